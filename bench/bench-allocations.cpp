@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "bench-data.hpp"
+#include "base/json.hpp"
+#include "base/serializer.hpp"
+#include "icinga/checkresult.hpp"
+#include "icinga/pluginutility.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <new>
+
+using namespace icinga;
+
+/* Counts the heap allocations of the current thread. The benchmarks in this
+ * file report them as the "allocations_per_item" counter. */
+static thread_local uint_fast64_t l_Allocations = 0;
+
+void *operator new(size_t size)
+{
+	l_Allocations++;
+
+	void *ptr = malloc(size ? size : 1);
+
+	if (!ptr)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+template<typename Function>
+static void CountAllocations(benchmark::State& state, const Function& function)
+{
+	uint_fast64_t allocations = 0;
+	uint_fast64_t items = 0;
+
+	for (auto _ : state) {
+		uint_fast64_t before = l_Allocations;
+
+		function();
+
+		allocations += l_Allocations - before;
+		items++;
+	}
+
+	state.counters["allocations_per_item"] = items ? static_cast<double>(allocations) / items : 0;
+}
+
+static void BM_AllocationsJsonDecodeCheckResult(benchmark::State& state)
+{
+	String message = GetCheckResultMessage();
+
+	CountAllocations(state, [&message]() {
+		benchmark::DoNotOptimize(JsonDecode(message));
+	});
+}
+BENCHMARK(BM_AllocationsJsonDecodeCheckResult);
+
+static void BM_AllocationsDeserializeCheckResult(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+
+	CountAllocations(state, [&cr]() {
+		benchmark::DoNotOptimize(Deserialize(cr, true));
+	});
+}
+BENCHMARK(BM_AllocationsDeserializeCheckResult);
+
+static void BM_AllocationsProcessCheckOutput(benchmark::State& state)
+{
+	/* The same steps as PluginCheckTask::ProcessFinishedHandler. */
+	Dictionary::Ptr crd = GetCheckResultDictionary();
+	String output = crd->Get("output") + "|" + PluginUtility::FormatPerfdata(crd->Get("performance_data"));
+
+	CountAllocations(state, [&output]() {
+		CheckResult::Ptr cr = new CheckResult();
+
+		std::pair<String, String> co = PluginUtility::ParseCheckOutput(output);
+		cr->SetOutput(std::move(co.first));
+		cr->SetPerformanceData(PluginUtility::SplitPerfdata(co.second));
+		cr->SetExitStatus(0);
+
+		benchmark::DoNotOptimize(cr);
+	});
+}
+BENCHMARK(BM_AllocationsProcessCheckOutput);
@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "bench-data.hpp"
+#include "base/base64.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static void BM_Base64EncodeCheckResult(benchmark::State& state)
+{
+	String message = GetCheckResultMessage();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Base64::Encode(message));
+
+	state.SetBytesProcessed(state.iterations() * message.GetLength());
+}
+BENCHMARK(BM_Base64EncodeCheckResult);
+
+static void BM_Base64DecodeCheckResult(benchmark::State& state)
+{
+	String encoded = Base64::Encode(GetCheckResultMessage());
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Base64::Decode(encoded));
+
+	state.SetBytesProcessed(state.iterations() * encoded.GetLength());
+}
+BENCHMARK(BM_Base64DecodeCheckResult);
+
+static void BM_Base64DecodeCredentials(benchmark::State& state)
+{
+	String encoded = Base64::Encode("root:icinga");
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Base64::Decode(encoded));
+}
+BENCHMARK(BM_Base64DecodeCredentials);
@@ -0,0 +1,39 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "bench-data.hpp"
+#include "base/json.hpp"
+
+using namespace icinga;
+
+/* Recorded from a cluster connection between two endpoints; the check is
+ * a "disk" check with one perfdata value per mount point. */
+static const char *l_CheckResultMessage = R"JSON({"jsonrpc":"2.0","method":"event::CheckResult","params":{"cr":{"active":true,"check_source":"satellite1.example.com","command":["/usr/lib/nagios/plugins/check_disk","-c","10%","-w","20%","-X","none","-X","tmpfs","-X","sysfs","-X","proc","-X","configfs","-X","devtmpfs","-X","devfs","-X","mtmfs","-X","tracefs","-X","cgroup","-X","fuse.gvfsd-fuse","-X","fuse.gvfs-fuse-daemon","-X","fdescfs","-X","overlay","-X","nsfs","-X","squashfs","-m"],"execution_end":1532419362.8547599316,"execution_start":1532419362.8420729637,"exit_status":0.0,"output":"DISK OK - free space: / 21007 MB (62% inode=87%); /boot 818 MB (86% inode=99%); /var 6276 MB (64% inode=96%); /var/lib/mysql 38190 MB (78% inode=99%); /home 9775 MB (97% inode=99%);","performance_data":["/=12456MB;26995;30369;0;33744","/boot=130MB;799;899;0;999","/var=3489MB;7986;8984;0;9983","/var/lib/mysql=10598MB;39026;43904;0;48783","/home=248MB;8041;9046;0;10052"],"schedule_end":1532419362.8548309803,"schedule_start":1532419362.8400001526,"state":0.0,"ttl":0.0,"type":"CheckResult","vars_after":{"attempt":1.0,"reachable":true,"state":0.0,"state_type":1.0},"vars_before":{"attempt":1.0,"reachable":true,"state":0.0,"state_type":1.0}},"host":"web-frontend-042.example.com","service":"disk"},"ts":1532419362.8551239967})JSON";
+
+String icinga::GetCheckResultMessage()
+{
+	return l_CheckResultMessage;
+}
+
+Dictionary::Ptr icinga::GetCheckResultDictionary()
+{
+	Dictionary::Ptr message = JsonDecode(l_CheckResultMessage);
+	Dictionary::Ptr params = message->Get("params");
+	return params->Get("cr");
+}
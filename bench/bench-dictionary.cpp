@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "bench-data.hpp"
+#include "base/dictionary.hpp"
+#include "base/objectlock.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static void BM_DictionaryGet(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(cr->Get("execution_end"));
+}
+BENCHMARK(BM_DictionaryGet);
+
+static void BM_DictionaryGetMissing(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(cr->Get("previous_hard_state"));
+}
+BENCHMARK(BM_DictionaryGetMissing);
+
+static void BM_DictionaryBuild(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+
+	for (auto _ : state) {
+		Dictionary::Ptr result = new Dictionary({
+			{ "type", "CheckResult" },
+			{ "active", cr->Get("active") },
+			{ "check_source", cr->Get("check_source") },
+			{ "execution_start", cr->Get("execution_start") },
+			{ "execution_end", cr->Get("execution_end") },
+			{ "schedule_start", cr->Get("schedule_start") },
+			{ "schedule_end", cr->Get("schedule_end") },
+			{ "exit_status", cr->Get("exit_status") },
+			{ "output", cr->Get("output") },
+			{ "performance_data", cr->Get("performance_data") },
+			{ "state", cr->Get("state") }
+		});
+
+		benchmark::DoNotOptimize(result);
+	}
+}
+BENCHMARK(BM_DictionaryBuild);
+
+static void BM_DictionarySet(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+	double ts = 0;
+
+	for (auto _ : state)
+		cr->Set("execution_end", ts++);
+}
+BENCHMARK(BM_DictionarySet);
+
+static void BM_DictionaryShallowClone(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(cr->ShallowClone());
+}
+BENCHMARK(BM_DictionaryShallowClone);
+
+static void BM_DictionaryIterate(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+
+	for (auto _ : state) {
+		ObjectLock olock(cr);
+
+		for (const Dictionary::Pair& kv : cr)
+			benchmark::DoNotOptimize(kv.second);
+	}
+}
+BENCHMARK(BM_DictionaryIterate);
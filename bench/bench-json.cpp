@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "bench-data.hpp"
+#include "base/json.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static void BM_JsonEncodeCheckResult(benchmark::State& state)
+{
+	Value message = JsonDecode(GetCheckResultMessage());
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(JsonEncode(message));
+
+	state.SetBytesProcessed(state.iterations() * GetCheckResultMessage().GetLength());
+}
+BENCHMARK(BM_JsonEncodeCheckResult);
+
+static void BM_JsonDecodeCheckResult(benchmark::State& state)
+{
+	String message = GetCheckResultMessage();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(JsonDecode(message));
+
+	state.SetBytesProcessed(state.iterations() * message.GetLength());
+}
+BENCHMARK(BM_JsonDecodeCheckResult);
+
+static void BM_JsonDecodeYajlCheckResult(benchmark::State& state)
+{
+	String message = GetCheckResultMessage();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(JsonDecodeYajl(message));
+
+	state.SetBytesProcessed(state.iterations() * message.GetLength());
+}
+BENCHMARK(BM_JsonDecodeYajlCheckResult);
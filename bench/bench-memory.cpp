@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "bench-data.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include <benchmark/benchmark.h>
+#include <vector>
+#ifdef __GLIBC__
+#	include <malloc.h>
+#endif /* __GLIBC__ */
+
+using namespace icinga;
+
+/* These benchmarks report the heap memory which is retained per item as the
+ * "bytes_per_item" counter; their timings are not meaningful. */
+
+#ifdef __GLIBC__
+static double GetHeapInUse()
+{
+#	if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 mi = mallinfo2();
+#	else /* __GLIBC__ */
+	struct mallinfo mi = mallinfo();
+#	endif /* __GLIBC__ */
+
+	return static_cast<double>(mi.uordblks) + mi.hblkhd;
+}
+#endif /* __GLIBC__ */
+
+template<typename Function>
+static void MeasureRetainedMemory(benchmark::State& state, const Function& createItem)
+{
+#ifdef __GLIBC__
+	const int count = 1000;
+
+	double bytes = 0;
+
+	for (auto _ : state) {
+		std::vector<Object::Ptr> items;
+		items.reserve(count);
+
+		double before = GetHeapInUse();
+
+		for (int i = 0; i < count; i++)
+			items.push_back(createItem());
+
+		bytes = (GetHeapInUse() - before) / count;
+	}
+
+	state.counters["bytes_per_item"] = bytes;
+#else /* __GLIBC__ */
+	state.SkipWithError("Heap statistics are only available with glibc.");
+#endif /* __GLIBC__ */
+}
+
+static void BM_MemoryCheckResultDictionary(benchmark::State& state)
+{
+	MeasureRetainedMemory(state, []() -> Object::Ptr {
+		return GetCheckResultDictionary();
+	});
+}
+BENCHMARK(BM_MemoryCheckResultDictionary)->Iterations(1);
+
+static void BM_MemoryPerfdataArray(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+	Array::Ptr perfdata = cr->Get("performance_data");
+
+	MeasureRetainedMemory(state, [&perfdata]() -> Object::Ptr {
+		return perfdata->ShallowClone();
+	});
+}
+BENCHMARK(BM_MemoryPerfdataArray)->Iterations(1);
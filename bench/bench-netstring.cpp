@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "bench-data.hpp"
+#include "base/netstring.hpp"
+#include "base/fifo.hpp"
+#include "base/convert.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+/* Reads a batch of check result messages which arrived in a single read, as with a busy cluster connection. */
+static void BM_NetStringReadCheckResults(benchmark::State& state)
+{
+	String message = GetCheckResultMessage();
+	const int count = state.range(0);
+
+	FIFO::Ptr fifo = new FIFO();
+	StreamReadContext src;
+	String result;
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		for (int i = 0; i < count; i++)
+			NetString::WriteStringToStream(fifo, message);
+		state.ResumeTiming();
+
+		for (int i = 0; i < count; i++) {
+			while (NetString::ReadStringFromStream(fifo, &result, src) == StatusNeedData)
+				;
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * count);
+	state.SetBytesProcessed(state.iterations() * count * message.GetLength());
+}
+BENCHMARK(BM_NetStringReadCheckResults)->Arg(1)->Arg(64);
+
+static void BM_NetStringParse(benchmark::State& state)
+{
+	String message = GetCheckResultMessage();
+	String buffer = Convert::ToString(message.GetLength()) + ":" + message + ",";
+
+	for (auto _ : state) {
+		const char *data;
+		size_t length;
+
+		benchmark::DoNotOptimize(NetString::ParseString(buffer.CStr(), buffer.GetLength(), &data, &length));
+		benchmark::DoNotOptimize(data);
+	}
+}
+BENCHMARK(BM_NetStringParse);
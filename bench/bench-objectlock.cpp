@@ -0,0 +1,44 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/dictionary.hpp"
+#include "base/objectlock.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static Dictionary::Ptr l_LockedObject = new Dictionary();
+
+static void BM_ObjectLock(benchmark::State& state)
+{
+	for (auto _ : state)
+		ObjectLock olock(l_LockedObject);
+}
+/* More than one thread measures the contended case. */
+BENCHMARK(BM_ObjectLock)->ThreadRange(1, 8);
+
+static void BM_ObjectLockRecursive(benchmark::State& state)
+{
+	Dictionary::Ptr dict = new Dictionary();
+	ObjectLock outer(dict);
+
+	for (auto _ : state)
+		ObjectLock olock(dict);
+}
+BENCHMARK(BM_ObjectLockRecursive);
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "bench-data.hpp"
+#include "base/serializer.hpp"
+#include "base/perfdatavalue.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static void BM_SerializeCheckResult(benchmark::State& state)
+{
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Serialize(cr));
+}
+BENCHMARK(BM_SerializeCheckResult);
+
+static void BM_DeserializeCheckResult(benchmark::State& state)
+{
+	/* The "type" attribute makes the deserializer create a CheckResult object. */
+	Dictionary::Ptr cr = GetCheckResultDictionary();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Deserialize(cr, true));
+}
+BENCHMARK(BM_DeserializeCheckResult);
+
+static void BM_SerializePerfdataValue(benchmark::State& state)
+{
+	PerfdataValue::Ptr pdv = PerfdataValue::Parse("/var/lib/mysql=10598MB;39026;43904;0;48783");
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Serialize(pdv));
+}
+BENCHMARK(BM_SerializePerfdataValue);
@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/string.hpp"
+#include "base/utility.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static void BM_StringConcat(benchmark::State& state)
+{
+	String host = "web-frontend-042.example.com";
+	String service = "disk";
+
+	for (auto _ : state) {
+		String name = host + "!" + service;
+		benchmark::DoNotOptimize(name);
+	}
+}
+BENCHMARK(BM_StringConcat);
+
+static void BM_StringFind(benchmark::State& state)
+{
+	String name = "web-frontend-042.example.com!disk";
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(name.Find("!"));
+}
+BENCHMARK(BM_StringFind);
+
+static void BM_StringSplit(benchmark::State& state)
+{
+	String perfdata = "/=12456MB;26995;30369;0;33744";
+
+	for (auto _ : state) {
+		std::vector<String> tokens = perfdata.Split(";");
+		benchmark::DoNotOptimize(tokens);
+	}
+}
+BENCHMARK(BM_StringSplit);
+
+static void BM_StringCompare(benchmark::State& state)
+{
+	String a = "web-frontend-042.example.com";
+	String b = "web-frontend-043.example.com";
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(a < b);
+}
+BENCHMARK(BM_StringCompare);
@@ -0,0 +1,60 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/timer.hpp"
+#include "base/utility.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static void BM_TimerStartStop(benchmark::State& state)
+{
+	Timer::Ptr timer = new Timer();
+	timer->SetInterval(300);
+
+	for (auto _ : state) {
+		timer->Start();
+		timer->Stop();
+	}
+}
+BENCHMARK(BM_TimerStartStop);
+
+static void BM_TimerReschedule(benchmark::State& state)
+{
+	/* Each timer stands for e.g. the check timer of a checkable. */
+	std::vector<Timer::Ptr> timers;
+
+	for (int i = 0; i < state.range(0); i++) {
+		Timer::Ptr timer = new Timer();
+		timer->SetInterval(300 + i);
+		timer->Start();
+		timers.push_back(timer);
+	}
+
+	size_t index = 0;
+
+	for (auto _ : state) {
+		timers[index]->Reschedule(Utility::GetTime() + 300);
+		index = (index + 1) % timers.size();
+	}
+
+	for (const Timer::Ptr& timer : timers)
+		timer->Stop();
+}
+BENCHMARK(BM_TimerReschedule)->Arg(10000);
@@ -0,0 +1,86 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/value.hpp"
+#include "base/dictionary.hpp"
+#include "base/convert.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static void BM_ValueCopyNumber(benchmark::State& state)
+{
+	Value value = 1532419362.8547599316;
+
+	for (auto _ : state) {
+		Value copy = value;
+		benchmark::DoNotOptimize(copy);
+	}
+}
+BENCHMARK(BM_ValueCopyNumber);
+
+static void BM_ValueCopyString(benchmark::State& state)
+{
+	Value value = "DISK OK - free space: / 21007 MB (62% inode=87%);";
+
+	for (auto _ : state) {
+		Value copy = value;
+		benchmark::DoNotOptimize(copy);
+	}
+}
+BENCHMARK(BM_ValueCopyString);
+
+static void BM_ValueCopyObject(benchmark::State& state)
+{
+	Value value = new Dictionary();
+
+	for (auto _ : state) {
+		Value copy = value;
+		benchmark::DoNotOptimize(copy);
+	}
+}
+BENCHMARK(BM_ValueCopyObject);
+
+static void BM_ValueToDouble(benchmark::State& state)
+{
+	Value value = "1532419362.8547599316";
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Convert::ToDouble(value));
+}
+BENCHMARK(BM_ValueToDouble);
+
+static void BM_ValueToString(benchmark::State& state)
+{
+	Value value = 1532419362.8547599316;
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Convert::ToString(value));
+}
+BENCHMARK(BM_ValueToString);
+
+static void BM_ValueCompare(benchmark::State& state)
+{
+	Value a = "web-frontend-042.example.com";
+	Value b = "web-frontend-043.example.com";
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(a == b);
+}
+BENCHMARK(BM_ValueCompare);
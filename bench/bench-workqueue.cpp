@@ -0,0 +1,58 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/workqueue.hpp"
+#include "base/application.hpp"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <numeric>
+
+using namespace icinga;
+
+static void BM_WorkQueueEnqueueJoin(benchmark::State& state)
+{
+	WorkQueue upq(0, state.range(1));
+	std::atomic<int64_t> counter(0);
+
+	for (auto _ : state) {
+		for (int64_t i = 0; i < state.range(0); i++)
+			upq.Enqueue([&counter]() { counter++; });
+
+		upq.Join();
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WorkQueueEnqueueJoin)->Args({ 1000, 1 })->Args({ 1000, 4 })->UseRealTime();
+
+static void BM_WorkQueueParallelFor(benchmark::State& state)
+{
+	WorkQueue upq(0, Application::GetConcurrency());
+	std::vector<int> items(state.range(0));
+	std::iota(items.begin(), items.end(), 0);
+	std::atomic<int64_t> sum(0);
+
+	for (auto _ : state) {
+		upq.ParallelFor(items, [&sum](int item) { sum += item; });
+		upq.Join();
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WorkQueueParallelFor)->Arg(10000)->UseRealTime();
@@ -0,0 +1,326 @@
+#!/usr/bin/env python
+# -*- coding:utf-8 -*-
+#
+# Icinga 2
+# Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation
+# Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+
+"""Runs the microbenchmarks and the `icinga2 bench checks` load test and
+compares the results with a stored baseline.
+
+A metric is reported as a regression if its median is worse than the
+baseline's median by more than the metric's threshold and, when both sides
+have enough samples, a one-sided Mann-Whitney U test says that the
+difference is significant. Exits with status 1 if there is a regression.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+FORMAT_VERSION = 1
+
+# Relative thresholds per kind of metric. Latencies are noisier than the
+# other metrics because they depend on the scheduler of the machine.
+THRESHOLDS = {
+    "time": 0.10,
+    "throughput": 0.05,
+    "latency": 0.20,
+    "memory": 0.05
+}
+
+TIME_UNITS = {
+    "ns": 1.0,
+    "us": 1e3,
+    "ms": 1e6,
+    "s": 1e9
+}
+
+# The load test offers 2100 check results per second and runs long enough
+# for the check scheduler to be past its initial spread.
+LOAD_ARGS = ["--hosts", "100", "--services", "20", "--check-interval", "1"]
+
+
+def add_sample(metrics, name, kind, better, unit, value):
+    metric = metrics.setdefault(name, {
+        "kind": kind,
+        "better": better,
+        "unit": unit,
+        "samples": []
+    })
+
+    metric["samples"].append(value)
+
+
+def run_benchmarks(binary, repetitions, benchmark_filter, metrics, context):
+    fd, path = tempfile.mkstemp(suffix=".json")
+    os.close(fd)
+
+    try:
+        args = [binary,
+                "--benchmark_repetitions=%d" % repetitions,
+                "--benchmark_out=%s" % path,
+                "--benchmark_out_format=json"]
+
+        if benchmark_filter:
+            args.append("--benchmark_filter=%s" % benchmark_filter)
+
+        subprocess.check_call(args, stdout=sys.stderr)
+
+        with open(path) as fp:
+            results = json.load(fp)
+    finally:
+        os.remove(path)
+
+    bench_context = results.get("context", {})
+
+    for key in ("host_name", "num_cpus", "mhz_per_cpu", "library_build_type"):
+        if key in bench_context:
+            context[key] = bench_context[key]
+
+    for bench in results.get("benchmarks", []):
+        if bench.get("run_type", "iteration") != "iteration" or bench.get("error_occurred"):
+            continue
+
+        name = bench.get("run_name", bench["name"])
+
+        if "bytes_per_item" in bench:
+            add_sample(metrics, name + ".bytes_per_item", "memory", "lower", "B", bench["bytes_per_item"])
+            continue
+
+        if "allocations_per_item" in bench:
+            add_sample(metrics, name + ".allocations_per_item", "memory", "lower", "", bench["allocations_per_item"])
+
+        factor = TIME_UNITS[bench.get("time_unit", "ns")]
+        add_sample(metrics, name + ".real_time", "time", "lower", "ns", bench["real_time"] * factor)
+
+
+def run_load_test(binary, runs, duration, metrics):
+    for run in range(runs):
+        print("Load test run %d/%d (%d seconds)" % (run + 1, runs, duration), file=sys.stderr)
+
+        output = subprocess.check_output([binary, "bench", "checks", "--json",
+                                          "--duration", str(duration)] + LOAD_ARGS)
+
+        summary = None
+
+        for line in output.decode("utf-8").splitlines():
+            if line.startswith("{"):
+                summary = json.loads(line).get("summary", summary)
+
+        if summary is None:
+            raise RuntimeError("'icinga2 bench checks' did not print a summary.")
+
+        add_sample(metrics, "checks.throughput", "throughput", "higher", "1/s",
+                   summary["sustained_check_results_per_second"])
+
+        for key in ("p50", "p95", "p99"):
+            add_sample(metrics, "checks.latency_" + key, "latency", "lower", "s", summary["latency"][key])
+
+        add_sample(metrics, "checks.peak_rss", "memory", "lower", "B", summary["peak_rss"])
+
+
+def median(values):
+    values = sorted(values)
+    mid = len(values) // 2
+
+    if len(values) % 2:
+        return values[mid]
+
+    return (values[mid - 1] + values[mid]) / 2.0
+
+
+def mann_whitney_p(baseline, current):
+    """Returns the one-sided p-value for the hypothesis that the values in
+    `current` tend to be larger than those in `baseline`, using the normal
+    approximation with tie correction. Returns None if all values are equal."""
+
+    n1 = len(current)
+    n2 = len(baseline)
+    values = sorted([(v, 0) for v in current] + [(v, 1) for v in baseline])
+    n = n1 + n2
+
+    rank_sum = 0.0
+    tie_term = 0.0
+    i = 0
+
+    while i < n:
+        j = i
+
+        while j + 1 < n and values[j + 1][0] == values[i][0]:
+            j += 1
+
+        rank = (i + j) / 2.0 + 1
+        ties = j - i + 1
+        tie_term += ties ** 3 - ties
+
+        for k in range(i, j + 1):
+            if values[k][1] == 0:
+                rank_sum += rank
+
+        i = j + 1
+
+    u = rank_sum - n1 * (n1 + 1) / 2.0
+    variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)))
+
+    if variance <= 0:
+        return None
+
+    z = (u - n1 * n2 / 2.0 - 0.5) / math.sqrt(variance)
+
+    return 0.5 * math.erfc(z / math.sqrt(2))
+
+
+def compare(baseline, current, threshold, alpha, min_samples):
+    regressions = []
+    rows = []
+
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            rows.append((name, "", "", "", "", "missing"))
+            continue
+
+        if name not in baseline:
+            rows.append((name, "", "%.4g" % median(current[name]["samples"]), "", "", "new"))
+            continue
+
+        metric = current[name]
+        base_samples = baseline[name]["samples"]
+        cur_samples = metric["samples"]
+
+        base_median = median(base_samples)
+        cur_median = median(cur_samples)
+
+        if metric["better"] == "higher":
+            base_samples = [-v for v in base_samples]
+            cur_samples = [-v for v in cur_samples]
+
+        if base_median == 0:
+            change = 0.0
+        else:
+            change = (cur_median - base_median) / abs(base_median)
+
+        worse = -change if metric["better"] == "higher" else change
+        limit = threshold if threshold is not None else THRESHOLDS[metric["kind"]]
+
+        p = None
+
+        if len(base_samples) >= min_samples and len(cur_samples) >= min_samples:
+            p = mann_whitney_p(base_samples, cur_samples)
+
+        if worse > limit and (p is None or p < alpha):
+            status = "REGRESSION"
+            regressions.append(name)
+        elif -worse > limit and (p is None or 1 - p < alpha):
+            status = "improved"
+        else:
+            status = "ok"
+
+        rows.append((name, "%.4g" % base_median, "%.4g %s" % (cur_median, metric["unit"]),
+                     "%+.1f%%" % (change * 100), "" if p is None else "%.3f" % p, status))
+
+    header = ("Metric", "Baseline", "Current", "Change", "p", "Status")
+    widths = [max(len(row[i]) for row in rows + [header]) for i in range(len(header))]
+
+    for row in [header] + rows:
+        print("  ".join(col.ljust(widths[i]) for i, col in enumerate(row)).rstrip())
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--baseline", required=True, help="baseline JSON file")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="store the results as the new baseline instead of comparing them")
+    parser.add_argument("--results", help="write the results to this JSON file")
+    parser.add_argument("--current", help="compare this results file instead of running the benchmarks")
+    parser.add_argument("--bench-binary", help="path to icinga2-bench")
+    parser.add_argument("--icinga2-binary", help="path to icinga2; the load test is skipped if this is not set")
+    parser.add_argument("--benchmark-filter", help="only run the microbenchmarks matching this regex")
+    parser.add_argument("--repetitions", type=int, default=5, help="repetitions per microbenchmark")
+    parser.add_argument("--load-runs", type=int, default=3, help="number of load test runs")
+    parser.add_argument("--load-duration", type=int, default=30, help="duration of a load test run in seconds")
+    parser.add_argument("--threshold", type=float,
+                        help="relative threshold in percent for all metrics (default: per kind of metric)")
+    parser.add_argument("--alpha", type=float, default=0.05, help="significance level")
+    parser.add_argument("--min-samples", type=int, default=3,
+                        help="minimum number of samples on both sides for the significance test")
+    args = parser.parse_args()
+
+    if args.current:
+        with open(args.current) as fp:
+            results = json.load(fp)
+    else:
+        if not args.bench_binary and not args.icinga2_binary:
+            parser.error("--bench-binary or --icinga2-binary is required unless --current is used.")
+
+        results = {"version": FORMAT_VERSION, "context": {}, "metrics": {}}
+
+        if args.bench_binary:
+            run_benchmarks(args.bench_binary, args.repetitions, args.benchmark_filter,
+                           results["metrics"], results["context"])
+
+        if args.icinga2_binary:
+            run_load_test(args.icinga2_binary, args.load_runs, args.load_duration, results["metrics"])
+
+    if args.results:
+        with open(args.results, "w") as fp:
+            json.dump(results, fp, indent=2, sort_keys=True)
+
+    if args.update_baseline:
+        with open(args.baseline, "w") as fp:
+            json.dump(results, fp, indent=2, sort_keys=True)
+
+        print("Stored %d metrics as the baseline in '%s'." % (len(results["metrics"]), args.baseline))
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print("The baseline '%s' does not exist. Create it with --update-baseline or 'make perf-baseline' "
+              "on a known-good commit." % args.baseline, file=sys.stderr)
+        return 2
+
+    with open(args.baseline) as fp:
+        baseline = json.load(fp)
+
+    if baseline.get("version") != FORMAT_VERSION:
+        print("The baseline '%s' has an unsupported format version." % args.baseline, file=sys.stderr)
+        return 2
+
+    for key, value in sorted(baseline.get("context", {}).items()):
+        if key in results["context"] and results["context"][key] != value:
+            print("Warning: The baseline was recorded with %s=%s, the results with %s=%s."
+                  % (key, value, key, results["context"][key]), file=sys.stderr)
+
+    threshold = args.threshold / 100.0 if args.threshold is not None else None
+    regressions = compare(baseline["metrics"], results["metrics"], threshold, args.alpha, args.min_samples)
+
+    if regressions:
+        print("\n%d significant regression(s): %s" % (len(regressions), ", ".join(regressions)))
+        return 1
+
+    print("\nNo significant regressions.")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -7,11 +7,16 @@
 #cmakedefine HAVE_DLADDR
 #cmakedefine HAVE_LIBEXECINFO
 #cmakedefine HAVE_CXXABI_H
+#cmakedefine HAVE_LINUX_IO_URING_H
 #cmakedefine HAVE_NICE
 #cmakedefine HAVE_EDITLINE
 #cmakedefine HAVE_SYSTEMD
+#cmakedefine HAVE_ZLIB
 
 #cmakedefine ICINGA2_UNITY_BUILD
+#cmakedefine ICINGA2_WITH_SIMD_JSON
+#cmakedefine ICINGA2_STRIP_DEBUG_LOG
+#cmakedefine ICINGA2_WITH_MEMORY_ACCOUNTING
 
 #define ICINGA_PREFIX "${CMAKE_INSTALL_PREFIX}"
 #define ICINGA_SYSCONFDIR "${CMAKE_INSTALL_FULL_SYSCONFDIR}"
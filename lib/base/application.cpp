@@ -54,12 +54,15 @@ using namespace icinga;
 REGISTER_TYPE(Application);
 
 boost::signals2::signal<void ()> Application::OnReopenLogs;
+boost::signals2::signal<void ()> Application::OnReloadValidated;
 Application::Ptr Application::m_Instance = nullptr;
 bool Application::m_ShuttingDown = false;
 bool Application::m_RequestRestart = false;
 bool Application::m_RequestReopenLogs = false;
 pid_t Application::m_ReloadProcess = 0;
 static bool l_Restarting = false;
+static bool l_IncrementalReload = false;
+static bool l_FullReloadRequested = false;
 static bool l_InExceptionHandler = false;
 int Application::m_ArgC;
 char **Application::m_ArgV;
@@ -363,8 +366,12 @@ mainloop:
 
 	Log(LogInformation, "Application", "Shutting down...");
 
-	ConfigObject::StopObjects();
-	Application::GetInstance()->OnShutdown();
+	Value defaultTimeout = 60;
+	double timeout = ScriptGlobal::Get("ShutdownTimeout", &defaultTimeout);
+
+	/* The state is written while the remaining objects are being deactivated. */
+	Application::Ptr app = Application::GetInstance();
+	ConfigObject::StopObjects([app]() { app->OnShutdown(); }, timeout);
 
 	UninitializeBase();
 }
@@ -379,23 +386,31 @@ void Application::OnShutdown()
 	/* Nothing to do here. */
 }
 
-static void ReloadProcessCallbackInternal(const ProcessResult& pr)
+static void ReloadProcessCallbackInternal(const ProcessResult& pr, bool incremental)
 {
 	if (pr.ExitStatus != 0) {
 		Application::SetLastReloadFailed(Utility::GetTime());
 		Log(LogCritical, "Application", "Found error in config: reloading aborted");
+	} else if (incremental) {
+		/* The new process only validated the config, the running objects are updated in place. */
+		Application::OnReloadValidated();
 	}
 #ifdef _WIN32
 	else
 		Application::Exit(7); /* keep this exit code in sync with icinga-app */
 #endif /* _WIN32 */
+
+#ifdef HAVE_SYSTEMD
+	if (incremental)
+		sd_notify(0, "READY=1");
+#endif /* HAVE_SYSTEMD */
 }
 
 static void ReloadProcessCallback(const ProcessResult& pr)
 {
 	l_Restarting = false;
 
-	std::thread t(std::bind(&ReloadProcessCallbackInternal, pr));
+	std::thread t(std::bind(&ReloadProcessCallbackInternal, pr, l_IncrementalReload));
 	t.detach();
 }
 
@@ -414,9 +429,16 @@ pid_t Application::StartReloadProcess()
 			i++;     // the next parameter after --reload-internal is the pid, remove that too
 	}
 
+	l_IncrementalReload = IsIncrementalReload() && !l_FullReloadRequested;
+	l_FullReloadRequested = false;
+
 #ifndef _WIN32
-	args.push_back("--reload-internal");
-	args.push_back(Convert::ToString(Utility::GetPid()));
+	if (l_IncrementalReload)
+		args.push_back("--validate");
+	else {
+		args.push_back("--reload-internal");
+		args.push_back(Convert::ToString(Utility::GetPid()));
+	}
 #else /* _WIN32 */
 	args.push_back("--validate");
 #endif /* _WIN32 */
@@ -448,6 +470,17 @@ void Application::RequestRestart()
 	m_RequestRestart = true;
 }
 
+/**
+ * Signals the application to restart during the next execution of the
+ * event loop, replacing the process even if incremental reloads are
+ * enabled.
+ */
+void Application::RequestFullReload()
+{
+	l_FullReloadRequested = true;
+	m_RequestRestart = true;
+}
+
 /**
  * Signals the application to reopen log files during the
  * next execution of the event loop.
@@ -1636,6 +1669,17 @@ void Application::SetScriptDebuggerEnabled(bool enabled)
 	m_ScriptDebuggerEnabled = enabled;
 }
 
+/**
+ * Returns whether a reload should update the running objects in place
+ * instead of replacing the process.
+ *
+ * @returns true if incremental reloads are enabled, false otherwise.
+ */
+bool Application::IsIncrementalReload()
+{
+	return Convert::ToBool(ScriptGlobal::Get("IncrementalReload", &Empty));
+}
+
 double Application::GetLastReloadFailed()
 {
 	return m_LastReloadFailed;
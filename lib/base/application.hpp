@@ -40,6 +40,7 @@ public:
 	DECLARE_OBJECT(Application);
 
 	static boost::signals2::signal<void ()> OnReopenLogs;
+	static boost::signals2::signal<void ()> OnReloadValidated;
 
 	~Application() override;
 
@@ -71,6 +72,7 @@ public:
 
 	static void RequestShutdown();
 	static void RequestRestart();
+	static void RequestFullReload();
 	static void RequestReopenLogs();
 
 	static bool IsShuttingDown();
@@ -165,6 +167,8 @@ public:
 	static bool GetScriptDebuggerEnabled();
 	static void SetScriptDebuggerEnabled(bool enabled);
 
+	static bool IsIncrementalReload();
+
 	static double GetLastReloadFailed();
 	static void SetLastReloadFailed(double ts);
 
@@ -44,6 +44,58 @@ Array::Array(std::initializer_list<Value> init)
 	: m_Data(init)
 { }
 
+Array::~Array()
+{
+	if (m_Shared && m_Shared->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		delete m_Shared;
+}
+
+/**
+ * Moves the array's data into a block which can be shared with clones.
+ *
+ * Note: Caller must hold the object lock unless the array is frozen.
+ */
+void Array::Share() const
+{
+	if (m_Shared)
+		return;
+
+	m_Shared = new SharedData{ { 1 }, std::move(m_Data) };
+	m_Data.clear();
+}
+
+/**
+ * Returns the array's data for modifying it. If the data is shared with
+ * other arrays this makes a private copy first.
+ *
+ * Note: Caller must hold the object lock.
+ */
+std::vector<Value>& Array::GetMutableData()
+{
+	ASSERT(OwnsLock());
+
+	if (m_Frozen)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
+
+	if (m_Shared) {
+		/* References are only added while holding the lock of an array
+		 * which uses the block, so a count of 1 can't change under us. */
+		if (m_Shared->References.load(std::memory_order_acquire) == 1) {
+			m_Data = std::move(m_Shared->Data);
+			delete m_Shared;
+		} else {
+			m_Data = m_Shared->Data;
+
+			if (m_Shared->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete m_Shared;
+		}
+
+		m_Shared = nullptr;
+	}
+
+	return m_Data;
+}
+
 /**
  * Restrieves a value from an array.
  *
@@ -52,9 +104,9 @@ Array::Array(std::initializer_list<Value> init)
  */
 Value Array::Get(SizeType index) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	return m_Data.at(index);
+	return GetData().at(index);
 }
 
 /**
@@ -67,10 +119,7 @@ void Array::Set(SizeType index, const Value& value)
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
-
-	m_Data.at(index) = value;
+	GetMutableData().at(index) = value;
 }
 
 /**
@@ -83,10 +132,7 @@ void Array::Set(SizeType index, Value&& value)
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
-
-	m_Data.at(index).Swap(value);
+	GetMutableData().at(index).Swap(value);
 }
 
 /**
@@ -98,38 +144,43 @@ void Array::Add(Value value)
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
-
-	m_Data.push_back(std::move(value));
+	GetMutableData().push_back(std::move(value));
 }
 
 /**
  * Returns an iterator to the beginning of the array.
  *
- * Note: Caller must hold the object lock while using the iterator.
+ * Note: Caller must hold the object lock while using the iterator unless
+ * the array is frozen.
  *
  * @returns An iterator.
  */
 Array::Iterator Array::Begin()
 {
-	ASSERT(OwnsLock());
+	ASSERT(m_Frozen || OwnsLock());
+
+	if (m_Frozen)
+		return m_Shared->Data.begin();
 
-	return m_Data.begin();
+	return GetMutableData().begin();
 }
 
 /**
  * Returns an iterator to the end of the array.
  *
- * Note: Caller must hold the object lock while using the iterator.
+ * Note: Caller must hold the object lock while using the iterator unless
+ * the array is frozen.
  *
  * @returns An iterator.
  */
 Array::Iterator Array::End()
 {
-	ASSERT(OwnsLock());
+	ASSERT(m_Frozen || OwnsLock());
+
+	if (m_Frozen)
+		return m_Shared->Data.end();
 
-	return m_Data.end();
+	return GetMutableData().end();
 }
 
 /**
@@ -139,9 +190,9 @@ Array::Iterator Array::End()
  */
 size_t Array::GetLength() const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	return m_Data.size();
+	return GetData().size();
 }
 
 /**
@@ -152,9 +203,11 @@ size_t Array::GetLength() const
  */
 bool Array::Contains(const Value& value) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	return (std::find(m_Data.begin(), m_Data.end(), value) != m_Data.end());
+	const std::vector<Value>& data = GetData();
+
+	return (std::find(data.begin(), data.end(), value) != data.end());
 }
 
 /**
@@ -167,12 +220,11 @@ void Array::Insert(SizeType index, Value value)
 {
 	ObjectLock olock(this);
 
-	ASSERT(index <= m_Data.size());
+	std::vector<Value>& data = GetMutableData();
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
+	ASSERT(index <= data.size());
 
-	m_Data.insert(m_Data.begin() + index, std::move(value));
+	data.insert(data.begin() + index, std::move(value));
 }
 
 /**
@@ -184,10 +236,9 @@ void Array::Remove(SizeType index)
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
+	std::vector<Value>& data = GetMutableData();
 
-	m_Data.erase(m_Data.begin() + index);
+	data.erase(data.begin() + index);
 }
 
 /**
@@ -199,20 +250,14 @@ void Array::Remove(Array::Iterator it)
 {
 	ASSERT(OwnsLock());
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
-
-	m_Data.erase(it);
+	GetMutableData().erase(it);
 }
 
 void Array::Resize(SizeType newSize)
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
-
-	m_Data.resize(newSize);
+	GetMutableData().resize(newSize);
 }
 
 void Array::Clear()
@@ -222,6 +267,14 @@ void Array::Clear()
 	if (m_Frozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
 
+	/* There's no point in copying shared data only to throw it away. */
+	if (m_Shared) {
+		if (m_Shared->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete m_Shared;
+
+		m_Shared = nullptr;
+	}
+
 	m_Data.clear();
 }
 
@@ -229,10 +282,7 @@ void Array::Reserve(SizeType newSize)
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
-
-	m_Data.reserve(newSize);
+	GetMutableData().reserve(newSize);
 }
 
 void Array::CopyTo(const Array::Ptr& dest) const
@@ -240,21 +290,29 @@ void Array::CopyTo(const Array::Ptr& dest) const
 	ObjectLock olock(this);
 	ObjectLock xlock(dest);
 
-	if (dest->m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
+	const std::vector<Value>& data = GetData();
+	std::vector<Value>& destData = dest->GetMutableData();
 
-	std::copy(m_Data.begin(), m_Data.end(), std::back_inserter(dest->m_Data));
+	destData.insert(destData.end(), data.begin(), data.end());
 }
 
 /**
- * Makes a shallow copy of an array.
+ * Makes a shallow copy of an array. The copy shares the elements with
+ * this array until either of them is modified.
  *
  * @returns a copy of the array.
  */
 Array::Ptr Array::ShallowClone() const
 {
 	Array::Ptr clone = new Array();
-	CopyTo(clone);
+
+	/* Frozen arrays already share their data and never give it up. */
+	ObjectLock olock(m_Frozen ? nullptr : this);
+
+	Share();
+	m_Shared->References.fetch_add(1, std::memory_order_relaxed);
+	clone->m_Shared = m_Shared;
+
 	return clone;
 }
 
@@ -268,8 +326,8 @@ Object::Ptr Array::Clone() const
 {
 	ArrayData arr;
 
-	ObjectLock olock(this);
-	for (const Value& val : m_Data) {
+	ObjectLock olock(m_Frozen ? nullptr : this);
+	for (const Value& val : GetData()) {
 		arr.push_back(val.Clone());
 	}
 
@@ -280,10 +338,11 @@ Array::Ptr Array::Reverse() const
 {
 	Array::Ptr result = new Array();
 
-	ObjectLock olock(this);
-	ObjectLock xlock(result);
+	ObjectLock olock(m_Frozen ? nullptr : this);
+
+	const std::vector<Value>& data = GetData();
 
-	std::copy(m_Data.rbegin(), m_Data.rend(), std::back_inserter(result->m_Data));
+	result->m_Data.assign(data.rbegin(), data.rend());
 
 	return result;
 }
@@ -292,10 +351,9 @@ void Array::Sort()
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Array must not be modified."));
+	std::vector<Value>& data = GetMutableData();
 
-	std::sort(m_Data.begin(), m_Data.end());
+	std::sort(data.begin(), data.end());
 }
 
 String Array::ToString() const
@@ -309,19 +367,32 @@ Array::Ptr Array::Unique() const
 {
 	std::set<Value> result;
 
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	for (const Value& item : m_Data) {
+	for (const Value& item : GetData()) {
 		result.insert(item);
 	}
 
 	return Array::FromSet(result);
 }
 
+/**
+ * Makes the array read-only. Frozen arrays can be read without holding
+ * their object lock.
+ */
 void Array::Freeze()
 {
 	ObjectLock olock(this);
-	m_Frozen = true;
+
+	/* Readers which don't take the lock rely on the data not moving
+	 * once they've seen the frozen flag. */
+	Share();
+	m_Frozen.store(true, std::memory_order_release);
+}
+
+bool Array::IsFrozen() const
+{
+	return m_Frozen.load(std::memory_order_acquire);
 }
 
 Value Array::GetFieldByName(const String& field, bool sandboxed, const DebugInfo& debugInfo) const
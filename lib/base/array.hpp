@@ -22,8 +22,10 @@
 
 #include "base/i2-base.hpp"
 #include "base/objectlock.hpp"
+#include "base/objectpool.hpp"
 #include "base/value.hpp"
 #include <boost/range/iterator.hpp>
+#include <atomic>
 #include <vector>
 #include <set>
 
@@ -35,12 +37,17 @@ typedef std::vector<Value> ArrayData;
 /**
  * An array of Value items.
  *
+ * ShallowClone() doesn't copy the elements: The arrays share them until
+ * one of them is modified. Frozen arrays can be read without holding
+ * their object lock.
+ *
  * @ingroup base
  */
 class Array final : public Object
 {
 public:
 	DECLARE_OBJECT(Array);
+	DECLARE_POOLED_ALLOCATOR();
 
 	/**
 	 * An iterator that can be used to iterate over array elements.
@@ -50,6 +57,7 @@ public:
 	typedef std::vector<Value>::size_type SizeType;
 
 	Array() = default;
+	~Array() override;
 	Array(const ArrayData& other);
 	Array(ArrayData&& other);
 	Array(std::initializer_list<Value> init);
@@ -114,13 +122,29 @@ public:
 
 	Array::Ptr Unique() const;
 	void Freeze();
+	bool IsFrozen() const;
 
 	Value GetFieldByName(const String& field, bool sandboxed, const DebugInfo& debugInfo) const override;
 	void SetFieldByName(const String& field, const Value& value, const DebugInfo& debugInfo) override;
 
 private:
-	std::vector<Value> m_Data; /**< The data for the array. */
-	bool m_Frozen{false};
+	struct SharedData
+	{
+		std::atomic<uint_fast32_t> References;
+		std::vector<Value> Data;
+	};
+
+	mutable std::vector<Value> m_Data; /**< The data for the array unless it is shared. */
+	mutable SharedData *m_Shared{nullptr}; /**< The data which is shared with clones. */
+	std::atomic<bool> m_Frozen{false};
+
+	const std::vector<Value>& GetData() const
+	{
+		return m_Shared ? m_Shared->Data : m_Data;
+	}
+
+	std::vector<Value>& GetMutableData();
+	void Share() const;
 };
 
 Array::Iterator begin(const Array::Ptr& x);
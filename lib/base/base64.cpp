@@ -18,53 +18,258 @@
  ******************************************************************************/
 
 #include "base/base64.hpp"
-#include <openssl/bio.h>
-#include <openssl/evp.h>
-#include <openssl/buffer.h>
-#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	include <tmmintrin.h>
+#	define BASE64_SSSE3 __attribute__((target("ssse3")))
+#endif /* defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) */
 
 using namespace icinga;
 
+/*
+ * The codec works on the contiguous input buffer and writes straight into
+ * the result. On x86 CPUs with SSSE3 blocks of 12 input bytes (encoding) or
+ * 16 characters (decoding) are translated with the pshufb-based algorithms
+ * by Wojciech Muła and Daniel Lemire; the rest of the input is handled by
+ * the table-driven scalar code.
+ */
+
+static const char l_EncodeTable[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+namespace {
+
+struct Base64DecodeTable
+{
+	int8_t Values[256];
+
+	Base64DecodeTable()
+	{
+		memset(Values, -1, sizeof(Values));
+
+		for (int i = 0; i < 64; i++)
+			Values[static_cast<unsigned char>(l_EncodeTable[i])] = i;
+	}
+};
+
+}
+
+static const Base64DecodeTable l_DecodeTable;
+
+#ifdef BASE64_SSSE3
+static bool HasSSSE3()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3");
+}
+
+static const bool l_HasSSSE3 = HasSSSE3();
+
+BASE64_SSSE3 static inline void EncodeBlock(const unsigned char *in, char *out)
+{
+	__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+
+	/* Spread the 12 input bytes over four 32-bit lanes: b1 b0 b2 b1. */
+	data = _mm_shuffle_epi8(data, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+	/* Move each of the 6-bit groups into its own byte. */
+	__m128i t0 = _mm_mulhi_epu16(_mm_and_si128(data, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+	__m128i t1 = _mm_mullo_epi16(_mm_and_si128(data, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+	__m128i indices = _mm_or_si128(t0, t1);
+
+	/* Map the indices to the offset of their range in the alphabet. */
+	__m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+
+	const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	__m128i result = _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(out), result);
+}
+
+BASE64_SSSE3 static inline bool DecodeBlock(const unsigned char *in, char *out)
+{
+	__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+
+	const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+
+	__m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(data, 4), nibbleMask);
+	__m128i loNibbles = _mm_and_si128(data, nibbleMask);
+
+	/* Characters outside of the alphabet (including '=') have a common bit in both lookups. */
+	__m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lutLo, loNibbles), _mm_shuffle_epi8(lutHi, hiNibbles));
+
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xffff)
+		return false;
+
+	__m128i isSlash = _mm_cmpeq_epi8(data, _mm_set1_epi8('/'));
+	data = _mm_add_epi8(data, _mm_shuffle_epi8(lutRoll, _mm_add_epi8(isSlash, hiNibbles)));
+
+	/* Pack the 6-bit values into 24-bit groups and restore the byte order. */
+	data = _mm_maddubs_epi16(data, _mm_set1_epi32(0x01400140));
+	data = _mm_madd_epi16(data, _mm_set1_epi32(0x00011000));
+	data = _mm_shuffle_epi8(data, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+	char buffer[16];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(buffer), data);
+	memcpy(out, buffer, 12);
+
+	return true;
+}
+
+BASE64_SSSE3 static size_t EncodeBlocks(const unsigned char *in, size_t length, char *out)
+{
+	size_t i = 0;
+
+	/* Each block reads 16 bytes but only consumes 12 of them. */
+	for (; i + 16 <= length; i += 12, out += 16)
+		EncodeBlock(in + i, out);
+
+	return i;
+}
+
+/* Stops at the first block that needs a closer look, the scalar code reports the error. */
+BASE64_SSSE3 static size_t DecodeBlocks(const unsigned char *in, size_t length, char *out)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= length; i += 16, out += 12) {
+		if (!DecodeBlock(in + i, out))
+			break;
+	}
+
+	return i;
+}
+#endif /* BASE64_SSSE3 */
+
 String Base64::Encode(const String& input)
 {
-	BIO *biomem = BIO_new(BIO_s_mem());
-	BIO *bio64 = BIO_new(BIO_f_base64());
-	BIO_push(bio64, biomem);
-	BIO_set_flags(bio64, BIO_FLAGS_BASE64_NO_NL);
-	BIO_write(bio64, input.CStr(), input.GetLength());
-	(void) BIO_flush(bio64);
+	return Encode(input.CStr(), input.GetLength());
+}
+
+/**
+ * Encodes a buffer. The result doesn't contain any line breaks.
+ *
+ * @param data The data.
+ * @param length The length of the data.
+ * @returns The base64-encoded data.
+ */
+String Base64::Encode(const char *data, size_t length)
+{
+	auto *in = reinterpret_cast<const unsigned char *>(data);
+	std::string result((length + 2) / 3 * 4, '\0');
+	char *out = &result[0];
+
+	size_t i = 0;
+
+#ifdef BASE64_SSSE3
+	if (l_HasSSSE3) {
+		i = EncodeBlocks(in, length, out);
+		out += i / 3 * 4;
+	}
+#endif /* BASE64_SSSE3 */
+
+	for (; i + 3 <= length; i += 3, out += 4) {
+		uint32_t triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+
+		out[0] = l_EncodeTable[(triple >> 18) & 0x3f];
+		out[1] = l_EncodeTable[(triple >> 12) & 0x3f];
+		out[2] = l_EncodeTable[(triple >> 6) & 0x3f];
+		out[3] = l_EncodeTable[triple & 0x3f];
+	}
 
-	char *outbuf;
-	long len = BIO_get_mem_data(biomem, &outbuf);
+	if (i < length) {
+		uint32_t triple = in[i] << 16;
 
-	String ret = String(outbuf, outbuf + len);
-	BIO_free_all(bio64);
+		if (i + 1 < length)
+			triple |= in[i + 1] << 8;
 
-	return ret;
+		out[0] = l_EncodeTable[(triple >> 18) & 0x3f];
+		out[1] = l_EncodeTable[(triple >> 12) & 0x3f];
+		out[2] = (i + 1 < length) ? l_EncodeTable[(triple >> 6) & 0x3f] : '=';
+		out[3] = '=';
+	}
+
+	return String(std::move(result));
 }
 
 String Base64::Decode(const String& input)
 {
-	BIO *biomem = BIO_new_mem_buf(
-		const_cast<char*>(input.CStr()), input.GetLength());
-	BIO *bio64 = BIO_new(BIO_f_base64());
-	BIO_push(bio64, biomem);
-	BIO_set_flags(bio64, BIO_FLAGS_BASE64_NO_NL);
-
-	auto *outbuf = new char[input.GetLength()];
+	return Decode(input.CStr(), input.GetLength());
+}
 
-	size_t len = 0;
-	int rc;
+/**
+ * Decodes a base64 string. The padding may be omitted; line breaks and
+ * other characters which aren't part of the alphabet are rejected.
+ *
+ * @param data The base64-encoded data.
+ * @param length The length of the base64-encoded data.
+ * @returns The decoded data.
+ * @exception invalid_argument The data isn't a valid base64 string.
+ */
+String Base64::Decode(const char *data, size_t length)
+{
+	auto *in = reinterpret_cast<const unsigned char *>(data);
 
-	while ((rc = BIO_read(bio64, outbuf + len, input.GetLength() - len)) > 0)
-		len += rc;
+	if (length % 4 == 0 && length > 0 && in[length - 1] == '=') {
+		length--;
 
-	String ret = String(outbuf, outbuf + len);
-	BIO_free_all(bio64);
-	delete [] outbuf;
+		if (in[length - 1] == '=')
+			length--;
+	}
 
-	if (ret.IsEmpty() && !input.IsEmpty())
+	if (length % 4 == 1)
 		throw std::invalid_argument("Not a valid base64 string");
 
-	return ret;
+	std::string result(length / 4 * 3 + (length % 4 ? length % 4 - 1 : 0), '\0');
+	char *out = &result[0];
+
+	size_t i = 0;
+
+#ifdef BASE64_SSSE3
+	if (l_HasSSSE3) {
+		i = DecodeBlocks(in, length, out);
+		out += i / 4 * 3;
+	}
+#endif /* BASE64_SSSE3 */
+
+	const int8_t *table = l_DecodeTable.Values;
+
+	for (; i + 4 <= length; i += 4, out += 3) {
+		int a = table[in[i]], b = table[in[i + 1]], c = table[in[i + 2]], d = table[in[i + 3]];
+
+		if ((a | b | c | d) < 0)
+			throw std::invalid_argument("Not a valid base64 string");
+
+		uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+
+		out[0] = triple >> 16;
+		out[1] = triple >> 8;
+		out[2] = triple;
+	}
+
+	if (i < length) {
+		int a = table[in[i]], b = table[in[i + 1]], c = (i + 2 < length) ? table[in[i + 2]] : 0;
+
+		if ((a | b | c) < 0)
+			throw std::invalid_argument("Not a valid base64 string");
+
+		uint32_t triple = (a << 18) | (b << 12) | (c << 6);
+
+		out[0] = triple >> 16;
+
+		if (i + 2 < length)
+			out[1] = triple >> 8;
+	}
+
+	return String(std::move(result));
 }
@@ -34,7 +34,9 @@ namespace icinga
 struct Base64
 {
 	static String Decode(const String& data);
+	static String Decode(const char *data, size_t length);
 	static String Encode(const String& data);
+	static String Encode(const char *data, size_t length);
 };
 
 }
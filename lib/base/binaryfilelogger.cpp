@@ -0,0 +1,272 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/binaryfilelogger.hpp"
+#include "base/binaryfilelogger-ti.cpp"
+#include "base/configtype.hpp"
+#include "base/convert.hpp"
+#include "base/statsfunction.hpp"
+#include "base/application.hpp"
+#include "base/objectlock.hpp"
+#include <cmath>
+#include <cstring>
+
+using namespace icinga;
+
+REGISTER_TYPE(BinaryFileLogger);
+
+REGISTER_STATSFUNCTION(BinaryFileLogger, &BinaryFileLogger::StatsFunc);
+
+static const char l_BinaryLogMagic[] = { 'I', '2', 'B', 'L' };
+static const unsigned char l_BinaryLogVersion = 1;
+
+enum BinaryLogRecordType
+{
+	BinaryLogHeader = 0,
+	BinaryLogFacility = 1,
+	BinaryLogEntry = 2
+};
+
+static void WriteInteger(std::ostream& stream, uint64_t value, size_t length)
+{
+	char buffer[8];
+
+	for (size_t i = 0; i < length; i++) {
+		buffer[i] = static_cast<char>(value & 0xff);
+		value >>= 8;
+	}
+
+	stream.write(buffer, length);
+}
+
+static bool ReadInteger(std::istream& stream, uint64_t& value, size_t length)
+{
+	unsigned char buffer[8];
+
+	if (!stream.read(reinterpret_cast<char *>(buffer), length))
+		return false;
+
+	value = 0;
+
+	for (size_t i = length; i > 0; i--)
+		value = (value << 8) | buffer[i - 1];
+
+	return true;
+}
+
+static bool ReadData(std::istream& stream, String& value, size_t length)
+{
+	std::string buffer(length, '\0');
+
+	if (length > 0 && !stream.read(&buffer[0], length))
+		return false;
+
+	value = std::move(buffer);
+	return true;
+}
+
+void BinaryFileLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+{
+	DictionaryData nodes;
+
+	for (const BinaryFileLogger::Ptr& binaryfilelogger : ConfigType::GetObjectsByType<BinaryFileLogger>()) {
+		nodes.emplace_back(binaryfilelogger->GetName(), 1); //add more stats
+	}
+
+	status->Set("binaryfilelogger", new Dictionary(std::move(nodes)));
+}
+
+void BinaryFileLogger::Start(bool runtimeCreated)
+{
+	ReopenLogFile();
+
+	Application::OnReopenLogs.connect(std::bind(&BinaryFileLogger::ReopenLogFile, this));
+
+	m_FlushLogTimer = new Timer("BinaryFileLogger flush");
+	m_FlushLogTimer->SetInterval(1);
+	m_FlushLogTimer->OnTimerExpired.connect(std::bind(&BinaryFileLogger::Flush, this));
+	m_FlushLogTimer->Start();
+
+	ObjectImpl<BinaryFileLogger>::Start(runtimeCreated);
+
+	Log(LogInformation, "BinaryFileLogger")
+		<< "'" << GetName() << "' started.";
+}
+
+void BinaryFileLogger::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<BinaryFileLogger>::Stop(runtimeRemoved);
+
+	if (m_FlushLogTimer)
+		m_FlushLogTimer->Stop();
+
+	ObjectLock olock(this);
+	m_Stream.flush();
+}
+
+void BinaryFileLogger::ReopenLogFile()
+{
+	ObjectLock olock(this);
+
+	String path = GetPath();
+
+	if (m_Stream.is_open())
+		m_Stream.close();
+
+	m_Stream.clear();
+	m_Stream.open(path.CStr(), std::ofstream::binary | std::ofstream::app | std::ofstream::out);
+
+	if (!m_Stream.good())
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open logfile '" + path + "'"));
+
+	/* Another process might have written to the file, start with a new facility table. */
+	WriteHeader(m_Stream, m_Facilities);
+}
+
+/**
+ * Writes a header record and resets the facility table.
+ *
+ * @param stream The output stream.
+ * @param facilities The facility ids which were written to the stream so far.
+ */
+void BinaryFileLogger::WriteHeader(std::ostream& stream, std::map<String, unsigned short>& facilities)
+{
+	facilities.clear();
+
+	WriteInteger(stream, BinaryLogHeader, 1);
+	stream.write(l_BinaryLogMagic, sizeof(l_BinaryLogMagic));
+	WriteInteger(stream, l_BinaryLogVersion, 1);
+}
+
+/**
+ * Writes a log entry record. The facility is written as a separate record
+ * the first time it is used.
+ *
+ * @param stream The output stream.
+ * @param facilities The facility ids which were written to the stream so far.
+ * @param entry The log entry.
+ */
+void BinaryFileLogger::WriteLogEntry(std::ostream& stream, std::map<String, unsigned short>& facilities, const LogEntry& entry)
+{
+	auto it = facilities.find(entry.Facility);
+
+	if (it == facilities.end()) {
+		if (facilities.size() >= 0xffff)
+			WriteHeader(stream, facilities);
+
+		unsigned short id = facilities.size();
+		size_t length = std::min<size_t>(entry.Facility.GetLength(), 0xffff);
+
+		WriteInteger(stream, BinaryLogFacility, 1);
+		WriteInteger(stream, id, 2);
+		WriteInteger(stream, length, 2);
+		stream.write(entry.Facility.CStr(), length);
+
+		it = facilities.insert(std::make_pair(entry.Facility, id)).first;
+	}
+
+	size_t length = std::min<size_t>(entry.Message.GetLength(), 0xffffffff);
+
+	WriteInteger(stream, BinaryLogEntry, 1);
+	WriteInteger(stream, static_cast<uint64_t>(std::llround(entry.Timestamp * 1000000)), 8);
+	WriteInteger(stream, entry.Severity, 1);
+	WriteInteger(stream, it->second, 2);
+	WriteInteger(stream, length, 4);
+	stream.write(entry.Message.CStr(), length);
+}
+
+/**
+ * Reads the next log entry from a binary log file. A truncated record at
+ * the end of the file (e.g. because the process crashed while writing it)
+ * is ignored.
+ *
+ * @param stream The input stream.
+ * @param facilities The facility names which were read from the stream so far.
+ * @param entry The log entry.
+ * @returns true if a log entry was read, false at the end of the file.
+ */
+bool BinaryFileLogger::ReadLogEntry(std::istream& stream, std::vector<String>& facilities, LogEntry& entry)
+{
+	for (;;) {
+		uint64_t type;
+
+		if (!ReadInteger(stream, type, 1))
+			return false;
+
+		if (type == BinaryLogHeader) {
+			char magic[sizeof(l_BinaryLogMagic)];
+			uint64_t version;
+
+			if (!stream.read(magic, sizeof(magic)) || !ReadInteger(stream, version, 1))
+				return false;
+
+			if (memcmp(magic, l_BinaryLogMagic, sizeof(magic)) != 0)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid binary log header."));
+
+			if (version != l_BinaryLogVersion)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported binary log version: " + Convert::ToString(version)));
+
+			facilities.clear();
+		} else if (type == BinaryLogFacility) {
+			uint64_t id, length;
+			String name;
+
+			if (!ReadInteger(stream, id, 2) || !ReadInteger(stream, length, 2) || !ReadData(stream, name, length))
+				return false;
+
+			if (id >= facilities.size())
+				facilities.resize(id + 1);
+
+			facilities[id] = std::move(name);
+		} else if (type == BinaryLogEntry) {
+			uint64_t timestamp, severity, facility, length;
+
+			if (!ReadInteger(stream, timestamp, 8) || !ReadInteger(stream, severity, 1) ||
+				!ReadInteger(stream, facility, 2) || !ReadInteger(stream, length, 4) ||
+				!ReadData(stream, entry.Message, length))
+				return false;
+
+			if (severity > LogCritical || facility >= facilities.size())
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid binary log entry."));
+
+			entry.Timestamp = timestamp / 1000000.0;
+			entry.Severity = static_cast<LogSeverity>(severity);
+			entry.Facility = facilities[facility];
+
+			return true;
+		} else
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid binary log record type: " + Convert::ToString(type)));
+	}
+}
+
+void BinaryFileLogger::ProcessLogEntry(const LogEntry& entry)
+{
+	if (!m_Stream.good())
+		return;
+
+	WriteLogEntry(m_Stream, m_Facilities, entry);
+}
+
+void BinaryFileLogger::Flush()
+{
+	ObjectLock olock(this);
+
+	if (m_Stream.good())
+		m_Stream.flush();
+}
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef BINARYFILELOGGER_H
+#define BINARYFILELOGGER_H
+
+#include "base/i2-base.hpp"
+#include "base/binaryfilelogger-ti.hpp"
+#include "base/timer.hpp"
+#include <fstream>
+#include <map>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A logger that writes log entries to a file in a compact binary format.
+ * Unlike FileLogger it doesn't format timestamps or severities and it
+ * writes each facility name only once. Use "icinga2 log decode" to
+ * convert the file to text.
+ *
+ * The file is a sequence of records which start with a type byte. All
+ * integers are little-endian.
+ *
+ *  - 0 (header): "I2BL", version (u8). Resets the facility table.
+ *  - 1 (facility): id (u16), length (u16), name
+ *  - 2 (entry): timestamp in microseconds (u64), severity (u8),
+ *    facility id (u16), length (u32), message
+ *
+ * @ingroup base
+ */
+class BinaryFileLogger final : public ObjectImpl<BinaryFileLogger>
+{
+public:
+	DECLARE_OBJECT(BinaryFileLogger);
+	DECLARE_OBJECTNAME(BinaryFileLogger);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+
+	static void WriteHeader(std::ostream& stream, std::map<String, unsigned short>& facilities);
+	static void WriteLogEntry(std::ostream& stream, std::map<String, unsigned short>& facilities, const LogEntry& entry);
+	static bool ReadLogEntry(std::istream& stream, std::vector<String>& facilities, LogEntry& entry);
+
+protected:
+	void ProcessLogEntry(const LogEntry& entry) override;
+	void Flush() override;
+
+private:
+	std::ofstream m_Stream;
+	std::map<String, unsigned short> m_Facilities;
+	Timer::Ptr m_FlushLogTimer;
+
+	void ReopenLogFile();
+};
+
+}
+
+#endif /* BINARYFILELOGGER_H */
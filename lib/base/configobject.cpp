@@ -21,8 +21,7 @@
 #include "base/configobject-ti.cpp"
 #include "base/configtype.hpp"
 #include "base/serializer.hpp"
-#include "base/netstring.hpp"
-#include "base/json.hpp"
+#include "base/statefile.hpp"
 #include "base/stdiostream.hpp"
 #include "base/debug.hpp"
 #include "base/objectlock.hpp"
@@ -34,6 +33,10 @@
 #include "base/context.hpp"
 #include "base/application.hpp"
 #include <fstream>
+#include <algorithm>
+#ifndef _WIN32
+#	include <unistd.h>
+#endif /* _WIN32 */
 #include <boost/exception/errinfo_api_function.hpp>
 #include <boost/exception/errinfo_errno.hpp>
 #include <boost/exception/errinfo_file_name.hpp>
@@ -44,6 +47,8 @@ REGISTER_TYPE_WITH_PROTOTYPE(ConfigObject, ConfigObject::GetPrototype());
 
 boost::signals2::signal<void (const ConfigObject::Ptr&)> ConfigObject::OnStateChanged;
 
+static std::atomic<uint_fast64_t> l_NextChangeSequence(0);
+
 bool ConfigObject::IsActive() const
 {
 	return GetActive();
@@ -341,6 +346,34 @@ bool ConfigObject::IsAttributeModified(const String& attr) const
 	return original_attributes->Contains(attr);
 }
 
+/**
+ * Records that one of the object's attributes has changed. This is done
+ * by the attributes' Notify*() functions, i.e. for all changes which
+ * don't suppress events.
+ */
+void ConfigObject::MarkChanged()
+{
+	m_ChangeSequence = ++l_NextChangeSequence;
+	m_LastChange = Utility::GetTime();
+}
+
+/**
+ * Returns a number which increases whenever one of the object's attributes
+ * changes. The numbers are unique across all objects of the process.
+ */
+uint_fast64_t ConfigObject::GetChangeSequence() const
+{
+	return m_ChangeSequence;
+}
+
+/**
+ * Returns the time at which one of the object's attributes last changed.
+ */
+double ConfigObject::GetLastChange() const
+{
+	return m_LastChange;
+}
+
 void ConfigObject::Register()
 {
 	ASSERT(!OwnsLock());
@@ -389,6 +422,8 @@ void ConfigObject::Activate(bool runtimeCreated)
 			SetAuthority(true);
 	}
 
+	MarkChanged();
+
 	NotifyActive();
 }
 
@@ -480,13 +515,48 @@ void ConfigObject::SetAuthority(bool authority)
 	}
 }
 
-void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
+static void DumpObject(const StdioStream::Ptr& sfp, const Type::Ptr& type, const ConfigObject::Ptr& object, int attributeTypes)
+{
+	Dictionary::Ptr update = Serialize(object, attributeTypes);
+
+	if (!update)
+		return;
+
+	Dictionary::Ptr persistentObject = new Dictionary({
+		{ "type", type->GetName() },
+		{ "name", object->GetName() },
+		{ "update", update }
+	});
+
+	StateFile::WriteRecord(sfp, persistentObject);
+}
+
+/**
+ * Returns the name of the journal which belongs to the specified state file.
+ */
+static String GetJournalFilename(const String& filename)
+{
+	return filename + ".journal";
+}
+
+/**
+ * Writes a snapshot of all objects' state to the state file. This
+ * compacts the state file's journal, i.e. the journal is removed.
+ *
+ * @param filename The state file.
+ * @param attributeTypes The attributes which are written.
+ * @returns The change sequence (see ConfigObject::GetChangeSequence()) the
+ *          snapshot covers. Pass this to the next JournalObjects() call.
+ */
+uint_fast64_t ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 {
 	Log(LogInformation, "ConfigObject")
 		<< "Dumping program state to file '" << filename << "'";
 
+	uint_fast64_t sequence = l_NextChangeSequence;
+
 	std::fstream fp;
-	String tempFilename = Utility::CreateTempFile(filename + ".XXXXXX", 0600, fp);
+	String tempFilename = Utility::CreateTempFile(filename + ".XXXXXX", 0600, fp, true);
 	fp.exceptions(std::ofstream::failbit | std::ofstream::badbit);
 
 	if (!fp)
@@ -494,34 +564,33 @@ void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 
 	StdioStream::Ptr sfp = new StdioStream(&fp, false);
 
+	StateFile::WriteHeader(sfp);
+
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
 
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
-			Dictionary::Ptr update = Serialize(object, attributeTypes);
-
-			if (!update)
-				continue;
-
-			Dictionary::Ptr persistentObject = new Dictionary({
-				{ "type", type->GetName() },
-				{ "name", object->GetName() },
-				{ "update", update }
-			});
-
-			String json = JsonEncode(persistentObject);
-
-			NetString::WriteStringToStream(sfp, json);
-		}
+		for (const ConfigObject::Ptr& object : dtype->GetObjects())
+			DumpObject(sfp, type, object, attributeTypes);
 	}
 
 	sfp->Close();
 
 	fp.close();
 
+	/* Remove the journal before replacing the snapshot: Replaying an old
+	 * journal on top of the new snapshot would restore outdated state. */
+	String journalFilename = GetJournalFilename(filename);
+
+	if (Utility::PathExists(journalFilename) && unlink(journalFilename.CStr()) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("unlink")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(journalFilename));
+	}
+
 #ifdef _WIN32
 	_unlink(filename.CStr());
 #endif /* _WIN32 */
@@ -532,15 +601,82 @@ void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 			<< boost::errinfo_errno(errno)
 			<< boost::errinfo_file_name(tempFilename));
 	}
+
+	return sequence;
+}
+
+/**
+ * Appends the state of all objects which have changed since the specified
+ * change sequence to the state file's journal.
+ *
+ * @param filename The state file.
+ * @param sequence The change sequence returned by the previous DumpObjects()
+ *                 or JournalObjects() call.
+ * @param attributeTypes The attributes which are written.
+ * @returns The change sequence the journal covers now.
+ */
+uint_fast64_t ConfigObject::JournalObjects(const String& filename, uint_fast64_t sequence, int attributeTypes)
+{
+	String journalFilename = GetJournalFilename(filename);
+
+	uint_fast64_t newSequence = l_NextChangeSequence;
+
+	if (newSequence == sequence)
+		return sequence;
+
+	std::fstream fp;
+	fp.open(journalFilename.CStr(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+	fp.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + journalFilename + "' file"));
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+	/* Journals which were started by older versions don't get a header,
+	 * the reader detects the format of each record. */
+	fp.seekp(0, std::ios_base::end);
+
+	if (fp.tellp() == 0)
+		StateFile::WriteHeader(sfp);
+
+	unsigned long journaled = 0;
+
+	for (const Type::Ptr& type : Type::GetAllTypes()) {
+		auto *dtype = dynamic_cast<ConfigType *>(type.get());
+
+		if (!dtype)
+			continue;
+
+		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+			if (object->GetChangeSequence() <= sequence)
+				continue;
+
+			DumpObject(sfp, type, object, attributeTypes);
+			journaled++;
+		}
+	}
+
+	sfp->Close();
+
+	fp.close();
+
+	Log(LogNotice, "ConfigObject")
+		<< "Appended state of " << journaled << " changed objects to file '" << journalFilename << "'";
+
+	return newSequence;
 }
 
-void ConfigObject::RestoreObject(const String& message, int attributeTypes)
+void ConfigObject::RestoreObject(const String& message, int attributeTypes, const std::map<std::pair<String, String>, String>& superseded)
 {
-	Dictionary::Ptr persistentObject = JsonDecode(message);
+	Dictionary::Ptr persistentObject = StateFile::DecodeRecord(message);
 
 	String type = persistentObject->Get("type");
 	String name = persistentObject->Get("name");
 
+	if (superseded.find(std::make_pair(type, name)) != superseded.end())
+		return;
+
 	ConfigObject::Ptr object = GetObject(type, name);
 
 	if (!object)
@@ -558,38 +694,56 @@ void ConfigObject::RestoreObject(const String& message, int attributeTypes)
 
 void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 {
-	if (!Utility::PathExists(filename))
+	String journalFilename = GetJournalFilename(filename);
+
+	if (!Utility::PathExists(filename) && !Utility::PathExists(journalFilename))
 		return;
 
 	Log(LogInformation, "ConfigObject")
 		<< "Restoring program state from file '" << filename << "'";
 
-	std::fstream fp;
-	fp.open(filename.CStr(), std::ios_base::in);
+	double startTime = Utility::GetTime();
+
+	/* Journal entries contain the complete state of an object. Only the
+	 * most recent one is restored and the snapshot's entry is skipped. */
+	std::map<std::pair<String, String>, String> journal;
 
-	StdioStream::Ptr sfp = new StdioStream (&fp, false);
+	if (Utility::PathExists(journalFilename)) {
+		StateFileView view(journalFilename);
+
+		for (const auto& record : view.GetRecords()) {
+			String message(record.first, record.first + record.second);
+			Dictionary::Ptr persistentObject = StateFile::DecodeRecord(message);
+			journal[std::make_pair(persistentObject->Get("type"), persistentObject->Get("name"))] = message;
+		}
+	}
 
 	unsigned long restored = 0;
 
 	WorkQueue upq(25000, Application::GetConcurrency());
 	upq.SetName("ConfigObject::RestoreObjects");
 
-	String message;
-	StreamReadContext src;
-	for (;;) {
-		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+	/* The snapshot contains each object at most once and objects with journal
+	 * entries are skipped, so the records can be restored in any order. */
+	if (Utility::PathExists(filename)) {
+		StateFileView view(filename);
+		std::vector<std::pair<const char *, size_t> > records = view.GetRecords();
 
-		if (srs == StatusEof)
-			break;
+		upq.ParallelFor(records, [attributeTypes, &journal](const std::pair<const char *, size_t>& record) {
+			RestoreObject(String(record.first, record.first + record.second), attributeTypes, journal);
+		});
 
-		if (srs != StatusNewItem)
-			continue;
+		upq.Join();
 
-		upq.Enqueue(std::bind(&ConfigObject::RestoreObject, message, attributeTypes));
-		restored++;
+		restored += records.size();
 	}
 
-	sfp->Close();
+	std::map<std::pair<String, String>, String> none;
+
+	for (const auto& kv : journal) {
+		upq.Enqueue(std::bind(&ConfigObject::RestoreObject, kv.second, attributeTypes, std::cref(none)));
+		restored++;
+	}
 
 	upq.Join();
 
@@ -612,21 +766,92 @@ void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 	}
 
 	Log(LogInformation, "ConfigObject")
-		<< "Restored " << restored << " objects. Loaded " << no_state << " new objects without state.";
+		<< "Restored " << restored << " objects in " << Utility::GetTime() - startTime << " seconds. Loaded "
+		<< no_state << " new objects without state.";
 }
 
-void ConfigObject::StopObjects()
+/**
+ * Deactivates all objects. Types are stopped in the reverse order of their
+ * activation priority. The objects of all types which share a priority are
+ * deactivated in parallel.
+ *
+ * @param concurrentTask A task which is run while the objects are being
+ *                       deactivated, once the types with a positive
+ *                       activation priority (the features and listeners
+ *                       which generate state changes) have been stopped.
+ * @param timeout The time budget in seconds. Objects which haven't been
+ *                deactivated when it runs out are left as they are.
+ */
+void ConfigObject::StopObjects(const std::function<void ()>& concurrentTask, double timeout)
 {
+	double startTime = Utility::GetTime();
+
+	std::vector<Type::Ptr> types;
+
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
-		auto *dtype = dynamic_cast<ConfigType *>(type.get());
+		if (dynamic_cast<ConfigType *>(type.get()))
+			types.push_back(type);
+	}
 
-		if (!dtype)
-			continue;
+	std::stable_sort(types.begin(), types.end(), [](const Type::Ptr& a, const Type::Ptr& b) {
+		return a->GetActivationPriority() > b->GetActivationPriority();
+	});
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+	WorkQueue upq(25000, Application::GetConcurrency());
+	upq.SetName("ConfigObject::StopObjects");
+
+	WorkQueue taskq;
+	taskq.SetName("ConfigObject::StopObjects task");
+
+	bool taskStarted = false;
+	size_t stopped = 0;
+
+	for (auto it = types.begin(); it != types.end();) {
+		int priority = (*it)->GetActivationPriority();
+
+		if (!taskStarted && priority <= 0 && concurrentTask) {
+			taskq.Enqueue(std::function<void ()>(concurrentTask));
+			taskStarted = true;
+		}
+
+		std::vector<ConfigObject::Ptr> objects;
+
+		for (; it != types.end() && (*it)->GetActivationPriority() == priority; it++) {
+			auto *dtype = dynamic_cast<ConfigType *>(it->get());
+
+			for (const ConfigObject::Ptr& object : dtype->GetObjects())
+				objects.push_back(object);
+		}
+
+		upq.ParallelFor(objects, [](const ConfigObject::Ptr& object) {
 			object->Deactivate();
+		});
+
+		upq.Join();
+
+		stopped += objects.size();
+
+		if (timeout > 0 && Utility::GetTime() - startTime > timeout && it != types.end()) {
+			Log(LogWarning, "ConfigObject")
+				<< "Could not deactivate all objects within " << timeout << " seconds. Skipping the types with activation priority "
+				<< (*it)->GetActivationPriority() << " and lower.";
+			break;
 		}
 	}
+
+	if (upq.HasExceptions())
+		upq.ReportExceptions("ConfigObject");
+
+	if (!taskStarted && concurrentTask)
+		taskq.Enqueue(std::function<void ()>(concurrentTask));
+
+	taskq.Join();
+
+	if (taskq.HasExceptions())
+		taskq.ReportExceptions("ConfigObject");
+
+	Log(LogNotice, "ConfigObject")
+		<< "Deactivated " << stopped << " objects in " << Utility::GetTime() - startTime << " seconds.";
 }
 
 void ConfigObject::DumpModifiedAttributes(const std::function<void(const ConfigObject::Ptr&, const String&, const Value&)>& callback)
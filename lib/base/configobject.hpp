@@ -26,6 +26,8 @@
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
 #include <boost/signals2.hpp>
+#include <atomic>
+#include <map>
 
 namespace icinga
 {
@@ -57,6 +59,10 @@ public:
 	void RestoreAttribute(const String& attr, bool updateVersion = true);
 	bool IsAttributeModified(const String& attr) const;
 
+	void MarkChanged();
+	uint_fast64_t GetChangeSequence() const;
+	double GetLastChange() const;
+
 	void Register();
 	void Unregister();
 
@@ -88,9 +94,10 @@ public:
 
 	static ConfigObject::Ptr GetObject(const String& type, const String& name);
 
-	static void DumpObjects(const String& filename, int attributeTypes = FAState);
+	static uint_fast64_t DumpObjects(const String& filename, int attributeTypes = FAState);
+	static uint_fast64_t JournalObjects(const String& filename, uint_fast64_t sequence, int attributeTypes = FAState);
 	static void RestoreObjects(const String& filename, int attributeTypes = FAState);
-	static void StopObjects();
+	static void StopObjects(const std::function<void ()>& concurrentTask = std::function<void ()>(), double timeout = 0);
 
 	static void DumpModifiedAttributes(const std::function<void(const ConfigObject::Ptr&, const String&, const Value&)>& callback);
 
@@ -98,8 +105,10 @@ public:
 
 private:
 	ConfigObject::Ptr m_Zone;
+	std::atomic<uint_fast64_t> m_ChangeSequence{0};
+	std::atomic<double> m_LastChange{0};
 
-	static void RestoreObject(const String& message, int attributeTypes);
+	static void RestoreObject(const String& message, int attributeTypes, const std::map<std::pair<String, String>, String>& superseded);
 };
 
 #define DECLARE_OBJECTNAME(klass)						\
@@ -26,13 +26,22 @@ using namespace icinga;
 ConfigType::~ConfigType()
 { }
 
+ConfigType::ObjectMapShard& ConfigType::GetObjectMapShard(const String& name) const
+{
+	/* Don't use the low bits which the shard's table uses to pick a bucket. */
+	size_t hash = std::hash<String>()(name);
+	return m_ObjectMap[(hash >> 16) % ObjectMapShards];
+}
+
 ConfigObject::Ptr ConfigType::GetObject(const String& name) const
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	ObjectMapShard& shard = GetObjectMapShard(name);
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
 
-	auto nt = m_ObjectMap.find(name);
+	auto nt = shard.Objects.find(name);
 
-	if (nt == m_ObjectMap.end())
+	if (nt == shard.Objects.end())
 		return nullptr;
 
 	return nt->second;
@@ -45,9 +54,12 @@ void ConfigType::RegisterObject(const ConfigObject::Ptr& object)
 	{
 		boost::mutex::scoped_lock lock(m_Mutex);
 
-		auto it = m_ObjectMap.find(name);
+		ObjectMapShard& shard = GetObjectMapShard(name);
+		boost::mutex::scoped_lock shardLock(shard.Mutex);
+
+		auto it = shard.Objects.find(name);
 
-		if (it != m_ObjectMap.end()) {
+		if (it != shard.Objects.end()) {
 			if (it->second == object)
 				return;
 
@@ -58,8 +70,15 @@ void ConfigType::RegisterObject(const ConfigObject::Ptr& object)
 				object->GetDebugInfo()));
 		}
 
-		m_ObjectMap[name] = object;
+		/* Lookups with interned names only need to compare addresses. */
+		shard.Objects[String::Intern(name)] = object;
+		shardLock.unlock();
+
 		m_ObjectVector.push_back(object);
+		m_ObjectVersion++;
+
+		/* The list is rebuilt lazily by the next reader. */
+		std::atomic_store(&m_ObjectList, std::shared_ptr<const ConfigObjectList>());
 	}
 }
 
@@ -70,20 +89,55 @@ void ConfigType::UnregisterObject(const ConfigObject::Ptr& object)
 	{
 		boost::mutex::scoped_lock lock(m_Mutex);
 
-		m_ObjectMap.erase(name);
+		{
+			ObjectMapShard& shard = GetObjectMapShard(name);
+			boost::mutex::scoped_lock shardLock(shard.Mutex);
+			shard.Objects.erase(name);
+		}
+
 		m_ObjectVector.erase(std::remove(m_ObjectVector.begin(), m_ObjectVector.end(), object), m_ObjectVector.end());
+		m_ObjectVersion++;
+
+		std::atomic_store(&m_ObjectList, std::shared_ptr<const ConfigObjectList>());
 	}
 }
 
 std::vector<ConfigObject::Ptr> ConfigType::GetObjects() const
 {
+	return GetObjectList()->Objects;
+}
+
+/**
+ * Returns the current object list. Readers only take the lock when the
+ * list has changed since it was last published.
+ */
+std::shared_ptr<const ConfigObjectList> ConfigType::GetObjectList() const
+{
+	std::shared_ptr<const ConfigObjectList> list = std::atomic_load(&m_ObjectList);
+
+	if (list)
+		return list;
+
 	boost::mutex::scoped_lock lock(m_Mutex);
-	return m_ObjectVector;
+
+	list = std::atomic_load(&m_ObjectList);
+
+	if (list)
+		return list;
+
+	auto newList = std::make_shared<ConfigObjectList>();
+	newList->Version = m_ObjectVersion;
+	newList->Objects = m_ObjectVector;
+
+	list = newList;
+	std::atomic_store(&m_ObjectList, list);
+
+	return list;
 }
 
-std::vector<ConfigObject::Ptr> ConfigType::GetObjectsHelper(Type *type)
+std::shared_ptr<const ConfigObjectList> ConfigType::GetObjectListHelper(Type *type)
 {
-	return static_cast<TypeImpl<ConfigObject> *>(type)->GetObjects();
+	return static_cast<TypeImpl<ConfigObject> *>(type)->GetObjectList();
 }
 
 int ConfigType::GetObjectCount() const
@@ -25,12 +25,118 @@
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
 #include <boost/thread/mutex.hpp>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
 
 namespace icinga
 {
 
 class ConfigObject;
 
+/**
+ * An immutable, versioned list of the objects of a config type.
+ *
+ * @ingroup base
+ */
+struct ConfigObjectList
+{
+	typedef std::vector<intrusive_ptr<ConfigObject> > ObjectVector;
+
+	uint_fast64_t Version;
+	ObjectVector Objects;
+};
+
+/**
+ * A read-only view over the objects of a config type. The view holds on to
+ * the list it was created from, so objects registered or unregistered while
+ * iterating do not affect it. Iterators yield raw pointers; callers which
+ * need to keep an object beyond the iteration have to take a reference.
+ *
+ * @ingroup base
+ */
+template<typename T>
+class ConfigObjectRange
+{
+public:
+	class Iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T *value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef T * const *pointer;
+		typedef T *reference;
+
+		explicit Iterator(ConfigObjectList::ObjectVector::const_iterator it)
+			: m_It(it)
+		{ }
+
+		T *operator*() const
+		{
+			return static_cast<T *>(m_It->get());
+		}
+
+		Iterator& operator++()
+		{
+			++m_It;
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator result = *this;
+			++m_It;
+			return result;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return m_It == other.m_It;
+		}
+
+		bool operator!=(const Iterator& other) const
+		{
+			return m_It != other.m_It;
+		}
+
+	private:
+		ConfigObjectList::ObjectVector::const_iterator m_It;
+	};
+
+	explicit ConfigObjectRange(std::shared_ptr<const ConfigObjectList> list)
+		: m_List(std::move(list))
+	{ }
+
+	Iterator begin() const
+	{
+		return Iterator(m_List->Objects.begin());
+	}
+
+	Iterator end() const
+	{
+		return Iterator(m_List->Objects.end());
+	}
+
+	size_t size() const
+	{
+		return m_List->Objects.size();
+	}
+
+	bool empty() const
+	{
+		return m_List->Objects.empty();
+	}
+
+	uint_fast64_t GetVersion() const
+	{
+		return m_List->Version;
+	}
+
+private:
+	std::shared_ptr<const ConfigObjectList> m_List;
+};
+
 class ConfigType
 {
 public:
@@ -42,6 +148,7 @@ public:
 	void UnregisterObject(const intrusive_ptr<ConfigObject>& object);
 
 	std::vector<intrusive_ptr<ConfigObject> > GetObjects() const;
+	std::shared_ptr<const ConfigObjectList> GetObjectList() const;
 
 	template<typename T>
 	static TypeImpl<T> *Get()
@@ -53,26 +160,49 @@ public:
 	template<typename T>
 	static std::vector<intrusive_ptr<T> > GetObjectsByType()
 	{
-		std::vector<intrusive_ptr<ConfigObject> > objects = GetObjectsHelper(T::TypeInstance.get());
+		std::shared_ptr<const ConfigObjectList> list = GetObjectListHelper(T::TypeInstance.get());
 		std::vector<intrusive_ptr<T> > result;
-		result.reserve(objects.size());
-for (const auto& object : objects) {
+		result.reserve(list->Objects.size());
+		for (const auto& object : list->Objects) {
 			result.push_back(static_pointer_cast<T>(object));
 		}
 		return result;
 	}
 
+	/**
+	 * Returns a view over all objects of the specified type without copying
+	 * the object list or touching the objects' reference counts.
+	 */
+	template<typename T>
+	static ConfigObjectRange<T> GetObjectRange()
+	{
+		return ConfigObjectRange<T>(GetObjectListHelper(T::TypeInstance.get()));
+	}
+
 	int GetObjectCount() const;
 
 private:
-	typedef std::map<String, intrusive_ptr<ConfigObject> > ObjectMap;
+	typedef std::unordered_map<String, intrusive_ptr<ConfigObject> > ObjectMap;
 	typedef std::vector<intrusive_ptr<ConfigObject> > ObjectVector;
 
+	/* Name lookups only lock the shard the name hashes to. */
+	struct ObjectMapShard
+	{
+		boost::mutex Mutex;
+		ObjectMap Objects;
+	};
+
+	static const size_t ObjectMapShards = 16;
+
 	mutable boost::mutex m_Mutex;
-	ObjectMap m_ObjectMap;
+	mutable ObjectMapShard m_ObjectMap[ObjectMapShards];
 	ObjectVector m_ObjectVector;
+	uint_fast64_t m_ObjectVersion{0};
+	mutable std::shared_ptr<const ConfigObjectList> m_ObjectList;
+
+	ObjectMapShard& GetObjectMapShard(const String& name) const;
 
-	static std::vector<intrusive_ptr<ConfigObject> > GetObjectsHelper(Type *type);
+	static std::shared_ptr<const ConfigObjectList> GetObjectListHelper(Type *type);
 };
 
 }
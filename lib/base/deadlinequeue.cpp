@@ -0,0 +1,145 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/deadlinequeue.hpp"
+#include "base/utility.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include <algorithm>
+#include <vector>
+
+using namespace icinga;
+
+/**
+ * Constructor for the DeadlineQueue class.
+ *
+ * @param callback The function which is called for objects whose deadline has passed.
+ * @param maxInterval The maximum time between two runs of the timer.
+ */
+DeadlineQueue::DeadlineQueue(const Callback& callback, double maxInterval)
+	: m_Callback(callback), m_MaxInterval(maxInterval), m_Timer(new Timer("DeadlineQueue"))
+{
+	m_Timer->SetInterval(maxInterval);
+	m_Timer->OnTimerExpired.connect(std::bind(&DeadlineQueue::TimerHandler, this));
+}
+
+void DeadlineQueue::Start()
+{
+	m_Timer->Start();
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	RescheduleTimer();
+}
+
+void DeadlineQueue::Stop()
+{
+	m_Timer->Stop(true);
+}
+
+/**
+ * Sets or updates the deadline for an object.
+ *
+ * @threadsafety Always.
+ */
+void DeadlineQueue::Set(const Object::Ptr& object, double deadline)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	auto& idx = boost::get<1>(m_Entries);
+	double head = idx.empty() ? -1 : idx.begin()->Deadline;
+
+	m_Entries.erase(object);
+	m_Entries.insert({ object, deadline });
+
+	/* Only touch the timer if the earliest deadline has changed. */
+	if (idx.begin()->Deadline != head)
+		RescheduleTimer();
+}
+
+/**
+ * Removes an object from the queue.
+ *
+ * @threadsafety Always.
+ */
+void DeadlineQueue::Remove(const Object::Ptr& object)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	/* The timer isn't rescheduled here, it will simply find nothing to do. */
+	m_Entries.erase(object);
+}
+
+size_t DeadlineQueue::GetLength() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_Entries.size();
+}
+
+void DeadlineQueue::TimerHandler()
+{
+	std::vector<Object::Ptr> objects;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		auto& idx = boost::get<1>(m_Entries);
+		double now = Utility::GetTime();
+
+		/* Deadlines are exclusive: an object is due once its deadline lies in the past. */
+		while (!idx.empty() && idx.begin()->Deadline < now) {
+			objects.push_back(idx.begin()->Item);
+			idx.erase(idx.begin());
+		}
+	}
+
+	for (const Object::Ptr& object : objects) {
+		try {
+			m_Callback(object);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "DeadlineQueue")
+				<< "Exception occurred while processing deadline: " << DiagnosticInformation(ex);
+		}
+	}
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	RescheduleTimer();
+}
+
+/**
+ * Schedules the timer for the earliest deadline. The interval is updated as
+ * well because a running timer ignores Reschedule() and uses its interval
+ * once the callback has returned.
+ *
+ * @threadsafety Caller must hold m_Mutex.
+ */
+void DeadlineQueue::RescheduleTimer()
+{
+	auto& idx = boost::get<1>(m_Entries);
+
+	if (idx.empty()) {
+		m_Timer->SetInterval(m_MaxInterval);
+		return;
+	}
+
+	double now = Utility::GetTime();
+	double wait = std::min(std::max(idx.begin()->Deadline - now, 0.01), m_MaxInterval);
+
+	m_Timer->SetInterval(wait);
+	m_Timer->Reschedule(now + wait);
+}
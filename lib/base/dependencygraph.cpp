@@ -21,20 +21,37 @@
 
 using namespace icinga;
 
-boost::mutex DependencyGraph::m_Mutex;
-std::map<Object *, std::map<Object *, int> > DependencyGraph::m_Dependencies;
+#define DEPENDENCYGRAPH_SHARDS 32
+
+DependencyGraph::Shard& DependencyGraph::GetShard(Object *child)
+{
+	/* Intentionally leaked so that objects destroyed by static destructors can still unlink themselves. */
+	static auto *shards = new Shard[DEPENDENCYGRAPH_SHARDS];
+
+	/* Skip the low bits which are the same for all allocations. */
+	return shards[(reinterpret_cast<uintptr_t>(child) >> 4) % DEPENDENCYGRAPH_SHARDS];
+}
 
 void DependencyGraph::AddDependency(Object *parent, Object *child)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
-	m_Dependencies[child][parent]++;
+	Shard& shard = GetShard(child);
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
+	shard.Dependencies[child][parent]++;
 }
 
 void DependencyGraph::RemoveDependency(Object *parent, Object *child)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	Shard& shard = GetShard(child);
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
 
-	auto& refs = m_Dependencies[child];
+	auto dt = shard.Dependencies.find(child);
+
+	if (dt == shard.Dependencies.end())
+		return;
+
+	auto& refs = dt->second;
 	auto it = refs.find(parent);
 
 	if (it == refs.end())
@@ -46,18 +63,22 @@ void DependencyGraph::RemoveDependency(Object *parent, Object *child)
 		refs.erase(it);
 
 	if (refs.empty())
-		m_Dependencies.erase(child);
+		shard.Dependencies.erase(dt);
 }
 
 std::vector<Object::Ptr> DependencyGraph::GetParents(const Object::Ptr& child)
 {
 	std::vector<Object::Ptr> objects;
 
-	boost::mutex::scoped_lock lock(m_Mutex);
-	auto it = m_Dependencies.find(child.get());
+	Shard& shard = GetShard(child.get());
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
+	auto it = shard.Dependencies.find(child.get());
+
+	if (it != shard.Dependencies.end()) {
+		objects.reserve(it->second.size());
 
-	if (it != m_Dependencies.end()) {
-		typedef std::pair<Object *, int> kv_pair;
+		typedef std::pair<Object * const, int> kv_pair;
 		for (const kv_pair& kv : it->second) {
 			objects.emplace_back(kv.first);
 		}
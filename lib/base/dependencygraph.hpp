@@ -23,7 +23,7 @@
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
 #include <boost/thread/mutex.hpp>
-#include <map>
+#include <unordered_map>
 
 namespace icinga {
 
@@ -42,8 +42,15 @@ public:
 private:
 	DependencyGraph();
 
-	static boost::mutex m_Mutex;
-	static std::map<Object *, std::map<Object *, int> > m_Dependencies;
+	/* Children are spread across shards so that unrelated objects can be
+	 * linked and unlinked in parallel, e.g. by the config commit work queue. */
+	struct Shard
+	{
+		boost::mutex Mutex;
+		std::unordered_map<Object *, std::unordered_map<Object *, int> > Dependencies;
+	};
+
+	static Shard& GetShard(Object *child);
 };
 
 }
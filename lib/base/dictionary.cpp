@@ -22,6 +22,8 @@
 #include "base/debug.hpp"
 #include "base/primitivetype.hpp"
 #include "base/configwriter.hpp"
+#include <algorithm>
+#include <memory>
 #include <sstream>
 
 using namespace icinga;
@@ -32,19 +34,185 @@ REGISTER_PRIMITIVE_TYPE(Dictionary, Object, Dictionary::GetPrototype());
 
 Dictionary::Dictionary(const DictionaryData& other)
 {
-	for (const auto& kv : other)
-		m_Data.insert(kv);
+	InitializeData(DictionaryData(other));
 }
 
 Dictionary::Dictionary(DictionaryData&& other)
 {
-	for (auto& kv : other)
-		m_Data.insert(std::move(kv));
+	InitializeData(std::move(other));
 }
 
 Dictionary::Dictionary(std::initializer_list<Dictionary::Pair> init)
-	: m_Data(init)
-{ }
+{
+	InitializeData(DictionaryData(init));
+}
+
+Dictionary::~Dictionary()
+{
+	if (m_Shared && m_Shared->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		delete m_Shared;
+}
+
+Dictionary::Storage::~Storage()
+{
+	Tree.clear_and_dispose(std::default_delete<TreeNode>());
+}
+
+void Dictionary::Storage::CopyFrom(const Storage& other)
+{
+	Flat = other.Flat;
+	Tree.clone_from(other.Tree, [](const TreeNode& node) { return new TreeNode(Pair(node)); },
+		std::default_delete<TreeNode>());
+	IsTree = other.IsTree;
+}
+
+void Dictionary::Storage::Swap(Storage& other)
+{
+	Flat.swap(other.Flat);
+	Tree.swap(other.Tree);
+	std::swap(IsTree, other.IsTree);
+}
+
+void Dictionary::Storage::Clear()
+{
+	Tree.clear_and_dispose(std::default_delete<TreeNode>());
+	Flat.clear();
+	IsTree = false;
+}
+
+/**
+ * Moves the elements from the flat storage into the tree.
+ */
+void Dictionary::Storage::ConvertToTree()
+{
+	for (auto& kv : Flat)
+		Tree.insert(Tree.end(), *new TreeNode(std::move(kv)));
+
+	DictionaryData().swap(Flat);
+
+	IsTree = true;
+}
+
+DictionaryData::iterator Dictionary::Storage::FindFlat(const String& key)
+{
+	auto it = std::lower_bound(Flat.begin(), Flat.end(), key, [](const Pair& a, const String& b) {
+		return a.first < b;
+	});
+
+	if (it != Flat.end() && it->first != key)
+		return Flat.end();
+
+	return it;
+}
+
+static bool PairKeyLess(const Dictionary::Pair& a, const Dictionary::Pair& b)
+{
+	return a.first < b.first;
+}
+
+static bool PairKeyEqual(const Dictionary::Pair& a, const Dictionary::Pair& b)
+{
+	return a.first == b.first;
+}
+
+/**
+ * Takes ownership of the specified elements. When there are duplicate keys
+ * the first element wins.
+ *
+ * @param data The elements.
+ */
+void Dictionary::InitializeData(DictionaryData&& data)
+{
+	std::stable_sort(data.begin(), data.end(), &PairKeyLess);
+	data.erase(std::unique(data.begin(), data.end(), &PairKeyEqual), data.end());
+
+	for (auto& kv : data)
+		kv.first = String::Intern(kv.first);
+
+	m_Data.Flat = std::move(data);
+
+	if (m_Data.Flat.size() > FlatThreshold)
+		m_Data.ConvertToTree();
+}
+
+/**
+ * Moves the dictionary's data into a block which can be shared with clones.
+ *
+ * Note: Caller must hold the object lock unless the dictionary is frozen.
+ */
+void Dictionary::Share() const
+{
+	if (m_Shared)
+		return;
+
+	std::unique_ptr<SharedStorage> shared(new SharedStorage());
+	shared->Data.Swap(m_Data);
+	m_Shared = shared.release();
+}
+
+/**
+ * Returns the dictionary's data for modifying it. If the data is shared
+ * with other dictionaries this makes a private copy first.
+ *
+ * Note: Caller must hold the object lock.
+ */
+Dictionary::Storage& Dictionary::GetMutableData()
+{
+	ASSERT(OwnsLock());
+
+	if (m_Frozen)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
+
+	if (m_Shared) {
+		/* References are only added while holding the lock of a dictionary
+		 * which uses the block, so a count of 1 can't change under us. */
+		if (m_Shared->References.load(std::memory_order_acquire) == 1) {
+			m_Data.Swap(m_Shared->Data);
+			delete m_Shared;
+		} else {
+			m_Data.CopyFrom(m_Shared->Data);
+
+			if (m_Shared->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete m_Shared;
+		}
+
+		m_Shared = nullptr;
+	}
+
+	return m_Data;
+}
+
+Dictionary::Iterator Dictionary::Find(const String& key) const
+{
+	auto& data = const_cast<Storage&>(GetData());
+
+	if (data.IsTree)
+		return Iterator(data.Tree.find(key, TreeNodeLess()));
+
+	auto it = data.FindFlat(key);
+
+	return Iterator(data.Flat.data() + (it - data.Flat.begin()));
+}
+
+Dictionary::Iterator Dictionary::InternalBegin() const
+{
+	auto& data = const_cast<Storage&>(GetData());
+
+	if (data.IsTree)
+		return Iterator(data.Tree.begin());
+	else
+		return Iterator(data.Flat.data());
+}
+
+Dictionary::Iterator Dictionary::InternalEnd() const
+{
+	auto& data = const_cast<Storage&>(GetData());
+
+	if (data.IsTree)
+		return Iterator(data.Tree.end());
+	else
+		return Iterator(data.Flat.data() + data.Flat.size());
+}
 
 /**
  * Retrieves a value from a dictionary.
@@ -54,11 +222,11 @@ Dictionary::Dictionary(std::initializer_list<Dictionary::Pair> init)
  */
 Value Dictionary::Get(const String& key) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	auto it = m_Data.find(key);
+	auto it = Find(key);
 
-	if (it == m_Data.end())
+	if (it == InternalEnd())
 		return Empty;
 
 	return it->second;
@@ -73,11 +241,11 @@ Value Dictionary::Get(const String& key) const
  */
 bool Dictionary::Get(const String& key, Value *result) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	auto it = m_Data.find(key);
+	auto it = Find(key);
 
-	if (it == m_Data.end())
+	if (it == InternalEnd())
 		return false;
 
 	*result = it->second;
@@ -94,10 +262,33 @@ void Dictionary::Set(const String& key, Value value)
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
+	Storage& data = GetMutableData();
+
+	if (!data.IsTree) {
+		auto it = std::lower_bound(data.Flat.begin(), data.Flat.end(), key, [](const Pair& a, const String& b) {
+			return a.first < b;
+		});
+
+		if (it != data.Flat.end() && it->first == key) {
+			it->second = std::move(value);
+			return;
+		}
+
+		if (data.Flat.size() < FlatThreshold) {
+			data.Flat.emplace(it, String::Intern(key), std::move(value));
+			return;
+		}
+
+		data.ConvertToTree();
+	}
+
+	TreeType::insert_commit_data commitData;
+	auto res = data.Tree.insert_check(key, TreeNodeLess(), commitData);
 
-	m_Data[key] = std::move(value);
+	if (!res.second)
+		res.first->second = std::move(value);
+	else
+		data.Tree.insert_commit(*new TreeNode(Pair(String::Intern(key), std::move(value))), commitData);
 }
 
 /**
@@ -107,9 +298,14 @@ void Dictionary::Set(const String& key, Value value)
  */
 size_t Dictionary::GetLength() const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	return m_Data.size();
+	const Storage& data = GetData();
+
+	if (data.IsTree)
+		return data.Tree.size();
+	else
+		return data.Flat.size();
 }
 
 /**
@@ -120,37 +316,45 @@ size_t Dictionary::GetLength() const
  */
 bool Dictionary::Contains(const String& key) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	return (m_Data.find(key) != m_Data.end());
+	return (Find(key) != InternalEnd());
 }
 
 /**
  * Returns an iterator to the beginning of the dictionary.
  *
- * Note: Caller must hold the object lock while using the iterator.
+ * Note: Caller must hold the object lock while using the iterator unless
+ * the dictionary is frozen.
  *
  * @returns An iterator.
  */
 Dictionary::Iterator Dictionary::Begin()
 {
-	ASSERT(OwnsLock());
+	ASSERT(m_Frozen || OwnsLock());
 
-	return m_Data.begin();
+	if (!m_Frozen)
+		GetMutableData();
+
+	return InternalBegin();
 }
 
 /**
  * Returns an iterator to the end of the dictionary.
  *
- * Note: Caller must hold the object lock while using the iterator.
+ * Note: Caller must hold the object lock while using the iterator unless
+ * the dictionary is frozen.
  *
  * @returns An iterator.
  */
 Dictionary::Iterator Dictionary::End()
 {
-	ASSERT(OwnsLock());
+	ASSERT(m_Frozen || OwnsLock());
 
-	return m_Data.end();
+	if (!m_Frozen)
+		GetMutableData();
+
+	return InternalEnd();
 }
 
 /**
@@ -162,10 +366,12 @@ void Dictionary::Remove(Dictionary::Iterator it)
 {
 	ASSERT(OwnsLock());
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
+	Storage& data = GetMutableData();
 
-	m_Data.erase(it);
+	if (it.m_IsTree)
+		data.Tree.erase_and_dispose(it.m_Tree, std::default_delete<TreeNode>());
+	else
+		data.Flat.erase(data.Flat.begin() + (it.m_Flat - data.Flat.data()));
 }
 
 /**
@@ -177,16 +383,19 @@ void Dictionary::Remove(const String& key)
 {
 	ObjectLock olock(this);
 
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
+	Storage& data = GetMutableData();
 
-	Dictionary::Iterator it;
-	it = m_Data.find(key);
+	if (data.IsTree) {
+		auto it = data.Tree.find(key, TreeNodeLess());
 
-	if (it == m_Data.end())
-		return;
+		if (it != data.Tree.end())
+			data.Tree.erase_and_dispose(it, std::default_delete<TreeNode>());
+	} else {
+		auto it = data.FindFlat(key);
 
-	m_Data.erase(it);
+		if (it != data.Flat.end())
+			data.Flat.erase(it);
+	}
 }
 
 /**
@@ -199,27 +408,43 @@ void Dictionary::Clear()
 	if (m_Frozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
-	m_Data.clear();
+	/* There's no point in copying shared data only to throw it away. */
+	if (m_Shared) {
+		if (m_Shared->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete m_Shared;
+
+		m_Shared = nullptr;
+	}
+
+	m_Data.Clear();
 }
 
 void Dictionary::CopyTo(const Dictionary::Ptr& dest) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
-	for (const Dictionary::Pair& kv : m_Data) {
-		dest->Set(kv.first, kv.second);
+	for (auto it = InternalBegin(); it != InternalEnd(); it++) {
+		dest->Set(it->first, it->second);
 	}
 }
 
 /**
- * Makes a shallow copy of a dictionary.
+ * Makes a shallow copy of a dictionary. The copy shares the elements with
+ * this dictionary until either of them is modified.
  *
  * @returns a copy of the dictionary.
  */
 Dictionary::Ptr Dictionary::ShallowClone() const
 {
 	Dictionary::Ptr clone = new Dictionary();
-	CopyTo(clone);
+
+	/* Frozen dictionaries already share their data and never give it up. */
+	ObjectLock olock(m_Frozen ? nullptr : this);
+
+	Share();
+	m_Shared->References.fetch_add(1, std::memory_order_relaxed);
+	clone->m_Shared = m_Shared;
+
 	return clone;
 }
 
@@ -234,12 +459,12 @@ Object::Ptr Dictionary::Clone() const
 	DictionaryData dict;
 
 	{
-		ObjectLock olock(this);
+		ObjectLock olock(m_Frozen ? nullptr : this);
 
 		dict.reserve(GetLength());
 
-		for (const Dictionary::Pair& kv : m_Data) {
-			dict.emplace_back(kv.first, kv.second.Clone());
+		for (auto it = InternalBegin(); it != InternalEnd(); it++) {
+			dict.emplace_back(it->first, it->second.Clone());
 		}
 	}
 
@@ -254,12 +479,14 @@ Object::Ptr Dictionary::Clone() const
  */
 std::vector<String> Dictionary::GetKeys() const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(m_Frozen ? nullptr : this);
 
 	std::vector<String> keys;
 
-	for (const Dictionary::Pair& kv : m_Data) {
-		keys.push_back(kv.first);
+	keys.reserve(GetLength());
+
+	for (auto it = InternalBegin(); it != InternalEnd(); it++) {
+		keys.push_back(it->first);
 	}
 
 	return keys;
@@ -272,10 +499,23 @@ String Dictionary::ToString() const
 	return msgbuf.str();
 }
 
+/**
+ * Makes the dictionary read-only. Frozen dictionaries can be read without
+ * holding their object lock.
+ */
 void Dictionary::Freeze()
 {
 	ObjectLock olock(this);
-	m_Frozen = true;
+
+	/* Readers which don't take the lock rely on the data not moving
+	 * once they've seen the frozen flag. */
+	Share();
+	m_Frozen.store(true, std::memory_order_release);
+}
+
+bool Dictionary::IsFrozen() const
+{
+	return m_Frozen.load(std::memory_order_acquire);
 }
 
 Value Dictionary::GetFieldByName(const String& field, bool, const DebugInfo& debugInfo) const
@@ -22,36 +22,120 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
+#include "base/objectpool.hpp"
 #include "base/value.hpp"
 #include <boost/range/iterator.hpp>
+#include <boost/intrusive/set.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <atomic>
 #include <map>
 #include <vector>
 
 namespace icinga
 {
 
-typedef std::vector<std::pair<String, Value> > DictionaryData;
-
 /**
  * A container that holds key-value pairs.
  *
+ * Small dictionaries keep their elements in a sorted vector. Once they grow
+ * beyond FlatThreshold elements they are converted into a tree. In both cases
+ * the elements are iterated in the order of their keys.
+ *
+ * ShallowClone() doesn't copy the elements: The dictionaries share them
+ * until one of them is modified. Frozen dictionaries can be read without
+ * holding their object lock.
+ *
  * @ingroup base
  */
 class Dictionary final : public Object
 {
 public:
 	DECLARE_OBJECT(Dictionary);
+	DECLARE_POOLED_ALLOCATOR();
+
+	typedef std::pair<String, Value> Pair;
+
+	typedef size_t SizeType;
+
+	static const SizeType FlatThreshold = 32;
 
+private:
+	struct TreeNode : public Pair, public boost::intrusive::set_base_hook<boost::intrusive::optimize_size<true> >
+	{
+		TreeNode(Pair&& pair)
+			: Pair(std::move(pair))
+		{ }
+	};
+
+	struct TreeNodeLess
+	{
+		bool operator()(const TreeNode& a, const TreeNode& b) const { return a.first < b.first; }
+		bool operator()(const String& a, const TreeNode& b) const { return a < b.first; }
+		bool operator()(const TreeNode& a, const String& b) const { return a.first < b; }
+	};
+
+	typedef boost::intrusive::set<TreeNode, boost::intrusive::compare<TreeNodeLess> > TreeType;
+
+public:
 	/**
 	 * An iterator that can be used to iterate over dictionary elements.
 	 */
-	typedef std::map<String, Value>::iterator Iterator;
-
-	typedef std::map<String, Value>::size_type SizeType;
-
-	typedef std::map<String, Value>::value_type Pair;
+	class Iterator : public boost::iterator_facade<Iterator, Pair, boost::bidirectional_traversal_tag>
+	{
+	public:
+		Iterator() = default;
+
+	private:
+		Pair *m_Flat{nullptr};
+		TreeType::iterator m_Tree;
+		bool m_IsTree{false};
+
+		Iterator(Pair *flat)
+			: m_Flat(flat)
+		{ }
+
+		Iterator(TreeType::iterator tree)
+			: m_Tree(tree), m_IsTree(true)
+		{ }
+
+		void increment()
+		{
+			if (m_IsTree)
+				++m_Tree;
+			else
+				++m_Flat;
+		}
+
+		void decrement()
+		{
+			if (m_IsTree)
+				--m_Tree;
+			else
+				--m_Flat;
+		}
+
+		bool equal(const Iterator& other) const
+		{
+			if (m_IsTree)
+				return m_Tree == other.m_Tree;
+			else
+				return m_Flat == other.m_Flat;
+		}
+
+		Pair& dereference() const
+		{
+			if (m_IsTree)
+				return *m_Tree;
+			else
+				return *m_Flat;
+		}
+
+		friend class boost::iterator_core_access;
+		friend class Dictionary;
+	};
 
 	Dictionary() = default;
+	~Dictionary() override;
 	Dictionary(const DictionaryData& other);
 	Dictionary(DictionaryData&& other);
 	Dictionary(std::initializer_list<Pair> init);
@@ -84,6 +168,7 @@ public:
 	String ToString() const override;
 
 	void Freeze();
+	bool IsFrozen() const;
 
 	Value GetFieldByName(const String& field, bool sandboxed, const DebugInfo& debugInfo) const override;
 	void SetFieldByName(const String& field, const Value& value, const DebugInfo& debugInfo) override;
@@ -91,8 +176,48 @@ public:
 	bool GetOwnField(const String& field, Value *result) const override;
 
 private:
-	std::map<String, Value> m_Data; /**< The data for the dictionary. */
-	bool m_Frozen{false};
+	struct Storage
+	{
+		DictionaryData Flat; /**< The data for small dictionaries, sorted by key. */
+		TreeType Tree; /**< The data for large dictionaries. */
+		bool IsTree{false};
+
+		Storage() = default;
+		Storage(const Storage&) = delete;
+		Storage& operator=(const Storage&) = delete;
+		~Storage();
+
+		void CopyFrom(const Storage& other);
+		void Swap(Storage& other);
+		void Clear();
+		void ConvertToTree();
+
+		DictionaryData::iterator FindFlat(const String& key);
+	};
+
+	struct SharedStorage
+	{
+		std::atomic<uint_fast32_t> References{1};
+		Storage Data;
+	};
+
+	mutable Storage m_Data; /**< The data for the dictionary unless it is shared. */
+	mutable SharedStorage *m_Shared{nullptr}; /**< The data which is shared with clones. */
+	std::atomic<bool> m_Frozen{false};
+
+	const Storage& GetData() const
+	{
+		return m_Shared ? m_Shared->Data : m_Data;
+	}
+
+	Storage& GetMutableData();
+	void Share() const;
+
+	void InitializeData(DictionaryData&& data);
+
+	Iterator Find(const String& key) const;
+	Iterator InternalBegin() const;
+	Iterator InternalEnd() const;
 };
 
 Dictionary::Iterator begin(const Dictionary::Ptr& x);
@@ -0,0 +1,374 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/dnsresolver.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/socket.hpp"
+#include "base/statsfunction.hpp"
+#include "base/utility.hpp"
+#include <boost/exception/errinfo_api_function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <thread>
+
+using namespace icinga;
+
+/**
+ * The cached result of a lookup.
+ */
+struct DnsCacheEntry
+{
+	String Node;
+	String Service;
+	std::vector<DnsAddress> Addresses;
+	int Error{0};
+	double Expires{0}; /**< 0 while there is no result yet. */
+	bool Pending{false};
+	std::vector<DnsResolver::ResolveCallback> Callbacks;
+};
+
+static boost::mutex l_DnsMutex;
+static boost::condition_variable l_DnsResultCV;
+static boost::condition_variable l_DnsQueueCV;
+static std::map<String, DnsCacheEntry> l_DnsCache;
+static std::deque<String> l_DnsQueue;
+static bool l_DnsThreadsStarted = false;
+
+static std::atomic<uint64_t> l_DnsHits{0};
+static std::atomic<uint64_t> l_DnsMisses{0};
+static std::atomic<uint64_t> l_DnsNegativeHits{0};
+static std::atomic<uint64_t> l_DnsLookups{0};
+static std::atomic<uint64_t> l_DnsFailures{0};
+
+/* Lookups for different names don't wait for each other. */
+static const int l_DnsThreadCount = 2;
+
+static double GetDnsConstant(const String& name, double defaultValue)
+{
+	Value value = ScriptGlobal::Get(name, &Empty);
+	return value.IsEmpty() ? defaultValue : static_cast<double>(value);
+}
+
+static void ResolverThreadProc()
+{
+	Utility::SetThreadName("DNS Resolver");
+
+	for (;;) {
+		String key, node, service;
+
+		{
+			boost::mutex::scoped_lock lock(l_DnsMutex);
+
+			while (l_DnsQueue.empty())
+				l_DnsQueueCV.wait(lock);
+
+			key = l_DnsQueue.front();
+			l_DnsQueue.pop_front();
+
+			const DnsCacheEntry& entry = l_DnsCache[key];
+			node = entry.Node;
+			service = entry.Service;
+		}
+
+		addrinfo hints;
+		addrinfo *result;
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+
+		l_DnsLookups++;
+
+		int rc = getaddrinfo(node.CStr(), service.CStr(), &hints, &result);
+
+		std::vector<DnsAddress> addresses;
+
+		if (rc == 0) {
+			for (addrinfo *info = result; info != nullptr; info = info->ai_next) {
+				DnsAddress address;
+				address.Family = info->ai_family;
+				address.SockType = info->ai_socktype;
+				address.Protocol = info->ai_protocol;
+				address.AddressLength = info->ai_addrlen;
+				memcpy(&address.Address, info->ai_addr, std::min<size_t>(info->ai_addrlen, sizeof(address.Address)));
+				addresses.push_back(address);
+			}
+
+			freeaddrinfo(result);
+		} else {
+			l_DnsFailures++;
+
+			Log(LogWarning, "DnsResolver")
+				<< "Failed to resolve '" << node << "': " << gai_strerror(rc);
+		}
+
+		std::vector<DnsResolver::ResolveCallback> callbacks;
+
+		{
+			boost::mutex::scoped_lock lock(l_DnsMutex);
+
+			DnsCacheEntry& entry = l_DnsCache[key];
+			double now = Utility::GetTime();
+
+			entry.Pending = false;
+
+			if (rc == 0) {
+				entry.Addresses = std::move(addresses);
+				entry.Error = 0;
+				entry.Expires = now + GetDnsConstant("DnsCacheTTL", 300);
+			} else if (entry.Error == 0 && !entry.Addresses.empty()) {
+				/* Keep the previous addresses while the resolver fails. */
+				entry.Expires = now + GetDnsConstant("DnsNegativeCacheTTL", 30);
+			} else {
+				entry.Addresses.clear();
+				entry.Error = rc;
+				entry.Expires = now + GetDnsConstant("DnsNegativeCacheTTL", 30);
+			}
+
+			callbacks.swap(entry.Callbacks);
+			addresses = entry.Addresses;
+			rc = entry.Error;
+
+			l_DnsResultCV.notify_all();
+		}
+
+		for (const DnsResolver::ResolveCallback& callback : callbacks)
+			callback(addresses, rc);
+	}
+}
+
+/**
+ * Queues a lookup for an entry unless one is already pending.
+ * l_DnsMutex must be held.
+ */
+static void QueueLookup(const String& key, DnsCacheEntry& entry)
+{
+	if (entry.Pending)
+		return;
+
+	entry.Pending = true;
+	l_DnsQueue.push_back(key);
+	l_DnsQueueCV.notify_one();
+
+	if (!l_DnsThreadsStarted) {
+		l_DnsThreadsStarted = true;
+
+		for (int i = 0; i < l_DnsThreadCount; i++) {
+			std::thread t(&ResolverThreadProc);
+			t.detach();
+		}
+	}
+}
+
+/**
+ * Returns whether an entry holds a result which may be used right away.
+ * Expired addresses are still used while they are resolved again.
+ */
+static bool HasUsableResult(const DnsCacheEntry& entry, double now)
+{
+	if (entry.Expires == 0)
+		return false;
+
+	if (entry.Error == 0)
+		return now < entry.Expires || GetDnsConstant("DnsCacheTTL", 300) > 0;
+
+	return now < entry.Expires;
+}
+
+static void ThrowResolveError(const String& node, int error)
+{
+	Log(LogCritical, "DnsResolver")
+		<< "getaddrinfo() failed for '" << node << "' with error code " << error << ", \"" << gai_strerror(error) << "\"";
+
+	BOOST_THROW_EXCEPTION(socket_error()
+		<< boost::errinfo_api_function("getaddrinfo")
+		<< errinfo_getaddrinfo_error(error));
+}
+
+/**
+ * Resolves a host name and service. Waits for at most DnsResolveTimeout
+ * seconds if there is no cached result.
+ *
+ * @param node The host name.
+ * @param service The service name or port.
+ * @returns The addresses.
+ */
+std::vector<DnsAddress> DnsResolver::Resolve(const String& node, const String& service)
+{
+	String key = node + "\n" + service;
+
+	boost::mutex::scoped_lock lock(l_DnsMutex);
+
+	DnsCacheEntry& entry = l_DnsCache[key];
+	double now = Utility::GetTime();
+
+	if (entry.Node.IsEmpty()) {
+		entry.Node = node;
+		entry.Service = service;
+	}
+
+	if (HasUsableResult(entry, now)) {
+		if (now >= entry.Expires)
+			QueueLookup(key, entry);
+
+		if (entry.Error != 0) {
+			l_DnsNegativeHits++;
+
+			int error = entry.Error;
+			lock.unlock();
+			ThrowResolveError(node, error);
+		}
+
+		l_DnsHits++;
+		return entry.Addresses;
+	}
+
+	l_DnsMisses++;
+
+	QueueLookup(key, entry);
+
+	boost::system_time timeout = boost::get_system_time()
+		+ boost::posix_time::milliseconds(static_cast<long>(GetDnsConstant("DnsResolveTimeout", 10) * 1000));
+
+	while (entry.Pending) {
+		if (!l_DnsResultCV.timed_wait(lock, timeout))
+			break;
+	}
+
+	if (entry.Pending) {
+		lock.unlock();
+		ThrowResolveError(node, EAI_AGAIN);
+	}
+
+	if (entry.Error != 0) {
+		int error = entry.Error;
+		lock.unlock();
+		ThrowResolveError(node, error);
+	}
+
+	return entry.Addresses;
+}
+
+/**
+ * Resolves a host name and service without blocking. The callback is
+ * called right away for cached results and from a resolver thread
+ * otherwise, with the getaddrinfo() error code if the lookup failed.
+ *
+ * @param node The host name.
+ * @param service The service name or port.
+ * @param callback Receives the addresses and the error code.
+ */
+void DnsResolver::ResolveAsync(const String& node, const String& service, const ResolveCallback& callback)
+{
+	String key = node + "\n" + service;
+
+	std::vector<DnsAddress> addresses;
+	int error;
+
+	{
+		boost::mutex::scoped_lock lock(l_DnsMutex);
+
+		DnsCacheEntry& entry = l_DnsCache[key];
+		double now = Utility::GetTime();
+
+		if (entry.Node.IsEmpty()) {
+			entry.Node = node;
+			entry.Service = service;
+		}
+
+		if (!HasUsableResult(entry, now)) {
+			l_DnsMisses++;
+
+			entry.Callbacks.push_back(callback);
+			QueueLookup(key, entry);
+			return;
+		}
+
+		if (now >= entry.Expires)
+			QueueLookup(key, entry);
+
+		if (entry.Error != 0)
+			l_DnsNegativeHits++;
+		else
+			l_DnsHits++;
+
+		addresses = entry.Addresses;
+		error = entry.Error;
+	}
+
+	callback(addresses, error);
+}
+
+/**
+ * Discards the cached addresses for a host name and service, e.g. because
+ * none of them accepted a connection.
+ */
+void DnsResolver::Invalidate(const String& node, const String& service)
+{
+	boost::mutex::scoped_lock lock(l_DnsMutex);
+
+	auto it = l_DnsCache.find(node + "\n" + service);
+
+	if (it == l_DnsCache.end() || it->second.Pending)
+		return;
+
+	it->second.Addresses.clear();
+	it->second.Error = 0;
+	it->second.Expires = 0;
+}
+
+Dictionary::Ptr DnsResolver::GetStats()
+{
+	size_t entries, pending;
+
+	{
+		boost::mutex::scoped_lock lock(l_DnsMutex);
+		entries = l_DnsCache.size();
+		pending = l_DnsQueue.size();
+	}
+
+	return new Dictionary({
+		{ "entries", entries },
+		{ "pending", pending },
+		{ "hits", l_DnsHits.load() },
+		{ "misses", l_DnsMisses.load() },
+		{ "negative_hits", l_DnsNegativeHits.load() },
+		{ "lookups", l_DnsLookups.load() },
+		{ "failures", l_DnsFailures.load() }
+	});
+}
+
+static void DnsResolverStatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	status->Set("dns_resolver", DnsResolver::GetStats());
+
+	perfdata->Add(new PerfdataValue("dns_resolver_hits", l_DnsHits.load()));
+	perfdata->Add(new PerfdataValue("dns_resolver_misses", l_DnsMisses.load()));
+	perfdata->Add(new PerfdataValue("dns_resolver_failures", l_DnsFailures.load()));
+}
+
+REGISTER_STATSFUNCTION(DnsResolver, &DnsResolverStatsFunc);
@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef DNSRESOLVER_H
+#define DNSRESOLVER_H
+
+#include "base/i2-base.hpp"
+#include "base/dictionary.hpp"
+#include "base/string.hpp"
+#include <functional>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A resolved socket address.
+ *
+ * @ingroup base
+ */
+struct DnsAddress
+{
+	int Family;
+	int SockType;
+	int Protocol;
+	sockaddr_storage Address;
+	socklen_t AddressLength;
+};
+
+/**
+ * Resolves host names for outbound connections. Lookups are done by
+ * dedicated resolver threads and cached for DnsCacheTTL seconds, failed
+ * lookups for DnsNegativeCacheTTL seconds. Once an entry has expired the
+ * previous addresses are still returned while the name is resolved again
+ * in the background, and kept if the resolver fails.
+ *
+ * @ingroup base
+ */
+class DnsResolver
+{
+public:
+	typedef std::function<void (const std::vector<DnsAddress>&, int)> ResolveCallback;
+
+	static std::vector<DnsAddress> Resolve(const String& node, const String& service);
+	static void ResolveAsync(const String& node, const String& service, const ResolveCallback& callback);
+	static void Invalidate(const String& node, const String& service);
+
+	static Dictionary::Ptr GetStats();
+
+private:
+	DnsResolver();
+};
+
+}
+
+#endif /* DNSRESOLVER_H */
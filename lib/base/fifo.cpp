@@ -60,14 +60,18 @@ void FIFO::ResizeBuffer(size_t newSize, bool decrease)
  */
 void FIFO::Optimize()
 {
-	if (m_Offset > m_DataSize / 10 && m_Offset - m_DataSize > 1024) {
-		std::memmove(m_Buffer, m_Buffer + m_Offset, m_DataSize);
+	if (m_DataSize == 0) {
 		m_Offset = 0;
+		return;
+	}
 
-		if (m_DataSize > 0)
-			ResizeBuffer(m_DataSize, true);
+	/* Only move the data once more has been consumed than is left, so that
+	 * every byte is moved at most once on average. */
+	if (m_Offset > 1024 && m_Offset >= m_DataSize) {
+		std::memmove(m_Buffer, m_Buffer + m_Offset, m_DataSize);
+		m_Offset = 0;
 
-		return;
+		ResizeBuffer(m_DataSize, true);
 	}
 }
 
@@ -109,9 +113,72 @@ size_t FIFO::Read(void *buffer, size_t count, bool allow_partial)
  * Implements IOQueue::Write.
  */
 void FIFO::Write(const void *buffer, size_t count)
+{
+	std::memcpy(PrepareWrite(count), buffer, count);
+	CommitWrite(count);
+}
+
+/**
+ * Implements Stream::ReadBuffered. The callback sees all data in the FIFO.
+ */
+bool FIFO::ReadBuffered(const std::function<size_t (const char *, size_t)>& callback)
+{
+	size_t count = callback(m_Buffer + m_Offset, m_DataSize);
+
+	ASSERT(count <= m_DataSize);
+
+	m_DataSize -= count;
+	m_Offset += count;
+
+	Optimize();
+
+	return true;
+}
+
+/**
+ * Implements Stream::WriteBuffers. The buffer is resized at most once.
+ */
+void FIFO::WriteBuffers(const StreamBuffer *buffers, size_t count)
+{
+	size_t total = 0;
+
+	for (size_t i = 0; i < count; i++)
+		total += buffers[i].Size;
+
+	char *data = PrepareWrite(total);
+
+	for (size_t i = 0; i < count; i++) {
+		std::memcpy(data, buffers[i].Data, buffers[i].Size);
+		data += buffers[i].Size;
+	}
+
+	CommitWrite(total);
+}
+
+/**
+ * Makes room for at least count bytes at the end of the FIFO so that
+ * the data can be written there directly, e.g. by SSL_read().
+ *
+ * @param count The number of bytes.
+ * @returns The location for the new data, valid until the FIFO is modified.
+ */
+char *FIFO::PrepareWrite(size_t count)
 {
 	ResizeBuffer(m_Offset + m_DataSize + count, false);
-	std::memcpy(m_Buffer + m_Offset + m_DataSize, buffer, count);
+
+	return m_Buffer + m_Offset + m_DataSize;
+}
+
+/**
+ * Appends data which has been written into the buffer returned by
+ * PrepareWrite().
+ *
+ * @param count The number of bytes which were written.
+ */
+void FIFO::CommitWrite(size_t count)
+{
+	ASSERT(m_Offset + m_DataSize + count <= m_AllocSize);
+
 	m_DataSize += count;
 
 	SignalDataAvailable();
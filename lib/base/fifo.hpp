@@ -43,6 +43,8 @@ public:
 	size_t Peek(void *buffer, size_t count, bool allow_partial = false) override;
 	size_t Read(void *buffer, size_t count, bool allow_partial = false) override;
 	void Write(const void *buffer, size_t count) override;
+	bool ReadBuffered(const std::function<size_t (const char *, size_t)>& callback) override;
+	void WriteBuffers(const StreamBuffer *buffers, size_t count) override;
 	void Close() override;
 	bool IsEof() const override;
 	bool SupportsWaiting() const override;
@@ -50,6 +52,9 @@ public:
 
 	size_t GetAvailableBytes() const;
 
+	char *PrepareWrite(size_t count);
+	void CommitWrite(size_t count);
+
 private:
 	char *m_Buffer{nullptr};
 	size_t m_DataSize{0};
@@ -27,6 +27,18 @@ using namespace icinga;
 REGISTER_TYPE_WITH_PROTOTYPE(Function, Function::GetPrototype());
 
 Function::Function(const String& name, Callback function, const std::vector<String>& args,
+	bool side_effect_free, bool deprecated)
+	: Function(name, SpanCallback([function](const ArgumentSpan& arguments) {
+		const std::vector<Value> *vector = arguments.GetVector();
+
+		if (vector)
+			return function(*vector);
+		else
+			return function(arguments.ToVector());
+	}), args, side_effect_free, deprecated)
+{ }
+
+Function::Function(const String& name, SpanCallback function, const std::vector<String>& args,
 	bool side_effect_free, bool deprecated)
 	: m_Callback(std::move(function))
 {
@@ -37,12 +49,22 @@ Function::Function(const String& name, Callback function, const std::vector<Stri
 }
 
 Value Function::Invoke(const std::vector<Value>& arguments)
+{
+	return Invoke(ArgumentSpan(arguments));
+}
+
+Value Function::Invoke(const ArgumentSpan& arguments)
 {
 	ScriptFrame frame(false);
 	return m_Callback(arguments);
 }
 
 Value Function::InvokeThis(const Value& otherThis, const std::vector<Value>& arguments)
+{
+	return InvokeThis(otherThis, ArgumentSpan(arguments));
+}
+
+Value Function::InvokeThis(const Value& otherThis, const ArgumentSpan& arguments)
 {
 	ScriptFrame frame(false, otherThis);
 	return m_Callback(arguments);
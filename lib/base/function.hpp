@@ -41,6 +41,7 @@ public:
 	DECLARE_OBJECT(Function);
 
 	typedef std::function<Value (const std::vector<Value>& arguments)> Callback;
+	typedef std::function<Value (const ArgumentSpan& arguments)> SpanCallback;
 
 	template<typename F>
 	Function(const String& name, F function, const std::vector<String>& args = std::vector<String>(),
@@ -49,7 +50,9 @@ public:
 	{ }
 
 	Value Invoke(const std::vector<Value>& arguments = std::vector<Value>());
+	Value Invoke(const ArgumentSpan& arguments);
 	Value InvokeThis(const Value& otherThis, const std::vector<Value>& arguments = std::vector<Value>());
+	Value InvokeThis(const Value& otherThis, const ArgumentSpan& arguments);
 
 	bool IsSideEffectFree() const
 	{
@@ -66,10 +69,12 @@ public:
 	Object::Ptr Clone() const override;
 
 private:
-	Callback m_Callback;
+	SpanCallback m_Callback;
 
 	Function(const String& name, Callback function, const std::vector<String>& args,
 		bool side_effect_free, bool deprecated);
+	Function(const String& name, SpanCallback function, const std::vector<String>& args,
+		bool side_effect_free, bool deprecated);
 };
 
 #define REGISTER_SCRIPTFUNCTION_NS(ns, name, callback, args) \
@@ -82,7 +87,7 @@ private:
 	INITIALIZE_ONCE_WITH_PRIORITY([]() { \
 		Function::Ptr sf = new icinga::Function(#ns "#" #name, callback, String(args).Split(":"), false); \
 		ScriptGlobal::Set(#ns "." #name, sf); \
-		Function::Ptr dsf = new icinga::Function("Deprecated#__" #name " (deprecated)", WrapFunction(callback), String(args).Split(":"), false, true); \
+		Function::Ptr dsf = new icinga::Function("Deprecated#__" #name " (deprecated)", callback, String(args).Split(":"), false, true); \
 		ScriptGlobal::Set("Deprecated.__" #name, dsf); \
 	}, 10)
 
@@ -90,7 +95,7 @@ private:
 	INITIALIZE_ONCE_WITH_PRIORITY([]() { \
 		Function::Ptr sf = new icinga::Function(#ns "#" #name, callback, String(args).Split(":"), false); \
 		ScriptGlobal::Set(#ns "." #name, sf); \
-		Function::Ptr dsf = new icinga::Function("Deprecated#" #name " (deprecated)", WrapFunction(callback), String(args).Split(":"), false, true); \
+		Function::Ptr dsf = new icinga::Function("Deprecated#" #name " (deprecated)", callback, String(args).Split(":"), false, true); \
 		ScriptGlobal::Set("Deprecated." #name, dsf); \
 	}, 10)
 
@@ -104,7 +109,7 @@ private:
 	INITIALIZE_ONCE_WITH_PRIORITY([]() { \
 		Function::Ptr sf = new icinga::Function(#ns "#" #name, callback, String(args).Split(":"), true); \
 		ScriptGlobal::Set(#ns "." #name, sf); \
-		Function::Ptr dsf = new icinga::Function("Deprecated#__" #name " (deprecated)", WrapFunction(callback), String(args).Split(":"), true, true); \
+		Function::Ptr dsf = new icinga::Function("Deprecated#__" #name " (deprecated)", callback, String(args).Split(":"), true, true); \
 		ScriptGlobal::Set("Deprecated.__" #name, dsf); \
 	}, 10)
 
@@ -112,7 +117,7 @@ private:
 	INITIALIZE_ONCE_WITH_PRIORITY([]() { \
 		Function::Ptr sf = new icinga::Function(#ns "#" #name, callback, String(args).Split(":"), true); \
 		ScriptGlobal::Set(#ns "." #name, sf); \
-		Function::Ptr dsf = new icinga::Function("Deprecated#" #name " (deprecated)", WrapFunction(callback), String(args).Split(":"), true, true); \
+		Function::Ptr dsf = new icinga::Function("Deprecated#" #name " (deprecated)", callback, String(args).Split(":"), true, true); \
 		ScriptGlobal::Set("Deprecated." #name, dsf); \
 	}, 10)
 
@@ -33,15 +33,128 @@ using namespace std::placeholders;
 namespace icinga
 {
 
+/**
+ * A read-only view of the arguments of a function call. Callers can pass
+ * arguments from any contiguous storage (e.g. an inline buffer on the stack
+ * or the VM's registers) without building a std::vector first.
+ *
+ * @ingroup base
+ */
+class ArgumentSpan
+{
+public:
+	typedef const Value *const_iterator;
+	typedef const Value *iterator;
+
+	ArgumentSpan()
+		: m_Data(nullptr), m_Size(0), m_Vector(nullptr)
+	{ }
+
+	ArgumentSpan(const Value *data, size_t size)
+		: m_Data(data), m_Size(size), m_Vector(nullptr)
+	{ }
+
+	ArgumentSpan(const std::vector<Value>& arguments)
+		: m_Data(arguments.data()), m_Size(arguments.size()), m_Vector(&arguments)
+	{ }
+
+	size_t size() const
+	{
+		return m_Size;
+	}
+
+	bool empty() const
+	{
+		return m_Size == 0;
+	}
+
+	const Value& operator[](size_t index) const
+	{
+		return m_Data[index];
+	}
+
+	const Value *begin() const
+	{
+		return m_Data;
+	}
+
+	const Value *end() const
+	{
+		return m_Data + m_Size;
+	}
+
+	/**
+	 * Returns the vector this span was created from, if any. This lets
+	 * functions which still take a std::vector avoid copying the arguments.
+	 */
+	const std::vector<Value> *GetVector() const
+	{
+		return m_Vector;
+	}
+
+	std::vector<Value> ToVector() const
+	{
+		return std::vector<Value>(m_Data, m_Data + m_Size);
+	}
+
+private:
+	const Value *m_Data;
+	size_t m_Size;
+	const std::vector<Value> *m_Vector;
+};
+
+/**
+ * Fixed-size argument storage for function calls which avoids allocating
+ * memory for calls with up to N arguments.
+ *
+ * @ingroup base
+ */
+template<size_t N>
+class InlineArguments
+{
+public:
+	explicit InlineArguments(size_t size)
+		: m_Size(size)
+	{
+		if (size > N)
+			m_Overflow.resize(size);
+	}
+
+	InlineArguments(const InlineArguments&) = delete;
+	InlineArguments& operator=(const InlineArguments&) = delete;
+
+	Value& operator[](size_t index)
+	{
+		return m_Size > N ? m_Overflow[index] : m_Inline[index];
+	}
+
+	operator ArgumentSpan() const
+	{
+		return ArgumentSpan(m_Size > N ? m_Overflow.data() : m_Inline, m_Size);
+	}
+
+private:
+	Value m_Inline[N];
+	std::vector<Value> m_Overflow;
+	size_t m_Size;
+};
+
 template<typename FuncType>
 typename std::enable_if<
     std::is_class<FuncType>::value &&
     std::is_same<typename boost::function_types::result_type<decltype(&FuncType::operator())>::type, Value>::value &&
 	boost::function_types::function_arity<decltype(&FuncType::operator())>::value == 2,
-    std::function<Value (const std::vector<Value>&)>>::type
+    std::function<Value (typename boost::mpl::at_c<typename boost::function_types::parameter_types<decltype(&FuncType::operator())>, 1>::type)>>::type
 WrapFunction(FuncType function)
 {
-	static_assert(std::is_same<typename boost::mpl::at_c<typename boost::function_types::parameter_types<decltype(&FuncType::operator())>, 1>::type, const std::vector<Value>&>::value, "Argument type must be const std::vector<Value>");
+	typedef typename boost::mpl::at_c<typename boost::function_types::parameter_types<decltype(&FuncType::operator())>, 1>::type ArgumentsType;
+	static_assert(std::is_same<ArgumentsType, const std::vector<Value>&>::value || std::is_same<ArgumentsType, const ArgumentSpan&>::value,
+		"Argument type must be const std::vector<Value> or const ArgumentSpan");
+	return function;
+}
+
+inline std::function<Value (const ArgumentSpan&)> WrapFunction(Value (*function)(const ArgumentSpan&))
+{
 	return function;
 }
 
@@ -81,14 +194,14 @@ struct UnpackCaller
 {
 private:
 	template <typename FuncType, size_t... I>
-	auto Invoke(FuncType f, const std::vector<Value>& args, indices<I...>) -> decltype(f(args[I]...))
+	auto Invoke(FuncType f, const ArgumentSpan& args, indices<I...>) -> decltype(f(args[I]...))
 	{
 		return f(args[I]...);
 	}
 
 public:
 	template <typename FuncType, int Arity>
-	auto operator() (FuncType f, const std::vector<Value>& args) -> decltype(Invoke(f, args, BuildIndices<Arity>{}))
+	auto operator() (FuncType f, const ArgumentSpan& args) -> decltype(Invoke(f, args, BuildIndices<Arity>{}))
 	{
 		return Invoke(f, args, BuildIndices<Arity>{});
 	}
@@ -97,7 +210,7 @@ public:
 template<typename FuncType, int Arity, typename ReturnType>
 struct FunctionWrapper
 {
-	static Value Invoke(FuncType function, const std::vector<Value>& arguments)
+	static Value Invoke(FuncType function, const ArgumentSpan& arguments)
 	{
 		return UnpackCaller().operator()<FuncType, Arity>(function, arguments);
 	}
@@ -106,7 +219,7 @@ struct FunctionWrapper
 template<typename FuncType, int Arity>
 struct FunctionWrapper<FuncType, Arity, void>
 {
-	static Value Invoke(FuncType function, const std::vector<Value>& arguments)
+	static Value Invoke(FuncType function, const ArgumentSpan& arguments)
 	{
 		UnpackCaller().operator()<FuncType, Arity>(function, arguments);
 		return Empty;
@@ -115,11 +228,12 @@ struct FunctionWrapper<FuncType, Arity, void>
 
 template<typename FuncType>
 typename std::enable_if<
-	std::is_function<typename std::remove_pointer<FuncType>::type>::value && !std::is_same<FuncType, Value(*)(const std::vector<Value>&)>::value,
-	std::function<Value (const std::vector<Value>&)>>::type
+	std::is_function<typename std::remove_pointer<FuncType>::type>::value && !std::is_same<FuncType, Value(*)(const std::vector<Value>&)>::value &&
+	!std::is_same<FuncType, Value(*)(const ArgumentSpan&)>::value,
+	std::function<Value (const ArgumentSpan&)>>::type
 WrapFunction(FuncType function)
 {
-	return [function](const std::vector<Value>& arguments) {
+	return [function](const ArgumentSpan& arguments) {
 		constexpr size_t arity = boost::function_types::function_arity<typename std::remove_pointer<FuncType>::type>::value;
 
 		if (arity > 0) {
@@ -129,7 +243,7 @@ WrapFunction(FuncType function)
 				BOOST_THROW_EXCEPTION(std::invalid_argument("Too many arguments for function."));
 		}
 
-		using ReturnType = decltype(UnpackCaller().operator()<FuncType, arity>(*static_cast<FuncType *>(nullptr), std::vector<Value>()));
+		using ReturnType = decltype(UnpackCaller().operator()<FuncType, arity>(*static_cast<FuncType *>(nullptr), ArgumentSpan()));
 
 		return FunctionWrapper<FuncType, arity, ReturnType>::Invoke(function, arguments);
 	};
@@ -140,14 +254,14 @@ typename std::enable_if<
     std::is_class<FuncType>::value &&
     !(std::is_same<typename boost::function_types::result_type<decltype(&FuncType::operator())>::type, Value>::value &&
 	boost::function_types::function_arity<decltype(&FuncType::operator())>::value == 2),
-    std::function<Value (const std::vector<Value>&)>>::type
+    std::function<Value (const ArgumentSpan&)>>::type
 WrapFunction(FuncType function)
 {
 	static_assert(!std::is_same<typename boost::mpl::at_c<typename boost::function_types::parameter_types<decltype(&FuncType::operator())>, 1>::type, const std::vector<Value>&>::value, "Argument type must be const std::vector<Value>");
 
 	using FuncTypeInvoker = decltype(&FuncType::operator());
 
-	return [function](const std::vector<Value>& arguments) {
+	return [function](const ArgumentSpan& arguments) {
 		constexpr size_t arity = boost::function_types::function_arity<FuncTypeInvoker>::value - 1;
 
 		if (arity > 0) {
@@ -157,7 +271,7 @@ WrapFunction(FuncType function)
 				BOOST_THROW_EXCEPTION(std::invalid_argument("Too many arguments for function."));
 		}
 
-		using ReturnType = decltype(UnpackCaller().operator()<FuncType, arity>(*static_cast<FuncType *>(nullptr), std::vector<Value>()));
+		using ReturnType = decltype(UnpackCaller().operator()<FuncType, arity>(*static_cast<FuncType *>(nullptr), ArgumentSpan()));
 
 		return FunctionWrapper<FuncType, arity, ReturnType>::Invoke(function, arguments);
 	};
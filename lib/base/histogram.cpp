@@ -0,0 +1,186 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/histogram.hpp"
+#include "base/utility.hpp"
+#include <cmath>
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif /* _MSC_VER */
+
+using namespace icinga;
+
+static inline int GetMagnitude(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else /* _MSC_VER */
+	return 63 - __builtin_clzll(value);
+#endif /* _MSC_VER */
+}
+
+Histogram::Histogram(int decayInterval)
+	: m_DecayInterval(decayInterval), m_LastDecay(static_cast<int64_t>(Utility::GetTime())), m_Sum(0)
+{
+	for (std::atomic<uint_fast64_t>& bucket : m_Buckets)
+		bucket.store(0);
+}
+
+/**
+ * Returns the bucket for a value in microseconds.
+ */
+int Histogram::GetBucket(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB_BUCKETS)
+		return value;
+
+	int magnitude = GetMagnitude(value);
+
+	if (magnitude > HISTOGRAM_MAX_MAGNITUDE)
+		return HISTOGRAM_BUCKETS - 1;
+
+	return HISTOGRAM_SUB_BUCKETS * (magnitude - 3) + (value >> (magnitude - 4)) - HISTOGRAM_SUB_BUCKETS;
+}
+
+/**
+ * Returns the midpoint of a bucket in seconds.
+ */
+double Histogram::GetBucketValue(int bucket)
+{
+	if (bucket < HISTOGRAM_SUB_BUCKETS)
+		return bucket / 1000000.0;
+
+	int magnitude = bucket / HISTOGRAM_SUB_BUCKETS + 3;
+	uint64_t lower = static_cast<uint64_t>(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << (magnitude - 4);
+	uint64_t width = static_cast<uint64_t>(1) << (magnitude - 4);
+
+	return (lower + width / 2.0) / 1000000.0;
+}
+
+/**
+ * Records a value.
+ *
+ * @param value The value in seconds.
+ */
+void Histogram::Record(double value)
+{
+	int64_t now = Utility::GetCoarseTime();
+	int64_t lastDecay = m_LastDecay.load();
+
+	if (now - lastDecay >= m_DecayInterval && m_LastDecay.compare_exchange_strong(lastDecay, now))
+		Decay();
+
+	uint64_t usec = (value > 0) ? static_cast<uint64_t>(value * 1000000) : 0;
+
+	m_Buckets[GetBucket(usec)].fetch_add(1);
+	m_Sum.fetch_add(usec);
+}
+
+/**
+ * Halves all counts.
+ */
+void Histogram::Decay()
+{
+	for (std::atomic<uint_fast64_t>& bucket : m_Buckets) {
+		uint_fast64_t count = bucket.load();
+
+		while (count > 0 && !bucket.compare_exchange_weak(count, count / 2))
+			; /* empty loop body */
+	}
+
+	uint_fast64_t sum = m_Sum.load();
+
+	while (!m_Sum.compare_exchange_weak(sum, sum / 2))
+		; /* empty loop body */
+}
+
+uint_fast64_t Histogram::GetCount() const
+{
+	uint_fast64_t count = 0;
+
+	for (const std::atomic<uint_fast64_t>& bucket : m_Buckets)
+		count += bucket.load();
+
+	return count;
+}
+
+double Histogram::GetAverage() const
+{
+	uint_fast64_t count = GetCount();
+
+	if (count == 0)
+		return 0;
+
+	return m_Sum.load() / 1000000.0 / count;
+}
+
+double Histogram::GetMin() const
+{
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (m_Buckets[i].load() > 0)
+			return GetBucketValue(i);
+	}
+
+	return 0;
+}
+
+double Histogram::GetMax() const
+{
+	for (int i = HISTOGRAM_BUCKETS - 1; i >= 0; i--) {
+		if (m_Buckets[i].load() > 0)
+			return GetBucketValue(i);
+	}
+
+	return 0;
+}
+
+/**
+ * Returns an approximation of the value below which the given percentage of
+ * the recorded values falls.
+ *
+ * @param percentile The percentile, between 0 and 100.
+ * @returns The value in seconds.
+ */
+double Histogram::GetPercentile(double percentile) const
+{
+	uint_fast64_t counts[HISTOGRAM_BUCKETS];
+	uint_fast64_t total = 0;
+
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		counts[i] = m_Buckets[i].load();
+		total += counts[i];
+	}
+
+	if (total == 0)
+		return 0;
+
+	uint_fast64_t target = std::max<uint_fast64_t>(1, std::ceil(total * percentile / 100));
+	uint_fast64_t seen = 0;
+
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += counts[i];
+
+		if (seen >= target)
+			return GetBucketValue(i);
+	}
+
+	return GetBucketValue(HISTOGRAM_BUCKETS - 1);
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "base/i2-base.hpp"
+#include <atomic>
+#include <cstdint>
+
+namespace icinga
+{
+
+#define HISTOGRAM_SUB_BUCKETS 16
+#define HISTOGRAM_MAX_MAGNITUDE 40
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS * (HISTOGRAM_MAX_MAGNITUDE - 2))
+
+/**
+ * A lock-free histogram for durations. Values are stored with microsecond
+ * resolution in log-linear buckets (each power of two is split into 16
+ * sub-buckets), so quantiles have a relative error of less than 7%.
+ *
+ * The counts are halved once per decay interval so that the quantiles
+ * follow the recent values rather than those since startup.
+ *
+ * @ingroup base
+ */
+class Histogram final
+{
+public:
+	Histogram(int decayInterval = 60);
+
+	Histogram(const Histogram&) = delete;
+	Histogram& operator=(const Histogram&) = delete;
+
+	void Record(double value);
+
+	uint_fast64_t GetCount() const;
+	double GetAverage() const;
+	double GetMin() const;
+	double GetMax() const;
+	double GetPercentile(double percentile) const;
+
+	void Decay();
+
+private:
+	int m_DecayInterval;
+	std::atomic<int64_t> m_LastDecay;
+	std::atomic<uint_fast64_t> m_Sum;
+	std::atomic<uint_fast64_t> m_Buckets[HISTOGRAM_BUCKETS];
+
+	static int GetBucket(uint64_t value);
+	static double GetBucketValue(int bucket);
+};
+
+}
+
+#endif /* HISTOGRAM_H */
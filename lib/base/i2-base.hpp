@@ -97,6 +97,18 @@
 #	define unlikely(x) (x)
 #endif
 
+#if defined(__GNUC__)
+#	define I2_RETURN_ADDRESS() __builtin_return_address(0)
+#	define I2_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#	include <intrin.h>
+#	define I2_RETURN_ADDRESS() _ReturnAddress()
+#	define I2_NOINLINE __declspec(noinline)
+#else
+#	define I2_RETURN_ADDRESS() nullptr
+#	define I2_NOINLINE
+#endif
+
 #define BOOST_BIND_NO_PLACEHOLDERS
 
 #include <functional>
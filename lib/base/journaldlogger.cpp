@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/journaldlogger.hpp"
+#ifdef HAVE_SYSTEMD
+#include "base/journaldlogger-ti.cpp"
+#include "base/configtype.hpp"
+#include "base/convert.hpp"
+#include "base/statsfunction.hpp"
+#include <systemd/sd-journal.h>
+#include <syslog.h>
+#include <sys/uio.h>
+
+using namespace icinga;
+
+REGISTER_TYPE(JournaldLogger);
+
+REGISTER_STATSFUNCTION(JournaldLogger, &JournaldLogger::StatsFunc);
+
+void JournaldLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+{
+	DictionaryData nodes;
+
+	for (const JournaldLogger::Ptr& journaldlogger : ConfigType::GetObjectsByType<JournaldLogger>()) {
+		nodes.emplace_back(journaldlogger->GetName(), 1); //add more stats
+	}
+
+	status->Set("journaldlogger", new Dictionary(std::move(nodes)));
+}
+
+/**
+ * Sends a log entry to the journal. The log facility, the severity and
+ * the context of warnings and critical messages are sent as separate
+ * fields so that they can be used in journalctl filters.
+ *
+ * @param entry The log entry.
+ */
+void JournaldLogger::ProcessLogEntry(const LogEntry& entry)
+{
+	int priority;
+
+	switch (entry.Severity) {
+		case LogDebug:
+			priority = LOG_DEBUG;
+			break;
+		case LogNotice:
+			priority = LOG_NOTICE;
+			break;
+		case LogWarning:
+			priority = LOG_WARNING;
+			break;
+		case LogCritical:
+			priority = LOG_CRIT;
+			break;
+		case LogInformation:
+		default:
+			priority = LOG_INFO;
+			break;
+	}
+
+	/* Log::Submit() appends the context to the message. */
+	String message = entry.Message;
+	String context;
+
+	size_t pos = message.Find("\nContext:");
+
+	if (pos != String::NPos) {
+		context = message.SubStr(pos + 9);
+		message = message.SubStr(0, pos);
+	}
+
+	std::vector<String> fields;
+	fields.emplace_back("MESSAGE=" + message);
+	fields.emplace_back("PRIORITY=" + Convert::ToString(priority));
+	fields.emplace_back("SYSLOG_IDENTIFIER=" + GetIdentifier());
+	fields.emplace_back("ICINGA2_FACILITY=" + entry.Facility);
+	fields.emplace_back("ICINGA2_SEVERITY=" + Logger::SeverityToString(entry.Severity));
+
+	if (!context.IsEmpty())
+		fields.emplace_back("ICINGA2_CONTEXT=" + context);
+
+	std::vector<struct iovec> iov;
+	iov.reserve(fields.size());
+
+	for (const String& field : fields) {
+		struct iovec vec;
+		vec.iov_base = const_cast<char *>(field.CStr());
+		vec.iov_len = field.GetLength();
+		iov.push_back(vec);
+	}
+
+	sd_journal_sendv(iov.data(), iov.size());
+}
+
+void JournaldLogger::Flush()
+{
+	/* Nothing to do here. */
+}
+#endif /* HAVE_SYSTEMD */
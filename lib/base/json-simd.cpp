@@ -0,0 +1,697 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/json.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+
+#ifdef ICINGA2_WITH_SIMD_JSON
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif /* __SSE2__ */
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif /* _MSC_VER */
+
+using namespace icinga;
+
+/* Documents which are nested deeper than this are handed over to yajl. */
+#define JSON_SIMD_MAX_DEPTH 512
+
+/*
+ * The decoder works in two stages, similar to simdjson: The first stage
+ * classifies the input in blocks of 64 bytes and builds an index of all
+ * structural characters (operators, opening quotes and the first character
+ * of literals and numbers) outside of strings. The second stage walks that
+ * index and builds the Dictionary and Array objects.
+ *
+ * Whenever the decoder encounters something it doesn't handle in exactly
+ * the same way as yajl (invalid documents, comments, surrogate pairs, numbers
+ * which are out of range) it gives up and JsonDecode() falls back to yajl.
+ */
+
+namespace {
+
+struct JsonBlockMasks
+{
+	uint64_t Backslash;
+	uint64_t Quote;
+	uint64_t Operator;
+	uint64_t Whitespace;
+};
+
+}
+
+static inline unsigned int CountTrailingZeros(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#else /* _MSC_VER */
+	return __builtin_ctzll(value);
+#endif /* _MSC_VER */
+}
+
+static inline bool IsJsonWhitespace(char ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+static inline bool IsJsonOperator(char ch)
+{
+	return ch == '{' || ch == '}' || ch == '[' || ch == ']' || ch == ':' || ch == ',';
+}
+
+static inline bool IsJsonDigit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+static inline void ClassifyBlock(const char *block, JsonBlockMasks& masks)
+{
+#ifdef __SSE2__
+	masks = { 0, 0, 0, 0 };
+
+	for (int i = 0; i < 4; i++) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i * 16));
+
+		auto match = [&chunk](char ch) {
+			return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(ch));
+		};
+
+		/* '{' and '[' as well as '}' and ']' only differ in bit 5. */
+		__m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+		__m128i ops = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+			_mm_or_si128(match(':'), match(',')));
+		__m128i ws = _mm_or_si128(_mm_or_si128(match(' '), match('\t')), _mm_or_si128(match('\n'), match('\r')));
+
+		unsigned int shift = i * 16;
+		masks.Backslash |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(match('\\')))) << shift;
+		masks.Quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(match('"')))) << shift;
+		masks.Operator |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(ops))) << shift;
+		masks.Whitespace |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(ws))) << shift;
+	}
+#else /* __SSE2__ */
+	masks = { 0, 0, 0, 0 };
+
+	for (int i = 0; i < 64; i++) {
+		char ch = block[i];
+		uint64_t bit = static_cast<uint64_t>(1) << i;
+
+		if (ch == '\\')
+			masks.Backslash |= bit;
+		else if (ch == '"')
+			masks.Quote |= bit;
+		else if (IsJsonOperator(ch))
+			masks.Operator |= bit;
+		else if (IsJsonWhitespace(ch))
+			masks.Whitespace |= bit;
+	}
+#endif /* __SSE2__ */
+}
+
+/**
+ * Returns a mask of all characters which are escaped by an odd number of
+ * backslashes. This is the algorithm used by simdjson.
+ */
+static inline uint64_t FindEscapedCharacters(uint64_t backslash, uint64_t& prevEndsOddBackslash)
+{
+	const uint64_t evenBits = 0x5555555555555555ULL;
+	const uint64_t oddBits = ~evenBits;
+
+	uint64_t startEdges = backslash & ~(backslash << 1);
+	uint64_t evenStartMask = evenBits ^ prevEndsOddBackslash;
+	uint64_t evenStarts = startEdges & evenStartMask;
+	uint64_t oddStarts = startEdges & ~evenStartMask;
+	uint64_t evenCarries = backslash + evenStarts;
+
+	uint64_t oddCarries = backslash + oddStarts;
+	bool endsOddBackslash = oddCarries < backslash;
+
+	oddCarries |= prevEndsOddBackslash;
+	prevEndsOddBackslash = endsOddBackslash ? 1 : 0;
+
+	uint64_t evenCarryEnds = evenCarries & ~backslash;
+	uint64_t oddCarryEnds = oddCarries & ~backslash;
+
+	return (evenCarryEnds & oddBits) | (oddCarryEnds & evenBits);
+}
+
+static inline uint64_t PrefixXor(uint64_t value)
+{
+	value ^= value << 1;
+	value ^= value << 2;
+	value ^= value << 4;
+	value ^= value << 8;
+	value ^= value << 16;
+	value ^= value << 32;
+	return value;
+}
+
+static bool BuildStructuralIndex(const char *data, size_t length, std::vector<uint32_t>& index)
+{
+	if (length >= UINT32_MAX)
+		return false;
+
+	index.reserve(length / 6 + 1);
+
+	uint64_t prevEndsOddBackslash = 0;
+	uint64_t prevInString = 0;
+	uint64_t prevScalar = 0;
+
+	for (size_t offset = 0; offset < length; offset += 64) {
+		const char *block;
+		char padded[64];
+
+		if (length - offset >= 64)
+			block = data + offset;
+		else {
+			memset(padded, ' ', sizeof(padded));
+			memcpy(padded, data + offset, length - offset);
+			block = padded;
+		}
+
+		JsonBlockMasks masks;
+		ClassifyBlock(block, masks);
+
+		uint64_t quotes = masks.Quote & ~FindEscapedCharacters(masks.Backslash, prevEndsOddBackslash);
+
+		/* Set for opening quotes and the characters inside of strings, but not for closing quotes. */
+		uint64_t inString = PrefixXor(quotes) ^ prevInString;
+		prevInString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+
+		uint64_t scalar = ~(masks.Operator | masks.Whitespace | quotes | inString);
+		uint64_t scalarStarts = scalar & ~((scalar << 1) | prevScalar);
+		prevScalar = scalar >> 63;
+
+		uint64_t structurals = (masks.Operator & ~inString) | (quotes & inString) | scalarStarts;
+
+		while (structurals) {
+			index.push_back(static_cast<uint32_t>(offset + CountTrailingZeros(structurals)));
+			structurals &= structurals - 1;
+		}
+	}
+
+	/* Unterminated string */
+	if (prevInString)
+		return false;
+
+	return true;
+}
+
+static void AppendUtf8(std::string& buffer, unsigned int codepoint)
+{
+	if (codepoint < 0x80)
+		buffer += static_cast<char>(codepoint);
+	else if (codepoint < 0x800) {
+		buffer += static_cast<char>(0xC0 | (codepoint >> 6));
+		buffer += static_cast<char>(0x80 | (codepoint & 0x3F));
+	} else {
+		buffer += static_cast<char>(0xE0 | (codepoint >> 12));
+		buffer += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		buffer += static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+}
+
+static inline int HexDigitValue(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	else if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	else if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	else
+		return -1;
+}
+
+namespace {
+
+class SimdJsonParser
+{
+public:
+	SimdJsonParser(const char *data, size_t length, const std::vector<uint32_t>& index)
+		: m_Data(data), m_Length(length), m_Index(index)
+	{ }
+
+	bool Parse(Value *result)
+	{
+		if (!ParseValue(*result, 0))
+			return false;
+
+		/* trailing garbage */
+		return m_Pos == m_Index.size();
+	}
+
+private:
+	const char *m_Data;
+	size_t m_Length;
+	const std::vector<uint32_t>& m_Index;
+	size_t m_Pos{0};
+
+	/* Scratch storage per nesting level, so that the final containers can be allocated with their exact size. */
+	std::vector<DictionaryData> m_ObjectScratch;
+	std::vector<ArrayData> m_ArrayScratch;
+
+	bool Next(uint32_t& offset)
+	{
+		if (m_Pos >= m_Index.size())
+			return false;
+
+		offset = m_Index[m_Pos++];
+		return true;
+	}
+
+	bool PeekChar(char& ch) const
+	{
+		if (m_Pos >= m_Index.size())
+			return false;
+
+		ch = m_Data[m_Index[m_Pos]];
+		return true;
+	}
+
+	bool IsDelimiter(size_t offset) const
+	{
+		return offset >= m_Length || IsJsonWhitespace(m_Data[offset]) || IsJsonOperator(m_Data[offset]);
+	}
+
+	bool ParseValue(Value& value, int depth)
+	{
+		uint32_t start;
+
+		if (!Next(start))
+			return false;
+
+		switch (m_Data[start]) {
+			case '{':
+				return ParseObject(value, depth + 1);
+			case '[':
+				return ParseArray(value, depth + 1);
+			case '"':
+				{
+					String str;
+
+					if (!ParseString(start + 1, str))
+						return false;
+
+					value = std::move(str);
+					return true;
+				}
+			case 't':
+				if (!ParseLiteral(start, "true"))
+					return false;
+
+				value = true;
+				return true;
+			case 'f':
+				if (!ParseLiteral(start, "false"))
+					return false;
+
+				value = false;
+				return true;
+			case 'n':
+				if (!ParseLiteral(start, "null"))
+					return false;
+
+				value = Empty;
+				return true;
+			default:
+				return ParseNumber(start, value);
+		}
+	}
+
+	bool ParseLiteral(uint32_t start, const char *literal) const
+	{
+		size_t length = strlen(literal);
+
+		if (m_Length - start < length || memcmp(m_Data + start, literal, length) != 0)
+			return false;
+
+		return IsDelimiter(start + length);
+	}
+
+	bool ParseNumber(uint32_t start, Value& value) const
+	{
+		const char *p = m_Data + start;
+		const char *end = m_Data + m_Length;
+		bool negative = false;
+
+		if (*p == '-') {
+			negative = true;
+			p++;
+		}
+
+		if (p == end || !IsJsonDigit(*p))
+			return false;
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		bool simple = true;
+
+		if (*p == '0')
+			p++;
+		else {
+			while (p != end && IsJsonDigit(*p)) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits++;
+				p++;
+			}
+		}
+
+		if (p != end && *p == '.') {
+			p++;
+
+			if (p == end || !IsJsonDigit(*p))
+				return false;
+
+			while (p != end && IsJsonDigit(*p))
+				p++;
+
+			simple = false;
+		}
+
+		if (p != end && (*p == 'e' || *p == 'E')) {
+			p++;
+
+			if (p != end && (*p == '+' || *p == '-'))
+				p++;
+
+			if (p == end || !IsJsonDigit(*p))
+				return false;
+
+			while (p != end && IsJsonDigit(*p))
+				p++;
+
+			simple = false;
+		}
+
+		if (!IsDelimiter(p - m_Data))
+			return false;
+
+		/* Integers with up to 15 digits can be represented exactly. */
+		if (simple && digits <= 15) {
+			double result = static_cast<double>(mantissa);
+			value = negative ? -result : result;
+			return true;
+		}
+
+		/* The number is followed by a delimiter which strtod() doesn't accept either. */
+		errno = 0;
+		double result = strtod(m_Data + start, nullptr);
+
+		if (errno == ERANGE)
+			return false;
+
+		value = result;
+		return true;
+	}
+
+	bool ParseString(size_t start, String& result) const
+	{
+		size_t pos = start;
+
+		/* Fast path: Find the end of strings which don't contain any escape sequences. */
+		if (!ScanString(pos))
+			return false;
+
+		if (m_Data[pos] == '"') {
+			result = String(m_Data + start, m_Data + pos);
+			return true;
+		}
+
+		std::string buffer(m_Data + start, m_Data + pos);
+
+		for (;;) {
+			/* m_Data[pos] is a backslash */
+			if (pos + 1 >= m_Length)
+				return false;
+
+			char ch = m_Data[pos + 1];
+			pos += 2;
+
+			switch (ch) {
+				case '"':
+				case '\\':
+				case '/':
+					buffer += ch;
+					break;
+				case 'b':
+					buffer += '\b';
+					break;
+				case 'f':
+					buffer += '\f';
+					break;
+				case 'n':
+					buffer += '\n';
+					break;
+				case 'r':
+					buffer += '\r';
+					break;
+				case 't':
+					buffer += '\t';
+					break;
+				case 'u':
+					{
+						if (m_Length - pos < 4)
+							return false;
+
+						unsigned int codepoint = 0;
+
+						for (int i = 0; i < 4; i++) {
+							int digit = HexDigitValue(m_Data[pos + i]);
+
+							if (digit < 0)
+								return false;
+
+							codepoint = (codepoint << 4) | digit;
+						}
+
+						pos += 4;
+
+						/* Leave surrogates to yajl which has its own ideas about them. */
+						if (codepoint >= 0xD800 && codepoint <= 0xDFFF)
+							return false;
+
+						if (codepoint == 0)
+							buffer += '\0';
+						else
+							AppendUtf8(buffer, codepoint);
+					}
+					break;
+				default:
+					return false;
+			}
+
+			size_t runStart = pos;
+
+			if (!ScanString(pos))
+				return false;
+
+			buffer.append(m_Data + runStart, pos - runStart);
+
+			if (m_Data[pos] == '"')
+				break;
+		}
+
+		result = String(std::move(buffer));
+		return true;
+	}
+
+	/**
+	 * Advances pos to the next quote or backslash. Fails for control
+	 * characters which yajl doesn't accept inside of strings.
+	 */
+	bool ScanString(size_t& pos) const
+	{
+#ifdef __SSE2__
+		while (m_Length - pos >= 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(m_Data + pos));
+			__m128i special = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))),
+				_mm_cmpeq_epi8(_mm_max_epu8(chunk, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F)));
+
+			int mask = _mm_movemask_epi8(special);
+
+			if (mask != 0) {
+				pos += CountTrailingZeros(static_cast<uint64_t>(mask));
+				return static_cast<unsigned char>(m_Data[pos]) >= 0x20;
+			}
+
+			pos += 16;
+		}
+#endif /* __SSE2__ */
+
+		for (; pos < m_Length; pos++) {
+			auto ch = static_cast<unsigned char>(m_Data[pos]);
+
+			if (ch == '"' || ch == '\\')
+				return true;
+
+			if (ch < 0x20)
+				return false;
+		}
+
+		return false;
+	}
+
+	bool ParseObject(Value& value, int depth)
+	{
+		if (depth > JSON_SIMD_MAX_DEPTH)
+			return false;
+
+		char ch;
+
+		if (!PeekChar(ch))
+			return false;
+
+		if (ch == '}') {
+			m_Pos++;
+			value = new Dictionary();
+			return true;
+		}
+
+		if (m_ObjectScratch.size() < static_cast<size_t>(depth))
+			m_ObjectScratch.resize(depth);
+
+		/* Must not hold on to the reference while parsing nested values, m_ObjectScratch might grow. */
+		m_ObjectScratch[depth - 1].clear();
+
+		for (;;) {
+			uint32_t pos;
+
+			if (!Next(pos) || m_Data[pos] != '"')
+				return false;
+
+			String key;
+
+			if (!ParseString(pos + 1, key))
+				return false;
+
+			if (!Next(pos) || m_Data[pos] != ':')
+				return false;
+
+			Value val;
+
+			if (!ParseValue(val, depth))
+				return false;
+
+			m_ObjectScratch[depth - 1].emplace_back(std::move(key), std::move(val));
+
+			if (!Next(pos))
+				return false;
+
+			if (m_Data[pos] == '}')
+				break;
+
+			if (m_Data[pos] != ',')
+				return false;
+		}
+
+		DictionaryData& scratch = m_ObjectScratch[depth - 1];
+
+		/* Dictionary keeps the first one of several duplicate keys, yajl (like most JSON parsers) keeps the last one. */
+		value = new Dictionary(DictionaryData(std::make_move_iterator(scratch.rbegin()), std::make_move_iterator(scratch.rend())));
+		scratch.clear();
+
+		return true;
+	}
+
+	bool ParseArray(Value& value, int depth)
+	{
+		if (depth > JSON_SIMD_MAX_DEPTH)
+			return false;
+
+		char ch;
+
+		if (!PeekChar(ch))
+			return false;
+
+		if (ch == ']') {
+			m_Pos++;
+			value = new Array();
+			return true;
+		}
+
+		if (m_ArrayScratch.size() < static_cast<size_t>(depth))
+			m_ArrayScratch.resize(depth);
+
+		m_ArrayScratch[depth - 1].clear();
+
+		for (;;) {
+			Value val;
+
+			if (!ParseValue(val, depth))
+				return false;
+
+			m_ArrayScratch[depth - 1].emplace_back(std::move(val));
+
+			uint32_t pos;
+
+			if (!Next(pos))
+				return false;
+
+			if (m_Data[pos] == ']')
+				break;
+
+			if (m_Data[pos] != ',')
+				return false;
+		}
+
+		ArrayData& scratch = m_ArrayScratch[depth - 1];
+
+		value = new Array(ArrayData(std::make_move_iterator(scratch.begin()), std::make_move_iterator(scratch.end())));
+		scratch.clear();
+
+		return true;
+	}
+};
+
+}
+
+/**
+ * Decodes a JSON document using the SIMD-accelerated decoder.
+ *
+ * @param data The JSON document.
+ * @param result The decoded value.
+ * @returns true if the document was decoded, false if it has to be decoded
+ *          with yajl instead (e.g. because it's invalid).
+ */
+bool icinga::JsonDecodeSimd(const String& data, Value *result)
+{
+	std::vector<uint32_t> index;
+
+	if (!BuildStructuralIndex(data.CStr(), data.GetLength(), index) || index.empty())
+		return false;
+
+	SimdJsonParser parser(data.CStr(), data.GetLength(), index);
+
+	return parser.Parse(result);
+}
+
+#endif /* ICINGA2_WITH_SIMD_JSON */
@@ -27,6 +27,7 @@
 #include <yajl/yajl_version.h>
 #include <yajl/yajl_gen.h>
 #include <yajl/yajl_parse.h>
+#include <cstring>
 #include <stack>
 
 using namespace icinga;
@@ -135,6 +136,110 @@ String icinga::JsonEncode(const Value& value, bool pretty_print)
 	return result;
 }
 
+/* Maximum number of bytes which are buffered before they're passed to the write callback. */
+#define JSON_STREAM_BUFFER_SIZE (16 * 1024)
+
+struct JsonStreamBuffer
+{
+	explicit JsonStreamBuffer(const JsonWriteCallback& callback)
+		: Callback(callback)
+	{ }
+
+	const JsonWriteCallback& Callback;
+	char Data[JSON_STREAM_BUFFER_SIZE];
+	size_t Length{0};
+	boost::exception_ptr Exception;
+
+	void Write(const char *data, size_t count)
+	{
+		/* Drop everything after the first error, the exception is re-thrown once yajl returns. */
+		if (Exception)
+			return;
+
+		try {
+			Callback(data, count);
+		} catch (...) {
+			Exception = boost::current_exception();
+		}
+	}
+
+	void Flush()
+	{
+		if (Length > 0) {
+			Write(Data, Length);
+			Length = 0;
+		}
+	}
+};
+
+static void JsonPrintCallback(void *ctx, const char *str, yajl_size len)
+{
+	auto *buffer = static_cast<JsonStreamBuffer *>(ctx);
+
+	if (buffer->Length + len > sizeof(buffer->Data)) {
+		buffer->Flush();
+
+		if (len > sizeof(buffer->Data)) {
+			buffer->Write(str, len);
+			return;
+		}
+	}
+
+	memcpy(buffer->Data + buffer->Length, str, len);
+	buffer->Length += len;
+}
+
+/**
+ * Encodes a value as JSON and passes the result to the callback in chunks
+ * of bounded size, rather than building the whole document in memory.
+ *
+ * @param value The value.
+ * @param callback Function which is called for each chunk, never with an empty chunk.
+ * @param pretty_print Whether to pretty-print the result.
+ */
+void icinga::JsonEncode(const Value& value, const JsonWriteCallback& callback, bool pretty_print)
+{
+	JsonStreamBuffer buffer(callback);
+
+#if YAJL_MAJOR < 2
+	yajl_gen_config conf = { pretty_print, "" };
+	yajl_gen handle = yajl_gen_alloc2(JsonPrintCallback, &conf, nullptr, &buffer);
+#else /* YAJL_MAJOR */
+	yajl_gen handle = yajl_gen_alloc(nullptr);
+	yajl_gen_config(handle, yajl_gen_print_callback, JsonPrintCallback, &buffer);
+	if (pretty_print)
+		yajl_gen_config(handle, yajl_gen_beautify, 1);
+#endif /* YAJL_MAJOR */
+
+	try {
+		Encode(handle, value);
+	} catch (...) {
+		yajl_gen_free(handle);
+		throw;
+	}
+
+	yajl_gen_free(handle);
+
+	buffer.Flush();
+
+	if (buffer.Exception)
+		boost::rethrow_exception(buffer.Exception);
+}
+
+/**
+ * Encodes a value as JSON and writes it to a stream.
+ *
+ * @param value The value.
+ * @param stream The stream.
+ * @param pretty_print Whether to pretty-print the result.
+ */
+void icinga::JsonEncode(const Value& value, const Stream::Ptr& stream, bool pretty_print)
+{
+	JsonEncode(value, [&stream](const char *data, size_t count) {
+		stream->Write(data, count);
+	}, pretty_print);
+}
+
 struct JsonElement
 {
 	String Key;
@@ -145,27 +250,27 @@ struct JsonElement
 struct JsonContext
 {
 public:
-	void Push(const Value& value)
+	void Push(Value value)
 	{
 		JsonElement element;
-		element.EValue = value;
+		element.EValue = std::move(value);
 
-		m_Stack.push(element);
+		m_Stack.push(std::move(element));
 	}
 
 	JsonElement Pop()
 	{
-		JsonElement value = m_Stack.top();
+		JsonElement value = std::move(m_Stack.top());
 		m_Stack.pop();
 		return value;
 	}
 
-	void AddValue(const Value& value)
+	void AddValue(Value value)
 	{
 		if (m_Stack.empty()) {
 			JsonElement element;
-			element.EValue = value;
-			m_Stack.push(element);
+			element.EValue = std::move(value);
+			m_Stack.push(std::move(element));
 			return;
 		}
 
@@ -177,12 +282,12 @@ public:
 				element.KeySet = true;
 			} else {
 				Dictionary::Ptr dict = element.EValue;
-				dict->Set(element.Key, value);
+				dict->Set(element.Key, std::move(value));
 				element.KeySet = false;
 			}
 		} else if (element.EValue.IsObjectType<Array>()) {
 			Array::Ptr arr = element.EValue;
-			arr->Add(value);
+			arr->Add(std::move(value));
 		} else {
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot add value to JSON element."));
 		}
@@ -268,6 +373,20 @@ static int DecodeString(void *ctx, const unsigned char *str, yajl_size len)
 	return 1;
 }
 
+static int DecodeMapKey(void *ctx, const unsigned char *str, yajl_size len)
+{
+	auto *context = static_cast<JsonContext *>(ctx);
+
+	try {
+		context->AddValue(String::Intern(String(str, str + len)));
+	} catch (...) {
+		context->SaveException();
+		return 0;
+	}
+
+	return 1;
+}
+
 static int DecodeStartMap(void *ctx)
 {
 	auto *context = static_cast<JsonContext *>(ctx);
@@ -310,7 +429,26 @@ static int DecodeStartArray(void *ctx)
 	return 1;
 }
 
+/**
+ * Decodes a JSON document. Uses the SIMD-accelerated decoder if it was
+ * enabled at build time, and yajl for documents it can't handle.
+ *
+ * @param data The JSON document.
+ * @returns The decoded value.
+ */
 Value icinga::JsonDecode(const String& data)
+{
+#ifdef ICINGA2_WITH_SIMD_JSON
+	Value result;
+
+	if (JsonDecodeSimd(data, &result))
+		return result;
+#endif /* ICINGA2_WITH_SIMD_JSON */
+
+	return JsonDecodeYajl(data);
+}
+
+Value icinga::JsonDecodeYajl(const String& data)
 {
 	static const yajl_callbacks callbacks = {
 		DecodeNull,
@@ -320,7 +458,7 @@ Value icinga::JsonDecode(const String& data)
 		DecodeNumber,
 		DecodeString,
 		DecodeStartMap,
-		DecodeString,
+		DecodeMapKey,
 		DecodeEndMapOrArray,
 		DecodeStartArray,
 		DecodeEndMapOrArray
@@ -21,6 +21,8 @@
 #define JSON_H
 
 #include "base/i2-base.hpp"
+#include "base/stream.hpp"
+#include <functional>
 
 namespace icinga
 {
@@ -28,8 +30,16 @@ namespace icinga
 class String;
 class Value;
 
+typedef std::function<void (const char *data, size_t count)> JsonWriteCallback;
+
 String JsonEncode(const Value& value, bool pretty_print = false);
+void JsonEncode(const Value& value, const JsonWriteCallback& callback, bool pretty_print = false);
+void JsonEncode(const Value& value, const Stream::Ptr& stream, bool pretty_print = false);
 Value JsonDecode(const String& data);
+Value JsonDecodeYajl(const String& data);
+#ifdef ICINGA2_WITH_SIMD_JSON
+bool JsonDecodeSimd(const String& data, Value *result);
+#endif /* ICINGA2_WITH_SIMD_JSON */
 
 }
 
@@ -22,6 +22,7 @@
 #include "base/logger.hpp"
 #include "base/exception.hpp"
 #include "base/application.hpp"
+#include "base/startuptimeline.hpp"
 
 using namespace icinga;
 
@@ -32,6 +33,8 @@ using namespace icinga;
  */
 Library::Library(const String& name)
 {
+	StartupPhase phase("library loading");
+
 	String path;
 #if defined(_WIN32)
 	path = name + ".dll";
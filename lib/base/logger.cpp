@@ -26,7 +26,11 @@
 #include "base/objectlock.hpp"
 #include "base/context.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/convert.hpp"
+#include <boost/thread/tss.hpp>
+#include <algorithm>
 #include <iostream>
+#include <map>
 
 using namespace icinga;
 
@@ -43,10 +47,102 @@ template Log& Log::operator<<(const double&);
 REGISTER_TYPE(Logger);
 
 std::set<Logger::Ptr> Logger::m_Loggers;
-boost::mutex Logger::m_Mutex;
+std::shared_ptr<const std::set<Logger::Ptr> > Logger::m_LoggersSnapshot = std::make_shared<std::set<Logger::Ptr> >();
+ProfiledMutex Logger::m_Mutex("Logger");
 bool Logger::m_ConsoleLogEnabled = true;
 bool Logger::m_TimestampEnabled = true;
 LogSeverity Logger::m_ConsoleLogSeverity = LogInformation;
+std::atomic<int> Logger::m_MinLogSeverity(LogInformation);
+
+namespace icinga
+{
+
+/**
+ * A single-producer single-consumer ring buffer for log entries. Each
+ * thread that writes to an asynchronous logger has its own buffer so
+ * that submitting a log entry doesn't require any locks.
+ *
+ * @ingroup base
+ */
+struct LogRingBuffer
+{
+	static const size_t Capacity = 1024;
+
+	LogEntry Entries[Capacity];
+	std::atomic<size_t> Head{0}; /* only written by the producer */
+	std::atomic<size_t> Tail{0}; /* only written by the consumer */
+
+	bool Push(const LogEntry& entry)
+	{
+		size_t head = Head.load(std::memory_order_relaxed);
+
+		if (head - Tail.load(std::memory_order_acquire) >= Capacity)
+			return false;
+
+		Entries[head % Capacity] = entry;
+		Head.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool Pop(LogEntry& entry)
+	{
+		size_t tail = Tail.load(std::memory_order_relaxed);
+
+		if (tail == Head.load(std::memory_order_acquire))
+			return false;
+
+		entry = std::move(Entries[tail % Capacity]);
+		Tail.store(tail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool IsEmpty() const
+	{
+		return Tail.load(std::memory_order_acquire) == Head.load(std::memory_order_acquire);
+	}
+};
+
+}
+
+namespace icinga
+{
+
+struct LogRateLimitState
+{
+	double WindowStart{0};
+	int Count{0};
+	uint_fast64_t Suppressed{0};
+	LogSeverity Severity{LogDebug};
+	String Facility;
+	String LastMessage;
+};
+
+/**
+ * Rate limiting state for a subset of the message templates. The
+ * templates are spread over several shards so that threads which log
+ * different messages don't contend for the same lock.
+ *
+ * @ingroup base
+ */
+struct LogRateLimitShard
+{
+	boost::mutex Mutex;
+	std::map<String, LogRateLimitState> States;
+};
+
+}
+
+/* Number of rate limiting shards per logger. */
+#define LOG_RATELIMIT_SHARDS 16
+
+/* Maximum length of a message template which is used as a rate limiting key. */
+#define LOG_RATELIMIT_TEMPLATE_LENGTH 256
+
+static std::atomic<uint_fast64_t> l_NextAsyncLoggerID(1);
+static boost::thread_specific_ptr<std::map<uint_fast64_t, std::shared_ptr<LogRingBuffer> > > l_LogRingBuffers;
+static boost::thread_specific_ptr<bool> l_InAsyncLoggerThread;
 
 INITIALIZE_ONCE([]() {
 	ScriptGlobal::Set("LogDebug", LogDebug);
@@ -54,6 +150,10 @@ INITIALIZE_ONCE([]() {
 	ScriptGlobal::Set("LogInformation", LogInformation);
 	ScriptGlobal::Set("LogWarning", LogWarning);
 	ScriptGlobal::Set("LogCritical", LogCritical);
+
+	Logger::OnSeverityChanged.connect([](const Logger::Ptr&, const Value&) {
+		Logger::UpdateMinLogSeverity();
+	});
 });
 
 /**
@@ -63,15 +163,59 @@ void Logger::Start(bool runtimeCreated)
 {
 	ObjectImpl<Logger>::Start(runtimeCreated);
 
-	boost::mutex::scoped_lock lock(m_Mutex);
-	m_Loggers.insert(this);
+	m_RateLimitBurst = GetRateLimitBurst();
+	m_RateLimitInterval = GetRateLimitInterval();
+
+	if (m_RateLimitBurst > 0) {
+		m_RateLimitShards.reset(new LogRateLimitShard[LOG_RATELIMIT_SHARDS]);
+
+		m_RateLimitTimer = new Timer("Logger rate limit");
+		m_RateLimitTimer->SetInterval(m_RateLimitInterval);
+		m_RateLimitTimer->OnTimerExpired.connect(std::bind(&Logger::RateLimitTimerHandler, this));
+		m_RateLimitTimer->Start();
+	}
+
+	if (GetAsync()) {
+		m_AsyncID = l_NextAsyncLoggerID.fetch_add(1);
+		m_CachedMinSeverity = GetMinSeverity();
+		m_AsyncDrop = (GetAsyncOverflow() == "drop");
+		m_AsyncStopped = false;
+		m_AsyncThread = std::thread(std::bind(&Logger::AsyncThreadProc, this));
+		m_AsyncEnabled = true;
+	}
+
+	{
+		ProfiledMutex::scoped_lock lock(m_Mutex);
+		m_Loggers.insert(this);
+		std::atomic_store(&m_LoggersSnapshot, std::shared_ptr<const std::set<Logger::Ptr> >(std::make_shared<std::set<Logger::Ptr> >(m_Loggers)));
+	}
+
+	UpdateMinLogSeverity();
 }
 
 void Logger::Stop(bool runtimeRemoved)
 {
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		ProfiledMutex::scoped_lock lock(m_Mutex);
 		m_Loggers.erase(this);
+		std::atomic_store(&m_LoggersSnapshot, std::shared_ptr<const std::set<Logger::Ptr> >(std::make_shared<std::set<Logger::Ptr> >(m_Loggers)));
+	}
+
+	UpdateMinLogSeverity();
+
+	if (m_RateLimitTimer)
+		m_RateLimitTimer->Stop();
+
+	if (m_AsyncThread.joinable()) {
+		m_AsyncEnabled = false;
+
+		{
+			boost::mutex::scoped_lock lock(m_AsyncMutex);
+			m_AsyncStopped = true;
+		}
+
+		m_AsyncCV.notify_all();
+		m_AsyncThread.join();
 	}
 
 	ObjectImpl<Logger>::Stop(runtimeRemoved);
@@ -79,10 +223,314 @@ void Logger::Stop(bool runtimeRemoved)
 
 std::set<Logger::Ptr> Logger::GetLoggers()
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	ProfiledMutex::scoped_lock lock(m_Mutex);
 	return m_Loggers;
 }
 
+/**
+ * Retrieves the currently active loggers without taking a lock.
+ *
+ * @returns The loggers.
+ */
+std::shared_ptr<const std::set<Logger::Ptr> > Logger::GetLoggersSnapshot()
+{
+	return std::atomic_load(&m_LoggersSnapshot);
+}
+
+/**
+ * Passes a log entry to this logger. Synchronous loggers process the entry
+ * right away. Asynchronous loggers copy it into the calling thread's ring
+ * buffer and leave formatting and writing it to the logger's thread.
+ *
+ * @param entry The log entry.
+ */
+void Logger::SubmitLogEntry(const LogEntry& entry)
+{
+	if (entry.Severity < m_CachedMinSeverity)
+		return;
+
+	if (m_RateLimitBurst > 0 && IsRateLimited(entry))
+		return;
+
+	WriteLogEntry(entry);
+}
+
+void Logger::WriteLogEntry(const LogEntry& entry)
+{
+	if (!m_AsyncEnabled.load(std::memory_order_acquire)) {
+		ObjectLock olock(this);
+
+		if (!IsActive())
+			return;
+
+		ProcessLogEntry(entry);
+
+#ifdef I2_DEBUG /* I2_DEBUG */
+		/* Always flush, don't depend on the timer. Enable this for development sprints. */
+		//Flush();
+#endif /* I2_DEBUG */
+
+		return;
+	}
+
+	LogRingBuffer& buffer = GetThreadRingBuffer();
+
+	while (!buffer.Push(entry)) {
+		/* Never block the logger's own thread, it is the one draining the buffers. */
+		if (m_AsyncDrop || m_AsyncStopped.load() || l_InAsyncLoggerThread.get()) {
+			m_AsyncDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		m_AsyncCV.notify_one();
+		Utility::Sleep(0.001);
+	}
+
+	if (entry.Severity >= LogCritical) {
+		{
+			boost::mutex::scoped_lock lock(m_AsyncMutex);
+			m_AsyncFlushPending = true;
+		}
+
+		m_AsyncCV.notify_one();
+	}
+}
+
+/**
+ * Reduces a log message to a template by replacing quoted strings and
+ * numbers, e.g. "Connection to endpoint 'a' failed after 3 attempts"
+ * becomes "Connection to endpoint '?' failed after # attempts".
+ *
+ * @param message The log message.
+ * @returns The message template.
+ */
+String Logger::GetMessageTemplate(const String& message)
+{
+	std::string result;
+	result.reserve(std::min<size_t>(message.GetLength(), LOG_RATELIMIT_TEMPLATE_LENGTH));
+
+	bool quoted = false;
+
+	for (char ch : message.GetData()) {
+		if (result.size() >= LOG_RATELIMIT_TEMPLATE_LENGTH)
+			break;
+
+		if (ch == '\'') {
+			if (!quoted)
+				result += "'?'";
+
+			quoted = !quoted;
+		} else if (quoted) {
+			continue;
+		} else if (ch >= '0' && ch <= '9') {
+			if (result.empty() || result.back() != '#')
+				result += '#';
+		} else
+			result += ch;
+	}
+
+	return result;
+}
+
+/**
+ * Checks whether a log entry exceeds the rate limit for its message
+ * template and counts it for the summary if it does.
+ *
+ * @param entry The log entry.
+ * @returns true if the entry should be suppressed, false otherwise.
+ */
+bool Logger::IsRateLimited(const LogEntry& entry)
+{
+	String key = entry.Facility + "\n" + GetMessageTemplate(entry.Message);
+
+	LogRateLimitShard& shard = m_RateLimitShards[std::hash<std::string>()(key.GetData()) % LOG_RATELIMIT_SHARDS];
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
+
+	LogRateLimitState& state = shard.States[key];
+
+	if (entry.Timestamp - state.WindowStart >= m_RateLimitInterval) {
+		state.WindowStart = entry.Timestamp;
+		state.Count = 0;
+	}
+
+	if (state.Count < m_RateLimitBurst) {
+		state.Count++;
+		return false;
+	}
+
+	state.Suppressed++;
+	state.Facility = entry.Facility;
+	state.LastMessage = entry.Message;
+
+	if (entry.Severity > state.Severity)
+		state.Severity = entry.Severity;
+
+	return true;
+}
+
+/**
+ * Writes a summary for each message template which had suppressed log
+ * entries and forgets about templates which weren't used recently.
+ */
+void Logger::RateLimitTimerHandler()
+{
+	double now = Utility::GetTime();
+	std::vector<LogEntry> summaries;
+
+	for (int i = 0; i < LOG_RATELIMIT_SHARDS; i++) {
+		LogRateLimitShard& shard = m_RateLimitShards[i];
+
+		boost::mutex::scoped_lock lock(shard.Mutex);
+
+		for (auto it = shard.States.begin(); it != shard.States.end(); ) {
+			LogRateLimitState& state = it->second;
+
+			if (state.Suppressed > 0) {
+				LogEntry summary;
+				summary.Timestamp = now;
+				summary.Severity = state.Severity;
+				summary.Facility = state.Facility;
+				summary.Message = Convert::ToString(state.Suppressed) + " similar messages suppressed, last one: " + state.LastMessage;
+				summaries.emplace_back(std::move(summary));
+
+				state.Suppressed = 0;
+				state.Severity = LogDebug;
+				state.LastMessage = String();
+			}
+
+			if (now - state.WindowStart >= 2 * m_RateLimitInterval)
+				it = shard.States.erase(it);
+			else
+				it++;
+		}
+	}
+
+	for (const LogEntry& summary : summaries)
+		WriteLogEntry(summary);
+}
+
+/**
+ * Retrieves the number of log entries which were dropped because
+ * the asynchronous logger couldn't keep up.
+ *
+ * @returns The number of dropped log entries.
+ */
+uint_fast64_t Logger::GetDroppedLogEntries() const
+{
+	return m_AsyncDropped.load();
+}
+
+LogRingBuffer& Logger::GetThreadRingBuffer()
+{
+	auto *buffers = l_LogRingBuffers.get();
+
+	if (!buffers) {
+		buffers = new std::map<uint_fast64_t, std::shared_ptr<LogRingBuffer> >();
+		l_LogRingBuffers.reset(buffers);
+	}
+
+	std::shared_ptr<LogRingBuffer>& buffer = (*buffers)[m_AsyncID];
+
+	if (!buffer) {
+		buffer = std::make_shared<LogRingBuffer>();
+
+		boost::mutex::scoped_lock lock(m_AsyncMutex);
+		m_AsyncBuffers.push_back(buffer);
+	}
+
+	return *buffer;
+}
+
+void Logger::AsyncThreadProc()
+{
+	Utility::SetThreadName("Async Logger");
+
+	l_InAsyncLoggerThread.reset(new bool(true));
+
+	for (;;) {
+		bool stopped;
+
+		{
+			boost::mutex::scoped_lock lock(m_AsyncMutex);
+
+			if (!m_AsyncFlushPending && !m_AsyncStopped)
+				m_AsyncCV.timed_wait(lock, boost::posix_time::milliseconds(100));
+
+			m_AsyncFlushPending = false;
+			stopped = m_AsyncStopped;
+		}
+
+		ProcessAsyncEntries();
+
+		if (stopped)
+			break;
+	}
+}
+
+/**
+ * Drains the ring buffers of all threads and writes their entries
+ * in a single batch. Critical entries are flushed immediately.
+ */
+void Logger::ProcessAsyncEntries()
+{
+	std::vector<std::shared_ptr<LogRingBuffer> > buffers;
+
+	{
+		boost::mutex::scoped_lock lock(m_AsyncMutex);
+
+		/* Buffers which are only referenced by us belong to threads which have exited. */
+		m_AsyncBuffers.erase(std::remove_if(m_AsyncBuffers.begin(), m_AsyncBuffers.end(),
+			[](const std::shared_ptr<LogRingBuffer>& buffer) { return buffer.use_count() == 1 && buffer->IsEmpty(); }),
+			m_AsyncBuffers.end());
+
+		buffers = m_AsyncBuffers;
+	}
+
+	std::vector<LogEntry> entries;
+
+	for (const std::shared_ptr<LogRingBuffer>& buffer : buffers) {
+		LogEntry entry;
+
+		while (buffer->Pop(entry))
+			entries.push_back(std::move(entry));
+	}
+
+	uint_fast64_t dropped = m_AsyncDropped.load() - m_AsyncReportedDropped;
+
+	if (entries.empty() && dropped == 0)
+		return;
+
+	std::stable_sort(entries.begin(), entries.end(), [](const LogEntry& a, const LogEntry& b) {
+		return a.Timestamp < b.Timestamp;
+	});
+
+	bool flush = false;
+
+	ObjectLock olock(this);
+
+	for (const LogEntry& entry : entries) {
+		ProcessLogEntry(entry);
+
+		if (entry.Severity >= LogCritical)
+			flush = true;
+	}
+
+	if (dropped > 0) {
+		m_AsyncReportedDropped += dropped;
+
+		LogEntry entry;
+		entry.Timestamp = Utility::GetCoarseTime();
+		entry.Severity = LogWarning;
+		entry.Facility = "Logger";
+		entry.Message = "Dropped " + Convert::ToString(dropped) + " log entries because the log buffer was full.";
+		ProcessLogEntry(entry);
+	}
+
+	if (flush)
+		Flush();
+}
+
 /**
  * Retrieves the minimum severity for this logger.
  *
@@ -151,11 +599,13 @@ LogSeverity Logger::StringToSeverity(const String& severity)
 void Logger::DisableConsoleLog()
 {
 	m_ConsoleLogEnabled = false;
+	UpdateMinLogSeverity();
 }
 
 void Logger::EnableConsoleLog()
 {
 	m_ConsoleLogEnabled = true;
+	UpdateMinLogSeverity();
 }
 
 bool Logger::IsConsoleLogEnabled()
@@ -166,6 +616,32 @@ bool Logger::IsConsoleLogEnabled()
 void Logger::SetConsoleLogSeverity(LogSeverity logSeverity)
 {
 	m_ConsoleLogSeverity = logSeverity;
+	UpdateMinLogSeverity();
+}
+
+/**
+ * Recalculates the lowest severity any active logger is interested in.
+ * Log messages below this severity aren't formatted at all.
+ */
+void Logger::UpdateMinLogSeverity()
+{
+	ProfiledMutex::scoped_lock lock(m_Mutex);
+
+	int severity = LogCritical + 1;
+
+	if (m_ConsoleLogEnabled)
+		severity = m_ConsoleLogSeverity;
+
+	for (const Logger::Ptr& logger : m_Loggers) {
+		LogSeverity minSeverity = logger->GetMinSeverity();
+
+		logger->m_CachedMinSeverity = minSeverity;
+
+		if (minSeverity < severity)
+			severity = minSeverity;
+	}
+
+	m_MinLogSeverity.store(severity);
 }
 
 LogSeverity Logger::GetConsoleLogSeverity()
@@ -199,26 +675,40 @@ void Logger::ValidateSeverity(const Lazy<String>& lvalue, const ValidationUtils&
 	}
 }
 
-Log::Log(LogSeverity severity, String facility, const String& message)
-	: m_Severity(severity), m_Facility(std::move(facility))
+void Logger::ValidateRateLimitBurst(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<Logger>::ValidateRateLimitBurst(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "rate_limit_burst" }, "Value must not be negative."));
+}
+
+void Logger::ValidateRateLimitInterval(const Lazy<double>& lvalue, const ValidationUtils& utils)
 {
-	m_Buffer << message;
+	ObjectImpl<Logger>::ValidateRateLimitInterval(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "rate_limit_interval" }, "Value must be greater than 0."));
 }
 
-Log::Log(LogSeverity severity, String facility)
-	: m_Severity(severity), m_Facility(std::move(facility))
-{ }
+void Logger::ValidateAsyncOverflow(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<Logger>::ValidateAsyncOverflow(lvalue, utils);
+
+	if (lvalue() != "block" && lvalue() != "drop")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "async_overflow" }, "Invalid overflow policy specified: " + lvalue()));
+}
 
 /**
  * Writes the message to the application's log.
  */
-Log::~Log()
+void Log::Submit()
 {
 	LogEntry entry;
-	entry.Timestamp = Utility::GetTime();
+	entry.Timestamp = Utility::GetCoarseTime();
 	entry.Severity = m_Severity;
 	entry.Facility = m_Facility;
-	entry.Message = m_Buffer.str();
+	entry.Message = m_Buffer->str();
 
 	if (m_Severity >= LogWarning) {
 		ContextTrace context;
@@ -230,20 +720,10 @@ Log::~Log()
 		}
 	}
 
-	for (const Logger::Ptr& logger : Logger::GetLoggers()) {
-		ObjectLock llock(logger);
-
-		if (!logger->IsActive())
-			continue;
+	auto loggers = Logger::GetLoggersSnapshot();
 
-		if (entry.Severity >= logger->GetMinSeverity())
-			logger->ProcessLogEntry(entry);
-
-#ifdef I2_DEBUG /* I2_DEBUG */
-		/* Always flush, don't depend on the timer. Enable this for development sprints. */
-		//logger->Flush();
-#endif /* I2_DEBUG */
-	}
+	for (const Logger::Ptr& logger : *loggers)
+		logger->SubmitLogEntry(entry);
 
 	if (Logger::IsConsoleLogEnabled() && entry.Severity >= Logger::GetConsoleLogSeverity())
 		StreamLogger::ProcessLogEntry(std::cout, entry);
@@ -251,6 +731,8 @@ Log::~Log()
 
 Log& Log::operator<<(const char *val)
 {
-	m_Buffer << val;
+	if (m_Buffer)
+		*m_Buffer << val;
+
 	return *this;
 }
@@ -22,8 +22,16 @@
 
 #include "base/i2-base.hpp"
 #include "base/logger-ti.hpp"
+#include "base/timer.hpp"
+#include "base/profiledmutex.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <set>
-#include <iosfwd>
+#include <thread>
+#include <vector>
+#include <sstream>
 
 namespace icinga
 {
@@ -54,6 +62,9 @@ struct LogEntry {
 	String Message; /**< The log entry's message. */
 };
 
+struct LogRingBuffer;
+struct LogRateLimitShard;
+
 /**
  * A log provider.
  *
@@ -79,7 +90,11 @@ public:
 
 	virtual void Flush() = 0;
 
+	void SubmitLogEntry(const LogEntry& entry);
+	uint_fast64_t GetDroppedLogEntries() const;
+
 	static std::set<Logger::Ptr> GetLoggers();
+	static std::shared_ptr<const std::set<Logger::Ptr> > GetLoggersSnapshot();
 
 	static void DisableConsoleLog();
 	static void EnableConsoleLog();
@@ -91,20 +106,73 @@ public:
 	static void SetConsoleLogSeverity(LogSeverity logSeverity);
 	static LogSeverity GetConsoleLogSeverity();
 
+	/**
+	 * Retrieves the lowest severity any active logger (including the
+	 * console) is interested in.
+	 *
+	 * @returns The severity.
+	 */
+	static LogSeverity GetMinLogSeverity()
+	{
+		return static_cast<LogSeverity>(m_MinLogSeverity.load(std::memory_order_relaxed));
+	}
+
+	static void UpdateMinLogSeverity();
+
+	static String GetMessageTemplate(const String& message);
+
 	void ValidateSeverity(const Lazy<String>& lvalue, const ValidationUtils& utils) final;
+	void ValidateAsyncOverflow(const Lazy<String>& lvalue, const ValidationUtils& utils) final;
+	void ValidateRateLimitBurst(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+	void ValidateRateLimitInterval(const Lazy<double>& lvalue, const ValidationUtils& utils) final;
 
 protected:
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
 private:
-	static boost::mutex m_Mutex;
+	static ProfiledMutex m_Mutex;
 	static std::set<Logger::Ptr> m_Loggers;
+	static std::shared_ptr<const std::set<Logger::Ptr> > m_LoggersSnapshot;
 	static bool m_ConsoleLogEnabled;
 	static bool m_TimestampEnabled;
 	static LogSeverity m_ConsoleLogSeverity;
+	static std::atomic<int> m_MinLogSeverity;
+
+	uint_fast64_t m_AsyncID{0};
+	std::atomic<bool> m_AsyncEnabled{false};
+	std::atomic<bool> m_AsyncStopped{false};
+	bool m_AsyncDrop{false};
+	std::atomic<int> m_CachedMinSeverity{LogInformation};
+	bool m_AsyncFlushPending{false};
+	uint_fast64_t m_AsyncReportedDropped{0};
+	std::thread m_AsyncThread;
+	mutable boost::mutex m_AsyncMutex;
+	boost::condition_variable m_AsyncCV;
+	std::vector<std::shared_ptr<LogRingBuffer> > m_AsyncBuffers;
+	std::atomic<uint_fast64_t> m_AsyncDropped{0};
+
+	int m_RateLimitBurst{0};
+	double m_RateLimitInterval{0};
+	std::unique_ptr<LogRateLimitShard[]> m_RateLimitShards;
+	Timer::Ptr m_RateLimitTimer;
+
+	void WriteLogEntry(const LogEntry& entry);
+	bool IsRateLimited(const LogEntry& entry);
+	void RateLimitTimerHandler();
+
+	LogRingBuffer& GetThreadRingBuffer();
+	void AsyncThreadProc();
+	void ProcessAsyncEntries();
 };
 
+/**
+ * Writes a message to the application's log. Messages with a severity
+ * no active logger is interested in are discarded without formatting
+ * their arguments.
+ *
+ * @ingroup base
+ */
 class Log
 {
 public:
@@ -112,24 +180,68 @@ public:
 	Log(const Log& other) = delete;
 	Log& operator=(const Log& rhs) = delete;
 
-	Log(LogSeverity severity, String facility, const String& message);
-	Log(LogSeverity severity, String facility);
+	Log(LogSeverity severity, String facility, const String& message)
+		: m_Severity(severity)
+	{
+		if (!IsEnabled(severity))
+			return;
+
+		m_Facility = std::move(facility);
+		m_Buffer.reset(new std::ostringstream());
+		*m_Buffer << message;
+	}
+
+	Log(LogSeverity severity, String facility)
+		: m_Severity(severity)
+	{
+		if (!IsEnabled(severity))
+			return;
 
-	~Log();
+		m_Facility = std::move(facility);
+		m_Buffer.reset(new std::ostringstream());
+	}
+
+	~Log()
+	{
+		if (m_Buffer)
+			Submit();
+	}
 
 	template<typename T>
 	Log& operator<<(const T& val)
 	{
-		m_Buffer << val;
+		if (m_Buffer)
+			*m_Buffer << val;
+
 		return *this;
 	}
 
 	Log& operator<<(const char *val);
 
+	/**
+	 * Checks whether messages with the specified severity are written
+	 * to any log. Debug messages are removed from release builds which
+	 * were configured with ICINGA2_STRIP_DEBUG_LOG.
+	 *
+	 * @param severity The severity.
+	 * @returns true if the messages are logged, false otherwise.
+	 */
+	static bool IsEnabled(LogSeverity severity)
+	{
+#if defined(ICINGA2_STRIP_DEBUG_LOG) && !defined(I2_DEBUG)
+		if (severity == LogDebug)
+			return false;
+#endif /* ICINGA2_STRIP_DEBUG_LOG && !I2_DEBUG */
+
+		return severity >= Logger::GetMinLogSeverity();
+	}
+
 private:
 	LogSeverity m_Severity;
 	String m_Facility;
-	std::ostringstream m_Buffer;
+	std::unique_ptr<std::ostringstream> m_Buffer;
+
+	void Submit();
 };
 
 extern template Log& Log::operator<<(const Value&);
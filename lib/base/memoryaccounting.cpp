@@ -0,0 +1,306 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/memoryaccounting.hpp"
+#include "base/configtype.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <vector>
+#ifdef ICINGA2_WITH_MEMORY_ACCOUNTING
+#	include <boost/thread/tss.hpp>
+#	include <typeindex>
+#	include <unordered_map>
+#endif /* ICINGA2_WITH_MEMORY_ACCOUNTING */
+#if defined(__GLIBC__) || defined(_WIN32)
+#	include <malloc.h>
+#endif /* defined(__GLIBC__) || defined(_WIN32) */
+#ifdef __APPLE__
+#	include <malloc/malloc.h>
+#endif /* __APPLE__ */
+
+using namespace icinga;
+
+REGISTER_STATSFUNCTION(Memory, &MemoryAccounting::StatsFunc);
+
+#ifdef ICINGA2_WITH_MEMORY_ACCOUNTING
+/* The allocation site is recorded for every n-th object per thread. */
+#define MA_SITE_SAMPLE_INTERVAL 1024
+
+namespace icinga
+{
+
+struct MemoryAccountingType
+{
+	String Name;
+	std::atomic<int64_t> Live{0};
+	std::atomic<uint64_t> Created{0};
+	std::atomic<int64_t> Bytes{0};
+	std::unordered_map<const void *, uint64_t> Sites; /* protected by l_TypesMutex */
+};
+
+}
+
+/* Types are never removed, threads cache them without having to lock. */
+static boost::mutex l_TypesMutex;
+static std::unordered_map<std::type_index, MemoryAccountingType *> l_Types;
+
+struct MemoryAccountingThreadState
+{
+	std::unordered_map<std::type_index, MemoryAccountingType *> Types;
+	unsigned int SampleCounter{0};
+};
+
+static boost::thread_specific_ptr<MemoryAccountingThreadState> l_ThreadState;
+
+static size_t GetAllocationSize(Object *object)
+{
+	void *ptr = dynamic_cast<void *>(object);
+
+#if defined(__GLIBC__)
+	return malloc_usable_size(ptr);
+#elif defined(__APPLE__)
+	return malloc_size(ptr);
+#elif defined(_WIN32)
+	return _msize(ptr);
+#else /* __GLIBC__ */
+	(void)ptr;
+	return 0;
+#endif /* __GLIBC__ */
+}
+
+/**
+ * Accounts for an object which just got its first reference. Objects are
+ * attributed to their dynamic type at that point, i.e. objects which take
+ * a reference to themselves in a base class constructor are counted for
+ * that base class.
+ *
+ * Objects which get a reference are always heap-allocated because the last
+ * reference deletes them, so asking the allocator for their size is safe.
+ *
+ * @param object The object.
+ * @param site The code address which took the reference.
+ */
+void MemoryAccounting::AddObject(Object *object, const void *site)
+{
+	MemoryAccountingThreadState *state = l_ThreadState.get();
+
+	if (!state) {
+		state = new MemoryAccountingThreadState();
+		l_ThreadState.reset(state);
+	}
+
+	std::type_index key(typeid(*object));
+	MemoryAccountingType *type;
+
+	auto it = state->Types.find(key);
+
+	if (it != state->Types.end())
+		type = it->second;
+	else {
+		boost::mutex::scoped_lock lock(l_TypesMutex);
+
+		MemoryAccountingType*& entry = l_Types[key];
+
+		if (!entry) {
+			entry = new MemoryAccountingType();
+			entry->Name = Utility::GetTypeName(typeid(*object));
+		}
+
+		type = entry;
+		state->Types[key] = type;
+	}
+
+	size_t bytes = GetAllocationSize(object);
+
+	object->m_AccountingType = type;
+	object->m_AccountedBytes = bytes;
+
+	type->Live.fetch_add(1, std::memory_order_relaxed);
+	type->Created.fetch_add(1, std::memory_order_relaxed);
+	type->Bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+	if (++state->SampleCounter % MA_SITE_SAMPLE_INTERVAL == 0) {
+		boost::mutex::scoped_lock lock(l_TypesMutex);
+		type->Sites[site]++;
+	}
+}
+
+/**
+ * Accounts for an object which is about to be deleted.
+ *
+ * @param object The object.
+ */
+void MemoryAccounting::RemoveObject(Object *object)
+{
+	MemoryAccountingType *type = object->m_AccountingType;
+
+	if (!type)
+		return;
+
+	type->Live.fetch_sub(1, std::memory_order_relaxed);
+	type->Bytes.fetch_sub(object->m_AccountedBytes, std::memory_order_relaxed);
+}
+
+static Dictionary::Ptr GetTypeStats(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	struct TypeSnapshot
+	{
+		String Name;
+		int64_t Live;
+		uint64_t Created;
+		int64_t Bytes;
+		std::vector<std::pair<const void *, uint64_t> > Sites;
+	};
+
+	/* Take a snapshot first, building the result allocates objects
+	 * which need l_TypesMutex for their own accounting. */
+	std::vector<TypeSnapshot> snapshot;
+
+	{
+		boost::mutex::scoped_lock lock(l_TypesMutex);
+
+		snapshot.reserve(l_Types.size());
+
+		for (const auto& kv : l_Types) {
+			const MemoryAccountingType *type = kv.second;
+
+			snapshot.push_back({ type->Name, type->Live.load(), type->Created.load(), type->Bytes.load(),
+				std::vector<std::pair<const void *, uint64_t> >(type->Sites.begin(), type->Sites.end()) });
+		}
+	}
+
+	std::sort(snapshot.begin(), snapshot.end(), [](const TypeSnapshot& a, const TypeSnapshot& b) {
+		return a.Bytes > b.Bytes;
+	});
+
+	DictionaryData types;
+	int64_t totalLive = 0, totalBytes = 0;
+
+	for (TypeSnapshot& type : snapshot) {
+		totalLive += type.Live;
+		totalBytes += type.Bytes;
+
+		std::sort(type.Sites.begin(), type.Sites.end(), [](const std::pair<const void *, uint64_t>& a,
+			const std::pair<const void *, uint64_t>& b) {
+			return a.second > b.second;
+		});
+
+		if (type.Sites.size() > 10)
+			type.Sites.resize(10);
+
+		ArrayData sites;
+
+		for (const auto& site : type.Sites) {
+			sites.emplace_back(new Dictionary({
+				{ "site", Utility::FormatCodeAddress(site.first) },
+				{ "sampled", site.second }
+			}));
+		}
+
+		types.emplace_back(type.Name, new Dictionary({
+			{ "live", type.Live },
+			{ "created", type.Created },
+			{ "bytes", type.Bytes },
+			{ "avg_bytes", type.Live > 0 ? type.Bytes / static_cast<double>(type.Live) : 0 },
+			{ "sites", new Array(std::move(sites)) }
+		}));
+	}
+
+	status->Set("objects", new Dictionary({
+		{ "live", totalLive },
+		{ "bytes", totalBytes },
+		{ "site_sample_interval", MA_SITE_SAMPLE_INTERVAL }
+	}));
+
+	perfdata->Add(new PerfdataValue("memory_objects", totalLive));
+	perfdata->Add(new PerfdataValue("memory_object_bytes", totalBytes));
+
+	return new Dictionary(std::move(types));
+}
+#endif /* ICINGA2_WITH_MEMORY_ACCOUNTING */
+
+/**
+ * Returns whether the per-type counters are available.
+ */
+bool MemoryAccounting::IsEnabled()
+{
+#ifdef ICINGA2_WITH_MEMORY_ACCOUNTING
+	return true;
+#else /* ICINGA2_WITH_MEMORY_ACCOUNTING */
+	return false;
+#endif /* ICINGA2_WITH_MEMORY_ACCOUNTING */
+}
+
+void MemoryAccounting::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	status->Set("accounting", IsEnabled());
+
+#ifdef __linux__
+	std::ifstream fp("/proc/self/statm");
+	unsigned long vsize, rss;
+
+	if (fp >> vsize >> rss) {
+		long pageSize = sysconf(_SC_PAGESIZE);
+
+		status->Set("process", new Dictionary({
+			{ "virtual", static_cast<double>(vsize) * pageSize },
+			{ "rss", static_cast<double>(rss) * pageSize }
+		}));
+
+		perfdata->Add(new PerfdataValue("memory_rss", static_cast<double>(rss) * pageSize));
+	}
+#endif /* __linux__ */
+
+#ifdef __GLIBC__
+#	if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 mi = mallinfo2();
+#	else /* __GLIBC__ */
+	struct mallinfo mi = mallinfo();
+#	endif /* __GLIBC__ */
+
+	status->Set("heap", new Dictionary({
+		{ "arena", static_cast<double>(mi.arena) },
+		{ "mmap", static_cast<double>(mi.hblkhd) },
+		{ "in_use", static_cast<double>(mi.uordblks) + mi.hblkhd },
+		{ "free", static_cast<double>(mi.fordblks) }
+	}));
+
+	perfdata->Add(new PerfdataValue("memory_heap_in_use", static_cast<double>(mi.uordblks) + mi.hblkhd));
+#endif /* __GLIBC__ */
+
+	DictionaryData configObjects;
+
+	for (const Type::Ptr& type : Type::GetAllTypes()) {
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		if (ctype)
+			configObjects.emplace_back(type->GetName(), ctype->GetObjectCount());
+	}
+
+	status->Set("config_objects", new Dictionary(std::move(configObjects)));
+
+#ifdef ICINGA2_WITH_MEMORY_ACCOUNTING
+	status->Set("types", GetTypeStats(status, perfdata));
+#endif /* ICINGA2_WITH_MEMORY_ACCOUNTING */
+}
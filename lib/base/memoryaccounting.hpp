@@ -0,0 +1,59 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include "base/i2-base.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+
+namespace icinga
+{
+
+class Object;
+struct MemoryAccountingType;
+
+/**
+ * Keeps track of the number of live objects and the approximate number of
+ * bytes they use per type. For a sample of all objects the allocation site
+ * (i.e. the code which took the first reference) is recorded.
+ *
+ * The per-type counters are only available when Icinga was built with
+ * ICINGA2_WITH_MEMORY_ACCOUNTING. The "Memory" stats function (i.e.
+ * /v1/status/Memory) always reports the process and heap sizes.
+ *
+ * @ingroup base
+ */
+class MemoryAccounting
+{
+public:
+	static bool IsEnabled();
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+#ifdef ICINGA2_WITH_MEMORY_ACCOUNTING
+	static void AddObject(Object *object, const void *site);
+	static void RemoveObject(Object *object);
+#endif /* ICINGA2_WITH_MEMORY_ACCOUNTING */
+};
+
+}
+
+#endif /* MEMORYACCOUNTING_H */
@@ -0,0 +1,411 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/msgpack.hpp"
+#include "base/debug.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/objectlock.hpp"
+#include "base/exception.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+using namespace icinga;
+
+/* Values which are nested deeper than this are rejected by the decoder. */
+#define MSGPACK_MAX_DEPTH 128
+
+static void Encode(std::string& buf, const Value& value);
+
+static void EncodeBigEndian(std::string& buf, uint64_t value, int bytes)
+{
+	for (int i = bytes - 1; i >= 0; i--)
+		buf += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+static void EncodeHeader(std::string& buf, size_t length, unsigned char fixType, size_t fixMax,
+	unsigned char type8, unsigned char type16, unsigned char type32)
+{
+	if (length <= fixMax)
+		buf += static_cast<char>(fixType | length);
+	else if (type8 && length <= 0xff) {
+		buf += static_cast<char>(type8);
+		EncodeBigEndian(buf, length, 1);
+	} else if (length <= 0xffff) {
+		buf += static_cast<char>(type16);
+		EncodeBigEndian(buf, length, 2);
+	} else {
+		buf += static_cast<char>(type32);
+		EncodeBigEndian(buf, length, 4);
+	}
+}
+
+static void EncodeString(std::string& buf, const String& str)
+{
+	EncodeHeader(buf, str.GetLength(), 0xa0, 31, 0xd9, 0xda, 0xdb);
+	buf.append(str.CStr(), str.GetLength());
+}
+
+static void EncodeNumber(std::string& buf, double value)
+{
+	/* Just like the JSON encoder we don't transfer NaN or infinity. */
+	if (!std::isfinite(value))
+		value = 0;
+
+	/* Integers (timestamps without fractions, counters, states) are sent in their shortest form. */
+	if (value == std::floor(value) && value >= -9223372036854775808.0 && value < 9223372036854775808.0 && !(value == 0 && std::signbit(value))) {
+		auto ival = static_cast<int64_t>(value);
+
+		if (ival >= 0) {
+			auto uval = static_cast<uint64_t>(ival);
+
+			if (uval <= 0x7f)
+				buf += static_cast<char>(uval);
+			else if (uval <= 0xff) {
+				buf += static_cast<char>(0xcc);
+				EncodeBigEndian(buf, uval, 1);
+			} else if (uval <= 0xffff) {
+				buf += static_cast<char>(0xcd);
+				EncodeBigEndian(buf, uval, 2);
+			} else if (uval <= 0xffffffff) {
+				buf += static_cast<char>(0xce);
+				EncodeBigEndian(buf, uval, 4);
+			} else {
+				buf += static_cast<char>(0xcf);
+				EncodeBigEndian(buf, uval, 8);
+			}
+		} else {
+			auto uval = static_cast<uint64_t>(ival);
+
+			if (ival >= -32)
+				buf += static_cast<char>(uval & 0xff);
+			else if (ival >= INT8_MIN) {
+				buf += static_cast<char>(0xd0);
+				EncodeBigEndian(buf, uval, 1);
+			} else if (ival >= INT16_MIN) {
+				buf += static_cast<char>(0xd1);
+				EncodeBigEndian(buf, uval, 2);
+			} else if (ival >= INT32_MIN) {
+				buf += static_cast<char>(0xd2);
+				EncodeBigEndian(buf, uval, 4);
+			} else {
+				buf += static_cast<char>(0xd3);
+				EncodeBigEndian(buf, uval, 8);
+			}
+		}
+
+		return;
+	}
+
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	buf += static_cast<char>(0xcb);
+	EncodeBigEndian(buf, bits, 8);
+}
+
+static void EncodeDictionary(std::string& buf, const Dictionary::Ptr& dict)
+{
+	ObjectLock olock(dict);
+
+	EncodeHeader(buf, dict->GetLength(), 0x80, 15, 0, 0xde, 0xdf);
+
+	for (const Dictionary::Pair& kv : dict) {
+		EncodeString(buf, kv.first);
+		Encode(buf, kv.second);
+	}
+}
+
+static void EncodeArray(std::string& buf, const Array::Ptr& arr)
+{
+	ObjectLock olock(arr);
+
+	EncodeHeader(buf, arr->GetLength(), 0x90, 15, 0, 0xdc, 0xdd);
+
+	for (const Value& value : arr) {
+		Encode(buf, value);
+	}
+}
+
+static void Encode(std::string& buf, const Value& value)
+{
+	switch (value.GetType()) {
+		case ValueNumber:
+			EncodeNumber(buf, value.Get<double>());
+
+			break;
+		case ValueBoolean:
+			buf += static_cast<char>(value.ToBool() ? 0xc3 : 0xc2);
+
+			break;
+		case ValueString:
+			EncodeString(buf, value.Get<String>());
+
+			break;
+		case ValueObject:
+			{
+				const Object::Ptr& obj = value.Get<Object::Ptr>();
+				Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(obj);
+
+				if (dict) {
+					EncodeDictionary(buf, dict);
+					break;
+				}
+
+				Array::Ptr arr = dynamic_pointer_cast<Array>(obj);
+
+				if (arr) {
+					EncodeArray(buf, arr);
+					break;
+				}
+			}
+
+			buf += static_cast<char>(0xc0);
+
+			break;
+		case ValueEmpty:
+			buf += static_cast<char>(0xc0);
+
+			break;
+		default:
+			VERIFY(!"Invalid variant type.");
+	}
+}
+
+/**
+ * Encodes a value in the MessagePack format. Dictionaries, arrays, strings,
+ * numbers, booleans and null are supported, just like with JsonEncode().
+ *
+ * @param value The value.
+ * @returns The encoded data.
+ */
+String icinga::MsgPackEncode(const Value& value)
+{
+	std::string buf;
+	buf.reserve(256);
+
+	Encode(buf, value);
+
+	return buf;
+}
+
+namespace {
+
+class MsgPackDecoder
+{
+public:
+	MsgPackDecoder(const String& data)
+		: m_Data(reinterpret_cast<const unsigned char *>(data.CStr())), m_Length(data.GetLength())
+	{ }
+
+	Value Decode()
+	{
+		Value result = DecodeValue(0);
+
+		if (m_Position != m_Length)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Trailing data after MessagePack value."));
+
+		return result;
+	}
+
+private:
+	const unsigned char *m_Data;
+	size_t m_Length;
+	size_t m_Position{0};
+
+	void Need(size_t count) const
+	{
+		if (m_Length - m_Position < count)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Unexpected end of MessagePack data."));
+	}
+
+	uint64_t ReadBigEndian(int bytes)
+	{
+		Need(bytes);
+
+		uint64_t value = 0;
+
+		for (int i = 0; i < bytes; i++)
+			value = (value << 8) | m_Data[m_Position++];
+
+		return value;
+	}
+
+	String ReadString(size_t length)
+	{
+		Need(length);
+
+		String result(m_Data + m_Position, m_Data + m_Position + length);
+		m_Position += length;
+
+		return result;
+	}
+
+	String DecodeKey()
+	{
+		Need(1);
+
+		unsigned char type = m_Data[m_Position++];
+
+		if ((type & 0xe0) == 0xa0)
+			return ReadString(type & 0x1f);
+
+		switch (type) {
+			case 0xd9:
+			case 0xc4:
+				return ReadString(ReadBigEndian(1));
+			case 0xda:
+			case 0xc5:
+				return ReadString(ReadBigEndian(2));
+			case 0xdb:
+			case 0xc6:
+				return ReadString(ReadBigEndian(4));
+			default:
+				BOOST_THROW_EXCEPTION(std::invalid_argument("MessagePack map keys must be strings."));
+		}
+	}
+
+	Value DecodeArray(size_t length, int depth)
+	{
+		/* Every element takes at least one byte. */
+		Need(length);
+
+		ArrayData result;
+		result.reserve(length);
+
+		for (size_t i = 0; i < length; i++)
+			result.emplace_back(DecodeValue(depth + 1));
+
+		return new Array(std::move(result));
+	}
+
+	Value DecodeMap(size_t length, int depth)
+	{
+		/* Every entry takes at least two bytes. */
+		if (length > (m_Length - m_Position) / 2)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Unexpected end of MessagePack data."));
+
+		DictionaryData result;
+		result.reserve(length);
+
+		for (size_t i = 0; i < length; i++) {
+			String key = DecodeKey();
+			result.emplace_back(std::move(key), DecodeValue(depth + 1));
+		}
+
+		return new Dictionary(std::move(result));
+	}
+
+	Value DecodeValue(int depth)
+	{
+		if (depth > MSGPACK_MAX_DEPTH)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("MessagePack data is nested too deeply."));
+
+		Need(1);
+
+		unsigned char type = m_Data[m_Position++];
+
+		if (type <= 0x7f)
+			return static_cast<double>(type);
+
+		if (type >= 0xe0)
+			return static_cast<double>(static_cast<int8_t>(type));
+
+		if ((type & 0xf0) == 0x80)
+			return DecodeMap(type & 0x0f, depth);
+
+		if ((type & 0xf0) == 0x90)
+			return DecodeArray(type & 0x0f, depth);
+
+		if ((type & 0xe0) == 0xa0)
+			return ReadString(type & 0x1f);
+
+		switch (type) {
+			case 0xc0:
+				return Empty;
+			case 0xc2:
+				return false;
+			case 0xc3:
+				return true;
+			case 0xc4:
+			case 0xd9:
+				return ReadString(ReadBigEndian(1));
+			case 0xc5:
+			case 0xda:
+				return ReadString(ReadBigEndian(2));
+			case 0xc6:
+			case 0xdb:
+				return ReadString(ReadBigEndian(4));
+			case 0xca:
+				{
+					auto bits = static_cast<uint32_t>(ReadBigEndian(4));
+					float value;
+					memcpy(&value, &bits, sizeof(value));
+					return static_cast<double>(value);
+				}
+			case 0xcb:
+				{
+					uint64_t bits = ReadBigEndian(8);
+					double value;
+					memcpy(&value, &bits, sizeof(value));
+					return value;
+				}
+			case 0xcc:
+				return static_cast<double>(ReadBigEndian(1));
+			case 0xcd:
+				return static_cast<double>(ReadBigEndian(2));
+			case 0xce:
+				return static_cast<double>(ReadBigEndian(4));
+			case 0xcf:
+				return static_cast<double>(ReadBigEndian(8));
+			case 0xd0:
+				return static_cast<double>(static_cast<int8_t>(ReadBigEndian(1)));
+			case 0xd1:
+				return static_cast<double>(static_cast<int16_t>(ReadBigEndian(2)));
+			case 0xd2:
+				return static_cast<double>(static_cast<int32_t>(ReadBigEndian(4)));
+			case 0xd3:
+				return static_cast<double>(static_cast<int64_t>(ReadBigEndian(8)));
+			case 0xdc:
+				return DecodeArray(ReadBigEndian(2), depth);
+			case 0xdd:
+				return DecodeArray(ReadBigEndian(4), depth);
+			case 0xde:
+				return DecodeMap(ReadBigEndian(2), depth);
+			case 0xdf:
+				return DecodeMap(ReadBigEndian(4), depth);
+			default:
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported MessagePack type."));
+		}
+	}
+};
+
+}
+
+/**
+ * Decodes a MessagePack value. Binary data is decoded as a string.
+ *
+ * @param data The encoded data.
+ * @returns The decoded value.
+ */
+Value icinga::MsgPackDecode(const String& data)
+{
+	return MsgPackDecoder(data).Decode();
+}
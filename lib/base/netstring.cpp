@@ -19,92 +19,136 @@
 
 #include "base/netstring.hpp"
 #include "base/debug.hpp"
+#include "base/convert.hpp"
+#include "base/json.hpp"
+#include "base/value.hpp"
 #include <sstream>
 
 using namespace icinga;
 
 /**
- * Reads data from a stream in netstring format.
+ * Parses a netstring at the start of a buffer without copying it.
  *
- * @param stream The stream to read from.
- * @param[out] str The String that has been read from the IOQueue.
- * @returns true if a complete String was read from the IOQueue, false otherwise.
- * @exception invalid_argument The input stream is invalid.
+ * @param buffer The buffer.
+ * @param size The size of the buffer.
+ * @param[out] data The start of the netstring's payload within the buffer.
+ * @param[out] length The length of the payload.
+ * @param maxMessageLength The maximum length of the payload, -1 for no limit.
+ * @returns The number of bytes which belong to the netstring, or 0 if the
+ *          buffer doesn't contain a complete netstring yet.
+ * @exception invalid_argument The buffer doesn't start with a valid netstring.
  * @see https://github.com/PeterScott/netstring-c/blob/master/netstring.c
  */
-StreamReadStatus NetString::ReadStringFromStream(const Stream::Ptr& stream, String *str, StreamReadContext& context,
-	bool may_wait, ssize_t maxMessageLength)
+size_t NetString::ParseString(const char *buffer, size_t size, const char **data, size_t *length,
+	ssize_t maxMessageLength)
 {
-	if (context.Eof)
-		return StatusEof;
+	size_t len = 0;
+	size_t i;
 
-	if (context.MustRead) {
-		if (!context.FillFromStream(stream, may_wait)) {
-			context.Eof = true;
-			return StatusEof;
-		}
+	for (i = 0; i < size && buffer[i] >= '0' && buffer[i] <= '9'; i++) {
+		/* length specifier must have at most 9 characters */
+		if (i >= 9)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Length specifier must not exceed 9 characters"));
 
-		context.MustRead = false;
+		len = len * 10 + (buffer[i] - '0');
 	}
 
-	size_t header_length = 0;
+	if (i == size)
+		return 0;
 
-	for (size_t i = 0; i < context.Size; i++) {
-		if (context.Buffer[i] == ':') {
-			header_length = i;
+	/* make sure there's a header */
+	if (i == 0) {
+		if (buffer[0] == ':')
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (no length specifier)"));
 
-			/* make sure there's a header */
-			if (header_length == 0)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (no length specifier)"));
-
-			break;
-		} else if (i > 16)
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing :)"));
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing :)"));
 	}
 
-	if (header_length == 0) {
-		context.MustRead = true;
-		return StatusNeedData;
-	}
+	if (buffer[i] != ':')
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing :)"));
 
 	/* no leading zeros allowed */
-	if (context.Buffer[0] == '0' && isdigit(context.Buffer[1]))
+	if (buffer[0] == '0' && i > 1)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (leading zero)"));
 
-	size_t len, i;
-
-	len = 0;
-	for (i = 0; i < header_length && isdigit(context.Buffer[i]); i++) {
-		/* length specifier must have at most 9 characters */
-		if (i >= 9)
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Length specifier must not exceed 9 characters"));
+	if (maxMessageLength >= 0 && len + 1 > static_cast<size_t>(maxMessageLength)) {
+		std::stringstream errorMessage;
+		errorMessage << "Max data length exceeded: " << (maxMessageLength / 1024) << " KB";
 
-		len = len * 10 + (context.Buffer[i] - '0');
+		BOOST_THROW_EXCEPTION(std::invalid_argument(errorMessage.str()));
 	}
 
-	/* read the whole message */
-	size_t data_length = len + 1;
+	size_t header_length = i + 1;
 
-	if (maxMessageLength >= 0 && data_length > maxMessageLength) {
-		std::stringstream errorMessage;
-		errorMessage << "Max data length exceeded: " << (maxMessageLength / 1024) << " KB";
+	if (size - header_length < len + 1)
+		return 0;
 
-		BOOST_THROW_EXCEPTION(std::invalid_argument(errorMessage.str()));
+	if (buffer[header_length + len] != ',')
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing ,)"));
+
+	*data = buffer + header_length;
+	*length = len;
+
+	return header_length + len + 1;
+}
+
+/**
+ * Reads data from a stream in netstring format.
+ *
+ * @param stream The stream to read from.
+ * @param[out] str The String that has been read from the IOQueue.
+ * @returns true if a complete String was read from the IOQueue, false otherwise.
+ * @exception invalid_argument The input stream is invalid.
+ */
+StreamReadStatus NetString::ReadStringFromStream(const Stream::Ptr& stream, String *str, StreamReadContext& context,
+	bool may_wait, ssize_t maxMessageLength)
+{
+	if (context.Eof)
+		return StatusEof;
+
+	/* Parse complete messages directly in the stream's buffer; only
+	 * partial messages are copied into the context. */
+	if (context.Size == 0) {
+		bool found = false;
+
+		stream->ReadBuffered([str, maxMessageLength, &found](const char *buffer, size_t size) -> size_t {
+			const char *data;
+			size_t length;
+			size_t count = ParseString(buffer, size, &data, &length, maxMessageLength);
+
+			if (count > 0) {
+				*str = String(data, data + length);
+				found = true;
+			}
+
+			return count;
+		});
+
+		if (found)
+			return StatusNewItem;
+	}
+
+	if (context.MustRead) {
+		if (!context.FillFromStream(stream, may_wait)) {
+			context.Eof = true;
+			return StatusEof;
+		}
+
+		context.MustRead = false;
 	}
 
-	char *data = context.Buffer + header_length + 1;
+	const char *data;
+	size_t length;
+	size_t count = ParseString(context.Buffer, context.Size, &data, &length, maxMessageLength);
 
-	if (context.Size < header_length + 1 + data_length) {
+	if (count == 0) {
 		context.MustRead = true;
 		return StatusNeedData;
 	}
 
-	if (data[len] != ',')
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing ,)"));
-
-	*str = String(&data[0], &data[len]);
+	*str = String(data, data + length);
 
-	context.DropData(header_length + 1 + len + 1);
+	context.DropData(count);
 
 	return StatusNewItem;
 }
@@ -119,12 +163,44 @@ StreamReadStatus NetString::ReadStringFromStream(const Stream::Ptr& stream, Stri
  */
 size_t NetString::WriteStringToStream(const Stream::Ptr& stream, const String& str)
 {
-	std::ostringstream msgbuf;
-	WriteStringToStream(msgbuf, str);
+	std::string header = std::to_string(str.GetLength()) + ":";
+
+	/* The message isn't copied; streams which support it write all parts at once. */
+	StreamBuffer buffers[] = {
+		{ header.c_str(), header.size() },
+		{ str.CStr(), str.GetLength() },
+		{ ",", 1 }
+	};
+
+	stream->WriteBuffers(buffers, sizeof(buffers) / sizeof(buffers[0]));
+
+	return header.size() + str.GetLength() + 1;
+}
+
+/**
+ * JSON-encodes a value and writes it into a stream using the netstring
+ * format without building the encoded document in memory. The value is
+ * encoded twice, once to determine its length.
+ *
+ * @param stream The stream.
+ * @param value The value that is to be written.
+ *
+ * @return The amount of bytes written.
+ */
+size_t NetString::WriteJsonToStream(const Stream::Ptr& stream, const Value& value)
+{
+	size_t length = 0;
+
+	JsonEncode(value, [&length](const char *, size_t count) {
+		length += count;
+	});
+
+	String header = Convert::ToString(length) + ":";
+	stream->Write(header.CStr(), header.GetLength());
+	JsonEncode(value, stream);
+	stream->Write(",", 1);
 
-	String msg = msgbuf.str();
-	stream->Write(msg.CStr(), msg.GetLength());
-	return msg.GetLength();
+	return header.GetLength() + length + 1;
 }
 
 /**
@@ -27,6 +27,7 @@ namespace icinga
 {
 
 class String;
+class Value;
 
 /**
  * Helper functions for reading/writing messages in the netstring format.
@@ -38,10 +39,13 @@ class String;
 class NetString
 {
 public:
+	static size_t ParseString(const char *buffer, size_t size, const char **data, size_t *length,
+		ssize_t maxMessageLength = -1);
 	static StreamReadStatus ReadStringFromStream(const Stream::Ptr& stream, String *message, StreamReadContext& context,
 		bool may_wait = false, ssize_t maxMessageLength = -1);
 	static size_t WriteStringToStream(const Stream::Ptr& stream, const String& message);
 	static void WriteStringToStream(std::ostream& stream, const String& message);
+	static size_t WriteJsonToStream(const Stream::Ptr& stream, const Value& value);
 
 private:
 	NetString();
@@ -18,6 +18,15 @@
  ******************************************************************************/
 
 #include "base/networkstream.hpp"
+#include "base/utility.hpp"
+#include "base/logger.hpp"
+#include <boost/exception/errinfo_api_function.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <vector>
+#ifndef _WIN32
+#	include <climits>
+#	include <sys/uio.h>
+#endif /* _WIN32 */
 
 using namespace icinga;
 
@@ -25,6 +34,11 @@ NetworkStream::NetworkStream(Socket::Ptr socket)
 	: m_Socket(std::move(socket)), m_Eof(false)
 { }
 
+void NetworkStream::Shutdown()
+{
+	m_Socket->Shutdown();
+}
+
 void NetworkStream::Close()
 {
 	Stream::Close();
@@ -92,6 +106,55 @@ void NetworkStream::Write(const void *buffer, size_t count)
 	}
 }
 
+/**
+ * Writes several buffers to the stream with a single system call.
+ *
+ * @param buffers The buffers.
+ * @param count The number of buffers.
+ */
+void NetworkStream::WriteBuffers(const StreamBuffer *buffers, size_t count)
+{
+#ifndef _WIN32
+	if (count > IOV_MAX) {
+		Stream::WriteBuffers(buffers, count);
+		return;
+	}
+
+	if (m_Eof)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Tried to write to closed socket."));
+
+	std::vector<iovec> iov(count);
+	size_t total = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		iov[i].iov_base = const_cast<void *>(buffers[i].Data);
+		iov[i].iov_len = buffers[i].Size;
+		total += buffers[i].Size;
+	}
+
+	ssize_t rc = writev(m_Socket->GetFD(), iov.data(), count);
+
+	if (rc < 0) {
+		m_Eof = true;
+
+		Log(LogCritical, "NetworkStream")
+			<< "writev() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+
+		BOOST_THROW_EXCEPTION(socket_error()
+			<< boost::errinfo_api_function("writev")
+			<< boost::errinfo_errno(errno));
+	}
+
+	if (static_cast<size_t>(rc) < total) {
+		m_Eof = true;
+
+		BOOST_THROW_EXCEPTION(std::runtime_error("Short write for socket."));
+	}
+#else /* _WIN32 */
+	Stream::WriteBuffers(buffers, count);
+#endif /* _WIN32 */
+}
+
 bool NetworkStream::IsEof() const
 {
 	return m_Eof;
@@ -41,7 +41,9 @@ public:
 
 	size_t Read(void *buffer, size_t count, bool allow_partial = false) override;
 	void Write(const void *buffer, size_t count) override;
+	void WriteBuffers(const StreamBuffer *buffers, size_t count) override;
 
+	void Shutdown() override;
 	void Close() override;
 
 	bool IsEof() const override;
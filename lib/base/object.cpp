@@ -18,32 +18,26 @@
  ******************************************************************************/
 
 #include "base/object.hpp"
+#include "base/objectlock.hpp"
 #include "base/value.hpp"
 #include "base/dictionary.hpp"
 #include "base/primitivetype.hpp"
 #include "base/utility.hpp"
-#include "base/timer.hpp"
-#include "base/logger.hpp"
 #include "base/exception.hpp"
+#include "base/serializer.hpp"
+#include "base/memoryaccounting.hpp"
 #include <boost/lexical_cast.hpp>
-#include <boost/thread/recursive_mutex.hpp>
 
 using namespace icinga;
 
 DEFINE_TYPE_INSTANCE(Object);
 
-#ifdef I2_LEAK_DEBUG
-static boost::mutex l_ObjectCountLock;
-static std::map<String, int> l_ObjectCounts;
-static Timer::Ptr l_ObjectCountTimer;
-#endif /* I2_LEAK_DEBUG */
-
 /**
  * Destructor for the Object class.
  */
 Object::~Object()
 {
-	delete reinterpret_cast<boost::recursive_mutex *>(m_Mutex);
+	ObjectLock::DestroyMutex(this);
 }
 
 /**
@@ -183,6 +177,63 @@ Object::Ptr Object::NavigateField(int id) const
 	BOOST_THROW_EXCEPTION(std::runtime_error("Invalid field ID."));
 }
 
+/**
+ * Serializes the object's fields. mkclass generates type-specific
+ * implementations; this one is used for types which are implemented by hand.
+ *
+ * @param fields The serialized fields are appended to this list.
+ * @param attributeTypes Only fields with one of these attributes are serialized (0 means all fields).
+ */
+void Object::SerializeFields(DictionaryData& fields, int attributeTypes) const
+{
+	Type::Ptr type = GetReflectionType();
+
+	for (int i = 0; i < type->GetFieldCount(); i++) {
+		Field field = type->GetFieldInfo(i);
+
+		if (attributeTypes != 0 && (field.Attributes & attributeTypes) == 0)
+			continue;
+
+		if (strcmp(field.Name, "type") == 0)
+			continue;
+
+		fields.emplace_back(type->GetFieldName(i), Serialize(GetField(i), attributeTypes));
+	}
+}
+
+/**
+ * Deserializes a field. mkclass generates type-specific implementations;
+ * this one is used for types which are implemented by hand.
+ *
+ * @param name The field's name.
+ * @param value The serialized value.
+ * @param safeMode Whether objects may be instantiated while deserializing the value.
+ * @param attributeTypes The field is only set if it has one of these attributes.
+ * @returns true if the object has a field with that name, false otherwise.
+ */
+bool Object::DeserializeField(const String& name, const Value& value, bool safeMode, int attributeTypes)
+{
+	Type::Ptr type = GetReflectionType();
+
+	int fid = type->GetFieldId(name);
+
+	if (fid < 0)
+		return false;
+
+	Field field = type->GetFieldInfo(fid);
+
+	if ((field.Attributes & attributeTypes) == 0)
+		return true;
+
+	try {
+		SetField(fid, Deserialize(value, safeMode, attributeTypes), true);
+	} catch (const std::exception&) {
+		SetField(fid, Empty);
+	}
+
+	return true;
+}
+
 Object::Ptr Object::Clone() const
 {
 	BOOST_THROW_EXCEPTION(std::runtime_error("Object cannot be cloned."));
@@ -213,51 +264,12 @@ Value icinga::GetPrototypeField(const Value& context, const String& field, bool
 		return Empty;
 }
 
-#ifdef I2_LEAK_DEBUG
-void icinga::TypeAddObject(Object *object)
-{
-	boost::mutex::scoped_lock lock(l_ObjectCountLock);
-	String typeName = Utility::GetTypeName(typeid(*object));
-	l_ObjectCounts[typeName]++;
-}
-
-void icinga::TypeRemoveObject(Object *object)
-{
-	boost::mutex::scoped_lock lock(l_ObjectCountLock);
-	String typeName = Utility::GetTypeName(typeid(*object));
-	l_ObjectCounts[typeName]--;
-}
-
-static void TypeInfoTimerHandler()
-{
-	boost::mutex::scoped_lock lock(l_ObjectCountLock);
-
-	typedef std::map<String, int>::value_type kv_pair;
-	for (kv_pair& kv : l_ObjectCounts) {
-		if (kv.second == 0)
-			continue;
-
-		Log(LogInformation, "TypeInfo")
-			<< kv.second << " " << kv.first << " objects";
-
-		kv.second = 0;
-	}
-}
-
-INITIALIZE_ONCE([]() {
-	l_ObjectCountTimer = new Timer();
-	l_ObjectCountTimer->SetInterval(10);
-	l_ObjectCountTimer->OnTimerExpired.connect(std::bind(TypeInfoTimerHandler));
-	l_ObjectCountTimer->Start();
-});
-#endif /* I2_LEAK_DEBUG */
-
 void icinga::intrusive_ptr_add_ref(Object *object)
 {
-#ifdef I2_LEAK_DEBUG
+#ifdef ICINGA2_WITH_MEMORY_ACCOUNTING
 	if (object->m_References == 0)
-		TypeAddObject(object);
-#endif /* I2_LEAK_DEBUG */
+		MemoryAccounting::AddObject(object, I2_RETURN_ADDRESS());
+#endif /* ICINGA2_WITH_MEMORY_ACCOUNTING */
 
 #ifdef _WIN32
 	InterlockedIncrement(&object->m_References);
@@ -277,9 +289,9 @@ void icinga::intrusive_ptr_release(Object *object)
 #endif /* _WIN32 */
 
 	if (unlikely(refs == 0)) {
-#ifdef I2_LEAK_DEBUG
-		TypeRemoveObject(object);
-#endif /* I2_LEAK_DEBUG */
+#ifdef ICINGA2_WITH_MEMORY_ACCOUNTING
+		MemoryAccounting::RemoveObject(object);
+#endif /* ICINGA2_WITH_MEMORY_ACCOUNTING */
 
 		delete object;
 	}
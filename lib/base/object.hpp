@@ -24,6 +24,7 @@
 #include "base/debug.hpp"
 #include <boost/smart_ptr/intrusive_ptr.hpp>
 #include <cstddef>
+#include <utility>
 #include <vector>
 
 using boost::intrusive_ptr;
@@ -39,9 +40,12 @@ class Type;
 class String;
 struct DebugInfo;
 class ValidationUtils;
+struct MemoryAccountingType;
 
 extern Value Empty;
 
+typedef std::vector<std::pair<String, Value> > DictionaryData;
+
 #define DECLARE_PTR_TYPEDEFS(klass) \
 	typedef intrusive_ptr<klass> Ptr
 
@@ -189,6 +193,8 @@ public:
 	virtual void ValidateField(int id, const Lazy<Value>& lvalue, const ValidationUtils& utils);
 	virtual void NotifyField(int id, const Value& cookie = Empty);
 	virtual Object::Ptr NavigateField(int id) const;
+	virtual void SerializeFields(DictionaryData& fields, int attributeTypes) const;
+	virtual bool DeserializeField(const String& name, const Value& value, bool safeMode, int attributeTypes);
 
 #ifdef I2_DEBUG
 	bool OwnsLock() const;
@@ -216,7 +222,13 @@ private:
 	mutable size_t m_LockCount = 0;
 #endif /* I2_DEBUG */
 
+#ifdef ICINGA2_WITH_MEMORY_ACCOUNTING
+	MemoryAccountingType *m_AccountingType{nullptr};
+	size_t m_AccountedBytes{0};
+#endif /* ICINGA2_WITH_MEMORY_ACCOUNTING */
+
 	friend struct ObjectLock;
+	friend class MemoryAccounting;
 
 	friend void intrusive_ptr_add_ref(Object *object);
 	friend void intrusive_ptr_release(Object *object);
@@ -224,9 +236,6 @@ private:
 
 Value GetPrototypeField(const Value& context, const String& field, bool not_found_error, const DebugInfo& debugInfo);
 
-void TypeAddObject(Object *object);
-void TypeRemoveObject(Object *object);
-
 void intrusive_ptr_add_ref(Object *object);
 void intrusive_ptr_release(Object *object);
 
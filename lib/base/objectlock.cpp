@@ -18,12 +18,220 @@
  ******************************************************************************/
 
 #include "base/objectlock.hpp"
-#include <boost/thread/recursive_mutex.hpp>
+#include "base/profiledmutex.hpp"
+#include "base/configtype.hpp"
+#include "base/configobject.hpp"
+#include "base/dictionary.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include "base/utility.hpp"
+#include <atomic>
+#include <thread>
+#ifdef __linux__
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#else /* __linux__ */
+#	include <boost/thread/recursive_mutex.hpp>
+#endif /* __linux__ */
 
 using namespace icinga;
 
-#define I2MUTEX_UNLOCKED 0
-#define I2MUTEX_LOCKED 1
+#ifndef SPIN_PAUSE
+#	if defined(__i386__) || defined(__x86_64__)
+#		define SPIN_PAUSE() __builtin_ia32_pause()
+#	endif /* defined(__i386__) || defined(__x86_64__) */
+#endif /* SPIN_PAUSE */
+
+/* Maximum number of times a contended lock spins before it parks the thread. */
+#define I2MUTEX_MAX_SPINS 100
+
+static std::atomic<uint64_t> l_ContendedLocks(0);
+static std::atomic<uint64_t> l_ContendedWaitTimeUsec(0);
+
+static LockContentionSites& GetObjectLockSites()
+{
+	static LockContentionSites sites;
+	return sites;
+}
+
+namespace {
+
+/**
+ * A recursive mutex which spins adaptively before parking the calling thread
+ * on a futex. The counters are only modified while the mutex is held.
+ */
+struct ObjectMutex
+{
+#ifdef __linux__
+	/* 0: unlocked, 1: locked, 2: locked and there might be waiters */
+	std::atomic<int> State{0};
+	std::atomic<std::thread::id> Owner{std::thread::id()};
+	unsigned int Recursion{0};
+	std::atomic<int> Spins{0};
+#else /* __linux__ */
+	boost::recursive_mutex Mutex;
+#endif /* __linux__ */
+
+	std::atomic<uint64_t> Acquisitions{0};
+	std::atomic<uint64_t> Contended{0};
+	std::atomic<double> WaitTime{0};
+
+	/* The hold time is measured for every 64th acquisition. */
+	double HoldStart{0};
+	std::atomic<uint64_t> HoldSamples{0};
+	std::atomic<double> HoldTime{0};
+
+	void Lock(const void *site);
+	void Unlock();
+
+private:
+	void RecordAcquisition(bool contended, double start, const void *site);
+	void RecordHoldTime();
+
+#ifdef __linux__
+	bool TryLock()
+	{
+		int expected = 0;
+		return State.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+	}
+
+	void LockSlow();
+#endif /* __linux__ */
+};
+
+}
+
+#ifdef __linux__
+static inline void FutexWait(std::atomic<int> *addr, int value)
+{
+	syscall(SYS_futex, reinterpret_cast<int *>(addr), FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+}
+
+static inline void FutexWake(std::atomic<int> *addr)
+{
+	syscall(SYS_futex, reinterpret_cast<int *>(addr), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+void ObjectMutex::Lock(const void *site)
+{
+	std::thread::id self = std::this_thread::get_id();
+
+	if (Owner.load(std::memory_order_relaxed) == self) {
+		Recursion++;
+		Acquisitions.store(Acquisitions.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+
+	if (likely(TryLock())) {
+		Owner.store(self, std::memory_order_relaxed);
+		Recursion = 1;
+		RecordAcquisition(false, 0, site);
+		return;
+	}
+
+	double start = Utility::GetTime();
+
+	LockSlow();
+
+	Owner.store(self, std::memory_order_relaxed);
+	Recursion = 1;
+	RecordAcquisition(true, start, site);
+}
+
+void ObjectMutex::LockSlow()
+{
+	/* Adapt the number of spins to how long the lock was held recently, similar to glibc's adaptive mutexes. */
+	int spins = Spins.load(std::memory_order_relaxed);
+	int maxSpins = std::min(I2MUTEX_MAX_SPINS, spins * 2 + 10);
+	int it;
+
+	for (it = 0; it < maxSpins; it++) {
+		if (State.load(std::memory_order_relaxed) == 0 && TryLock()) {
+			Spins.store(spins + (it - spins) / 8, std::memory_order_relaxed);
+			return;
+		}
+
+#ifdef SPIN_PAUSE
+		SPIN_PAUSE();
+#endif /* SPIN_PAUSE */
+	}
+
+	Spins.store(spins + (it - spins) / 8, std::memory_order_relaxed);
+
+	while (State.exchange(2, std::memory_order_acquire) != 0)
+		FutexWait(&State, 2);
+}
+
+void ObjectMutex::Unlock()
+{
+	if (--Recursion > 0)
+		return;
+
+	if (unlikely(HoldStart != 0))
+		RecordHoldTime();
+
+	Owner.store(std::thread::id(), std::memory_order_relaxed);
+
+	if (State.exchange(0, std::memory_order_release) == 2)
+		FutexWake(&State);
+}
+#else /* __linux__ */
+void ObjectMutex::Lock(const void *site)
+{
+	if (likely(Mutex.try_lock())) {
+		RecordAcquisition(false, 0, site);
+		return;
+	}
+
+	double start = Utility::GetTime();
+
+	Mutex.lock();
+
+	RecordAcquisition(true, start, site);
+}
+
+/* The recursion depth isn't known here, so the hold time is only
+ * measured on Linux. */
+void ObjectMutex::Unlock()
+{
+	Mutex.unlock();
+}
+#endif /* __linux__ */
+
+void ObjectMutex::RecordAcquisition(bool contended, double start, const void *site)
+{
+	uint64_t acquisitions = Acquisitions.load(std::memory_order_relaxed) + 1;
+	Acquisitions.store(acquisitions, std::memory_order_relaxed);
+
+#ifdef __linux__
+	if (unlikely((acquisitions & 63) == 0))
+		HoldStart = Utility::GetTime();
+#endif /* __linux__ */
+
+	if (!contended)
+		return;
+
+	double waitTime = Utility::GetTime() - start;
+
+	Contended.store(Contended.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	WaitTime.store(WaitTime.load(std::memory_order_relaxed) + waitTime, std::memory_order_relaxed);
+
+	l_ContendedLocks++;
+	l_ContendedWaitTimeUsec += static_cast<uint64_t>(waitTime * 1000 * 1000);
+
+	if (site)
+		GetObjectLockSites().Record(site, waitTime);
+}
+
+void ObjectMutex::RecordHoldTime()
+{
+	double holdTime = Utility::GetTime() - HoldStart;
+	HoldStart = 0;
+
+	HoldSamples.store(HoldSamples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	HoldTime.store(HoldTime.load(std::memory_order_relaxed) + holdTime, std::memory_order_relaxed);
+}
 
 ObjectLock::~ObjectLock()
 {
@@ -34,58 +242,116 @@ ObjectLock::ObjectLock(const Object::Ptr& object)
 	: m_Object(object.get()), m_Locked(false)
 {
 	if (m_Object)
-		Lock();
+		Lock(I2_RETURN_ADDRESS());
 }
 
 ObjectLock::ObjectLock(const Object *object)
 	: m_Object(object), m_Locked(false)
 {
 	if (m_Object)
-		Lock();
+		Lock(I2_RETURN_ADDRESS());
 }
 
-void ObjectLock::LockMutex(const Object *object)
+/**
+ * Locks the mutex which belongs to an object.
+ *
+ * @param object The object.
+ * @param site The call site which is reported when the lock is contended.
+ */
+void ObjectLock::LockMutex(const Object *object, const void *site)
 {
-	unsigned int it = 0;
-
 #ifdef _WIN32
-#	ifdef _WIN64
-	while (likely(InterlockedCompareExchange64((LONGLONG *)&object->m_Mutex, I2MUTEX_LOCKED, I2MUTEX_UNLOCKED) != I2MUTEX_UNLOCKED)) {
-#	else /* _WIN64 */
-	while (likely(InterlockedCompareExchange(&object->m_Mutex, I2MUTEX_LOCKED, I2MUTEX_UNLOCKED) != I2MUTEX_UNLOCKED)) {
-#	endif /* _WIN64 */
+	auto *mtx = reinterpret_cast<ObjectMutex *>(InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile *>(&object->m_Mutex), nullptr, nullptr));
 #else /* _WIN32 */
-	while (likely(!__sync_bool_compare_and_swap(&object->m_Mutex, I2MUTEX_UNLOCKED, I2MUTEX_LOCKED))) {
+	auto *mtx = reinterpret_cast<ObjectMutex *>(__atomic_load_n(&object->m_Mutex, __ATOMIC_ACQUIRE));
 #endif /* _WIN32 */
-		if (likely(object->m_Mutex > I2MUTEX_LOCKED)) {
-			auto *mtx = reinterpret_cast<boost::recursive_mutex *>(object->m_Mutex);
-			mtx->lock();
-
-			return;
-		}
 
-		Spin(it);
-		it++;
-	}
+	if (unlikely(!mtx)) {
+		auto *newMtx = new ObjectMutex();
 
-	auto *mtx = new boost::recursive_mutex();
-	mtx->lock();
 #ifdef _WIN32
-#	ifdef _WIN64
-	InterlockedCompareExchange64((LONGLONG *)&object->m_Mutex, reinterpret_cast<LONGLONG>(mtx), I2MUTEX_LOCKED);
-#	else /* _WIN64 */
-	InterlockedCompareExchange(&object->m_Mutex, reinterpret_cast<LONG>(mtx), I2MUTEX_LOCKED);
-#	endif /* _WIN64 */
+		void *oldMtx = InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile *>(&object->m_Mutex), newMtx, nullptr);
 #else /* _WIN32 */
-	__sync_bool_compare_and_swap(&object->m_Mutex, I2MUTEX_LOCKED, reinterpret_cast<uintptr_t>(mtx));
+		auto *oldMtx = reinterpret_cast<void *>(__sync_val_compare_and_swap(&object->m_Mutex, 0, reinterpret_cast<uintptr_t>(newMtx)));
 #endif /* _WIN32 */
+
+		if (oldMtx) {
+			/* Another thread won the race. */
+			delete newMtx;
+			mtx = static_cast<ObjectMutex *>(oldMtx);
+		} else
+			mtx = newMtx;
+	}
+
+	mtx->Lock(site);
+}
+
+/**
+ * Frees the mutex which belongs to an object. Must only be called from the
+ * object's destructor.
+ *
+ * @param object The object.
+ */
+void ObjectLock::DestroyMutex(const Object *object)
+{
+	delete reinterpret_cast<ObjectMutex *>(object->m_Mutex);
+}
+
+/**
+ * Retrieves the lock contention counters for an object.
+ *
+ * @param object The object.
+ * @param acquisitions The number of times the lock was acquired.
+ * @param contended The number of times the lock was held by another thread.
+ * @param waitTime The total time spent waiting for the lock.
+ */
+void ObjectLock::GetContentionStats(const Object *object, uint64_t& acquisitions, uint64_t& contended, double& waitTime)
+{
+	auto *mtx = reinterpret_cast<ObjectMutex *>(object->m_Mutex);
+
+	if (!mtx) {
+		acquisitions = 0;
+		contended = 0;
+		waitTime = 0;
+		return;
+	}
+
+	acquisitions = mtx->Acquisitions.load(std::memory_order_relaxed);
+	contended = mtx->Contended.load(std::memory_order_relaxed);
+	waitTime = mtx->WaitTime.load(std::memory_order_relaxed);
+}
+
+/**
+ * Retrieves the sampled hold times for an object.
+ *
+ * @param object The object.
+ * @param samples The number of times the hold time was measured.
+ * @param holdTime The total measured hold time.
+ */
+void ObjectLock::GetHoldTimeStats(const Object *object, uint64_t& samples, double& holdTime)
+{
+	auto *mtx = reinterpret_cast<ObjectMutex *>(object->m_Mutex);
+
+	if (!mtx) {
+		samples = 0;
+		holdTime = 0;
+		return;
+	}
+
+	samples = mtx->HoldSamples.load(std::memory_order_relaxed);
+	holdTime = mtx->HoldTime.load(std::memory_order_relaxed);
 }
 
 void ObjectLock::Lock()
+{
+	Lock(I2_RETURN_ADDRESS());
+}
+
+void ObjectLock::Lock(const void *site)
 {
 	ASSERT(!m_Locked && m_Object);
 
-	LockMutex(m_Object);
+	LockMutex(m_Object, site);
 
 	m_Locked = true;
 
@@ -132,7 +398,63 @@ void ObjectLock::Unlock()
 #endif /* I2_DEBUG */
 
 	if (m_Locked) {
-		reinterpret_cast<boost::recursive_mutex *>(m_Object->m_Mutex)->unlock();
+		reinterpret_cast<ObjectMutex *>(m_Object->m_Mutex)->Unlock();
 		m_Locked = false;
 	}
 }
+
+static void ObjectLockStatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	DictionaryData types;
+
+	for (const Type::Ptr& type : Type::GetAllTypes()) {
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		if (!ctype)
+			continue;
+
+		uint64_t typeAcquisitions = 0, typeContended = 0, typeHoldSamples = 0;
+		double typeWaitTime = 0, typeHoldTime = 0;
+
+		for (const ConfigObject::Ptr& object : ctype->GetObjects()) {
+			uint64_t acquisitions, contended, holdSamples;
+			double waitTime, holdTime;
+
+			ObjectLock::GetContentionStats(object.get(), acquisitions, contended, waitTime);
+			ObjectLock::GetHoldTimeStats(object.get(), holdSamples, holdTime);
+
+			typeAcquisitions += acquisitions;
+			typeContended += contended;
+			typeWaitTime += waitTime;
+			typeHoldSamples += holdSamples;
+			typeHoldTime += holdTime;
+		}
+
+		if (typeAcquisitions == 0)
+			continue;
+
+		types.emplace_back(type->GetName(), new Dictionary({
+			{ "acquisitions", typeAcquisitions },
+			{ "contended", typeContended },
+			{ "wait_time", typeWaitTime },
+			{ "avg_hold_time", typeHoldSamples > 0 ? typeHoldTime / typeHoldSamples : 0 }
+		}));
+	}
+
+	std::unordered_map<const void *, std::pair<uint64_t, double> > sites;
+	GetObjectLockSites().Merge(sites);
+
+	double waitTime = l_ContendedWaitTimeUsec.load() / (1000.0 * 1000.0);
+
+	status->Set("object_lock", new Dictionary({
+		{ "contended", l_ContendedLocks.load() },
+		{ "wait_time", waitTime },
+		{ "types", new Dictionary(std::move(types)) },
+		{ "sites", LockContentionSites::Format(sites) }
+	}));
+
+	perfdata->Add(new PerfdataValue("object_lock_contended", l_ContendedLocks.load(), true));
+	perfdata->Add(new PerfdataValue("object_lock_wait_time", waitTime, true));
+}
+
+REGISTER_STATSFUNCTION(ObjectLock, &ObjectLockStatsFunc);
@@ -21,6 +21,7 @@
 #define OBJECTLOCK_H
 
 #include "base/object.hpp"
+#include <cstdint>
 
 namespace icinga
 {
@@ -36,9 +37,13 @@ public:
 
 	~ObjectLock();
 
-	static void LockMutex(const Object *object);
+	static void LockMutex(const Object *object, const void *site = nullptr);
+	static void DestroyMutex(const Object *object);
 
-	void Lock();
+	static void GetContentionStats(const Object *object, uint64_t& acquisitions, uint64_t& contended, double& waitTime);
+	static void GetHoldTimeStats(const Object *object, uint64_t& samples, double& holdTime);
+
+	I2_NOINLINE void Lock();
 
 	static void Spin(unsigned int it);
 
@@ -47,6 +52,8 @@ public:
 private:
 	const Object *m_Object{nullptr};
 	bool m_Locked{false};
+
+	void Lock(const void *site);
 };
 
 }
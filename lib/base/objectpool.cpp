@@ -0,0 +1,272 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/objectpool.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+using namespace icinga;
+
+#define POOL_CLASSES (ObjectPool::MaxSize / ObjectPool::Granularity)
+
+/* Number of allocations after which a thread publishes its counters. */
+#define POOL_STATS_INTERVAL 1024
+
+namespace {
+
+struct FreeBlock
+{
+	FreeBlock *Next;
+};
+
+struct FreeBatch
+{
+	FreeBlock *Head;
+	size_t Count;
+};
+
+struct SharedPool
+{
+	boost::mutex Mutex;
+	std::vector<FreeBatch> Batches[POOL_CLASSES];
+};
+
+struct ThreadCache
+{
+	FreeBlock *Heads[POOL_CLASSES] = {};
+	size_t Counts[POOL_CLASSES] = {};
+	uint64_t Allocations = 0;
+	uint64_t Hits = 0;
+	uint64_t TotalAllocations = 0;
+
+	~ThreadCache();
+
+	void PublishStats();
+};
+
+}
+
+static std::atomic<uint64_t> l_Allocations(0);
+static std::atomic<uint64_t> l_LocalHits(0);
+static std::atomic<uint64_t> l_SharedRefills(0);
+static std::atomic<uint64_t> l_SlabRefills(0);
+static std::atomic<uint64_t> l_SlabMemory(0);
+
+static SharedPool& GetSharedPool()
+{
+	/* Intentionally leaked: objects may still be freed by static destructors. */
+	static auto *pool = new SharedPool();
+	return *pool;
+}
+
+static ThreadCache *GetThreadCache()
+{
+	static auto *caches = new boost::thread_specific_ptr<ThreadCache>();
+
+	ThreadCache *cache = caches->get();
+
+	if (unlikely(!cache)) {
+		cache = new ThreadCache();
+		caches->reset(cache);
+	}
+
+	return cache;
+}
+
+void ThreadCache::PublishStats()
+{
+	l_Allocations += Allocations;
+	l_LocalHits += Hits;
+
+	Allocations = 0;
+	Hits = 0;
+}
+
+ThreadCache::~ThreadCache()
+{
+	PublishStats();
+
+	SharedPool& pool = GetSharedPool();
+
+	boost::mutex::scoped_lock lock(pool.Mutex);
+
+	for (size_t cls = 0; cls < POOL_CLASSES; cls++) {
+		if (Heads[cls])
+			pool.Batches[cls].push_back({ Heads[cls], Counts[cls] });
+	}
+}
+
+static void RefillCache(ThreadCache *cache, size_t cls)
+{
+	SharedPool& pool = GetSharedPool();
+
+	{
+		boost::mutex::scoped_lock lock(pool.Mutex);
+
+		std::vector<FreeBatch>& batches = pool.Batches[cls];
+
+		if (!batches.empty()) {
+			FreeBatch batch = batches.back();
+			batches.pop_back();
+
+			cache->Heads[cls] = batch.Head;
+			cache->Counts[cls] = batch.Count;
+
+			l_SharedRefills++;
+			return;
+		}
+	}
+
+	size_t blockSize = (cls + 1) * ObjectPool::Granularity;
+	auto *slab = static_cast<char *>(::operator new(blockSize * ObjectPool::BatchSize));
+
+	FreeBlock *head = nullptr;
+
+	for (size_t i = ObjectPool::BatchSize; i > 0; i--) {
+		auto *block = reinterpret_cast<FreeBlock *>(slab + (i - 1) * blockSize);
+		block->Next = head;
+		head = block;
+	}
+
+	cache->Heads[cls] = head;
+	cache->Counts[cls] = ObjectPool::BatchSize;
+
+	l_SlabRefills++;
+	l_SlabMemory += blockSize * ObjectPool::BatchSize;
+}
+
+static void ReleaseBatch(ThreadCache *cache, size_t cls)
+{
+	FreeBlock *head = cache->Heads[cls];
+	FreeBlock *tail = head;
+
+	for (size_t i = 1; i < ObjectPool::BatchSize; i++)
+		tail = tail->Next;
+
+	cache->Heads[cls] = tail->Next;
+	cache->Counts[cls] -= ObjectPool::BatchSize;
+	tail->Next = nullptr;
+
+	SharedPool& pool = GetSharedPool();
+
+	boost::mutex::scoped_lock lock(pool.Mutex);
+	pool.Batches[cls].push_back({ head, ObjectPool::BatchSize });
+}
+
+/**
+ * Allocates a block of memory. Sizes which exceed MaxSize are passed
+ * through to the global operator new.
+ *
+ * @param size The number of bytes.
+ * @returns The memory block.
+ */
+void *ObjectPool::Allocate(size_t size)
+{
+	if (size == 0 || size > MaxSize)
+		return ::operator new(size);
+
+	size_t cls = (size - 1) / Granularity;
+	ThreadCache *cache = GetThreadCache();
+
+	FreeBlock *block = cache->Heads[cls];
+
+	if (likely(block != nullptr)) {
+		cache->Hits++;
+	} else {
+		RefillCache(cache, cls);
+		block = cache->Heads[cls];
+	}
+
+	cache->Heads[cls] = block->Next;
+	cache->Counts[cls]--;
+	cache->TotalAllocations++;
+
+	if (unlikely(++cache->Allocations >= POOL_STATS_INTERVAL))
+		cache->PublishStats();
+
+	return block;
+}
+
+/**
+ * Returns the number of pooled allocations the current thread has made.
+ *
+ * @returns The number of allocations.
+ */
+uint64_t ObjectPool::GetThreadAllocations()
+{
+	return GetThreadCache()->TotalAllocations;
+}
+
+/**
+ * Returns a block of memory to the current thread's free list. Excess
+ * blocks are handed over to the shared pool so that other threads can
+ * re-use them.
+ *
+ * @param ptr The memory block.
+ * @param size The size which was used to allocate the block.
+ */
+void ObjectPool::Free(void *ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	if (size == 0 || size > MaxSize) {
+		::operator delete(ptr);
+		return;
+	}
+
+	size_t cls = (size - 1) / Granularity;
+	ThreadCache *cache = GetThreadCache();
+
+	auto *block = static_cast<FreeBlock *>(ptr);
+	block->Next = cache->Heads[cls];
+	cache->Heads[cls] = block;
+
+	if (unlikely(++cache->Counts[cls] >= 2 * BatchSize))
+		ReleaseBatch(cache, cls);
+}
+
+static void ObjectPoolStatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	uint64_t allocations = l_Allocations.load();
+	uint64_t hits = l_LocalHits.load();
+	double hitRate = allocations > 0 ? static_cast<double>(hits) / allocations : 0;
+
+	status->Set("object_pool", new Dictionary({
+		{ "allocations", allocations },
+		{ "local_hits", hits },
+		{ "shared_refills", l_SharedRefills.load() },
+		{ "slab_refills", l_SlabRefills.load() },
+		{ "memory", l_SlabMemory.load() },
+		{ "hit_rate", hitRate }
+	}));
+
+	perfdata->Add(new PerfdataValue("object_pool_hit_rate", hitRate));
+	perfdata->Add(new PerfdataValue("object_pool_memory", l_SlabMemory.load()));
+}
+
+REGISTER_STATSFUNCTION(ObjectPool, &ObjectPoolStatsFunc);
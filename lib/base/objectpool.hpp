@@ -0,0 +1,69 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include "base/i2-base.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace icinga
+{
+
+/**
+ * Size-class based allocator for frequently allocated objects. Each thread
+ * keeps its own free lists; blocks which are freed on another thread than
+ * the one which allocated them are returned to a shared pool in batches.
+ *
+ * @ingroup base
+ */
+class ObjectPool
+{
+public:
+	static void *Allocate(size_t size);
+	static void Free(void *ptr, size_t size);
+
+	static uint64_t GetThreadAllocations();
+
+	static const size_t Granularity = 16;
+	static const size_t MaxSize = 512;
+	static const size_t BatchSize = 64;
+
+private:
+	ObjectPool();
+};
+
+/**
+ * Makes a class (and its subclasses) use the ObjectPool allocator.
+ */
+#define DECLARE_POOLED_ALLOCATOR() \
+	static void *operator new(size_t size) \
+	{ \
+		return ObjectPool::Allocate(size); \
+	} \
+	\
+	static void operator delete(void *ptr, size_t size) \
+	{ \
+		ObjectPool::Free(ptr, size); \
+	}
+
+}
+
+#endif /* OBJECTPOOL_H */
@@ -0,0 +1,281 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/pattern.hpp"
+#include "base/dictionary.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include <mmatch.h>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <unordered_map>
+
+using namespace icinga;
+
+#define PATTERN_CACHE_SHARDS 16
+#define PATTERN_CACHE_SHARD_SIZE 256
+
+static std::atomic<uint64_t> l_GlobHits(0);
+static std::atomic<uint64_t> l_GlobMisses(0);
+static std::atomic<uint64_t> l_RegexHits(0);
+static std::atomic<uint64_t> l_RegexMisses(0);
+
+static inline bool EqualsIgnoreCase(char a, char b)
+{
+	return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b));
+}
+
+GlobPattern::GlobPattern(const String& pattern)
+	: m_Pattern(pattern), m_Kind(GlobMatchGeneric)
+{
+	/* Split the pattern into its stars and literal characters, the same way
+	 * match() interprets the escape sequences "\*" and "\?". */
+	const std::string& data = pattern.GetData();
+	std::vector<std::pair<bool, std::string> > parts;
+
+	for (std::string::size_type i = 0; i < data.size(); i++) {
+		char ch = data[i];
+
+		if (ch == '?')
+			return;
+
+		if (ch == '*') {
+			if (parts.empty() || !parts.back().first)
+				parts.emplace_back(true, std::string());
+
+			continue;
+		}
+
+		if (ch == '\\' && i + 1 < data.size() && (data[i + 1] == '*' || data[i + 1] == '?'))
+			ch = data[++i];
+
+		if (parts.empty() || parts.back().first)
+			parts.emplace_back(false, std::string());
+
+		parts.back().second += static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+	}
+
+	if (parts.empty()) {
+		m_Kind = GlobMatchExact;
+	} else if (parts.size() == 1) {
+		m_Kind = parts[0].first ? GlobMatchAll : GlobMatchExact;
+		m_Literal = parts[0].second;
+	} else if (parts.size() == 2) {
+		m_Kind = parts[0].first ? GlobMatchSuffix : GlobMatchPrefix;
+		m_Literal = parts[0].first ? parts[1].second : parts[0].second;
+	} else if (parts.size() == 3 && parts[0].first) {
+		m_Kind = GlobMatchInfix;
+		m_Literal = parts[1].second;
+	}
+}
+
+/**
+ * Checks whether the text matches the pattern. Comparisons are
+ * case-insensitive.
+ *
+ * @param text The text.
+ * @returns true if the text matches, false otherwise.
+ */
+bool GlobPattern::Match(const String& text) const
+{
+	const std::string& data = text.GetData();
+
+	switch (m_Kind) {
+		case GlobMatchAll:
+			return true;
+		case GlobMatchExact:
+			return data.size() == m_Literal.size() && std::equal(m_Literal.begin(), m_Literal.end(), data.begin(), EqualsIgnoreCase);
+		case GlobMatchPrefix:
+			return data.size() >= m_Literal.size() && std::equal(m_Literal.begin(), m_Literal.end(), data.begin(), EqualsIgnoreCase);
+		case GlobMatchSuffix:
+			return data.size() >= m_Literal.size() && std::equal(m_Literal.begin(), m_Literal.end(), data.end() - m_Literal.size(), EqualsIgnoreCase);
+		case GlobMatchInfix:
+			return std::search(data.begin(), data.end(), m_Literal.begin(), m_Literal.end(), EqualsIgnoreCase) != data.end();
+		default:
+			return match(m_Pattern.CStr(), text.CStr()) == 0;
+	}
+}
+
+GlobKind GlobPattern::GetKind() const
+{
+	return m_Kind;
+}
+
+namespace
+{
+
+template<typename T>
+class CompiledPatterns
+{
+public:
+	CompiledPatterns(std::atomic<uint64_t>& hits, std::atomic<uint64_t>& misses)
+		: m_Hits(hits), m_Misses(misses)
+	{ }
+
+	template<typename F>
+	std::shared_ptr<const T> Get(const std::string& key, const F& compile)
+	{
+		Shard& shard = m_Shards[std::hash<std::string>()(key) % PATTERN_CACHE_SHARDS];
+
+		{
+			boost::mutex::scoped_lock lock(shard.Mutex);
+
+			auto it = shard.Patterns.find(key);
+
+			if (it != shard.Patterns.end()) {
+				m_Hits.fetch_add(1, std::memory_order_relaxed);
+				return it->second;
+			}
+		}
+
+		m_Misses.fetch_add(1, std::memory_order_relaxed);
+
+		/* Compile the pattern without holding the lock. Invalid patterns throw and are not cached. */
+		std::shared_ptr<const T> compiled = compile();
+
+		boost::mutex::scoped_lock lock(shard.Mutex);
+
+		/* Patterns which are built at runtime (e.g. from API filters) must not
+		 * grow the cache without bounds. */
+		if (shard.Patterns.size() >= PATTERN_CACHE_SHARD_SIZE)
+			shard.Patterns.clear();
+
+		shard.Patterns.emplace(key, compiled);
+
+		return compiled;
+	}
+
+	size_t GetSize()
+	{
+		size_t size = 0;
+
+		for (Shard& shard : m_Shards) {
+			boost::mutex::scoped_lock lock(shard.Mutex);
+			size += shard.Patterns.size();
+		}
+
+		return size;
+	}
+
+private:
+	struct Shard
+	{
+		boost::mutex Mutex;
+		std::unordered_map<std::string, std::shared_ptr<const T> > Patterns;
+	};
+
+	Shard m_Shards[PATTERN_CACHE_SHARDS];
+	std::atomic<uint64_t>& m_Hits;
+	std::atomic<uint64_t>& m_Misses;
+};
+
+}
+
+static CompiledPatterns<GlobPattern>& GetGlobPatterns()
+{
+	static CompiledPatterns<GlobPattern> patterns(l_GlobHits, l_GlobMisses);
+	return patterns;
+}
+
+static CompiledPatterns<boost::regex>& GetRegexPatterns()
+{
+	static CompiledPatterns<boost::regex> patterns(l_RegexHits, l_RegexMisses);
+	return patterns;
+}
+
+/**
+ * Checks whether the text matches the wildcard pattern, using the compiled
+ * version of the pattern.
+ *
+ * @param pattern The pattern.
+ * @param text The text.
+ * @returns true if the text matches, false otherwise.
+ */
+bool PatternCache::MatchGlob(const String& pattern, const String& text)
+{
+	/* Patterns without special characters only match the same string, so
+	 * they don't need to be looked up. */
+	if (pattern.FindFirstOf("*?\\") == String::NPos) {
+		const std::string& pdata = pattern.GetData();
+		const std::string& tdata = text.GetData();
+
+		return pdata.size() == tdata.size() && std::equal(pdata.begin(), pdata.end(), tdata.begin(), EqualsIgnoreCase);
+	}
+
+	return GetGlob(pattern)->Match(text);
+}
+
+/**
+ * Returns the compiled version of a wildcard pattern.
+ *
+ * @param pattern The pattern.
+ * @returns The compiled pattern.
+ */
+std::shared_ptr<const GlobPattern> PatternCache::GetGlob(const String& pattern)
+{
+	return GetGlobPatterns().Get(pattern.GetData(), [&pattern]() {
+		return std::make_shared<const GlobPattern>(pattern);
+	});
+}
+
+/**
+ * Returns the compiled version of a regular expression. Throws a
+ * boost::regex_error if the expression is invalid.
+ *
+ * @param pattern The regular expression.
+ * @param flags The flags for boost::regex, e.g. boost::regex::icase.
+ * @returns The compiled regular expression.
+ */
+std::shared_ptr<const boost::regex> PatternCache::GetRegex(const String& pattern, boost::regex::flag_type flags)
+{
+	std::string key = std::to_string(flags) + ":" + pattern.GetData();
+
+	return GetRegexPatterns().Get(key, [&pattern, flags]() {
+		return std::make_shared<const boost::regex>(pattern.GetData(), flags);
+	});
+}
+
+uint64_t PatternCache::GetHits()
+{
+	return l_GlobHits.load() + l_RegexHits.load();
+}
+
+uint64_t PatternCache::GetMisses()
+{
+	return l_GlobMisses.load() + l_RegexMisses.load();
+}
+
+static void PatternCacheStatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	status->Set("pattern_cache", new Dictionary({
+		{ "glob_hits", l_GlobHits.load() },
+		{ "glob_misses", l_GlobMisses.load() },
+		{ "glob_entries", GetGlobPatterns().GetSize() },
+		{ "regex_hits", l_RegexHits.load() },
+		{ "regex_misses", l_RegexMisses.load() },
+		{ "regex_entries", GetRegexPatterns().GetSize() }
+	}));
+
+	perfdata->Add(new PerfdataValue("pattern_cache_hits", PatternCache::GetHits()));
+	perfdata->Add(new PerfdataValue("pattern_cache_misses", PatternCache::GetMisses()));
+}
+
+REGISTER_STATSFUNCTION(PatternCache, &PatternCacheStatsFunc);
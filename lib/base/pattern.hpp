@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+#include <boost/regex.hpp>
+#include <cstdint>
+#include <memory>
+
+namespace icinga
+{
+
+/**
+ * The shapes of wildcard patterns which can be matched without
+ * backtracking.
+ *
+ * @ingroup base
+ */
+enum GlobKind
+{
+	GlobMatchAll,
+	GlobMatchExact,
+	GlobMatchPrefix,
+	GlobMatchSuffix,
+	GlobMatchInfix,
+	GlobMatchGeneric
+};
+
+/**
+ * A wildcard pattern as used by Utility::Match(). The pattern is
+ * classified once so that common shapes like "prefix*", "*suffix" and
+ * "*infix*" are matched with a single comparison.
+ *
+ * @ingroup base
+ */
+class GlobPattern
+{
+public:
+	GlobPattern(const String& pattern);
+
+	bool Match(const String& text) const;
+
+	GlobKind GetKind() const;
+
+private:
+	String m_Pattern;
+	GlobKind m_Kind;
+	std::string m_Literal;
+};
+
+/**
+ * A bounded cache for compiled wildcard patterns and regular expressions.
+ *
+ * @ingroup base
+ */
+class PatternCache
+{
+public:
+	static bool MatchGlob(const String& pattern, const String& text);
+
+	static std::shared_ptr<const GlobPattern> GetGlob(const String& pattern);
+	static std::shared_ptr<const boost::regex> GetRegex(const String& pattern, boost::regex::flag_type flags = boost::regex::normal);
+
+	static uint64_t GetHits();
+	static uint64_t GetMisses();
+
+private:
+	PatternCache();
+};
+
+}
+
+#endif /* PATTERN_H */
@@ -22,6 +22,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/perfdatavalue-ti.hpp"
+#include "base/objectpool.hpp"
 
 namespace icinga
 {
@@ -35,6 +36,7 @@ class PerfdataValue final : public ObjectImpl<PerfdataValue>
 {
 public:
 	DECLARE_OBJECT(PerfdataValue);
+	DECLARE_POOLED_ALLOCATOR();
 
 	PerfdataValue() = default;
 
@@ -27,9 +27,11 @@
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/scriptglobal.hpp"
-#include "base/json.hpp"
+#include "base/tracing.hpp"
 #include <boost/algorithm/string/join.hpp>
 #include <boost/thread/once.hpp>
+#include <atomic>
+#include <set>
 #include <thread>
 #include <iostream>
 
@@ -37,6 +39,9 @@
 #	include <execvpe.h>
 #	include <poll.h>
 #	include <string.h>
+#	ifdef __linux__
+#		include <sys/epoll.h>
+#	endif /* __linux__ */
 
 #	ifndef __APPLE__
 extern char **environ;
@@ -48,28 +53,177 @@ extern char **environ;
 
 using namespace icinga;
 
-#define IOTHREADS 4
+#define DEFAULT_IOTHREADS 4
+#define SPAWN_HELPERS 4
 
-static boost::mutex l_ProcessMutex[IOTHREADS];
-static std::map<Process::ProcessHandle, Process::Ptr> l_Processes[IOTHREADS];
-#ifdef _WIN32
-static HANDLE l_Events[IOTHREADS];
-#else /* _WIN32 */
-static int l_EventFDs[IOTHREADS][2];
-static std::map<Process::ConsoleHandle, Process::ProcessHandle> l_FDs[IOTHREADS];
+/* Output buffers come in size classes of 4 KiB, 16 KiB, ..., 4 MiB. */
+#define OUTPUT_SIZE_CLASSES 6
+#define OUTPUT_MIN_BUFFER_SIZE 4096
+#define OUTPUT_POOL_SIZE 16
+#define OUTPUT_DEFAULT_MAX_SIZE (1024 * 1024)
+
+#ifndef _WIN32
+/**
+ * A spawn helper process as seen from the main process.
+ */
+struct ProcessSpawnHelper
+{
+	boost::mutex Mutex;
+	int FD{-1};
+	pid_t PID{-1};
+};
+
+static ProcessSpawnHelper l_SpawnHelpers[SPAWN_HELPERS];
+static std::atomic<unsigned int> l_NextSpawnHelper(0);
 
-static boost::mutex l_ProcessControlMutex;
+/* The control FD inside of a spawn helper process. */
 static int l_ProcessControlFD = -1;
-static pid_t l_ProcessControlPID;
+
+/*
+ * Requests are sent to the spawn helpers in a compact binary format: a fixed
+ * header which is followed by Length bytes of command-specific payload. Spawn
+ * requests carry the FDs for the child process as SCM_RIGHTS ancillary data
+ * and their payload consists of a ProcessHelperSpawnRequest followed by the
+ * NUL-terminated arguments and extra environment variables ("key=value").
+ */
+enum ProcessHelperCommand
+{
+	ProcessHelperSpawn,
+	ProcessHelperWaitPID,
+	ProcessHelperKill
+};
+
+struct ProcessHelperRequestHeader
+{
+	uint32_t Length;
+	uint32_t Command;
+};
+
+struct ProcessHelperSpawnRequest
+{
+	uint32_t AdjustPriority;
+	uint32_t ArgumentCount;
+	uint32_t EnvironmentCount;
+};
+
+struct ProcessHelperPIDRequest
+{
+	int32_t PID;
+	int32_t Signal;
+};
+
+struct ProcessHelperResponse
+{
+	int32_t Result;
+	int32_t Value;
+};
 #endif /* _WIN32 */
+static std::atomic<uint_fast64_t> l_SpawnFailures(0);
 static boost::once_flag l_ProcessOnceFlag = BOOST_ONCE_INIT;
+static boost::once_flag l_MaxOutputSizeOnceFlag = BOOST_ONCE_INIT;
+static size_t l_MaxOutputSize;
+
+/**
+ * Free output buffers for the processes handled by one IO thread.
+ */
+struct ProcessOutputBufferPool
+{
+	boost::mutex Mutex;
+	std::vector<char *> Buffers[OUTPUT_SIZE_CLASSES];
+};
+
+/**
+ * The state of one process I/O thread.
+ */
+struct ProcessIOThread
+{
+	boost::mutex Mutex;
+	std::map<Process::ProcessHandle, Process::Ptr> Processes;
+	std::atomic<int> ProcessCount{0};
+
+	/* The processes which have a timeout, ordered by their deadline. */
+	std::set<std::pair<double, Process::ProcessHandle> > Deadlines;
+
+#ifdef _WIN32
+	HANDLE Event;
+#else /* _WIN32 */
+	int EventFDs[2];
+	std::map<Process::ConsoleHandle, Process::ProcessHandle> FDs;
+#	ifdef __linux__
+	int PollFD{-1};
+#	endif /* __linux__ */
+#endif /* _WIN32 */
+
+	ProcessOutputBufferPool OutputBuffers;
+};
+
+static ProcessIOThread *l_IOThreads;
+static int l_IOThreadCount;
+
+static size_t GetOutputBufferSize(int sizeClass)
+{
+	return static_cast<size_t>(OUTPUT_MIN_BUFFER_SIZE) << (2 * sizeClass);
+}
+
+static char *AcquireOutputBuffer(int tid, int sizeClass)
+{
+	ProcessOutputBufferPool& pool = l_IOThreads[tid].OutputBuffers;
+
+	{
+		boost::mutex::scoped_lock lock(pool.Mutex);
+
+		std::vector<char *>& buffers = pool.Buffers[sizeClass];
+
+		if (!buffers.empty()) {
+			char *buffer = buffers.back();
+			buffers.pop_back();
+			return buffer;
+		}
+	}
+
+	return new char[GetOutputBufferSize(sizeClass)];
+}
+
+static void ReleaseOutputBuffer(int tid, int sizeClass, char *buffer)
+{
+	ProcessOutputBufferPool& pool = l_IOThreads[tid].OutputBuffers;
+
+	{
+		boost::mutex::scoped_lock lock(pool.Mutex);
+
+		std::vector<char *>& buffers = pool.Buffers[sizeClass];
+
+		if (buffers.size() < OUTPUT_POOL_SIZE) {
+			buffers.push_back(buffer);
+			return;
+		}
+	}
+
+	delete [] buffer;
+}
+
+static void InitializeMaxOutputSize()
+{
+	Value maxOutputSize = ScriptGlobal::Get("MaxPluginOutputSize", &Empty);
+
+	if (maxOutputSize.IsEmpty() || maxOutputSize <= 0)
+		l_MaxOutputSize = OUTPUT_DEFAULT_MAX_SIZE;
+	else
+		l_MaxOutputSize = static_cast<size_t>(maxOutputSize);
+
+	l_MaxOutputSize = std::min(l_MaxOutputSize, GetOutputBufferSize(OUTPUT_SIZE_CLASSES - 1));
+}
 static boost::once_flag l_SpawnHelperOnceFlag = BOOST_ONCE_INIT;
 
 Process::Process(Process::Arguments arguments, Dictionary::Ptr extraEnvironment)
-	: m_Arguments(std::move(arguments)), m_ExtraEnvironment(std::move(extraEnvironment)), m_Timeout(600), m_AdjustPriority(false)
+	: m_Arguments(std::move(arguments)), m_ExtraEnvironment(std::move(extraEnvironment)), m_Timeout(600), m_AdjustPriority(false),
+	m_OutputBuffer(nullptr), m_OutputLength(0), m_OutputSizeClass(-1), m_OutputTruncated(false)
 #ifdef _WIN32
 	, m_ReadPending(false), m_ReadFailed(false), m_Overlapped()
+#else /* _WIN32 */
+	, m_SpawnHelper(0)
 #endif /* _WIN32 */
+	, m_TID(-1)
 {
 #ifdef _WIN32
 	m_Overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
@@ -81,63 +235,189 @@ Process::~Process()
 #ifdef _WIN32
 	CloseHandle(m_Overlapped.hEvent);
 #endif /* _WIN32 */
+
+	FreeOutputBuffer();
+}
+
+/**
+ * Makes room for more output in the output buffer, moving the output into a
+ * buffer of the next size class if necessary.
+ *
+ * @returns The number of bytes which can be appended to the buffer, zero
+ *          if the output size limit has been reached.
+ */
+size_t Process::ReserveOutput()
+{
+	if (m_OutputLength >= l_MaxOutputSize)
+		return 0;
+
+	if (!m_OutputBuffer) {
+		m_OutputSizeClass = 0;
+		m_OutputBuffer = AcquireOutputBuffer(GetTID(), m_OutputSizeClass);
+	} else if (m_OutputLength == GetOutputBufferSize(m_OutputSizeClass)) {
+		char *buffer = AcquireOutputBuffer(GetTID(), m_OutputSizeClass + 1);
+		memcpy(buffer, m_OutputBuffer, m_OutputLength);
+		ReleaseOutputBuffer(GetTID(), m_OutputSizeClass, m_OutputBuffer);
+		m_OutputBuffer = buffer;
+		m_OutputSizeClass++;
+	}
+
+	return std::min(GetOutputBufferSize(m_OutputSizeClass), l_MaxOutputSize) - m_OutputLength;
+}
+
+void Process::AppendOutput(const char *data, size_t length)
+{
+	while (length > 0 && !m_OutputTruncated) {
+		size_t count = std::min(ReserveOutput(), length);
+
+		if (count == 0) {
+			m_OutputTruncated = true;
+			break;
+		}
+
+		memcpy(m_OutputBuffer + m_OutputLength, data, count);
+		m_OutputLength += count;
+		data += count;
+		length -= count;
+	}
+}
+
+void Process::FreeOutputBuffer()
+{
+	if (!m_OutputBuffer)
+		return;
+
+	ReleaseOutputBuffer(GetTID(), m_OutputSizeClass, m_OutputBuffer);
+	m_OutputBuffer = nullptr;
+	m_OutputLength = 0;
+	m_OutputSizeClass = -1;
 }
 
 #ifndef _WIN32
-static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& request)
+static bool SendAll(int fd, const char *buffer, size_t length)
 {
+	while (length > 0) {
+		ssize_t rc = send(fd, buffer, length, 0);
+
+		if (rc < 0 && errno == EINTR)
+			continue;
+
+		if (rc <= 0)
+			return false;
+
+		buffer += rc;
+		length -= rc;
+	}
+
+	return true;
+}
+
+static bool RecvAll(int fd, char *buffer, size_t length)
+{
+	while (length > 0) {
+		ssize_t rc = recv(fd, buffer, length, 0);
+
+		if (rc < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+
+		if (rc <= 0)
+			return false;
+
+		buffer += rc;
+		length -= rc;
+	}
+
+	return true;
+}
+
+/* Only async-signal-safe functions may be used between vfork() and exec. */
+static void ReportChildError(const char *message)
+{
+	const char *error = strerror(errno);
+
+	(void)write(STDERR_FILENO, message, strlen(message));
+	(void)write(STDERR_FILENO, ": ", 2);
+	(void)write(STDERR_FILENO, error, strlen(error));
+	(void)write(STDERR_FILENO, "\n", 1);
+}
+
+static ProcessHelperResponse ProcessSpawnImpl(struct msghdr *msgh, const std::vector<char>& payload)
+{
+	ProcessHelperResponse response;
+	response.Result = -1;
+	response.Value = EINVAL;
+
 	struct cmsghdr *cmsg = CMSG_FIRSTHDR(msgh);
 
 	if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 3)) {
 		std::cerr << "Invalid 'spawn' request: FDs missing" << std::endl;
-		return Empty;
+		return response;
 	}
 
-	auto *fds = (int *)CMSG_DATA(cmsg);
+	int fds[3];
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
 
-	Array::Ptr arguments = request->Get("arguments");
-	Dictionary::Ptr extraEnvironment = request->Get("extraEnvironment");
-	bool adjustPriority = request->Get("adjustPriority");
+	ProcessHelperSpawnRequest request;
 
-	// build argv
-	auto **argv = new char *[arguments->GetLength() + 1];
+	if (payload.size() < sizeof(request)) {
+		std::cerr << "Invalid 'spawn' request: Payload too short" << std::endl;
+
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		(void)close(fds[2]);
 
-	for (unsigned int i = 0; i < arguments->GetLength(); i++) {
-		String arg = arguments->Get(i);
-		argv[i] = strdup(arg.CStr());
+		return response;
 	}
 
-	argv[arguments->GetLength()] = nullptr;
+	memcpy(&request, &payload[0], sizeof(request));
 
-	// build envp
-	int envc = 0;
+	/* The arguments and environment variables are used in-place, the payload
+	 * buffer only has to stay valid until the child process has called exec. */
+	std::vector<char *> strings;
+	const char *begin = &payload[0] + sizeof(request);
+	const char *end = &payload[0] + payload.size();
+
+	while (begin < end) {
+		const char *term = static_cast<const char *>(memchr(begin, '\0', end - begin));
 
-	/* count existing environment variables */
-	while (environ[envc])
-		envc++;
+		if (!term)
+			break;
 
-	auto **envp = new char *[envc + (extraEnvironment ? extraEnvironment->GetLength() : 0) + 2];
+		strings.push_back(const_cast<char *>(begin));
+		begin = term + 1;
+	}
 
-	for (int i = 0; i < envc; i++)
-		envp[i] = strdup(environ[i]);
+	if (request.ArgumentCount == 0 || strings.size() != request.ArgumentCount + request.EnvironmentCount) {
+		std::cerr << "Invalid 'spawn' request: Malformed payload" << std::endl;
 
-	if (extraEnvironment) {
-		ObjectLock olock(extraEnvironment);
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		(void)close(fds[2]);
 
-		int index = envc;
-		for (const Dictionary::Pair& kv : extraEnvironment) {
-			String skv = kv.first + "=" + Convert::ToString(kv.second);
-			envp[index] = strdup(skv.CStr());
-			index++;
-		}
+		return response;
 	}
 
-	envp[envc + (extraEnvironment ? extraEnvironment->GetLength() : 0)] = strdup("LC_NUMERIC=C");
-	envp[envc + (extraEnvironment ? extraEnvironment->GetLength() : 0) + 1] = nullptr;
+	// build argv
+	std::vector<char *> argv(strings.begin(), strings.begin() + request.ArgumentCount);
+	argv.push_back(nullptr);
 
-	extraEnvironment.reset();
+	// build envp
+	std::vector<char *> envp;
+
+	for (int i = 0; environ[i]; i++)
+		envp.push_back(environ[i]);
+
+	envp.insert(envp.end(), strings.begin() + request.ArgumentCount, strings.end());
+	envp.push_back(const_cast<char *>("LC_NUMERIC=C"));
+	envp.push_back(nullptr);
 
+	/* vfork() doesn't have to copy the helper's page tables; the child only
+	 * calls async-signal-safe functions until it execs or exits. */
+#ifdef HAVE_VFORK
+	pid_t pid = vfork();
+#else /* HAVE_VFORK */
 	pid_t pid = fork();
+#endif /* HAVE_VFORK */
 
 	int errorCode = 0;
 
@@ -150,12 +430,12 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 		(void)close(l_ProcessControlFD);
 
 		if (setsid() < 0) {
-			perror("setsid() failed");
+			ReportChildError("setsid() failed");
 			_exit(128);
 		}
 
 		if (dup2(fds[0], STDIN_FILENO) < 0 || dup2(fds[1], STDOUT_FILENO) < 0 || dup2(fds[2], STDERR_FILENO) < 0) {
-			perror("dup2() failed");
+			ReportChildError("dup2() failed");
 			_exit(128);
 		}
 
@@ -164,21 +444,21 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 		(void)close(fds[2]);
 
 #ifdef HAVE_NICE
-		if (adjustPriority)
-			nice(5);
+		if (request.AdjustPriority)
+			(void)nice(5);
 #endif /* HAVE_NICE */
 
 		sigset_t mask;
 		sigemptyset(&mask);
 		sigprocmask(SIG_SETMASK, &mask, nullptr);
 
-		if (icinga2_execvpe(argv[0], argv, envp) < 0) {
+		if (icinga2_execvpe(argv[0], &argv[0], &envp[0]) < 0) {
 			char errmsg[512];
 			strcpy(errmsg, "execvpe(");
 			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
 			strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
 			errmsg[sizeof(errmsg) - 1] = '\0';
-			perror(errmsg);
+			ReportChildError(errmsg);
 			_exit(128);
 		}
 
@@ -189,53 +469,32 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 	(void)close(fds[1]);
 	(void)close(fds[2]);
 
-	// free arguments
-	for (int i = 0; argv[i]; i++)
-		free(argv[i]);
-
-	delete[] argv;
-
-	// free environment
-	for (int i = 0; envp[i]; i++)
-		free(envp[i]);
-
-	delete[] envp;
-
-	Dictionary::Ptr response = new Dictionary({
-		{ "rc", pid },
-		{ "errno", errorCode }
-	});
+	response.Result = pid;
+	response.Value = errorCode;
 
 	return response;
 }
 
-static Value ProcessKillImpl(struct msghdr *msgh, const Dictionary::Ptr& request)
+static ProcessHelperResponse ProcessKillImpl(const ProcessHelperPIDRequest& request)
 {
-	pid_t pid = request->Get("pid");
-	int signum = request->Get("signum");
-
 	errno = 0;
-	kill(pid, signum);
-	int error = errno;
+	kill(request.PID, request.Signal);
 
-	Dictionary::Ptr response = new Dictionary({
-		{ "errno", error }
-	});
+	ProcessHelperResponse response;
+	response.Result = 0;
+	response.Value = errno;
 
 	return response;
 }
 
-static Value ProcessWaitPIDImpl(struct msghdr *msgh, const Dictionary::Ptr& request)
+static ProcessHelperResponse ProcessWaitPIDImpl(const ProcessHelperPIDRequest& request)
 {
-	pid_t pid = request->Get("pid");
-
 	int status;
-	int rc = waitpid(pid, &status, 0);
+	int rc = waitpid(request.PID, &status, 0);
 
-	Dictionary::Ptr response = new Dictionary({
-		{ "status", status },
-		{ "rc", rc }
-	});
+	ProcessHelperResponse response;
+	response.Result = rc;
+	response.Value = status;
 
 	return response;
 }
@@ -258,15 +517,17 @@ static void ProcessHandler()
 				(void)close(i);
 	}
 
+	std::vector<char> payload;
+
 	for (;;) {
-		size_t length;
+		ProcessHelperRequestHeader header;
 
 		struct msghdr msg;
 		memset(&msg, 0, sizeof(msg));
 
 		struct iovec io;
-		io.iov_base = &length;
-		io.iov_len = sizeof(length);
+		io.iov_base = &header;
+		io.iov_len = sizeof(header);
 
 		msg.msg_iov = &io;
 		msg.msg_iovlen = 1;
@@ -284,49 +545,34 @@ static void ProcessHandler()
 			break;
 		}
 
-		auto *mbuf = new char[length];
+		if (static_cast<size_t>(rc) < sizeof(header) &&
+			!RecvAll(l_ProcessControlFD, reinterpret_cast<char *>(&header) + rc, sizeof(header) - rc))
+			_exit(0);
 
-		size_t count = 0;
-		while (count < length) {
-			rc = recv(l_ProcessControlFD, mbuf + count, length - count, 0);
+		payload.resize(header.Length);
 
-			if (rc <= 0) {
-				if (rc < 0 && (errno == EINTR || errno == EAGAIN))
-					continue;
+		if (header.Length > 0 && !RecvAll(l_ProcessControlFD, &payload[0], header.Length))
+			_exit(0);
 
-				delete [] mbuf;
+		ProcessHelperResponse response;
 
-				_exit(0);
-			}
-
-			count += rc;
+		if (header.Command == ProcessHelperSpawn)
+			response = ProcessSpawnImpl(&msg, payload);
+		else if ((header.Command == ProcessHelperWaitPID || header.Command == ProcessHelperKill) &&
+			payload.size() == sizeof(ProcessHelperPIDRequest)) {
+			ProcessHelperPIDRequest request;
+			memcpy(&request, &payload[0], sizeof(request));
 
-			if (rc == 0)
-				break;
+			if (header.Command == ProcessHelperWaitPID)
+				response = ProcessWaitPIDImpl(request);
+			else
+				response = ProcessKillImpl(request);
+		} else {
+			response.Result = -1;
+			response.Value = EINVAL;
 		}
 
-		String jrequest = String(mbuf, mbuf + count);
-
-		delete [] mbuf;
-
-		Dictionary::Ptr request = JsonDecode(jrequest);
-
-		String command = request->Get("command");
-
-		Value response;
-
-		if (command == "spawn")
-			response = ProcessSpawnImpl(&msg, request);
-		else if (command == "waitpid")
-			response = ProcessWaitPIDImpl(&msg, request);
-		else if (command == "kill")
-			response = ProcessKillImpl(&msg, request);
-		else
-			response = Empty;
-
-		String jresponse = JsonEncode(response);
-
-		if (send(l_ProcessControlFD, jresponse.CStr(), jresponse.GetLength(), 0) < 0) {
+		if (!SendAll(l_ProcessControlFD, reinterpret_cast<const char *>(&response), sizeof(response))) {
 			BOOST_THROW_EXCEPTION(posix_error()
 				<< boost::errinfo_api_function("send")
 				<< boost::errinfo_errno(errno));
@@ -336,13 +582,13 @@ static void ProcessHandler()
 	_exit(0);
 }
 
-static void StartSpawnProcessHelper()
+static void StartSpawnProcessHelper(ProcessSpawnHelper& helper)
 {
-	if (l_ProcessControlFD != -1) {
-		(void)close(l_ProcessControlFD);
+	if (helper.FD != -1) {
+		(void)close(helper.FD);
 
 		int status;
-		(void)waitpid(l_ProcessControlPID, &status, 0);
+		(void)waitpid(helper.PID, &status, 0);
 	}
 
 	int controlFDs[2];
@@ -372,183 +618,268 @@ static void StartSpawnProcessHelper()
 
 	(void)close(controlFDs[0]);
 
-	l_ProcessControlFD = controlFDs[1];
-	l_ProcessControlPID = pid;
+	helper.FD = controlFDs[1];
+	helper.PID = pid;
 }
 
-static pid_t ProcessSpawn(const std::vector<String>& arguments, const Dictionary::Ptr& extraEnvironment, bool adjustPriority, int fds[3])
+/* The caller must hold the helper's mutex. */
+static bool ProcessHelperRequest(ProcessSpawnHelper& helper, ProcessHelperCommand command,
+	const std::string& payload, const int *fds, ProcessHelperResponse& response)
 {
-	Dictionary::Ptr request = new Dictionary({
-		{ "command", "spawn" },
-		{ "arguments", Array::FromVector(arguments) },
-		{ "extraEnvironment", extraEnvironment },
-		{ "adjustPriority", adjustPriority }
-	});
+	ProcessHelperRequestHeader header;
+	header.Length = payload.size();
+	header.Command = command;
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
-
-	boost::mutex::scoped_lock lock(l_ProcessControlMutex);
+	std::string message(reinterpret_cast<const char *>(&header), sizeof(header));
+	message += payload;
 
 	struct msghdr msg;
 	memset(&msg, 0, sizeof(msg));
 
 	struct iovec io;
-	io.iov_base = &length;
-	io.iov_len = sizeof(length);
+	io.iov_base = const_cast<char *>(message.c_str());
+	io.iov_len = message.size();
 
 	msg.msg_iov = &io;
 	msg.msg_iovlen = 1;
 
 	char cbuf[CMSG_SPACE(sizeof(int) * 3)];
-	msg.msg_control = cbuf;
-	msg.msg_controllen = sizeof(cbuf);
 
-	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-	cmsg->cmsg_level = SOL_SOCKET;
-	cmsg->cmsg_type = SCM_RIGHTS;
-	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 3);
+	if (fds) {
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
 
-	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * 3);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 3);
 
-	msg.msg_controllen = cmsg->cmsg_len;
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * 3);
 
-send_message:
-	while (sendmsg(l_ProcessControlFD, &msg, 0) < 0)
-		StartSpawnProcessHelper();
+		msg.msg_controllen = cmsg->cmsg_len;
+	}
 
-	if (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0)
-		goto send_message;
+	for (;;) {
+		ssize_t rc = sendmsg(helper.FD, &msg, 0);
 
-	char buf[4096];
+		if (rc >= 0 && (static_cast<size_t>(rc) == message.size() ||
+			SendAll(helper.FD, message.c_str() + rc, message.size() - rc)))
+			break;
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
+		StartSpawnProcessHelper(helper);
+	}
 
-	if (rc <= 0)
-		return -1;
+	return RecvAll(helper.FD, reinterpret_cast<char *>(&response), sizeof(response));
+}
 
-	String jresponse = String(buf, buf + rc);
+static pid_t ProcessSpawn(const std::vector<String>& arguments, const Dictionary::Ptr& extraEnvironment, bool adjustPriority, int fds[3], int& helperIndex)
+{
+	ProcessHelperSpawnRequest request;
+	request.AdjustPriority = adjustPriority;
+	request.ArgumentCount = arguments.size();
+	request.EnvironmentCount = 0;
 
-	Dictionary::Ptr response = JsonDecode(jresponse);
+	std::string payload(reinterpret_cast<const char *>(&request), sizeof(request));
 
-	if (response->Get("rc") == -1)
-		errno = response->Get("errno");
+	for (const String& argument : arguments) {
+		payload += argument.GetData();
+		payload += '\0';
+	}
 
-	return response->Get("rc");
-}
+	if (extraEnvironment) {
+		ObjectLock olock(extraEnvironment);
 
-static int ProcessKill(pid_t pid, int signum)
-{
-	Dictionary::Ptr request = new Dictionary({
-		{ "command", "kill" },
-		{ "pid", pid },
-		{ "signum", signum }
-	});
+		for (const Dictionary::Pair& kv : extraEnvironment) {
+			payload += kv.first + "=" + Convert::ToString(kv.second);
+			payload += '\0';
+			request.EnvironmentCount++;
+		}
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
+		memcpy(&payload[0], &request, sizeof(request));
+	}
 
-	boost::mutex::scoped_lock lock(l_ProcessControlMutex);
+	/* Prefer an idle helper so that concurrent spawns don't queue up behind each other. */
+	unsigned int next = l_NextSpawnHelper++;
+	helperIndex = -1;
 
-send_message:
-	while (send(l_ProcessControlFD, &length, sizeof(length), 0) < 0)
-		StartSpawnProcessHelper();
+	for (int i = 0; i < SPAWN_HELPERS; i++) {
+		int index = (next + i) % SPAWN_HELPERS;
+
+		if (l_SpawnHelpers[index].Mutex.try_lock()) {
+			helperIndex = index;
+			break;
+		}
+	}
 
-	if (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0)
-		goto send_message;
+	if (helperIndex == -1) {
+		helperIndex = next % SPAWN_HELPERS;
+		l_SpawnHelpers[helperIndex].Mutex.lock();
+	}
 
-	char buf[4096];
+	ProcessSpawnHelper& helper = l_SpawnHelpers[helperIndex];
+	boost::mutex::scoped_lock lock(helper.Mutex, boost::adopt_lock);
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
+	ProcessHelperResponse response;
 
-	if (rc <= 0)
+	if (!ProcessHelperRequest(helper, ProcessHelperSpawn, payload, fds, response))
 		return -1;
 
-	String jresponse = String(buf, buf + rc);
+	if (response.Result == -1)
+		errno = response.Value;
 
-	Dictionary::Ptr response = JsonDecode(jresponse);
-	return response->Get("errno");
+	return response.Result;
 }
 
-static int ProcessWaitPID(pid_t pid, int *status)
+static int ProcessKill(int helperIndex, pid_t pid, int signum)
 {
-	Dictionary::Ptr request = new Dictionary({
-		{ "command", "waitpid" },
-		{ "pid", pid }
-	});
+	ProcessHelperPIDRequest request;
+	request.PID = pid;
+	request.Signal = signum;
+
+	std::string payload(reinterpret_cast<const char *>(&request), sizeof(request));
+
+	ProcessSpawnHelper& helper = l_SpawnHelpers[helperIndex];
+	boost::mutex::scoped_lock lock(helper.Mutex);
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
+	ProcessHelperResponse response;
 
-	boost::mutex::scoped_lock lock(l_ProcessControlMutex);
+	if (!ProcessHelperRequest(helper, ProcessHelperKill, payload, nullptr, response))
+		return -1;
 
-send_message:
-	while (send(l_ProcessControlFD, &length, sizeof(length), 0) < 0)
-		StartSpawnProcessHelper();
+	return response.Value;
+}
 
-	if (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0)
-		goto send_message;
+static int ProcessWaitPID(int helperIndex, pid_t pid, int *status)
+{
+	ProcessHelperPIDRequest request;
+	request.PID = pid;
+	request.Signal = 0;
 
-	char buf[4096];
+	std::string payload(reinterpret_cast<const char *>(&request), sizeof(request));
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
+	ProcessSpawnHelper& helper = l_SpawnHelpers[helperIndex];
+	boost::mutex::scoped_lock lock(helper.Mutex);
 
-	if (rc <= 0)
-		return -1;
+	ProcessHelperResponse response;
 
-	String jresponse = String(buf, buf + rc);
+	if (!ProcessHelperRequest(helper, ProcessHelperWaitPID, payload, nullptr, response))
+		return -1;
 
-	Dictionary::Ptr response = JsonDecode(jresponse);
-	*status = response->Get("status");
-	return response->Get("rc");
+	*status = response.Value;
+	return response.Result;
 }
 
 void Process::InitializeSpawnHelper()
 {
-	if (l_ProcessControlFD == -1)
-		StartSpawnProcessHelper();
+	for (ProcessSpawnHelper& helper : l_SpawnHelpers) {
+		if (helper.FD == -1)
+			StartSpawnProcessHelper(helper);
+	}
+}
+
+/**
+ * Starts a process through one of the spawn helpers without tracking its
+ * output. The caller is responsible for reaping it with WaitPID().
+ *
+ * @param arguments The command line.
+ * @param extraEnvironment Additional environment variables.
+ * @param fds The file descriptors for stdin, stdout and stderr.
+ * @param spawnHelper Set to the spawn helper which started the process.
+ * @returns The PID, or -1 if the process could not be started.
+ */
+pid_t Process::Spawn(const Arguments& arguments, const Dictionary::Ptr& extraEnvironment, int fds[3], int& spawnHelper)
+{
+	boost::call_once(l_SpawnHelperOnceFlag, &Process::InitializeSpawnHelper);
+
+	return ProcessSpawn(arguments, extraEnvironment, true, fds, spawnHelper);
+}
+
+int Process::Kill(int spawnHelper, pid_t pid, int signum)
+{
+	return ProcessKill(spawnHelper, pid, signum);
+}
+
+int Process::WaitPID(int spawnHelper, pid_t pid, int *status)
+{
+	return ProcessWaitPID(spawnHelper, pid, status);
 }
 #endif /* _WIN32 */
 
-static void InitializeProcess()
+#ifndef _WIN32
+static void CreateEventPipe(int fds[2])
 {
-#ifdef _WIN32
-	for (auto& event : l_Events) {
-		event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
-	}
-#else /* _WIN32 */
-	for (auto& eventFD : l_EventFDs) {
 #	ifdef HAVE_PIPE2
-		if (pipe2(eventFD, O_CLOEXEC) < 0) {
-			if (errno == ENOSYS) {
+	if (pipe2(fds, O_CLOEXEC) < 0) {
+		if (errno == ENOSYS) {
 #	endif /* HAVE_PIPE2 */
-				if (pipe(eventFD) < 0) {
-					BOOST_THROW_EXCEPTION(posix_error()
-						<< boost::errinfo_api_function("pipe")
-						<< boost::errinfo_errno(errno));
-				}
-
-				Utility::SetCloExec(eventFD[0]);
-				Utility::SetCloExec(eventFD[1]);
-#	ifdef HAVE_PIPE2
-			} else {
+			if (pipe(fds) < 0) {
 				BOOST_THROW_EXCEPTION(posix_error()
-					<< boost::errinfo_api_function("pipe2")
+					<< boost::errinfo_api_function("pipe")
 					<< boost::errinfo_errno(errno));
 			}
+
+			Utility::SetCloExec(fds[0]);
+			Utility::SetCloExec(fds[1]);
+#	ifdef HAVE_PIPE2
+		} else {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("pipe2")
+				<< boost::errinfo_errno(errno));
 		}
-#	endif /* HAVE_PIPE2 */
 	}
-#endif /* _WIN32 */
-}
+#	endif /* HAVE_PIPE2 */
 
-INITIALIZE_ONCE(InitializeProcess);
+	Utility::SetNonBlocking(fds[0]);
+	Utility::SetNonBlocking(fds[1]);
+}
+#endif /* _WIN32 */
 
 void Process::ThreadInitialize()
 {
 	/* Note to self: Make sure this runs _after_ we've daemonized. */
-	for (int tid = 0; tid < IOTHREADS; tid++) {
+	Value defaultThreads = DEFAULT_IOTHREADS;
+	int threads = ScriptGlobal::Get("ProcessIOThreads", &defaultThreads);
+
+	if (threads < 1)
+		threads = 1;
+
+	l_IOThreads = new ProcessIOThread[threads];
+	l_IOThreadCount = threads;
+
+	for (int tid = 0; tid < threads; tid++) {
+		ProcessIOThread& thread = l_IOThreads[tid];
+
+#ifdef _WIN32
+		thread.Event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+#else /* _WIN32 */
+		CreateEventPipe(thread.EventFDs);
+
+#	ifdef __linux__
+		thread.PollFD = epoll_create1(EPOLL_CLOEXEC);
+
+		if (thread.PollFD < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("epoll_create1")
+				<< boost::errinfo_errno(errno));
+		}
+
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.data.fd = thread.EventFDs[0];
+		event.events = EPOLLIN;
+		epoll_ctl(thread.PollFD, EPOLL_CTL_ADD, thread.EventFDs[0], &event);
+#	endif /* __linux__ */
+#endif /* _WIN32 */
+	}
+
+	ScriptGlobal::Set("ProcessIOThreads", threads);
+
+	for (int tid = 0; tid < threads; tid++) {
+#ifdef __linux__
+		std::thread t(std::bind(&Process::EpollIOThreadProc, tid));
+#else /* __linux__ */
 		std::thread t(std::bind(&Process::IOThreadProc, tid));
+#endif /* __linux__ */
 		t.detach();
 	}
 }
@@ -606,8 +937,182 @@ bool Process::GetAdjustPriority() const
 	return m_AdjustPriority;
 }
 
+/**
+ * Picks the I/O thread for a new process: the one which currently handles
+ * the fewest processes.
+ */
+static int AssignIOThread()
+{
+	int best = 0;
+	int bestCount = l_IOThreads[0].ProcessCount.load();
+
+	for (int tid = 1; tid < l_IOThreadCount; tid++) {
+		int count = l_IOThreads[tid].ProcessCount.load();
+
+		if (count < bestCount) {
+			best = tid;
+			bestCount = count;
+		}
+	}
+
+	l_IOThreads[best].ProcessCount++;
+
+	return best;
+}
+
+/**
+ * Adds the process to its I/O thread. Must be called after the process
+ * has been started.
+ */
+void Process::Register()
+{
+	ProcessIOThread& thread = l_IOThreads[m_TID];
+	bool wakeUp = true;
+
+	{
+		boost::mutex::scoped_lock lock(thread.Mutex);
+
+		thread.Processes[m_Process] = this;
+
+		if (m_Timeout != 0)
+			thread.Deadlines.insert(std::make_pair(m_Result.ExecutionStart + m_Timeout, m_Process));
+
+#ifndef _WIN32
+		thread.FDs[m_FD] = m_Process;
+
+#	ifdef __linux__
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		event.data.fd = m_FD;
+		event.events = EPOLLIN;
+
+		if (epoll_ctl(thread.PollFD, EPOLL_CTL_ADD, m_FD, &event) < 0) {
+			Log(LogCritical, "Process")
+				<< "epoll_ctl() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		}
+
+		/* The FD is watched right away, the thread only needs to be woken
+		 * up when the process has the thread's earliest deadline. */
+		wakeUp = (m_Timeout != 0 && thread.Deadlines.begin()->second == m_Process);
+#	endif /* __linux__ */
+#endif /* _WIN32 */
+	}
+
+	if (!wakeUp)
+		return;
+
+#ifdef _WIN32
+	SetEvent(thread.Event);
+#else /* _WIN32 */
+	if (write(thread.EventFDs[1], "T", 1) < 0 && errno != EINTR && errno != EAGAIN)
+		Log(LogCritical, "base", "Write to event FD failed.");
+#endif /* _WIN32 */
+}
+
+/**
+ * Removes the process from its I/O thread and closes its handles. Must be
+ * called with the thread's mutex held.
+ */
+void Process::Unregister()
+{
+	ProcessIOThread& thread = l_IOThreads[m_TID];
+
+	if (m_Timeout != 0)
+		thread.Deadlines.erase(std::make_pair(m_Result.ExecutionStart + m_Timeout, m_Process));
+
+#ifdef _WIN32
+	CloseHandle(m_Process);
+	CloseHandle(m_FD);
+#else /* _WIN32 */
+	thread.FDs.erase(m_FD);
+
+	/* Closing the FD also removes it from the epoll set. */
+	(void)close(m_FD);
+#endif /* _WIN32 */
+
+	thread.ProcessCount--;
+
+	thread.Processes.erase(m_Process);
+}
+
+#ifdef __linux__
+void Process::EpollIOThreadProc(int tid)
+{
+	ProcessIOThread& thread = l_IOThreads[tid];
+	epoll_event events[128];
+
+	Utility::SetThreadName("ProcessIO");
+
+	for (;;) {
+		int timeout = -1;
+
+		{
+			boost::mutex::scoped_lock lock(thread.Mutex);
+
+			if (!thread.Deadlines.empty()) {
+				double delta = thread.Deadlines.begin()->first - Utility::GetTime();
+				timeout = std::max(delta, 0.01) * 1000;
+			}
+		}
+
+		int rc = epoll_wait(thread.PollFD, events, sizeof(events) / sizeof(events[0]), timeout);
+
+		if (rc < 0)
+			continue;
+
+		boost::mutex::scoped_lock lock(thread.Mutex);
+
+		for (int i = 0; i < rc; i++) {
+			int fd = events[i].data.fd;
+
+			if (fd == thread.EventFDs[0]) {
+				char buffer[512];
+				if (read(fd, buffer, sizeof(buffer)) < 0 && errno != EAGAIN)
+					Log(LogCritical, "base", "Read from event FD failed.");
+
+				continue;
+			}
+
+			auto it2 = thread.FDs.find(fd);
+
+			if (it2 == thread.FDs.end())
+				continue; /* The process was removed earlier in this round. */
+
+			auto it = thread.Processes.find(it2->second);
+
+			if (it == thread.Processes.end())
+				continue; /* This should never happen. */
+
+			Process::Ptr process = it->second;
+
+			if (!process->DoEvents())
+				process->Unregister();
+		}
+
+		double now = Utility::GetTime();
+
+		while (!thread.Deadlines.empty() && thread.Deadlines.begin()->first < now) {
+			ProcessHandle handle = thread.Deadlines.begin()->second;
+			thread.Deadlines.erase(thread.Deadlines.begin());
+
+			auto it = thread.Processes.find(handle);
+
+			if (it == thread.Processes.end())
+				continue;
+
+			Process::Ptr process = it->second;
+
+			/* Kills the process because its timeout has expired. */
+			if (!process->DoEvents())
+				process->Unregister();
+		}
+	}
+}
+#endif /* __linux__ */
+
 void Process::IOThreadProc(int tid)
 {
+	ProcessIOThread& thread = l_IOThreads[tid];
 #ifdef _WIN32
 	HANDLE *handles = nullptr;
 	HANDLE *fhandles = nullptr;
@@ -625,26 +1130,26 @@ void Process::IOThreadProc(int tid)
 		now = Utility::GetTime();
 
 		{
-			boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+			boost::mutex::scoped_lock lock(thread.Mutex);
 
-			count = 1 + l_Processes[tid].size();
+			count = 1 + thread.Processes.size();
 #ifdef _WIN32
 			handles = reinterpret_cast<HANDLE *>(realloc(handles, sizeof(HANDLE) * count));
 			fhandles = reinterpret_cast<HANDLE *>(realloc(fhandles, sizeof(HANDLE) * count));
 
-			fhandles[0] = l_Events[tid];
+			fhandles[0] = thread.Event;
 
 #else /* _WIN32 */
 			pfds = reinterpret_cast<pollfd *>(realloc(pfds, sizeof(pollfd) * count));
 
-			pfds[0].fd = l_EventFDs[tid][0];
+			pfds[0].fd = thread.EventFDs[0];
 			pfds[0].events = POLLIN;
 			pfds[0].revents = 0;
 #endif /* _WIN32 */
 
 			int i = 1;
 			typedef std::pair<ProcessHandle, Process::Ptr> kv_pair;
-			for (const kv_pair& kv : l_Processes[tid]) {
+			for (const kv_pair& kv : thread.Processes) {
 				const Process::Ptr& process = kv.second;
 #ifdef _WIN32
 				handles[i] = kv.first;
@@ -694,32 +1199,32 @@ void Process::IOThreadProc(int tid)
 		now = Utility::GetTime();
 
 		{
-			boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+			boost::mutex::scoped_lock lock(thread.Mutex);
 
 #ifdef _WIN32
 			if (rc == WAIT_OBJECT_0)
-				ResetEvent(l_Events[tid]);
+				ResetEvent(thread.Event);
 #else /* _WIN32 */
 			if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
 				char buffer[512];
-				if (read(l_EventFDs[tid][0], buffer, sizeof(buffer)) < 0)
+				if (read(thread.EventFDs[0], buffer, sizeof(buffer)) < 0)
 					Log(LogCritical, "base", "Read from event FD failed.");
 			}
 #endif /* _WIN32 */
 
 			for (int i = 1; i < count; i++) {
 #ifdef _WIN32
-				auto it = l_Processes[tid].find(handles[i]);
+				auto it = thread.Processes.find(handles[i]);
 #else /* _WIN32 */
-				auto it2 = l_FDs[tid].find(pfds[i].fd);
+				auto it2 = thread.FDs.find(pfds[i].fd);
 
-				if (it2 == l_FDs[tid].end())
+				if (it2 == thread.FDs.end())
 					continue; /* This should never happen. */
 
-				auto it = l_Processes[tid].find(it2->second);
+				auto it = thread.Processes.find(it2->second);
 #endif /* _WIN32 */
 
-				if (it == l_Processes[tid].end())
+				if (it == thread.Processes.end())
 					continue; /* This should never happen. */
 
 				bool is_timeout = false;
@@ -736,16 +1241,10 @@ void Process::IOThreadProc(int tid)
 #else /* _WIN32 */
 				if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR) || is_timeout) {
 #endif /* _WIN32 */
-					if (!it->second->DoEvents()) {
-#ifdef _WIN32
-						CloseHandle(it->first);
-						CloseHandle(it->second->m_FD);
-#else /* _WIN32 */
-						l_FDs[tid].erase(it->second->m_FD);
-						(void)close(it->second->m_FD);
-#endif /* _WIN32 */
-						l_Processes[tid].erase(it);
-					}
+					Process::Ptr process = it->second;
+
+					if (!process->DoEvents())
+						process->Unregister();
 				}
 			}
 		}
@@ -800,8 +1299,10 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 	boost::call_once(l_SpawnHelperOnceFlag, &Process::InitializeSpawnHelper);
 #endif /* _WIN32 */
 	boost::call_once(l_ProcessOnceFlag, &Process::ThreadInitialize);
+	boost::call_once(l_MaxOutputSizeOnceFlag, &InitializeMaxOutputSize);
 
 	m_Result.ExecutionStart = Utility::GetTime();
+	m_TID = AssignIOThread();
 
 #ifdef _WIN32
 	SECURITY_ATTRIBUTES sa = {};
@@ -922,6 +1423,7 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 	if (!CreateProcess(nullptr, args, nullptr, nullptr, TRUE,
 		0 /*EXTENDED_STARTUPINFO_PRESENT*/, envp, nullptr, &si.StartupInfo, &pi)) {
 		DWORD error = GetLastError();
+		l_SpawnFailures++;
 		CloseHandle(outWritePipe);
 		CloseHandle(outWritePipeDup);
 		free(envp);
@@ -986,12 +1488,22 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 	fds[1] = outfds[1];
 	fds[2] = outfds[1];
 
-	m_Process = ProcessSpawn(m_Arguments, m_ExtraEnvironment, m_AdjustPriority, fds);
+	{
+		TraceSpan span("process.spawn");
+
+		if (span.IsSampled())
+			span.SetDetail(m_Arguments.empty() ? String() : m_Arguments[0]);
+
+		m_Process = ProcessSpawn(m_Arguments, m_ExtraEnvironment, m_AdjustPriority, fds, m_SpawnHelper);
+	}
+
 	m_PID = m_Process;
 
 	if (m_PID == -1) {
-		m_OutputStream << "Fork failed with error code " << errno << " (" << Utility::FormatErrorNumber(errno) << ")";
-		Log(LogCritical, "Process", m_OutputStream.str());
+		l_SpawnFailures++;
+		String message = "Fork failed with error code " + Convert::ToString(errno) + " (" + Utility::FormatErrorNumber(errno) + ")";
+		AppendOutput(message.CStr(), message.GetLength());
+		Log(LogCritical, "Process", message);
 	}
 
 	Log(LogNotice, "Process")
@@ -1006,22 +1518,7 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 
 	m_Callback = callback;
 
-	int tid = GetTID();
-
-	{
-		boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
-		l_Processes[tid][m_Process] = this;
-#ifndef _WIN32
-		l_FDs[tid][m_FD] = m_Process;
-#endif /* _WIN32 */
-	}
-
-#ifdef _WIN32
-	SetEvent(l_Events[tid]);
-#else /* _WIN32 */
-	if (write(l_EventFDs[tid][1], "T", 1) < 0 && errno != EINTR && errno != EAGAIN)
-		Log(LogCritical, "base", "Write to event FD failed.");
-#endif /* _WIN32 */
+	Register();
 }
 
 bool Process::DoEvents()
@@ -1039,11 +1536,10 @@ bool Process::DoEvents()
 				<< "Killing process group " << m_PID << " (" << PrettyPrintArguments(m_Arguments)
 				<< ") after timeout of " << m_Timeout << " seconds";
 
-			m_OutputStream << "<Timeout exceeded.>";
 #ifdef _WIN32
 			TerminateProcess(m_Process, 1);
 #else /* _WIN32 */
-			int error = ProcessKill(-m_Process, SIGKILL);
+			int error = ProcessKill(m_SpawnHelper, -m_Process, SIGKILL);
 			if (error) {
 				Log(LogWarning, "Process")
 					<< "Couldn't kill the process group " << m_PID << " (" << PrettyPrintArguments(m_Arguments)
@@ -1062,19 +1558,35 @@ bool Process::DoEvents()
 
 		DWORD rc;
 		if (!m_ReadFailed && GetOverlappedResult(m_FD, &m_Overlapped, &rc, TRUE) && rc > 0) {
-			m_OutputStream.write(m_ReadBuffer, rc);
+			AppendOutput(m_ReadBuffer, rc);
 			return true;
 		}
 #else /* _WIN32 */
-		char buffer[512];
+		/* Output which exceeds the size limit is read into the scratch buffer and discarded. */
+		char scratch[512];
 		for (;;) {
-			int rc = read(m_FD, buffer, sizeof(buffer));
+			char *target = scratch;
+			size_t size = sizeof(scratch);
+
+			if (!m_OutputTruncated) {
+				size_t available = ReserveOutput();
+
+				if (available > 0) {
+					target = m_OutputBuffer + m_OutputLength;
+					size = available;
+				} else
+					m_OutputTruncated = true;
+			}
+
+			int rc = read(m_FD, target, size);
 
 			if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
 				return true;
 
 			if (rc > 0) {
-				m_OutputStream.write(buffer, rc);
+				if (target != scratch)
+					m_OutputLength += rc;
+
 				continue;
 			}
 
@@ -1083,7 +1595,21 @@ bool Process::DoEvents()
 #endif /* _WIN32 */
 	}
 
-	String output = m_OutputStream.str();
+	String output;
+
+	if (m_OutputBuffer)
+		output = String(m_OutputBuffer, m_OutputBuffer + m_OutputLength);
+
+	if (m_OutputTruncated) {
+		Log(LogWarning, "Process")
+			<< "Output of PID " << m_PID << " (" << PrettyPrintArguments(m_Arguments)
+			<< ") was truncated after " << m_OutputLength << " bytes";
+	}
+
+	FreeOutputBuffer();
+
+	if (is_timeout)
+		output += "<Timeout exceeded.>";
 
 #ifdef _WIN32
 	WaitForSingleObject(m_Process, INFINITE);
@@ -1097,7 +1623,7 @@ bool Process::DoEvents()
 	int status, exitcode;
 	if (could_not_kill || m_PID == -1) {
 		exitcode = 128;
-	} else if (ProcessWaitPID(m_Process, &status) != m_Process) {
+	} else if (ProcessWaitPID(m_SpawnHelper, m_Process, &status) != m_Process) {
 		exitcode = 128;
 
 		Log(LogWarning, "Process")
@@ -1136,12 +1662,24 @@ bool Process::DoEvents()
 	m_Result.ExitStatus = exitcode;
 	m_Result.Output = output;
 
+	/* The plugin's runtime from the spawn to its exit. */
+	if (Tracing::IsEnabled())
+		Tracing::RecordSpan("process.run", m_Result.ExecutionStart, m_Result.ExecutionEnd, PrettyPrintArguments(m_Arguments));
+
 	if (m_Callback)
 		Utility::QueueAsyncCallback(std::bind(m_Callback, m_Result));
 
 	return false;
 }
 
+/**
+ * Returns the number of processes which could not be started so far.
+ */
+uint_fast64_t Process::GetSpawnFailures()
+{
+	return l_SpawnFailures;
+}
+
 pid_t Process::GetPID() const
 {
 	return m_PID;
@@ -1150,6 +1688,6 @@ pid_t Process::GetPID() const
 
 int Process::GetTID() const
 {
-	return (reinterpret_cast<uintptr_t>(this) / sizeof(void *)) % IOTHREADS;
+	return m_TID;
 }
 
@@ -22,6 +22,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/dictionary.hpp"
+#include <cstdint>
 #include <iosfwd>
 #include <deque>
 #include <vector>
@@ -86,8 +87,14 @@ public:
 
 	static String PrettyPrintArguments(const Arguments& arguments);
 
+	static uint_fast64_t GetSpawnFailures();
+
 #ifndef _WIN32
 	static void InitializeSpawnHelper();
+
+	static pid_t Spawn(const Arguments& arguments, const Dictionary::Ptr& extraEnvironment, int fds[3], int& spawnHelper);
+	static int Kill(int spawnHelper, pid_t pid, int signum);
+	static int WaitPID(int spawnHelper, pid_t pid, int *status);
 #endif /* _WIN32 */
 
 private:
@@ -106,15 +113,32 @@ private:
 	bool m_ReadFailed;
 	OVERLAPPED m_Overlapped;
 	char m_ReadBuffer[1024];
+#else /* _WIN32 */
+	int m_SpawnHelper;
 #endif /* _WIN32 */
 
-	std::ostringstream m_OutputStream;
+	int m_TID;
+
+	char *m_OutputBuffer;
+	size_t m_OutputLength;
+	int m_OutputSizeClass;
+	bool m_OutputTruncated;
+
 	std::function<void (const ProcessResult&)> m_Callback;
 	ProcessResult m_Result;
 
 	static void IOThreadProc(int tid);
+#ifdef __linux__
+	static void EpollIOThreadProc(int tid);
+#endif /* __linux__ */
+	void Register();
+	void Unregister();
 	bool DoEvents();
 	int GetTID() const;
+
+	size_t ReserveOutput();
+	void AppendOutput(const char *data, size_t length);
+	void FreeOutputBuffer();
 };
 
 }
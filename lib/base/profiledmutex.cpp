@@ -0,0 +1,202 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/profiledmutex.hpp"
+#include "base/statsfunction.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <map>
+
+using namespace icinga;
+
+REGISTER_STATSFUNCTION(ProfiledMutex, &ProfiledMutex::StatsFunc);
+
+typedef std::unordered_map<const void *, std::pair<uint64_t, double> > ContentionSiteMap;
+
+static boost::mutex& GetProfiledMutexesMutex()
+{
+	static boost::mutex mutex;
+	return mutex;
+}
+
+static std::vector<ProfiledMutex *>& GetProfiledMutexes()
+{
+	static std::vector<ProfiledMutex *> mutexes;
+	return mutexes;
+}
+
+static void UpdateMax(std::atomic<double>& max, double value)
+{
+	double current = max.load(std::memory_order_relaxed);
+
+	while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		; /* empty loop body */
+}
+
+static void AddTime(std::atomic<double>& sum, double value)
+{
+	double current = sum.load(std::memory_order_relaxed);
+
+	while (!sum.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+		; /* empty loop body */
+}
+
+void LockContentionSites::Record(const void *site, double waitTime)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	auto& entry = m_Sites[site];
+	entry.first++;
+	entry.second += waitTime;
+}
+
+void LockContentionSites::Merge(ContentionSiteMap& sites) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	for (const ContentionSiteMap::value_type& kv : m_Sites) {
+		auto& entry = sites[kv.first];
+		entry.first += kv.second.first;
+		entry.second += kv.second.second;
+	}
+}
+
+/**
+ * Returns the call sites with the highest total wait time.
+ */
+Array::Ptr LockContentionSites::Format(const ContentionSiteMap& sites, size_t limit)
+{
+	std::vector<std::pair<const void *, std::pair<uint64_t, double> > > sorted(sites.begin(), sites.end());
+
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<const void *, std::pair<uint64_t, double> >& a,
+		const std::pair<const void *, std::pair<uint64_t, double> >& b) {
+		return a.second.second > b.second.second;
+	});
+
+	if (sorted.size() > limit)
+		sorted.resize(limit);
+
+	ArrayData result;
+
+	for (const auto& kv : sorted) {
+		result.emplace_back(new Dictionary({
+			{ "site", Utility::FormatCodeAddress(kv.first) },
+			{ "contended", kv.second.first },
+			{ "wait_time", kv.second.second }
+		}));
+	}
+
+	return new Array(std::move(result));
+}
+
+ProfiledMutex::ProfiledMutex(const char *name)
+	: m_Name(name)
+{
+	boost::mutex::scoped_lock lock(GetProfiledMutexesMutex());
+	GetProfiledMutexes().push_back(this);
+}
+
+ProfiledMutex::~ProfiledMutex()
+{
+	boost::mutex::scoped_lock lock(GetProfiledMutexesMutex());
+	std::vector<ProfiledMutex *>& mutexes = GetProfiledMutexes();
+	mutexes.erase(std::remove(mutexes.begin(), mutexes.end(), this), mutexes.end());
+}
+
+void ProfiledMutex::LockSlow(const void *site)
+{
+	double start = Utility::GetTime();
+
+	m_Mutex.lock();
+
+	double waitTime = Utility::GetTime() - start;
+
+	m_Contended.fetch_add(1, std::memory_order_relaxed);
+	AddTime(m_WaitTime, waitTime);
+	UpdateMax(m_MaxWaitTime, waitTime);
+	m_Sites.Record(site, waitTime);
+
+	OnAcquired();
+}
+
+void ProfiledMutex::StartHoldTime()
+{
+	m_HoldStart = Utility::GetTime();
+}
+
+void ProfiledMutex::RecordHoldTime()
+{
+	double holdTime = Utility::GetTime() - m_HoldStart;
+	m_HoldStart = 0;
+
+	m_HoldSamples.fetch_add(1, std::memory_order_relaxed);
+	AddTime(m_HoldTime, holdTime);
+	UpdateMax(m_MaxHoldTime, holdTime);
+}
+
+void ProfiledMutex::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+{
+	struct Totals
+	{
+		size_t Instances{0};
+		uint64_t Acquisitions{0};
+		uint64_t Contended{0};
+		double WaitTime{0};
+		double MaxWaitTime{0};
+		uint64_t HoldSamples{0};
+		double HoldTime{0};
+		double MaxHoldTime{0};
+		ContentionSiteMap Sites;
+	};
+
+	std::map<String, Totals> totals;
+
+	{
+		boost::mutex::scoped_lock lock(GetProfiledMutexesMutex());
+
+		for (const ProfiledMutex *mutex : GetProfiledMutexes()) {
+			Totals& t = totals[mutex->m_Name];
+
+			t.Instances++;
+			t.Acquisitions += mutex->m_Acquisitions.load(std::memory_order_relaxed);
+			t.Contended += mutex->m_Contended.load(std::memory_order_relaxed);
+			t.WaitTime += mutex->m_WaitTime.load(std::memory_order_relaxed);
+			t.MaxWaitTime = std::max(t.MaxWaitTime, mutex->m_MaxWaitTime.load(std::memory_order_relaxed));
+			t.HoldSamples += mutex->m_HoldSamples.load(std::memory_order_relaxed);
+			t.HoldTime += mutex->m_HoldTime.load(std::memory_order_relaxed);
+			t.MaxHoldTime = std::max(t.MaxHoldTime, mutex->m_MaxHoldTime.load(std::memory_order_relaxed));
+			mutex->m_Sites.Merge(t.Sites);
+		}
+	}
+
+	for (const std::pair<const String, Totals>& kv : totals) {
+		const Totals& t = kv.second;
+
+		status->Set(kv.first, new Dictionary({
+			{ "instances", t.Instances },
+			{ "acquisitions", t.Acquisitions },
+			{ "contended", t.Contended },
+			{ "wait_time", t.WaitTime },
+			{ "max_wait_time", t.MaxWaitTime },
+			{ "avg_hold_time", t.HoldSamples > 0 ? t.HoldTime / t.HoldSamples : 0 },
+			{ "max_hold_time", t.MaxHoldTime },
+			{ "sites", LockContentionSites::Format(t.Sites) }
+		}));
+	}
+}
@@ -0,0 +1,136 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef PROFILEDMUTEX_H
+#define PROFILEDMUTEX_H
+
+#include "base/i2-base.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+namespace icinga
+{
+
+/**
+ * Keeps track of the call sites which had to wait for a lock.
+ *
+ * @ingroup base
+ */
+class LockContentionSites
+{
+public:
+	void Record(const void *site, double waitTime);
+
+	void Merge(std::unordered_map<const void *, std::pair<uint64_t, double> >& sites) const;
+
+	static Array::Ptr Format(const std::unordered_map<const void *, std::pair<uint64_t, double> >& sites, size_t limit = 10);
+
+private:
+	mutable boost::mutex m_Mutex;
+	std::unordered_map<const void *, std::pair<uint64_t, double> > m_Sites; /* site -> (count, wait time) */
+};
+
+/**
+ * A mutex which records how often it was contended, how long threads
+ * waited for it and which call sites had to wait. The hold time is
+ * measured for every 64th acquisition. All mutexes with the same name are
+ * reported together by the "ProfiledMutex" stats function (i.e.
+ * /v1/status/ProfiledMutex).
+ *
+ * Use it in place of boost::mutex for locks which are suspected to be
+ * contended. Condition variables have to be boost::condition_variable_any.
+ *
+ * @ingroup base
+ */
+class ProfiledMutex final
+{
+public:
+	typedef boost::unique_lock<ProfiledMutex> scoped_lock;
+
+	explicit ProfiledMutex(const char *name);
+	~ProfiledMutex();
+
+	ProfiledMutex(const ProfiledMutex&) = delete;
+	ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+	I2_NOINLINE void lock()
+	{
+		if (likely(m_Mutex.try_lock()))
+			OnAcquired();
+		else
+			LockSlow(I2_RETURN_ADDRESS());
+	}
+
+	bool try_lock()
+	{
+		if (!m_Mutex.try_lock())
+			return false;
+
+		OnAcquired();
+		return true;
+	}
+
+	void unlock()
+	{
+		if (unlikely(m_HoldStart != 0))
+			RecordHoldTime();
+
+		m_Mutex.unlock();
+	}
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+private:
+	const char *m_Name;
+	boost::mutex m_Mutex;
+
+	/* Only modified while the mutex is held. */
+	std::atomic<uint64_t> m_Acquisitions{0};
+	double m_HoldStart{0};
+
+	std::atomic<uint64_t> m_Contended{0};
+	std::atomic<double> m_WaitTime{0};
+	std::atomic<double> m_MaxWaitTime{0};
+	std::atomic<uint64_t> m_HoldSamples{0};
+	std::atomic<double> m_HoldTime{0};
+	std::atomic<double> m_MaxHoldTime{0};
+	LockContentionSites m_Sites;
+
+	inline void OnAcquired()
+	{
+		uint64_t acquisitions = m_Acquisitions.load(std::memory_order_relaxed) + 1;
+		m_Acquisitions.store(acquisitions, std::memory_order_relaxed);
+
+		if (unlikely((acquisitions & 63) == 0))
+			StartHoldTime();
+	}
+
+	void LockSlow(const void *site);
+	void StartHoldTime();
+	void RecordHoldTime();
+};
+
+}
+
+#endif /* PROFILEDMUTEX_H */
@@ -0,0 +1,110 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/rendezvoushash.hpp"
+#include "base/debug.hpp"
+#include <cmath>
+
+using namespace icinga;
+
+/* The finalizer of SplitMix64, turns similar inputs into unrelated outputs. */
+static inline uint64_t MixHash(uint64_t value)
+{
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	return value ^ (value >> 31);
+}
+
+/**
+ * Adds a node. The index of the node is the number of nodes which were
+ * added before it.
+ *
+ * @param name The node's name.
+ * @param weight The node's weight, must be greater than 0.
+ */
+void RendezvousHash::AddNode(const String& name, double weight)
+{
+	ASSERT(weight > 0);
+
+	if (!m_Nodes.empty() && weight != m_Nodes.front().Weight)
+		m_Weighted = true;
+
+	m_Nodes.push_back({ HashString(name), weight });
+}
+
+size_t RendezvousHash::GetNodeCount() const
+{
+	return m_Nodes.size();
+}
+
+/**
+ * Returns the index of the node which is responsible for a key.
+ *
+ * @param key The key.
+ * @returns The node's index.
+ */
+size_t RendezvousHash::GetNode(const String& key) const
+{
+	ASSERT(!m_Nodes.empty());
+
+	uint64_t keyHash = HashString(key);
+	size_t best = 0;
+
+	if (!m_Weighted) {
+		/* Integer scores, so that all platforms agree on the result. */
+		uint64_t bestScore = 0;
+
+		for (size_t i = 0; i < m_Nodes.size(); i++) {
+			uint64_t score = MixHash(keyHash ^ m_Nodes[i].Hash);
+
+			if (i == 0 || score > bestScore) {
+				best = i;
+				bestScore = score;
+			}
+		}
+	} else {
+		/* Weighted rendezvous hashing: -weight / ln(u) with u uniform in (0, 1). */
+		double bestScore = 0;
+
+		for (size_t i = 0; i < m_Nodes.size(); i++) {
+			double u = ((MixHash(keyHash ^ m_Nodes[i].Hash) >> 11) + 0.5) / 9007199254740992.0;
+			double score = -m_Nodes[i].Weight / std::log(u);
+
+			if (i == 0 || score > bestScore) {
+				best = i;
+				bestScore = score;
+			}
+		}
+	}
+
+	return best;
+}
+
+/* FNV-1a, unlike Utility::SDBM() its result doesn't depend on the size of long. */
+uint64_t RendezvousHash::HashString(const String& str)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (char ch : str) {
+		hash ^= static_cast<unsigned char>(ch);
+		hash *= 0x100000001b3ull;
+	}
+
+	return MixHash(hash);
+}
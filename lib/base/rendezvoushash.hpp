@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef RENDEZVOUSHASH_H
+#define RENDEZVOUSHASH_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Assigns keys to nodes with rendezvous (highest random weight) hashing:
+ * Each key goes to the node with the highest score for that key. Adding
+ * or removing a node only moves the keys which that node wins or loses,
+ * i.e. about 1/N of them. Nodes with a higher weight get proportionally
+ * more keys.
+ *
+ * The assignment only depends on the nodes' names and weights, so that
+ * all instances which know the same nodes come to the same result.
+ *
+ * @ingroup base
+ */
+class RendezvousHash
+{
+public:
+	void AddNode(const String& name, double weight = 1);
+	size_t GetNodeCount() const;
+
+	size_t GetNode(const String& key) const;
+
+private:
+	struct Node
+	{
+		uint64_t Hash;
+		double Weight;
+	};
+
+	std::vector<Node> m_Nodes;
+	bool m_Weighted{false};
+
+	static uint64_t HashString(const String& str);
+};
+
+}
+
+#endif /* RENDEZVOUSHASH_H */
@@ -30,6 +30,7 @@
 #include "base/application.hpp"
 #include "base/dependencygraph.hpp"
 #include "base/initialize.hpp"
+#include "base/pattern.hpp"
 #include <boost/regex.hpp>
 #include <algorithm>
 #include <set>
@@ -123,7 +124,8 @@ bool ScriptUtils::Regex(const std::vector<Value>& args)
 	else
 		mode = MatchAll;
 
-	boost::regex expr(pattern.GetData());
+	std::shared_ptr<const boost::regex> compiled = PatternCache::GetRegex(pattern);
+	const boost::regex& expr = *compiled;
 
 	Array::Ptr texts;
 
@@ -64,17 +64,7 @@ static Object::Ptr SerializeObject(const Object::Ptr& input, int attributeTypes)
 	DictionaryData fields;
 	fields.reserve(type->GetFieldCount() + 1);
 
-	for (int i = 0; i < type->GetFieldCount(); i++) {
-		Field field = type->GetFieldInfo(i);
-
-		if (attributeTypes != 0 && (field.Attributes & attributeTypes) == 0)
-			continue;
-
-		if (strcmp(field.Name, "type") == 0)
-			continue;
-
-		fields.emplace_back(field.Name, Serialize(input->GetField(i), attributeTypes));
-	}
+	input->SerializeFields(fields, attributeTypes);
 
 	fields.emplace_back("type", type->GetName());
 
@@ -138,21 +128,7 @@ static Object::Ptr DeserializeObject(const Object::Ptr& object, const Dictionary
 		if (kv.first.IsEmpty())
 			continue;
 
-		int fid = type->GetFieldId(kv.first);
-
-		if (fid < 0)
-			continue;
-
-		Field field = type->GetFieldInfo(fid);
-
-		if ((field.Attributes & attributeTypes) == 0)
-			continue;
-
-		try {
-			instance->SetField(fid, Deserialize(kv.second, safe_mode, attributeTypes), true);
-		} catch (const std::exception&) {
-			instance->SetField(fid, Empty);
-		}
+		instance->DeserializeField(kv.first, kv.second, safe_mode, attributeTypes);
 	}
 
 	return instance;
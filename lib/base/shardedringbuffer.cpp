@@ -0,0 +1,132 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/shardedringbuffer.hpp"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+using namespace icinga;
+
+/* A slot holds the time value in the upper and the count in the lower half. */
+static inline uint64_t MakeSlot(uint32_t tv, uint32_t count)
+{
+	return (static_cast<uint64_t>(tv) << 32) | count;
+}
+
+static inline uint32_t GetSlotTime(uint64_t slot)
+{
+	return slot >> 32;
+}
+
+static inline uint32_t GetSlotCount(uint64_t slot)
+{
+	return slot & 0xffffffff;
+}
+
+/**
+ * Constructor for the ShardedRingBuffer class.
+ *
+ * @param slots The number of seconds to keep.
+ * @param shards The number of shards, 0 picks one per CPU (up to 8).
+ */
+ShardedRingBuffer::ShardedRingBuffer(ShardedRingBuffer::SizeType slots, ShardedRingBuffer::SizeType shards)
+	: m_Length(slots)
+{
+	if (shards == 0)
+		shards = std::min<SizeType>(std::max(std::thread::hardware_concurrency(), 1u), 8);
+
+	m_Shards.resize(shards);
+
+	for (Shard& shard : m_Shards) {
+		shard.Slots.reset(new std::atomic<uint64_t>[slots]);
+
+		for (SizeType i = 0; i < slots; i++)
+			shard.Slots[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+ShardedRingBuffer::SizeType ShardedRingBuffer::GetLength() const
+{
+	return m_Length;
+}
+
+ShardedRingBuffer::Shard& ShardedRingBuffer::GetShard()
+{
+	static std::hash<std::thread::id> hasher;
+
+	return m_Shards[hasher(std::this_thread::get_id()) % m_Shards.size()];
+}
+
+void ShardedRingBuffer::UpdateFirstTimeValue(ShardedRingBuffer::SizeType tv)
+{
+	SizeType expected = 0;
+	m_FirstTimeValue.compare_exchange_strong(expected, tv, std::memory_order_relaxed);
+}
+
+void ShardedRingBuffer::InsertValue(ShardedRingBuffer::SizeType tv, int num)
+{
+	UpdateFirstTimeValue(tv);
+
+	std::atomic<uint64_t>& slot = GetShard().Slots[tv % m_Length];
+	uint64_t current = slot.load(std::memory_order_relaxed);
+	uint64_t next;
+
+	do {
+		uint32_t slotTime = GetSlotTime(current);
+
+		if (slotTime == static_cast<uint32_t>(tv))
+			next = MakeSlot(slotTime, GetSlotCount(current) + num);
+		else if (slotTime < static_cast<uint32_t>(tv))
+			next = MakeSlot(tv, num);
+		else
+			return; /* The slot already belongs to a newer second. */
+	} while (!slot.compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+int ShardedRingBuffer::UpdateAndGetValues(ShardedRingBuffer::SizeType tv, ShardedRingBuffer::SizeType span)
+{
+	UpdateFirstTimeValue(tv);
+
+	if (span > m_Length)
+		span = m_Length;
+
+	int sum = 0;
+
+	for (const Shard& shard : m_Shards) {
+		for (SizeType i = 0; i < span && i <= tv; i++) {
+			uint64_t slot = shard.Slots[(tv - i) % m_Length].load(std::memory_order_relaxed);
+
+			if (GetSlotTime(slot) == static_cast<uint32_t>(tv - i))
+				sum += GetSlotCount(slot);
+		}
+	}
+
+	return sum;
+}
+
+double ShardedRingBuffer::CalculateRate(ShardedRingBuffer::SizeType tv, ShardedRingBuffer::SizeType span)
+{
+	int sum = UpdateAndGetValues(tv, span);
+
+	SizeType first = m_FirstTimeValue.load(std::memory_order_relaxed);
+	SizeType inserted = std::min(m_Length, tv >= first ? tv - first + 1 : 1);
+
+	return sum / static_cast<double>(std::min(span, inserted));
+}
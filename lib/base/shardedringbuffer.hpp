@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef SHARDEDRINGBUFFER_H
+#define SHARDEDRINGBUFFER_H
+
+#include "base/i2-base.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A per-second rate counter with the interface of RingBuffer which doesn't
+ * take a lock. Each thread adds to one of several shards and every slot
+ * packs the second it belongs to together with its count into a single
+ * atomic, so stale slots are recognized (and ignored) instead of reset.
+ *
+ * @ingroup base
+ */
+class ShardedRingBuffer final
+{
+public:
+	typedef size_t SizeType;
+
+	ShardedRingBuffer(SizeType slots, SizeType shards = 0);
+
+	SizeType GetLength() const;
+	void InsertValue(SizeType tv, int num);
+	int UpdateAndGetValues(SizeType tv, SizeType span);
+	double CalculateRate(SizeType tv, SizeType span);
+
+private:
+	struct Shard
+	{
+		std::unique_ptr<std::atomic<uint64_t>[]> Slots;
+	};
+
+	SizeType m_Length;
+	std::vector<Shard> m_Shards;
+	std::atomic<SizeType> m_FirstTimeValue{0};
+
+	Shard& GetShard();
+	void UpdateFirstTimeValue(SizeType tv);
+};
+
+}
+
+#endif /* SHARDEDRINGBUFFER_H */
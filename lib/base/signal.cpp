@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/signal.hpp"
+#include "base/statsfunction.hpp"
+#include <algorithm>
+
+using namespace icinga;
+
+REGISTER_STATSFUNCTION(Signal, &SignalBase::StatsFunc);
+
+static boost::mutex& GetSignalsMutex()
+{
+	static boost::mutex mutex;
+	return mutex;
+}
+
+static std::vector<SignalBase *>& GetSignals()
+{
+	static std::vector<SignalBase *> signals;
+	return signals;
+}
+
+SignalBase::SignalBase(const String& name)
+	: m_Name(name)
+{
+	boost::mutex::scoped_lock lock(GetSignalsMutex());
+	GetSignals().push_back(this);
+}
+
+SignalBase::~SignalBase()
+{
+	boost::mutex::scoped_lock lock(GetSignalsMutex());
+	std::vector<SignalBase *>& signals = GetSignals();
+	signals.erase(std::remove(signals.begin(), signals.end(), this), signals.end());
+}
+
+String SignalBase::GetName() const
+{
+	return m_Name;
+}
+
+void SignalBase::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+{
+	boost::mutex::scoped_lock lock(GetSignalsMutex());
+
+	for (const SignalBase *signal : GetSignals()) {
+		DictionaryData slots;
+
+		for (const std::shared_ptr<SignalSlotStatistics>& stats : signal->GetSlotStatistics()) {
+			uint_fast64_t calls = stats->Calls.load(std::memory_order_relaxed);
+			double executionTime = stats->ExecutionTime.load(std::memory_order_relaxed) / 1e9;
+
+			slots.emplace_back(stats->Name, new Dictionary({
+				{ "calls", calls },
+				{ "execution_time", executionTime },
+				{ "avg_execution_time", calls > 0 ? executionTime / calls : 0 }
+			}));
+		}
+
+		status->Set(signal->GetName(), new Dictionary(std::move(slots)));
+	}
+}
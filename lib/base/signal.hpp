@@ -0,0 +1,192 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef SIGNAL_H
+#define SIGNAL_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/tracing.hpp"
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Per-slot call statistics of a signal.
+ *
+ * @ingroup base
+ */
+struct SignalSlotStatistics
+{
+	String Name;
+	std::atomic<uint_fast64_t> Calls{0};
+	std::atomic<uint_fast64_t> ExecutionTime{0}; /* nanoseconds */
+};
+
+/**
+ * Base class for signals. Keeps track of all signals so that the
+ * statistics of their slots can be reported.
+ *
+ * @ingroup base
+ */
+class SignalBase
+{
+public:
+	SignalBase(const String& name);
+
+	SignalBase(const SignalBase&) = delete;
+	SignalBase& operator=(const SignalBase&) = delete;
+
+	String GetName() const;
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+protected:
+	virtual ~SignalBase();
+
+	virtual std::vector<std::shared_ptr<SignalSlotStatistics> > GetSlotStatistics() const = 0;
+
+private:
+	String m_Name;
+};
+
+template<typename Signature>
+class Signal;
+
+/**
+ * A signal for frequently emitted events. Unlike boost::signals2 emitting
+ * the signal neither takes a lock nor copies the slot list: Connecting a
+ * slot publishes a new slot list and the old list is kept until the signal
+ * is destroyed. Slots can't be disconnected.
+ *
+ * The execution time of each slot is recorded and reported by the
+ * "Signal" stats function (e.g. /v1/status/Signal).
+ *
+ * @ingroup base
+ */
+template<typename... Args>
+class Signal<void (Args...)> final : public SignalBase
+{
+public:
+	typedef std::function<void (Args...)> SlotType;
+
+	Signal(const String& name)
+		: SignalBase(name)
+	{ }
+
+	~Signal() override
+	{
+		delete m_Slots.load();
+	}
+
+	/**
+	 * Connects a slot to the signal.
+	 *
+	 * @param slot The slot.
+	 * @param name The name which is used for the slot's statistics.
+	 */
+	void connect(const SlotType& slot, const String& name = String())
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		const SlotList *oldSlots = m_Slots.load();
+		std::unique_ptr<SlotList> slots(oldSlots ? new SlotList(*oldSlots) : new SlotList());
+
+		auto stats = std::make_shared<SignalSlotStatistics>();
+		stats->Name = name.IsEmpty() ? String("slot_" + std::to_string(slots->size())) : name;
+
+		slots->push_back({ slot, stats });
+
+		m_Slots.store(slots.release());
+
+		if (oldSlots)
+			m_RetiredSlots.emplace_back(oldSlots);
+	}
+
+	bool empty() const
+	{
+		const SlotList *slots = m_Slots.load(std::memory_order_acquire);
+
+		return !slots || slots->empty();
+	}
+
+	void operator()(Args... args) const
+	{
+		const SlotList *slots = m_Slots.load(std::memory_order_acquire);
+
+		if (!slots)
+			return;
+
+		TraceSpan span("signal");
+
+		if (span.IsSampled())
+			span.SetDetail(GetName());
+
+		for (const Slot& slot : *slots) {
+			auto start = std::chrono::steady_clock::now();
+
+			slot.Function(args...);
+
+			auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+			slot.Statistics->Calls.fetch_add(1, std::memory_order_relaxed);
+			slot.Statistics->ExecutionTime.fetch_add(duration.count(), std::memory_order_relaxed);
+		}
+	}
+
+protected:
+	std::vector<std::shared_ptr<SignalSlotStatistics> > GetSlotStatistics() const override
+	{
+		std::vector<std::shared_ptr<SignalSlotStatistics> > result;
+
+		const SlotList *slots = m_Slots.load(std::memory_order_acquire);
+
+		if (slots) {
+			for (const Slot& slot : *slots)
+				result.push_back(slot.Statistics);
+		}
+
+		return result;
+	}
+
+private:
+	struct Slot
+	{
+		SlotType Function;
+		std::shared_ptr<SignalSlotStatistics> Statistics;
+	};
+
+	typedef std::vector<Slot> SlotList;
+
+	boost::mutex m_Mutex;
+	std::atomic<const SlotList *> m_Slots{nullptr};
+	std::vector<std::unique_ptr<const SlotList> > m_RetiredSlots;
+};
+
+}
+
+#endif /* SIGNAL_H */
@@ -93,6 +93,23 @@ void Socket::Close()
 	}
 }
 
+/**
+ * Shuts down both directions of the socket. Threads which are blocked
+ * reading from or writing to the socket are woken up.
+ */
+void Socket::Shutdown()
+{
+	ObjectLock olock(this);
+
+	if (m_FD != INVALID_SOCKET) {
+#ifndef _WIN32
+		(void)shutdown(m_FD, SHUT_RDWR);
+#else /* _WIN32 */
+		(void)shutdown(m_FD, SD_BOTH);
+#endif /* _WIN32 */
+	}
+}
+
 /**
  * Retrieves the last error that occurred for the socket.
  *
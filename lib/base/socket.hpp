@@ -44,6 +44,7 @@ public:
 	SOCKET GetFD() const;
 
 	void Close();
+	void Shutdown();
 
 	String GetClientAddress();
 	String GetPeerAddress();
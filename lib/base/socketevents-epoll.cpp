@@ -27,6 +27,10 @@
 
 using namespace icinga;
 
+SocketEventEngineEpoll::SocketEventEngineEpoll(int threadCount)
+	: SocketEventEngine(threadCount), m_PollFDs(threadCount, INVALID_SOCKET)
+{ }
+
 void SocketEventEngineEpoll::InitializeThread(int tid)
 {
 	m_PollFDs[tid] = epoll_create(128);
@@ -110,9 +114,14 @@ void SocketEventEngineEpoll::ThreadProc(int tid)
 				if ((pevents[i].events & (EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR)) == 0)
 					continue;
 
+				SocketEventDescriptor *desc = m_Sockets[tid].Find(pevents[i].data.fd);
+
+				if (!desc)
+					continue;
+
 				EventDescription event;
 				event.REvents = SocketEventEngineEpoll::EpollToPoll(pevents[i].events);
-				event.Descriptor = m_Sockets[tid][pevents[i].data.fd];
+				event.Descriptor = *desc;
 				event.LifesupportReference = event.Descriptor.LifesupportObject;
 				VERIFY(event.LifesupportReference);
 
@@ -136,7 +145,7 @@ void SocketEventEngineEpoll::ThreadProc(int tid)
 
 void SocketEventEngineEpoll::Register(SocketEvents *se, Object *lifesupportObject)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_Thread;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -147,7 +156,7 @@ void SocketEventEngineEpoll::Register(SocketEvents *se, Object *lifesupportObjec
 		desc.EventInterface = se;
 		desc.LifesupportObject = lifesupportObject;
 
-		VERIFY(m_Sockets[tid].find(se->m_FD) == m_Sockets[tid].end());
+		VERIFY(!m_Sockets[tid].Find(se->m_FD));
 
 		m_Sockets[tid][se->m_FD] = desc;
 
@@ -163,7 +172,7 @@ void SocketEventEngineEpoll::Register(SocketEvents *se, Object *lifesupportObjec
 
 void SocketEventEngineEpoll::Unregister(SocketEvents *se)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_Thread;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -171,7 +180,8 @@ void SocketEventEngineEpoll::Unregister(SocketEvents *se)
 		if (se->m_FD == INVALID_SOCKET)
 			return;
 
-		m_Sockets[tid].erase(se->m_FD);
+		m_Sockets[tid].Erase(se->m_FD);
+		m_SocketCount[tid]--;
 		m_FDChanged[tid] = true;
 
 		epoll_ctl(m_PollFDs[tid], EPOLL_CTL_DEL, se->m_FD, nullptr);
@@ -188,14 +198,14 @@ void SocketEventEngineEpoll::ChangeEvents(SocketEvents *se, int events)
 	if (se->m_FD == INVALID_SOCKET)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
 
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_Thread;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
-		auto it = m_Sockets[tid].find(se->m_FD);
+		SocketEventDescriptor *desc = m_Sockets[tid].Find(se->m_FD);
 
-		if (it == m_Sockets[tid].end())
+		if (!desc)
 			return;
 
 		epoll_event event;
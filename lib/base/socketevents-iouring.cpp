@@ -0,0 +1,470 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/socketevents.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include <boost/exception/errinfo_api_function.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <map>
+#include <memory>
+#if defined(__linux__) && defined(HAVE_LINUX_IO_URING_H)
+#	include <linux/io_uring.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+
+using namespace icinga;
+
+#define IOURING_ENTRIES 4096
+#define IOURING_CANCEL_TAG (~static_cast<uint64_t>(0))
+
+/**
+ * A submission/completion ring pair as set up by io_uring_setup(). We talk
+ * to the kernel through the raw syscalls so that no liburing is required.
+ */
+struct SocketEventEngineIoUring::Ring
+{
+	int FD{-1};
+
+	void *SQRing{MAP_FAILED};
+	size_t SQRingSize{0};
+	void *CQRing{MAP_FAILED};
+	size_t CQRingSize{0};
+	io_uring_sqe *SQEs{static_cast<io_uring_sqe *>(MAP_FAILED)};
+	size_t SQEsSize{0};
+
+	unsigned *SQHead{nullptr};
+	unsigned *SQTail{nullptr};
+	unsigned *SQArray{nullptr};
+	unsigned SQMask{0};
+	unsigned SQEntries{0};
+
+	unsigned *CQHead{nullptr};
+	unsigned *CQTail{nullptr};
+	io_uring_cqe *CQEs{nullptr};
+	unsigned CQMask{0};
+
+	~Ring()
+	{
+		if (SQEs != MAP_FAILED)
+			munmap(SQEs, SQEsSize);
+
+		if (CQRing != MAP_FAILED && CQRing != SQRing)
+			munmap(CQRing, CQRingSize);
+
+		if (SQRing != MAP_FAILED)
+			munmap(SQRing, SQRingSize);
+
+		if (FD != -1)
+			close(FD);
+	}
+
+	static Ring *Create(unsigned entries)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+
+		std::unique_ptr<Ring> ring(new Ring());
+
+		ring->FD = syscall(__NR_io_uring_setup, entries, &params);
+
+		if (ring->FD < 0)
+			return nullptr;
+
+		Utility::SetCloExec(ring->FD);
+
+		ring->SQRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		ring->CQRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+			ring->SQRingSize = ring->CQRingSize = std::max(ring->SQRingSize, ring->CQRingSize);
+
+		ring->SQRing = mmap(nullptr, ring->SQRingSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->FD, IORING_OFF_SQ_RING);
+
+		if (ring->SQRing == MAP_FAILED)
+			return nullptr;
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+			ring->CQRing = ring->SQRing;
+		else {
+			ring->CQRing = mmap(nullptr, ring->CQRingSize, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring->FD, IORING_OFF_CQ_RING);
+
+			if (ring->CQRing == MAP_FAILED)
+				return nullptr;
+		}
+
+		ring->SQEsSize = params.sq_entries * sizeof(io_uring_sqe);
+		ring->SQEs = static_cast<io_uring_sqe *>(mmap(nullptr, ring->SQEsSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->FD, IORING_OFF_SQES));
+
+		if (ring->SQEs == MAP_FAILED)
+			return nullptr;
+
+		char *sq = static_cast<char *>(ring->SQRing);
+		ring->SQHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+		ring->SQTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+		ring->SQArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+		ring->SQMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+		ring->SQEntries = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+
+		char *cq = static_cast<char *>(ring->CQRing);
+		ring->CQHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+		ring->CQTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+		ring->CQEs = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+		ring->CQMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+
+		return ring.release();
+	}
+
+	int Enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+	{
+		return syscall(__NR_io_uring_enter, FD, toSubmit, minComplete, flags, nullptr, 0);
+	}
+
+	unsigned GetPendingSubmissions() const
+	{
+		return *SQTail - __atomic_load_n(SQHead, __ATOMIC_ACQUIRE);
+	}
+
+	/* The caller holds the engine mutex for this ring, so we're the only writer for the SQ tail. */
+	io_uring_sqe *GetSQE()
+	{
+		if (GetPendingSubmissions() >= SQEntries) {
+			if (Enter(GetPendingSubmissions(), 0, 0) < 0 || GetPendingSubmissions() >= SQEntries)
+				return nullptr;
+		}
+
+		unsigned index = *SQTail & SQMask;
+
+		io_uring_sqe *sqe = &SQEs[index];
+		memset(sqe, 0, sizeof(*sqe));
+		SQArray[index] = index;
+
+		return sqe;
+	}
+
+	void CommitSQE()
+	{
+		__atomic_store_n(SQTail, *SQTail + 1, __ATOMIC_RELEASE);
+	}
+};
+
+SocketEventEngineIoUring::SocketEventEngineIoUring(int threadCount)
+	: SocketEventEngine(threadCount), m_Rings(threadCount, nullptr),
+	m_PollStates(threadCount), m_NextGeneration(threadCount, 0)
+{ }
+
+bool SocketEventEngineIoUring::IsSupported()
+{
+	std::unique_ptr<Ring> ring(Ring::Create(2));
+	return !!ring;
+}
+
+void SocketEventEngineIoUring::InitializeThread(int tid)
+{
+	m_Rings[tid] = Ring::Create(IOURING_ENTRIES);
+
+	if (!m_Rings[tid]) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("io_uring_setup")
+			<< boost::errinfo_errno(errno));
+	}
+
+	SocketEventDescriptor sed;
+
+	m_Sockets[tid][m_EventFDs[tid][0]] = sed;
+	m_FDChanged[tid] = true;
+
+	PollState& state = m_PollStates[tid][m_EventFDs[tid][0]];
+	state.Events = POLLIN;
+	ArmPoll(tid, m_EventFDs[tid][0], state, POLLIN);
+}
+
+/* Readiness is tracked with one-shot poll requests; the user data carries the fd and
+ * the generation of the request so that completions for stale requests can be ignored. */
+void SocketEventEngineIoUring::ArmPoll(int tid, SOCKET fd, PollState& state, int events)
+{
+	io_uring_sqe *sqe = m_Rings[tid]->GetSQE();
+
+	if (!sqe) {
+		Log(LogCritical, "SocketEvents")
+			<< "Submission queue for I/O thread " << tid << " is full.";
+		return;
+	}
+
+	state.Generation = ++m_NextGeneration[tid];
+	state.ArmedEvents = events;
+	state.Armed = true;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll_events = events;
+	sqe->user_data = (static_cast<uint64_t>(fd) << 32) | state.Generation;
+
+	m_Rings[tid]->CommitSQE();
+}
+
+void SocketEventEngineIoUring::CancelPoll(int tid, SOCKET fd, PollState& state)
+{
+	io_uring_sqe *sqe = m_Rings[tid]->GetSQE();
+
+	if (!sqe) {
+		Log(LogCritical, "SocketEvents")
+			<< "Submission queue for I/O thread " << tid << " is full.";
+		return;
+	}
+
+	state.Armed = false;
+
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = (static_cast<uint64_t>(fd) << 32) | state.Generation;
+	sqe->user_data = IOURING_CANCEL_TAG;
+
+	m_Rings[tid]->CommitSQE();
+}
+
+void SocketEventEngineIoUring::Submit(int tid)
+{
+	/* The I/O thread submits its pending entries when it waits for completions. */
+	if (std::this_thread::get_id() == m_Threads[tid].get_id())
+		return;
+
+	unsigned pending = m_Rings[tid]->GetPendingSubmissions();
+
+	if (pending > 0 && m_Rings[tid]->Enter(pending, 0, 0) < 0) {
+		Log(LogCritical, "SocketEvents")
+			<< "io_uring_enter() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+	}
+}
+
+void SocketEventEngineIoUring::ThreadProc(int tid)
+{
+	Utility::SetThreadName("SocketIO");
+
+	Ring *ring = m_Rings[tid];
+	std::vector<SOCKET> fired;
+
+	for (;;) {
+		unsigned pending;
+
+		{
+			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+			if (m_FDChanged[tid]) {
+				m_FDChanged[tid] = false;
+				m_CV[tid].notify_all();
+			}
+
+			pending = ring->GetPendingSubmissions();
+		}
+
+		/* Re-armed polls are submitted in the same syscall that waits for completions. */
+		if (ring->Enter(pending, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EBUSY) {
+			Log(LogCritical, "SocketEvents")
+				<< "io_uring_enter() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		}
+
+		std::vector<EventDescription> events;
+		fired.clear();
+
+		{
+			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+			/* Unlike with epoll we can't just skip this iteration because the poll requests
+			 * are one-shot. Completions for sockets which are gone are filtered below. */
+			if (m_FDChanged[tid]) {
+				m_FDChanged[tid] = false;
+				m_CV[tid].notify_all();
+			}
+
+			unsigned head = *ring->CQHead;
+			unsigned tail = __atomic_load_n(ring->CQTail, __ATOMIC_ACQUIRE);
+
+			for (; head != tail; head++) {
+				const io_uring_cqe& cqe = ring->CQEs[head & ring->CQMask];
+
+				if (cqe.user_data == IOURING_CANCEL_TAG)
+					continue;
+
+				SOCKET fd = static_cast<SOCKET>(cqe.user_data >> 32);
+				uint32_t generation = static_cast<uint32_t>(cqe.user_data);
+
+				PollState *st = m_PollStates[tid].Find(fd);
+
+				if (!st || !st->Armed || st->Generation != generation)
+					continue;
+
+				st->Armed = false;
+
+				if (fd == m_EventFDs[tid][0]) {
+					char buffer[512];
+					if (recv(m_EventFDs[tid][0], buffer, sizeof(buffer), 0) < 0 && errno != EAGAIN)
+						Log(LogCritical, "SocketEvents", "Read from event FD failed.");
+
+					ArmPoll(tid, fd, *st, POLLIN);
+
+					continue;
+				}
+
+				fired.push_back(fd);
+
+				if (cqe.res == -ECANCELED)
+					continue;
+
+				int revents = (cqe.res < 0) ? POLLERR : cqe.res;
+
+				if ((revents & (POLLIN | POLLOUT | POLLHUP | POLLERR)) == 0)
+					continue;
+
+				SocketEventDescriptor *desc = m_Sockets[tid].Find(fd);
+
+				if (!desc)
+					continue;
+
+				EventDescription event;
+				event.REvents = revents;
+				event.Descriptor = *desc;
+				event.LifesupportReference = event.Descriptor.LifesupportObject;
+				VERIFY(event.LifesupportReference);
+
+				events.emplace_back(std::move(event));
+			}
+
+			__atomic_store_n(ring->CQHead, head, __ATOMIC_RELEASE);
+		}
+
+		for (const EventDescription& event : events) {
+			try {
+				event.Descriptor.EventInterface->OnEvent(event.REvents);
+			} catch (const std::exception& ex) {
+				Log(LogCritical, "SocketEvents")
+					<< "Exception thrown in socket I/O handler:\n"
+					<< DiagnosticInformation(ex);
+			} catch (...) {
+				Log(LogCritical, "SocketEvents", "Exception of unknown type thrown in socket I/O handler.");
+			}
+		}
+
+		{
+			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+			for (SOCKET fd : fired) {
+				PollState *st = m_PollStates[tid].Find(fd);
+
+				if (!st || st->Armed || st->Events == 0)
+					continue;
+
+				ArmPoll(tid, fd, *st, st->Events);
+			}
+		}
+	}
+}
+
+void SocketEventEngineIoUring::Register(SocketEvents *se, Object *lifesupportObject)
+{
+	int tid = se->m_Thread;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		VERIFY(se->m_FD != INVALID_SOCKET);
+
+		SocketEventDescriptor desc;
+		desc.Events = 0;
+		desc.EventInterface = se;
+		desc.LifesupportObject = lifesupportObject;
+
+		VERIFY(!m_Sockets[tid].Find(se->m_FD));
+
+		m_Sockets[tid][se->m_FD] = desc;
+		m_PollStates[tid][se->m_FD] = PollState();
+
+		se->m_Events = true;
+	}
+}
+
+void SocketEventEngineIoUring::Unregister(SocketEvents *se)
+{
+	int tid = se->m_Thread;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		if (se->m_FD == INVALID_SOCKET)
+			return;
+
+		m_Sockets[tid].Erase(se->m_FD);
+		m_SocketCount[tid]--;
+		m_FDChanged[tid] = true;
+
+		PollState *st = m_PollStates[tid].Find(se->m_FD);
+
+		if (st) {
+			if (st->Armed)
+				CancelPoll(tid, se->m_FD, *st);
+
+			m_PollStates[tid].Erase(se->m_FD);
+		}
+
+		Submit(tid);
+
+		se->m_FD = INVALID_SOCKET;
+		se->m_Events = false;
+	}
+
+	WakeUpThread(tid, true);
+}
+
+void SocketEventEngineIoUring::ChangeEvents(SocketEvents *se, int events)
+{
+	if (se->m_FD == INVALID_SOCKET)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
+
+	int tid = se->m_Thread;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		SocketEventDescriptor *desc = m_Sockets[tid].Find(se->m_FD);
+
+		if (!desc)
+			return;
+
+		desc->Events = events;
+
+		PollState& state = m_PollStates[tid][se->m_FD];
+		state.Events = events;
+
+		if (state.Armed && state.ArmedEvents == events)
+			return;
+
+		if (state.Armed)
+			CancelPoll(tid, se->m_FD, state);
+
+		if (events != 0)
+			ArmPoll(tid, se->m_FD, state, events);
+
+		Submit(tid);
+	}
+}
+#endif /* __linux__ && HAVE_LINUX_IO_URING_H */
@@ -25,6 +25,10 @@
 
 using namespace icinga;
 
+SocketEventEnginePoll::SocketEventEnginePoll(int threadCount)
+	: SocketEventEngine(threadCount)
+{ }
+
 void SocketEventEnginePoll::InitializeThread(int tid)
 {
 	SocketEventDescriptor sed;
@@ -46,32 +50,30 @@ void SocketEventEnginePoll::ThreadProc(int tid)
 			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
 			if (m_FDChanged[tid]) {
-				pfds.resize(m_Sockets[tid].size());
-				descriptors.resize(m_Sockets[tid].size());
+				pfds.resize(m_Sockets[tid].GetCount());
+				descriptors.resize(m_Sockets[tid].GetCount());
 
 				int i = 0;
 
-				typedef std::map<SOCKET, SocketEventDescriptor>::value_type kv_pair;
-
-				for (const kv_pair& desc : m_Sockets[tid]) {
-					if (desc.second.Events == 0)
-						continue;
+				m_Sockets[tid].ForEach([&pfds, &descriptors, &i](SOCKET fd, const SocketEventDescriptor& desc) {
+					if (desc.Events == 0)
+						return;
 
-					int events = desc.second.Events;
+					int events = desc.Events;
 
-					if (desc.second.EventInterface) {
-						desc.second.EventInterface->m_EnginePrivate = &pfds[i];
+					if (desc.EventInterface) {
+						desc.EventInterface->m_EnginePrivate = &pfds[i];
 
-						if (!desc.second.EventInterface->m_Events)
+						if (!desc.EventInterface->m_Events)
 							events = 0;
 					}
 
-					pfds[i].fd = desc.first;
+					pfds[i].fd = fd;
 					pfds[i].events = events;
-					descriptors[i] = desc.second;
+					descriptors[i] = desc;
 
 					i++;
-				}
+				});
 
 				pfds.resize(i);
 
@@ -134,7 +136,7 @@ void SocketEventEnginePoll::ThreadProc(int tid)
 
 void SocketEventEnginePoll::Register(SocketEvents *se, Object *lifesupportObject)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_Thread;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -146,7 +148,7 @@ void SocketEventEnginePoll::Register(SocketEvents *se, Object *lifesupportObject
 		desc.EventInterface = se;
 		desc.LifesupportObject = lifesupportObject;
 
-		VERIFY(m_Sockets[tid].find(se->m_FD) == m_Sockets[tid].end());
+		VERIFY(!m_Sockets[tid].Find(se->m_FD));
 
 		m_Sockets[tid][se->m_FD] = desc;
 
@@ -160,7 +162,7 @@ void SocketEventEnginePoll::Register(SocketEvents *se, Object *lifesupportObject
 
 void SocketEventEnginePoll::Unregister(SocketEvents *se)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_Thread;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -168,7 +170,8 @@ void SocketEventEnginePoll::Unregister(SocketEvents *se)
 		if (se->m_FD == INVALID_SOCKET)
 			return;
 
-		m_Sockets[tid].erase(se->m_FD);
+		m_Sockets[tid].Erase(se->m_FD);
+		m_SocketCount[tid]--;
 		m_FDChanged[tid] = true;
 
 		se->m_FD = INVALID_SOCKET;
@@ -183,20 +186,20 @@ void SocketEventEnginePoll::ChangeEvents(SocketEvents *se, int events)
 	if (se->m_FD == INVALID_SOCKET)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
 
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_Thread;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
-		auto it = m_Sockets[tid].find(se->m_FD);
+		SocketEventDescriptor *desc = m_Sockets[tid].Find(se->m_FD);
 
-		if (it == m_Sockets[tid].end())
+		if (!desc)
 			return;
 
-		if (it->second.Events == events)
+		if (desc->Events == events)
 			return;
 
-		it->second.Events = events;
+		desc->Events = events;
 
 		if (se->m_EnginePrivate && std::this_thread::get_id() == m_Threads[tid].get_id())
 			((pollfd *)se->m_EnginePrivate)->events = events;
@@ -22,6 +22,7 @@
 #include "base/logger.hpp"
 #include "base/application.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/threadplacement.hpp"
 #include <boost/thread/once.hpp>
 #include <map>
 #ifdef __linux__
@@ -33,11 +34,19 @@ using namespace icinga;
 static boost::once_flag l_SocketIOOnceFlag = BOOST_ONCE_INIT;
 static SocketEventEngine *l_SocketIOEngine;
 
-int SocketEvents::m_NextID = 0;
+SocketEventEngine::SocketEventEngine(int threadCount)
+	: m_ThreadCount(threadCount), m_Threads(new std::thread[threadCount]),
+	m_EventFDs(new SOCKET[threadCount][2]), m_FDChanged(new bool[threadCount]()),
+	m_EventMutex(new boost::mutex[threadCount]), m_CV(new boost::condition_variable[threadCount]),
+	m_Sockets(new SocketTable<SocketEventDescriptor>[threadCount]), m_SocketCount(new std::atomic<int>[threadCount])
+{
+	for (int tid = 0; tid < threadCount; tid++)
+		m_SocketCount[tid].store(0);
+}
 
 void SocketEventEngine::Start()
 {
-	for (int tid = 0; tid < SOCKET_IOTHREADS; tid++) {
+	for (int tid = 0; tid < m_ThreadCount; tid++) {
 		Socket::SocketPair(m_EventFDs[tid]);
 
 		Utility::SetNonBlockingSocket(m_EventFDs[tid][0]);
@@ -50,14 +59,46 @@ void SocketEventEngine::Start()
 
 		InitializeThread(tid);
 
-		m_Threads[tid] = std::thread(std::bind(&SocketEventEngine::ThreadProc, this, tid));
+		m_Threads[tid] = std::thread([this, tid]() {
+			ThreadPlacement::PlaceThread(tid);
+			ThreadProc(tid);
+		});
 	}
 }
 
-void SocketEventEngine::WakeUpThread(int sid, bool wait)
+int SocketEventEngine::GetThreadCount() const
+{
+	return m_ThreadCount;
+}
+
+/**
+ * Picks the I/O thread for a new socket. Sockets are placed on the thread
+ * which currently handles the fewest sockets so that connections which are
+ * closed and re-established don't pile up on a few threads.
+ *
+ * @returns The thread ID.
+ */
+int SocketEventEngine::AssignThread()
 {
-	int tid = sid % SOCKET_IOTHREADS;
+	int best = 0;
+	int bestCount = m_SocketCount[0].load();
+
+	for (int tid = 1; tid < m_ThreadCount; tid++) {
+		int count = m_SocketCount[tid].load();
+
+		if (count < bestCount) {
+			best = tid;
+			bestCount = count;
+		}
+	}
+
+	m_SocketCount[best]++;
 
+	return best;
+}
+
+void SocketEventEngine::WakeUpThread(int tid, bool wait)
+{
 	if (std::this_thread::get_id() == m_Threads[tid].get_id())
 		return;
 
@@ -88,31 +129,54 @@ void SocketEvents::InitializeEngine()
 		eventEngine = "poll";
 #endif /* __linux__ */
 
+	Value defaultThreads = Application::GetConcurrency();
+	int threads = ScriptGlobal::Get("SocketIOThreads", &defaultThreads);
+
+	if (threads < 1)
+		threads = 1;
+
 	if (eventEngine == "poll")
-		l_SocketIOEngine = new SocketEventEnginePoll();
+		l_SocketIOEngine = new SocketEventEnginePoll(threads);
 #ifdef __linux__
 	else if (eventEngine == "epoll")
-		l_SocketIOEngine = new SocketEventEngineEpoll();
+		l_SocketIOEngine = new SocketEventEngineEpoll(threads);
 #endif /* __linux__ */
+#if defined(__linux__) && defined(HAVE_LINUX_IO_URING_H)
+	else if (eventEngine == "io_uring") {
+		if (SocketEventEngineIoUring::IsSupported())
+			l_SocketIOEngine = new SocketEventEngineIoUring(threads);
+		else {
+			Log(LogWarning, "SocketEvents", "The io_uring interface is not available - Falling back to 'epoll'");
+
+			eventEngine = "epoll";
+
+			l_SocketIOEngine = new SocketEventEngineEpoll(threads);
+		}
+	}
+#endif /* __linux__ && HAVE_LINUX_IO_URING_H */
 	else {
 		Log(LogWarning, "SocketEvents")
 			<< "Invalid event engine selected: " << eventEngine << " - Falling back to 'poll'";
 
 		eventEngine = "poll";
 
-		l_SocketIOEngine = new SocketEventEnginePoll();
+		l_SocketIOEngine = new SocketEventEnginePoll(threads);
 	}
 
 	l_SocketIOEngine->Start();
 
 	ScriptGlobal::Set("EventEngine", eventEngine);
+	ScriptGlobal::Set("SocketIOThreads", threads);
+
+	Log(LogNotice, "SocketEvents")
+		<< "Started " << threads << " socket I/O threads using the '" << eventEngine << "' event engine.";
 }
 
 /**
  * Constructor for the SocketEvents class.
  */
 SocketEvents::SocketEvents(const Socket::Ptr& socket, Object *lifesupportObject)
-	: m_ID(m_NextID++), m_FD(socket->GetFD()), m_EnginePrivate(nullptr)
+	: m_Thread(-1), m_FD(socket->GetFD()), m_EnginePrivate(nullptr)
 {
 	boost::call_once(l_SocketIOOnceFlag, &SocketEvents::InitializeEngine);
 
@@ -126,6 +190,8 @@ SocketEvents::~SocketEvents()
 
 void SocketEvents::Register(Object *lifesupportObject)
 {
+	m_Thread = l_SocketIOEngine->AssignThread();
+
 	l_SocketIOEngine->Register(this, lifesupportObject);
 }
 
@@ -146,8 +212,7 @@ boost::mutex& SocketEventEngine::GetMutex(int tid)
 
 bool SocketEvents::IsHandlingEvents() const
 {
-	int tid = m_ID % SOCKET_IOTHREADS;
-	boost::mutex::scoped_lock lock(l_SocketIOEngine->GetMutex(tid));
+	boost::mutex::scoped_lock lock(l_SocketIOEngine->GetMutex(m_Thread));
 	return m_Events;
 }
 
@@ -23,7 +23,12 @@
 #include "base/i2-base.hpp"
 #include "base/socket.hpp"
 #include <boost/thread/condition_variable.hpp>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #ifndef _WIN32
 #	include <poll.h>
@@ -57,13 +62,11 @@ protected:
 	SocketEvents(const Socket::Ptr& socket, Object *lifesupportObject);
 
 private:
-	int m_ID;
+	int m_Thread;
 	SOCKET m_FD;
 	bool m_Events;
 	void *m_EnginePrivate;
 
-	static int m_NextID;
-
 	static void InitializeEngine();
 
 	void WakeUpThread(bool wait = false);
@@ -72,9 +75,104 @@ private:
 
 	friend class SocketEventEnginePoll;
 	friend class SocketEventEngineEpoll;
+	friend class SocketEventEngineIoUring;
 };
 
-#define SOCKET_IOTHREADS 8
+/**
+ * Maps sockets to per-socket state. On POSIX systems the table is indexed by
+ * the file descriptor, which is small and dense, so lookups don't need to
+ * search. Windows socket handles are arbitrary values so a map is used there.
+ *
+ * @ingroup base
+ */
+template<typename T>
+class SocketTable
+{
+public:
+	T *Find(SOCKET fd)
+	{
+#ifndef _WIN32
+		if (fd < 0 || static_cast<size_t>(fd) >= m_Slots.size() || !m_Slots[fd].Used)
+			return nullptr;
+
+		return &m_Slots[fd].Value;
+#else /* _WIN32 */
+		auto it = m_Slots.find(fd);
+		return (it != m_Slots.end()) ? &it->second : nullptr;
+#endif /* _WIN32 */
+	}
+
+	/* Inserts a default-constructed value if there is none for the socket yet. */
+	T& operator[](SOCKET fd)
+	{
+#ifndef _WIN32
+		if (static_cast<size_t>(fd) >= m_Slots.size())
+			m_Slots.resize(std::max(static_cast<size_t>(fd) + 1, m_Slots.size() * 2));
+
+		Slot& slot = m_Slots[fd];
+
+		if (!slot.Used) {
+			slot.Used = true;
+			slot.Value = T();
+			m_Count++;
+		}
+
+		return slot.Value;
+#else /* _WIN32 */
+		return m_Slots[fd];
+#endif /* _WIN32 */
+	}
+
+	void Erase(SOCKET fd)
+	{
+#ifndef _WIN32
+		if (Find(fd)) {
+			m_Slots[fd].Used = false;
+			m_Count--;
+		}
+#else /* _WIN32 */
+		m_Slots.erase(fd);
+#endif /* _WIN32 */
+	}
+
+	size_t GetCount() const
+	{
+#ifndef _WIN32
+		return m_Count;
+#else /* _WIN32 */
+		return m_Slots.size();
+#endif /* _WIN32 */
+	}
+
+	/* Calls func(fd, value) for each socket in ascending order. */
+	template<typename F>
+	void ForEach(const F& func) const
+	{
+#ifndef _WIN32
+		for (size_t fd = 0; fd < m_Slots.size(); fd++) {
+			if (m_Slots[fd].Used)
+				func(static_cast<SOCKET>(fd), m_Slots[fd].Value);
+		}
+#else /* _WIN32 */
+		for (const auto& kv : m_Slots)
+			func(kv.first, kv.second);
+#endif /* _WIN32 */
+	}
+
+private:
+#ifndef _WIN32
+	struct Slot
+	{
+		bool Used{false};
+		T Value;
+	};
+
+	std::vector<Slot> m_Slots;
+	size_t m_Count{0};
+#else /* _WIN32 */
+	std::map<SOCKET, T> m_Slots;
+#endif /* _WIN32 */
+};
 
 struct SocketEventDescriptor
 {
@@ -93,9 +191,15 @@ struct EventDescription
 class SocketEventEngine
 {
 public:
+	SocketEventEngine(int threadCount);
+	virtual ~SocketEventEngine() = default;
+
 	void Start();
 
-	void WakeUpThread(int sid, bool wait);
+	int GetThreadCount() const;
+	int AssignThread();
+
+	void WakeUpThread(int tid, bool wait);
 
 	boost::mutex& GetMutex(int tid);
 
@@ -106,12 +210,14 @@ protected:
 	virtual void Unregister(SocketEvents *se) = 0;
 	virtual void ChangeEvents(SocketEvents *se, int events) = 0;
 
-	std::thread m_Threads[SOCKET_IOTHREADS];
-	SOCKET m_EventFDs[SOCKET_IOTHREADS][2];
-	bool m_FDChanged[SOCKET_IOTHREADS];
-	boost::mutex m_EventMutex[SOCKET_IOTHREADS];
-	boost::condition_variable m_CV[SOCKET_IOTHREADS];
-	std::map<SOCKET, SocketEventDescriptor> m_Sockets[SOCKET_IOTHREADS];
+	int m_ThreadCount;
+	std::unique_ptr<std::thread[]> m_Threads;
+	std::unique_ptr<SOCKET[][2]> m_EventFDs;
+	std::unique_ptr<bool[]> m_FDChanged;
+	std::unique_ptr<boost::mutex[]> m_EventMutex;
+	std::unique_ptr<boost::condition_variable[]> m_CV;
+	std::unique_ptr<SocketTable<SocketEventDescriptor>[]> m_Sockets;
+	std::unique_ptr<std::atomic<int>[]> m_SocketCount;
 
 	friend class SocketEvents;
 };
@@ -119,6 +225,8 @@ protected:
 class SocketEventEnginePoll final : public SocketEventEngine
 {
 public:
+	SocketEventEnginePoll(int threadCount);
+
 	void Register(SocketEvents *se, Object *lifesupportObject) override;
 	void Unregister(SocketEvents *se) override;
 	void ChangeEvents(SocketEvents *se, int events) override;
@@ -132,6 +240,8 @@ protected:
 class SocketEventEngineEpoll : public SocketEventEngine
 {
 public:
+	SocketEventEngineEpoll(int threadCount);
+
 	virtual void Register(SocketEvents *se, Object *lifesupportObject);
 	virtual void Unregister(SocketEvents *se);
 	virtual void ChangeEvents(SocketEvents *se, int events);
@@ -141,13 +251,50 @@ protected:
 	virtual void ThreadProc(int tid);
 
 private:
-	SOCKET m_PollFDs[SOCKET_IOTHREADS];
+	std::vector<SOCKET> m_PollFDs;
 
 	static int PollToEpoll(int events);
 	static int EpollToPoll(int events);
 };
 #endif /* __linux__ */
 
+#if defined(__linux__) && defined(HAVE_LINUX_IO_URING_H)
+class SocketEventEngineIoUring final : public SocketEventEngine
+{
+public:
+	SocketEventEngineIoUring(int threadCount);
+
+	static bool IsSupported();
+
+	void Register(SocketEvents *se, Object *lifesupportObject) override;
+	void Unregister(SocketEvents *se) override;
+	void ChangeEvents(SocketEvents *se, int events) override;
+
+protected:
+	void InitializeThread(int tid) override;
+	void ThreadProc(int tid) override;
+
+private:
+	struct Ring;
+
+	struct PollState
+	{
+		int Events{0};
+		int ArmedEvents{0};
+		uint32_t Generation{0};
+		bool Armed{false};
+	};
+
+	std::vector<Ring *> m_Rings;
+	std::vector<SocketTable<PollState> > m_PollStates;
+	std::vector<uint32_t> m_NextGeneration;
+
+	void ArmPoll(int tid, SOCKET fd, PollState& state, int events);
+	void CancelPoll(int tid, SOCKET fd, PollState& state);
+	void Submit(int tid);
+};
+#endif /* __linux__ && HAVE_LINUX_IO_URING_H */
+
 }
 
 #endif /* SOCKETEVENTS_H */
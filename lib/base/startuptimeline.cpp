@@ -0,0 +1,256 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/startuptimeline.hpp"
+#include "base/application.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#ifndef _WIN32
+#	include <sys/resource.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+namespace
+{
+
+struct StartupPhaseEntry
+{
+	String Name;
+	double Start; /**< Seconds since the program start when the phase was first entered. */
+	double Duration;
+	int Count;
+	double PeakRss;
+	bool Concurrent; /**< Whether the duration is the sum of several threads. */
+};
+
+}
+
+static boost::mutex l_TimelineMutex;
+static std::vector<StartupPhaseEntry> l_Phases;
+static std::vector<std::pair<String, double> > l_Milestones;
+static bool l_Finished = false;
+static double l_FinishTime = 0;
+
+/**
+ * Returns the largest resident set size of the process so far in bytes.
+ */
+static double GetPeakRss()
+{
+#ifndef _WIN32
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0;
+
+#	ifdef __APPLE__
+	return usage.ru_maxrss;
+#	else /* __APPLE__ */
+	return usage.ru_maxrss * 1024.0;
+#	endif /* __APPLE__ */
+#else /* _WIN32 */
+	return 0;
+#endif /* _WIN32 */
+}
+
+static StartupPhaseEntry& GetPhase(const String& name, double start)
+{
+	for (StartupPhaseEntry& entry : l_Phases) {
+		if (entry.Name == name)
+			return entry;
+	}
+
+	l_Phases.push_back({ name, start - Application::GetStartTime(), 0, 0, 0, false });
+	return l_Phases.back();
+}
+
+static String FormatSize(double bytes)
+{
+	std::ostringstream msgbuf;
+	msgbuf << std::fixed << std::setprecision(1) << bytes / (1024 * 1024) << " MiB";
+	return msgbuf.str();
+}
+
+/**
+ * Records a phase. Phases with the same name are added up.
+ *
+ * @param name The name of the phase.
+ * @param start When the phase started.
+ * @param end When the phase ended.
+ */
+void StartupTimeline::AddPhase(const String& name, double start, double end)
+{
+	double peakRss = GetPeakRss();
+
+	boost::mutex::scoped_lock lock(l_TimelineMutex);
+
+	if (l_Finished)
+		return;
+
+	StartupPhaseEntry& entry = GetPhase(name, start);
+	entry.Duration += end - start;
+	entry.Count++;
+	entry.PeakRss = std::max(entry.PeakRss, peakRss);
+}
+
+/**
+ * Records time which was spent by several threads in parallel, e.g.
+ * validating objects. The duration is the sum over all threads.
+ *
+ * @param name The name of the phase.
+ * @param duration The duration in seconds.
+ */
+void StartupTimeline::AddConcurrentTime(const String& name, double duration)
+{
+	if (duration <= 0)
+		return;
+
+	boost::mutex::scoped_lock lock(l_TimelineMutex);
+
+	if (l_Finished)
+		return;
+
+	double now = Utility::GetTime();
+
+	StartupPhaseEntry& entry = GetPhase(name, now - duration);
+	entry.Duration += duration;
+	entry.Count++;
+	entry.Concurrent = true;
+}
+
+/**
+ * Records when something happened for the first time, e.g. when the first
+ * check was scheduled. Unlike phases this also works after the startup
+ * has finished.
+ *
+ * @param name The name of the milestone.
+ */
+void StartupTimeline::AddMilestone(const String& name)
+{
+	double offset = Utility::GetTime() - Application::GetStartTime();
+
+	{
+		boost::mutex::scoped_lock lock(l_TimelineMutex);
+
+		for (const auto& milestone : l_Milestones) {
+			if (milestone.first == name)
+				return;
+		}
+
+		l_Milestones.emplace_back(name, offset);
+	}
+
+	Log(LogInformation, "StartupTimeline")
+		<< "Milestone '" << name << "' reached " << Utility::FormatDuration(offset) << " after the program start.";
+}
+
+/**
+ * Stops recording phases and logs a summary.
+ */
+void StartupTimeline::Finish()
+{
+	std::vector<StartupPhaseEntry> phases;
+	double duration;
+
+	{
+		boost::mutex::scoped_lock lock(l_TimelineMutex);
+
+		if (l_Finished)
+			return;
+
+		l_Finished = true;
+		l_FinishTime = Utility::GetTime();
+		phases = l_Phases;
+	}
+
+	duration = l_FinishTime - Application::GetStartTime();
+
+	Log(LogInformation, "StartupTimeline")
+		<< "Startup finished after " << Utility::FormatDuration(duration)
+		<< " (peak RSS " << FormatSize(GetPeakRss()) << ").";
+
+	for (const StartupPhaseEntry& entry : phases) {
+		Log msg(LogInformation, "StartupTimeline");
+
+		msg << "Phase '" << entry.Name << "': " << std::fixed << std::setprecision(3) << entry.Duration << "s";
+
+		if (entry.Concurrent)
+			msg << " (summed over all threads)";
+		else
+			msg << " starting at " << std::setprecision(3) << entry.Start << "s, peak RSS " << FormatSize(entry.PeakRss);
+
+		if (entry.Count > 1)
+			msg << ", entered " << entry.Count << " times";
+	}
+}
+
+bool StartupTimeline::IsFinished()
+{
+	boost::mutex::scoped_lock lock(l_TimelineMutex);
+	return l_Finished;
+}
+
+Dictionary::Ptr StartupTimeline::ToDictionary()
+{
+	ArrayData phases;
+	DictionaryData milestones;
+	bool finished;
+	double duration;
+
+	{
+		boost::mutex::scoped_lock lock(l_TimelineMutex);
+
+		for (const StartupPhaseEntry& entry : l_Phases) {
+			phases.emplace_back(new Dictionary({
+				{ "name", entry.Name },
+				{ "start", entry.Start },
+				{ "duration", entry.Duration },
+				{ "count", entry.Count },
+				{ "peak_rss", entry.PeakRss },
+				{ "concurrent", entry.Concurrent }
+			}));
+		}
+
+		for (const auto& milestone : l_Milestones)
+			milestones.emplace_back(milestone.first, milestone.second);
+
+		finished = l_Finished;
+		duration = l_Finished ? l_FinishTime - Application::GetStartTime() : 0;
+	}
+
+	return new Dictionary({
+		{ "finished", finished },
+		{ "duration", duration },
+		{ "phases", new Array(std::move(phases)) },
+		{ "milestones", new Dictionary(std::move(milestones)) }
+	});
+}
+
+StartupPhase::StartupPhase(String name)
+	: m_Name(std::move(name)), m_Start(Utility::GetTime())
+{ }
+
+StartupPhase::~StartupPhase()
+{
+	StartupTimeline::AddPhase(m_Name, m_Start, Utility::GetTime());
+}
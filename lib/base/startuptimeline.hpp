@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef STARTUPTIMELINE_H
+#define STARTUPTIMELINE_H
+
+#include "base/i2-base.hpp"
+#include "base/dictionary.hpp"
+
+namespace icinga
+{
+
+/**
+ * Records how long the phases of the startup took (e.g. config parse,
+ * commit, state restore and activation) and how large the process was
+ * at the end of each phase. Phases which are entered more than once are
+ * added up. Nothing is recorded after the startup has finished.
+ *
+ * @ingroup base
+ */
+class StartupTimeline
+{
+public:
+	static void AddPhase(const String& name, double start, double end);
+	static void AddConcurrentTime(const String& name, double duration);
+	static void AddMilestone(const String& name);
+
+	static void Finish();
+	static bool IsFinished();
+
+	static Dictionary::Ptr ToDictionary();
+};
+
+/**
+ * Records a startup phase for the lifetime of the object.
+ *
+ * @ingroup base
+ */
+class StartupPhase
+{
+public:
+	explicit StartupPhase(String name);
+	~StartupPhase();
+
+	StartupPhase(const StartupPhase&) = delete;
+	StartupPhase& operator=(const StartupPhase&) = delete;
+
+private:
+	String m_Name;
+	double m_Start;
+};
+
+}
+
+#endif /* STARTUPTIMELINE_H */
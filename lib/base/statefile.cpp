@@ -0,0 +1,199 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/statefile.hpp"
+#include "base/netstring.hpp"
+#include "base/msgpack.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#ifndef _WIN32
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif /* _WIN32 */
+#include <boost/exception/errinfo_api_function.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+
+using namespace icinga;
+
+static const char l_StateFileMagic[] = "I2STATE";
+
+/**
+ * Writes the header of a new state file or journal.
+ *
+ * @param stream The stream.
+ */
+void StateFile::WriteHeader(const Stream::Ptr& stream)
+{
+	char header[HeaderSize];
+	memcpy(header, l_StateFileMagic, HeaderSize - 1);
+	header[HeaderSize - 1] = static_cast<char>(Version);
+
+	stream->Write(header, sizeof(header));
+}
+
+/**
+ * Appends a record to a state file or journal.
+ *
+ * @param stream The stream.
+ * @param record The record.
+ * @returns The number of bytes which were written.
+ */
+size_t StateFile::WriteRecord(const Stream::Ptr& stream, const Value& record)
+{
+	return NetString::WriteStringToStream(stream, EncodeRecord(record));
+}
+
+String StateFile::EncodeRecord(const Value& record)
+{
+	return MsgPackEncode(record);
+}
+
+/**
+ * Decodes a record. Records which were written by older versions are JSON
+ * objects, MessagePack maps never start with '{'.
+ *
+ * @param data The record.
+ * @returns The decoded record.
+ */
+Value StateFile::DecodeRecord(const String& data)
+{
+	if (!data.IsEmpty() && data[0] == '{')
+		return JsonDecode(data);
+
+	return MsgPackDecode(data);
+}
+
+StateFileView::StateFileView(const String& filename)
+	: m_Filename(filename)
+{
+#ifndef _WIN32
+	int fd = open(filename.CStr(), O_RDONLY);
+
+	if (fd < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("open")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(filename));
+	}
+
+	struct stat statbuf;
+
+	if (fstat(fd, &statbuf) < 0) {
+		close(fd);
+
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("fstat")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(filename));
+	}
+
+	m_Size = statbuf.st_size;
+
+	if (m_Size > 0) {
+		void *data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data == MAP_FAILED) {
+			close(fd);
+
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("mmap")
+				<< boost::errinfo_errno(errno)
+				<< boost::errinfo_file_name(filename));
+		}
+
+		m_Data = static_cast<const char *>(data);
+
+		madvise(data, m_Size, MADV_SEQUENTIAL);
+	}
+
+	close(fd);
+#else /* _WIN32 */
+	std::ifstream fp(filename.CStr(), std::ios_base::in | std::ios_base::binary);
+	m_Buffer.assign(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>());
+
+	m_Data = m_Buffer.data();
+	m_Size = m_Buffer.size();
+#endif /* _WIN32 */
+
+	if (m_Size >= StateFile::HeaderSize && memcmp(m_Data, l_StateFileMagic, StateFile::HeaderSize - 1) == 0) {
+		m_Version = static_cast<unsigned char>(m_Data[StateFile::HeaderSize - 1]);
+		m_Offset = StateFile::HeaderSize;
+
+		if (m_Version > StateFile::Version) {
+			BOOST_THROW_EXCEPTION(std::invalid_argument("State file '" + filename + "' has version "
+				+ std::to_string(m_Version) + " which is newer than the supported version "
+				+ std::to_string(StateFile::Version) + "."));
+		}
+	}
+}
+
+StateFileView::~StateFileView()
+{
+#ifndef _WIN32
+	if (m_Data)
+		munmap(const_cast<char *>(m_Data), m_Size);
+#endif /* _WIN32 */
+}
+
+/**
+ * Returns the version of the file's format. Files without a header
+ * (i.e. JSON records only) have version 0.
+ */
+int StateFileView::GetVersion() const
+{
+	return m_Version;
+}
+
+/**
+ * Finds the netstring records in the file. A truncated record at the end
+ * of the file (e.g. from a journal write which was interrupted) is ignored.
+ *
+ * @returns The records' payloads.
+ */
+std::vector<std::pair<const char *, size_t> > StateFileView::GetRecords() const
+{
+	std::vector<std::pair<const char *, size_t> > records;
+
+	size_t offset = m_Offset;
+
+	while (offset < m_Size) {
+		const char *data;
+		size_t len;
+		size_t count = NetString::ParseString(m_Data + offset, m_Size - offset, &data, &len);
+
+		if (count == 0) {
+			Log(LogWarning, "StateFile")
+				<< "Ignoring truncated record at offset " << offset << " in file '" << m_Filename << "'";
+			break;
+		}
+
+		records.emplace_back(data, len);
+
+		offset += count;
+	}
+
+	return records;
+}
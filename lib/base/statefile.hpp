@@ -0,0 +1,93 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef STATEFILE_H
+#define STATEFILE_H
+
+#include "base/i2-base.hpp"
+#include "base/stream.hpp"
+#include "base/value.hpp"
+#include <utility>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * The format of the state file and its journal.
+ *
+ * A file starts with the magic "I2STATE" and a version byte, followed by
+ * netstrings which contain one MessagePack-encoded record each. Files which
+ * were written by older versions don't have the header and contain JSON
+ * records. The decoder tells the formats apart by each record's first byte,
+ * so records can be appended to an old journal.
+ *
+ * @ingroup base
+ */
+class StateFile
+{
+public:
+	static const int Version = 1;
+	static const size_t HeaderSize = 8;
+
+	static void WriteHeader(const Stream::Ptr& stream);
+	static size_t WriteRecord(const Stream::Ptr& stream, const Value& record);
+
+	static String EncodeRecord(const Value& record);
+	static Value DecodeRecord(const String& data);
+
+private:
+	StateFile();
+};
+
+/**
+ * Read-only view of a state file's contents. The file is mapped into memory
+ * where possible so that the records can be decoded without copying them
+ * through a stream first.
+ *
+ * @ingroup base
+ */
+class StateFileView
+{
+public:
+	StateFileView(const String& filename);
+	~StateFileView();
+
+	StateFileView(const StateFileView&) = delete;
+	StateFileView& operator=(const StateFileView&) = delete;
+
+	int GetVersion() const;
+
+	std::vector<std::pair<const char *, size_t> > GetRecords() const;
+
+private:
+	String m_Filename;
+	const char *m_Data{nullptr};
+	size_t m_Size{0};
+	size_t m_Offset{0};
+	int m_Version{0};
+
+#ifdef _WIN32
+	std::vector<char> m_Buffer;
+#endif /* _WIN32 */
+};
+
+}
+
+#endif /* STATEFILE_H */
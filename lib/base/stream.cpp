@@ -50,6 +50,17 @@ size_t Stream::Peek(void *buffer, size_t count, bool allow_partial)
 	BOOST_THROW_EXCEPTION(std::runtime_error("Stream does not support Peek()."));
 }
 
+bool Stream::ReadBuffered(const std::function<size_t (const char *, size_t)>&)
+{
+	return false;
+}
+
+void Stream::WriteBuffers(const StreamBuffer *buffers, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		Write(buffers[i].Data, buffers[i].Size);
+}
+
 void Stream::SignalDataAvailable()
 {
 	OnDataAvailable(this);
@@ -150,13 +161,37 @@ bool StreamReadContext::FillFromStream(const Stream::Ptr& stream, bool may_wait)
 	if (may_wait && stream->SupportsWaiting())
 		stream->WaitForData();
 
+	if (Buffer != Allocation) {
+		if (Size > 0)
+			memmove(Allocation, Buffer, Size);
+
+		Buffer = Allocation;
+	}
+
+	/* Give back the memory for a large message once it has been consumed. */
+	if (Capacity > Size + 128 * 1024) {
+		auto *allocation = static_cast<char *>(realloc(Allocation, Size + 4096));
+
+		if (allocation) {
+			Allocation = allocation;
+			Buffer = allocation;
+			Capacity = Size + 4096;
+		}
+	}
+
 	size_t count = 0;
 
 	do {
-		Buffer = (char *)realloc(Buffer, Size + 4096);
+		if (Capacity < Size + 4096) {
+			auto *allocation = static_cast<char *>(realloc(Allocation, Size + 4096));
+
+			if (!allocation)
+				throw std::bad_alloc();
 
-		if (!Buffer)
-			throw std::bad_alloc();
+			Allocation = allocation;
+			Buffer = allocation;
+			Capacity = Size + 4096;
+		}
 
 		if (stream->IsEof())
 			break;
@@ -176,6 +211,9 @@ bool StreamReadContext::FillFromStream(const Stream::Ptr& stream, bool may_wait)
 void StreamReadContext::DropData(size_t count)
 {
 	ASSERT(count <= Size);
-	memmove(Buffer, Buffer + count, Size - count);
+	Buffer += count;
 	Size -= count;
+
+	if (Size == 0)
+		Buffer = Allocation;
 }
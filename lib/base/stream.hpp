@@ -38,11 +38,17 @@ enum ConnectionRole
 	RoleServer
 };
 
+/**
+ * Buffers data which has been read from a stream. Buffer points to the data
+ * which hasn't been consumed yet; dropping data only advances the pointer,
+ * the remaining data is moved to the start of the allocation when more data
+ * is read.
+ */
 struct StreamReadContext
 {
 	~StreamReadContext()
 	{
-		free(Buffer);
+		free(Allocation);
 	}
 
 	bool FillFromStream(const intrusive_ptr<Stream>& stream, bool may_wait);
@@ -50,10 +56,21 @@ struct StreamReadContext
 
 	char *Buffer{nullptr};
 	size_t Size{0};
+	char *Allocation{nullptr};
+	size_t Capacity{0};
 	bool MustRead{true};
 	bool Eof{false};
 };
 
+/**
+ * A range of bytes which is written with Stream::WriteBuffers().
+ */
+struct StreamBuffer
+{
+	const void *Data;
+	size_t Size;
+};
+
 enum StreamReadStatus
 {
 	StatusNewItem,
@@ -102,6 +119,28 @@ public:
 	 */
 	virtual void Write(const void *buffer, size_t count) = 0;
 
+	/**
+	 * Lets the caller work on the data which is buffered by the stream
+	 * without copying it. The callback is called with the buffered data
+	 * (which may be empty) and returns how many bytes it has consumed;
+	 * these bytes are removed from the stream. The data must not be
+	 * accessed after the callback has returned.
+	 *
+	 * @param callback The callback.
+	 * @returns false if the stream doesn't buffer received data, in which
+	 *	    case the callback isn't called.
+	 */
+	virtual bool ReadBuffered(const std::function<size_t (const char *, size_t)>& callback);
+
+	/**
+	 * Writes several buffers to the stream as if Write() was called for
+	 * each of them.
+	 *
+	 * @param buffers The buffers.
+	 * @param count The number of buffers.
+	 */
+	virtual void WriteBuffers(const StreamBuffer *buffers, size_t count);
+
 	/**
 	 * Causes the stream to be closed (via Close()) once all pending data has been
 	 * written.
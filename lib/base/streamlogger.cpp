@@ -72,7 +72,7 @@ void StreamLogger::BindStream(std::ostream *stream, bool ownsStream)
 	m_Stream = stream;
 	m_OwnsStream = ownsStream;
 
-	m_FlushLogTimer = new Timer();
+	m_FlushLogTimer = new Timer("StreamLogger flush");
 	m_FlushLogTimer->SetInterval(1);
 	m_FlushLogTimer->OnTimerExpired.connect(std::bind(&StreamLogger::FlushLogTimerHandler, this));
 	m_FlushLogTimer->Start();
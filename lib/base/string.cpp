@@ -21,10 +21,15 @@
 #include "base/value.hpp"
 #include "base/primitivetype.hpp"
 #include "base/dictionary.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/thread/mutex.hpp>
+#include <atomic>
 #include <ostream>
+#include <unordered_set>
 
 using namespace icinga;
 
@@ -34,6 +39,29 @@ REGISTER_BUILTIN_TYPE(String, String::GetPrototype());
 
 const String::SizeType String::NPos = std::string::npos;
 
+/* Interned strings are never freed. These limits make sure that untrusted
+ * input (e.g. JSON keys) can't grow the intern table indefinitely. */
+static const size_t l_InternMaxLength = 64;
+static const size_t l_InternMaxCount = 256 * 1024;
+
+#define INTERN_SHARDS 16
+
+struct InternTableShard
+{
+	boost::mutex Mutex;
+	std::unordered_set<std::string> Strings;
+};
+
+static std::atomic<size_t> l_InternedCount(0);
+static std::atomic<size_t> l_InternedMemory(0);
+
+static InternTableShard *GetInternTable()
+{
+	/* Intentionally leaked so that interned strings outlive all static destructors. */
+	static auto *table = new InternTableShard[INTERN_SHARDS];
+	return table;
+}
+
 String::String(const char *data)
 	: m_Data(data)
 { }
@@ -47,11 +75,11 @@ String::String(String::SizeType n, char c)
 { }
 
 String::String(const String& other)
-	: m_Data(other)
+	: m_Data(other.m_Data), m_Interned(other.m_Interned)
 { }
 
 String::String(String&& other)
-	: m_Data(std::move(other.m_Data))
+	: m_Data(std::move(other.m_Data)), m_Interned(other.m_Interned)
 { }
 
 #ifndef _MSC_VER
@@ -61,10 +89,99 @@ String::String(Value&& other)
 }
 #endif /* _MSC_VER */
 
+/**
+ * Returns an interned copy of the specified string. Strings which are too
+ * long, or which would exceed the intern table's capacity, are returned as
+ * they are.
+ *
+ * @param str The string.
+ * @returns The interned string.
+ */
+String String::Intern(const String& str)
+{
+	if (str.m_Interned)
+		return str;
+
+	const std::string& data = str.m_Data;
+
+	if (data.size() > l_InternMaxLength)
+		return str;
+
+	InternTableShard& shard = GetInternTable()[std::hash<std::string>()(data) % INTERN_SHARDS];
+
+	String result;
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
+
+	auto it = shard.Strings.find(data);
+
+	if (it == shard.Strings.end()) {
+		if (l_InternedCount.load() >= l_InternMaxCount)
+			return str;
+
+		it = shard.Strings.insert(data).first;
+
+		l_InternedCount++;
+		l_InternedMemory += sizeof(std::string) + sizeof(void *) * 2 + (data.size() >= 16 ? data.capacity() + 1 : 0);
+	}
+
+	result.m_Interned = &*it;
+	return result;
+}
+
+/**
+ * Checks whether the string refers to an entry in the intern table.
+ *
+ * @returns true if the string is interned, false otherwise.
+ */
+bool String::IsInterned() const
+{
+	return m_Interned != nullptr;
+}
+
+size_t String::GetInternedCount()
+{
+	return l_InternedCount.load();
+}
+
+size_t String::GetInternedMemoryUsage()
+{
+	return l_InternedMemory.load();
+}
+
+static void InternStatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	size_t count = String::GetInternedCount();
+	size_t memory = String::GetInternedMemoryUsage();
+
+	status->Set("string_intern", new Dictionary({
+		{ "count", count },
+		{ "memory", memory }
+	}));
+
+	perfdata->Add(new PerfdataValue("string_intern_count", count));
+	perfdata->Add(new PerfdataValue("string_intern_memory", memory));
+}
+
+REGISTER_STATSFUNCTION(StringIntern, &InternStatsFunc);
+
+/**
+ * Copies the interned data into this string's private storage so that it
+ * can be modified.
+ */
+void String::Detach()
+{
+	if (!m_Interned)
+		return;
+
+	m_Data = *m_Interned;
+	m_Interned = nullptr;
+}
+
 String& String::operator=(Value&& other)
 {
 	if (other.IsString())
-		m_Data = std::move(other.Get<String>());
+		*this = other.Get<String>();
 	else
 		*this = static_cast<String>(other);
 
@@ -73,6 +190,7 @@ String& String::operator=(Value&& other)
 
 String& String::operator+=(const Value& rhs)
 {
+	Detach();
 	m_Data += static_cast<String>(rhs);
 	return *this;
 }
@@ -80,240 +198,260 @@ String& String::operator+=(const Value& rhs)
 String& String::operator=(const String& rhs)
 {
 	m_Data = rhs.m_Data;
+	m_Interned = rhs.m_Interned;
 	return *this;
 }
 
 String& String::operator=(String&& rhs)
 {
 	m_Data = std::move(rhs.m_Data);
+	m_Interned = rhs.m_Interned;
 	return *this;
 }
 
 String& String::operator=(const std::string& rhs)
 {
 	m_Data = rhs;
+	m_Interned = nullptr;
 	return *this;
 }
 
 String& String::operator=(const char *rhs)
 {
 	m_Data = rhs;
+	m_Interned = nullptr;
 	return *this;
 }
 
 const char& String::operator[](String::SizeType pos) const
 {
-	return m_Data[pos];
+	return ConstData()[pos];
 }
 
 char& String::operator[](String::SizeType pos)
 {
+	Detach();
 	return m_Data[pos];
 }
 
 String& String::operator+=(const String& rhs)
 {
-	m_Data += rhs.m_Data;
+	Detach();
+	m_Data += rhs.ConstData();
 	return *this;
 }
 
 String& String::operator+=(const char *rhs)
 {
+	Detach();
 	m_Data += rhs;
 	return *this;
 }
 
 String& String::operator+=(char rhs)
 {
+	Detach();
 	m_Data += rhs;
 	return *this;
 }
 
 bool String::IsEmpty() const
 {
-	return m_Data.empty();
+	return ConstData().empty();
 }
 
 bool String::operator<(const String& rhs) const
 {
-	return m_Data < rhs.m_Data;
+	if (m_Interned && m_Interned == rhs.m_Interned)
+		return false;
+
+	return ConstData() < rhs.ConstData();
 }
 
 String::operator const std::string&() const
 {
-	return m_Data;
+	return ConstData();
 }
 
 const char *String::CStr() const
 {
-	return m_Data.c_str();
+	return ConstData().c_str();
 }
 
 void String::Clear()
 {
 	m_Data.clear();
+	m_Interned = nullptr;
 }
 
 String::SizeType String::GetLength() const
 {
-	return m_Data.size();
+	return ConstData().size();
 }
 
 std::string& String::GetData()
 {
+	Detach();
 	return m_Data;
 }
 
 const std::string& String::GetData() const
 {
-	return m_Data;
+	return ConstData();
 }
 
 String::SizeType String::Find(const String& str, String::SizeType pos) const
 {
-	return m_Data.find(str, pos);
+	return ConstData().find(str, pos);
 }
 
 String::SizeType String::RFind(const String& str, String::SizeType pos) const
 {
-	return m_Data.rfind(str, pos);
+	return ConstData().rfind(str, pos);
 }
 
 String::SizeType String::FindFirstOf(const char *s, String::SizeType pos) const
 {
-	return m_Data.find_first_of(s, pos);
+	return ConstData().find_first_of(s, pos);
 }
 
 String::SizeType String::FindFirstOf(char ch, String::SizeType pos) const
 {
-	return m_Data.find_first_of(ch, pos);
+	return ConstData().find_first_of(ch, pos);
 }
 
 String::SizeType String::FindFirstNotOf(const char *s, String::SizeType pos) const
 {
-	return m_Data.find_first_not_of(s, pos);
+	return ConstData().find_first_not_of(s, pos);
 }
 
 String::SizeType String::FindFirstNotOf(char ch, String::SizeType pos) const
 {
-	return m_Data.find_first_not_of(ch, pos);
+	return ConstData().find_first_not_of(ch, pos);
 }
 
 String::SizeType String::FindLastOf(const char *s, String::SizeType pos) const
 {
-	return m_Data.find_last_of(s, pos);
+	return ConstData().find_last_of(s, pos);
 }
 
 String::SizeType String::FindLastOf(char ch, String::SizeType pos) const
 {
-	return m_Data.find_last_of(ch, pos);
+	return ConstData().find_last_of(ch, pos);
 }
 
 String String::SubStr(String::SizeType first, String::SizeType len) const
 {
-	return m_Data.substr(first, len);
+	return ConstData().substr(first, len);
 }
 
 std::vector<String> String::Split(const char *separators) const
 {
 	std::vector<String> result;
-	boost::algorithm::split(result, m_Data, boost::is_any_of(separators));
+	boost::algorithm::split(result, ConstData(), boost::is_any_of(separators));
 	return result;
 }
 
 void String::Replace(String::SizeType first, String::SizeType second, const String& str)
 {
+	Detach();
 	m_Data.replace(first, second, str);
 }
 
 String String::Trim() const
 {
-	String t = m_Data;
+	String t = ConstData();
 	boost::algorithm::trim(t);
 	return t;
 }
 
 String String::ToLower() const
 {
-	String t = m_Data;
+	String t = ConstData();
 	boost::algorithm::to_lower(t);
 	return t;
 }
 
 String String::ToUpper() const
 {
-	String t = m_Data;
+	String t = ConstData();
 	boost::algorithm::to_upper(t);
 	return t;
 }
 
 String String::Reverse() const
 {
-	String t = m_Data;
+	String t = ConstData();
 	std::reverse(t.m_Data.begin(), t.m_Data.end());
 	return t;
 }
 
 void String::Append(int count, char ch)
 {
+	Detach();
 	m_Data.append(count, ch);
 }
 
 bool String::Contains(const String& str) const
 {
-	return (m_Data.find(str) != std::string::npos);
+	return (ConstData().find(str) != std::string::npos);
 }
 
 void String::swap(String& str)
 {
 	m_Data.swap(str.m_Data);
+	std::swap(m_Interned, str.m_Interned);
 }
 
 String::Iterator String::erase(String::Iterator first, String::Iterator last)
 {
+	/* first and last must have been obtained from Begin() or End() which already detached the string. */
 	return m_Data.erase(first, last);
 }
 
 String::Iterator String::Begin()
 {
+	Detach();
 	return m_Data.begin();
 }
 
 String::ConstIterator String::Begin() const
 {
-	return m_Data.begin();
+	return ConstData().begin();
 }
 
 String::Iterator String::End()
 {
+	Detach();
 	return m_Data.end();
 }
 
 String::ConstIterator String::End() const
 {
-	return m_Data.end();
+	return ConstData().end();
 }
 
 String::ReverseIterator String::RBegin()
 {
+	Detach();
 	return m_Data.rbegin();
 }
 
 String::ConstReverseIterator String::RBegin() const
 {
-	return m_Data.rbegin();
+	return ConstData().rbegin();
 }
 
 String::ReverseIterator String::REnd()
 {
+	Detach();
 	return m_Data.rend();
 }
 
 String::ConstReverseIterator String::REnd() const
 {
-	return m_Data.rend();
+	return ConstData().rend();
 }
-
 std::ostream& icinga::operator<<(std::ostream& stream, const String& str)
 {
 	stream << str.GetData();
@@ -345,6 +483,10 @@ String icinga::operator+(const char *lhs, const String& rhs)
 
 bool icinga::operator==(const String& lhs, const String& rhs)
 {
+	/* Interned strings are unique, so their addresses can be compared instead of their contents. */
+	if (lhs.IsInterned() && rhs.IsInterned())
+		return &lhs.GetData() == &rhs.GetData();
+
 	return lhs.GetData() == rhs.GetData();
 }
 
@@ -415,7 +557,7 @@ bool icinga::operator>=(const char *lhs, const String& rhs)
 
 bool icinga::operator!=(const String& lhs, const String& rhs)
 {
-	return lhs.GetData() != rhs.GetData();
+	return !(lhs == rhs);
 }
 
 bool icinga::operator!=(const String& lhs, const char *rhs)
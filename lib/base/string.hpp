@@ -23,6 +23,7 @@
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
 #include <boost/range/iterator.hpp>
+#include <functional>
 #include <string>
 #include <iosfwd>
 
@@ -35,6 +36,11 @@ class Value;
  *
  * Rationale for having this: The std::string class has an ambiguous assignment
  * operator when used in conjunction with the Value class.
+ *
+ * Strings returned by Intern() refer to an immutable entry in a global intern
+ * table. Copying them doesn't allocate any memory and comparing two interned
+ * strings for equality only compares their addresses. Interned strings are
+ * copied into private storage as soon as they're modified.
  */
 class String
 {
@@ -69,6 +75,12 @@ public:
 		: m_Data(begin, end)
 	{ }
 
+	static String Intern(const String& str);
+	bool IsInterned() const;
+
+	static size_t GetInternedCount();
+	static size_t GetInternedMemoryUsage();
+
 	String& operator=(const String& rhs);
 	String& operator=(String&& rhs);
 	String& operator=(Value&& rhs);
@@ -132,6 +144,7 @@ public:
 	template<typename InputIterator>
 	void insert(Iterator p, InputIterator first, InputIterator last)
 	{
+		/* p must have been obtained from Begin() or End() which already detached the string. */
 		m_Data.insert(p, first, last);
 	}
 
@@ -150,6 +163,14 @@ public:
 
 private:
 	std::string m_Data;
+	const std::string *m_Interned{nullptr};
+
+	inline const std::string& ConstData() const
+	{
+		return m_Interned ? *m_Interned : m_Data;
+	}
+
+	void Detach();
 };
 
 std::ostream& operator<<(std::ostream& stream, const String& str);
@@ -212,4 +233,18 @@ struct range_const_iterator<icinga::String>
 
 }
 
+namespace std
+{
+
+template<>
+struct hash<icinga::String>
+{
+	size_t operator()(const icinga::String& str) const
+	{
+		return std::hash<std::string>()(str.GetData());
+	}
+};
+
+}
+
 #endif /* STRING_H */
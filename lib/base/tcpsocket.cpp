@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "base/tcpsocket.hpp"
+#include "base/dnsresolver.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/exception.hpp"
@@ -138,31 +139,16 @@ void TcpSocket::Bind(const String& node, const String& service, int family)
  */
 void TcpSocket::Connect(const String& node, const String& service)
 {
-	addrinfo hints;
-	addrinfo *result;
 	int error;
 	const char *func;
+	int rc;
 
-	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_protocol = IPPROTO_TCP;
-
-	int rc = getaddrinfo(node.CStr(), service.CStr(), &hints, &result);
-
-	if (rc != 0) {
-		Log(LogCritical, "TcpSocket")
-			<< "getaddrinfo() failed with error code " << rc << ", \"" << gai_strerror(rc) << "\"";
-
-		BOOST_THROW_EXCEPTION(socket_error()
-			<< boost::errinfo_api_function("getaddrinfo")
-			<< errinfo_getaddrinfo_error(rc));
-	}
+	std::vector<DnsAddress> addresses = DnsResolver::Resolve(node, service);
 
 	SOCKET fd = INVALID_SOCKET;
 
-	for (addrinfo *info = result; info != nullptr; info = info->ai_next) {
-		fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+	for (const DnsAddress& addr : addresses) {
+		fd = socket(addr.Family, addr.SockType, addr.Protocol);
 
 		if (fd == INVALID_SOCKET) {
 #ifdef _WIN32
@@ -183,10 +169,10 @@ void TcpSocket::Connect(const String& node, const String& service)
 			error = errno;
 #endif /* _WIN32 */
 			Log(LogWarning, "TcpSocket")
-				<< "setsockopt() unable to enable TCP keep-alives with error code " << rc;
+				<< "setsockopt() unable to enable TCP keep-alives with error code " << error;
 		}
 
-		rc = connect(fd, info->ai_addr, info->ai_addrlen);
+		rc = connect(fd, reinterpret_cast<const sockaddr *>(&addr.Address), addr.AddressLength);
 
 		if (rc < 0) {
 #ifdef _WIN32
@@ -206,9 +192,10 @@ void TcpSocket::Connect(const String& node, const String& service)
 		break;
 	}
 
-	freeaddrinfo(result);
-
 	if (GetFD() == INVALID_SOCKET) {
+		/* The addresses may be stale, resolve the name again next time. */
+		DnsResolver::Invalidate(node, service);
+
 		Log(LogCritical, "TcpSocket")
 			<< "Invalid socket: " << Utility::FormatErrorNumber(error);
 
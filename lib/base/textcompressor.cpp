@@ -0,0 +1,197 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/textcompressor.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include <boost/thread/tss.hpp>
+#ifdef HAVE_ZLIB
+#	include <zlib.h>
+#endif /* HAVE_ZLIB */
+
+using namespace icinga;
+
+#ifdef HAVE_ZLIB
+/* Words which are common in plugin output. The most frequent strings are at
+ * the end because deflate encodes shorter distances more efficiently.
+ */
+static const char l_TextDictionary[] =
+	"ifOperStatus ifAdminStatus ifInOctets ifOutOctets ifInErrors ifOutErrors ifSpeed "
+	"Interface GigabitEthernet TenGigabitEthernet FastEthernet Vlan Port-channel "
+	"Mbit/s Gbit/s bytes packets errors discards in/out load average "
+	"UNKNOWN - Unknown CRITICAL - Critical WARNING - Warning OK - All "
+	"Connection refused Connection timed out No route to host Socket timeout "
+	"HTTP/1.1 200 OK - bytes in second response time PING OK - Packet loss = 0%, RTA = ms "
+	"DISK OK - free space: SWAP OK - free MB (% inode=%): used total "
+	"CPU Memory Process processes users uptime days, hours, minutes "
+	" is up is down is UP is DOWN (up) (down) status: state: OK: CRITICAL: WARNING: ";
+
+struct TextCompressorState
+{
+	z_stream Deflate;
+	z_stream Inflate;
+
+	TextCompressorState()
+	{
+		Deflate = z_stream();
+		Inflate = z_stream();
+
+		if (deflateInit2(&Deflate, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			BOOST_THROW_EXCEPTION(std::runtime_error("deflateInit2() failed."));
+
+		if (inflateInit2(&Inflate, -MAX_WBITS) != Z_OK) {
+			deflateEnd(&Deflate);
+			BOOST_THROW_EXCEPTION(std::runtime_error("inflateInit2() failed."));
+		}
+	}
+
+	~TextCompressorState()
+	{
+		deflateEnd(&Deflate);
+		inflateEnd(&Inflate);
+	}
+};
+
+static boost::thread_specific_ptr<TextCompressorState> l_TextCompressorState;
+
+static TextCompressorState& GetTextCompressorState()
+{
+	TextCompressorState *state = l_TextCompressorState.get();
+
+	if (!state) {
+		state = new TextCompressorState();
+		l_TextCompressorState.reset(state);
+	}
+
+	return *state;
+}
+
+static void ThrowZlibError(const char *function, int rc)
+{
+	BOOST_THROW_EXCEPTION(std::runtime_error(String(function) + "() failed with error code " + Convert::ToString(rc)));
+}
+#endif /* HAVE_ZLIB */
+
+/**
+ * Checks whether this build can compress texts.
+ */
+bool TextCompressor::IsSupported()
+{
+#ifdef HAVE_ZLIB
+	return true;
+#else /* HAVE_ZLIB */
+	return false;
+#endif /* HAVE_ZLIB */
+}
+
+/**
+ * Compresses a text.
+ *
+ * @param text The text.
+ * @param result Receives the compressed text.
+ * @returns false if the compressed text wouldn't be smaller than the text.
+ */
+bool TextCompressor::Compress(const String& text, std::string& result)
+{
+#ifdef HAVE_ZLIB
+	z_stream& stream = GetTextCompressorState().Deflate;
+
+	int rc = deflateReset(&stream);
+
+	if (rc != Z_OK)
+		ThrowZlibError("deflateReset", rc);
+
+	rc = deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(l_TextDictionary), sizeof(l_TextDictionary) - 1);
+
+	if (rc != Z_OK)
+		ThrowZlibError("deflateSetDictionary", rc);
+
+	/* Only keep the result if it saves at least an eighth. */
+	result.resize(text.GetLength() - text.GetLength() / 8);
+
+	if (result.empty())
+		return false;
+
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(text.CStr()));
+	stream.avail_in = text.GetLength();
+	stream.next_out = reinterpret_cast<Bytef *>(&result[0]);
+	stream.avail_out = result.size();
+
+	rc = deflate(&stream, Z_FINISH);
+
+	if (rc != Z_STREAM_END) {
+		if (rc != Z_OK && rc != Z_BUF_ERROR)
+			ThrowZlibError("deflate", rc);
+
+		return false;
+	}
+
+	result.resize(result.size() - stream.avail_out);
+	result.shrink_to_fit();
+
+	return true;
+#else /* HAVE_ZLIB */
+	(void)text;
+	(void)result;
+	return false;
+#endif /* HAVE_ZLIB */
+}
+
+/**
+ * Decompresses a text which was compressed by Compress().
+ *
+ * @param data The compressed text.
+ * @param length The length of the text.
+ * @returns The text.
+ */
+String TextCompressor::Decompress(const std::string& data, size_t length)
+{
+#ifdef HAVE_ZLIB
+	z_stream& stream = GetTextCompressorState().Inflate;
+
+	int rc = inflateReset(&stream);
+
+	if (rc != Z_OK)
+		ThrowZlibError("inflateReset", rc);
+
+	rc = inflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(l_TextDictionary), sizeof(l_TextDictionary) - 1);
+
+	if (rc != Z_OK)
+		ThrowZlibError("inflateSetDictionary", rc);
+
+	std::string result;
+	result.resize(length);
+
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.c_str()));
+	stream.avail_in = data.size();
+	stream.next_out = reinterpret_cast<Bytef *>(&result[0]);
+	stream.avail_out = result.size();
+
+	rc = inflate(&stream, Z_FINISH);
+
+	if (rc != Z_STREAM_END || stream.avail_out != 0)
+		ThrowZlibError("inflate", rc);
+
+	return result;
+#else /* HAVE_ZLIB */
+	(void)data;
+	(void)length;
+	BOOST_THROW_EXCEPTION(std::runtime_error("Text compression is not supported by this build."));
+#endif /* HAVE_ZLIB */
+}
@@ -0,0 +1,282 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/threadplacement.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <stdexcept>
+#ifdef __linux__
+#	include <linux/mempolicy.h>
+#	include <sched.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif /* __linux__ */
+
+using namespace icinga;
+
+struct NumaNode
+{
+	int ID;
+	std::vector<int> CPUs;
+};
+
+static boost::mutex l_PlacementMutex;
+static String l_Policy = "none";
+static std::atomic<int> l_Generation(0);
+static bool l_TopologyLoaded;
+static std::vector<NumaNode> l_Nodes;
+
+/**
+ * Parses a CPU list as used by sysfs and cpusets, e.g. "0-3,8-11".
+ *
+ * @param list The CPU list.
+ * @returns The CPU numbers in ascending order.
+ */
+std::vector<int> ThreadPlacement::ParseCPUList(const String& list)
+{
+	std::vector<int> cpus;
+	std::vector<String> ranges = list.Trim().Split(",");
+
+	for (const String& range : ranges) {
+		String trimmed = range.Trim();
+
+		if (trimmed.IsEmpty())
+			continue;
+
+		size_t dash = trimmed.Find("-");
+		int first, last;
+
+		try {
+			if (dash == String::NPos) {
+				first = last = Convert::ToLong(trimmed);
+			} else {
+				first = Convert::ToLong(trimmed.SubStr(0, dash));
+				last = Convert::ToLong(trimmed.SubStr(dash + 1));
+			}
+		} catch (const std::exception&) {
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid CPU list: '" + list + "'"));
+		}
+
+		if (first < 0 || last < first)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid CPU list: '" + list + "'"));
+
+		for (int cpu = first; cpu <= last; cpu++)
+			cpus.push_back(cpu);
+	}
+
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+
+	return cpus;
+}
+
+/* Must be called with l_PlacementMutex held, before any thread is pinned:
+ * the process' affinity mask is taken from the calling thread. */
+static void LoadTopology()
+{
+	if (l_TopologyLoaded)
+		return;
+
+	l_TopologyLoaded = true;
+
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		Log(LogWarning, "ThreadPlacement")
+			<< "sched_getaffinity() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		return;
+	}
+
+	Utility::Glob("/sys/devices/system/node/node*", [&allowed](const String& path) {
+		String name = Utility::BaseName(path);
+		NumaNode node;
+
+		try {
+			node.ID = Convert::ToLong(name.SubStr(4));
+		} catch (const std::exception&) {
+			return;
+		}
+
+		std::ifstream fp(path + "/cpulist");
+		std::string list;
+
+		if (!std::getline(fp, list))
+			return;
+
+		try {
+			for (int cpu : ThreadPlacement::ParseCPUList(list)) {
+				if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+					node.CPUs.push_back(cpu);
+			}
+		} catch (const std::exception&) {
+			return;
+		}
+
+		if (!node.CPUs.empty())
+			l_Nodes.push_back(node);
+	}, GlobDirectory);
+
+	std::sort(l_Nodes.begin(), l_Nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.ID < b.ID; });
+
+	/* No NUMA information (e.g. in containers without /sys): treat all CPUs as one node. */
+	if (l_Nodes.empty()) {
+		NumaNode node;
+		node.ID = -1;
+
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &allowed))
+				node.CPUs.push_back(cpu);
+		}
+
+		if (!node.CPUs.empty())
+			l_Nodes.push_back(node);
+	}
+#endif /* __linux__ */
+}
+
+bool ThreadPlacement::IsValidPolicy(const String& policy)
+{
+	return policy == "none" || policy == "numa";
+}
+
+/**
+ * Sets the placement policy. Threads re-apply their placement when they
+ * notice that the generation has changed.
+ *
+ * @param policy "none" or "numa".
+ */
+void ThreadPlacement::SetPolicy(const String& policy)
+{
+	if (!IsValidPolicy(policy))
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid thread placement policy: '" + policy + "'"));
+
+	boost::mutex::scoped_lock lock(l_PlacementMutex);
+
+	if (policy == l_Policy)
+		return;
+
+	LoadTopology();
+
+	l_Policy = policy;
+	l_Generation++;
+
+	if (policy == "numa") {
+		Log(LogInformation, "ThreadPlacement")
+			<< "Placing threads on " << l_Nodes.size() << " NUMA node(s).";
+	}
+}
+
+String ThreadPlacement::GetPolicy()
+{
+	boost::mutex::scoped_lock lock(l_PlacementMutex);
+	return l_Policy;
+}
+
+int ThreadPlacement::GetGeneration()
+{
+	return l_Generation.load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns the number of NUMA nodes threads are placed on, or 0 if threads are
+ * not placed.
+ */
+int ThreadPlacement::GetNodeCount()
+{
+	boost::mutex::scoped_lock lock(l_PlacementMutex);
+
+	if (l_Policy == "none")
+		return 0;
+
+	return l_Nodes.size();
+}
+
+/**
+ * Places the calling thread according to the current policy.
+ *
+ * @param index The index of the thread within its group of threads.
+ * @returns The node the thread was placed on (0 to GetNodeCount() - 1), or -1
+ *          if the thread was not placed.
+ */
+int ThreadPlacement::PlaceThread(int index)
+{
+#ifdef __linux__
+	boost::mutex::scoped_lock lock(l_PlacementMutex);
+
+	if (l_Policy == "none") {
+		/* The policy was reset: allow all CPUs again. */
+		if (l_TopologyLoaded && !l_Nodes.empty()) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+
+			for (const NumaNode& node : l_Nodes) {
+				for (int cpu : node.CPUs)
+					CPU_SET(cpu, &cpus);
+			}
+
+			(void) sched_setaffinity(0, sizeof(cpus), &cpus);
+			(void) syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+		}
+
+		return -1;
+	}
+
+	if (l_Nodes.empty())
+		return -1;
+
+	int nodeIndex = static_cast<unsigned int>(index) % l_Nodes.size();
+	const NumaNode& node = l_Nodes[nodeIndex];
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+
+	for (int cpu : node.CPUs)
+		CPU_SET(cpu, &cpus);
+
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+		Log(LogWarning, "ThreadPlacement")
+			<< "sched_setaffinity() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		return -1;
+	}
+
+	/* Prefer memory from the thread's own node. Allocations fall back to other
+	 * nodes when the node is out of memory. */
+	if (node.ID >= 0 && l_Nodes.size() > 1) {
+		const size_t bits = sizeof(unsigned long) * 8;
+		std::vector<unsigned long> mask(node.ID / bits + 1, 0);
+		mask[node.ID / bits] |= 1UL << (node.ID % bits);
+
+		if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask[0], mask.size() * bits + 1) < 0) {
+			Log(LogNotice, "ThreadPlacement")
+				<< "set_mempolicy() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		}
+	}
+
+	return nodeIndex;
+#else /* __linux__ */
+	return -1;
+#endif /* __linux__ */
+}
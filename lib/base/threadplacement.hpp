@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Places long-running threads on the NUMA nodes of the machine.
+ *
+ * With the "numa" policy each thread is pinned to the CPUs of one NUMA node,
+ * chosen round-robin by the index of the thread within its group (e.g. the
+ * socket I/O threads, the thread pool workers or the checker shards), and the
+ * kernel is asked to allocate the thread's memory from that node. Only the
+ * CPUs which are in the process' affinity mask are used, so cgroup cpusets
+ * and taskset are respected.
+ *
+ * Thread placement is only supported on Linux. It is a no-op elsewhere.
+ *
+ * @ingroup base
+ */
+class ThreadPlacement
+{
+public:
+	static void SetPolicy(const String& policy);
+	static String GetPolicy();
+	static bool IsValidPolicy(const String& policy);
+
+	static int GetGeneration();
+	static int GetNodeCount();
+
+	static int PlaceThread(int index);
+
+	static std::vector<int> ParseCPUList(const String& list);
+
+private:
+	ThreadPlacement();
+};
+
+}
+
+#endif /* THREADPLACEMENT_H */
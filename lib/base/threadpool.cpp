@@ -23,17 +23,39 @@
 #include "base/utility.hpp"
 #include "base/exception.hpp"
 #include "base/application.hpp"
+#include "base/threadplacement.hpp"
 #include <iostream>
 
 using namespace icinga;
 
 int ThreadPool::m_NextID = 1;
 
+boost::thread_specific_ptr<ThreadPool::WorkerThread> ThreadPool::m_CurrentWorker;
+
 ThreadPool::ThreadPool(size_t max_threads)
 	: m_ID(m_NextID++), m_MaxThreads(max_threads)
 {
-	if (m_MaxThreads != UINT_MAX && m_MaxThreads < sizeof(m_Queues) / sizeof(m_Queues[0]))
-		m_MaxThreads = sizeof(m_Queues) / sizeof(m_Queues[0]);
+	size_t concurrency = std::thread::hardware_concurrency();
+
+	if (concurrency < 4)
+		concurrency = 4;
+
+	/* Without an explicit limit we allow the pool to grow to a multiple of
+	 * the number of CPUs so that blocking work items don't starve the pool. */
+	if (m_MaxThreads == UINT_MAX)
+		m_MaxThreads = std::max<size_t>(64, concurrency * 4);
+
+	if (m_MaxThreads < 4)
+		m_MaxThreads = 4;
+
+	m_MinThreads = std::min(concurrency, m_MaxThreads);
+
+	m_Threads.reset(new WorkerThread[m_MaxThreads]);
+
+	for (size_t i = 0; i < m_MaxThreads; i++) {
+		m_Threads[i].Pool = this;
+		m_Threads[i].Index = i;
+	}
 
 	Start();
 }
@@ -41,6 +63,11 @@ ThreadPool::ThreadPool(size_t max_threads)
 ThreadPool::~ThreadPool()
 {
 	Stop();
+
+	for (size_t i = 0; i < m_MaxThreads; i++) {
+		for (WorkItem *wi : m_Threads[i].Inbox)
+			delete wi;
+	}
 }
 
 void ThreadPool::Start()
@@ -49,9 +76,14 @@ void ThreadPool::Start()
 		return;
 
 	m_Stopped = false;
+	m_Stopping = false;
+
+	{
+		boost::mutex::scoped_lock lock(m_MgmtMutex);
 
-	for (auto& queue : m_Queues)
-		queue.SpawnWorker(m_ThreadGroup);
+		for (size_t i = 0; i < m_MinThreads; i++)
+			SpawnWorker();
+	}
 
 	m_MgmtThread = std::thread(std::bind(&ThreadPool::ManagerThreadProc, this));
 }
@@ -70,55 +102,242 @@ void ThreadPool::Stop()
 	if (m_MgmtThread.joinable())
 		m_MgmtThread.join();
 
-	for (auto& queue : m_Queues) {
-		boost::mutex::scoped_lock lock(queue.Mutex);
-		queue.Stopped = true;
-		queue.CV.notify_all();
-	}
+	m_Stopping = true;
+	WakeUpWorkers(true);
 
 	m_ThreadGroup.join_all();
 	m_ThreadGroup.~thread_group();
 	new (&m_ThreadGroup) boost::thread_group();
 
-	for (auto& queue : m_Queues)
-		queue.Stopped = false;
-
+	m_Stopping = false;
 	m_Stopped = true;
 }
 
+ThreadPool::WorkStealingDeque::Buffer::Buffer(int64_t size)
+	: Size(size), Items(new std::atomic<WorkItem *>[size])
+{ }
+
+ThreadPool::WorkItem *ThreadPool::WorkStealingDeque::Buffer::Get(int64_t index) const
+{
+	return Items[index & (Size - 1)].load(std::memory_order_relaxed);
+}
+
+void ThreadPool::WorkStealingDeque::Buffer::Put(int64_t index, WorkItem *item)
+{
+	Items[index & (Size - 1)].store(item, std::memory_order_relaxed);
+}
+
+ThreadPool::WorkStealingDeque::WorkStealingDeque()
+	: m_Buffer(new Buffer(64))
+{ }
+
+ThreadPool::WorkStealingDeque::~WorkStealingDeque()
+{
+	while (WorkItem *item = Pop())
+		delete item;
+
+	delete m_Buffer.load();
+
+	for (Buffer *buffer : m_OldBuffers)
+		delete buffer;
+}
+
+void ThreadPool::WorkStealingDeque::Push(WorkItem *item)
+{
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	Buffer *buffer = m_Buffer.load(std::memory_order_relaxed);
+
+	if (bottom - top > buffer->Size - 1) {
+		Buffer *newBuffer = new Buffer(buffer->Size * 2);
+
+		for (int64_t i = top; i < bottom; i++)
+			newBuffer->Put(i, buffer->Get(i));
+
+		m_OldBuffers.push_back(buffer);
+		m_Buffer.store(newBuffer, std::memory_order_release);
+		buffer = newBuffer;
+	}
+
+	buffer->Put(bottom, item);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+ThreadPool::WorkItem *ThreadPool::WorkStealingDeque::Pop()
+{
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	Buffer *buffer = m_Buffer.load(std::memory_order_relaxed);
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_Top.load(std::memory_order_relaxed);
+
+	if (top > bottom) {
+		/* The deque is empty. */
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	WorkItem *item = buffer->Get(bottom);
+
+	if (top == bottom) {
+		/* This is the last item, we're racing against thieves for it. */
+		if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			item = nullptr;
+
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return item;
+}
+
+ThreadPool::WorkItem *ThreadPool::WorkStealingDeque::Steal()
+{
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+		return nullptr;
+
+	Buffer *buffer = m_Buffer.load(std::memory_order_acquire);
+	WorkItem *item = buffer->Get(top);
+
+	/* Another thief or the owner got there first. */
+	if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+
+	return item;
+}
+
+bool ThreadPool::WorkStealingDeque::IsEmpty() const
+{
+	return m_Top.load(std::memory_order_relaxed) >= m_Bottom.load(std::memory_order_relaxed);
+}
+
+/**
+ * Retrieves the next work item for the specified worker: first from its own
+ * deque, then from its inbox and finally by stealing from other workers.
+ */
+ThreadPool::WorkItem *ThreadPool::TakeWork(WorkerThread& worker)
+{
+	WorkItem *item = worker.Local.Pop();
+
+	if (item)
+		return item;
+
+	size_t count = m_HighWater.load();
+	size_t offset = Utility::Random();
+	int node = worker.Node.load(std::memory_order_relaxed);
+
+	/* Workers which are placed on a NUMA node look for work on their own node first. */
+	for (int pass = (node >= 0) ? 0 : 1; pass < 2; pass++) {
+		for (size_t i = 0; i < count; i++) {
+			/* Start with our own inbox, then visit the others in random order. */
+			WorkerThread& victim = m_Threads[i == 0 ? worker.Index : (worker.Index + offset + i) % count];
+
+			if (node >= 0 && (victim.Node.load(std::memory_order_relaxed) == node) != (pass == 0))
+				continue;
+
+			if (victim.InboxSize.load() > 0) {
+				ProfiledMutex::scoped_lock lock(victim.InboxMutex);
+
+				if (!victim.Inbox.empty()) {
+					item = victim.Inbox.front();
+					victim.Inbox.pop_front();
+					victim.InboxSize--;
+					return item;
+				}
+			}
+
+			if (&victim != &worker) {
+				item = victim.Local.Steal();
+
+				if (item)
+					return item;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * Puts the worker to sleep until new work items are posted.
+ */
+void ThreadPool::Park(WorkerThread& worker)
+{
+	{
+		ProfiledMutex::scoped_lock lock(worker.Mutex);
+		worker.UpdateUtilization(ThreadIdle);
+	}
+
+	boost::mutex::scoped_lock lock(m_ParkMutex);
+
+	m_Sleepers++;
+
+	while (m_Pending.load() == 0 && !worker.Zombie && !m_Stopping)
+		m_ParkCV.wait(lock);
+
+	m_Sleepers--;
+}
+
+void ThreadPool::WakeUpWorkers(bool all)
+{
+	boost::mutex::scoped_lock lock(m_ParkMutex);
+
+	if (all)
+		m_ParkCV.notify_all();
+	else
+		m_ParkCV.notify_one();
+}
+
 /**
  * Waits for work items and processes them.
  */
-void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
+void ThreadPool::WorkerThread::ThreadProc()
 {
 	std::ostringstream idbuf;
-	idbuf << "Q #" << &queue << " W #" << this;
+	idbuf << "TP #" << Pool->m_ID << " W #" << Index;
 	Utility::SetThreadName(idbuf.str());
 
-	for (;;) {
-		WorkItem wi;
+	m_CurrentWorker.reset(this);
 
-		{
-			boost::mutex::scoped_lock lock(queue.Mutex);
+	int placementGeneration = -1;
 
-			UpdateUtilization(ThreadIdle);
+	for (;;) {
+		WorkItem *wi;
 
-			while (queue.Items.empty() && !queue.Stopped && !Zombie) {
-				if (queue.Items.empty())
-					queue.CVStarved.notify_all();
+		int generation = ThreadPlacement::GetGeneration();
 
-				queue.CV.wait(lock);
-			}
+		if (generation != placementGeneration) {
+			placementGeneration = generation;
+			Node.store(ThreadPlacement::PlaceThread(Index), std::memory_order_relaxed);
+		}
 
-			if (Zombie)
-				break;
+		if (Zombie) {
+			/* Finish the work items which were posted from this thread before exiting. */
+			wi = Local.Pop();
 
-			if (queue.Items.empty() && queue.Stopped)
+			if (!wi)
 				break;
+		} else {
+			wi = Pool->TakeWork(*this);
+
+			if (!wi) {
+				if (Pool->m_Stopping && Pool->m_Pending.load() == 0)
+					break;
+
+				Pool->Park(*this);
+
+				continue;
+			}
+		}
 
-			wi = queue.Items.front();
-			queue.Items.pop_front();
+		Pool->m_Pending--;
 
+		{
+			ProfiledMutex::scoped_lock lock(Mutex);
 			UpdateUtilization(ThreadBusy);
 		}
 
@@ -133,8 +352,8 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
 #endif /* I2_DEBUG */
 
 		try {
-			if (wi.Callback)
-				wi.Callback();
+			if (wi->Callback)
+				wi->Callback();
 		} catch (const std::exception& ex) {
 			Log(LogCritical, "ThreadPool")
 				<< "Exception thrown in event handler:\n"
@@ -144,14 +363,16 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
 		}
 
 		double et = Utility::GetTime();
-		double latency = st - wi.Timestamp;
+		double latency = st - wi->Timestamp;
+
+		delete wi;
 
 		{
-			boost::mutex::scoped_lock lock(queue.Mutex);
+			ProfiledMutex::scoped_lock lock(Mutex);
 
-			queue.WaitTime += latency;
-			queue.ServiceTime += et - st;
-			queue.TaskCount++;
+			WaitTime += latency;
+			ServiceTime += et - st;
+			TaskCount++;
 		}
 
 #ifdef I2_DEBUG
@@ -183,13 +404,18 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
 #endif /* I2_DEBUG */
 	}
 
-	boost::mutex::scoped_lock lock(queue.Mutex);
+	m_CurrentWorker.release();
+
+	ProfiledMutex::scoped_lock lock(Mutex);
 	UpdateUtilization(ThreadDead);
 	Zombie = false;
+	Node.store(-1, std::memory_order_relaxed);
 }
 
 /**
- * Appends a work item to the work queue. Work items will be processed in FIFO order.
+ * Appends a work item to the work queue. Work items which are posted from
+ * one of the pool's worker threads are put into that worker's own deque,
+ * all other work items are distributed across the workers' inboxes.
  *
  * @param callback The callback function for the work item.
  * @param policy The scheduling policy
@@ -197,25 +423,36 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
  */
 bool ThreadPool::Post(const ThreadPool::WorkFunction& callback, SchedulerPolicy policy)
 {
-	WorkItem wi;
-	wi.Callback = callback;
-	wi.Timestamp = Utility::GetTime();
+	if (m_Stopping)
+		return false;
 
-	Queue& queue = m_Queues[Utility::Random() % (sizeof(m_Queues) / sizeof(m_Queues[0]))];
+	if (policy == LowLatencyScheduler) {
+		boost::mutex::scoped_lock lock(m_MgmtMutex);
+		SpawnWorker();
+	}
 
-	{
-		boost::mutex::scoped_lock lock(queue.Mutex);
+	WorkItem *wi = new WorkItem();
+	wi->Callback = callback;
+	wi->Timestamp = Utility::GetTime();
 
-		if (queue.Stopped)
-			return false;
+	WorkerThread *current = m_CurrentWorker.get();
 
-		if (policy == LowLatencyScheduler)
-			queue.SpawnWorker(m_ThreadGroup);
+	if (current && current->Pool == this && !current->Zombie)
+		current->Local.Push(wi);
+	else {
+		size_t count = m_HighWater.load();
+		WorkerThread& worker = m_Threads[count > 0 ? m_NextInbox++ % count : 0];
 
-		queue.Items.emplace_back(std::move(wi));
-		queue.CV.notify_one();
+		ProfiledMutex::scoped_lock lock(worker.InboxMutex);
+		worker.Inbox.push_back(wi);
+		worker.InboxSize++;
 	}
 
+	m_Pending++;
+
+	if (m_Sleepers.load() > 0)
+		WakeUpWorkers(false);
+
 	return true;
 }
 
@@ -228,86 +465,83 @@ void ThreadPool::ManagerThreadProc()
 	double lastStats = 0;
 
 	for (;;) {
-		size_t total_pending = 0, total_alive = 0;
-		double total_avg_latency = 0;
-		double total_utilization = 0;
+		size_t pending, alive = 0;
+		double wait_time = 0;
+		int task_count = 0;
+		double utilization = 0;
 
-		{
-			boost::mutex::scoped_lock lock(m_MgmtMutex);
+		boost::mutex::scoped_lock lock(m_MgmtMutex);
 
-			if (!m_Stopped)
-				m_MgmtCV.timed_wait(lock, boost::posix_time::milliseconds(500));
+		if (!m_Stopped)
+			m_MgmtCV.timed_wait(lock, boost::posix_time::milliseconds(500));
 
-			if (m_Stopped)
-				break;
-		}
+		if (m_Stopped)
+			break;
 
-		for (auto& queue : m_Queues) {
-			size_t pending, alive = 0;
-			double avg_latency;
-			double utilization = 0;
+		size_t count = m_HighWater.load();
 
-				boost::mutex::scoped_lock lock(queue.Mutex);
+		for (size_t i = 0; i < count; i++) {
+			WorkerThread& thread = m_Threads[i];
 
-			for (auto& thread : queue.Threads)
-				thread.UpdateUtilization();
+			ProfiledMutex::scoped_lock tlock(thread.Mutex);
 
-			pending = queue.Items.size();
+			thread.UpdateUtilization();
 
-			for (auto& thread : queue.Threads) {
-				if (thread.State != ThreadDead && !thread.Zombie) {
-					alive++;
-					utilization += thread.Utilization * 100;
-				}
+			if (thread.State != ThreadDead && !thread.Zombie) {
+				alive++;
+				utilization += thread.Utilization * 100;
 			}
 
-			utilization /= alive;
+			wait_time += thread.WaitTime;
+			task_count += thread.TaskCount;
 
-			if (queue.TaskCount > 0)
-				avg_latency = queue.WaitTime / (queue.TaskCount * 1.0);
-			else
-				avg_latency = 0;
+			thread.WaitTime = 0;
+			thread.ServiceTime = 0;
+			thread.TaskCount = 0;
+		}
 
-			if (utilization < 60 || utilization > 80 || alive < 8) {
-				double wthreads = std::ceil((utilization * alive) / 80.0);
+		pending = std::max(m_Pending.load(), 0);
 
-				int tthreads = wthreads - alive;
+		if (alive > 0)
+			utilization /= alive;
 
-				/* Make sure there is at least one thread per queue */
-				if (alive + tthreads < 1)
-					tthreads = 1 - alive;
+		double avg_latency;
 
-				/* Don't kill more than 2 threads at once. */
-				if (tthreads < -2)
-					tthreads = -2;
+		if (task_count > 0)
+			avg_latency = wait_time / (task_count * 1.0);
+		else
+			avg_latency = 0;
 
-				/* Spawn more workers if there are outstanding work items. */
-				if (tthreads > 0 && pending > 0)
-					tthreads = 2;
+		if (utilization < 60 || utilization > 80 || alive < m_MinThreads) {
+			double wthreads = std::ceil((utilization * alive) / 80.0);
 
-				if (m_MaxThreads != UINT_MAX && (alive + tthreads) * (sizeof(m_Queues) / sizeof(m_Queues[0])) > m_MaxThreads)
-					tthreads = m_MaxThreads / (sizeof(m_Queues) / sizeof(m_Queues[0])) - alive;
+			int tthreads = wthreads - alive;
 
-				if (tthreads != 0) {
-					Log(LogNotice, "ThreadPool")
-						<< "Thread pool; current: " << alive << "; adjustment: " << tthreads;
-				}
+			/* Make sure we don't go below the minimum number of threads. */
+			if (static_cast<int>(alive) + tthreads < static_cast<int>(m_MinThreads))
+				tthreads = m_MinThreads - alive;
+
+			/* Don't kill more than 8 threads at once. */
+			if (tthreads < -8)
+				tthreads = -8;
+
+			/* Spawn more workers if there are outstanding work items. */
+			if (tthreads > 0 && pending > 0)
+				tthreads = 8;
 
-				for (int i = 0; i < -tthreads; i++)
-					queue.KillWorker(m_ThreadGroup);
+			if (static_cast<int>(alive) + tthreads > static_cast<int>(m_MaxThreads))
+				tthreads = m_MaxThreads - alive;
 
-				for (int i = 0; i < tthreads; i++)
-					queue.SpawnWorker(m_ThreadGroup);
+			if (tthreads != 0) {
+				Log(LogNotice, "ThreadPool")
+					<< "Thread pool; current: " << alive << "; adjustment: " << tthreads;
 			}
 
-			queue.WaitTime = 0;
-			queue.ServiceTime = 0;
-			queue.TaskCount = 0;
+			for (int i = 0; i < -tthreads; i++)
+				KillWorker();
 
-			total_pending += pending;
-			total_alive += alive;
-			total_avg_latency += avg_latency;
-			total_utilization += utilization;
+			for (int i = 0; i < tthreads; i++)
+				SpawnWorker();
 		}
 
 		double now = Utility::GetTime();
@@ -316,54 +550,76 @@ void ThreadPool::ManagerThreadProc()
 			lastStats = now;
 
 			Log(LogNotice, "ThreadPool")
-				<< "Pool #" << m_ID << ": Pending tasks: " << total_pending << "; Average latency: "
-				<< (long)(total_avg_latency * 1000 / (sizeof(m_Queues) / sizeof(m_Queues[0]))) << "ms"
-				<< "; Threads: " << total_alive
-				<< "; Pool utilization: " << (total_utilization / (sizeof(m_Queues) / sizeof(m_Queues[0]))) << "%";
+				<< "Pool #" << m_ID << ": Pending tasks: " << pending << "; Average latency: "
+				<< (long)(avg_latency * 1000) << "ms"
+				<< "; Threads: " << alive
+				<< "; Pool utilization: " << utilization << "%";
 		}
 	}
 }
 
 /**
- * Note: Caller must hold m_Mutex
+ * Note: Caller must hold m_MgmtMutex.
  */
-void ThreadPool::Queue::SpawnWorker(boost::thread_group& group)
+bool ThreadPool::SpawnWorker()
 {
-	for (auto& thread : Threads) {
+	for (size_t i = 0; i < m_MaxThreads; i++) {
+		WorkerThread& thread = m_Threads[i];
+
+		ProfiledMutex::scoped_lock lock(thread.Mutex);
+
 		if (thread.State == ThreadDead) {
 			Log(LogDebug, "ThreadPool", "Spawning worker thread.");
 
-			thread = WorkerThread(ThreadIdle);
-			thread.Thread = group.create_thread(std::bind(&ThreadPool::WorkerThread::ThreadProc, std::ref(thread), std::ref(*this)));
+			thread.State = ThreadIdle;
+			thread.Zombie = false;
+			thread.Utilization = 0;
+			thread.LastUpdate = 0;
 
-			break;
+			if (m_HighWater.load() < i + 1)
+				m_HighWater = i + 1;
+
+			thread.Thread = m_ThreadGroup.create_thread(std::bind(&ThreadPool::WorkerThread::ThreadProc, std::ref(thread)));
+
+			return true;
 		}
 	}
+
+	return false;
 }
 
 /**
- * Note: Caller must hold Mutex.
+ * Note: Caller must hold m_MgmtMutex.
  */
-void ThreadPool::Queue::KillWorker(boost::thread_group& group)
+bool ThreadPool::KillWorker()
 {
-	for (auto& thread : Threads) {
+	for (size_t i = m_HighWater.load(); i > 0; i--) {
+		WorkerThread& thread = m_Threads[i - 1];
+
+		ProfiledMutex::scoped_lock lock(thread.Mutex);
+
 		if (thread.State == ThreadIdle && !thread.Zombie) {
 			Log(LogDebug, "ThreadPool", "Killing worker thread.");
 
-			group.remove_thread(thread.Thread);
+			m_ThreadGroup.remove_thread(thread.Thread);
 			thread.Thread->detach();
 			delete thread.Thread;
 
 			thread.Zombie = true;
-			CV.notify_all();
 
-			break;
+			lock.unlock();
+
+			WakeUpWorkers(true);
+
+			return true;
 		}
 	}
+
+	return false;
 }
 
 /**
- * Note: Caller must hold queue Mutex.
+ * Note: Caller must hold the worker's Mutex.
  */
 void ThreadPool::WorkerThread::UpdateUtilization(ThreadState state)
 {
@@ -21,17 +21,20 @@
 #define THREADPOOL_H
 
 #include "base/i2-base.hpp"
+#include "base/profiledmutex.hpp"
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+#include <atomic>
 #include <deque>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace icinga
 {
 
-#define QUEUECOUNT 4U
-
 enum SchedulerPolicy
 {
 	DefaultScheduler,
@@ -39,7 +42,11 @@ enum SchedulerPolicy
 };
 
 /**
- * A thread pool.
+ * A work-stealing thread pool.
+ *
+ * Each worker thread has its own lock-free deque for work items which are
+ * posted from inside the pool and a mutex-guarded inbox for work items which
+ * are posted by other threads. Idle workers steal work from random victims.
  *
  * @ingroup base
  */
@@ -71,49 +78,77 @@ private:
 		double Timestamp;
 	};
 
-	struct Queue;
-
-	struct WorkerThread
+	/**
+	 * A Chase-Lev work-stealing deque. Only the owning worker may call
+	 * Push() and Pop(), any thread may call Steal().
+	 */
+	class WorkStealingDeque
 	{
-		ThreadState State{ThreadDead};
-		bool Zombie{false};
-		double Utilization{0};
-		double LastUpdate{0};
-		boost::thread *Thread{nullptr};
+	public:
+		WorkStealingDeque();
+		~WorkStealingDeque();
 
-		WorkerThread(ThreadState state = ThreadDead)
-			: State(state)
-		{ }
+		void Push(WorkItem *item);
+		WorkItem *Pop();
+		WorkItem *Steal();
 
-		void UpdateUtilization(ThreadState state = ThreadUnspecified);
+		bool IsEmpty() const;
+
+	private:
+		struct Buffer
+		{
+			int64_t Size;
+			std::unique_ptr<std::atomic<WorkItem *>[]> Items;
+
+			Buffer(int64_t size);
+
+			WorkItem *Get(int64_t index) const;
+			void Put(int64_t index, WorkItem *item);
+		};
 
-		void ThreadProc(Queue& queue);
+		std::atomic<int64_t> m_Top{0};
+		std::atomic<int64_t> m_Bottom{0};
+		std::atomic<Buffer *> m_Buffer;
+
+		/* Buffers which were replaced when growing the deque. Thieves might
+		 * still be reading from them so they're only freed when the deque
+		 * is destroyed. */
+		std::vector<Buffer *> m_OldBuffers;
 	};
 
-	struct Queue
+	struct WorkerThread
 	{
-		boost::mutex Mutex;
-		boost::condition_variable CV;
-		boost::condition_variable CVStarved;
+		ThreadPool *Pool{nullptr};
+		size_t Index{0};
 
-		std::deque<WorkItem> Items;
+		ProfiledMutex Mutex{"ThreadPool worker"};
+		ThreadState State{ThreadDead};
+		std::atomic<bool> Zombie{false};
+		double Utilization{0};
+		double LastUpdate{0};
+		boost::thread *Thread{nullptr};
+		std::atomic<int> Node{-1};
 
 		double WaitTime{0};
 		double ServiceTime{0};
 		int TaskCount{0};
 
-		bool Stopped{false};
+		WorkStealingDeque Local;
 
-		WorkerThread Threads[16];
+		ProfiledMutex InboxMutex{"ThreadPool inbox"};
+		std::deque<WorkItem *> Inbox;
+		std::atomic<size_t> InboxSize{0};
 
-		void SpawnWorker(boost::thread_group& group);
-		void KillWorker(boost::thread_group& group);
+		void UpdateUtilization(ThreadState state = ThreadUnspecified);
+
+		void ThreadProc();
 	};
 
 	int m_ID;
 	static int m_NextID;
 
 	size_t m_MaxThreads;
+	size_t m_MinThreads;
 
 	boost::thread_group m_ThreadGroup;
 
@@ -122,11 +157,28 @@ private:
 	boost::condition_variable m_MgmtCV;
 	bool m_Stopped{true};
 
-	Queue m_Queues[QUEUECOUNT];
+	std::unique_ptr<WorkerThread[]> m_Threads;
+	std::atomic<size_t> m_HighWater{0};
+	std::atomic<size_t> m_NextInbox{0};
+	std::atomic<bool> m_Stopping{false};
+	std::atomic<int> m_Pending{0};
+
+	boost::mutex m_ParkMutex;
+	boost::condition_variable m_ParkCV;
+	std::atomic<int> m_Sleepers{0};
+
+	static boost::thread_specific_ptr<WorkerThread> m_CurrentWorker;
+
+	WorkItem *TakeWork(WorkerThread& worker);
+	void Park(WorkerThread& worker);
+	void WakeUpWorkers(bool all);
+
+	bool SpawnWorker();
+	bool KillWorker();
 
 	void ManagerThreadProc();
 };
 
 }
 
-#endif /* EVENTQUEUE_H */
+#endif /* THREADPOOL_H */
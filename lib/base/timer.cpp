@@ -21,11 +21,16 @@
 #include "base/debug.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
-#include <boost/thread/mutex.hpp>
+#include "base/scriptglobal.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include "base/profiledmutex.hpp"
 #include <boost/thread/condition_variable.hpp>
+#include <boost/thread/once.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/key_extractors.hpp>
+#include <map>
 #include <thread>
 
 using namespace icinga;
@@ -57,7 +62,36 @@ private:
 	Timer *m_Timer;
 };
 
-}
+/**
+ * Storage for the timers which are currently scheduled. All methods
+ * must be called while holding l_TimerMutex.
+ *
+ * @ingroup base
+ */
+class TimerEngine
+{
+public:
+	virtual ~TimerEngine() = default;
+
+	virtual String GetName() const = 0;
+
+	virtual void Insert(Timer *timer) = 0;
+	virtual void Erase(Timer *timer) = 0;
+
+	virtual bool IsEmpty() const = 0;
+	virtual size_t GetLength() const = 0;
+
+	/* Returns a timer which is due at the specified time and removes it. */
+	virtual Timer *PopExpired(double now) = 0;
+
+	/* Returns the time when the timer thread should look for expired timers again. */
+	virtual double GetNextWakeup(double now) = 0;
+
+	virtual void GetTimers(std::vector<Timer *>& timers) const = 0;
+
+	/* Called after the system clock has jumped. */
+	virtual void Rebase(double now) = 0;
+};
 
 typedef boost::multi_index_container<
 	TimerHolder,
@@ -67,12 +101,427 @@ typedef boost::multi_index_container<
 	>
 > TimerSet;
 
-static boost::mutex l_TimerMutex;
-static boost::condition_variable l_TimerCV;
+/**
+ * Timer engine which keeps the timers in a set that is ordered by their
+ * next scheduled timestamp.
+ *
+ * @ingroup base
+ */
+class TimerEngineSet final : public TimerEngine
+{
+public:
+	String GetName() const override
+	{
+		return "set";
+	}
+
+	void Insert(Timer *timer) override
+	{
+		m_Timers.insert(timer);
+	}
+
+	void Erase(Timer *timer) override
+	{
+		m_Timers.erase(timer);
+	}
+
+	bool IsEmpty() const override
+	{
+		return m_Timers.empty();
+	}
+
+	size_t GetLength() const override
+	{
+		return m_Timers.size();
+	}
+
+	Timer *PopExpired(double now) override
+	{
+		NextTimerView& idx = boost::get<1>(m_Timers);
+
+		if (idx.empty())
+			return nullptr;
+
+		Timer *timer = *idx.begin();
+
+		if (timer->m_Next - now > 0.01)
+			return nullptr;
+
+		m_Timers.erase(timer);
+
+		return timer;
+	}
+
+	double GetNextWakeup(double now) override
+	{
+		NextTimerView& idx = boost::get<1>(m_Timers);
+
+		if (idx.empty())
+			return now;
+
+		return (*idx.begin()).GetNextUnlocked();
+	}
+
+	void GetTimers(std::vector<Timer *>& timers) const override
+	{
+		for (Timer *timer : boost::get<1>(m_Timers))
+			timers.push_back(timer);
+	}
+
+	void Rebase(double) override
+	{ }
+
+private:
+	typedef boost::multi_index::nth_index<TimerSet, 1>::type NextTimerView;
+
+	TimerSet m_Timers;
+};
+
+/**
+ * Timer engine based on a hierarchical timer wheel. Inserting, removing
+ * and rescheduling timers are O(1) operations.
+ *
+ * The first level has one slot per tick. Timers which are further in the
+ * future are stored in coarser slots on the upper levels and are moved
+ * down ("cascaded") whenever the lower level wraps around.
+ *
+ * @ingroup base
+ */
+class TimerEngineWheel final : public TimerEngine
+{
+public:
+	TimerEngineWheel()
+		: m_CurrentTick(GetTick(Utility::GetTime()))
+	{
+		std::fill(std::begin(m_Slots), std::end(m_Slots), nullptr);
+		std::fill(std::begin(m_RootBitmap), std::end(m_RootBitmap), 0);
+	}
+
+	String GetName() const override
+	{
+		return "wheel";
+	}
+
+	void Insert(Timer *timer) override
+	{
+		uint64_t tick = GetTick(timer->m_Next);
+
+		if (tick < m_CurrentTick)
+			tick = m_CurrentTick;
+
+		uint64_t delta = tick - m_CurrentTick;
+		int slot;
+
+		if (delta < RootSize)
+			slot = tick & RootMask;
+		else {
+			int level = 1;
+
+			for (; level < LevelCount - 1; level++) {
+				if (delta < (uint64_t(1) << (RootBits + level * LevelBits)))
+					break;
+			}
+
+			/* Timers which are too far in the future are parked in the
+			 * last slot of the top level and cascaded again later on. */
+			if (delta >= (uint64_t(1) << (RootBits + level * LevelBits)))
+				tick = m_CurrentTick + (uint64_t(1) << (RootBits + level * LevelBits)) - 1;
+
+			slot = RootSize + (level - 1) * LevelSize + ((tick >> (RootBits + (level - 1) * LevelBits)) & LevelMask);
+		}
+
+		Link(timer, slot);
+	}
+
+	void Erase(Timer *timer) override
+	{
+		if (timer->m_WheelSlot == -1)
+			return;
+
+		int slot = timer->m_WheelSlot;
+
+		if (timer->m_WheelPrev)
+			timer->m_WheelPrev->m_WheelNext = timer->m_WheelNext;
+		else
+			m_Slots[slot] = timer->m_WheelNext;
+
+		if (timer->m_WheelNext)
+			timer->m_WheelNext->m_WheelPrev = timer->m_WheelPrev;
+
+		if (slot < RootSize && !m_Slots[slot])
+			m_RootBitmap[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+
+		timer->m_WheelPrev = nullptr;
+		timer->m_WheelNext = nullptr;
+		timer->m_WheelSlot = -1;
+
+		m_Count--;
+	}
+
+	bool IsEmpty() const override
+	{
+		return m_Count == 0;
+	}
+
+	size_t GetLength() const override
+	{
+		return m_Count;
+	}
+
+	Timer *PopExpired(double now) override
+	{
+		Advance(GetTick(now));
+
+		Timer *timer = m_Slots[ReadySlot];
+
+		if (!timer)
+			return nullptr;
+
+		Erase(timer);
+
+		return timer;
+	}
+
+	double GetNextWakeup(double now) override
+	{
+		if (m_Slots[ReadySlot])
+			return now;
+
+		int index = m_CurrentTick & RootMask;
+		int next = FindNextRootSlot(index);
+		uint64_t tick;
+
+		if (next != -1)
+			tick = m_CurrentTick + (next - index);
+		else
+			tick = (m_CurrentTick | RootMask) + 1;
+
+		return tick * Resolution;
+	}
+
+	void GetTimers(std::vector<Timer *>& timers) const override
+	{
+		for (Timer *head : m_Slots) {
+			for (Timer *timer = head; timer; timer = timer->m_WheelNext)
+				timers.push_back(timer);
+		}
+	}
+
+	void Rebase(double now) override
+	{
+		std::vector<Timer *> timers;
+		GetTimers(timers);
+
+		for (Timer *timer : timers)
+			Erase(timer);
+
+		m_CurrentTick = GetTick(now);
+
+		for (Timer *timer : timers)
+			Insert(timer);
+	}
+
+private:
+	static constexpr double Resolution = 0.01;
+
+	static const int RootBits = 8;
+	static const int RootSize = 1 << RootBits;
+	static const int RootMask = RootSize - 1;
+	static const int LevelBits = 6;
+	static const int LevelSize = 1 << LevelBits;
+	static const int LevelMask = LevelSize - 1;
+	static const int LevelCount = 5;
+	static const int ReadySlot = RootSize + (LevelCount - 1) * LevelSize;
+
+	Timer *m_Slots[ReadySlot + 1];
+	uint64_t m_RootBitmap[RootSize / 64];
+	uint64_t m_CurrentTick; /**< The next tick which hasn't been processed yet. */
+	size_t m_Count{0};
+
+	static uint64_t GetTick(double ts)
+	{
+		if (ts < 0)
+			return 0;
+
+		return static_cast<uint64_t>(ts / Resolution);
+	}
+
+	void Link(Timer *timer, int slot)
+	{
+		timer->m_WheelSlot = slot;
+		timer->m_WheelPrev = nullptr;
+		timer->m_WheelNext = m_Slots[slot];
+
+		if (m_Slots[slot])
+			m_Slots[slot]->m_WheelPrev = timer;
+
+		m_Slots[slot] = timer;
+
+		if (slot < RootSize)
+			m_RootBitmap[slot / 64] |= uint64_t(1) << (slot % 64);
+
+		m_Count++;
+	}
+
+	/**
+	 * Finds the first non-empty slot on the first level, starting at
+	 * the specified index and without wrapping around.
+	 */
+	int FindNextRootSlot(int index) const
+	{
+		for (int word = index / 64; word < RootSize / 64; word++) {
+			uint64_t bits = m_RootBitmap[word];
+
+			if (word == index / 64)
+				bits &= ~uint64_t(0) << (index % 64);
+
+			if (!bits)
+				continue;
+
+			int bit = 0;
+
+			while (!(bits & (uint64_t(1) << bit)))
+				bit++;
+
+			return word * 64 + bit;
+		}
+
+		return -1;
+	}
+
+	/**
+	 * Moves all timers from the specified slot one level down.
+	 */
+	void Cascade(int slot)
+	{
+		Timer *timer = m_Slots[slot];
+
+		while (timer) {
+			Timer *next = timer->m_WheelNext;
+
+			Erase(timer);
+			Insert(timer);
+
+			timer = next;
+		}
+	}
+
+	/**
+	 * Moves all timers which are due up to (and including) the specified
+	 * tick into the ready list.
+	 */
+	void Advance(uint64_t nowTick)
+	{
+		while (m_CurrentTick <= nowTick) {
+			int index = m_CurrentTick & RootMask;
+
+			if (index == 0) {
+				for (int level = 1; level < LevelCount; level++) {
+					int levelIndex = (m_CurrentTick >> (RootBits + (level - 1) * LevelBits)) & LevelMask;
+
+					Cascade(RootSize + (level - 1) * LevelSize + levelIndex);
+
+					if (levelIndex != 0)
+						break;
+				}
+			}
+
+			int next = FindNextRootSlot(index);
+
+			if (next == -1) {
+				/* Skip ahead to the next point where the upper levels need to be cascaded. */
+				m_CurrentTick = std::min((m_CurrentTick | RootMask) + 1, nowTick + 1);
+				continue;
+			}
+
+			if (next != index) {
+				m_CurrentTick = std::min(m_CurrentTick + (next - index), nowTick + 1);
+				continue;
+			}
+
+			Timer *timer = m_Slots[index];
+
+			while (timer) {
+				Timer *nextTimer = timer->m_WheelNext;
+
+				Erase(timer);
+				Link(timer, ReadySlot);
+
+				timer = nextTimer;
+			}
+
+			m_CurrentTick++;
+		}
+	}
+};
+
+}
+
+static ProfiledMutex l_TimerMutex("Timer");
+static boost::condition_variable_any l_TimerCV;
 static std::thread l_TimerThread;
 static bool l_StopTimerThread;
-static TimerSet l_Timers;
+static TimerEngine *l_TimerEngine;
+static boost::once_flag l_TimerEngineOnceFlag = BOOST_ONCE_INIT;
 static int l_AliveTimers = 0;
+static double l_DispatchLag = 0;
+static double l_DispatchLagMax = 0;
+static double l_DispatchLagMaxReset = 0;
+
+REGISTER_STATSFUNCTION(Timer, &Timer::StatsFunc);
+
+namespace icinga {
+
+struct TimerStatistics
+{
+	std::atomic<int> Timers{0};
+	std::atomic<uint_fast64_t> Calls{0};
+	Histogram DispatchLag; /**< How late the timer thread picked up the timer. */
+	Histogram QueueWait; /**< How long the callback waited for a thread pool worker. */
+	Histogram ExecutionTime; /**< How long the callback ran. */
+};
+
+}
+
+static boost::mutex& GetTimerStatisticsMutex()
+{
+	static boost::mutex mutex;
+	return mutex;
+}
+
+/* The statistics are never freed so that the entries stay valid for
+ * timers which are destroyed while their callback is queued. */
+static std::map<String, TimerStatistics *>& GetTimerStatistics()
+{
+	static std::map<String, TimerStatistics *> statistics;
+	return statistics;
+}
+
+static Histogram& GetEventLoopLagHistogram()
+{
+	static Histogram histogram;
+	return histogram;
+}
+
+/**
+ * Constructor for the Timer class.
+ *
+ * @param name The name which is used for the statistics, e.g. the name of
+ *        the class which owns the timer.
+ */
+Timer::Timer(const String& name)
+	: m_Name(name)
+{
+	boost::mutex::scoped_lock lock(GetTimerStatisticsMutex());
+
+	TimerStatistics*& statistics = GetTimerStatistics()[name.IsEmpty() ? "Timer" : name];
+
+	if (!statistics)
+		statistics = new TimerStatistics();
+
+	m_Statistics = statistics;
+	m_Statistics->Timers++;
+}
 
 /**
  * Destructor for the Timer class.
@@ -80,11 +529,23 @@ static int l_AliveTimers = 0;
 Timer::~Timer()
 {
 	Stop(true);
+
+	m_Statistics->Timers--;
+}
+
+/**
+ * Retrieves the name of this timer.
+ *
+ * @returns The name.
+ */
+String Timer::GetName() const
+{
+	return m_Name;
 }
 
 void Timer::Initialize()
 {
-	boost::mutex::scoped_lock lock(l_TimerMutex);
+	ProfiledMutex::scoped_lock lock(l_TimerMutex);
 
 	if (l_AliveTimers > 0) {
 		InitializeThread();
@@ -93,13 +554,36 @@ void Timer::Initialize()
 
 void Timer::Uninitialize()
 {
-	boost::mutex::scoped_lock lock(l_TimerMutex);
+	ProfiledMutex::scoped_lock lock(l_TimerMutex);
 
 	if (l_AliveTimers > 0) {
 		UninitializeThread();
 	}
 }
 
+void Timer::InitializeEngine()
+{
+	String timerEngine = ScriptGlobal::Get("TimerEngine", &Empty);
+
+	if (timerEngine.IsEmpty())
+		timerEngine = "wheel";
+
+	if (timerEngine == "wheel")
+		l_TimerEngine = new TimerEngineWheel();
+	else if (timerEngine == "set")
+		l_TimerEngine = new TimerEngineSet();
+	else {
+		Log(LogWarning, "Timer")
+			<< "Invalid timer engine selected: " << timerEngine << " - Falling back to 'wheel'";
+
+		timerEngine = "wheel";
+
+		l_TimerEngine = new TimerEngineWheel();
+	}
+
+	ScriptGlobal::Set("TimerEngine", timerEngine);
+}
+
 void Timer::InitializeThread()
 {
 	l_StopTimerThread = false;
@@ -123,17 +607,32 @@ void Timer::UninitializeThread()
 
 /**
  * Calls this timer.
+ *
+ * @param lag How late the timer thread picked up the timer.
+ * @param dispatched When the timer thread queued the call.
  */
-void Timer::Call()
+void Timer::Call(double lag, double dispatched)
 {
+	double start = Utility::GetTime();
+	double queueWait = std::max(start - dispatched, 0.0);
+
+	m_Statistics->Calls++;
+	m_Statistics->DispatchLag.Record(lag);
+	m_Statistics->QueueWait.Record(queueWait);
+	GetEventLoopLagHistogram().Record(lag + queueWait);
+
 	try {
 		OnTimerExpired(Timer::Ptr(this));
 	} catch (...) {
+		m_Statistics->ExecutionTime.Record(Utility::GetTime() - start);
+
 		InternalReschedule(true);
 
 		throw;
 	}
 
+	m_Statistics->ExecutionTime.Record(Utility::GetTime() - start);
+
 	InternalReschedule(true);
 }
 
@@ -144,7 +643,7 @@ void Timer::Call()
  */
 void Timer::SetInterval(double interval)
 {
-	boost::mutex::scoped_lock lock(l_TimerMutex);
+	ProfiledMutex::scoped_lock lock(l_TimerMutex);
 	m_Interval = interval;
 }
 
@@ -155,7 +654,7 @@ void Timer::SetInterval(double interval)
  */
 double Timer::GetInterval() const
 {
-	boost::mutex::scoped_lock lock(l_TimerMutex);
+	ProfiledMutex::scoped_lock lock(l_TimerMutex);
 	return m_Interval;
 }
 
@@ -164,8 +663,10 @@ double Timer::GetInterval() const
  */
 void Timer::Start()
 {
+	boost::call_once(l_TimerEngineOnceFlag, &Timer::InitializeEngine);
+
 	{
-		boost::mutex::scoped_lock lock(l_TimerMutex);
+		ProfiledMutex::scoped_lock lock(l_TimerMutex);
 		m_Started = true;
 
 		if (++l_AliveTimers == 1) {
@@ -184,14 +685,16 @@ void Timer::Stop(bool wait)
 	if (l_StopTimerThread)
 		return;
 
-	boost::mutex::scoped_lock lock(l_TimerMutex);
+	ProfiledMutex::scoped_lock lock(l_TimerMutex);
 
 	if (m_Started && --l_AliveTimers == 0) {
 		UninitializeThread();
 	}
 
 	m_Started = false;
-	l_Timers.erase(this);
+
+	if (l_TimerEngine)
+		l_TimerEngine->Erase(this);
 
 	/* Notify the worker thread that we've disabled a timer. */
 	l_TimerCV.notify_all();
@@ -214,25 +717,35 @@ void Timer::Reschedule(double next)
  */
 void Timer::InternalReschedule(bool completed, double next)
 {
-	boost::mutex::scoped_lock lock(l_TimerMutex);
+	ProfiledMutex::scoped_lock lock(l_TimerMutex);
+
+	bool rearmed = false;
 
-	if (completed)
+	if (completed) {
 		m_Running = false;
+		rearmed = m_Rearmed;
+		m_Rearmed = false;
+	} else if (m_Running && next >= 0)
+		m_Rearmed = true;
 
 	if (next < 0) {
-		/* Don't schedule the next call if this is not a periodic timer. */
-		if (m_Interval <= 0)
-			return;
-
-		next = Utility::GetTime() + m_Interval;
+		/* Don't schedule the next call if this is not a periodic timer,
+		 * unless its callback has set a new deadline. */
+		if (m_Interval <= 0) {
+			if (!rearmed)
+				return;
+
+			next = m_Next;
+		} else
+			next = Utility::GetTime() + m_Interval;
 	}
 
 	m_Next = next;
 
 	if (m_Started && !m_Running) {
 		/* Remove and re-add the timer to update the index. */
-		l_Timers.erase(this);
-		l_Timers.insert(this);
+		l_TimerEngine->Erase(this);
+		l_TimerEngine->Insert(this);
 
 		/* Notify the worker that we've rescheduled a timer. */
 		l_TimerCV.notify_all();
@@ -246,7 +759,7 @@ void Timer::InternalReschedule(bool completed, double next)
  */
 double Timer::GetNext() const
 {
-	boost::mutex::scoped_lock lock(l_TimerMutex);
+	ProfiledMutex::scoped_lock lock(l_TimerMutex);
 	return m_Next;
 }
 
@@ -258,27 +771,31 @@ double Timer::GetNext() const
  */
 void Timer::AdjustTimers(double adjustment)
 {
-	boost::mutex::scoped_lock lock(l_TimerMutex);
+	ProfiledMutex::scoped_lock lock(l_TimerMutex);
+
+	if (!l_TimerEngine)
+		return;
 
 	double now = Utility::GetTime();
 
-	typedef boost::multi_index::nth_index<TimerSet, 1>::type TimerView;
-	TimerView& idx = boost::get<1>(l_Timers);
+	std::vector<Timer *> allTimers;
+	l_TimerEngine->GetTimers(allTimers);
 
 	std::vector<Timer *> timers;
 
-	for (Timer *timer : idx) {
+	for (Timer *timer : allTimers) {
 		if (std::fabs(now - (timer->m_Next + adjustment)) <
 			std::fabs(now - timer->m_Next)) {
+			l_TimerEngine->Erase(timer);
 			timer->m_Next += adjustment;
 			timers.push_back(timer);
 		}
 	}
 
-	for (Timer *timer : timers) {
-		l_Timers.erase(timer);
-		l_Timers.insert(timer);
-	}
+	l_TimerEngine->Rebase(now);
+
+	for (Timer *timer : timers)
+		l_TimerEngine->Insert(timer);
 
 	/* Notify the worker that we've rescheduled some timers. */
 	l_TimerCV.notify_all();
@@ -294,41 +811,127 @@ void Timer::TimerThreadProc()
 	Utility::SetThreadName("Timer Thread");
 
 	for (;;) {
-		boost::mutex::scoped_lock lock(l_TimerMutex);
-
-		typedef boost::multi_index::nth_index<TimerSet, 1>::type NextTimerView;
-		NextTimerView& idx = boost::get<1>(l_Timers);
+		ProfiledMutex::scoped_lock lock(l_TimerMutex);
 
 		/* Wait until there is at least one timer. */
-		while (idx.empty() && !l_StopTimerThread)
+		while (l_TimerEngine->IsEmpty() && !l_StopTimerThread)
 			l_TimerCV.wait(lock);
 
 		if (l_StopTimerThread)
 			break;
 
-		auto it = idx.begin();
-		Timer *timer = *it;
+		double now = Utility::GetTime();
+
+		/* Remove the timer from the list so it doesn't get called again
+		 * until the current call is completed. */
+		Timer *timer = l_TimerEngine->PopExpired(now);
 
-		double wait = timer->m_Next - Utility::GetTime();
+		if (!timer) {
+			double wait = l_TimerEngine->GetNextWakeup(now) - now;
 
-		if (wait > 0.01) {
 			/* Wait for the next timer. */
-			l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
+			if (wait > 0)
+				l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000) + 1));
 
 			continue;
 		}
 
-		Timer::Ptr ptimer = timer;
+		double lag = std::max(now - timer->m_Next, 0.0);
 
-		/* Remove the timer from the list so it doesn't get called again
-		 * until the current call is completed. */
-		l_Timers.erase(timer);
+		l_DispatchLag = l_DispatchLag * 0.95 + lag * 0.05;
+
+		if (now - l_DispatchLagMaxReset > 60) {
+			l_DispatchLagMax = 0;
+			l_DispatchLagMaxReset = now;
+		}
+
+		if (lag > l_DispatchLagMax)
+			l_DispatchLagMax = lag;
+
+		Timer::Ptr ptimer = timer;
 
 		timer->m_Running = true;
 
 		lock.unlock();
 
 		/* Asynchronously call the timer. */
-		Utility::QueueAsyncCallback(std::bind(&Timer::Call, ptimer));
+		Utility::QueueAsyncCallback(std::bind(&Timer::Call, ptimer, lag, now));
+	}
+}
+
+/**
+ * Returns how late timer callbacks started in seconds, i.e. the dispatch
+ * lag plus the time they waited for a thread pool worker. This is the
+ * first thing to go up when the event loop is overloaded.
+ *
+ * @returns The histogram.
+ */
+const Histogram& Timer::GetEventLoopLag()
+{
+	return GetEventLoopLagHistogram();
+}
+
+static Dictionary::Ptr GetHistogramStats(const Histogram& histogram)
+{
+	return new Dictionary({
+		{ "avg", histogram.GetAverage() },
+		{ "p50", histogram.GetPercentile(50) },
+		{ "p95", histogram.GetPercentile(95) },
+		{ "p99", histogram.GetPercentile(99) },
+		{ "max", histogram.GetMax() }
+	});
+}
+
+void Timer::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	boost::call_once(l_TimerEngineOnceFlag, &Timer::InitializeEngine);
+
+	String engine;
+	size_t timers;
+	double lag, lagMax;
+
+	{
+		ProfiledMutex::scoped_lock lock(l_TimerMutex);
+
+		engine = l_TimerEngine->GetName();
+		timers = l_TimerEngine->GetLength();
+		lag = l_DispatchLag;
+		lagMax = l_DispatchLagMax;
+	}
+
+	DictionaryData owners;
+
+	{
+		boost::mutex::scoped_lock lock(GetTimerStatisticsMutex());
+
+		for (const auto& kv : GetTimerStatistics()) {
+			const TimerStatistics *statistics = kv.second;
+
+			if (statistics->Timers == 0 && statistics->Calls == 0)
+				continue;
+
+			owners.emplace_back(kv.first, new Dictionary({
+				{ "timers", statistics->Timers.load() },
+				{ "calls", statistics->Calls.load() },
+				{ "dispatch_lag", GetHistogramStats(statistics->DispatchLag) },
+				{ "queue_wait", GetHistogramStats(statistics->QueueWait) },
+				{ "execution_time", GetHistogramStats(statistics->ExecutionTime) }
+			}));
+		}
 	}
+
+	const Histogram& eventLoopLag = GetEventLoopLagHistogram();
+
+	status->Set("timer", new Dictionary({
+		{ "engine", engine },
+		{ "timers", timers },
+		{ "dispatch_lag", lag },
+		{ "dispatch_lag_max", lagMax },
+		{ "event_loop_lag", GetHistogramStats(eventLoopLag) },
+		{ "owners", new Dictionary(std::move(owners)) }
+	}));
+
+	perfdata->Add(new PerfdataValue("timer_dispatch_lag", lag));
+	perfdata->Add(new PerfdataValue("timer_dispatch_lag_max", lagMax));
+	perfdata->Add(new PerfdataValue("event_loop_lag_p95", eventLoopLag.GetPercentile(95)));
 }
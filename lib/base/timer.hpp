@@ -22,15 +22,26 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/histogram.hpp"
 #include <boost/signals2.hpp>
 
 namespace icinga {
 
 class TimerHolder;
+class TimerEngineSet;
+class TimerEngineWheel;
+struct TimerStatistics;
 
 /**
  * A timer that periodically triggers an event.
  *
+ * Timers with the same name share their statistics, i.e. how late they
+ * were dispatched, how long their callback waited for a thread pool
+ * worker and how long it ran. These are reported by the "Timer" stats
+ * function (i.e. /v1/status/Timer).
+ *
  * @ingroup base
  */
 class Timer final : public Object
@@ -38,8 +49,11 @@ class Timer final : public Object
 public:
 	DECLARE_PTR_TYPEDEFS(Timer);
 
+	explicit Timer(const String& name = String());
 	~Timer() override;
 
+	String GetName() const;
+
 	static void Initialize();
 	static void Uninitialize();
 	static void InitializeThread();
@@ -56,6 +70,10 @@ public:
 	void Reschedule(double next = -1);
 	double GetNext() const;
 
+	static const Histogram& GetEventLoopLag();
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
 	boost::signals2::signal<void(const Timer::Ptr&)> OnTimerExpired;
 
 private:
@@ -63,13 +81,23 @@ private:
 	double m_Next{0}; /**< When the next event should happen. */
 	bool m_Started{false}; /**< Whether the timer is enabled. */
 	bool m_Running{false}; /**< Whether the timer proc is currently running. */
+	bool m_Rearmed{false}; /**< Whether the timer was rescheduled while its proc was running. */
+	String m_Name; /**< The name which is used for the statistics. */
+	TimerStatistics *m_Statistics; /**< The statistics shared by all timers with this name. */
+
+	Timer *m_WheelPrev{nullptr}; /**< The previous timer in the wheel slot. */
+	Timer *m_WheelNext{nullptr}; /**< The next timer in the wheel slot. */
+	int m_WheelSlot{-1}; /**< The wheel slot this timer is linked into. */
 
-	void Call();
+	void Call(double lag, double dispatched);
 	void InternalReschedule(bool completed, double next = -1);
 
+	static void InitializeEngine();
 	static void TimerThreadProc();
 
 	friend class TimerHolder;
+	friend class TimerEngineSet;
+	friend class TimerEngineWheel;
 };
 
 }
@@ -21,6 +21,8 @@
 #include "base/utility.hpp"
 #include "base/exception.hpp"
 #include "base/logger.hpp"
+#include "base/scriptglobal.hpp"
+#include <algorithm>
 #include <iostream>
 
 #ifndef _WIN32
@@ -70,6 +72,13 @@ TlsStream::TlsStream(const Socket::Ptr& socket, const String& hostname, Connecti
 
 	socket->MakeNonBlocking();
 
+#ifdef SSL_OP_ENABLE_KTLS
+	/* Let the kernel encrypt and decrypt the records after the handshake. OpenSSL
+	 * falls back to doing it itself if the kernel or the cipher don't support it. */
+	if (ScriptGlobal::Get("TlsKernelOffload", &Empty).ToBool())
+		SSL_set_options(m_SSL.get(), SSL_OP_ENABLE_KTLS);
+#endif /* SSL_OP_ENABLE_KTLS */
+
 	SSL_set_fd(m_SSL.get(), socket->GetFD());
 
 	if (m_Role == RoleServer)
@@ -106,6 +115,16 @@ int TlsStream::ValidateCertificate(int preverify_ok, X509_STORE_CTX *ctx)
 	return 1;
 }
 
+/**
+ * Returns the number of bytes which were written to the stream but
+ * haven't been sent to the peer yet.
+ */
+size_t TlsStream::GetSendQueueSize() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_SendQ->GetAvailableBytes();
+}
+
 bool TlsStream::IsVerifyOK() const
 {
 	return m_VerifyOK;
@@ -116,6 +135,80 @@ String TlsStream::GetVerifyError() const
 	return m_VerifyError;
 }
 
+/**
+ * Offers a session from an earlier connection for resumption. Must be
+ * called before the handshake.
+ *
+ * @param session The session.
+ */
+void TlsStream::SetSession(const std::shared_ptr<SSL_SESSION>& session)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	SSL_set_session(m_SSL.get(), session.get());
+}
+
+/**
+ * Sets a callback which receives the resumable sessions the server hands
+ * out to this client. Must be called before the handshake.
+ *
+ * @param callback The callback.
+ */
+void TlsStream::SetSessionCallback(const std::function<void (const std::shared_ptr<SSL_SESSION>&)>& callback)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_SessionCallback = callback;
+}
+
+/**
+ * Checks whether the handshake resumed an earlier session.
+ *
+ * @returns true if the session was reused, false otherwise.
+ */
+bool TlsStream::IsSessionReused() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return SSL_session_reused(m_SSL.get());
+}
+
+/**
+ * Returns whether the kernel encrypts the records we send (kTLS).
+ */
+bool TlsStream::IsKernelSendOffloaded() const
+{
+#ifdef SSL_OP_ENABLE_KTLS
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_HandshakeOK && BIO_get_ktls_send(SSL_get_wbio(m_SSL.get()));
+#else /* SSL_OP_ENABLE_KTLS */
+	return false;
+#endif /* SSL_OP_ENABLE_KTLS */
+}
+
+/**
+ * Returns whether the kernel decrypts the records we receive (kTLS).
+ */
+bool TlsStream::IsKernelReceiveOffloaded() const
+{
+#ifdef SSL_OP_ENABLE_KTLS
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_HandshakeOK && BIO_get_ktls_recv(SSL_get_rbio(m_SSL.get()));
+#else /* SSL_OP_ENABLE_KTLS */
+	return false;
+#endif /* SSL_OP_ENABLE_KTLS */
+}
+
+int TlsStream::NewSessionCallback(SSL *ssl, SSL_SESSION *session)
+{
+	auto *stream = static_cast<TlsStream *>(SSL_get_ex_data(ssl, m_SSLIndex));
+
+	if (!stream || stream->m_Role != RoleClient || !stream->m_SessionCallback)
+		return 0;
+
+	/* Returning 1 hands our reference of the session to the shared_ptr. */
+	stream->m_SessionCallback(std::shared_ptr<SSL_SESSION>(session, SSL_SESSION_free));
+
+	return 1;
+}
+
 /**
  * Retrieves the X509 certficate for this client.
  *
@@ -141,15 +234,12 @@ std::shared_ptr<X509> TlsStream::GetPeerCertificate() const
 void TlsStream::OnEvent(int revents)
 {
 	int rc;
-	size_t count;
 
 	boost::mutex::scoped_lock lock(m_Mutex);
 
 	if (!m_SSL)
 		return;
 
-	char buffer[64 * 1024];
-
 	if (m_CurrentAction == TlsActionNone) {
 		bool corked = IsCorked();
 		if (!corked && (revents & (POLLIN | POLLERR | POLLHUP)))
@@ -178,10 +268,11 @@ void TlsStream::OnEvent(int revents)
 	switch (m_CurrentAction) {
 		case TlsActionRead:
 			do {
-				rc = SSL_read(m_SSL.get(), buffer, sizeof(buffer));
+				/* Decrypt directly into the receive queue. */
+				rc = SSL_read(m_SSL.get(), m_RecvQ->PrepareWrite(16 * 1024), 16 * 1024);
 
 				if (rc > 0) {
-					m_RecvQ->Write(buffer, rc);
+					m_RecvQ->CommitWrite(rc);
 					success = true;
 
 					readTotal += rc;
@@ -212,14 +303,17 @@ void TlsStream::OnEvent(int revents)
 
 			break;
 		case TlsActionWrite:
-			count = m_SendQ->Peek(buffer, sizeof(buffer), true);
+			/* Encrypt directly from the send queue, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER
+			 * allows the queue to be reallocated before a write is retried. */
+			m_SendQ->ReadBuffered([this, &rc, &success](const char *data, size_t size) -> size_t {
+				rc = SSL_write(m_SSL.get(), data, std::min<size_t>(size, 64 * 1024));
 
-			rc = SSL_write(m_SSL.get(), buffer, count);
+				if (rc <= 0)
+					return 0;
 
-			if (rc > 0) {
-				m_SendQ->Read(nullptr, rc, true);
 				success = true;
-			}
+				return rc;
+			});
 
 			break;
 		case TlsActionHandshake:
@@ -228,6 +322,20 @@ void TlsStream::OnEvent(int revents)
 			if (rc > 0) {
 				success = true;
 				m_HandshakeOK = true;
+
+				/* Certificates aren't verified again for resumed sessions, use the stored result instead. */
+				if (SSL_session_reused(m_SSL.get())) {
+					long result = SSL_get_verify_result(m_SSL.get());
+
+					if (result != X509_V_OK) {
+						m_VerifyOK = false;
+
+						std::ostringstream msgbuf;
+						msgbuf << "code " << result << ": " << X509_verify_cert_error_string(result);
+						m_VerifyError = msgbuf.str();
+					}
+				}
+
 				m_CV.notify_all();
 			}
 
@@ -368,6 +476,28 @@ void TlsStream::Write(const void *buffer, size_t count)
 	ChangeEvents(POLLIN|POLLOUT);
 }
 
+/**
+ * Implements Stream::ReadBuffered. The callback works on the receive
+ * queue and must not call any of the stream's methods.
+ */
+bool TlsStream::ReadBuffered(const std::function<size_t (const char *, size_t)>& callback)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	HandleError();
+
+	return m_RecvQ->ReadBuffered(callback);
+}
+
+void TlsStream::WriteBuffers(const StreamBuffer *buffers, size_t count)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_SendQ->WriteBuffers(buffers, count);
+
+	ChangeEvents(POLLIN|POLLOUT);
+}
+
 void TlsStream::Shutdown()
 {
 	m_Shutdown = true;
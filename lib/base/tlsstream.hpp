@@ -64,6 +64,8 @@ public:
 	size_t Peek(void *buffer, size_t count, bool allow_partial = false) override;
 	size_t Read(void *buffer, size_t count, bool allow_partial = false) override;
 	void Write(const void *buffer, size_t count) override;
+	bool ReadBuffered(const std::function<size_t (const char *, size_t)>& callback) override;
+	void WriteBuffers(const StreamBuffer *buffers, size_t count) override;
 
 	bool IsEof() const override;
 
@@ -72,9 +74,20 @@ public:
 
 	void SetCorked(bool corked) override;
 
+	size_t GetSendQueueSize() const;
+
 	bool IsVerifyOK() const;
 	String GetVerifyError() const;
 
+	void SetSession(const std::shared_ptr<SSL_SESSION>& session);
+	void SetSessionCallback(const std::function<void (const std::shared_ptr<SSL_SESSION>&)>& callback);
+	bool IsSessionReused() const;
+
+	bool IsKernelSendOffloaded() const;
+	bool IsKernelReceiveOffloaded() const;
+
+	static int NewSessionCallback(SSL *ssl, SSL_SESSION *session);
+
 private:
 	std::shared_ptr<SSL> m_SSL;
 	bool m_Eof;
@@ -92,6 +105,8 @@ private:
 	FIFO::Ptr m_SendQ;
 	FIFO::Ptr m_RecvQ;
 
+	std::function<void (const std::shared_ptr<SSL_SESSION>&)> m_SessionCallback;
+
 	TlsAction m_CurrentAction;
 	bool m_Retry;
 	bool m_Shutdown;
@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "base/tlsutility.hpp"
+#include "base/tlsstream.hpp"
 #include "base/convert.hpp"
 #include "base/logger.hpp"
 #include "base/context.hpp"
@@ -25,6 +26,11 @@
 #include "base/application.hpp"
 #include "base/exception.hpp"
 #include <fstream>
+#include <vector>
+#include <sys/stat.h>
+
+/* Resumable sessions and persisted ticket keys are valid for one day. */
+#define TLS_SESSION_TIMEOUT (24 * 60 * 60)
 
 namespace icinga
 {
@@ -101,6 +107,11 @@ std::shared_ptr<SSL_CTX> MakeSSLContext(const String& pubkey, const String& priv
 	SSL_CTX_set_mode(sslContext.get(), SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 	SSL_CTX_set_session_id_context(sslContext.get(), (const unsigned char *)"Icinga 2", 8);
 
+	/* Cache sessions on both sides so that reconnecting peers can skip the full handshake. */
+	SSL_CTX_set_session_cache_mode(sslContext.get(), SSL_SESS_CACHE_BOTH);
+	SSL_CTX_set_timeout(sslContext.get(), TLS_SESSION_TIMEOUT);
+	SSL_CTX_sess_set_new_cb(sslContext.get(), &TlsStream::NewSessionCallback);
+
 	if (!pubkey.IsEmpty()) {
 		if (!SSL_CTX_use_certificate_chain_file(sslContext.get(), pubkey.CStr())) {
 			Log(LogCritical, "SSL")
@@ -210,6 +221,62 @@ void SetTlsProtocolminToSSLContext(const std::shared_ptr<SSL_CTX>& context, cons
 	SSL_CTX_set_options(context.get(), flags);
 }
 
+/**
+ * Loads the session ticket keys for an SSL context from the specified file.
+ * If the file doesn't exist, doesn't match the key length or is older than
+ * a day the context's random keys are stored there instead. Restarted
+ * instances can therefore still resume the sessions of reconnecting peers.
+ *
+ * @param context The SSL context.
+ * @param keyPath The path of the ticket key file.
+ */
+void SetTicketKeysToSSLContext(const std::shared_ptr<SSL_CTX>& context, const String& keyPath)
+{
+	char errbuf[120];
+
+	/* The key length depends on the OpenSSL version. */
+	long keyLength = SSL_CTX_get_tlsext_ticket_keys(context.get(), nullptr, 0);
+
+	if (keyLength <= 0)
+		return;
+
+	std::vector<char> keys(keyLength);
+
+	struct stat statbuf;
+	if (stat(keyPath.CStr(), &statbuf) >= 0 && statbuf.st_size == keyLength
+		&& statbuf.st_mtime > Utility::GetTime() - TLS_SESSION_TIMEOUT) {
+		std::ifstream ifp(keyPath.CStr(), std::ifstream::in | std::ifstream::binary);
+		ifp.read(&keys[0], keyLength);
+
+		if (ifp && SSL_CTX_set_tlsext_ticket_keys(context.get(), &keys[0], keyLength))
+			return;
+	}
+
+	if (!SSL_CTX_get_tlsext_ticket_keys(context.get(), &keys[0], keyLength)) {
+		Log(LogCritical, "SSL")
+			<< "Error retrieving TLS session ticket keys: " << ERR_peek_error() << ", "" << ERR_error_string(ERR_peek_error(), errbuf) << """;
+		BOOST_THROW_EXCEPTION(openssl_error()
+			<< boost::errinfo_api_function("SSL_CTX_get_tlsext_ticket_keys")
+			<< errinfo_openssl_error(ERR_peek_error()));
+	}
+
+	std::fstream ofp;
+	String tempPath = Utility::CreateTempFile(keyPath + ".XXXXXX", 0600, ofp);
+	ofp.write(&keys[0], keyLength);
+	ofp.close();
+
+#ifdef _WIN32
+	_unlink(keyPath.CStr());
+#endif /* _WIN32 */
+
+	if (rename(tempPath.CStr(), keyPath.CStr()) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("rename")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(tempPath));
+	}
+}
+
 /**
  * Loads a CRL and appends its certificates to the specified SSL context.
  *
@@ -0,0 +1,345 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/tracing.hpp"
+#include "base/array.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include "base/application.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+
+using namespace icinga;
+
+#define TRACE_BUFFER_SIZE 4096
+
+/**
+ * The ring buffer of a thread. Buffers of threads which have exited are
+ * handed over to new threads so that the events aren't lost.
+ */
+struct TraceBuffer
+{
+	boost::mutex Mutex;
+	std::vector<TraceEvent> Events;
+	size_t Next{0};
+};
+
+struct icinga::TraceThreadState
+{
+	std::shared_ptr<TraceBuffer> Buffer;
+	std::mt19937_64 Random;
+	TraceSpan *Current{nullptr};
+	int ThreadId;
+};
+
+std::atomic<bool> Tracing::m_Enabled(false);
+std::atomic<double> Tracing::m_SampleRate(0);
+
+static boost::mutex l_BuffersMutex;
+static std::vector<std::shared_ptr<TraceBuffer> > l_Buffers;
+static int l_NextThreadId = 1;
+static boost::thread_specific_ptr<TraceThreadState> l_ThreadState;
+
+void Tracing::SetSampleRate(double rate)
+{
+	rate = std::max(0.0, std::min(1.0, rate));
+
+	m_SampleRate.store(rate);
+	m_Enabled.store(rate > 0);
+}
+
+double Tracing::GetSampleRate()
+{
+	return m_SampleRate.load();
+}
+
+TraceThreadState& Tracing::GetThreadState()
+{
+	TraceThreadState *state = l_ThreadState.get();
+
+	if (state)
+		return *state;
+
+	state = new TraceThreadState();
+	state->Random.seed(std::random_device()());
+
+	{
+		boost::mutex::scoped_lock lock(l_BuffersMutex);
+
+		for (const std::shared_ptr<TraceBuffer>& buffer : l_Buffers) {
+			if (buffer.use_count() == 1) {
+				state->Buffer = buffer;
+				break;
+			}
+		}
+
+		if (!state->Buffer) {
+			state->Buffer = std::make_shared<TraceBuffer>();
+			l_Buffers.push_back(state->Buffer);
+		}
+
+		state->ThreadId = l_NextThreadId++;
+	}
+
+	l_ThreadState.reset(state);
+
+	return *state;
+}
+
+void Tracing::AddEvent(TraceThreadState& state, TraceEvent&& event)
+{
+	TraceBuffer& buffer = *state.Buffer;
+
+	boost::mutex::scoped_lock lock(buffer.Mutex);
+
+	if (buffer.Events.size() < TRACE_BUFFER_SIZE)
+		buffer.Events.emplace_back(std::move(event));
+	else
+		buffer.Events[buffer.Next] = std::move(event);
+
+	buffer.Next = (buffer.Next + 1) % TRACE_BUFFER_SIZE;
+}
+
+/**
+ * Records a span whose start and end are already known, e.g. the runtime
+ * of a process.
+ */
+void Tracing::RecordSpan(const char *name, double start, double end, const String& detail)
+{
+	if (!IsEnabled())
+		return;
+
+	TraceThreadState& state = GetThreadState();
+	TraceSpan *parent = state.Current;
+
+	if (parent ? !parent->m_Sampled : (std::generate_canonical<double, 32>(state.Random) >= m_SampleRate.load(std::memory_order_relaxed)))
+		return;
+
+	TraceEvent event;
+	event.Name = name;
+	event.Detail = detail;
+	event.Start = start;
+	event.End = end;
+	event.SpanId = state.Random();
+	event.TraceId = parent ? parent->m_TraceId : state.Random();
+	event.ParentSpanId = parent ? parent->m_SpanId : 0;
+	event.ThreadId = state.ThreadId;
+
+	AddEvent(state, std::move(event));
+}
+
+/**
+ * Returns the recorded events of all threads ordered by their start time.
+ */
+std::vector<TraceEvent> Tracing::GetEvents()
+{
+	std::vector<std::shared_ptr<TraceBuffer> > buffers;
+
+	{
+		boost::mutex::scoped_lock lock(l_BuffersMutex);
+		buffers = l_Buffers;
+	}
+
+	std::vector<TraceEvent> events;
+
+	for (const std::shared_ptr<TraceBuffer>& buffer : buffers) {
+		boost::mutex::scoped_lock lock(buffer->Mutex);
+		events.insert(events.end(), buffer->Events.begin(), buffer->Events.end());
+	}
+
+	std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) {
+		return a.Start < b.Start;
+	});
+
+	return events;
+}
+
+void Tracing::Clear()
+{
+	boost::mutex::scoped_lock lock(l_BuffersMutex);
+
+	for (const std::shared_ptr<TraceBuffer>& buffer : l_Buffers) {
+		boost::mutex::scoped_lock block(buffer->Mutex);
+		buffer->Events.clear();
+		buffer->Next = 0;
+	}
+}
+
+/**
+ * Exports the events in the Chrome trace event format which can be loaded
+ * into chrome://tracing or Perfetto.
+ */
+Dictionary::Ptr Tracing::ExportChromeTrace()
+{
+	ArrayData traceEvents;
+	pid_t pid = Utility::GetPid();
+
+	for (const TraceEvent& event : GetEvents()) {
+		Dictionary::Ptr traceEvent = new Dictionary({
+			{ "name", event.Name },
+			{ "cat", "icinga2" },
+			{ "ph", "X" },
+			{ "ts", event.Start * 1000 * 1000 },
+			{ "dur", (event.End - event.Start) * 1000 * 1000 },
+			{ "pid", pid },
+			{ "tid", event.ThreadId }
+		});
+
+		if (!event.Detail.IsEmpty())
+			traceEvent->Set("args", new Dictionary({ { "detail", event.Detail } }));
+
+		traceEvents.emplace_back(std::move(traceEvent));
+	}
+
+	return new Dictionary({
+		{ "traceEvents", new Array(std::move(traceEvents)) },
+		{ "displayTimeUnit", "ms" }
+	});
+}
+
+static String FormatSpanId(uint64_t id)
+{
+	std::ostringstream msgbuf;
+	msgbuf << std::hex << std::setfill('0') << std::setw(16) << id;
+	return msgbuf.str();
+}
+
+static String FormatNanoseconds(double timestamp)
+{
+	return Convert::ToString(static_cast<unsigned long long>(timestamp * 1000 * 1000) * 1000ull);
+}
+
+/**
+ * Exports the events as an OpenTelemetry (OTLP/JSON) trace export request
+ * which can be sent to the /v1/traces endpoint of a collector.
+ */
+Dictionary::Ptr Tracing::ExportOpenTelemetry()
+{
+	ArrayData spans;
+
+	for (const TraceEvent& event : GetEvents()) {
+		ArrayData attributes;
+
+		attributes.emplace_back(new Dictionary({
+			{ "key", "thread.id" },
+			{ "value", new Dictionary({ { "intValue", Convert::ToString(event.ThreadId) } }) }
+		}));
+
+		if (!event.Detail.IsEmpty()) {
+			attributes.emplace_back(new Dictionary({
+				{ "key", "icinga.detail" },
+				{ "value", new Dictionary({ { "stringValue", event.Detail } }) }
+			}));
+		}
+
+		Dictionary::Ptr span = new Dictionary({
+			/* Trace IDs have 128 bits of which only the lower 64 bits are used. */
+			{ "traceId", FormatSpanId(0) + FormatSpanId(event.TraceId) },
+			{ "spanId", FormatSpanId(event.SpanId) },
+			{ "name", event.Name },
+			{ "kind", 1 }, /* SPAN_KIND_INTERNAL */
+			{ "startTimeUnixNano", FormatNanoseconds(event.Start) },
+			{ "endTimeUnixNano", FormatNanoseconds(event.End) },
+			{ "attributes", new Array(std::move(attributes)) }
+		});
+
+		if (event.ParentSpanId)
+			span->Set("parentSpanId", FormatSpanId(event.ParentSpanId));
+
+		spans.emplace_back(std::move(span));
+	}
+
+	return new Dictionary({
+		{ "resourceSpans", new Array({
+			new Dictionary({
+				{ "resource", new Dictionary({
+					{ "attributes", new Array({
+						new Dictionary({
+							{ "key", "service.name" },
+							{ "value", new Dictionary({ { "stringValue", "icinga2" } }) }
+						}),
+						new Dictionary({
+							{ "key", "service.version" },
+							{ "value", new Dictionary({ { "stringValue", Application::GetAppVersion() } }) }
+						})
+					}) }
+				}) },
+				{ "scopeSpans", new Array({
+					new Dictionary({
+						{ "scope", new Dictionary({ { "name", "icinga2" } }) },
+						{ "spans", new Array(std::move(spans)) }
+					})
+				}) }
+			})
+		}) }
+	});
+}
+
+void TraceSpan::Begin()
+{
+	m_State = &Tracing::GetThreadState();
+	m_Parent = m_State->Current;
+
+	if (m_Parent) {
+		m_Sampled = m_Parent->m_Sampled;
+		m_TraceId = m_Parent->m_TraceId;
+	} else {
+		m_Sampled = std::generate_canonical<double, 32>(m_State->Random) < Tracing::m_SampleRate.load(std::memory_order_relaxed);
+
+		if (m_Sampled)
+			m_TraceId = m_State->Random();
+	}
+
+	m_State->Current = this;
+
+	if (m_Sampled) {
+		m_SpanId = m_State->Random();
+		m_Start = Utility::GetTime();
+	}
+}
+
+void TraceSpan::End()
+{
+	m_State->Current = m_Parent;
+
+	if (!m_Sampled)
+		return;
+
+	TraceEvent event;
+	event.Name = m_Name;
+	event.Detail = std::move(m_Detail);
+	event.Start = m_Start;
+	event.End = Utility::GetTime();
+	event.TraceId = m_TraceId;
+	event.SpanId = m_SpanId;
+	event.ParentSpanId = m_Parent ? m_Parent->m_SpanId : 0;
+	event.ThreadId = m_State->ThreadId;
+
+	Tracing::AddEvent(*m_State, std::move(event));
+}
+
+void TraceSpan::SetDetail(const String& detail)
+{
+	m_Detail = detail;
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+#include "base/dictionary.hpp"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A finished span.
+ *
+ * @ingroup base
+ */
+struct TraceEvent
+{
+	const char *Name;
+	String Detail;
+	double Start;
+	double End;
+	uint64_t TraceId;
+	uint64_t SpanId;
+	uint64_t ParentSpanId;
+	int ThreadId;
+};
+
+struct TraceThreadState;
+
+/**
+ * Records timestamped spans into per-thread ring buffers. Spans are sampled
+ * when they're started without a parent span on the same thread, nested
+ * spans follow the decision of their parent. With a sample rate of 0 (the
+ * default) starting a span costs a single atomic load.
+ *
+ * @ingroup base
+ */
+class Tracing
+{
+public:
+	static void SetSampleRate(double rate);
+	static double GetSampleRate();
+
+	static inline bool IsEnabled()
+	{
+		return m_Enabled.load(std::memory_order_relaxed);
+	}
+
+	static void RecordSpan(const char *name, double start, double end, const String& detail = String());
+
+	static std::vector<TraceEvent> GetEvents();
+	static void Clear();
+
+	static Dictionary::Ptr ExportChromeTrace();
+	static Dictionary::Ptr ExportOpenTelemetry();
+
+private:
+	Tracing();
+
+	static std::atomic<bool> m_Enabled;
+	static std::atomic<double> m_SampleRate;
+
+	static TraceThreadState& GetThreadState();
+	static void AddEvent(TraceThreadState& state, TraceEvent&& event);
+
+	friend class TraceSpan;
+};
+
+/**
+ * A span which covers the lifetime of the object. The name must be
+ * a string literal.
+ *
+ * @ingroup base
+ */
+class TraceSpan
+{
+public:
+	inline explicit TraceSpan(const char *name)
+		: m_Name(name)
+	{
+		if (Tracing::IsEnabled())
+			Begin();
+	}
+
+	inline ~TraceSpan()
+	{
+		if (m_State)
+			End();
+	}
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+	/**
+	 * Returns whether the span is recorded. Callers should check this before
+	 * building the detail string.
+	 */
+	inline bool IsSampled() const
+	{
+		return m_Sampled;
+	}
+
+	void SetDetail(const String& detail);
+
+private:
+	const char *m_Name;
+	TraceThreadState *m_State{nullptr};
+	TraceSpan *m_Parent{nullptr};
+	bool m_Sampled{false};
+	String m_Detail;
+	double m_Start{0};
+	uint64_t m_TraceId{0};
+	uint64_t m_SpanId{0};
+
+	void Begin();
+	void End();
+
+	friend class Tracing;
+};
+
+/* The span variable has to be named in order to cover the enclosing scope. */
+#define TRACE_SPAN(name) icinga::TraceSpan currentTraceSpan(name)
+
+}
+
+#endif /* TRACING_H */
@@ -88,6 +88,29 @@ String Type::GetPluralName() const
 		return name + "s";
 }
 
+/**
+ * Returns the interned name of the specified field.
+ *
+ * @param id The field ID.
+ * @returns The field name.
+ */
+String Type::GetFieldName(int id) const
+{
+	return String::Intern(GetFieldInfo(id).Name);
+}
+
+/**
+ * Returns a function which reads the specified field directly. mkclass
+ * generates accessors for all fields of the types it compiles.
+ *
+ * @param id The field ID.
+ * @returns The accessor, or nullptr if the type doesn't provide one.
+ */
+FieldAccessor Type::GetFieldAccessor(int id) const
+{
+	return nullptr;
+}
+
 Object::Ptr Type::Instantiate(const std::vector<Value>& args) const
 {
 	ObjectFactory factory = GetFactory();
@@ -59,6 +59,12 @@ struct Field
 	{ }
 };
 
+/**
+ * Reads a field without going through Object::GetField(). The object must be
+ * an instance of the type which returned the accessor.
+ */
+typedef Value (*FieldAccessor)(const Object *object);
+
 enum TypeAttribute
 {
 	TAAbstract = 1
@@ -82,7 +88,9 @@ public:
 	virtual int GetAttributes() const = 0;
 	virtual int GetFieldId(const String& name) const = 0;
 	virtual Field GetFieldInfo(int id) const = 0;
+	virtual String GetFieldName(int id) const;
 	virtual int GetFieldCount() const = 0;
+	virtual FieldAccessor GetFieldAccessor(int id) const;
 
 	String GetPluralName() const;
 
@@ -26,7 +26,7 @@
 #include "base/utility.hpp"
 #include "base/json.hpp"
 #include "base/objectlock.hpp"
-#include <mmatch.h>
+#include "base/pattern.hpp"
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/tss.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -37,6 +37,7 @@
 #include <fstream>
 #include <iostream>
 #include <future>
+#include <ctime>
 
 #ifdef __FreeBSD__
 #	include <pthread_np.h>
@@ -144,6 +145,35 @@ String Utility::GetSymbolName(const void *addr)
 	return "(unknown function)";
 }
 
+/**
+ * Formats a code address as "symbol+0xoffset", falling back to the plain
+ * address if it can't be resolved.
+ *
+ * @param addr The code address.
+ * @returns The formatted address.
+ */
+String Utility::FormatCodeAddress(const void *addr)
+{
+	std::ostringstream msgbuf;
+
+#ifdef HAVE_DLADDR
+	Dl_info dli;
+
+	if (dladdr(const_cast<void *>(addr), &dli) > 0 && dli.dli_sname) {
+		String sym = DemangleSymbolName(dli.dli_sname);
+
+		if (sym.IsEmpty())
+			sym = dli.dli_sname;
+
+		msgbuf << sym << "+0x" << std::hex << (static_cast<const char *>(addr) - static_cast<const char *>(dli.dli_saddr));
+		return msgbuf.str();
+	}
+#endif /* HAVE_DLADDR */
+
+	msgbuf << addr;
+	return msgbuf.str();
+}
+
 /**
  * Performs wildcard pattern matching.
  *
@@ -153,7 +183,7 @@ String Utility::GetSymbolName(const void *addr)
  */
 bool Utility::Match(const String& pattern, const String& text)
 {
-	return (match(pattern.CStr(), text.CStr()) == 0);
+	return PatternCache::MatchGlob(pattern, text);
 }
 
 static bool ParseIp(const String& ip, char addr[16], int *proto)
@@ -401,6 +431,30 @@ double Utility::GetTime()
 #endif /* _WIN32 */
 }
 
+/**
+ * Returns the current time with a resolution of a few milliseconds, which
+ * is cheaper than GetTime(). Use it for statistics, log timestamps and
+ * timeouts, but not for measuring how long something took.
+ *
+ * @returns The current time.
+ */
+double Utility::GetCoarseTime()
+{
+#if defined(CLOCK_REALTIME_COARSE) && !defined(_WIN32)
+#ifdef I2_DEBUG
+	if (m_DebugTime >= 0)
+		return m_DebugTime;
+#endif /* I2_DEBUG */
+
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0)
+		return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif /* CLOCK_REALTIME_COARSE && !_WIN32 */
+
+	return GetTime();
+}
+
 /**
  * Returns the ID of the current process.
  *
@@ -1315,7 +1369,9 @@ int Utility::Random()
 	unsigned int *seed = m_RandSeed.get();
 
 	if (!seed) {
-		seed = new unsigned int(Utility::GetTime());
+		/* Instances started at the same time must not share a seed,
+		 * e.g. for the jitter of cluster reconnects. */
+		seed = new unsigned int(static_cast<unsigned int>(Utility::GetTime()) ^ (static_cast<unsigned int>(getpid()) << 16));
 		m_RandSeed.reset(seed);
 	}
 
@@ -1720,43 +1776,66 @@ String Utility::GetPlatformArchitecture()
 #endif /* _WIN32 */
 }
 
+/**
+ * Returns the length of the UTF-8 sequence at the specified position.
+ *
+ * @returns 1 to 3 for valid sequences and 0 otherwise.
+ */
+static size_t GetUTF8SequenceLength(const String& input, size_t i)
+{
+	size_t length = input.GetLength();
+
+	if ((input[i] & 0x80) == 0)
+		return 1;
+
+	if ((input[i] & 0xE0) == 0xC0 && length > i + 1 &&
+		(input[i + 1] & 0xC0) == 0x80)
+		return 2;
+
+	if ((input[i] & 0xF0) == 0xE0 && length > i + 2 &&
+		(input[i + 1] & 0xC0) == 0x80 && (input[i + 2] & 0xC0) == 0x80)
+		return 3;
+
+	return 0;
+}
+
 String Utility::ValidateUTF8(const String& input)
 {
-	String output;
 	size_t length = input.GetLength();
+	size_t i = 0;
 
-	for (size_t i = 0; i < length; i++) {
-		if ((input[i] & 0x80) == 0) {
-			output += input[i];
-			continue;
-		}
+	/* Most strings are valid, these are returned without copying them byte by byte. */
+	while (i < length) {
+		size_t n = GetUTF8SequenceLength(input, i);
 
-		if ((input[i] & 0xE0) == 0xC0 && length > i + 1 &&
-			(input[i + 1] & 0xC0) == 0x80) {
-			output += input[i];
-			output += input[i + 1];
-			i++;
-			continue;
-		}
+		if (n == 0)
+			break;
 
-		if ((input[i] & 0xF0) == 0xE0 && length > i + 2 &&
-			(input[i + 1] & 0xC0) == 0x80 && (input[i + 2] & 0xC0) == 0x80) {
-			output += input[i];
-			output += input[i + 1];
-			output += input[i + 2];
-			i += 2;
+		i += n;
+	}
+
+	if (i == length)
+		return input;
+
+	String output = input.SubStr(0, i);
+
+	while (i < length) {
+		size_t n = GetUTF8SequenceLength(input, i);
+
+		if (n == 0) {
+			output += "\xEF\xBF\xBD";
+			i++;
 			continue;
 		}
 
-		output += '\xEF';
-		output += '\xBF';
-		output += '\xBD';
+		output.GetData().append(input.GetData(), i, n);
+		i += n;
 	}
 
 	return output;
 }
 
-String Utility::CreateTempFile(const String& path, int mode, std::fstream& fp)
+String Utility::CreateTempFile(const String& path, int mode, std::fstream& fp, bool binary)
 {
 	std::vector<char> targetPath(path.Begin(), path.End());
 	targetPath.push_back('\0');
@@ -1776,7 +1855,12 @@ String Utility::CreateTempFile(const String& path, int mode, std::fstream& fp)
 	}
 
 	try {
-		fp.open(&targetPath[0], std::ios_base::trunc | std::ios_base::out);
+		std::ios_base::openmode openMode = std::ios_base::trunc | std::ios_base::out;
+
+		if (binary)
+			openMode |= std::ios_base::binary;
+
+		fp.open(&targetPath[0], openMode);
 	} catch (const std::fstream::failure&) {
 		close(fd);
 		throw;
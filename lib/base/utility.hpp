@@ -62,6 +62,7 @@ public:
 	static String DemangleSymbolName(const String& sym);
 	static String GetTypeName(const std::type_info& ti);
 	static String GetSymbolName(const void *addr);
+	static String FormatCodeAddress(const void *addr);
 
 	static bool Match(const String& pattern, const String& text);
 	static bool CidrMatch(const String& pattern, const String& ip);
@@ -72,6 +73,7 @@ public:
 	static void NullDeleter(void *);
 
 	static double GetTime();
+	static double GetCoarseTime();
 
 	static pid_t GetPid();
 
@@ -140,7 +142,7 @@ public:
 
 	static String ValidateUTF8(const String& input);
 
-	static String CreateTempFile(const String& path, int mode, std::fstream& fp);
+	static String CreateTempFile(const String& path, int mode, std::fstream& fp, bool binary = false);
 
 #ifdef _WIN32
 	static String GetIcingaInstallPath();
@@ -30,21 +30,20 @@ using namespace icinga;
 
 Value::operator double() const
 {
-	const double *value = boost::get<double>(&m_Value);
+	if (m_Type == ValueNumber)
+		return m_Number;
 
-	if (value)
-		return *value;
-
-	const bool *fvalue = boost::get<bool>(&m_Value);
-
-	if (fvalue)
-		return *fvalue;
+	if (m_Type == ValueBoolean)
+		return m_Boolean;
 
 	if (IsEmpty())
 		return 0;
 
 	try {
-		return boost::lexical_cast<double>(m_Value);
+		if (m_Type != ValueString)
+			BOOST_THROW_EXCEPTION(boost::bad_lexical_cast());
+
+		return boost::lexical_cast<double>(m_String->Data.GetData());
 	} catch (const std::exception&) {
 		std::ostringstream msgbuf;
 		msgbuf << "Can't convert '" << *this << "' to a floating point number.";
@@ -60,16 +59,16 @@ Value::operator String() const
 		case ValueEmpty:
 			return String();
 		case ValueNumber:
-			return Convert::ToString(boost::get<double>(m_Value));
+			return Convert::ToString(m_Number);
 		case ValueBoolean:
-			if (boost::get<bool>(m_Value))
+			if (m_Boolean)
 				return "true";
 			else
 				return "false";
 		case ValueString:
-			return boost::get<String>(m_Value);
+			return m_String->Data;
 		case ValueObject:
-			object = boost::get<Object::Ptr>(m_Value).get();
+			object = m_Object.get();
 			return object->ToString();
 		default:
 			BOOST_THROW_EXCEPTION(std::runtime_error("Unknown value type."));
@@ -24,187 +24,236 @@
 
 using namespace icinga;
 
-template class boost::variant<boost::blank, double, bool, String, Object::Ptr>;
-template const double& Value::Get<double>() const;
-template const bool& Value::Get<bool>() const;
-template const String& Value::Get<String>() const;
-template const Object::Ptr& Value::Get<Object::Ptr>() const;
-
 Value icinga::Empty;
 
 Value::Value(std::nullptr_t)
+	: Value()
 { }
 
 Value::Value(int value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(unsigned int value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(long value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(unsigned long value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(long long value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(unsigned long long value)
-	: m_Value(double(value))
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(double value)
-	: m_Value(value)
+	: m_Number(value), m_Type(ValueNumber)
 { }
 
 Value::Value(bool value)
-	: m_Value(value)
+	: m_Boolean(value), m_Type(ValueBoolean)
 { }
 
 Value::Value(const String& value)
-	: m_Value(value)
-{ }
+	: Value()
+{
+	SetString(value);
+}
 
 Value::Value(String&& value)
-	: m_Value(value)
-{ }
+	: Value()
+{
+	SetString(std::move(value));
+}
 
 Value::Value(const char *value)
-	: m_Value(String(value))
-{ }
+	: Value()
+{
+	SetString(value);
+}
 
 Value::Value(const Value& other)
-	: m_Value(other.m_Value)
-{ }
+	: Value()
+{
+	CopyFrom(other);
+}
 
-Value::Value(Value&& other)
+Value::Value(Value&& other) noexcept
+	: Value()
 {
-#if BOOST_VERSION >= 105400
-	m_Value = std::move(other.m_Value);
-#else /* BOOST_VERSION */
-	m_Value.swap(other.m_Value);
-#endif /* BOOST_VERSION */
+	MoveFrom(other);
 }
 
 Value::Value(Object *value)
-	: Value(Object::Ptr(value))
-{ }
+	: Value()
+{
+	if (value) {
+		new (&m_Object) Object::Ptr(value);
+		m_Type = ValueObject;
+	}
+}
 
 Value::Value(const intrusive_ptr<Object>& value)
+	: Value()
 {
-	if (value)
-		m_Value = value;
+	if (value) {
+		new (&m_Object) Object::Ptr(value);
+		m_Type = ValueObject;
+	}
 }
 
 Value& Value::operator=(const Value& other)
 {
-	m_Value = other.m_Value;
+	if (this != &other) {
+		Reset();
+		CopyFrom(other);
+	}
+
 	return *this;
 }
 
-Value& Value::operator=(Value&& other)
+Value& Value::operator=(Value&& other) noexcept
 {
-#if BOOST_VERSION >= 105400
-	m_Value = std::move(other.m_Value);
-#else /* BOOST_VERSION */
-	m_Value.swap(other.m_Value);
-#endif /* BOOST_VERSION */
+	if (this != &other) {
+		Reset();
+		MoveFrom(other);
+	}
 
 	return *this;
 }
 
 /**
- * Checks whether the variant is empty.
+ * Stores a string. The value must be empty.
  *
- * @returns true if the variant is empty, false otherwise.
+ * @param value The string.
  */
-bool Value::IsEmpty() const
+void Value::SetString(String value)
 {
-	return (GetType() == ValueEmpty || (IsString() && boost::get<String>(m_Value).IsEmpty()));
+	m_String = new StringBuffer{ { 1 }, std::move(value) };
+	m_Type = ValueString;
 }
 
 /**
- * Checks whether the variant is scalar (i.e. not an object and not empty).
+ * Copies another value. The value must be empty.
  *
- * @returns true if the variant is scalar, false otherwise.
+ * @param other The value which is copied.
  */
-bool Value::IsScalar() const
+void Value::CopyFrom(const Value& other)
 {
-	return !IsEmpty() && !IsObject();
-}
+	switch (other.m_Type) {
+		case ValueNumber:
+			m_Number = other.m_Number;
+			break;
+		case ValueBoolean:
+			m_Boolean = other.m_Boolean;
+			break;
+		case ValueString:
+			m_String = other.m_String;
+			m_String->References.fetch_add(1, std::memory_order_relaxed);
+			break;
+		case ValueObject:
+			new (&m_Object) Object::Ptr(other.m_Object);
+			break;
+		default:
+			break;
+	}
 
-/**
-* Checks whether the variant is a number.
-*
-* @returns true if the variant is a number.
-*/
-bool Value::IsNumber() const
-{
-	return (GetType() == ValueNumber);
+	m_Type = other.m_Type;
 }
 
 /**
- * Checks whether the variant is a boolean.
+ * Moves another value into this one and leaves the other value empty.
+ * The value must be empty.
  *
- * @returns true if the variant is a boolean.
+ * @param other The value which is moved.
  */
-bool Value::IsBoolean() const
+void Value::MoveFrom(Value& other) noexcept
 {
-	return (GetType() == ValueBoolean);
+	switch (other.m_Type) {
+		case ValueNumber:
+			m_Number = other.m_Number;
+			break;
+		case ValueBoolean:
+			m_Boolean = other.m_Boolean;
+			break;
+		case ValueString:
+			m_String = other.m_String;
+			break;
+		case ValueObject:
+			new (&m_Object) Object::Ptr(std::move(other.m_Object));
+			other.m_Object.~intrusive_ptr();
+			break;
+		default:
+			break;
+	}
+
+	m_Type = other.m_Type;
+
+	other.m_Number = 0;
+	other.m_Type = ValueEmpty;
 }
 
 /**
- * Checks whether the variant is a string.
- *
- * @returns true if the variant is a string.
+ * Releases the value's string or object and makes it empty.
  */
-bool Value::IsString() const
+void Value::Reset() noexcept
 {
-	return (GetType() == ValueString);
+	if (m_Type == ValueString) {
+		if (m_String->References.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete m_String;
+	} else if (m_Type == ValueObject)
+		m_Object.~intrusive_ptr();
+
+	m_Number = 0;
+	m_Type = ValueEmpty;
 }
 
 /**
- * Checks whether the variant is a non-null object.
+ * Checks whether the variant is empty.
  *
- * @returns true if the variant is a non-null object, false otherwise.
+ * @returns true if the variant is empty, false otherwise.
  */
-bool Value::IsObject() const
+bool Value::IsEmpty() const
 {
-	return  (GetType() == ValueObject);
+	return (GetType() == ValueEmpty || (IsString() && m_String->Data.IsEmpty()));
 }
 
 /**
- * Returns the type of the value.
+ * Checks whether the variant is scalar (i.e. not an object and not empty).
  *
- * @returns The type.
+ * @returns true if the variant is scalar, false otherwise.
  */
-ValueType Value::GetType() const
+bool Value::IsScalar() const
 {
-	return static_cast<ValueType>(m_Value.which());
+	return !IsEmpty() && !IsObject();
 }
 
 void Value::Swap(Value& other)
 {
-	m_Value.swap(other.m_Value);
+	Value temp(std::move(other));
+	other = std::move(*this);
+	*this = std::move(temp);
 }
 
 bool Value::ToBool() const
 {
 	switch (GetType()) {
 		case ValueNumber:
-			return static_cast<bool>(boost::get<double>(m_Value));
+			return static_cast<bool>(m_Number);
 
 		case ValueBoolean:
-			return boost::get<bool>(m_Value);
+			return m_Boolean;
 
 		case ValueString:
-			return !boost::get<String>(m_Value).IsEmpty();
+			return !m_String->Data.IsEmpty();
 
 		case ValueObject:
 			if (IsObjectType<Dictionary>()) {
@@ -239,7 +288,7 @@ String Value::GetTypeName() const
 		case ValueString:
 			return "String";
 		case ValueObject:
-			t = boost::get<Object::Ptr>(m_Value)->GetReflectionType();
+			t = m_Object->GetReflectionType();
 			if (!t) {
 				if (IsObjectType<Array>())
 					return "Array";
@@ -266,7 +315,7 @@ Type::Ptr Value::GetReflectionType() const
 		case ValueString:
 			return Type::GetByName("String");
 		case ValueObject:
-			return boost::get<Object::Ptr>(m_Value)->GetReflectionType();
+			return m_Object->GetReflectionType();
 		default:
 			return nullptr;
 	}
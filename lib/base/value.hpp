@@ -22,9 +22,9 @@
 
 #include "base/object.hpp"
 #include "base/string.hpp"
-#include <boost/variant/variant.hpp>
 #include <boost/variant/get.hpp>
 #include <boost/throw_exception.hpp>
+#include <atomic>
 
 namespace icinga
 {
@@ -48,12 +48,19 @@ enum ValueType
 /**
  * A type that can hold an arbitrary value.
  *
+ * Values are 16 bytes: an 8-byte payload and the type tag. Strings are kept
+ * in an immutable reference-counted buffer which is shared between copies,
+ * so copying a string value never copies the string's data.
+ *
  * @ingroup base
  */
 class Value
 {
 public:
-	Value() = default;
+	Value()
+		: m_Number(0)
+	{ }
+
 	Value(std::nullptr_t);
 	Value(int value);
 	Value(unsigned int value);
@@ -67,7 +74,7 @@ public:
 	Value(String&& value);
 	Value(const char *value);
 	Value(const Value& other);
-	Value(Value&& other);
+	Value(Value&& other) noexcept;
 	Value(Object *value);
 	Value(const intrusive_ptr<Object>& value);
 
@@ -78,13 +85,19 @@ public:
 		static_assert(!std::is_same<T, Object>::value, "T must not be Object");
 	}
 
+	~Value()
+	{
+		if (m_Type >= ValueString)
+			Reset();
+	}
+
 	bool ToBool() const;
 
 	operator double() const;
 	operator String() const;
 
 	Value& operator=(const Value& other);
-	Value& operator=(Value&& other);
+	Value& operator=(Value&& other) noexcept;
 
 	bool operator==(bool rhs) const;
 	bool operator!=(bool rhs) const;
@@ -113,11 +126,9 @@ public:
 		if (!IsObject())
 			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot convert value of type '" + GetTypeName() + "' to an object."));
 
-		const auto& object = Get<Object::Ptr>();
+		ASSERT(m_Object);
 
-		ASSERT(object);
-
-		intrusive_ptr<T> tobject = dynamic_pointer_cast<T>(object);
+		intrusive_ptr<T> tobject = dynamic_pointer_cast<T>(m_Object);
 
 		if (!tobject)
 			BOOST_THROW_EXCEPTION(std::bad_cast());
@@ -127,10 +138,26 @@ public:
 
 	bool IsEmpty() const;
 	bool IsScalar() const;
-	bool IsNumber() const;
-	bool IsBoolean() const;
-	bool IsString() const;
-	bool IsObject() const;
+
+	bool IsNumber() const
+	{
+		return m_Type == ValueNumber;
+	}
+
+	bool IsBoolean() const
+	{
+		return m_Type == ValueBoolean;
+	}
+
+	bool IsString() const
+	{
+		return m_Type == ValueString;
+	}
+
+	bool IsObject() const
+	{
+		return m_Type == ValueObject;
+	}
 
 	template<typename T>
 	bool IsObjectType() const
@@ -138,10 +165,13 @@ public:
 		if (!IsObject())
 			return false;
 
-		return dynamic_cast<T *>(Get<Object::Ptr>().get());
+		return dynamic_cast<T *>(m_Object.get());
 	}
 
-	ValueType GetType() const;
+	ValueType GetType() const
+	{
+		return m_Type;
+	}
 
 	void Swap(Value& other);
 
@@ -151,20 +181,70 @@ public:
 
 	Value Clone() const;
 
+	/**
+	 * Returns the value's payload. Throws boost::bad_get if the value
+	 * doesn't have the type T.
+	 */
 	template<typename T>
-	const T& Get() const
-	{
-		return boost::get<T>(m_Value);
-	}
+	const T& Get() const;
 
 private:
-	boost::variant<boost::blank, double, bool, String, Object::Ptr> m_Value;
+	struct StringBuffer
+	{
+		std::atomic<uint_fast32_t> References;
+		const String Data;
+	};
+
+	union {
+		double m_Number;
+		bool m_Boolean;
+		StringBuffer *m_String;
+		Object::Ptr m_Object;
+	};
+
+	ValueType m_Type{ValueEmpty};
+
+	void SetString(String value);
+	void CopyFrom(const Value& other);
+	void MoveFrom(Value& other) noexcept;
+	void Reset() noexcept;
 };
 
-extern template const double& Value::Get<double>() const;
-extern template const bool& Value::Get<bool>() const;
-extern template const String& Value::Get<String>() const;
-extern template const Object::Ptr& Value::Get<Object::Ptr>() const;
+template<>
+inline const double& Value::Get<double>() const
+{
+	if (m_Type != ValueNumber)
+		BOOST_THROW_EXCEPTION(boost::bad_get());
+
+	return m_Number;
+}
+
+template<>
+inline const bool& Value::Get<bool>() const
+{
+	if (m_Type != ValueBoolean)
+		BOOST_THROW_EXCEPTION(boost::bad_get());
+
+	return m_Boolean;
+}
+
+template<>
+inline const String& Value::Get<String>() const
+{
+	if (m_Type != ValueString)
+		BOOST_THROW_EXCEPTION(boost::bad_get());
+
+	return m_String->Data;
+}
+
+template<>
+inline const Object::Ptr& Value::Get<Object::Ptr>() const
+{
+	if (m_Type != ValueObject)
+		BOOST_THROW_EXCEPTION(boost::bad_get());
+
+	return m_Object;
+}
 
 extern Value Empty;
 
@@ -263,6 +343,4 @@ std::istream& operator>>(std::istream& stream, Value& value);
 
 }
 
-extern template class boost::variant<boost::blank, double, bool, icinga::String, icinga::Object::Ptr>;
-
 #endif /* VALUE_H */
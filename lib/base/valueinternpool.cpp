@@ -0,0 +1,138 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/valueinternpool.hpp"
+#include "base/object-packer.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/objectlock.hpp"
+
+using namespace icinga;
+
+/**
+ * Returns the frozen instance which is shared by all dictionaries and arrays
+ * with the same contents as the specified value. Nested containers are
+ * interned as well.
+ *
+ * @param value The value.
+ * @returns The shared instance, or the value itself if it can't be shared.
+ */
+Value ValueInternPool::Intern(const Value& value)
+{
+	Value result;
+	InternInternal(value, &result);
+	return result;
+}
+
+/**
+ * Returns the number of distinct containers in the pool.
+ */
+size_t ValueInternPool::GetUniqueCount() const
+{
+	return m_Values.size();
+}
+
+/**
+ * Returns the number of containers which were replaced with an
+ * existing instance.
+ */
+size_t ValueInternPool::GetSharedCount() const
+{
+	return m_Shared;
+}
+
+/**
+ * @returns Whether the value consists of plain data only.
+ */
+bool ValueInternPool::InternInternal(const Value& value, Value *result)
+{
+	if (!value.IsObject()) {
+		*result = value;
+		return true;
+	}
+
+	Object::Ptr container;
+
+	if (value.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr dict = value;
+		DictionaryData data;
+
+		ObjectLock olock(dict);
+
+		data.reserve(dict->GetLength());
+
+		for (const Dictionary::Pair& kv : dict) {
+			Value child;
+
+			if (!InternInternal(kv.second, &child)) {
+				*result = value;
+				return false;
+			}
+
+			data.emplace_back(kv.first, std::move(child));
+		}
+
+		container = new Dictionary(std::move(data));
+	} else if (value.IsObjectType<Array>()) {
+		Array::Ptr arr = value;
+		ArrayData data;
+
+		ObjectLock olock(arr);
+
+		data.reserve(arr->GetLength());
+
+		for (const Value& item : arr) {
+			Value child;
+
+			if (!InternInternal(item, &child)) {
+				*result = value;
+				return false;
+			}
+
+			data.emplace_back(std::move(child));
+		}
+
+		container = new Array(std::move(data));
+	} else {
+		/* PackObject() can't tell other objects apart. */
+		*result = value;
+		return false;
+	}
+
+	/* The packed value is the same for all containers with the same contents
+	 * no matter in which order their keys were set. */
+	std::string key = PackObject(value).GetData();
+
+	auto it = m_Values.find(key);
+
+	if (it != m_Values.end()) {
+		m_Shared++;
+		*result = it->second;
+		return true;
+	}
+
+	if (container->GetReflectionType() == Dictionary::TypeInstance)
+		static_pointer_cast<Dictionary>(container)->Freeze();
+	else
+		static_pointer_cast<Array>(container)->Freeze();
+
+	m_Values.emplace(std::move(key), container);
+	*result = container;
+	return true;
+}
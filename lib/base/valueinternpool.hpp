@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef VALUEINTERNPOOL_H
+#define VALUEINTERNPOOL_H
+
+#include "base/i2-base.hpp"
+#include "base/value.hpp"
+#include <string>
+#include <unordered_map>
+
+namespace icinga
+{
+
+/**
+ * Finds structurally identical dictionaries and arrays so that they can
+ * share one frozen instance. Containers which hold other kinds of objects
+ * (e.g. functions) are returned unchanged.
+ *
+ * @ingroup base
+ */
+class ValueInternPool
+{
+public:
+	Value Intern(const Value& value);
+
+	size_t GetUniqueCount() const;
+	size_t GetSharedCount() const;
+
+private:
+	std::unordered_map<std::string, Value> m_Values;
+	size_t m_Shared{0};
+
+	bool InternInternal(const Value& value, Value *result);
+};
+
+}
+
+#endif /* VALUEINTERNPOOL_H */
@@ -23,7 +23,10 @@
 #include "base/convert.hpp"
 #include "base/application.hpp"
 #include "base/exception.hpp"
+#include "base/statsfunction.hpp"
+#include "base/threadplacement.hpp"
 #include <boost/thread/tss.hpp>
+#include <algorithm>
 #include <math.h>
 
 using namespace icinga;
@@ -31,21 +34,120 @@ using namespace icinga;
 std::atomic<int> WorkQueue::m_NextID(1);
 boost::thread_specific_ptr<WorkQueue *> l_ThreadWorkQueue;
 
+REGISTER_STATSFUNCTION(WorkQueues, &WorkQueue::StatsFunc);
+
+static boost::mutex& GetWorkQueuesMutex()
+{
+	static boost::mutex mutex;
+	return mutex;
+}
+
+static std::vector<WorkQueue *>& GetWorkQueues()
+{
+	static std::vector<WorkQueue *> workQueues;
+	return workQueues;
+}
+
+/* Number of slots per priority ring, must be a power of two. Tasks which
+ * don't fit into the ring are kept in a mutex-protected overflow queue. */
+#define WQ_RING_SIZE 256
+
+/**
+ * Bounded multi-producer/single-consumer ring buffer. Each slot has a
+ * sequence number which tells producers and the consumer whether the slot
+ * is free or holds a task.
+ */
+struct WorkQueue::TaskRing
+{
+	struct Slot
+	{
+		std::atomic<size_t> Sequence;
+		Task Value;
+	};
+
+	Slot Slots[WQ_RING_SIZE];
+	std::atomic<size_t> EnqueuePos{0};
+	size_t DequeuePos{0};
+
+	TaskRing()
+	{
+		for (size_t i = 0; i < WQ_RING_SIZE; i++)
+			Slots[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+
+	bool TryPush(Task& task)
+	{
+		size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+		Slot *slot;
+
+		for (;;) {
+			slot = &Slots[pos & (WQ_RING_SIZE - 1)];
+			size_t seq = slot->Sequence.load(std::memory_order_acquire);
+			auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+			if (diff == 0) {
+				if (EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0)
+				return false;
+			else
+				pos = EnqueuePos.load(std::memory_order_relaxed);
+		}
+
+		slot->Value = std::move(task);
+		slot->Sequence.store(pos + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool TryPop(Task& task)
+	{
+		Slot *slot = &Slots[DequeuePos & (WQ_RING_SIZE - 1)];
+		size_t seq = slot->Sequence.load(std::memory_order_acquire);
+
+		if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(DequeuePos + 1) < 0)
+			return false;
+
+		task = std::move(slot->Value);
+		slot->Value = Task();
+		slot->Sequence.store(DequeuePos + WQ_RING_SIZE, std::memory_order_release);
+		DequeuePos++;
+
+		return true;
+	}
+};
+
 WorkQueue::WorkQueue(size_t maxItems, int threadCount)
-	: m_ID(m_NextID++), m_ThreadCount(threadCount), m_MaxItems(maxItems),
-	m_TaskStats(15 * 60)
+	: m_ID(m_NextID++), m_ThreadCount(threadCount), m_LockFree(threadCount == 1),
+	m_MaxItems(maxItems), m_TaskStats(15 * 60)
 {
+	for (int i = 0; i <= PriorityHigh; i++) {
+		m_OverflowCount[i].store(0);
+
+		if (m_LockFree)
+			m_Rings[i].reset(new TaskRing());
+	}
+
 	/* Initialize logger. */
 	m_StatusTimerTimeout = Utility::GetTime();
 
-	m_StatusTimer = new Timer();
+	m_StatusTimer = new Timer("WorkQueue status");
 	m_StatusTimer->SetInterval(10);
 	m_StatusTimer->OnTimerExpired.connect(std::bind(&WorkQueue::StatusTimerHandler, this));
 	m_StatusTimer->Start();
+
+	boost::mutex::scoped_lock lock(GetWorkQueuesMutex());
+	GetWorkQueues().push_back(this);
 }
 
 WorkQueue::~WorkQueue()
 {
+	{
+		boost::mutex::scoped_lock lock(GetWorkQueuesMutex());
+		std::vector<WorkQueue *>& workQueues = GetWorkQueues();
+		workQueues.erase(std::remove(workQueues.begin(), workQueues.end(), this), workQueues.end());
+	}
+
 	m_StatusTimer->Stop(true);
 
 	Join(true);
@@ -66,21 +168,33 @@ boost::mutex::scoped_lock WorkQueue::AcquireLock()
 	return boost::mutex::scoped_lock(m_Mutex);
 }
 
+void WorkQueue::SpawnThreads()
+{
+	Log(LogNotice, "WorkQueue")
+		<< "Spawning WorkQueue threads for '" << m_Name << "'";
+
+	for (int i = 0; i < m_ThreadCount; i++) {
+		if (m_LockFree)
+			m_Threads.create_thread(std::bind(&WorkQueue::LockFreeWorkerThreadProc, this));
+		else
+			m_Threads.create_thread(std::bind(&WorkQueue::WorkerThreadProc, this));
+	}
+
+	m_Spawned = true;
+}
+
 /**
  * Enqueues a task. Tasks are guaranteed to be executed in the order
  * they were enqueued in except if there is more than one worker thread.
  */
 void WorkQueue::EnqueueUnlocked(boost::mutex::scoped_lock& lock, std::function<void ()>&& function, WorkQueuePriority priority)
 {
-	if (!m_Spawned) {
-		Log(LogNotice, "WorkQueue")
-			<< "Spawning WorkQueue threads for '" << m_Name << "'";
-
-		for (int i = 0; i < m_ThreadCount; i++) {
-			m_Threads.create_thread(std::bind(&WorkQueue::WorkerThreadProc, this));
-		}
+	if (!m_Spawned)
+		SpawnThreads();
 
-		m_Spawned = true;
+	if (m_LockFree) {
+		EnqueueLockFree(lock, std::move(function), priority);
+		return;
 	}
 
 	bool wq_thread = IsWorkerThread();
@@ -90,7 +204,7 @@ void WorkQueue::EnqueueUnlocked(boost::mutex::scoped_lock& lock, std::function<v
 			m_CVFull.wait(lock);
 	}
 
-	m_Tasks.emplace(std::move(function), priority, ++m_NextTaskID);
+	m_Tasks.emplace(std::move(function), priority, ++m_NextTaskID, Utility::GetTime());
 
 	m_CVEmpty.notify_one();
 }
@@ -112,10 +226,102 @@ void WorkQueue::Enqueue(std::function<void ()>&& function, WorkQueuePriority pri
 		return;
 	}
 
+	if (m_LockFree) {
+		boost::mutex::scoped_lock lock(m_Mutex, boost::defer_lock);
+
+		if (!m_Spawned.load(std::memory_order_acquire)) {
+			lock.lock();
+
+			if (!m_Spawned)
+				SpawnThreads();
+		}
+
+		EnqueueLockFree(lock, std::move(function), priority);
+		return;
+	}
+
 	auto lock = AcquireLock();
 	EnqueueUnlocked(lock, std::move(function), priority);
 }
 
+/**
+ * Enqueues a task for a work queue with a single worker thread. The lock
+ * is only acquired when the caller has to wait for free space, when the
+ * task has to go into the overflow queue or when the worker thread has
+ * to be woken up.
+ *
+ * @param lock A lock for m_Mutex which doesn't have to be held by the caller
+ */
+void WorkQueue::EnqueueLockFree(boost::mutex::scoped_lock& lock, TaskFunction&& function, WorkQueuePriority priority)
+{
+	if (m_MaxItems != 0 && m_Length.load() >= m_MaxItems && !IsWorkerThread()) {
+		if (!lock.owns_lock())
+			lock.lock();
+
+		m_FullWaiters++;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		while (m_Length.load() >= m_MaxItems)
+			m_CVFull.wait(lock);
+
+		m_FullWaiters--;
+	}
+
+	m_Length++;
+
+	Task task(std::move(function), priority, 0, Utility::GetTime());
+
+	/* Once a ring has overflown all tasks for that priority have to go into the
+	 * overflow queue until it's empty again, otherwise they'd be run out of order. */
+	if (m_OverflowCount[priority].load() > 0 || !m_Rings[priority]->TryPush(task)) {
+		if (!lock.owns_lock())
+			lock.lock();
+
+		m_Overflow[priority].emplace_back(std::move(task));
+		m_OverflowCount[priority]++;
+	}
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (m_ConsumerWaiting.load()) {
+		if (!lock.owns_lock())
+			lock.lock();
+
+		m_CVEmpty.notify_one();
+	}
+}
+
+/**
+ * Dequeues the task with the highest priority for a work queue with a single
+ * worker thread. Must only be called by the worker thread.
+ *
+ * @param lock A lock for m_Mutex which doesn't have to be held by the caller
+ * @returns true if a task was dequeued, false otherwise
+ */
+bool WorkQueue::DequeueLockFree(boost::mutex::scoped_lock& lock, Task& task)
+{
+	for (int priority = PriorityHigh; priority >= PriorityLow; priority--) {
+		if (m_Rings[priority]->TryPop(task))
+			return true;
+
+		if (m_OverflowCount[priority].load() > 0) {
+			if (!lock.owns_lock())
+				lock.lock();
+
+			/* Producers might still be adding tasks to the ring if they checked the
+			 * overflow queue before it was filled. Those were enqueued concurrently
+			 * with the tasks in the overflow queue and can be run in any order. */
+			task = std::move(m_Overflow[priority].front());
+			m_Overflow[priority].pop_front();
+			m_OverflowCount[priority]--;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /**
  * Waits until all currently enqueued tasks have completed. This only works reliably
  * when no other thread is enqueuing new tasks when this method is called.
@@ -126,9 +332,14 @@ void WorkQueue::Join(bool stop)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	while (m_Processing || !m_Tasks.empty())
+	m_Joiners++;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	while (m_Length.load() > 0 || m_Processing || !m_Tasks.empty())
 		m_CVStarved.wait(lock);
 
+	m_Joiners--;
+
 	if (stop) {
 		m_Stopped = true;
 		m_CVEmpty.notify_all();
@@ -201,6 +412,9 @@ void WorkQueue::ReportExceptions(const String& facility) const
 
 size_t WorkQueue::GetLength() const
 {
+	if (m_LockFree)
+		return m_Length.load();
+
 	boost::mutex::scoped_lock lock(m_Mutex);
 
 	return m_Tasks.size();
@@ -212,7 +426,7 @@ void WorkQueue::StatusTimerHandler()
 
 	ASSERT(!m_Name.IsEmpty());
 
-	size_t pending = m_Tasks.size();
+	size_t pending = m_LockFree ? m_Length.load() : m_Tasks.size();
 
 	double now = Utility::GetTime();
 	double gradient = (pending - m_PendingTasks) / (now - m_PendingTasksTimestamp);
@@ -266,11 +480,26 @@ void WorkQueue::RunTaskFunction(const TaskFunction& func)
 	}
 }
 
+/**
+ * Runs a task which was dequeued by a worker thread and records its wait
+ * and execution time.
+ */
+void WorkQueue::RunTask(const Task& task)
+{
+	double start = Utility::GetTime();
+	m_WaitTime.Record(start - task.EnqueueTime);
+
+	RunTaskFunction(task.Function);
+
+	m_ExecutionTime.Record(Utility::GetTime() - start);
+}
+
 void WorkQueue::WorkerThreadProc()
 {
 	std::ostringstream idbuf;
 	idbuf << "WQ #" << m_ID;
 	Utility::SetThreadName(idbuf.str());
+	ThreadPlacement::PlaceThread(m_ID);
 
 	l_ThreadWorkQueue.reset(new WorkQueue *(this));
 
@@ -293,7 +522,7 @@ void WorkQueue::WorkerThreadProc()
 
 		lock.unlock();
 
-		RunTaskFunction(task.Function);
+		RunTask(task);
 
 		/* clear the task so whatever other resources it holds are released _before_ we re-acquire the mutex */
 		task = Task();
@@ -309,14 +538,135 @@ void WorkQueue::WorkerThreadProc()
 	}
 }
 
+void WorkQueue::LockFreeWorkerThreadProc()
+{
+	std::ostringstream idbuf;
+	idbuf << "WQ #" << m_ID;
+	Utility::SetThreadName(idbuf.str());
+	ThreadPlacement::PlaceThread(m_ID);
+
+	l_ThreadWorkQueue.reset(new WorkQueue *(this));
+
+	for (;;) {
+		Task task;
+		boost::mutex::scoped_lock lock(m_Mutex, boost::defer_lock);
+
+		/* m_Processing has to be incremented before m_Length is decremented so that Join() doesn't return early. */
+		m_Processing++;
+
+		if (!DequeueLockFree(lock, task)) {
+			m_Processing--;
+
+			if (!lock.owns_lock())
+				lock.lock();
+
+			if (m_Joiners.load() > 0)
+				m_CVStarved.notify_all();
+
+			m_ConsumerWaiting = true;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			bool dequeued = false;
+
+			while (!m_Stopped) {
+				m_Processing++;
+
+				if (DequeueLockFree(lock, task)) {
+					dequeued = true;
+					break;
+				}
+
+				m_Processing--;
+
+				if (m_Joiners.load() > 0)
+					m_CVStarved.notify_all();
+
+				m_CVEmpty.wait(lock);
+			}
+
+			m_ConsumerWaiting = false;
+
+			if (!dequeued)
+				break;
+		}
+
+		if (lock.owns_lock())
+			lock.unlock();
+
+		m_Length--;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (m_FullWaiters.load() > 0) {
+			lock.lock();
+			m_CVFull.notify_all();
+			lock.unlock();
+		}
+
+		RunTask(task);
+
+		/* clear the task so whatever other resources it holds are released before we signal Join() */
+		task = Task();
+
+		IncreaseTaskCount();
+
+		m_Processing--;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (m_Joiners.load() > 0 && m_Length.load() == 0) {
+			lock.lock();
+			m_CVStarved.notify_all();
+		}
+	}
+}
+
 void WorkQueue::IncreaseTaskCount()
 {
-	m_TaskStats.InsertValue(Utility::GetTime(), 1);
+	m_TaskStats.InsertValue(Utility::GetCoarseTime(), 1);
 }
 
-size_t WorkQueue::GetTaskCount(RingBuffer::SizeType span)
+size_t WorkQueue::GetTaskCount(ShardedRingBuffer::SizeType span)
 {
-	return m_TaskStats.UpdateAndGetValues(Utility::GetTime(), span);
+	return m_TaskStats.UpdateAndGetValues(Utility::GetCoarseTime(), span);
+}
+
+static Dictionary::Ptr GetHistogramStats(const Histogram& histogram)
+{
+	return new Dictionary({
+		{ "avg", histogram.GetAverage() },
+		{ "p50", histogram.GetPercentile(50) },
+		{ "p95", histogram.GetPercentile(95) },
+		{ "p99", histogram.GetPercentile(99) },
+		{ "max", histogram.GetMax() }
+	});
+}
+
+/**
+ * Reports all work queues. Queues with the same name (e.g. one per
+ * connection) are told apart by their ID.
+ */
+void WorkQueue::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+{
+	boost::mutex::scoped_lock lock(GetWorkQueuesMutex());
+
+	for (WorkQueue *wq : GetWorkQueues()) {
+		String name = wq->GetName();
+
+		if (name.IsEmpty())
+			name = "WorkQueue";
+
+		if (status->Contains(name))
+			name += " #" + Convert::ToString(wq->m_ID);
+
+		status->Set(name, new Dictionary({
+			{ "id", wq->m_ID },
+			{ "threads", wq->m_ThreadCount },
+			{ "items", wq->GetLength() },
+			{ "max_items", wq->m_MaxItems },
+			{ "task_rate", wq->GetTaskCount(60) / 60.0 },
+			{ "wait_time", GetHistogramStats(wq->m_WaitTime) },
+			{ "execution_time", GetHistogramStats(wq->m_ExecutionTime) }
+		}));
+	}
 }
 
 bool icinga::operator<(const Task& a, const Task& b)
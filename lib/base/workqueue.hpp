@@ -22,7 +22,10 @@
 
 #include "base/i2-base.hpp"
 #include "base/timer.hpp"
-#include "base/ringbuffer.hpp"
+#include "base/shardedringbuffer.hpp"
+#include "base/histogram.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -30,6 +33,7 @@
 #include <queue>
 #include <deque>
 #include <atomic>
+#include <memory>
 
 namespace icinga
 {
@@ -47,13 +51,14 @@ struct Task
 {
 	Task() = default;
 
-	Task(TaskFunction function, WorkQueuePriority priority, int id)
-		: Function(std::move(function)), Priority(priority), ID(id)
+	Task(TaskFunction function, WorkQueuePriority priority, int id, double enqueueTime)
+		: Function(std::move(function)), Priority(priority), ID(id), EnqueueTime(enqueueTime)
 	{ }
 
 	TaskFunction Function;
 	WorkQueuePriority Priority{PriorityNormal};
 	int ID{-1};
+	double EnqueueTime{0};
 };
 
 bool operator<(const Task& a, const Task& b);
@@ -61,6 +66,15 @@ bool operator<(const Task& a, const Task& b);
 /**
  * A workqueue.
  *
+ * Work queues with a single worker thread use lock-free rings (one per
+ * priority) to pass tasks to the worker. Producers only take the mutex
+ * when they have to wait for free space, when a ring overflows or when the
+ * worker thread needs to be woken up.
+ *
+ * All work queues keep histograms of the time tasks wait for a worker
+ * thread and of their execution time. They're reported by the "WorkQueues"
+ * stats function (i.e. /v1/status/WorkQueues).
+ *
  * @ingroup base
  */
 class WorkQueue
@@ -113,7 +127,7 @@ public:
 	bool IsWorkerThread() const;
 
 	size_t GetLength() const;
-	size_t GetTaskCount(RingBuffer::SizeType span);
+	size_t GetTaskCount(ShardedRingBuffer::SizeType span);
 
 	void SetExceptionCallback(const ExceptionCallback& callback);
 
@@ -121,6 +135,8 @@ public:
 	std::vector<boost::exception_ptr> GetExceptions() const;
 	void ReportExceptions(const String& facility) const;
 
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
 protected:
 	void IncreaseTaskCount();
 
@@ -129,7 +145,8 @@ private:
 	String m_Name;
 	static std::atomic<int> m_NextID;
 	int m_ThreadCount;
-	bool m_Spawned{false};
+	std::atomic<bool> m_Spawned{false};
+	bool m_LockFree;
 
 	mutable boost::mutex m_Mutex;
 	boost::condition_variable m_CVEmpty;
@@ -138,22 +155,41 @@ private:
 	boost::thread_group m_Threads;
 	size_t m_MaxItems;
 	bool m_Stopped{false};
-	int m_Processing{0};
+	std::atomic<int> m_Processing{0};
 	std::priority_queue<Task, std::deque<Task> > m_Tasks;
+
+	struct TaskRing;
+
+	std::unique_ptr<TaskRing> m_Rings[PriorityHigh + 1];
+	std::deque<Task> m_Overflow[PriorityHigh + 1];
+	std::atomic<size_t> m_OverflowCount[PriorityHigh + 1];
+	std::atomic<size_t> m_Length{0};
+	std::atomic<bool> m_ConsumerWaiting{false};
+	std::atomic<int> m_FullWaiters{0};
+	std::atomic<int> m_Joiners{0};
 	int m_NextTaskID{0};
 	ExceptionCallback m_ExceptionCallback;
 	std::vector<boost::exception_ptr> m_Exceptions;
 	Timer::Ptr m_StatusTimer;
 	double m_StatusTimerTimeout;
 
-	RingBuffer m_TaskStats;
+	ShardedRingBuffer m_TaskStats;
+	Histogram m_WaitTime;
+	Histogram m_ExecutionTime;
 	size_t m_PendingTasks{0};
 	double m_PendingTasksTimestamp{0};
 
+	void SpawnThreads();
+
+	void EnqueueLockFree(boost::mutex::scoped_lock& lock, TaskFunction&& function, WorkQueuePriority priority);
+	bool DequeueLockFree(boost::mutex::scoped_lock& lock, Task& task);
+
 	void WorkerThreadProc();
+	void LockFreeWorkerThreadProc();
 	void StatusTimerHandler();
 
 	void RunTaskFunction(const TaskFunction& func);
+	void RunTask(const Task& task);
 };
 
 }
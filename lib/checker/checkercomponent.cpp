@@ -21,6 +21,7 @@
 #include "checker/checkercomponent-ti.cpp"
 #include "icinga/icingaapplication.hpp"
 #include "icinga/cib.hpp"
+#include "icinga/concurrencycontroller.hpp"
 #include "remote/apilistener.hpp"
 #include "base/configtype.hpp"
 #include "base/objectlock.hpp"
@@ -30,6 +31,11 @@
 #include "base/exception.hpp"
 #include "base/convert.hpp"
 #include "base/statsfunction.hpp"
+#include "base/tracing.hpp"
+#include "base/startuptimeline.hpp"
+#include "base/threadplacement.hpp"
+#include <algorithm>
+#include <atomic>
 
 using namespace icinga;
 
@@ -37,6 +43,8 @@ REGISTER_TYPE(CheckerComponent);
 
 REGISTER_STATSFUNCTION(CheckerComponent, &CheckerComponent::StatsFunc);
 
+static std::atomic<bool> l_FirstCheckScheduled{false};
+
 void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
@@ -45,9 +53,19 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 		unsigned long idle = checker->GetIdleCheckables();
 		unsigned long pending = checker->GetPendingCheckables();
 
+		ArrayData shards;
+
+		for (const std::unique_ptr<Shard>& shard : checker->m_Shards) {
+			shards.emplace_back(new Dictionary({
+				{ "latency", CIB::GetHistogramStats(shard->Latency) },
+				{ "execution_time", CIB::GetHistogramStats(shard->ExecutionTime) }
+			}));
+		}
+
 		nodes.emplace_back(checker->GetName(), new Dictionary({
 			{ "idle", idle },
-			{ "pending", pending }
+			{ "pending", pending },
+			{ "shards", new Array(std::move(shards)) }
 		}));
 
 		String perfdata_prefix = "checkercomponent_" + checker->GetName() + "_";
@@ -60,10 +78,22 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 
 void CheckerComponent::OnConfigLoaded()
 {
+	for (int i = 0; i < GetSchedulerThreads(); i++)
+		m_Shards.emplace_back(new Shard());
+
 	ConfigObject::OnActiveChanged.connect(std::bind(&CheckerComponent::ObjectHandler, this, _1));
 	ConfigObject::OnPausedChanged.connect(std::bind(&CheckerComponent::ObjectHandler, this, _1));
 
 	Checkable::OnNextCheckChanged.connect(std::bind(&CheckerComponent::NextCheckChangedHandler, this, _1));
+	Checkable::OnNewCheckResult.connect(std::bind(&CheckerComponent::CheckResultHandler, this, _1, _2, _3), "CheckerComponent::CheckResultHandler");
+}
+
+void CheckerComponent::ValidateSchedulerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<CheckerComponent>::ValidateSchedulerThreads(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "scheduler_threads" }, "Value must be greater than 0."));
 }
 
 void CheckerComponent::Start(bool runtimeCreated)
@@ -74,12 +104,20 @@ void CheckerComponent::Start(bool runtimeCreated)
 		<< "'" << GetName() << "' started.";
 
 
-	m_Thread = std::thread(std::bind(&CheckerComponent::CheckThreadProc, this));
+	for (size_t i = 0; i < m_Shards.size(); i++)
+		m_Shards[i]->Thread = std::thread(std::bind(&CheckerComponent::CheckThreadProc, this, std::ref(*m_Shards[i]), i));
 
-	m_ResultTimer = new Timer();
+	m_ResultTimer = new Timer("CheckerComponent status");
 	m_ResultTimer->SetInterval(5);
 	m_ResultTimer->OnTimerExpired.connect(std::bind(&CheckerComponent::ResultTimerHandler, this));
 	m_ResultTimer->Start();
+
+	ConcurrencyController::SetAdaptive(GetAdaptiveConcurrentChecks(), GetMinConcurrentChecks());
+
+	m_ConcurrencyTimer = new Timer("CheckerComponent concurrency");
+	m_ConcurrencyTimer->SetInterval(5);
+	m_ConcurrencyTimer->OnTimerExpired.connect(std::bind(&ConcurrencyController::Update));
+	m_ConcurrencyTimer->Start();
 }
 
 void CheckerComponent::Stop(bool runtimeRemoved)
@@ -87,32 +125,83 @@ void CheckerComponent::Stop(bool runtimeRemoved)
 	Log(LogInformation, "CheckerComponent")
 		<< "'" << GetName() << "' stopped.";
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-		m_Stopped = true;
-		m_CV.notify_all();
+	for (const std::unique_ptr<Shard>& shard : m_Shards) {
+		ProfiledMutex::scoped_lock lock(shard->Mutex);
+		shard->Stopped = true;
+		shard->CV.notify_all();
 	}
 
 	m_ResultTimer->Stop();
-	m_Thread.join();
+	m_ConcurrencyTimer->Stop();
+
+	ConcurrencyController::SetAdaptive(false, GetMinConcurrentChecks());
+
+	for (const std::unique_ptr<Shard>& shard : m_Shards)
+		shard->Thread.join();
 
 	ObjectImpl<CheckerComponent>::Stop(runtimeRemoved);
 }
 
-void CheckerComponent::CheckThreadProc()
+/**
+ * Takes a token from the bucket which limits the number of checks started
+ * per second (max_checks_per_second) across all shards.
+ *
+ * @param wait Set to the time until the next token is available.
+ * @returns true if a check may be started.
+ */
+bool CheckerComponent::TakeCheckToken(double& wait)
+{
+	double rate = GetMaxChecksPerSecond();
+
+	if (rate <= 0)
+		return true;
+
+	boost::mutex::scoped_lock lock(m_RateMutex);
+
+	double now = Utility::GetTime();
+
+	/* Allow bursts of up to one second worth of checks. */
+	m_RateTokens = std::min(std::max(rate, 1.0), m_RateTokens + (now - m_RateLastRefill) * rate);
+	m_RateLastRefill = now;
+
+	if (m_RateTokens >= 1) {
+		m_RateTokens -= 1;
+		return true;
+	}
+
+	wait = (1 - m_RateTokens) / rate;
+	return false;
+}
+
+void CheckerComponent::ReturnCheckToken()
+{
+	if (GetMaxChecksPerSecond() <= 0)
+		return;
+
+	boost::mutex::scoped_lock lock(m_RateMutex);
+	m_RateTokens += 1;
+}
+
+CheckerComponent::Shard& CheckerComponent::GetShard(const Checkable::Ptr& checkable)
+{
+	return *m_Shards[Utility::SDBM(checkable->GetName()) % m_Shards.size()];
+}
+
+void CheckerComponent::CheckThreadProc(Shard& shard, int index)
 {
 	Utility::SetThreadName("Check Scheduler");
+	ThreadPlacement::PlaceThread(index);
 
-	boost::mutex::scoped_lock lock(m_Mutex);
+	ProfiledMutex::scoped_lock lock(shard.Mutex);
 
 	for (;;) {
 		typedef boost::multi_index::nth_index<CheckableSet, 1>::type CheckTimeView;
-		CheckTimeView& idx = boost::get<1>(m_IdleCheckables);
+		CheckTimeView& idx = boost::get<1>(shard.IdleCheckables);
 
-		while (idx.begin() == idx.end() && !m_Stopped)
-			m_CV.wait(lock);
+		while (idx.begin() == idx.end() && !shard.Stopped)
+			shard.CV.wait(lock);
 
-		if (m_Stopped)
+		if (shard.Stopped)
 			break;
 
 		auto it = idx.begin();
@@ -120,19 +209,29 @@ void CheckerComponent::CheckThreadProc()
 
 		double wait = csi.NextCheck - Utility::GetTime();
 
-		if (Checkable::GetPendingChecks() >= GetConcurrentChecks())
-			wait = 0.5;
+		if (wait <= 0) {
+			double rateWait;
+
+			/* The concurrent checks limit is shared by all shards, so the slot must be
+			 * reserved atomically rather than checked and taken later. */
+			if (!TakeCheckToken(rateWait))
+				wait = rateWait;
+			else if (!Checkable::TryAquirePendingCheckSlot(ConcurrencyController::GetLimit())) {
+				ReturnCheckToken();
+				wait = 0.5;
+			}
+		}
 
 		if (wait > 0) {
 			/* Wait for the next check. */
-			m_CV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
+			shard.CV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
 
 			continue;
 		}
 
 		Checkable::Ptr checkable = csi.Object;
 
-		m_IdleCheckables.erase(checkable);
+		shard.IdleCheckables.erase(checkable);
 
 		bool forced = checkable->GetForceNextCheck();
 		bool check = true;
@@ -171,9 +270,11 @@ void CheckerComponent::CheckThreadProc()
 
 		/* reschedule the checkable if checks are disabled */
 		if (!check) {
-			m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+			shard.IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
 			lock.unlock();
 
+			Checkable::DecreasePendingChecks();
+
 			Log(LogDebug, "CheckerComponent")
 				<< "Checks for checkable '" << checkable->GetName() << "' are disabled. Rescheduling check.";
 
@@ -193,7 +294,7 @@ void CheckerComponent::CheckThreadProc()
 			<< csi.Object->GetName() << "', Next Check: "
 			<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", csi.NextCheck) << "(" << csi.NextCheck << ").";
 
-		m_PendingCheckables.insert(csi);
+		shard.PendingCheckables.insert(csi);
 
 		lock.unlock();
 
@@ -205,16 +306,26 @@ void CheckerComponent::CheckThreadProc()
 		Log(LogDebug, "CheckerComponent")
 			<< "Executing check for '" << checkable->GetName() << "'";
 
-		Checkable::IncreasePendingChecks();
+		/* The time between the scheduled check time and the dispatch. */
+		if (Tracing::IsEnabled())
+			Tracing::RecordSpan("checker.schedule", std::min(checkable->GetNextCheck(), Utility::GetTime()), Utility::GetTime(), checkable->GetName());
 
 		Utility::QueueAsyncCallback(std::bind(&CheckerComponent::ExecuteCheckHelper, CheckerComponent::Ptr(this), checkable));
 
+		if (!l_FirstCheckScheduled.load(std::memory_order_relaxed) && !l_FirstCheckScheduled.exchange(true))
+			StartupTimeline::AddMilestone("first check scheduled");
+
 		lock.lock();
 	}
 }
 
 void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 {
+	TraceSpan span("checker.execute");
+
+	if (span.IsSampled())
+		span.SetDetail(checkable->GetName());
+
 	try {
 		checkable->ExecuteCheck();
 	} catch (const std::exception& ex) {
@@ -238,20 +349,21 @@ void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 	Checkable::DecreasePendingChecks();
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		Shard& shard = GetShard(checkable);
+		ProfiledMutex::scoped_lock lock(shard.Mutex);
 
 		/* remove the object from the list of pending objects; if it's not in the
 		 * list this was a manual (i.e. forced) check and we must not re-add the
 		 * object to the list because it's already there. */
-		auto it = m_PendingCheckables.find(checkable);
+		auto it = shard.PendingCheckables.find(checkable);
 
-		if (it != m_PendingCheckables.end()) {
-			m_PendingCheckables.erase(it);
+		if (it != shard.PendingCheckables.end()) {
+			shard.PendingCheckables.erase(it);
 
 			if (checkable->IsActive())
-				m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+				shard.IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
 
-			m_CV.notify_all();
+			shard.CV.notify_all();
 		}
 	}
 
@@ -263,12 +375,8 @@ void CheckerComponent::ResultTimerHandler()
 {
 	std::ostringstream msgbuf;
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-
-		msgbuf << "Pending checkables: " << m_PendingCheckables.size() << "; Idle checkables: " << m_IdleCheckables.size() << "; Checks/s: "
-			<< (CIB::GetActiveHostChecksStatistics(60) + CIB::GetActiveServiceChecksStatistics(60)) / 60.0;
-	}
+	msgbuf << "Pending checkables: " << GetPendingCheckables() << "; Idle checkables: " << GetIdleCheckables() << "; Checks/s: "
+		<< (CIB::GetActiveHostChecksStatistics(60) + CIB::GetActiveServiceChecksStatistics(60)) / 60.0;
 
 	Log(LogNotice, "CheckerComponent", msgbuf.str());
 }
@@ -283,20 +391,36 @@ void CheckerComponent::ObjectHandler(const ConfigObject::Ptr& object)
 	Zone::Ptr zone = Zone::GetByName(checkable->GetZoneName());
 	bool same_zone = (!zone || Zone::GetLocalZone() == zone);
 
+	bool schedule = object->IsActive() && !object->IsPaused() && same_zone;
+
+	/* Checks which are overdue or were only scheduled within the next minute
+	 * by Checkable::Start() after a restart or reload are spread evenly across
+	 * their check interval, using the random scheduling offset as the phase. */
+	if (schedule && GetSpreadChecks()) {
+		double interval = checkable->GetCheckInterval();
+		double now = Utility::GetTime();
+
+		if (interval > 0 && checkable->GetNextCheck() < now + std::min(interval, 60.0)) {
+			double phase = (checkable->GetSchedulingOffset() % 10000) / 10000.0;
+			checkable->SetNextCheck(now + phase * interval);
+		}
+	}
+
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		Shard& shard = GetShard(checkable);
+		ProfiledMutex::scoped_lock lock(shard.Mutex);
 
-		if (object->IsActive() && !object->IsPaused() && same_zone) {
-			if (m_PendingCheckables.find(checkable) != m_PendingCheckables.end())
+		if (schedule) {
+			if (shard.PendingCheckables.find(checkable) != shard.PendingCheckables.end())
 				return;
 
-			m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+			shard.IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
 		} else {
-			m_IdleCheckables.erase(checkable);
-			m_PendingCheckables.erase(checkable);
+			shard.IdleCheckables.erase(checkable);
+			shard.PendingCheckables.erase(checkable);
 		}
 
-		m_CV.notify_all();
+		shard.CV.notify_all();
 	}
 }
 
@@ -310,11 +434,12 @@ CheckableScheduleInfo CheckerComponent::GetCheckableScheduleInfo(const Checkable
 
 void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	Shard& shard = GetShard(checkable);
+	ProfiledMutex::scoped_lock lock(shard.Mutex);
 
 	/* remove and re-insert the object from the set in order to force an index update */
 	typedef boost::multi_index::nth_index<CheckableSet, 0>::type CheckableView;
-	CheckableView& idx = boost::get<0>(m_IdleCheckables);
+	CheckableView& idx = boost::get<0>(shard.IdleCheckables);
 
 	auto it = idx.find(checkable);
 
@@ -326,19 +451,42 @@ void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 	CheckableScheduleInfo csi = GetCheckableScheduleInfo(checkable);
 	idx.insert(csi);
 
-	m_CV.notify_all();
+	shard.CV.notify_all();
+}
+
+void CheckerComponent::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin)
+{
+	ConcurrencyController::ProcessCheckResult(cr);
+
+	/* Only account for the checks which were executed by this instance. */
+	if (!cr->GetActive() || (origin && !origin->IsLocal()))
+		return;
+
+	Shard& shard = GetShard(checkable);
+	shard.Latency.Record(cr->CalculateLatency());
+	shard.ExecutionTime.Record(cr->CalculateExecutionTime());
 }
 
 unsigned long CheckerComponent::GetIdleCheckables()
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
 
-	return m_IdleCheckables.size();
+	for (const std::unique_ptr<Shard>& shard : m_Shards) {
+		ProfiledMutex::scoped_lock lock(shard->Mutex);
+		count += shard->IdleCheckables.size();
+	}
+
+	return count;
 }
 
 unsigned long CheckerComponent::GetPendingCheckables()
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
+
+	for (const std::unique_ptr<Shard>& shard : m_Shards) {
+		ProfiledMutex::scoped_lock lock(shard->Mutex);
+		count += shard->PendingCheckables.size();
+	}
 
-	return m_PendingCheckables.size();
+	return count;
 }
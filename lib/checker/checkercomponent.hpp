@@ -25,12 +25,16 @@
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
 #include "base/utility.hpp"
+#include "base/histogram.hpp"
+#include "base/profiledmutex.hpp"
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/key_extractors.hpp>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace icinga
 {
@@ -81,22 +85,46 @@ public:
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
+	void ValidateSchedulerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 	unsigned long GetIdleCheckables();
 	unsigned long GetPendingCheckables();
 
 private:
-	boost::mutex m_Mutex;
-	boost::condition_variable m_CV;
-	bool m_Stopped{false};
-	std::thread m_Thread;
+	/**
+	 * A scheduler shard: checkables are distributed across the shards by
+	 * the hash of their name, each shard is served by its own thread.
+	 */
+	struct Shard
+	{
+		ProfiledMutex Mutex{"CheckerComponent shard"};
+		boost::condition_variable_any CV;
+		bool Stopped{false};
+		std::thread Thread;
+
+		CheckableSet IdleCheckables;
+		CheckableSet PendingCheckables;
 
-	CheckableSet m_IdleCheckables;
-	CheckableSet m_PendingCheckables;
+		Histogram Latency;
+		Histogram ExecutionTime;
+	};
+
+	std::vector<std::unique_ptr<Shard> > m_Shards;
 
 	Timer::Ptr m_ResultTimer;
+	Timer::Ptr m_ConcurrencyTimer;
+
+	boost::mutex m_RateMutex;
+	double m_RateTokens{0};
+	double m_RateLastRefill{0};
+
+	bool TakeCheckToken(double& wait);
+	void ReturnCheckToken();
+
+	Shard& GetShard(const Checkable::Ptr& checkable);
 
-	void CheckThreadProc();
+	void CheckThreadProc(Shard& shard, int index);
 	void ResultTimerHandler();
 
 	void ExecuteCheckHelper(const Checkable::Ptr& checkable);
@@ -105,6 +133,7 @@ private:
 
 	void ObjectHandler(const ConfigObject::Ptr& object);
 	void NextCheckChangedHandler(const Checkable::Ptr& checkable);
+	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin);
 
 	void RescheduleCheckTimer();
 
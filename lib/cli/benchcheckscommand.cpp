@@ -0,0 +1,403 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "cli/benchcheckscommand.hpp"
+#include "icinga/checkable.hpp"
+#include "icinga/cib.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include "config/configitembuilder.hpp"
+#include "base/application.hpp"
+#include "base/configwriter.hpp"
+#include "base/histogram.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/utility.hpp"
+#include "base/exception.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#ifndef _WIN32
+#	include <sys/resource.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+namespace po = boost::program_options;
+
+REGISTER_CLICOMMAND("bench/checks", BenchChecksCommand);
+
+static std::atomic<uint_fast64_t> l_CheckResults(0);
+static std::unique_ptr<Histogram> l_Latency;
+
+static void CheckResultHandler(const Checkable::Ptr&, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&)
+{
+	l_CheckResults.fetch_add(1);
+	l_Latency->Record(cr->CalculateLatency());
+}
+
+/**
+ * Returns the CPU time (user and system, in seconds) and the resident set
+ * size (in bytes) of the process.
+ */
+static void GetResourceUsage(double& cpuTime, double& rss)
+{
+	cpuTime = 0;
+	rss = 0;
+
+#ifndef _WIN32
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return;
+
+	cpuTime = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+		usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+
+#ifdef __linux__
+	std::ifstream fp("/proc/self/statm");
+	long size, resident;
+
+	if (fp >> size >> resident)
+		rss = static_cast<double>(resident) * sysconf(_SC_PAGESIZE);
+#else /* __linux__ */
+	/* This is the peak RSS rather than the current one. */
+	rss = usage.ru_maxrss * 1024.0;
+#endif /* __linux__ */
+#endif /* _WIN32 */
+}
+
+/**
+ * Returns the queue sizes which are reported by the stats functions,
+ * e.g. the checker's pending checks and the work queues of the features.
+ */
+static Dictionary::Ptr GetQueueDepths()
+{
+	Array::Ptr perfdata = CIB::GetFeatureStats().second;
+
+	DictionaryData queues;
+
+	ObjectLock olock(perfdata);
+
+	for (const Value& item : perfdata) {
+		if (!item.IsObjectType<PerfdataValue>())
+			continue;
+
+		PerfdataValue::Ptr pdv = item;
+		String label = pdv->GetLabel();
+
+		if (label.Find("pending") != String::NPos || label.Find("queue") != String::NPos)
+			queues.emplace_back(label, pdv->GetValue());
+	}
+
+	return new Dictionary(std::move(queues));
+}
+
+static String GenerateConfig(int hosts, int services, const String& checkCommand, double interval, const String& perfdataDir)
+{
+	std::ostringstream fp;
+
+	fp << "include <itl>" "\n"
+		"\n"
+		"object CheckerComponent \"bench-checker\" { }" "\n"
+		"\n"
+		"for (i in range(" << hosts << ")) {" "\n"
+		"\t" "var name = \"bench-host-\" + i" "\n"
+		"\n"
+		"\t" "object Host name {" "\n"
+		"\t\t" "check_command = ";
+	ConfigWriter::EmitString(fp, checkCommand);
+	fp << "\n"
+		"\t\t" "check_interval = " << interval << "\n"
+		"\t\t" "retry_interval = " << interval << "\n"
+		"\t\t" "vars.bench = true" "\n"
+		"\t\t" "vars.dummy_text = \"OK - bench | time=0.001s;1;2;0\"" "\n"
+		"\t" "}" "\n"
+		"}" "\n";
+
+	if (services > 0) {
+		fp << "\n"
+			"apply Service \"bench-service-\" for (i in range(" << services << ")) to Host {" "\n"
+			"\t" "check_command = ";
+		ConfigWriter::EmitString(fp, checkCommand);
+		fp << "\n"
+			"\t" "check_interval = " << interval << "\n"
+			"\t" "retry_interval = " << interval << "\n"
+			"\t" "vars.dummy_text = \"OK - bench | time=0.001s;1;2;0\"" "\n"
+			"\n"
+			"\t" "assign where host.vars.bench" "\n"
+			"}" "\n";
+	}
+
+	if (!perfdataDir.IsEmpty()) {
+		fp << "\n"
+			"object PerfdataWriter \"bench-perfdata\" {" "\n"
+			"\t" "host_perfdata_path = ";
+		ConfigWriter::EmitString(fp, perfdataDir + "/host-perfdata");
+		fp << "\n" "\t" "service_perfdata_path = ";
+		ConfigWriter::EmitString(fp, perfdataDir + "/service-perfdata");
+		fp << "\n" "\t" "host_temp_path = ";
+		ConfigWriter::EmitString(fp, perfdataDir + "/host-perfdata.tmp");
+		fp << "\n" "\t" "service_temp_path = ";
+		ConfigWriter::EmitString(fp, perfdataDir + "/service-perfdata.tmp");
+		fp << "\n" "}" "\n";
+	}
+
+	return fp.str();
+}
+
+/**
+ * Compiles and evaluates a config fragment. The file is read if no text is specified.
+ */
+static bool EvaluateConfig(const String& path, const String& text = String())
+{
+	try {
+		std::unique_ptr<Expression> expression;
+
+		if (text.IsEmpty())
+			expression = ConfigCompiler::CompileFile(path, String(), "_etc");
+		else
+			expression = ConfigCompiler::CompileText(path, text, String(), "_etc");
+
+		ScriptFrame frame(true);
+		expression->Evaluate(frame);
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "config", DiagnosticInformation(ex));
+		return false;
+	}
+
+	return true;
+}
+
+static void PrintSample(const Dictionary::Ptr& sample)
+{
+	Dictionary::Ptr latency = sample->Get("latency");
+
+	std::cout << "[" << Utility::FormatDuration(sample->Get("time")) << "] "
+		<< static_cast<long>(sample->Get("check_results_per_second")) << " check results/s, latency p50/p95/p99 "
+		<< latency->Get("p50") << "/" << latency->Get("p95") << "/" << latency->Get("p99") << "s, CPU "
+		<< static_cast<long>(static_cast<double>(sample->Get("cpu_usage")) * 100) << "%, RSS "
+		<< static_cast<long>(static_cast<double>(sample->Get("rss")) / (1024 * 1024)) << " MB";
+
+	Dictionary::Ptr queues = sample->Get("queues");
+
+	ObjectLock olock(queues);
+
+	for (const Dictionary::Pair& kv : queues)
+		std::cout << ", " << kv.first << "=" << kv.second;
+
+	std::cout << "\n";
+}
+
+String BenchChecksCommand::GetDescription() const
+{
+	return "Generates hosts and services with dummy or random checks and reports the check throughput.";
+}
+
+String BenchChecksCommand::GetShortDescription() const
+{
+	return "runs a load test";
+}
+
+void BenchChecksCommand::InitParameters(boost::program_options::options_description& visibleDesc,
+	boost::program_options::options_description& hiddenDesc) const
+{
+	visibleDesc.add_options()
+		("hosts", po::value<int>()->default_value(100), "number of hosts")
+		("services", po::value<int>()->default_value(10), "number of services per host")
+		("check-command", po::value<std::string>()->default_value("dummy"), "check command for the hosts and services (dummy or random)")
+		("check-interval", po::value<double>()->default_value(10), "check interval in seconds")
+		("duration", po::value<double>()->default_value(60), "duration of the load test in seconds")
+		("report-interval", po::value<double>()->default_value(5), "interval in seconds between reports")
+		("perfdata", po::value<std::string>(), "enable a PerfdataWriter which writes to the specified directory")
+		("config,c", po::value<std::vector<std::string> >(), "parse an additional configuration file, e.g. with IDO or metric writer objects")
+		("json", "print the reports as JSON objects, one per line")
+	;
+}
+
+std::vector<String> BenchChecksCommand::GetArgumentSuggestions(const String& argument, const String& word) const
+{
+	if (argument == "config")
+		return GetBashCompletionSuggestions("file", word);
+	else if (argument == "perfdata")
+		return GetBashCompletionSuggestions("directory", word);
+	else
+		return CLICommand::GetArgumentSuggestions(argument, word);
+}
+
+/**
+ * The entry point for the "bench checks" CLI command.
+ *
+ * @returns An exit status.
+ */
+int BenchChecksCommand::Run(const po::variables_map& vm, const std::vector<std::string>& ap) const
+{
+	int hosts = vm["hosts"].as<int>();
+	int services = vm["services"].as<int>();
+	String checkCommand = vm["check-command"].as<std::string>();
+	double interval = vm["check-interval"].as<double>();
+	double duration = vm["duration"].as<double>();
+	double reportInterval = vm["report-interval"].as<double>();
+	bool json = vm.count("json");
+
+	if (hosts < 1 || services < 0 || interval <= 0 || duration <= 0 || reportInterval <= 0) {
+		Log(LogCritical, "cli", "The number of hosts, the check interval, the duration and the report interval must be greater than zero.");
+		return EXIT_FAILURE;
+	}
+
+	if (checkCommand != "dummy" && checkCommand != "random") {
+		Log(LogCritical, "cli")
+			<< "Invalid check command '" << checkCommand << "': Must be 'dummy' or 'random'.";
+		return EXIT_FAILURE;
+	}
+
+	String perfdataDir;
+
+	if (vm.count("perfdata")) {
+		perfdataDir = vm["perfdata"].as<std::string>();
+		Utility::MkDirP(perfdataDir, 0750);
+	}
+
+	Log(LogInformation, "cli")
+		<< "Generating " << hosts << " hosts with " << services << " services each.";
+
+	ActivationScope ascope;
+
+	String config = GenerateConfig(hosts, services, checkCommand, interval, perfdataDir);
+
+	if (!EvaluateConfig("<bench>", config))
+		return EXIT_FAILURE;
+
+	if (vm.count("config")) {
+		for (const String& configPath : vm["config"].as<std::vector<std::string> >()) {
+			if (!EvaluateConfig(configPath))
+				return EXIT_FAILURE;
+		}
+	}
+
+	Type::Ptr appType = Type::GetByName(ScriptGlobal::Get("ApplicationType", &Empty));
+
+	if (ConfigItem::GetItems(appType).empty()) {
+		ConfigItemBuilder builder;
+		builder.SetType(appType);
+		builder.SetName("app");
+		builder.AddExpression(new ImportDefaultTemplatesExpression());
+		ConfigItem::Ptr item = builder.Compile();
+		item->Register();
+	}
+
+	/* Histogram::Record() decays at most once per interval; this makes
+	 * the percentiles cover the whole load test. */
+	l_Latency.reset(new Histogram(static_cast<int>(duration) + 1));
+	Checkable::OnNewCheckResult.connect(&CheckResultHandler, "BenchChecksCommand");
+
+	{
+		WorkQueue upq(25000, Application::GetConcurrency());
+		upq.SetName("BenchChecksCommand::Run");
+
+		std::vector<ConfigItem::Ptr> newItems;
+
+		if (!ConfigItem::CommitItems(ascope.GetContext(), upq, newItems) || !ConfigItem::ActivateItems(upq, newItems)) {
+			Log(LogCritical, "cli", "Error activating configuration.");
+			return EXIT_FAILURE;
+		}
+	}
+
+	double start = Utility::GetTime();
+	double lastTime = start;
+	uint_fast64_t lastCheckResults = l_CheckResults.load();
+	double lastCpuTime, rss;
+	GetResourceUsage(lastCpuTime, rss);
+
+	/* The first check interval schedules the checks randomly and isn't counted as sustained throughput. */
+	double warmup = (interval < duration / 2) ? interval : 0;
+	double warmupTime = 0;
+	uint_fast64_t warmupCheckResults = 0;
+	double peakRss = rss;
+
+	for (;;) {
+		double now = Utility::GetTime();
+
+		if (now - start >= duration)
+			break;
+
+		Utility::Sleep(std::min(reportInterval, start + duration - now));
+
+		now = Utility::GetTime();
+
+		uint_fast64_t checkResults = l_CheckResults.load();
+		double cpuTime;
+		GetResourceUsage(cpuTime, rss);
+
+		if (rss > peakRss)
+			peakRss = rss;
+
+		if (now - start <= warmup) {
+			warmupTime = now - start;
+			warmupCheckResults = checkResults;
+		}
+
+		Dictionary::Ptr sample = new Dictionary({
+			{ "time", now - start },
+			{ "check_results", checkResults },
+			{ "check_results_per_second", (checkResults - lastCheckResults) / (now - lastTime) },
+			{ "latency", CIB::GetHistogramStats(*l_Latency) },
+			{ "queues", GetQueueDepths() },
+			{ "cpu_usage", (cpuTime - lastCpuTime) / (now - lastTime) },
+			{ "rss", rss }
+		});
+
+		if (json)
+			std::cout << JsonEncode(sample) << "\n";
+		else
+			PrintSample(sample);
+
+		std::cout.flush();
+
+		lastTime = now;
+		lastCheckResults = checkResults;
+		lastCpuTime = cpuTime;
+	}
+
+	Dictionary::Ptr summary = new Dictionary({
+		{ "hosts", hosts },
+		{ "services", hosts * services },
+		{ "check_interval", interval },
+		{ "duration", lastTime - start },
+		{ "check_results", lastCheckResults },
+		{ "sustained_check_results_per_second", (lastCheckResults - warmupCheckResults) / (lastTime - start - warmupTime) },
+		{ "latency", CIB::GetHistogramStats(*l_Latency) },
+		{ "peak_rss", peakRss }
+	});
+
+	if (json)
+		std::cout << JsonEncode(new Dictionary({ { "summary", summary } })) << "\n";
+	else {
+		std::cout << "\n" "Sustained throughput: " << static_cast<long>(summary->Get("sustained_check_results_per_second"))
+			<< " check results/s (expected: " << static_cast<long>(hosts * (services + 1) / interval) << "), "
+			<< lastCheckResults << " check results in total, peak RSS "
+			<< static_cast<long>(peakRss / (1024 * 1024)) << " MB" "\n";
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,718 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "cli/benchclustercommand.hpp"
+#include "remote/jsonrpc.hpp"
+#include "remote/pkiutility.hpp"
+#include "base/application.hpp"
+#include "base/configwriter.hpp"
+#include "base/histogram.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include "base/tcpsocket.hpp"
+#include "base/tlsstream.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include "base/exception.hpp"
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#ifndef _WIN32
+#	include <unistd.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+namespace po = boost::program_options;
+
+REGISTER_CLICOMMAND("bench/cluster", BenchClusterCommand);
+
+/**
+ * An emulated endpoint. Child peers send check results for their hosts,
+ * the parent peer sends next check updates for the children's hosts
+ * which the endpoint under test relays (or logs for the replay).
+ */
+struct BenchClusterPeer
+{
+	String Name;
+	bool IsParent{false};
+	std::vector<String> Hosts;
+
+	boost::mutex Mutex;
+	TlsStream::Ptr Stream;
+	bool Connected{false};
+	double ConnectTime{0};
+	double ReconnectTime{0}; /* while disconnected by a reconnect storm */
+	double LastHeartbeat{0};
+	double LastLogPosition{0};
+	double RemoteLogPosition{0};
+	size_t NextHost{0};
+
+	/* Replay of the messages which were logged while we were disconnected. */
+	bool Replaying{false};
+	double LastReplayedMessage{0};
+	uint_fast64_t ReplayedMessages{0};
+};
+
+struct BenchClusterOptions
+{
+	String Target;
+	String Host;
+	String Port;
+	String CertDir;
+	double CheckResultRate;
+	double NextCheckRate;
+	double HeartbeatInterval;
+};
+
+static std::atomic<uint_fast64_t> l_SentMessages(0);
+static std::atomic<uint_fast64_t> l_ReceivedMessages(0);
+static std::atomic<uint_fast64_t> l_RelayedCheckResults(0);
+static std::atomic<uint_fast64_t> l_ReplayedMessages(0);
+static std::atomic<uint_fast64_t> l_Replays(0);
+static std::atomic<uint_fast64_t> l_Connects(0);
+static std::atomic<uint_fast64_t> l_ConnectFailures(0);
+static std::unique_ptr<Histogram> l_RelayLatency;
+static std::unique_ptr<Histogram> l_ReplayDuration;
+static std::unique_ptr<Histogram> l_ConnectDuration;
+static std::atomic<bool> l_Stopping(false);
+
+static String GetPeerName(int index)
+{
+	return "bench-endpoint-" + Convert::ToString(index);
+}
+
+static String GetPeerZone(int index)
+{
+	return "bench-zone-" + Convert::ToString(index);
+}
+
+static String GetHostName(int peer, int index)
+{
+	return GetPeerZone(peer) + "-host-" + Convert::ToString(index);
+}
+
+static void PrintObject(std::ostream& fp, const String& type, const String& name, const Dictionary::Ptr& attrs)
+{
+	fp << "object " << type << " ";
+	ConfigWriter::EmitString(fp, name);
+	fp << " {" "\n";
+
+	ObjectLock olock(attrs);
+
+	for (const Dictionary::Pair& kv : attrs) {
+		fp << "\t" << kv.first << " = ";
+		ConfigWriter::EmitValue(fp, 1, kv.second);
+		fp << "\n";
+	}
+
+	fp << "}" "\n" "\n";
+}
+
+/**
+ * Prints the zones.conf for the endpoint under test: its own zone is a
+ * child of the emulated parent zone and has one child zone per emulated
+ * endpoint.
+ */
+static void PrintConfig(std::ostream& fp, const String& target, int endpoints, int hosts)
+{
+	String targetZone = "bench-" + target;
+
+	PrintObject(fp, "Endpoint", "bench-parent", new Dictionary());
+	PrintObject(fp, "Zone", "bench-parent", new Dictionary({
+		{ "endpoints", new Array({ "bench-parent" }) }
+	}));
+
+	PrintObject(fp, "Endpoint", target, new Dictionary());
+	PrintObject(fp, "Zone", targetZone, new Dictionary({
+		{ "endpoints", new Array({ target }) },
+		{ "parent", "bench-parent" }
+	}));
+
+	for (int i = 0; i < endpoints; i++) {
+		PrintObject(fp, "Endpoint", GetPeerName(i), new Dictionary({
+			{ "log_duration", 3600 }
+		}));
+		PrintObject(fp, "Zone", GetPeerZone(i), new Dictionary({
+			{ "endpoints", new Array({ GetPeerName(i) }) },
+			{ "parent", targetZone }
+		}));
+
+		for (int k = 0; k < hosts; k++) {
+			PrintObject(fp, "Host", GetHostName(i, k), new Dictionary({
+				{ "check_command", "dummy" },
+				{ "enable_active_checks", false },
+				{ "zone", GetPeerZone(i) }
+			}));
+		}
+	}
+}
+
+/**
+ * Creates the key and a certificate signed by the local CA for an
+ * emulated endpoint unless they already exist.
+ */
+static bool EnsureCertificate(const String& certDir, const String& name)
+{
+	String keyPath = certDir + "/" + name + ".key";
+	String csrPath = certDir + "/" + name + ".csr";
+	String certPath = certDir + "/" + name + ".crt";
+
+	if (Utility::PathExists(keyPath) && Utility::PathExists(certPath))
+		return true;
+
+	if (MakeX509CSR(name, keyPath, csrPath) != 0)
+		return false;
+
+	return PkiUtility::SignCsr(csrPath, certPath) == 0;
+}
+
+/**
+ * Returns the CPU time (in seconds) and the RSS (in bytes) of another process.
+ */
+static bool GetProcessUsage(int pid, double& cpuTime, double& rss)
+{
+#ifdef __linux__
+	std::ifstream statfp(("/proc/" + Convert::ToString(pid) + "/stat").CStr());
+	std::string line;
+
+	if (!std::getline(statfp, line))
+		return false;
+
+	/* The process name may contain spaces; the fields after it are separated by single spaces. */
+	size_t pos = line.rfind(')');
+
+	if (pos == std::string::npos)
+		return false;
+
+	std::vector<String> fields = String(line.substr(pos + 2)).Split(" ");
+
+	/* utime and stime are fields 14 and 15, i.e. 12 and 13 after the process name. */
+	if (fields.size() < 13)
+		return false;
+
+	double ticks = sysconf(_SC_CLK_TCK);
+	cpuTime = (Convert::ToDouble(fields[11]) + Convert::ToDouble(fields[12])) / ticks;
+
+	std::ifstream statmfp(("/proc/" + Convert::ToString(pid) + "/statm").CStr());
+	long size, resident;
+
+	if (!(statmfp >> size >> resident))
+		return false;
+
+	rss = static_cast<double>(resident) * sysconf(_SC_PAGESIZE);
+
+	return true;
+#else /* __linux__ */
+	return false;
+#endif /* __linux__ */
+}
+
+static void SendPeerMessage(BenchClusterPeer& peer, const String& method, const Dictionary::Ptr& params)
+{
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", method },
+		{ "params", params }
+	});
+
+	try {
+		JsonRpc::SendMessage(peer.Stream, message);
+		l_SentMessages.fetch_add(1);
+	} catch (const std::exception& ex) {
+		Log(LogNotice, "cli")
+			<< "Could not send message to '" << peer.Name << "': " << DiagnosticInformation(ex, false);
+
+		peer.Stream->Close();
+		peer.Connected = false;
+	}
+}
+
+static void FinishReplay(BenchClusterPeer& peer)
+{
+	if (!peer.Replaying)
+		return;
+
+	peer.Replaying = false;
+
+	if (peer.ReplayedMessages == 0)
+		return;
+
+	l_Replays.fetch_add(1);
+	l_ReplayedMessages.fetch_add(peer.ReplayedMessages);
+	l_ReplayDuration->Record(peer.LastReplayedMessage - peer.ConnectTime);
+}
+
+static void ProcessPeerMessage(BenchClusterPeer& peer, const Dictionary::Ptr& message)
+{
+	l_ReceivedMessages.fetch_add(1);
+
+	double now = Utility::GetTime();
+	String method = message->Get("method");
+
+	boost::mutex::scoped_lock lock(peer.Mutex);
+
+	if (message->Contains("ts")) {
+		double ts = message->Get("ts");
+
+		if (ts > peer.RemoteLogPosition)
+			peer.RemoteLogPosition = ts;
+
+		/* Messages which were created before we connected come from the replay log. */
+		if (peer.Replaying && method != "log::SetLogPosition") {
+			if (ts < peer.ConnectTime) {
+				peer.ReplayedMessages++;
+				peer.LastReplayedMessage = now;
+			} else
+				FinishReplay(peer);
+		}
+	}
+
+	if (peer.IsParent && method == "event::CheckResult") {
+		Dictionary::Ptr params = message->Get("params");
+		Dictionary::Ptr cr = params ? params->Get("cr") : Dictionary::Ptr();
+
+		/* The child peers put their send time into the check result. */
+		if (cr) {
+			l_RelayedCheckResults.fetch_add(1);
+			l_RelayLatency->Record(now - static_cast<double>(cr->Get("execution_end")));
+		}
+	}
+}
+
+static void ConnectPeer(BenchClusterPeer& peer, const BenchClusterOptions& options)
+{
+	double start = Utility::GetTime();
+
+	TcpSocket::Ptr socket = new TcpSocket();
+	socket->Connect(options.Host, options.Port);
+
+	std::shared_ptr<SSL_CTX> sslContext = MakeSSLContext(options.CertDir + "/" + peer.Name + ".crt",
+		options.CertDir + "/" + peer.Name + ".key", options.CertDir + "/ca.crt");
+
+	TlsStream::Ptr stream = new TlsStream(socket, options.Target, RoleClient, sslContext);
+	stream->Handshake();
+
+	if (!stream->IsVerifyOK() || GetCertificateCN(stream->GetPeerCertificate()) != options.Target) {
+		stream->Close();
+		BOOST_THROW_EXCEPTION(std::runtime_error("Certificate validation failed for endpoint '" + options.Target + "'."));
+	}
+
+	double now = Utility::GetTime();
+	l_ConnectDuration->Record(now - start);
+
+	boost::mutex::scoped_lock lock(peer.Mutex);
+
+	peer.Stream = stream;
+	peer.Connected = true;
+	peer.ConnectTime = now;
+	peer.Replaying = true;
+	peer.ReplayedMessages = 0;
+
+	/* Older peers don't send any capabilities and get uncompressed JSON. */
+	SendPeerMessage(peer, "icinga::Hello", new Dictionary());
+}
+
+/**
+ * Connects the peer and reads its messages until the benchmark ends.
+ * The peer is reconnected when the connection was closed.
+ */
+static void PeerThreadProc(BenchClusterPeer& peer, const BenchClusterOptions& options)
+{
+	Utility::SetThreadName("Bench " + peer.Name);
+
+	while (!l_Stopping) {
+		{
+			boost::mutex::scoped_lock lock(peer.Mutex);
+
+			if (peer.ReconnectTime > Utility::GetTime()) {
+				lock.unlock();
+				Utility::Sleep(0.1);
+				continue;
+			}
+		}
+
+		try {
+			ConnectPeer(peer, options);
+			l_Connects.fetch_add(1);
+		} catch (const std::exception& ex) {
+			l_ConnectFailures.fetch_add(1);
+
+			Log(LogWarning, "cli")
+				<< "Could not connect '" << peer.Name << "': " << DiagnosticInformation(ex, false);
+
+			Utility::Sleep(1);
+			continue;
+		}
+
+		TlsStream::Ptr stream = peer.Stream;
+		StreamReadContext src;
+
+		try {
+			for (;;) {
+				String jsonString;
+				StreamReadStatus srs = JsonRpc::ReadMessage(stream, &jsonString, src, true);
+
+				if (srs == StatusEof)
+					break;
+
+				if (srs != StatusNewItem)
+					continue;
+
+				ProcessPeerMessage(peer, JsonRpc::DecodeMessage(jsonString));
+			}
+		} catch (const std::exception& ex) {
+			Log(LogNotice, "cli")
+				<< "Connection of '" << peer.Name << "' failed: " << DiagnosticInformation(ex, false);
+		}
+
+		boost::mutex::scoped_lock lock(peer.Mutex);
+		FinishReplay(peer);
+		peer.Connected = false;
+		stream->Close();
+	}
+}
+
+/**
+ * Sends the messages which are due for a peer.
+ */
+static void SendPeerMessages(BenchClusterPeer& peer, const BenchClusterOptions& options, double now, double elapsed)
+{
+	boost::mutex::scoped_lock lock(peer.Mutex);
+
+	if (!peer.Connected || peer.Hosts.empty())
+		return;
+
+	if (now - peer.LastHeartbeat >= options.HeartbeatInterval) {
+		SendPeerMessage(peer, "event::Heartbeat", new Dictionary({ { "timeout", 120 } }));
+		peer.LastHeartbeat = now;
+	}
+
+	if (now - peer.LastLogPosition >= 5 && peer.RemoteLogPosition > 0) {
+		SendPeerMessage(peer, "log::SetLogPosition", new Dictionary({ { "log_position", peer.RemoteLogPosition } }));
+		peer.LastLogPosition = now;
+	}
+
+	double rate = peer.IsParent ? options.NextCheckRate : options.CheckResultRate;
+
+	/* Spread the fractional part of the rate over the ticks. */
+	double expected = rate * elapsed;
+	int count = static_cast<int>(expected);
+
+	if (Utility::Random() % 1000 < (expected - count) * 1000)
+		count++;
+
+	for (int i = 0; i < count && peer.Connected; i++) {
+		const String& host = peer.Hosts[peer.NextHost];
+		peer.NextHost = (peer.NextHost + 1) % peer.Hosts.size();
+
+		if (peer.IsParent) {
+			SendPeerMessage(peer, "event::SetNextCheck", new Dictionary({
+				{ "host", host },
+				{ "next_check", now + 300 }
+			}));
+		} else {
+			SendPeerMessage(peer, "event::CheckResult", new Dictionary({
+				{ "host", host },
+				{ "cr", new Dictionary({
+					{ "type", "CheckResult" },
+					{ "active", true },
+					{ "check_source", peer.Name },
+					{ "command", new Array({ "bench" }) },
+					{ "execution_start", now },
+					{ "execution_end", now },
+					{ "schedule_start", now },
+					{ "schedule_end", now },
+					{ "exit_status", 0 },
+					{ "state", 0 },
+					{ "output", "OK - bench" },
+					{ "performance_data", new Array({ "time=0.001s;1;2;0" }) }
+				}) }
+			}));
+		}
+	}
+}
+
+String BenchClusterCommand::GetDescription() const
+{
+	return "Emulates endpoints which send cluster messages to an Icinga instance and reports the relay and replay performance.";
+}
+
+String BenchClusterCommand::GetShortDescription() const
+{
+	return "runs a cluster load test";
+}
+
+void BenchClusterCommand::InitParameters(boost::program_options::options_description& visibleDesc,
+	boost::program_options::options_description& hiddenDesc) const
+{
+	visibleDesc.add_options()
+		("target", po::value<std::string>(), "endpoint name of the Icinga instance under test")
+		("host", po::value<std::string>(), "address of the Icinga instance under test (defaults to the endpoint name)")
+		("port", po::value<std::string>()->default_value("5665"), "API port of the Icinga instance under test")
+		("endpoints", po::value<int>()->default_value(20), "number of emulated child endpoints")
+		("hosts", po::value<int>()->default_value(100), "number of hosts per child endpoint")
+		("check-result-rate", po::value<double>()->default_value(10), "check results per second and child endpoint")
+		("next-check-rate", po::value<double>()->default_value(100), "next check updates per second which the parent endpoint sends for the children's hosts")
+		("heartbeat-interval", po::value<double>()->default_value(10), "interval in seconds between heartbeats")
+		("reconnect-interval", po::value<double>()->default_value(0), "interval in seconds between reconnect storms (0 disables them)")
+		("reconnect-fraction", po::value<double>()->default_value(0.5), "fraction of the child endpoints which are disconnected by a reconnect storm")
+		("reconnect-delay", po::value<double>()->default_value(10), "time in seconds until disconnected endpoints reconnect")
+		("duration", po::value<double>()->default_value(60), "duration of the load test in seconds")
+		("report-interval", po::value<double>()->default_value(5), "interval in seconds between reports")
+		("cert-dir", po::value<std::string>(), "directory for the certificates of the emulated endpoints")
+		("pid", po::value<int>(), "PID of the Icinga instance under test, used to report its CPU usage and RSS")
+		("print-config", "print the zones configuration for the instance under test and exit")
+		("json", "print the reports as JSON objects, one per line")
+	;
+}
+
+std::vector<String> BenchClusterCommand::GetArgumentSuggestions(const String& argument, const String& word) const
+{
+	if (argument == "cert-dir")
+		return GetBashCompletionSuggestions("directory", word);
+	else
+		return CLICommand::GetArgumentSuggestions(argument, word);
+}
+
+/**
+ * The entry point for the "bench cluster" CLI command.
+ *
+ * @returns An exit status.
+ */
+int BenchClusterCommand::Run(const po::variables_map& vm, const std::vector<std::string>& ap) const
+{
+	if (!vm.count("target")) {
+		Log(LogCritical, "cli", "Please specify the endpoint name of the instance under test with --target.");
+		return EXIT_FAILURE;
+	}
+
+	BenchClusterOptions options;
+	options.Target = vm["target"].as<std::string>();
+	options.Host = vm.count("host") ? String(vm["host"].as<std::string>()) : options.Target;
+	options.Port = vm["port"].as<std::string>();
+	options.CertDir = vm.count("cert-dir") ? String(vm["cert-dir"].as<std::string>()) : Application::GetLocalStateDir() + "/lib/icinga2/bench-cluster";
+	options.CheckResultRate = vm["check-result-rate"].as<double>();
+	options.NextCheckRate = vm["next-check-rate"].as<double>();
+	options.HeartbeatInterval = vm["heartbeat-interval"].as<double>();
+
+	int endpoints = vm["endpoints"].as<int>();
+	int hosts = vm["hosts"].as<int>();
+	double reconnectInterval = vm["reconnect-interval"].as<double>();
+	double reconnectFraction = vm["reconnect-fraction"].as<double>();
+	double reconnectDelay = vm["reconnect-delay"].as<double>();
+	double duration = vm["duration"].as<double>();
+	double reportInterval = vm["report-interval"].as<double>();
+	bool json = vm.count("json");
+
+	if (endpoints < 1 || hosts < 1 || duration <= 0 || reportInterval <= 0 || options.HeartbeatInterval <= 0) {
+		Log(LogCritical, "cli", "The number of endpoints and hosts, the duration and the intervals must be greater than zero.");
+		return EXIT_FAILURE;
+	}
+
+	if (vm.count("print-config")) {
+		PrintConfig(std::cout, options.Target, endpoints, hosts);
+		return EXIT_SUCCESS;
+	}
+
+	/* Certificates are signed by the local CA, i.e. this has to run on the CA node. */
+	Utility::MkDirP(options.CertDir, 0700);
+
+	if (!Utility::PathExists(options.CertDir + "/ca.crt"))
+		Utility::CopyFile(GetIcingaCADir() + "/ca.crt", options.CertDir + "/ca.crt");
+
+	std::vector<std::unique_ptr<BenchClusterPeer> > peers;
+
+	for (int i = 0; i <= endpoints; i++) {
+		std::unique_ptr<BenchClusterPeer> peer(new BenchClusterPeer());
+
+		if (i < endpoints) {
+			peer->Name = GetPeerName(i);
+
+			for (int k = 0; k < hosts; k++)
+				peer->Hosts.push_back(GetHostName(i, k));
+		} else {
+			peer->Name = "bench-parent";
+			peer->IsParent = true;
+
+			for (int p = 0; p < endpoints; p++) {
+				for (int k = 0; k < hosts; k++)
+					peer->Hosts.push_back(GetHostName(p, k));
+			}
+		}
+
+		if (!EnsureCertificate(options.CertDir, peer->Name)) {
+			Log(LogCritical, "cli")
+				<< "Could not create a certificate for '" << peer->Name << "'.";
+			return EXIT_FAILURE;
+		}
+
+		peers.push_back(std::move(peer));
+	}
+
+	/* Histogram::Record() decays at most once per interval; this makes
+	 * the percentiles cover the whole load test. */
+	int decayInterval = static_cast<int>(duration) + 1;
+	l_RelayLatency.reset(new Histogram(decayInterval));
+	l_ReplayDuration.reset(new Histogram(decayInterval));
+	l_ConnectDuration.reset(new Histogram(decayInterval));
+
+	std::vector<boost::thread> threads;
+
+	for (const std::unique_ptr<BenchClusterPeer>& peer : peers)
+		threads.emplace_back(std::bind(&PeerThreadProc, std::ref(*peer), std::cref(options)));
+
+	int pid = vm.count("pid") ? vm["pid"].as<int>() : 0;
+	double lastCpuTime = 0, rss = 0;
+
+	if (pid)
+		GetProcessUsage(pid, lastCpuTime, rss);
+
+	double start = Utility::GetTime();
+	double lastTick = start;
+	double lastReport = start;
+	double nextStorm = reconnectInterval > 0 ? start + reconnectInterval : 0;
+	uint_fast64_t lastSent = 0, lastReceived = 0;
+
+	for (;;) {
+		Utility::Sleep(0.01);
+
+		double now = Utility::GetTime();
+
+		if (now - start >= duration)
+			break;
+
+		for (const std::unique_ptr<BenchClusterPeer>& peer : peers)
+			SendPeerMessages(*peer, options, now, now - lastTick);
+
+		lastTick = now;
+
+		if (nextStorm > 0 && now >= nextStorm) {
+			int count = static_cast<int>(endpoints * reconnectFraction);
+
+			Log(LogInformation, "cli")
+				<< "Disconnecting " << count << " endpoints for " << reconnectDelay << " seconds.";
+
+			for (int i = 0; i < count; i++) {
+				BenchClusterPeer& peer = *peers[Utility::Random() % endpoints];
+
+				boost::mutex::scoped_lock lock(peer.Mutex);
+
+				if (peer.Connected)
+					peer.Stream->Close();
+
+				peer.ReconnectTime = now + reconnectDelay;
+			}
+
+			nextStorm = now + reconnectInterval;
+		}
+
+		if (now - lastReport < reportInterval)
+			continue;
+
+		int connected = 0;
+
+		for (const std::unique_ptr<BenchClusterPeer>& peer : peers) {
+			boost::mutex::scoped_lock lock(peer->Mutex);
+
+			if (peer->Connected)
+				connected++;
+		}
+
+		uint_fast64_t sent = l_SentMessages.load();
+		uint_fast64_t received = l_ReceivedMessages.load();
+
+		Dictionary::Ptr sample = new Dictionary({
+			{ "time", now - start },
+			{ "connected_endpoints", connected },
+			{ "connects", l_Connects.load() },
+			{ "connect_failures", l_ConnectFailures.load() },
+			{ "sent_messages_per_second", (sent - lastSent) / (now - lastReport) },
+			{ "received_messages_per_second", (received - lastReceived) / (now - lastReport) },
+			{ "relayed_check_results", l_RelayedCheckResults.load() },
+			{ "relay_latency", new Dictionary({
+				{ "p50", l_RelayLatency->GetPercentile(50) },
+				{ "p95", l_RelayLatency->GetPercentile(95) },
+				{ "p99", l_RelayLatency->GetPercentile(99) }
+			}) },
+			{ "replays", l_Replays.load() },
+			{ "replayed_messages", l_ReplayedMessages.load() },
+			{ "replay_duration", new Dictionary({
+				{ "p50", l_ReplayDuration->GetPercentile(50) },
+				{ "max", l_ReplayDuration->GetMax() }
+			}) },
+			{ "connect_duration_p99", l_ConnectDuration->GetPercentile(99) }
+		});
+
+		double cpuTime;
+
+		if (pid && GetProcessUsage(pid, cpuTime, rss)) {
+			sample->Set("target_cpu_usage", (cpuTime - lastCpuTime) / (now - lastReport));
+			sample->Set("target_rss", rss);
+			lastCpuTime = cpuTime;
+		}
+
+		if (json) {
+			std::cout << JsonEncode(sample) << "\n";
+		} else {
+			Dictionary::Ptr relayLatency = sample->Get("relay_latency");
+
+			std::cout << "[" << Utility::FormatDuration(now - start) << "] "
+				<< connected << "/" << peers.size() << " endpoints connected, "
+				<< static_cast<long>(sample->Get("sent_messages_per_second")) << " messages/s sent, "
+				<< static_cast<long>(sample->Get("received_messages_per_second")) << " messages/s received, "
+				<< "relay latency p50/p95/p99 " << relayLatency->Get("p50") << "/" << relayLatency->Get("p95")
+				<< "/" << relayLatency->Get("p99") << "s, "
+				<< l_Replays.load() << " replays (" << l_ReplayedMessages.load() << " messages, max "
+				<< l_ReplayDuration->GetMax() << "s)";
+
+			if (sample->Contains("target_cpu_usage")) {
+				std::cout << ", target CPU " << static_cast<long>(static_cast<double>(sample->Get("target_cpu_usage")) * 100)
+					<< "%, RSS " << static_cast<long>(rss / (1024 * 1024)) << " MB";
+			}
+
+			std::cout << "\n";
+		}
+
+		std::cout.flush();
+
+		lastReport = now;
+		lastSent = sent;
+		lastReceived = received;
+	}
+
+	l_Stopping = true;
+
+	for (const std::unique_ptr<BenchClusterPeer>& peer : peers) {
+		boost::mutex::scoped_lock lock(peer->Mutex);
+
+		if (peer->Connected)
+			peer->Stream->Close();
+
+		/* Don't reconnect while the threads are shutting down. */
+		peer->ReconnectTime = Utility::GetTime() + 3600;
+	}
+
+	for (boost::thread& thread : threads)
+		thread.join();
+
+	return EXIT_SUCCESS;
+}
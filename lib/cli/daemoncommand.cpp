@@ -24,6 +24,7 @@
 #include "config/configcompiler.hpp"
 #include "config/configcompilercontext.hpp"
 #include "config/configitembuilder.hpp"
+#include "config/configprofiler.hpp"
 #include "base/logger.hpp"
 #include "base/application.hpp"
 #include "base/timer.hpp"
@@ -32,6 +33,7 @@
 #include "base/convert.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/context.hpp"
+#include "base/startuptimeline.hpp"
 #include "config.h"
 #include <boost/program_options.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -52,6 +54,12 @@ static void SigHupHandler(int)
 }
 #endif /* _WIN32 */
 
+static void ReloadValidatedHandler()
+{
+	if (!ConfigItem::ReloadObjects(Application::GetObjectsPath()))
+		Application::SetLastReloadFailed(Utility::GetTime());
+}
+
 static bool Daemonize()
 {
 #ifndef _WIN32
@@ -156,6 +164,7 @@ void DaemonCommand::InitParameters(boost::program_options::options_description&
 		("config,c", po::value<std::vector<std::string> >(), "parse a configuration file")
 		("no-config,z", "start without a configuration file")
 		("validate,C", "exit after validating the configuration")
+		("profile", po::value<std::string>()->implicit_value(""), "profile the config compilation and write a report to the specified path prefix")
 		("errorlog,e", po::value<std::string>(), "log fatal errors to the specified log file (only works in combination with --daemonize)")
 #ifndef _WIN32
 		("daemonize,d", "detach from the controlling terminal")
@@ -170,7 +179,7 @@ void DaemonCommand::InitParameters(boost::program_options::options_description&
 
 std::vector<String> DaemonCommand::GetArgumentSuggestions(const String& argument, const String& word) const
 {
-	if (argument == "config" || argument == "errorlog")
+	if (argument == "config" || argument == "errorlog" || argument == "profile")
 		return GetBashCompletionSuggestions("file", word);
 	else
 		return CLICommand::GetArgumentSuggestions(argument, word);
@@ -211,11 +220,26 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 
 	std::vector<ConfigItem::Ptr> newItems;
 
-	if (!DaemonUtility::LoadConfigFiles(configs, newItems, Application::GetObjectsPath(), Application::GetVarsPath()))
+	if (vm.count("profile"))
+		ConfigProfiler::Enable();
+
+	bool loaded = DaemonUtility::LoadConfigFiles(configs, newItems, Application::GetObjectsPath(), Application::GetVarsPath());
+
+	if (vm.count("profile")) {
+		String profilePrefix = vm["profile"].as<std::string>();
+
+		if (profilePrefix.IsEmpty())
+			profilePrefix = Utility::DirName(Application::GetObjectsPath()) + "/config-profile";
+
+		ConfigProfiler::WriteFiles(profilePrefix);
+	}
+
+	if (!loaded)
 		return EXIT_FAILURE;
 
 	if (vm.count("validate")) {
 		Log(LogInformation, "cli", "Finished validating the configuration file(s).");
+		StartupTimeline::Finish();
 		return EXIT_SUCCESS;
 	}
 
@@ -231,8 +255,13 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		}
 
 		double start = Utility::GetTime();
-		while (kill(vm["reload-internal"].as<int>(), SIGCHLD) == 0)
-			Utility::Sleep(0.2);
+
+		{
+			StartupPhase phase("takeover");
+
+			while (kill(vm["reload-internal"].as<int>(), SIGCHLD) == 0)
+				Utility::Sleep(0.2);
+		}
 
 		Log(LogNotice, "cli")
 			<< "Waited for " << Utility::FormatDuration(Utility::GetTime() - start) << " on old process to exit.";
@@ -253,6 +282,7 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 
 	/* restore the previous program state */
 	try {
+		StartupPhase phase("state restore");
 		ConfigObject::RestoreObjects(Application::GetStatePath());
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "cli")
@@ -264,6 +294,8 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		WorkQueue upq(25000, Application::GetConcurrency());
 		upq.SetName("DaemonCommand::Run");
 
+		StartupPhase phase("activation");
+
 		// activate config only after daemonization: it starts threads and that is not compatible with fork()
 		if (!ConfigItem::ActivateItems(upq, newItems, false, false, true)) {
 			Log(LogCritical, "cli", "Error activating configuration.");
@@ -290,7 +322,11 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 	sigaction(SIGHUP, &sa, nullptr);
 #endif /* _WIN32 */
 
+	Application::OnReloadValidated.connect(&ReloadValidatedHandler);
+
 	ApiListener::UpdateObjectAuthority();
 
+	StartupTimeline::Finish();
+
 	return Application::GetInstance()->Run();
 }
@@ -23,6 +23,9 @@
 #include "base/application.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configcompilercontext.hpp"
+#include "config/configcache.hpp"
+#include "config/configprofiler.hpp"
+#include "base/startuptimeline.hpp"
 #include "config/configitembuilder.hpp"
 
 
@@ -51,9 +54,9 @@ static void IncludeZoneDirRecursive(const String& path, const String& package, b
 	/* register this zone path for cluster config sync */
 	ConfigCompiler::RegisterZoneDir("_etc", path, zoneName);
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(path, "*.conf", std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zoneName, package), GlobFile);
-	DictExpression expr(std::move(expressions));
+	std::vector<String> paths;
+	ConfigCache::GlobRecursive(path, "*.conf", std::bind(&ConfigCompiler::CollectIncludes, std::ref(paths), _1), GlobFile);
+	DictExpression expr(ConfigCompiler::CompileIncludes(paths, zoneName, package));
 	if (!ExecuteExpression(&expr))
 		success = false;
 }
@@ -68,15 +71,15 @@ static void IncludeNonLocalZone(const String& zonePath, const String& package, b
 	/* Check whether this node already has an authoritative config version
 	 * from zones.d in etc or api package directory, or a local marker file)
 	 */
-	if (ConfigCompiler::HasZoneConfigAuthority(zoneName) || Utility::PathExists(zonePath + "/.authoritative")) {
+	if (ConfigCompiler::HasZoneConfigAuthority(zoneName) || ConfigCache::PathExists(zonePath + "/.authoritative")) {
 		Log(LogNotice, "config")
 			<< "Ignoring non local config include for zone '" << zoneName << "': We already have an authoritative copy included.";
 		return;
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(zonePath, "*.conf", std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zoneName, package), GlobFile);
-	DictExpression expr(std::move(expressions));
+	std::vector<String> paths;
+	ConfigCache::GlobRecursive(zonePath, "*.conf", std::bind(&ConfigCompiler::CollectIncludes, std::ref(paths), _1), GlobFile);
+	DictExpression expr(ConfigCompiler::CompileIncludes(paths, zoneName, package));
 	if (!ExecuteExpression(&expr))
 		success = false;
 }
@@ -87,7 +90,7 @@ static void IncludePackage(const String& packagePath, bool& success)
 	 * for config sync inside their generated config. */
 	String packageName = Utility::BaseName(packagePath);
 
-	if (Utility::PathExists(packagePath + "/include.conf")) {
+	if (ConfigCache::PathExists(packagePath + "/include.conf")) {
 		std::unique_ptr<Expression> expr = ConfigCompiler::CompileFile(packagePath + "/include.conf",
 			String(), packageName);
 
@@ -122,8 +125,8 @@ bool DaemonUtility::ValidateConfigFiles(const std::vector<std::string>& configs,
 	success = true;
 
 	String zonesEtcDir = Application::GetZonesDir();
-	if (!zonesEtcDir.IsEmpty() && Utility::PathExists(zonesEtcDir))
-		Utility::Glob(zonesEtcDir + "/*", std::bind(&IncludeZoneDirRecursive, _1, "_etc", std::ref(success)), GlobDirectory);
+	if (!zonesEtcDir.IsEmpty() && ConfigCache::PathExists(zonesEtcDir))
+		ConfigCache::Glob(zonesEtcDir + "/*", std::bind(&IncludeZoneDirRecursive, _1, "_etc", std::ref(success)), GlobDirectory);
 
 	if (!success)
 		return false;
@@ -131,16 +134,16 @@ bool DaemonUtility::ValidateConfigFiles(const std::vector<std::string>& configs,
 	/* Load package config files - they may contain additional zones which
 	 * are authoritative on this node and are checked in HasZoneConfigAuthority(). */
 	String packagesVarDir = Application::GetLocalStateDir() + "/lib/icinga2/api/packages";
-	if (Utility::PathExists(packagesVarDir))
-		Utility::Glob(packagesVarDir + "/*", std::bind(&IncludePackage, _1, std::ref(success)), GlobDirectory);
+	if (ConfigCache::PathExists(packagesVarDir))
+		ConfigCache::Glob(packagesVarDir + "/*", std::bind(&IncludePackage, _1, std::ref(success)), GlobDirectory);
 
 	if (!success)
 		return false;
 
 	/* Load cluster synchronized configuration files */
 	String zonesVarDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones";
-	if (Utility::PathExists(zonesVarDir))
-		Utility::Glob(zonesVarDir + "/*", std::bind(&IncludeNonLocalZone, _1, "_cluster", std::ref(success)), GlobDirectory);
+	if (ConfigCache::PathExists(zonesVarDir))
+		ConfigCache::Glob(zonesVarDir + "/*", std::bind(&IncludeNonLocalZone, _1, "_cluster", std::ref(success)), GlobDirectory);
 
 	if (!success)
 		return false;
@@ -165,18 +168,61 @@ bool DaemonUtility::LoadConfigFiles(const std::vector<std::string>& configs,
 {
 	ActivationScope ascope;
 
-	if (!DaemonUtility::ValidateConfigFiles(configs, objectsFile)) {
-		ConfigCompilerContext::GetInstance()->CancelObjectsFile();
-		return false;
-	}
+	String cachePath = ConfigCache::GetCachePath();
+	ConfigCache cache;
 
-	WorkQueue upq(25000, Application::GetConcurrency());
-	upq.SetName("DaemonUtility::LoadConfigFiles");
-	bool result = ConfigItem::CommitItems(ascope.GetContext(), upq, newItems);
+	if (!cachePath.IsEmpty() && cache.Load(cachePath)) {
+		if (!objectsFile.IsEmpty())
+			ConfigCompilerContext::GetInstance()->OpenObjectsFile(objectsFile);
 
-	if (!result) {
-		ConfigCompilerContext::GetInstance()->CancelObjectsFile();
-		return false;
+		WorkQueue upq(25000, Application::GetConcurrency());
+		upq.SetName("DaemonUtility::LoadConfigFiles");
+
+		StartupPhase phase("config cache restore");
+
+		if (!cache.Restore(ascope.GetContext(), upq, newItems)) {
+			Log(LogCritical, "cli")
+				<< "Could not restore the config from the config cache '" << cachePath << "'. Removing the cache.";
+			unlink(cachePath.CStr());
+			ConfigCompilerContext::GetInstance()->CancelObjectsFile();
+			return false;
+		}
+	} else {
+		if (!cachePath.IsEmpty())
+			ConfigCache::BeginRecording();
+
+		bool result;
+
+		{
+			ConfigProfilerScope profile("stage", "Evaluate configuration", true);
+			StartupPhase phase("config parse");
+			result = DaemonUtility::ValidateConfigFiles(configs, objectsFile);
+		}
+
+		if (!result) {
+			ConfigCache::EndRecording();
+			ConfigCompilerContext::GetInstance()->CancelObjectsFile();
+			return false;
+		}
+
+		WorkQueue upq(25000, Application::GetConcurrency());
+		upq.SetName("DaemonUtility::LoadConfigFiles");
+
+		{
+			StartupPhase phase("commit");
+			result = ConfigItem::CommitItems(ascope.GetContext(), upq, newItems);
+		}
+
+		if (!result) {
+			ConfigCache::EndRecording();
+			ConfigCompilerContext::GetInstance()->CancelObjectsFile();
+			return false;
+		}
+
+		if (!cachePath.IsEmpty()) {
+			ConfigCache::Save(cachePath, newItems);
+			ConfigCache::EndRecording();
+		}
 	}
 
 	ConfigCompilerContext::GetInstance()->FinishObjectsFile();
@@ -0,0 +1,259 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "cli/debugmemorycommand.hpp"
+#include "remote/apiclient.hpp"
+#include "remote/url.hpp"
+#include "base/application.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace icinga;
+namespace po = boost::program_options;
+
+REGISTER_CLICOMMAND("debug/memory", DebugMemoryCommand);
+
+String DebugMemoryCommand::GetDescription() const
+{
+	return "Shows the memory usage of a running Icinga 2 instance by object type.";
+}
+
+String DebugMemoryCommand::GetShortDescription() const
+{
+	return "shows memory usage by object type";
+}
+
+ImpersonationLevel DebugMemoryCommand::GetImpersonationLevel() const
+{
+	return ImpersonateNone;
+}
+
+void DebugMemoryCommand::InitParameters(boost::program_options::options_description& visibleDesc,
+	boost::program_options::options_description& hiddenDesc) const
+{
+	visibleDesc.add_options()
+		("connect,c", po::value<std::string>(), "API URL of the Icinga 2 instance (defaults to https://localhost:5665/)")
+		("sort", po::value<std::string>()->default_value("bytes"), "sort types by 'bytes', 'live' or 'created'")
+		("limit", po::value<int>()->default_value(25), "number of types to show (0 shows all)")
+		("sites", "show the sampled allocation sites of each type")
+		("json", "print the raw status as JSON");
+}
+
+static String FormatBytes(double bytes)
+{
+	static const char * const units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+	size_t unit = 0;
+
+	while (bytes >= 1024 && unit < sizeof(units) / sizeof(units[0]) - 1) {
+		bytes /= 1024;
+		unit++;
+	}
+
+	std::ostringstream msgbuf;
+	msgbuf << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << " " << units[unit];
+	return msgbuf.str();
+}
+
+static void PrintMemoryStatus(const Dictionary::Ptr& status, const String& sortKey, int limit, bool showSites)
+{
+	Dictionary::Ptr process = status->Get("process");
+
+	if (process) {
+		std::cout << "Process: " << FormatBytes(process->Get("rss")) << " resident, "
+			<< FormatBytes(process->Get("virtual")) << " virtual\n";
+	}
+
+	Dictionary::Ptr heap = status->Get("heap");
+
+	if (heap) {
+		std::cout << "Heap: " << FormatBytes(heap->Get("in_use")) << " in use, "
+			<< FormatBytes(heap->Get("free")) << " free\n";
+	}
+
+	Dictionary::Ptr types = status->Get("types");
+
+	if (!status->Get("accounting").ToBool() || !types) {
+		Dictionary::Ptr configObjects = status->Get("config_objects");
+
+		if (configObjects) {
+			std::cout << "\n" << std::left << std::setw(40) << "Config type" << std::right << std::setw(12) << "Objects" << "\n";
+
+			ObjectLock olock(configObjects);
+			for (const Dictionary::Pair& kv : configObjects) {
+				if (kv.second != 0)
+					std::cout << std::left << std::setw(40) << kv.first << std::right << std::setw(12) << kv.second << "\n";
+			}
+		}
+
+		std::cout << "\nPer-type object accounting is not available. Rebuild Icinga 2 with "
+			<< "-DICINGA2_WITH_MEMORY_ACCOUNTING=ON to enable it.\n";
+		return;
+	}
+
+	Dictionary::Ptr objects = status->Get("objects");
+
+	if (objects) {
+		double bytes = objects->Get("bytes");
+
+		std::cout << "Objects: " << objects->Get("live") << " live, " << FormatBytes(bytes);
+
+		double heapInUse = heap ? static_cast<double>(heap->Get("in_use")) : 0;
+
+		if (heapInUse > 0)
+			std::cout << " (" << std::fixed << std::setprecision(1) << bytes * 100 / heapInUse << "% of the heap in use)";
+
+		std::cout << "\n";
+	}
+
+	std::vector<std::pair<String, Dictionary::Ptr> > sorted;
+
+	{
+		ObjectLock olock(types);
+		for (const Dictionary::Pair& kv : types)
+			sorted.emplace_back(kv.first, kv.second);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [&sortKey](const std::pair<String, Dictionary::Ptr>& a,
+		const std::pair<String, Dictionary::Ptr>& b) {
+		return a.second->Get(sortKey) > b.second->Get(sortKey);
+	});
+
+	if (limit > 0 && sorted.size() > static_cast<size_t>(limit))
+		sorted.resize(limit);
+
+	std::cout << "\n" << std::left << std::setw(50) << "Type" << std::right
+		<< std::setw(12) << "Live" << std::setw(14) << "Created"
+		<< std::setw(12) << "Bytes" << std::setw(10) << "Avg" << "\n";
+
+	for (const auto& kv : sorted) {
+		const Dictionary::Ptr& type = kv.second;
+
+		std::cout << std::left << std::setw(50) << kv.first << std::right
+			<< std::setw(12) << type->Get("live") << std::setw(14) << type->Get("created")
+			<< std::setw(12) << FormatBytes(type->Get("bytes"))
+			<< std::setw(10) << std::fixed << std::setprecision(0) << static_cast<double>(type->Get("avg_bytes")) << "\n";
+
+		if (!showSites)
+			continue;
+
+		Array::Ptr sites = type->Get("sites");
+
+		if (!sites)
+			continue;
+
+		ObjectLock olock(sites);
+		for (const Dictionary::Ptr& site : sites)
+			std::cout << "    " << std::setw(8) << site->Get("sampled") << "  " << site->Get("site") << "\n";
+	}
+}
+
+/**
+ * The entry point for the "debug memory" CLI command.
+ *
+ * @returns An exit status.
+ */
+int DebugMemoryCommand::Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const
+{
+	String sortKey = vm["sort"].as<std::string>();
+
+	if (sortKey != "bytes" && sortKey != "live" && sortKey != "created") {
+		Log(LogCritical, "cli")
+			<< "Invalid sort key '" << sortKey << "'. Use 'bytes', 'live' or 'created'.";
+		return EXIT_FAILURE;
+	}
+
+	String addr = "https://localhost:5665/";
+
+	const char *addrEnv = getenv("ICINGA2_API_URL");
+	if (addrEnv)
+		addr = addrEnv;
+
+	if (vm.count("connect"))
+		addr = vm["connect"].as<std::string>();
+
+	Url::Ptr url;
+
+	try {
+		url = new Url(addr);
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "cli", ex.what());
+		return EXIT_FAILURE;
+	}
+
+	const char *usernameEnv = getenv("ICINGA2_API_USERNAME");
+	const char *passwordEnv = getenv("ICINGA2_API_PASSWORD");
+
+	if (usernameEnv)
+		url->SetUsername(usernameEnv);
+	if (passwordEnv)
+		url->SetPassword(passwordEnv);
+
+	if (url->GetPort().IsEmpty())
+		url->SetPort("5665");
+
+	ApiClient::Ptr client = new ApiClient(url->GetHost(), url->GetPort(), url->GetUsername(), url->GetPassword());
+
+	boost::mutex mutex;
+	boost::condition_variable cv;
+	bool ready = false;
+	boost::exception_ptr eptr;
+	Dictionary::Ptr status;
+
+	client->GetStatus("Memory", [&mutex, &cv, &ready, &eptr, &status](boost::exception_ptr ex, const Dictionary::Ptr& result) {
+		boost::mutex::scoped_lock lock(mutex);
+		eptr = ex;
+		status = result;
+		ready = true;
+		cv.notify_all();
+	});
+
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		while (!ready)
+			cv.wait(lock);
+	}
+
+	if (eptr) {
+		try {
+			boost::rethrow_exception(eptr);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "cli")
+				<< "HTTP query failed: " << ex.what();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!status) {
+		Log(LogCritical, "cli", "The instance did not return a memory status.");
+		return EXIT_FAILURE;
+	}
+
+	if (vm.count("json"))
+		std::cout << JsonEncode(status, true) << "\n";
+	else
+		PrintMemoryStatus(status, sortKey, vm["limit"].as<int>(), vm.count("sites"));
+
+	return EXIT_SUCCESS;
+}
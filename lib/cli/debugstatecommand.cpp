@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "cli/debugstatecommand.hpp"
+#include "base/statefile.hpp"
+#include "base/application.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include "base/exception.hpp"
+#include <iostream>
+
+using namespace icinga;
+namespace po = boost::program_options;
+
+REGISTER_CLICOMMAND("debug/state", DebugStateCommand);
+
+String DebugStateCommand::GetDescription() const
+{
+	return "Prints the records of a state file or its journal as JSON, one record per line.";
+}
+
+String DebugStateCommand::GetShortDescription() const
+{
+	return "prints the state file as JSON";
+}
+
+int DebugStateCommand::GetMinArguments() const
+{
+	return 0;
+}
+
+int DebugStateCommand::GetMaxArguments() const
+{
+	return -1;
+}
+
+ImpersonationLevel DebugStateCommand::GetImpersonationLevel() const
+{
+	return ImpersonateIcinga;
+}
+
+void DebugStateCommand::InitParameters(boost::program_options::options_description& visibleDesc,
+	boost::program_options::options_description& hiddenDesc) const
+{
+	visibleDesc.add_options()
+		("type", po::value<std::string>(), "only print the records of objects with this type")
+		("name", po::value<std::string>(), "only print the records of objects with this name");
+}
+
+/**
+ * The entry point for the "debug state" CLI command.
+ *
+ * @returns An exit status.
+ */
+int DebugStateCommand::Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const
+{
+	std::vector<std::string> paths = ap;
+
+	if (paths.empty()) {
+		paths.push_back(Application::GetStatePath());
+
+		String journalPath = Application::GetStatePath() + ".journal";
+
+		if (Utility::PathExists(journalPath))
+			paths.push_back(journalPath);
+	}
+
+	String type, name;
+
+	if (vm.count("type"))
+		type = vm["type"].as<std::string>();
+
+	if (vm.count("name"))
+		name = vm["name"].as<std::string>();
+
+	for (const std::string& path : paths) {
+		try {
+			StateFileView view(path);
+
+			for (const auto& record : view.GetRecords()) {
+				Value value = StateFile::DecodeRecord(String(record.first, record.first + record.second));
+
+				if (value.IsObjectType<Dictionary>()) {
+					Dictionary::Ptr persistentObject = value;
+
+					if (!type.IsEmpty() && persistentObject->Get("type") != type)
+						continue;
+
+					if (!name.IsEmpty() && persistentObject->Get("name") != name)
+						continue;
+				}
+
+				std::cout << JsonEncode(value) << "\n";
+			}
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "cli")
+				<< "Could not decode state file '" << path << "': " << DiagnosticInformation(ex, false);
+			return 1;
+		}
+	}
+
+	return 0;
+}
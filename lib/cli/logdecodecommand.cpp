@@ -0,0 +1,117 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "cli/logdecodecommand.hpp"
+#include "base/binaryfilelogger.hpp"
+#include "base/streamlogger.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include <fstream>
+#include <iostream>
+
+using namespace icinga;
+namespace po = boost::program_options;
+
+REGISTER_CLICOMMAND("log/decode", LogDecodeCommand);
+
+String LogDecodeCommand::GetDescription() const
+{
+	return "Converts log files which were written by a BinaryFileLogger to text.";
+}
+
+String LogDecodeCommand::GetShortDescription() const
+{
+	return "decodes binary log files";
+}
+
+int LogDecodeCommand::GetMinArguments() const
+{
+	return 1;
+}
+
+int LogDecodeCommand::GetMaxArguments() const
+{
+	return -1;
+}
+
+void LogDecodeCommand::InitParameters(boost::program_options::options_description& visibleDesc,
+	boost::program_options::options_description& hiddenDesc) const
+{
+	visibleDesc.add_options()
+		("severity", po::value<std::string>(), "minimum severity of the log entries (debug, notice, information, warning or critical)")
+		("facility", po::value<std::string>(), "only show log entries for this facility")
+	;
+}
+
+/**
+ * The entry point for the "log decode" CLI command.
+ *
+ * @returns An exit status.
+ */
+int LogDecodeCommand::Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const
+{
+	LogSeverity minSeverity = LogDebug;
+
+	if (vm.count("severity")) {
+		try {
+			minSeverity = Logger::StringToSeverity(vm["severity"].as<std::string>());
+		} catch (const std::exception&) {
+			Log(LogCritical, "cli")
+				<< "Invalid severity: " << vm["severity"].as<std::string>();
+			return 1;
+		}
+	}
+
+	String facility;
+
+	if (vm.count("facility"))
+		facility = vm["facility"].as<std::string>();
+
+	for (const std::string& path : ap) {
+		std::ifstream fp;
+		fp.open(path.c_str(), std::ifstream::in | std::ifstream::binary);
+
+		if (!fp) {
+			Log(LogCritical, "cli")
+				<< "Could not open log file '" << path << "'.";
+			return 1;
+		}
+
+		std::vector<String> facilities;
+		LogEntry entry;
+
+		try {
+			while (BinaryFileLogger::ReadLogEntry(fp, facilities, entry)) {
+				if (entry.Severity < minSeverity)
+					continue;
+
+				if (!facility.IsEmpty() && entry.Facility != facility)
+					continue;
+
+				StreamLogger::ProcessLogEntry(std::cout, entry);
+			}
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "cli")
+				<< "Could not decode log file '" << path << "': " << DiagnosticInformation(ex, false);
+			return 1;
+		}
+	}
+
+	return 0;
+}
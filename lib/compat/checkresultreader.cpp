@@ -32,7 +32,12 @@
 #include "base/exception.hpp"
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
+#include <algorithm>
 #include <fstream>
+#ifdef __linux__
+#	include <poll.h>
+#	include <sys/inotify.h>
+#endif /* __linux__ */
 
 using namespace icinga;
 
@@ -65,7 +70,20 @@ void CheckResultReader::Start(bool runtimeCreated)
 		<< "The CheckResultReader feature is DEPRECATED and will be removed in Icinga v2.11.";
 
 #ifndef _WIN32
-	m_ReadTimer = new Timer();
+	m_WorkQueue.reset(new WorkQueue(0, Application::GetConcurrency()));
+	m_WorkQueue->SetName("CheckResultReader, " + GetName());
+	m_WorkQueue->SetExceptionCallback([](boost::exception_ptr exp) {
+		Log(LogCritical, "CheckResultReader")
+			<< "Failed to process check result file: " << DiagnosticInformation(exp);
+	});
+
+#ifdef __linux__
+	m_Stopped = false;
+	m_NotifyThread = std::thread(std::bind(&CheckResultReader::NotifyThreadProc, this));
+#endif /* __linux__ */
+
+	/* With inotify the timer only picks up files whose events were missed. */
+	m_ReadTimer = new Timer("CheckResultReader");
 	m_ReadTimer->OnTimerExpired.connect(std::bind(&CheckResultReader::ReadTimerHandler, this));
 	m_ReadTimer->SetInterval(5);
 	m_ReadTimer->Start();
@@ -80,20 +98,155 @@ void CheckResultReader::Stop(bool runtimeRemoved)
 	Log(LogInformation, "CheckResultReader")
 		<< "'" << GetName() << "' stopped.";
 
+#ifndef _WIN32
+	m_ReadTimer->Stop(true);
+
+#ifdef __linux__
+	m_Stopped = true;
+
+	if (m_NotifyThread.joinable())
+		m_NotifyThread.join();
+#endif /* __linux__ */
+#endif /* _WIN32 */
+
 	ObjectImpl<CheckResultReader>::Stop(runtimeRemoved);
 }
 
+#ifndef _WIN32
 /**
  * @threadsafety Always.
  */
 void CheckResultReader::ReadTimerHandler() const
 {
+	ProcessSpoolDir();
+}
+
+#ifdef __linux__
+/**
+ * Processes the spool directory as soon as a check result file has been
+ * completed, i.e. its ".ok" file has been written or moved there.
+ */
+void CheckResultReader::NotifyThreadProc() const
+{
+	Utility::SetThreadName("CheckResultReader");
+
+	String spoolDir = GetSpoolDir();
+
+	int fd = inotify_init1(IN_CLOEXEC);
+
+	if (fd < 0) {
+		Log(LogWarning, "CheckResultReader")
+			<< "inotify_init1() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		return;
+	}
+
+	if (inotify_add_watch(fd, spoolDir.CStr(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		Log(LogWarning, "CheckResultReader")
+			<< "inotify_add_watch() for spool directory '" << spoolDir << "' failed with error code "
+			<< errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		close(fd);
+		return;
+	}
+
+	while (!m_Stopped) {
+		pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+
+		/* Wake up regularly to check whether the component was stopped. */
+		int rc = poll(&pfd, 1, 500);
+
+		if (rc <= 0)
+			continue;
+
+		char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+		ssize_t len = read(fd, buffer, sizeof(buffer));
+
+		if (len <= 0)
+			continue;
+
+		bool completed = false;
+
+		for (char *ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + reinterpret_cast<inotify_event *>(ptr)->len) {
+			auto *event = reinterpret_cast<inotify_event *>(ptr);
+
+			if (event->len == 0)
+				continue;
+
+			String name = event->name;
+
+			if (name.GetLength() == 10 && name[0] == 'c' && name.SubStr(7) == ".ok")
+				completed = true;
+		}
+
+		/* Events for files which are processed by this run are coalesced;
+		 * their files are gone when the next run starts. */
+		if (completed)
+			ProcessSpoolDir();
+	}
+
+	close(fd);
+}
+#endif /* __linux__ */
+
+/**
+ * Parses all completed check result files in the spool directory in parallel
+ * and processes their results. Results for the same checkable are processed
+ * in the order in which they were executed.
+ */
+void CheckResultReader::ProcessSpoolDir() const
+{
+	boost::mutex::scoped_lock lock(m_SpoolMutex);
+
 	CONTEXT("Processing check result files in '" + GetSpoolDir() + "'");
 
-	Utility::Glob(GetSpoolDir() + "/c??????.ok", std::bind(&CheckResultReader::ProcessCheckResultFile, this, _1), GlobFile);
+	std::vector<String> files;
+	Utility::Glob(GetSpoolDir() + "/c??????.ok", [&files](const String& path) { files.push_back(path); }, GlobFile);
+
+	if (files.empty())
+		return;
+
+	boost::mutex resultsMutex;
+	std::map<Checkable::Ptr, std::vector<CheckResult::Ptr> > resultsByCheckable;
+
+	m_WorkQueue->ParallelFor(files, [&resultsMutex, &resultsByCheckable](const String& path) {
+		std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> > results = ReadCheckResultFile(path);
+
+		boost::mutex::scoped_lock lock(resultsMutex);
+
+		for (const auto& result : results)
+			resultsByCheckable[result.first].push_back(result.second);
+	});
+
+	m_WorkQueue->Join();
+
+	std::vector<std::pair<Checkable::Ptr, std::vector<CheckResult::Ptr> > > groups(resultsByCheckable.begin(), resultsByCheckable.end());
+
+	m_WorkQueue->ParallelFor(groups, [](const std::pair<Checkable::Ptr, std::vector<CheckResult::Ptr> >& group) {
+		std::vector<CheckResult::Ptr> results = group.second;
+
+		std::stable_sort(results.begin(), results.end(), [](const CheckResult::Ptr& a, const CheckResult::Ptr& b) {
+			return a->GetExecutionEnd() < b->GetExecutionEnd();
+		});
+
+		for (const CheckResult::Ptr& result : results)
+			ProcessCheckResult(group.first, result);
+	});
+
+	m_WorkQueue->Join();
+
+	Log(LogNotice, "CheckResultReader")
+		<< "Processed " << files.size() << " check result files.";
 }
 
-void CheckResultReader::ProcessCheckResultFile(const String& path) const
+/**
+ * Reads a check result file and removes it. A file may contain multiple
+ * check results separated by empty lines, each starting with "host_name".
+ *
+ * @param path The path of the file's ".ok" file.
+ * @returns The check results and the checkables they belong to.
+ */
+std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> > CheckResultReader::ReadCheckResultFile(const String& path)
 {
 	CONTEXT("Processing check result file '" + path + "'");
 
@@ -103,14 +256,25 @@ void CheckResultReader::ProcessCheckResultFile(const String& path) const
 	fp.exceptions(std::ifstream::badbit);
 	fp.open(crfile.CStr());
 
-	std::map<String, String> attrs;
+	std::vector<std::map<String, String> > blocks;
+	std::map<String, String> block;
 
 	while (fp.good()) {
 		std::string line;
 		std::getline(fp, line);
 
-		if (line.empty() || line[0] == '#')
-			continue; /* Ignore comments and empty lines. */
+		if (line.empty()) {
+			/* An empty line ends a check result. Blocks without a host
+			 * name (e.g. the "file_time" header) are ignored. */
+			if (block.find("host_name") != block.end())
+				blocks.push_back(std::move(block));
+
+			block.clear();
+			continue;
+		}
+
+		if (line[0] == '#')
+			continue; /* Ignore comments. */
 
 		size_t pos = line.find_first_of('=');
 
@@ -120,9 +284,12 @@ void CheckResultReader::ProcessCheckResultFile(const String& path) const
 		String key = line.substr(0, pos);
 		String value = line.substr(pos + 1);
 
-		attrs[key] = value;
+		block[key] = value;
 	}
 
+	if (block.find("host_name") != block.end())
+		blocks.push_back(std::move(block));
+
 	/* Remove the checkresult files. */
 	if (unlink(path.CStr()) < 0)
 		BOOST_THROW_EXCEPTION(posix_error()
@@ -136,49 +303,60 @@ void CheckResultReader::ProcessCheckResultFile(const String& path) const
 			<< boost::errinfo_errno(errno)
 			<< boost::errinfo_file_name(crfile));
 
-	Checkable::Ptr checkable;
-
-	Host::Ptr host = Host::GetByName(attrs["host_name"]);
+	std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> > results;
 
-	if (!host) {
-		Log(LogWarning, "CheckResultReader")
-			<< "Ignoring checkresult file for host '" << attrs["host_name"] << "': Host does not exist.";
-
-		return;
-	}
+	for (std::map<String, String>& attrs : blocks) {
+		Checkable::Ptr checkable;
 
-	if (attrs.find("service_description") != attrs.end()) {
-		Service::Ptr service = host->GetServiceByShortName(attrs["service_description"]);
+		Host::Ptr host = Host::GetByName(attrs["host_name"]);
 
-		if (!service) {
+		if (!host) {
 			Log(LogWarning, "CheckResultReader")
-				<< "Ignoring checkresult file for host '" << attrs["host_name"]
-				<< "', service '" << attrs["service_description"] << "': Service does not exist.";
+				<< "Ignoring checkresult file for host '" << attrs["host_name"] << "': Host does not exist.";
 
-			return;
+			continue;
 		}
 
-		checkable = service;
-	} else
-		checkable = host;
+		if (attrs.find("service_description") != attrs.end()) {
+			Service::Ptr service = host->GetServiceByShortName(attrs["service_description"]);
 
-	CheckResult::Ptr result = new CheckResult();
-	String output = CompatUtility::UnEscapeString(attrs["output"]);
-	std::pair<String, Value> co = PluginUtility::ParseCheckOutput(output);
-	result->SetOutput(co.first);
-	result->SetPerformanceData(PluginUtility::SplitPerfdata(co.second));
-	result->SetState(PluginUtility::ExitStatusToState(Convert::ToLong(attrs["return_code"])));
+			if (!service) {
+				Log(LogWarning, "CheckResultReader")
+					<< "Ignoring checkresult file for host '" << attrs["host_name"]
+					<< "', service '" << attrs["service_description"] << "': Service does not exist.";
 
-	if (attrs.find("start_time") != attrs.end())
-		result->SetExecutionStart(Convert::ToDouble(attrs["start_time"]));
-	else
-		result->SetExecutionStart(Utility::GetTime());
+				continue;
+			}
 
-	if (attrs.find("finish_time") != attrs.end())
-		result->SetExecutionEnd(Convert::ToDouble(attrs["finish_time"]));
-	else
-		result->SetExecutionEnd(result->GetExecutionStart());
+			checkable = service;
+		} else
+			checkable = host;
 
+		CheckResult::Ptr result = new CheckResult();
+		String output = CompatUtility::UnEscapeString(attrs["output"]);
+		std::pair<String, Value> co = PluginUtility::ParseCheckOutput(output);
+		result->SetOutput(co.first);
+		result->SetPerformanceData(PluginUtility::SplitPerfdata(co.second));
+		result->SetState(PluginUtility::ExitStatusToState(Convert::ToLong(attrs["return_code"])));
+
+		if (attrs.find("start_time") != attrs.end())
+			result->SetExecutionStart(Convert::ToDouble(attrs["start_time"]));
+		else
+			result->SetExecutionStart(Utility::GetTime());
+
+		if (attrs.find("finish_time") != attrs.end())
+			result->SetExecutionEnd(Convert::ToDouble(attrs["finish_time"]));
+		else
+			result->SetExecutionEnd(result->GetExecutionStart());
+
+		results.emplace_back(checkable, result);
+	}
+
+	return results;
+}
+
+void CheckResultReader::ProcessCheckResult(const Checkable::Ptr& checkable, const CheckResult::Ptr& result)
+{
 	checkable->ProcessCheckResult(result);
 
 	Log(LogDebug, "CheckResultReader")
@@ -189,3 +367,4 @@ void CheckResultReader::ProcessCheckResultFile(const String& path) const
 	 * active checks. */
 	checkable->SetNextCheck(Utility::GetTime() + checkable->GetCheckInterval());
 }
+#endif /* _WIN32 */
@@ -21,8 +21,15 @@
 #define CHECKRESULTREADER_H
 
 #include "compat/checkresultreader-ti.hpp"
+#include "icinga/checkable.hpp"
 #include "base/timer.hpp"
+#include "base/workqueue.hpp"
+#include <boost/thread/mutex.hpp>
+#include <atomic>
 #include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace icinga
 {
@@ -45,9 +52,24 @@ protected:
 	void Stop(bool runtimeRemoved) override;
 
 private:
+#ifndef _WIN32
 	Timer::Ptr m_ReadTimer;
+	std::unique_ptr<WorkQueue> m_WorkQueue;
+	mutable boost::mutex m_SpoolMutex;
+
+#ifdef __linux__
+	std::thread m_NotifyThread;
+	std::atomic<bool> m_Stopped{false};
+
+	void NotifyThreadProc() const;
+#endif /* __linux__ */
+
 	void ReadTimerHandler() const;
-	void ProcessCheckResultFile(const String& path) const;
+	void ProcessSpoolDir() const;
+
+	static std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> > ReadCheckResultFile(const String& path);
+	static void ProcessCheckResult(const Checkable::Ptr& checkable, const CheckResult::Ptr& result);
+#endif /* _WIN32 */
 };
 
 }
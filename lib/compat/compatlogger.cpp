@@ -66,7 +66,7 @@ void CompatLogger::Start(bool runtimeCreated)
 	Log(LogWarning, "CompatLogger")
 		<< "The CompatLogger feature is DEPRECATED and will be removed in Icinga v2.11.";
 
-	Checkable::OnNewCheckResult.connect(std::bind(&CompatLogger::CheckResultHandler, this, _1, _2));
+	Checkable::OnNewCheckResult.connect(std::bind(&CompatLogger::CheckResultHandler, this, _1, _2), "CompatLogger::CheckResultHandler");
 	Checkable::OnNotificationSentToUser.connect(std::bind(&CompatLogger::NotificationSentHandler, this, _1, _2, _3, _4, _5, _6, _7, _8));
 	Downtime::OnDowntimeTriggered.connect(std::bind(&CompatLogger::TriggerDowntimeHandler, this, _1));
 	Downtime::OnDowntimeRemoved.connect(std::bind(&CompatLogger::RemoveDowntimeHandler, this, _1));
@@ -77,11 +77,14 @@ void CompatLogger::Start(bool runtimeCreated)
 
 	ExternalCommandProcessor::OnNewExternalCommand.connect(std::bind(&CompatLogger::ExternalCommandHandler, this, _2, _3));
 
-	m_RotationTimer = new Timer();
+	m_RotationTimer = new Timer("CompatLogger rotation");
 	m_RotationTimer->OnTimerExpired.connect(std::bind(&CompatLogger::RotationTimerHandler, this));
 	m_RotationTimer->Start();
 
-	ReopenFile(false);
+	m_WriterStopped = false;
+	m_WriterThread = std::thread(std::bind(&CompatLogger::WriterThreadProc, this));
+
+	RequestReopen(false);
 	ScheduleNextRotation();
 }
 
@@ -93,6 +96,16 @@ void CompatLogger::Stop(bool runtimeRemoved)
 	Log(LogInformation, "CompatLogger")
 		<< "'" << GetName() << "' stopped.";
 
+	if (m_WriterThread.joinable()) {
+		{
+			boost::mutex::scoped_lock lock(m_WriterMutex);
+			m_WriterStopped = true;
+		}
+
+		m_WriterCV.notify_all();
+		m_WriterThread.join();
+	}
+
 	ObjectImpl<CompatLogger>::Stop(runtimeRemoved);
 }
 
@@ -153,11 +166,7 @@ void CompatLogger::CheckResultHandler(const Checkable::Ptr& checkable, const Che
 
 	}
 
-	{
-		ObjectLock olock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 /**
@@ -189,11 +198,7 @@ void CompatLogger::TriggerDowntimeHandler(const Downtime::Ptr& downtime)
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 /**
@@ -236,11 +241,7 @@ void CompatLogger::RemoveDowntimeHandler(const Downtime::Ptr& downtime)
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 /**
@@ -300,11 +301,7 @@ void CompatLogger::NotificationSentHandler(const Notification::Ptr& notification
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 /**
@@ -344,11 +341,7 @@ void CompatLogger::FlappingChangedHandler(const Checkable::Ptr& checkable)
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 void CompatLogger::EnableFlappingChangedHandler(const Checkable::Ptr& checkable)
@@ -380,11 +373,7 @@ void CompatLogger::EnableFlappingChangedHandler(const Checkable::Ptr& checkable)
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 void CompatLogger::ExternalCommandHandler(const String& command, const std::vector<String>& arguments)
@@ -395,11 +384,7 @@ void CompatLogger::ExternalCommandHandler(const String& command, const std::vect
 		<< boost::algorithm::join(arguments, ";")
 		<< "";
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 void CompatLogger::EventCommandHandler(const Checkable::Ptr& checkable)
@@ -431,11 +416,7 @@ void CompatLogger::EventCommandHandler(const Checkable::Ptr& checkable)
 			<< event_command_name;
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 String CompatLogger::GetHostStateString(const Host::Ptr& host)
@@ -446,36 +427,123 @@ String CompatLogger::GetHostStateString(const Host::Ptr& host)
 	return Host::StateToString(host->GetState());
 }
 
+/**
+ * Queues a line for the writer thread. The line is timestamped right away.
+ *
+ * @threadsafety Always.
+ */
 void CompatLogger::WriteLine(const String& line)
 {
-	ASSERT(OwnsLock());
+	String text = "[" + Convert::ToString(static_cast<long>(Utility::GetTime())) + "] " + line;
 
-	if (!m_OutputFile.good())
-		return;
+	{
+		boost::mutex::scoped_lock lock(m_WriterMutex);
+		m_PendingLines.emplace_back(std::move(text));
+	}
+
+	m_WriterCV.notify_one();
+}
+
+/**
+ * Asks the writer thread to (re)open the log file.
+ *
+ * @threadsafety Always.
+ */
+void CompatLogger::RequestReopen(bool rotate)
+{
+	{
+		boost::mutex::scoped_lock lock(m_WriterMutex);
+		m_ReopenPending = true;
+		m_RotationPending = m_RotationPending || rotate;
+	}
 
-	m_OutputFile << "[" << (long)Utility::GetTime() << "] " << line << "\n";
+	m_WriterCV.notify_one();
 }
 
-void CompatLogger::Flush()
+/**
+ * Writes queued lines in batches and handles log rotation, so that
+ * neither the file I/O nor the rotation block the event handlers.
+ */
+void CompatLogger::WriterThreadProc()
 {
-	ASSERT(OwnsLock());
+	Utility::SetThreadName("CompatLogger");
+
+	for (;;) {
+		std::vector<String> lines;
+		bool reopen, rotate, stopped;
+
+		{
+			boost::mutex::scoped_lock lock(m_WriterMutex);
+
+			while (m_PendingLines.empty() && !m_ReopenPending && !m_WriterStopped)
+				m_WriterCV.wait(lock);
+
+			lines.swap(m_PendingLines);
+			reopen = m_ReopenPending;
+			rotate = m_RotationPending;
+			stopped = m_WriterStopped;
+
+			m_ReopenPending = false;
+			m_RotationPending = false;
+		}
+
+		/* lines which were queued before the rotation belong into the old file */
+		if (!lines.empty())
+			WriteLines(lines);
+
+		if (reopen) {
+			try {
+				ReopenFile(rotate);
+			} catch (const std::exception& ex) {
+				Log(LogCritical, "CompatLogger")
+					<< "Could not reopen compat log file: " << DiagnosticInformation(ex, false);
+			}
+		}
+
+		if (stopped)
+			break;
+	}
 
+	if (m_OutputFile.is_open())
+		m_OutputFile.close();
+}
+
+/**
+ * Writes and flushes a batch of lines. Must only be called by the writer thread.
+ */
+void CompatLogger::WriteLines(const std::vector<String>& lines)
+{
 	if (!m_OutputFile.good())
 		return;
 
+	std::streamoff offset = m_OutputOffset;
+	std::streamoff size = 0;
+
+	for (const String& line : lines) {
+		m_OutputFile << line << "\n";
+		size += line.GetLength() + 1;
+	}
+
 	m_OutputFile << std::flush;
+
+	if (!m_OutputFile.good() || offset < 0) {
+		m_OutputOffset = -1;
+		return;
+	}
+
+	m_OutputOffset = offset + size;
+
+	CompatUtility::OnLogLinesWritten(m_OutputPath, offset, lines);
 }
 
 /**
- * @threadsafety Always.
+ * Must only be called by the writer thread.
  */
 void CompatLogger::ReopenFile(bool rotate)
 {
-	ObjectLock olock(this);
-
 	String tempFile = GetLogDir() + "/icinga.log";
 
-	if (m_OutputFile) {
+	if (m_OutputFile.is_open()) {
 		m_OutputFile.close();
 
 		if (rotate) {
@@ -484,11 +552,14 @@ void CompatLogger::ReopenFile(bool rotate)
 			Log(LogNotice, "CompatLogger")
 				<< "Rotating compat log file '" << tempFile << "' -> '" << archiveFile << "'";
 
-			(void) rename(tempFile.CStr(), archiveFile.CStr());
+			if (rename(tempFile.CStr(), archiveFile.CStr()) == 0)
+				CompatUtility::OnLogFileRotated(tempFile, archiveFile);
 		}
 	}
 
+	m_OutputFile.clear();
 	m_OutputFile.open(tempFile.CStr(), std::ofstream::app);
+	m_OutputPath = tempFile;
 
 	if (!m_OutputFile) {
 		Log(LogWarning, "CompatLogger")
@@ -497,8 +568,14 @@ void CompatLogger::ReopenFile(bool rotate)
 		return;
 	}
 
-	WriteLine("LOG ROTATION: " + GetRotationMethod());
-	WriteLine("LOG VERSION: 2.0");
+	m_OutputFile.seekp(0, std::ios_base::end);
+	m_OutputOffset = m_OutputFile.tellp();
+
+	std::vector<String> lines;
+	String prefix = "[" + Convert::ToString(static_cast<long>(Utility::GetTime())) + "] ";
+
+	lines.emplace_back(prefix + "LOG ROTATION: " + GetRotationMethod());
+	lines.emplace_back(prefix + "LOG VERSION: 2.0");
 
 	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
 		String output;
@@ -515,7 +592,7 @@ void CompatLogger::ReopenFile(bool rotate)
 			<< host->GetCheckAttempt() << ";"
 			<< output << "";
 
-		WriteLine(msgbuf.str());
+		lines.emplace_back(prefix + msgbuf.str());
 	}
 
 	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
@@ -536,10 +613,10 @@ void CompatLogger::ReopenFile(bool rotate)
 			<< service->GetCheckAttempt() << ";"
 			<< output << "";
 
-		WriteLine(msgbuf.str());
+		lines.emplace_back(prefix + msgbuf.str());
 	}
 
-	Flush();
+	WriteLines(lines);
 }
 
 void CompatLogger::ScheduleNextRotation()
@@ -598,14 +675,7 @@ void CompatLogger::ScheduleNextRotation()
  */
 void CompatLogger::RotationTimerHandler()
 {
-	try {
-		ReopenFile(true);
-	} catch (...) {
-		ScheduleNextRotation();
-
-		throw;
-	}
-
+	RequestReopen(true);
 	ScheduleNextRotation();
 }
 
@@ -23,7 +23,11 @@
 #include "compat/compatlogger-ti.hpp"
 #include "icinga/service.hpp"
 #include "base/timer.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <fstream>
+#include <thread>
+#include <vector>
 
 namespace icinga
 {
@@ -48,8 +52,17 @@ protected:
 	void Stop(bool runtimeRemoved) override;
 
 private:
+	boost::mutex m_WriterMutex;
+	boost::condition_variable m_WriterCV;
+	std::vector<String> m_PendingLines;
+	bool m_ReopenPending{false};
+	bool m_RotationPending{false};
+	bool m_WriterStopped{false};
+	std::thread m_WriterThread;
+
 	void WriteLine(const String& line);
-	void Flush();
+	void WriterThreadProc();
+	void WriteLines(const std::vector<String>& lines);
 
 	void CheckResultHandler(const Checkable::Ptr& service, const CheckResult::Ptr& cr);
 	void NotificationSentHandler(const Notification::Ptr& notification, const Checkable::Ptr& service,
@@ -68,8 +81,11 @@ private:
 	void RotationTimerHandler();
 	void ScheduleNextRotation();
 
+	String m_OutputPath;
 	std::ofstream m_OutputFile;
+	std::streamoff m_OutputOffset{-1};
 	void ReopenFile(bool rotate);
+	void RequestReopen(bool rotate);
 };
 
 }
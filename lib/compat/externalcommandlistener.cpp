@@ -25,6 +25,7 @@
 #include "base/exception.hpp"
 #include "base/application.hpp"
 #include "base/statsfunction.hpp"
+#include "base/convert.hpp"
 
 using namespace icinga;
 
@@ -37,7 +38,18 @@ void ExternalCommandListener::StatsFunc(const Dictionary::Ptr& status, const Arr
 	DictionaryData nodes;
 
 	for (const ExternalCommandListener::Ptr& externalcommandlistener : ConfigType::GetObjectsByType<ExternalCommandListener>()) {
+#ifndef _WIN32
+		size_t pending = 0;
+
+		for (const std::unique_ptr<WorkQueue>& queue : externalcommandlistener->m_ExecutorQueues)
+			pending += queue->GetLength();
+
+		nodes.emplace_back(externalcommandlistener->GetName(), new Dictionary({
+			{ "pending_commands", pending }
+		}));
+#else /* _WIN32 */
 		nodes.emplace_back(externalcommandlistener->GetName(), 1); //add more stats
+#endif /* _WIN32 */
 	}
 
 	status->Set("externalcommandlistener", new Dictionary(std::move(nodes)));
@@ -54,6 +66,12 @@ void ExternalCommandListener::Start(bool runtimeCreated)
 		<< "'" << GetName() << "' started.";
 
 #ifndef _WIN32
+	for (int i = 0; i < GetExecutorThreads(); i++) {
+		std::unique_ptr<WorkQueue> queue(new WorkQueue(25000, 1));
+		queue->SetName("ExternalCommandListener, " + GetName() + ", #" + Convert::ToString(i));
+		m_ExecutorQueues.push_back(std::move(queue));
+	}
+
 	m_CommandThread = std::thread(std::bind(&ExternalCommandListener::CommandPipeThread, this, GetCommandPath()));
 	m_CommandThread.detach();
 #endif /* _WIN32 */
@@ -70,6 +88,14 @@ void ExternalCommandListener::Stop(bool runtimeRemoved)
 	ObjectImpl<ExternalCommandListener>::Stop(runtimeRemoved);
 }
 
+void ExternalCommandListener::ValidateExecutorThreads(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ExternalCommandListener>::ValidateExecutorThreads(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "executor_threads" }, "Value must be greater than 0."));
+}
+
 #ifndef _WIN32
 void ExternalCommandListener::CommandPipeThread(const String& commandPath)
 {
@@ -151,19 +177,50 @@ void ExternalCommandListener::CommandPipeThread(const String& commandPath)
 				if (srs != StatusNewItem)
 					break;
 
-				try {
-					Log(LogInformation, "ExternalCommandListener")
-						<< "Executing external command: " << command;
-
-					ExternalCommandProcessor::Execute(command);
-				} catch (const std::exception& ex) {
-					Log(LogWarning, "ExternalCommandListener")
-						<< "External command failed: " << DiagnosticInformation(ex, false);
-					Log(LogNotice, "ExternalCommandListener")
-						<< "External command failed: " << DiagnosticInformation(ex, true);
-				}
+				EnqueueCommand(command);
 			}
 		}
 	}
 }
+
+/**
+ * Hands a command over to the executor queue of its host. Commands for the
+ * same host (and its services) are therefore executed in order. This blocks
+ * while the queue is full so that the pipe's writers are slowed down.
+ *
+ * @param command The command line.
+ */
+void ExternalCommandListener::EnqueueCommand(const String& command)
+{
+	size_t index = 0;
+
+	if (m_ExecutorQueues.size() > 1) {
+		/* [timestamp] COMMAND;host_name;... */
+		size_t begin = command.Find(";");
+
+		if (begin != String::NPos) {
+			begin++;
+
+			size_t end = command.Find(";", begin);
+			index = Utility::SDBM(command.SubStr(begin, end == String::NPos ? String::NPos : end - begin)) % m_ExecutorQueues.size();
+		}
+	}
+
+	m_ExecutorQueues[index]->Enqueue(std::bind(&ExternalCommandListener::ExecuteCommand, command));
+}
+
+void ExternalCommandListener::ExecuteCommand(const String& command)
+{
+	try {
+		Log(LogInformation, "ExternalCommandListener")
+			<< "Executing external command: " << command;
+
+		ExternalCommandProcessor::Execute(command);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ExternalCommandListener")
+			<< "External command failed: " << DiagnosticInformation(ex, false);
+		Log(LogNotice, "ExternalCommandListener")
+			<< "External command failed: " << DiagnosticInformation(ex, true);
+	}
+}
 #endif /* _WIN32 */
@@ -24,7 +24,10 @@
 #include "base/objectlock.hpp"
 #include "base/timer.hpp"
 #include "base/utility.hpp"
+#include "base/workqueue.hpp"
+#include <memory>
 #include <thread>
+#include <vector>
 #include <iostream>
 
 namespace icinga
@@ -41,6 +44,8 @@ public:
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void ValidateExecutorThreads(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+
 protected:
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
@@ -49,7 +54,12 @@ private:
 #ifndef _WIN32
 	std::thread m_CommandThread;
 
+	/* Commands are executed by these queues, sharded by host name. */
+	std::vector<std::unique_ptr<WorkQueue> > m_ExecutorQueues;
+
 	void CommandPipeThread(const String& commandPath);
+	void EnqueueCommand(const String& command);
+	static void ExecuteCommand(const String& command);
 #endif /* _WIN32 */
 };
 
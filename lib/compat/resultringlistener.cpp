@@ -0,0 +1,476 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "compat/resultringlistener.hpp"
+#include "compat/resultringlistener-ti.cpp"
+#include "resultring/icinga2-resultring.h"
+#include "icinga/service.hpp"
+#include "icinga/pluginutility.hpp"
+#include "base/configtype.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include "base/application.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include "base/statsfunction.hpp"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#ifdef __linux__
+#	include <poll.h>
+#	include <sys/eventfd.h>
+#	include <sys/mman.h>
+#	include <sys/socket.h>
+#	include <sys/stat.h>
+#	include <sys/un.h>
+#endif /* __linux__ */
+
+using namespace icinga;
+
+REGISTER_TYPE(ResultRingListener);
+
+REGISTER_STATSFUNCTION(ResultRingListener, &ResultRingListener::StatsFunc);
+
+/* The maximum number of results which are processed as one batch. */
+static const size_t l_ResultRingBatchSize = 1024;
+
+void ResultRingListener::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+{
+	DictionaryData nodes;
+
+	for (const ResultRingListener::Ptr& resultringlistener : ConfigType::GetObjectsByType<ResultRingListener>()) {
+#ifdef __linux__
+		nodes.emplace_back(resultringlistener->GetName(), new Dictionary({
+			{ "processed_results", static_cast<double>(resultringlistener->m_ProcessedResults.load()) },
+			{ "dropped_results", static_cast<double>(resultringlistener->m_DroppedResults.load()) }
+		}));
+#else /* __linux__ */
+		nodes.emplace_back(resultringlistener->GetName(), 1); //add more stats
+#endif /* __linux__ */
+	}
+
+	status->Set("resultringlistener", new Dictionary(std::move(nodes)));
+}
+
+void ResultRingListener::ValidateRingSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ResultRingListener>::ValidateRingSize(lvalue, utils);
+
+	int size = lvalue();
+
+	if (size < 65536 || (size & (size - 1)) != 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "ring_size" }, "Value must be a power of two and at least 65536."));
+}
+
+/**
+ * Starts the component.
+ */
+void ResultRingListener::Start(bool runtimeCreated)
+{
+	ObjectImpl<ResultRingListener>::Start(runtimeCreated);
+
+	Log(LogInformation, "ResultRingListener")
+		<< "'" << GetName() << "' started.";
+
+#ifdef __linux__
+	m_WorkQueue.reset(new WorkQueue(0, Application::GetConcurrency()));
+	m_WorkQueue->SetName("ResultRingListener, " + GetName());
+	m_WorkQueue->SetExceptionCallback([](boost::exception_ptr exp) {
+		Log(LogCritical, "ResultRingListener")
+			<< "Failed to process check result: " << DiagnosticInformation(exp);
+	});
+
+	CreateRing();
+
+	m_Stopped = false;
+	m_AcceptThread = std::thread(std::bind(&ResultRingListener::AcceptThreadProc, this));
+	m_ReaderThread = std::thread(std::bind(&ResultRingListener::ReaderThreadProc, this));
+#else /* __linux__ */
+	Log(LogWarning, "ResultRingListener")
+		<< "The ResultRingListener feature is only supported on Linux.";
+#endif /* __linux__ */
+}
+
+/**
+ * Stops the component.
+ */
+void ResultRingListener::Stop(bool runtimeRemoved)
+{
+	Log(LogInformation, "ResultRingListener")
+		<< "'" << GetName() << "' stopped.";
+
+#ifdef __linux__
+	m_Stopped = true;
+
+	if (m_AcceptThread.joinable())
+		m_AcceptThread.join();
+
+	if (m_ReaderThread.joinable())
+		m_ReaderThread.join();
+
+	DestroyRing();
+#endif /* __linux__ */
+
+	ObjectImpl<ResultRingListener>::Stop(runtimeRemoved);
+}
+
+#ifdef __linux__
+/**
+ * Creates the shared memory for the ring buffer, the eventfd which producers
+ * use to wake up the reader thread and the socket which hands both of them
+ * to producers.
+ */
+void ResultRingListener::CreateRing()
+{
+	m_RingSize = GetRingSize();
+	m_MappingSize = ICINGA2_RESULTRING_DATA_OFFSET + m_RingSize;
+
+	m_MemFd = memfd_create("icinga2-resultring", MFD_CLOEXEC);
+
+	if (m_MemFd < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("memfd_create")
+			<< boost::errinfo_errno(errno));
+	}
+
+	if (ftruncate(m_MemFd, m_MappingSize) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("ftruncate")
+			<< boost::errinfo_errno(errno));
+	}
+
+	void *mapping = mmap(nullptr, m_MappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_MemFd, 0);
+
+	if (mapping == MAP_FAILED) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("mmap")
+			<< boost::errinfo_errno(errno));
+	}
+
+	/* The memory is zero-filled, i.e. all counters start at 0 and there are no records. */
+	m_Header = static_cast<icinga2_resultring_header *>(mapping);
+	m_Header->magic = ICINGA2_RESULTRING_MAGIC;
+	m_Header->version = ICINGA2_RESULTRING_VERSION;
+	m_Header->size = m_RingSize;
+	m_Data = static_cast<char *>(mapping) + ICINGA2_RESULTRING_DATA_OFFSET;
+	m_Tail = 0;
+
+	m_EventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	if (m_EventFd < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("eventfd")
+			<< boost::errinfo_errno(errno));
+	}
+
+	String socketPath = GetSocketPath();
+
+	sockaddr_un addr;
+
+	if (socketPath.GetLength() >= sizeof(addr.sun_path))
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Socket path '" + socketPath + "' is too long."));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath.CStr(), sizeof(addr.sun_path) - 1);
+
+	m_ListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+	if (m_ListenFd < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("socket")
+			<< boost::errinfo_errno(errno));
+	}
+
+	(void) unlink(socketPath.CStr());
+
+	if (bind(m_ListenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("bind")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(socketPath));
+	}
+
+	/* Same permissions as the command pipe. */
+	if (chmod(socketPath.CStr(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("chmod")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(socketPath));
+	}
+
+	if (listen(m_ListenFd, SOMAXCONN) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("listen")
+			<< boost::errinfo_errno(errno));
+	}
+}
+
+void ResultRingListener::DestroyRing()
+{
+	if (m_ListenFd >= 0) {
+		close(m_ListenFd);
+		(void) unlink(GetSocketPath().CStr());
+		m_ListenFd = -1;
+	}
+
+	if (m_EventFd >= 0) {
+		close(m_EventFd);
+		m_EventFd = -1;
+	}
+
+	if (m_Header) {
+		munmap(m_Header, m_MappingSize);
+		m_Header = nullptr;
+		m_Data = nullptr;
+	}
+
+	if (m_MemFd >= 0) {
+		close(m_MemFd);
+		m_MemFd = -1;
+	}
+}
+
+/**
+ * Sends the ring's memory file descriptor and the eventfd to each producer
+ * which connects to the socket.
+ */
+void ResultRingListener::AcceptThreadProc()
+{
+	Utility::SetThreadName("ResultRing Accept");
+
+	while (!m_Stopped) {
+		pollfd pfd;
+		pfd.fd = m_ListenFd;
+		pfd.events = POLLIN;
+
+		/* Wake up regularly to check whether the component was stopped. */
+		if (poll(&pfd, 1, 500) <= 0)
+			continue;
+
+		int fd = accept4(m_ListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+
+		if (fd < 0)
+			continue;
+
+		char byte = 0;
+		iovec iov;
+		iov.iov_base = &byte;
+		iov.iov_len = sizeof(byte);
+
+		union {
+			cmsghdr align;
+			char buf[CMSG_SPACE(2 * sizeof(int))];
+		} control;
+
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+
+		cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+
+		int fds[2] = { m_MemFd, m_EventFd };
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+		if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+			Log(LogWarning, "ResultRingListener")
+				<< "sendmsg() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		}
+
+		close(fd);
+	}
+}
+
+/**
+ * Drains the ring buffer and processes its results in batches. The thread
+ * sleeps on the eventfd while the ring is empty.
+ */
+void ResultRingListener::ReaderThreadProc()
+{
+	Utility::SetThreadName("ResultRing Reader");
+
+	std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> > results;
+
+	try {
+		while (!m_Stopped) {
+			while (results.size() < l_ResultRingBatchSize && ReadRecord(results))
+				; /* empty loop body */
+
+			if (!results.empty()) {
+				ProcessResults(results);
+				continue;
+			}
+
+			/* Announce that we are about to sleep and check again; a producer
+			 * which commits a record after this only signals the eventfd if it
+			 * sees the flag. */
+			__atomic_store_n(&m_Header->waiting, 1, __ATOMIC_SEQ_CST);
+
+			auto *record = reinterpret_cast<icinga2_resultring_record *>(m_Data + (m_Tail & (m_RingSize - 1)));
+
+			if (__atomic_load_n(&record->length, __ATOMIC_SEQ_CST) == 0) {
+				pollfd pfd;
+				pfd.fd = m_EventFd;
+				pfd.events = POLLIN;
+
+				/* Wake up regularly to check whether the component was stopped. */
+				if (poll(&pfd, 1, 500) > 0) {
+					uint64_t value;
+					(void) read(m_EventFd, &value, sizeof(value));
+				}
+			}
+
+			__atomic_store_n(&m_Header->waiting, 0, __ATOMIC_SEQ_CST);
+		}
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "ResultRingListener")
+			<< "Stopped reading from the ring buffer; the feature needs to be restarted: " << DiagnosticInformation(ex, false);
+	}
+}
+
+/**
+ * Reads the record at the ring's tail, if it has been completed, and frees
+ * its space.
+ *
+ * @param results The results to append the record's check result to.
+ * @returns Whether a record was consumed.
+ */
+bool ResultRingListener::ReadRecord(std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> >& results)
+{
+	/* Producers can write to the header, so its size and tail aren't trusted. */
+	uint64_t size = m_RingSize;
+	uint64_t offset = m_Tail & (size - 1);
+	char *data = m_Data + offset;
+	auto *record = reinterpret_cast<icinga2_resultring_record *>(data);
+
+	uint32_t length = __atomic_load_n(&record->length, __ATOMIC_ACQUIRE);
+
+	if (length == 0)
+		return false;
+
+	if (length % 8 != 0 || length > size - offset)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Invalid record length " + Convert::ToString(length) + " at offset " + Convert::ToString(offset)));
+
+	if (record->type == ICINGA2_RESULTRING_RECORD_RESULT) {
+		size_t payloadLength = static_cast<size_t>(record->host_length) + record->service_length + record->output_length;
+
+		if (length < sizeof(*record) || payloadLength > length - sizeof(*record) || record->host_length == 0) {
+			m_DroppedResults++;
+
+			Log(LogWarning, "ResultRingListener")
+				<< "Ignoring malformed record at offset " << offset << ".";
+		} else {
+			const char *payload = data + sizeof(*record);
+			String hostName(payload, payload + record->host_length);
+			payload += record->host_length;
+			String serviceName(payload, payload + record->service_length);
+			payload += record->service_length;
+			String output(payload, payload + record->output_length);
+
+			Checkable::Ptr checkable;
+			Host::Ptr host = Host::GetByName(hostName);
+
+			if (host && !serviceName.IsEmpty())
+				checkable = host->GetServiceByShortName(serviceName);
+			else
+				checkable = host;
+
+			if (!checkable) {
+				m_DroppedResults++;
+
+				Log(LogNotice, "ResultRingListener")
+					<< "Ignoring check result for non-existent object '" << hostName
+					<< (serviceName.IsEmpty() ? String() : "!" + serviceName) << "'.";
+			} else if (!checkable->GetEnablePassiveChecks()) {
+				m_DroppedResults++;
+
+				Log(LogNotice, "ResultRingListener")
+					<< "Ignoring check result for object '" << checkable->GetName() << "' which has passive checks disabled.";
+			} else {
+				CheckResult::Ptr result = new CheckResult();
+				std::pair<String, String> co = PluginUtility::ParseCheckOutput(output);
+				result->SetOutput(co.first);
+				result->SetPerformanceData(PluginUtility::SplitPerfdata(co.second));
+				result->SetState(PluginUtility::ExitStatusToState(record->exit_status));
+
+				double now = Utility::GetTime();
+				double executionStart = record->execution_start != 0 ? record->execution_start : now;
+				double executionEnd = record->execution_end != 0 ? record->execution_end : executionStart;
+
+				result->SetScheduleStart(executionStart);
+				result->SetScheduleEnd(executionEnd);
+				result->SetExecutionStart(executionStart);
+				result->SetExecutionEnd(executionEnd);
+
+				/* Mark this check result as passive. */
+				result->SetActive(false);
+
+				results.emplace_back(checkable, result);
+			}
+		}
+	} else if (record->type != ICINGA2_RESULTRING_RECORD_PADDING) {
+		Log(LogWarning, "ResultRingListener")
+			<< "Ignoring record with unknown type " << record->type << " at offset " << offset << ".";
+	}
+
+	/* Producers rely on free space being zeroed. */
+	memset(data, 0, length);
+
+	m_Tail += length;
+	__atomic_store_n(&m_Header->tail, m_Tail, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * Processes a batch of check results in parallel. Results for the same
+ * checkable are processed in the order in which they were submitted.
+ *
+ * @param results The check results; the vector is cleared.
+ */
+void ResultRingListener::ProcessResults(std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> >& results)
+{
+	std::map<Checkable::Ptr, std::vector<CheckResult::Ptr> > resultsByCheckable;
+
+	for (const auto& result : results)
+		resultsByCheckable[result.first].push_back(result.second);
+
+	std::vector<std::pair<Checkable::Ptr, std::vector<CheckResult::Ptr> > > groups(resultsByCheckable.begin(), resultsByCheckable.end());
+
+	m_WorkQueue->ParallelFor(groups, [](const std::pair<Checkable::Ptr, std::vector<CheckResult::Ptr> >& group) {
+		for (const CheckResult::Ptr& result : group.second)
+			group.first->ProcessCheckResult(result);
+	});
+
+	m_WorkQueue->Join();
+
+	m_ProcessedResults += results.size();
+
+	Log(LogDebug, "ResultRingListener")
+		<< "Processed " << results.size() << " check results.";
+
+	results.clear();
+}
+#endif /* __linux__ */
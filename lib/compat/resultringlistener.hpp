@@ -0,0 +1,89 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef RESULTRINGLISTENER_H
+#define RESULTRINGLISTENER_H
+
+#include "compat/resultringlistener-ti.hpp"
+#include "icinga/checkable.hpp"
+#include "base/workqueue.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct icinga2_resultring_header;
+
+namespace icinga
+{
+
+/**
+ * Receives passive check results from local producers through a shared
+ * memory ring buffer. Producers obtain the ring from a Unix socket and
+ * use the icinga2-resultring client library to write into it.
+ *
+ * @ingroup compat
+ */
+class ResultRingListener final : public ObjectImpl<ResultRingListener>
+{
+public:
+	DECLARE_OBJECT(ResultRingListener);
+	DECLARE_OBJECTNAME(ResultRingListener);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+	void ValidateRingSize(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+
+protected:
+	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+
+private:
+#ifdef __linux__
+	int m_MemFd{-1};
+	int m_EventFd{-1};
+	int m_ListenFd{-1};
+	icinga2_resultring_header *m_Header{nullptr};
+	char *m_Data{nullptr};
+	size_t m_RingSize{0};
+	uint64_t m_Tail{0};
+	size_t m_MappingSize{0};
+
+	std::thread m_AcceptThread;
+	std::thread m_ReaderThread;
+	std::atomic<bool> m_Stopped{false};
+	std::unique_ptr<WorkQueue> m_WorkQueue;
+
+	std::atomic<uint_fast64_t> m_ProcessedResults{0};
+	std::atomic<uint_fast64_t> m_DroppedResults{0};
+
+	void CreateRing();
+	void DestroyRing();
+
+	void AcceptThreadProc();
+	void ReaderThreadProc();
+
+	bool ReadRecord(std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> >& results);
+	void ProcessResults(std::vector<std::pair<Checkable::Ptr, CheckResult::Ptr> >& results);
+#endif /* __linux__ */
+};
+
+}
+
+#endif /* RESULTRINGLISTENER_H */
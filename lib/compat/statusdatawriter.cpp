@@ -30,6 +30,7 @@
 #include "icinga/compatutility.hpp"
 #include "icinga/pluginutility.hpp"
 #include "icinga/dependency.hpp"
+#include "config/configitem.hpp"
 #include "base/configtype.hpp"
 #include "base/objectlock.hpp"
 #include "base/json.hpp"
@@ -39,10 +40,13 @@
 #include "base/application.hpp"
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
+#include "base/workqueue.hpp"
 #include <boost/tuple/tuple.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <fstream>
+#include <numeric>
 
 using namespace icinga;
 
@@ -81,8 +85,9 @@ void StatusDataWriter::Start(bool runtimeCreated)
 		<< "The StatusDataWriter feature is DEPRECATED and will be removed in Icinga v2.11.";
 
 	m_ObjectsCacheOutdated = true;
+	m_ObjectsCacheActivationPending = true;
 
-	m_StatusTimer = new Timer();
+	m_StatusTimer = new Timer("StatusDataWriter");
 	m_StatusTimer->SetInterval(GetUpdateInterval());
 	m_StatusTimer->OnTimerExpired.connect(std::bind(&StatusDataWriter::StatusTimerHandler, this));
 	m_StatusTimer->Start();
@@ -90,6 +95,7 @@ void StatusDataWriter::Start(bool runtimeCreated)
 
 	ConfigObject::OnVersionChanged.connect(std::bind(&StatusDataWriter::ObjectHandler, this));
 	ConfigObject::OnActiveChanged.connect(std::bind(&StatusDataWriter::ObjectHandler, this));
+	ConfigItem::OnItemsActivated.connect(std::bind(&StatusDataWriter::ItemsActivatedHandler, this));
 }
 
 /**
@@ -205,13 +211,20 @@ void StatusDataWriter::DumpDowntimes(std::ostream& fp, const Checkable::Ptr& che
 	}
 }
 
-void StatusDataWriter::DumpHostStatus(std::ostream& fp, const Host::Ptr& host)
+/**
+ * Writes the status block of a host including its downtimes and comments.
+ *
+ * @returns The position at which the value of the "last_update" attribute
+ *          has to be inserted.
+ */
+std::streampos StatusDataWriter::DumpHostStatus(std::ostream& fp, const Host::Ptr& host)
 {
 	fp << "hoststatus {" "\n" "\t" "host_name=" << host->GetName() << "\n";
 
+	std::streampos lastUpdatePos;
+
 	{
-		ObjectLock olock(host);
-		DumpCheckableStatusAttrs(fp, host);
+		lastUpdatePos = DumpCheckableStatusAttrs(fp, host);
 	}
 
 	/* ugly but cgis parse only that */
@@ -223,6 +236,8 @@ void StatusDataWriter::DumpHostStatus(std::ostream& fp, const Host::Ptr& host)
 
 	DumpDowntimes(fp, host);
 	DumpComments(fp, host);
+
+	return lastUpdatePos;
 }
 
 void StatusDataWriter::DumpHostObject(std::ostream& fp, const Host::Ptr& host)
@@ -332,9 +347,18 @@ void StatusDataWriter::DumpHostObject(std::ostream& fp, const Host::Ptr& host)
 	fp << "\t" "}" "\n" "\n";
 }
 
-void StatusDataWriter::DumpCheckableStatusAttrs(std::ostream& fp, const Checkable::Ptr& checkable)
+/**
+ * Writes the status attributes of a checkable. The value of the "last_update"
+ * attribute is left out so that the attributes can be cached.
+ *
+ * @returns The position at which the value of the "last_update" attribute
+ *          has to be inserted.
+ */
+std::streampos StatusDataWriter::DumpCheckableStatusAttrs(std::ostream& fp, const Checkable::Ptr& checkable)
 {
-	CheckResult::Ptr cr = checkable->GetLastCheckResult();
+	/* The state is read from the snapshot so that the checker doesn't have to wait for us. */
+	CheckableSnapshot::Ptr snapshot = checkable->GetSnapshot();
+	const CheckResult::Ptr& cr = snapshot->LastCheckResult;
 
 	EventCommand::Ptr eventcommand = checkable->GetEventCommand();
 	CheckCommand::Ptr checkcommand = checkable->GetCheckCommand();
@@ -343,7 +367,7 @@ void StatusDataWriter::DumpCheckableStatusAttrs(std::ostream& fp, const Checkabl
 		"\t" "event_handler=" << CompatUtility::GetCommandName(eventcommand) << "\n"
 		"\t" "check_interval=" << (checkable->GetCheckInterval() / 60.0) << "\n"
 		"\t" "retry_interval=" << (checkable->GetRetryInterval() / 60.0) << "\n"
-		"\t" "has_been_checked=" << Convert::ToLong(checkable->HasBeenChecked()) << "\n"
+		"\t" "has_been_checked=" << (cr ? 1 : 0) << "\n"
 		"\t" "should_be_scheduled=" << checkable->GetEnableActiveChecks() << "\n"
 		"\t" "event_handler_enabled=" << Convert::ToLong(checkable->GetEnableEventHandler()) << "\n";
 
@@ -361,56 +385,73 @@ void StatusDataWriter::DumpCheckableStatusAttrs(std::ostream& fp, const Checkabl
 	tie(host, service) = GetHostService(checkable);
 
 	if (service) {
-		fp << "\t" "current_state=" << service->GetState() << "\n"
-			"\t" "last_hard_state=" << service->GetLastHardState() << "\n"
+		fp << "\t" "current_state=" << snapshot->StateRaw << "\n"
+			"\t" "last_hard_state=" << snapshot->LastHardStateRaw << "\n"
 			"\t" "last_time_ok=" << static_cast<int>(service->GetLastStateOK()) << "\n"
 			"\t" "last_time_warn=" << static_cast<int>(service->GetLastStateWarning()) << "\n"
 			"\t" "last_time_critical=" << static_cast<int>(service->GetLastStateCritical()) << "\n"
 			"\t" "last_time_unknown=" << static_cast<int>(service->GetLastStateUnknown()) << "\n";
 	} else {
-		int currentState = host->GetState();
+		int currentState = Host::CalculateState(snapshot->StateRaw);
 
 		if (currentState != HostUp && !host->IsReachable())
 			currentState = 2; /* hardcoded compat state */
 
 		fp << "\t" "current_state=" << currentState << "\n"
-			"\t" "last_hard_state=" << host->GetLastHardState() << "\n"
+			"\t" "last_hard_state=" << Host::CalculateState(snapshot->LastHardStateRaw) << "\n"
 			"\t" "last_time_up=" << static_cast<int>(host->GetLastStateUp()) << "\n"
 			"\t" "last_time_down=" << static_cast<int>(host->GetLastStateDown()) << "\n";
 	}
 
-	fp << "\t" "state_type=" << checkable->GetStateType() << "\n"
-		"\t" "last_check=" << static_cast<long>(host->GetLastCheck()) << "\n";
+	fp << "\t" "state_type=" << snapshot->Type << "\n"
+		"\t" "last_check=" << static_cast<long>(cr ? cr->GetScheduleEnd() : -1) << "\n";
 
 	if (cr) {
 		fp << "\t" "plugin_output=" << CompatUtility::GetCheckResultOutput(cr) << "\n"
 			"\t" "long_plugin_output=" << CompatUtility::GetCheckResultLongOutput(cr) << "\n"
-			"\t" "performance_data=" << PluginUtility::FormatPerfdata(cr->GetPerformanceData()) << "\n";
+			"\t" "performance_data=" << cr->GetFormattedPerformanceData() << "\n";
 	}
 
 	fp << "\t" << "next_check=" << static_cast<long>(checkable->GetNextCheck()) << "\n"
-		"\t" "current_attempt=" << checkable->GetCheckAttempt() << "\n"
+		"\t" "current_attempt=" << snapshot->CheckAttempt << "\n"
 		"\t" "max_attempts=" << checkable->GetMaxCheckAttempts() << "\n"
-		"\t" "last_state_change=" << static_cast<long>(checkable->GetLastStateChange()) << "\n"
-		"\t" "last_hard_state_change=" << static_cast<long>(checkable->GetLastHardStateChange()) << "\n"
-		"\t" "last_update=" << static_cast<long>(Utility::GetTime()) << "\n"
+		"\t" "last_state_change=" << static_cast<long>(snapshot->LastStateChange) << "\n"
+		"\t" "last_hard_state_change=" << static_cast<long>(snapshot->LastHardStateChange) << "\n"
+		"\t" "last_update=";
+
+	std::streampos lastUpdatePos = fp.tellp();
+
+	int acknowledgement = snapshot->Acknowledgement;
+
+	if (acknowledgement != AcknowledgementNone && snapshot->AcknowledgementExpiry != 0 && snapshot->AcknowledgementExpiry < Utility::GetTime())
+		acknowledgement = AcknowledgementNone;
+
+	fp << "\n"
 		"\t" "notifications_enabled=" << Convert::ToLong(checkable->GetEnableNotifications()) << "\n"
 		"\t" "active_checks_enabled=" << Convert::ToLong(checkable->GetEnableActiveChecks()) << "\n"
 		"\t" "passive_checks_enabled=" << Convert::ToLong(checkable->GetEnablePassiveChecks()) << "\n"
 		"\t" "flap_detection_enabled=" << Convert::ToLong(checkable->GetEnableFlapping()) << "\n"
-		"\t" "is_flapping=" << Convert::ToLong(checkable->IsFlapping()) << "\n"
-		"\t" "percent_state_change=" << checkable->GetFlappingCurrent() << "\n"
-		"\t" "problem_has_been_acknowledged=" << (checkable->GetAcknowledgement() != AcknowledgementNone ? 1 : 0) << "\n"
-		"\t" "acknowledgement_type=" << checkable->GetAcknowledgement() << "\n"
-		"\t" "acknowledgement_end_time=" << checkable->GetAcknowledgementExpiry() << "\n"
+		"\t" "is_flapping=" << Convert::ToLong(snapshot->Flapping) << "\n"
+		"\t" "percent_state_change=" << snapshot->FlappingCurrent << "\n"
+		"\t" "problem_has_been_acknowledged=" << (acknowledgement != AcknowledgementNone ? 1 : 0) << "\n"
+		"\t" "acknowledgement_type=" << acknowledgement << "\n"
+		"\t" "acknowledgement_end_time=" << snapshot->AcknowledgementExpiry << "\n"
 		"\t" "scheduled_downtime_depth=" << checkable->GetDowntimeDepth() << "\n"
 		"\t" "last_notification=" << CompatUtility::GetCheckableNotificationLastNotification(checkable) << "\n"
 		"\t" "next_notification=" << CompatUtility::GetCheckableNotificationNextNotification(checkable) << "\n"
 		"\t" "current_notification_number=" << CompatUtility::GetCheckableNotificationNotificationNumber(checkable) << "\n"
 		"\t" "is_reachable=" << Convert::ToLong(checkable->IsReachable()) << "\n";
+
+	return lastUpdatePos;
 }
 
-void StatusDataWriter::DumpServiceStatus(std::ostream& fp, const Service::Ptr& service)
+/**
+ * Writes the status block of a service including its downtimes and comments.
+ *
+ * @returns The position at which the value of the "last_update" attribute
+ *          has to be inserted.
+ */
+std::streampos StatusDataWriter::DumpServiceStatus(std::ostream& fp, const Service::Ptr& service)
 {
 	Host::Ptr host = service->GetHost();
 
@@ -418,15 +459,99 @@ void StatusDataWriter::DumpServiceStatus(std::ostream& fp, const Service::Ptr& s
 		"\t" "host_name=" << host->GetName() << "\n"
 		"\t" "service_description=" << service->GetShortName() << "\n";
 
+	std::streampos lastUpdatePos;
+
 	{
-		ObjectLock olock(service);
-		DumpCheckableStatusAttrs(fp, service);
+		lastUpdatePos = DumpCheckableStatusAttrs(fp, service);
 	}
 
 	fp << "\t" "}" "\n" "\n";
 
 	DumpDowntimes(fp, service);
 	DumpComments(fp, service);
+
+	return lastUpdatePos;
+}
+
+/**
+ * Calculates a version of the checkable's status block. It changes whenever
+ * one of the objects the status block is rendered from changes.
+ */
+size_t StatusDataWriter::GetStatusVersion(const Checkable::Ptr& checkable)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	size_t seed = 0;
+
+	boost::hash_combine(seed, checkable->GetChangeSequence());
+
+	/* Services include some of their host's attributes. */
+	if (service)
+		boost::hash_combine(seed, host->GetChangeSequence());
+
+	for (const Comment::Ptr& comment : checkable->GetComments())
+		boost::hash_combine(seed, comment->GetChangeSequence());
+
+	for (const Downtime::Ptr& downtime : checkable->GetDowntimes())
+		boost::hash_combine(seed, downtime->GetChangeSequence());
+
+	for (const Notification::Ptr& notification : checkable->GetNotifications())
+		boost::hash_combine(seed, notification->GetChangeSequence());
+
+	CheckCommand::Ptr checkCommand = checkable->GetCheckCommand();
+
+	if (checkCommand)
+		boost::hash_combine(seed, checkCommand->GetChangeSequence());
+
+	/* These depend on other objects' state and on global settings. */
+	boost::hash_combine(seed, checkable->IsReachable());
+	boost::hash_combine(seed, checkable->IsFlapping());
+
+	return seed;
+}
+
+/**
+ * Writes the status block of a checkable to the status file. The block is
+ * only rendered again if the checkable has changed since the last time.
+ */
+void StatusDataWriter::WriteStatusBlock(std::ostream& fp, const Checkable::Ptr& checkable,
+	std::map<Checkable::Ptr, StatusBlock>& blocks, const String& lastUpdate)
+{
+	size_t version = GetStatusVersion(checkable);
+
+	auto it = m_StatusBlocks.find(checkable);
+
+	if (it == m_StatusBlocks.end() || it->second.Version != version) {
+		Host::Ptr host;
+		Service::Ptr service;
+		tie(host, service) = GetHostService(checkable);
+
+		std::ostringstream tempstatusfp;
+		tempstatusfp << std::fixed;
+
+		std::streampos lastUpdatePos;
+
+		if (service)
+			lastUpdatePos = DumpServiceStatus(tempstatusfp, service);
+		else
+			lastUpdatePos = DumpHostStatus(tempstatusfp, host);
+
+		StatusBlock block;
+		block.Version = version;
+		block.Text = tempstatusfp.str();
+		block.LastUpdateOffset = static_cast<size_t>(lastUpdatePos);
+
+		it = blocks.emplace(checkable, std::move(block)).first;
+	} else
+		it = blocks.emplace(checkable, std::move(it->second)).first;
+
+	const StatusBlock& block = it->second;
+
+	fp.write(block.Text.CStr(), block.LastUpdateOffset);
+	fp << lastUpdate;
+	fp.write(block.Text.CStr() + block.LastUpdateOffset, block.Text.GetLength() - block.LastUpdateOffset);
 }
 
 void StatusDataWriter::DumpServiceObject(std::ostream& fp, const Service::Ptr& service)
@@ -555,228 +680,282 @@ void StatusDataWriter::DumpCustomAttributes(std::ostream& fp, const CustomVarObj
 		fp << "\t" "_is_json" "\t" "1" "\n";
 }
 
-void StatusDataWriter::UpdateObjectsCache()
+void StatusDataWriter::DumpHostGroupObject(std::ostream& fp, const HostGroup::Ptr& hg)
 {
-	CONTEXT("Writing objects.cache file");
+	String display_name = hg->GetDisplayName();
+	String notes = hg->GetNotes();
+	String notes_url = hg->GetNotesUrl();
+	String action_url = hg->GetActionUrl();
 
-	String objectsPath = GetObjectsPath();
+	fp << "define hostgroup {" "\n"
+			"\t" "hostgroup_name" "\t" << hg->GetName() << "\n";
 
-	std::fstream objectfp;
-	String tempObjectsPath = Utility::CreateTempFile(objectsPath + ".XXXXXX", 0644, objectfp);
-
-	objectfp << std::fixed;
+	if (!display_name.IsEmpty())
+		fp << "\t" "alias" "\t" << display_name << "\n";
+	if (!notes.IsEmpty())
+		fp << "\t" "notes" "\t" << notes << "\n";
+	if (!notes_url.IsEmpty())
+		fp << "\t" "notes_url" "\t" << notes_url << "\n";
+	if (!action_url.IsEmpty())
+		fp << "\t" "action_url" "\t" << action_url << "\n";
 
-	objectfp << "# Icinga objects cache file" "\n"
-			"# This file is auto-generated. Do not modify this file." "\n"
-			"\n";
+	DumpCustomAttributes(fp, hg);
 
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		std::ostringstream tempobjectfp;
-		tempobjectfp << std::fixed;
-		DumpHostObject(tempobjectfp, host);
-		objectfp << tempobjectfp.str();
-
-		for (const Service::Ptr& service : host->GetServices()) {
-			std::ostringstream tempobjectfp;
-			tempobjectfp << std::fixed;
-			DumpServiceObject(tempobjectfp, service);
-			objectfp << tempobjectfp.str();
-		}
-	}
+	fp << "\t" "members" "\t";
+	DumpNameList(fp, hg->GetMembers());
+	fp << "\n" "\t" "}" "\n";
+}
 
-	for (const HostGroup::Ptr& hg : ConfigType::GetObjectsByType<HostGroup>()) {
-		std::ostringstream tempobjectfp;
-		tempobjectfp << std::fixed;
+void StatusDataWriter::DumpServiceGroupObject(std::ostream& fp, const ServiceGroup::Ptr& sg)
+{
+	String display_name = sg->GetDisplayName();
+	String notes = sg->GetNotes();
+	String notes_url = sg->GetNotesUrl();
+	String action_url = sg->GetActionUrl();
 
-		String display_name = hg->GetDisplayName();
-		String notes = hg->GetNotes();
-		String notes_url = hg->GetNotesUrl();
-		String action_url = hg->GetActionUrl();
+	fp << "define servicegroup {" "\n"
+		"\t" "servicegroup_name" "\t" << sg->GetName() << "\n";
 
-		tempobjectfp << "define hostgroup {" "\n"
-				"\t" "hostgroup_name" "\t" << hg->GetName() << "\n";
+	if (!display_name.IsEmpty())
+		fp << "\t" "alias" "\t" << display_name << "\n";
+	if (!notes.IsEmpty())
+		fp << "\t" "notes" "\t" << notes << "\n";
+	if (!notes_url.IsEmpty())
+		fp << "\t" "notes_url" "\t" << notes_url << "\n";
+	if (!action_url.IsEmpty())
+		fp << "\t" "action_url" "\t" << action_url << "\n";
 
-		if (!display_name.IsEmpty())
-			tempobjectfp << "\t" "alias" "\t" << display_name << "\n";
-		if (!notes.IsEmpty())
-			tempobjectfp << "\t" "notes" "\t" << notes << "\n";
-		if (!notes_url.IsEmpty())
-			tempobjectfp << "\t" "notes_url" "\t" << notes_url << "\n";
-		if (!action_url.IsEmpty())
-			tempobjectfp << "\t" "action_url" "\t" << action_url << "\n";
+	DumpCustomAttributes(fp, sg);
 
-		DumpCustomAttributes(tempobjectfp, hg);
+	fp << "\t" "members" "\t";
 
-		tempobjectfp << "\t" "members" "\t";
-		DumpNameList(tempobjectfp, hg->GetMembers());
-		tempobjectfp << "\n" "\t" "}" "\n";
+	std::vector<String> sglist;
+	for (const Service::Ptr& service : sg->GetMembers()) {
+		Host::Ptr host = service->GetHost();
 
-		objectfp << tempobjectfp.str();
+		sglist.emplace_back(host->GetName());
+		sglist.emplace_back(service->GetShortName());
 	}
 
-	for (const ServiceGroup::Ptr& sg : ConfigType::GetObjectsByType<ServiceGroup>()) {
-		std::ostringstream tempobjectfp;
-		tempobjectfp << std::fixed;
-
-		String display_name = sg->GetDisplayName();
-		String notes = sg->GetNotes();
-		String notes_url = sg->GetNotesUrl();
-		String action_url = sg->GetActionUrl();
+	DumpStringList(fp, sglist);
 
-		tempobjectfp << "define servicegroup {" "\n"
-			"\t" "servicegroup_name" "\t" << sg->GetName() << "\n";
+	fp << "\n" "}" "\n";
+}
 
-		if (!display_name.IsEmpty())
-			tempobjectfp << "\t" "alias" "\t" << display_name << "\n";
-		if (!notes.IsEmpty())
-			tempobjectfp << "\t" "notes" "\t" << notes << "\n";
-		if (!notes_url.IsEmpty())
-			tempobjectfp << "\t" "notes_url" "\t" << notes_url << "\n";
-		if (!action_url.IsEmpty())
-			tempobjectfp << "\t" "action_url" "\t" << action_url << "\n";
+void StatusDataWriter::DumpUserObject(std::ostream& fp, const User::Ptr& user)
+{
+	String email = user->GetEmail();
+	String pager = user->GetPager();
+	String alias = user->GetDisplayName();
+
+	fp << "define contact {" "\n"
+			"\t" "contact_name" "\t" << user->GetName() << "\n";
+
+	if (!alias.IsEmpty())
+		fp << "\t" "alias" "\t" << alias << "\n";
+	if (!email.IsEmpty())
+		fp << "\t" "email" "\t" << email << "\n";
+	if (!pager.IsEmpty())
+		fp << "\t" "pager" "\t" << pager << "\n";
+
+	fp << "\t" "service_notification_options" "\t" "w,u,c,r,f,s" "\n"
+		"\t" "host_notification_options""\t" "d,u,r,f,s" "\n"
+		"\t" "host_notifications_enabled" "\t" "1" "\n"
+		"\t" "service_notifications_enabled" "\t" "1" "\n"
+		"\t" "}" "\n"
+		"\n";
+}
 
-		DumpCustomAttributes(tempobjectfp, sg);
+void StatusDataWriter::DumpUserGroupObject(std::ostream& fp, const UserGroup::Ptr& ug)
+{
+	fp << "define contactgroup {" "\n"
+			"\t" "contactgroup_name" "\t" << ug->GetName() << "\n"
+			"\t" "alias" "\t" << ug->GetDisplayName() << "\n";
+
+	fp << "\t" "members" "\t";
+	DumpNameList(fp, ug->GetMembers());
+	fp << "\n"
+			"\t" "}" "\n";
+}
 
-		tempobjectfp << "\t" "members" "\t";
+void StatusDataWriter::DumpDependencyObject(std::ostream& fp, const Dependency::Ptr& dep)
+{
+	Checkable::Ptr parent = dep->GetParent();
 
-		std::vector<String> sglist;
-		for (const Service::Ptr& service : sg->GetMembers()) {
-			Host::Ptr host = service->GetHost();
+	if (!parent) {
+		Log(LogDebug, "StatusDataWriter")
+			<< "Missing parent for dependency '" << dep->GetName() << "'.";
+		return;
+	}
 
-			sglist.emplace_back(host->GetName());
-			sglist.emplace_back(service->GetShortName());
-		}
+	Host::Ptr parent_host;
+	Service::Ptr parent_service;
+	tie(parent_host, parent_service) = GetHostService(parent);
 
-		DumpStringList(tempobjectfp, sglist);
+	Checkable::Ptr child = dep->GetChild();
 
-		tempobjectfp << "\n" "}" "\n";
+	if (!child) {
+		Log(LogDebug, "StatusDataWriter")
+			<< "Missing child for dependency '" << dep->GetName() << "'.";
+		return;
+	}
 
-		objectfp << tempobjectfp.str();
+	Host::Ptr child_host;
+	Service::Ptr child_service;
+	tie(child_host, child_service) = GetHostService(child);
+
+	int state_filter = dep->GetStateFilter();
+	std::vector<String> failure_criteria;
+	if (state_filter & StateFilterOK || state_filter & StateFilterUp)
+		failure_criteria.emplace_back("o");
+	if (state_filter & StateFilterWarning)
+		failure_criteria.emplace_back("w");
+	if (state_filter & StateFilterCritical)
+		failure_criteria.emplace_back("c");
+	if (state_filter & StateFilterUnknown)
+		failure_criteria.emplace_back("u");
+	if (state_filter & StateFilterDown)
+		failure_criteria.emplace_back("d");
+
+	String criteria = boost::algorithm::join(failure_criteria, ",");
+
+	/* Icinga 1.x only allows host->host, service->service dependencies */
+	if (!child_service && !parent_service) {
+		fp << "define hostdependency {" "\n"
+			"\t" "dependent_host_name" "\t" << child_host->GetName() << "\n"
+			"\t" "host_name" "\t" << parent_host->GetName() << "\n"
+			"\t" "execution_failure_criteria" "\t" << criteria << "\n"
+			"\t" "notification_failure_criteria" "\t" << criteria << "\n"
+			"\t" "}" "\n"
+			"\n";
+	} else if (child_service && parent_service){
+
+		fp << "define servicedependency {" "\n"
+			"\t" "dependent_host_name" "\t" << child_service->GetHost()->GetName() << "\n"
+			"\t" "dependent_service_description" "\t" << child_service->GetShortName() << "\n"
+			"\t" "host_name" "\t" << parent_service->GetHost()->GetName() << "\n"
+			"\t" "service_description" "\t" << parent_service->GetShortName() << "\n"
+			"\t" "execution_failure_criteria" "\t" << criteria << "\n"
+			"\t" "notification_failure_criteria" "\t" << criteria << "\n"
+			"\t" "}" "\n"
+			"\n";
 	}
+}
 
-	for (const User::Ptr& user : ConfigType::GetObjectsByType<User>()) {
-		std::ostringstream tempobjectfp;
-		tempobjectfp << std::fixed;
+/**
+ * Renders the objects.cache block for a single object.
+ */
+String StatusDataWriter::RenderObject(const ConfigObject::Ptr& object)
+{
+	std::ostringstream fp;
+	fp << std::fixed;
+
+	Type::Ptr type = object->GetReflectionType();
+
+	if (type == Host::TypeInstance)
+		DumpHostObject(fp, static_pointer_cast<Host>(object));
+	else if (type == Service::TypeInstance)
+		DumpServiceObject(fp, static_pointer_cast<Service>(object));
+	else if (type == HostGroup::TypeInstance)
+		DumpHostGroupObject(fp, static_pointer_cast<HostGroup>(object));
+	else if (type == ServiceGroup::TypeInstance)
+		DumpServiceGroupObject(fp, static_pointer_cast<ServiceGroup>(object));
+	else if (type == User::TypeInstance)
+		DumpUserObject(fp, static_pointer_cast<User>(object));
+	else if (type == UserGroup::TypeInstance)
+		DumpUserGroupObject(fp, static_pointer_cast<UserGroup>(object));
+	else if (type == TimePeriod::TypeInstance)
+		DumpTimePeriod(fp, static_pointer_cast<TimePeriod>(object));
+	else if (type == Dependency::TypeInstance)
+		DumpDependencyObject(fp, static_pointer_cast<Dependency>(object));
+	else
+		DumpCommand(fp, static_pointer_cast<Command>(object));
+
+	return fp.str();
+}
 
-		String email = user->GetEmail();
-		String pager = user->GetPager();
-		String alias = user->GetDisplayName();
+/**
+ * Renders the objects.cache blocks in parallel and writes them to the
+ * file in the same order as they would have been rendered sequentially.
+ */
+void StatusDataWriter::UpdateObjectsCache()
+{
+	CONTEXT("Writing objects.cache file");
 
-		tempobjectfp << "define contact {" "\n"
-				"\t" "contact_name" "\t" << user->GetName() << "\n";
+	double start = Utility::GetTime();
 
-		if (!alias.IsEmpty())
-			tempobjectfp << "\t" "alias" "\t" << alias << "\n";
-		if (!email.IsEmpty())
-			tempobjectfp << "\t" "email" "\t" << email << "\n";
-		if (!pager.IsEmpty())
-			tempobjectfp << "\t" "pager" "\t" << pager << "\n";
+	boost::mutex::scoped_lock lock(m_ObjectsCacheMutex);
 
-		tempobjectfp << "\t" "service_notification_options" "\t" "w,u,c,r,f,s" "\n"
-			"\t" "host_notification_options""\t" "d,u,r,f,s" "\n"
-			"\t" "host_notifications_enabled" "\t" "1" "\n"
-			"\t" "service_notifications_enabled" "\t" "1" "\n"
-			"\t" "}" "\n"
-			"\n";
+	/* Changes after this point will be picked up by the next update. */
+	m_ObjectsCacheOutdated = false;
+
+	std::vector<ConfigObject::Ptr> objects;
 
-		objectfp << tempobjectfp.str();
+	for (Host *host : ConfigType::GetObjectRange<Host>()) {
+		objects.push_back(host);
+
+		for (const Service::Ptr& service : host->GetServices())
+			objects.push_back(service);
 	}
 
-	for (const UserGroup::Ptr& ug : ConfigType::GetObjectsByType<UserGroup>()) {
-		std::ostringstream tempobjectfp;
-		tempobjectfp << std::fixed;
+	for (HostGroup *hg : ConfigType::GetObjectRange<HostGroup>())
+		objects.push_back(hg);
 
-		tempobjectfp << "define contactgroup {" "\n"
-				"\t" "contactgroup_name" "\t" << ug->GetName() << "\n"
-				"\t" "alias" "\t" << ug->GetDisplayName() << "\n";
+	for (ServiceGroup *sg : ConfigType::GetObjectRange<ServiceGroup>())
+		objects.push_back(sg);
 
-		tempobjectfp << "\t" "members" "\t";
-		DumpNameList(tempobjectfp, ug->GetMembers());
-		tempobjectfp << "\n"
-				"\t" "}" "\n";
+	for (User *user : ConfigType::GetObjectRange<User>())
+		objects.push_back(user);
 
-		objectfp << tempobjectfp.str();
-	}
+	for (UserGroup *ug : ConfigType::GetObjectRange<UserGroup>())
+		objects.push_back(ug);
 
-	for (const Command::Ptr& command : ConfigType::GetObjectsByType<CheckCommand>()) {
-		DumpCommand(objectfp, command);
-	}
+	for (CheckCommand *command : ConfigType::GetObjectRange<CheckCommand>())
+		objects.push_back(command);
 
-	for (const Command::Ptr& command : ConfigType::GetObjectsByType<NotificationCommand>()) {
-		DumpCommand(objectfp, command);
-	}
+	for (NotificationCommand *command : ConfigType::GetObjectRange<NotificationCommand>())
+		objects.push_back(command);
 
-	for (const Command::Ptr& command : ConfigType::GetObjectsByType<EventCommand>()) {
-		DumpCommand(objectfp, command);
-	}
+	for (EventCommand *command : ConfigType::GetObjectRange<EventCommand>())
+		objects.push_back(command);
 
-	for (const TimePeriod::Ptr& tp : ConfigType::GetObjectsByType<TimePeriod>()) {
-		DumpTimePeriod(objectfp, tp);
-	}
+	for (TimePeriod *tp : ConfigType::GetObjectRange<TimePeriod>())
+		objects.push_back(tp);
 
-	for (const Dependency::Ptr& dep : ConfigType::GetObjectsByType<Dependency>()) {
-		Checkable::Ptr parent = dep->GetParent();
+	for (Dependency *dep : ConfigType::GetObjectRange<Dependency>())
+		objects.push_back(dep);
 
-		if (!parent) {
-			Log(LogDebug, "StatusDataWriter")
-				<< "Missing parent for dependency '" << dep->GetName() << "'.";
-			continue;
-		}
+	std::vector<String> blocks(objects.size());
+	std::vector<size_t> indices(objects.size());
+	std::iota(indices.begin(), indices.end(), 0);
 
-		Host::Ptr parent_host;
-		Service::Ptr parent_service;
-		tie(parent_host, parent_service) = GetHostService(parent);
+	WorkQueue upq(25000, Application::GetConcurrency());
+	upq.SetName("StatusDataWriter, objects.cache");
 
-		Checkable::Ptr child = dep->GetChild();
+	upq.ParallelFor(indices, [this, &objects, &blocks](size_t index) {
+		blocks[index] = RenderObject(objects[index]);
+	});
 
-		if (!child) {
-			Log(LogDebug, "StatusDataWriter")
-				<< "Missing child for dependency '" << dep->GetName() << "'.";
-			continue;
-		}
+	upq.Join();
 
-		Host::Ptr child_host;
-		Service::Ptr child_service;
-		tie(child_host, child_service) = GetHostService(child);
-
-		int state_filter = dep->GetStateFilter();
-		std::vector<String> failure_criteria;
-		if (state_filter & StateFilterOK || state_filter & StateFilterUp)
-			failure_criteria.emplace_back("o");
-		if (state_filter & StateFilterWarning)
-			failure_criteria.emplace_back("w");
-		if (state_filter & StateFilterCritical)
-			failure_criteria.emplace_back("c");
-		if (state_filter & StateFilterUnknown)
-			failure_criteria.emplace_back("u");
-		if (state_filter & StateFilterDown)
-			failure_criteria.emplace_back("d");
-
-		String criteria = boost::algorithm::join(failure_criteria, ",");
-
-		/* Icinga 1.x only allows host->host, service->service dependencies */
-		if (!child_service && !parent_service) {
-			objectfp << "define hostdependency {" "\n"
-				"\t" "dependent_host_name" "\t" << child_host->GetName() << "\n"
-				"\t" "host_name" "\t" << parent_host->GetName() << "\n"
-				"\t" "execution_failure_criteria" "\t" << criteria << "\n"
-				"\t" "notification_failure_criteria" "\t" << criteria << "\n"
-				"\t" "}" "\n"
-				"\n";
-		} else if (child_service && parent_service){
-
-			objectfp << "define servicedependency {" "\n"
-				"\t" "dependent_host_name" "\t" << child_service->GetHost()->GetName() << "\n"
-				"\t" "dependent_service_description" "\t" << child_service->GetShortName() << "\n"
-				"\t" "host_name" "\t" << parent_service->GetHost()->GetName() << "\n"
-				"\t" "service_description" "\t" << parent_service->GetShortName() << "\n"
-				"\t" "execution_failure_criteria" "\t" << criteria << "\n"
-				"\t" "notification_failure_criteria" "\t" << criteria << "\n"
-				"\t" "}" "\n"
-				"\n";
-		}
+	if (upq.HasExceptions()) {
+		upq.ReportExceptions("StatusDataWriter");
+		m_ObjectsCacheOutdated = true;
+		return;
 	}
 
+	String objectsPath = GetObjectsPath();
+
+	std::fstream objectfp;
+	String tempObjectsPath = Utility::CreateTempFile(objectsPath + ".XXXXXX", 0644, objectfp);
+
+	objectfp << "# Icinga objects cache file" "\n"
+			"# This file is auto-generated. Do not modify this file." "\n"
+			"\n";
+
+	for (const String& block : blocks)
+		objectfp << block;
+
 	objectfp.close();
 
 #ifdef _WIN32
@@ -789,6 +968,26 @@ void StatusDataWriter::UpdateObjectsCache()
 			<< boost::errinfo_errno(errno)
 			<< boost::errinfo_file_name(tempObjectsPath));
 	}
+
+	Log(LogNotice, "StatusDataWriter")
+		<< "Writing objects.cache file for " << objects.size() << " objects took " << Utility::FormatDuration(Utility::GetTime() - start);
+}
+
+/**
+ * Writes the objects.cache file right after the activation which started
+ * this writer, so that it is consistent with the activated config.
+ */
+void StatusDataWriter::ItemsActivatedHandler()
+{
+	if (!IsActive() || !m_ObjectsCacheActivationPending.exchange(false))
+		return;
+
+	try {
+		UpdateObjectsCache();
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "StatusDataWriter")
+			<< "Cannot write objects.cache file: " << DiagnosticInformation(ex, false);
+	}
 }
 
 /**
@@ -796,10 +995,9 @@ void StatusDataWriter::UpdateObjectsCache()
  */
 void StatusDataWriter::StatusTimerHandler()
 {
-	if (m_ObjectsCacheOutdated) {
+	/* The objects.cache file is written once activation has finished. */
+	if (m_ObjectsCacheOutdated && !m_ObjectsCacheActivationPending)
 		UpdateObjectsCache();
-		m_ObjectsCacheOutdated = false;
-	}
 
 	double start = Utility::GetTime();
 
@@ -845,20 +1043,20 @@ void StatusDataWriter::StatusTimerHandler()
 	statusfp << "\t" "}" "\n"
 			"\n";
 
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		std::ostringstream tempstatusfp;
-		tempstatusfp << std::fixed;
-		DumpHostStatus(tempstatusfp, host);
-		statusfp << tempstatusfp.str();
-
-		for (const Service::Ptr& service : host->GetServices()) {
-			std::ostringstream tempstatusfp;
-			tempstatusfp << std::fixed;
-			DumpServiceStatus(tempstatusfp, service);
-			statusfp << tempstatusfp.str();
-		}
+	String lastUpdate = Convert::ToString(static_cast<long>(Utility::GetTime()));
+
+	/* Blocks of objects which no longer exist are dropped along with the old map. */
+	std::map<Checkable::Ptr, StatusBlock> blocks;
+
+	for (Host *host : ConfigType::GetObjectRange<Host>()) {
+		WriteStatusBlock(statusfp, host, blocks, lastUpdate);
+
+		for (const Service::Ptr& service : host->GetServices())
+			WriteStatusBlock(statusfp, service, blocks, lastUpdate);
 	}
 
+	m_StatusBlocks.swap(blocks);
+
 	statusfp.close();
 
 #ifdef _WIN32
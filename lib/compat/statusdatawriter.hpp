@@ -25,10 +25,18 @@
 #include "icinga/host.hpp"
 #include "icinga/service.hpp"
 #include "icinga/command.hpp"
+#include "icinga/hostgroup.hpp"
+#include "icinga/servicegroup.hpp"
+#include "icinga/user.hpp"
+#include "icinga/usergroup.hpp"
+#include "icinga/dependency.hpp"
 #include "icinga/compatutility.hpp"
 #include "base/timer.hpp"
 #include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <atomic>
 #include <iostream>
+#include <map>
 
 namespace icinga
 {
@@ -49,17 +57,27 @@ protected:
 	void Stop(bool runtimeRemoved) override;
 
 private:
+	struct StatusBlock
+	{
+		size_t Version;
+		String Text;
+		size_t LastUpdateOffset;
+	};
+
 	Timer::Ptr m_StatusTimer;
-	bool m_ObjectsCacheOutdated;
+	std::atomic<bool> m_ObjectsCacheOutdated{false};
+	std::atomic<bool> m_ObjectsCacheActivationPending{false};
+	boost::mutex m_ObjectsCacheMutex;
+	std::map<Checkable::Ptr, StatusBlock> m_StatusBlocks;
 
 	void DumpCommand(std::ostream& fp, const Command::Ptr& command);
 	void DumpTimePeriod(std::ostream& fp, const TimePeriod::Ptr& tp);
 	void DumpDowntimes(std::ostream& fp, const Checkable::Ptr& owner);
 	void DumpComments(std::ostream& fp, const Checkable::Ptr& owner);
-	void DumpHostStatus(std::ostream& fp, const Host::Ptr& host);
+	std::streampos DumpHostStatus(std::ostream& fp, const Host::Ptr& host);
 	void DumpHostObject(std::ostream& fp, const Host::Ptr& host);
 
-	void DumpCheckableStatusAttrs(std::ostream& fp, const Checkable::Ptr& checkable);
+	std::streampos DumpCheckableStatusAttrs(std::ostream& fp, const Checkable::Ptr& checkable);
 
 	template<typename T>
 	void DumpNameList(std::ostream& fp, const T& list)
@@ -89,12 +107,24 @@ private:
 		}
 	}
 
-	void DumpServiceStatus(std::ostream& fp, const Service::Ptr& service);
+	std::streampos DumpServiceStatus(std::ostream& fp, const Service::Ptr& service);
 	void DumpServiceObject(std::ostream& fp, const Service::Ptr& service);
 
 	void DumpCustomAttributes(std::ostream& fp, const CustomVarObject::Ptr& object);
 
+	void DumpHostGroupObject(std::ostream& fp, const HostGroup::Ptr& hg);
+	void DumpServiceGroupObject(std::ostream& fp, const ServiceGroup::Ptr& sg);
+	void DumpUserObject(std::ostream& fp, const User::Ptr& user);
+	void DumpUserGroupObject(std::ostream& fp, const UserGroup::Ptr& ug);
+	void DumpDependencyObject(std::ostream& fp, const Dependency::Ptr& dep);
+	String RenderObject(const ConfigObject::Ptr& object);
+
+	static size_t GetStatusVersion(const Checkable::Ptr& checkable);
+	void WriteStatusBlock(std::ostream& fp, const Checkable::Ptr& checkable,
+		std::map<Checkable::Ptr, StatusBlock>& blocks, const String& lastUpdate);
+
 	void UpdateObjectsCache();
+	void ItemsActivatedHandler();
 	void StatusTimerHandler();
 	void ObjectHandler();
 
@@ -18,7 +18,10 @@
  ******************************************************************************/
 
 #include "config/applyrule.hpp"
+#include "config/ruleindex.hpp"
+#include "config/configprofiler.hpp"
 #include "base/logger.hpp"
+#include <boost/thread/mutex.hpp>
 #include <set>
 
 using namespace icinga;
@@ -26,6 +29,9 @@ using namespace icinga;
 ApplyRule::RuleMap ApplyRule::m_Rules;
 ApplyRule::TypeMap ApplyRule::m_Types;
 
+static boost::mutex l_RuleIndexesMutex;
+static std::map<String, std::shared_ptr<const RuleIndex> > l_RuleIndexes;
+
 ApplyRule::ApplyRule(String targetType, String name, std::shared_ptr<Expression> expression,
 	std::shared_ptr<Expression> filter, String package, String fkvar, String fvvar, std::shared_ptr<Expression> fterm,
 	bool ignoreOnError, DebugInfo di, Dictionary::Ptr scope)
@@ -97,7 +103,16 @@ void ApplyRule::AddRule(const String& sourceType, const String& targetType, cons
 
 bool ApplyRule::EvaluateFilter(ScriptFrame& frame) const
 {
-	return Convert::ToBool(m_Filter->Evaluate(frame));
+	if (!ConfigProfiler::IsEnabled())
+		return Convert::ToBool(m_Filter->Evaluate(frame));
+
+	std::ostringstream msgbuf;
+	msgbuf << m_Name << " (" << m_DebugInfo << ")";
+
+	ConfigProfilerScope profile("apply", msgbuf.str());
+	bool result = Convert::ToBool(m_Filter->Evaluate(frame));
+	profile.SetHit(result);
+	return result;
 }
 
 void ApplyRule::RegisterType(const String& sourceType, const std::vector<String>& targetTypes)
@@ -158,6 +173,59 @@ std::vector<ApplyRule>& ApplyRule::GetRules(const String& type)
 	return it->second;
 }
 
+static std::shared_ptr<const RuleIndex> BuildRuleIndex(const std::vector<ApplyRule>& rules)
+{
+	/* Apply rules are evaluated for hosts and services. */
+	auto index = std::make_shared<RuleIndex>(std::set<String>{ "host", "service" });
+
+	for (const ApplyRule& rule : rules) {
+		/* Variables from 'for' loops shadow the ones we know about. */
+		std::set<String> shadowed;
+
+		if (!rule.GetFKVar().IsEmpty())
+			shadowed.insert(rule.GetFKVar());
+
+		if (!rule.GetFVVar().IsEmpty())
+			shadowed.insert(rule.GetFVVar());
+
+		index->AddRule(rule.GetFilter().get(), rule.GetScope(), shadowed);
+	}
+
+	return index;
+}
+
+/**
+ * Returns the rules for a type whose filters may match the specified
+ * variables, in the order in which the rules were added. Rules whose
+ * filters can't be analyzed are always returned.
+ *
+ * @param type The source type.
+ * @param variables The variables the filters will be evaluated with, e.g. 'host'.
+ * @returns The candidate rules.
+ */
+std::vector<ApplyRule *> ApplyRule::GetCandidateRules(const String& type, const std::map<String, Value>& variables)
+{
+	std::vector<ApplyRule>& rules = GetRules(type);
+	std::shared_ptr<const RuleIndex> index;
+
+	{
+		boost::mutex::scoped_lock lock(l_RuleIndexesMutex);
+		std::shared_ptr<const RuleIndex>& cachedIndex = l_RuleIndexes[type];
+
+		if (!cachedIndex || cachedIndex->GetRuleCount() != rules.size())
+			cachedIndex = BuildRuleIndex(rules);
+
+		index = cachedIndex;
+	}
+
+	std::vector<ApplyRule *> result;
+
+	for (size_t rule : index->GetCandidates(variables))
+		result.push_back(&rules[rule]);
+
+	return result;
+}
+
 void ApplyRule::CheckMatches()
 {
 	for (const RuleMap::value_type& kv : m_Rules) {
@@ -0,0 +1,591 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/bytecode.hpp"
+#include "config/vmops.hpp"
+#include "base/json.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/logger.hpp"
+#include <boost/exception/errinfo_nested_exception.hpp>
+
+using namespace icinga;
+
+BytecodeExpression::BytecodeExpression(std::shared_ptr<Expression> expression)
+	: m_Expression(std::move(expression))
+{ }
+
+BytecodeExpression::~BytecodeExpression()
+{ }
+
+bool BytecodeExpression::GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint) const
+{
+	return m_Expression->GetReference(frame, init_dict, parent, index, dhint);
+}
+
+const DebugInfo& BytecodeExpression::GetDebugInfo() const
+{
+	return m_Expression->GetDebugInfo();
+}
+
+ExpressionResult BytecodeExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
+{
+	/* Debug hints and breakpoints need the expression tree. */
+	if (dhint || !Expression::OnBreakpoint.empty())
+		return m_Expression->DoEvaluate(frame, dhint);
+
+	std::call_once(m_CompileOnce, [this]() {
+		m_Program = BytecodeCompiler::Compile(m_Expression.get());
+	});
+
+	return m_Program->Run(frame);
+}
+
+/**
+ * Wraps an expression so that it's evaluated by the bytecode VM.
+ *
+ * @param expression The expression, or nullptr.
+ * @returns The wrapped expression, or nullptr.
+ */
+std::shared_ptr<Expression> icinga::MakeBytecode(std::unique_ptr<Expression> expression)
+{
+	if (!expression)
+		return nullptr;
+
+	return std::make_shared<BytecodeExpression>(std::move(expression));
+}
+
+BytecodeCompiler::BytecodeCompiler()
+	: m_Program(new BytecodeProgram())
+{ }
+
+std::unique_ptr<BytecodeProgram> BytecodeCompiler::Compile(const Expression *expression)
+{
+	BytecodeCompiler compiler;
+	compiler.CompileExpression(expression, 0);
+
+	if (compiler.m_FoldedConstants > 0 || compiler.m_ConstantSets > 0) {
+		Log(LogDebug, "BytecodeCompiler")
+			<< "Optimized expression at " << expression->GetDebugInfo() << ": Folded " << compiler.m_FoldedConstants
+			<< " constant expression(s), " << compiler.m_ConstantSets << " 'in' operator(s) use a precomputed set.";
+	}
+
+	return std::move(compiler.m_Program);
+}
+
+int BytecodeCompiler::AllocateRegister()
+{
+	int reg = m_NextRegister++;
+
+	if (m_NextRegister > m_Program->RegisterCount)
+		m_Program->RegisterCount = m_NextRegister;
+
+	return reg;
+}
+
+void BytecodeCompiler::FreeRegisters(int first)
+{
+	m_NextRegister = first;
+}
+
+size_t BytecodeCompiler::Emit(BytecodeOpcode op, const Expression *expr, int dst, int a, int b, size_t index)
+{
+	m_Program->Instructions.push_back({ op, dst, a, b, index, expr });
+	return m_Program->Instructions.size() - 1;
+}
+
+void BytecodeCompiler::EmitConstant(const Value& value, const Expression *expr, int dst)
+{
+	m_Program->Constants.push_back(value);
+	Emit(OpLoadConstant, expr, dst, 0, 0, m_Program->Constants.size() - 1);
+}
+
+static BytecodeOpcode GetBinaryOpcode(const Expression *expr)
+{
+	if (dynamic_cast<const AddExpression *>(expr))
+		return OpAdd;
+	else if (dynamic_cast<const SubtractExpression *>(expr))
+		return OpSubtract;
+	else if (dynamic_cast<const MultiplyExpression *>(expr))
+		return OpMultiply;
+	else if (dynamic_cast<const DivideExpression *>(expr))
+		return OpDivide;
+	else if (dynamic_cast<const ModuloExpression *>(expr))
+		return OpModulo;
+	else if (dynamic_cast<const XorExpression *>(expr))
+		return OpXor;
+	else if (dynamic_cast<const BinaryAndExpression *>(expr))
+		return OpBinaryAnd;
+	else if (dynamic_cast<const BinaryOrExpression *>(expr))
+		return OpBinaryOr;
+	else if (dynamic_cast<const ShiftLeftExpression *>(expr))
+		return OpShiftLeft;
+	else if (dynamic_cast<const ShiftRightExpression *>(expr))
+		return OpShiftRight;
+	else if (dynamic_cast<const EqualExpression *>(expr))
+		return OpEqual;
+	else if (dynamic_cast<const NotEqualExpression *>(expr))
+		return OpNotEqual;
+	else if (dynamic_cast<const LessThanExpression *>(expr))
+		return OpLessThan;
+	else if (dynamic_cast<const GreaterThanExpression *>(expr))
+		return OpGreaterThan;
+	else if (dynamic_cast<const LessThanOrEqualExpression *>(expr))
+		return OpLessThanOrEqual;
+	else if (dynamic_cast<const GreaterThanOrEqualExpression *>(expr))
+		return OpGreaterThanOrEqual;
+	else if (dynamic_cast<const IndexerExpression *>(expr))
+		return OpGetField;
+	else
+		return OpEvaluate;
+}
+
+/**
+ * Checks whether an expression only consists of operators whose operands
+ * are scalar literals.
+ *
+ * @param expr The expression.
+ * @returns true if the expression is constant, false otherwise.
+ */
+bool BytecodeCompiler::IsConstant(const Expression *expr)
+{
+	if (auto lexpr = dynamic_cast<const LiteralExpression *>(expr))
+		return !lexpr->GetValue().IsObject();
+
+	BytecodeOpcode binaryOp = GetBinaryOpcode(expr);
+
+	if (binaryOp != OpEvaluate && binaryOp != OpGetField) {
+		auto bexpr = static_cast<const BinaryExpression *>(expr);
+		return IsConstant(bexpr->GetOperand1().get()) && IsConstant(bexpr->GetOperand2().get());
+	}
+
+	if (auto nexpr = dynamic_cast<const NegateExpression *>(expr))
+		return IsConstant(nexpr->GetOperand().get());
+
+	if (auto lnexpr = dynamic_cast<const LogicalNegateExpression *>(expr))
+		return IsConstant(lnexpr->GetOperand().get());
+
+	if (auto laexpr = dynamic_cast<const LogicalAndExpression *>(expr))
+		return IsConstant(laexpr->GetOperand1().get()) && IsConstant(laexpr->GetOperand2().get());
+
+	if (auto loexpr = dynamic_cast<const LogicalOrExpression *>(expr))
+		return IsConstant(loexpr->GetOperand1().get()) && IsConstant(loexpr->GetOperand2().get());
+
+	return false;
+}
+
+/**
+ * Evaluates a constant expression at compile time. Expressions which
+ * fail (e.g. a division by zero) are not folded so that the error is
+ * reported when the program runs.
+ *
+ * @param expr The expression.
+ * @param result The value of the expression.
+ * @returns true if the expression was folded, false otherwise.
+ */
+bool BytecodeCompiler::FoldConstant(const Expression *expr, Value *result)
+{
+	if (!IsConstant(expr))
+		return false;
+
+	try {
+		ScriptFrame frame(false);
+		ExpressionResult res = expr->Evaluate(frame);
+
+		if (res.GetCode() != ResultOK || res.GetValue().IsObject())
+			return false;
+
+		*result = res.GetValue();
+	} catch (const std::exception&) {
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compiles an expression. The expression's value is stored in the specified
+ * register. Expressions which have no bytecode equivalent (e.g. assignments
+ * or loops) are evaluated by the expression tree.
+ *
+ * @param expr The expression.
+ * @param dst The register for the result.
+ */
+void BytecodeCompiler::CompileExpression(const Expression *expr, int dst)
+{
+	BytecodeOpcode binaryOp = GetBinaryOpcode(expr);
+	Value constant;
+
+	if (!dynamic_cast<const LiteralExpression *>(expr) && FoldConstant(expr, &constant)) {
+		EmitConstant(constant, expr, dst);
+		m_FoldedConstants++;
+	} else if (binaryOp != OpEvaluate) {
+		CompileBinary(binaryOp, static_cast<const BinaryExpression *>(expr), dst);
+	} else if (auto lexpr = dynamic_cast<const LiteralExpression *>(expr)) {
+		EmitConstant(lexpr->GetValue(), expr, dst);
+	} else if (auto vexpr = dynamic_cast<const VariableExpression *>(expr)) {
+		m_Program->Names.push_back(vexpr->GetVariable());
+		Emit(OpLoadVariable, expr, dst, 0, 0, m_Program->Names.size() - 1);
+	} else if (auto sexpr = dynamic_cast<const GetScopeExpression *>(expr)) {
+		Emit(OpGetScope, expr, dst, sexpr->GetScopeSpec());
+	} else if (auto nexpr = dynamic_cast<const NegateExpression *>(expr)) {
+		CompileExpression(nexpr->GetOperand().get(), dst);
+		Emit(OpNegate, expr, dst, dst);
+	} else if (auto lnexpr = dynamic_cast<const LogicalNegateExpression *>(expr)) {
+		CompileExpression(lnexpr->GetOperand().get(), dst);
+		Emit(OpLogicalNegate, expr, dst, dst);
+	} else if (auto iexpr = dynamic_cast<const InExpression *>(expr)) {
+		CompileIn(false, iexpr, dst);
+	} else if (auto niexpr = dynamic_cast<const NotInExpression *>(expr)) {
+		CompileIn(true, niexpr, dst);
+	} else if (auto laexpr = dynamic_cast<const LogicalAndExpression *>(expr)) {
+		CompileLogical(true, laexpr, dst);
+	} else if (auto loexpr = dynamic_cast<const LogicalOrExpression *>(expr)) {
+		CompileLogical(false, loexpr, dst);
+	} else if (auto fexpr = dynamic_cast<const FunctionCallExpression *>(expr)) {
+		CompileFunctionCall(fexpr, dst);
+	} else if (auto aexpr = dynamic_cast<const ArrayExpression *>(expr)) {
+		int first = m_NextRegister;
+
+		for (const auto& element : aexpr->GetExpressions())
+			CompileExpression(element.get(), AllocateRegister());
+
+		Emit(OpMakeArray, expr, dst, first, m_NextRegister - first);
+		FreeRegisters(first);
+	} else if (auto dexpr = dynamic_cast<const DictExpression *>(expr)) {
+		if (!dexpr->IsInline()) {
+			Emit(OpEvaluate, expr, dst);
+			return;
+		}
+
+		const auto& statements = dexpr->GetExpressions();
+
+		if (statements.empty())
+			EmitConstant(Empty, expr, dst);
+
+		for (const auto& statement : statements)
+			CompileExpression(statement.get(), dst);
+	} else if (auto rexpr = dynamic_cast<const ReturnExpression *>(expr)) {
+		CompileExpression(rexpr->GetOperand().get(), dst);
+		Emit(OpReturn, expr, dst, dst);
+	} else {
+		Emit(OpEvaluate, expr, dst);
+	}
+}
+
+void BytecodeCompiler::CompileBinary(BytecodeOpcode op, const BinaryExpression *expr, int dst)
+{
+	CompileExpression(expr->GetOperand1().get(), dst);
+
+	int first = m_NextRegister;
+	int operand2 = AllocateRegister();
+	CompileExpression(expr->GetOperand2().get(), operand2);
+	Emit(op, expr, dst, dst, operand2);
+	FreeRegisters(first);
+}
+
+/* The right side of 'in' is evaluated first. The left side isn't evaluated at all if the right side is null.
+ * Arrays of string literals are turned into a set which is built at compile time. */
+void BytecodeCompiler::CompileIn(bool negate, const BinaryExpression *expr, int dst)
+{
+	auto aexpr = dynamic_cast<const ArrayExpression *>(expr->GetOperand2().get());
+
+	if (aexpr) {
+		std::unordered_set<std::string> strings;
+
+		for (const auto& element : aexpr->GetExpressions()) {
+			Value value;
+
+			if (!FoldConstant(element.get(), &value) || !value.IsString()) {
+				aexpr = nullptr;
+				break;
+			}
+
+			strings.insert(value.Get<String>().GetData());
+		}
+
+		if (aexpr) {
+			m_Program->StringSets.emplace_back(std::move(strings));
+			CompileExpression(expr->GetOperand1().get(), dst);
+			Emit(negate ? OpNotInSet : OpInSet, expr, dst, dst, 0, m_Program->StringSets.size() - 1);
+			m_ConstantSets++;
+			return;
+		}
+	}
+
+	int first = m_NextRegister;
+	int operand2 = AllocateRegister();
+	CompileExpression(expr->GetOperand2().get(), operand2);
+
+	size_t test = Emit(negate ? OpTestNotIn : OpTestIn, expr, dst, operand2);
+
+	CompileExpression(expr->GetOperand1().get(), dst);
+	Emit(negate ? OpNotIn : OpIn, expr, dst, dst, operand2);
+	FreeRegisters(first);
+
+	m_Program->Instructions[test].Index = m_Program->Instructions.size();
+}
+
+void BytecodeCompiler::CompileLogical(bool isAnd, const BinaryExpression *expr, int dst)
+{
+	Value left;
+
+	/* Skip the test if the left side is constant. */
+	if (FoldConstant(expr->GetOperand1().get(), &left)) {
+		m_FoldedConstants++;
+
+		if (left.ToBool() != isAnd)
+			EmitConstant(left, expr, dst);
+		else
+			CompileExpression(expr->GetOperand2().get(), dst);
+
+		return;
+	}
+
+	CompileExpression(expr->GetOperand1().get(), dst);
+
+	size_t jump = Emit(isAnd ? OpJumpIfFalse : OpJumpIfTrue, expr, dst, dst);
+
+	CompileExpression(expr->GetOperand2().get(), dst);
+
+	m_Program->Instructions[jump].Index = m_Program->Instructions.size();
+}
+
+/* Registers: function, self, arguments. */
+void BytecodeCompiler::CompileFunctionCall(const FunctionCallExpression *expr, int dst)
+{
+	int first = m_NextRegister;
+	int func = AllocateRegister();
+	AllocateRegister();
+
+	Emit(OpResolveFunction, expr, func);
+
+	for (const auto& arg : expr->m_Args)
+		CompileExpression(arg.get(), AllocateRegister());
+
+	Emit(OpCall, expr, dst, func, m_NextRegister - func - 2);
+	FreeRegisters(first);
+}
+
+/**
+ * Runs the program. The semantics are the same as evaluating the original
+ * expression tree.
+ *
+ * @param frame The script frame.
+ * @returns The result of the expression.
+ */
+ExpressionResult BytecodeProgram::Run(ScriptFrame& frame) const
+{
+	std::vector<Value> registers(RegisterCount);
+	const BytecodeInstruction *instr = nullptr;
+
+	try {
+		for (size_t pc = 0; pc < Instructions.size();) {
+			instr = &Instructions[pc++];
+
+			Value& dst = registers[instr->Dst];
+			const Value& a = registers[instr->A];
+			const Value& b = registers[instr->B];
+
+			switch (instr->Op) {
+				case OpLoadConstant:
+					dst = Constants[instr->Index];
+					break;
+				case OpLoadVariable: {
+					const String& name = Names[instr->Index];
+					Value value;
+
+					if (frame.Locals && frame.Locals->Get(name, &value))
+						dst = std::move(value);
+					else if (frame.Self.IsObject() && frame.Locals != frame.Self.Get<Object::Ptr>() && frame.Self.Get<Object::Ptr>()->GetOwnField(name, &value))
+						dst = std::move(value);
+					else if (VMOps::FindVarImport(frame, name, &value, instr->Expr->GetDebugInfo()))
+						dst = std::move(value);
+					else
+						dst = ScriptGlobal::Get(name);
+
+					break;
+				}
+				case OpGetScope:
+					if (instr->A == ScopeLocal)
+						dst = frame.Locals;
+					else if (instr->A == ScopeThis)
+						dst = frame.Self;
+					else
+						dst = ScriptGlobal::GetGlobals();
+					break;
+				case OpGetField:
+					dst = static_cast<const IndexerExpression *>(instr->Expr)->GetField(a, b, frame.Sandboxed);
+					break;
+				case OpNegate:
+					dst = ~(long)a;
+					break;
+				case OpLogicalNegate:
+					dst = !a.ToBool();
+					break;
+				case OpAdd:
+					dst = a + b;
+					break;
+				case OpSubtract:
+					dst = a - b;
+					break;
+				case OpMultiply:
+					dst = a * b;
+					break;
+				case OpDivide:
+					dst = a / b;
+					break;
+				case OpModulo:
+					dst = a % b;
+					break;
+				case OpXor:
+					dst = a ^ b;
+					break;
+				case OpBinaryAnd:
+					dst = a & b;
+					break;
+				case OpBinaryOr:
+					dst = a | b;
+					break;
+				case OpShiftLeft:
+					dst = a << b;
+					break;
+				case OpShiftRight:
+					dst = a >> b;
+					break;
+				case OpEqual:
+					dst = a == b;
+					break;
+				case OpNotEqual:
+					dst = a != b;
+					break;
+				case OpLessThan:
+					dst = a < b;
+					break;
+				case OpGreaterThan:
+					dst = a > b;
+					break;
+				case OpLessThanOrEqual:
+					dst = a <= b;
+					break;
+				case OpGreaterThanOrEqual:
+					dst = a >= b;
+					break;
+				case OpTestIn:
+				case OpTestNotIn:
+					if (a.IsEmpty()) {
+						dst = (instr->Op == OpTestNotIn);
+						pc = instr->Index;
+					} else if (!a.IsObjectType<Array>())
+						BOOST_THROW_EXCEPTION(ScriptError("Invalid right side argument for 'in' operator: " + JsonEncode(a), instr->Expr->GetDebugInfo()));
+					break;
+				case OpIn:
+					dst = static_cast<Array::Ptr>(b)->Contains(a);
+					break;
+				case OpNotIn:
+					dst = !static_cast<Array::Ptr>(b)->Contains(a);
+					break;
+				case OpInSet:
+				case OpNotInSet: {
+					/* Only strings and null compare equal to a string. */
+					bool found = false;
+
+					if (a.IsString())
+						found = StringSets[instr->Index].count(a.Get<String>().GetData()) > 0;
+					else if (a.IsEmpty())
+						found = StringSets[instr->Index].count(std::string()) > 0;
+
+					dst = (found != (instr->Op == OpNotInSet));
+					break;
+				}
+				case OpJump:
+					pc = instr->Index;
+					break;
+				case OpJumpIfFalse:
+					if (!a.ToBool())
+						pc = instr->Index;
+					break;
+				case OpJumpIfTrue:
+					if (a.ToBool())
+						pc = instr->Index;
+					break;
+				case OpMakeArray: {
+					ArrayData result(registers.begin() + instr->A, registers.begin() + instr->A + instr->B);
+					dst = new Array(std::move(result));
+					break;
+				}
+				case OpResolveFunction: {
+					auto fexpr = static_cast<const FunctionCallExpression *>(instr->Expr);
+					const DebugInfo& debugInfo = instr->Expr->GetDebugInfo();
+					Value self, vfunc;
+					String index;
+
+					if (fexpr->m_FName->GetReference(frame, false, &self, &index))
+						vfunc = VMOps::GetField(self, index, frame.Sandboxed, debugInfo);
+					else {
+						ExpressionResult vfuncres = fexpr->m_FName->Evaluate(frame);
+						CHECK_RESULT(vfuncres);
+
+						vfunc = vfuncres.GetValue();
+					}
+
+					if (!vfunc.IsObjectType<Type>()) {
+						if (!vfunc.IsObjectType<Function>())
+							BOOST_THROW_EXCEPTION(ScriptError("Argument is not a callable object.", debugInfo));
+
+						Function::Ptr func = vfunc;
+
+						if (!func->IsSideEffectFree() && frame.Sandboxed)
+							BOOST_THROW_EXCEPTION(ScriptError("Function is not marked as safe for sandbox mode.", debugInfo));
+					}
+
+					dst = std::move(vfunc);
+					registers[instr->Dst + 1] = std::move(self);
+					break;
+				}
+				case OpCall: {
+					/* The arguments are passed straight from the registers. */
+					ArgumentSpan arguments(registers.data() + instr->A + 2, instr->B);
+
+					if (a.IsObjectType<Type>())
+						dst = VMOps::ConstructorCall(a, arguments.ToVector(), instr->Expr->GetDebugInfo());
+					else
+						dst = VMOps::FunctionCall(frame, registers[instr->A + 1], a, arguments);
+
+					break;
+				}
+				case OpReturn:
+					return ExpressionResult(a, ResultReturn);
+				case OpEvaluate: {
+					ExpressionResult result = instr->Expr->Evaluate(frame);
+					CHECK_RESULT(result);
+
+					dst = result.GetValue();
+					break;
+				}
+			}
+		}
+	} catch (const ScriptError&) {
+		throw;
+	} catch (const std::exception& ex) {
+		BOOST_THROW_EXCEPTION(ScriptError("Error while evaluating expression: " + String(ex.what()), instr->Expr->GetDebugInfo())
+			<< boost::errinfo_nested_exception(boost::current_exception()));
+	}
+
+	return registers[0];
+}
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include <unordered_set>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * @ingroup config
+ */
+enum BytecodeOpcode
+{
+	OpLoadConstant,
+	OpLoadVariable,
+	OpGetScope,
+	OpGetField,
+	OpNegate,
+	OpLogicalNegate,
+	OpAdd,
+	OpSubtract,
+	OpMultiply,
+	OpDivide,
+	OpModulo,
+	OpXor,
+	OpBinaryAnd,
+	OpBinaryOr,
+	OpShiftLeft,
+	OpShiftRight,
+	OpEqual,
+	OpNotEqual,
+	OpLessThan,
+	OpGreaterThan,
+	OpLessThanOrEqual,
+	OpGreaterThanOrEqual,
+	OpTestIn,
+	OpTestNotIn,
+	OpIn,
+	OpNotIn,
+	OpInSet,
+	OpNotInSet,
+	OpJump,
+	OpJumpIfFalse,
+	OpJumpIfTrue,
+	OpMakeArray,
+	OpResolveFunction,
+	OpCall,
+	OpReturn,
+	OpEvaluate
+};
+
+/**
+ * A VM instruction. Dst, A and B are register numbers. Index refers to a
+ * constant or variable name, or is the target of a jump. Expr is the
+ * expression the instruction was compiled from and is used for error
+ * messages and for evaluating expressions which have no bytecode.
+ *
+ * @ingroup config
+ */
+struct BytecodeInstruction
+{
+	BytecodeOpcode Op;
+	int Dst;
+	int A;
+	int B;
+	size_t Index;
+	const Expression *Expr;
+};
+
+/**
+ * A compiled expression. The result of the expression ends up in
+ * register 0.
+ *
+ * @ingroup config
+ */
+struct BytecodeProgram
+{
+	std::vector<BytecodeInstruction> Instructions;
+	std::vector<Value> Constants;
+	std::vector<String> Names;
+	std::vector<std::unordered_set<std::string> > StringSets;
+	int RegisterCount{1};
+
+	ExpressionResult Run(ScriptFrame& frame) const;
+};
+
+/**
+ * Compiles expression trees into bytecode.
+ *
+ * @ingroup config
+ */
+class BytecodeCompiler
+{
+public:
+	static std::unique_ptr<BytecodeProgram> Compile(const Expression *expression);
+
+private:
+	std::unique_ptr<BytecodeProgram> m_Program;
+	int m_NextRegister{1};
+	int m_FoldedConstants{0};
+	int m_ConstantSets{0};
+
+	BytecodeCompiler();
+
+	int AllocateRegister();
+	void FreeRegisters(int first);
+	size_t Emit(BytecodeOpcode op, const Expression *expr, int dst, int a = 0, int b = 0, size_t index = 0);
+	void EmitConstant(const Value& value, const Expression *expr, int dst);
+
+	static bool IsConstant(const Expression *expr);
+	static bool FoldConstant(const Expression *expr, Value *result);
+
+	void CompileExpression(const Expression *expr, int dst);
+	void CompileBinary(BytecodeOpcode op, const BinaryExpression *expr, int dst);
+	void CompileIn(bool negate, const BinaryExpression *expr, int dst);
+	void CompileLogical(bool isAnd, const BinaryExpression *expr, int dst);
+	void CompileFunctionCall(const FunctionCallExpression *expr, int dst);
+};
+
+}
+
+#endif /* BYTECODE_H */
@@ -0,0 +1,969 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/configcache.hpp"
+#include "config/configcompiler.hpp"
+#include "config/applyrule.hpp"
+#include "config/configitembuilder.hpp"
+#include "config/expression.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/configobject.hpp"
+#include "base/objectlock.hpp"
+#include "base/netstring.hpp"
+#include "base/stdiostream.hpp"
+#include "base/tlsutility.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include <boost/algorithm/string/join.hpp>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+using namespace icinga;
+
+boost::mutex ConfigCache::m_Mutex;
+bool ConfigCache::m_Recording = false;
+String ConfigCache::m_GlobalsHash;
+std::map<String, Value> ConfigCache::m_GlobalsSnapshot;
+std::set<ConfigItem::Ptr> ConfigCache::m_TemplatesSnapshot;
+std::map<String, String> ConfigCache::m_Inputs;
+std::map<String, std::pair<String, String> > ConfigCache::m_Sources;
+std::map<Function *, ConfigCache::FunctionInfo> ConfigCache::m_Functions;
+std::vector<std::vector<String> > ConfigCache::m_ZoneDirs;
+
+static const int l_CacheVersion = 1;
+
+namespace
+{
+
+/**
+ * Sets the config attributes of an object to the values from the config cache.
+ */
+class CachedObjectExpression final : public Expression
+{
+public:
+	CachedObjectExpression(Dictionary::Ptr properties)
+		: m_Properties(std::move(properties))
+	{ }
+
+protected:
+	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *) const override
+	{
+		Object::Ptr object = frame.Self;
+		Type::Ptr type = object->GetReflectionType();
+
+		ObjectLock olock(m_Properties);
+
+		for (const Dictionary::Pair& kv : m_Properties) {
+			int fid = type->GetFieldId(kv.first);
+
+			if (fid < 0)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Type '" + type->GetName() + "' does not have an attribute '" + kv.first + "'."));
+
+			object->SetField(fid, kv.second);
+		}
+
+		return Empty;
+	}
+
+private:
+	Dictionary::Ptr m_Properties;
+};
+
+/**
+ * Temporarily collects the definitions parsed by the current thread.
+ */
+class DefinitionCollectorScope
+{
+public:
+	DefinitionCollectorScope(DefinitionList *definitions)
+	{
+		SetDefinitionCollector(definitions);
+	}
+
+	~DefinitionCollectorScope()
+	{
+		SetDefinitionCollector(nullptr);
+	}
+};
+
+}
+
+static String GetLocationKey(const DebugInfo& di)
+{
+	std::ostringstream msgbuf;
+	msgbuf << di.Path << "\n" << di.FirstLine << ":" << di.FirstColumn << ":" << di.LastLine << ":" << di.LastColumn;
+	return msgbuf.str();
+}
+
+static Array::Ptr EncodeDebugInfo(const DebugInfo& di)
+{
+	return new Array({
+		di.Path,
+		di.FirstLine,
+		di.FirstColumn,
+		di.LastLine,
+		di.LastColumn
+	});
+}
+
+static DebugInfo DecodeDebugInfo(const Array::Ptr& arr)
+{
+	DebugInfo di;
+
+	if (arr && arr->GetLength() == 5) {
+		di.Path = arr->Get(0);
+		di.FirstLine = arr->Get(1);
+		di.FirstColumn = arr->Get(2);
+		di.LastLine = arr->Get(3);
+		di.LastColumn = arr->Get(4);
+	}
+
+	return di;
+}
+
+static bool IsSameValue(const Value& a, const Value& b)
+{
+	if (a.IsObject() || b.IsObject())
+		return a.IsObject() && b.IsObject() && static_cast<Object::Ptr>(a) == static_cast<Object::Ptr>(b);
+
+	return a.GetType() == b.GetType() && a == b;
+}
+
+static String ReadFile(const String& path, bool& success)
+{
+	std::ifstream fp(path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+	if (!fp) {
+		success = false;
+		return String();
+	}
+
+	success = true;
+
+	return String(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>());
+}
+
+static String HashMatches(bool result, const std::vector<String>& matches)
+{
+	std::vector<std::string> items{ result ? "1" : "0" };
+
+	for (const String& match : matches)
+		items.push_back(match);
+
+	return SHA256(boost::algorithm::join(items, "\n"));
+}
+
+class ConfigCache::Encoder
+{
+public:
+	Value Encode(const Value& value);
+
+	Array::Ptr GetFunctions() const
+	{
+		return m_Definitions;
+	}
+
+private:
+	std::map<Function *, int> m_Ids;
+	std::set<Object *> m_Visiting;
+	Array::Ptr m_Definitions{new Array()};
+};
+
+/**
+ * Encodes a value for the config cache. Functions are replaced with a
+ * reference to their definition and dictionaries which contain a reserved
+ * key are wrapped.
+ *
+ * @param value The value.
+ * @returns The encoded value.
+ */
+Value ConfigCache::Encoder::Encode(const Value& value)
+{
+	if (!value.IsObject())
+		return value;
+
+	Object::Ptr object = value;
+
+	if (m_Visiting.find(object.get()) != m_Visiting.end())
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Values which reference themselves cannot be cached."));
+
+	m_Visiting.insert(object.get());
+
+	Value result;
+
+	if (value.IsObjectType<Array>()) {
+		Array::Ptr source = value;
+		ArrayData items;
+
+		ObjectLock olock(source);
+
+		for (const Value& item : source)
+			items.push_back(Encode(item));
+
+		result = new Array(std::move(items));
+	} else if (value.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr source = value;
+		DictionaryData items;
+
+		{
+			ObjectLock olock(source);
+
+			for (const Dictionary::Pair& kv : source)
+				items.emplace_back(kv.first, Encode(kv.second));
+		}
+
+		Dictionary::Ptr dict = new Dictionary(std::move(items));
+
+		if (dict->Contains("__function") || dict->Contains("__dictionary"))
+			result = new Dictionary({ { "__dictionary", dict } });
+		else
+			result = dict;
+	} else if (value.IsObjectType<Function>()) {
+		Function::Ptr func = value;
+		int id;
+		auto itId = m_Ids.find(func.get());
+
+		if (itId != m_Ids.end())
+			id = itId->second;
+		else {
+			auto it = m_Functions.find(func.get());
+
+			if (it == m_Functions.end() || m_Sources.find(it->second.Location.Path) == m_Sources.end())
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Function '" + func->GetName() + "' was not defined in a config file."));
+
+			id = m_Definitions->GetLength();
+			m_Ids[func.get()] = id;
+			m_Definitions->Add(Empty);
+
+			m_Definitions->Set(id, new Dictionary({
+				{ "type", "function" },
+				{ "id", id },
+				{ "debug_info", EncodeDebugInfo(it->second.Location) },
+				{ "closed_vars", Encode(it->second.ClosedVars) }
+			}));
+		}
+
+		result = new Dictionary({ { "__function", id } });
+	} else
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Values of type '" + object->GetReflectionType()->GetName() + "' cannot be cached."));
+
+	m_Visiting.erase(object.get());
+
+	return result;
+}
+
+class ConfigCache::Decoder
+{
+public:
+	Decoder(std::map<int, Dictionary::Ptr> definitions, std::map<String, const Expression *> expressions)
+		: m_Definitions(std::move(definitions)), m_Expressions(std::move(expressions))
+	{ }
+
+	Value Decode(const Value& value);
+	const Expression *GetExpression(const Value& debugInfo) const;
+
+private:
+	std::map<int, Dictionary::Ptr> m_Definitions;
+	std::map<String, const Expression *> m_Expressions;
+	std::map<int, Function::Ptr> m_Functions;
+};
+
+/**
+ * Finds the definition in the parsed config files which is at the
+ * specified location.
+ *
+ * @param debugInfo The encoded location.
+ * @returns The expression.
+ */
+const Expression *ConfigCache::Decoder::GetExpression(const Value& debugInfo) const
+{
+	DebugInfo di = DecodeDebugInfo(debugInfo);
+	auto it = m_Expressions.find(GetLocationKey(di));
+
+	if (it == m_Expressions.end()) {
+		std::ostringstream msgbuf;
+		msgbuf << "No definition found at " << di;
+		BOOST_THROW_EXCEPTION(std::invalid_argument(msgbuf.str()));
+	}
+
+	return it->second;
+}
+
+/**
+ * Decodes a value from the config cache.
+ *
+ * @param value The encoded value.
+ * @returns The value.
+ */
+Value ConfigCache::Decoder::Decode(const Value& value)
+{
+	if (value.IsObjectType<Array>()) {
+		Array::Ptr source = value;
+		ArrayData items;
+
+		ObjectLock olock(source);
+
+		for (const Value& item : source)
+			items.push_back(Decode(item));
+
+		return new Array(std::move(items));
+	} else if (value.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr source = value;
+
+		if (source->Contains("__function")) {
+			int id = source->Get("__function");
+			auto it = m_Functions.find(id);
+
+			if (it != m_Functions.end())
+				return it->second;
+
+			auto itDef = m_Definitions.find(id);
+
+			if (itDef == m_Definitions.end())
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid function reference in config cache."));
+
+			auto *fexpr = dynamic_cast<const FunctionExpression *>(GetExpression(itDef->second->Get("debug_info")));
+
+			if (!fexpr)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Definition is not a function."));
+
+			Function::Ptr func = fexpr->Restore(Decode(itDef->second->Get("closed_vars")));
+			m_Functions[id] = func;
+			return func;
+		}
+
+		if (source->Contains("__dictionary"))
+			source = source->Get("__dictionary");
+
+		DictionaryData items;
+
+		ObjectLock olock(source);
+
+		for (const Dictionary::Pair& kv : source)
+			items.emplace_back(kv.first, Decode(kv.second));
+
+		return new Dictionary(std::move(items));
+	} else
+		return value;
+}
+
+/**
+ * Returns the path of the config cache. The cache is only used if the
+ * ConfigCachePath constant is set on the command line.
+ *
+ * @returns The path, or an empty string.
+ */
+String ConfigCache::GetCachePath()
+{
+	return ScriptGlobal::Get("ConfigCachePath", &Empty);
+}
+
+/**
+ * Starts recording the inputs of the config which is about to be loaded.
+ */
+void ConfigCache::BeginRecording()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_Inputs.clear();
+	m_Sources.clear();
+	m_Functions.clear();
+	m_ZoneDirs.clear();
+	m_GlobalsSnapshot.clear();
+	m_TemplatesSnapshot.clear();
+
+	m_GlobalsHash = GetGlobalsHash();
+
+	Dictionary::Ptr globals = ScriptGlobal::GetGlobals();
+
+	{
+		ObjectLock olock(globals);
+
+		for (const Dictionary::Pair& kv : globals)
+			m_GlobalsSnapshot[kv.first] = kv.second;
+	}
+
+	/* Templates from the built-in config fragments are re-created on every start. */
+	for (const Type::Ptr& type : Type::GetAllTypes()) {
+		if (!ConfigObject::TypeInstance->IsAssignableFrom(type))
+			continue;
+
+		for (const ConfigItem::Ptr& item : ConfigItem::GetItems(type)) {
+			if (item->IsAbstract())
+				m_TemplatesSnapshot.insert(item);
+		}
+	}
+
+	m_Recording = true;
+}
+
+/**
+ * Stops recording and releases the recorded functions.
+ */
+void ConfigCache::EndRecording()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_Recording = false;
+
+	m_Inputs.clear();
+	m_Sources.clear();
+	m_Functions.clear();
+	m_ZoneDirs.clear();
+	m_GlobalsSnapshot.clear();
+	m_TemplatesSnapshot.clear();
+}
+
+bool ConfigCache::IsRecording()
+{
+	return m_Recording;
+}
+
+void ConfigCache::RecordFile(const String& path, const String& content, const String& zone, const String& package)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_Recording)
+		return;
+
+	m_Inputs["file\n" + path] = SHA256(content);
+	m_Sources.insert(std::make_pair(path, std::make_pair(zone, package)));
+}
+
+void ConfigCache::RecordFunction(const Function::Ptr& func, const DebugInfo& debugInfo, const Dictionary::Ptr& closedVars)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_Recording)
+		return;
+
+	m_Functions[func.get()] = { func, debugInfo, closedVars };
+}
+
+void ConfigCache::RecordZoneDir(const String& tag, const String& path, const String& zoneName)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_Recording)
+		return;
+
+	m_ZoneDirs.push_back({ tag, path, zoneName });
+}
+
+/**
+ * Works like Utility::Glob() but records the matches while recording.
+ */
+bool ConfigCache::Glob(const String& pathSpec, const std::function<void (const String&)>& callback, int type)
+{
+	if (!IsRecording())
+		return Utility::Glob(pathSpec, callback, type);
+
+	std::vector<String> matches;
+	bool result = Utility::Glob(pathSpec, [&matches](const String& path) { matches.push_back(path); }, type);
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Inputs["glob\n" + Convert::ToString(type) + "\n" + pathSpec] = HashMatches(result, matches);
+	}
+
+	for (const String& match : matches)
+		callback(match);
+
+	return result;
+}
+
+/**
+ * Works like Utility::GlobRecursive() but records the matches while recording.
+ */
+bool ConfigCache::GlobRecursive(const String& path, const String& pattern, const std::function<void (const String&)>& callback, int type)
+{
+	if (!IsRecording())
+		return Utility::GlobRecursive(path, pattern, callback, type);
+
+	std::vector<String> matches;
+	bool result = Utility::GlobRecursive(path, pattern, [&matches](const String& match) { matches.push_back(match); }, type);
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Inputs["globrecursive\n" + Convert::ToString(type) + "\n" + path + "\n" + pattern] = HashMatches(result, matches);
+	}
+
+	for (const String& match : matches)
+		callback(match);
+
+	return result;
+}
+
+/**
+ * Works like Utility::PathExists() but records the result while recording.
+ */
+bool ConfigCache::PathExists(const String& path)
+{
+	bool result = Utility::PathExists(path);
+
+	if (IsRecording()) {
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Inputs["exists\n" + path] = result ? "1" : "0";
+	}
+
+	return result;
+}
+
+String ConfigCache::GetGlobalsHash()
+{
+	std::ostringstream msgbuf;
+
+	msgbuf << l_CacheVersion << "\n";
+
+	Dictionary::Ptr globals = ScriptGlobal::GetGlobals();
+
+	ObjectLock olock(globals);
+
+	for (const Dictionary::Pair& kv : globals) {
+		if (!kv.second.IsObject())
+			msgbuf << kv.first << "=" << JsonEncode(kv.second) << "\n";
+	}
+
+	return SHA256(msgbuf.str());
+}
+
+/**
+ * Determines the current value of a recorded input.
+ *
+ * @param key The input key.
+ * @returns The value, or an empty string if the key is invalid.
+ */
+String ConfigCache::GetInputHash(const String& key)
+{
+	std::vector<String> tokens = key.Split("\n");
+
+	if (tokens.size() == 2 && tokens[0] == "file") {
+		bool success;
+		String content = ReadFile(tokens[1], success);
+		return success ? SHA256(content) : String();
+	} else if (tokens.size() == 2 && tokens[0] == "exists") {
+		return Utility::PathExists(tokens[1]) ? "1" : "0";
+	} else if (tokens.size() == 3 && tokens[0] == "glob") {
+		std::vector<String> matches;
+		bool result = Utility::Glob(tokens[2], [&matches](const String& path) { matches.push_back(path); }, Convert::ToLong(tokens[1]));
+		return HashMatches(result, matches);
+	} else if (tokens.size() == 4 && tokens[0] == "globrecursive") {
+		std::vector<String> matches;
+		bool result = Utility::GlobRecursive(tokens[2], tokens[3], [&matches](const String& path) { matches.push_back(path); }, Convert::ToLong(tokens[1]));
+		return HashMatches(result, matches);
+	}
+
+	return String();
+}
+
+/**
+ * Writes the config cache for the config which was loaded while recording.
+ *
+ * @param path The path of the cache file.
+ * @param newItems The committed config items.
+ * @returns true if the cache was written, false otherwise.
+ */
+bool ConfigCache::Save(const String& path, const std::vector<ConfigItem::Ptr>& newItems)
+{
+	double start = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_Recording)
+		return false;
+
+	std::vector<Dictionary::Ptr> records;
+	Encoder encoder;
+
+	try {
+		Dictionary::Ptr globals = ScriptGlobal::GetGlobals();
+
+		{
+			ObjectLock olock(globals);
+
+			for (const Dictionary::Pair& kv : globals) {
+				auto it = m_GlobalsSnapshot.find(kv.first);
+
+				if (it != m_GlobalsSnapshot.end() && IsSameValue(it->second, kv.second))
+					continue;
+
+				records.emplace_back(new Dictionary({
+					{ "type", "global" },
+					{ "name", kv.first },
+					{ "value", encoder.Encode(kv.second) }
+				}));
+			}
+		}
+
+		for (const std::vector<String>& zoneDir : m_ZoneDirs) {
+			records.emplace_back(new Dictionary({
+				{ "type", "zone_dir" },
+				{ "tag", zoneDir[0] },
+				{ "path", zoneDir[1] },
+				{ "zone", zoneDir[2] }
+			}));
+		}
+
+		for (const Type::Ptr& type : Type::GetAllTypes()) {
+			if (ConfigObject::TypeInstance->IsAssignableFrom(type)) {
+				for (const ConfigItem::Ptr& item : ConfigItem::GetItems(type)) {
+					if (!item->IsAbstract() || m_TemplatesSnapshot.find(item) != m_TemplatesSnapshot.end())
+						continue;
+
+					DebugInfo di = item->GetDebugInfo();
+
+					if (m_Sources.find(di.Path) == m_Sources.end())
+						BOOST_THROW_EXCEPTION(std::invalid_argument("Template '" + item->GetName() + "' was not defined in a config file."));
+
+					records.emplace_back(new Dictionary({
+						{ "type", "template" },
+						{ "object_type", type->GetName() },
+						{ "name", item->GetName() },
+						{ "debug_info", EncodeDebugInfo(di) },
+						{ "scope", encoder.Encode(item->GetScope()) }
+					}));
+				}
+			}
+
+			if (!ApplyRule::IsValidSourceType(type->GetName()))
+				continue;
+
+			for (const ApplyRule& rule : ApplyRule::GetRules(type->GetName())) {
+				DebugInfo di = rule.GetDebugInfo();
+
+				if (m_Sources.find(di.Path) == m_Sources.end())
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Apply rule '" + rule.GetName() + "' was not defined in a config file."));
+
+				records.emplace_back(new Dictionary({
+					{ "type", "apply" },
+					{ "object_type", type->GetName() },
+					{ "name", rule.GetName() },
+					{ "debug_info", EncodeDebugInfo(di) },
+					{ "scope", encoder.Encode(rule.GetScope()) }
+				}));
+			}
+		}
+
+		for (const ConfigItem::Ptr& item : newItems) {
+			ConfigObject::Ptr object = item->GetObject();
+
+			if (!object)
+				continue;
+
+			Type::Ptr type = object->GetReflectionType();
+			DictionaryData properties;
+
+			for (int fid = 0; fid < type->GetFieldCount(); fid++) {
+				Field field = type->GetFieldInfo(fid);
+
+				if (!(field.Attributes & FAConfig) || strcmp(field.Name, "type") == 0)
+					continue;
+
+				properties.emplace_back(field.Name, encoder.Encode(object->GetField(fid)));
+			}
+
+			records.emplace_back(new Dictionary({
+				{ "type", "object" },
+				{ "object_type", type->GetName() },
+				{ "name", item->GetName() },
+				{ "zone", object->GetZoneName() },
+				{ "package", object->GetPackage() },
+				{ "debug_info", EncodeDebugInfo(item->GetDebugInfo()) },
+				{ "properties", new Dictionary(std::move(properties)) }
+			}));
+		}
+	} catch (const std::exception& ex) {
+		Log(LogNotice, "ConfigCache")
+			<< "Not writing config cache: " << DiagnosticInformation(ex, false);
+		return false;
+	}
+
+	DictionaryData inputs;
+
+	for (const auto& kv : m_Inputs)
+		inputs.emplace_back(kv.first, kv.second);
+
+	DictionaryData sources;
+
+	for (const auto& kv : m_Sources)
+		sources.emplace_back(kv.first, new Array({ kv.second.first, kv.second.second }));
+
+	Dictionary::Ptr header = new Dictionary({
+		{ "version", l_CacheVersion },
+		{ "globals", m_GlobalsHash },
+		{ "inputs", new Dictionary(std::move(inputs)) },
+		{ "sources", new Dictionary(std::move(sources)) }
+	});
+
+	try {
+		std::fstream fp;
+		String tempFilename = Utility::CreateTempFile(path + ".XXXXXX", 0600, fp);
+
+		if (!fp)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + tempFilename + "' file"));
+
+		StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+		NetString::WriteStringToStream(sfp, JsonEncode(header));
+
+		Array::Ptr functions = encoder.GetFunctions();
+
+		{
+			ObjectLock olock(functions);
+
+			for (const Value& function : functions)
+				NetString::WriteStringToStream(sfp, JsonEncode(function));
+		}
+
+		for (const Dictionary::Ptr& record : records)
+			NetString::WriteStringToStream(sfp, JsonEncode(record));
+
+		sfp->Close();
+
+		fp.close();
+
+#ifdef _WIN32
+		_unlink(path.CStr());
+#endif /* _WIN32 */
+
+		if (rename(tempFilename.CStr(), path.CStr()) < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("rename")
+				<< boost::errinfo_errno(errno)
+				<< boost::errinfo_file_name(tempFilename));
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ConfigCache")
+			<< "Could not write config cache '" << path << "': " << DiagnosticInformation(ex, false);
+		return false;
+	}
+
+	Log(LogInformation, "ConfigCache")
+		<< "Wrote config cache '" << path << "' with " << records.size() << " records in "
+		<< Utility::FormatDuration(Utility::GetTime() - start) << ".";
+
+	return true;
+}
+
+/**
+ * Reads the config cache and checks whether it is still up-to-date. This
+ * has no side effects except for re-parsing the config files which contain
+ * functions, templates or apply rules.
+ *
+ * @param path The path of the cache file.
+ * @returns true if the cache can be restored, false otherwise.
+ */
+bool ConfigCache::Load(const String& path)
+{
+	if (!Utility::PathExists(path))
+		return false;
+
+	double start = Utility::GetTime();
+
+	std::vector<Dictionary::Ptr> records;
+
+	try {
+		std::fstream fp;
+		fp.open(path.CStr(), std::ios_base::in);
+
+		StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+		String message;
+		StreamReadContext src;
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+			if (srs == StatusEof)
+				break;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			records.emplace_back(JsonDecode(message));
+		}
+
+		sfp->Close();
+
+		if (records.empty())
+			return false;
+
+		Dictionary::Ptr header = records[0];
+
+		if (header->Get("version") != l_CacheVersion || header->Get("globals") != GetGlobalsHash()) {
+			Log(LogNotice, "ConfigCache")
+				<< "Config cache '" << path << "' was written with different constants or by a different version.";
+			return false;
+		}
+
+		Dictionary::Ptr inputs = header->Get("inputs");
+
+		{
+			ObjectLock olock(inputs);
+
+			for (const Dictionary::Pair& kv : inputs) {
+				if (GetInputHash(kv.first) != kv.second) {
+					Log(LogNotice, "ConfigCache")
+						<< "Config cache '" << path << "' is outdated: '" << kv.first.SubStr(kv.first.FindFirstOf("\n") + 1) << "' has changed.";
+					return false;
+				}
+			}
+		}
+
+		Dictionary::Ptr sources = header->Get("sources");
+		std::set<String> paths;
+		std::map<int, Dictionary::Ptr> functions;
+
+		for (std::vector<Dictionary::Ptr>::size_type i = 1; i < records.size(); i++) {
+			const Dictionary::Ptr& record = records[i];
+			String recordType = record->Get("type");
+
+			if (recordType == "function")
+				functions[record->Get("id")] = record;
+
+			if (recordType == "function" || recordType == "template" || recordType == "apply")
+				paths.insert(DecodeDebugInfo(record->Get("debug_info")).Path);
+		}
+
+		DefinitionList definitions;
+
+		{
+			DefinitionCollectorScope collector(&definitions);
+
+			for (const String& source : paths) {
+				Array::Ptr info = sources->Get(source);
+
+				if (!info)
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown config file '" + source + "'."));
+
+				m_Trees.emplace_back(ConfigCompiler::CompileFile(source, info->Get(0), info->Get(1)));
+			}
+		}
+
+		std::map<String, const Expression *> expressions;
+
+		for (const auto& definition : definitions)
+			expressions[GetLocationKey(definition.first)] = definition.second;
+
+		Decoder decoder(std::move(functions), std::move(expressions));
+
+		for (std::vector<Dictionary::Ptr>::size_type i = 1; i < records.size(); i++) {
+			const Dictionary::Ptr& record = records[i];
+			String recordType = record->Get("type");
+
+			if (recordType == "global") {
+				m_Globals.emplace_back(record->Get("name"), decoder.Decode(record->Get("value")));
+			} else if (recordType == "zone_dir") {
+				m_RestoredZoneDirs.push_back({ record->Get("tag"), record->Get("path"), record->Get("zone") });
+			} else if (recordType == "template" || recordType == "apply") {
+				const Expression *expr = decoder.GetExpression(record->Get("debug_info"));
+
+				if (recordType == "template" && !dynamic_cast<const ObjectExpression *>(expr))
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Definition is not a template."));
+
+				if (recordType == "apply" && !dynamic_cast<const ApplyExpression *>(expr))
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Definition is not an apply rule."));
+
+				Definition definition{ expr, record->Get("object_type"), record->Get("name"), decoder.Decode(record->Get("scope")) };
+
+				if (recordType == "template")
+					m_Templates.push_back(definition);
+				else
+					m_ApplyRules.push_back(definition);
+			} else if (recordType == "object") {
+				String objectType = record->Get("object_type");
+				Type::Ptr type = Type::GetByName(objectType);
+
+				if (!type || !ConfigObject::TypeInstance->IsAssignableFrom(type))
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown object type '" + objectType + "'."));
+
+				m_Objects.push_back({ type, record->Get("name"), record->Get("zone"), record->Get("package"),
+					DecodeDebugInfo(record->Get("debug_info")), decoder.Decode(record->Get("properties")) });
+			}
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ConfigCache")
+			<< "Could not load config cache '" << path << "': " << DiagnosticInformation(ex, false);
+
+		m_Trees.clear();
+		m_Globals.clear();
+		m_RestoredZoneDirs.clear();
+		m_Templates.clear();
+		m_ApplyRules.clear();
+		m_Objects.clear();
+
+		return false;
+	}
+
+	Log(LogInformation, "ConfigCache")
+		<< "Loaded config cache '" << path << "' with " << m_Objects.size() << " objects in "
+		<< Utility::FormatDuration(Utility::GetTime() - start) << ".";
+
+	return true;
+}
+
+/**
+ * Restores the globals, templates, apply rules and objects which were
+ * read by Load() and commits the objects. Apply rules are not evaluated
+ * because the cache already contains the objects they created.
+ *
+ * @param context The activation context.
+ * @param upq The work queue.
+ * @param newItems The committed config items.
+ * @returns true if the objects were committed, false otherwise.
+ */
+bool ConfigCache::Restore(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems)
+{
+	try {
+		for (const auto& kv : m_Globals)
+			ScriptGlobal::Set(kv.first, kv.second);
+
+		for (const std::vector<String>& zoneDir : m_RestoredZoneDirs)
+			ConfigCompiler::RegisterZoneDir(zoneDir[0], zoneDir[1], zoneDir[2]);
+
+		for (const Definition& definition : m_Templates) {
+			Type::Ptr type = Type::GetByName(definition.Type);
+
+			if (!type)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown object type '" + definition.Type + "'."));
+
+			static_cast<const ObjectExpression *>(definition.Expr)->Restore(type, definition.Name, definition.Scope);
+		}
+
+		for (const Definition& definition : m_ApplyRules)
+			static_cast<const ApplyExpression *>(definition.Expr)->Restore(definition.Name, definition.Scope);
+
+		for (const CachedObject& object : m_Objects) {
+			ConfigItemBuilder builder{object.Location};
+			builder.SetType(object.ObjectType);
+			builder.SetName(object.Name);
+			builder.SetZone(object.Zone);
+			builder.SetPackage(object.Package);
+			builder.AddExpression(new ImportDefaultTemplatesExpression());
+			builder.AddExpression(new CachedObjectExpression(object.Properties));
+			builder.Compile()->Register();
+		}
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "config", DiagnosticInformation(ex));
+		return false;
+	}
+
+	return ConfigItem::CommitItems(context, upq, newItems, false, false);
+}
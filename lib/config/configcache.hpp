@@ -0,0 +1,125 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+
+#include "config/i2-config.hpp"
+#include "config/configitem.hpp"
+#include "config/activationcontext.hpp"
+#include "base/function.hpp"
+#include "base/debuginfo.hpp"
+#include "base/workqueue.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace icinga
+{
+
+class Expression;
+
+/**
+ * A cache for the evaluated configuration. While the configuration is
+ * loaded the cache records which files, include patterns and functions
+ * were used. Once the objects were committed the cache stores the
+ * globals, templates, apply rules and object attributes. On the next
+ * startup the objects are restored from the cache if none of the
+ * recorded inputs have changed.
+ *
+ * @ingroup config
+ */
+class ConfigCache
+{
+public:
+	static String GetCachePath();
+
+	static void BeginRecording();
+	static void EndRecording();
+	static bool IsRecording();
+
+	static void RecordFile(const String& path, const String& content, const String& zone, const String& package);
+	static void RecordFunction(const Function::Ptr& func, const DebugInfo& debugInfo, const Dictionary::Ptr& closedVars);
+	static void RecordZoneDir(const String& tag, const String& path, const String& zoneName);
+
+	static bool Glob(const String& pathSpec, const std::function<void (const String&)>& callback, int type = GlobFile | GlobDirectory);
+	static bool GlobRecursive(const String& path, const String& pattern, const std::function<void (const String&)>& callback, int type = GlobFile | GlobDirectory);
+	static bool PathExists(const String& path);
+
+	static bool Save(const String& path, const std::vector<ConfigItem::Ptr>& newItems);
+
+	bool Load(const String& path);
+	bool Restore(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems);
+
+private:
+	class Encoder;
+	class Decoder;
+
+	struct FunctionInfo
+	{
+		Function::Ptr Func;
+		DebugInfo Location;
+		Dictionary::Ptr ClosedVars;
+	};
+
+	struct Definition
+	{
+		const Expression *Expr;
+		String Type;
+		String Name;
+		Dictionary::Ptr Scope;
+	};
+
+	struct CachedObject
+	{
+		Type::Ptr ObjectType;
+		String Name;
+		String Zone;
+		String Package;
+		DebugInfo Location;
+		Dictionary::Ptr Properties;
+	};
+
+	static boost::mutex m_Mutex;
+	static bool m_Recording;
+	static String m_GlobalsHash;
+	static std::map<String, Value> m_GlobalsSnapshot;
+	static std::set<ConfigItem::Ptr> m_TemplatesSnapshot;
+	static std::map<String, String> m_Inputs;
+	static std::map<String, std::pair<String, String> > m_Sources;
+	static std::map<Function *, FunctionInfo> m_Functions;
+	static std::vector<std::vector<String> > m_ZoneDirs;
+
+	std::vector<std::unique_ptr<Expression> > m_Trees;
+	std::vector<std::pair<String, Value> > m_Globals;
+	std::vector<std::vector<String> > m_RestoredZoneDirs;
+	std::vector<Definition> m_Templates;
+	std::vector<Definition> m_ApplyRules;
+	std::vector<CachedObject> m_Objects;
+
+	static String GetGlobalsHash();
+	static String GetInputHash(const String& key);
+};
+
+}
+
+#endif /* CONFIGCACHE_H */
@@ -19,12 +19,18 @@
 
 #include "config/configcompiler.hpp"
 #include "config/configitem.hpp"
+#include "config/configcache.hpp"
+#include "config/configprofiler.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/loader.hpp"
 #include "base/context.hpp"
 #include "base/exception.hpp"
+#include "base/application.hpp"
+#include "base/workqueue.hpp"
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 
 using namespace icinga;
 
@@ -109,16 +115,56 @@ String ConfigCompiler::GetPackage() const
 	return m_Package;
 }
 
-void ConfigCompiler::CollectIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
-	const String& file, const String& zone, const String& package)
+void ConfigCompiler::CollectIncludes(std::vector<String>& paths, const String& file)
 {
-	try {
-		expressions.emplace_back(CompileFile(file, zone, package));
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ConfigCompiler")
-			<< "Cannot compile file '"
-			<< file << "': " << DiagnosticInformation(ex);
+	paths.push_back(file);
+}
+
+/**
+ * Compiles the specified files. Files are parsed concurrently, but the
+ * resulting expressions are in the same order as the paths so that
+ * evaluating them is equivalent to evaluating the files one after another.
+ * Files which cannot be read are skipped.
+ *
+ * @param paths The paths.
+ * @param zone The zone for the files.
+ * @param package The package for the files.
+ * @returns The expressions for the files.
+ */
+std::vector<std::unique_ptr<Expression> > ConfigCompiler::CompileIncludes(const std::vector<String>& paths,
+	const String& zone, const String& package)
+{
+	std::vector<std::unique_ptr<Expression> > expressions(paths.size());
+
+	auto compile = [&paths, &expressions, &zone, &package](size_t index) {
+		const String& file = paths[index];
+
+		try {
+			expressions[index] = CompileFile(file, zone, package);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "ConfigCompiler")
+				<< "Cannot compile file '"
+				<< file << "': " << DiagnosticInformation(ex);
+		}
+	};
+
+	if (paths.size() > 1) {
+		std::vector<size_t> indexes;
+
+		for (size_t i = 0; i < paths.size(); i++)
+			indexes.push_back(i);
+
+		WorkQueue upq(0, std::min(Application::GetConcurrency(), static_cast<int>(paths.size())));
+		upq.SetName("ConfigCompiler::CompileIncludes");
+		upq.ParallelFor(indexes, compile);
+		upq.Join();
+	} else if (!paths.empty()) {
+		compile(0);
 	}
+
+	expressions.erase(std::remove(expressions.begin(), expressions.end(), nullptr), expressions.end());
+
+	return expressions;
 }
 
 /**
@@ -145,22 +191,22 @@ std::unique_ptr<Expression> ConfigCompiler::HandleInclude(const String& relative
 		for (const String& dir : m_IncludeSearchDirs) {
 			String spath = dir + "/" + path;
 
-			if (Utility::PathExists(spath)) {
+			if (ConfigCache::PathExists(spath)) {
 				includePath = spath;
 				break;
 			}
 		}
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
+	std::vector<String> paths;
 
-	if (!Utility::Glob(includePath, std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zone, package), GlobFile) && includePath.FindFirstOf("*?") == String::NPos) {
+	if (!ConfigCache::Glob(includePath, std::bind(&ConfigCompiler::CollectIncludes, std::ref(paths), _1), GlobFile) && includePath.FindFirstOf("*?") == String::NPos) {
 		std::ostringstream msgbuf;
 		msgbuf << "Include file '" + path + "' does not exist";
 		BOOST_THROW_EXCEPTION(ScriptError(msgbuf.str(), debuginfo));
 	}
 
-	std::unique_ptr<DictExpression> expr{new DictExpression(std::move(expressions))};
+	std::unique_ptr<DictExpression> expr{new DictExpression(CompileIncludes(paths, zone, package))};
 	expr->MakeInline();
 	return std::move(expr);
 }
@@ -183,10 +229,10 @@ std::unique_ptr<Expression> ConfigCompiler::HandleIncludeRecursive(const String&
 	else
 		ppath = relativeBase + "/" + path;
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(ppath, pattern, std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zone, package), GlobFile);
+	std::vector<String> paths;
+	ConfigCache::GlobRecursive(ppath, pattern, std::bind(&ConfigCompiler::CollectIncludes, std::ref(paths), _1), GlobFile);
 
-	std::unique_ptr<DictExpression> dict{new DictExpression(std::move(expressions))};
+	std::unique_ptr<DictExpression> dict{new DictExpression(CompileIncludes(paths, zone, package))};
 	dict->MakeInline();
 	return std::move(dict);
 }
@@ -204,7 +250,11 @@ void ConfigCompiler::HandleIncludeZone(const String& relativeBase, const String&
 
 	RegisterZoneDir(tag, ppath, zoneName);
 
-	Utility::GlobRecursive(ppath, pattern, std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zoneName, package), GlobFile);
+	std::vector<String> paths;
+	ConfigCache::GlobRecursive(ppath, pattern, std::bind(&ConfigCompiler::CollectIncludes, std::ref(paths), _1), GlobFile);
+
+	for (auto& expression : CompileIncludes(paths, zoneName, package))
+		expressions.emplace_back(std::move(expression));
 }
 
 /**
@@ -230,7 +280,7 @@ std::unique_ptr<Expression> ConfigCompiler::HandleIncludeZones(const String& rel
 	}
 
 	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::Glob(ppath + "/*", std::bind(&ConfigCompiler::HandleIncludeZone, newRelativeBase, tag, _1, pattern, package, std::ref(expressions)), GlobDirectory);
+	ConfigCache::Glob(ppath + "/*", std::bind(&ConfigCompiler::HandleIncludeZone, newRelativeBase, tag, _1, pattern, package, std::ref(expressions)), GlobDirectory);
 	return std::unique_ptr<Expression>(new DictExpression(std::move(expressions)));
 }
 
@@ -270,6 +320,8 @@ std::unique_ptr<Expression> ConfigCompiler::CompileFile(const String& path, cons
 {
 	CONTEXT("Compiling configuration file '" + path + "'");
 
+	ConfigProfilerScope profile("parse", path, true);
+
 	std::ifstream stream(path.CStr(), std::ifstream::in);
 
 	if (!stream)
@@ -281,6 +333,15 @@ std::unique_ptr<Expression> ConfigCompiler::CompileFile(const String& path, cons
 	Log(LogNotice, "ConfigCompiler")
 		<< "Compiling config file: " << path;
 
+	if (ConfigCache::IsRecording()) {
+		std::stringstream content;
+		content << stream.rdbuf();
+
+		ConfigCache::RecordFile(path, content.str(), zone, package);
+
+		return CompileStream(path, &content, zone, package);
+	}
+
 	return CompileStream(path, &stream, zone, package);
 }
 
@@ -327,6 +388,8 @@ void ConfigCompiler::RegisterZoneDir(const String& tag, const String& ppath, con
 	zf.Tag = tag;
 	zf.Path = ppath;
 
+	ConfigCache::RecordZoneDir(tag, ppath, zoneName);
+
 	boost::mutex::scoped_lock lock(m_ZoneDirsMutex);
 	m_ZoneDirs[zoneName].push_back(zf);
 }
@@ -109,8 +109,9 @@ public:
 	void SetPackage(const String& package);
 	String GetPackage() const;
 
-	static void CollectIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
-		const String& file, const String& zone, const String& package);
+	static void CollectIncludes(std::vector<String>& paths, const String& file);
+	static std::vector<std::unique_ptr<Expression> > CompileIncludes(const std::vector<String>& paths,
+		const String& zone, const String& package);
 
 	static std::unique_ptr<Expression> HandleInclude(const String& relativeBase, const String& path, bool search,
 		const String& zone, const String& package, const DebugInfo& debuginfo = DebugInfo());
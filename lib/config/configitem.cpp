@@ -22,6 +22,8 @@
 #include "config/applyrule.hpp"
 #include "config/objectrule.hpp"
 #include "config/configcompiler.hpp"
+#include "config/configprofiler.hpp"
+#include "base/startuptimeline.hpp"
 #include "base/application.hpp"
 #include "base/configtype.hpp"
 #include "base/objectlock.hpp"
@@ -36,6 +38,11 @@
 #include "base/json.hpp"
 #include "base/exception.hpp"
 #include "base/function.hpp"
+#include "base/dependencygraph.hpp"
+#include "base/valueinternpool.hpp"
+#include "base/scriptglobal.hpp"
+#include <atomic>
+#include <chrono>
 #include <sstream>
 #include <fstream>
 
@@ -47,8 +54,52 @@ ConfigItem::TypeMap ConfigItem::m_DefaultTemplates;
 ConfigItem::ItemList ConfigItem::m_UnnamedItems;
 ConfigItem::IgnoredItemList ConfigItem::m_IgnoredItems;
 
+boost::signals2::signal<void (bool)> ConfigItem::OnItemsActivated;
+
 REGISTER_SCRIPTFUNCTION_NS(Internal, run_with_activation_context, &ConfigItem::RunWithActivationContext, "func");
 
+/* Nanoseconds spent validating objects, added up over all threads. */
+static std::atomic<uint64_t> l_ValidationTime{0};
+
+static boost::mutex l_ActivationMutex;
+static WorkQueue *l_DeferredActivationQueue;
+
+/* Types whose objects don't do anything until a state changes. With
+ * LazyActivation they are activated in the background after startup, in
+ * this order. */
+static const char * const l_DeferredTypes[] = {
+	"Dependency",
+	"ScheduledDowntime",
+	"Downtime",
+	"Comment",
+	"Notification"
+};
+
+namespace
+{
+
+/**
+ * Adds the time from construction to destruction to l_ValidationTime.
+ */
+class ValidationTimer
+{
+public:
+	ValidationTimer()
+		: m_Start(std::chrono::steady_clock::now())
+	{ }
+
+	~ValidationTimer()
+	{
+		l_ValidationTime.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - m_Start).count(), std::memory_order_relaxed);
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_Start;
+};
+
+}
+
 /**
  * Constructor for the ConfigItem class.
  *
@@ -70,6 +121,10 @@ ConfigItem::ConfigItem(Type::Ptr type, String name,
 	m_DebugInfo(std::move(debuginfo)), m_Scope(std::move(scope)), m_Zone(std::move(zone)),
 	m_Package(std::move(package))
 {
+	if (m_Abstract && m_Expression)
+		m_TemplateExpression = std::make_shared<TemplateExpression>(m_Type, m_Expression);
+	else
+		m_TemplateExpression = m_Expression;
 }
 
 /**
@@ -142,6 +197,16 @@ std::shared_ptr<Expression> ConfigItem::GetExpression() const
 	return m_Expression;
 }
 
+/**
+ * Retrieves the expression which objects use to import this item.
+ *
+ * @returns The expression.
+ */
+const std::shared_ptr<Expression>& ConfigItem::GetTemplateExpression() const
+{
+	return m_TemplateExpression;
+}
+
 /**
 * Retrieves the object filter for the configuration item.
 *
@@ -188,6 +253,8 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 	if (IsAbstract())
 		return nullptr;
 
+	ConfigProfilerScope profile("commit", type->GetName());
+
 	ConfigObject::Ptr dobj = static_pointer_cast<ConfigObject>(type->Instantiate(std::vector<Value>()));
 
 	dobj->SetDebugInfo(m_DebugInfo);
@@ -252,6 +319,8 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 	Dictionary::Ptr dhint = debugHints.ToDictionary();
 
 	try {
+		ConfigProfilerScope vprofile("validate", type->GetName());
+		ValidationTimer vtimer;
 		DefaultValidationUtils utils;
 		dobj->Validate(FAConfig, utils);
 	} catch (ValidationError& ex) {
@@ -388,7 +457,7 @@ ConfigItem::Ptr ConfigItem::GetByTypeAndName(const Type::Ptr& type, const String
 	return it2->second;
 }
 
-bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems)
+bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems, bool applyRules)
 {
 	typedef std::pair<ConfigItem::Ptr, bool> ItemPair;
 	std::vector<ItemPair> items;
@@ -431,11 +500,16 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 	for (const auto& ip : items)
 		newItems.push_back(ip.first);
 
-	upq.ParallelFor(items, [](const ItemPair& ip) {
-		ip.first->Commit(ip.second);
-	});
+	{
+		ConfigProfilerScope profile("stage", "Commit items", true);
+		StartupPhase phase("commit items");
 
-	upq.Join();
+		upq.ParallelFor(items, [](const ItemPair& ip) {
+			ip.first->Commit(ip.second);
+		});
+
+		upq.Join();
+	}
 
 	if (upq.HasExceptions())
 		return false;
@@ -447,9 +521,22 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 			types.insert(type);
 	}
 
+	/* Group the items by type so that each stage only has to visit the items it needs. */
+	std::map<Type::Ptr, std::vector<ConfigItem::Ptr> > itemsByType;
+
+	for (const ItemPair& ip : items) {
+		if (ip.first->m_Object)
+			itemsByType[ip.first->m_Type].push_back(ip.first);
+	}
+
 	std::set<Type::Ptr> completed_types;
 
 	while (types.size() != completed_types.size()) {
+		/* Types whose load dependencies have all been completed do not depend on each
+		 * other and are therefore processed concurrently, instead of waiting for each
+		 * type separately. */
+		std::vector<Type::Ptr> ready_types;
+
 		for (const Type::Ptr& type : types) {
 			if (completed_types.find(type) != completed_types.end())
 				continue;
@@ -465,13 +552,34 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 				}
 			}
 
-			if (unresolved_dep)
-				continue;
+			if (!unresolved_dep)
+				ready_types.push_back(type);
+		}
+
+		/* The load dependencies must not contain cycles. */
+		VERIFY(!ready_types.empty());
+
+		std::vector<ConfigItem::Ptr> stageItems;
+		String stageName;
+
+		for (const Type::Ptr& type : ready_types) {
+			auto it = itemsByType.find(type);
+
+			if (it != itemsByType.end())
+				stageItems.insert(stageItems.end(), it->second.begin(), it->second.end());
+
+			if (!stageName.IsEmpty())
+				stageName += ", ";
 
-			upq.ParallelFor(items, [&type](const ItemPair& ip) {
-				const ConfigItem::Ptr& item = ip.first;
+			stageName += type->GetName();
+		}
+
+		{
+			ConfigProfilerScope profile("stage", "OnAllConfigLoaded: " + stageName, true);
+			StartupPhase phase("OnAllConfigLoaded");
 
-				if (!item->m_Object || item->m_Type != type)
+			upq.ParallelFor(stageItems, [](const ConfigItem::Ptr& item) {
+				if (!item->m_Object)
 					return;
 
 				try {
@@ -492,44 +600,124 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 				}
 			});
 
-			completed_types.insert(type);
-
 			upq.Join();
+		}
+
+		completed_types.insert(ready_types.begin(), ready_types.end());
 
-			if (upq.HasExceptions())
-				return false;
+		if (upq.HasExceptions())
+			return false;
+
+		if (!applyRules)
+			continue;
 
+		/* Map the types of the parent objects to the completed child types. Each parent
+		 * object then creates all of its child objects within a single task. */
+		std::map<Type::Ptr, std::vector<Type::Ptr> > childTypes;
+
+		for (const Type::Ptr& type : ready_types) {
 			for (const String& loadDep : type->GetLoadDependencies()) {
-				upq.ParallelFor(items, [loadDep, &type](const ItemPair& ip) {
-					const ConfigItem::Ptr& item = ip.first;
+				Type::Ptr pLoadDep = Type::GetByName(loadDep);
+
+				if (pLoadDep)
+					childTypes[pLoadDep].push_back(type);
+			}
+		}
+
+		std::vector<ConfigItem::Ptr> parentItems;
+
+		for (const auto& kv : childTypes) {
+			auto it = itemsByType.find(kv.first);
+
+			if (it != itemsByType.end())
+				parentItems.insert(parentItems.end(), it->second.begin(), it->second.end());
+		}
+
+		{
+			ConfigProfilerScope profile("stage", "CreateChildObjects: " + stageName, true);
+			StartupPhase phase("apply rule evaluation");
+
+			upq.ParallelFor(parentItems, [&childTypes](const ConfigItem::Ptr& item) {
+				if (!item->m_Object)
+					return;
 
-					if (!item->m_Object || item->m_Type->GetName() != loadDep)
-						return;
+				ActivationScope ascope(item->m_ActivationContext);
 
-					ActivationScope ascope(item->m_ActivationContext);
+				for (const Type::Ptr& type : childTypes.find(item->m_Type)->second)
 					item->m_Object->CreateChildObjects(type);
-				});
-			}
+			});
 
 			upq.Join();
+		}
 
-			if (upq.HasExceptions())
-				return false;
+		if (upq.HasExceptions())
+			return false;
 
-			if (!CommitNewItems(context, upq, newItems))
-				return false;
-		}
+		if (!CommitNewItems(context, upq, newItems, applyRules))
+			return false;
 	}
 
 	return true;
 }
 
-bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems, bool silent)
+/**
+ * Makes config objects share frozen instances of structurally identical
+ * dictionaries and arrays in their config attributes, e.g. the custom vars
+ * which many objects inherit from the same templates. Each object gets a
+ * shallow clone of the top-level value so that it's still modifiable, the
+ * clones share their elements until they are modified.
+ */
+static void DeduplicateConfigAttributes(const std::vector<ConfigItem::Ptr>& items, bool silent)
+{
+	ValueInternPool pool;
+
+	for (const ConfigItem::Ptr& item : items) {
+		ConfigObject::Ptr object = item->GetObject();
+
+		if (!object)
+			continue;
+
+		Type::Ptr type = object->GetReflectionType();
+
+		for (int fid = 0; fid < type->GetFieldCount(); fid++) {
+			Field field = type->GetFieldInfo(fid);
+
+			if (!(field.Attributes & FAConfig))
+				continue;
+
+			Value value = object->GetField(fid);
+
+			if (!value.IsObjectType<Dictionary>() && !value.IsObjectType<Array>())
+				continue;
+
+			Value shared = pool.Intern(value);
+
+			if (!shared.IsObjectType<Dictionary>() && !shared.IsObjectType<Array>())
+				continue;
+
+			if (static_cast<Object::Ptr>(shared) == static_cast<Object::Ptr>(value))
+				continue;
+
+			if (shared.IsObjectType<Dictionary>())
+				object->SetField(fid, static_cast<Dictionary::Ptr>(shared)->ShallowClone(), true);
+			else
+				object->SetField(fid, static_cast<Array::Ptr>(shared)->ShallowClone(), true);
+		}
+	}
+
+	if (!silent) {
+		Log(LogInformation, "ConfigItem")
+			<< "Replaced " << pool.GetSharedCount() << " dictionaries and arrays in config attributes with "
+			<< pool.GetUniqueCount() << " shared instances.";
+	}
+}
+
+bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems, bool silent, bool applyRules)
 {
 	if (!silent)
 		Log(LogInformation, "ConfigItem", "Committing config item(s).");
 
-	if (!CommitNewItems(context, upq, newItems)) {
+	if (!CommitNewItems(context, upq, newItems, applyRules)) {
 		upq.ReportExceptions("config");
 
 		for (const ConfigItem::Ptr& item : newItems) {
@@ -539,7 +727,15 @@ bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, WorkQueue& u
 		return false;
 	}
 
-	ApplyRule::CheckMatches();
+	if (applyRules)
+		ApplyRule::CheckMatches();
+
+	{
+		StartupPhase phase("config attribute deduplication");
+		DeduplicateConfigAttributes(newItems, silent);
+	}
+
+	StartupTimeline::AddConcurrentTime("validation", l_ValidationTime.exchange(0) / 1e9);
 
 	if (!silent) {
 		/* log stats for external parsers */
@@ -561,12 +757,65 @@ bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, WorkQueue& u
 	return true;
 }
 
+static bool IsDeferredType(const Type::Ptr& type)
+{
+	for (const char *name : l_DeferredTypes) {
+		if (type->GetName() == name)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Activates the objects which were skipped by ActivateItems() because of
+ * LazyActivation.
+ */
+void ConfigItem::ActivateDeferredObjects(const std::vector<ConfigObject::Ptr>& objects)
+{
+	double start = Utility::GetTime();
+	size_t activated = 0;
+
+	for (const char *name : l_DeferredTypes) {
+		Type::Ptr type = Type::GetByName(name);
+
+		if (!type)
+			continue;
+
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		boost::mutex::scoped_lock lock(l_ActivationMutex);
+
+		for (const ConfigObject::Ptr& object : objects) {
+			if (object->GetReflectionType() != type)
+				continue;
+
+			if (Application::IsShuttingDown())
+				return;
+
+			/* Skip objects which have been deleted in the meantime. */
+			if (object->IsActive() || ctype->GetObject(object->GetName()) != object)
+				continue;
+
+			object->PreActivate();
+			object->Activate();
+			activated++;
+		}
+	}
+
+	Log(LogInformation, "ConfigItem")
+		<< "Activated " << activated << " deferred objects in " << Utility::GetTime() - start << " seconds.";
+
+	OnItemsActivated(false);
+}
+
 bool ConfigItem::ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr>& newItems, bool runtimeCreated, bool silent, bool withModAttrs)
 {
-	static boost::mutex mtx;
-	boost::mutex::scoped_lock lock(mtx);
+	boost::mutex::scoped_lock lock(l_ActivationMutex);
 
 	if (withModAttrs) {
+		StartupPhase phase("modified attributes restore");
+
 		/* restore modified attributes */
 		if (Utility::PathExists(Application::GetModAttrPath())) {
 			std::unique_ptr<Expression> expression = ConfigCompiler::CompileFile(Application::GetModAttrPath());
@@ -582,6 +831,11 @@ bool ConfigItem::ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr
 		}
 	}
 
+	/* With LazyActivation the checker and the cluster are started before the
+	 * objects of the deferred types are activated. */
+	bool lazy = !runtimeCreated && !silent && Convert::ToBool(ScriptGlobal::Get("LazyActivation", &Empty));
+	std::vector<ConfigObject::Ptr> deferred;
+
 	for (const ConfigItem::Ptr& item : newItems) {
 		if (!item->m_Object)
 			continue;
@@ -591,6 +845,11 @@ bool ConfigItem::ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr
 		if (object->IsActive())
 			continue;
 
+		if (lazy && IsDeferredType(object->GetReflectionType())) {
+			deferred.push_back(object);
+			continue;
+		}
+
 #ifdef I2_DEBUG
 		Log(LogDebug, "ConfigItem")
 			<< "Setting 'active' to true for object '" << object->GetName() << "' of type '" << object->GetReflectionType()->GetName() << "'";
@@ -612,6 +871,12 @@ bool ConfigItem::ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr
 	});
 
 	for (const Type::Ptr& type : types) {
+		if (lazy && IsDeferredType(type))
+			continue;
+
+		double start = Utility::GetTime();
+		size_t activated = 0;
+
 		for (const ConfigItem::Ptr& item : newItems) {
 			if (!item->m_Object)
 				continue;
@@ -630,7 +895,11 @@ bool ConfigItem::ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr
 #endif /* I2_DEBUG */
 
 			object->Activate(runtimeCreated);
+			activated++;
 		}
+
+		if (activated > 0 && !runtimeCreated)
+			StartupTimeline::AddPhase("activate " + type->GetName(), start, Utility::GetTime());
 	}
 
 	upq.Join();
@@ -644,7 +913,7 @@ bool ConfigItem::ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr
 	for (const ConfigItem::Ptr& item : newItems) {
 		ConfigObject::Ptr object = item->m_Object;
 
-		if (!object)
+		if (!object || (lazy && IsDeferredType(object->GetReflectionType())))
 			continue;
 
 		ASSERT(object && object->IsActive());
@@ -654,6 +923,20 @@ bool ConfigItem::ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr
 	if (!silent)
 		Log(LogInformation, "ConfigItem", "Activated all objects.");
 
+	OnItemsActivated(runtimeCreated);
+
+	if (!deferred.empty()) {
+		Log(LogInformation, "ConfigItem")
+			<< "Activating " << deferred.size() << " objects in the background.";
+
+		if (!l_DeferredActivationQueue) {
+			l_DeferredActivationQueue = new WorkQueue(0, 1);
+			l_DeferredActivationQueue->SetName("ConfigItem, deferred activation");
+		}
+
+		l_DeferredActivationQueue->Enqueue(std::bind(&ConfigItem::ActivateDeferredObjects, std::move(deferred)));
+	}
+
 	return true;
 }
 
@@ -736,3 +1019,418 @@ void ConfigItem::RemoveIgnoredItems(const String& allowedConfigPath)
 
 	m_IgnoredItems.clear();
 }
+
+/**
+ * Returns the config attributes which differ between a running object and
+ * its new properties. Attributes which were modified at runtime keep their
+ * modified values and are not compared.
+ *
+ * @param object The running object.
+ * @param properties The new config attributes.
+ * @param recreate Set to true if an attribute changed that cannot be
+ *                 updated in place.
+ * @returns The changed attributes.
+ */
+static Dictionary::Ptr GetChangedAttributes(const ConfigObject::Ptr& object, const Dictionary::Ptr& properties, bool& recreate)
+{
+	Type::Ptr type = object->GetReflectionType();
+	Dictionary::Ptr current = Serialize(object, FAConfig);
+	Dictionary::Ptr original = object->GetOriginalAttributes();
+	std::set<String> modified;
+
+	if (original) {
+		ObjectLock olock(original);
+
+		for (const Dictionary::Pair& kv : original)
+			modified.insert(kv.first.SubStr(0, kv.first.Find(".")));
+	}
+
+	Dictionary::Ptr changes = new Dictionary();
+
+	ObjectLock olock(properties);
+
+	for (const Dictionary::Pair& kv : properties) {
+		int fid = type->GetFieldId(kv.first);
+
+		if (fid < 0 || modified.find(kv.first) != modified.end())
+			continue;
+
+		Field field = type->GetFieldInfo(fid);
+
+		if (!(field.Attributes & FAConfig))
+			continue;
+
+		if (JsonEncode(current->Get(kv.first)) == JsonEncode(kv.second))
+			continue;
+
+		/* References and internal attributes are resolved when the object is loaded. */
+		if (field.Attributes & (FANoUserModify | FANavigation))
+			recreate = true;
+
+		changes->Set(kv.first, kv.second);
+	}
+
+	return changes;
+}
+
+/**
+ * Checks whether a serialized value contains functions. Functions cannot
+ * be restored from the objects file.
+ */
+static bool ContainsFunctions(const Value& value)
+{
+	if (value.IsObjectType<Array>()) {
+		Array::Ptr arr = value;
+		ObjectLock olock(arr);
+
+		for (const Value& item : arr) {
+			if (ContainsFunctions(item))
+				return true;
+		}
+	} else if (value.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr dict = value;
+
+		if (dict->Get("type") == "Function")
+			return true;
+
+		ObjectLock olock(dict);
+
+		for (const Dictionary::Pair& kv : dict) {
+			if (ContainsFunctions(kv.second))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Updates the running objects to match the objects file written by a
+ * validation run: new objects are created, removed objects are deactivated,
+ * and changed objects are either updated in place or recreated with their
+ * current state. Unchanged objects are left alone.
+ *
+ * Templates and apply rules are not part of the objects file, objects which
+ * are created at runtime keep using the ones which were loaded on startup.
+ *
+ * @param objectsPath The path of the objects file.
+ * @returns true if all changes were applied, false otherwise.
+ */
+bool ConfigItem::ReloadObjects(const String& objectsPath)
+{
+	static boost::mutex mtx;
+	boost::mutex::scoped_lock lock(mtx);
+
+	Log(LogInformation, "ConfigItem")
+		<< "Updating objects from '" << objectsPath << "'.";
+
+	double start = Utility::GetTime();
+
+	typedef std::pair<Type::Ptr, String> ObjectKey;
+	std::map<ObjectKey, Dictionary::Ptr> persistentItems;
+
+	try {
+		std::fstream fp;
+		fp.open(objectsPath.CStr(), std::ios_base::in);
+
+		StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+		String message;
+		StreamReadContext src;
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+			if (srs == StatusEof)
+				break;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			Dictionary::Ptr persistentItem = JsonDecode(message);
+			Type::Ptr type = Type::GetByName(persistentItem->Get("type"));
+			Dictionary::Ptr properties = persistentItem->Get("properties");
+
+			if (!type || !properties)
+				continue;
+
+			persistentItems[std::make_pair(type, properties->Get("__name"))] = persistentItem;
+		}
+
+		sfp->Close();
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "ConfigItem")
+			<< "Could not read objects file '" << objectsPath << "': " << DiagnosticInformation(ex);
+		return false;
+	}
+
+	std::set<ConfigObject::Ptr> replaced;
+	std::map<ConfigObject::Ptr, Dictionary::Ptr> updated;
+
+	for (const Type::Ptr& type : Type::GetAllTypes()) {
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		if (!ctype)
+			continue;
+
+		for (const ConfigObject::Ptr& object : ctype->GetObjects()) {
+			auto it = persistentItems.find(std::make_pair(type, object->GetName()));
+
+			if (it == persistentItems.end()) {
+				/* Objects which weren't loaded from the config are kept. */
+				if (!object->GetDebugInfo().Path.IsEmpty())
+					replaced.insert(object);
+
+				continue;
+			}
+
+			bool recreate = false;
+			Dictionary::Ptr changes = GetChangedAttributes(object, it->second->Get("properties"), recreate);
+
+			if (recreate)
+				replaced.insert(object);
+			else if (changes->GetLength() > 0)
+				updated[object] = changes;
+		}
+	}
+
+	/* Objects which reference a replaced object have to be replaced as well. */
+	std::vector<ConfigObject::Ptr> pending(replaced.begin(), replaced.end());
+
+	while (!pending.empty()) {
+		ConfigObject::Ptr object = pending.back();
+		pending.pop_back();
+
+		for (const Object::Ptr& parent : DependencyGraph::GetParents(object)) {
+			ConfigObject::Ptr pobject = dynamic_pointer_cast<ConfigObject>(parent);
+
+			if (!pobject || !replaced.insert(pobject).second)
+				continue;
+
+			updated.erase(pobject);
+			pending.push_back(pobject);
+		}
+	}
+
+	for (const ConfigObject::Ptr& object : replaced)
+		updated.erase(object);
+
+	bool functions = false;
+
+	for (const auto& kv : updated)
+		functions = functions || ContainsFunctions(kv.second);
+
+	for (const auto& kv : persistentItems) {
+		auto *ctype = dynamic_cast<ConfigType *>(kv.first.first.get());
+		ConfigObject::Ptr object = ctype ? ctype->GetObject(kv.first.second) : nullptr;
+
+		if (!object || replaced.find(object) != replaced.end())
+			functions = functions || ContainsFunctions(kv.second->Get("properties"));
+	}
+
+	if (functions) {
+		Log(LogWarning, "ConfigItem", "Changed objects contain functions which cannot be restored from the objects file. Falling back to a full reload.");
+		Application::RequestFullReload();
+		return true;
+	}
+
+	/* Deactivate objects before the objects they depend on. */
+	std::vector<ConfigObject::Ptr> oldObjects;
+	std::set<ConfigObject::Ptr> visited;
+
+	std::function<void (const ConfigObject::Ptr&)> addOldObject = [&](const ConfigObject::Ptr& object) {
+		if (!visited.insert(object).second)
+			return;
+
+		for (const Object::Ptr& parent : DependencyGraph::GetParents(object)) {
+			ConfigObject::Ptr pobject = dynamic_pointer_cast<ConfigObject>(parent);
+
+			if (pobject && replaced.find(pobject) != replaced.end())
+				addOldObject(pobject);
+		}
+
+		oldObjects.push_back(object);
+	};
+
+	for (const ConfigObject::Ptr& object : replaced)
+		addOldObject(object);
+
+	std::map<ObjectKey, Dictionary::Ptr> states;
+	int removedCount = 0;
+
+	for (const ConfigObject::Ptr& object : oldObjects) {
+		Type::Ptr type = object->GetReflectionType();
+		ObjectKey key = std::make_pair(type, object->GetName());
+		bool removed = (persistentItems.find(key) == persistentItems.end());
+
+		if (!removed)
+			states[key] = Serialize(object, FAState);
+		else
+			removedCount++;
+
+		try {
+			object->Deactivate(removed);
+
+			ConfigItem::Ptr item = GetByTypeAndName(type, object->GetName());
+
+			if (item && item->m_Object == object) {
+				if (removed)
+					item->Unregister();
+				else {
+					object->Unregister();
+					item->m_Object.reset();
+				}
+			} else
+				object->Unregister();
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "ConfigItem")
+				<< "Could not remove object '" << object->GetName() << "' of type '" << type->GetName() << "': " << DiagnosticInformation(ex);
+			return false;
+		}
+	}
+
+	for (const auto& kv : updated) {
+		const ConfigObject::Ptr& object = kv.first;
+		Type::Ptr type = object->GetReflectionType();
+
+		ObjectLock olock(kv.second);
+
+		for (const Dictionary::Pair& attr : kv.second) {
+			Log(LogNotice, "ConfigItem")
+				<< "Updating attribute '" << attr.first << "' of object '" << object->GetName() << "' of type '" << type->GetName() << "'.";
+
+			object->SetField(type->GetFieldId(attr.first), Deserialize(attr.second, true, FAConfig));
+		}
+	}
+
+	std::vector<ConfigObject::Ptr> newObjects;
+	int recreatedCount = 0;
+	bool success = true;
+
+	for (const auto& kv : persistentItems) {
+		const Type::Ptr& type = kv.first.first;
+		const String& name = kv.first.second;
+
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		if (!ctype || ctype->GetObject(name))
+			continue;
+
+		Dictionary::Ptr persistentItem = kv.second;
+		Array::Ptr debugInfo = persistentItem->Get("debug_info");
+
+		DebugInfo di;
+
+		if (debugInfo && debugInfo->GetLength() == 5) {
+			di.Path = debugInfo->Get(0);
+			di.FirstLine = debugInfo->Get(1);
+			di.FirstColumn = debugInfo->Get(2);
+			di.LastLine = debugInfo->Get(3);
+			di.LastColumn = debugInfo->Get(4);
+		}
+
+		try {
+			ConfigObject::Ptr object = static_pointer_cast<ConfigObject>(type->Instantiate(std::vector<Value>()));
+			object->SetDebugInfo(di);
+			Deserialize(object, persistentItem->Get("properties"), true, FAConfig);
+			object->OnConfigLoaded();
+			object->Register();
+
+			if (!dynamic_cast<NameComposer *>(type.get())) {
+				ConfigItem::Ptr item = GetByTypeAndName(type, name);
+
+				if (!item) {
+					item = new ConfigItem(type, name, false, nullptr, nullptr, false, false, di,
+						nullptr, object->GetZoneName(), object->GetPackage());
+					item->Register();
+				}
+
+				item->m_Object = object;
+			}
+
+			newObjects.push_back(object);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "ConfigItem")
+				<< "Could not create object '" << name << "' of type '" << type->GetName() << "': " << DiagnosticInformation(ex);
+			success = false;
+		}
+	}
+
+	/* Resolve references in the same order as when the config is loaded on startup. */
+	std::set<Type::Ptr> types;
+
+	for (const ConfigObject::Ptr& object : newObjects)
+		types.insert(object->GetReflectionType());
+
+	std::set<Type::Ptr> completedTypes;
+
+	while (types.size() != completedTypes.size()) {
+		for (const Type::Ptr& type : types) {
+			if (completedTypes.find(type) != completedTypes.end())
+				continue;
+
+			bool unresolvedDep = false;
+
+			for (const String& loadDep : type->GetLoadDependencies()) {
+				Type::Ptr pLoadDep = Type::GetByName(loadDep);
+				if (types.find(pLoadDep) != types.end() && completedTypes.find(pLoadDep) == completedTypes.end()) {
+					unresolvedDep = true;
+					break;
+				}
+			}
+
+			if (unresolvedDep)
+				continue;
+
+			for (const ConfigObject::Ptr& object : newObjects) {
+				if (object->GetReflectionType() != type)
+					continue;
+
+				try {
+					object->OnAllConfigLoaded();
+				} catch (const std::exception& ex) {
+					Log(LogCritical, "ConfigItem")
+						<< "Could not load object '" << object->GetName() << "' of type '" << type->GetName() << "': " << DiagnosticInformation(ex);
+					success = false;
+				}
+			}
+
+			completedTypes.insert(type);
+		}
+	}
+
+	for (const ConfigObject::Ptr& object : newObjects) {
+		auto it = states.find(std::make_pair(object->GetReflectionType(), object->GetName()));
+
+		if (it != states.end()) {
+			Deserialize(object, it->second, false, FAState);
+			recreatedCount++;
+		}
+
+		object->OnStateLoaded();
+		object->SetStateLoaded(true);
+	}
+
+	std::sort(newObjects.begin(), newObjects.end(), [](const ConfigObject::Ptr& a, const ConfigObject::Ptr& b) {
+		return a->GetReflectionType()->GetActivationPriority() < b->GetReflectionType()->GetActivationPriority();
+	});
+
+	for (const ConfigObject::Ptr& object : newObjects)
+		object->PreActivate();
+
+	for (const ConfigObject::Ptr& object : newObjects) {
+		try {
+			object->Activate();
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "ConfigItem")
+				<< "Could not activate object '" << object->GetName() << "' of type '" << object->GetReflectionType()->GetName() << "': " << DiagnosticInformation(ex);
+			success = false;
+		}
+	}
+
+	Log(LogInformation, "ConfigItem")
+		<< "Updated objects in " << Utility::FormatDuration(Utility::GetTime() - start) << ": "
+		<< (newObjects.size() - recreatedCount) << " created, " << updated.size() << " updated, "
+		<< recreatedCount << " recreated, " << removedCount << " removed.";
+
+	return success;
+}
@@ -56,6 +56,7 @@ public:
 	std::vector<ConfigItem::Ptr> GetParents() const;
 
 	std::shared_ptr<Expression> GetExpression() const;
+	const std::shared_ptr<Expression>& GetTemplateExpression() const;
 	std::shared_ptr<Expression> GetFilter() const;
 
 	void Register();
@@ -69,7 +70,7 @@ public:
 	static ConfigItem::Ptr GetByTypeAndName(const Type::Ptr& type,
 		const String& name);
 
-	static bool CommitItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems, bool silent = false);
+	static bool CommitItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems, bool silent = false, bool applyRules = true);
 	static bool ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr>& newItems, bool runtimeCreated = false, bool silent = false, bool withModAttrs = false);
 
 	static bool RunWithActivationContext(const Function::Ptr& function);
@@ -79,12 +80,19 @@ public:
 
 	static void RemoveIgnoredItems(const String& allowedConfigPath);
 
+	static bool ReloadObjects(const String& objectsPath);
+
+	/* Emitted at the end of ActivateItems() once all new objects are active,
+	 * and again once the objects deferred by LazyActivation are active. */
+	static boost::signals2::signal<void (bool runtimeCreated)> OnItemsActivated;
+
 private:
 	Type::Ptr m_Type; /**< The object type. */
 	String m_Name; /**< The name. */
 	bool m_Abstract; /**< Whether this is a template. */
 
 	std::shared_ptr<Expression> m_Expression;
+	std::shared_ptr<Expression> m_TemplateExpression;
 	std::shared_ptr<Expression> m_Filter;
 	bool m_DefaultTmpl;
 	bool m_IgnoreOnError;
@@ -114,7 +122,8 @@ private:
 
 	ConfigObject::Ptr Commit(bool discard = true);
 
-	static bool CommitNewItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems);
+	static bool CommitNewItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems, bool applyRules);
+	static void ActivateDeferredObjects(const std::vector<ConfigObject::Ptr>& objects);
 };
 
 }
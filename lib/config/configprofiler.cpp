@@ -0,0 +1,298 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/configprofiler.hpp"
+#include "base/objectpool.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <vector>
+
+using namespace icinga;
+
+bool ConfigProfiler::m_Enabled = false;
+
+namespace
+{
+
+struct ProfileEntry
+{
+	uint64_t Count = 0;
+	uint64_t Hits = 0;
+	uint64_t Allocations = 0;
+	double Total = 0;
+	double Max = 0;
+};
+
+struct TraceEvent
+{
+	String Category;
+	String Name;
+	double Start;
+	double Duration;
+};
+
+struct ThreadProfile
+{
+	boost::mutex Mutex;
+	int ThreadId;
+	std::map<std::pair<String, String>, ProfileEntry> Entries;
+	std::vector<TraceEvent> Events;
+};
+
+typedef std::pair<std::pair<String, String>, ProfileEntry> ProfileItem;
+
+}
+
+static double l_ProfileStart;
+static boost::mutex l_ProfilesMutex;
+static std::vector<ThreadProfile *> l_Profiles;
+
+static void KeepThreadProfile(ThreadProfile *)
+{
+	/* The profile is owned by l_Profiles so that it can be reported after the thread has exited. */
+}
+
+static ThreadProfile *GetThreadProfile()
+{
+	static boost::thread_specific_ptr<ThreadProfile> profiles(&KeepThreadProfile);
+
+	ThreadProfile *profile = profiles.get();
+
+	if (!profile) {
+		profile = new ThreadProfile();
+
+		boost::mutex::scoped_lock lock(l_ProfilesMutex);
+		profile->ThreadId = l_Profiles.size() + 1;
+		l_Profiles.push_back(profile);
+
+		profiles.reset(profile);
+	}
+
+	return profile;
+}
+
+static std::vector<ProfileItem> GetProfileItems()
+{
+	std::map<std::pair<String, String>, ProfileEntry> entries;
+
+	{
+		boost::mutex::scoped_lock lock(l_ProfilesMutex);
+
+		for (ThreadProfile *profile : l_Profiles) {
+			boost::mutex::scoped_lock plock(profile->Mutex);
+
+			for (const auto& kv : profile->Entries) {
+				ProfileEntry& entry = entries[kv.first];
+				entry.Count += kv.second.Count;
+				entry.Hits += kv.second.Hits;
+				entry.Allocations += kv.second.Allocations;
+				entry.Total += kv.second.Total;
+				entry.Max = std::max(entry.Max, kv.second.Max);
+			}
+		}
+	}
+
+	std::vector<ProfileItem> items(entries.begin(), entries.end());
+
+	std::sort(items.begin(), items.end(), [](const ProfileItem& a, const ProfileItem& b) {
+		return a.second.Total > b.second.Total;
+	});
+
+	return items;
+}
+
+/**
+ * Enables the profiler. This should be done before the configuration is
+ * loaded.
+ */
+void ConfigProfiler::Enable()
+{
+	l_ProfileStart = Utility::GetTime();
+	m_Enabled = true;
+}
+
+/**
+ * Adds a sample.
+ *
+ * @param category The category, e.g. "parse" or "commit".
+ * @param name The name, e.g. the file name or the object type.
+ * @param start The start time.
+ * @param end The end time.
+ * @param allocations The number of pooled allocations.
+ * @param hit Whether the sample counts as a hit, e.g. a matching apply rule filter.
+ * @param trace Whether to add a trace event for the sample.
+ */
+void ConfigProfiler::AddSample(const String& category, const String& name, double start, double end,
+	uint64_t allocations, bool hit, bool trace)
+{
+	ThreadProfile *profile = GetThreadProfile();
+	double duration = end - start;
+
+	boost::mutex::scoped_lock lock(profile->Mutex);
+
+	ProfileEntry& entry = profile->Entries[std::make_pair(category, name)];
+	entry.Count++;
+	entry.Allocations += allocations;
+	entry.Total += duration;
+	entry.Max = std::max(entry.Max, duration);
+
+	if (hit)
+		entry.Hits++;
+
+	if (trace)
+		profile->Events.push_back({ category, name, start, duration });
+}
+
+/**
+ * Writes a tab-separated report which is sorted by the total time.
+ *
+ * @param fp The stream.
+ * @param limit The maximum number of rows, or 0 for all rows.
+ */
+void ConfigProfiler::WriteReport(std::ostream& fp, size_t limit)
+{
+	fp << "category\tname\tcount\thits\ttotal_ms\tavg_ms\tmax_ms\tallocations\n";
+
+	size_t rows = 0;
+
+	for (const ProfileItem& item : GetProfileItems()) {
+		if (limit > 0 && rows++ >= limit)
+			break;
+
+		const ProfileEntry& entry = item.second;
+
+		fp << item.first.first << "\t" << item.first.second << "\t" << entry.Count << "\t" << entry.Hits << "\t"
+			<< std::fixed << std::setprecision(3) << entry.Total * 1000 << "\t" << entry.Total * 1000 / entry.Count << "\t"
+			<< entry.Max * 1000 << "\t" << entry.Allocations << "\n";
+	}
+}
+
+/**
+ * Writes the trace events in the Chrome trace event format.
+ *
+ * @param fp The stream.
+ */
+void ConfigProfiler::WriteTrace(std::ostream& fp)
+{
+	ArrayData events;
+	int pid = Utility::GetPid();
+
+	{
+		boost::mutex::scoped_lock lock(l_ProfilesMutex);
+
+		for (ThreadProfile *profile : l_Profiles) {
+			boost::mutex::scoped_lock plock(profile->Mutex);
+
+			for (const TraceEvent& event : profile->Events) {
+				events.emplace_back(new Dictionary({
+					{ "name", event.Name },
+					{ "cat", event.Category },
+					{ "ph", "X" },
+					{ "ts", (event.Start - l_ProfileStart) * 1000000 },
+					{ "dur", event.Duration * 1000000 },
+					{ "pid", pid },
+					{ "tid", profile->ThreadId }
+				}));
+			}
+		}
+	}
+
+	Dictionary::Ptr trace = new Dictionary({
+		{ "traceEvents", new Array(std::move(events)) },
+		{ "displayTimeUnit", "ms" }
+	});
+
+	fp << JsonEncode(trace);
+}
+
+/**
+ * Writes the report to "<prefix>.tsv" and the trace to "<prefix>.json" and
+ * logs the most expensive entries.
+ *
+ * @param prefix The path prefix.
+ * @returns true if the files were written, false otherwise.
+ */
+bool ConfigProfiler::WriteFiles(const String& prefix)
+{
+	String reportPath = prefix + ".tsv";
+	String tracePath = prefix + ".json";
+
+	std::ofstream reportfp(reportPath.CStr(), std::ofstream::out | std::ofstream::trunc);
+	WriteReport(reportfp);
+	reportfp.close();
+
+	std::ofstream tracefp(tracePath.CStr(), std::ofstream::out | std::ofstream::trunc);
+	WriteTrace(tracefp);
+	tracefp.close();
+
+	if (!reportfp || !tracefp) {
+		Log(LogCritical, "ConfigProfiler")
+			<< "Could not write config profile to '" << reportPath << "' and '" << tracePath << "'.";
+		return false;
+	}
+
+	std::vector<ProfileItem> items = GetProfileItems();
+
+	for (std::vector<ProfileItem>::size_type i = 0; i < std::min<size_t>(items.size(), 10); i++) {
+		const ProfileItem& item = items[i];
+
+		Log(LogInformation, "ConfigProfiler")
+			<< Utility::FormatDuration(item.second.Total) << " in " << item.second.Count
+			<< " sample(s) for " << item.first.first << " '" << item.first.second << "'.";
+	}
+
+	Log(LogInformation, "ConfigProfiler")
+		<< "Wrote config profile to '" << reportPath << "' and Chrome trace to '" << tracePath << "'.";
+
+	return true;
+}
+
+ConfigProfilerScope::ConfigProfilerScope(const char *category, const String& name, bool trace)
+	: m_Category(category), m_Trace(trace)
+{
+	if (!ConfigProfiler::IsEnabled())
+		return;
+
+	m_Name = name;
+	m_Start = Utility::GetTime();
+	m_Allocations = ObjectPool::GetThreadAllocations();
+}
+
+ConfigProfilerScope::~ConfigProfilerScope()
+{
+	if (m_Start == 0)
+		return;
+
+	ConfigProfiler::AddSample(m_Category, m_Name, m_Start, Utility::GetTime(),
+		ObjectPool::GetThreadAllocations() - m_Allocations, m_Hit, m_Trace);
+}
+
+void ConfigProfilerScope::SetHit(bool hit)
+{
+	m_Hit = hit;
+}
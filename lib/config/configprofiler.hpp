@@ -0,0 +1,89 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CONFIGPROFILER_H
+#define CONFIGPROFILER_H
+
+#include "config/i2-config.hpp"
+#include "base/string.hpp"
+#include <cstdint>
+#include <iosfwd>
+
+namespace icinga
+{
+
+/**
+ * Collects timings while the configuration is compiled. Samples are
+ * aggregated per category and name, e.g. per config file or per object
+ * type. Coarse-grained samples are also kept as trace events which can be
+ * viewed in Chrome's trace viewer.
+ *
+ * @ingroup config
+ */
+class ConfigProfiler
+{
+public:
+	static void Enable();
+
+	static bool IsEnabled()
+	{
+		return m_Enabled;
+	}
+
+	static void AddSample(const String& category, const String& name, double start, double end,
+		uint64_t allocations, bool hit, bool trace);
+
+	static void WriteReport(std::ostream& fp, size_t limit = 0);
+	static void WriteTrace(std::ostream& fp);
+	static bool WriteFiles(const String& prefix);
+
+private:
+	static bool m_Enabled;
+
+	ConfigProfiler();
+};
+
+/**
+ * Records a sample for the lifetime of the scope if profiling is enabled.
+ *
+ * @ingroup config
+ */
+class ConfigProfilerScope
+{
+public:
+	ConfigProfilerScope(const char *category, const String& name, bool trace = false);
+	~ConfigProfilerScope();
+
+	ConfigProfilerScope(const ConfigProfilerScope&) = delete;
+	ConfigProfilerScope& operator=(const ConfigProfilerScope&) = delete;
+
+	void SetHit(bool hit);
+
+private:
+	const char *m_Category;
+	String m_Name;
+	bool m_Trace;
+	bool m_Hit{false};
+	double m_Start{0};
+	uint64_t m_Allocations{0};
+};
+
+}
+
+#endif /* CONFIGPROFILER_H */
@@ -36,6 +36,11 @@ using namespace icinga;
 boost::signals2::signal<void (ScriptFrame&, ScriptError *ex, const DebugInfo&)> Expression::OnBreakpoint;
 boost::thread_specific_ptr<bool> l_InBreakpointHandler;
 
+static void IgnoreDefinitionCollector(DefinitionList *)
+{ }
+
+static boost::thread_specific_ptr<DefinitionList> l_DefinitionCollector(&IgnoreDefinitionCollector);
+
 Expression::~Expression()
 { }
 
@@ -50,6 +55,25 @@ void Expression::ScriptBreakpoint(ScriptFrame& frame, ScriptError *ex, const Deb
 	}
 }
 
+/**
+ * Sets the list which function, object and apply definitions that are
+ * parsed by the current thread are added to.
+ *
+ * @param definitions The list, or nullptr to stop collecting definitions.
+ */
+void icinga::SetDefinitionCollector(DefinitionList *definitions)
+{
+	l_DefinitionCollector.reset(definitions);
+}
+
+void icinga::CollectDefinition(const DebugInfo& debugInfo, const Expression *expression)
+{
+	DefinitionList *definitions = l_DefinitionCollector.get();
+
+	if (definitions)
+		definitions->emplace_back(debugInfo, expression);
+}
+
 ExpressionResult Expression::Evaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	try {
@@ -447,13 +471,14 @@ ExpressionResult FunctionCallExpression::DoEvaluate(ScriptFrame& frame, DebugHin
 	if (!func->IsSideEffectFree() && frame.Sandboxed)
 		BOOST_THROW_EXCEPTION(ScriptError("Function is not marked as safe for sandbox mode.", m_DebugInfo));
 
-	std::vector<Value> arguments;
-	arguments.reserve(m_Args.size());
-	for (const auto& arg : m_Args) {
-		ExpressionResult argres = arg->Evaluate(frame);
+	/* Most calls have only a few arguments which fit into the inline buffer. */
+	InlineArguments<8> arguments(m_Args.size());
+
+	for (std::vector<std::unique_ptr<Expression> >::size_type i = 0; i < m_Args.size(); i++) {
+		ExpressionResult argres = m_Args[i]->Evaluate(frame);
 		CHECK_RESULT(argres);
 
-		arguments.push_back(argres.GetValue());
+		arguments[i] = argres.GetValue();
 	}
 
 	return VMOps::FunctionCall(frame, self, func, arguments);
@@ -628,6 +653,20 @@ ExpressionResult ContinueExpression::DoEvaluate(ScriptFrame& frame, DebugHint *d
 	return ExpressionResult(Empty, ResultContinue);
 }
 
+IndexerExpression::IndexerExpression(std::unique_ptr<Expression> operand1, std::unique_ptr<Expression> operand2, const DebugInfo& debugInfo)
+	: BinaryExpression(std::move(operand1), std::move(operand2), debugInfo)
+{
+	auto lexpr = dynamic_cast<LiteralExpression *>(m_Operand2.get());
+
+	if (lexpr && lexpr->GetValue().IsString())
+		m_Field = lexpr->GetValue();
+}
+
+IndexerExpression::~IndexerExpression()
+{
+	delete m_Binding.load();
+}
+
 ExpressionResult IndexerExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	ExpressionResult operand1 = m_Operand1->Evaluate(frame, dhint);
@@ -636,7 +675,62 @@ ExpressionResult IndexerExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dh
 	ExpressionResult operand2 = m_Operand2->Evaluate(frame, dhint);
 	CHECK_RESULT(operand2);
 
-	return VMOps::GetField(operand1.GetValue(), operand2.GetValue(), frame.Sandboxed, m_DebugInfo);
+	return GetField(operand1.GetValue(), operand2.GetValue(), frame.Sandboxed);
+}
+
+/**
+ * Looks up the expression's constant field for the specified type. Only the
+ * first type the expression is evaluated for is bound; other types use the
+ * regular lookup.
+ *
+ * @param type The object's type.
+ * @returns The binding.
+ */
+const IndexerExpression::FieldBinding *IndexerExpression::BindField(const Type::Ptr& type) const
+{
+	std::unique_ptr<FieldBinding> binding(new FieldBinding{ type, nullptr, false });
+
+	int fid = type->GetFieldId(m_Field);
+
+	if (fid >= 0) {
+		binding->Accessor = type->GetFieldAccessor(fid);
+		binding->NoUserView = (type->GetFieldInfo(fid).Attributes & FANoUserView) != 0;
+	}
+
+	const FieldBinding *expected = nullptr;
+
+	if (m_Binding.compare_exchange_strong(expected, binding.get()))
+		return binding.release();
+
+	return expected;
+}
+
+/**
+ * Returns the value of a field, like VMOps::GetField().
+ *
+ * @param context The object.
+ * @param index The field's name.
+ * @param sandboxed Whether the expression is evaluated in sandbox mode.
+ * @returns The field's value.
+ */
+Value IndexerExpression::GetField(const Value& context, const Value& index, bool sandboxed) const
+{
+	if (!m_Field.IsEmpty() && context.IsObject()) {
+		const Object::Ptr& object = context.Get<Object::Ptr>();
+		Type::Ptr type = object->GetReflectionType();
+
+		if (type) {
+			const FieldBinding *binding = m_Binding.load(std::memory_order_acquire);
+
+			if (!binding)
+				binding = BindField(type);
+
+			if (binding->BoundType == type && binding->Accessor && !(sandboxed && binding->NoUserView))
+				return binding->Accessor(object.get());
+		}
+	}
+
+	return VMOps::GetField(context, index, sandboxed, m_DebugInfo);
 }
 
 bool IndexerExpression::GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint) const
@@ -755,12 +849,155 @@ ExpressionResult ImportExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhi
 	if (scope)
 		scope->CopyTo(frame.Locals);
 
-	ExpressionResult result = item->GetExpression()->Evaluate(frame, dhint);
+	ExpressionResult result = item->GetTemplateExpression()->Evaluate(frame, dhint);
 	CHECK_RESULT(result);
 
 	return Empty;
 }
 
+TemplateExpression::TemplateExpression(Type::Ptr type, std::shared_ptr<Expression> expression)
+	: m_Type(std::move(type)), m_Expression(std::move(expression))
+{
+	AddSteps(m_Expression.get());
+}
+
+const DebugInfo& TemplateExpression::GetDebugInfo() const
+{
+	return m_Expression->GetDebugInfo();
+}
+
+static bool GetConstantPath(const Expression *expression, std::vector<String> *path)
+{
+	auto *vexpr = dynamic_cast<const VariableExpression *>(expression);
+
+	if (vexpr) {
+		path->push_back(vexpr->GetVariable());
+		return true;
+	}
+
+	auto *iexpr = dynamic_cast<const IndexerExpression *>(expression);
+
+	if (!iexpr || !GetConstantPath(iexpr->GetOperand1().get(), path))
+		return false;
+
+	auto *lexpr = dynamic_cast<const LiteralExpression *>(iexpr->GetOperand2().get());
+
+	if (!lexpr || !lexpr->GetValue().IsString())
+		return false;
+
+	path->push_back(lexpr->GetValue());
+	return true;
+}
+
+void TemplateExpression::AddSteps(const Expression *expression)
+{
+	/* Inline dictionaries evaluate their statements in the same frame, so
+	 * they can be flattened into a single list of statements. */
+	auto *oexpr = dynamic_cast<const OwnedExpression *>(expression);
+
+	if (oexpr) {
+		AddSteps(oexpr->GetExpression().get());
+		return;
+	}
+
+	auto *dexpr = dynamic_cast<const DictExpression *>(expression);
+
+	if (dexpr && dexpr->IsInline()) {
+		for (const std::unique_ptr<Expression>& expr : dexpr->GetExpressions())
+			AddSteps(expr.get());
+
+		return;
+	}
+
+	Step step;
+	step.Statement = expression;
+	step.IsConstant = false;
+
+	auto *sexpr = dynamic_cast<const SetExpression *>(expression);
+
+	if (sexpr && sexpr->GetOp() == OpSetLiteral && GetConstantPath(sexpr->GetOperand1().get(), &step.Path)) {
+		auto *lexpr = dynamic_cast<const LiteralExpression *>(sexpr->GetOperand2().get());
+
+		/* Objects might be modified by the objects which import the template. */
+		if (lexpr && !lexpr->GetValue().IsObject() && m_Type && m_Type->GetFieldId(step.Path[0]) != -1) {
+			step.IsConstant = true;
+			step.Constant = lexpr->GetValue();
+		}
+	}
+
+	m_Steps.push_back(std::move(step));
+}
+
+/**
+ * Applies a constant assignment the same way SetExpression would. Returns
+ * false if the assignment has to be evaluated instead, e.g. because a local
+ * variable shadows the field.
+ */
+bool TemplateExpression::ApplyConstant(ScriptFrame& frame, const Step& step, DebugHint *dhint) const
+{
+	if (frame.Sandboxed || !frame.Self.IsObject())
+		return false;
+
+	Object::Ptr self = frame.Self;
+	const String& field = step.Path[0];
+
+	if (self->GetReflectionType() != m_Type)
+		return false;
+
+	if (frame.Locals && (frame.Locals.get() == self.get() || frame.Locals->Contains(field)))
+		return false;
+
+	const DebugInfo& debugInfo = step.Statement->GetDebugInfo();
+
+	/* Intermediate values must either be dictionaries or empty. */
+	Value parent = self;
+	String index = field;
+
+	for (std::vector<String>::size_type i = 1; i < step.Path.size(); i++) {
+		Value child = VMOps::GetField(parent, index, false, debugInfo);
+
+		if (child.IsEmpty() && !child.IsString()) {
+			child = new Dictionary();
+			VMOps::SetField(parent, index, child, debugInfo);
+		} else if (!child.IsObjectType<Dictionary>())
+			return false;
+
+		parent = child;
+		index = step.Path[i];
+	}
+
+	VMOps::SetField(parent, index, step.Constant, debugInfo);
+
+	if (dhint) {
+		DebugHint hint = dhint->GetChild(field);
+
+		for (std::vector<String>::size_type i = 1; i < step.Path.size(); i++)
+			hint = hint.GetChild(step.Path[i]);
+
+		hint.AddMessage("=", debugInfo);
+	}
+
+	return true;
+}
+
+ExpressionResult TemplateExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
+{
+	Value result;
+
+	for (const Step& step : m_Steps) {
+		if (step.IsConstant && ApplyConstant(frame, step, dhint)) {
+			result = Empty;
+			continue;
+		}
+
+		ExpressionResult element = step.Statement->Evaluate(frame, dhint);
+		CHECK_RESULT(element);
+		result = element.GetValue();
+	}
+
+	return result;
+}
+
 ExpressionResult ImportDefaultTemplatesExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	if (frame.Sandboxed)
@@ -775,7 +1012,7 @@ ExpressionResult ImportDefaultTemplatesExpression::DoEvaluate(ScriptFrame& frame
 		if (scope)
 			scope->CopyTo(frame.Locals);
 
-		ExpressionResult result = item->GetExpression()->Evaluate(frame, dhint);
+		ExpressionResult result = item->GetTemplateExpression()->Evaluate(frame, dhint);
 		CHECK_RESULT(result);
 	}
 
@@ -784,7 +1021,18 @@ ExpressionResult ImportDefaultTemplatesExpression::DoEvaluate(ScriptFrame& frame
 
 ExpressionResult FunctionExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
-	return VMOps::NewFunction(frame, m_Name, m_Args, m_ClosedVars, m_Expression);
+	return VMOps::NewFunction(frame, m_Name, m_Args, m_ClosedVars, m_Expression, m_DebugInfo);
+}
+
+/**
+ * Re-creates a function from the config cache.
+ *
+ * @param closedVars The values of the closed variables.
+ * @returns The function.
+ */
+Function::Ptr FunctionExpression::Restore(const Dictionary::Ptr& closedVars) const
+{
+	return VMOps::NewFunction(m_Name, m_Args, closedVars, m_Expression, m_DebugInfo);
 }
 
 ExpressionResult ApplyExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
@@ -799,6 +1047,18 @@ ExpressionResult ApplyExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhin
 		m_Package, m_FKVar, m_FVVar, m_FTerm, m_ClosedVars, m_IgnoreOnError, m_Expression, m_DebugInfo);
 }
 
+/**
+ * Re-creates an apply rule from the config cache.
+ *
+ * @param name The evaluated name of the rule.
+ * @param scope The values of the closed variables.
+ */
+void ApplyExpression::Restore(const String& name, const Dictionary::Ptr& scope) const
+{
+	ApplyRule::AddRule(m_Type, m_Target, name, m_Expression, m_Filter, m_Package, m_FKVar,
+		m_FVVar, m_FTerm, m_IgnoreOnError, m_DebugInfo, scope);
+}
+
 ExpressionResult ObjectExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	if (frame.Sandboxed)
@@ -821,6 +1081,19 @@ ExpressionResult ObjectExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhi
 		m_Package, m_DefaultTmpl, m_IgnoreOnError, m_ClosedVars, m_Expression, m_DebugInfo);
 }
 
+/**
+ * Re-creates a template from the config cache.
+ *
+ * @param type The evaluated type of the template.
+ * @param name The evaluated name of the template.
+ * @param scope The values of the closed variables.
+ */
+void ObjectExpression::Restore(const Type::Ptr& type, const String& name, const Dictionary::Ptr& scope) const
+{
+	VMOps::NewObject(m_Abstract, type, name, m_Filter, m_Zone, m_Package,
+		m_DefaultTmpl, m_IgnoreOnError, scope, m_Expression, m_DebugInfo);
+}
+
 ExpressionResult ForExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	if (frame.Sandboxed)
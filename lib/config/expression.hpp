@@ -28,7 +28,9 @@
 #include "base/exception.hpp"
 #include "base/scriptframe.hpp"
 #include "base/convert.hpp"
+#include <atomic>
 #include <map>
+#include <mutex>
 
 namespace icinga
 {
@@ -224,6 +226,11 @@ public:
 		: m_Expression(std::move(expression))
 	{ }
 
+	const std::shared_ptr<Expression>& GetExpression() const
+	{
+		return m_Expression;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override
 	{
@@ -239,6 +246,46 @@ private:
 	std::shared_ptr<Expression> m_Expression;
 };
 
+struct BytecodeProgram;
+
+/**
+ * An expression which is compiled into bytecode for a register-based VM
+ * the first time it is evaluated. The expression tree is evaluated instead
+ * while a script debugger is attached, so that breakpoints see every
+ * expression.
+ *
+ * @ingroup config
+ */
+class BytecodeExpression final : public Expression
+{
+public:
+	BytecodeExpression(std::shared_ptr<Expression> expression);
+	~BytecodeExpression() override;
+
+	const std::shared_ptr<Expression>& GetExpression() const
+	{
+		return m_Expression;
+	}
+
+	bool GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint) const override;
+	const DebugInfo& GetDebugInfo() const override;
+
+protected:
+	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
+
+private:
+	std::shared_ptr<Expression> m_Expression;
+	mutable std::once_flag m_CompileOnce;
+	mutable std::unique_ptr<BytecodeProgram> m_Program;
+};
+
+std::shared_ptr<Expression> MakeBytecode(std::unique_ptr<Expression> expression);
+
+typedef std::vector<std::pair<DebugInfo, const Expression *> > DefinitionList;
+
+void SetDefinitionCollector(DefinitionList *definitions);
+void CollectDefinition(const DebugInfo& debugInfo, const Expression *expression);
+
 class LiteralExpression final : public Expression
 {
 public:
@@ -286,6 +333,11 @@ public:
 		: DebuggableExpression(debugInfo), m_Operand(std::move(operand))
 	{ }
 
+	const std::unique_ptr<Expression>& GetOperand() const
+	{
+		return m_Operand;
+	}
+
 protected:
 	std::unique_ptr<Expression> m_Operand;
 };
@@ -297,6 +349,16 @@ public:
 		: DebuggableExpression(debugInfo), m_Operand1(std::move(operand1)), m_Operand2(std::move(operand2))
 	{ }
 
+	const std::unique_ptr<Expression>& GetOperand1() const
+	{
+		return m_Operand1;
+	}
+
+	const std::unique_ptr<Expression>& GetOperand2() const
+	{
+		return m_Operand2;
+	}
+
 protected:
 	std::unique_ptr<Expression> m_Operand1;
 	std::unique_ptr<Expression> m_Operand2;
@@ -588,6 +650,11 @@ public:
 		: DebuggableExpression(debugInfo), m_Expressions(std::move(expressions))
 	{ }
 
+	const std::vector<std::unique_ptr<Expression> >& GetExpressions() const
+	{
+		return m_Expressions;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -604,6 +671,16 @@ public:
 
 	void MakeInline();
 
+	bool IsInline() const
+	{
+		return m_Inline;
+	}
+
+	const std::vector<std::unique_ptr<Expression> >& GetExpressions() const
+	{
+		return m_Expressions;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -621,6 +698,11 @@ public:
 		: BinaryExpression(std::move(operand1), std::move(operand2), debugInfo), m_Op(op)
 	{ }
 
+	CombinedSetOp GetOp() const
+	{
+		return m_Op;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -702,6 +784,11 @@ public:
 		: m_ScopeSpec(scopeSpec)
 	{ }
 
+	ScopeSpecifier GetScopeSpec() const
+	{
+		return m_ScopeSpec;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -709,18 +796,38 @@ private:
 	ScopeSpecifier m_ScopeSpec;
 };
 
+/**
+ * An indexer expression (e.g. service.state). If the index is a string
+ * literal the expression binds to the field's accessor the first time it
+ * is evaluated and reads the field directly for further objects of the
+ * same type.
+ */
 class IndexerExpression final : public BinaryExpression
 {
 public:
-	IndexerExpression(std::unique_ptr<Expression> operand1, std::unique_ptr<Expression> operand2, const DebugInfo& debugInfo = DebugInfo())
-		: BinaryExpression(std::move(operand1), std::move(operand2), debugInfo)
-	{ }
+	IndexerExpression(std::unique_ptr<Expression> operand1, std::unique_ptr<Expression> operand2, const DebugInfo& debugInfo = DebugInfo());
+	~IndexerExpression() override;
+
+	Value GetField(const Value& context, const Value& index, bool sandboxed) const;
 
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 	bool GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint) const override;
 
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
+
+private:
+	struct FieldBinding
+	{
+		Type::Ptr BoundType;
+		FieldAccessor Accessor;
+		bool NoUserView;
+	};
+
+	String m_Field;
+	mutable std::atomic<const FieldBinding *> m_Binding{nullptr};
+
+	const FieldBinding *BindField(const Type::Ptr& type) const;
 };
 
 void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
@@ -754,6 +861,39 @@ private:
 	std::unique_ptr<Expression> m_Name;
 };
 
+/**
+ * Evaluates the body of a template. Assignments of constant values to the
+ * fields of the template's type are resolved once when the template is
+ * registered and are applied to each object without evaluating their
+ * expressions. All other statements are evaluated as usual.
+ */
+class TemplateExpression final : public Expression
+{
+public:
+	TemplateExpression(Type::Ptr type, std::shared_ptr<Expression> expression);
+
+	const DebugInfo& GetDebugInfo() const override;
+
+protected:
+	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
+
+private:
+	struct Step
+	{
+		const Expression *Statement;
+		bool IsConstant;
+		std::vector<String> Path;
+		Value Constant;
+	};
+
+	Type::Ptr m_Type;
+	std::shared_ptr<Expression> m_Expression;
+	std::vector<Step> m_Steps;
+
+	void AddSteps(const Expression *expression);
+	bool ApplyConstant(ScriptFrame& frame, const Step& step, DebugHint *dhint) const;
+};
+
 class ImportDefaultTemplatesExpression final : public DebuggableExpression
 {
 public:
@@ -770,8 +910,12 @@ class FunctionExpression final : public DebuggableExpression
 public:
 	FunctionExpression(String name, std::vector<String> args,
 		std::map<String, std::unique_ptr<Expression> >&& closedVars, std::unique_ptr<Expression> expression, const DebugInfo& debugInfo = DebugInfo())
-		: DebuggableExpression(debugInfo), m_Name(std::move(name)), m_Args(std::move(args)), m_ClosedVars(std::move(closedVars)), m_Expression(std::move(expression))
-	{ }
+		: DebuggableExpression(debugInfo), m_Name(std::move(name)), m_Args(std::move(args)), m_ClosedVars(std::move(closedVars)), m_Expression(MakeBytecode(std::move(expression)))
+	{
+		CollectDefinition(m_DebugInfo, this);
+	}
+
+	Function::Ptr Restore(const Dictionary::Ptr& closedVars) const;
 
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
@@ -791,10 +935,14 @@ public:
 		std::unique_ptr<Expression> fterm, std::map<String, std::unique_ptr<Expression> >&& closedVars, bool ignoreOnError,
 		std::unique_ptr<Expression> expression, const DebugInfo& debugInfo = DebugInfo())
 		: DebuggableExpression(debugInfo), m_Type(std::move(type)), m_Target(std::move(target)),
-			m_Name(std::move(name)), m_Filter(std::move(filter)), m_Package(std::move(package)), m_FKVar(std::move(fkvar)), m_FVVar(std::move(fvvar)),
+			m_Name(std::move(name)), m_Filter(MakeBytecode(std::move(filter))), m_Package(std::move(package)), m_FKVar(std::move(fkvar)), m_FVVar(std::move(fvvar)),
 			m_FTerm(std::move(fterm)), m_IgnoreOnError(ignoreOnError), m_ClosedVars(std::move(closedVars)),
 			m_Expression(std::move(expression))
-	{ }
+	{
+		CollectDefinition(m_DebugInfo, this);
+	}
+
+	void Restore(const String& name, const Dictionary::Ptr& scope) const;
 
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
@@ -820,9 +968,13 @@ public:
 		String zone, String package, std::map<String, std::unique_ptr<Expression> >&& closedVars,
 		bool defaultTmpl, bool ignoreOnError, std::unique_ptr<Expression> expression, const DebugInfo& debugInfo = DebugInfo())
 		: DebuggableExpression(debugInfo), m_Abstract(abstract), m_Type(std::move(type)),
-		m_Name(std::move(name)), m_Filter(std::move(filter)), m_Zone(std::move(zone)), m_Package(std::move(package)), m_DefaultTmpl(defaultTmpl),
+		m_Name(std::move(name)), m_Filter(MakeBytecode(std::move(filter))), m_Zone(std::move(zone)), m_Package(std::move(package)), m_DefaultTmpl(defaultTmpl),
 		m_IgnoreOnError(ignoreOnError), m_ClosedVars(std::move(closedVars)), m_Expression(std::move(expression))
-	{ }
+	{
+		CollectDefinition(m_DebugInfo, this);
+	}
+
+	void Restore(const Type::Ptr& type, const String& name, const Dictionary::Ptr& scope) const;
 
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
@@ -18,12 +18,28 @@
  ******************************************************************************/
 
 #include "config/objectrule.hpp"
+#include "config/configitem.hpp"
+#include "config/ruleindex.hpp"
+#include <boost/thread/mutex.hpp>
 #include <set>
 
 using namespace icinga;
 
 ObjectRule::TypeSet ObjectRule::m_Types;
 
+namespace {
+
+struct ObjectRuleIndex
+{
+	std::vector<ConfigItem::Ptr> Rules;
+	std::shared_ptr<const RuleIndex> Index;
+};
+
+}
+
+static boost::mutex l_ObjectRuleIndexesMutex;
+static std::map<Type::Ptr, ObjectRuleIndex> l_ObjectRuleIndexes;
+
 void ObjectRule::RegisterType(const String& sourceType)
 {
 	m_Types.insert(sourceType);
@@ -33,3 +49,92 @@ bool ObjectRule::IsValidSourceType(const String& sourceType)
 {
 	return m_Types.find(sourceType) != m_Types.end();
 }
+
+/**
+ * Returns the object rules (e.g. host groups with 'assign where' conditions)
+ * of a type whose filters may match the specified variables. The index is
+ * rebuilt whenever objects of the type are added or removed.
+ *
+ * @param type The type of the objects which have the rules, e.g. HostGroup.
+ * @param variables The variables the filters will be evaluated with, e.g. 'host'.
+ * @returns The config items of the candidate rules.
+ */
+std::vector<ConfigItem::Ptr> ObjectRule::GetCandidateRules(const Type::Ptr& type, const std::map<String, Value>& variables)
+{
+	std::vector<ConfigItem::Ptr> rules;
+
+	for (const ConfigItem::Ptr& item : ConfigItem::GetItems(type)) {
+		if (item->GetFilter())
+			rules.push_back(item);
+	}
+
+	std::shared_ptr<const RuleIndex> index;
+
+	{
+		boost::mutex::scoped_lock lock(l_ObjectRuleIndexesMutex);
+		ObjectRuleIndex& cachedIndex = l_ObjectRuleIndexes[type];
+
+		if (!cachedIndex.Index || cachedIndex.Rules != rules) {
+			std::set<String> names;
+
+			for (const auto& kv : variables)
+				names.insert(kv.first);
+
+			auto newIndex = std::make_shared<RuleIndex>(std::move(names));
+
+			for (const ConfigItem::Ptr& rule : rules)
+				newIndex->AddRule(rule->GetFilter().get(), rule->GetScope());
+
+			cachedIndex.Rules = rules;
+			cachedIndex.Index = std::move(newIndex);
+		}
+
+		index = cachedIndex.Index;
+	}
+
+	std::vector<ConfigItem::Ptr> result;
+
+	for (size_t rule : index->GetCandidates(variables))
+		result.push_back(rules[rule]);
+
+	return result;
+}
+
+/**
+ * Evaluates the candidate object rules of a type in the order of their
+ * names, i.e. in the same order as ConfigItem::GetItems() returns them.
+ *
+ * A rule which matches usually changes the object's groups, which later
+ * rules may check. The candidates are therefore determined again after
+ * each match.
+ *
+ * @param type The type of the objects which have the rules, e.g. HostGroup.
+ * @param variables The variables the filters will be evaluated with, e.g. 'host'.
+ * @param evaluate Evaluates a rule and returns whether it matched.
+ */
+void ObjectRule::EvaluateRules(const Type::Ptr& type, const std::map<String, Value>& variables,
+	const std::function<bool (const ConfigItem::Ptr&)>& evaluate)
+{
+	bool started = false;
+	String last;
+
+	for (;;) {
+		bool matched = false;
+
+		for (const ConfigItem::Ptr& rule : GetCandidateRules(type, variables)) {
+			if (started && rule->GetName() <= last)
+				continue;
+
+			started = true;
+			last = rule->GetName();
+
+			if (evaluate(rule)) {
+				matched = true;
+				break;
+			}
+		}
+
+		if (!matched)
+			break;
+	}
+}
@@ -23,11 +23,15 @@
 #include "config/i2-config.hpp"
 #include "config/expression.hpp"
 #include "base/debuginfo.hpp"
+#include <functional>
+#include <map>
 #include <set>
 
 namespace icinga
 {
 
+class ConfigItem;
+
 /**
  * @ingroup config
  */
@@ -39,6 +43,10 @@ public:
 	static void RegisterType(const String& sourceType);
 	static bool IsValidSourceType(const String& sourceType);
 
+	static std::vector<intrusive_ptr<ConfigItem> > GetCandidateRules(const Type::Ptr& type, const std::map<String, Value>& variables);
+	static void EvaluateRules(const Type::Ptr& type, const std::map<String, Value>& variables,
+		const std::function<bool (const intrusive_ptr<ConfigItem>&)>& evaluate);
+
 private:
 	ObjectRule();
 
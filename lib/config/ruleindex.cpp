@@ -0,0 +1,314 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/ruleindex.hpp"
+#include "config/vmops.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/objectlock.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+
+using namespace icinga;
+
+namespace {
+
+enum RulePredicateType
+{
+	PredicateEqual,
+	PredicateMember,
+	PredicateMatch
+};
+
+/**
+ * A condition on an attribute of a variable like 'host' which holds for
+ * all objects a rule's filter matches.
+ */
+struct RulePredicate
+{
+	String Variable;
+	std::vector<String> Path;
+	RulePredicateType Type;
+	String Value;
+};
+
+}
+
+static bool GetPredicatePath(const Expression *expr, const std::set<String>& variables, String& variable, std::vector<String>& path)
+{
+	auto iexpr = dynamic_cast<const IndexerExpression *>(expr);
+
+	if (!iexpr) {
+		auto vexpr = dynamic_cast<const VariableExpression *>(expr);
+
+		if (!vexpr || variables.find(vexpr->GetVariable()) == variables.end())
+			return false;
+
+		variable = vexpr->GetVariable();
+		return true;
+	}
+
+	auto lexpr = dynamic_cast<const LiteralExpression *>(iexpr->GetOperand2().get());
+
+	if (!lexpr || !lexpr->GetValue().IsString())
+		return false;
+
+	if (!GetPredicatePath(iexpr->GetOperand1().get(), variables, variable, path))
+		return false;
+
+	path.push_back(lexpr->GetValue());
+	return true;
+}
+
+static bool GetPredicateConstant(const Expression *expr, String& value)
+{
+	auto lexpr = dynamic_cast<const LiteralExpression *>(expr);
+
+	/* Empty strings are equal to null, so they can't be looked up by value. */
+	if (!lexpr || !lexpr->GetValue().IsString() || lexpr->GetValue() == "")
+		return false;
+
+	value = lexpr->GetValue();
+	return true;
+}
+
+/**
+ * Finds predicates one of which holds whenever the expression is true.
+ *
+ * @param expr The expression.
+ * @param variables The variables predicates may refer to.
+ * @param indexMatch Whether match() calls may be used as predicates.
+ * @param predicates Receives the predicates.
+ * @returns true if such predicates were found, false otherwise.
+ */
+static bool GetRulePredicates(const Expression *expr, const std::set<String>& variables, bool indexMatch,
+	std::vector<RulePredicate>& predicates)
+{
+	if (auto bexpr = dynamic_cast<const BytecodeExpression *>(expr))
+		return GetRulePredicates(bexpr->GetExpression().get(), variables, indexMatch, predicates);
+
+	if (auto dexpr = dynamic_cast<const DictExpression *>(expr)) {
+		if (!dexpr->IsInline() || dexpr->GetExpressions().size() != 1)
+			return false;
+
+		return GetRulePredicates(dexpr->GetExpressions()[0].get(), variables, indexMatch, predicates);
+	}
+
+	if (auto oexpr = dynamic_cast<const LogicalOrExpression *>(expr)) {
+		std::vector<RulePredicate> left, right;
+
+		if (!GetRulePredicates(oexpr->GetOperand1().get(), variables, indexMatch, left)
+			|| !GetRulePredicates(oexpr->GetOperand2().get(), variables, indexMatch, right))
+			return false;
+
+		predicates.insert(predicates.end(), left.begin(), left.end());
+		predicates.insert(predicates.end(), right.begin(), right.end());
+		return true;
+	}
+
+	/* Both sides must hold for a conjunction, so either side's predicates are sufficient. */
+	if (auto aexpr = dynamic_cast<const LogicalAndExpression *>(expr)) {
+		return GetRulePredicates(aexpr->GetOperand1().get(), variables, indexMatch, predicates)
+			|| GetRulePredicates(aexpr->GetOperand2().get(), variables, indexMatch, predicates);
+	}
+
+	RulePredicate predicate;
+
+	if (auto eexpr = dynamic_cast<const EqualExpression *>(expr)) {
+		predicate.Type = PredicateEqual;
+
+		if (!(GetPredicatePath(eexpr->GetOperand1().get(), variables, predicate.Variable, predicate.Path)
+			&& GetPredicateConstant(eexpr->GetOperand2().get(), predicate.Value))
+			&& !(GetPredicatePath(eexpr->GetOperand2().get(), variables, predicate.Variable, predicate.Path)
+			&& GetPredicateConstant(eexpr->GetOperand1().get(), predicate.Value)))
+			return false;
+	} else if (auto iexpr = dynamic_cast<const InExpression *>(expr)) {
+		predicate.Type = PredicateMember;
+
+		if (!GetPredicateConstant(iexpr->GetOperand1().get(), predicate.Value)
+			|| !GetPredicatePath(iexpr->GetOperand2().get(), variables, predicate.Variable, predicate.Path))
+			return false;
+	} else if (auto fexpr = dynamic_cast<const FunctionCallExpression *>(expr)) {
+		predicate.Type = PredicateMatch;
+
+		auto vexpr = dynamic_cast<const VariableExpression *>(fexpr->m_FName.get());
+
+		if (!indexMatch || !vexpr || vexpr->GetVariable() != "match" || fexpr->m_Args.size() != 2
+			|| !GetPredicateConstant(fexpr->m_Args[0].get(), predicate.Value)
+			|| !GetPredicatePath(fexpr->m_Args[1].get(), variables, predicate.Variable, predicate.Path))
+			return false;
+	} else
+		return false;
+
+	/* The variable itself isn't indexed, only its attributes. */
+	if (predicate.Path.empty())
+		return false;
+
+	predicates.push_back(std::move(predicate));
+	return true;
+}
+
+static void SelectRules(const std::map<String, std::vector<size_t> >& rules, std::vector<bool>& selected)
+{
+	for (const auto& kv : rules) {
+		for (size_t rule : kv.second)
+			selected[rule] = true;
+	}
+}
+
+static void SelectRules(const std::map<String, std::vector<size_t> >& rules, const String& key, std::vector<bool>& selected)
+{
+	auto it = rules.find(key);
+
+	if (it == rules.end())
+		return;
+
+	for (size_t rule : it->second)
+		selected[rule] = true;
+}
+
+RuleIndex::RuleIndex(std::set<String> variables)
+	: m_Variables(std::move(variables))
+{ }
+
+/**
+ * Adds a rule to the index. Rules are identified by the order in which
+ * they were added.
+ *
+ * @param filter The rule's filter, may be null.
+ * @param scope The rule's scope. Its variables shadow the indexed variables.
+ * @param shadowed Additional variables which shadow the indexed variables,
+ *                 e.g. the variables of 'for' loops.
+ */
+void RuleIndex::AddRule(const Expression *filter, const Dictionary::Ptr& scope, const std::set<String>& shadowed)
+{
+	size_t rule = m_RuleCount++;
+
+	std::set<String> variables;
+
+	for (const String& variable : m_Variables) {
+		if ((!scope || !scope->Contains(variable)) && shadowed.find(variable) == shadowed.end())
+			variables.insert(variable);
+	}
+
+	bool indexMatch = (!scope || !scope->Contains("match")) && shadowed.find("match") == shadowed.end()
+		&& !ScriptGlobal::Exists("match");
+
+	std::vector<RulePredicate> predicates;
+
+	if (!filter || !GetRulePredicates(filter, variables, indexMatch, predicates)) {
+		m_Unindexed.push_back(rule);
+		return;
+	}
+
+	for (const RulePredicate& predicate : predicates) {
+		auto it = std::find_if(m_Paths.begin(), m_Paths.end(), [&predicate](const RuleIndexPath& path) {
+			return path.Variable == predicate.Variable && path.Path == predicate.Path;
+		});
+
+		if (it == m_Paths.end()) {
+			m_Paths.emplace_back();
+			it = m_Paths.end() - 1;
+			it->Variable = predicate.Variable;
+			it->Path = predicate.Path;
+		}
+
+		if (predicate.Type == PredicateEqual)
+			it->Values[predicate.Value].push_back(rule);
+		else if (predicate.Type == PredicateMember)
+			it->Members[predicate.Value].push_back(rule);
+		else
+			it->Patterns.emplace_back(predicate.Value, rule);
+	}
+}
+
+size_t RuleIndex::GetRuleCount() const
+{
+	return m_RuleCount;
+}
+
+/**
+ * Returns the rules whose filters may match the specified variables, in the
+ * order in which the rules were added. Rules whose filters can't be analyzed
+ * are always returned.
+ *
+ * @param variables The variables the filters will be evaluated with, e.g. 'host'.
+ * @returns The indexes of the candidate rules.
+ */
+std::vector<size_t> RuleIndex::GetCandidates(const std::map<String, Value>& variables) const
+{
+	std::vector<bool> selected(m_RuleCount, false);
+
+	for (size_t rule : m_Unindexed)
+		selected[rule] = true;
+
+	for (const RuleIndexPath& path : m_Paths) {
+		auto it = variables.find(path.Variable);
+		bool known = (it != variables.end());
+		Value value;
+
+		if (known) {
+			value = it->second;
+
+			try {
+				for (const String& component : path.Path)
+					value = VMOps::GetField(value, component, false, DebugInfo());
+			} catch (const std::exception&) {
+				/* Let the filter report the error. */
+				known = false;
+			}
+		}
+
+		if (!known || !value.IsString())
+			SelectRules(path.Values, selected);
+		else
+			SelectRules(path.Values, value, selected);
+
+		if (!path.Members.empty()) {
+			if (known && value.IsObjectType<Array>()) {
+				Array::Ptr arr = value;
+				ObjectLock olock(arr);
+
+				for (const Value& item : arr) {
+					if (!item.IsString()) {
+						SelectRules(path.Members, selected);
+						break;
+					}
+
+					SelectRules(path.Members, item, selected);
+				}
+			} else if (!known || !value.IsEmpty()) {
+				SelectRules(path.Members, selected);
+			}
+		}
+
+		for (const auto& pattern : path.Patterns) {
+			if (!known || !value.IsString() || Utility::Match(pattern.first, value))
+				selected[pattern.second] = true;
+		}
+	}
+
+	std::vector<size_t> result;
+
+	for (size_t i = 0; i < m_RuleCount; i++) {
+		if (selected[i])
+			result.push_back(i);
+	}
+
+	return result;
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef RULEINDEX_H
+#define RULEINDEX_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include "base/dictionary.hpp"
+#include <map>
+#include <set>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * The rules which have conditions on a specific attribute.
+ *
+ * @ingroup config
+ */
+struct RuleIndexPath
+{
+	String Variable;
+	std::vector<String> Path;
+	std::map<String, std::vector<size_t> > Values;
+	std::map<String, std::vector<size_t> > Members;
+	std::vector<std::pair<String, size_t> > Patterns;
+};
+
+/**
+ * An index of rule filters (e.g. 'assign where' conditions) by their
+ * equality, membership and match() conditions on attributes of variables
+ * like 'host'. It returns the rules whose filters may match a set of
+ * variables so that the other filters don't have to be evaluated.
+ *
+ * @ingroup config
+ */
+class RuleIndex
+{
+public:
+	RuleIndex(std::set<String> variables);
+
+	void AddRule(const Expression *filter, const Dictionary::Ptr& scope, const std::set<String>& shadowed = std::set<String>());
+
+	size_t GetRuleCount() const;
+	std::vector<size_t> GetCandidates(const std::map<String, Value>& variables) const;
+
+private:
+	std::set<String> m_Variables;
+	size_t m_RuleCount{0};
+	std::vector<size_t> m_Unindexed;
+	std::vector<RuleIndexPath> m_Paths;
+};
+
+}
+
+#endif /* RULEINDEX_H */
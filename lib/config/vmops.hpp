@@ -25,6 +25,7 @@
 #include "config/configitembuilder.hpp"
 #include "config/applyrule.hpp"
 #include "config/objectrule.hpp"
+#include "config/configcache.hpp"
 #include "base/debuginfo.hpp"
 #include "base/array.hpp"
 #include "base/dictionary.hpp"
@@ -99,7 +100,7 @@ public:
 			return type->Instantiate(args);
 	}
 
-	static inline Value FunctionCall(ScriptFrame& frame, const Value& self, const Function::Ptr& func, const std::vector<Value>& arguments)
+	static inline Value FunctionCall(ScriptFrame& frame, const Value& self, const Function::Ptr& func, const ArgumentSpan& arguments)
 	{
 		if (!self.IsEmpty() || self.IsString())
 			return func->InvokeThis(self, arguments);
@@ -109,11 +110,17 @@ public:
 	}
 
 	static inline Value NewFunction(ScriptFrame& frame, const String& name, const std::vector<String>& argNames,
-		const std::map<String, std::unique_ptr<Expression> >& closedVars, const std::shared_ptr<Expression>& expression)
+		const std::map<String, std::unique_ptr<Expression> >& closedVars, const std::shared_ptr<Expression>& expression,
+		const DebugInfo& debugInfo = DebugInfo())
 	{
-		auto evaluatedClosedVars = EvaluateClosedVars(frame, closedVars);
+		return NewFunction(name, argNames, EvaluateClosedVars(frame, closedVars), expression, debugInfo);
+	}
 
-		auto wrapper = [argNames, evaluatedClosedVars, expression](const std::vector<Value>& arguments) -> Value {
+	static inline Function::Ptr NewFunction(const String& name, const std::vector<String>& argNames,
+		const Dictionary::Ptr& evaluatedClosedVars, const std::shared_ptr<Expression>& expression,
+		const DebugInfo& debugInfo = DebugInfo())
+	{
+		auto wrapper = [argNames, evaluatedClosedVars, expression](const ArgumentSpan& arguments) -> Value {
 			if (arguments.size() < argNames.size())
 				BOOST_THROW_EXCEPTION(std::invalid_argument("Too few arguments for function"));
 
@@ -124,13 +131,18 @@ public:
 			if (evaluatedClosedVars)
 				evaluatedClosedVars->CopyTo(frame->Locals);
 
-			for (std::vector<Value>::size_type i = 0; i < std::min(arguments.size(), argNames.size()); i++)
+			for (size_t i = 0; i < std::min(arguments.size(), argNames.size()); i++)
 				frame->Locals->Set(argNames[i], arguments[i]);
 
 			return expression->Evaluate(*frame);
 		};
 
-		return new Function(name, wrapper, argNames);
+		Function::Ptr func = new Function(name, wrapper, argNames);
+
+		if (ConfigCache::IsRecording())
+			ConfigCache::RecordFunction(func, debugInfo, evaluatedClosedVars);
+
+		return func;
 	}
 
 	static inline Value NewApply(ScriptFrame& frame, const String& type, const String& target, const String& name, const std::shared_ptr<Expression>& filter,
@@ -145,6 +157,13 @@ public:
 
 	static inline Value NewObject(ScriptFrame& frame, bool abstract, const Type::Ptr& type, const String& name, const std::shared_ptr<Expression>& filter,
 		const String& zone, const String& package, bool defaultTmpl, bool ignoreOnError, const std::map<String, std::unique_ptr<Expression> >& closedVars, const std::shared_ptr<Expression>& expression, const DebugInfo& debugInfo = DebugInfo())
+	{
+		return NewObject(abstract, type, name, filter, zone, package, defaultTmpl, ignoreOnError,
+			EvaluateClosedVars(frame, closedVars), expression, debugInfo);
+	}
+
+	static inline Value NewObject(bool abstract, const Type::Ptr& type, const String& name, const std::shared_ptr<Expression>& filter,
+		const String& zone, const String& package, bool defaultTmpl, bool ignoreOnError, const Dictionary::Ptr& scope, const std::shared_ptr<Expression>& expression, const DebugInfo& debugInfo = DebugInfo())
 	{
 		ConfigItemBuilder item{debugInfo};
 
@@ -181,7 +200,7 @@ public:
 
 		item.AddExpression(new OwnedExpression(expression));
 		item.SetAbstract(abstract);
-		item.SetScope(EvaluateClosedVars(frame, closedVars));
+		item.SetScope(scope);
 		item.SetZone(zone);
 		item.SetPackage(package);
 		item.SetFilter(filter);
@@ -21,6 +21,7 @@
 #include "db_ido/dbconnection-ti.cpp"
 #include "db_ido/dbvalue.hpp"
 #include "icinga/icingaapplication.hpp"
+#include "icinga/cib.hpp"
 #include "icinga/host.hpp"
 #include "icinga/service.hpp"
 #include "base/configtype.hpp"
@@ -89,8 +90,8 @@ void DbConnection::Resume()
 	Log(LogInformation, "DbConnection")
 		<< "Resuming IDO connection: " << GetName();
 
-	m_CleanUpTimer = new Timer();
-	m_CleanUpTimer->SetInterval(60);
+	m_CleanUpTimer = new Timer("DbConnection cleanup");
+	m_CleanUpTimer->SetInterval(1);
 	m_CleanUpTimer->OnTimerExpired.connect(std::bind(&DbConnection::CleanUpHandler, this));
 	m_CleanUpTimer->Start();
 }
@@ -127,7 +128,7 @@ void DbConnection::Pause()
 
 void DbConnection::InitializeDbTimer()
 {
-	m_ProgramStatusTimer = new Timer();
+	m_ProgramStatusTimer = new Timer("DbConnection program status");
 	m_ProgramStatusTimer->SetInterval(10);
 	m_ProgramStatusTimer->OnTimerExpired.connect(std::bind(&DbConnection::UpdateProgramStatus));
 	m_ProgramStatusTimer->Start();
@@ -208,47 +209,161 @@ void DbConnection::UpdateProgramStatus()
 	InsertRuntimeVariable("total_scheduled_hosts", ConfigType::Get<Host>()->GetObjectCount());
 }
 
+/**
+ * Deletes old history rows. The cut-off times are refreshed every minute,
+ * the rows are deleted in chunks of at most "chunk_rows" rows. Only one
+ * chunk is in flight at a time and "rows_per_second" limits how fast the
+ * chunks follow each other.
+ */
 void DbConnection::CleanUpHandler()
 {
-	auto now = static_cast<long>(Utility::GetTime());
-
-	struct {
-		String name;
-		String time_column;
-	} tables[] = {
-		{ "acknowledgements", "entry_time" },
-		{ "commenthistory", "entry_time" },
-		{ "contactnotifications", "start_time" },
-		{ "contactnotificationmethods", "start_time" },
-		{ "downtimehistory", "entry_time" },
-		{ "eventhandlers", "start_time" },
-		{ "externalcommands", "entry_time" },
-		{ "flappinghistory", "event_time" },
-		{ "hostchecks", "start_time" },
-		{ "logentries", "logentry_time" },
-		{ "notifications", "start_time" },
-		{ "processevents", "event_time" },
-		{ "statehistory", "state_time" },
-		{ "servicechecks", "start_time" },
-		{ "systemcommands", "start_time" }
-	};
-
-	for (auto& table : tables) {
-		double max_age = GetCleanup()->Get(table.name + "_age");
-
-		if (max_age == 0)
-			continue;
+	double now = Utility::GetTime();
+
+	String table, timeColumn;
+	double maxAge;
+	int limit;
+
+	{
+		boost::mutex::scoped_lock lock(m_CleanUpMutex);
+
+		if (now >= m_CleanUpNextRefresh) {
+			struct {
+				String name;
+				String time_column;
+			} tables[] = {
+				{ "acknowledgements", "entry_time" },
+				{ "commenthistory", "entry_time" },
+				{ "contactnotifications", "start_time" },
+				{ "contactnotificationmethods", "start_time" },
+				{ "downtimehistory", "entry_time" },
+				{ "eventhandlers", "start_time" },
+				{ "externalcommands", "entry_time" },
+				{ "flappinghistory", "event_time" },
+				{ "hostchecks", "start_time" },
+				{ "logentries", "logentry_time" },
+				{ "notifications", "start_time" },
+				{ "processevents", "event_time" },
+				{ "statehistory", "state_time" },
+				{ "servicechecks", "start_time" },
+				{ "systemcommands", "start_time" }
+			};
+
+			m_CleanUpTables.clear();
+
+			for (auto& table : tables) {
+				double max_age = GetCleanup()->Get(table.name + "_age");
+
+				if (max_age == 0)
+					continue;
+
+				auto cutoff = static_cast<long>(now) - max_age;
+
+				m_CleanUpTables.push_back({ table.name, table.time_column, cutoff, true });
+
+				Log(LogNotice, "DbConnection")
+					<< "Cleanup (" << table.name << "): " << max_age
+					<< " now: " << static_cast<long>(now)
+					<< " old: " << cutoff;
+			}
+
+			m_CleanUpNextRefresh = now + 60;
+		}
+
+		/* Chunks which got lost, e.g. because of a reconnect, must not block the cleanup forever. */
+		if (m_CleanUpQueryPending && now - m_CleanUpQueryStarted < 300)
+			return;
+
+		if (now < m_CleanUpNextQuery)
+			return;
+
+		size_t count = m_CleanUpTables.size();
+		size_t i;
+
+		for (i = 0; i < count; i++) {
+			if (m_CleanUpTables[(m_CleanUpIndex + i) % count].Pending)
+				break;
+		}
+
+		if (i == count) {
+			m_CleanUpQueryPending = false;
+			return;
+		}
 
-		CleanUpExecuteQuery(table.name, table.time_column, now - max_age);
-		Log(LogNotice, "DbConnection")
-			<< "Cleanup (" << table.name << "): " << max_age
-			<< " now: " << now
-			<< " old: " << now - max_age;
+		m_CleanUpIndex = (m_CleanUpIndex + i) % count;
+
+		const CleanUpTable& entry = m_CleanUpTables[m_CleanUpIndex];
+		table = entry.Name;
+		timeColumn = entry.TimeColumn;
+		maxAge = entry.MaxAge;
+		limit = GetCleanUpOption("chunk_rows", 10000);
+
+		m_CleanUpQueryPending = true;
+		m_CleanUpQueryStarted = now;
 	}
 
+	CleanUpExecuteQuery(table, timeColumn, maxAge, limit);
 }
 
-void DbConnection::CleanUpExecuteQuery(const String&, const String&, double)
+/**
+ * Called by the database backends after a cleanup chunk has been deleted.
+ *
+ * @param table The table name.
+ * @param limit The maximum number of rows the chunk could have deleted.
+ * @param deletedRows The number of rows which were actually deleted.
+ */
+void DbConnection::FinishCleanUpQuery(const String& table, int limit, int deletedRows)
+{
+	boost::mutex::scoped_lock lock(m_CleanUpMutex);
+
+	m_CleanUpQueryPending = false;
+
+	if (deletedRows > 0)
+		m_CleanUpDeletedRows += deletedRows;
+
+	/* The table is done until the next refresh once a chunk comes up short. */
+	if (deletedRows < limit) {
+		for (CleanUpTable& entry : m_CleanUpTables) {
+			if (entry.Name == table)
+				entry.Pending = false;
+		}
+	}
+
+	int rate = GetCleanUpOption("rows_per_second", 0);
+
+	if (rate > 0 && deletedRows > 0)
+		m_CleanUpNextQuery = Utility::GetTime() + static_cast<double>(deletedRows) / rate;
+}
+
+int DbConnection::GetCleanUpOption(const String& key, int defaultValue) const
+{
+	Value value = GetCleanup()->Get(key);
+
+	if (value.IsEmpty() || static_cast<int>(value) <= 0)
+		return defaultValue;
+
+	return value;
+}
+
+uint64_t DbConnection::GetCleanUpDeletedRows() const
+{
+	return m_CleanUpDeletedRows;
+}
+
+int DbConnection::GetCleanUpPendingTables() const
+{
+	boost::mutex::scoped_lock lock(m_CleanUpMutex);
+
+	int count = 0;
+
+	for (const CleanUpTable& entry : m_CleanUpTables) {
+		if (entry.Pending)
+			count++;
+	}
+
+	return count;
+}
+
+void DbConnection::CleanUpExecuteQuery(const String&, const String&, double, int)
 {
 	/* Default handler does nothing. */
 }
@@ -263,6 +378,8 @@ void DbConnection::SetConfigHash(const DbType::Ptr& type, const DbReference& obj
 	if (!objid.IsValid())
 		return;
 
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (!hash.IsEmpty())
 		m_ConfigHashes[std::make_pair(type, objid)] = hash;
 	else
@@ -279,6 +396,8 @@ String DbConnection::GetConfigHash(const DbType::Ptr& type, const DbReference& o
 	if (!objid.IsValid())
 		return String();
 
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	auto it = m_ConfigHashes.find(std::make_pair(type, objid));
 
 	if (it == m_ConfigHashes.end())
@@ -289,6 +408,8 @@ String DbConnection::GetConfigHash(const DbType::Ptr& type, const DbReference& o
 
 void DbConnection::SetObjectID(const DbObject::Ptr& dbobj, const DbReference& dbref)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (dbref.IsValid())
 		m_ObjectIDs[dbobj] = dbref;
 	else
@@ -297,6 +418,8 @@ void DbConnection::SetObjectID(const DbObject::Ptr& dbobj, const DbReference& db
 
 DbReference DbConnection::GetObjectID(const DbObject::Ptr& dbobj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	auto it = m_ObjectIDs.find(dbobj);
 
 	if (it == m_ObjectIDs.end())
@@ -315,6 +438,8 @@ void DbConnection::SetInsertID(const DbType::Ptr& type, const DbReference& objid
 	if (!objid.IsValid())
 		return;
 
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (dbref.IsValid())
 		m_InsertIDs[std::make_pair(type, objid)] = dbref;
 	else
@@ -331,6 +456,8 @@ DbReference DbConnection::GetInsertID(const DbType::Ptr& type, const DbReference
 	if (!objid.IsValid())
 		return {};
 
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	auto it = m_InsertIDs.find(std::make_pair(type, objid));
 
 	if (it == m_InsertIDs.end())
@@ -341,6 +468,8 @@ DbReference DbConnection::GetInsertID(const DbType::Ptr& type, const DbReference
 
 void DbConnection::SetObjectActive(const DbObject::Ptr& dbobj, bool active)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (active)
 		m_ActiveObjects.insert(dbobj);
 	else
@@ -349,6 +478,8 @@ void DbConnection::SetObjectActive(const DbObject::Ptr& dbobj, bool active)
 
 bool DbConnection::GetObjectActive(const DbObject::Ptr& dbobj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	return (m_ActiveObjects.find(dbobj) != m_ActiveObjects.end());
 }
 
@@ -356,6 +487,8 @@ void DbConnection::ClearIDCache()
 {
 	SetIDCacheValid(false);
 
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	m_ObjectIDs.clear();
 	m_InsertIDs.clear();
 	m_ActiveObjects.clear();
@@ -366,6 +499,8 @@ void DbConnection::ClearIDCache()
 
 void DbConnection::SetConfigUpdate(const DbObject::Ptr& dbobj, bool hasupdate)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (hasupdate)
 		m_ConfigUpdates.insert(dbobj);
 	else
@@ -374,11 +509,15 @@ void DbConnection::SetConfigUpdate(const DbObject::Ptr& dbobj, bool hasupdate)
 
 bool DbConnection::GetConfigUpdate(const DbObject::Ptr& dbobj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	return (m_ConfigUpdates.find(dbobj) != m_ConfigUpdates.end());
 }
 
 void DbConnection::SetStatusUpdate(const DbObject::Ptr& dbobj, bool hasupdate)
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	if (hasupdate)
 		m_StatusUpdates.insert(dbobj);
 	else
@@ -387,6 +526,8 @@ void DbConnection::SetStatusUpdate(const DbObject::Ptr& dbobj, bool hasupdate)
 
 bool DbConnection::GetStatusUpdate(const DbObject::Ptr& dbobj) const
 {
+	boost::mutex::scoped_lock lock(m_IDMutex);
+
 	return (m_StatusUpdates.find(dbobj) != m_StatusUpdates.end());
 }
 
@@ -429,6 +570,9 @@ void DbConnection::UpdateObject(const ConfigObject::Ptr& object)
 
 void DbConnection::UpdateAllObjects()
 {
+	std::vector<ConfigObject::Ptr> objects;
+	std::vector<DbObject::Ptr> inactiveDbObjs;
+
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
 
@@ -436,18 +580,217 @@ void DbConnection::UpdateAllObjects()
 			continue;
 
 		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
-			UpdateObject(object);
+			DbObject::Ptr dbobj = DbObject::GetOrCreateByObject(object);
+
+			if (!dbobj)
+				continue;
+
+			objects.push_back(object);
+
+			if (object->IsActive() && !GetObjectActive(dbobj))
+				inactiveDbObjs.push_back(dbobj);
 		}
 	}
+
+	m_ConfigDumpDone = 0;
+	m_ConfigDumpTotal = objects.size();
+
+	/* Register the objects with a few large queries instead of one query per object. */
+	if (!inactiveDbObjs.empty())
+		BulkActivateObjects(inactiveDbObjs);
+
+	for (const ConfigObject::Ptr& object : objects) {
+		UpdateObject(object);
+		m_ConfigDumpDone++;
+	}
+}
+
+/**
+ * Returns the progress of the config dump which is running after
+ * (re)connecting to the database.
+ *
+ * @returns The progress in percent.
+ */
+double DbConnection::GetConfigDumpProgress() const
+{
+	size_t total = m_ConfigDumpTotal;
+
+	if (total == 0)
+		return 100;
+
+	return 100.0 * m_ConfigDumpDone / total;
 }
 
-void DbConnection::PrepareDatabase()
+/**
+ * Activates multiple objects at once. Backends which don't implement this
+ * activate each object separately when it is updated.
+ *
+ * @param dbobjs The objects which have to be activated.
+ */
+void DbConnection::BulkActivateObjects(const std::vector<DbObject::Ptr>&)
 {
+	/* Default handler does nothing. */
+}
+
+/**
+ * Fills the ID cache, either from the file which was saved when the
+ * connection was closed last time or from the database.
+ *
+ * @param generation Identifies the state of the database, the saved cache
+ *                   is only used if it was saved with the same generation.
+ */
+void DbConnection::PrepareDatabase(const String& generation)
+{
+	if (!generation.IsEmpty() && LoadIDCache(generation))
+		return;
+
 	for (const DbType::Ptr& type : DbType::GetAllTypes()) {
 		FillIDCache(type);
 	}
 }
 
+String DbConnection::GetIDCachePath() const
+{
+	return Application::GetLocalStateDir() + "/cache/icinga2/ido-" + GetName() + ".cache";
+}
+
+bool DbConnection::LoadIDCache(const String& generation)
+{
+	String path = GetIDCachePath();
+
+	if (!Utility::PathExists(path))
+		return false;
+
+	try {
+		Dictionary::Ptr cache = Utility::LoadJsonFile(path);
+
+		if (cache->Get("generation") != generation) {
+			Log(LogNotice, "DbConnection")
+				<< "The database was modified since the ID cache '" << path << "' was saved, ignoring it.";
+			return false;
+		}
+
+		Dictionary::Ptr insertIDs = cache->Get("insert_ids");
+		Dictionary::Ptr configHashes = cache->Get("config_hashes");
+
+		ObjectLock olock(insertIDs);
+		for (const Dictionary::Pair& kv : insertIDs) {
+			DbType::Ptr type = DbType::GetByName(kv.first);
+
+			if (!type)
+				continue;
+
+			Array::Ptr ids = kv.second;
+			ObjectLock ilock(ids);
+
+			for (Array::SizeType i = 0; i + 1 < ids->GetLength(); i += 2)
+				SetInsertID(type, DbReference(ids->Get(i)), DbReference(ids->Get(i + 1)));
+		}
+
+		ObjectLock hlock(configHashes);
+		for (const Dictionary::Pair& kv : configHashes) {
+			DbType::Ptr type = DbType::GetByName(kv.first);
+
+			if (!type)
+				continue;
+
+			Array::Ptr hashes = kv.second;
+			ObjectLock ilock(hashes);
+
+			for (Array::SizeType i = 0; i + 1 < hashes->GetLength(); i += 2)
+				SetConfigHash(type, DbReference(hashes->Get(i)), hashes->Get(i + 1));
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "DbConnection")
+			<< "Could not load ID cache '" << path << "': " << DiagnosticInformation(ex, false);
+
+		ClearIDCache();
+		return false;
+	}
+
+	Log(LogInformation, "DbConnection")
+		<< "Loaded ID cache from '" << path << "'.";
+
+	return true;
+}
+
+/**
+ * Saves the ID cache so that the next connection can skip reading it
+ * from the database. Must only be called once all queries which update the
+ * cache have been committed.
+ *
+ * @param generation Identifies the state of the database.
+ */
+void DbConnection::SaveIDCache(const String& generation)
+{
+	if (generation.IsEmpty() || !IsIDCacheValid())
+		return;
+
+	Dictionary::Ptr insertIDs = new Dictionary();
+	Dictionary::Ptr configHashes = new Dictionary();
+
+	{
+		boost::mutex::scoped_lock lock(m_IDMutex);
+
+		for (const auto& kv : m_InsertIDs) {
+			String name = kv.first.first->GetName();
+			Array::Ptr ids = insertIDs->Get(name);
+
+			if (!ids) {
+				ids = new Array();
+				insertIDs->Set(name, ids);
+			}
+
+			ids->Add(static_cast<long>(kv.first.second));
+			ids->Add(static_cast<long>(kv.second));
+		}
+
+		for (const auto& kv : m_ConfigHashes) {
+			String name = kv.first.first->GetName();
+			Array::Ptr hashes = configHashes->Get(name);
+
+			if (!hashes) {
+				hashes = new Array();
+				configHashes->Set(name, hashes);
+			}
+
+			hashes->Add(static_cast<long>(kv.first.second));
+			hashes->Add(kv.second);
+		}
+	}
+
+	String path = GetIDCachePath();
+
+	try {
+		Utility::SaveJsonFile(path, 0600, new Dictionary({
+			{ "generation", generation },
+			{ "insert_ids", insertIDs },
+			{ "config_hashes", configHashes }
+		}));
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "DbConnection")
+			<< "Could not save ID cache '" << path << "': " << DiagnosticInformation(ex, false);
+	}
+}
+
+/**
+ * Keeps the cached config hash of an object in sync with its config row.
+ *
+ * @param query A query which is about to be executed.
+ */
+void DbConnection::UpdateConfigHash(const DbQuery& query)
+{
+	if (!query.ConfigUpdate || !query.Object || !query.Fields)
+		return;
+
+	Value hash = query.Fields->Get("config_hash");
+
+	if (hash.IsEmpty())
+		return;
+
+	SetConfigHash(query.Object, hash);
+}
+
 void DbConnection::ValidateFailoverTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<DbConnection>::ValidateFailoverTimeout(lvalue, utils);
@@ -456,6 +799,14 @@ void DbConnection::ValidateFailoverTimeout(const Lazy<double>& lvalue, const Val
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "failover_timeout" }, "Failover timeout minimum is 60s."));
 }
 
+void DbConnection::ValidateSessions(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<DbConnection>::ValidateSessions(lvalue, utils);
+
+	if (lvalue() < 1 || lvalue() > 32)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "sessions" }, "Value must be between 1 and 32."));
+}
+
 void DbConnection::ValidateCategories(const Lazy<Array::Ptr>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<DbConnection>::ValidateCategories(lvalue, utils);
@@ -471,16 +822,221 @@ void DbConnection::ValidateCategories(const Lazy<Array::Ptr>& lvalue, const Vali
 
 void DbConnection::IncreaseQueryCount()
 {
-	double now = Utility::GetTime();
+	m_QueryStats.InsertValue(Utility::GetCoarseTime(), 1);
+}
 
-	boost::mutex::scoped_lock lock(m_StatsMutex);
-	m_QueryStats.InsertValue(now, 1);
+int DbConnection::GetQueryCount(ShardedRingBuffer::SizeType span)
+{
+	return m_QueryStats.UpdateAndGetValues(Utility::GetCoarseTime(), span);
 }
 
-int DbConnection::GetQueryCount(RingBuffer::SizeType span)
+/**
+ * Records the execution of a query.
+ *
+ * @param table The table name (without the prefix).
+ * @param type The query type.
+ * @param latency The time the database took to execute the query.
+ * @param rows The number of affected rows.
+ */
+void DbConnection::RecordQueryStats(const String& table, int type, double latency, int rows)
 {
-	boost::mutex::scoped_lock lock(m_StatsMutex);
-	return m_QueryStats.UpdateAndGetValues(Utility::GetTime(), span);
+	if (table.IsEmpty())
+		return;
+
+	String key = table;
+
+	if ((type & DbQueryInsert) && (type & DbQueryUpdate))
+		key += "_upsert";
+	else if (type & DbQueryInsert)
+		key += "_insert";
+	else if (type & DbQueryUpdate)
+		key += "_update";
+	else if (type & DbQueryDelete)
+		key += "_delete";
+
+	DbQueryStats *stats;
+
+	{
+		boost::mutex::scoped_lock lock(m_QueryTypeStatsMutex);
+
+		std::unique_ptr<DbQueryStats>& entry = m_QueryTypeStats[key];
+
+		if (!entry)
+			entry.reset(new DbQueryStats());
+
+		stats = entry.get();
+	}
+
+	stats->Latency.Record(latency);
+	stats->Queries++;
+
+	if (rows > 0)
+		stats->Rows += rows;
+}
+
+/**
+ * Records how long a query has been waiting in the work queue.
+ *
+ * @param enqueueTime The time at which the query was enqueued.
+ */
+void DbConnection::RecordQueueWait(double enqueueTime)
+{
+	m_QueueWait.Record(Utility::GetTime() - enqueueTime);
+}
+
+const Histogram& DbConnection::GetQueueWaitHistogram() const
+{
+	return m_QueueWait;
+}
+
+/**
+ * Returns the latency and row statistics for each table and query type
+ * as well as the time the queries spend waiting in the work queue.
+ */
+Dictionary::Ptr DbConnection::GetQueryStats() const
+{
+	Dictionary::Ptr queries = new Dictionary();
+
+	{
+		boost::mutex::scoped_lock lock(m_QueryTypeStatsMutex);
+
+		for (const auto& kv : m_QueryTypeStats) {
+			queries->Set(kv.first, new Dictionary({
+				{ "count", kv.second->Queries.load() },
+				{ "rows", kv.second->Rows.load() },
+				{ "latency", CIB::GetHistogramStats(kv.second->Latency) }
+			}));
+		}
+	}
+
+	return new Dictionary({
+		{ "queue_wait", CIB::GetHistogramStats(m_QueueWait) },
+		{ "queries", queries }
+	});
+}
+
+/**
+ * Merges a status update into the update which is already queued for the
+ * same table and object, if there is one. Fields which are set by both
+ * queries take the value from the newer query.
+ *
+ * @param query The status update.
+ * @returns The query which has to be queued, or nullptr if the update was
+ *          merged into a pending query.
+ */
+std::shared_ptr<DbQuery> DbConnection::CoalesceStatusUpdate(const DbQuery& query)
+{
+	std::pair<DbObject *, String> key(query.Object.get(), query.Table);
+
+	boost::mutex::scoped_lock lock(m_PendingStatusUpdatesMutex);
+
+	auto it = m_PendingStatusUpdates.find(key);
+
+	if (it != m_PendingStatusUpdates.end()) {
+		DbQuery& pending = *it->second;
+
+		if (pending.Category == query.Category) {
+			Dictionary::Ptr fields = pending.Fields ? pending.Fields->ShallowClone() : new Dictionary();
+
+			if (query.Fields)
+				query.Fields->CopyTo(fields);
+
+			pending.Fields = fields;
+			pending.Type |= query.Type;
+			pending.WhereCriteria = query.WhereCriteria;
+
+			m_CoalescedStatusUpdates++;
+
+			return nullptr;
+		}
+	}
+
+	auto pending = std::make_shared<DbQuery>(query);
+	m_PendingStatusUpdates[key] = pending;
+
+	return pending;
+}
+
+/**
+ * Removes a pending status update from the coalescing map before
+ * it is executed.
+ *
+ * @param pending The query which was returned by CoalesceStatusUpdate().
+ * @returns The query including all updates which were merged into it.
+ */
+DbQuery DbConnection::TakeStatusUpdate(const std::shared_ptr<DbQuery>& pending)
+{
+	boost::mutex::scoped_lock lock(m_PendingStatusUpdatesMutex);
+
+	auto it = m_PendingStatusUpdates.find(std::make_pair(pending->Object.get(), pending->Table));
+
+	if (it != m_PendingStatusUpdates.end() && it->second == pending)
+		m_PendingStatusUpdates.erase(it);
+
+	return *pending;
+}
+
+/**
+ * Prevents later status updates from being merged into a query which is
+ * queued before the specified query, i.e. the queued query keeps its
+ * values and newer updates are queued after the specified query.
+ *
+ * @param query The query which is about to be queued.
+ */
+void DbConnection::SealStatusUpdate(const DbQuery& query)
+{
+	if (!query.Object)
+		return;
+
+	boost::mutex::scoped_lock lock(m_PendingStatusUpdatesMutex);
+
+	if (m_PendingStatusUpdates.empty())
+		return;
+
+	m_PendingStatusUpdates.erase(std::make_pair(query.Object.get(), query.Table));
+}
+
+uint64_t DbConnection::GetCoalescedStatusUpdates() const
+{
+	return m_CoalescedStatusUpdates.load();
+}
+
+/**
+ * Returns the index of the database session which executes the specified
+ * query. Queries for the same object always use the same session so that
+ * their order is kept. Queries which aren't bound to an object, update the
+ * ID cache or provide an insert ID for other queries use the primary
+ * session (0).
+ *
+ * @param query The query.
+ * @returns The session index.
+ */
+int DbConnection::GetQuerySession(const DbQuery& query) const
+{
+	int sessions = GetSessions();
+
+	if (sessions <= 1 || !query.Object || query.ConfigUpdate || query.NotificationInsertID)
+		return 0;
+
+	auto hash = reinterpret_cast<uintptr_t>(query.Object.get()) / sizeof(void *);
+	hash ^= hash >> 16;
+
+	return hash % sessions;
+}
+
+int DbConnection::GetQuerySession(const std::vector<DbQuery>& queries) const
+{
+	if (queries.empty())
+		return 0;
+
+	int session = GetQuerySession(queries[0]);
+
+	for (const DbQuery& query : queries) {
+		if (GetQuerySession(query) != session)
+			return 0;
+	}
+
+	return session;
 }
 
 bool DbConnection::IsIDCacheValid() const
@@ -25,9 +25,11 @@
 #include "db_ido/dbobject.hpp"
 #include "db_ido/dbquery.hpp"
 #include "base/timer.hpp"
-#include "base/ringbuffer.hpp"
+#include "base/shardedringbuffer.hpp"
+#include "base/histogram.hpp"
 #include <boost/thread/once.hpp>
 #include <boost/thread/mutex.hpp>
+#include <atomic>
 
 #define IDO_CURRENT_SCHEMA_VERSION "1.14.3"
 #define IDO_COMPAT_SCHEMA_VERSION "1.14.3"
@@ -35,6 +37,19 @@
 namespace icinga
 {
 
+/**
+ * Execution statistics for one kind of query, e.g. updates of the
+ * hoststatus table.
+ *
+ * @ingroup db_ido
+ */
+struct DbQueryStats
+{
+	Histogram Latency;
+	std::atomic<uint64_t> Queries{0};
+	std::atomic<uint64_t> Rows{0};
+};
+
 /**
  * A database connection.
  *
@@ -71,10 +86,14 @@ public:
 	void SetStatusUpdate(const DbObject::Ptr& dbobj, bool hasupdate);
 	bool GetStatusUpdate(const DbObject::Ptr& dbobj) const;
 
-	int GetQueryCount(RingBuffer::SizeType span);
+	int GetQueryCount(ShardedRingBuffer::SizeType span);
 	virtual int GetPendingQueryCount() const = 0;
 
+	Dictionary::Ptr GetQueryStats() const;
+	const Histogram& GetQueueWaitHistogram() const;
+
 	void ValidateFailoverTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils) final;
+	void ValidateSessions(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
 	void ValidateCategories(const Lazy<Array::Ptr>& lvalue, const ValidationUtils& utils) final;
 
 protected:
@@ -89,16 +108,33 @@ protected:
 	virtual void ActivateObject(const DbObject::Ptr& dbobj) = 0;
 	virtual void DeactivateObject(const DbObject::Ptr& dbobj) = 0;
 
-	virtual void CleanUpExecuteQuery(const String& table, const String& time_column, double max_age);
+	virtual void CleanUpExecuteQuery(const String& table, const String& time_column, double max_age, int limit);
+	void FinishCleanUpQuery(const String& table, int limit, int deletedRows);
+	uint64_t GetCleanUpDeletedRows() const;
+	int GetCleanUpPendingTables() const;
 	virtual void FillIDCache(const DbType::Ptr& type) = 0;
+	virtual void BulkActivateObjects(const std::vector<DbObject::Ptr>& dbobjs);
 	virtual void NewTransaction() = 0;
 
 	void UpdateObject(const ConfigObject::Ptr& object);
 	void UpdateAllObjects();
+	double GetConfigDumpProgress() const;
 
-	void PrepareDatabase();
+	void PrepareDatabase(const String& generation = String());
+	void SaveIDCache(const String& generation);
+	void UpdateConfigHash(const DbQuery& query);
 
 	void IncreaseQueryCount();
+	void RecordQueryStats(const String& table, int type, double latency, int rows);
+	void RecordQueueWait(double enqueueTime);
+
+	std::shared_ptr<DbQuery> CoalesceStatusUpdate(const DbQuery& query);
+	DbQuery TakeStatusUpdate(const std::shared_ptr<DbQuery>& pending);
+	void SealStatusUpdate(const DbQuery& query);
+	uint64_t GetCoalescedStatusUpdates() const;
+
+	int GetQuerySession(const DbQuery& query) const;
+	int GetQuerySession(const std::vector<DbQuery>& queries) const;
 
 	bool IsIDCacheValid() const;
 	void SetIDCacheValid(bool valid);
@@ -110,7 +146,9 @@ protected:
 	static int GetSessionToken();
 
 private:
-	bool m_IDCacheValid{false};
+	std::atomic<bool> m_IDCacheValid{false};
+
+	mutable boost::mutex m_IDMutex;
 	std::map<std::pair<DbType::Ptr, DbReference>, String> m_ConfigHashes;
 	std::map<DbObject::Ptr, DbReference> m_ObjectIDs;
 	std::map<std::pair<DbType::Ptr, DbReference>, DbReference> m_InsertIDs;
@@ -119,16 +157,47 @@ private:
 	std::set<DbObject::Ptr> m_StatusUpdates;
 	Timer::Ptr m_CleanUpTimer;
 
+	struct CleanUpTable
+	{
+		String Name;
+		String TimeColumn;
+		double MaxAge;
+		bool Pending;
+	};
+
+	mutable boost::mutex m_CleanUpMutex;
+	std::vector<CleanUpTable> m_CleanUpTables;
+	size_t m_CleanUpIndex{0};
+	double m_CleanUpNextRefresh{0};
+	double m_CleanUpNextQuery{0};
+	double m_CleanUpQueryStarted{0};
+	bool m_CleanUpQueryPending{false};
+	std::atomic<uint64_t> m_CleanUpDeletedRows{0};
+
 	void CleanUpHandler();
+	int GetCleanUpOption(const String& key, int defaultValue) const;
+
+	bool LoadIDCache(const String& generation);
+	String GetIDCachePath() const;
 
 	static Timer::Ptr m_ProgramStatusTimer;
 	static boost::once_flag m_OnceFlag;
 
 	static void InsertRuntimeVariable(const String& key, const Value& value);
 
-	mutable boost::mutex m_StatsMutex;
-	RingBuffer m_QueryStats{15 * 60};
+	ShardedRingBuffer m_QueryStats{15 * 60};
+
+	mutable boost::mutex m_QueryTypeStatsMutex;
+	std::map<String, std::unique_ptr<DbQueryStats> > m_QueryTypeStats;
+	Histogram m_QueueWait;
 	bool m_ActiveChangedHandler{false};
+
+	boost::mutex m_PendingStatusUpdatesMutex;
+	std::map<std::pair<DbObject *, String>, std::shared_ptr<DbQuery> > m_PendingStatusUpdates;
+	std::atomic<uint64_t> m_CoalescedStatusUpdates{0};
+
+	std::atomic<size_t> m_ConfigDumpTotal{0};
+	std::atomic<size_t> m_ConfigDumpDone{0};
 };
 
 struct database_error : virtual std::exception, virtual boost::exception { };
@@ -40,6 +40,71 @@ using namespace icinga;
 
 INITIALIZE_ONCE(&DbEvents::StaticInitialize);
 
+/* History rows always have the same columns. The values are passed in this order. */
+static const DbQueryTemplate l_NotificationsTemplate("notifications", DbCatNotification, {
+	"notification_type", "notification_reason", "object_id", "start_time", "start_time_usec",
+	"end_time", "end_time_usec", "state", "output", "long_output", "escalated",
+	"contacts_notified", "instance_id", "endpoint_object_id"
+});
+
+static const DbQueryTemplate l_ContactNotificationsTemplate("contactnotifications", DbCatNotification, {
+	"contact_object_id", "start_time", "start_time_usec", "end_time", "end_time_usec",
+	"notification_id", "instance_id"
+});
+
+static const DbQueryTemplate l_StateHistoryTemplate("statehistory", DbCatStateHistory, {
+	"state_time", "state_time_usec", "object_id", "state_change", "state_type",
+	"current_check_attempt", "max_check_attempts", "state", "last_state", "last_hard_state",
+	"output", "long_output", "check_source", "instance_id", "endpoint_object_id"
+});
+
+static const DbQueryTemplate l_LogEntriesTemplate("logentries", DbCatLog, {
+	"logentry_time", "entry_time", "entry_time_usec", "object_id", "logentry_type",
+	"logentry_data", "instance_id", "endpoint_object_id"
+});
+
+static const DbQueryTemplate l_FlappingHistoryTemplate("flappinghistory", DbCatFlapping, {
+	"event_time", "event_time_usec", "event_type", "reason_type", "flapping_type", "object_id",
+	"percent_state_change", "low_threshold", "high_threshold", "instance_id", "endpoint_object_id"
+});
+
+static const DbQueryTemplate l_HostChecksTemplate("hostchecks", DbCatCheck, {
+	"check_type", "current_check_attempt", "max_check_attempts", "state_type", "start_time",
+	"start_time_usec", "end_time", "end_time_usec", "command_object_id", "execution_time",
+	"latency", "return_code", "perfdata", "output", "long_output", "command_line",
+	"instance_id", "host_object_id", "state", "endpoint_object_id"
+});
+
+static const DbQueryTemplate l_ServiceChecksTemplate("servicechecks", DbCatCheck, {
+	"check_type", "current_check_attempt", "max_check_attempts", "state_type", "start_time",
+	"start_time_usec", "end_time", "end_time_usec", "command_object_id", "execution_time",
+	"latency", "return_code", "perfdata", "output", "long_output", "command_line",
+	"instance_id", "service_object_id", "state", "endpoint_object_id"
+});
+
+static const DbQueryTemplate l_EventHandlersTemplate("eventhandlers", DbCatEventHandler, {
+	"object_id", "state_type", "command_object_id", "instance_id", "state", "eventhandler_type",
+	"start_time", "start_time_usec", "end_time", "end_time_usec", "endpoint_object_id"
+});
+
+static const DbQueryTemplate l_ExternalCommandsTemplate("externalcommands", DbCatExternalCommand, {
+	"entry_time", "command_type", "command_name", "command_args", "instance_id", "endpoint_object_id"
+});
+
+/**
+ * Returns the local endpoint for the endpoint_object_id column, or an empty
+ * value which leaves the column out.
+ */
+static Value GetEndpointObject()
+{
+	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
+
+	if (endpoint)
+		return endpoint;
+
+	return Empty;
+}
+
 void DbEvents::StaticInitialize()
 {
 	/* Status */
@@ -61,7 +126,7 @@ void DbEvents::StaticInitialize()
 	Checkable::OnEnablePerfdataChanged.connect(std::bind(&DbEvents::EnablePerfdataChangedHandler, _1));
 	Checkable::OnEnableFlappingChanged.connect(std::bind(&DbEvents::EnableFlappingChangedHandler, _1));
 
-	Checkable::OnReachabilityChanged.connect(std::bind(&DbEvents::ReachabilityChangedHandler, _1, _2, _3));
+	Checkable::OnReachabilityChanged.connect(std::bind(&DbEvents::ReachabilityChangedHandler, _1, _2, _3), "DbEvents::ReachabilityChangedHandler");
 
 	/* History */
 	Comment::OnCommentAdded.connect(std::bind(&DbEvents::AddCommentHistory, _1));
@@ -70,9 +135,9 @@ void DbEvents::StaticInitialize()
 
 	Checkable::OnNotificationSentToAllUsers.connect(std::bind(&DbEvents::AddNotificationHistory, _1, _2, _3, _4, _5, _6, _7));
 
-	Checkable::OnStateChange.connect(std::bind(&DbEvents::AddStateChangeHistory, _1, _2, _3));
+	Checkable::OnStateChange.connect(std::bind(&DbEvents::AddStateChangeHistory, _1, _2, _3), "DbEvents::AddStateChangeHistory");
 
-	Checkable::OnNewCheckResult.connect(std::bind(&DbEvents::AddCheckResultLogHistory, _1, _2));
+	Checkable::OnNewCheckResult.connect(std::bind(&DbEvents::AddCheckResultLogHistory, _1, _2), "DbEvents::AddCheckResultLogHistory");
 	Checkable::OnNotificationSentToUser.connect(std::bind(&DbEvents::AddNotificationSentLogHistory, _1, _2, _3, _4, _5, _6, _7));
 	Checkable::OnFlappingChanged.connect(std::bind(&DbEvents::AddFlappingChangedLogHistory, _1));
 	Checkable::OnEnableFlappingChanged.connect(std::bind(&DbEvents::AddEnableFlappingChangedLogHistory, _1));
@@ -81,7 +146,7 @@ void DbEvents::StaticInitialize()
 
 	Checkable::OnFlappingChanged.connect(std::bind(&DbEvents::AddFlappingChangedHistory, _1));
 	Checkable::OnEnableFlappingChanged.connect(std::bind(&DbEvents::AddEnableFlappingChangedHistory, _1));
-	Checkable::OnNewCheckResult.connect(std::bind(&DbEvents::AddCheckableCheckHistory, _1, _2));
+	Checkable::OnNewCheckResult.connect(std::bind(&DbEvents::AddCheckableCheckHistory, _1, _2), "DbEvents::AddCheckableCheckHistory");
 
 	Checkable::OnEventCommandExecuted.connect(std::bind(&DbEvents::AddEventHandlerHistory, _1));
 
@@ -190,7 +255,7 @@ void DbEvents::LastNotificationChangedHandler(const Notification::Ptr& notificat
 	DbObject::OnQuery(query1);
 }
 
-void DbEvents::ReachabilityChangedHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, std::set<Checkable::Ptr> children)
+void DbEvents::ReachabilityChangedHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const std::set<Checkable::Ptr>& children)
 {
 	int is_reachable = 0;
 
@@ -831,45 +896,29 @@ void DbEvents::AddNotificationHistory(const Notification::Ptr& notification, con
 	/* start and end happen at the same time */
 	std::pair<unsigned long, unsigned long> timeBag = ConvertTimestamp(Utility::GetTime());
 
-	DbQuery query1;
-	query1.Table = "notifications";
-	query1.Type = DbQueryInsert;
-	query1.Category = DbCatNotification;
-	query1.NotificationInsertID = new DbValue(DbValueObjectInsertID, -1);
-
 	Host::Ptr host;
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
-	Dictionary::Ptr fields1 = new Dictionary();
-	fields1->Set("notification_type", 1); /* service */
-	fields1->Set("notification_reason", MapNotificationReasonType(type));
-	fields1->Set("object_id", checkable);
-	fields1->Set("start_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("start_time_usec", timeBag.second);
-	fields1->Set("end_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("end_time_usec", timeBag.second);
-
-	if (service)
-		fields1->Set("state", service->GetState());
-	else
-		fields1->Set("state", GetHostState(host));
-
-	if (cr) {
-		fields1->Set("output", CompatUtility::GetCheckResultOutput(cr));
-		fields1->Set("long_output", CompatUtility::GetCheckResultLongOutput(cr));
-	}
-
-	fields1->Set("escalated", 0);
-	fields1->Set("contacts_notified", static_cast<long>(users.size()));
-	fields1->Set("instance_id", 0); /* DbConnection class fills in real ID */
-
-	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
+	DbQuery query1 = l_NotificationsTemplate.NewQuery({
+		1, /* notification_type: service */
+		MapNotificationReasonType(type),
+		checkable,
+		DbValue::FromTimestamp(timeBag.first),
+		timeBag.second,
+		DbValue::FromTimestamp(timeBag.first),
+		timeBag.second,
+		service ? service->GetState() : GetHostState(host),
+		cr ? Value(CompatUtility::GetCheckResultOutput(cr)) : Empty,
+		cr ? Value(CompatUtility::GetCheckResultLongOutput(cr)) : Empty,
+		0, /* escalated */
+		static_cast<long>(users.size()),
+		0, /* instance_id: DbConnection class fills in real ID */
+		GetEndpointObject()
+	});
 
-	if (endpoint)
-		fields1->Set("endpoint_object_id", endpoint);
+	query1.NotificationInsertID = new DbValue(DbValueObjectInsertID, -1);
 
-	query1.Fields = fields1;
 	DbObject::OnQuery(query1);
 
 	std::vector<DbQuery> queries;
@@ -878,22 +927,15 @@ void DbEvents::AddNotificationHistory(const Notification::Ptr& notification, con
 		Log(LogDebug, "DbEvents")
 			<< "add contact notification history for service '" << checkable->GetName() << "' and user '" << user->GetName() << "'.";
 
-		DbQuery query2;
-		query2.Table = "contactnotifications";
-		query2.Type = DbQueryInsert;
-		query2.Category = DbCatNotification;
-
-		query2.Fields = new Dictionary({
-			{ "contact_object_id", user },
-			{ "start_time", DbValue::FromTimestamp(timeBag.first) },
-			{ "start_time_usec", timeBag.second },
-			{ "end_time", DbValue::FromTimestamp(timeBag.first) },
-			{ "end_time_usec", timeBag.second },
-			{ "notification_id", query1.NotificationInsertID },
-			{ "instance_id", 0 } /* DbConnection class fills in real ID */
-		});
-
-		queries.emplace_back(std::move(query2));
+		queries.emplace_back(l_ContactNotificationsTemplate.NewQuery({
+			user,
+			DbValue::FromTimestamp(timeBag.first),
+			timeBag.second,
+			DbValue::FromTimestamp(timeBag.first),
+			timeBag.second,
+			query1.NotificationInsertID,
+			0 /* instance_id: DbConnection class fills in real ID */
+		}));
 	}
 
 	DbObject::OnMultipleQueries(queries);
@@ -908,49 +950,27 @@ void DbEvents::AddStateChangeHistory(const Checkable::Ptr& checkable, const Chec
 	double ts = cr->GetExecutionEnd();
 	std::pair<unsigned long, unsigned long> timeBag = ConvertTimestamp(ts);
 
-	DbQuery query1;
-	query1.Table = "statehistory";
-	query1.Type = DbQueryInsert;
-	query1.Category = DbCatStateHistory;
-
 	Host::Ptr host;
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
-	Dictionary::Ptr fields1 = new Dictionary();
-	fields1->Set("state_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("state_time_usec", timeBag.second);
-	fields1->Set("object_id", checkable);
-	fields1->Set("state_change", 1); /* service */
-	fields1->Set("state_type", checkable->GetStateType());
-	fields1->Set("current_check_attempt", checkable->GetCheckAttempt());
-	fields1->Set("max_check_attempts", checkable->GetMaxCheckAttempts());
-
-	if (service) {
-		fields1->Set("state", service->GetState());
-		fields1->Set("last_state", service->GetLastState());
-		fields1->Set("last_hard_state", service->GetLastHardState());
-	} else {
-		fields1->Set("state", GetHostState(host));
-		fields1->Set("last_state", host->GetLastState());
-		fields1->Set("last_hard_state", host->GetLastHardState());
-	}
-
-	if (cr) {
-		fields1->Set("output", CompatUtility::GetCheckResultOutput(cr));
-		fields1->Set("long_output", CompatUtility::GetCheckResultLongOutput(cr));
-		fields1->Set("check_source", cr->GetCheckSource());
-	}
-
-	fields1->Set("instance_id", 0); /* DbConnection class fills in real ID */
-
-	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
-
-	if (endpoint)
-		fields1->Set("endpoint_object_id", endpoint);
-
-	query1.Fields = fields1;
-	DbObject::OnQuery(query1);
+	DbObject::OnQuery(l_StateHistoryTemplate.NewQuery({
+		DbValue::FromTimestamp(timeBag.first),
+		timeBag.second,
+		checkable,
+		1, /* state_change */
+		checkable->GetStateType(),
+		checkable->GetCheckAttempt(),
+		checkable->GetMaxCheckAttempts(),
+		service ? service->GetState() : GetHostState(host),
+		service ? Value(service->GetLastState()) : Value(host->GetLastState()),
+		service ? Value(service->GetLastHardState()) : Value(host->GetLastHardState()),
+		cr ? Value(CompatUtility::GetCheckResultOutput(cr)) : Empty,
+		cr ? Value(CompatUtility::GetCheckResultLongOutput(cr)) : Empty,
+		cr ? Value(cr->GetCheckSource()) : Empty,
+		0, /* instance_id: DbConnection class fills in real ID */
+		GetEndpointObject()
+	}));
 }
 
 /* logentries */
@@ -1232,29 +1252,16 @@ void DbEvents::AddLogHistory(const Checkable::Ptr& checkable, const String& buff
 
 	std::pair<unsigned long, unsigned long> timeBag = ConvertTimestamp(Utility::GetTime());
 
-	DbQuery query1;
-	query1.Table = "logentries";
-	query1.Type = DbQueryInsert;
-	query1.Category = DbCatLog;
-
-	Dictionary::Ptr fields1 = new Dictionary();
-
-	fields1->Set("logentry_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("entry_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("entry_time_usec", timeBag.second);
-	fields1->Set("object_id", checkable);
-	fields1->Set("logentry_type", type);
-	fields1->Set("logentry_data", buffer);
-
-	fields1->Set("instance_id", 0); /* DbConnection class fills in real ID */
-
-	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
-
-	if (endpoint)
-		fields1->Set("endpoint_object_id", endpoint);
-
-	query1.Fields = fields1;
-	DbObject::OnQuery(query1);
+	DbObject::OnQuery(l_LogEntriesTemplate.NewQuery({
+		DbValue::FromTimestamp(timeBag.first),
+		DbValue::FromTimestamp(timeBag.first),
+		timeBag.second,
+		checkable,
+		type,
+		buffer,
+		0, /* instance_id: DbConnection class fills in real ID */
+		GetEndpointObject()
+	}));
 }
 
 /* flappinghistory */
@@ -1265,42 +1272,25 @@ void DbEvents::AddFlappingChangedHistory(const Checkable::Ptr& checkable)
 
 	std::pair<unsigned long, unsigned long> timeBag = ConvertTimestamp(Utility::GetTime());
 
-	DbQuery query1;
-	query1.Table = "flappinghistory";
-	query1.Type = DbQueryInsert;
-	query1.Category = DbCatFlapping;
-
-	Dictionary::Ptr fields1 = new Dictionary();
-
-	fields1->Set("event_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("event_time_usec", timeBag.second);
-
-	if (checkable->IsFlapping())
-		fields1->Set("event_type", 1000);
-	else {
-		fields1->Set("event_type", 1001);
-		fields1->Set("reason_type", 1);
-	}
+	bool flapping = checkable->IsFlapping();
 
 	Host::Ptr host;
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
-	fields1->Set("flapping_type", service ? 1 : 0);
-	fields1->Set("object_id", checkable);
-	fields1->Set("percent_state_change", checkable->GetFlappingCurrent());
-	fields1->Set("low_threshold", checkable->GetFlappingThresholdLow());
-	fields1->Set("high_threshold", checkable->GetFlappingThresholdHigh());
-
-	fields1->Set("instance_id", 0); /* DbConnection class fills in real ID */
-
-	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
-
-	if (endpoint)
-		fields1->Set("endpoint_object_id", endpoint);
-
-	query1.Fields = fields1;
-	DbObject::OnQuery(query1);
+	DbObject::OnQuery(l_FlappingHistoryTemplate.NewQuery({
+		DbValue::FromTimestamp(timeBag.first),
+		timeBag.second,
+		flapping ? 1000 : 1001, /* event_type */
+		flapping ? Empty : Value(1), /* reason_type */
+		service ? 1 : 0, /* flapping_type */
+		checkable,
+		checkable->GetFlappingCurrent(),
+		checkable->GetFlappingThresholdLow(),
+		checkable->GetFlappingThresholdHigh(),
+		0, /* instance_id: DbConnection class fills in real ID */
+		GetEndpointObject()
+	}));
 }
 
 void DbEvents::AddEnableFlappingChangedHistory(const Checkable::Ptr& checkable)
@@ -1313,37 +1303,23 @@ void DbEvents::AddEnableFlappingChangedHistory(const Checkable::Ptr& checkable)
 
 	std::pair<unsigned long, unsigned long> timeBag = ConvertTimestamp(Utility::GetTime());
 
-	DbQuery query1;
-	query1.Table = "flappinghistory";
-	query1.Type = DbQueryInsert;
-	query1.Category = DbCatFlapping;
-
-	Dictionary::Ptr fields1 = new Dictionary();
-
-	fields1->Set("event_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("event_time_usec", timeBag.second);
-
-	fields1->Set("event_type", 1001);
-	fields1->Set("reason_type", 2);
-
 	Host::Ptr host;
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
-	fields1->Set("flapping_type", service ? 1 : 0);
-	fields1->Set("object_id", checkable);
-	fields1->Set("percent_state_change", checkable->GetFlappingCurrent());
-	fields1->Set("low_threshold", checkable->GetFlappingThresholdLow());
-	fields1->Set("high_threshold", checkable->GetFlappingThresholdHigh());
-	fields1->Set("instance_id", 0); /* DbConnection class fills in real ID */
-
-	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
-
-	if (endpoint)
-		fields1->Set("endpoint_object_id", endpoint);
-
-	query1.Fields = fields1;
-	DbObject::OnQuery(query1);
+	DbObject::OnQuery(l_FlappingHistoryTemplate.NewQuery({
+		DbValue::FromTimestamp(timeBag.first),
+		timeBag.second,
+		1001, /* event_type */
+		2, /* reason_type */
+		service ? 1 : 0, /* flapping_type */
+		checkable,
+		checkable->GetFlappingCurrent(),
+		checkable->GetFlappingThresholdLow(),
+		checkable->GetFlappingThresholdHigh(),
+		0, /* instance_id: DbConnection class fills in real ID */
+		GetEndpointObject()
+	}));
 }
 
 /* servicechecks */
@@ -1359,54 +1335,34 @@ void DbEvents::AddCheckableCheckHistory(const Checkable::Ptr& checkable, const C
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
-	DbQuery query1;
-	query1.Table = service ? "servicechecks" : "hostchecks";
-	query1.Type = DbQueryInsert;
-	query1.Category = DbCatCheck;
-
-	Dictionary::Ptr fields1 = new Dictionary();
-	fields1->Set("check_type", !checkable->GetEnableActiveChecks()); /* 0 .. active, 1 .. passive */
-	fields1->Set("current_check_attempt", checkable->GetCheckAttempt());
-	fields1->Set("max_check_attempts", checkable->GetMaxCheckAttempts());
-	fields1->Set("state_type", checkable->GetStateType());
-
-	double start = cr->GetExecutionStart();
-	double end = cr->GetExecutionEnd();
-	double executionTime = cr->CalculateExecutionTime();
-
-	std::pair<unsigned long, unsigned long> timeBagStart = ConvertTimestamp(start);
-	std::pair<unsigned long, unsigned long> timeBagEnd = ConvertTimestamp(end);
-
-	fields1->Set("start_time", DbValue::FromTimestamp(timeBagStart.first));
-	fields1->Set("start_time_usec", timeBagStart.second);
-	fields1->Set("end_time", DbValue::FromTimestamp(timeBagEnd.first));
-	fields1->Set("end_time_usec", timeBagEnd.second);
-	fields1->Set("command_object_id", checkable->GetCheckCommand());
-	fields1->Set("execution_time", executionTime);
-	fields1->Set("latency", cr->CalculateLatency());
-	fields1->Set("return_code", cr->GetExitStatus());
-	fields1->Set("perfdata", PluginUtility::FormatPerfdata(cr->GetPerformanceData()));
-
-	fields1->Set("output", CompatUtility::GetCheckResultOutput(cr));
-	fields1->Set("long_output", CompatUtility::GetCheckResultLongOutput(cr));
-	fields1->Set("command_line", CompatUtility::GetCommandLine(checkable->GetCheckCommand()));
-	fields1->Set("instance_id", 0); /* DbConnection class fills in real ID */
-
-	if (service) {
-		fields1->Set("service_object_id", service);
-		fields1->Set("state", service->GetState());
-	} else {
-		fields1->Set("host_object_id", host);
-		fields1->Set("state", GetHostState(host));
-	}
-
-	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
-
-	if (endpoint)
-		fields1->Set("endpoint_object_id", endpoint);
-
-	query1.Fields = fields1;
-	DbObject::OnQuery(query1);
+	std::pair<unsigned long, unsigned long> timeBagStart = ConvertTimestamp(cr->GetExecutionStart());
+	std::pair<unsigned long, unsigned long> timeBagEnd = ConvertTimestamp(cr->GetExecutionEnd());
+
+	/* The host and service tables only differ in the object ID column. */
+	const DbQueryTemplate& queryTemplate = service ? l_ServiceChecksTemplate : l_HostChecksTemplate;
+
+	DbObject::OnQuery(queryTemplate.NewQuery({
+		!checkable->GetEnableActiveChecks(), /* check_type: 0 .. active, 1 .. passive */
+		checkable->GetCheckAttempt(),
+		checkable->GetMaxCheckAttempts(),
+		checkable->GetStateType(),
+		DbValue::FromTimestamp(timeBagStart.first),
+		timeBagStart.second,
+		DbValue::FromTimestamp(timeBagEnd.first),
+		timeBagEnd.second,
+		checkable->GetCheckCommand(),
+		cr->CalculateExecutionTime(),
+		cr->CalculateLatency(),
+		cr->GetExitStatus(),
+		cr->GetFormattedPerformanceData(),
+		CompatUtility::GetCheckResultOutput(cr),
+		CompatUtility::GetCheckResultLongOutput(cr),
+		CompatUtility::GetCommandLine(checkable->GetCheckCommand()),
+		0, /* instance_id: DbConnection class fills in real ID */
+		service ? Value(service) : Value(host),
+		service ? service->GetState() : GetHostState(host),
+		GetEndpointObject()
+	}));
 }
 
 /* eventhandlers */
@@ -1415,44 +1371,25 @@ void DbEvents::AddEventHandlerHistory(const Checkable::Ptr& checkable)
 	Log(LogDebug, "DbEvents")
 		<< "add eventhandler history for '" << checkable->GetName() << "'";
 
-	DbQuery query1;
-	query1.Table = "eventhandlers";
-	query1.Type = DbQueryInsert;
-	query1.Category = DbCatEventHandler;
-
-	Dictionary::Ptr fields1 = new Dictionary();
-
 	Host::Ptr host;
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
-	fields1->Set("object_id", checkable);
-	fields1->Set("state_type", checkable->GetStateType());
-	fields1->Set("command_object_id", checkable->GetEventCommand());
-	fields1->Set("instance_id", 0); /* DbConnection class fills in real ID */
-
-	if (service) {
-		fields1->Set("state", service->GetState());
-		fields1->Set("eventhandler_type", 1);
-	} else {
-		fields1->Set("state", GetHostState(host));
-		fields1->Set("eventhandler_type", 0);
-	}
-
 	std::pair<unsigned long, unsigned long> timeBag = ConvertTimestamp(Utility::GetTime());
 
-	fields1->Set("start_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("start_time_usec", timeBag.second);
-	fields1->Set("end_time", DbValue::FromTimestamp(timeBag.first));
-	fields1->Set("end_time_usec", timeBag.second);
-
-	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
-
-	if (endpoint)
-		fields1->Set("endpoint_object_id", endpoint);
-
-	query1.Fields = fields1;
-	DbObject::OnQuery(query1);
+	DbObject::OnQuery(l_EventHandlersTemplate.NewQuery({
+		checkable,
+		checkable->GetStateType(),
+		checkable->GetEventCommand(),
+		0, /* instance_id: DbConnection class fills in real ID */
+		service ? service->GetState() : GetHostState(host),
+		service ? 1 : 0, /* eventhandler_type */
+		DbValue::FromTimestamp(timeBag.first),
+		timeBag.second,
+		DbValue::FromTimestamp(timeBag.first),
+		timeBag.second,
+		GetEndpointObject()
+	}));
 }
 
 /* externalcommands */
@@ -1460,26 +1397,14 @@ void DbEvents::AddExternalCommandHistory(double time, const String& command, con
 {
 	Log(LogDebug, "DbEvents", "add external command history");
 
-	DbQuery query1;
-	query1.Table = "externalcommands";
-	query1.Type = DbQueryInsert;
-	query1.Category = DbCatExternalCommand;
-
-	Dictionary::Ptr fields1 = new Dictionary();
-
-	fields1->Set("entry_time", DbValue::FromTimestamp(time));
-	fields1->Set("command_type", MapExternalCommandType(command));
-	fields1->Set("command_name", command);
-	fields1->Set("command_args", boost::algorithm::join(arguments, ";"));
-	fields1->Set("instance_id", 0); /* DbConnection class fills in real ID */
-
-	Endpoint::Ptr endpoint = Endpoint::GetByName(IcingaApplication::GetInstance()->GetNodeName());
-
-	if (endpoint)
-		fields1->Set("endpoint_object_id", endpoint);
-
-	query1.Fields = fields1;
-	DbObject::OnQuery(query1);
+	DbObject::OnQuery(l_ExternalCommandsTemplate.NewQuery({
+		DbValue::FromTimestamp(time),
+		MapExternalCommandType(command),
+		command,
+		boost::algorithm::join(arguments, ";"),
+		0, /* instance_id: DbConnection class fills in real ID */
+		GetEndpointObject()
+	}));
 }
 
 int DbEvents::GetHostState(const Host::Ptr& host)
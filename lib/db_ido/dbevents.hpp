@@ -90,7 +90,7 @@ public:
 	static void RemoveAcknowledgement(const Checkable::Ptr& checkable);
 	static void AddAcknowledgementInternal(const Checkable::Ptr& checkable, AcknowledgementType type, bool add);
 
-	static void ReachabilityChangedHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, std::set<Checkable::Ptr> children);
+	static void ReachabilityChangedHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const std::set<Checkable::Ptr>& children);
 
 	/* comment, downtime, acknowledgement history */
 	static void AddCommentHistory(const Comment::Ptr& comment);
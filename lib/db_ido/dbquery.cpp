@@ -20,6 +20,8 @@
 #include "db_ido/dbquery.hpp"
 #include "base/initialize.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/objectlock.hpp"
+#include "base/debug.hpp"
 
 using namespace icinga;
 
@@ -67,3 +69,80 @@ const std::map<String, int>& DbQuery::GetCategoryFilterMap()
 {
 	return m_CategoryFilterMap;
 }
+
+bool DbQuery::HasFields() const
+{
+	return Template || Fields;
+}
+
+/**
+ * Calls the callback for each column which has a value, either from the
+ * template's values or from the Fields dictionary.
+ *
+ * @returns false if the callback returned false, which stops the iteration.
+ */
+bool DbQuery::ForEachField(const std::function<bool (const String&, const Value&)>& callback) const
+{
+	if (Template) {
+		const std::vector<String>& columns = Template->GetColumns();
+
+		for (std::vector<String>::size_type i = 0; i < columns.size(); i++) {
+			const Value& value = Values[i];
+
+			if (value.IsEmpty() && !value.IsString())
+				continue;
+
+			if (!callback(columns[i], value))
+				return false;
+		}
+
+		return true;
+	}
+
+	if (!Fields)
+		return true;
+
+	ObjectLock olock(Fields);
+
+	for (const Dictionary::Pair& kv : Fields) {
+		if (kv.second.IsEmpty() && !kv.second.IsString())
+			continue;
+
+		if (!callback(kv.first, kv.second))
+			return false;
+	}
+
+	return true;
+}
+
+DbQueryTemplate::DbQueryTemplate(String table, DbQueryCategory category, std::vector<String> columns)
+	: m_Table(std::move(table)), m_Category(category), m_Columns(std::move(columns))
+{ }
+
+const String& DbQueryTemplate::GetTable() const
+{
+	return m_Table;
+}
+
+const std::vector<String>& DbQueryTemplate::GetColumns() const
+{
+	return m_Columns;
+}
+
+/**
+ * Creates an INSERT query for the template's table.
+ *
+ * @param values One value per column, in the order of the template's columns.
+ */
+DbQuery DbQueryTemplate::NewQuery(std::vector<Value> values) const
+{
+	VERIFY(values.size() == m_Columns.size());
+
+	DbQuery query;
+	query.Table = m_Table;
+	query.Type = DbQueryInsert;
+	query.Category = m_Category;
+	query.Template = this;
+	query.Values = std::move(values);
+	return query;
+}
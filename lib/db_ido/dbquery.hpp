@@ -25,6 +25,8 @@
 #include "icinga/customvarobject.hpp"
 #include "base/dictionary.hpp"
 #include "base/configobject.hpp"
+#include <functional>
+#include <vector>
 
 namespace icinga
 {
@@ -59,6 +61,7 @@ enum DbQueryCategory
 };
 
 class DbObject;
+class DbQueryTemplate;
 
 struct DbQuery
 {
@@ -68,6 +71,8 @@ struct DbQuery
 	String IdColumn;
 	Dictionary::Ptr Fields;
 	Dictionary::Ptr WhereCriteria;
+	const DbQueryTemplate *Template{nullptr};
+	std::vector<Value> Values; /**< One value per column of the template, used instead of Fields. */
 	intrusive_ptr<DbObject> Object;
 	DbValue::Ptr NotificationInsertID;
 	bool ConfigUpdate{false};
@@ -78,10 +83,41 @@ struct DbQuery
 
 	static const std::map<String, int>& GetCategoryFilterMap();
 
+	bool HasFields() const;
+	bool ForEachField(const std::function<bool (const String&, const Value&)>& callback) const;
+
 private:
 	static std::map<String, int> m_CategoryFilterMap;
 };
 
+/**
+ * The table and columns of a recurring history INSERT. Queries which are
+ * created from a template carry one value per column rather than a
+ * Fields dictionary. Empty values are left out, just like missing fields.
+ *
+ * Templates are static and must outlive all of their queries.
+ *
+ * @ingroup ido
+ */
+class DbQueryTemplate
+{
+public:
+	DbQueryTemplate(String table, DbQueryCategory category, std::vector<String> columns);
+
+	DbQueryTemplate(const DbQueryTemplate&) = delete;
+	DbQueryTemplate& operator=(const DbQueryTemplate&) = delete;
+
+	const String& GetTable() const;
+	const std::vector<String>& GetColumns() const;
+
+	DbQuery NewQuery(std::vector<Value> values) const;
+
+private:
+	String m_Table;
+	DbQueryCategory m_Category;
+	std::vector<String> m_Columns;
+};
+
 }
 
 #endif /* DBQUERY_H */
@@ -99,7 +99,7 @@ Dictionary::Ptr HostDbObject::GetStatusFields() const
 	if (cr) {
 		fields->Set("output", CompatUtility::GetCheckResultOutput(cr));
 		fields->Set("long_output", CompatUtility::GetCheckResultLongOutput(cr));
-		fields->Set("perfdata", PluginUtility::FormatPerfdata(cr->GetPerformanceData()));
+		fields->Set("perfdata", cr->GetFormattedPerformanceData());
 		fields->Set("check_source", cr->GetCheckSource());
 		fields->Set("latency", cr->CalculateLatency());
 		fields->Set("execution_time", cr->CalculateExecutionTime());
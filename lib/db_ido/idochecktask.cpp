@@ -28,6 +28,7 @@
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/configtype.hpp"
+#include "base/objectlock.hpp"
 #include "base/convert.hpp"
 
 using namespace icinga;
@@ -181,13 +182,28 @@ void IdoCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckResult
 
 	cr->SetOutput(msgbuf.str());
 
-	cr->SetPerformanceData(new Array({
+	Array::Ptr perfdata = new Array({
 		{ new PerfdataValue("queries", qps, false, "", queriesWarning, queriesCritical) },
 		{ new PerfdataValue("queries_1min", conn->GetQueryCount(60)) },
 		{ new PerfdataValue("queries_5mins", conn->GetQueryCount(5 * 60)) },
 		{ new PerfdataValue("queries_15mins", conn->GetQueryCount(15 * 60)) },
-		{ new PerfdataValue("pending_queries", pendingQueries, false, "", pendingQueriesWarning, pendingQueriesCritical) }
-	}));
+		{ new PerfdataValue("pending_queries", pendingQueries, false, "", pendingQueriesWarning, pendingQueriesCritical) },
+		{ new PerfdataValue("queue_wait", conn->GetQueueWaitHistogram().GetPercentile(95), false, "s") }
+	});
+
+	/* 95th percentile latency and affected rows for each table and query type */
+	Dictionary::Ptr queryStats = conn->GetQueryStats()->Get("queries");
+
+	ObjectLock olock(queryStats);
+	for (const Dictionary::Pair& kv : queryStats) {
+		Dictionary::Ptr stats = kv.second;
+		Dictionary::Ptr latency = stats->Get("latency");
+
+		perfdata->Add(new PerfdataValue(kv.first + "_latency", latency->Get("p95"), false, "s"));
+		perfdata->Add(new PerfdataValue(kv.first + "_rows", stats->Get("rows"), true));
+	}
+
+	cr->SetPerformanceData(perfdata);
 
 	checkable->ProcessCheckResult(cr);
 }
@@ -30,6 +30,7 @@
 #include "base/configtype.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/tracing.hpp"
 #include <boost/tuple/tuple.hpp>
 #include <utility>
 
@@ -42,7 +43,16 @@ void IdoMysqlConnection::OnConfigLoaded()
 {
 	ObjectImpl<IdoMysqlConnection>::OnConfigLoaded();
 
-	m_QueryQueue.SetName("IdoMysqlConnection, " + GetName());
+	for (int i = 0; i < GetSessions(); i++) {
+		std::unique_ptr<IdoMysqlSession> session(new IdoMysqlSession());
+
+		if (i == 0)
+			session->Queue.SetName("IdoMysqlConnection, " + GetName());
+		else
+			session->Queue.SetName("IdoMysqlConnection, " + GetName() + ", session " + Convert::ToString(i));
+
+		m_Sessions.emplace_back(std::move(session));
+	}
 
 	Library shimLibrary{"mysql_shim"};
 
@@ -58,15 +68,29 @@ void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 	DictionaryData nodes;
 
 	for (const IdoMysqlConnection::Ptr& idomysqlconnection : ConfigType::GetObjectsByType<IdoMysqlConnection>()) {
-		size_t queryQueueItems = idomysqlconnection->m_QueryQueue.GetLength();
-		double queryQueueItemRate = idomysqlconnection->m_QueryQueue.GetTaskCount(60) / 60.0;
+		size_t queryQueueItems = 0;
+		double queryQueueItemRate = 0;
+
+		for (const std::unique_ptr<IdoMysqlSession>& session : idomysqlconnection->m_Sessions) {
+			queryQueueItems += session->Queue.GetLength();
+			queryQueueItemRate += session->Queue.GetTaskCount(60) / 60.0;
+		}
 
 		nodes.emplace_back(idomysqlconnection->GetName(), new Dictionary({
 			{ "version", idomysqlconnection->GetSchemaVersion() },
 			{ "instance_name", idomysqlconnection->GetInstanceName() },
 			{ "connected", idomysqlconnection->GetConnected() },
+			{ "sessions", static_cast<int>(idomysqlconnection->m_Sessions.size()) },
 			{ "query_queue_items", queryQueueItems },
-			{ "query_queue_item_rate", queryQueueItemRate }
+			{ "query_queue_item_rate", queryQueueItemRate },
+			{ "insert_batches", idomysqlconnection->m_InsertBatches.load() },
+			{ "insert_batch_rows", idomysqlconnection->m_InsertBatchRows.load() },
+			{ "insert_batch_max_rows", idomysqlconnection->m_InsertBatchMaxRows.load() },
+			{ "coalesced_status_updates", idomysqlconnection->GetCoalescedStatusUpdates() },
+			{ "cleanup_deleted_rows", idomysqlconnection->GetCleanUpDeletedRows() },
+			{ "cleanup_pending_tables", idomysqlconnection->GetCleanUpPendingTables() },
+			{ "config_dump_progress", idomysqlconnection->GetConfigDumpProgress() },
+			{ "query_stats", idomysqlconnection->GetQueryStats() }
 		}));
 
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_queries_rate", idomysqlconnection->GetQueryCount(60) / 60.0));
@@ -89,14 +113,15 @@ void IdoMysqlConnection::Resume()
 
 	SetConnected(false);
 
-	m_QueryQueue.SetExceptionCallback(std::bind(&IdoMysqlConnection::ExceptionHandler, this, _1));
+	for (const std::unique_ptr<IdoMysqlSession>& session : m_Sessions)
+		session->Queue.SetExceptionCallback(std::bind(&IdoMysqlConnection::ExceptionHandler, this, _1));
 
-	m_TxTimer = new Timer();
+	m_TxTimer = new Timer("IdoMysqlConnection transaction");
 	m_TxTimer->SetInterval(1);
 	m_TxTimer->OnTimerExpired.connect(std::bind(&IdoMysqlConnection::TxTimerHandler, this));
 	m_TxTimer->Start();
 
-	m_ReconnectTimer = new Timer();
+	m_ReconnectTimer = new Timer("IdoMysqlConnection reconnect");
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&IdoMysqlConnection::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
@@ -119,8 +144,11 @@ void IdoMysqlConnection::Pause()
 		<< "Rescheduling disconnect task.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::Disconnect, this), PriorityHigh);
-	m_QueryQueue.Join();
+	for (const std::unique_ptr<IdoMysqlSession>& session : m_Sessions)
+		session->Queue.Enqueue(std::bind(&IdoMysqlConnection::Disconnect, this), PriorityHigh);
+
+	for (const std::unique_ptr<IdoMysqlSession>& session : m_Sessions)
+		session->Queue.Join();
 }
 
 void IdoMysqlConnection::ExceptionHandler(boost::exception_ptr exp)
@@ -130,27 +158,100 @@ void IdoMysqlConnection::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "IdoMysqlConnection")
 		<< "Exception during database operation: " << DiagnosticInformation(std::move(exp));
 
+	IdoMysqlSession& session = GetSession();
+
+	if (!IsPrimarySession()) {
+		if (session.Connected) {
+			m_Mysql->close(&session.Connection);
+
+			session.Connected = false;
+		}
+
+		return;
+	}
+
 	if (GetConnected()) {
-		m_Mysql->close(&m_Connection);
+		m_Mysql->close(&session.Connection);
 
 		SetConnected(false);
 	}
 }
 
+/**
+ * Returns the work queue of a session.
+ *
+ * @param session The session index, 0 is the primary session.
+ * @returns The work queue.
+ */
+WorkQueue& IdoMysqlConnection::GetQueue(int session) const
+{
+	return m_Sessions[session]->Queue;
+}
+
+/**
+ * Returns the session which belongs to the current work queue thread.
+ *
+ * @returns The session.
+ */
+IdoMysqlSession& IdoMysqlConnection::GetSession() const
+{
+	for (const std::unique_ptr<IdoMysqlSession>& session : m_Sessions) {
+		if (session->Queue.IsWorkerThread())
+			return *session;
+	}
+
+	VERIFY(!"Not running on a session work queue.");
+}
+
+/**
+ * Checks whether the current work queue thread belongs to the primary
+ * session, i.e. the session which maintains the ID cache.
+ */
+bool IdoMysqlConnection::IsPrimarySession() const
+{
+	return m_Sessions[0]->Queue.IsWorkerThread();
+}
+
 void IdoMysqlConnection::AssertOnWorkQueue()
 {
-	ASSERT(m_QueryQueue.IsWorkerThread());
+#ifdef I2_DEBUG
+	bool worker = false;
+
+	for (const std::unique_ptr<IdoMysqlSession>& session : m_Sessions) {
+		if (session->Queue.IsWorkerThread())
+			worker = true;
+	}
+
+	ASSERT(worker);
+#endif /* I2_DEBUG */
 }
 
 void IdoMysqlConnection::Disconnect()
 {
 	AssertOnWorkQueue();
 
+	IdoMysqlSession& session = GetSession();
+
+	if (!IsPrimarySession()) {
+		if (!session.Connected)
+			return;
+
+		Query("COMMIT");
+		m_Mysql->close(&session.Connection);
+
+		session.Connected = false;
+		return;
+	}
+
 	if (!GetConnected())
 		return;
 
 	Query("COMMIT");
-	m_Mysql->close(&m_Connection);
+
+	/* everything which changed the ID cache has been committed now */
+	SaveIDCache(m_IDCacheGeneration);
+
+	m_Mysql->close(&session.Connection);
 
 	SetConnected(false);
 }
@@ -167,15 +268,18 @@ void IdoMysqlConnection::NewTransaction()
 		<< "Scheduling new transaction and finishing async queries.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalNewTransaction, this), PriorityHigh);
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::FinishAsyncQueries, this), PriorityHigh);
+	/* Each session runs its own transactions. */
+	for (const std::unique_ptr<IdoMysqlSession>& session : m_Sessions) {
+		session->Queue.Enqueue(std::bind(&IdoMysqlConnection::InternalNewTransaction, this), PriorityHigh);
+		session->Queue.Enqueue(std::bind(&IdoMysqlConnection::FinishAsyncQueries, this), PriorityHigh);
+	}
 }
 
 void IdoMysqlConnection::InternalNewTransaction()
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!ConnectSession())
 		return;
 
 	AsyncQuery("COMMIT");
@@ -189,7 +293,7 @@ void IdoMysqlConnection::ReconnectTimerHandler()
 		<< "Scheduling reconnect task.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::Reconnect, this), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoMysqlConnection::Reconnect, this), PriorityLow);
 }
 
 void IdoMysqlConnection::Reconnect()
@@ -203,73 +307,25 @@ void IdoMysqlConnection::Reconnect()
 
 	double startTime = Utility::GetTime();
 
+	IdoMysqlSession& session = GetSession();
+
 	SetShouldConnect(true);
 
 	bool reconnect = false;
 
 	if (GetConnected()) {
 		/* Check if we're really still connected */
-		if (m_Mysql->ping(&m_Connection) == 0)
+		if (m_Mysql->ping(&session.Connection) == 0)
 			return;
 
-		m_Mysql->close(&m_Connection);
+		m_Mysql->close(&session.Connection);
 		SetConnected(false);
 		reconnect = true;
 	}
 
 	ClearIDCache();
 
-	String ihost, isocket_path, iuser, ipasswd, idb;
-	String isslKey, isslCert, isslCa, isslCaPath, isslCipher;
-	const char *host, *socket_path, *user , *passwd, *db;
-	const char *sslKey, *sslCert, *sslCa, *sslCaPath, *sslCipher;
-	bool enableSsl;
-	long port;
-
-	ihost = GetHost();
-	isocket_path = GetSocketPath();
-	iuser = GetUser();
-	ipasswd = GetPassword();
-	idb = GetDatabase();
-
-	enableSsl = GetEnableSsl();
-	isslKey = GetSslKey();
-	isslCert = GetSslCert();
-	isslCa = GetSslCa();
-	isslCaPath = GetSslCapath();
-	isslCipher = GetSslCipher();
-
-	host = (!ihost.IsEmpty()) ? ihost.CStr() : nullptr;
-	port = GetPort();
-	socket_path = (!isocket_path.IsEmpty()) ? isocket_path.CStr() : nullptr;
-	user = (!iuser.IsEmpty()) ? iuser.CStr() : nullptr;
-	passwd = (!ipasswd.IsEmpty()) ? ipasswd.CStr() : nullptr;
-	db = (!idb.IsEmpty()) ? idb.CStr() : nullptr;
-
-	sslKey = (!isslKey.IsEmpty()) ? isslKey.CStr() : nullptr;
-	sslCert = (!isslCert.IsEmpty()) ? isslCert.CStr() : nullptr;
-	sslCa = (!isslCa.IsEmpty()) ? isslCa.CStr() : nullptr;
-	sslCaPath = (!isslCaPath.IsEmpty()) ? isslCaPath.CStr() : nullptr;
-	sslCipher = (!isslCipher.IsEmpty()) ? isslCipher.CStr() : nullptr;
-
-	/* connection */
-	if (!m_Mysql->init(&m_Connection)) {
-		Log(LogCritical, "IdoMysqlConnection")
-			<< "mysql_init() failed: out of memory";
-
-		BOOST_THROW_EXCEPTION(std::bad_alloc());
-	}
-
-	if (enableSsl)
-		m_Mysql->ssl_set(&m_Connection, sslKey, sslCert, sslCa, sslCaPath, sslCipher);
-
-	if (!m_Mysql->real_connect(&m_Connection, host, user, passwd, db, port, socket_path, CLIENT_FOUND_ROWS | CLIENT_MULTI_STATEMENTS)) {
-		Log(LogCritical, "IdoMysqlConnection")
-			<< "Connection to database '" << db << "' with user '" << user << "' on '" << host << ":" << port
-			<< "' " << (enableSsl ? "(SSL enabled) " : "") << "failed: \"" << m_Mysql->error(&m_Connection) << "\"";
-
-		BOOST_THROW_EXCEPTION(std::runtime_error(m_Mysql->error(&m_Connection)));
-	}
+	Connect(&session.Connection);
 
 	SetConnected(true);
 
@@ -278,9 +334,9 @@ void IdoMysqlConnection::Reconnect()
 	Dictionary::Ptr row = FetchRow(result);
 
 	if (row)
-		m_MaxPacketSize = row->Get("max_allowed_packet");
+		session.MaxPacketSize = row->Get("max_allowed_packet");
 	else
-		m_MaxPacketSize = 64 * 1024;
+		session.MaxPacketSize = 64 * 1024;
 
 	DiscardRows(result);
 
@@ -290,7 +346,7 @@ void IdoMysqlConnection::Reconnect()
 	row = FetchRow(result);
 
 	if (!row) {
-		m_Mysql->close(&m_Connection);
+		m_Mysql->close(&session.Connection);
 		SetConnected(false);
 
 		Log(LogCritical, "IdoMysqlConnection", "Schema does not provide any valid version! Verify your schema installation.");
@@ -305,7 +361,7 @@ void IdoMysqlConnection::Reconnect()
 	SetSchemaVersion(version);
 
 	if (Utility::CompareVersion(IDO_COMPAT_SCHEMA_VERSION, version) < 0) {
-		m_Mysql->close(&m_Connection);
+		m_Mysql->close(&session.Connection);
 		SetConnected(false);
 
 		Log(LogCritical, "IdoMysqlConnection")
@@ -362,7 +418,7 @@ void IdoMysqlConnection::Reconnect()
 				<< "Last update by '" << endpoint_name << "' was " << status_update_age << "s ago.";
 
 			if (status_update_age < GetFailoverTimeout()) {
-				m_Mysql->close(&m_Connection);
+				m_Mysql->close(&session.Connection);
 				SetConnected(false);
 				SetShouldConnect(false);
 
@@ -374,7 +430,7 @@ void IdoMysqlConnection::Reconnect()
 				Log(LogNotice, "IdoMysqlConnection")
 					<< "Local endpoint '" << my_endpoint->GetName() << "' is not authoritative, bailing out.";
 
-				m_Mysql->close(&m_Connection);
+				m_Mysql->close(&session.Connection);
 				SetConnected(false);
 
 				return;
@@ -397,14 +453,27 @@ void IdoMysqlConnection::Reconnect()
 	/* update programstatus table */
 	UpdateProgramStatus();
 
+	/* Every connection adds a conninfo row, the saved ID cache is only valid if
+	 * the last row before ours is the one from the connection which saved it. */
+	result = Query("SELECT MAX(conninfo_id) AS conninfo_id FROM " + GetTablePrefix() + "conninfo WHERE instance_id = "
+		+ Convert::ToString(static_cast<long>(m_InstanceID)));
+	row = FetchRow(result);
+
+	String lastGeneration;
+
+	if (row && !row->Get("conninfo_id").IsEmpty())
+		lastGeneration = GetIDCacheGeneration(row->Get("conninfo_id"));
+
 	/* record connection */
 	Query("INSERT INTO " + GetTablePrefix() + "conninfo " +
 		"(instance_id, connect_time, last_checkin_time, agent_name, agent_version, connect_type, data_start_time) VALUES ("
 		+ Convert::ToString(static_cast<long>(m_InstanceID)) + ", NOW(), NOW(), 'icinga2 db_ido_mysql', '" + Escape(Application::GetAppVersion())
 		+ "', '" + (reconnect ? "RECONNECT" : "INITIAL") + "', NOW())");
 
+	m_IDCacheGeneration = GetIDCacheGeneration(static_cast<long>(GetLastInsertID()));
+
 	/* clear config tables for the initial config dump */
-	PrepareDatabase();
+	PrepareDatabase(lastGeneration);
 
 	std::ostringstream q1buf;
 	q1buf << "SELECT object_id, objecttype_id, name1, name2, is_active FROM " + GetTablePrefix() + "objects WHERE instance_id = " << static_cast<long>(m_InstanceID);
@@ -448,9 +517,120 @@ void IdoMysqlConnection::Reconnect()
 		<< "Scheduling session table clear and finish connect task.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::ClearTablesBySession, this), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoMysqlConnection::ClearTablesBySession, this), PriorityLow);
+
+	GetQueue().Enqueue(std::bind(&IdoMysqlConnection::FinishConnect, this, startTime), PriorityLow);
+}
+
+/**
+ * Opens a database connection with the configured connection parameters.
+ *
+ * @param connection The connection handle.
+ */
+void IdoMysqlConnection::Connect(MYSQL *connection)
+{
+	String ihost, isocket_path, iuser, ipasswd, idb;
+	String isslKey, isslCert, isslCa, isslCaPath, isslCipher;
+	const char *host, *socket_path, *user , *passwd, *db;
+	const char *sslKey, *sslCert, *sslCa, *sslCaPath, *sslCipher;
+	bool enableSsl;
+	long port;
+
+	ihost = GetHost();
+	isocket_path = GetSocketPath();
+	iuser = GetUser();
+	ipasswd = GetPassword();
+	idb = GetDatabase();
+
+	enableSsl = GetEnableSsl();
+	isslKey = GetSslKey();
+	isslCert = GetSslCert();
+	isslCa = GetSslCa();
+	isslCaPath = GetSslCapath();
+	isslCipher = GetSslCipher();
+
+	host = (!ihost.IsEmpty()) ? ihost.CStr() : nullptr;
+	port = GetPort();
+	socket_path = (!isocket_path.IsEmpty()) ? isocket_path.CStr() : nullptr;
+	user = (!iuser.IsEmpty()) ? iuser.CStr() : nullptr;
+	passwd = (!ipasswd.IsEmpty()) ? ipasswd.CStr() : nullptr;
+	db = (!idb.IsEmpty()) ? idb.CStr() : nullptr;
+
+	sslKey = (!isslKey.IsEmpty()) ? isslKey.CStr() : nullptr;
+	sslCert = (!isslCert.IsEmpty()) ? isslCert.CStr() : nullptr;
+	sslCa = (!isslCa.IsEmpty()) ? isslCa.CStr() : nullptr;
+	sslCaPath = (!isslCaPath.IsEmpty()) ? isslCaPath.CStr() : nullptr;
+	sslCipher = (!isslCipher.IsEmpty()) ? isslCipher.CStr() : nullptr;
+
+	/* connection */
+	if (!m_Mysql->init(connection)) {
+		Log(LogCritical, "IdoMysqlConnection")
+			<< "mysql_init() failed: out of memory";
+
+		BOOST_THROW_EXCEPTION(std::bad_alloc());
+	}
+
+	if (enableSsl)
+		m_Mysql->ssl_set(connection, sslKey, sslCert, sslCa, sslCaPath, sslCipher);
+
+	if (!m_Mysql->real_connect(connection, host, user, passwd, db, port, socket_path, CLIENT_FOUND_ROWS | CLIENT_MULTI_STATEMENTS)) {
+		Log(LogCritical, "IdoMysqlConnection")
+			<< "Connection to database '" << db << "' with user '" << user << "' on '" << host << ":" << port
+			<< "' " << (enableSsl ? "(SSL enabled) " : "") << "failed: \"" << m_Mysql->error(connection) << "\"";
+
+		BOOST_THROW_EXCEPTION(std::runtime_error(m_Mysql->error(connection)));
+	}
+}
+
+/**
+ * Checks whether the session of the current work queue is connected. Writer
+ * sessions are connected once the primary session is connected and closed
+ * when the primary session has lost its connection.
+ *
+ * @returns true if queries can be executed on the current session.
+ */
+bool IdoMysqlConnection::ConnectSession()
+{
+	AssertOnWorkQueue();
+
+	if (IsPrimarySession())
+		return GetConnected();
+
+	IdoMysqlSession& session = GetSession();
+
+	if (!GetConnected()) {
+		if (session.Connected) {
+			m_Mysql->close(&session.Connection);
+			session.Connected = false;
+			session.AsyncQueries.clear();
+		}
+
+		return false;
+	}
+
+	if (session.Connected)
+		return true;
+
+	Connect(&session.Connection);
+
+	session.Connected = true;
+
+	IdoMysqlResult result = Query("SELECT @@global.max_allowed_packet AS max_allowed_packet");
+
+	Dictionary::Ptr row = FetchRow(result);
+
+	if (row)
+		session.MaxPacketSize = row->Get("max_allowed_packet");
+
+	DiscardRows(result);
+
+	Query("SET SESSION TIME_ZONE='+00:00'");
+
+	Query("SET SESSION SQL_MODE='NO_AUTO_VALUE_ON_ZERO'");
+
+	Query("BEGIN");
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::FinishConnect, this, startTime), PriorityLow);
+	return true;
 }
 
 void IdoMysqlConnection::FinishConnect(double startTime)
@@ -483,19 +663,81 @@ void IdoMysqlConnection::ClearTableBySession(const String& table)
 		Convert::ToString(GetSessionToken()));
 }
 
-void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<void (const IdoMysqlResult&)>& callback)
+void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<void (const IdoMysqlResult&)>& callback,
+	const String& statsTable, int statsType)
 {
-	AssertOnWorkQueue();
-
 	IdoAsyncQuery aq;
 	aq.Query = query;
+	aq.StatsTable = statsTable;
+	aq.StatsType = statsType;
 	/* XXX: Important: The callback must not immediately execute a query, but enqueue it!
 	 * See https://github.com/Icinga/icinga2/issues/4603 for details.
 	 */
 	aq.Callback = callback;
-	m_AsyncQueries.emplace_back(std::move(aq));
+	EnqueueAsyncQuery(std::move(aq));
+}
+
+/**
+ * Queues an INSERT statement for a single row. The row is appended to an
+ * already queued INSERT statement for the same table and columns unless
+ * another kind of statement has been queued since then.
+ *
+ * @param table The table name (without the prefix).
+ * @param columns The comma-separated column names.
+ * @param values The comma-separated escaped values.
+ */
+void IdoMysqlConnection::AsyncInsertQuery(const String& table, const String& columns, const String& values)
+{
+	AssertOnWorkQueue();
+
+	IdoMysqlSession& session = GetSession();
+
+	String prefix = "INSERT INTO " + GetTablePrefix() + table + " (" + columns + ") VALUES ";
+	String row = "(" + values + ")";
+
+	int maxRows = GetInsertBatchRows();
+	size_t maxBytes = std::min<size_t>(GetInsertBatchSize(), session.MaxPacketSize > 1024 ? session.MaxPacketSize - 1024 : 0);
+
+	if (maxRows > 1) {
+		int depth = 0;
+
+		for (auto it = session.AsyncQueries.rbegin(); it != session.AsyncQueries.rend() && depth < 64; ++it, ++depth) {
+			/* Rows must not be moved across other statements, e.g. a DELETE for the same object. */
+			if (it->BatchTable.IsEmpty())
+				break;
+
+			/* INSERTs for other tables are independent of this row. */
+			if (it->BatchTable != table)
+				continue;
+
+			if (it->BatchPrefix != prefix || it->BatchRows >= maxRows || it->Query.GetLength() + row.GetLength() + 2 > maxBytes)
+				break;
+
+			it->Query += ", " + row;
+			it->BatchRows++;
+			return;
+		}
+	}
+
+	IdoAsyncQuery aq;
+	aq.Query = prefix + row;
+	aq.BatchTable = table;
+	aq.BatchPrefix = prefix;
+	aq.BatchRows = 1;
+	aq.StatsTable = table;
+	aq.StatsType = DbQueryInsert;
+	EnqueueAsyncQuery(std::move(aq));
+}
+
+void IdoMysqlConnection::EnqueueAsyncQuery(IdoAsyncQuery&& aq)
+{
+	AssertOnWorkQueue();
+
+	IdoMysqlSession& session = GetSession();
+
+	session.AsyncQueries.emplace_back(std::move(aq));
 
-	if (m_AsyncQueries.size() > 25000) {
+	if (session.AsyncQueries.size() > 25000) {
 		FinishAsyncQueries();
 		InternalNewTransaction();
 	}
@@ -503,8 +745,10 @@ void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<voi
 
 void IdoMysqlConnection::FinishAsyncQueries()
 {
+	IdoMysqlSession& session = GetSession();
+
 	std::vector<IdoAsyncQuery> queries;
-	m_AsyncQueries.swap(queries);
+	session.AsyncQueries.swap(queries);
 
 	std::vector<IdoAsyncQuery>::size_type offset = 0;
 
@@ -519,7 +763,7 @@ void IdoMysqlConnection::FinishAsyncQueries()
 
 			size_t size_query = aq.Query.GetLength() + 1;
 
-			if (num_bytes + size_query > m_MaxPacketSize - 512)
+			if (num_bytes + size_query > session.MaxPacketSize - 512)
 				break;
 
 			if (count > 0)
@@ -531,21 +775,33 @@ void IdoMysqlConnection::FinishAsyncQueries()
 			Log(LogDebug, "IdoMysqlConnection")
 				<< "Query: " << aq.Query;
 
+			if (aq.BatchRows > 0) {
+				m_InsertBatches++;
+				m_InsertBatchRows += aq.BatchRows;
+
+				if (aq.BatchRows > m_InsertBatchMaxRows)
+					m_InsertBatchMaxRows = aq.BatchRows;
+			}
+
 			querybuf << aq.Query;
 			num_bytes += size_query;
 		}
 
 		String query = querybuf.str();
 
-		if (m_Mysql->query(&m_Connection, query.CStr()) != 0) {
+		/* The results arrive one after another, each statement is accounted
+		 * the time since the previous result. */
+		double last = Utility::GetTime();
+
+		if (m_Mysql->query(&session.Connection, query.CStr()) != 0) {
 			std::ostringstream msgbuf;
-			String message = m_Mysql->error(&m_Connection);
+			String message = m_Mysql->error(&session.Connection);
 			msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 			Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 			BOOST_THROW_EXCEPTION(
 				database_error()
-				<< errinfo_message(m_Mysql->error(&m_Connection))
+				<< errinfo_message(m_Mysql->error(&session.Connection))
 				<< errinfo_database_query(query)
 			);
 		}
@@ -553,22 +809,26 @@ void IdoMysqlConnection::FinishAsyncQueries()
 		for (std::vector<IdoAsyncQuery>::size_type i = offset; i < offset + count; i++) {
 			const IdoAsyncQuery& aq = queries[i];
 
-			MYSQL_RES *result = m_Mysql->store_result(&m_Connection);
+			MYSQL_RES *result = m_Mysql->store_result(&session.Connection);
 
-			m_AffectedRows = m_Mysql->affected_rows(&m_Connection);
+			session.AffectedRows = m_Mysql->affected_rows(&session.Connection);
+
+			double now = Utility::GetTime();
+			RecordQueryStats(aq.StatsTable, aq.StatsType, now - last, session.AffectedRows);
+			last = now;
 
 			IdoMysqlResult iresult;
 
 			if (!result) {
-				if (m_Mysql->field_count(&m_Connection) > 0) {
+				if (m_Mysql->field_count(&session.Connection) > 0) {
 					std::ostringstream msgbuf;
-					String message = m_Mysql->error(&m_Connection);
+					String message = m_Mysql->error(&session.Connection);
 					msgbuf << "Error \"" << message << "\" when executing query \"" << aq.Query << "\"";
 					Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 					BOOST_THROW_EXCEPTION(
 						database_error()
-						<< errinfo_message(m_Mysql->error(&m_Connection))
+						<< errinfo_message(m_Mysql->error(&session.Connection))
 						<< errinfo_database_query(query)
 					);
 				}
@@ -578,15 +838,15 @@ void IdoMysqlConnection::FinishAsyncQueries()
 			if (aq.Callback)
 				aq.Callback(iresult);
 
-			if (m_Mysql->next_result(&m_Connection) > 0) {
+			if (m_Mysql->next_result(&session.Connection) > 0) {
 				std::ostringstream msgbuf;
-				String message = m_Mysql->error(&m_Connection);
+				String message = m_Mysql->error(&session.Connection);
 				msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 				Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 				BOOST_THROW_EXCEPTION(
 					database_error()
-					<< errinfo_message(m_Mysql->error(&m_Connection))
+					<< errinfo_message(m_Mysql->error(&session.Connection))
 					<< errinfo_database_query(query)
 				);
 			}
@@ -600,6 +860,8 @@ IdoMysqlResult IdoMysqlConnection::Query(const String& query)
 {
 	AssertOnWorkQueue();
 
+	IdoMysqlSession& session = GetSession();
+
 	/* finish all async queries to maintain the right order for queries */
 	FinishAsyncQueries();
 
@@ -608,33 +870,33 @@ IdoMysqlResult IdoMysqlConnection::Query(const String& query)
 
 	IncreaseQueryCount();
 
-	if (m_Mysql->query(&m_Connection, query.CStr()) != 0) {
+	if (m_Mysql->query(&session.Connection, query.CStr()) != 0) {
 		std::ostringstream msgbuf;
-		String message = m_Mysql->error(&m_Connection);
+		String message = m_Mysql->error(&session.Connection);
 		msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 		Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 		BOOST_THROW_EXCEPTION(
 			database_error()
-			<< errinfo_message(m_Mysql->error(&m_Connection))
+			<< errinfo_message(m_Mysql->error(&session.Connection))
 			<< errinfo_database_query(query)
 		);
 	}
 
-	MYSQL_RES *result = m_Mysql->store_result(&m_Connection);
+	MYSQL_RES *result = m_Mysql->store_result(&session.Connection);
 
-	m_AffectedRows = m_Mysql->affected_rows(&m_Connection);
+	session.AffectedRows = m_Mysql->affected_rows(&session.Connection);
 
 	if (!result) {
-		if (m_Mysql->field_count(&m_Connection) > 0) {
+		if (m_Mysql->field_count(&session.Connection) > 0) {
 			std::ostringstream msgbuf;
-			String message = m_Mysql->error(&m_Connection);
+			String message = m_Mysql->error(&session.Connection);
 			msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 			Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 			BOOST_THROW_EXCEPTION(
 				database_error()
-				<< errinfo_message(m_Mysql->error(&m_Connection))
+				<< errinfo_message(m_Mysql->error(&session.Connection))
 				<< errinfo_database_query(query)
 			);
 		}
@@ -649,14 +911,14 @@ DbReference IdoMysqlConnection::GetLastInsertID()
 {
 	AssertOnWorkQueue();
 
-	return {static_cast<long>(m_Mysql->insert_id(&m_Connection))};
+	return {static_cast<long>(m_Mysql->insert_id(&GetSession().Connection))};
 }
 
 int IdoMysqlConnection::GetAffectedRows()
 {
 	AssertOnWorkQueue();
 
-	return m_AffectedRows;
+	return GetSession().AffectedRows;
 }
 
 String IdoMysqlConnection::Escape(const String& s)
@@ -665,16 +927,23 @@ String IdoMysqlConnection::Escape(const String& s)
 
 	String utf8s = Utility::ValidateUTF8(s);
 
-	size_t length = utf8s.GetLength();
-	auto *to = new char[utf8s.GetLength() * 2 + 1];
+	/* Most values don't contain any of the characters mysql_real_escape_string() escapes. */
+	static const char specialChars[] = { '\0', '\n', '\r', '\\', '\'', '"', '\x1a' };
+
+	if (utf8s.GetData().find_first_of(specialChars, 0, sizeof(specialChars)) == std::string::npos)
+		return utf8s;
+
+	IdoMysqlSession& session = GetSession();
 
-	m_Mysql->real_escape_string(&m_Connection, to, utf8s.CStr(), length);
+	size_t length = utf8s.GetLength();
 
-	String result = String(to);
+	if (session.EscapeBuffer.size() < length * 2 + 1)
+		session.EscapeBuffer.resize(length * 2 + 1);
 
-	delete [] to;
+	char *to = session.EscapeBuffer.data();
+	unsigned long escapedLength = m_Mysql->real_escape_string(&session.Connection, to, utf8s.CStr(), length);
 
-	return result;
+	return String(to, to + escapedLength);
 }
 
 Dictionary::Ptr IdoMysqlConnection::FetchRow(const IdoMysqlResult& result)
@@ -719,7 +988,7 @@ void IdoMysqlConnection::ActivateObject(const DbObject::Ptr& dbobj)
 		<< "Scheduling object activation task for '" << dbobj->GetName1() << "!" << dbobj->GetName2() << "'.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalActivateObject, this, dbobj), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoMysqlConnection::InternalActivateObject, this, dbobj), PriorityLow);
 }
 
 void IdoMysqlConnection::InternalActivateObject(const DbObject::Ptr& dbobj)
@@ -751,6 +1020,95 @@ void IdoMysqlConnection::InternalActivateObject(const DbObject::Ptr& dbobj)
 	}
 }
 
+/**
+ * Inserts the missing objects and reactivates the existing ones with
+ * multi-row statements. This is used for the config dump after connecting
+ * which would otherwise have to wait for one INSERT per new object.
+ */
+void IdoMysqlConnection::BulkActivateObjects(const std::vector<DbObject::Ptr>& dbobjs)
+{
+	AssertOnWorkQueue();
+
+	if (!GetConnected())
+		return;
+
+	IdoMysqlSession& session = GetSession();
+	size_t maxSize = session.MaxPacketSize / 2;
+
+	std::ostringstream insertbuf, updatebuf;
+	int insertRows = 0, updateRows = 0;
+	long minID = -1;
+
+	for (auto it = dbobjs.begin(); it != dbobjs.end(); it++) {
+		const DbObject::Ptr& dbobj = *it;
+		DbReference dbref = GetObjectID(dbobj);
+
+		if (!dbref.IsValid()) {
+			insertbuf << (insertRows == 0 ? "" : ", ") << "(" << static_cast<long>(m_InstanceID) << ", " << dbobj->GetType()->GetTypeID()
+				<< ", '" << Escape(dbobj->GetName1()) << "', ";
+
+			if (dbobj->GetName2().IsEmpty())
+				insertbuf << "NULL";
+			else
+				insertbuf << "'" << Escape(dbobj->GetName2()) << "'";
+
+			insertbuf << ", 1)";
+			insertRows++;
+		} else {
+			updatebuf << (updateRows == 0 ? "" : ", ") << static_cast<long>(dbref);
+			updateRows++;
+
+			SetObjectActive(dbobj, true);
+		}
+
+		bool last = (it + 1 == dbobjs.end());
+
+		if (insertRows > 0 && (last || insertRows >= 1000 || insertbuf.tellp() > static_cast<std::streamoff>(maxSize))) {
+			Query("INSERT INTO " + GetTablePrefix() + "objects (instance_id, objecttype_id, name1, name2, is_active) VALUES " + insertbuf.str());
+
+			/* this is the ID of the first row */
+			long id = GetLastInsertID();
+
+			if (minID == -1 || id < minID)
+				minID = id;
+
+			insertbuf.str("");
+			insertRows = 0;
+		}
+
+		if (updateRows > 0 && (last || updateRows >= 1000)) {
+			AsyncQuery("UPDATE " + GetTablePrefix() + "objects SET is_active = 1 WHERE object_id IN (" + updatebuf.str() + ")");
+
+			updatebuf.str("");
+			updateRows = 0;
+		}
+	}
+
+	if (minID == -1)
+		return;
+
+	/* The IDs of a multi-row INSERT aren't necessarily consecutive, fetch them instead. */
+	IdoMysqlResult result = Query("SELECT object_id, objecttype_id, name1, name2 FROM " + GetTablePrefix() + "objects WHERE instance_id = " +
+		Convert::ToString(static_cast<long>(m_InstanceID)) + " AND object_id >= " + Convert::ToString(minID));
+
+	Dictionary::Ptr row;
+
+	while ((row = FetchRow(result))) {
+		DbType::Ptr dbtype = DbType::GetByID(row->Get("objecttype_id"));
+
+		if (!dbtype)
+			continue;
+
+		DbObject::Ptr dbobj = dbtype->GetOrCreateObjectByName(row->Get("name1"), row->Get("name2"));
+
+		if (GetObjectID(dbobj).IsValid())
+			continue;
+
+		SetObjectID(dbobj, DbReference(row->Get("object_id")));
+		SetObjectActive(dbobj, true);
+	}
+}
+
 void IdoMysqlConnection::DeactivateObject(const DbObject::Ptr& dbobj)
 {
 #ifdef I2_DEBUG /* I2_DEBUG */
@@ -758,7 +1116,7 @@ void IdoMysqlConnection::DeactivateObject(const DbObject::Ptr& dbobj)
 		<< "Scheduling object deactivation task for '" << dbobj->GetName1() << "!" << dbobj->GetName2() << "'.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalDeactivateObject, this, dbobj), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoMysqlConnection::InternalDeactivateObject, this, dbobj), PriorityLow);
 }
 
 void IdoMysqlConnection::InternalDeactivateObject(const DbObject::Ptr& dbobj)
@@ -815,6 +1173,10 @@ bool IdoMysqlConnection::FieldToEscapedString(const String& key, const Value& va
 			dbrefcol = GetObjectID(dbobjcol);
 
 			if (!dbrefcol.IsValid()) {
+				/* only the primary session creates objects */
+				if (!IsPrimarySession())
+					return false;
+
 				InternalActivateObject(dbobjcol);
 
 				dbrefcol = GetObjectID(dbobjcol);
@@ -858,12 +1220,40 @@ void IdoMysqlConnection::ExecuteQuery(const DbQuery& query)
 {
 	ASSERT(query.Category != DbCatInvalid);
 
+	TraceSpan span("ido.enqueue");
+
+	if (span.IsSampled())
+		span.SetDetail(query.Table);
+
 #ifdef I2_DEBUG /* I2_DEBUG */
 	Log(LogDebug, "IdoMysqlConnection")
 		<< "Scheduling execute query task, type " << query.Type << ", table '" << query.Table << "'.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, -1), query.Priority, true);
+	/* Status updates for the same object supersede each other, merge them into the pending query. */
+	if (query.StatusUpdate && query.Object && !(query.Type & DbQueryDelete)) {
+		std::shared_ptr<DbQuery> pending = CoalesceStatusUpdate(query);
+
+		if (pending) {
+			double enqueueTime = Utility::GetTime();
+
+			GetQueue(GetQuerySession(query)).Enqueue([this, pending, enqueueTime]() {
+				RecordQueueWait(enqueueTime);
+				InternalExecuteStatusUpdate(pending);
+			}, query.Priority, true);
+		}
+
+		return;
+	}
+
+	SealStatusUpdate(query);
+
+	double enqueueTime = Utility::GetTime();
+
+	GetQueue(GetQuerySession(query)).Enqueue([this, query, enqueueTime]() {
+		RecordQueueWait(enqueueTime);
+		InternalExecuteQuery(query);
+	}, query.Priority, true);
 }
 
 void IdoMysqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& queries)
@@ -876,7 +1266,15 @@ void IdoMysqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& quer
 		<< "Scheduling multiple execute query task, type " << queries[0].Type << ", table '" << queries[0].Table << "'.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteMultipleQueries, this, queries), queries[0].Priority, true);
+	for (const DbQuery& query : queries)
+		SealStatusUpdate(query);
+
+	double enqueueTime = Utility::GetTime();
+
+	GetQueue(GetQuerySession(queries)).Enqueue([this, queries, enqueueTime]() {
+		RecordQueueWait(enqueueTime);
+		InternalExecuteMultipleQueries(queries);
+	}, queries[0].Priority, true);
 }
 
 bool IdoMysqlConnection::CanExecuteQuery(const DbQuery& query)
@@ -894,28 +1292,22 @@ bool IdoMysqlConnection::CanExecuteQuery(const DbQuery& query)
 		}
 	}
 
-	if (query.Fields) {
-		ObjectLock olock(query.Fields);
-
-		for (const Dictionary::Pair& kv : query.Fields) {
-			Value value;
-
-			if (kv.second.IsEmpty() && !kv.second.IsString())
-				continue;
-
-			if (!FieldToEscapedString(kv.first, kv.second, &value))
-				return false;
-		}
-	}
+	return query.ForEachField([this](const String& column, const Value& field) {
+		Value value;
+		return FieldToEscapedString(column, field, &value);
+	});
+}
 
-	return true;
+void IdoMysqlConnection::InternalExecuteStatusUpdate(const std::shared_ptr<DbQuery>& pending)
+{
+	InternalExecuteQuery(TakeStatusUpdate(pending));
 }
 
 void IdoMysqlConnection::InternalExecuteMultipleQueries(const std::vector<DbQuery>& queries)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!ConnectSession())
 		return;
 
 	for (const DbQuery& query : queries) {
@@ -929,7 +1321,7 @@ void IdoMysqlConnection::InternalExecuteMultipleQueries(const std::vector<DbQuer
 				<< query.Type << "', table '" << query.Table << "', queue size: '" << GetPendingQueryCount() << "'.";
 #endif /* I2_DEBUG */
 
-			m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteMultipleQueries, this, queries), query.Priority);
+			GetQueue().Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteMultipleQueries, this, queries), query.Priority);
 			return;
 		}
 	}
@@ -943,7 +1335,12 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	TraceSpan span("ido.execute");
+
+	if (span.IsSampled())
+		span.SetDetail(query.Table);
+
+	if (!ConnectSession())
 		return;
 
 	if (query.Type == DbQueryNewTransaction) {
@@ -958,7 +1355,8 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if (query.Object && query.Object->GetObject()->GetExtension("agent_check").ToBool())
 		return;
 
-	/* check if there are missing object/insert ids and re-enqueue the query */
+	/* check if there are missing object/insert ids and re-enqueue the query,
+	 * writer sessions hand it over to the primary session which maintains the ID cache */
 	if (!CanExecuteQuery(query)) {
 
 #ifdef I2_DEBUG /* I2_DEBUG */
@@ -967,7 +1365,7 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 			<< typeOverride << "', table '" << query.Table << "', queue size: '" << GetPendingQueryCount() << "'.";
 #endif /* I2_DEBUG */
 
-		m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, typeOverride), query.Priority);
+		GetQueue().Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, typeOverride), query.Priority);
 		return;
 	}
 
@@ -990,7 +1388,7 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 					<< typeOverride << "', table '" << query.Table << "', queue size: '" << GetPendingQueryCount() << "'.";
 #endif /* I2_DEBUG */
 
-				m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
+				GetQueue().Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
 				return;
 			}
 
@@ -1027,7 +1425,7 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if ((type & DbQueryInsert) && (type & DbQueryDelete)) {
 		std::ostringstream qdel;
 		qdel << "DELETE FROM " << GetTablePrefix() << query.Table << where.str();
-		AsyncQuery(qdel.str());
+		AsyncQuery(qdel.str(), IdoAsyncCallback(), query.Table, DbQueryDelete);
 
 		type = DbQueryInsert;
 	}
@@ -1052,25 +1450,20 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 		if (type == DbQueryUpdate && query.Fields->GetLength() == 0)
 			return;
 
-		ObjectLock olock(query.Fields);
-
 		bool first = true;
-		for (const Dictionary::Pair& kv : query.Fields) {
+
+		bool complete = query.ForEachField([&](const String& column, const Value& field) {
 			Value value;
 
-			if (kv.second.IsEmpty() && !kv.second.IsString())
-				continue;
-
-			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
+			if (!FieldToEscapedString(column, field, &value)) {
 
 #ifdef I2_DEBUG /* I2_DEBUG */
 				Log(LogDebug, "IdoMysqlConnection")
 					<< "Scheduling execute query task again: Cannot extract required INSERT/UPDATE fields, key '"
-					<< kv.first << "', val '" << kv.second << "', type " << typeOverride << ", table '" << query.Table << "'.";
+					<< column << "', val '" << field << "', type " << typeOverride << ", table '" << query.Table << "'.";
 #endif /* I2_DEBUG */
 
-				m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
-				return;
+				return false;
 			}
 
 			if (type == DbQueryInsert) {
@@ -1079,27 +1472,59 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 					valbuf << ", ";
 				}
 
-				colbuf << kv.first;
+				colbuf << column;
 				valbuf << value;
 			} else {
 				if (!first)
 					qbuf << ", ";
 
-				qbuf << " " << kv.first << " = " << value;
+				qbuf << " " << column << " = " << value;
 			}
 
 			if (first)
 				first = false;
+
+			return true;
+		});
+
+		if (!complete) {
+			GetQueue().Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
+			return;
 		}
 
-		if (type == DbQueryInsert)
+		if (type == DbQueryInsert) {
+			/* Rows which don't need their insert ID can be sent in batches. */
+			if (!(query.Object && (query.ConfigUpdate || query.StatusUpdate)) && !(query.Table == "notifications" && query.NotificationInsertID)) {
+				AsyncInsertQuery(query.Table, colbuf.str(), valbuf.str());
+				return;
+			}
+
 			qbuf << " (" << colbuf.str() << ") VALUES (" << valbuf.str() << ")";
+		}
 	}
 
 	if (type != DbQueryInsert)
 		qbuf << where.str();
 
-	AsyncQuery(qbuf.str(), std::bind(&IdoMysqlConnection::FinishExecuteQuery, this, query, type, upsert));
+	UpdateConfigHash(query);
+
+	AsyncQuery(qbuf.str(), std::bind(&IdoMysqlConnection::FinishExecuteQuery, this, query, type, upsert), query.Table, type);
+}
+
+void IdoMysqlConnection::ValidateInsertBatchRows(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<IdoMysqlConnection>::ValidateInsertBatchRows(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "insert_batch_rows" }, "Value must be greater than 0."));
+}
+
+void IdoMysqlConnection::ValidateInsertBatchSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<IdoMysqlConnection>::ValidateInsertBatchSize(lvalue, utils);
+
+	if (lvalue() < 1024)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "insert_batch_size" }, "Value must be at least 1024 bytes."));
 }
 
 void IdoMysqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool upsert)
@@ -1111,7 +1536,7 @@ void IdoMysqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool
 			<< "Rescheduling DELETE/INSERT query: Upsert UPDATE did not affect rows, type " << type << ", table '" << query.Table << "'.";
 #endif /* I2_DEBUG */
 
-		m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, DbQueryDelete | DbQueryInsert), query.Priority);
+		GetSession().Queue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, DbQueryDelete | DbQueryInsert), query.Priority);
 
 		return;
 	}
@@ -1128,7 +1553,7 @@ void IdoMysqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool
 		query.NotificationInsertID->SetValue(static_cast<long>(GetLastInsertID()));
 }
 
-void IdoMysqlConnection::CleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
+void IdoMysqlConnection::CleanUpExecuteQuery(const String& table, const String& time_column, double max_age, int limit)
 {
 #ifdef I2_DEBUG /* I2_DEBUG */
 		Log(LogDebug, "IdoMysqlConnection")
@@ -1136,19 +1561,31 @@ void IdoMysqlConnection::CleanUpExecuteQuery(const String& table, const String&
 			<< time_column << "'. max_age is set to '" << max_age << "'.";
 #endif /* I2_DEBUG */
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalCleanUpExecuteQuery, this, table, time_column, max_age), PriorityLow, true);
+	GetQueue().Enqueue(std::bind(&IdoMysqlConnection::InternalCleanUpExecuteQuery, this, table, time_column, max_age, limit), PriorityLow);
 }
 
-void IdoMysqlConnection::InternalCleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
+void IdoMysqlConnection::InternalCleanUpExecuteQuery(const String& table, const String& time_column, double max_age, int limit)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!GetConnected()) {
+		FinishCleanUpQuery(table, limit, 0);
 		return;
+	}
 
 	AsyncQuery("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
 		Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
-		" < FROM_UNIXTIME(" + Convert::ToString(static_cast<long>(max_age)) + ")");
+		" < FROM_UNIXTIME(" + Convert::ToString(static_cast<long>(max_age)) + ") LIMIT " + Convert::ToString(limit),
+		[this, table, limit](const IdoMysqlResult&) { FinishCleanUpQuery(table, limit, GetAffectedRows()); });
+}
+
+/**
+ * Returns an identifier for the state of the database after the
+ * connection with the given conninfo ID was made.
+ */
+String IdoMysqlConnection::GetIDCacheGeneration(const Value& connInfoID) const
+{
+	return GetHost() + ":" + Convert::ToString(GetPort()) + "/" + GetDatabase() + "/" + GetTablePrefix() + "conninfo/" + Convert::ToString(connInfoID);
 }
 
 void IdoMysqlConnection::FillIDCache(const DbType::Ptr& type)
@@ -1167,5 +1604,10 @@ void IdoMysqlConnection::FillIDCache(const DbType::Ptr& type)
 
 int IdoMysqlConnection::GetPendingQueryCount() const
 {
-	return m_QueryQueue.GetLength();
+	size_t length = 0;
+
+	for (const std::unique_ptr<IdoMysqlSession>& session : m_Sessions)
+		length += session->Queue.GetLength();
+
+	return length;
 }
@@ -26,6 +26,7 @@
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include "base/library.hpp"
+#include <atomic>
 
 namespace icinga
 {
@@ -38,6 +39,36 @@ struct IdoAsyncQuery
 {
 	String Query;
 	IdoAsyncCallback Callback;
+
+	/* Set for INSERT statements which further rows can be appended to. */
+	String BatchTable;
+	String BatchPrefix;
+	int BatchRows{0};
+
+	/* The table and query type the statistics are recorded for. */
+	String StatsTable;
+	int StatsType{0};
+};
+
+/**
+ * A database session with its own work queue. Queries for different
+ * objects are distributed over the sessions of a connection.
+ *
+ * @ingroup ido
+ */
+struct IdoMysqlSession
+{
+	WorkQueue Queue{10000000};
+
+	MYSQL Connection;
+	bool Connected{false};
+	int AffectedRows{0};
+	unsigned int MaxPacketSize{64 * 1024};
+
+	std::vector<IdoAsyncQuery> AsyncQueries;
+
+	/* Reused by Escape() */
+	std::vector<char> EscapeBuffer;
 };
 
 /**
@@ -55,6 +86,9 @@ public:
 
 	int GetPendingQueryCount() const override;
 
+	void ValidateInsertBatchRows(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateInsertBatchSize(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void OnConfigLoaded() override;
 	void Resume() override;
@@ -64,23 +98,23 @@ protected:
 	void DeactivateObject(const DbObject::Ptr& dbobj) override;
 	void ExecuteQuery(const DbQuery& query) override;
 	void ExecuteMultipleQueries(const std::vector<DbQuery>& queries) override;
-	void CleanUpExecuteQuery(const String& table, const String& time_key, double time_value) override;
+	void CleanUpExecuteQuery(const String& table, const String& time_key, double time_value, int limit) override;
 	void FillIDCache(const DbType::Ptr& type) override;
+	void BulkActivateObjects(const std::vector<DbObject::Ptr>& dbobjs) override;
 	void NewTransaction() override;
 
 private:
 	DbReference m_InstanceID;
+	String m_IDCacheGeneration;
 
-	WorkQueue m_QueryQueue{10000000};
+	std::vector<std::unique_ptr<IdoMysqlSession> > m_Sessions;
 
 	Library m_Library;
 	std::unique_ptr<MysqlInterface, MysqlInterfaceDeleter> m_Mysql;
 
-	MYSQL m_Connection;
-	int m_AffectedRows;
-	unsigned int m_MaxPacketSize;
-
-	std::vector<IdoAsyncQuery> m_AsyncQueries;
+	std::atomic<uint64_t> m_InsertBatches{0};
+	std::atomic<uint64_t> m_InsertBatchRows{0};
+	std::atomic<int> m_InsertBatchMaxRows{0};
 
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
@@ -89,10 +123,14 @@ private:
 	DbReference GetLastInsertID();
 	int GetAffectedRows();
 	String Escape(const String& s);
+	String GetIDCacheGeneration(const Value& connInfoID) const;
 	Dictionary::Ptr FetchRow(const IdoMysqlResult& result);
 	void DiscardRows(const IdoMysqlResult& result);
 
-	void AsyncQuery(const String& query, const IdoAsyncCallback& callback = IdoAsyncCallback());
+	void AsyncQuery(const String& query, const IdoAsyncCallback& callback = IdoAsyncCallback(),
+		const String& statsTable = String(), int statsType = 0);
+	void AsyncInsertQuery(const String& table, const String& columns, const String& values);
+	void EnqueueAsyncQuery(IdoAsyncQuery&& aq);
 	void FinishAsyncQueries();
 
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
@@ -101,6 +139,12 @@ private:
 
 	void Disconnect();
 	void Reconnect();
+	void Connect(MYSQL *connection);
+	bool ConnectSession();
+
+	WorkQueue& GetQueue(int session = 0) const;
+	IdoMysqlSession& GetSession() const;
+	bool IsPrimarySession() const;
 
 	void AssertOnWorkQueue();
 
@@ -110,10 +154,11 @@ private:
 	bool CanExecuteQuery(const DbQuery& query);
 
 	void InternalExecuteQuery(const DbQuery& query, int typeOverride = -1);
+	void InternalExecuteStatusUpdate(const std::shared_ptr<DbQuery>& pending);
 	void InternalExecuteMultipleQueries(const std::vector<DbQuery>& queries);
 
 	void FinishExecuteQuery(const DbQuery& query, int type, bool upsert);
-	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
+	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value, int limit);
 	void InternalNewTransaction();
 
 	void ClearTableBySession(const String& table);
@@ -31,6 +31,7 @@
 #include "base/exception.hpp"
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
+#include "base/tracing.hpp"
 #include <boost/tuple/tuple.hpp>
 #include <utility>
 
@@ -40,16 +41,20 @@ REGISTER_TYPE(IdoPgsqlConnection);
 
 REGISTER_STATSFUNCTION(IdoPgsqlConnection, &IdoPgsqlConnection::StatsFunc);
 
-IdoPgsqlConnection::IdoPgsqlConnection()
-{
-	m_QueryQueue.SetName("IdoPgsqlConnection, " + GetName());
-}
-
 void IdoPgsqlConnection::OnConfigLoaded()
 {
 	ObjectImpl<IdoPgsqlConnection>::OnConfigLoaded();
 
-	m_QueryQueue.SetName("IdoPgsqlConnection, " + GetName());
+	for (int i = 0; i < GetSessions(); i++) {
+		std::unique_ptr<IdoPgsqlSession> session(new IdoPgsqlSession());
+
+		if (i == 0)
+			session->Queue.SetName("IdoPgsqlConnection, " + GetName());
+		else
+			session->Queue.SetName("IdoPgsqlConnection, " + GetName() + ", session " + Convert::ToString(i));
+
+		m_Sessions.emplace_back(std::move(session));
+	}
 
 	Library shimLibrary{"pgsql_shim"};
 
@@ -65,15 +70,30 @@ void IdoPgsqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 	DictionaryData nodes;
 
 	for (const IdoPgsqlConnection::Ptr& idopgsqlconnection : ConfigType::GetObjectsByType<IdoPgsqlConnection>()) {
-		size_t queryQueueItems = idopgsqlconnection->m_QueryQueue.GetLength();
-		double queryQueueItemRate = idopgsqlconnection->m_QueryQueue.GetTaskCount(60) / 60.0;
+		size_t queryQueueItems = 0;
+		double queryQueueItemRate = 0;
+
+		for (const std::unique_ptr<IdoPgsqlSession>& session : idopgsqlconnection->m_Sessions) {
+			queryQueueItems += session->Queue.GetLength();
+			queryQueueItemRate += session->Queue.GetTaskCount(60) / 60.0;
+		}
 
 		nodes.emplace_back(idopgsqlconnection->GetName(), new Dictionary({
 			{ "version", idopgsqlconnection->GetSchemaVersion() },
 			{ "instance_name", idopgsqlconnection->GetInstanceName() },
 			{ "connected", idopgsqlconnection->GetConnected() },
+			{ "sessions", static_cast<int>(idopgsqlconnection->m_Sessions.size()) },
 			{ "query_queue_items", queryQueueItems },
-			{ "query_queue_item_rate", queryQueueItemRate }
+			{ "query_queue_item_rate", queryQueueItemRate },
+			{ "coalesced_status_updates", idopgsqlconnection->GetCoalescedStatusUpdates() },
+			{ "copy_batches", idopgsqlconnection->m_CopyBatches.load() },
+			{ "copy_rows", idopgsqlconnection->m_CopyRows.load() },
+			{ "pipelined_queries", idopgsqlconnection->m_PipelinedQueries.load() },
+			{ "prepared_queries", idopgsqlconnection->m_PreparedQueries.load() },
+			{ "cleanup_deleted_rows", idopgsqlconnection->GetCleanUpDeletedRows() },
+			{ "cleanup_pending_tables", idopgsqlconnection->GetCleanUpPendingTables() },
+			{ "config_dump_progress", idopgsqlconnection->GetConfigDumpProgress() },
+			{ "query_stats", idopgsqlconnection->GetQueryStats() }
 		}));
 
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_queries_rate", idopgsqlconnection->GetQueryCount(60) / 60.0));
@@ -96,14 +116,15 @@ void IdoPgsqlConnection::Resume()
 
 	SetConnected(false);
 
-	m_QueryQueue.SetExceptionCallback(std::bind(&IdoPgsqlConnection::ExceptionHandler, this, _1));
+	for (const std::unique_ptr<IdoPgsqlSession>& session : m_Sessions)
+		session->Queue.SetExceptionCallback(std::bind(&IdoPgsqlConnection::ExceptionHandler, this, _1));
 
-	m_TxTimer = new Timer();
+	m_TxTimer = new Timer("IdoPgsqlConnection transaction");
 	m_TxTimer->SetInterval(1);
 	m_TxTimer->OnTimerExpired.connect(std::bind(&IdoPgsqlConnection::TxTimerHandler, this));
 	m_TxTimer->Start();
 
-	m_ReconnectTimer = new Timer();
+	m_ReconnectTimer = new Timer("IdoPgsqlConnection reconnect");
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&IdoPgsqlConnection::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
@@ -121,8 +142,11 @@ void IdoPgsqlConnection::Pause()
 
 	DbConnection::Pause();
 
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::Disconnect, this), PriorityHigh);
-	m_QueryQueue.Join();
+	for (const std::unique_ptr<IdoPgsqlSession>& session : m_Sessions)
+		session->Queue.Enqueue(std::bind(&IdoPgsqlConnection::Disconnect, this), PriorityHigh);
+
+	for (const std::unique_ptr<IdoPgsqlSession>& session : m_Sessions)
+		session->Queue.Join();
 }
 
 void IdoPgsqlConnection::ExceptionHandler(boost::exception_ptr exp)
@@ -132,27 +156,98 @@ void IdoPgsqlConnection::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "IdoPgsqlConnection")
 		<< "Exception during database operation: " << DiagnosticInformation(std::move(exp));
 
+	IdoPgsqlSession& session = GetSession();
+
+	if (!IsPrimarySession()) {
+		if (session.Connected) {
+			m_Pgsql->finish(session.Connection);
+			session.Connected = false;
+		}
+
+		return;
+	}
+
 	if (GetConnected()) {
-		m_Pgsql->finish(m_Connection);
+		m_Pgsql->finish(session.Connection);
 		SetConnected(false);
 	}
 }
 
+/**
+ * Returns the work queue of a session.
+ *
+ * @param session The session index, 0 is the primary session.
+ * @returns The work queue.
+ */
+WorkQueue& IdoPgsqlConnection::GetQueue(int session) const
+{
+	return m_Sessions[session]->Queue;
+}
+
+/**
+ * Returns the session which belongs to the current work queue thread.
+ *
+ * @returns The session.
+ */
+IdoPgsqlSession& IdoPgsqlConnection::GetSession() const
+{
+	for (const std::unique_ptr<IdoPgsqlSession>& session : m_Sessions) {
+		if (session->Queue.IsWorkerThread())
+			return *session;
+	}
+
+	VERIFY(!"Not running on a session work queue.");
+}
+
+/**
+ * Checks whether the current work queue thread belongs to the primary
+ * session, i.e. the session which maintains the ID cache.
+ */
+bool IdoPgsqlConnection::IsPrimarySession() const
+{
+	return m_Sessions[0]->Queue.IsWorkerThread();
+}
+
 void IdoPgsqlConnection::AssertOnWorkQueue()
 {
-	ASSERT(m_QueryQueue.IsWorkerThread());
+#ifdef I2_DEBUG
+	bool worker = false;
+
+	for (const std::unique_ptr<IdoPgsqlSession>& session : m_Sessions) {
+		if (session->Queue.IsWorkerThread())
+			worker = true;
+	}
+
+	ASSERT(worker);
+#endif /* I2_DEBUG */
 }
 
 void IdoPgsqlConnection::Disconnect()
 {
 	AssertOnWorkQueue();
 
+	IdoPgsqlSession& session = GetSession();
+
+	if (!IsPrimarySession()) {
+		if (!session.Connected)
+			return;
+
+		Query("COMMIT");
+
+		m_Pgsql->finish(session.Connection);
+		session.Connected = false;
+		return;
+	}
+
 	if (!GetConnected())
 		return;
 
 	Query("COMMIT");
 
-	m_Pgsql->finish(m_Connection);
+	/* everything which changed the ID cache has been committed now */
+	SaveIDCache(m_IDCacheGeneration);
+
+	m_Pgsql->finish(session.Connection);
 	SetConnected(false);
 }
 
@@ -163,14 +258,16 @@ void IdoPgsqlConnection::TxTimerHandler()
 
 void IdoPgsqlConnection::NewTransaction()
 {
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalNewTransaction, this), PriorityHigh, true);
+	/* Each session runs its own transactions. */
+	for (const std::unique_ptr<IdoPgsqlSession>& session : m_Sessions)
+		session->Queue.Enqueue(std::bind(&IdoPgsqlConnection::InternalNewTransaction, this), PriorityHigh, true);
 }
 
 void IdoPgsqlConnection::InternalNewTransaction()
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!ConnectSession())
 		return;
 
 	Query("COMMIT");
@@ -179,7 +276,7 @@ void IdoPgsqlConnection::InternalNewTransaction()
 
 void IdoPgsqlConnection::ReconnectTimerHandler()
 {
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::Reconnect, this), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::Reconnect, this), PriorityLow);
 }
 
 void IdoPgsqlConnection::Reconnect()
@@ -190,6 +287,8 @@ void IdoPgsqlConnection::Reconnect()
 
 	double startTime = Utility::GetTime();
 
+	IdoPgsqlSession& session = GetSession();
+
 	SetShouldConnect(true);
 
 	bool reconnect = false;
@@ -200,7 +299,7 @@ void IdoPgsqlConnection::Reconnect()
 			Query("SELECT 1");
 			return;
 		} catch (const std::exception&) {
-			m_Pgsql->finish(m_Connection);
+			m_Pgsql->finish(session.Connection);
 			SetConnected(false);
 			reconnect = true;
 		}
@@ -208,56 +307,14 @@ void IdoPgsqlConnection::Reconnect()
 
 	ClearIDCache();
 
-	String host = GetHost();
-	String port = GetPort();
-	String user = GetUser();
-	String password = GetPassword();
-	String database = GetDatabase();
+	session.AsyncQueries.clear();
 
-	String sslMode = GetSslMode();
-	String sslKey = GetSslKey();
-	String sslCert = GetSslCert();
-	String sslCa = GetSslCa();
-
-	String conninfo;
+	session.Connection = Connect();
 
-	if (!host.IsEmpty())
-		conninfo += " host=" + host;
-	if (!port.IsEmpty())
-		conninfo += " port=" + port;
-	if (!user.IsEmpty())
-		conninfo += " user=" + user;
-	if (!password.IsEmpty())
-		conninfo += " password=" + password;
-	if (!database.IsEmpty())
-		conninfo += " dbname=" + database;
-
-	if (!sslMode.IsEmpty())
-		conninfo += " sslmode=" + sslMode;
-	if (!sslKey.IsEmpty())
-		conninfo += " sslkey=" + sslKey;
-	if (!sslCert.IsEmpty())
-		conninfo += " sslcert=" + sslCert;
-	if (!sslCa.IsEmpty())
-		conninfo += " sslrootcert=" + sslCa;
-
-	/* connection */
-	m_Connection = m_Pgsql->connectdb(conninfo.CStr());
-
-	if (!m_Connection)
+	if (!session.Connection)
 		return;
 
-	if (m_Pgsql->status(m_Connection) != CONNECTION_OK) {
-		String message = m_Pgsql->errorMessage(m_Connection);
-		m_Pgsql->finish(m_Connection);
-		SetConnected(false);
-
-		Log(LogCritical, "IdoPgsqlConnection")
-			<< "Connection to database '" << database << "' with user '" << user << "' on '" << host << ":" << port
-			<< "' failed: \"" << message << "\"";
-
-		BOOST_THROW_EXCEPTION(std::runtime_error(message));
-	}
+	session.PreparedStatements.clear();
 
 	SetConnected(true);
 
@@ -266,7 +323,7 @@ void IdoPgsqlConnection::Reconnect()
 	/* explicitely require legacy mode for string escaping in PostgreSQL >= 9.1
 	 * changing standard_conforming_strings to on by default
 	 */
-	if (m_Pgsql->serverVersion(m_Connection) >= 90100)
+	if (m_Pgsql->serverVersion(session.Connection) >= 90100)
 		result = Query("SET standard_conforming_strings TO off");
 
 	String dbVersionName = "idoutils";
@@ -275,7 +332,7 @@ void IdoPgsqlConnection::Reconnect()
 	Dictionary::Ptr row = FetchRow(result, 0);
 
 	if (!row) {
-		m_Pgsql->finish(m_Connection);
+		m_Pgsql->finish(session.Connection);
 		SetConnected(false);
 
 		Log(LogCritical, "IdoPgsqlConnection", "Schema does not provide any valid version! Verify your schema installation.");
@@ -288,7 +345,7 @@ void IdoPgsqlConnection::Reconnect()
 	SetSchemaVersion(version);
 
 	if (Utility::CompareVersion(IDO_COMPAT_SCHEMA_VERSION, version) < 0) {
-		m_Pgsql->finish(m_Connection);
+		m_Pgsql->finish(session.Connection);
 		SetConnected(false);
 
 		Log(LogCritical, "IdoPgsqlConnection")
@@ -342,7 +399,7 @@ void IdoPgsqlConnection::Reconnect()
 				<< "Last update by '" << endpoint_name << "' was " << status_update_age << "s ago.";
 
 			if (status_update_age < GetFailoverTimeout()) {
-				m_Pgsql->finish(m_Connection);
+				m_Pgsql->finish(session.Connection);
 				SetConnected(false);
 				SetShouldConnect(false);
 
@@ -354,7 +411,7 @@ void IdoPgsqlConnection::Reconnect()
 				Log(LogNotice, "IdoPgsqlConnection")
 					<< "Local endpoint '" << my_endpoint->GetName() << "' is not authoritative, bailing out.";
 
-				m_Pgsql->finish(m_Connection);
+				m_Pgsql->finish(session.Connection);
 				SetConnected(false);
 
 				return;
@@ -366,21 +423,34 @@ void IdoPgsqlConnection::Reconnect()
 
 	Log(LogInformation, "IdoPgsqlConnection")
 		<< "PGSQL IDO instance id: " << static_cast<long>(m_InstanceID) << " (schema version: '" + version + "')"
-		<< (!sslMode.IsEmpty() ? ", sslmode='" + sslMode + "'" : "");
+		<< (!GetSslMode().IsEmpty() ? ", sslmode='" + GetSslMode() + "'" : "");
 
 	Query("BEGIN");
 
 	/* update programstatus table */
 	UpdateProgramStatus();
 
+	/* Every connection adds a conninfo row, the saved ID cache is only valid if
+	 * the last row before ours is the one from the connection which saved it. */
+	result = Query("SELECT MAX(conninfo_id) AS conninfo_id FROM " + GetTablePrefix() + "conninfo WHERE instance_id = "
+		+ Convert::ToString(static_cast<long>(m_InstanceID)));
+	row = FetchRow(result, 0);
+
+	String lastGeneration;
+
+	if (row && !row->Get("conninfo_id").IsEmpty())
+		lastGeneration = GetIDCacheGeneration(row->Get("conninfo_id"));
+
 	/* record connection */
 	Query("INSERT INTO " + GetTablePrefix() + "conninfo " +
 		"(instance_id, connect_time, last_checkin_time, agent_name, agent_version, connect_type, data_start_time) VALUES ("
 		+ Convert::ToString(static_cast<long>(m_InstanceID)) + ", NOW(), NOW(), E'icinga2 db_ido_pgsql', E'" + Escape(Application::GetAppVersion())
 		+ "', E'" + (reconnect ? "RECONNECT" : "INITIAL") + "', NOW())");
 
+	m_IDCacheGeneration = GetIDCacheGeneration(static_cast<long>(GetSequenceValue(GetTablePrefix() + "conninfo", "conninfo_id")));
+
 	/* clear config tables for the initial config dump */
-	PrepareDatabase();
+	PrepareDatabase(lastGeneration);
 
 	std::ostringstream q1buf;
 	q1buf << "SELECT object_id, objecttype_id, name1, name2, is_active FROM " + GetTablePrefix() + "objects WHERE instance_id = " << static_cast<long>(m_InstanceID);
@@ -422,9 +492,116 @@ void IdoPgsqlConnection::Reconnect()
 
 	UpdateAllObjects();
 
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::ClearTablesBySession, this), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::ClearTablesBySession, this), PriorityLow);
 
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::FinishConnect, this, startTime), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::FinishConnect, this, startTime), PriorityLow);
+}
+
+/**
+ * Opens a database connection with the configured connection parameters.
+ *
+ * @returns The connection handle or nullptr.
+ */
+PGconn *IdoPgsqlConnection::Connect()
+{
+	String host = GetHost();
+	String port = GetPort();
+	String user = GetUser();
+	String password = GetPassword();
+	String database = GetDatabase();
+
+	String sslMode = GetSslMode();
+	String sslKey = GetSslKey();
+	String sslCert = GetSslCert();
+	String sslCa = GetSslCa();
+
+	String conninfo;
+
+	if (!host.IsEmpty())
+		conninfo += " host=" + host;
+	if (!port.IsEmpty())
+		conninfo += " port=" + port;
+	if (!user.IsEmpty())
+		conninfo += " user=" + user;
+	if (!password.IsEmpty())
+		conninfo += " password=" + password;
+	if (!database.IsEmpty())
+		conninfo += " dbname=" + database;
+
+	if (!sslMode.IsEmpty())
+		conninfo += " sslmode=" + sslMode;
+	if (!sslKey.IsEmpty())
+		conninfo += " sslkey=" + sslKey;
+	if (!sslCert.IsEmpty())
+		conninfo += " sslcert=" + sslCert;
+	if (!sslCa.IsEmpty())
+		conninfo += " sslrootcert=" + sslCa;
+
+	/* connection */
+	PGconn *connection = m_Pgsql->connectdb(conninfo.CStr());
+
+	if (!connection)
+		return nullptr;
+
+	if (m_Pgsql->status(connection) != CONNECTION_OK) {
+		String message = m_Pgsql->errorMessage(connection);
+		m_Pgsql->finish(connection);
+
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Connection to database '" << database << "' with user '" << user << "' on '" << host << ":" << port
+			<< "' failed: \"" << message << "\"";
+
+		BOOST_THROW_EXCEPTION(std::runtime_error(message));
+	}
+
+	return connection;
+}
+
+/**
+ * Checks whether the session of the current work queue is connected. Writer
+ * sessions are connected once the primary session is connected and closed
+ * when the primary session has lost its connection.
+ *
+ * @returns true if queries can be executed on the current session.
+ */
+bool IdoPgsqlConnection::ConnectSession()
+{
+	AssertOnWorkQueue();
+
+	if (IsPrimarySession())
+		return GetConnected();
+
+	IdoPgsqlSession& session = GetSession();
+
+	if (!GetConnected()) {
+		if (session.Connected) {
+			m_Pgsql->finish(session.Connection);
+			session.Connected = false;
+			session.AsyncQueries.clear();
+		}
+
+		return false;
+	}
+
+	if (session.Connected)
+		return true;
+
+	session.Connection = Connect();
+
+	if (!session.Connection)
+		return false;
+
+	session.PreparedStatements.clear();
+
+	session.Connected = true;
+
+	/* see Reconnect() */
+	if (m_Pgsql->serverVersion(session.Connection) >= 90100)
+		Query("SET standard_conforming_strings TO off");
+
+	Query("BEGIN");
+
+	return true;
 }
 
 void IdoPgsqlConnection::FinishConnect(double startTime)
@@ -459,15 +636,34 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 {
 	AssertOnWorkQueue();
 
+	/* finish all async queries to maintain the right order for queries */
+	FinishAsyncQueries();
+
+	IdoPgsqlSession& session = GetSession();
+
 	Log(LogDebug, "IdoPgsqlConnection")
 		<< "Query: " << query;
 
 	IncreaseQueryCount();
 
-	PGresult *result = m_Pgsql->exec(m_Connection, query.CStr());
+	PGresult *result = m_Pgsql->exec(session.Connection, query.CStr());
+
+	return HandleResult(result, query);
+}
+
+/**
+ * Checks the result of a query and updates the number of affected rows.
+ *
+ * @param result The result, the function takes ownership of it.
+ * @param query The query, used for error messages.
+ * @returns The result set, or an empty pointer for commands.
+ */
+IdoPgsqlResult IdoPgsqlConnection::HandleResult(PGresult *result, const String& query)
+{
+	IdoPgsqlSession& session = GetSession();
 
 	if (!result) {
-		String message = m_Pgsql->errorMessage(m_Connection);
+		String message = m_Pgsql->errorMessage(session.Connection);
 		Log(LogCritical, "IdoPgsqlConnection")
 			<< "Error \"" << message << "\" when executing query \"" << query << "\"";
 
@@ -479,7 +675,7 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 	}
 
 	char *rowCount = m_Pgsql->cmdTuples(result);
-	m_AffectedRows = atoi(rowCount);
+	session.AffectedRows = atoi(rowCount);
 
 	if (m_Pgsql->resultStatus(result) == PGRES_COMMAND_OK) {
 		m_Pgsql->clear(result);
@@ -503,6 +699,221 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 	return IdoPgsqlResult(result, std::bind(&PgsqlInterface::clear, std::cref(m_Pgsql), _1));
 }
 
+void IdoPgsqlConnection::AsyncQuery(const String& query, const IdoPgsqlAsyncCallback& callback,
+	const String& statsTable, int statsType)
+{
+	IdoPgsqlAsyncQuery aq;
+	aq.Query = query;
+	aq.StatsTable = statsTable;
+	aq.StatsType = statsType;
+	/* The callback must not immediately execute a query, but enqueue it. */
+	aq.Callback = callback;
+	EnqueueAsyncQuery(std::move(aq));
+}
+
+/**
+ * Queues a row for a COPY ... FROM STDIN statement. The row is appended to
+ * an already queued COPY for the same table and columns unless another
+ * kind of statement has been queued since then.
+ *
+ * @param table The table name (without the prefix).
+ * @param columns The comma-separated column names.
+ * @param row The row in COPY text format, including the line terminator.
+ */
+void IdoPgsqlConnection::AsyncCopyQuery(const String& table, const String& columns, const String& row)
+{
+	AssertOnWorkQueue();
+
+	IdoPgsqlSession& session = GetSession();
+
+	int maxRows = GetCopyBatchRows();
+	size_t maxBytes = GetCopyBatchSize();
+	int depth = 0;
+
+	for (auto it = session.AsyncQueries.rbegin(); it != session.AsyncQueries.rend() && depth < 64; ++it, ++depth) {
+		/* Rows must not be moved across other statements, e.g. a DELETE for the same object. */
+		if (it->CopyTable.IsEmpty())
+			break;
+
+		/* COPYs for other tables are independent of this row. */
+		if (it->CopyTable != table)
+			continue;
+
+		if (it->CopyColumns != columns || it->CopyRows >= maxRows || it->Query.GetLength() + row.GetLength() > maxBytes)
+			break;
+
+		it->Query += row;
+		it->CopyRows++;
+		return;
+	}
+
+	IdoPgsqlAsyncQuery aq;
+	aq.Query = row;
+	aq.CopyTable = table;
+	aq.CopyColumns = columns;
+	aq.CopyRows = 1;
+	EnqueueAsyncQuery(std::move(aq));
+}
+
+void IdoPgsqlConnection::EnqueueAsyncQuery(IdoPgsqlAsyncQuery&& aq)
+{
+	AssertOnWorkQueue();
+
+	IdoPgsqlSession& session = GetSession();
+
+	session.AsyncQueries.emplace_back(std::move(aq));
+
+	if (session.AsyncQueries.size() > 25000)
+		InternalNewTransaction();
+}
+
+/**
+ * Sends the queued statements. Consecutive statements are sent with a
+ * single PQsendQuery() call so that they only need one round trip, the
+ * results are read afterwards in the same order.
+ */
+void IdoPgsqlConnection::FinishAsyncQueries()
+{
+	IdoPgsqlSession& session = GetSession();
+
+	std::vector<IdoPgsqlAsyncQuery> queries;
+	session.AsyncQueries.swap(queries);
+
+	std::vector<IdoPgsqlAsyncQuery>::size_type offset = 0;
+
+	while (offset < queries.size()) {
+		if (queries[offset].CopyRows > 0) {
+			ExecuteCopy(queries[offset]);
+			offset++;
+			continue;
+		}
+
+		std::ostringstream querybuf;
+
+		std::vector<IdoPgsqlAsyncQuery>::size_type count = 0;
+		size_t num_bytes = 0;
+
+		for (std::vector<IdoPgsqlAsyncQuery>::size_type i = offset; i < queries.size(); i++) {
+			const IdoPgsqlAsyncQuery& aq = queries[i];
+
+			if (aq.CopyRows > 0)
+				break;
+
+			size_t size_query = aq.Query.GetLength() + 1;
+
+			if (count > 0 && num_bytes + size_query > static_cast<size_t>(GetCopyBatchSize()))
+				break;
+
+			if (count > 0)
+				querybuf << ";";
+
+			IncreaseQueryCount();
+			count++;
+
+			Log(LogDebug, "IdoPgsqlConnection")
+				<< "Query: " << aq.Query;
+
+			querybuf << aq.Query;
+			num_bytes += size_query;
+		}
+
+		String query = querybuf.str();
+
+		/* The results arrive one after another, each statement is accounted
+		 * the time since the previous result. */
+		double last = Utility::GetTime();
+
+		if (!m_Pgsql->sendQuery(session.Connection, query.CStr())) {
+			String message = m_Pgsql->errorMessage(session.Connection);
+			Log(LogCritical, "IdoPgsqlConnection")
+				<< "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+			BOOST_THROW_EXCEPTION(
+				database_error()
+				<< errinfo_message(message)
+				<< errinfo_database_query(query)
+			);
+		}
+
+		m_PipelinedQueries += count;
+
+		for (std::vector<IdoPgsqlAsyncQuery>::size_type i = offset; i < offset + count; i++) {
+			const IdoPgsqlAsyncQuery& aq = queries[i];
+
+			IdoPgsqlResult result = HandleResult(m_Pgsql->getResult(session.Connection), aq.Query);
+
+			double now = Utility::GetTime();
+			RecordQueryStats(aq.StatsTable, aq.StatsType, now - last, session.AffectedRows);
+			last = now;
+
+			if (aq.Callback)
+				aq.Callback(result);
+		}
+
+		/* the connection accepts new commands once all results have been read */
+		while (PGresult *result = m_Pgsql->getResult(session.Connection))
+			m_Pgsql->clear(result);
+
+		offset += count;
+	}
+}
+
+/**
+ * Sends the rows of a queued COPY statement.
+ *
+ * @param aq The queued COPY statement.
+ */
+void IdoPgsqlConnection::ExecuteCopy(const IdoPgsqlAsyncQuery& aq)
+{
+	IdoPgsqlSession& session = GetSession();
+
+	String query = "COPY " + GetTablePrefix() + aq.CopyTable + " (" + aq.CopyColumns + ") FROM STDIN";
+
+	Log(LogDebug, "IdoPgsqlConnection")
+		<< "Query: " << query << " (" << aq.CopyRows << " rows)";
+
+	IncreaseQueryCount();
+
+	double start = Utility::GetTime();
+
+	PGresult *result = m_Pgsql->exec(session.Connection, query.CStr());
+
+	if (!result || m_Pgsql->resultStatus(result) != PGRES_COPY_IN) {
+		HandleResult(result, query);
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message("COPY did not start.")
+			<< errinfo_database_query(query)
+		);
+	}
+
+	m_Pgsql->clear(result);
+
+	if (m_Pgsql->putCopyData(session.Connection, aq.Query.CStr(), aq.Query.GetLength()) != 1 ||
+		m_Pgsql->putCopyEnd(session.Connection, nullptr) != 1) {
+		String message = m_Pgsql->errorMessage(session.Connection);
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when sending data for query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	HandleResult(m_Pgsql->getResult(session.Connection), query);
+
+	RecordQueryStats(aq.CopyTable, DbQueryInsert, Utility::GetTime() - start, aq.CopyRows);
+
+	while ((result = m_Pgsql->getResult(session.Connection)))
+		m_Pgsql->clear(result);
+
+	m_CopyBatches++;
+	m_CopyRows += aq.CopyRows;
+}
+
 DbReference IdoPgsqlConnection::GetSequenceValue(const String& table, const String& column)
 {
 	AssertOnWorkQueue();
@@ -523,7 +934,7 @@ int IdoPgsqlConnection::GetAffectedRows()
 {
 	AssertOnWorkQueue();
 
-	return m_AffectedRows;
+	return GetSession().AffectedRows;
 }
 
 String IdoPgsqlConnection::Escape(const String& s)
@@ -532,16 +943,21 @@ String IdoPgsqlConnection::Escape(const String& s)
 
 	String utf8s = Utility::ValidateUTF8(s);
 
-	size_t length = utf8s.GetLength();
-	auto *to = new char[utf8s.GetLength() * 2 + 1];
+	/* PQescapeStringConn() only doubles quotes and backslashes. */
+	if (utf8s.FindFirstOf("'\\") == String::NPos && utf8s.FindFirstOf('\0') == String::NPos)
+		return utf8s;
 
-	m_Pgsql->escapeStringConn(m_Connection, to, utf8s.CStr(), length, nullptr);
+	IdoPgsqlSession& session = GetSession();
 
-	String result = String(to);
+	size_t length = utf8s.GetLength();
+
+	if (session.EscapeBuffer.size() < length * 2 + 1)
+		session.EscapeBuffer.resize(length * 2 + 1);
 
-	delete [] to;
+	char *to = session.EscapeBuffer.data();
+	size_t escapedLength = m_Pgsql->escapeStringConn(session.Connection, to, utf8s.CStr(), length, nullptr);
 
-	return result;
+	return String(to, to + escapedLength);
 }
 
 Dictionary::Ptr IdoPgsqlConnection::FetchRow(const IdoPgsqlResult& result, int row)
@@ -569,7 +985,7 @@ Dictionary::Ptr IdoPgsqlConnection::FetchRow(const IdoPgsqlResult& result, int r
 
 void IdoPgsqlConnection::ActivateObject(const DbObject::Ptr& dbobj)
 {
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalActivateObject, this, dbobj), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::InternalActivateObject, this, dbobj), PriorityLow);
 }
 
 void IdoPgsqlConnection::InternalActivateObject(const DbObject::Ptr& dbobj)
@@ -601,9 +1017,83 @@ void IdoPgsqlConnection::InternalActivateObject(const DbObject::Ptr& dbobj)
 	}
 }
 
+/**
+ * Inserts the missing objects and reactivates the existing ones with
+ * multi-row statements. This is used for the config dump after connecting
+ * which would otherwise have to wait for one INSERT per new object.
+ */
+void IdoPgsqlConnection::BulkActivateObjects(const std::vector<DbObject::Ptr>& dbobjs)
+{
+	AssertOnWorkQueue();
+
+	if (!GetConnected())
+		return;
+
+	size_t maxSize = GetCopyBatchSize();
+
+	std::ostringstream insertbuf, updatebuf;
+	int insertRows = 0, updateRows = 0;
+
+	for (auto it = dbobjs.begin(); it != dbobjs.end(); it++) {
+		const DbObject::Ptr& dbobj = *it;
+		DbReference dbref = GetObjectID(dbobj);
+
+		if (!dbref.IsValid()) {
+			insertbuf << (insertRows == 0 ? "" : ", ") << "(" << static_cast<long>(m_InstanceID) << ", " << dbobj->GetType()->GetTypeID()
+				<< ", E'" << Escape(dbobj->GetName1()) << "', ";
+
+			if (dbobj->GetName2().IsEmpty())
+				insertbuf << "NULL";
+			else
+				insertbuf << "E'" << Escape(dbobj->GetName2()) << "'";
+
+			insertbuf << ", 1)";
+			insertRows++;
+		} else {
+			updatebuf << (updateRows == 0 ? "" : ", ") << static_cast<long>(dbref);
+			updateRows++;
+
+			SetObjectActive(dbobj, true);
+		}
+
+		bool last = (it + 1 == dbobjs.end());
+
+		if (insertRows > 0 && (last || insertRows >= 1000 || insertbuf.tellp() > static_cast<std::streamoff>(maxSize))) {
+			IdoPgsqlResult result = Query("INSERT INTO " + GetTablePrefix() + "objects (instance_id, objecttype_id, name1, name2, is_active) VALUES " +
+				insertbuf.str() + " RETURNING object_id, objecttype_id, name1, name2");
+
+			Dictionary::Ptr row;
+			int index = 0;
+
+			while ((row = FetchRow(result, index))) {
+				index++;
+
+				DbType::Ptr dbtype = DbType::GetByID(row->Get("objecttype_id"));
+
+				if (!dbtype)
+					continue;
+
+				DbObject::Ptr dbobj = dbtype->GetOrCreateObjectByName(row->Get("name1"), row->Get("name2"));
+				SetObjectID(dbobj, DbReference(row->Get("object_id")));
+				SetObjectActive(dbobj, true);
+			}
+
+			insertbuf.str("");
+			insertRows = 0;
+		}
+
+		if (updateRows > 0 && (last || updateRows >= 1000)) {
+			AsyncQuery("UPDATE " + GetTablePrefix() + "objects SET is_active = 1 WHERE object_id IN (" + updatebuf.str() + ")");
+
+			updatebuf.str("");
+			updateRows = 0;
+		}
+	}
+}
+
 void IdoPgsqlConnection::DeactivateObject(const DbObject::Ptr& dbobj)
 {
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalDeactivateObject, this, dbobj), PriorityLow);
+	GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::InternalDeactivateObject, this, dbobj), PriorityLow);
 }
 
 void IdoPgsqlConnection::InternalDeactivateObject(const DbObject::Ptr& dbobj)
@@ -626,6 +1116,43 @@ void IdoPgsqlConnection::InternalDeactivateObject(const DbObject::Ptr& dbobj)
 	 * because the object is still in the database. */
 }
 
+/**
+ * Returns the name of a prepared statement for the given statement text,
+ * preparing it on the current session first if necessary.
+ *
+ * @param statement The statement with $n placeholders for the values.
+ * @param sync Whether the PREPARE has to be executed right away.
+ * @returns The statement name or an empty string if the session has
+ *          already prepared too many statements.
+ */
+String IdoPgsqlConnection::GetPreparedStatement(const String& statement, bool sync)
+{
+	AssertOnWorkQueue();
+
+	IdoPgsqlSession& session = GetSession();
+
+	auto it = session.PreparedStatements.find(statement);
+
+	if (it != session.PreparedStatements.end())
+		return it->second;
+
+	/* there's only a limited number of statement shapes, more of them are not worth caching */
+	if (session.PreparedStatements.size() >= 256)
+		return String();
+
+	String name = "icinga_stmt_" + Convert::ToString(session.PreparedStatements.size());
+	String prepare = "PREPARE " + name + " AS " + statement;
+
+	if (sync)
+		Query(prepare);
+	else
+		AsyncQuery(prepare);
+
+	session.PreparedStatements[statement] = name;
+
+	return name;
+}
+
 bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& value, Value *result)
 {
 	if (key == "instance_id") {
@@ -660,6 +1187,10 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 			dbrefcol = GetObjectID(dbobjcol);
 
 			if (!dbrefcol.IsValid()) {
+				/* only the primary session creates objects */
+				if (!IsPrimarySession())
+					return false;
+
 				InternalActivateObject(dbobjcol);
 
 				dbrefcol = GetObjectID(dbobjcol);
@@ -703,7 +1234,35 @@ void IdoPgsqlConnection::ExecuteQuery(const DbQuery& query)
 {
 	ASSERT(query.Category != DbCatInvalid);
 
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority, true);
+	TraceSpan span("ido.enqueue");
+
+	if (span.IsSampled())
+		span.SetDetail(query.Table);
+
+	/* Status updates for the same object supersede each other, merge them into the pending query. */
+	if (query.StatusUpdate && query.Object && !(query.Type & DbQueryDelete)) {
+		std::shared_ptr<DbQuery> pending = CoalesceStatusUpdate(query);
+
+		if (pending) {
+			double enqueueTime = Utility::GetTime();
+
+			GetQueue(GetQuerySession(query)).Enqueue([this, pending, enqueueTime]() {
+				RecordQueueWait(enqueueTime);
+				InternalExecuteStatusUpdate(pending);
+			}, query.Priority, true);
+		}
+
+		return;
+	}
+
+	SealStatusUpdate(query);
+
+	double enqueueTime = Utility::GetTime();
+
+	GetQueue(GetQuerySession(query)).Enqueue([this, query, enqueueTime]() {
+		RecordQueueWait(enqueueTime);
+		InternalExecuteQuery(query);
+	}, query.Priority, true);
 }
 
 void IdoPgsqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& queries)
@@ -711,7 +1270,15 @@ void IdoPgsqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& quer
 	if (queries.empty())
 		return;
 
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteMultipleQueries, this, queries), queries[0].Priority, true);
+	for (const DbQuery& query : queries)
+		SealStatusUpdate(query);
+
+	double enqueueTime = Utility::GetTime();
+
+	GetQueue(GetQuerySession(queries)).Enqueue([this, queries, enqueueTime]() {
+		RecordQueueWait(enqueueTime);
+		InternalExecuteMultipleQueries(queries);
+	}, queries[0].Priority, true);
 }
 
 bool IdoPgsqlConnection::CanExecuteQuery(const DbQuery& query)
@@ -729,35 +1296,29 @@ bool IdoPgsqlConnection::CanExecuteQuery(const DbQuery& query)
 		}
 	}
 
-	if (query.Fields) {
-		ObjectLock olock(query.Fields);
-
-		for (const Dictionary::Pair& kv : query.Fields) {
-			Value value;
-
-			if (kv.second.IsEmpty() && !kv.second.IsString())
-				continue;
-
-			if (!FieldToEscapedString(kv.first, kv.second, &value))
-				return false;
-		}
-	}
+	return query.ForEachField([this](const String& column, const Value& field) {
+		Value value;
+		return FieldToEscapedString(column, field, &value);
+	});
+}
 
-	return true;
+void IdoPgsqlConnection::InternalExecuteStatusUpdate(const std::shared_ptr<DbQuery>& pending)
+{
+	InternalExecuteQuery(TakeStatusUpdate(pending));
 }
 
 void IdoPgsqlConnection::InternalExecuteMultipleQueries(const std::vector<DbQuery>& queries)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!ConnectSession())
 		return;
 
 	for (const DbQuery& query : queries) {
 		ASSERT(query.Type == DbQueryNewTransaction || query.Category != DbCatInvalid);
 
 		if (!CanExecuteQuery(query)) {
-			m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteMultipleQueries, this, queries), query.Priority);
+			GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteMultipleQueries, this, queries), query.Priority);
 			return;
 		}
 	}
@@ -771,7 +1332,12 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	TraceSpan span("ido.execute");
+
+	if (span.IsSampled())
+		span.SetDetail(query.Table);
+
+	if (!ConnectSession())
 		return;
 
 	if (query.Type == DbQueryNewTransaction) {
@@ -786,15 +1352,21 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if (query.Object && query.Object->GetObject()->GetExtension("agent_check").ToBool())
 		return;
 
-	/* check if there are missing object/insert ids and re-enqueue the query */
+	/* check if there are missing object/insert ids and re-enqueue the query,
+	 * writer sessions hand it over to the primary session which maintains the ID cache */
 	if (!CanExecuteQuery(query)) {
-		m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, typeOverride), query.Priority);
+		GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, typeOverride), query.Priority);
 		return;
 	}
 
 	std::ostringstream qbuf, where;
 	int type;
 
+	/* The statement with $n placeholders and its parameters for EXECUTE. */
+	std::ostringstream pbuf;
+	std::vector<String> whereColumns;
+	std::vector<Value> params, whereParams;
+
 	if (query.WhereCriteria) {
 		where << " WHERE ";
 
@@ -804,7 +1376,7 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 		for (const Dictionary::Pair& kv : query.WhereCriteria) {
 			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
-				m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
+				GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
 				return;
 			}
 
@@ -813,6 +1385,9 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 			where << kv.first << " = " << value;
 
+			whereColumns.push_back(kv.first);
+			whereParams.push_back(value);
+
 			if (first)
 				first = false;
 		}
@@ -841,7 +1416,7 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if ((type & DbQueryInsert) && (type & DbQueryDelete)) {
 		std::ostringstream qdel;
 		qdel << "DELETE FROM " << GetTablePrefix() << query.Table << where.str();
-		Query(qdel.str());
+		AsyncQuery(qdel.str(), IdoPgsqlAsyncCallback(), query.Table, DbQueryDelete);
 
 		type = DbQueryInsert;
 	}
@@ -849,35 +1424,41 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	switch (type) {
 		case DbQueryInsert:
 			qbuf << "INSERT INTO " << GetTablePrefix() << query.Table;
+			pbuf << qbuf.str();
 			break;
 		case DbQueryUpdate:
 			qbuf << "UPDATE " << GetTablePrefix() << query.Table << " SET";
+			pbuf << qbuf.str();
 			break;
 		case DbQueryDelete:
 			qbuf << "DELETE FROM " << GetTablePrefix() << query.Table;
+			pbuf << qbuf.str();
 			break;
 		default:
 			VERIFY(!"Invalid query type.");
 	}
 
+	/* Inserts which provide an insert ID have to be executed right away. */
+	bool sync = (type == DbQueryInsert && query.Object && query.ConfigUpdate) ||
+		(type == DbQueryInsert && query.Table == "notifications" && query.NotificationInsertID);
+
+	/* Rows which don't need a callback can be sent with COPY. */
+	bool copy = type == DbQueryInsert && !sync && !(query.Object && query.StatusUpdate) && GetCopyBatchRows() > 1;
+
+	String copyrow;
+
 	if (type == DbQueryInsert || type == DbQueryUpdate) {
-		std::ostringstream colbuf, valbuf;
+		std::ostringstream colbuf, valbuf, pvalbuf;
 
 		if (type == DbQueryUpdate && query.Fields->GetLength() == 0)
 			return;
 
-		ObjectLock olock(query.Fields);
-
 		Value value;
 		bool first = true;
-		for (const Dictionary::Pair& kv : query.Fields) {
-			if (kv.second.IsEmpty() && !kv.second.IsString())
-				continue;
 
-			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
-				m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
-				return;
-			}
+		bool complete = query.ForEachField([&](const String& column, const Value& field) {
+			if (!FieldToEscapedString(column, field, &value))
+				return false;
 
 			if (type == DbQueryInsert) {
 				if (!first) {
@@ -885,34 +1466,97 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 					valbuf << ", ";
 				}
 
-				colbuf << kv.first;
+				colbuf << column;
 				valbuf << value;
+
+				params.push_back(value);
+				pvalbuf << (first ? "" : ", ") << "$" << params.size();
+
+				if (copy) {
+					String copyvalue;
+
+					if (FieldToCopyString(field, value, &copyvalue))
+						copyrow += (first ? "" : "\t") + copyvalue;
+					else
+						copy = false;
+				}
 			} else {
 				if (!first)
 					qbuf << ", ";
 
-				qbuf << " " << kv.first << " = " << value;
+				qbuf << " " << column << " = " << value;
+
+				params.push_back(value);
+				pbuf << (first ? "" : ",") << " " << column << " = $" << params.size();
 			}
 
 			if (first)
 				first = false;
+
+			return true;
+		});
+
+		if (!complete) {
+			GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
+			return;
 		}
 
-		if (type == DbQueryInsert)
+		if (type == DbQueryInsert) {
+			if (copy && !first) {
+				AsyncCopyQuery(query.Table, colbuf.str(), copyrow + "\n");
+				return;
+			}
+
 			qbuf << " (" << colbuf.str() << ") VALUES (" << valbuf.str() << ")";
+			pbuf << " (" << colbuf.str() << ") VALUES (" << pvalbuf.str() << ")";
+		}
 	}
 
-	if (type != DbQueryInsert)
+	if (type != DbQueryInsert) {
 		qbuf << where.str();
 
-	Query(qbuf.str());
+		/* WHERE parameters follow the SET parameters */
+		for (size_t i = 0; i < whereColumns.size(); i++) {
+			params.push_back(whereParams[i]);
+			pbuf << (i == 0 ? " WHERE " : " AND ") << whereColumns[i] << " = $" << params.size();
+		}
+	}
 
-	if (upsert && GetAffectedRows() == 0) {
-		InternalExecuteQuery(query, DbQueryDelete | DbQueryInsert);
+	String statement = qbuf.str();
+
+	if (GetEnablePreparedStatements() && !params.empty()) {
+		String name = GetPreparedStatement(pbuf.str(), sync);
+
+		if (!name.IsEmpty()) {
+			std::ostringstream ebuf;
+			ebuf << "EXECUTE " << name << "(";
+
+			for (size_t i = 0; i < params.size(); i++)
+				ebuf << (i == 0 ? "" : ", ") << params[i];
+
+			ebuf << ")";
+
+			statement = ebuf.str();
+			m_PreparedQueries++;
+		}
+	}
 
+	UpdateConfigHash(query);
+
+	if (!sync) {
+		AsyncQuery(statement, std::bind(&IdoPgsqlConnection::FinishExecuteQuery, this, query, type, upsert), query.Table, type);
 		return;
 	}
 
+	/* don't account the queued statements to this one */
+	FinishAsyncQueries();
+
+	double start = Utility::GetTime();
+
+	Query(statement);
+
+	RecordQueryStats(query.Table, type, Utility::GetTime() - start, GetAffectedRows());
+
 	if (type == DbQueryInsert && query.Object) {
 		if (query.ConfigUpdate) {
 			String idField = query.IdColumn;
@@ -933,21 +1577,139 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	}
 }
 
-void IdoPgsqlConnection::CleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
+void IdoPgsqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool upsert)
+{
+	if (upsert && GetAffectedRows() == 0) {
+		GetSession().Queue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, DbQueryDelete | DbQueryInsert), query.Priority);
+
+		return;
+	}
+
+	if (type == DbQueryInsert && query.Object && query.StatusUpdate)
+		SetStatusUpdate(query.Object, true);
+}
+
+/**
+ * Converts a field value for COPY ... FROM STDIN.
+ *
+ * @param value The field value.
+ * @param escaped The value returned by FieldToEscapedString().
+ * @param result The value in COPY text format.
+ * @returns false if the value can only be used in an INSERT statement.
+ */
+bool IdoPgsqlConnection::FieldToCopyString(const Value& value, const Value& escaped, String *result)
+{
+	if (DbValue::IsTimestampNow(value))
+		return false;
+
+	Value rawvalue = DbValue::ExtractValue(value);
+
+	if (DbValue::IsTimestamp(value)) {
+		/* same as TO_TIMESTAMP(ts) AT TIME ZONE 'UTC' */
+		auto ts = static_cast<time_t>(static_cast<long>(rawvalue));
+		tm tmthen;
+
+#ifdef _MSC_VER
+		tm *temp = gmtime(&ts);
+
+		if (!temp)
+			return false;
+
+		tmthen = *temp;
+#else /* _MSC_VER */
+		if (!gmtime_r(&ts, &tmthen))
+			return false;
+#endif /* _MSC_VER */
+
+		char timestamp[64];
+		strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tmthen);
+		*result = timestamp;
+		return true;
+	}
+
+	/* object IDs, insert IDs, instance_id and session_token */
+	if (!escaped.IsString()) {
+		*result = Convert::ToString(escaped);
+		return true;
+	}
+
+	String text;
+
+	if (rawvalue.IsBoolean())
+		text = Convert::ToString(Convert::ToLong(rawvalue));
+	else
+		text = Utility::ValidateUTF8(rawvalue);
+
+	String copyvalue;
+
+	for (char ch : text) {
+		switch (ch) {
+			case '\\':
+				copyvalue += "\\\\";
+				break;
+			case '\n':
+				copyvalue += "\\n";
+				break;
+			case '\r':
+				copyvalue += "\\r";
+				break;
+			case '\t':
+				copyvalue += "\\t";
+				break;
+			default:
+				copyvalue += ch;
+		}
+	}
+
+	*result = copyvalue;
+	return true;
+}
+
+void IdoPgsqlConnection::ValidateCopyBatchRows(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<IdoPgsqlConnection>::ValidateCopyBatchRows(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "copy_batch_rows" }, "Value must be greater than 0."));
+}
+
+void IdoPgsqlConnection::ValidateCopyBatchSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
 {
-	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalCleanUpExecuteQuery, this, table, time_column, max_age), PriorityLow, true);
+	ObjectImpl<IdoPgsqlConnection>::ValidateCopyBatchSize(lvalue, utils);
+
+	if (lvalue() < 1024)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "copy_batch_size" }, "Value must be at least 1024 bytes."));
 }
 
-void IdoPgsqlConnection::InternalCleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
+void IdoPgsqlConnection::CleanUpExecuteQuery(const String& table, const String& time_column, double max_age, int limit)
+{
+	GetQueue().Enqueue(std::bind(&IdoPgsqlConnection::InternalCleanUpExecuteQuery, this, table, time_column, max_age, limit), PriorityLow);
+}
+
+void IdoPgsqlConnection::InternalCleanUpExecuteQuery(const String& table, const String& time_column, double max_age, int limit)
 {
 	AssertOnWorkQueue();
 
-	if (!GetConnected())
+	if (!GetConnected()) {
+		FinishCleanUpQuery(table, limit, 0);
 		return;
+	}
 
-	Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
-		Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
-		" < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ")");
+	/* PostgreSQL doesn't support DELETE ... LIMIT */
+	AsyncQuery("DELETE FROM " + GetTablePrefix() + table + " WHERE ctid = ANY(ARRAY(SELECT ctid FROM " +
+		GetTablePrefix() + table + " WHERE instance_id = " + Convert::ToString(static_cast<long>(m_InstanceID)) +
+		" AND " + time_column + " < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ")" +
+		" LIMIT " + Convert::ToString(limit) + "))",
+		[this, table, limit](const IdoPgsqlResult&) { FinishCleanUpQuery(table, limit, GetAffectedRows()); });
+}
+
+/**
+ * Returns an identifier for the state of the database after the
+ * connection with the given conninfo ID was made.
+ */
+String IdoPgsqlConnection::GetIDCacheGeneration(const Value& connInfoID) const
+{
+	return GetHost() + ":" + Convert::ToString(GetPort()) + "/" + GetDatabase() + "/" + GetTablePrefix() + "conninfo/" + Convert::ToString(connInfoID);
 }
 
 void IdoPgsqlConnection::FillIDCache(const DbType::Ptr& type)
@@ -968,5 +1730,10 @@ void IdoPgsqlConnection::FillIDCache(const DbType::Ptr& type)
 
 int IdoPgsqlConnection::GetPendingQueryCount() const
 {
-	return m_QueryQueue.GetLength();
+	size_t length = 0;
+
+	for (const std::unique_ptr<IdoPgsqlSession>& session : m_Sessions)
+		length += session->Queue.GetLength();
+
+	return length;
 }
@@ -26,12 +26,54 @@
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include "base/library.hpp"
+#include <atomic>
+#include <map>
 
 namespace icinga
 {
 
 typedef std::shared_ptr<PGresult> IdoPgsqlResult;
 
+typedef std::function<void (const IdoPgsqlResult&)> IdoPgsqlAsyncCallback;
+
+struct IdoPgsqlAsyncQuery
+{
+	String Query;
+	IdoPgsqlAsyncCallback Callback;
+
+	/* Set for rows which are sent with COPY ... FROM STDIN, Query contains the data. */
+	String CopyTable;
+	String CopyColumns;
+	int CopyRows{0};
+
+	/* The table and query type the statistics are recorded for. */
+	String StatsTable;
+	int StatsType{0};
+};
+
+/**
+ * A database session with its own work queue. Queries for different
+ * objects are distributed over the sessions of a connection.
+ *
+ * @ingroup ido
+ */
+struct IdoPgsqlSession
+{
+	WorkQueue Queue{1000000};
+
+	PGconn *Connection{nullptr};
+	bool Connected{false};
+	int AffectedRows{0};
+
+	std::vector<IdoPgsqlAsyncQuery> AsyncQueries;
+
+	/* Reused by Escape() */
+	std::vector<char> EscapeBuffer;
+
+	/* Statement names by statement shape, valid for the current connection only. */
+	std::map<String, String> PreparedStatements;
+};
+
 /**
  * An IDO pgSQL database connection.
  *
@@ -43,12 +85,13 @@ public:
 	DECLARE_OBJECT(IdoPgsqlConnection);
 	DECLARE_OBJECTNAME(IdoPgsqlConnection);
 
-	IdoPgsqlConnection();
-
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
 	int GetPendingQueryCount() const override;
 
+	void ValidateCopyBatchRows(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateCopyBatchSize(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void OnConfigLoaded() override;
 	void Resume() override;
@@ -58,37 +101,58 @@ protected:
 	void DeactivateObject(const DbObject::Ptr& dbobj) override;
 	void ExecuteQuery(const DbQuery& query) override;
 	void ExecuteMultipleQueries(const std::vector<DbQuery>& queries) override;
-	void CleanUpExecuteQuery(const String& table, const String& time_key, double time_value) override;
+	void CleanUpExecuteQuery(const String& table, const String& time_key, double time_value, int limit) override;
 	void FillIDCache(const DbType::Ptr& type) override;
+	void BulkActivateObjects(const std::vector<DbObject::Ptr>& dbobjs) override;
 	void NewTransaction() override;
 
 private:
 	DbReference m_InstanceID;
+	String m_IDCacheGeneration;
 
-	WorkQueue m_QueryQueue{1000000};
+	std::vector<std::unique_ptr<IdoPgsqlSession> > m_Sessions;
 
 	Library m_Library;
 	std::unique_ptr<PgsqlInterface, PgsqlInterfaceDeleter> m_Pgsql;
 
-	PGconn *m_Connection;
-	int m_AffectedRows;
+	std::atomic<uint64_t> m_CopyBatches{0};
+	std::atomic<uint64_t> m_CopyRows{0};
+	std::atomic<uint64_t> m_PipelinedQueries{0};
+	std::atomic<uint64_t> m_PreparedQueries{0};
 
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
 	IdoPgsqlResult Query(const String& query);
+	IdoPgsqlResult HandleResult(PGresult *result, const String& query);
 	DbReference GetSequenceValue(const String& table, const String& column);
 	int GetAffectedRows();
 	String Escape(const String& s);
+	String GetIDCacheGeneration(const Value& connInfoID) const;
 	Dictionary::Ptr FetchRow(const IdoPgsqlResult& result, int row);
 
+	void AsyncQuery(const String& query, const IdoPgsqlAsyncCallback& callback = IdoPgsqlAsyncCallback(),
+		const String& statsTable = String(), int statsType = 0);
+	void AsyncCopyQuery(const String& table, const String& columns, const String& row);
+	void EnqueueAsyncQuery(IdoPgsqlAsyncQuery&& aq);
+	void FinishAsyncQueries();
+	void ExecuteCopy(const IdoPgsqlAsyncQuery& aq);
+	String GetPreparedStatement(const String& statement, bool sync);
+
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
+	bool FieldToCopyString(const Value& value, const Value& escaped, String *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
 
 	void Disconnect();
 	void InternalNewTransaction();
 	void Reconnect();
+	PGconn *Connect();
+	bool ConnectSession();
+
+	WorkQueue& GetQueue(int session = 0) const;
+	IdoPgsqlSession& GetSession() const;
+	bool IsPrimarySession() const;
 
 	void AssertOnWorkQueue();
 
@@ -100,8 +164,10 @@ private:
 	bool CanExecuteQuery(const DbQuery& query);
 
 	void InternalExecuteQuery(const DbQuery& query, int typeOverride = -1);
+	void FinishExecuteQuery(const DbQuery& query, int type, bool upsert);
+	void InternalExecuteStatusUpdate(const std::shared_ptr<DbQuery>& pending);
 	void InternalExecuteMultipleQueries(const std::vector<DbQuery>& queries);
-	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
+	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value, int limit);
 
 	void ClearTableBySession(const String& table);
 	void ClearTablesBySession();
@@ -30,8 +30,8 @@ INITIALIZE_ONCE(&ApiEvents::StaticInitialize);
 
 void ApiEvents::StaticInitialize()
 {
-	Checkable::OnNewCheckResult.connect(&ApiEvents::CheckResultHandler);
-	Checkable::OnStateChange.connect(&ApiEvents::StateChangeHandler);
+	Checkable::OnNewCheckResult.connect(&ApiEvents::CheckResultHandler, "ApiEvents::CheckResultHandler");
+	Checkable::OnStateChange.connect(&ApiEvents::StateChangeHandler, "ApiEvents::StateChangeHandler");
 	Checkable::OnNotificationSentToAllUsers.connect(&ApiEvents::NotificationSentToAllUsersHandler);
 
 	Checkable::OnFlappingChanged.connect(&ApiEvents::FlappingChangedHandler);
@@ -71,9 +71,7 @@ void ApiEvents::CheckResultHandler(const Checkable::Ptr& checkable, const CheckR
 
 	result->Set("check_result", Serialize(cr));
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::StateChangeHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, StateType type, const MessageOrigin::Ptr& origin)
@@ -101,9 +99,7 @@ void ApiEvents::StateChangeHandler(const Checkable::Ptr& checkable, const CheckR
 	result->Set("state_type", checkable->GetStateType());
 	result->Set("check_result", Serialize(cr));
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::NotificationSentToAllUsersHandler(const Notification::Ptr& notification,
@@ -141,9 +137,7 @@ void ApiEvents::NotificationSentToAllUsersHandler(const Notification::Ptr& notif
 	result->Set("text", text);
 	result->Set("check_result", Serialize(cr));
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::FlappingChangedHandler(const Checkable::Ptr& checkable, const MessageOrigin::Ptr& origin)
@@ -174,9 +168,7 @@ void ApiEvents::FlappingChangedHandler(const Checkable::Ptr& checkable, const Me
 	result->Set("threshold_low", checkable->GetFlappingThresholdLow());
 	result->Set("threshold_high", checkable->GetFlappingThresholdHigh());
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::AcknowledgementSetHandler(const Checkable::Ptr& checkable,
@@ -212,9 +204,7 @@ void ApiEvents::AcknowledgementSetHandler(const Checkable::Ptr& checkable,
 	result->Set("persistent", persistent);
 	result->Set("expiry", expiry);
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::AcknowledgementClearedHandler(const Checkable::Ptr& checkable, const MessageOrigin::Ptr& origin)
@@ -241,9 +231,7 @@ void ApiEvents::AcknowledgementClearedHandler(const Checkable::Ptr& checkable, c
 	result->Set("state", service ? static_cast<int>(service->GetState()) : static_cast<int>(host->GetState()));
 	result->Set("state_type", checkable->GetStateType());
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 
 	result->Set("acknowledgement_type", AcknowledgementNone);
 }
@@ -263,9 +251,7 @@ void ApiEvents::CommentAddedHandler(const Comment::Ptr& comment)
 		{ "comment", Serialize(comment, FAConfig | FAState) }
 	});
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::CommentRemovedHandler(const Comment::Ptr& comment)
@@ -283,9 +269,7 @@ void ApiEvents::CommentRemovedHandler(const Comment::Ptr& comment)
 		{ "comment", Serialize(comment, FAConfig | FAState) }
 	});
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::DowntimeAddedHandler(const Downtime::Ptr& downtime)
@@ -303,9 +287,7 @@ void ApiEvents::DowntimeAddedHandler(const Downtime::Ptr& downtime)
 		{ "downtime", Serialize(downtime, FAConfig | FAState) }
 	});
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::DowntimeRemovedHandler(const Downtime::Ptr& downtime)
@@ -323,9 +305,7 @@ void ApiEvents::DowntimeRemovedHandler(const Downtime::Ptr& downtime)
 		{ "downtime", Serialize(downtime, FAConfig | FAState) }
 	});
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::DowntimeStartedHandler(const Downtime::Ptr& downtime)
@@ -343,9 +323,7 @@ void ApiEvents::DowntimeStartedHandler(const Downtime::Ptr& downtime)
 		{ "downtime", Serialize(downtime, FAConfig | FAState) }
 	});
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
 
 void ApiEvents::DowntimeTriggeredHandler(const Downtime::Ptr& downtime)
@@ -363,7 +341,5 @@ void ApiEvents::DowntimeTriggeredHandler(const Downtime::Ptr& downtime)
 		{ "downtime", Serialize(downtime, FAConfig | FAState) }
 	});
 
-	for (const EventQueue::Ptr& queue : queues) {
-		queue->ProcessEvent(result);
-	}
+	EventQueue::DispatchEvent(new EncodedMessage(result));
 }
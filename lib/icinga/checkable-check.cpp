@@ -24,19 +24,22 @@
 #include "icinga/icingaapplication.hpp"
 #include "icinga/cib.hpp"
 #include "icinga/clusterevents.hpp"
+#include "icinga/checkresultbatcher.hpp"
 #include "remote/messageorigin.hpp"
 #include "remote/apilistener.hpp"
 #include "base/objectlock.hpp"
+#include "base/perfdatavalue.hpp"
 #include "base/logger.hpp"
 #include "base/convert.hpp"
 #include "base/utility.hpp"
 #include "base/context.hpp"
+#include "base/tracing.hpp"
 
 using namespace icinga;
 
-boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> Checkable::OnNewCheckResult;
-boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> Checkable::OnStateChange;
-boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, std::set<Checkable::Ptr>, const MessageOrigin::Ptr&)> Checkable::OnReachabilityChanged;
+Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> Checkable::OnNewCheckResult("Checkable::OnNewCheckResult");
+Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> Checkable::OnStateChange("Checkable::OnStateChange");
+Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const std::set<Checkable::Ptr>&, const MessageOrigin::Ptr&)> Checkable::OnReachabilityChanged("Checkable::OnReachabilityChanged");
 boost::signals2::signal<void (const Checkable::Ptr&, NotificationType, const CheckResult::Ptr&, const String&, const String&, const MessageOrigin::Ptr&)> Checkable::OnNotificationsRequested;
 boost::signals2::signal<void (const Checkable::Ptr&)> Checkable::OnNextCheckUpdated;
 
@@ -107,8 +110,73 @@ double Checkable::GetLastCheck() const
 	return schedule_end;
 }
 
+std::atomic<unsigned long> Checkable::m_DeduplicatedCheckResults{0};
+
+static String PerfdataItemToString(const Value& item)
+{
+	if (item.IsObjectType<PerfdataValue>())
+		return static_cast<PerfdataValue::Ptr>(item)->Format();
+
+	return item;
+}
+
+static bool IsSamePerfdata(const Array::Ptr& a, const Array::Ptr& b)
+{
+	size_t length = a ? a->GetLength() : 0;
+
+	if (length != (b ? b->GetLength() : 0))
+		return false;
+
+	for (size_t i = 0; i < length; i++) {
+		if (PerfdataItemToString(a->Get(i)) != PerfdataItemToString(b->Get(i)))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Returns whether a passive check result repeats the previous one and may
+ * skip the full processing, see passive_dedup_window. Must be called with
+ * the object lock held.
+ */
+bool Checkable::IsDuplicateCheckResult(const CheckResult::Ptr& old_cr, const CheckResult::Ptr& cr, double now)
+{
+	double window = GetPassiveDedupWindow();
+
+	if (window <= 0 || cr->GetActive())
+		return false;
+
+	bool duplicate = old_cr
+		&& now - m_LastFullCheckResult < window
+		&& m_SuppressedCheckResults < GetPassiveDedupLimit()
+		&& cr->GetState() == old_cr->GetState()
+		&& cr->GetExitStatus() == old_cr->GetExitStatus()
+		&& cr->GetOutput() == old_cr->GetOutput()
+		&& IsSamePerfdata(cr->GetPerformanceData(), old_cr->GetPerformanceData());
+
+	if (duplicate) {
+		m_SuppressedCheckResults++;
+	} else {
+		m_LastFullCheckResult = now;
+		m_SuppressedCheckResults = 0;
+	}
+
+	return duplicate;
+}
+
+unsigned long Checkable::GetDeduplicatedCheckResults()
+{
+	return m_DeduplicatedCheckResults;
+}
+
 void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin)
 {
+	TraceSpan span("checkable.process_check_result");
+
+	if (span.IsSampled())
+		span.SetDetail(GetName());
+
 	{
 		ObjectLock olock(this);
 		m_CheckRunning = false;
@@ -147,7 +215,7 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 		if (listener) {
 			/* send message back to its origin */
 			Dictionary::Ptr message = ClusterEvents::MakeCheckResultMessage(this, cr);
-			listener->SyncSendMessage(command_endpoint, message);
+			ClusterEvents::SendBatchableMessage(command_endpoint, message);
 		}
 
 		return;
@@ -172,6 +240,22 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 	if (old_cr && cr->GetExecutionStart() < old_cr->GetExecutionStart())
 		return;
 
+	/* Identical passive check results only refresh the last check and the freshness. */
+	if (IsDuplicateCheckResult(old_cr, cr, now)) {
+		m_DeduplicatedCheckResults++;
+
+		cr->SetVarsBefore(old_cr->GetVarsAfter());
+		cr->SetVarsAfter(old_cr->GetVarsAfter());
+		SetLastCheckResult(cr);
+
+		double ttl = cr->GetTtl();
+		SetNextCheck(Utility::GetTime() + (ttl > 0 ? ttl : GetCheckInterval()), false, origin);
+
+		PublishSnapshot();
+
+		return;
+	}
+
 	/* The ExecuteCheck function already sets the old state, but we need to do it again
 	 * in case this was a passive check result. */
 	SetLastStateRaw(old_state);
@@ -350,8 +434,14 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 		SetNextCheck(Utility::GetTime() + offset, false, origin);
 	}
 
+	PublishSnapshot();
+
 	olock.Unlock();
 
+	/* Dependencies on this checkable have to be evaluated again. */
+	if (!old_cr || old_state != new_state || old_stateType != GetStateType())
+		InvalidateReachability();
+
 #ifdef I2_DEBUG /* I2_DEBUG */
 	Log(LogDebug, "Checkable")
 		<< "Flapping: Checkable " << GetName()
@@ -363,6 +453,7 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 #endif /* I2_DEBUG */
 
 	OnNewCheckResult(this, cr, origin);
+	CheckResultBatcher::Add(this, cr, origin);
 
 	/* signal status updates to for example db_ido */
 	OnStateChanged(this);
@@ -414,6 +505,8 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 		if (!IsPaused())
 			OnNotificationsRequested(this, recovery ? NotificationRecovery : NotificationProblem, cr, "", "", nullptr);
 	}
+
+	CIB::UpdateCheckStatistics(this, cr, Utility::GetTime() - now);
 }
 
 void Checkable::ExecuteRemoteCheck(const Dictionary::Ptr& resolvedMacros)
@@ -495,10 +588,7 @@ void Checkable::ExecuteCheck()
 
 			params->Set("macros", macros);
 
-			ApiListener::Ptr listener = ApiListener::GetInstance();
-
-			if (listener)
-				listener->SyncSendMessage(endpoint, message);
+			ClusterEvents::SendBatchableMessage(endpoint, message);
 
 			/* Re-schedule the check so we don't run it again until after we've received
 			 * a check result from the remote instance. The check will be re-scheduled
@@ -576,3 +666,14 @@ void Checkable::AquirePendingCheckSlot(int maxPendingChecks)
 
 	m_PendingChecks++;
 }
+
+bool Checkable::TryAquirePendingCheckSlot(int maxPendingChecks)
+{
+	boost::mutex::scoped_lock lock(m_StatsMutex);
+
+	if (m_PendingChecks >= maxPendingChecks)
+		return false;
+
+	m_PendingChecks++;
+	return true;
+}
@@ -19,20 +19,46 @@
 
 #include "icinga/service.hpp"
 #include "icinga/dependency.hpp"
+#include "icinga/cib.hpp"
+#include "base/initialize.hpp"
 #include "base/logger.hpp"
 
 using namespace icinga;
 
+INITIALIZE_ONCE([]() {
+	/* Cached reachability depends on the configuration of the dependencies. */
+	auto invalidate = [](const Dependency::Ptr& dependency, const Value&) {
+		Checkable::Ptr child = dependency->GetChild();
+
+		if (child)
+			child->InvalidateReachability();
+	};
+
+	Dependency::OnPeriodRawChanged.connect(invalidate);
+	Dependency::OnStateFilterChanged.connect(invalidate);
+	Dependency::OnIgnoreSoftStatesChanged.connect(invalidate);
+	Dependency::OnDisableChecksChanged.connect(invalidate);
+	Dependency::OnDisableNotificationsChanged.connect(invalidate);
+});
+
 void Checkable::AddDependency(const Dependency::Ptr& dep)
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	m_Dependencies.insert(dep);
+	{
+		boost::mutex::scoped_lock lock(m_DependencyMutex);
+		m_Dependencies.insert(dep);
+	}
+
+	InvalidateReachability();
 }
 
 void Checkable::RemoveDependency(const Dependency::Ptr& dep)
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	m_Dependencies.erase(dep);
+	{
+		boost::mutex::scoped_lock lock(m_DependencyMutex);
+		m_Dependencies.erase(dep);
+	}
+
+	InvalidateReachability();
 }
 
 std::vector<Dependency::Ptr> Checkable::GetDependencies() const
@@ -59,46 +85,149 @@ std::vector<Dependency::Ptr> Checkable::GetReverseDependencies() const
 	return std::vector<Dependency::Ptr>(m_ReverseDependencies.begin(), m_ReverseDependencies.end());
 }
 
+/**
+ * Checks whether the parents and dependencies of this checkable are
+ * available. The result is cached until InvalidateReachability() is called
+ * for this checkable or one of its parents.
+ *
+ * @param dt The dependency type.
+ * @param failedDependency Returns the dependency which failed, if any.
+ * @param rstack The recursion depth.
+ * @returns true if the checkable is reachable.
+ */
 bool Checkable::IsReachable(DependencyType dt, Dependency::Ptr *failedDependency, int rstack) const
 {
+	bool cacheable;
+	return IsReachableInternal(dt, failedDependency, rstack, &cacheable);
+}
+
+bool Checkable::IsReachableInternal(DependencyType dt, Dependency::Ptr *failedDependency, int rstack, bool *cacheable) const
+{
+	ReachabilityCacheEntry& entry = m_Reachability[dt];
+	uint_fast64_t generation;
+
+	{
+		boost::mutex::scoped_lock lock(m_ReachabilityMutex);
+
+		if (entry.Valid) {
+			if (failedDependency)
+				*failedDependency = entry.FailedDependency;
+
+			*cacheable = true;
+			return entry.Reachable;
+		}
+
+		generation = m_ReachabilityGeneration;
+	}
+
 	if (rstack > 20) {
 		Log(LogWarning, "Checkable")
 			<< "Too many nested dependencies for service '" << GetName() << "': Dependency failed.";
 
+		*cacheable = false;
 		return false;
 	}
 
+	*cacheable = true;
+
+	Dependency::Ptr failed;
+	bool reachable = true;
+
 	for (const Checkable::Ptr& checkable : GetParents()) {
-		if (!checkable->IsReachable(dt, failedDependency, rstack + 1))
-			return false;
+		bool parentCacheable;
+
+		if (!checkable->IsReachableInternal(dt, &failed, rstack + 1, &parentCacheable))
+			reachable = false;
+
+		if (!parentCacheable)
+			*cacheable = false;
+
+		if (!reachable)
+			break;
 	}
 
 	/* implicit dependency on host if this is a service */
 	const auto *service = dynamic_cast<const Service *>(this);
-	if (service && (dt == DependencyState || dt == DependencyNotification)) {
+	if (reachable && service && (dt == DependencyState || dt == DependencyNotification)) {
 		Host::Ptr host = service->GetHost();
 
 		if (host && host->GetState() != HostUp && host->GetStateType() == StateTypeHard) {
-			if (failedDependency)
-				*failedDependency = nullptr;
+			failed = nullptr;
+			reachable = false;
+		}
+	}
 
-			return false;
+	if (reachable) {
+		for (const Dependency::Ptr& dep : GetDependencies()) {
+			/* Time periods change without notice, don't cache their results. */
+			if (dep->GetPeriod())
+				*cacheable = false;
+
+			if (!dep->IsAvailable(dt)) {
+				failed = dep;
+				reachable = false;
+				break;
+			}
 		}
 	}
 
-	for (const Dependency::Ptr& dep : GetDependencies()) {
-		if (!dep->IsAvailable(dt)) {
-			if (failedDependency)
-				*failedDependency = dep;
+	if (reachable)
+		failed = nullptr;
+
+	if (*cacheable) {
+		boost::mutex::scoped_lock lock(m_ReachabilityMutex);
 
-			return false;
+		/* Don't cache the result if a parent changed meanwhile. */
+		if (generation == m_ReachabilityGeneration) {
+			entry.Valid = true;
+			entry.Reachable = reachable;
+			entry.FailedDependency = failed;
 		}
 	}
 
 	if (failedDependency)
-		*failedDependency = nullptr;
+		*failedDependency = failed;
+
+	return reachable;
+}
 
-	return true;
+/**
+ * Discards the cached reachability of this checkable and of all checkables
+ * which depend on it and updates their CIB state counters. Must be called
+ * after the state of this checkable or one of its dependencies changed.
+ */
+void Checkable::InvalidateReachability()
+{
+	std::set<Checkable::Ptr> checkables = GetAllChildren();
+	checkables.insert(this);
+
+	/* Services implicitly depend on their host. */
+	auto *host = dynamic_cast<Host *>(this);
+	if (host) {
+		for (const Service::Ptr& service : host->GetServices()) {
+			std::set<Checkable::Ptr> children = service->GetAllChildren();
+			checkables.insert(children.begin(), children.end());
+			checkables.insert(service);
+		}
+	}
+
+	for (const Checkable::Ptr& checkable : checkables)
+		checkable->ResetReachability();
+
+	for (const Checkable::Ptr& checkable : checkables)
+		CIB::UpdateStateCounters(checkable);
+}
+
+void Checkable::ResetReachability()
+{
+	boost::mutex::scoped_lock lock(m_ReachabilityMutex);
+
+	m_ReachabilityGeneration++;
+
+	for (ReachabilityCacheEntry& entry : m_Reachability) {
+		entry.Valid = false;
+		entry.FailedDependency = nullptr;
+	}
 }
 
 std::set<Checkable::Ptr> Checkable::GetParents() const
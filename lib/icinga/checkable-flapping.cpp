@@ -20,9 +20,29 @@
 #include "icinga/checkable.hpp"
 #include "icinga/icingaapplication.hpp"
 #include "base/utility.hpp"
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif /* _MSC_VER */
 
 using namespace icinga;
 
+/* The flapping history holds the last 20 check results, one bit each. */
+static const int l_FlappingHistorySize = 20;
+static const unsigned long l_FlappingHistoryMask = (1UL << l_FlappingHistorySize) - 1;
+
+/* l_FlappingPositionMasks[k] has the bits set for all history positions
+ * whose index has bit k set. Used to sum up the indices of set bits. */
+static const unsigned long l_FlappingPositionMasks[] = { 0xAAAAA, 0xCCCCC, 0x0F0F0, 0x0FF00, 0xF0000 };
+
+static inline int PopCount(unsigned long value)
+{
+#ifdef _MSC_VER
+	return __popcnt(value);
+#else /* _MSC_VER */
+	return __builtin_popcountl(value);
+#endif /* _MSC_VER */
+}
+
 template<typename T>
 struct Bitset
 {
@@ -59,17 +79,9 @@ void Checkable::UpdateFlappingStatus(bool stateChange)
 	int oldestIndex = GetFlappingIndex();
 
 	stateChangeBuf.Modify(oldestIndex, stateChange);
-	oldestIndex = (oldestIndex + 1) % 20;
-
-	double stateChanges = 0;
-
-	/* Iterate over our state array and compute a weighted total */
-	for (int i = 0; i < 20; i++) {
-		if (stateChangeBuf.Get((oldestIndex + i) % 20))
-			stateChanges += 0.8 + (0.02 * i);
-	}
+	oldestIndex = (oldestIndex + 1) % l_FlappingHistorySize;
 
-	double flappingValue = 100.0 * stateChanges / 20.0;
+	double flappingValue = CalculateFlappingValue(stateChangeBuf.GetValue(), oldestIndex);
 
 	bool flapping;
 
@@ -87,6 +99,32 @@ void Checkable::UpdateFlappingStatus(bool stateChange)
 		SetFlappingLastChange(Utility::GetTime());
 }
 
+/**
+ * Calculates the weighted percentage of state changes in the flapping
+ * history. A state change weighs 0.8 for the oldest check result and
+ * 0.02 more for each newer one.
+ *
+ * @param stateChanges The flapping history, one bit per check result.
+ * @param oldestIndex The bit which holds the oldest check result.
+ * @returns The flapping value.
+ */
+double Checkable::CalculateFlappingValue(unsigned long stateChanges, int oldestIndex)
+{
+	/* Rotate the history so that the oldest check result is in bit 0. */
+	unsigned long history = stateChanges & l_FlappingHistoryMask;
+	history = ((history >> oldestIndex) | (history << (l_FlappingHistorySize - oldestIndex))) & l_FlappingHistoryMask;
+
+	int positionSum = 0;
+	int shift = 0;
+
+	for (unsigned long mask : l_FlappingPositionMasks)
+		positionSum += PopCount(history & mask) << shift++;
+
+	double weightedChanges = 0.8 * PopCount(history) + 0.02 * positionSum;
+
+	return 100.0 * weightedChanges / l_FlappingHistorySize;
+}
+
 bool Checkable::IsFlapping() const
 {
 	if (!GetEnableFlapping() || !IcingaApplication::GetInstance()->GetEnableFlapping())
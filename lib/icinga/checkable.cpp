@@ -21,6 +21,8 @@
 #include "icinga/checkable-ti.cpp"
 #include "icinga/host.hpp"
 #include "icinga/service.hpp"
+#include "icinga/cib.hpp"
+#include "remote/apilistener.hpp"
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/exception.hpp"
@@ -32,6 +34,9 @@ INITIALIZE_ONCE(&Checkable::StaticInitialize);
 
 boost::signals2::signal<void (const Checkable::Ptr&, const String&, const String&, AcknowledgementType, bool, bool, double, const MessageOrigin::Ptr&)> Checkable::OnAcknowledgementSet;
 boost::signals2::signal<void (const Checkable::Ptr&, const MessageOrigin::Ptr&)> Checkable::OnAcknowledgementCleared;
+boost::signals2::signal<void (const Checkable::Ptr&)> Checkable::OnSnapshotPublished;
+
+std::atomic<uint_fast64_t> Checkable::m_SnapshotGeneration{0};
 
 void Checkable::StaticInitialize()
 {
@@ -41,6 +46,17 @@ void Checkable::StaticInitialize()
 	Downtime::OnDowntimeTriggered.connect(std::bind(&Checkable::NotifyFlexibleDowntimeStart, _1));
 	/* fixed/flexible downtime end */
 	Downtime::OnDowntimeRemoved.connect(std::bind(&Checkable::NotifyDowntimeEnd, _1));
+
+	/* load metrics for the object authority distribution */
+	ApiListener::RegisterLoadFunction([]() -> double {
+		int maxChecks = Application::GetMaxConcurrentChecks();
+		return maxChecks > 0 ? static_cast<double>(GetPendingChecks()) / maxChecks : 0;
+	});
+
+	ApiListener::RegisterLoadFunction([]() -> double {
+		/* An instance which can't keep up starts its checks late; 10 seconds count as fully loaded. */
+		return CIB::CalculateServiceCheckStats().avg_latency / 10;
+	});
 }
 
 Checkable::Checkable()
@@ -79,6 +95,9 @@ void Checkable::Start(bool runtimeCreated)
 		SetNextCheck(now + delta);
 	}
 
+	/* The state has been restored by now. */
+	PublishSnapshot();
+
 	ObjectImpl<Checkable>::Start(runtimeCreated);
 }
 
@@ -103,6 +122,16 @@ void Checkable::AddGroup(const String& name)
 	groups->Add(name);
 }
 
+/**
+ * Stores the CIB state counters this checkable contributes to.
+ *
+ * @returns The previously stored counters.
+ */
+unsigned int Checkable::ExchangeStateCounterFlags(unsigned int flags)
+{
+	return m_StateCounterFlags.exchange(flags);
+}
+
 AcknowledgementType Checkable::GetAcknowledgement()
 {
 	auto avalue = static_cast<AcknowledgementType>(GetAcknowledgementRaw());
@@ -132,6 +161,8 @@ void Checkable::AcknowledgeProblem(const String& author, const String& comment,
 	if (notify && !IsPaused())
 		OnNotificationsRequested(this, NotificationAcknowledgement, GetLastCheckResult(), author, comment, nullptr);
 
+	PublishSnapshot();
+
 	OnAcknowledgementSet(this, author, comment, type, notify, persistent, expiry, origin);
 }
 
@@ -140,6 +171,8 @@ void Checkable::ClearAcknowledgement(const MessageOrigin::Ptr& origin)
 	SetAcknowledgementRaw(AcknowledgementNone);
 	SetAcknowledgementExpiry(0);
 
+	PublishSnapshot();
+
 	OnAcknowledgementCleared(this, origin);
 }
 
@@ -148,6 +181,50 @@ Endpoint::Ptr Checkable::GetCommandEndpoint() const
 	return Endpoint::GetByName(GetCommandEndpointRaw());
 }
 
+/**
+ * Returns the most recently published state snapshot. This doesn't take
+ * the object lock and never waits for a check result which is being
+ * processed.
+ */
+CheckableSnapshot::Ptr Checkable::GetSnapshot() const
+{
+	CheckableSnapshot::Ptr snapshot = std::atomic_load(&m_Snapshot);
+
+	if (snapshot)
+		return snapshot;
+
+	const_cast<Checkable *>(this)->PublishSnapshot();
+
+	return std::atomic_load(&m_Snapshot);
+}
+
+/**
+ * Copies the current state into a new snapshot and replaces the previous
+ * one. Callers which change several attributes at once should hold the
+ * object lock so that the snapshot doesn't mix old and new values.
+ */
+void Checkable::PublishSnapshot()
+{
+	auto snapshot = std::make_shared<CheckableSnapshot>();
+
+	snapshot->StateRaw = GetStateRaw();
+	snapshot->LastHardStateRaw = GetLastHardStateRaw();
+	snapshot->Type = GetStateType();
+	snapshot->CheckAttempt = GetCheckAttempt();
+	snapshot->LastCheckResult = GetLastCheckResult();
+	snapshot->LastStateChange = GetLastStateChange();
+	snapshot->LastHardStateChange = GetLastHardStateChange();
+	snapshot->Flapping = IsFlapping();
+	snapshot->FlappingCurrent = GetFlappingCurrent();
+	snapshot->Acknowledgement = GetAcknowledgementRaw();
+	snapshot->AcknowledgementExpiry = GetAcknowledgementExpiry();
+	snapshot->Generation = ++m_SnapshotGeneration;
+
+	std::atomic_store(&m_Snapshot, CheckableSnapshot::Ptr(std::move(snapshot)));
+
+	OnSnapshotPublished(this);
+}
+
 int Checkable::GetSeverity() const
 {
 	/* overridden in Host/Service class. */
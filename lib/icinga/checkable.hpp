@@ -28,6 +28,9 @@
 #include "icinga/downtime.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
+#include "base/signal.hpp"
+#include <atomic>
+#include <memory>
 
 namespace icinga
 {
@@ -73,6 +76,31 @@ class CheckCommand;
 class EventCommand;
 class Dependency;
 
+/**
+ * An immutable copy of the checkable state which is read most often.
+ * A new copy is published once ProcessCheckResult() has updated the state,
+ * so readers get a consistent view without taking the object lock.
+ *
+ * @ingroup icinga
+ */
+struct CheckableSnapshot
+{
+	typedef std::shared_ptr<const CheckableSnapshot> Ptr;
+
+	ServiceState StateRaw;
+	ServiceState LastHardStateRaw;
+	StateType Type;
+	long CheckAttempt;
+	CheckResult::Ptr LastCheckResult;
+	double LastStateChange;
+	double LastHardStateChange;
+	bool Flapping;
+	double FlappingCurrent;
+	int Acknowledgement;
+	double AcknowledgementExpiry;
+	uint_fast64_t Generation;
+};
+
 /**
  * An Icinga service.
  *
@@ -95,6 +123,9 @@ public:
 	void AddGroup(const String& name);
 
 	bool IsReachable(DependencyType dt = DependencyState, intrusive_ptr<Dependency> *failedDependency = nullptr, int rstack = 0) const;
+	void InvalidateReachability();
+
+	unsigned int ExchangeStateCounterFlags(unsigned int flags);
 
 	AcknowledgementType GetAcknowledgement();
 
@@ -120,6 +151,7 @@ public:
 	virtual void SaveLastState(ServiceState state, double timestamp) = 0;
 
 	static void UpdateStatistics(const CheckResult::Ptr& cr, CheckableType type);
+	static unsigned long GetDeduplicatedCheckResults();
 
 	void ExecuteRemoteCheck(const Dictionary::Ptr& resolvedMacros = nullptr);
 	void ExecuteCheck();
@@ -127,9 +159,13 @@ public:
 
 	Endpoint::Ptr GetCommandEndpoint() const;
 
-	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> OnNewCheckResult;
-	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> OnStateChange;
-	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, std::set<Checkable::Ptr>, const MessageOrigin::Ptr&)> OnReachabilityChanged;
+	CheckableSnapshot::Ptr GetSnapshot() const;
+	void PublishSnapshot();
+
+	static Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> OnNewCheckResult;
+	static boost::signals2::signal<void (const Checkable::Ptr&)> OnSnapshotPublished;
+	static Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> OnStateChange;
+	static Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const std::set<Checkable::Ptr>&, const MessageOrigin::Ptr&)> OnReachabilityChanged;
 	static boost::signals2::signal<void (const Checkable::Ptr&, NotificationType, const CheckResult::Ptr&,
 		const String&, const String&, const MessageOrigin::Ptr&)> OnNotificationsRequested;
 	static boost::signals2::signal<void (const Notification::Ptr&, const Checkable::Ptr&, const User::Ptr&,
@@ -181,6 +217,7 @@ public:
 
 	/* Flapping Detection */
 	bool IsFlapping() const;
+	static double CalculateFlappingValue(unsigned long stateChanges, int oldestIndex);
 
 	/* Dependencies */
 	void AddDependency(const intrusive_ptr<Dependency>& dep);
@@ -198,6 +235,7 @@ public:
 	static void DecreasePendingChecks();
 	static int GetPendingChecks();
 	static void AquirePendingCheckSlot(int maxPendingChecks);
+	static bool TryAquirePendingCheckSlot(int maxPendingChecks);
 
 	static Object::Ptr GetPrototype();
 
@@ -210,6 +248,17 @@ private:
 	bool m_CheckRunning{false};
 	long m_SchedulingOffset;
 
+	/* Only accessed through std::atomic_load() and std::atomic_store(). */
+	CheckableSnapshot::Ptr m_Snapshot;
+	static std::atomic<uint_fast64_t> m_SnapshotGeneration;
+
+	/* Passive check result deduplication */
+	double m_LastFullCheckResult{0};
+	int m_SuppressedCheckResults{0};
+	static std::atomic<unsigned long> m_DeduplicatedCheckResults;
+
+	bool IsDuplicateCheckResult(const CheckResult::Ptr& old_cr, const CheckResult::Ptr& cr, double now);
+
 	static boost::mutex m_StatsMutex;
 	static int m_PendingChecks;
 	static boost::condition_variable m_PendingChecksCV;
@@ -237,7 +286,26 @@ private:
 	std::set<intrusive_ptr<Dependency> > m_Dependencies;
 	std::set<intrusive_ptr<Dependency> > m_ReverseDependencies;
 
+	/**
+	 * The cached result of IsReachable() for one dependency type.
+	 */
+	struct ReachabilityCacheEntry
+	{
+		bool Valid{false};
+		bool Reachable{false};
+		intrusive_ptr<Dependency> FailedDependency;
+	};
+
+	mutable boost::mutex m_ReachabilityMutex;
+	mutable ReachabilityCacheEntry m_Reachability[DependencyNotification + 1];
+	mutable uint_fast64_t m_ReachabilityGeneration{0};
+
 	void GetAllChildrenInternal(std::set<Checkable::Ptr>& children, int level = 0) const;
+	bool IsReachableInternal(DependencyType dt, intrusive_ptr<Dependency> *failedDependency, int rstack, bool *cacheable) const;
+	void ResetReachability();
+
+	/* State counters (see CIB::UpdateStateCounters()) */
+	std::atomic<unsigned int> m_StateCounterFlags{0};
 
 	/* Flapping */
 	void UpdateFlappingStatus(bool stateChange);
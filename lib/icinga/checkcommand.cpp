@@ -35,3 +35,11 @@ void CheckCommand::Execute(const Checkable::Ptr& checkable, const CheckResult::P
 		useResolvedMacros
 	});
 }
+
+/**
+ * Returns the check statistics for the checkables which use this command.
+ */
+CheckHistograms& CheckCommand::GetCheckHistograms()
+{
+	return m_CheckHistograms;
+}
@@ -22,6 +22,7 @@
 
 #include "icinga/checkcommand-ti.hpp"
 #include "icinga/checkable.hpp"
+#include "icinga/cib.hpp"
 
 namespace icinga
 {
@@ -40,6 +41,11 @@ public:
 	virtual void Execute(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
 		const Dictionary::Ptr& resolvedMacros = nullptr,
 		bool useResolvedMacros = false);
+
+	CheckHistograms& GetCheckHistograms();
+
+private:
+	CheckHistograms m_CheckHistograms;
 };
 
 }
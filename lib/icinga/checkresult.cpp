@@ -19,12 +19,24 @@
 
 #include "icinga/checkresult.hpp"
 #include "icinga/checkresult-ti.cpp"
+#include "icinga/pluginutility.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/objectlock.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/textcompressor.hpp"
+#include <atomic>
 
 using namespace icinga;
 
 REGISTER_TYPE(CheckResult);
 
+/* Outputs shorter than this aren't worth compressing. */
+static const size_t l_MinCompressedOutputLength = 256;
+
+static std::atomic<uint_fast64_t> l_CompressedOutputs{0};
+static std::atomic<uint_fast64_t> l_CompressedOutputOriginalBytes{0};
+static std::atomic<uint_fast64_t> l_CompressedOutputBytes{0};
+
 INITIALIZE_ONCE([]() {
 	ScriptGlobal::Set("ServiceOK", ServiceOK);
 	ScriptGlobal::Set("ServiceWarning", ServiceWarning);
@@ -35,6 +47,82 @@ INITIALIZE_ONCE([]() {
 	ScriptGlobal::Set("HostDown", HostDown);
 })
 
+CheckResult::~CheckResult()
+{
+	ReleaseCompressedOutput();
+}
+
+String CheckResult::GetOutput() const
+{
+	ObjectLock olock(this);
+
+	if (m_CompressedOutput.empty())
+		return ObjectImpl<CheckResult>::GetOutput();
+
+	return TextCompressor::Decompress(m_CompressedOutput, m_OutputLength);
+}
+
+/**
+ * Sets the output. Long outputs are stored compressed if the
+ * CompressCheckOutput constant is enabled and decompressed whenever
+ * GetOutput() is called.
+ */
+void CheckResult::SetOutput(const String& value, bool suppress_events, const Value& cookie)
+{
+	static const bool compress = TextCompressor::IsSupported() && ScriptGlobal::Get("CompressCheckOutput", &Empty).ToBool();
+
+	{
+		ObjectLock olock(this);
+
+		ReleaseCompressedOutput();
+
+		if (compress && value.GetLength() >= l_MinCompressedOutputLength && TextCompressor::Compress(value, m_CompressedOutput)) {
+			m_OutputLength = value.GetLength();
+
+			l_CompressedOutputs++;
+			l_CompressedOutputOriginalBytes += m_OutputLength;
+			l_CompressedOutputBytes += m_CompressedOutput.size();
+
+			ObjectImpl<CheckResult>::SetOutput(String(), true);
+		} else {
+			m_CompressedOutput.clear();
+			ObjectImpl<CheckResult>::SetOutput(value, true);
+		}
+	}
+
+	if (!suppress_events)
+		NotifyOutput(cookie);
+}
+
+void CheckResult::ReleaseCompressedOutput()
+{
+	if (m_CompressedOutput.empty())
+		return;
+
+	l_CompressedOutputs--;
+	l_CompressedOutputOriginalBytes -= m_OutputLength;
+	l_CompressedOutputBytes -= m_CompressedOutput.size();
+
+	m_CompressedOutput = std::string();
+	m_OutputLength = 0;
+}
+
+/**
+ * Returns how much memory compressing check outputs currently saves.
+ */
+Dictionary::Ptr CheckResult::GetOutputCompressionStats()
+{
+	uint_fast64_t originalBytes = l_CompressedOutputOriginalBytes;
+	uint_fast64_t compressedBytes = l_CompressedOutputBytes;
+
+	return new Dictionary({
+		{ "outputs", static_cast<double>(l_CompressedOutputs) },
+		{ "original_bytes", static_cast<double>(originalBytes) },
+		{ "compressed_bytes", static_cast<double>(compressedBytes) },
+		{ "saved_bytes", static_cast<double>(originalBytes - compressedBytes) }
+	});
+}
+
 double CheckResult::CalculateExecutionTime() const
 {
 	return GetExecutionEnd() - GetExecutionStart();
@@ -49,3 +137,72 @@ double CheckResult::CalculateLatency() const
 
 	return latency;
 }
+
+/**
+ * Returns the performance data with each value parsed into a
+ * PerfdataValue. Values which can't be parsed are kept as strings.
+ * The result is computed once per check result and shared by all
+ * callers, so it must not be modified.
+ *
+ * @returns The parsed performance data or null if there is none.
+ */
+Array::Ptr CheckResult::GetParsedPerformanceData() const
+{
+	Array::Ptr perfdata = GetPerformanceData();
+
+	if (!perfdata)
+		return nullptr;
+
+	ObjectLock olock(this);
+
+	if (m_ParsedPerfdataSource == perfdata)
+		return m_ParsedPerfdata;
+
+	ArrayData values;
+
+	{
+		ObjectLock perfdataLock(perfdata);
+
+		for (const Value& val : perfdata) {
+			if (val.IsObjectType<PerfdataValue>()) {
+				values.push_back(val);
+				continue;
+			}
+
+			try {
+				values.emplace_back(PerfdataValue::Parse(val));
+			} catch (const std::exception&) {
+				values.push_back(val);
+			}
+		}
+	}
+
+	Array::Ptr result = new Array(std::move(values));
+	result->Freeze();
+
+	m_ParsedPerfdataSource = perfdata;
+	m_ParsedPerfdata = result;
+
+	return result;
+}
+
+/**
+ * Returns the performance data formatted as plugin output. The result
+ * is computed once per check result.
+ */
+String CheckResult::GetFormattedPerformanceData() const
+{
+	Array::Ptr perfdata = GetPerformanceData();
+
+	if (!perfdata)
+		return "";
+
+	ObjectLock olock(this);
+
+	if (m_FormattedPerfdataSource != perfdata) {
+		m_FormattedPerfdata = PluginUtility::FormatPerfdata(perfdata);
+		m_FormattedPerfdataSource = perfdata;
+	}
+
+	return m_FormattedPerfdata;
+}
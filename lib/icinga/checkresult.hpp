@@ -22,6 +22,8 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkresult-ti.hpp"
+#include "base/objectpool.hpp"
+#include <string>
 
 namespace icinga
 {
@@ -35,9 +37,32 @@ class CheckResult final : public ObjectImpl<CheckResult>
 {
 public:
 	DECLARE_OBJECT(CheckResult);
+	DECLARE_POOLED_ALLOCATOR();
+
+	~CheckResult() override;
+
+	String GetOutput() const override;
+	void SetOutput(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
+
+	static Dictionary::Ptr GetOutputCompressionStats();
 
 	double CalculateExecutionTime() const;
 	double CalculateLatency() const;
+
+	Array::Ptr GetParsedPerformanceData() const;
+	String GetFormattedPerformanceData() const;
+
+private:
+	mutable Array::Ptr m_ParsedPerfdataSource;
+	mutable Array::Ptr m_ParsedPerfdata;
+	mutable Array::Ptr m_FormattedPerfdataSource;
+	mutable String m_FormattedPerfdata;
+
+	/* The output if it was stored compressed, see SetOutput(). */
+	std::string m_CompressedOutput;
+	size_t m_OutputLength{0};
+
+	void ReleaseCompressedOutput();
 };
 
 }
@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/checkresultbatcher.hpp"
+#include "base/timer.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+
+using namespace icinga;
+
+#define CHECKRESULT_BATCH_SHARDS 4
+#define CHECKRESULT_BATCH_INTERVAL 0.1
+#define CHECKRESULT_BATCH_SIZE 1024
+
+Signal<void (const CheckResultBatch&)> CheckResultBatcher::OnNewCheckResults("CheckResultBatcher::OnNewCheckResults");
+
+struct CheckResultBatchShard
+{
+	boost::mutex Mutex;
+	CheckResultBatch Items;
+	bool FlushQueued{false};
+
+	/* Serializes the delivery of batches so that results stay in order. */
+	boost::mutex DispatchMutex;
+};
+
+static CheckResultBatchShard l_BatchShards[CHECKRESULT_BATCH_SHARDS];
+static Timer::Ptr l_BatchTimer;
+static boost::once_flag l_BatchOnceFlag = BOOST_ONCE_INIT;
+
+static void BatchTimerHandler()
+{
+	for (int i = 0; i < CHECKRESULT_BATCH_SHARDS; i++) {
+		CheckResultBatchShard& shard = l_BatchShards[i];
+
+		{
+			boost::mutex::scoped_lock lock(shard.Mutex);
+
+			if (shard.Items.empty() || shard.FlushQueued)
+				continue;
+
+			shard.FlushQueued = true;
+		}
+
+		Utility::QueueAsyncCallback(std::bind(&CheckResultBatcher::Flush, i));
+	}
+}
+
+static void StartBatchTimer()
+{
+	l_BatchTimer = new Timer("CheckResultBatcher");
+	l_BatchTimer->SetInterval(CHECKRESULT_BATCH_INTERVAL);
+	l_BatchTimer->OnTimerExpired.connect(std::bind(&BatchTimerHandler));
+	l_BatchTimer->Start();
+}
+
+/**
+ * Queues a check result for batched delivery to the OnNewCheckResults slots.
+ *
+ * @param checkable The checkable the result belongs to.
+ * @param cr The check result.
+ * @param origin The origin of the check result.
+ */
+void CheckResultBatcher::Add(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin)
+{
+	if (OnNewCheckResults.empty())
+		return;
+
+	boost::call_once(l_BatchOnceFlag, &StartBatchTimer);
+
+	int index = Utility::SDBM(checkable->GetName()) % CHECKRESULT_BATCH_SHARDS;
+	CheckResultBatchShard& shard = l_BatchShards[index];
+
+	bool flush = false;
+
+	{
+		boost::mutex::scoped_lock lock(shard.Mutex);
+
+		shard.Items.push_back({ checkable, cr, origin });
+
+		if (shard.Items.size() >= CHECKRESULT_BATCH_SIZE && !shard.FlushQueued) {
+			shard.FlushQueued = true;
+			flush = true;
+		}
+	}
+
+	if (flush)
+		Utility::QueueAsyncCallback(std::bind(&CheckResultBatcher::Flush, index));
+}
+
+void CheckResultBatcher::Flush(int index)
+{
+	CheckResultBatchShard& shard = l_BatchShards[index];
+
+	boost::mutex::scoped_lock dispatchLock(shard.DispatchMutex);
+
+	CheckResultBatch batch;
+
+	{
+		boost::mutex::scoped_lock lock(shard.Mutex);
+		batch.swap(shard.Items);
+		shard.FlushQueued = false;
+	}
+
+	if (!batch.empty())
+		OnNewCheckResults(batch);
+}
+
+/**
+ * Invokes the handler for each item in the batch. An exception thrown by the
+ * handler does not prevent the remaining items from being processed; the
+ * first exception is rethrown once the whole batch has been handled.
+ *
+ * @param batch The batch.
+ * @param handler The handler.
+ */
+void CheckResultBatcher::ForEach(const CheckResultBatch& batch, const Handler& handler)
+{
+	std::exception_ptr firstException;
+
+	for (const CheckResultBatchItem& item : batch) {
+		try {
+			handler(item.Object, item.Result);
+		} catch (...) {
+			if (!firstException)
+				firstException = std::current_exception();
+		}
+	}
+
+	if (firstException)
+		std::rethrow_exception(firstException);
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CHECKRESULTBATCHER_H
+#define CHECKRESULTBATCHER_H
+
+#include "icinga/i2-icinga.hpp"
+#include "icinga/checkable.hpp"
+#include "remote/messageorigin.hpp"
+#include "base/signal.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * @ingroup icinga
+ */
+struct CheckResultBatchItem
+{
+	Checkable::Ptr Object;
+	CheckResult::Ptr Result;
+	MessageOrigin::Ptr Origin;
+};
+
+typedef std::vector<CheckResultBatchItem> CheckResultBatch;
+
+/**
+ * Collects processed check results and hands them to the slots of
+ * OnNewCheckResults in batches. Results are sharded by checkable so that
+ * the results for one checkable are always delivered in order.
+ *
+ * @ingroup icinga
+ */
+class CheckResultBatcher
+{
+public:
+	typedef std::function<void (const Checkable::Ptr&, const CheckResult::Ptr&)> Handler;
+
+	static Signal<void (const CheckResultBatch&)> OnNewCheckResults;
+
+	static void Add(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin);
+	static void ForEach(const CheckResultBatch& batch, const Handler& handler);
+
+	static void Flush(int shard);
+
+private:
+	CheckResultBatcher();
+};
+
+}
+
+#endif /* CHECKRESULTBATCHER_H */
@@ -20,19 +20,54 @@
 #include "icinga/cib.hpp"
 #include "icinga/host.hpp"
 #include "icinga/service.hpp"
+#include "icinga/checkcommand.hpp"
 #include "icinga/clusterevents.hpp"
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/configtype.hpp"
 #include "base/statsfunction.hpp"
+#include "base/initialize.hpp"
+#include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
 
 using namespace icinga;
 
-RingBuffer CIB::m_ActiveHostChecksStatistics(15 * 60);
-RingBuffer CIB::m_ActiveServiceChecksStatistics(15 * 60);
-RingBuffer CIB::m_PassiveHostChecksStatistics(15 * 60);
-RingBuffer CIB::m_PassiveServiceChecksStatistics(15 * 60);
+ShardedRingBuffer CIB::m_ActiveHostChecksStatistics(15 * 60);
+ShardedRingBuffer CIB::m_ActiveServiceChecksStatistics(15 * 60);
+ShardedRingBuffer CIB::m_PassiveHostChecksStatistics(15 * 60);
+ShardedRingBuffer CIB::m_PassiveServiceChecksStatistics(15 * 60);
+CheckHistograms CIB::m_HostCheckHistograms;
+CheckHistograms CIB::m_ServiceCheckHistograms;
+CIB::StateCounterShard CIB::m_StateCounterShards[CIB::StateCounterShardCount];
+
+INITIALIZE_ONCE([]() {
+	auto updateCheckable = [](const Checkable::Ptr& checkable) { CIB::UpdateStateCounters(checkable); };
+	auto updateDowntime = [](const Downtime::Ptr& downtime) {
+		Checkable::Ptr checkable = downtime->GetCheckable();
+
+		if (checkable)
+			CIB::UpdateStateCounters(checkable);
+	};
+
+	/* State, reachability and flapping changes either come with a check result
+	 * or invalidate the reachability of the affected checkables, which updates
+	 * their counters, too. */
+	Checkable::OnNewCheckResult.connect(std::bind(updateCheckable, _1), "CIB::UpdateStateCounters");
+	Checkable::OnAcknowledgementSet.connect(std::bind(updateCheckable, _1));
+	Checkable::OnAcknowledgementCleared.connect(std::bind(updateCheckable, _1));
+	Checkable::OnFlappingChanged.connect(std::bind(updateCheckable, _1));
+	Downtime::OnDowntimeStarted.connect(updateDowntime);
+	Downtime::OnDowntimeTriggered.connect(updateDowntime);
+	Downtime::OnDowntimeRemoved.connect(updateDowntime);
+
+	ConfigObject::OnActiveChanged.connect([updateCheckable](const ConfigObject::Ptr& object, const Value&) {
+		Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+		if (checkable)
+			updateCheckable(checkable);
+	});
+});
 
 void CIB::UpdateActiveHostChecksStatistics(long tv, int num)
 {
@@ -46,12 +81,12 @@ void CIB::UpdateActiveServiceChecksStatistics(long tv, int num)
 
 int CIB::GetActiveHostChecksStatistics(long timespan)
 {
-	return m_ActiveHostChecksStatistics.UpdateAndGetValues(Utility::GetTime(), timespan);
+	return m_ActiveHostChecksStatistics.UpdateAndGetValues(Utility::GetCoarseTime(), timespan);
 }
 
 int CIB::GetActiveServiceChecksStatistics(long timespan)
 {
-	return m_ActiveServiceChecksStatistics.UpdateAndGetValues(Utility::GetTime(), timespan);
+	return m_ActiveServiceChecksStatistics.UpdateAndGetValues(Utility::GetCoarseTime(), timespan);
 }
 
 void CIB::UpdatePassiveHostChecksStatistics(long tv, int num)
@@ -66,197 +101,185 @@ void CIB::UpdatePassiveServiceChecksStatistics(long tv, int num)
 
 int CIB::GetPassiveHostChecksStatistics(long timespan)
 {
-	return m_PassiveHostChecksStatistics.UpdateAndGetValues(Utility::GetTime(), timespan);
+	return m_PassiveHostChecksStatistics.UpdateAndGetValues(Utility::GetCoarseTime(), timespan);
 }
 
 int CIB::GetPassiveServiceChecksStatistics(long timespan)
 {
-	return m_PassiveServiceChecksStatistics.UpdateAndGetValues(Utility::GetTime(), timespan);
+	return m_PassiveServiceChecksStatistics.UpdateAndGetValues(Utility::GetCoarseTime(), timespan);
 }
 
-CheckableCheckStatistics CIB::CalculateHostCheckStats()
+/**
+ * Records the latency, execution time and processing time for a check result
+ * in the global and the check command's histograms.
+ */
+void CIB::UpdateCheckStatistics(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, double processingTime)
 {
-	double min_latency = -1, max_latency = 0, sum_latency = 0;
-	int count_latency = 0;
-	double min_execution_time = -1, max_execution_time = 0, sum_execution_time = 0;
-	int count_execution_time = 0;
-	bool checkresult = false;
-
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		ObjectLock olock(host);
-
-		CheckResult::Ptr cr = host->GetLastCheckResult();
-
-		if (!cr)
-			continue;
-
-		/* set to true, we have a checkresult */
-		checkresult = true;
+	double latency = cr->CalculateLatency();
+	double executionTime = cr->CalculateExecutionTime();
 
-		/* latency */
-		double latency = cr->CalculateLatency();
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
 
-		if (min_latency == -1 || latency < min_latency)
-			min_latency = latency;
+	CheckHistograms& histograms = service ? m_ServiceCheckHistograms : m_HostCheckHistograms;
 
-		if (latency > max_latency)
-			max_latency = latency;
+	histograms.Latency.Record(latency);
+	histograms.ExecutionTime.Record(executionTime);
+	histograms.ProcessingTime.Record(processingTime);
 
-		sum_latency += latency;
-		count_latency++;
+	CheckCommand::Ptr command = checkable->GetCheckCommand();
 
-		/* execution_time */
-		double execution_time = cr->CalculateExecutionTime();
+	if (command) {
+		CheckHistograms& commandHistograms = command->GetCheckHistograms();
 
-		if (min_execution_time == -1 || execution_time < min_execution_time)
-			min_execution_time = execution_time;
-
-		if (execution_time > max_execution_time)
-			max_execution_time = execution_time;
-
-		sum_execution_time += execution_time;
-		count_execution_time++;
-	}
-
-	if (!checkresult) {
-		min_latency = 0;
-		min_execution_time = 0;
+		commandHistograms.Latency.Record(latency);
+		commandHistograms.ExecutionTime.Record(executionTime);
+		commandHistograms.ProcessingTime.Record(processingTime);
 	}
+}
 
+CheckableCheckStatistics CIB::GetCheckStatistics(const CheckHistograms& histograms)
+{
 	CheckableCheckStatistics ccs;
 
-	ccs.min_latency = min_latency;
-	ccs.max_latency = max_latency;
-	ccs.avg_latency = sum_latency / count_latency;
-	ccs.min_execution_time = min_execution_time;
-	ccs.max_execution_time = max_execution_time;
-	ccs.avg_execution_time = sum_execution_time / count_execution_time;
+	ccs.min_latency = histograms.Latency.GetMin();
+	ccs.max_latency = histograms.Latency.GetMax();
+	ccs.avg_latency = histograms.Latency.GetAverage();
+	ccs.p50_latency = histograms.Latency.GetPercentile(50);
+	ccs.p95_latency = histograms.Latency.GetPercentile(95);
+	ccs.p99_latency = histograms.Latency.GetPercentile(99);
+	ccs.min_execution_time = histograms.ExecutionTime.GetMin();
+	ccs.max_execution_time = histograms.ExecutionTime.GetMax();
+	ccs.avg_execution_time = histograms.ExecutionTime.GetAverage();
+	ccs.p50_execution_time = histograms.ExecutionTime.GetPercentile(50);
+	ccs.p95_execution_time = histograms.ExecutionTime.GetPercentile(95);
+	ccs.p99_execution_time = histograms.ExecutionTime.GetPercentile(99);
+	ccs.avg_processing_time = histograms.ProcessingTime.GetAverage();
+	ccs.p50_processing_time = histograms.ProcessingTime.GetPercentile(50);
+	ccs.p95_processing_time = histograms.ProcessingTime.GetPercentile(95);
+	ccs.p99_processing_time = histograms.ProcessingTime.GetPercentile(99);
 
 	return ccs;
 }
 
-CheckableCheckStatistics CIB::CalculateServiceCheckStats()
+Dictionary::Ptr CIB::GetHistogramStats(const Histogram& histogram)
 {
-	double min_latency = -1, max_latency = 0, sum_latency = 0;
-	int count_latency = 0;
-	double min_execution_time = -1, max_execution_time = 0, sum_execution_time = 0;
-	int count_execution_time = 0;
-	bool checkresult = false;
-
-	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
-		ObjectLock olock(service);
-
-		CheckResult::Ptr cr = service->GetLastCheckResult();
-
-		if (!cr)
-			continue;
-
-		/* set to true, we have a checkresult */
-		checkresult = true;
+	return new Dictionary({
+		{ "min", histogram.GetMin() },
+		{ "max", histogram.GetMax() },
+		{ "avg", histogram.GetAverage() },
+		{ "p50", histogram.GetPercentile(50) },
+		{ "p95", histogram.GetPercentile(95) },
+		{ "p99", histogram.GetPercentile(99) }
+	});
+}
 
-		/* latency */
-		double latency = cr->CalculateLatency();
+CheckableCheckStatistics CIB::CalculateHostCheckStats()
+{
+	return GetCheckStatistics(m_HostCheckHistograms);
+}
 
-		if (min_latency == -1 || latency < min_latency)
-			min_latency = latency;
+CheckableCheckStatistics CIB::CalculateServiceCheckStats()
+{
+	return GetCheckStatistics(m_ServiceCheckHistograms);
+}
 
-		if (latency > max_latency)
-			max_latency = latency;
+ServiceStatistics CIB::CalculateServiceStats()
+{
+	ServiceStatistics ss;
+
+	ss.services_ok = GetStateCounter(StateCounterService, ServiceOK);
+	ss.services_warning = GetStateCounter(StateCounterService, ServiceWarning);
+	ss.services_critical = GetStateCounter(StateCounterService, ServiceCritical);
+	ss.services_unknown = GetStateCounter(StateCounterService, ServiceUnknown);
+	ss.services_pending = GetStateCounter(StateCounterService, StateCounterPending);
+	ss.services_unreachable = GetStateCounter(StateCounterService, StateCounterUnreachable);
+	ss.services_flapping = GetStateCounter(StateCounterService, StateCounterFlapping);
+	ss.services_in_downtime = GetStateCounter(StateCounterService, StateCounterInDowntime);
+	ss.services_acknowledged = GetStateCounter(StateCounterService, StateCounterAcknowledged);
 
-		sum_latency += latency;
-		count_latency++;
+	return ss;
+}
 
-		/* execution_time */
-		double execution_time = cr->CalculateExecutionTime();
+HostStatistics CIB::CalculateHostStats()
+{
+	HostStatistics hs;
 
-		if (min_execution_time == -1 || execution_time < min_execution_time)
-			min_execution_time = execution_time;
+	hs.hosts_up = GetStateCounter(StateCounterHost, HostUp);
+	hs.hosts_down = GetStateCounter(StateCounterHost, HostDown);
+	hs.hosts_unreachable = GetStateCounter(StateCounterHost, StateCounterUnreachable);
+	hs.hosts_pending = GetStateCounter(StateCounterHost, StateCounterPending);
+	hs.hosts_flapping = GetStateCounter(StateCounterHost, StateCounterFlapping);
+	hs.hosts_in_downtime = GetStateCounter(StateCounterHost, StateCounterInDowntime);
+	hs.hosts_acknowledged = GetStateCounter(StateCounterHost, StateCounterAcknowledged);
 
-		if (execution_time > max_execution_time)
-			max_execution_time = execution_time;
+	return hs;
+}
 
-		sum_execution_time += execution_time;
-		count_execution_time++;
+/**
+ * Re-evaluates which of the host/service state counters the checkable
+ * contributes to and applies the difference to the counters. Inactive
+ * checkables don't contribute to any counter.
+ */
+void CIB::UpdateStateCounters(const Checkable::Ptr& checkable)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	unsigned int flags = 0;
+
+	if (checkable->IsActive()) {
+		if (service) {
+			flags |= 1 << service->GetState();
+
+			if (!service->IsReachable())
+				flags |= 1 << StateCounterUnreachable;
+		} else if (host->IsReachable())
+			flags |= 1 << host->GetState();
+		else
+			flags |= 1 << StateCounterUnreachable;
+
+		if (!checkable->GetLastCheckResult())
+			flags |= 1 << StateCounterPending;
+		if (checkable->IsFlapping())
+			flags |= 1 << StateCounterFlapping;
+		if (checkable->IsInDowntime())
+			flags |= 1 << StateCounterInDowntime;
+		if (checkable->IsAcknowledged())
+			flags |= 1 << StateCounterAcknowledged;
 	}
 
-	if (!checkresult) {
-		min_latency = 0;
-		min_execution_time = 0;
-	}
+	unsigned int oldFlags = checkable->ExchangeStateCounterFlags(flags);
 
-	CheckableCheckStatistics ccs;
+	if (flags == oldFlags)
+		return;
 
-	ccs.min_latency = min_latency;
-	ccs.max_latency = max_latency;
-	ccs.avg_latency = sum_latency / count_latency;
-	ccs.min_execution_time = min_execution_time;
-	ccs.max_execution_time = max_execution_time;
-	ccs.avg_execution_time = sum_execution_time / count_execution_time;
+	/* Each thread updates its own shard so that concurrent check results
+	 * don't contend on the same cache lines. */
+	static boost::hash<boost::thread::id> hasher;
+	StateCounterShard& shard = m_StateCounterShards[hasher(boost::this_thread::get_id()) % StateCounterShardCount];
+	std::atomic<long> *counters = shard.Counters[service ? StateCounterService : StateCounterHost];
 
-	return ccs;
-}
+	for (int i = 0; i < StateCounterMax; i++) {
+		unsigned int bit = 1 << i;
 
-ServiceStatistics CIB::CalculateServiceStats()
-{
-	ServiceStatistics ss = {};
-
-	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
-		ObjectLock olock(service);
-
-		CheckResult::Ptr cr = service->GetLastCheckResult();
-
-		if (service->GetState() == ServiceOK)
-			ss.services_ok++;
-		if (service->GetState() == ServiceWarning)
-			ss.services_warning++;
-		if (service->GetState() == ServiceCritical)
-			ss.services_critical++;
-		if (service->GetState() == ServiceUnknown)
-			ss.services_unknown++;
-
-		if (!cr)
-			ss.services_pending++;
-		if (!service->IsReachable())
-			ss.services_unreachable++;
-
-		if (service->IsFlapping())
-			ss.services_flapping++;
-		if (service->IsInDowntime())
-			ss.services_in_downtime++;
-		if (service->IsAcknowledged())
-			ss.services_acknowledged++;
+		if ((flags & bit) && !(oldFlags & bit))
+			counters[i]++;
+		else if (!(flags & bit) && (oldFlags & bit))
+			counters[i]--;
 	}
-
-	return ss;
 }
 
-HostStatistics CIB::CalculateHostStats()
+double CIB::GetStateCounter(StateCounterType type, int counter)
 {
-	HostStatistics hs = {};
-
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		ObjectLock olock(host);
-
-		if (host->IsReachable()) {
-			if (host->GetState() == HostUp)
-				hs.hosts_up++;
-			if (host->GetState() == HostDown)
-				hs.hosts_down++;
-		} else
-			hs.hosts_unreachable++;
-
-		if (!host->GetLastCheckResult())
-			hs.hosts_pending++;
-
-		if (host->IsFlapping())
-			hs.hosts_flapping++;
-		if (host->IsInDowntime())
-			hs.hosts_in_downtime++;
-		if (host->IsAcknowledged())
-			hs.hosts_acknowledged++;
-	}
+	long value = 0;
 
-	return hs;
+	for (const StateCounterShard& shard : m_StateCounterShards)
+		value += shard.Counters[type][counter];
+
+	return value;
 }
 
 /*
@@ -313,9 +336,38 @@ void CIB::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata) {
 	status->Set("min_latency", scs.min_latency);
 	status->Set("max_latency", scs.max_latency);
 	status->Set("avg_latency", scs.avg_latency);
+	status->Set("p50_latency", scs.p50_latency);
+	status->Set("p95_latency", scs.p95_latency);
+	status->Set("p99_latency", scs.p99_latency);
 	status->Set("min_execution_time", scs.min_execution_time);
 	status->Set("max_execution_time", scs.max_execution_time);
 	status->Set("avg_execution_time", scs.avg_execution_time);
+	status->Set("p50_execution_time", scs.p50_execution_time);
+	status->Set("p95_execution_time", scs.p95_execution_time);
+	status->Set("p99_execution_time", scs.p99_execution_time);
+	status->Set("avg_processing_time", scs.avg_processing_time);
+	status->Set("p50_processing_time", scs.p50_processing_time);
+	status->Set("p95_processing_time", scs.p95_processing_time);
+	status->Set("p99_processing_time", scs.p99_processing_time);
+
+	DictionaryData commands;
+
+	for (const CheckCommand::Ptr& command : ConfigType::GetObjectsByType<CheckCommand>()) {
+		CheckHistograms& histograms = command->GetCheckHistograms();
+
+		if (histograms.Latency.GetCount() == 0)
+			continue;
+
+		commands.emplace_back(command->GetName(), new Dictionary({
+			{ "latency", GetHistogramStats(histograms.Latency) },
+			{ "execution_time", GetHistogramStats(histograms.ExecutionTime) },
+			{ "processing_time", GetHistogramStats(histograms.ProcessingTime) }
+		}));
+	}
+
+	status->Set("check_commands", new Dictionary(std::move(commands)));
+	status->Set("output_compression", CheckResult::GetOutputCompressionStats());
+	status->Set("deduplicated_check_results", Checkable::GetDeduplicatedCheckResults());
 
 	ServiceStatistics ss = CalculateServiceStats();
 
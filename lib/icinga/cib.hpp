@@ -21,20 +21,48 @@
 #define CIB_H
 
 #include "icinga/i2-icinga.hpp"
-#include "base/ringbuffer.hpp"
+#include "icinga/checkresult.hpp"
+#include "base/shardedringbuffer.hpp"
+#include "base/histogram.hpp"
 #include "base/dictionary.hpp"
 #include "base/array.hpp"
+#include <atomic>
 
 namespace icinga
 {
 
+class Checkable;
+class CheckResult;
+
 struct CheckableCheckStatistics {
 	double min_latency;
 	double max_latency;
 	double avg_latency;
+	double p50_latency;
+	double p95_latency;
+	double p99_latency;
 	double min_execution_time;
 	double max_execution_time;
 	double avg_execution_time;
+	double p50_execution_time;
+	double p95_execution_time;
+	double p99_execution_time;
+	double avg_processing_time;
+	double p50_processing_time;
+	double p95_processing_time;
+	double p99_processing_time;
+};
+
+/**
+ * Histograms for the check latency, the check execution time and the
+ * time it took to process the check result.
+ *
+ * @ingroup icinga
+ */
+struct CheckHistograms {
+	Histogram Latency;
+	Histogram ExecutionTime;
+	Histogram ProcessingTime;
 };
 
 struct ServiceStatistics {
@@ -80,11 +108,17 @@ public:
 	static void UpdatePassiveServiceChecksStatistics(long tv, int num);
 	static int GetPassiveServiceChecksStatistics(long timespan);
 
+	static void UpdateCheckStatistics(const intrusive_ptr<Checkable>& checkable, const intrusive_ptr<CheckResult>& cr, double processingTime);
+	static CheckableCheckStatistics GetCheckStatistics(const CheckHistograms& histograms);
+	static Dictionary::Ptr GetHistogramStats(const Histogram& histogram);
+
 	static CheckableCheckStatistics CalculateHostCheckStats();
 	static CheckableCheckStatistics CalculateServiceCheckStats();
 	static HostStatistics CalculateHostStats();
 	static ServiceStatistics CalculateServiceStats();
 
+	static void UpdateStateCounters(const intrusive_ptr<Checkable>& checkable);
+
 	static std::pair<Dictionary::Ptr, Array::Ptr> GetFeatureStats();
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
@@ -92,11 +126,44 @@ public:
 private:
 	CIB();
 
+	/**
+	 * Counters which are maintained in addition to the host and service
+	 * state counters. The latter use the HostState/ServiceState values.
+	 */
+	enum StateCounter
+	{
+		StateCounterPending = ServiceUnknown + 1,
+		StateCounterUnreachable,
+		StateCounterFlapping,
+		StateCounterInDowntime,
+		StateCounterAcknowledged,
+		StateCounterMax
+	};
+
+	enum StateCounterType
+	{
+		StateCounterHost,
+		StateCounterService
+	};
+
+	static const int StateCounterShardCount = 16;
+
+	struct alignas(64) StateCounterShard
+	{
+		std::atomic<long> Counters[StateCounterService + 1][StateCounterMax];
+	};
+
+	static StateCounterShard m_StateCounterShards[StateCounterShardCount];
+
+	static double GetStateCounter(StateCounterType type, int counter);
+
 	static boost::mutex m_Mutex;
-	static RingBuffer m_ActiveHostChecksStatistics;
-	static RingBuffer m_PassiveHostChecksStatistics;
-	static RingBuffer m_ActiveServiceChecksStatistics;
-	static RingBuffer m_PassiveServiceChecksStatistics;
+	static ShardedRingBuffer m_ActiveHostChecksStatistics;
+	static ShardedRingBuffer m_PassiveHostChecksStatistics;
+	static ShardedRingBuffer m_ActiveServiceChecksStatistics;
+	static ShardedRingBuffer m_PassiveServiceChecksStatistics;
+	static CheckHistograms m_HostCheckHistograms;
+	static CheckHistograms m_ServiceCheckHistograms;
 };
 
 }
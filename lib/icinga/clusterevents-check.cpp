@@ -18,9 +18,11 @@
  ******************************************************************************/
 
 #include "icinga/clusterevents.hpp"
+#include "icinga/concurrencycontroller.hpp"
 #include "remote/apilistener.hpp"
 #include "base/serializer.hpp"
 #include "base/exception.hpp"
+#include "base/scriptglobal.hpp"
 #include <boost/thread/once.hpp>
 #include <thread>
 
@@ -33,6 +35,10 @@ int ClusterEvents::m_ChecksExecutedDuringInterval;
 int ClusterEvents::m_ChecksDroppedDuringInterval;
 Timer::Ptr ClusterEvents::m_LogTimer;
 
+boost::mutex ClusterEvents::m_BatchMutex;
+std::map<std::pair<Endpoint::Ptr, String>, std::vector<Dictionary::Ptr> > ClusterEvents::m_Batches;
+Timer::Ptr ClusterEvents::m_BatchTimer;
+
 void ClusterEvents::RemoteCheckThreadProc()
 {
 	Utility::SetThreadName("Remote Check Scheduler");
@@ -44,7 +50,7 @@ void ClusterEvents::RemoteCheckThreadProc()
 			break;
 
 		lock.unlock();
-		Checkable::AquirePendingCheckSlot(Application::GetMaxConcurrentChecks());
+		Checkable::AquirePendingCheckSlot(ConcurrencyController::GetLimit());
 		lock.lock();
 
 		auto callback = m_CheckRequestQueue.front();
@@ -66,7 +72,7 @@ void ClusterEvents::EnqueueCheck(const MessageOrigin::Ptr& origin, const Diction
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, []() {
-		m_LogTimer = new Timer();
+		m_LogTimer = new Timer("ClusterEvents check request log");
 		m_LogTimer->SetInterval(10);
 		m_LogTimer->OnTimerExpired.connect(std::bind(ClusterEvents::LogRemoteCheckQueueInformation));
 		m_LogTimer->Start();
@@ -125,7 +131,7 @@ void ClusterEvents::ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, cons
 		cr->SetState(ServiceUnknown);
 		cr->SetOutput("Endpoint '" + Endpoint::GetLocalEndpoint()->GetName() + "' does not accept commands.");
 		Dictionary::Ptr message = MakeCheckResultMessage(host, cr);
-		listener->SyncSendMessage(sourceEndpoint, message);
+		SendBatchableMessage(sourceEndpoint, message);
 
 		return;
 	}
@@ -151,7 +157,7 @@ void ClusterEvents::ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, cons
 			cr->SetState(ServiceUnknown);
 			cr->SetOutput("Check command '" + command + "' does not exist.");
 			Dictionary::Ptr message = MakeCheckResultMessage(host, cr);
-			listener->SyncSendMessage(sourceEndpoint, message);
+			SendBatchableMessage(sourceEndpoint, message);
 			return;
 		}
 	} else if (command_type == "event_command") {
@@ -189,7 +195,7 @@ void ClusterEvents::ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, cons
 			cr->SetExecutionEnd(now);
 
 			Dictionary::Ptr message = MakeCheckResultMessage(host, cr);
-			listener->SyncSendMessage(sourceEndpoint, message);
+			SendBatchableMessage(sourceEndpoint, message);
 
 			Log(LogCritical, "checker", output);
 		}
@@ -198,6 +204,173 @@ void ClusterEvents::ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, cons
 	}
 }
 
+/**
+ * Sends an event::ExecuteCommand or event::CheckResult message to an endpoint.
+ * If all connections to the endpoint announced support for it, the message is
+ * collected and sent along with the other messages of the same kind for the
+ * endpoint, either after the ApiBatchWindow or once ApiBatchSize messages are
+ * waiting.
+ *
+ * @param endpoint The endpoint.
+ * @param message The message.
+ */
+void ClusterEvents::SendBatchableMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return;
+
+	double window = 0.1;
+	Value windowValue = ScriptGlobal::Get("ApiBatchWindow", &Empty);
+
+	if (!windowValue.IsEmpty())
+		window = windowValue;
+
+	if (window <= 0 || !IsBatchingEnabled(endpoint)) {
+		listener->SyncSendMessage(endpoint, message);
+		return;
+	}
+
+	size_t size = 250;
+	Value sizeValue = ScriptGlobal::Get("ApiBatchSize", &Empty);
+
+	if (!sizeValue.IsEmpty())
+		size = std::max(1.0, static_cast<double>(sizeValue));
+
+	static boost::once_flag once = BOOST_ONCE_INIT;
+
+	boost::call_once(once, [window]() {
+		m_BatchTimer = new Timer("ClusterEvents batches");
+		m_BatchTimer->SetInterval(window);
+		m_BatchTimer->OnTimerExpired.connect(std::bind(ClusterEvents::FlushBatches));
+		m_BatchTimer->Start();
+	});
+
+	String method = message->Get("method");
+	std::vector<Dictionary::Ptr> ready;
+
+	{
+		boost::mutex::scoped_lock lock(m_BatchMutex);
+
+		std::vector<Dictionary::Ptr>& batch = m_Batches[std::make_pair(endpoint, method)];
+		batch.push_back(message);
+
+		if (batch.size() >= size)
+			ready.swap(batch);
+	}
+
+	if (!ready.empty())
+		SendBatch(endpoint, method, ready);
+}
+
+/**
+ * Checks whether all connections to an endpoint accept batched messages.
+ */
+bool ClusterEvents::IsBatchingEnabled(const Endpoint::Ptr& endpoint)
+{
+	std::set<JsonRpcConnection::Ptr> clients = endpoint->GetClients();
+
+	if (clients.empty())
+		return false;
+
+	for (const JsonRpcConnection::Ptr& client : clients) {
+		if (!client->IsBatchingEnabled())
+			return false;
+	}
+
+	return true;
+}
+
+void ClusterEvents::SendBatch(const Endpoint::Ptr& endpoint, const String& method, const std::vector<Dictionary::Ptr>& messages)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return;
+
+	ArrayData items;
+	items.reserve(messages.size());
+
+	for (const Dictionary::Ptr& message : messages)
+		items.emplace_back(message->Get("params"));
+
+	/* Even single messages are sent as a batch: The receiver processes
+	 * batches in order on the connection's work queue, so mixing them with
+	 * plain messages could reorder results for the same host. */
+	Dictionary::Ptr batch;
+
+	if (method == "event::ExecuteCommand") {
+		batch = new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "event::ExecuteCommands" },
+			{ "params", new Dictionary({ { "commands", new Array(std::move(items)) } }) }
+		});
+	} else {
+		batch = new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "event::CheckResults" },
+			{ "params", new Dictionary({ { "results", new Array(std::move(items)) } }) }
+		});
+	}
+
+	listener->SyncSendMessage(endpoint, batch);
+}
+
+void ClusterEvents::FlushBatches()
+{
+	std::map<std::pair<Endpoint::Ptr, String>, std::vector<Dictionary::Ptr> > batches;
+
+	{
+		boost::mutex::scoped_lock lock(m_BatchMutex);
+		batches.swap(m_Batches);
+	}
+
+	for (const auto& kv : batches) {
+		if (!kv.second.empty())
+			SendBatch(kv.first.first, kv.first.second, kv.second);
+	}
+}
+
+/**
+ * Passes each entry of a batched message to the handler for the single
+ * message, so they're validated and processed exactly like those.
+ */
+Value ClusterEvents::ProcessBatch(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params, const String& key,
+	const std::function<Value (const MessageOrigin::Ptr&, const Dictionary::Ptr&)>& handler)
+{
+	Array::Ptr items = params->Get(key);
+
+	if (!items)
+		return Empty;
+
+	ObjectLock olock(items);
+
+	for (const Value& item : items) {
+		if (!item.IsObjectType<Dictionary>())
+			continue;
+
+		try {
+			handler(origin, item);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "ClusterEvents")
+				<< "Error while processing batched message from '" << origin->FromClient->GetIdentity() << "': " << DiagnosticInformation(ex);
+		}
+	}
+
+	return Empty;
+}
+
+Value ClusterEvents::ExecuteCommandsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	return ProcessBatch(origin, params, "commands", &ClusterEvents::ExecuteCommandAPIHandler);
+}
+
+Value ClusterEvents::CheckResultsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	return ProcessBatch(origin, params, "results", &ClusterEvents::CheckResultAPIHandler);
+}
+
 int ClusterEvents::GetCheckRequestQueueSize()
 {
 	return m_CheckRequestQueue.size();
@@ -60,6 +60,10 @@ public:
 	static Value AcknowledgementClearedAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
 	static Value ExecuteCommandAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ExecuteCommandsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value CheckResultsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+
+	static void SendBatchableMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message);
 
 	static Dictionary::Ptr MakeCheckResultMessage(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 
@@ -86,6 +90,16 @@ private:
 	static int m_ChecksDroppedDuringInterval;
 	static Timer::Ptr m_LogTimer;
 
+	static boost::mutex m_BatchMutex;
+	static std::map<std::pair<Endpoint::Ptr, String>, std::vector<Dictionary::Ptr> > m_Batches;
+	static Timer::Ptr m_BatchTimer;
+
+	static bool IsBatchingEnabled(const Endpoint::Ptr& endpoint);
+	static void SendBatch(const Endpoint::Ptr& endpoint, const String& method, const std::vector<Dictionary::Ptr>& messages);
+	static void FlushBatches();
+	static Value ProcessBatch(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params, const String& key,
+		const std::function<Value (const MessageOrigin::Ptr&, const Dictionary::Ptr&)>& handler);
+
 	static void RemoteCheckThreadProc();
 	static void EnqueueCheck(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 	static void ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
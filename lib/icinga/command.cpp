@@ -27,6 +27,23 @@ using namespace icinga;
 
 REGISTER_TYPE(Command);
 
+/**
+ * Returns the compiled command line and arguments. The template is
+ * rebuilt whenever the 'command' or 'arguments' attribute is replaced.
+ */
+CommandTemplate::Ptr Command::GetCommandTemplate() const
+{
+	Value commandLine = GetCommandLine();
+	Dictionary::Ptr arguments = GetArguments();
+
+	boost::mutex::scoped_lock lock(m_TemplateMutex);
+
+	if (!m_CommandTemplate || !m_CommandTemplate->IsCompiledFrom(commandLine, arguments))
+		m_CommandTemplate = new CommandTemplate(commandLine, arguments);
+
+	return m_CommandTemplate;
+}
+
 void Command::Validate(int types, const ValidationUtils& utils)
 {
 	ObjectImpl<Command>::Validate(types, utils);
@@ -22,7 +22,9 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/command-ti.hpp"
+#include "icinga/macrotemplate.hpp"
 #include "remote/messageorigin.hpp"
+#include <boost/thread/mutex.hpp>
 
 namespace icinga
 {
@@ -40,6 +42,12 @@ public:
 	//virtual Dictionary::Ptr Execute(const Object::Ptr& context) = 0;
 
 	void Validate(int types, const ValidationUtils& utils) override;
+
+	CommandTemplate::Ptr GetCommandTemplate() const;
+
+private:
+	mutable boost::mutex m_TemplateMutex;
+	mutable CommandTemplate::Ptr m_CommandTemplate;
 };
 
 }
@@ -23,7 +23,7 @@
 #include "remote/configobjectutility.hpp"
 #include "base/utility.hpp"
 #include "base/configtype.hpp"
-#include "base/timer.hpp"
+#include "base/deadlinequeue.hpp"
 #include <boost/thread/once.hpp>
 
 using namespace icinga;
@@ -31,7 +31,7 @@ using namespace icinga;
 static int l_NextCommentID = 1;
 static boost::mutex l_CommentMutex;
 static std::map<int, String> l_LegacyCommentsCache;
-static Timer::Ptr l_CommentsExpireTimer;
+static DeadlineQueue::Ptr l_CommentsExpireQueue;
 
 boost::signals2::signal<void (const Comment::Ptr&)> Comment::OnCommentAdded;
 boost::signals2::signal<void (const Comment::Ptr&)> Comment::OnCommentRemoved;
@@ -97,10 +97,14 @@ void Comment::Start(bool runtimeCreated)
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, [this]() {
-		l_CommentsExpireTimer = new Timer();
-		l_CommentsExpireTimer->SetInterval(60);
-		l_CommentsExpireTimer->OnTimerExpired.connect(std::bind(&Comment::CommentsExpireTimerHandler));
-		l_CommentsExpireTimer->Start();
+		l_CommentsExpireQueue = new DeadlineQueue(&Comment::CommentExpireHandler);
+		l_CommentsExpireQueue->Start();
+
+		auto handler = [](const Comment::Ptr& comment, const Value&) { comment->UpdateDeadline(); };
+
+		ObjectImpl<Comment>::OnExpireTimeChanged.connect(handler);
+		ObjectImpl<Comment>::OnPersistentChanged.connect(handler);
+		ObjectImpl<Comment>::OnEntryTypeChanged.connect(handler);
 	});
 
 	{
@@ -115,10 +119,14 @@ void Comment::Start(bool runtimeCreated)
 
 	if (runtimeCreated)
 		OnCommentAdded(this);
+
+	UpdateDeadline();
 }
 
 void Comment::Stop(bool runtimeRemoved)
 {
+	l_CommentsExpireQueue->Remove(this);
+
 	GetCheckable()->UnregisterComment(this);
 
 	if (runtimeRemoved)
@@ -236,22 +244,31 @@ String Comment::GetCommentIDFromLegacyID(int id)
 	return it->second;
 }
 
-void Comment::CommentsExpireTimerHandler()
+/**
+ * Updates the time at which this comment is expired.
+ */
+void Comment::UpdateDeadline()
 {
-	std::vector<Comment::Ptr> comments;
+	if (!IsActive())
+		return;
 
-	for (const Comment::Ptr& comment : ConfigType::GetObjectsByType<Comment>()) {
-		comments.push_back(comment);
-	}
+	/* Do not remove persistent comments from an acknowledgement */
+	if (GetExpireTime() == 0 || (GetEntryType() == CommentAcknowledgement && GetPersistent()))
+		l_CommentsExpireQueue->Remove(this);
+	else
+		l_CommentsExpireQueue->Set(this, GetExpireTime());
+}
 
-	for (const Comment::Ptr& comment : comments) {
-		/* Only remove comments which are activated after daemon start. */
-		if (comment->IsActive() && comment->IsExpired()) {
-			/* Do not remove persistent comments from an acknowledgement */
-			if (comment->GetEntryType() == CommentAcknowledgement && comment->GetPersistent())
-				continue;
+void Comment::CommentExpireHandler(const Object::Ptr& object)
+{
+	Comment::Ptr comment = static_pointer_cast<Comment>(object);
 
-			RemoveComment(comment->GetName());
-		}
-	}
+	/* Only remove comments which are activated after daemon start. */
+	if (!comment->IsActive())
+		return;
+
+	if (comment->IsExpired())
+		RemoveComment(comment->GetName());
+	else
+		comment->UpdateDeadline();
 }
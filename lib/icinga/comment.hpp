@@ -64,7 +64,9 @@ protected:
 private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
-	static void CommentsExpireTimerHandler();
+	void UpdateDeadline();
+
+	static void CommentExpireHandler(const Object::Ptr& object);
 };
 
 }
@@ -32,6 +32,19 @@
 
 using namespace icinga;
 
+/**
+ * Emitted by the compat log writer after it has written complete lines
+ * to a log file: the file's path, the offset of the first line and the
+ * lines without their trailing newline. An offset of 0 means that the
+ * file was created.
+ */
+boost::signals2::signal<void (const String&, std::streamoff, const std::vector<String>&)> CompatUtility::OnLogLinesWritten;
+
+/**
+ * Emitted when a compat log file was renamed to its archive path.
+ */
+boost::signals2::signal<void (const String&, const String&)> CompatUtility::OnLogFileRotated;
+
 /* Used in DB IDO, StatusDataWriter and Livestatus. */
 String CompatUtility::GetCommandLine(const Command::Ptr& command)
 {
@@ -23,6 +23,8 @@
 #include "icinga/i2-icinga.hpp"
 #include "icinga/host.hpp"
 #include "icinga/command.hpp"
+#include <ios>
+#include <vector>
 
 namespace icinga
 {
@@ -62,6 +64,10 @@ public:
 	static String EscapeString(const String& str);
 	static String UnEscapeString(const String& str);
 
+	/* compat log */
+	static boost::signals2::signal<void (const String&, std::streamoff, const std::vector<String>&)> OnLogLinesWritten;
+	static boost::signals2::signal<void (const String&, const String&)> OnLogFileRotated;
+
 private:
 	CompatUtility();
 
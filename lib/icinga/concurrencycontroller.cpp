@@ -0,0 +1,205 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/concurrencycontroller.hpp"
+#include "icinga/checkable.hpp"
+#include "base/application.hpp"
+#include "base/process.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+
+using namespace icinga;
+
+/* Latency above which the limit is raised if the checker is saturated. */
+#define CONCURRENCY_LATENCY_THRESHOLD 1.0
+/* Execution time (relative to its long-term average) above which the limit is lowered. */
+#define CONCURRENCY_EXECUTION_TIME_FACTOR 2.0
+/* Load average per CPU above which the limit is lowered. */
+#define CONCURRENCY_LOAD_THRESHOLD 2.0
+
+static boost::mutex l_ConcurrencyMutex;
+static bool l_ConcurrencyAdaptive = false;
+static int l_ConcurrencyMinLimit = 1;
+static std::atomic<int> l_ConcurrencyLimit(0);
+static ConcurrencyChangeReason l_ConcurrencyReason = ConcurrencyChangeNone;
+static double l_ConcurrencyLatency = 0;
+static double l_ConcurrencyExecutionTime = 0;
+static double l_ConcurrencyBaselineExecutionTime = 0;
+static uint_fast64_t l_ConcurrencySpawnFailures = 0;
+
+/**
+ * Returns the number of checks which may currently run concurrently.
+ */
+int ConcurrencyController::GetLimit()
+{
+	int limit = l_ConcurrencyLimit;
+
+	if (limit > 0)
+		return limit;
+
+	return Application::GetMaxConcurrentChecks();
+}
+
+bool ConcurrencyController::IsAdaptive()
+{
+	boost::mutex::scoped_lock lock(l_ConcurrencyMutex);
+	return l_ConcurrencyAdaptive;
+}
+
+ConcurrencyChangeReason ConcurrencyController::GetLastChangeReason()
+{
+	boost::mutex::scoped_lock lock(l_ConcurrencyMutex);
+	return l_ConcurrencyReason;
+}
+
+String ConcurrencyController::GetLastChangeReasonText()
+{
+	switch (GetLastChangeReason()) {
+		case ConcurrencyChangeLatency:
+			return "check latency";
+		case ConcurrencyChangeExecutionTime:
+			return "check execution time";
+		case ConcurrencyChangeSpawnFailures:
+			return "process spawn failures";
+		case ConcurrencyChangeLoad:
+			return "system load";
+		default:
+			return "none";
+	}
+}
+
+/**
+ * Enables or disables the adaptive mode.
+ *
+ * @param adaptive Whether the limit should be adjusted automatically.
+ * @param minLimit The lower bound for the limit, the upper bound is MaxConcurrentChecks.
+ */
+void ConcurrencyController::SetAdaptive(bool adaptive, int minLimit)
+{
+	boost::mutex::scoped_lock lock(l_ConcurrencyMutex);
+
+	l_ConcurrencyMinLimit = std::max(1, minLimit);
+
+	if (adaptive == l_ConcurrencyAdaptive)
+		return;
+
+	l_ConcurrencyAdaptive = adaptive;
+	l_ConcurrencyReason = ConcurrencyChangeNone;
+	l_ConcurrencySpawnFailures = Process::GetSpawnFailures();
+
+	/* Start from the configured maximum; 0 means "use MaxConcurrentChecks". */
+	l_ConcurrencyLimit = adaptive ? Application::GetMaxConcurrentChecks() : 0;
+}
+
+/**
+ * Updates the latency and execution time averages from an active check result.
+ */
+void ConcurrencyController::ProcessCheckResult(const CheckResult::Ptr& cr)
+{
+	if (!cr->GetActive())
+		return;
+
+	double latency = cr->CalculateLatency();
+	double executionTime = cr->CalculateExecutionTime();
+
+	boost::mutex::scoped_lock lock(l_ConcurrencyMutex);
+
+	if (!l_ConcurrencyAdaptive)
+		return;
+
+	l_ConcurrencyLatency = 0.9 * l_ConcurrencyLatency + 0.1 * latency;
+	l_ConcurrencyExecutionTime = 0.9 * l_ConcurrencyExecutionTime + 0.1 * executionTime;
+
+	if (l_ConcurrencyBaselineExecutionTime == 0)
+		l_ConcurrencyBaselineExecutionTime = executionTime;
+	else
+		l_ConcurrencyBaselineExecutionTime = 0.999 * l_ConcurrencyBaselineExecutionTime + 0.001 * executionTime;
+}
+
+/**
+ * Adjusts the limit. This is supposed to be called periodically.
+ *
+ * Spawn failures and a high system load halve respectively reduce the
+ * limit, execution times well above their long-term average lower it
+ * slightly. The limit is only raised while checks are late and the
+ * checker actually uses the whole limit.
+ */
+void ConcurrencyController::Update()
+{
+	double load = 0;
+
+#ifndef _WIN32
+	double loadavg[1];
+
+	if (getloadavg(loadavg, 1) == 1)
+		load = loadavg[0] / std::max(1, Application::GetConcurrency());
+#endif /* _WIN32 */
+
+	uint_fast64_t spawnFailures = Process::GetSpawnFailures();
+	int pending = Checkable::GetPendingChecks();
+	int maxLimit = std::max(1, Application::GetMaxConcurrentChecks());
+
+	boost::mutex::scoped_lock lock(l_ConcurrencyMutex);
+
+	if (!l_ConcurrencyAdaptive)
+		return;
+
+	int oldLimit = l_ConcurrencyLimit;
+	int limit = oldLimit;
+	ConcurrencyChangeReason reason = ConcurrencyChangeNone;
+
+	if (spawnFailures > l_ConcurrencySpawnFailures) {
+		limit = limit / 2;
+		reason = ConcurrencyChangeSpawnFailures;
+	} else if (load > CONCURRENCY_LOAD_THRESHOLD) {
+		limit = limit * 3 / 4;
+		reason = ConcurrencyChangeLoad;
+	} else if (l_ConcurrencyBaselineExecutionTime > 0 &&
+		l_ConcurrencyExecutionTime > CONCURRENCY_EXECUTION_TIME_FACTOR * l_ConcurrencyBaselineExecutionTime) {
+		limit = limit * 9 / 10;
+		reason = ConcurrencyChangeExecutionTime;
+	} else if (l_ConcurrencyLatency > CONCURRENCY_LATENCY_THRESHOLD && pending >= limit * 9 / 10) {
+		limit = limit + std::max(1, limit / 10);
+		reason = ConcurrencyChangeLatency;
+	}
+
+	l_ConcurrencySpawnFailures = spawnFailures;
+
+	limit = std::min(maxLimit, std::max(std::min(l_ConcurrencyMinLimit, maxLimit), limit));
+
+	if (limit == oldLimit)
+		return;
+
+	l_ConcurrencyLimit = limit;
+	l_ConcurrencyReason = reason;
+
+	lock.unlock();
+
+	if (reason == ConcurrencyChangeNone) {
+		Log(LogInformation, "ConcurrencyController")
+			<< "Changed the concurrent checks limit from " << oldLimit << " to " << limit
+			<< " to match the configured bounds.";
+	} else {
+		Log(LogInformation, "ConcurrencyController")
+			<< "Changed the concurrent checks limit from " << oldLimit << " to " << limit
+			<< " because of " << GetLastChangeReasonText() << ".";
+	}
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CONCURRENCYCONTROLLER_H
+#define CONCURRENCYCONTROLLER_H
+
+#include "icinga/i2-icinga.hpp"
+#include "icinga/checkresult.hpp"
+
+namespace icinga
+{
+
+/**
+ * Reasons for the last change of the adaptive concurrent checks limit.
+ *
+ * @ingroup icinga
+ */
+enum ConcurrencyChangeReason
+{
+	ConcurrencyChangeNone = 0,
+	ConcurrencyChangeLatency = 1,
+	ConcurrencyChangeExecutionTime = 2,
+	ConcurrencyChangeSpawnFailures = 3,
+	ConcurrencyChangeLoad = 4
+};
+
+/**
+ * Determines the effective limit for concurrent checks. Unless the adaptive
+ * mode is enabled this is simply MaxConcurrentChecks. In adaptive mode the
+ * limit is adjusted between the configured minimum and MaxConcurrentChecks
+ * based on check latency, execution time, spawn failures and system load.
+ *
+ * @ingroup icinga
+ */
+class ConcurrencyController
+{
+public:
+	static int GetLimit();
+	static bool IsAdaptive();
+	static ConcurrencyChangeReason GetLastChangeReason();
+	static String GetLastChangeReasonText();
+
+	static void SetAdaptive(bool adaptive, int minLimit);
+	static void ProcessCheckResult(const CheckResult::Ptr& cr);
+	static void Update();
+
+private:
+	ConcurrencyController();
+};
+
+}
+
+#endif /* CONCURRENCYCONTROLLER_H */
@@ -20,6 +20,8 @@
 #include "icinga/customvarobject.hpp"
 #include "icinga/customvarobject-ti.cpp"
 #include "icinga/macroprocessor.hpp"
+#include "remote/customvarindex.hpp"
+#include "base/initialize.hpp"
 #include "base/logger.hpp"
 #include "base/function.hpp"
 #include "base/exception.hpp"
@@ -29,6 +31,26 @@ using namespace icinga;
 
 REGISTER_TYPE(CustomVarObject);
 
+/* Only active objects are indexed, just like the dependency graph lookups in FilterUtility. */
+INITIALIZE_ONCE([]() {
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		CustomVarObject::Ptr cvobject = dynamic_pointer_cast<CustomVarObject>(object);
+
+		if (!cvobject)
+			return;
+
+		if (cvobject->IsActive())
+			CustomVarIndex::UpdateObject(cvobject, cvobject->GetVars());
+		else
+			CustomVarIndex::RemoveObject(cvobject);
+	});
+
+	CustomVarObject::OnVarsChanged.connect([](const CustomVarObject::Ptr& object, const Value&) {
+		if (object->IsActive())
+			CustomVarIndex::UpdateObject(object, object->GetVars());
+	});
+});
+
 void CustomVarObject::ValidateVars(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils)
 {
 	MacroProcessor::ValidateCustomVars(this, lvalue());
@@ -24,7 +24,7 @@
 #include "remote/configobjectutility.hpp"
 #include "base/configtype.hpp"
 #include "base/utility.hpp"
-#include "base/timer.hpp"
+#include "base/deadlinequeue.hpp"
 #include <boost/thread/once.hpp>
 
 using namespace icinga;
@@ -32,8 +32,8 @@ using namespace icinga;
 static int l_NextDowntimeID = 1;
 static boost::mutex l_DowntimeMutex;
 static std::map<int, String> l_LegacyDowntimesCache;
-static Timer::Ptr l_DowntimesExpireTimer;
-static Timer::Ptr l_DowntimesStartTimer;
+static DeadlineQueue::Ptr l_DowntimesStartQueue;
+static DeadlineQueue::Ptr l_DowntimesExpireQueue;
 
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeAdded;
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeRemoved;
@@ -101,15 +101,19 @@ void Downtime::Start(bool runtimeCreated)
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, [this]() {
-		l_DowntimesStartTimer = new Timer();
-		l_DowntimesStartTimer->SetInterval(5);
-		l_DowntimesStartTimer->OnTimerExpired.connect(std::bind(&Downtime::DowntimesStartTimerHandler));
-		l_DowntimesStartTimer->Start();
-
-		l_DowntimesExpireTimer = new Timer();
-		l_DowntimesExpireTimer->SetInterval(60);
-		l_DowntimesExpireTimer->OnTimerExpired.connect(std::bind(&Downtime::DowntimesExpireTimerHandler));
-		l_DowntimesExpireTimer->Start();
+		l_DowntimesStartQueue = new DeadlineQueue(&Downtime::DowntimeStartHandler);
+		l_DowntimesStartQueue->Start();
+
+		l_DowntimesExpireQueue = new DeadlineQueue(&Downtime::DowntimeExpireHandler);
+		l_DowntimesExpireQueue->Start();
+
+		auto handler = [](const Downtime::Ptr& downtime, const Value&) { downtime->UpdateDeadlines(); };
+
+		ObjectImpl<Downtime>::OnStartTimeChanged.connect(handler);
+		ObjectImpl<Downtime>::OnEndTimeChanged.connect(handler);
+		ObjectImpl<Downtime>::OnFixedChanged.connect(handler);
+		ObjectImpl<Downtime>::OnDurationChanged.connect(handler);
+		ObjectImpl<Downtime>::OnTriggerTimeChanged.connect(handler);
 	});
 
 	{
@@ -127,6 +131,11 @@ void Downtime::Start(bool runtimeCreated)
 	if (runtimeCreated)
 		OnDowntimeAdded(this);
 
+	UpdateDeadlines();
+
+	if (!HasValidConfigOwner())
+		QueueExpiryCheck();
+
 	/* if this object is already in a NOT-OK state trigger
 	 * this downtime now *after* it has been added (important
 	 * for DB IDO, etc.)
@@ -141,6 +150,9 @@ void Downtime::Start(bool runtimeCreated)
 
 void Downtime::Stop(bool runtimeRemoved)
 {
+	l_DowntimesStartQueue->Remove(this);
+	l_DowntimesExpireQueue->Remove(this);
+
 	GetCheckable()->UnregisterDowntime(this);
 
 	if (runtimeRemoved)
@@ -374,37 +386,66 @@ String Downtime::GetDowntimeIDFromLegacyID(int id)
 	return it->second;
 }
 
-void Downtime::DowntimesStartTimerHandler()
+/**
+ * Updates the times at which this downtime is started and expired.
+ * Flexible downtimes are triggered on-demand and only need to expire.
+ */
+void Downtime::UpdateDeadlines()
 {
-	/* Start fixed downtimes. Flexible downtimes will be triggered on-demand. */
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
-		if (downtime->IsActive() &&
-			downtime->CanBeTriggered() &&
-			downtime->GetFixed()) {
-			/* Send notifications. */
-			OnDowntimeStarted(downtime);
-
-			/* Trigger fixed downtime immediately. */
-			downtime->TriggerDowntime();
-		}
-	}
+	if (!IsActive())
+		return;
+
+	if (GetFixed() && GetTriggerTime() == 0)
+		l_DowntimesStartQueue->Set(this, GetStartTime());
+	else
+		l_DowntimesStartQueue->Remove(this);
+
+	double triggerTime = GetTriggerTime();
+
+	if (!GetFixed() && triggerTime > 0)
+		l_DowntimesExpireQueue->Set(this, triggerTime + GetDuration());
+	else
+		l_DowntimesExpireQueue->Set(this, GetEndTime());
 }
 
-void Downtime::DowntimesExpireTimerHandler()
+/**
+ * Checks whether this downtime has expired or lost its config owner as soon
+ * as possible rather than at its end time.
+ */
+void Downtime::QueueExpiryCheck()
 {
-	std::vector<Downtime::Ptr> downtimes;
+	l_DowntimesExpireQueue->Set(this, 0);
+}
 
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
-		downtimes.push_back(downtime);
-	}
+void Downtime::DowntimeStartHandler(const Object::Ptr& object)
+{
+	Downtime::Ptr downtime = static_pointer_cast<Downtime>(object);
+
+	if (downtime->IsActive() &&
+		downtime->CanBeTriggered() &&
+		downtime->GetFixed()) {
+		/* Send notifications. */
+		OnDowntimeStarted(downtime);
 
-	for (const Downtime::Ptr& downtime : downtimes) {
-		/* Only remove downtimes which are activated after daemon start. */
-		if (downtime->IsActive() && (downtime->IsExpired() || !downtime->HasValidConfigOwner()))
-			RemoveDowntime(downtime->GetName(), false, true);
+		/* Trigger fixed downtime immediately. */
+		downtime->TriggerDowntime();
 	}
 }
 
+void Downtime::DowntimeExpireHandler(const Object::Ptr& object)
+{
+	Downtime::Ptr downtime = static_pointer_cast<Downtime>(object);
+
+	/* Only remove downtimes which are activated after daemon start. */
+	if (!downtime->IsActive())
+		return;
+
+	if (downtime->IsExpired() || !downtime->HasValidConfigOwner())
+		RemoveDowntime(downtime->GetName(), false, true);
+	else
+		downtime->UpdateDeadlines();
+}
+
 void Downtime::ValidateStartTime(const Lazy<Timestamp>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<Downtime>::ValidateStartTime(lvalue, utils);
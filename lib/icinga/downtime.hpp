@@ -62,6 +62,7 @@ public:
 	static void RemoveDowntime(const String& id, bool cancelled, bool expired = false, const MessageOrigin::Ptr& origin = nullptr);
 
 	void TriggerDowntime();
+	void QueueExpiryCheck();
 
 	static String GetDowntimeIDFromLegacyID(int id);
 
@@ -77,9 +78,10 @@ private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
 	bool CanBeTriggered();
+	void UpdateDeadlines();
 
-	static void DowntimesStartTimerHandler();
-	static void DowntimesExpireTimerHandler();
+	static void DowntimeStartHandler(const Object::Ptr& object);
+	static void DowntimeExpireHandler(const Object::Ptr& object);
 };
 
 }
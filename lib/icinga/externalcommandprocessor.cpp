@@ -38,64 +38,170 @@
 #include "base/exception.hpp"
 #include <fstream>
 #include <boost/thread/once.hpp>
+#include <boost/thread/tss.hpp>
 
 using namespace icinga;
 
 boost::signals2::signal<void(double, const String&, const std::vector<String>&)> ExternalCommandProcessor::OnNewExternalCommand;
 
-void ExternalCommandProcessor::Execute(const String& line)
+/* Number of recently resolved hosts and services cached per thread. */
+#define RESOLVED_CHECKABLE_CACHE_SIZE 1024
+
+namespace
 {
-	if (line.IsEmpty())
-		return;
 
+struct ResolvedCheckable
+{
+	String HostName;
+	String ServiceName;
+	Host::Ptr HostObject;
+	Service::Ptr ServiceObject;
+};
+
+}
+
+static boost::thread_specific_ptr<std::vector<ResolvedCheckable> > l_ResolvedCheckables;
+
+static ResolvedCheckable& GetResolvedCheckable(const String& hostName, const String& serviceName)
+{
+	std::vector<ResolvedCheckable> *cache = l_ResolvedCheckables.get();
+
+	if (!cache) {
+		cache = new std::vector<ResolvedCheckable>(RESOLVED_CHECKABLE_CACHE_SIZE);
+		l_ResolvedCheckables.reset(cache);
+	}
+
+	std::hash<std::string> hasher;
+	size_t hash = hasher(hostName.GetData()) * 31 + hasher(serviceName.GetData());
+
+	return (*cache)[hash % RESOLVED_CHECKABLE_CACHE_SIZE];
+}
+
+/**
+ * Looks up a host by name. Passive check results usually arrive for the
+ * same hosts over and over again, so recently resolved hosts are cached.
+ * Objects which were deactivated are looked up again.
+ */
+static Host::Ptr ResolveHost(const String& hostName)
+{
+	ResolvedCheckable& entry = GetResolvedCheckable(hostName, String());
+
+	if (entry.HostObject && !entry.ServiceObject && entry.HostObject->IsActive() && entry.HostName == hostName)
+		return entry.HostObject;
+
+	Host::Ptr host = Host::GetByName(hostName);
+
+	if (host) {
+		entry.HostName = hostName;
+		entry.ServiceName = String();
+		entry.HostObject = host;
+		entry.ServiceObject = nullptr;
+	}
+
+	return host;
+}
+
+/**
+ * Looks up a service by its host and short name using the same cache as ResolveHost.
+ */
+static Service::Ptr ResolveService(const String& hostName, const String& serviceName)
+{
+	ResolvedCheckable& entry = GetResolvedCheckable(hostName, serviceName);
+
+	if (entry.ServiceObject && entry.ServiceObject->IsActive() && entry.HostName == hostName && entry.ServiceName == serviceName)
+		return entry.ServiceObject;
+
+	Service::Ptr service = Service::GetByNamePair(hostName, serviceName);
+
+	if (service) {
+		entry.HostName = hostName;
+		entry.ServiceName = serviceName;
+		entry.HostObject = nullptr;
+		entry.ServiceObject = service;
+	}
+
+	return service;
+}
+
+/**
+ * Splits an external command line ("[<timestamp>] <command>;<arguments>")
+ * into its timestamp and the command name.
+ *
+ * @returns The position of the separator in front of the first argument
+ *          or String::NPos if there are no arguments.
+ */
+static String::SizeType ParseCommandLine(const String& line, double& ts, String& command)
+{
 	if (line[0] != '[')
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
 
-	size_t pos = line.FindFirstOf("]");
+	const std::string& data = line.GetData();
+
+	String::SizeType pos = data.find(']');
 
 	if (pos == String::NPos)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
 
-	String timestamp = line.SubStr(1, pos - 1);
-	String args = line.SubStr(pos + 2, String::NPos);
-
-	double ts = Convert::ToDouble(timestamp);
+	ts = Convert::ToDouble(line.SubStr(1, pos - 1));
 
 	if (ts == 0)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid timestamp in command: " + line));
 
-	std::vector<String> argv = args.Split(";");
+	String::SizeType begin = std::min(pos + 2, data.size());
+	String::SizeType end = data.find(';', begin);
 
-	if (argv.empty())
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing arguments in command: " + line));
+	command = String(data.begin() + begin, end == String::NPos ? data.end() : data.begin() + end);
 
-	std::vector<String> argvExtra(argv.begin() + 1, argv.end());
-	Execute(ts, argv[0], argvExtra);
+	return end;
 }
 
-void ExternalCommandProcessor::Execute(double time, const String& command, const std::vector<String>& arguments)
+/**
+ * Splits the arguments of an external command line in a single pass. The
+ * last argument contains the rest of the line (including any further
+ * semicolons) so that it doesn't have to be joined together again.
+ */
+static void TokenizeArguments(const String& line, String::SizeType pos, size_t maxArgs, std::vector<String>& arguments)
 {
-	ExternalCommandInfo eci;
-
-	static boost::once_flag once = BOOST_ONCE_INIT;
+	if (pos == String::NPos || maxArgs == 0)
+		return;
 
-	boost::call_once(once, []() {
-		RegisterCommands();
-	});
+	const std::string& data = line.GetData();
 
-	{
-		boost::mutex::scoped_lock lock(GetMutex());
+	arguments.reserve(maxArgs);
 
-		auto it = GetCommands().find(command);
+	for (;;) {
+		String::SizeType next = (arguments.size() + 1 < maxArgs) ? data.find(';', pos + 1) : String::NPos;
 
-		if (it == GetCommands().end())
-			BOOST_THROW_EXCEPTION(std::invalid_argument("The external command '" + command + "' does not exist."));
+		if (next == String::NPos) {
+			arguments.emplace_back(data.begin() + pos + 1, data.end());
+			break;
+		}
 
-		eci = it->second;
+		arguments.emplace_back(data.begin() + pos + 1, data.begin() + next);
+		pos = next;
 	}
+}
 
-	if (arguments.size() < eci.MinArgs)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Expected " + Convert::ToString(eci.MinArgs) + " arguments"));
+void ExternalCommandProcessor::Execute(const String& line)
+{
+	if (line.IsEmpty())
+		return;
+
+	double ts;
+	String command;
+	String::SizeType pos = ParseCommandLine(line, ts, command);
+
+	const ExternalCommandInfo& eci = GetCommandInfo(command);
+
+	std::vector<String> arguments;
+	TokenizeArguments(line, pos, eci.MaxArgs, arguments);
+
+	ExecuteCommand(ts, command, eci, arguments);
+}
+
+void ExternalCommandProcessor::Execute(double time, const String& command, const std::vector<String>& arguments)
+{
+	const ExternalCommandInfo& eci = GetCommandInfo(command);
 
 	size_t argnum = std::min(arguments.size(), eci.MaxArgs);
 
@@ -116,9 +222,35 @@ void ExternalCommandProcessor::Execute(double time, const String& command, const
 		realArguments[argnum - 1] = last_argument;
 	}
 
-	OnNewExternalCommand(time, command, realArguments);
+	ExecuteCommand(time, command, eci, realArguments);
+}
+
+const ExternalCommandInfo& ExternalCommandProcessor::GetCommandInfo(const String& command)
+{
+	static boost::once_flag once = BOOST_ONCE_INIT;
+
+	boost::call_once(once, []() {
+		RegisterCommands();
+	});
+
+	/* The command table isn't modified after it has been filled, no lock is needed. */
+	const auto& commands = GetCommands();
+	auto it = commands.find(command.GetData());
+
+	if (it == commands.end())
+		BOOST_THROW_EXCEPTION(std::invalid_argument("The external command '" + command + "' does not exist."));
+
+	return it->second;
+}
+
+void ExternalCommandProcessor::ExecuteCommand(double time, const String& command, const ExternalCommandInfo& eci, const std::vector<String>& arguments)
+{
+	if (arguments.size() < eci.MinArgs)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Expected " + Convert::ToString(eci.MinArgs) + " arguments"));
+
+	OnNewExternalCommand(time, command, arguments);
 
-	eci.Callback(time, realArguments);
+	eci.Callback(time, arguments);
 }
 
 void ExternalCommandProcessor::RegisterCommand(const String& command, const ExternalCommandCallback& callback, size_t minArgs, size_t maxArgs)
@@ -128,7 +260,7 @@ void ExternalCommandProcessor::RegisterCommand(const String& command, const Exte
 	eci.Callback = callback;
 	eci.MinArgs = minArgs;
 	eci.MaxArgs = (maxArgs == UINT_MAX) ? minArgs : maxArgs;
-	GetCommands()[command] = eci;
+	GetCommands()[command.GetData()] = eci;
 }
 
 void ExternalCommandProcessor::RegisterCommands()
@@ -258,41 +390,30 @@ void ExternalCommandProcessor::ExecuteFromFile(const String& line, std::deque< s
 	if (line.IsEmpty())
 		return;
 
-	if (line[0] != '[')
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
-
-	size_t pos = line.FindFirstOf("]");
-
-	if (pos == String::NPos)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
-
-	String timestamp = line.SubStr(1, pos - 1);
-	String args = line.SubStr(pos + 2, String::NPos);
-
-	double ts = Convert::ToDouble(timestamp);
-
-	if (ts == 0)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid timestamp in command: " + line));
+	double ts;
+	String command;
+	String::SizeType pos = ParseCommandLine(line, ts, command);
 
-	std::vector<String> argv = args.Split(";");
+	const ExternalCommandInfo& eci = GetCommandInfo(command);
 
-	if (argv.empty())
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing arguments in command: " + line));
+	std::vector<String> arguments;
+	TokenizeArguments(line, pos, eci.MaxArgs, arguments);
 
-	std::vector<String> argvExtra(argv.begin() + 1, argv.end());
+	if (command == "PROCESS_FILE") {
+		if (arguments.size() < eci.MinArgs)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Expected " + Convert::ToString(eci.MinArgs) + " arguments"));
 
-	if (argv[0] == "PROCESS_FILE") {
 		Log(LogDebug, "ExternalCommandProcessor")
-			<< "Enqueing external command file " << argvExtra[0];
-		file_queue.push_back(argvExtra);
+			<< "Enqueing external command file " << arguments[0];
+		file_queue.push_back(arguments);
 	} else {
-		Execute(ts, argv[0], argvExtra);
+		ExecuteCommand(ts, command, eci, arguments);
 	}
 }
 
 void ExternalCommandProcessor::ProcessHostCheckResult(double time, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot process passive host check result for non-existent host '" + arguments[0] + "'"));
@@ -333,7 +454,7 @@ void ExternalCommandProcessor::ProcessHostCheckResult(double time, const std::ve
 
 void ExternalCommandProcessor::ProcessServiceCheckResult(double time, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot process passive service check result for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -365,7 +486,7 @@ void ExternalCommandProcessor::ProcessServiceCheckResult(double time, const std:
 
 void ExternalCommandProcessor::ScheduleHostCheck(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot reschedule host check for non-existent host '" + arguments[0] + "'"));
@@ -393,7 +514,7 @@ void ExternalCommandProcessor::ScheduleHostCheck(double, const std::vector<Strin
 
 void ExternalCommandProcessor::ScheduleForcedHostCheck(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot reschedule forced host check for non-existent host '" + arguments[0] + "'"));
@@ -410,7 +531,7 @@ void ExternalCommandProcessor::ScheduleForcedHostCheck(double, const std::vector
 
 void ExternalCommandProcessor::ScheduleSvcCheck(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot reschedule service check for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -438,7 +559,7 @@ void ExternalCommandProcessor::ScheduleSvcCheck(double, const std::vector<String
 
 void ExternalCommandProcessor::ScheduleForcedSvcCheck(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot reschedule forced service check for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -455,7 +576,7 @@ void ExternalCommandProcessor::ScheduleForcedSvcCheck(double, const std::vector<
 
 void ExternalCommandProcessor::EnableHostCheck(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable host checks for non-existent host '" + arguments[0] + "'"));
@@ -468,7 +589,7 @@ void ExternalCommandProcessor::EnableHostCheck(double, const std::vector<String>
 
 void ExternalCommandProcessor::DisableHostCheck(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable host check non-existent host '" + arguments[0] + "'"));
@@ -481,7 +602,7 @@ void ExternalCommandProcessor::DisableHostCheck(double, const std::vector<String
 
 void ExternalCommandProcessor::EnableSvcCheck(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable service check for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -494,7 +615,7 @@ void ExternalCommandProcessor::EnableSvcCheck(double, const std::vector<String>&
 
 void ExternalCommandProcessor::DisableSvcCheck(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable service check for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -521,7 +642,7 @@ void ExternalCommandProcessor::ScheduleForcedHostSvcChecks(double, const std::ve
 {
 	double planned_check = Convert::ToDouble(arguments[1]);
 
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot reschedule forced host service checks for non-existent host '" + arguments[0] + "'"));
@@ -542,7 +663,7 @@ void ExternalCommandProcessor::ScheduleHostSvcChecks(double, const std::vector<S
 {
 	double planned_check = Convert::ToDouble(arguments[1]);
 
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot reschedule host service checks for non-existent host '" + arguments[0] + "'"));
@@ -570,7 +691,7 @@ void ExternalCommandProcessor::ScheduleHostSvcChecks(double, const std::vector<S
 
 void ExternalCommandProcessor::EnableHostSvcChecks(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable host service checks for non-existent host '" + arguments[0] + "'"));
@@ -585,7 +706,7 @@ void ExternalCommandProcessor::EnableHostSvcChecks(double, const std::vector<Str
 
 void ExternalCommandProcessor::DisableHostSvcChecks(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable host service checks for non-existent host '" + arguments[0] + "'"));
@@ -604,7 +725,7 @@ void ExternalCommandProcessor::AcknowledgeSvcProblem(double, const std::vector<S
 	bool notify = (Convert::ToLong(arguments[3]) > 0 ? true : false);
 	bool persistent = (Convert::ToLong(arguments[4]) > 0 ? true : false);
 
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot acknowledge service problem for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -626,7 +747,7 @@ void ExternalCommandProcessor::AcknowledgeSvcProblemExpire(double, const std::ve
 	bool persistent = (Convert::ToLong(arguments[4]) > 0 ? true : false);
 	double timestamp = Convert::ToDouble(arguments[5]);
 
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot acknowledge service problem with expire time for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -646,7 +767,7 @@ void ExternalCommandProcessor::AcknowledgeSvcProblemExpire(double, const std::ve
 
 void ExternalCommandProcessor::RemoveSvcAcknowledgement(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot remove service acknowledgement for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -668,7 +789,7 @@ void ExternalCommandProcessor::AcknowledgeHostProblem(double, const std::vector<
 	bool notify = (Convert::ToLong(arguments[2]) > 0 ? true : false);
 	bool persistent = (Convert::ToLong(arguments[3]) > 0 ? true : false);
 
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot acknowledge host problem for non-existent host '" + arguments[0] + "'"));
@@ -690,7 +811,7 @@ void ExternalCommandProcessor::AcknowledgeHostProblemExpire(double, const std::v
 	bool persistent = (Convert::ToLong(arguments[3]) > 0 ? true : false);
 	double timestamp = Convert::ToDouble(arguments[4]);
 
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot acknowledge host problem with expire time for non-existent host '" + arguments[0] + "'"));
@@ -710,7 +831,7 @@ void ExternalCommandProcessor::AcknowledgeHostProblemExpire(double, const std::v
 
 void ExternalCommandProcessor::RemoveHostAcknowledgement(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot remove acknowledgement for non-existent host '" + arguments[0] + "'"));
@@ -791,7 +912,7 @@ void ExternalCommandProcessor::DisableServicegroupSvcChecks(double, const std::v
 
 void ExternalCommandProcessor::EnablePassiveHostChecks(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable passive host checks for non-existent host '" + arguments[0] + "'"));
@@ -804,7 +925,7 @@ void ExternalCommandProcessor::EnablePassiveHostChecks(double, const std::vector
 
 void ExternalCommandProcessor::DisablePassiveHostChecks(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable passive host checks for non-existent host '" + arguments[0] + "'"));
@@ -817,7 +938,7 @@ void ExternalCommandProcessor::DisablePassiveHostChecks(double, const std::vecto
 
 void ExternalCommandProcessor::EnablePassiveSvcChecks(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable service checks for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -830,7 +951,7 @@ void ExternalCommandProcessor::EnablePassiveSvcChecks(double, const std::vector<
 
 void ExternalCommandProcessor::DisablePassiveSvcChecks(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable service checks for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -946,7 +1067,7 @@ void ExternalCommandProcessor::ProcessFile(double, const std::vector<String>& ar
 
 void ExternalCommandProcessor::ScheduleSvcDowntime(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot schedule service downtime for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -975,7 +1096,7 @@ void ExternalCommandProcessor::DelSvcDowntime(double, const std::vector<String>&
 
 void ExternalCommandProcessor::ScheduleHostDowntime(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot schedule host downtime for non-existent host '" + arguments[0] + "'"));
@@ -996,7 +1117,7 @@ void ExternalCommandProcessor::ScheduleHostDowntime(double, const std::vector<St
 
 void ExternalCommandProcessor::ScheduleAndPropagateHostDowntime(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot schedule and propagate host downtime for non-existent host '" + arguments[0] + "'"));
@@ -1032,7 +1153,7 @@ void ExternalCommandProcessor::ScheduleAndPropagateHostDowntime(double, const st
 
 void ExternalCommandProcessor::ScheduleAndPropagateTriggeredHostDowntime(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot schedule and propagate triggered host downtime for non-existent host '" + arguments[0] + "'"));
@@ -1077,7 +1198,7 @@ void ExternalCommandProcessor::DelHostDowntime(double, const std::vector<String>
 
 void ExternalCommandProcessor::DelDowntimeByHostName(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot schedule host services downtime for non-existent host '" + arguments[0] + "'"));
@@ -1126,7 +1247,7 @@ void ExternalCommandProcessor::DelDowntimeByHostName(double, const std::vector<S
 
 void ExternalCommandProcessor::ScheduleHostSvcDowntime(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot schedule host services downtime for non-existent host '" + arguments[0] + "'"));
@@ -1267,7 +1388,7 @@ void ExternalCommandProcessor::ScheduleServicegroupSvcDowntime(double, const std
 
 void ExternalCommandProcessor::AddHostComment(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot add host comment for non-existent host '" + arguments[0] + "'"));
@@ -1291,7 +1412,7 @@ void ExternalCommandProcessor::DelHostComment(double, const std::vector<String>&
 
 void ExternalCommandProcessor::AddSvcComment(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot add service comment for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1316,7 +1437,7 @@ void ExternalCommandProcessor::DelSvcComment(double, const std::vector<String>&
 
 void ExternalCommandProcessor::DelAllHostComments(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot delete all host comments for non-existent host '" + arguments[0] + "'"));
@@ -1328,7 +1449,7 @@ void ExternalCommandProcessor::DelAllHostComments(double, const std::vector<Stri
 
 void ExternalCommandProcessor::DelAllSvcComments(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot delete all service comments for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1340,7 +1461,7 @@ void ExternalCommandProcessor::DelAllSvcComments(double, const std::vector<Strin
 
 void ExternalCommandProcessor::SendCustomHostNotification(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot send custom host notification for non-existent host '" + arguments[0] + "'"));
@@ -1359,7 +1480,7 @@ void ExternalCommandProcessor::SendCustomHostNotification(double, const std::vec
 
 void ExternalCommandProcessor::SendCustomSvcNotification(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot send custom service notification for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1379,7 +1500,7 @@ void ExternalCommandProcessor::SendCustomSvcNotification(double, const std::vect
 
 void ExternalCommandProcessor::DelayHostNotification(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot delay host notification for non-existent host '" + arguments[0] + "'"));
@@ -1394,7 +1515,7 @@ void ExternalCommandProcessor::DelayHostNotification(double, const std::vector<S
 
 void ExternalCommandProcessor::DelaySvcNotification(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot delay service notification for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1409,7 +1530,7 @@ void ExternalCommandProcessor::DelaySvcNotification(double, const std::vector<St
 
 void ExternalCommandProcessor::EnableHostNotifications(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable host notifications for non-existent host '" + arguments[0] + "'"));
@@ -1422,7 +1543,7 @@ void ExternalCommandProcessor::EnableHostNotifications(double, const std::vector
 
 void ExternalCommandProcessor::DisableHostNotifications(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable host notifications for non-existent host '" + arguments[0] + "'"));
@@ -1435,7 +1556,7 @@ void ExternalCommandProcessor::DisableHostNotifications(double, const std::vecto
 
 void ExternalCommandProcessor::EnableSvcNotifications(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable service notifications for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1448,7 +1569,7 @@ void ExternalCommandProcessor::EnableSvcNotifications(double, const std::vector<
 
 void ExternalCommandProcessor::DisableSvcNotifications(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable service notifications for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1461,7 +1582,7 @@ void ExternalCommandProcessor::DisableSvcNotifications(double, const std::vector
 
 void ExternalCommandProcessor::EnableHostSvcNotifications(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable notifications for all services for non-existent host '" + arguments[0] + "'"));
@@ -1479,7 +1600,7 @@ void ExternalCommandProcessor::EnableHostSvcNotifications(double, const std::vec
 
 void ExternalCommandProcessor::DisableHostSvcNotifications(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable notifications for all services  for non-existent host '" + arguments[0] + "'"));
@@ -1625,7 +1746,7 @@ void ExternalCommandProcessor::EnableServicegroupPassiveHostChecks(double, const
 
 void ExternalCommandProcessor::EnableHostFlapping(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable host flapping for non-existent host '" + arguments[0] + "'"));
@@ -1638,7 +1759,7 @@ void ExternalCommandProcessor::EnableHostFlapping(double, const std::vector<Stri
 
 void ExternalCommandProcessor::DisableHostFlapping(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable host flapping for non-existent host '" + arguments[0] + "'"));
@@ -1651,7 +1772,7 @@ void ExternalCommandProcessor::DisableHostFlapping(double, const std::vector<Str
 
 void ExternalCommandProcessor::EnableSvcFlapping(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable service flapping for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1664,7 +1785,7 @@ void ExternalCommandProcessor::EnableSvcFlapping(double, const std::vector<Strin
 
 void ExternalCommandProcessor::DisableSvcFlapping(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable service flapping for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1761,7 +1882,7 @@ void ExternalCommandProcessor::StopExecutingHostChecks(double, const std::vector
 
 void ExternalCommandProcessor::ChangeNormalSvcCheckInterval(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot update check interval for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1776,7 +1897,7 @@ void ExternalCommandProcessor::ChangeNormalSvcCheckInterval(double, const std::v
 
 void ExternalCommandProcessor::ChangeNormalHostCheckInterval(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot update check interval for non-existent host '" + arguments[0] + "'"));
@@ -1791,7 +1912,7 @@ void ExternalCommandProcessor::ChangeNormalHostCheckInterval(double, const std::
 
 void ExternalCommandProcessor::ChangeRetrySvcCheckInterval(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot update retry interval for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1806,7 +1927,7 @@ void ExternalCommandProcessor::ChangeRetrySvcCheckInterval(double, const std::ve
 
 void ExternalCommandProcessor::ChangeRetryHostCheckInterval(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot update retry interval for non-existent host '" + arguments[0] + "'"));
@@ -1821,7 +1942,7 @@ void ExternalCommandProcessor::ChangeRetryHostCheckInterval(double, const std::v
 
 void ExternalCommandProcessor::EnableHostEventHandler(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable event handler for non-existent host '" + arguments[0] + "'"));
@@ -1834,7 +1955,7 @@ void ExternalCommandProcessor::EnableHostEventHandler(double, const std::vector<
 
 void ExternalCommandProcessor::DisableHostEventHandler(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable event handler for non-existent host '" + arguments[0] + "'"));
@@ -1847,7 +1968,7 @@ void ExternalCommandProcessor::DisableHostEventHandler(double, const std::vector
 
 void ExternalCommandProcessor::EnableSvcEventHandler(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable event handler for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1860,7 +1981,7 @@ void ExternalCommandProcessor::EnableSvcEventHandler(double, const std::vector<S
 
 void ExternalCommandProcessor::DisableSvcEventHandler(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable event handler for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1873,7 +1994,7 @@ void ExternalCommandProcessor::DisableSvcEventHandler(double, const std::vector<
 
 void ExternalCommandProcessor::ChangeHostEventHandler(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change event handler for non-existent host '" + arguments[0] + "'"));
@@ -1898,7 +2019,7 @@ void ExternalCommandProcessor::ChangeHostEventHandler(double, const std::vector<
 
 void ExternalCommandProcessor::ChangeSvcEventHandler(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change event handler for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1923,7 +2044,7 @@ void ExternalCommandProcessor::ChangeSvcEventHandler(double, const std::vector<S
 
 void ExternalCommandProcessor::ChangeHostCheckCommand(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change check command for non-existent host '" + arguments[0] + "'"));
@@ -1941,7 +2062,7 @@ void ExternalCommandProcessor::ChangeHostCheckCommand(double, const std::vector<
 
 void ExternalCommandProcessor::ChangeSvcCheckCommand(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change check command for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1959,7 +2080,7 @@ void ExternalCommandProcessor::ChangeSvcCheckCommand(double, const std::vector<S
 
 void ExternalCommandProcessor::ChangeMaxHostCheckAttempts(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change max check attempts for non-existent host '" + arguments[0] + "'"));
@@ -1974,7 +2095,7 @@ void ExternalCommandProcessor::ChangeMaxHostCheckAttempts(double, const std::vec
 
 void ExternalCommandProcessor::ChangeMaxSvcCheckAttempts(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change max check attempts for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -1989,7 +2110,7 @@ void ExternalCommandProcessor::ChangeMaxSvcCheckAttempts(double, const std::vect
 
 void ExternalCommandProcessor::ChangeHostCheckTimeperiod(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change check period for non-existent host '" + arguments[0] + "'"));
@@ -2007,7 +2128,7 @@ void ExternalCommandProcessor::ChangeHostCheckTimeperiod(double, const std::vect
 
 void ExternalCommandProcessor::ChangeSvcCheckTimeperiod(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change check period for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -2025,7 +2146,7 @@ void ExternalCommandProcessor::ChangeSvcCheckTimeperiod(double, const std::vecto
 
 void ExternalCommandProcessor::ChangeCustomHostVar(double, const std::vector<String>& arguments)
 {
-	Host::Ptr host = Host::GetByName(arguments[0]);
+	Host::Ptr host = ResolveHost(arguments[0]);
 
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change custom var for non-existent host '" + arguments[0] + "'"));
@@ -2038,7 +2159,7 @@ void ExternalCommandProcessor::ChangeCustomHostVar(double, const std::vector<Str
 
 void ExternalCommandProcessor::ChangeCustomSvcVar(double, const std::vector<String>& arguments)
 {
-	Service::Ptr service = Service::GetByNamePair(arguments[0], arguments[1]);
+	Service::Ptr service = ResolveService(arguments[0], arguments[1]);
 
 	if (!service)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot change custom var for non-existent service '" + arguments[1] + "' on host '" + arguments[0] + "'"));
@@ -2235,9 +2356,9 @@ boost::mutex& ExternalCommandProcessor::GetMutex()
 	return mtx;
 }
 
-std::map<String, ExternalCommandInfo>& ExternalCommandProcessor::GetCommands()
+std::unordered_map<std::string, ExternalCommandInfo>& ExternalCommandProcessor::GetCommands()
 {
-	static std::map<String, ExternalCommandInfo> commands;
+	static std::unordered_map<std::string, ExternalCommandInfo> commands;
 	return commands;
 }
 
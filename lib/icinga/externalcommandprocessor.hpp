@@ -24,6 +24,7 @@
 #include "icinga/command.hpp"
 #include "base/string.hpp"
 #include <boost/signals2.hpp>
+#include <unordered_map>
 #include <vector>
 
 namespace icinga
@@ -177,7 +178,9 @@ private:
 	static void RegisterCommands();
 
 	static boost::mutex& GetMutex();
-	static std::map<String, ExternalCommandInfo>& GetCommands();
+	static std::unordered_map<std::string, ExternalCommandInfo>& GetCommands();
+	static const ExternalCommandInfo& GetCommandInfo(const String& command);
+	static void ExecuteCommand(double time, const String& command, const ExternalCommandInfo& eci, const std::vector<String>& arguments);
 
 };
 
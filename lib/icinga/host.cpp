@@ -325,7 +325,7 @@ bool Host::ResolveMacro(const String& macro, const CheckResult::Ptr&, Value *res
 			*result = cr->GetOutput();
 			return true;
 		} else if (macro == "perfdata") {
-			*result = PluginUtility::FormatPerfdata(cr->GetPerformanceData());
+			*result = cr->GetFormattedPerformanceData();
 			return true;
 		} else if (macro == "check_source") {
 			*result = cr->GetCheckSource();
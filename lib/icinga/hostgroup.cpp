@@ -26,13 +26,22 @@
 #include "base/objectlock.hpp"
 #include "base/context.hpp"
 #include "base/workqueue.hpp"
+#include <algorithm>
+#include <atomic>
 
 using namespace icinga;
 
 REGISTER_TYPE(HostGroup);
 
+/* Invalidates the resolved nested groups of all host groups. */
+static std::atomic<int> l_HostGroupGeneration{0};
+
 INITIALIZE_ONCE([]() {
 	ObjectRule::RegisterType("HostGroup");
+
+	HostGroup::OnGroupsChanged.connect([](const HostGroup::Ptr&, const Value&) {
+		l_HostGroupGeneration++;
+	});
 });
 
 bool HostGroup::EvaluateObjectRule(const Host::Ptr& host, const ConfigItem::Ptr& group)
@@ -64,13 +73,9 @@ void HostGroup::EvaluateObjectRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating group memberships for host '" + host->GetName() + "'");
 
-	for (const ConfigItem::Ptr& group : ConfigItem::GetItems(HostGroup::TypeInstance))
-	{
-		if (!group->GetFilter())
-			continue;
-
-		EvaluateObjectRule(host, group);
-	}
+	ObjectRule::EvaluateRules(HostGroup::TypeInstance, { { "host", host } }, [&host](const ConfigItem::Ptr& group) {
+		return EvaluateObjectRule(host, group);
+	});
 }
 
 std::set<Host::Ptr> HostGroup::GetMembers() const
@@ -93,33 +98,98 @@ void HostGroup::RemoveMember(const Host::Ptr& host)
 	m_Members.erase(host);
 }
 
-bool HostGroup::ResolveGroupMembership(const Host::Ptr& host, bool add, int rstack) {
+/**
+ * Returns this group and the groups it is nested in, the outermost groups
+ * first. The result is cached until a group of this type changes.
+ *
+ * @returns false if the groups are nested too deeply.
+ */
+bool HostGroup::GetResolvedGroups(std::vector<HostGroup::Ptr>& groups)
+{
+	int generation = l_HostGroupGeneration;
 
-	if (add && rstack > 20) {
-		Log(LogWarning, "HostGroup")
-			<< "Too many nested groups for group '" << GetName() << "': Host '"
-			<< host->GetName() << "' membership assignment failed.";
+	{
+		boost::mutex::scoped_lock lock(m_HostGroupMutex);
 
-		return false;
+		if (m_ResolvedGeneration == generation) {
+			groups = m_ResolvedGroups;
+			return !groups.empty();
+		}
 	}
 
-	Array::Ptr groups = GetGroups();
+	std::vector<HostGroup::Ptr> result;
 
-	if (groups && groups->GetLength() > 0) {
-		ObjectLock olock(groups);
+	if (!CollectGroups(this, result, 0))
+		result.clear();
 
-		for (const String& name : groups) {
-			HostGroup::Ptr group = HostGroup::GetByName(name);
+	boost::mutex::scoped_lock lock(m_HostGroupMutex);
+	m_ResolvedGroups = result;
+	m_ResolvedGeneration = generation;
 
-			if (group && !group->ResolveGroupMembership(host, add, rstack + 1))
+	groups.swap(result);
+	return !groups.empty();
+}
+
+bool HostGroup::CollectGroups(const HostGroup::Ptr& group, std::vector<HostGroup::Ptr>& groups, int rstack)
+{
+	if (rstack > 20)
+		return false;
+
+	Array::Ptr parents = group->GetGroups();
+
+	if (parents && parents->GetLength() > 0) {
+		ObjectLock olock(parents);
+
+		for (const String& name : parents) {
+			HostGroup::Ptr parent = HostGroup::GetByName(name);
+
+			if (parent && !CollectGroups(parent, groups, rstack + 1))
 				return false;
 		}
 	}
 
-	if (add)
-		AddMember(host);
-	else
-		RemoveMember(host);
+	if (std::find(groups.begin(), groups.end(), group) == groups.end())
+		groups.push_back(group);
+
+	return true;
+}
+
+bool HostGroup::ResolveGroupMembership(const Host::Ptr& host, bool add)
+{
+	std::vector<HostGroup::Ptr> groups;
+
+	if (!GetResolvedGroups(groups)) {
+		if (add) {
+			Log(LogWarning, "HostGroup")
+				<< "Too many nested groups for group '" << GetName() << "': Host '"
+				<< host->GetName() << "' membership assignment failed.";
+
+			return false;
+		}
+
+		groups.emplace_back(this);
+	}
+
+	for (const HostGroup::Ptr& group : groups) {
+		if (add)
+			group->AddMember(host);
+		else
+			group->RemoveMember(host);
+	}
 
 	return true;
 }
+
+void HostGroup::OnConfigLoaded()
+{
+	ObjectImpl<HostGroup>::OnConfigLoaded();
+
+	l_HostGroupGeneration++;
+}
+
+void HostGroup::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<HostGroup>::Stop(runtimeRemoved);
+
+	l_HostGroupGeneration++;
+}
@@ -44,14 +44,24 @@ public:
 	void AddMember(const Host::Ptr& host);
 	void RemoveMember(const Host::Ptr& host);
 
-	bool ResolveGroupMembership(const Host::Ptr& host, bool add = true, int rstack = 0);
+	bool ResolveGroupMembership(const Host::Ptr& host, bool add = true);
 
 	static void EvaluateObjectRules(const Host::Ptr& host);
 
+protected:
+	void OnConfigLoaded() override;
+	void Stop(bool runtimeRemoved) override;
+
 private:
 	mutable boost::mutex m_HostGroupMutex;
 	std::set<Host::Ptr> m_Members;
 
+	int m_ResolvedGeneration{-1};
+	std::vector<HostGroup::Ptr> m_ResolvedGroups;
+
+	bool GetResolvedGroups(std::vector<HostGroup::Ptr>& groups);
+
+	static bool CollectGroups(const HostGroup::Ptr& group, std::vector<HostGroup::Ptr>& groups, int rstack);
 	static bool EvaluateObjectRule(const Host::Ptr& host, const intrusive_ptr<ConfigItem>& item);
 };
 
@@ -34,11 +34,19 @@
 #include "base/initialize.hpp"
 #include "base/statsfunction.hpp"
 #include "base/loader.hpp"
+#include "base/startuptimeline.hpp"
+#include "base/threadplacement.hpp"
 #include <fstream>
 
 using namespace icinga;
 
 static Timer::Ptr l_RetentionTimer;
+static boost::mutex l_RetentionMutex;
+static uint_fast64_t l_RetentionSequence;
+static int l_RetentionJournalCount;
+
+/* Number of journal writes after which the journal is compacted into a new snapshot. */
+static const int l_RetentionCompactInterval = 12;
 
 REGISTER_TYPE(IcingaApplication);
 INITIALIZE_ONCE(&IcingaApplication::StaticInitialize);
@@ -64,6 +72,14 @@ void IcingaApplication::StaticInitialize()
 	ScriptGlobal::Set("ApplicationVersion", Application::GetAppVersion());
 }
 
+void IcingaApplication::OnConfigLoaded()
+{
+	ObjectImpl<IcingaApplication>::OnConfigLoaded();
+
+	/* Place the threads before the checker and the socket I/O threads are started. */
+	ThreadPlacement::SetPolicy(GetThreadPlacement());
+}
+
 REGISTER_STATSFUNCTION(IcingaApplication, &IcingaApplication::StatsFunc);
 
 void IcingaApplication::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
@@ -79,10 +95,12 @@ void IcingaApplication::StatsFunc(const Dictionary::Ptr& status, const Array::Pt
 			{ "enable_host_checks", icingaapplication->GetEnableHostChecks() },
 			{ "enable_service_checks", icingaapplication->GetEnableServiceChecks() },
 			{ "enable_perfdata", icingaapplication->GetEnablePerfdata() },
+			{ "thread_placement", icingaapplication->GetThreadPlacement() },
 			{ "pid", Utility::GetPid() },
 			{ "program_start", Application::GetStartTime() },
 			{ "version", Application::GetAppVersion() },
-			{ "environment", ScriptGlobal::Get("Environment", &Empty) }
+			{ "environment", ScriptGlobal::Get("Environment", &Empty) },
+			{ "startup", StartupTimeline::ToDictionary() }
 		}));
 	}
 
@@ -99,9 +117,9 @@ int IcingaApplication::Main()
 	Log(LogDebug, "IcingaApplication", "In IcingaApplication::Main()");
 
 	/* periodically dump the program state */
-	l_RetentionTimer = new Timer();
+	l_RetentionTimer = new Timer("IcingaApplication retention");
 	l_RetentionTimer->SetInterval(300);
-	l_RetentionTimer->OnTimerExpired.connect(std::bind(&IcingaApplication::DumpProgramState, this));
+	l_RetentionTimer->OnTimerExpired.connect(std::bind(&IcingaApplication::DumpProgramState, this, false));
 	l_RetentionTimer->Start();
 
 	RunEventLoop();
@@ -118,7 +136,7 @@ void IcingaApplication::OnShutdown()
 		l_RetentionTimer->Stop();
 	}
 
-	DumpProgramState();
+	DumpProgramState(true);
 }
 
 static void PersistModAttrHelper(std::fstream& fp, ConfigObject::Ptr& previousObject, const ConfigObject::Ptr& object, const String& attr, const Value& value)
@@ -154,9 +172,29 @@ static void PersistModAttrHelper(std::fstream& fp, ConfigObject::Ptr& previousOb
 	previousObject = object;
 }
 
-void IcingaApplication::DumpProgramState()
+/**
+ * Persists the program state. Usually only the objects which have changed
+ * since the last run are appended to the state file's journal. Every few
+ * runs and at shutdown the journal is compacted into a new snapshot.
+ *
+ * @param compact Whether to write a new snapshot.
+ */
+void IcingaApplication::DumpProgramState(bool compact)
 {
-	ConfigObject::DumpObjects(GetStatePath());
+	{
+		boost::mutex::scoped_lock lock(l_RetentionMutex);
+
+		/* The first dump always writes a snapshot which replaces the
+		 * snapshot and journal the state was restored from. */
+		if (compact || l_RetentionSequence == 0 || l_RetentionJournalCount >= l_RetentionCompactInterval) {
+			l_RetentionSequence = ConfigObject::DumpObjects(GetStatePath());
+			l_RetentionJournalCount = 0;
+		} else {
+			l_RetentionSequence = ConfigObject::JournalObjects(GetStatePath(), l_RetentionSequence);
+			l_RetentionJournalCount++;
+		}
+	}
+
 	DumpModifiedAttributes();
 }
 
@@ -298,3 +336,11 @@ void IcingaApplication::ValidateVars(const Lazy<Dictionary::Ptr>& lvalue, const
 {
 	MacroProcessor::ValidateCustomVars(this, lvalue());
 }
+
+void IcingaApplication::ValidateThreadPlacement(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<IcingaApplication>::ValidateThreadPlacement(lvalue, utils);
+
+	if (!ThreadPlacement::IsValidPolicy(lvalue()))
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "thread_placement" }, "Invalid thread placement policy specified: " + lvalue()));
+}
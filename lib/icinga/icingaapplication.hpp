@@ -53,9 +53,13 @@ public:
 	String GetNodeName() const;
 
 	void ValidateVars(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
+	void ValidateThreadPlacement(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+
+protected:
+	void OnConfigLoaded() override;
 
 private:
-	void DumpProgramState();
+	void DumpProgramState(bool compact);
 	void DumpModifiedAttributes();
 
 	void OnShutdown() override;
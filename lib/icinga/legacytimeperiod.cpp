@@ -25,6 +25,9 @@
 #include "base/logger.hpp"
 #include "base/debug.hpp"
 #include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <memory>
 
 using namespace icinga;
 
@@ -132,25 +135,80 @@ int LegacyTimePeriod::MonthFromString(const String& monthdef)
 
 void LegacyTimePeriod::ParseTimeSpec(const String& timespec, tm *begin, tm *end, tm *reference)
 {
-	/* Let mktime() figure out whether we're in DST or not. */
-	reference->tm_isdst = -1;
+	ApplyTimeSpec(CompileTimeSpec(timespec), begin, end, reference);
+}
+
+LegacyTimePeriod::TimeSpec LegacyTimePeriod::CompileTimeSpec(const String& timespec)
+{
+	TimeSpec spec;
 
 	/* YYYY-MM-DD */
 	if (timespec.GetLength() == 10 && timespec[4] == '-' && timespec[7] == '-') {
-		int year = Convert::ToLong(timespec.SubStr(0, 4));
-		int month = Convert::ToLong(timespec.SubStr(5, 2));
-		int day = Convert::ToLong(timespec.SubStr(8, 2));
+		spec.Type = TimeSpec::Date;
+		spec.Year = Convert::ToLong(timespec.SubStr(0, 4));
+		spec.Month = Convert::ToLong(timespec.SubStr(5, 2));
+		spec.Day = Convert::ToLong(timespec.SubStr(8, 2));
 
-		if (month < 1 || month > 12)
+		if (spec.Month < 1 || spec.Month > 12)
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid month in time specification: " + timespec));
-		if (day < 1 || day > 31)
+		if (spec.Day < 1 || spec.Day > 31)
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid day in time specification: " + timespec));
 
+		spec.Month--;
+
+		return spec;
+	}
+
+	std::vector<String> tokens = timespec.Split(" ");
+
+	int mon = -1;
+
+	if (tokens.size() > 1 && (tokens[0] == "day" || (mon = MonthFromString(tokens[0])) != -1)) {
+		spec.Type = TimeSpec::MonthDay;
+		spec.Month = mon;
+		spec.Day = Convert::ToLong(tokens[1]);
+
+		return spec;
+	}
+
+	int wday;
+
+	if (tokens.size() >= 1 && (wday = WeekdayFromString(tokens[0])) != -1) {
+		spec.Type = TimeSpec::Weekday;
+		spec.Wday = wday;
+
+		if (tokens.size() > 2) {
+			spec.Month = MonthFromString(tokens[2]);
+
+			if (spec.Month == -1)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid month in time specification: " + timespec));
+		}
+
+		if (tokens.size() > 1) {
+			spec.Nth = Convert::ToLong(tokens[1]);
+
+			/* FindNthWeekday() would never return for "monday 0". */
+			if (spec.Nth == 0)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid weekday number in time specification: " + timespec));
+		}
+
+		return spec;
+	}
+
+	BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid time specification: " + timespec));
+}
+
+void LegacyTimePeriod::ApplyTimeSpec(const TimeSpec& spec, tm *begin, tm *end, tm *reference)
+{
+	/* Let mktime() figure out whether we're in DST or not. */
+	reference->tm_isdst = -1;
+
+	if (spec.Type == TimeSpec::Date) {
 		if (begin) {
 			*begin = *reference;
-			begin->tm_year = year - 1900;
-			begin->tm_mon = month - 1;
-			begin->tm_mday = day;
+			begin->tm_year = spec.Year - 1900;
+			begin->tm_mon = spec.Month;
+			begin->tm_mday = spec.Day;
 			begin->tm_hour = 0;
 			begin->tm_min = 0;
 			begin->tm_sec = 0;
@@ -158,26 +216,20 @@ void LegacyTimePeriod::ParseTimeSpec(const String& timespec, tm *begin, tm *end,
 
 		if (end) {
 			*end = *reference;
-			end->tm_year = year - 1900;
-			end->tm_mon = month - 1;
-			end->tm_mday = day;
+			end->tm_year = spec.Year - 1900;
+			end->tm_mon = spec.Month;
+			end->tm_mday = spec.Day;
 			end->tm_hour = 24;
 			end->tm_min = 0;
 			end->tm_sec = 0;
 		}
+	} else if (spec.Type == TimeSpec::MonthDay) {
+		int mon = spec.Month;
 
-		return;
-	}
-
-	std::vector<String> tokens = timespec.Split(" ");
-
-	int mon = -1;
-
-	if (tokens.size() > 1 && (tokens[0] == "day" || (mon = MonthFromString(tokens[0])) != -1)) {
 		if (mon == -1)
 			mon = reference->tm_mon;
 
-		int mday = Convert::ToLong(tokens[1]);
+		int mday = spec.Day;
 
 		if (begin) {
 			*begin = *reference;
@@ -208,36 +260,19 @@ void LegacyTimePeriod::ParseTimeSpec(const String& timespec, tm *begin, tm *end,
 				end->tm_mon++;
 			}
 		}
-
-		return;
-	}
-
-	int wday;
-
-	if (tokens.size() >= 1 && (wday = WeekdayFromString(tokens[0])) != -1) {
+	} else {
 		tm myref = *reference;
 
-		if (tokens.size() > 2) {
-			mon = MonthFromString(tokens[2]);
-
-			if (mon == -1)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid month in time specification: " + timespec));
-
-			myref.tm_mon = mon;
-		}
-
-		int n = 0;
-
-		if (tokens.size() > 1)
-			n = Convert::ToLong(tokens[1]);
+		if (spec.Month != -1)
+			myref.tm_mon = spec.Month;
 
 		if (begin) {
 			*begin = myref;
 
-			if (tokens.size() > 1)
-				FindNthWeekday(wday, n, begin);
+			if (spec.Nth != 0)
+				FindNthWeekday(spec.Wday, spec.Nth, begin);
 			else
-				begin->tm_mday += (7 - begin->tm_wday + wday) % 7;
+				begin->tm_mday += (7 - begin->tm_wday + spec.Wday) % 7;
 
 			begin->tm_hour = 0;
 			begin->tm_min = 0;
@@ -247,25 +282,30 @@ void LegacyTimePeriod::ParseTimeSpec(const String& timespec, tm *begin, tm *end,
 		if (end) {
 			*end = myref;
 
-			if (tokens.size() > 1)
-				FindNthWeekday(wday, n, end);
+			if (spec.Nth != 0)
+				FindNthWeekday(spec.Wday, spec.Nth, end);
 			else
-				end->tm_mday += (7 - end->tm_wday + wday) % 7;
+				end->tm_mday += (7 - end->tm_wday + spec.Wday) % 7;
 
 			end->tm_hour = 0;
 			end->tm_min = 0;
 			end->tm_sec = 0;
 			end->tm_mday++;
 		}
-
-		return;
 	}
-
-	BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid time specification: " + timespec));
 }
 
 void LegacyTimePeriod::ParseTimeRange(const String& timerange, tm *begin, tm *end, int *stride, tm *reference)
 {
+	DayDefinition daydef = CompileDayDefinition(timerange);
+
+	ApplyDayDefinition(daydef, begin, end, reference);
+	*stride = daydef.Stride;
+}
+
+LegacyTimePeriod::DayDefinition LegacyTimePeriod::CompileDayDefinition(const String& timerange)
+{
+	DayDefinition daydef;
 	String def = timerange;
 
 	/* Figure out the stride. */
@@ -273,12 +313,12 @@ void LegacyTimePeriod::ParseTimeRange(const String& timerange, tm *begin, tm *en
 
 	if (pos != String::NPos) {
 		String strStride = def.SubStr(pos + 1).Trim();
-		*stride = Convert::ToLong(strStride);
+		daydef.Stride = Convert::ToLong(strStride);
 
 		/* Remove the stride parameter from the definition. */
 		def = def.SubStr(0, pos);
 	} else {
-		*stride = 1; /* User didn't specify anything, assume default. */
+		daydef.Stride = 1; /* User didn't specify anything, assume default. */
 	}
 
 	/* Figure out whether the user has specified two dates. */
@@ -289,7 +329,7 @@ void LegacyTimePeriod::ParseTimeRange(const String& timerange, tm *begin, tm *en
 
 		String second = def.SubStr(pos + 1).Trim();
 
-		ParseTimeSpec(first, begin, nullptr, reference);
+		daydef.Begin = CompileTimeSpec(first);
 
 		/* If the second definition starts with a number we need
 		 * to add the first word from the first definition, e.g.:
@@ -310,10 +350,19 @@ void LegacyTimePeriod::ParseTimeRange(const String& timerange, tm *begin, tm *en
 			second = first.SubStr(0, xpos + 1) + second;
 		}
 
-		ParseTimeSpec(second, nullptr, end, reference);
+		daydef.End = CompileTimeSpec(second);
 	} else {
-		ParseTimeSpec(def, begin, end, reference);
+		daydef.Begin = CompileTimeSpec(def);
+		daydef.End = daydef.Begin;
 	}
+
+	return daydef;
+}
+
+void LegacyTimePeriod::ApplyDayDefinition(const DayDefinition& daydef, tm *begin, tm *end, tm *reference)
+{
+	ApplyTimeSpec(daydef.Begin, begin, nullptr, reference);
+	ApplyTimeSpec(daydef.End, nullptr, end, reference);
 }
 
 bool LegacyTimePeriod::IsInDayDefinition(const String& daydef, tm *reference)
@@ -331,6 +380,11 @@ bool LegacyTimePeriod::IsInDayDefinition(const String& daydef, tm *reference)
 }
 
 void LegacyTimePeriod::ProcessTimeRangeRaw(const String& timerange, tm *reference, tm *begin, tm *end)
+{
+	ApplyTimeRange(CompileTimeRange(timerange), reference, begin, end);
+}
+
+LegacyTimePeriod::TimeRange LegacyTimePeriod::CompileTimeRange(const String& timerange)
 {
 	std::vector<String> times = timerange.Split("-");
 
@@ -347,19 +401,39 @@ void LegacyTimePeriod::ProcessTimeRangeRaw(const String& timerange, tm *referenc
 	if (hd2.size() != 2)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid time specification: " + times[1]));
 
+	TimeRange range;
+	range.BeginHour = Convert::ToLong(hd1[0]);
+	range.BeginMinute = Convert::ToLong(hd1[1]);
+	range.EndHour = Convert::ToLong(hd2[0]);
+	range.EndMinute = Convert::ToLong(hd2[1]);
+
+	if (range.BeginHour * 3600 + range.BeginMinute * 60 >= range.EndHour * 3600 + range.EndMinute * 60)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Time period segment ends before it begins"));
+
+	return range;
+}
+
+void LegacyTimePeriod::ApplyTimeRange(const TimeRange& timerange, tm *reference, tm *begin, tm *end)
+{
 	*begin = *reference;
 	begin->tm_sec = 0;
-	begin->tm_min = Convert::ToLong(hd1[1]);
-	begin->tm_hour = Convert::ToLong(hd1[0]);
+	begin->tm_min = timerange.BeginMinute;
+	begin->tm_hour = timerange.BeginHour;
 
 	*end = *reference;
 	end->tm_sec = 0;
-	end->tm_min = Convert::ToLong(hd2[1]);
-	end->tm_hour = Convert::ToLong(hd2[0]);
+	end->tm_min = timerange.EndMinute;
+	end->tm_hour = timerange.EndHour;
+}
 
-	if (begin->tm_hour * 3600 + begin->tm_min * 60 + begin->tm_sec >=
-		end->tm_hour * 3600 + end->tm_min * 60 + end->tm_sec)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Time period segment ends before it begins"));
+std::vector<LegacyTimePeriod::TimeRange> LegacyTimePeriod::CompileTimeRanges(const String& timeranges)
+{
+	std::vector<TimeRange> result;
+
+	for (const String& range : timeranges.Split(","))
+		result.push_back(CompileTimeRange(range));
+
+	return result;
 }
 
 Dictionary::Ptr LegacyTimePeriod::ProcessTimeRange(const String& timestamp, tm *reference)
@@ -446,6 +520,138 @@ Dictionary::Ptr LegacyTimePeriod::FindNextSegment(const String& daydef, const St
 	return nullptr;
 }
 
+namespace
+{
+
+/**
+ * The compiled form of a "ranges" dictionary and the segments it yields for
+ * the days which have been looked at. Time periods with identical ranges
+ * share one entry.
+ */
+struct CompiledRanges
+{
+	std::vector<std::pair<LegacyTimePeriod::DayDefinition, std::vector<LegacyTimePeriod::TimeRange> > > Ranges;
+
+	boost::mutex Mutex;
+	std::map<int, std::vector<std::pair<long, long> > > Days;
+	double LastUsed{0};
+};
+
+}
+
+static boost::mutex l_CompiledRangesMutex;
+static std::map<String, std::shared_ptr<CompiledRanges> > l_CompiledRanges;
+static double l_CompiledRangesLastPrune = 0;
+
+static std::shared_ptr<CompiledRanges> GetCompiledRanges(const Dictionary::Ptr& ranges)
+{
+	String key;
+
+	{
+		ObjectLock olock(ranges);
+		for (const Dictionary::Pair& kv : ranges) {
+			key += kv.first;
+			key += '\0';
+			key += static_cast<String>(kv.second);
+			key += '\0';
+		}
+	}
+
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(l_CompiledRangesMutex);
+
+	/* Drop the definitions which haven't been used for a day, e.g. after the ranges were changed. */
+	if (now - l_CompiledRangesLastPrune > 3600) {
+		for (auto it = l_CompiledRanges.begin(); it != l_CompiledRanges.end();) {
+			if (now - it->second->LastUsed > 24 * 60 * 60)
+				it = l_CompiledRanges.erase(it);
+			else
+				++it;
+		}
+
+		l_CompiledRangesLastPrune = now;
+	}
+
+	std::shared_ptr<CompiledRanges>& compiled = l_CompiledRanges[key];
+
+	if (!compiled) {
+		std::shared_ptr<CompiledRanges> result = std::make_shared<CompiledRanges>();
+
+		try {
+			ObjectLock olock(ranges);
+			for (const Dictionary::Pair& kv : ranges)
+				result->Ranges.emplace_back(LegacyTimePeriod::CompileDayDefinition(kv.first), LegacyTimePeriod::CompileTimeRanges(kv.second));
+		} catch (...) {
+			l_CompiledRanges.erase(key);
+			throw;
+		}
+
+		compiled = result;
+	}
+
+	compiled->LastUsed = now;
+
+	return compiled;
+}
+
+/**
+ * Returns the segments for the day of the reference time.
+ */
+static std::vector<std::pair<long, long> > GetDaySegments(CompiledRanges& compiled, const tm& refday)
+{
+	int key = refday.tm_year * 400 + refday.tm_yday;
+
+	boost::mutex::scoped_lock lock(compiled.Mutex);
+
+	auto it = compiled.Days.find(key);
+
+	if (it != compiled.Days.end())
+		return it->second;
+
+	/* Use noon as the reference so that the result doesn't depend on the time
+	 * of day, e.g. for strides across DST changes. */
+	tm reference = refday;
+	reference.tm_hour = 12;
+	reference.tm_min = 0;
+	reference.tm_sec = 0;
+	reference.tm_isdst = -1;
+	mktime(&reference);
+
+	std::vector<std::pair<long, long> > segments;
+
+	for (const auto& range : compiled.Ranges) {
+		tm begin, end;
+
+		LegacyTimePeriod::ApplyDayDefinition(range.first, &begin, &end, &reference);
+
+		if (!LegacyTimePeriod::IsInTimeRange(&begin, &end, range.first.Stride, &reference))
+			continue;
+
+		for (const LegacyTimePeriod::TimeRange& timerange : range.second) {
+			tm segmentBegin, segmentEnd;
+
+			LegacyTimePeriod::ApplyTimeRange(timerange, &reference, &segmentBegin, &segmentEnd);
+
+			long tsBegin = mktime(&segmentBegin);
+			long tsEnd = mktime(&segmentEnd);
+
+			if (tsBegin >= tsEnd)
+				continue;
+
+			segments.emplace_back(tsBegin, tsEnd);
+		}
+	}
+
+	/* Only the days around the current time are asked for, keep a few of them. */
+	if (compiled.Days.size() >= 16)
+		compiled.Days.erase(compiled.Days.begin());
+
+	compiled.Days[key] = segments;
+
+	return segments;
+}
+
 Array::Ptr LegacyTimePeriod::ScriptFunc(const TimePeriod::Ptr& tp, double begin, double end)
 {
 	Array::Ptr segments = new Array();
@@ -453,6 +659,8 @@ Array::Ptr LegacyTimePeriod::ScriptFunc(const TimePeriod::Ptr& tp, double begin,
 	Dictionary::Ptr ranges = tp->GetRanges();
 
 	if (ranges) {
+		std::shared_ptr<CompiledRanges> compiled = GetCompiledRanges(ranges);
+
 		for (int i = 0; i <= (end - begin) / (24 * 60 * 60); i++) {
 			time_t refts = begin + i * 24 * 60 * 60;
 			tm reference = Utility::LocalTime(refts);
@@ -462,22 +670,11 @@ Array::Ptr LegacyTimePeriod::ScriptFunc(const TimePeriod::Ptr& tp, double begin,
 				<< "Checking reference time " << refts;
 #endif /* I2_DEBUG */
 
-			ObjectLock olock(ranges);
-			for (const Dictionary::Pair& kv : ranges) {
-				if (!IsInDayDefinition(kv.first, &reference)) {
-#ifdef I2_DEBUG
-					Log(LogDebug, "LegacyTimePeriod")
-						<< "Not in day definition '" << kv.first << "'.";
-#endif /* I2_DEBUG */
-					continue;
-				}
-
-#ifdef I2_DEBUG
-				Log(LogDebug, "LegacyTimePeriod")
-					<< "In day definition '" << kv.first << "'.";
-#endif /* I2_DEBUG */
-
-				ProcessTimeRanges(kv.second, &reference, segments);
+			for (const std::pair<long, long>& segment : GetDaySegments(*compiled, reference)) {
+				segments->Add(new Dictionary({
+					{ "begin", segment.first },
+					{ "end", segment.second }
+				}));
 			}
 		}
 	}
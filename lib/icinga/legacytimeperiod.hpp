@@ -23,6 +23,7 @@
 #include "icinga/i2-icinga.hpp"
 #include "icinga/timeperiod.hpp"
 #include "base/dictionary.hpp"
+#include <vector>
 
 namespace icinga
 {
@@ -35,6 +36,41 @@ namespace icinga
 class LegacyTimePeriod
 {
 public:
+	/**
+	 * A parsed time specification, e.g. "2018-01-01", "day -1", "july 4"
+	 * or "monday 2 march".
+	 */
+	struct TimeSpec
+	{
+		enum { Date, MonthDay, Weekday } Type;
+		int Year{0};
+		int Month{-1}; /**< -1 to use the reference month */
+		int Day{0};
+		int Wday{-1};
+		int Nth{0}; /**< 0 for the next matching weekday */
+	};
+
+	/**
+	 * A parsed day definition, e.g. "monday" or "day 1 - 15 / 2".
+	 */
+	struct DayDefinition
+	{
+		TimeSpec Begin;
+		TimeSpec End;
+		int Stride{1};
+	};
+
+	/**
+	 * A parsed time range, e.g. "09:00-17:00".
+	 */
+	struct TimeRange
+	{
+		int BeginHour;
+		int BeginMinute;
+		int EndHour;
+		int EndMinute;
+	};
+
 	static Array::Ptr ScriptFunc(const TimePeriod::Ptr& tp, double start, double end);
 
 	static bool IsInTimeRange(tm *begin, tm *end, int stride, tm *reference);
@@ -49,6 +85,14 @@ public:
 	static void ProcessTimeRanges(const String& timeranges, tm *reference, const Array::Ptr& result);
 	static Dictionary::Ptr FindNextSegment(const String& daydef, const String& timeranges, tm *reference);
 
+	static TimeSpec CompileTimeSpec(const String& timespec);
+	static void ApplyTimeSpec(const TimeSpec& spec, tm *begin, tm *end, tm *reference);
+	static DayDefinition CompileDayDefinition(const String& daydef);
+	static void ApplyDayDefinition(const DayDefinition& daydef, tm *begin, tm *end, tm *reference);
+	static TimeRange CompileTimeRange(const String& timerange);
+	static void ApplyTimeRange(const TimeRange& timerange, tm *reference, tm *begin, tm *end);
+	static std::vector<TimeRange> CompileTimeRanges(const String& timeranges);
+
 private:
 	LegacyTimePeriod();
 };
@@ -28,7 +28,6 @@
 #include "base/scriptframe.hpp"
 #include "base/convert.hpp"
 #include "base/exception.hpp"
-#include <boost/algorithm/string/join.hpp>
 
 using namespace icinga;
 
@@ -40,21 +39,31 @@ Value MacroProcessor::ResolveMacros(const Value& str, const ResolverList& resolv
 	if (useResolvedMacros)
 		REQUIRE_NOT_NULL(resolvedMacros);
 
+	if (str.IsEmpty())
+		return Empty;
+
+	return ResolveTemplate(MacroValueTemplate(str), resolvers, cr, missingMacro, escapeFn,
+		resolvedMacros, useResolvedMacros, recursionLevel);
+}
+
+Value MacroProcessor::ResolveTemplate(const MacroValueTemplate& tmpl, const ResolverList& resolvers,
+	const CheckResult::Ptr& cr, String *missingMacro,
+	const MacroProcessor::EscapeCallback& escapeFn, const Dictionary::Ptr& resolvedMacros,
+	bool useResolvedMacros, int recursionLevel)
+{
+	const Value& str = tmpl.Source;
 	Value result;
 
 	if (str.IsEmpty())
 		return Empty;
 
 	if (str.IsScalar()) {
-		result = InternalResolveMacros(str, resolvers, cr, missingMacro, escapeFn,
+		result = InternalResolveMacros(tmpl.Scalar, resolvers, cr, missingMacro, escapeFn,
 			resolvedMacros, useResolvedMacros, recursionLevel + 1);
 	} else if (str.IsObjectType<Array>()) {
 		ArrayData resultArr;
-		Array::Ptr arr = str;
-
-		ObjectLock olock(arr);
 
-		for (const Value& arg : arr) {
+		for (const MacroTemplate& arg : tmpl.Elements) {
 			/* Note: don't escape macros here. */
 			Value value = InternalResolveMacros(arg, resolvers, cr, missingMacro,
 				EscapeCallback(), resolvedMacros, useResolvedMacros, recursionLevel + 1);
@@ -68,11 +77,8 @@ Value MacroProcessor::ResolveMacros(const Value& str, const ResolverList& resolv
 		result = new Array(std::move(resultArr));
 	} else if (str.IsObjectType<Dictionary>()) {
 		Dictionary::Ptr resultDict = new Dictionary();
-		Dictionary::Ptr dict = str;
 
-		ObjectLock olock(dict);
-
-		for (const Dictionary::Pair& kv : dict) {
+		for (const auto& kv : tmpl.Items) {
 			/* Note: don't escape macros here. */
 			resultDict->Set(kv.first, InternalResolveMacros(kv.second, resolvers, cr, missingMacro,
 				EscapeCallback(), resolvedMacros, useResolvedMacros, recursionLevel + 1));
@@ -88,20 +94,17 @@ Value MacroProcessor::ResolveMacros(const Value& str, const ResolverList& resolv
 	return result;
 }
 
-bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resolvers,
+bool MacroProcessor::ResolveMacro(const MacroTemplateSegment& segment, const ResolverList& resolvers,
 	const CheckResult::Ptr& cr, Value *result, bool *recursive_macro)
 {
+	const String& macro = segment.Text;
+
 	CONTEXT("Resolving macro '" + macro + "'");
 
 	*recursive_macro = false;
 
-	std::vector<String> tokens = macro.Split(".");
-
-	String objName;
-	if (tokens.size() > 1) {
-		objName = tokens[0];
-		tokens.erase(tokens.begin());
-	}
+	const String& objName = segment.ObjectName;
+	const std::vector<String>& tokens = segment.Tokens;
 
 	for (const ResolverSpec& resolver : resolvers) {
 		if (!objName.IsEmpty() && objName != resolver.first)
@@ -123,7 +126,7 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 
 		auto *mresolver = dynamic_cast<MacroResolver *>(resolver.second.get());
 
-		if (mresolver && mresolver->ResolveMacro(boost::algorithm::join(tokens, "."), cr, result))
+		if (mresolver && mresolver->ResolveMacro(segment.Attribute, cr, result))
 			return true;
 
 		Value ref = resolver.second;
@@ -220,43 +223,45 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 	const MacroProcessor::EscapeCallback& escapeFn, const Dictionary::Ptr& resolvedMacros,
 	bool useResolvedMacros, int recursionLevel)
 {
-	CONTEXT("Resolving macros for string '" + str + "'");
+	return InternalResolveMacros(MacroTemplate(str), resolvers, cr, missingMacro, escapeFn,
+		resolvedMacros, useResolvedMacros, recursionLevel);
+}
+
+Value MacroProcessor::InternalResolveMacros(const MacroTemplate& tmpl, const ResolverList& resolvers,
+	const CheckResult::Ptr& cr, String *missingMacro,
+	const MacroProcessor::EscapeCallback& escapeFn, const Dictionary::Ptr& resolvedMacros,
+	bool useResolvedMacros, int recursionLevel)
+{
+	CONTEXT("Resolving macros for string '" + tmpl.GetSource() + "'");
 
 	if (recursionLevel > 15)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Infinite recursion detected while resolving macros"));
 
-	size_t offset, pos_first, pos_second;
-	offset = 0;
-
-	Dictionary::Ptr resolvers_this;
-
-	String result = str;
-	while ((pos_first = result.FindFirstOf("$", offset)) != String::NPos) {
-		pos_second = result.FindFirstOf("$", pos_first + 1);
+	String result;
 
-		if (pos_second == String::NPos)
-			BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string."));
+	for (const MacroTemplateSegment& segment : tmpl.GetSegments()) {
+		if (!segment.IsMacro) {
+			result += segment.Text;
+			continue;
+		}
 
-		String name = result.SubStr(pos_first + 1, pos_second - pos_first - 1);
+		const String& name = segment.Text;
 
 		Value resolved_macro;
-		bool recursive_macro;
+		bool recursive_macro = false;
 		bool found;
 
-		if (useResolvedMacros) {
-			recursive_macro = false;
+		/* $$ is an escape sequence for $. */
+		if (name.IsEmpty()) {
+			resolved_macro = "$";
+			found = true;
+		} else if (useResolvedMacros) {
 			found = resolvedMacros->Contains(name);
 
 			if (found)
 				resolved_macro = resolvedMacros->Get(name);
 		} else
-			found = ResolveMacro(name, resolvers, cr, &resolved_macro, &recursive_macro);
-
-		/* $$ is an escape sequence for $. */
-		if (name.IsEmpty()) {
-			resolved_macro = "$";
-			found = true;
-		}
+			found = ResolveMacro(segment, resolvers, cr, &resolved_macro, &recursive_macro);
 
 		if (resolved_macro.IsObjectType<Function>()) {
 			resolved_macro = EvaluateFunction(resolved_macro, resolvers, cr, escapeFn,
@@ -302,25 +307,17 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 			resolved_macro = escapeFn(resolved_macro);
 
 		/* we're done if this is the only macro and there are no other non-macro parts in the string */
-		if (pos_first == 0 && pos_second == str.GetLength() - 1)
+		if (tmpl.IsSingleMacro())
 			return resolved_macro;
 		else if (resolved_macro.IsObjectType<Array>())
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
-
-		if (resolved_macro.IsObjectType<Array>()) {
-			/* don't allow mixing strings and arrays in macro strings */
-			if (pos_first != 0 || pos_second != str.GetLength() - 1)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
 
-			return resolved_macro;
-		}
-
-		String resolved_macro_str = resolved_macro;
-
-		result.Replace(pos_first, pos_second - pos_first + 1, resolved_macro_str);
-		offset = pos_first + resolved_macro_str.GetLength();
+		result += static_cast<String>(resolved_macro);
 	}
 
+	if (tmpl.IsUnterminated())
+		BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string."));
+
 	return result;
 }
 
@@ -420,22 +417,15 @@ Value MacroProcessor::EscapeMacroShellArg(const Value& value)
 	return result;
 }
 
-struct CommandArgument
+Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::Ptr& arguments,
+	const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr,
+	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel)
 {
-	int Order{0};
-	bool SkipKey{false};
-	bool RepeatKey{true};
-	bool SkipValue{false};
-	String Key;
-	Value AValue;
-
-	bool operator<(const CommandArgument& rhs) const
-	{
-		return Order < rhs.Order;
-	}
-};
+	return ResolveArguments(new CommandTemplate(command, arguments), resolvers, cr,
+		resolvedMacros, useResolvedMacros, recursionLevel);
+}
 
-Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::Ptr& arguments,
+Value MacroProcessor::ResolveArguments(const CommandTemplate::Ptr& commandTemplate,
 	const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr,
 	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel)
 {
@@ -443,84 +433,56 @@ Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::P
 		REQUIRE_NOT_NULL(resolvedMacros);
 
 	Value resolvedCommand;
-	if (!arguments || command.IsObjectType<Array>() || command.IsObjectType<Function>())
-		resolvedCommand = MacroProcessor::ResolveMacros(command, resolvers, cr, nullptr,
+	if (commandTemplate->GetResolveCommand())
+		resolvedCommand = MacroProcessor::ResolveTemplate(commandTemplate->GetCommandTemplate(), resolvers, cr, nullptr,
 			EscapeMacroShellArg, resolvedMacros, useResolvedMacros, recursionLevel + 1);
 	else {
-		resolvedCommand = new Array({ command });
+		resolvedCommand = new Array({ commandTemplate->GetCommand() });
 	}
 
-	if (arguments) {
-		std::vector<CommandArgument> args;
-
-		ObjectLock olock(arguments);
-		for (const Dictionary::Pair& kv : arguments) {
-			const Value& arginfo = kv.second;
+	if (commandTemplate->GetArguments()) {
+		/* The argument templates are already sorted by their 'order' attribute. */
+		std::vector<std::pair<const CommandArgumentTemplate *, Value> > args;
 
-			CommandArgument arg;
-			arg.Key = kv.first;
+		for (const CommandArgumentTemplate& arg : commandTemplate->GetArgumentTemplates()) {
+			if (!arg.SetIfTemplate.Source.IsEmpty()) {
+				String missingMacro;
+				Value set_if_resolved = MacroProcessor::ResolveTemplate(arg.SetIfTemplate, resolvers,
+					cr, &missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros,
+					useResolvedMacros, recursionLevel + 1);
 
-			bool required = false;
-			Value argval;
-
-			if (arginfo.IsObjectType<Dictionary>()) {
-				Dictionary::Ptr argdict = arginfo;
-				if (argdict->Contains("key"))
-					arg.Key = argdict->Get("key");
-				argval = argdict->Get("value");
-				if (argdict->Contains("required"))
-					required = argdict->Get("required");
-				arg.SkipKey = argdict->Get("skip_key");
-				if (argdict->Contains("repeat_key"))
-					arg.RepeatKey = argdict->Get("repeat_key");
-				arg.Order = argdict->Get("order");
-
-				Value set_if = argdict->Get("set_if");
-
-				if (!set_if.IsEmpty()) {
-					String missingMacro;
-					Value set_if_resolved = MacroProcessor::ResolveMacros(set_if, resolvers,
-						cr, &missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros,
-						useResolvedMacros, recursionLevel + 1);
+				if (!missingMacro.IsEmpty())
+					continue;
 
-					if (!missingMacro.IsEmpty())
+				int value;
+
+				if (set_if_resolved == "true")
+					value = 1;
+				else if (set_if_resolved == "false")
+					value = 0;
+				else {
+					try {
+						value = Convert::ToLong(set_if_resolved);
+					} catch (const std::exception& ex) {
+						/* tried to convert a string */
+						Log(LogWarning, "PluginUtility")
+							<< "Error evaluating set_if value '" << set_if_resolved
+							<< "' used in argument '" << arg.Key << "': " << ex.what();
 						continue;
-
-					int value;
-
-					if (set_if_resolved == "true")
-						value = 1;
-					else if (set_if_resolved == "false")
-						value = 0;
-					else {
-						try {
-							value = Convert::ToLong(set_if_resolved);
-						} catch (const std::exception& ex) {
-							/* tried to convert a string */
-							Log(LogWarning, "PluginUtility")
-								<< "Error evaluating set_if value '" << set_if_resolved
-								<< "' used in argument '" << arg.Key << "': " << ex.what();
-							continue;
-						}
 					}
-
-					if (!value)
-						continue;
 				}
-			}
-			else
-				argval = arginfo;
 
-			if (argval.IsEmpty())
-				arg.SkipValue = true;
+				if (!value)
+					continue;
+			}
 
 			String missingMacro;
-			arg.AValue = MacroProcessor::ResolveMacros(argval, resolvers,
+			Value argValue = MacroProcessor::ResolveTemplate(arg.ValueTemplate, resolvers,
 				cr, &missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros,
 				useResolvedMacros, recursionLevel + 1);
 
 			if (!missingMacro.IsEmpty()) {
-				if (required) {
+				if (arg.Required) {
 					BOOST_THROW_EXCEPTION(ScriptError("Non-optional macro '" + missingMacro + "' used in argument '" +
 						arg.Key + "' is missing."));
 				}
@@ -528,21 +490,21 @@ Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::P
 				continue;
 			}
 
-			args.emplace_back(std::move(arg));
+			args.emplace_back(&arg, std::move(argValue));
 		}
 
-		std::sort(args.begin(), args.end());
-
 		Array::Ptr command_arr = resolvedCommand;
-		for (const CommandArgument& arg : args) {
+		for (const auto& kv : args) {
+			const CommandArgumentTemplate& arg = *kv.first;
+			const Value& argValue = kv.second;
 
-			if (arg.AValue.IsObjectType<Dictionary>()) {
+			if (argValue.IsObjectType<Dictionary>()) {
 				Log(LogWarning, "PluginUtility")
 					<< "Tried to use dictionary in argument '" << arg.Key << "'.";
 				continue;
-			} else if (arg.AValue.IsObjectType<Array>()) {
+			} else if (argValue.IsObjectType<Array>()) {
 				bool first = true;
-				Array::Ptr arr = static_cast<Array::Ptr>(arg.AValue);
+				Array::Ptr arr = static_cast<Array::Ptr>(argValue);
 
 				ObjectLock olock(arr);
 				for (const Value& value : arr) {
@@ -557,7 +519,7 @@ Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::P
 					AddArgumentHelper(command_arr, arg.Key, value, add_key, !arg.SkipValue);
 				}
 			} else
-				AddArgumentHelper(command_arr, arg.Key, arg.AValue, !arg.SkipKey, !arg.SkipValue);
+				AddArgumentHelper(command_arr, arg.Key, argValue, !arg.SkipKey, !arg.SkipValue);
 		}
 	}
 
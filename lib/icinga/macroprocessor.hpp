@@ -22,6 +22,7 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkable.hpp"
+#include "icinga/macrotemplate.hpp"
 #include "base/value.hpp"
 #include <vector>
 
@@ -49,6 +50,9 @@ public:
 	static Value ResolveArguments(const Value& command, const Dictionary::Ptr& arguments,
 		const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr,
 		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel = 0);
+	static Value ResolveArguments(const CommandTemplate::Ptr& commandTemplate,
+		const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr,
+		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel = 0);
 
 	static bool ValidateMacroString(const String& macro);
 	static void ValidateCustomVars(const ConfigObject::Ptr& object, const Dictionary::Ptr& value);
@@ -56,13 +60,23 @@ public:
 private:
 	MacroProcessor();
 
-	static bool ResolveMacro(const String& macro, const ResolverList& resolvers,
+	static bool ResolveMacro(const MacroTemplateSegment& segment, const ResolverList& resolvers,
 		const CheckResult::Ptr& cr, Value *result, bool *recursive_macro);
+	static Value ResolveTemplate(const MacroValueTemplate& tmpl,
+		const ResolverList& resolvers, const CheckResult::Ptr& cr,
+		String *missingMacro, const EscapeCallback& escapeFn,
+		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros,
+		int recursionLevel);
 	static Value InternalResolveMacros(const String& str,
 		const ResolverList& resolvers, const CheckResult::Ptr& cr,
 		String *missingMacro, const EscapeCallback& escapeFn,
 		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros,
 		int recursionLevel = 0);
+	static Value InternalResolveMacros(const MacroTemplate& tmpl,
+		const ResolverList& resolvers, const CheckResult::Ptr& cr,
+		String *missingMacro, const EscapeCallback& escapeFn,
+		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros,
+		int recursionLevel = 0);
 	static Value EvaluateFunction(const Function::Ptr& func, const ResolverList& resolvers,
 		const CheckResult::Ptr& cr, const MacroProcessor::EscapeCallback& escapeFn,
 		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel);
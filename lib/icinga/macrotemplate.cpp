@@ -0,0 +1,204 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/macrotemplate.hpp"
+#include "base/array.hpp"
+#include "base/objectlock.hpp"
+#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+
+using namespace icinga;
+
+MacroTemplate::MacroTemplate(const String& str)
+	: m_Source(str)
+{
+	size_t offset, pos_first, pos_second;
+	offset = 0;
+
+	while ((pos_first = str.FindFirstOf("$", offset)) != String::NPos) {
+		pos_second = str.FindFirstOf("$", pos_first + 1);
+
+		if (pos_second == String::NPos) {
+			/* Report this when the string is resolved, just like the unparsed version did. */
+			m_Unterminated = true;
+			return;
+		}
+
+		if (pos_first > offset) {
+			MacroTemplateSegment literal;
+			literal.Text = str.SubStr(offset, pos_first - offset);
+			m_Segments.emplace_back(std::move(literal));
+		}
+
+		MacroTemplateSegment macro;
+		macro.IsMacro = true;
+		macro.Text = str.SubStr(pos_first + 1, pos_second - pos_first - 1);
+		macro.Tokens = macro.Text.Split(".");
+
+		if (macro.Tokens.size() > 1) {
+			macro.ObjectName = macro.Tokens[0];
+			macro.Tokens.erase(macro.Tokens.begin());
+		}
+
+		macro.Attribute = boost::algorithm::join(macro.Tokens, ".");
+
+		m_Segments.emplace_back(std::move(macro));
+
+		offset = pos_second + 1;
+	}
+
+	if (offset < str.GetLength()) {
+		MacroTemplateSegment literal;
+		literal.Text = str.SubStr(offset);
+		m_Segments.emplace_back(std::move(literal));
+	}
+}
+
+const String& MacroTemplate::GetSource() const
+{
+	return m_Source;
+}
+
+const std::vector<MacroTemplateSegment>& MacroTemplate::GetSegments() const
+{
+	return m_Segments;
+}
+
+bool MacroTemplate::IsSingleMacro() const
+{
+	return m_Segments.size() == 1 && m_Segments[0].IsMacro && !m_Unterminated;
+}
+
+bool MacroTemplate::IsUnterminated() const
+{
+	return m_Unterminated;
+}
+
+MacroValueTemplate::MacroValueTemplate(const Value& value)
+	: Source(value)
+{
+	if (value.IsEmpty())
+		return;
+
+	if (value.IsScalar()) {
+		Scalar = MacroTemplate(value);
+	} else if (value.IsObjectType<Array>()) {
+		Array::Ptr arr = value;
+
+		ObjectLock olock(arr);
+
+		for (const Value& arg : arr)
+			Elements.emplace_back(arg);
+	} else if (value.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr dict = value;
+
+		ObjectLock olock(dict);
+
+		for (const Dictionary::Pair& kv : dict)
+			Items.emplace_back(kv.first, MacroTemplate(kv.second));
+	}
+}
+
+CommandTemplate::CommandTemplate(const Value& command, const Dictionary::Ptr& arguments)
+	: m_Command(command), m_Arguments(arguments)
+{
+	m_ResolveCommand = !arguments || command.IsObjectType<Array>() || command.IsObjectType<Function>();
+
+	if (m_ResolveCommand)
+		m_CommandTemplate = MacroValueTemplate(command);
+
+	if (!arguments)
+		return;
+
+	ObjectLock olock(arguments);
+	for (const Dictionary::Pair& kv : arguments) {
+		const Value& arginfo = kv.second;
+
+		CommandArgumentTemplate arg;
+		arg.Key = kv.first;
+
+		Value argval;
+
+		if (arginfo.IsObjectType<Dictionary>()) {
+			Dictionary::Ptr argdict = arginfo;
+			if (argdict->Contains("key"))
+				arg.Key = argdict->Get("key");
+			argval = argdict->Get("value");
+			if (argdict->Contains("required"))
+				arg.Required = argdict->Get("required");
+			arg.SkipKey = argdict->Get("skip_key");
+			if (argdict->Contains("repeat_key"))
+				arg.RepeatKey = argdict->Get("repeat_key");
+			arg.Order = argdict->Get("order");
+
+			arg.SetIfTemplate = MacroValueTemplate(argdict->Get("set_if"));
+		} else
+			argval = arginfo;
+
+		if (argval.IsEmpty())
+			arg.SkipValue = true;
+
+		arg.ValueTemplate = MacroValueTemplate(argval);
+
+		m_ArgumentTemplates.emplace_back(std::move(arg));
+	}
+
+	/* Keep arguments with the same order in a stable (key) order. */
+	std::stable_sort(m_ArgumentTemplates.begin(), m_ArgumentTemplates.end(),
+		[](const CommandArgumentTemplate& a, const CommandArgumentTemplate& b) { return a.Order < b.Order; });
+}
+
+bool CommandTemplate::IsCompiledFrom(const Value& command, const Dictionary::Ptr& arguments) const
+{
+	if (arguments != m_Arguments)
+		return false;
+
+	if (command.IsObject() || m_Command.IsObject()) {
+		return command.IsObject() && m_Command.IsObject() &&
+			static_cast<Object::Ptr>(command) == static_cast<Object::Ptr>(m_Command);
+	}
+
+	return command.GetType() == m_Command.GetType() &&
+		static_cast<String>(command) == static_cast<String>(m_Command);
+}
+
+const Value& CommandTemplate::GetCommand() const
+{
+	return m_Command;
+}
+
+const Dictionary::Ptr& CommandTemplate::GetArguments() const
+{
+	return m_Arguments;
+}
+
+bool CommandTemplate::GetResolveCommand() const
+{
+	return m_ResolveCommand;
+}
+
+const MacroValueTemplate& CommandTemplate::GetCommandTemplate() const
+{
+	return m_CommandTemplate;
+}
+
+const std::vector<CommandArgumentTemplate>& CommandTemplate::GetArgumentTemplates() const
+{
+	return m_ArgumentTemplates;
+}
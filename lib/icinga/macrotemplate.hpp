@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef MACROTEMPLATE_H
+#define MACROTEMPLATE_H
+
+#include "icinga/i2-icinga.hpp"
+#include "base/dictionary.hpp"
+#include "base/function.hpp"
+#include "base/value.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A literal text part or a macro reference within a macro string.
+ *
+ * @ingroup icinga
+ */
+struct MacroTemplateSegment
+{
+	bool IsMacro{false};
+	String Text; /* the literal text or the full macro name */
+	String ObjectName; /* e.g. "host" for "$host.vars.os$" */
+	std::vector<String> Tokens; /* the name's remaining components */
+	String Attribute; /* the remaining components joined with "." */
+};
+
+/**
+ * A macro string which has been split into literal text and macro
+ * references so that it does not have to be parsed again each time
+ * it is resolved.
+ *
+ * @ingroup icinga
+ */
+class MacroTemplate
+{
+public:
+	MacroTemplate() = default;
+	explicit MacroTemplate(const String& str);
+
+	const String& GetSource() const;
+	const std::vector<MacroTemplateSegment>& GetSegments() const;
+
+	bool IsSingleMacro() const;
+	bool IsUnterminated() const;
+
+private:
+	String m_Source;
+	std::vector<MacroTemplateSegment> m_Segments;
+	bool m_Unterminated{false};
+};
+
+/**
+ * A macro value (string, array, dictionary or function) with all of its
+ * macro strings parsed.
+ *
+ * @ingroup icinga
+ */
+struct MacroValueTemplate
+{
+	Value Source;
+	MacroTemplate Scalar;
+	std::vector<MacroTemplate> Elements;
+	std::vector<std::pair<String, MacroTemplate> > Items;
+
+	MacroValueTemplate() = default;
+	explicit MacroValueTemplate(const Value& value);
+};
+
+/**
+ * A command argument with its attributes evaluated and its
+ * macro strings parsed.
+ *
+ * @ingroup icinga
+ */
+struct CommandArgumentTemplate
+{
+	int Order{0};
+	bool Required{false};
+	bool SkipKey{false};
+	bool RepeatKey{true};
+	bool SkipValue{false};
+	String Key;
+	MacroValueTemplate ValueTemplate;
+	MacroValueTemplate SetIfTemplate;
+};
+
+/**
+ * A command line and its arguments, compiled once and reused for every
+ * execution until the command's attributes change.
+ *
+ * @ingroup icinga
+ */
+class CommandTemplate final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(CommandTemplate);
+
+	CommandTemplate(const Value& command, const Dictionary::Ptr& arguments);
+
+	bool IsCompiledFrom(const Value& command, const Dictionary::Ptr& arguments) const;
+
+	const Value& GetCommand() const;
+	const Dictionary::Ptr& GetArguments() const;
+	bool GetResolveCommand() const;
+	const MacroValueTemplate& GetCommandTemplate() const;
+	const std::vector<CommandArgumentTemplate>& GetArgumentTemplates() const;
+
+private:
+	Value m_Command;
+	Dictionary::Ptr m_Arguments;
+	bool m_ResolveCommand;
+	MacroValueTemplate m_CommandTemplate;
+	std::vector<CommandArgumentTemplate> m_ArgumentTemplates;
+};
+
+}
+
+#endif /* MACROTEMPLATE_H */
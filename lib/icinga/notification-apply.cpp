@@ -152,13 +152,14 @@ void Notification::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-	for (ApplyRule& rule : ApplyRule::GetRules("Notification"))
-	{
-		if (rule.GetTargetType() != "Host")
+	std::map<String, Value> variables { { "host", host } };
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules("Notification", variables)) {
+		if (rule->GetTargetType() != "Host")
 			continue;
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
 
@@ -166,11 +167,13 @@ void Notification::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" + service->GetName() + "'");
 
-	for (ApplyRule& rule : ApplyRule::GetRules("Notification")) {
-		if (rule.GetTargetType() != "Service")
+	std::map<String, Value> variables { { "host", service->GetHost() }, { "service", service } };
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules("Notification", variables)) {
+		if (rule->GetTargetType() != "Service")
 			continue;
 
-		if (EvaluateApplyRule(service, rule))
-			rule.AddMatch();
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
 	}
 }
@@ -29,6 +29,7 @@
 #include "base/exception.hpp"
 #include "base/initialize.hpp"
 #include "base/scriptglobal.hpp"
+#include <atomic>
 
 using namespace icinga;
 
@@ -40,6 +41,9 @@ std::map<String, int> Notification::m_TypeFilterMap;
 
 boost::signals2::signal<void (const Notification::Ptr&, const MessageOrigin::Ptr&)> Notification::OnNextNotificationChanged;
 
+/* Incremented whenever the recipients of any notification may have changed. */
+static std::atomic<uint_fast64_t> l_RecipientsVersion(1);
+
 String NotificationNameComposer::MakeName(const String& shortName, const Object::Ptr& context) const
 {
 	Notification::Ptr notification = dynamic_pointer_cast<Notification>(context);
@@ -112,6 +116,15 @@ void Notification::StaticInitialize()
 	m_TypeFilterMap["Recovery"] = NotificationRecovery;
 	m_TypeFilterMap["FlappingStart"] = NotificationFlappingStart;
 	m_TypeFilterMap["FlappingEnd"] = NotificationFlappingEnd;
+
+	/* Group memberships are updated by UserGroup::AddMember()/RemoveMember(). */
+	Notification::OnUsersRawChanged.connect(std::bind(&Notification::InvalidateRecipients));
+	Notification::OnUserGroupsRawChanged.connect(std::bind(&Notification::InvalidateRecipients));
+
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		if (dynamic_pointer_cast<User>(object) || dynamic_pointer_cast<UserGroup>(object))
+			InvalidateRecipients();
+	});
 }
 
 void Notification::OnConfigLoaded()
@@ -216,6 +229,49 @@ std::set<UserGroup::Ptr> Notification::GetUserGroups() const
 	return result;
 }
 
+/**
+ * Returns the users from the "users" attribute and all members of the groups
+ * from the "user_groups" attribute. The result is cached until the users, the
+ * groups or their memberships change.
+ *
+ * @returns The users.
+ */
+std::shared_ptr<const std::set<User::Ptr> > Notification::GetRecipients() const
+{
+	uint_fast64_t version = l_RecipientsVersion;
+
+	{
+		boost::mutex::scoped_lock lock(m_RecipientsMutex);
+
+		if (m_Recipients && m_RecipientsVersion == version)
+			return m_Recipients;
+	}
+
+	auto recipients = std::make_shared<std::set<User::Ptr> >(GetUsers());
+
+	for (const UserGroup::Ptr& ug : GetUserGroups()) {
+		std::set<User::Ptr> members = ug->GetMembers();
+		recipients->insert(members.begin(), members.end());
+	}
+
+	boost::mutex::scoped_lock lock(m_RecipientsMutex);
+
+	/* Changes which happened while resolving the recipients have incremented
+	 * the version, so they're picked up by the next call. */
+	m_Recipients = recipients;
+	m_RecipientsVersion = version;
+
+	return recipients;
+}
+
+/**
+ * Discards the cached recipients of all notifications.
+ */
+void Notification::InvalidateRecipients()
+{
+	l_RecipientsVersion++;
+}
+
 TimePeriod::Ptr Notification::GetPeriod() const
 {
 	return TimePeriod::GetByName(GetPeriodRaw());
@@ -372,20 +428,15 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 			SetLastProblemNotification(now);
 	}
 
-	std::set<User::Ptr> allUsers;
-
-	std::set<User::Ptr> users = GetUsers();
-	std::copy(users.begin(), users.end(), std::inserter(allUsers, allUsers.begin()));
-
-	for (const UserGroup::Ptr& ug : GetUserGroups()) {
-		std::set<User::Ptr> members = ug->GetMembers();
-		std::copy(members.begin(), members.end(), std::inserter(allUsers, allUsers.begin()));
-	}
+	std::shared_ptr<const std::set<User::Ptr> > allUsers = GetRecipients();
 
 	std::set<User::Ptr> allNotifiedUsers;
 	Array::Ptr notifiedProblemUsers = GetNotifiedProblemUsers();
 
-	for (const User::Ptr& user : allUsers) {
+	/* Users usually share a few time periods, evaluate each only once. */
+	std::map<TimePeriod::Ptr, bool> periods;
+
+	for (const User::Ptr& user : *allUsers) {
 		String userName = user->GetName();
 
 		if (!user->GetEnableNotifications()) {
@@ -394,7 +445,7 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 			continue;
 		}
 
-		if (!CheckNotificationUserFilters(type, user, force, reminder)) {
+		if (!CheckNotificationUserFilters(type, user, force, reminder, periods)) {
 			Log(LogNotice, "Notification")
 				<< "Notification filters for user '" << userName << "' not matched. Not sending notification.";
 			continue;
@@ -431,12 +482,23 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 	Service::OnNotificationSentToAllUsers(this, checkable, allNotifiedUsers, type, cr, author, text, nullptr);
 }
 
-bool Notification::CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder)
+bool Notification::CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder,
+	std::map<TimePeriod::Ptr, bool>& periods)
 {
 	if (!force) {
 		TimePeriod::Ptr tp = user->GetPeriod();
+		bool inside = true;
 
-		if (tp && !tp->IsInside(Utility::GetTime())) {
+		if (tp) {
+			auto it = periods.find(tp);
+
+			if (it == periods.end())
+				it = periods.emplace(tp, tp->IsInside(Utility::GetTime())).first;
+
+			inside = it->second;
+		}
+
+		if (!inside) {
 			Log(LogNotice, "Notification")
 				<< "Not sending " << (reminder ? "reminder " : " ") << "notifications for notification object '"
 				<< GetName() << " and user '" << user->GetName()
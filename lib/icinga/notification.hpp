@@ -30,6 +30,7 @@
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
 #include "base/array.hpp"
+#include <memory>
 
 namespace icinga
 {
@@ -90,6 +91,9 @@ public:
 	TimePeriod::Ptr GetPeriod() const;
 	std::set<User::Ptr> GetUsers() const;
 	std::set<UserGroup::Ptr> GetUserGroups() const;
+	std::shared_ptr<const std::set<User::Ptr> > GetRecipients() const;
+
+	static void InvalidateRecipients();
 
 	void UpdateNotificationNumber();
 	void ResetNotificationNumber();
@@ -124,7 +128,12 @@ protected:
 private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
-	bool CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder);
+	mutable boost::mutex m_RecipientsMutex;
+	mutable std::shared_ptr<const std::set<User::Ptr> > m_Recipients;
+	mutable uint_fast64_t m_RecipientsVersion{0};
+
+	bool CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder,
+		std::map<TimePeriod::Ptr, bool>& periods);
 
 	void ExecuteNotificationHelper(NotificationType type, const User::Ptr& user, const CheckResult::Ptr& cr, bool force, const String& author = "", const String& text = "");
 
@@ -19,6 +19,7 @@
 
 #include "icinga/pluginutility.hpp"
 #include "icinga/macroprocessor.hpp"
+#include "icinga/pluginworker.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
@@ -27,6 +28,7 @@
 #include "base/objectlock.hpp"
 #include "base/exception.hpp"
 #include <boost/algorithm/string/trim.hpp>
+#include <cstring>
 
 using namespace icinga;
 
@@ -35,13 +37,10 @@ void PluginUtility::ExecuteCommand(const Command::Ptr& commandObj, const Checkab
 	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros,
 	const std::function<void(const Value& commandLine, const ProcessResult&)>& callback)
 {
-	Value raw_command = commandObj->GetCommandLine();
-	Dictionary::Ptr raw_arguments = commandObj->GetArguments();
-
 	Value command;
 
 	try {
-		command = MacroProcessor::ResolveArguments(raw_command, raw_arguments,
+		command = MacroProcessor::ResolveArguments(commandObj->GetCommandTemplate(),
 			macroResolvers, cr, resolvedMacros, useResolvedMacros);
 	} catch (const std::exception& ex) {
 		String message = DiagnosticInformation(ex);
@@ -77,19 +76,33 @@ void PluginUtility::ExecuteCommand(const Command::Ptr& commandObj, const Checkab
 			if (value.IsObjectType<Array>())
 				value = Utility::Join(value, ';');
 
-			envMacros->Set(kv.first, value);
+			envMacros->Set(kv.first, std::move(value));
 		}
 	}
 
 	if (resolvedMacros && !useResolvedMacros)
 		return;
 
-	Process::Ptr process = new Process(Process::PrepareCommand(command), envMacros);
+	double timeout;
 
 	if (checkable->GetCheckTimeout().IsEmpty())
-		process->SetTimeout(commandObj->GetTimeout());
+		timeout = commandObj->GetTimeout();
 	else
-		process->SetTimeout(checkable->GetCheckTimeout());
+		timeout = checkable->GetCheckTimeout();
+
+#ifndef _WIN32
+	CheckCommand::Ptr checkCommand = dynamic_pointer_cast<CheckCommand>(commandObj);
+
+	if (checkCommand && checkCommand->GetWorkerCommand()) {
+		PluginWorkerPool::GetPool(checkCommand)->Execute(Process::PrepareCommand(command), envMacros,
+			timeout, std::bind(callback, command, _1));
+		return;
+	}
+#endif /* _WIN32 */
+
+	Process::Ptr process = new Process(Process::PrepareCommand(command), envMacros);
+
+	process->SetTimeout(timeout);
 
 	process->SetAdjustPriority(true);
 
@@ -112,32 +125,46 @@ ServiceState PluginUtility::ExitStatusToState(int exitStatus)
 
 std::pair<String, String> PluginUtility::ParseCheckOutput(const String& output)
 {
-	String text;
-	String perfdata;
+	std::string text;
+	std::string perfdata;
+
+	text.reserve(output.GetLength());
+
+	/* Walk the lines in place rather than splitting the output into separate strings first. */
+	const char *data = output.CStr();
+	const char *end = data + output.GetLength();
+
+	for (const char *line = data;; line++) {
+		const char *lineEnd = line;
 
-	std::vector<String> lines = output.Split("\r\n");
+		while (lineEnd < end && *lineEnd != '\r' && *lineEnd != '\n')
+			lineEnd++;
 
-	for (const String& line : lines) {
-		size_t delim = line.FindFirstOf("|");
+		const char *delim = static_cast<const char *>(memchr(line, '|', lineEnd - line));
 
-		if (!text.IsEmpty())
-			text += "\n";
+		if (!text.empty())
+			text += '\n';
 
-		if (delim != String::NPos) {
-			text += line.SubStr(0, delim);
+		if (delim) {
+			text.append(line, delim);
 
-			if (!perfdata.IsEmpty())
-				perfdata += " ";
+			if (!perfdata.empty())
+				perfdata += ' ';
 
-			perfdata += line.SubStr(delim + 1, line.GetLength());
+			perfdata.append(delim + 1, lineEnd);
 		} else {
-			text += line;
+			text.append(line, lineEnd);
 		}
+
+		if (lineEnd == end)
+			break;
+
+		line = lineEnd;
 	}
 
 	boost::algorithm::trim(perfdata);
 
-	return std::make_pair(text, perfdata);
+	return std::make_pair(String(std::move(text)), String(std::move(perfdata)));
 }
 
 Array::Ptr PluginUtility::SplitPerfdata(const String& perfdata)
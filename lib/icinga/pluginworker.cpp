@@ -0,0 +1,299 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/pluginworker.hpp"
+#include "base/networkstream.hpp"
+#include "base/netstring.hpp"
+#include "base/json.hpp"
+#include "base/array.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include "base/exception.hpp"
+#include <boost/exception/errinfo_api_function.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <poll.h>
+#include <thread>
+
+#ifndef _WIN32
+
+using namespace icinga;
+
+static boost::mutex l_PluginWorkerPoolsMutex;
+static std::map<String, PluginWorkerPool::Ptr> l_PluginWorkerPools;
+
+/**
+ * The state of one worker process. Each worker is owned by exactly one
+ * pool thread which sends it one check at a time.
+ */
+struct PluginWorkerPool::Worker
+{
+	pid_t PID{-1};
+	int SpawnHelper{0};
+	Socket::Ptr WorkerSocket;
+	NetworkStream::Ptr Stream;
+	std::unique_ptr<StreamReadContext> Context;
+};
+
+PluginWorkerPool::PluginWorkerPool(Process::Arguments workerCommand, int workerCount)
+	: m_WorkerCommand(std::move(workerCommand)), m_WorkerCount(workerCount)
+{ }
+
+/**
+ * Returns the worker pool for a check command. The pool is replaced when
+ * the command's worker_command or worker_count change.
+ */
+PluginWorkerPool::Ptr PluginWorkerPool::GetPool(const CheckCommand::Ptr& command)
+{
+	Process::Arguments workerCommand = Process::PrepareCommand(command->GetWorkerCommand());
+	int workerCount = std::max(1, command->GetWorkerCount());
+
+	boost::mutex::scoped_lock lock(l_PluginWorkerPoolsMutex);
+
+	auto it = l_PluginWorkerPools.find(command->GetName());
+
+	if (it != l_PluginWorkerPools.end()) {
+		if (it->second->m_WorkerCommand == workerCommand && it->second->m_WorkerCount == workerCount)
+			return it->second;
+
+		it->second->Stop();
+	}
+
+	PluginWorkerPool::Ptr pool = new PluginWorkerPool(std::move(workerCommand), workerCount);
+	pool->Start();
+
+	l_PluginWorkerPools[command->GetName()] = pool;
+
+	return pool;
+}
+
+void PluginWorkerPool::Start()
+{
+	for (int i = 0; i < m_WorkerCount; i++) {
+		std::thread t(std::bind(&PluginWorkerPool::WorkerThreadProc, PluginWorkerPool::Ptr(this)));
+		t.detach();
+	}
+}
+
+/**
+ * Stops the pool. Jobs which were already queued are still executed.
+ */
+void PluginWorkerPool::Stop()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_Stopped = true;
+	m_CV.notify_all();
+}
+
+void PluginWorkerPool::Execute(const Process::Arguments& arguments, const Dictionary::Ptr& extraEnvironment,
+	double timeout, const std::function<void (const ProcessResult&)>& callback)
+{
+	Job job;
+	job.Arguments = arguments;
+	job.ExtraEnvironment = extraEnvironment;
+	job.Timeout = timeout;
+	job.Callback = callback;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_Jobs.emplace_back(std::move(job));
+	m_CV.notify_one();
+}
+
+void PluginWorkerPool::WorkerThreadProc()
+{
+	Utility::SetThreadName("Plugin Worker");
+
+	Worker worker;
+
+	for (;;) {
+		Job job;
+
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
+
+			while (m_Jobs.empty() && !m_Stopped)
+				m_CV.wait(lock);
+
+			if (m_Jobs.empty())
+				break;
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+		}
+
+		ProcessResult pr = RunJob(worker, job);
+
+		try {
+			job.Callback(pr);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "PluginWorkerPool")
+				<< "Exception thrown in plugin worker callback:\n"
+				<< DiagnosticInformation(ex);
+		}
+	}
+
+	StopWorker(worker);
+}
+
+ProcessResult PluginWorkerPool::RunJob(Worker& worker, const Job& job)
+{
+	ProcessResult pr;
+	pr.PID = -1;
+	pr.ExecutionStart = Utility::GetTime();
+	pr.ExitStatus = 128;
+
+	if (!worker.Stream && !StartWorker(worker)) {
+		pr.ExecutionEnd = Utility::GetTime();
+		pr.ExitStatus = 3; /* Unknown */
+		pr.Output = "Could not start plugin worker " + Process::PrettyPrintArguments(m_WorkerCommand);
+		return pr;
+	}
+
+	pr.PID = worker.PID;
+
+	Dictionary::Ptr request = new Dictionary({
+		{ "arguments", Array::FromVector(job.Arguments) },
+		{ "env", job.ExtraEnvironment },
+		{ "timeout", job.Timeout }
+	});
+
+	double deadline = pr.ExecutionStart + job.Timeout;
+	String jresponse;
+
+	try {
+		NetString::WriteStringToStream(worker.Stream, JsonEncode(request));
+
+		for (;;) {
+			double remaining = deadline - Utility::GetTime();
+
+			if (remaining <= 0) {
+				Log(LogWarning, "PluginWorkerPool")
+					<< "Killing plugin worker " << worker.PID << " (" << Process::PrettyPrintArguments(job.Arguments)
+					<< ") after timeout of " << job.Timeout << " seconds";
+
+				StopWorker(worker);
+
+				pr.ExecutionEnd = Utility::GetTime();
+				pr.Output = "<Timeout exceeded.>";
+				return pr;
+			}
+
+			pollfd pfd;
+			pfd.fd = worker.WorkerSocket->GetFD();
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+
+			int rc = poll(&pfd, 1, static_cast<int>(remaining * 1000) + 1);
+
+			if (rc < 0 && errno != EINTR) {
+				BOOST_THROW_EXCEPTION(posix_error()
+					<< boost::errinfo_api_function("poll")
+					<< boost::errinfo_errno(errno));
+			}
+
+			if (rc <= 0)
+				continue;
+
+			StreamReadStatus srs = NetString::ReadStringFromStream(worker.Stream, &jresponse, *worker.Context);
+
+			if (srs == StatusEof)
+				BOOST_THROW_EXCEPTION(std::runtime_error("Plugin worker closed the connection."));
+
+			if (srs == StatusNewItem)
+				break;
+		}
+
+		Dictionary::Ptr response = JsonDecode(jresponse);
+
+		pr.ExitStatus = response->Get("exit_status");
+		pr.Output = response->Get("output");
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "PluginWorkerPool")
+			<< "Plugin worker " << worker.PID << " (" << Process::PrettyPrintArguments(m_WorkerCommand)
+			<< ") failed: " << DiagnosticInformation(ex, false);
+
+		StopWorker(worker);
+
+		pr.Output = "<Plugin worker terminated unexpectedly.>";
+	}
+
+	pr.ExecutionEnd = Utility::GetTime();
+
+	return pr;
+}
+
+bool PluginWorkerPool::StartWorker(Worker& worker)
+{
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		Log(LogCritical, "PluginWorkerPool")
+			<< "socketpair() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		return false;
+	}
+
+	Utility::SetCloExec(sv[0]);
+
+	int fds[3];
+	fds[0] = sv[1];
+	fds[1] = sv[1];
+	fds[2] = STDERR_FILENO;
+
+	worker.PID = Process::Spawn(m_WorkerCommand, nullptr, fds, worker.SpawnHelper);
+
+	(void)close(sv[1]);
+
+	if (worker.PID == -1) {
+		Log(LogCritical, "PluginWorkerPool")
+			<< "Could not start plugin worker " << Process::PrettyPrintArguments(m_WorkerCommand)
+			<< ": error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+
+		(void)close(sv[0]);
+		return false;
+	}
+
+	Log(LogNotice, "PluginWorkerPool")
+		<< "Started plugin worker " << Process::PrettyPrintArguments(m_WorkerCommand) << ": PID " << worker.PID;
+
+	worker.WorkerSocket = new Socket(sv[0]);
+	worker.Stream = new NetworkStream(worker.WorkerSocket);
+	worker.Context.reset(new StreamReadContext());
+
+	return true;
+}
+
+void PluginWorkerPool::StopWorker(Worker& worker)
+{
+	if (!worker.Stream)
+		return;
+
+	worker.Stream->Close();
+
+	/* Workers are started in their own session, so this also kills their children. */
+	(void)Process::Kill(worker.SpawnHelper, -worker.PID, SIGKILL);
+
+	int status;
+	(void)Process::WaitPID(worker.SpawnHelper, worker.PID, &status);
+
+	worker.PID = -1;
+	worker.WorkerSocket.reset();
+	worker.Stream.reset();
+	worker.Context.reset();
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,87 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef PLUGINWORKER_H
+#define PLUGINWORKER_H
+
+#include "icinga/i2-icinga.hpp"
+#include "icinga/checkcommand.hpp"
+#include "base/process.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+
+namespace icinga
+{
+
+#ifndef _WIN32
+
+/**
+ * A pool of long-lived worker processes for a check command which has a
+ * worker_command. Check invocations are sent to the workers as
+ * netstring-encoded JSON messages over their stdin and the result is read
+ * from their stdout, so no process has to be spawned per check.
+ *
+ * @ingroup icinga
+ */
+class PluginWorkerPool final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(PluginWorkerPool);
+
+	static PluginWorkerPool::Ptr GetPool(const CheckCommand::Ptr& command);
+
+	void Execute(const Process::Arguments& arguments, const Dictionary::Ptr& extraEnvironment,
+		double timeout, const std::function<void (const ProcessResult&)>& callback);
+
+private:
+	struct Job
+	{
+		Process::Arguments Arguments;
+		Dictionary::Ptr ExtraEnvironment;
+		double Timeout;
+		std::function<void (const ProcessResult&)> Callback;
+	};
+
+	struct Worker;
+
+	Process::Arguments m_WorkerCommand;
+	int m_WorkerCount;
+
+	boost::mutex m_Mutex;
+	boost::condition_variable m_CV;
+	std::deque<Job> m_Jobs;
+	bool m_Stopped{false};
+
+	PluginWorkerPool(Process::Arguments workerCommand, int workerCount);
+
+	void Start();
+	void Stop();
+
+	void WorkerThreadProc();
+	ProcessResult RunJob(Worker& worker, const Job& job);
+	bool StartWorker(Worker& worker);
+	void StopWorker(Worker& worker);
+};
+
+#endif /* _WIN32 */
+
+}
+
+#endif /* PLUGINWORKER_H */
@@ -89,7 +89,7 @@ void ScheduledDowntime::Start(bool runtimeCreated)
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, [this]() {
-		l_Timer = new Timer();
+		l_Timer = new Timer("ScheduledDowntime");
 		l_Timer->SetInterval(60);
 		l_Timer->OnTimerExpired.connect(std::bind(&ScheduledDowntime::TimerProc));
 		l_Timer->Start();
@@ -98,6 +98,19 @@ void ScheduledDowntime::Start(bool runtimeCreated)
 	Utility::QueueAsyncCallback(std::bind(&ScheduledDowntime::CreateNextDowntime, this));
 }
 
+void ScheduledDowntime::Stop(bool runtimeRemoved)
+{
+	/* The downtimes created by this object are removed once it is gone. */
+	if (runtimeRemoved) {
+		for (const Downtime::Ptr& downtime : GetCheckable()->GetDowntimes()) {
+			if (downtime->GetConfigOwner() == GetName())
+				downtime->QueueExpiryCheck();
+		}
+	}
+
+	ObjectImpl<ScheduledDowntime>::Stop(runtimeRemoved);
+}
+
 void ScheduledDowntime::TimerProc()
 {
 	for (const ScheduledDowntime::Ptr& sd : ConfigType::GetObjectsByType<ScheduledDowntime>()) {
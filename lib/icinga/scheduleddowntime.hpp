@@ -53,6 +53,7 @@ public:
 protected:
 	void OnAllConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
 
 private:
 	static void TimerProc();
@@ -26,13 +26,22 @@
 #include "base/logger.hpp"
 #include "base/context.hpp"
 #include "base/workqueue.hpp"
+#include <algorithm>
+#include <atomic>
 
 using namespace icinga;
 
 REGISTER_TYPE(ServiceGroup);
 
+/* Invalidates the resolved nested groups of all service groups. */
+static std::atomic<int> l_ServiceGroupGeneration{0};
+
 INITIALIZE_ONCE([]() {
 	ObjectRule::RegisterType("ServiceGroup");
+
+	ServiceGroup::OnGroupsChanged.connect([](const ServiceGroup::Ptr&, const Value&) {
+		l_ServiceGroupGeneration++;
+	});
 });
 
 bool ServiceGroup::EvaluateObjectRule(const Service::Ptr& service, const ConfigItem::Ptr& group)
@@ -67,13 +76,9 @@ void ServiceGroup::EvaluateObjectRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating group membership for service '" + service->GetName() + "'");
 
-	for (const ConfigItem::Ptr& group : ConfigItem::GetItems(ServiceGroup::TypeInstance))
-	{
-		if (!group->GetFilter())
-			continue;
-
-		EvaluateObjectRule(service, group);
-	}
+	ObjectRule::EvaluateRules(ServiceGroup::TypeInstance, { { "host", service->GetHost() }, { "service", service } }, [&service](const ConfigItem::Ptr& group) {
+		return EvaluateObjectRule(service, group);
+	});
 }
 
 std::set<Service::Ptr> ServiceGroup::GetMembers() const
@@ -96,33 +101,98 @@ void ServiceGroup::RemoveMember(const Service::Ptr& service)
 	m_Members.erase(service);
 }
 
-bool ServiceGroup::ResolveGroupMembership(const Service::Ptr& service, bool add, int rstack) {
+/**
+ * Returns this group and the groups it is nested in, the outermost groups
+ * first. The result is cached until a group of this type changes.
+ *
+ * @returns false if the groups are nested too deeply.
+ */
+bool ServiceGroup::GetResolvedGroups(std::vector<ServiceGroup::Ptr>& groups)
+{
+	int generation = l_ServiceGroupGeneration;
 
-	if (add && rstack > 20) {
-		Log(LogWarning, "ServiceGroup")
-			<< "Too many nested groups for group '" << GetName() << "': Service '"
-			<< service->GetName() << "' membership assignment failed.";
+	{
+		boost::mutex::scoped_lock lock(m_ServiceGroupMutex);
 
-		return false;
+		if (m_ResolvedGeneration == generation) {
+			groups = m_ResolvedGroups;
+			return !groups.empty();
+		}
 	}
 
-	Array::Ptr groups = GetGroups();
+	std::vector<ServiceGroup::Ptr> result;
 
-	if (groups && groups->GetLength() > 0) {
-		ObjectLock olock(groups);
+	if (!CollectGroups(this, result, 0))
+		result.clear();
 
-		for (const String& name : groups) {
-			ServiceGroup::Ptr group = ServiceGroup::GetByName(name);
+	boost::mutex::scoped_lock lock(m_ServiceGroupMutex);
+	m_ResolvedGroups = result;
+	m_ResolvedGeneration = generation;
 
-			if (group && !group->ResolveGroupMembership(service, add, rstack + 1))
+	groups.swap(result);
+	return !groups.empty();
+}
+
+bool ServiceGroup::CollectGroups(const ServiceGroup::Ptr& group, std::vector<ServiceGroup::Ptr>& groups, int rstack)
+{
+	if (rstack > 20)
+		return false;
+
+	Array::Ptr parents = group->GetGroups();
+
+	if (parents && parents->GetLength() > 0) {
+		ObjectLock olock(parents);
+
+		for (const String& name : parents) {
+			ServiceGroup::Ptr parent = ServiceGroup::GetByName(name);
+
+			if (parent && !CollectGroups(parent, groups, rstack + 1))
 				return false;
 		}
 	}
 
-	if (add)
-		AddMember(service);
-	else
-		RemoveMember(service);
+	if (std::find(groups.begin(), groups.end(), group) == groups.end())
+		groups.push_back(group);
+
+	return true;
+}
+
+bool ServiceGroup::ResolveGroupMembership(const Service::Ptr& service, bool add)
+{
+	std::vector<ServiceGroup::Ptr> groups;
+
+	if (!GetResolvedGroups(groups)) {
+		if (add) {
+			Log(LogWarning, "ServiceGroup")
+				<< "Too many nested groups for group '" << GetName() << "': Service '"
+				<< service->GetName() << "' membership assignment failed.";
+
+			return false;
+		}
+
+		groups.emplace_back(this);
+	}
+
+	for (const ServiceGroup::Ptr& group : groups) {
+		if (add)
+			group->AddMember(service);
+		else
+			group->RemoveMember(service);
+	}
 
 	return true;
 }
+
+void ServiceGroup::OnConfigLoaded()
+{
+	ObjectImpl<ServiceGroup>::OnConfigLoaded();
+
+	l_ServiceGroupGeneration++;
+}
+
+void ServiceGroup::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<ServiceGroup>::Stop(runtimeRemoved);
+
+	l_ServiceGroupGeneration++;
+}
@@ -44,14 +44,25 @@ public:
 	void AddMember(const Service::Ptr& service);
 	void RemoveMember(const Service::Ptr& service);
 
-	bool ResolveGroupMembership(const Service::Ptr& service, bool add = true, int rstack = 0);
+	bool ResolveGroupMembership(const Service::Ptr& service, bool add = true);
 
 	static void EvaluateObjectRules(const Service::Ptr& service);
 
+protected:
+	void OnConfigLoaded() override;
+	void Stop(bool runtimeRemoved) override;
+
 private:
 	mutable boost::mutex m_ServiceGroupMutex;
 	std::set<Service::Ptr> m_Members;
 
+	int m_ResolvedGeneration{-1};
+	std::vector<ServiceGroup::Ptr> m_ResolvedGroups;
+
+	bool GetResolvedGroups(std::vector<ServiceGroup::Ptr>& groups);
+
+	static bool CollectGroups(const ServiceGroup::Ptr& group, std::vector<ServiceGroup::Ptr>& groups, int rstack);
+
 	static bool EvaluateObjectRule(const Service::Ptr& service, const intrusive_ptr<ConfigItem>& group);
 };
 
@@ -27,6 +27,7 @@
 #include "base/timer.hpp"
 #include "base/utility.hpp"
 #include <boost/thread/once.hpp>
+#include <algorithm>
 
 using namespace icinga;
 
@@ -41,7 +42,7 @@ void TimePeriod::Start(bool runtimeCreated)
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, [this]() {
-		l_UpdateTimer = new Timer();
+		l_UpdateTimer = new Timer("TimePeriod update");
 		l_UpdateTimer->SetInterval(300);
 		l_UpdateTimer->OnTimerExpired.connect(std::bind(&TimePeriod::UpdateTimerHandler));
 		l_UpdateTimer->Start();
@@ -59,6 +60,8 @@ void TimePeriod::AddSegment(double begin, double end)
 {
 	ASSERT(OwnsLock());
 
+	m_MergedSegmentsDirty = true;
+
 	Log(LogDebug, "TimePeriod")
 		<< "Adding segment '" << Utility::FormatDateTime("%c", begin) << "' <-> '"
 		<< Utility::FormatDateTime("%c", end) << "' to TimePeriod '" << GetName() << "'";
@@ -120,6 +123,8 @@ void TimePeriod::RemoveSegment(double begin, double end)
 {
 	ASSERT(OwnsLock());
 
+	m_MergedSegmentsDirty = true;
+
 	Log(LogDebug, "TimePeriod")
 		<< "Removing segment '" << Utility::FormatDateTime("%c", begin) << "' <-> '"
 		<< Utility::FormatDateTime("%c", end) << "' from TimePeriod '" << GetName() << "'";
@@ -302,17 +307,55 @@ bool TimePeriod::IsInside(double ts) const
 	if (GetValidBegin().IsEmpty() || ts < GetValidBegin() || GetValidEnd().IsEmpty() || ts > GetValidEnd())
 		return true; /* Assume that all invalid regions are "inside". */
 
+	UpdateMergedSegments();
+
+	/* Find the last segment which begins before the timestamp. */
+	auto it = std::upper_bound(m_MergedSegments.begin(), m_MergedSegments.end(), ts,
+		[](double ts, const std::pair<double, double>& segment) { return ts <= segment.first; });
+
+	if (it == m_MergedSegments.begin())
+		return false;
+
+	--it;
+
+	return ts < it->second;
+}
+
+/**
+ * Rebuilds the sorted list of segments if they have changed.
+ *
+ * @threadsafety Caller must hold the object lock.
+ */
+void TimePeriod::UpdateMergedSegments() const
+{
 	Array::Ptr segments = GetSegments();
 
+	if (!m_MergedSegmentsDirty && segments == m_MergedSegmentsSource)
+		return;
+
+	m_MergedSegments.clear();
+
 	if (segments) {
 		ObjectLock dlock(segments);
-		for (const Dictionary::Ptr& segment : segments) {
-			if (ts > segment->Get("begin") && ts < segment->Get("end"))
-				return true;
-		}
+		for (const Dictionary::Ptr& segment : segments)
+			m_MergedSegments.emplace_back(segment->Get("begin"), segment->Get("end"));
+	}
+
+	std::sort(m_MergedSegments.begin(), m_MergedSegments.end());
+
+	/* Segments which only touch are kept apart: the boundary itself is not inside. */
+	std::vector<std::pair<double, double> > merged;
+
+	for (const std::pair<double, double>& segment : m_MergedSegments) {
+		if (!merged.empty() && segment.first < merged.back().second)
+			merged.back().second = std::max(merged.back().second, segment.second);
+		else
+			merged.push_back(segment);
 	}
 
-	return false;
+	m_MergedSegments.swap(merged);
+	m_MergedSegmentsSource = segments;
+	m_MergedSegmentsDirty = false;
 }
 
 double TimePeriod::FindNextTransition(double begin)
@@ -22,6 +22,7 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/timeperiod-ti.hpp"
+#include <vector>
 
 namespace icinga
 {
@@ -49,6 +50,13 @@ public:
 	void ValidateRanges(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
 
 private:
+	/* Sorted copy of the segments with overlapping segments merged, for IsInside(). */
+	mutable std::vector<std::pair<double, double> > m_MergedSegments;
+	mutable Array::Ptr m_MergedSegmentsSource;
+	mutable bool m_MergedSegmentsDirty{true};
+
+	void UpdateMergedSegments() const;
+
 	void AddSegment(double s, double end);
 	void AddSegment(const Dictionary::Ptr& segment);
 	void RemoveSegment(double begin, double end);
@@ -19,6 +19,7 @@
 
 #include "icinga/usergroup.hpp"
 #include "icinga/usergroup-ti.cpp"
+#include "icinga/notification.hpp"
 #include "config/objectrule.hpp"
 #include "config/configitem.hpp"
 #include "base/configtype.hpp"
@@ -26,13 +27,22 @@
 #include "base/logger.hpp"
 #include "base/context.hpp"
 #include "base/workqueue.hpp"
+#include <algorithm>
+#include <atomic>
 
 using namespace icinga;
 
 REGISTER_TYPE(UserGroup);
 
+/* Invalidates the resolved nested groups of all user groups. */
+static std::atomic<int> l_UserGroupGeneration{0};
+
 INITIALIZE_ONCE([]() {
 	ObjectRule::RegisterType("UserGroup");
+
+	UserGroup::OnGroupsChanged.connect([](const UserGroup::Ptr&, const Value&) {
+		l_UserGroupGeneration++;
+	});
 });
 
 bool UserGroup::EvaluateObjectRule(const User::Ptr& user, const ConfigItem::Ptr& group)
@@ -64,13 +74,9 @@ void UserGroup::EvaluateObjectRules(const User::Ptr& user)
 {
 	CONTEXT("Evaluating group membership for user '" + user->GetName() + "'");
 
-	for (const ConfigItem::Ptr& group : ConfigItem::GetItems(UserGroup::TypeInstance))
-	{
-		if (!group->GetFilter())
-			continue;
-
-		EvaluateObjectRule(user, group);
-	}
+	ObjectRule::EvaluateRules(UserGroup::TypeInstance, { { "user", user } }, [&user](const ConfigItem::Ptr& group) {
+		return EvaluateObjectRule(user, group);
+	});
 }
 
 std::set<User::Ptr> UserGroup::GetMembers() const
@@ -83,44 +89,116 @@ void UserGroup::AddMember(const User::Ptr& user)
 {
 	user->AddGroup(GetName());
 
-	boost::mutex::scoped_lock lock(m_UserGroupMutex);
-	m_Members.insert(user);
+	{
+		boost::mutex::scoped_lock lock(m_UserGroupMutex);
+		m_Members.insert(user);
+	}
+
+	Notification::InvalidateRecipients();
 }
 
 void UserGroup::RemoveMember(const User::Ptr& user)
 {
-	boost::mutex::scoped_lock lock(m_UserGroupMutex);
-	m_Members.erase(user);
+	{
+		boost::mutex::scoped_lock lock(m_UserGroupMutex);
+		m_Members.erase(user);
+	}
+
+	Notification::InvalidateRecipients();
 }
 
-bool UserGroup::ResolveGroupMembership(const User::Ptr& user, bool add, int rstack) {
+/**
+ * Returns this group and the groups it is nested in, the outermost groups
+ * first. The result is cached until a group of this type changes.
+ *
+ * @returns false if the groups are nested too deeply.
+ */
+bool UserGroup::GetResolvedGroups(std::vector<UserGroup::Ptr>& groups)
+{
+	int generation = l_UserGroupGeneration;
 
-	if (add && rstack > 20) {
-		Log(LogWarning, "UserGroup")
-			<< "Too many nested groups for group '" << GetName() << "': User '"
-			<< user->GetName() << "' membership assignment failed.";
+	{
+		boost::mutex::scoped_lock lock(m_UserGroupMutex);
 
-		return false;
+		if (m_ResolvedGeneration == generation) {
+			groups = m_ResolvedGroups;
+			return !groups.empty();
+		}
 	}
 
-	Array::Ptr groups = GetGroups();
+	std::vector<UserGroup::Ptr> result;
 
-	if (groups && groups->GetLength() > 0) {
-		ObjectLock olock(groups);
+	if (!CollectGroups(this, result, 0))
+		result.clear();
 
-		for (const String& name : groups) {
-			UserGroup::Ptr group = UserGroup::GetByName(name);
+	boost::mutex::scoped_lock lock(m_UserGroupMutex);
+	m_ResolvedGroups = result;
+	m_ResolvedGeneration = generation;
+
+	groups.swap(result);
+	return !groups.empty();
+}
+
+bool UserGroup::CollectGroups(const UserGroup::Ptr& group, std::vector<UserGroup::Ptr>& groups, int rstack)
+{
+	if (rstack > 20)
+		return false;
 
-			if (group && !group->ResolveGroupMembership(user, add, rstack + 1))
+	Array::Ptr parents = group->GetGroups();
+
+	if (parents && parents->GetLength() > 0) {
+		ObjectLock olock(parents);
+
+		for (const String& name : parents) {
+			UserGroup::Ptr parent = UserGroup::GetByName(name);
+
+			if (parent && !CollectGroups(parent, groups, rstack + 1))
 				return false;
 		}
 	}
 
-	if (add)
-		AddMember(user);
-	else
-		RemoveMember(user);
+	if (std::find(groups.begin(), groups.end(), group) == groups.end())
+		groups.push_back(group);
+
+	return true;
+}
+
+bool UserGroup::ResolveGroupMembership(const User::Ptr& user, bool add)
+{
+	std::vector<UserGroup::Ptr> groups;
+
+	if (!GetResolvedGroups(groups)) {
+		if (add) {
+			Log(LogWarning, "UserGroup")
+				<< "Too many nested groups for group '" << GetName() << "': User '"
+				<< user->GetName() << "' membership assignment failed.";
+
+			return false;
+		}
+
+		groups.emplace_back(this);
+	}
+
+	for (const UserGroup::Ptr& group : groups) {
+		if (add)
+			group->AddMember(user);
+		else
+			group->RemoveMember(user);
+	}
 
 	return true;
 }
 
+void UserGroup::OnConfigLoaded()
+{
+	ObjectImpl<UserGroup>::OnConfigLoaded();
+
+	l_UserGroupGeneration++;
+}
+
+void UserGroup::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<UserGroup>::Stop(runtimeRemoved);
+
+	l_UserGroupGeneration++;
+}
@@ -44,14 +44,25 @@ public:
 	void AddMember(const User::Ptr& user);
 	void RemoveMember(const User::Ptr& user);
 
-	bool ResolveGroupMembership(const User::Ptr& user, bool add = true, int rstack = 0);
+	bool ResolveGroupMembership(const User::Ptr& user, bool add = true);
 
 	static void EvaluateObjectRules(const User::Ptr& user);
 
+protected:
+	void OnConfigLoaded() override;
+	void Stop(bool runtimeRemoved) override;
+
 private:
 	mutable boost::mutex m_UserGroupMutex;
 	std::set<User::Ptr> m_Members;
 
+	int m_ResolvedGeneration{-1};
+	std::vector<UserGroup::Ptr> m_ResolvedGroups;
+
+	bool GetResolvedGroups(std::vector<UserGroup::Ptr>& groups);
+
+	static bool CollectGroups(const UserGroup::Ptr& group, std::vector<UserGroup::Ptr>& groups, int rstack);
+
 	static bool EvaluateObjectRule(const User::Ptr& user, const intrusive_ptr<ConfigItem>& group);
 };
 
@@ -30,3 +30,9 @@ bool AndFilter::Apply(const Table::Ptr& table, const Value& row)
 
 	return true;
 }
+
+void AndFilter::GetIndexPredicates(std::vector<LivestatusIndexPredicate>& predicates) const
+{
+	for (const Filter::Ptr& filter : m_Filters)
+		filter->GetIndexPredicates(predicates);
+}
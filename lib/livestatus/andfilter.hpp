@@ -36,6 +36,7 @@ public:
 	DECLARE_PTR_TYPEDEFS(AndFilter);
 
 	bool Apply(const Table::Ptr& table, const Value& row) override;
+	void GetIndexPredicates(std::vector<LivestatusIndexPredicate>& predicates) const override;
 };
 
 }
@@ -22,6 +22,7 @@
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
+#include "base/pattern.hpp"
 #include <boost/regex.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -33,9 +34,7 @@ AttributeFilter::AttributeFilter(String column, String op, String operand)
 
 bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 {
-	Column column = table->GetColumn(m_Column);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetRowValue(m_Column, row);
 
 	if (value.IsObjectType<Array>()) {
 		Array::Ptr array = value;
@@ -64,10 +63,10 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 		} else if (m_Operator == "~") {
 			bool ret;
 			try {
-				boost::regex expr(m_Operand.GetData());
+				std::shared_ptr<const boost::regex> expr = PatternCache::GetRegex(m_Operand);
 				String operand = value;
 				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
+				ret = boost::regex_search(operand.GetData(), what, *expr);
 			} catch (boost::exception&) {
 				Log(LogWarning, "AttributeFilter")
 					<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
@@ -94,10 +93,10 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 		} else if (m_Operator == "~~") {
 			bool ret;
 			try {
-				boost::regex expr(m_Operand.GetData(), boost::regex::icase);
+				std::shared_ptr<const boost::regex> expr = PatternCache::GetRegex(m_Operand, boost::regex::icase);
 				String operand = value;
 				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
+				ret = boost::regex_search(operand.GetData(), what, *expr);
 			} catch (boost::exception&) {
 				Log(LogWarning, "AttributeFilter")
 					<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
@@ -136,3 +135,10 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 
 	return false;
 }
+
+void AttributeFilter::GetIndexPredicates(std::vector<LivestatusIndexPredicate>& predicates) const
+{
+	/* equality for scalar columns and membership for list columns */
+	if (m_Operator == "=" || m_Operator == ">=")
+		predicates.push_back({ m_Column, m_Operator, m_Operand });
+}
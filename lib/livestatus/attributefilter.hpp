@@ -38,6 +38,7 @@ public:
 	AttributeFilter(String column, String op, String operand);
 
 	bool Apply(const Table::Ptr& table, const Value& row) override;
+	void GetIndexPredicates(std::vector<LivestatusIndexPredicate>& predicates) const override;
 
 protected:
 	String m_Column;
@@ -35,9 +35,7 @@ AvgAggregatorState *AvgAggregator::EnsureState(AggregatorState **state)
 
 void AvgAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_AvgAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetRowValue(m_AvgAttr, row);
 
 	AvgAggregatorState *pstate = EnsureState(state);
 
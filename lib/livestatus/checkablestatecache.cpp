@@ -0,0 +1,266 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "livestatus/checkablestatecache.hpp"
+#include "icinga/compatutility.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <unordered_map>
+
+using namespace icinga;
+
+namespace
+{
+
+struct CheckableStateRow
+{
+	int StateRaw;
+	int StateType;
+	int Acknowledgement;
+	double AcknowledgementExpiry;
+	int HasBeenChecked;
+	double LastCheck;
+	double LastStateChange;
+	String PluginOutput;
+};
+
+/* One entry per cached checkable in each vector, indexed by the checkable's slot. */
+struct CheckableStateColumns
+{
+	std::vector<unsigned int> Generation;
+	std::vector<int> Valid;
+	std::vector<int> StateRaw;
+	std::vector<int> StateType;
+	std::vector<int> Acknowledgement;
+	std::vector<double> AcknowledgementExpiry;
+	std::vector<int> HasBeenChecked;
+	std::vector<double> LastCheck;
+	std::vector<double> LastStateChange;
+	std::vector<String> PluginOutput;
+};
+
+}
+
+static boost::mutex l_Mutex;
+static bool l_Started = false;
+static std::unordered_map<const Checkable *, size_t> l_Slots;
+static std::vector<size_t> l_FreeSlots;
+static CheckableStateColumns l_Columns;
+
+static size_t GetSlot(const Checkable::Ptr& checkable)
+{
+	auto it = l_Slots.find(checkable.get());
+
+	if (it != l_Slots.end())
+		return it->second;
+
+	size_t slot;
+
+	if (!l_FreeSlots.empty()) {
+		slot = l_FreeSlots.back();
+		l_FreeSlots.pop_back();
+	} else {
+		slot = l_Columns.Generation.size();
+
+		l_Columns.Generation.push_back(0);
+		l_Columns.Valid.push_back(0);
+		l_Columns.StateRaw.push_back(0);
+		l_Columns.StateType.push_back(0);
+		l_Columns.Acknowledgement.push_back(0);
+		l_Columns.AcknowledgementExpiry.push_back(0);
+		l_Columns.HasBeenChecked.push_back(0);
+		l_Columns.LastCheck.push_back(0);
+		l_Columns.LastStateChange.push_back(0);
+		l_Columns.PluginOutput.emplace_back();
+	}
+
+	l_Slots[checkable.get()] = slot;
+
+	return slot;
+}
+
+static CheckableStateRow ReadRow(const Checkable::Ptr& checkable)
+{
+	CheckableStateRow row;
+
+	CheckableSnapshot::Ptr snapshot = checkable->GetSnapshot();
+	const CheckResult::Ptr& cr = snapshot->LastCheckResult;
+
+	row.StateRaw = snapshot->StateRaw;
+	row.StateType = snapshot->Type;
+	row.Acknowledgement = snapshot->Acknowledgement;
+	row.AcknowledgementExpiry = snapshot->AcknowledgementExpiry;
+	row.HasBeenChecked = cr ? 1 : 0;
+	row.LastCheck = cr ? cr->GetScheduleEnd() : -1;
+	row.LastStateChange = snapshot->LastStateChange;
+
+	if (cr)
+		row.PluginOutput = CompatUtility::GetCheckResultOutput(cr);
+
+	return row;
+}
+
+static void StoreRow(size_t slot, const CheckableStateRow& row)
+{
+	l_Columns.StateRaw[slot] = row.StateRaw;
+	l_Columns.StateType[slot] = row.StateType;
+	l_Columns.Acknowledgement[slot] = row.Acknowledgement;
+	l_Columns.AcknowledgementExpiry[slot] = row.AcknowledgementExpiry;
+	l_Columns.HasBeenChecked[slot] = row.HasBeenChecked;
+	l_Columns.LastCheck[slot] = row.LastCheck;
+	l_Columns.LastStateChange[slot] = row.LastStateChange;
+	l_Columns.PluginOutput[slot] = row.PluginOutput;
+	l_Columns.Valid[slot] = 1;
+}
+
+template<typename T>
+static T GetCachedValue(const Checkable::Ptr& checkable, std::vector<T> CheckableStateColumns::*column, T CheckableStateRow::*field)
+{
+	bool cacheable = false;
+	unsigned int generation = 0;
+
+	{
+		boost::mutex::scoped_lock lock(l_Mutex);
+
+		if (l_Started && checkable->IsActive()) {
+			size_t slot = GetSlot(checkable);
+
+			if (l_Columns.Valid[slot])
+				return (l_Columns.*column)[slot];
+
+			cacheable = true;
+			generation = l_Columns.Generation[slot];
+		}
+	}
+
+	/* Read the object's state without holding the cache lock. */
+	CheckableStateRow row = ReadRow(checkable);
+
+	if (cacheable) {
+		boost::mutex::scoped_lock lock(l_Mutex);
+
+		auto it = l_Slots.find(checkable.get());
+
+		/* Don't store the row if the checkable was updated or deactivated in the meantime. */
+		if (it != l_Slots.end() && l_Columns.Generation[it->second] == generation)
+			StoreRow(it->second, row);
+	}
+
+	return row.*field;
+}
+
+void CheckableStateCache::Start()
+{
+	boost::mutex::scoped_lock lock(l_Mutex);
+
+	if (l_Started)
+		return;
+
+	Checkable::OnLastCheckResultChanged.connect(std::bind(&CheckableStateCache::InvalidateHandler, _1));
+	Checkable::OnStateRawChanged.connect(std::bind(&CheckableStateCache::InvalidateHandler, _1));
+	Checkable::OnStateTypeChanged.connect(std::bind(&CheckableStateCache::InvalidateHandler, _1));
+	Checkable::OnLastStateChangeChanged.connect(std::bind(&CheckableStateCache::InvalidateHandler, _1));
+	Checkable::OnAcknowledgementRawChanged.connect(std::bind(&CheckableStateCache::InvalidateHandler, _1));
+	Checkable::OnAcknowledgementExpiryChanged.connect(std::bind(&CheckableStateCache::InvalidateHandler, _1));
+	Checkable::OnSnapshotPublished.connect(std::bind(&CheckableStateCache::InvalidateHandler, _1));
+	ConfigObject::OnActiveChanged.connect(std::bind(&CheckableStateCache::ObjectActiveChangedHandler, _1));
+
+	l_Started = true;
+}
+
+void CheckableStateCache::InvalidateHandler(const Checkable::Ptr& checkable)
+{
+	boost::mutex::scoped_lock lock(l_Mutex);
+
+	auto it = l_Slots.find(checkable.get());
+
+	if (it == l_Slots.end())
+		return;
+
+	l_Columns.Generation[it->second]++;
+	l_Columns.Valid[it->second] = 0;
+}
+
+void CheckableStateCache::ObjectActiveChangedHandler(const ConfigObject::Ptr& object)
+{
+	Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+	if (!checkable || checkable->IsActive())
+		return;
+
+	boost::mutex::scoped_lock lock(l_Mutex);
+
+	auto it = l_Slots.find(checkable.get());
+
+	if (it == l_Slots.end())
+		return;
+
+	size_t slot = it->second;
+
+	l_Columns.Generation[slot]++;
+	l_Columns.Valid[slot] = 0;
+	l_Columns.PluginOutput[slot] = String();
+
+	l_FreeSlots.push_back(slot);
+	l_Slots.erase(it);
+}
+
+/**
+ * Returns the service state of the checkable. Host states depend on the
+ * host's reachability and are therefore not cached.
+ */
+int CheckableStateCache::GetStateRaw(const Checkable::Ptr& checkable)
+{
+	return GetCachedValue(checkable, &CheckableStateColumns::StateRaw, &CheckableStateRow::StateRaw);
+}
+
+int CheckableStateCache::GetStateType(const Checkable::Ptr& checkable)
+{
+	return GetCachedValue(checkable, &CheckableStateColumns::StateType, &CheckableStateRow::StateType);
+}
+
+bool CheckableStateCache::IsAcknowledged(const Checkable::Ptr& checkable)
+{
+	if (GetCachedValue(checkable, &CheckableStateColumns::Acknowledgement, &CheckableStateRow::Acknowledgement) == AcknowledgementNone)
+		return false;
+
+	double expiry = GetCachedValue(checkable, &CheckableStateColumns::AcknowledgementExpiry, &CheckableStateRow::AcknowledgementExpiry);
+
+	return expiry == 0 || expiry >= Utility::GetTime();
+}
+
+bool CheckableStateCache::HasBeenChecked(const Checkable::Ptr& checkable)
+{
+	return GetCachedValue(checkable, &CheckableStateColumns::HasBeenChecked, &CheckableStateRow::HasBeenChecked) != 0;
+}
+
+double CheckableStateCache::GetLastCheck(const Checkable::Ptr& checkable)
+{
+	return GetCachedValue(checkable, &CheckableStateColumns::LastCheck, &CheckableStateRow::LastCheck);
+}
+
+double CheckableStateCache::GetLastStateChange(const Checkable::Ptr& checkable)
+{
+	return GetCachedValue(checkable, &CheckableStateColumns::LastStateChange, &CheckableStateRow::LastStateChange);
+}
+
+String CheckableStateCache::GetPluginOutput(const Checkable::Ptr& checkable)
+{
+	return GetCachedValue(checkable, &CheckableStateColumns::PluginOutput, &CheckableStateRow::PluginOutput);
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CHECKABLESTATECACHE_H
+#define CHECKABLESTATECACHE_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "icinga/checkable.hpp"
+
+using namespace icinga;
+
+namespace icinga
+{
+
+/**
+ * Column-oriented copy of the checkable state which is queried most often
+ * by livestatus clients. Rows are invalidated by the checkable's attribute
+ * change signals and refreshed on the next access, so table accessors don't
+ * have to lock the objects or re-format the check result for every cell.
+ *
+ * @ingroup livestatus
+ */
+class CheckableStateCache
+{
+public:
+	static void Start();
+
+	static int GetStateRaw(const Checkable::Ptr& checkable);
+	static int GetStateType(const Checkable::Ptr& checkable);
+	static bool IsAcknowledged(const Checkable::Ptr& checkable);
+	static bool HasBeenChecked(const Checkable::Ptr& checkable);
+	static double GetLastCheck(const Checkable::Ptr& checkable);
+	static double GetLastStateChange(const Checkable::Ptr& checkable);
+	static String GetPluginOutput(const Checkable::Ptr& checkable);
+
+private:
+	CheckableStateCache();
+
+	static void InvalidateHandler(const Checkable::Ptr& checkable);
+	static void ObjectActiveChangedHandler(const ConfigObject::Ptr& object);
+};
+
+}
+
+#endif /* CHECKABLESTATECACHE_H */
@@ -36,6 +36,10 @@ public:
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row) = 0;
 
+	/* Adds the predicates which every row matching this filter must satisfy. */
+	virtual void GetIndexPredicates(std::vector<LivestatusIndexPredicate>&) const
+	{ }
+
 protected:
 	Filter() = default;
 };
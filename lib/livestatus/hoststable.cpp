@@ -20,6 +20,7 @@
 #include "livestatus/hoststable.hpp"
 #include "livestatus/hostgroupstable.hpp"
 #include "livestatus/endpointstable.hpp"
+#include "livestatus/checkablestatecache.hpp"
 #include "icinga/host.hpp"
 #include "icinga/service.hpp"
 #include "icinga/hostgroup.hpp"
@@ -196,13 +197,34 @@ void HostsTable::FetchRows(const AddRowFunction& addRowFn)
 			}
 		}
 	} else {
-		for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
+		for (Host *host : ConfigType::GetObjectRange<Host>()) {
 			if (!addRowFn(host, LivestatusGroupByNone, Empty))
 				return;
 		}
 	}
 }
 
+bool HostsTable::FetchIndexedRows(const LivestatusIndexPredicate& predicate, const AddRowFunction& addRowFn)
+{
+	if (GetGroupByType() != LivestatusGroupByNone)
+		return false;
+
+	FilterPredicate fp;
+	fp.Variable = "host";
+	fp.Values.insert(predicate.Operand);
+
+	if ((predicate.Column == "name" || predicate.Column == "host_name") && predicate.Operator == "=") {
+		fp.Path.emplace_back("name");
+		fp.Membership = false;
+	} else if (predicate.Column == "groups" && predicate.Operator == ">=") {
+		fp.Path.emplace_back("groups");
+		fp.Membership = true;
+	} else
+		return false;
+
+	return FetchPredicateRows("Host", fp, addRowFn);
+}
+
 Object::Ptr HostsTable::HostGroupAccessor(const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	/* return the current group by value set from within FetchRows()
@@ -394,13 +416,7 @@ Value HostsTable::PluginOutputAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	String output;
-	CheckResult::Ptr cr = host->GetLastCheckResult();
-
-	if (cr)
-		output = CompatUtility::GetCheckResultOutput(cr);
-
-	return output;
+	return CheckableStateCache::GetPluginOutput(host);
 }
 
 Value HostsTable::PerfDataAccessor(const Value& row)
@@ -416,7 +432,7 @@ Value HostsTable::PerfDataAccessor(const Value& row)
 	if (!cr)
 		return Empty;
 
-	return PluginUtility::FormatPerfdata(cr->GetPerformanceData());
+	return cr->GetFormattedPerformanceData();
 }
 
 Value HostsTable::IconImageAccessor(const Value& row)
@@ -608,7 +624,7 @@ Value HostsTable::HasBeenCheckedAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	return Convert::ToLong(host->HasBeenChecked());
+	return Convert::ToLong(CheckableStateCache::HasBeenChecked(host));
 }
 
 Value HostsTable::CurrentNotificationNumberAccessor(const Value& row)
@@ -668,8 +684,7 @@ Value HostsTable::AcknowledgedAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	ObjectLock olock(host);
-	return host->IsAcknowledged();
+	return CheckableStateCache::IsAcknowledged(host);
 }
 
 Value HostsTable::StateAccessor(const Value& row)
@@ -689,7 +704,7 @@ Value HostsTable::StateTypeAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	return host->GetStateType();
+	return CheckableStateCache::GetStateType(host);
 }
 
 Value HostsTable::NoMoreNotificationsAccessor(const Value& row)
@@ -709,7 +724,7 @@ Value HostsTable::LastCheckAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	return static_cast<int>(host->GetLastCheck());
+	return static_cast<int>(CheckableStateCache::GetLastCheck(host));
 }
 
 Value HostsTable::LastStateChangeAccessor(const Value& row)
@@ -719,7 +734,7 @@ Value HostsTable::LastStateChangeAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	return static_cast<int>(host->GetLastStateChange());
+	return static_cast<int>(CheckableStateCache::GetLastStateChange(host));
 }
 
 Value HostsTable::LastTimeUpAccessor(const Value& row)
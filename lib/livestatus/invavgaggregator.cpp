@@ -35,9 +35,7 @@ InvAvgAggregatorState *InvAvgAggregator::EnsureState(AggregatorState **state)
 
 void InvAvgAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_InvAvgAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetRowValue(m_InvAvgAttr, row);
 
 	InvAvgAggregatorState *pstate = EnsureState(state);
 
@@ -35,9 +35,7 @@ InvSumAggregatorState *InvSumAggregator::EnsureState(AggregatorState **state)
 
 void InvSumAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_InvSumAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetRowValue(m_InvSumAttr, row);
 
 	InvSumAggregatorState *pstate = EnsureState(state);
 
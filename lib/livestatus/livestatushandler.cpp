@@ -0,0 +1,103 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "livestatus/livestatushandler.hpp"
+#include "livestatus/livestatuslistener.hpp"
+#include "livestatus/livestatusquery.hpp"
+#include "remote/httputility.hpp"
+#include "remote/filterutility.hpp"
+#include "base/configtype.hpp"
+#include "base/application.hpp"
+#include "base/stdiostream.hpp"
+#include "base/logger.hpp"
+#include <sstream>
+
+using namespace icinga;
+
+REGISTER_URLHANDLER("/v1/livestatus", LivestatusHandler);
+
+static String GetCompatLogPath()
+{
+	for (const LivestatusListener::Ptr& listener : ConfigType::GetObjectsByType<LivestatusListener>())
+		return listener->GetCompatLogPath();
+
+	return Application::GetLocalStateDir() + "/log/icinga2/compat";
+}
+
+bool LivestatusHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
+{
+	if (request.RequestUrl->GetPath().size() != 2)
+		return false;
+
+	if (request.RequestMethod != "GET" && request.RequestMethod != "POST")
+		return false;
+
+	String text = HttpUtility::GetLastParameter(params, "query");
+	std::vector<String> lines;
+
+	for (String line : text.Split("\n")) {
+		if (line.GetLength() > 0 && line[line.GetLength() - 1] == '\r')
+			line = line.SubStr(0, line.GetLength() - 1);
+
+		if (line.IsEmpty())
+			break;
+
+		/* The HTTP response carries the status code and the length. */
+		if (line.SubStr(0, 15) == "ResponseHeader:" || line.SubStr(0, 10) == "KeepAlive:")
+			continue;
+
+		lines.emplace_back(std::move(line));
+	}
+
+	if (lines.empty()) {
+		HttpUtility::SendJsonError(response, params, 400, "Query must not be empty.");
+		return true;
+	}
+
+	if (lines[0].SubStr(0, 8) == "COMMAND ")
+		FilterUtility::CheckPermission(user, "livestatus/command");
+	else
+		FilterUtility::CheckPermission(user, "livestatus/query");
+
+	lines.emplace_back("ResponseHeader: fixed16");
+
+	LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath());
+
+	std::stringstream stream;
+	query->Execute(new StdioStream(&stream, false));
+
+	String output = stream.str();
+
+	/* Skip the fixed16 header. */
+	if (output.GetLength() >= 16)
+		output = output.SubStr(16);
+
+	int code = query->GetResponseCode();
+
+	if (code != LivestatusErrorOK) {
+		HttpUtility::SendJsonError(response, params, code == LivestatusErrorNotFound ? 404 : 400, output);
+		return true;
+	}
+
+	response.SetStatus(200, "OK");
+	response.AddHeader("Content-Type", query->GetOutputFormat() == "json" ? "application/json" : "text/plain");
+	response.WriteBody(output.CStr(), output.GetLength());
+
+	return true;
+}
@@ -0,0 +1,45 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef LIVESTATUSHANDLER_H
+#define LIVESTATUSHANDLER_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "remote/httphandler.hpp"
+
+namespace icinga
+{
+
+/**
+ * Executes livestatus queries which are sent to the REST API.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusHandler final : public HttpHandler
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusHandler);
+
+	bool HandleRequest(const ApiUser::Ptr& user, HttpRequest& request,
+		HttpResponse& response, const Dictionary::Ptr& params) override;
+};
+
+}
+
+#endif /* LIVESTATUSHANDLER_H */
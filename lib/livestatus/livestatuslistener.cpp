@@ -19,6 +19,8 @@
 
 #include "livestatus/livestatuslistener.hpp"
 #include "livestatus/livestatuslistener-ti.cpp"
+#include "livestatus/checkablestatecache.hpp"
+#include "icinga/cib.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/objectlock.hpp"
@@ -48,11 +50,20 @@ void LivestatusListener::StatsFunc(const Dictionary::Ptr& status, const Array::P
 	DictionaryData nodes;
 
 	for (const LivestatusListener::Ptr& livestatuslistener : ConfigType::GetObjectsByType<LivestatusListener>()) {
+		size_t workQueueItems = livestatuslistener->m_WorkQueue ? livestatuslistener->m_WorkQueue->GetLength() : 0;
+
 		nodes.emplace_back(livestatuslistener->GetName(), new Dictionary({
-			{ "connections", l_Connections }
+			{ "connections", l_Connections },
+			{ "work_queue_items", workQueueItems },
+			{ "rejected_clients", livestatuslistener->m_RejectedClients.load() },
+			{ "query_cache_hits", livestatuslistener->m_QueryCache ? livestatuslistener->m_QueryCache->GetHits() : 0 },
+			{ "query_cache_misses", livestatuslistener->m_QueryCache ? livestatuslistener->m_QueryCache->GetMisses() : 0 },
+			{ "queries", livestatuslistener->GetQueryStats() }
 		}));
 
 		perfdata->Add(new PerfdataValue("livestatuslistener_" + livestatuslistener->GetName() + "_connections", l_Connections));
+		perfdata->Add(new PerfdataValue("livestatuslistener_" + livestatuslistener->GetName() + "_work_queue_items", workQueueItems));
+		perfdata->Add(new PerfdataValue("livestatuslistener_" + livestatuslistener->GetName() + "_rejected_clients", livestatuslistener->m_RejectedClients.load()));
 	}
 
 	status->Set("livestatuslistener", new Dictionary(std::move(nodes)));
@@ -68,6 +79,14 @@ void LivestatusListener::Start(bool runtimeCreated)
 	Log(LogInformation, "LivestatusListener")
 		<< "'" << GetName() << "' started.";
 
+	CheckableStateCache::Start();
+
+	if (GetQueryCacheMaxAge() > 0)
+		m_QueryCache.reset(new LivestatusQueryCache());
+
+	m_WorkQueue.reset(new WorkQueue(0, GetWorkerThreads()));
+	m_WorkQueue->SetName("LivestatusListener, " + GetName());
+
 	if (GetSocketType() == "tcp") {
 		TcpSocket::Ptr socket = new TcpSocket();
 
@@ -159,7 +178,31 @@ void LivestatusListener::ServerThreadProc()
 			if (m_Listener->Poll(true, false, &tv)) {
 				Socket::Ptr client = m_Listener->Accept();
 				Log(LogNotice, "LivestatusListener", "Client connected");
-				Utility::QueueAsyncCallback(std::bind(&LivestatusListener::ClientHandler, this, client), LowLatencyScheduler);
+
+				size_t queuedClients = m_WorkQueue->GetLength();
+
+				if (queuedClients >= static_cast<size_t>(GetMaxQueuedClients())) {
+					Log(LogWarning, "LivestatusListener")
+						<< "Closing client connection: " << queuedClients << " clients are already waiting for a worker thread.";
+
+					m_RejectedClients++;
+					client->Close();
+				} else {
+					LivestatusSession::Ptr session = new LivestatusSession(this, client);
+
+					{
+						boost::mutex::scoped_lock lock(m_SessionsMutex);
+						m_Sessions.insert(session);
+					}
+
+					{
+						boost::mutex::scoped_lock lock(l_ComponentMutex);
+						l_ClientsConnected++;
+						l_Connections++;
+					}
+
+					DispatchSession(session);
+				}
 			}
 
 			if (!IsActive())
@@ -172,44 +215,110 @@ void LivestatusListener::ServerThreadProc()
 	m_Listener->Close();
 }
 
-void LivestatusListener::ClientHandler(const Socket::Ptr& client)
+void LivestatusListener::DispatchSession(const LivestatusSession::Ptr& session)
 {
-	{
-		boost::mutex::scoped_lock lock(l_ComponentMutex);
-		l_ClientsConnected++;
-		l_Connections++;
-	}
+	m_WorkQueue->Enqueue(std::bind(&LivestatusListener::ClientHandler, this, session));
+}
+
+void LivestatusListener::ClientHandler(const LivestatusSession::Ptr& session)
+{
+	try {
+		for (;;) {
+			String line;
 
-	Stream::Ptr stream = new NetworkStream(client);
+			std::vector<String> lines;
 
-	StreamReadContext context;
+			for (;;) {
+				StreamReadStatus srs = session->Stream->ReadLine(&line, session->Context);
 
-	for (;;) {
-		String line;
+				if (srs == StatusEof)
+					break;
 
-		std::vector<String> lines;
+				if (srs != StatusNewItem)
+					continue;
 
-		for (;;) {
-			StreamReadStatus srs = stream->ReadLine(&line, context);
+				if (line.GetLength() > 0)
+					lines.push_back(line);
+				else
+					break;
+			}
 
-			if (srs == StatusEof)
+			if (lines.empty())
 				break;
 
-			if (srs != StatusNewItem)
-				continue;
+			LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath());
+
+			String cacheKey;
 
-			if (line.GetLength() > 0)
-				lines.push_back(line);
+			if (m_QueryCache)
+				cacheKey = LivestatusQueryCache::GetQueryKey(lines);
+
+			double start = Utility::GetTime();
+			bool keepAlive;
+
+			if (cacheKey.IsEmpty())
+				keepAlive = query->Execute(session->Stream);
 			else
+				keepAlive = ExecuteCachedQuery(session->Stream, query, cacheKey);
+
+			RecordQueryStats(query, Utility::GetTime() - start);
+
+			if (!keepAlive)
 				break;
+
+			/* Queries which the client has already pipelined are executed right away.
+			 * Otherwise the worker thread is released until the next query arrives. */
+			if (session->Context.Size == 0) {
+				session->ChangeEvents(POLLIN);
+				return;
+			}
 		}
+	} catch (const std::exception& ex) {
+		Log(LogNotice, "LivestatusListener")
+			<< "Error while processing livestatus query: " << DiagnosticInformation(ex, false);
+	}
 
-		if (lines.empty())
-			break;
+	CloseSession(session);
+}
 
-		LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath());
-		if (!query->Execute(stream))
-			break;
+/**
+ * Sends the cached response for a query if there is a current one.
+ * Otherwise the query is executed and its response is added to the cache.
+ */
+bool LivestatusListener::ExecuteCachedQuery(const Stream::Ptr& stream, const LivestatusQuery::Ptr& query, const String& key)
+{
+	String response;
+
+	if (m_QueryCache->GetResponse(key, GetQueryCacheMaxAge(), response)) {
+		stream->Write(response.CStr(), response.GetLength());
+
+		if (!query->GetKeepAlive()) {
+			stream->Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	uint_fast64_t generation = LivestatusQueryCache::GetGeneration();
+
+	LivestatusCaptureStream::Ptr capture = new LivestatusCaptureStream(stream, LivestatusQueryCache::GetMaxResponseSize());
+	bool keepAlive = query->Execute(capture);
+
+	if (query->GetResponseCode() == LivestatusErrorOK && capture->IsComplete())
+		m_QueryCache->AddResponse(key, generation, capture->GetData());
+
+	return keepAlive;
+}
+
+void LivestatusListener::CloseSession(const LivestatusSession::Ptr& session)
+{
+	session->Unregister();
+	session->Stream->Close();
+
+	{
+		boost::mutex::scoped_lock lock(m_SessionsMutex);
+		m_Sessions.erase(session);
 	}
 
 	{
@@ -218,6 +327,49 @@ void LivestatusListener::ClientHandler(const Socket::Ptr& client)
 	}
 }
 
+void LivestatusListener::RecordQueryStats(const LivestatusQuery::Ptr& query, double duration)
+{
+	String table = query->GetTable();
+
+	if (table.IsEmpty())
+		return;
+
+	LivestatusQueryStats *stats;
+
+	{
+		boost::mutex::scoped_lock lock(m_QueryStatsMutex);
+
+		std::unique_ptr<LivestatusQueryStats>& entry = m_QueryStats[table];
+
+		if (!entry)
+			entry.reset(new LivestatusQueryStats());
+
+		stats = entry.get();
+	}
+
+	stats->Duration.Record(duration);
+	stats->Queries++;
+	stats->RowsScanned += query->GetRowsScanned();
+	stats->RowsReturned += query->GetRowsReturned();
+}
+
+Dictionary::Ptr LivestatusListener::GetQueryStats() const
+{
+	Dictionary::Ptr queries = new Dictionary();
+
+	boost::mutex::scoped_lock lock(m_QueryStatsMutex);
+
+	for (const auto& kv : m_QueryStats) {
+		queries->Set(kv.first, new Dictionary({
+			{ "count", kv.second->Queries.load() },
+			{ "rows_scanned", kv.second->RowsScanned.load() },
+			{ "rows_returned", kv.second->RowsReturned.load() },
+			{ "duration", CIB::GetHistogramStats(kv.second->Duration) }
+		}));
+	}
+
+	return queries;
+}
 
 void LivestatusListener::ValidateSocketType(const Lazy<String>& lvalue, const ValidationUtils& utils)
 {
@@ -226,3 +378,39 @@ void LivestatusListener::ValidateSocketType(const Lazy<String>& lvalue, const Va
 	if (lvalue() != "unix" && lvalue() != "tcp")
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "socket_type" }, "Socket type '" + lvalue() + "' is invalid."));
 }
+
+void LivestatusListener::ValidateWorkerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<LivestatusListener>::ValidateWorkerThreads(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "worker_threads" }, "Value must be greater than 0."));
+}
+
+void LivestatusListener::ValidateMaxQueuedClients(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<LivestatusListener>::ValidateMaxQueuedClients(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "max_queued_clients" }, "Value must be greater than 0."));
+}
+
+void LivestatusListener::ValidateQueryCacheMaxAge(const Lazy<double>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<LivestatusListener>::ValidateQueryCacheMaxAge(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "query_cache_max_age" }, "Value must not be negative."));
+}
+
+LivestatusSession::LivestatusSession(LivestatusListener *listener, const Socket::Ptr& client)
+	: SocketEvents(client, this), Client(client), Stream(new NetworkStream(client)), m_Listener(listener)
+{ }
+
+void LivestatusSession::OnEvent(int)
+{
+	/* The worker thread re-enables the events once it's done with the client. */
+	ChangeEvents(0);
+
+	m_Listener->DispatchSession(this);
+}
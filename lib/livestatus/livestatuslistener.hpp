@@ -23,7 +23,14 @@
 #include "livestatus/i2-livestatus.hpp"
 #include "livestatus/livestatuslistener-ti.hpp"
 #include "livestatus/livestatusquery.hpp"
+#include "livestatus/livestatusquerycache.hpp"
 #include "base/socket.hpp"
+#include "base/socketevents.hpp"
+#include "base/networkstream.hpp"
+#include "base/workqueue.hpp"
+#include "base/histogram.hpp"
+#include <atomic>
+#include <set>
 #include <thread>
 
 using namespace icinga;
@@ -31,6 +38,41 @@ using namespace icinga;
 namespace icinga
 {
 
+class LivestatusListener;
+
+/**
+ * A livestatus client connection. Its read buffer is kept between queries
+ * so that pipelined queries of keep-alive clients aren't lost. While the
+ * client is idle the session waits for data in the socket I/O engine
+ * rather than on a worker thread.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusSession final : public Object, public SocketEvents
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusSession);
+
+	LivestatusSession(LivestatusListener *listener, const Socket::Ptr& client);
+
+	void OnEvent(int revents) override;
+
+	Socket::Ptr Client;
+	NetworkStream::Ptr Stream;
+	StreamReadContext Context;
+
+private:
+	LivestatusListener *m_Listener;
+};
+
+struct LivestatusQueryStats
+{
+	Histogram Duration;
+	std::atomic<uint_fast64_t> Queries{0};
+	std::atomic<uint_fast64_t> RowsScanned{0};
+	std::atomic<uint_fast64_t> RowsReturned{0};
+};
+
 /**
  * @ingroup livestatus
  */
@@ -45,7 +87,14 @@ public:
 	static int GetClientsConnected();
 	static int GetConnections();
 
+	void DispatchSession(const LivestatusSession::Ptr& session);
+
+	Dictionary::Ptr GetQueryStats() const;
+
 	void ValidateSocketType(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateWorkerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateMaxQueuedClients(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateQueryCacheMaxAge(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
 
 protected:
 	void Start(bool runtimeCreated) override;
@@ -53,10 +102,24 @@ protected:
 
 private:
 	void ServerThreadProc();
-	void ClientHandler(const Socket::Ptr& client);
+	void ClientHandler(const LivestatusSession::Ptr& session);
+	void CloseSession(const LivestatusSession::Ptr& session);
+	bool ExecuteCachedQuery(const Stream::Ptr& stream, const LivestatusQuery::Ptr& query, const String& key);
+	void RecordQueryStats(const LivestatusQuery::Ptr& query, double duration);
 
 	Socket::Ptr m_Listener;
 	std::thread m_Thread;
+
+	std::unique_ptr<WorkQueue> m_WorkQueue;
+	std::atomic<uint_fast64_t> m_RejectedClients{0};
+
+	boost::mutex m_SessionsMutex;
+	std::set<LivestatusSession::Ptr> m_Sessions;
+
+	mutable boost::mutex m_QueryStatsMutex;
+	std::map<String, std::unique_ptr<LivestatusQueryStats> > m_QueryStats;
+
+	std::unique_ptr<LivestatusQueryCache> m_QueryCache;
 };
 
 }
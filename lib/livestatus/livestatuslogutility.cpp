@@ -24,100 +24,822 @@
 #include "icinga/checkcommand.hpp"
 #include "icinga/eventcommand.hpp"
 #include "icinga/notificationcommand.hpp"
+#include "icinga/compatutility.hpp"
 #include "base/utility.hpp"
 #include "base/convert.hpp"
 #include "base/logger.hpp"
+#include "base/application.hpp"
+#include "base/objectlock.hpp"
+#include "base/exception.hpp"
+#include "base/initialize.hpp"
+#include <boost/thread/mutex.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fstream>
+#include <list>
+#include <memory>
+#include <set>
+#include <sys/stat.h>
 
 using namespace icinga;
 
+/* Lines between two checkpoints of the log file index. */
+#define LOG_INDEX_CHECKPOINT_LINES 1024
+
+/* Maximum number of parsed log entries which are kept in memory. */
+#define LOG_CACHE_MAX_ENTRIES 100000
+
+/* Maximum number of state history extracts which are kept in memory. */
+#define STATEHIST_EXTRACT_MAX_FILES 64
+
+namespace
+{
+
+struct LogCheckpoint
+{
+	time_t MaxTimeBefore; /* newest timestamp of all lines before the checkpoint */
+	std::streamoff Offset;
+	int LineNo;
+};
+
+struct LogFileIndex
+{
+	double Size{0};
+	double MTime{0};
+	bool Valid{false};
+	time_t Start{0};
+	time_t End{0};
+	std::streamoff ScannedOffset{0}; /* end of the last complete line which was indexed */
+	int ScannedLines{0};
+	std::vector<LogCheckpoint> Checkpoints;
+};
+
+typedef std::vector<std::pair<int, Dictionary::Ptr> > LogCacheEntries;
+
+struct LogCacheBlock
+{
+	std::shared_ptr<LogCacheEntries> Entries;
+	std::list<String>::iterator LruPosition;
+};
+
+/* state history relevant entries of an archived log file, one list per checkpoint */
+struct StateHistExtract
+{
+	double Size{0};
+	double MTime{0};
+	std::vector<std::shared_ptr<LogCacheEntries> > Blocks;
+};
+
+}
+
+static boost::mutex l_LogIndexMutex;
+static bool l_LogIndexLoaded = false;
+static bool l_LogIndexChanged = false;
+static double l_LogIndexLastSave = 0;
+static std::map<String, LogFileIndex> l_LogIndex;
+static std::map<String, LogCacheBlock> l_LogCache;
+static std::list<String> l_LogCacheLru;
+static size_t l_LogCacheEntries = 0;
+static std::map<String, std::shared_ptr<StateHistExtract> > l_StateHistExtracts;
+static std::list<String> l_StateHistExtractsLru;
+
+static String GetLogIndexPath()
+{
+	return Application::GetLocalStateDir() + "/cache/icinga2/livestatus-log-index.json";
+}
+
+static time_t GetLogLineTimestamp(const std::string& line)
+{
+	return atoi(line.substr(1, 11).c_str());
+}
+
+static void LoadLogIndex()
+{
+	String path;
+
+	try {
+		path = GetLogIndexPath();
+
+		if (!Utility::PathExists(path))
+			return;
+
+		Dictionary::Ptr files = Utility::LoadJsonFile(path);
+
+		ObjectLock olock(files);
+		for (const Dictionary::Pair& kv : files) {
+			Dictionary::Ptr entry = kv.second;
+			LogFileIndex info;
+
+			info.Size = entry->Get("size");
+			info.MTime = entry->Get("mtime");
+			info.Valid = entry->Get("valid");
+			info.Start = static_cast<double>(entry->Get("start"));
+			info.End = static_cast<double>(entry->Get("end"));
+			info.ScannedOffset = static_cast<double>(entry->Get("scanned_offset"));
+			info.ScannedLines = entry->Get("scanned_lines");
+
+			Array::Ptr checkpoints = entry->Get("checkpoints");
+			ObjectLock clock(checkpoints);
+
+			for (Array::SizeType i = 0; i + 2 < checkpoints->GetLength(); i += 3) {
+				LogCheckpoint checkpoint;
+				checkpoint.MaxTimeBefore = static_cast<double>(checkpoints->Get(i));
+				checkpoint.Offset = static_cast<double>(checkpoints->Get(i + 1));
+				checkpoint.LineNo = checkpoints->Get(i + 2);
+				info.Checkpoints.push_back(checkpoint);
+			}
+
+			if (info.Checkpoints.empty())
+				continue;
+
+			l_LogIndex[kv.first] = std::move(info);
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "LivestatusLogUtility")
+			<< "Could not load log file index '" << path << "': " << DiagnosticInformation(ex, false);
+
+		l_LogIndex.clear();
+	}
+}
+
+static void SaveLogIndex()
+{
+	DictionaryData files;
+
+	for (const auto& kv : l_LogIndex) {
+		const LogFileIndex& info = kv.second;
+		ArrayData checkpoints;
+
+		for (const LogCheckpoint& checkpoint : info.Checkpoints) {
+			checkpoints.emplace_back(static_cast<double>(checkpoint.MaxTimeBefore));
+			checkpoints.emplace_back(static_cast<double>(checkpoint.Offset));
+			checkpoints.emplace_back(checkpoint.LineNo);
+		}
+
+		files.emplace_back(kv.first, new Dictionary({
+			{ "size", info.Size },
+			{ "mtime", info.MTime },
+			{ "valid", info.Valid },
+			{ "start", static_cast<double>(info.Start) },
+			{ "end", static_cast<double>(info.End) },
+			{ "scanned_offset", static_cast<double>(info.ScannedOffset) },
+			{ "scanned_lines", info.ScannedLines },
+			{ "checkpoints", new Array(std::move(checkpoints)) }
+		}));
+	}
+
+	String path;
+
+	try {
+		path = GetLogIndexPath();
+
+		Utility::MkDirP(Utility::DirName(path), 0750);
+		Utility::SaveJsonFile(path, 0644, new Dictionary(std::move(files)));
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "LivestatusLogUtility")
+			<< "Could not save log file index '" << path << "': " << DiagnosticInformation(ex, false);
+	}
+}
+
+static void DropCachedLogEntries(const String& path)
+{
+	String prefix = path + "\n";
+
+	auto it = l_LogCache.lower_bound(prefix);
+
+	while (it != l_LogCache.end() && it->first.Find(prefix) == 0) {
+		l_LogCacheEntries -= it->second.Entries->size();
+		l_LogCacheLru.erase(it->second.LruPosition);
+		it = l_LogCache.erase(it);
+	}
+}
+
+static String GetStateHistExtractPath(const String& path);
+
+static void DropStateHistExtract(const String& path)
+{
+	l_StateHistExtracts.erase(path);
+	l_StateHistExtractsLru.remove(path);
+
+	try {
+		String extractPath = GetStateHistExtractPath(path);
+
+		if (Utility::PathExists(extractPath))
+			(void) unlink(extractPath.CStr());
+	} catch (const std::exception&) {
+		/* there's no persisted extract without a local state directory */
+	}
+}
+
+/**
+ * Adds a complete, non-empty log line to the index entry of its file.
+ *
+ * @returns false if the file isn't a log file, true otherwise.
+ */
+static bool IndexLogLine(LogFileIndex& info, const std::string& line, std::streamoff lineOffset)
+{
+	if (info.ScannedLines == 0) {
+		/* read the first bytes to get the timestamp: [123456789] */
+		info.Valid = (line.size() >= 12 && line[0] == '[' && line[11] == ']');
+
+		if (!info.Valid)
+			return false;
+
+		info.Start = GetLogLineTimestamp(line);
+	}
+
+	if (info.ScannedLines - info.Checkpoints.back().LineNo >= LOG_INDEX_CHECKPOINT_LINES)
+		info.Checkpoints.push_back({ info.End, lineOffset, info.ScannedLines });
+
+	time_t ts = GetLogLineTimestamp(line);
+
+	if (ts > info.End)
+		info.End = ts;
+
+	info.ScannedLines++;
+
+	return true;
+}
+
+/**
+ * Brings the index entry of a log file up to date. Log files only ever
+ * grow, so only lines which were appended since the last scan are read
+ * unless the file was replaced.
+ *
+ * @returns true if the entry was changed, false otherwise.
+ */
+static bool UpdateLogFileIndex(const String& path, LogFileIndex& info)
+{
+	struct stat statbuf;
+
+	if (stat(path.CStr(), &statbuf) < 0)
+		return false;
+
+	double size = statbuf.st_size;
+	double mtime = statbuf.st_mtime;
+
+	if (!info.Checkpoints.empty() && info.Size == size && info.MTime == mtime)
+		return false;
+
+	std::ifstream fp;
+	fp.open(path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open log file: " + path));
+
+	bool append = !info.Checkpoints.empty() && size >= info.Size;
+
+	/* make sure the file wasn't replaced by one which is even larger */
+	if (append && info.Valid) {
+		std::string line;
+		std::getline(fp, line);
+		append = (GetLogLineTimestamp(line) == info.Start);
+	}
+
+	if (!append) {
+		info = LogFileIndex();
+		info.Checkpoints.push_back({ 0, 0, 0 });
+	}
+
+	info.Size = size;
+	info.MTime = mtime;
+
+	/* this can happen for directories too, silently ignore them */
+	if (append && !info.Valid)
+		return true;
+
+	fp.clear();
+	fp.seekg(info.ScannedOffset);
+
+	std::streamoff offset = info.ScannedOffset;
+	std::string line;
+
+	while (std::getline(fp, line)) {
+		/* an incomplete line is indexed once it has been written completely */
+		if (fp.eof())
+			break;
+
+		std::streamoff lineOffset = offset;
+		offset += line.size() + 1;
+
+		if (!line.empty() && !IndexLogLine(info, line, lineOffset))
+			break;
+
+		info.ScannedOffset = offset;
+	}
+
+	return true;
+}
+
+/**
+ * Updates the index for lines the compat logger has just appended to a
+ * log file, so that the next query doesn't have to read them again.
+ */
+static void LogLinesWrittenHandler(const String& path, std::streamoff offset, const std::vector<String>& lines)
+{
+	boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+	/* the index is built when the first query is executed */
+	if (!l_LogIndexLoaded)
+		return;
+
+	LogFileIndex *info;
+
+	if (offset == 0) {
+		DropCachedLogEntries(path);
+		DropStateHistExtract(path);
+
+		info = &l_LogIndex[path];
+		*info = LogFileIndex();
+		info->Checkpoints.push_back({ 0, 0, 0 });
+	} else {
+		auto it = l_LogIndex.find(path);
+
+		/* the lines are picked up by the next scan */
+		if (it == l_LogIndex.end() || !it->second.Valid || it->second.ScannedOffset != offset)
+			return;
+
+		info = &it->second;
+	}
+
+	for (const String& line : lines) {
+		std::streamoff lineOffset = offset;
+		offset += line.GetLength() + 1;
+
+		if (!line.IsEmpty() && !IndexLogLine(*info, line.GetData(), lineOffset))
+			break;
+
+		info->ScannedOffset = offset;
+	}
+
+	struct stat statbuf;
+
+	/* only skip the next scan if nobody else has written to the file */
+	if (stat(path.CStr(), &statbuf) == 0 && statbuf.st_size == info->ScannedOffset) {
+		info->Size = statbuf.st_size;
+		info->MTime = statbuf.st_mtime;
+	}
+
+	l_LogIndexChanged = true;
+}
+
+/**
+ * Moves the index of a log file which was renamed to its archive path.
+ */
+static void LogFileRotatedHandler(const String& oldPath, const String& newPath)
+{
+	boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+	if (!l_LogIndexLoaded)
+		return;
+
+	DropCachedLogEntries(oldPath);
+	DropStateHistExtract(oldPath);
+
+	auto it = l_LogIndex.find(oldPath);
+
+	if (it == l_LogIndex.end())
+		return;
+
+	LogFileIndex info = it->second;
+	l_LogIndex.erase(it);
+	l_LogIndex[newPath] = info;
+	l_LogIndexChanged = true;
+}
+
+INITIALIZE_ONCE([]() {
+	CompatUtility::OnLogLinesWritten.connect(&LogLinesWrittenHandler);
+	CompatUtility::OnLogFileRotated.connect(&LogFileRotatedHandler);
+});
+
 void LivestatusLogUtility::CreateLogIndex(const String& path, std::map<time_t, String>& index)
 {
+	std::set<String> files;
+
 	Utility::Glob(path + "/icinga.log", std::bind(&LivestatusLogUtility::CreateLogIndexFileHandler, _1, std::ref(index)), GlobFile);
 	Utility::Glob(path + "/archives/*.log", std::bind(&LivestatusLogUtility::CreateLogIndexFileHandler, _1, std::ref(index)), GlobFile);
+
+	for (const auto& kv : index)
+		files.insert(kv.second);
+
+	boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+	/* forget about log files which were deleted */
+	String prefix = path + "/";
+
+	for (auto it = l_LogIndex.begin(); it != l_LogIndex.end(); ) {
+		if (it->first.Find(prefix) == 0 && files.find(it->first) == files.end() && !Utility::PathExists(it->first)) {
+			DropCachedLogEntries(it->first);
+			DropStateHistExtract(it->first);
+			it = l_LogIndex.erase(it);
+			l_LogIndexChanged = true;
+		} else
+			it++;
+	}
+
+	double now = Utility::GetTime();
+
+	if (l_LogIndexChanged && now - l_LogIndexLastSave >= 60) {
+		SaveLogIndex();
+
+		l_LogIndexChanged = false;
+		l_LogIndexLastSave = now;
+	}
 }
 
 void LivestatusLogUtility::CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index)
 {
-	std::ifstream stream;
-	stream.open(path.CStr(), std::ifstream::in);
+	LogFileIndex info;
 
-	if (!stream)
-		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open log file: " + path));
+	{
+		boost::mutex::scoped_lock lock(l_LogIndexMutex);
 
-	/* read the first bytes to get the timestamp: [123456789] */
-	char buffer[12];
+		if (!l_LogIndexLoaded) {
+			LoadLogIndex();
+			l_LogIndexLoaded = true;
+		}
 
-	stream.read(buffer, 12);
+		auto it = l_LogIndex.find(path);
 
-	if (buffer[0] != '[' || buffer[11] != ']') {
-		/* this can happen for directories too, silently ignore them */
-		return;
+		if (it != l_LogIndex.end())
+			info = it->second;
 	}
 
-	/* extract timestamp */
-	buffer[11] = 0;
-	time_t ts_start = atoi(buffer+1);
+	time_t oldStart = info.Start;
+	bool replaced = info.Checkpoints.empty();
 
-	stream.close();
+	/* the file is scanned without holding the lock */
+	if (UpdateLogFileIndex(path, info)) {
+		replaced = replaced || info.Start != oldStart || info.ScannedLines == 0;
+
+		boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+		if (replaced)
+			DropCachedLogEntries(path);
+
+		l_LogIndex[path] = info;
+		l_LogIndexChanged = true;
+	}
+
+	if (!info.Valid)
+		return;
 
 	Log(LogDebug, "LivestatusLogUtility")
-		<< "Indexing log file: '" << path << "' with timestamp start: '" << ts_start << "'.";
+		<< "Indexing log file: '" << path << "' with timestamp start: '" << info.Start << "'.";
 
-	index[ts_start] = path;
+	index[info.Start] = path;
 }
 
-void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, HistoryTable *table,
-	time_t from, time_t until, const AddRowFunction& addRowFn)
+static std::shared_ptr<LogCacheEntries> GetCachedLogEntries(const String& key)
+{
+	boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+	auto it = l_LogCache.find(key);
+
+	if (it == l_LogCache.end())
+		return nullptr;
+
+	l_LogCacheLru.splice(l_LogCacheLru.end(), l_LogCacheLru, it->second.LruPosition);
+
+	return it->second.Entries;
+}
+
+static void AddCachedLogEntries(const String& key, const std::shared_ptr<LogCacheEntries>& entries)
+{
+	boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+	if (l_LogCache.find(key) != l_LogCache.end())
+		return;
+
+	LogCacheBlock block;
+	block.Entries = entries;
+	block.LruPosition = l_LogCacheLru.insert(l_LogCacheLru.end(), key);
+
+	l_LogCache[key] = block;
+	l_LogCacheEntries += entries->size();
+
+	while (l_LogCacheEntries > LOG_CACHE_MAX_ENTRIES && l_LogCacheLru.size() > 1) {
+		auto it = l_LogCache.find(l_LogCacheLru.front());
+
+		l_LogCacheEntries -= it->second.Entries->size();
+		l_LogCache.erase(it);
+		l_LogCacheLru.pop_front();
+	}
+}
+
+/**
+ * Returns the parsed entries of a log file between a checkpoint and the next one.
+ */
+static std::shared_ptr<LogCacheEntries> GetLogBlockEntries(const String& path, const LogFileIndex& info, size_t block, std::ifstream& fp)
+{
+	const LogCheckpoint& checkpoint = info.Checkpoints[block];
+
+	/* the entries between two checkpoints don't change any more */
+	bool complete = (block + 1 < info.Checkpoints.size());
+	String key = path + "\n" + Convert::ToString(static_cast<double>(checkpoint.Offset));
+	std::shared_ptr<LogCacheEntries> entries;
+
+	if (complete)
+		entries = GetCachedLogEntries(key);
+
+	if (entries)
+		return entries;
+
+	entries = std::make_shared<LogCacheEntries>();
+
+	std::streamoff offset = checkpoint.Offset;
+	std::streamoff end = complete ? info.Checkpoints[block + 1].Offset : -1;
+	int lineno = checkpoint.LineNo;
+
+	fp.clear();
+	fp.seekg(offset);
+
+	while (fp.good() && (end == -1 || offset < end)) {
+		std::string line;
+		std::getline(fp, line);
+
+		offset += line.size() + 1;
+
+		if (line.empty())
+			continue; /* Ignore empty lines */
+
+		Dictionary::Ptr log_entry_attrs = LivestatusLogUtility::GetAttributes(line);
+
+		/* no attributes available - invalid log line */
+		if (!log_entry_attrs) {
+			Log(LogDebug, "LivestatusLogUtility")
+				<< "Skipping invalid log line: '" << line << "'.";
+			continue;
+		}
+
+		entries->emplace_back(lineno, log_entry_attrs);
+		lineno++;
+	}
+
+	if (complete)
+		AddCachedLogEntries(key, entries);
+
+	return entries;
+}
+
+typedef std::function<std::shared_ptr<LogCacheEntries> (const String&, const LogFileIndex&, size_t, std::ifstream&)> LogBlockFunction;
+
+static void ProcessLogFiles(const std::map<time_t, String>& index, HistoryTable *table,
+	time_t from, time_t until, const AddRowFunction& addRowFn, const LogBlockFunction& blockFn)
 {
 	ASSERT(table);
 
 	/* m_LogFileIndex map tells which log files are involved ordered by their start timestamp */
 	unsigned long line_count = 0;
 	for (const auto& kv : index) {
-		unsigned int ts = kv.first;
+		String log_file = kv.second;
+		LogFileIndex info;
+
+		{
+			boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+			auto it = l_LogIndex.find(log_file);
+
+			if (it == l_LogIndex.end())
+				continue;
+
+			info = it->second;
+		}
 
 		/* skip log files not in range (performance optimization) */
-		if (ts < from || ts > until)
+		if (info.End < from || info.Start > until)
 			continue;
 
-		String log_file = index[ts];
-		int lineno = 0;
+		/* seek to the last checkpoint before which all lines are older than the time window */
+		size_t block = 0;
+
+		while (block + 1 < info.Checkpoints.size() && info.Checkpoints[block + 1].MaxTimeBefore < from)
+			block++;
 
 		std::ifstream fp;
 		fp.exceptions(std::ifstream::badbit);
-		fp.open(log_file.CStr(), std::ifstream::in);
+		fp.open(log_file.CStr(), std::ifstream::in | std::ifstream::binary);
 
-		while (fp.good()) {
-			std::string line;
-			std::getline(fp, line);
+		for (; block < info.Checkpoints.size(); block++) {
+			std::shared_ptr<LogCacheEntries> entries = blockFn(log_file, info, block, fp);
 
-			if (line.empty())
-				continue; /* Ignore empty lines */
+			for (const auto& entry : *entries) {
+				table->UpdateLogEntries(entry.second, line_count, entry.first, addRowFn);
+				line_count++;
+			}
+		}
 
-			Dictionary::Ptr log_entry_attrs = LivestatusLogUtility::GetAttributes(line);
+		fp.close();
+	}
+}
 
-			/* no attributes available - invalid log line */
-			if (!log_entry_attrs) {
-				Log(LogDebug, "LivestatusLogUtility")
-					<< "Skipping invalid log line: '" << line << "'.";
-				continue;
-			}
+void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, HistoryTable *table,
+	time_t from, time_t until, const AddRowFunction& addRowFn)
+{
+	ProcessLogFiles(index, table, from, until, addRowFn, &GetLogBlockEntries);
+}
+
+/**
+ * Returns the entries of a block which can change the state history: state
+ * changes, flapping and downtime alerts as well as the first entry for each
+ * checkable (which sets its initial state).
+ */
+static std::shared_ptr<LogCacheEntries> FilterStateHistEntries(const LogCacheEntries& entries)
+{
+	auto result = std::make_shared<LogCacheEntries>();
+	std::set<String> seen;
 
-			table->UpdateLogEntries(log_entry_attrs, line_count, lineno, addRowFn);
+	for (const auto& entry : entries) {
+		const Dictionary::Ptr& attrs = entry.second;
+		String host_name = attrs->Get("host_name");
 
-			line_count++;
-			lineno++;
+		if (host_name.IsEmpty())
+			continue;
+
+		int log_type = attrs->Get("log_type");
+		bool first = seen.insert(host_name + "!" + attrs->Get("service_description")).second;
+
+		switch (log_type) {
+			case LogEntryTypeHostAlert:
+			case LogEntryTypeHostInitialState:
+			case LogEntryTypeHostCurrentState:
+			case LogEntryTypeServiceAlert:
+			case LogEntryTypeServiceInitialState:
+			case LogEntryTypeServiceCurrentState:
+			case LogEntryTypeHostFlapping:
+			case LogEntryTypeServiceFlapping:
+			case LogEntryTypeHostDowntimeAlert:
+			case LogEntryTypeServiceDowntimeAlert:
+				result->push_back(entry);
+				break;
+			default:
+				if (first)
+					result->push_back(entry);
+				break;
 		}
+	}
 
-		fp.close();
+	return result;
+}
+
+static String GetStateHistExtractPath(const String& path)
+{
+	return Application::GetLocalStateDir() + "/cache/icinga2/livestatus-statehist/" + Utility::BaseName(path) + ".json";
+}
+
+static bool IsArchivedLogFile(const String& path)
+{
+	return Utility::BaseName(path) != "icinga.log";
+}
+
+static std::shared_ptr<StateHistExtract> LoadStateHistExtract(const String& path, const LogFileIndex& info)
+{
+	String extractPath;
+
+	try {
+		extractPath = GetStateHistExtractPath(path);
+
+		if (!Utility::PathExists(extractPath))
+			return nullptr;
+
+		Dictionary::Ptr data = Utility::LoadJsonFile(extractPath);
+
+		if (data->Get("path") != path || data->Get("size") != info.Size || data->Get("mtime") != info.MTime)
+			return nullptr;
+
+		Array::Ptr blocks = data->Get("blocks");
+
+		if (blocks->GetLength() != info.Checkpoints.size())
+			return nullptr;
+
+		auto extract = std::make_shared<StateHistExtract>();
+		extract->Size = info.Size;
+		extract->MTime = info.MTime;
+
+		ObjectLock olock(blocks);
+		for (Array::Ptr block : blocks) {
+			auto entries = std::make_shared<LogCacheEntries>();
+
+			ObjectLock block_lock(block);
+			for (Array::Ptr entry : block)
+				entries->emplace_back(entry->Get(0), entry->Get(1));
+
+			extract->Blocks.push_back(entries);
+		}
+
+		return extract;
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "LivestatusLogUtility")
+			<< "Could not load state history extract '" << extractPath << "': " << DiagnosticInformation(ex, false);
+
+		return nullptr;
+	}
+}
+
+static void SaveStateHistExtract(const String& path, const StateHistExtract& extract)
+{
+	ArrayData blocks;
+
+	for (const auto& entries : extract.Blocks) {
+		ArrayData block;
+
+		for (const auto& entry : *entries)
+			block.emplace_back(new Array({ entry.first, entry.second }));
+
+		blocks.emplace_back(new Array(std::move(block)));
+	}
+
+	String extractPath;
+
+	try {
+		extractPath = GetStateHistExtractPath(path);
+
+		Utility::MkDirP(Utility::DirName(extractPath), 0750);
+
+		Utility::SaveJsonFile(extractPath, 0644, new Dictionary({
+			{ "path", path },
+			{ "size", extract.Size },
+			{ "mtime", extract.MTime },
+			{ "blocks", new Array(std::move(blocks)) }
+		}));
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "LivestatusLogUtility")
+			<< "Could not save state history extract '" << extractPath << "': " << DiagnosticInformation(ex, false);
 	}
 }
 
+static std::shared_ptr<StateHistExtract> GetStateHistExtract(const String& path, const LogFileIndex& info, std::ifstream& fp)
+{
+	{
+		boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+		auto it = l_StateHistExtracts.find(path);
+
+		if (it != l_StateHistExtracts.end()) {
+			if (it->second->Size == info.Size && it->second->MTime == info.MTime) {
+				l_StateHistExtractsLru.remove(path);
+				l_StateHistExtractsLru.push_back(path);
+				return it->second;
+			}
+
+			l_StateHistExtracts.erase(it);
+			l_StateHistExtractsLru.remove(path);
+		}
+	}
+
+	std::shared_ptr<StateHistExtract> extract = LoadStateHistExtract(path, info);
+
+	if (!extract) {
+		Log(LogNotice, "LivestatusLogUtility")
+			<< "Creating state history extract for log file '" << path << "'.";
+
+		extract = std::make_shared<StateHistExtract>();
+		extract->Size = info.Size;
+		extract->MTime = info.MTime;
+
+		for (size_t block = 0; block < info.Checkpoints.size(); block++)
+			extract->Blocks.push_back(FilterStateHistEntries(*GetLogBlockEntries(path, info, block, fp)));
+
+		SaveStateHistExtract(path, *extract);
+	}
+
+	boost::mutex::scoped_lock lock(l_LogIndexMutex);
+
+	if (l_StateHistExtracts.find(path) == l_StateHistExtracts.end())
+		l_StateHistExtractsLru.push_back(path);
+
+	l_StateHistExtracts[path] = extract;
+
+	while (l_StateHistExtractsLru.size() > STATEHIST_EXTRACT_MAX_FILES) {
+		l_StateHistExtracts.erase(l_StateHistExtractsLru.front());
+		l_StateHistExtractsLru.pop_front();
+	}
+
+	return extract;
+}
+
+static std::shared_ptr<LogCacheEntries> GetStateHistBlockEntries(const String& path, const LogFileIndex& info, size_t block, std::ifstream& fp)
+{
+	/* only archived log files don't change any more */
+	if (!IsArchivedLogFile(path))
+		return FilterStateHistEntries(*GetLogBlockEntries(path, info, block, fp));
+
+	return GetStateHistExtract(path, info, fp)->Blocks[block];
+}
+
+/**
+ * Like CreateLogCache() but only passes the entries which can change the
+ * state history to the table. For archived log files these entries are
+ * extracted once and persisted.
+ */
+void LivestatusLogUtility::CreateStateHistCache(std::map<time_t, String> index, HistoryTable *table,
+	time_t from, time_t until, const AddRowFunction& addRowFn)
+{
+	ProcessLogFiles(index, table, from, until, addRowFn, &GetStateHistBlockEntries);
+}
+
 Dictionary::Ptr LivestatusLogUtility::GetAttributes(const String& text)
 {
 	Dictionary::Ptr bag = new Dictionary();
@@ -43,14 +43,20 @@
 #include "base/initialize.hpp"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
+#include <cmath>
+#include <cstring>
 
 using namespace icinga;
 
+/* Result sets are written to the client in pieces of this size unless a fixed16
+ * response header requires the length of the complete response. */
+#define LIVESTATUS_OUTPUT_CHUNK_SIZE (64 * 1024)
+
 static int l_ExternalCommands = 0;
 static boost::mutex l_QueryMutex;
 
 LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path)
-	: m_KeepAlive(false), m_OutputFormat("csv"), m_ColumnHeaders(true), m_Limit(-1), m_ErrorCode(0),
+	: m_KeepAlive(false), m_OutputFormat("csv"), m_ColumnHeaders(true), m_Limit(-1), m_ResponseCode(LivestatusErrorOK), m_RowsScanned(0), m_RowsReturned(0), m_ErrorCode(0),
 	m_LogTimeFrom(0), m_LogTimeUntil(static_cast<long>(Utility::GetTime()))
 {
 	if (lines.size() == 0) {
@@ -275,6 +281,43 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 	m_Aggregators.swap(aggregators);
 }
 
+String LivestatusQuery::GetTable() const
+{
+	return m_Table;
+}
+
+bool LivestatusQuery::GetKeepAlive() const
+{
+	return m_KeepAlive;
+}
+
+String LivestatusQuery::GetOutputFormat() const
+{
+	return m_OutputFormat;
+}
+
+/**
+ * Returns the status code of the response which was sent to the client.
+ */
+int LivestatusQuery::GetResponseCode() const
+{
+	return m_ResponseCode;
+}
+
+/**
+ * Returns the number of rows which were passed to the filter by the last
+ * GET query.
+ */
+size_t LivestatusQuery::GetRowsScanned() const
+{
+	return m_RowsScanned;
+}
+
+size_t LivestatusQuery::GetRowsReturned() const
+{
+	return m_RowsReturned;
+}
+
 int LivestatusQuery::GetExternalCommands()
 {
 	boost::mutex::scoped_lock lock(l_QueryMutex);
@@ -357,53 +400,244 @@ Filter::Ptr LivestatusQuery::ParseFilter(const String& params, unsigned long& fr
 	return filter;
 }
 
-void LivestatusQuery::BeginResultSet(std::ostream& fp) const
+static void AppendInteger(std::string& fp, long long value)
+{
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	char *p = end;
+
+	unsigned long long uvalue = (value < 0) ? -static_cast<unsigned long long>(value) : value;
+
+	do {
+		*--p = '0' + uvalue % 10;
+		uvalue /= 10;
+	} while (uvalue > 0);
+
+	if (value < 0)
+		*--p = '-';
+
+	fp.append(p, end);
+}
+
+/* Same format as Convert::ToString(double). */
+static void AppendNumber(std::string& fp, double value)
+{
+	double integral;
+
+	if (std::modf(value, &integral) == 0) {
+		AppendInteger(fp, static_cast<long long>(value));
+		return;
+	}
+
+	char buf[512];
+	int len = snprintf(buf, sizeof(buf), "%f", value);
+	fp.append(buf, len);
+}
+
+/* Same format as writing the value to a std::ostream. */
+static void AppendValue(std::string& fp, const Value& value)
+{
+	switch (value.GetType()) {
+		case ValueNumber:
+			AppendNumber(fp, value.Get<double>());
+			break;
+		case ValueBoolean:
+			fp += value.Get<bool>() ? '1' : '0';
+			break;
+		case ValueString:
+			fp += value.Get<String>().GetData();
+			break;
+		case ValueEmpty:
+			break;
+		default:
+			fp += static_cast<String>(value).GetData();
+			break;
+	}
+}
+
+/* Same format as yajl's generator. */
+static void AppendJsonNumber(std::string& fp, double value)
+{
+	if (std::isnan(value) || std::isinf(value))
+		value = 0;
+
+	char buf[32];
+	int len = snprintf(buf, sizeof(buf), "%.20g", value);
+	fp.append(buf, len);
+
+	if (strspn(buf, "0123456789-") == static_cast<size_t>(len))
+		fp += ".0";
+}
+
+static void AppendJsonString(std::string& fp, const String& str)
+{
+	static const char hexchars[] = "0123456789ABCDEF";
+
+	const char *data = str.CStr();
+	size_t len = str.GetLength();
+	size_t begin = 0;
+
+	fp += '"';
+
+	for (size_t i = 0; i < len; i++) {
+		unsigned char ch = data[i];
+
+		if (ch >= 32 && ch != '"' && ch != '\\')
+			continue;
+
+		fp.append(data + begin, i - begin);
+		begin = i + 1;
+
+		switch (ch) {
+			case '"': fp += "\\\""; break;
+			case '\\': fp += "\\\\"; break;
+			case '\r': fp += "\\r"; break;
+			case '\n': fp += "\\n"; break;
+			case '\f': fp += "\\f"; break;
+			case '\b': fp += "\\b"; break;
+			case '\t': fp += "\\t"; break;
+			default:
+				fp += "\\u00";
+				fp += hexchars[ch >> 4];
+				fp += hexchars[ch & 0x0F];
+				break;
+		}
+	}
+
+	fp.append(data + begin, len - begin);
+	fp += '"';
+}
+
+static void AppendJsonValue(std::string& fp, const Value& value)
+{
+	switch (value.GetType()) {
+		case ValueNumber:
+			AppendJsonNumber(fp, value.Get<double>());
+			return;
+		case ValueBoolean:
+			fp += value.Get<bool>() ? "true" : "false";
+			return;
+		case ValueString:
+			AppendJsonString(fp, value.Get<String>());
+			return;
+		case ValueObject:
+			break;
+		default:
+			fp += "null";
+			return;
+	}
+
+	const Object::Ptr& obj = value.Get<Object::Ptr>();
+
+	Array::Ptr arr = dynamic_pointer_cast<Array>(obj);
+
+	if (arr) {
+		fp += '[';
+
+		bool first = true;
+
+		ObjectLock olock(arr);
+		for (const Value& item : arr) {
+			if (first)
+				first = false;
+			else
+				fp += ',';
+
+			AppendJsonValue(fp, item);
+		}
+
+		fp += ']';
+		return;
+	}
+
+	Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(obj);
+
+	if (dict) {
+		fp += '{';
+
+		bool first = true;
+
+		ObjectLock olock(dict);
+		for (const Dictionary::Pair& kv : dict) {
+			if (first)
+				first = false;
+			else
+				fp += ',';
+
+			AppendJsonString(fp, kv.first);
+			fp += ':';
+			AppendJsonValue(fp, kv.second);
+		}
+
+		fp += '}';
+		return;
+	}
+
+	fp += "null";
+}
+
+void LivestatusQuery::BeginResultSet(std::string& fp) const
 {
 	if (m_OutputFormat == "json" || m_OutputFormat == "python")
-		fp << "[";
+		fp += '[';
 }
 
-void LivestatusQuery::EndResultSet(std::ostream& fp) const
+void LivestatusQuery::EndResultSet(std::string& fp) const
 {
 	if (m_OutputFormat == "json" || m_OutputFormat == "python")
-		fp << "]";
+		fp += ']';
 }
 
-void LivestatusQuery::AppendResultRow(std::ostream& fp, const Array::Ptr& row, bool& first_row) const
+/**
+ * Formats a result row directly into the output buffer.
+ */
+void LivestatusQuery::AppendResultRow(std::string& fp, const ArrayData& row, bool& first_row) const
 {
 	if (m_OutputFormat == "csv") {
 		bool first = true;
 
-		ObjectLock rlock(row);
 		for (const Value& value : row) {
 			if (first)
 				first = false;
 			else
-				fp << m_Separators[1];
+				fp += m_Separators[1].GetData();
 
 			if (value.IsObjectType<Array>())
 				PrintCsvArray(fp, value, 0);
 			else
-				fp << value;
+				AppendValue(fp, value);
 		}
 
-		fp << m_Separators[0];
+		fp += m_Separators[0].GetData();
 	} else if (m_OutputFormat == "json") {
 		if (!first_row)
-			fp << ", ";
+			fp += ", ";
 
-		fp << JsonEncode(row);
+		fp += '[';
+
+		bool first = true;
+
+		for (const Value& value : row) {
+			if (first)
+				first = false;
+			else
+				fp += ',';
+
+			AppendJsonValue(fp, value);
+		}
+
+		fp += ']';
 	} else if (m_OutputFormat == "python") {
 		if (!first_row)
-			fp << ", ";
+			fp += ", ";
 
-		PrintPythonArray(fp, row);
+		PrintPythonArray(fp, row.begin(), row.end());
 	}
 
 	first_row = false;
 }
 
-void LivestatusQuery::PrintCsvArray(std::ostream& fp, const Array::Ptr& array, int level) const
+void LivestatusQuery::PrintCsvArray(std::string& fp, const Array::Ptr& array, int level) const
 {
 	bool first = true;
 
@@ -412,44 +646,51 @@ void LivestatusQuery::PrintCsvArray(std::ostream& fp, const Array::Ptr& array, i
 		if (first)
 			first = false;
 		else
-			fp << ((level == 0) ? m_Separators[2] : m_Separators[3]);
+			fp += ((level == 0) ? m_Separators[2] : m_Separators[3]).GetData();
 
 		if (value.IsObjectType<Array>())
 			PrintCsvArray(fp, value, level + 1);
-		else if (value.IsBoolean())
-			fp << Convert::ToLong(value);
 		else
-			fp << value;
+			AppendValue(fp, value);
 	}
 }
 
-void LivestatusQuery::PrintPythonArray(std::ostream& fp, const Array::Ptr& rs) const
+void LivestatusQuery::PrintPythonArray(std::string& fp, ArrayData::const_iterator begin, ArrayData::const_iterator end) const
 {
-	fp << "[ ";
+	fp += "[ ";
 
-	bool first = true;
+	for (auto it = begin; it != end; it++) {
+		const Value& value = *it;
 
-	for (const Value& value : rs) {
-		if (first)
-			first = false;
-		else
-			fp << ", ";
+		if (it != begin)
+			fp += ", ";
 
-		if (value.IsObjectType<Array>())
-			PrintPythonArray(fp, value);
-		else if (value.IsNumber())
-			fp << value;
+		if (value.IsObjectType<Array>()) {
+			Array::Ptr array = value;
+
+			ObjectLock olock(array);
+			PrintPythonArray(fp, array->Begin(), array->End());
+		} else if (value.IsNumber())
+			AppendNumber(fp, value.Get<double>());
 		else
-			fp << QuoteStringPython(value);
+			AppendPythonString(fp, value);
 	}
 
-	fp << " ]";
+	fp += " ]";
 }
 
-String LivestatusQuery::QuoteStringPython(const String& str) {
-	String result = str;
-	boost::algorithm::replace_all(result, "\"", "\\\"");
-	return "r\"" + result + "\"";
+void LivestatusQuery::AppendPythonString(std::string& fp, const String& str)
+{
+	fp += "r\"";
+
+	for (char ch : str.GetData()) {
+		if (ch == '"')
+			fp += "\\\"";
+		else
+			fp += ch;
+	}
+
+	fp += '"';
 }
 
 void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
@@ -465,7 +706,7 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 		return;
 	}
 
-	std::vector<LivestatusRowValue> objects = table->FilterRows(m_Filter, m_Limit);
+	std::vector<LivestatusRowValue> objects = table->FilterRows(m_Filter, m_Limit, &m_RowsScanned);
 	std::vector<String> columns;
 
 	if (m_Columns.size() > 0)
@@ -473,7 +714,7 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 	else
 		columns = table->GetColumnNames();
 
-	std::ostringstream result;
+	std::string result;
 	bool first_row = true;
 	BeginResultSet(result);
 
@@ -486,27 +727,31 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 		for (const String& columnName : columns)
 			column_objs.emplace_back(columnName, table->GetColumn(columnName));
 
-		ArrayData header;
+		ArrayData row;
+		row.reserve(column_objs.size());
 
 		for (const LivestatusRowValue& object : objects) {
-			ArrayData row;
+			if (m_ColumnHeaders) {
+				for (const ColumnPair& cv : column_objs)
+					row.emplace_back(cv.first);
 
-			row.reserve(column_objs.size());
+				AppendResultRow(result, row, first_row);
+				m_ColumnHeaders = false;
 
-			for (const ColumnPair& cv : column_objs) {
-				if (m_ColumnHeaders)
-					header.push_back(cv.first);
+				row.clear();
+			}
 
+			for (const ColumnPair& cv : column_objs)
 				row.push_back(cv.second.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
 
-			if (m_ColumnHeaders) {
-				AppendResultRow(result, new Array(std::move(header)), first_row);
-				m_ColumnHeaders = false;
-			}
+			AppendResultRow(result, row, first_row);
+
+			row.clear();
 
-			AppendResultRow(result, new Array(std::move(row)), first_row);
+			FlushResultSet(stream, result, false);
 		}
+
+		m_RowsReturned = objects.size();
 	} else {
 		std::map<std::vector<Value>, std::vector<AggregatorState *> > allStats;
 
@@ -548,7 +793,7 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 				header.push_back("stats_" + Convert::ToString(i));
 			}
 
-			AppendResultRow(result, new Array(std::move(header)), first_row);
+			AppendResultRow(result, header, first_row);
 		}
 
 		for (const auto& kv : allStats) {
@@ -565,9 +810,13 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 			for (size_t i = 0; i < m_Aggregators.size(); i++)
 				row.push_back(m_Aggregators[i]->GetResultAndFreeState(stats[i]));
 
-			AppendResultRow(result, new Array(std::move(row)), first_row);
+			AppendResultRow(result, row, first_row);
+
+			FlushResultSet(stream, result, false);
 		}
 
+		m_RowsReturned = allStats.size();
+
 		/* add a bogus zero value if aggregated is empty*/
 		if (allStats.empty()) {
 			ArrayData row;
@@ -578,13 +827,44 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 				row.push_back(0);
 			}
 
-			AppendResultRow(result, new Array(std::move(row)), first_row);
+			AppendResultRow(result, row, first_row);
 		}
 	}
 
 	EndResultSet(result);
 
-	SendResponse(stream, LivestatusErrorOK, result.str());
+	if (m_ResponseHeader == "fixed16") {
+		SendResponse(stream, LivestatusErrorOK, result);
+		return;
+	}
+
+	FlushResultSet(stream, result, true);
+
+	/* an empty chunk marks the end of the response */
+	if (m_ResponseHeader == "chunked")
+		PrintFixed16(stream, LivestatusErrorOK, "");
+}
+
+/**
+ * Writes the buffered part of a result set to the client once it has grown
+ * large enough. Responses with a fixed16 header are sent as a whole.
+ */
+void LivestatusQuery::FlushResultSet(const Stream::Ptr& stream, std::string& result, bool force)
+{
+	if (m_ResponseHeader == "fixed16")
+		return;
+
+	if (!force && result.size() < LIVESTATUS_OUTPUT_CHUNK_SIZE)
+		return;
+
+	if (result.empty())
+		return;
+
+	if (m_ResponseHeader == "chunked")
+		PrintFixed16(stream, LivestatusErrorOK, result);
+
+	stream->Write(result.c_str(), result.size());
+	result.clear();
 }
 
 void LivestatusQuery::ExecuteCommandHelper(const Stream::Ptr& stream)
@@ -610,10 +890,14 @@ void LivestatusQuery::ExecuteErrorHelper(const Stream::Ptr& stream)
 
 void LivestatusQuery::SendResponse(const Stream::Ptr& stream, int code, const String& data)
 {
-	if (m_ResponseHeader == "fixed16")
+	bool header = (m_ResponseHeader == "fixed16" || m_ResponseHeader == "chunked");
+
+	m_ResponseCode = code;
+
+	if (header)
 		PrintFixed16(stream, code, data);
 
-	if (m_ResponseHeader == "fixed16" || code == LivestatusErrorOK) {
+	if (header || code == LivestatusErrorOK) {
 		try {
 			stream->Write(data.CStr(), data.GetLength());
 		} catch (const std::exception&) {
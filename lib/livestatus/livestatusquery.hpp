@@ -52,6 +52,13 @@ public:
 
 	bool Execute(const Stream::Ptr& stream);
 
+	String GetTable() const;
+	bool GetKeepAlive() const;
+	String GetOutputFormat() const;
+	int GetResponseCode() const;
+	size_t GetRowsScanned() const;
+	size_t GetRowsReturned() const;
+
 	static int GetExternalCommands();
 
 private:
@@ -72,6 +79,10 @@ private:
 	int m_Limit;
 
 	String m_ResponseHeader;
+	int m_ResponseCode;
+
+	size_t m_RowsScanned;
+	size_t m_RowsReturned;
 
 	/* Parameters for COMMAND/SCRIPT queries. */
 	String m_Command;
@@ -85,17 +96,18 @@ private:
 	unsigned long m_LogTimeUntil;
 	String m_CompatLogPath;
 
-	void BeginResultSet(std::ostream& fp) const;
-	void EndResultSet(std::ostream& fp) const;
-	void AppendResultRow(std::ostream& fp, const Array::Ptr& row, bool& first_row) const;
-	void PrintCsvArray(std::ostream& fp, const Array::Ptr& array, int level) const;
-	void PrintPythonArray(std::ostream& fp, const Array::Ptr& array) const;
-	static String QuoteStringPython(const String& str);
+	void BeginResultSet(std::string& fp) const;
+	void EndResultSet(std::string& fp) const;
+	void AppendResultRow(std::string& fp, const ArrayData& row, bool& first_row) const;
+	void PrintCsvArray(std::string& fp, const Array::Ptr& array, int level) const;
+	void PrintPythonArray(std::string& fp, ArrayData::const_iterator begin, ArrayData::const_iterator end) const;
+	static void AppendPythonString(std::string& fp, const String& str);
 
 	void ExecuteGetHelper(const Stream::Ptr& stream);
 	void ExecuteCommandHelper(const Stream::Ptr& stream);
 	void ExecuteErrorHelper(const Stream::Ptr& stream);
 
+	void FlushResultSet(const Stream::Ptr& stream, std::string& result, bool force);
 	void SendResponse(const Stream::Ptr& stream, int code, const String& data);
 	void PrintFixed16(const Stream::Ptr& stream, int code, const String& data);
 
@@ -0,0 +1,232 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "livestatus/livestatusquerycache.hpp"
+#include "icinga/checkable.hpp"
+#include "icinga/downtime.hpp"
+#include "icinga/comment.hpp"
+#include "base/utility.hpp"
+
+using namespace icinga;
+
+#define LIVESTATUS_QUERY_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+static boost::mutex l_StartMutex;
+static bool l_Started = false;
+static std::atomic<uint_fast64_t> l_Generation{0};
+
+LivestatusQueryCache::LivestatusQueryCache()
+{
+	Start();
+}
+
+void LivestatusQueryCache::Start()
+{
+	boost::mutex::scoped_lock lock(l_StartMutex);
+
+	if (l_Started)
+		return;
+
+	Checkable::OnNewCheckResult.connect(std::bind(&LivestatusQueryCache::InvalidateHandler), "LivestatusQueryCache::InvalidateHandler");
+	Checkable::OnStateChange.connect(std::bind(&LivestatusQueryCache::InvalidateHandler), "LivestatusQueryCache::InvalidateHandler");
+	Checkable::OnAcknowledgementSet.connect(std::bind(&LivestatusQueryCache::InvalidateHandler));
+	Checkable::OnAcknowledgementCleared.connect(std::bind(&LivestatusQueryCache::InvalidateHandler));
+	Downtime::OnDowntimeAdded.connect(std::bind(&LivestatusQueryCache::InvalidateHandler));
+	Downtime::OnDowntimeRemoved.connect(std::bind(&LivestatusQueryCache::InvalidateHandler));
+	Downtime::OnDowntimeTriggered.connect(std::bind(&LivestatusQueryCache::InvalidateHandler));
+	Comment::OnCommentAdded.connect(std::bind(&LivestatusQueryCache::InvalidateHandler));
+	Comment::OnCommentRemoved.connect(std::bind(&LivestatusQueryCache::InvalidateHandler));
+	ConfigObject::OnActiveChanged.connect(std::bind(&LivestatusQueryCache::InvalidateHandler));
+
+	l_Started = true;
+}
+
+void LivestatusQueryCache::InvalidateHandler()
+{
+	l_Generation++;
+}
+
+uint_fast64_t LivestatusQueryCache::GetGeneration()
+{
+	return l_Generation.load();
+}
+
+/**
+ * Responses larger than this are sent to the client but not cached.
+ */
+size_t LivestatusQueryCache::GetMaxResponseSize()
+{
+	return LIVESTATUS_QUERY_CACHE_MAX_SIZE / 4;
+}
+
+/**
+ * Returns the cache key for a query, or an empty string if the query's
+ * response must not be cached. Headers are normalized the way the query
+ * parser reads them and the KeepAlive header is ignored because it
+ * doesn't change the response.
+ */
+String LivestatusQueryCache::GetQueryKey(const std::vector<String>& lines)
+{
+	if (lines.empty() || lines[0].SubStr(0, 4) != "GET ")
+		return String();
+
+	String key = lines[0];
+
+	for (std::vector<String>::size_type i = 1; i < lines.size(); i++) {
+		const String& line = lines[i];
+
+		size_t col_index = line.FindFirstOf(":");
+		String header = line.SubStr(0, col_index);
+		String params;
+
+		if (line.GetLength() > col_index + 1)
+			params = line.SubStr(col_index + 1).Trim();
+
+		if (header == "KeepAlive")
+			continue;
+
+		key += "\n" + header + ": " + params;
+	}
+
+	return key;
+}
+
+bool LivestatusQueryCache::GetResponse(const String& key, double maxAge, String& response)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	auto it = m_Entries.find(key);
+
+	if (it == m_Entries.end()) {
+		m_Misses++;
+		return false;
+	}
+
+	if (it->second.Generation != GetGeneration() || it->second.Timestamp < Utility::GetTime() - maxAge) {
+		RemoveEntry(it);
+		m_Misses++;
+		return false;
+	}
+
+	m_Lru.splice(m_Lru.end(), m_Lru, it->second.LruPosition);
+
+	response = it->second.Response;
+	m_Hits++;
+	return true;
+}
+
+/**
+ * Stores the response of a query. The generation must have been retrieved
+ * before the query was executed so that changes which happened while the
+ * query was running invalidate the response.
+ */
+void LivestatusQueryCache::AddResponse(const String& key, uint_fast64_t generation, const String& response)
+{
+	if (response.GetLength() > GetMaxResponseSize())
+		return;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	auto it = m_Entries.find(key);
+
+	if (it != m_Entries.end())
+		RemoveEntry(it);
+
+	while (!m_Lru.empty() && m_Size + response.GetLength() > LIVESTATUS_QUERY_CACHE_MAX_SIZE)
+		RemoveEntry(m_Entries.find(m_Lru.front()));
+
+	CacheEntry& entry = m_Entries[key];
+	entry.Generation = generation;
+	entry.Timestamp = Utility::GetTime();
+	entry.Response = response;
+	entry.LruPosition = m_Lru.insert(m_Lru.end(), key);
+
+	m_Size += response.GetLength();
+}
+
+void LivestatusQueryCache::RemoveEntry(std::map<String, CacheEntry>::iterator it)
+{
+	m_Size -= it->second.Response.GetLength();
+	m_Lru.erase(it->second.LruPosition);
+	m_Entries.erase(it);
+}
+
+uint_fast64_t LivestatusQueryCache::GetHits() const
+{
+	return m_Hits.load();
+}
+
+uint_fast64_t LivestatusQueryCache::GetMisses() const
+{
+	return m_Misses.load();
+}
+
+LivestatusCaptureStream::LivestatusCaptureStream(const Stream::Ptr& stream, size_t maxSize)
+	: m_Stream(stream), m_MaxSize(maxSize)
+{ }
+
+size_t LivestatusCaptureStream::Read(void *buffer, size_t count, bool allow_partial)
+{
+	return m_Stream->Read(buffer, count, allow_partial);
+}
+
+void LivestatusCaptureStream::Write(const void *buffer, size_t count)
+{
+	try {
+		m_Stream->Write(buffer, count);
+	} catch (...) {
+		m_Complete = false;
+		throw;
+	}
+
+	if (!m_Complete)
+		return;
+
+	if (m_Data.GetLength() + count > m_MaxSize) {
+		m_Complete = false;
+		m_Data = String();
+		return;
+	}
+
+	m_Data += String(static_cast<const char *>(buffer), static_cast<const char *>(buffer) + count);
+}
+
+void LivestatusCaptureStream::Close()
+{
+	m_Stream->Close();
+}
+
+bool LivestatusCaptureStream::IsEof() const
+{
+	return m_Stream->IsEof();
+}
+
+/**
+ * Returns whether the whole response was written to the client and
+ * retained in the buffer.
+ */
+bool LivestatusCaptureStream::IsComplete() const
+{
+	return m_Complete;
+}
+
+String LivestatusCaptureStream::GetData() const
+{
+	return m_Data;
+}
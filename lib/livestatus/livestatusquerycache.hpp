@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef LIVESTATUSQUERYCACHE_H
+#define LIVESTATUSQUERYCACHE_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/stream.hpp"
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <list>
+#include <map>
+
+using namespace icinga;
+
+namespace icinga
+{
+
+/**
+ * Responses of recently executed GET queries. Entries are keyed by the
+ * normalized query text including the AuthUser header. They are discarded
+ * as soon as a check result, acknowledgement, downtime, comment or object
+ * changes and once they are older than the listener's maximum age.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusQueryCache
+{
+public:
+	LivestatusQueryCache();
+
+	static void Start();
+
+	static String GetQueryKey(const std::vector<String>& lines);
+	static uint_fast64_t GetGeneration();
+	static size_t GetMaxResponseSize();
+
+	bool GetResponse(const String& key, double maxAge, String& response);
+	void AddResponse(const String& key, uint_fast64_t generation, const String& response);
+
+	uint_fast64_t GetHits() const;
+	uint_fast64_t GetMisses() const;
+
+private:
+	struct CacheEntry
+	{
+		uint_fast64_t Generation;
+		double Timestamp;
+		String Response;
+		std::list<String>::iterator LruPosition;
+	};
+
+	boost::mutex m_Mutex;
+	std::map<String, CacheEntry> m_Entries;
+	std::list<String> m_Lru;
+	size_t m_Size{0};
+
+	std::atomic<uint_fast64_t> m_Hits{0};
+	std::atomic<uint_fast64_t> m_Misses{0};
+
+	void RemoveEntry(std::map<String, CacheEntry>::iterator it);
+
+	static void InvalidateHandler();
+};
+
+/**
+ * Passes a query response through to the client and keeps a copy of it
+ * for the query cache.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusCaptureStream final : public Stream
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusCaptureStream);
+
+	LivestatusCaptureStream(const Stream::Ptr& stream, size_t maxSize);
+
+	size_t Read(void *buffer, size_t count, bool allow_partial = false) override;
+	void Write(const void *buffer, size_t count) override;
+	void Close() override;
+	bool IsEof() const override;
+
+	bool IsComplete() const;
+	String GetData() const;
+
+private:
+	Stream::Ptr m_Stream;
+	size_t m_MaxSize;
+	bool m_Complete{true};
+	String m_Data;
+};
+
+}
+
+#endif /* LIVESTATUSQUERYCACHE_H */
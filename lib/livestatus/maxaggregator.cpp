@@ -35,9 +35,7 @@ MaxAggregatorState *MaxAggregator::EnsureState(AggregatorState **state)
 
 void MaxAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_MaxAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetRowValue(m_MaxAttr, row);
 
 	MaxAggregatorState *pstate = EnsureState(state);
 
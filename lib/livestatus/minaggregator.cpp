@@ -35,9 +35,7 @@ MinAggregatorState *MinAggregator::EnsureState(AggregatorState **state)
 
 void MinAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_MinAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetRowValue(m_MinAttr, row);
 
 	MinAggregatorState *pstate = EnsureState(state);
 
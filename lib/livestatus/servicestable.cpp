@@ -22,6 +22,7 @@
 #include "livestatus/servicegroupstable.hpp"
 #include "livestatus/hostgroupstable.hpp"
 #include "livestatus/endpointstable.hpp"
+#include "livestatus/checkablestatecache.hpp"
 #include "icinga/service.hpp"
 #include "icinga/servicegroup.hpp"
 #include "icinga/hostgroup.hpp"
@@ -188,13 +189,39 @@ void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 			}
 		}
 	} else {
-		for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
+		for (Service *service : ConfigType::GetObjectRange<Service>()) {
 			if (!addRowFn(service, LivestatusGroupByNone, Empty))
 				return;
 		}
 	}
 }
 
+bool ServicesTable::FetchIndexedRows(const LivestatusIndexPredicate& predicate, const AddRowFunction& addRowFn)
+{
+	if (GetGroupByType() != LivestatusGroupByNone)
+		return false;
+
+	FilterPredicate fp;
+	fp.Values.insert(predicate.Operand);
+
+	if (predicate.Column == "host_name" && predicate.Operator == "=") {
+		fp.Variable = "service";
+		fp.Path.emplace_back("host_name");
+		fp.Membership = false;
+	} else if (predicate.Column == "groups" && predicate.Operator == ">=") {
+		fp.Variable = "service";
+		fp.Path.emplace_back("groups");
+		fp.Membership = true;
+	} else if (predicate.Column == "host_groups" && predicate.Operator == ">=") {
+		fp.Variable = "host";
+		fp.Path.emplace_back("groups");
+		fp.Membership = true;
+	} else
+		return false;
+
+	return FetchPredicateRows("Service", fp, addRowFn);
+}
+
 Object::Ptr ServicesTable::HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor)
 {
 	Value service;
@@ -308,13 +335,7 @@ Value ServicesTable::PluginOutputAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	String output;
-	CheckResult::Ptr cr = service->GetLastCheckResult();
-
-	if (cr)
-		output = CompatUtility::GetCheckResultOutput(cr);
-
-	return output;
+	return CheckableStateCache::GetPluginOutput(service);
 }
 
 Value ServicesTable::LongPluginOutputAccessor(const Value& row)
@@ -346,7 +367,7 @@ Value ServicesTable::PerfDataAccessor(const Value& row)
 	if (!cr)
 		return Empty;
 
-	return PluginUtility::FormatPerfdata(cr->GetPerformanceData());
+	return cr->GetFormattedPerformanceData();
 }
 
 Value ServicesTable::CheckPeriodAccessor(const Value& row)
@@ -505,7 +526,7 @@ Value ServicesTable::StateAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	return service->GetState();
+	return CheckableStateCache::GetStateRaw(service);
 }
 
 Value ServicesTable::HasBeenCheckedAccessor(const Value& row)
@@ -515,7 +536,7 @@ Value ServicesTable::HasBeenCheckedAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	return Convert::ToLong(service->HasBeenChecked());
+	return Convert::ToLong(CheckableStateCache::HasBeenChecked(service));
 }
 
 Value ServicesTable::LastStateAccessor(const Value& row)
@@ -545,7 +566,7 @@ Value ServicesTable::StateTypeAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	return service->GetStateType();
+	return CheckableStateCache::GetStateType(service);
 }
 
 Value ServicesTable::CheckTypeAccessor(const Value& row)
@@ -565,8 +586,7 @@ Value ServicesTable::AcknowledgedAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	ObjectLock olock(service);
-	return service->IsAcknowledged();
+	return CheckableStateCache::IsAcknowledged(service);
 }
 
 Value ServicesTable::AcknowledgementTypeAccessor(const Value& row)
@@ -637,7 +657,7 @@ Value ServicesTable::LastCheckAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	return static_cast<int>(service->GetLastCheck());
+	return static_cast<int>(CheckableStateCache::GetLastCheck(service));
 }
 
 Value ServicesTable::NextCheckAccessor(const Value& row)
@@ -687,7 +707,7 @@ Value ServicesTable::LastStateChangeAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	return static_cast<int>(service->GetLastStateChange());
+	return static_cast<int>(CheckableStateCache::GetLastStateChange(service));
 }
 
 Value ServicesTable::LastHardStateChangeAccessor(const Value& row)
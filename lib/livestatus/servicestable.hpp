@@ -45,6 +45,7 @@ public:
 
 protected:
 	void FetchRows(const AddRowFunction& addRowFn) override;
+	bool FetchIndexedRows(const LivestatusIndexPredicate& predicate, const AddRowFunction& addRowFn) override;
 
 	static Object::Ptr HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor);
 	static Object::Ptr ServiceGroupAccessor(const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
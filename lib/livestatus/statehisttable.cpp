@@ -261,11 +261,12 @@ void StateHistTable::FetchRows(const AddRowFunction& addRowFn)
 	LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
 
 	/* generate log cache */
-	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+	LivestatusLogUtility::CreateStateHistCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
 
 	Checkable::Ptr checkable;
 
 	for (const auto& kv : m_CheckablesCache) {
+		ObjectLock olock(kv.second);
 		for (const Dictionary::Ptr& state_hist_bag : kv.second) {
 			/* pass a dictionary from state history array */
 			if (!addRowFn(state_hist_bag, LivestatusGroupByNone, Empty))
@@ -36,9 +36,7 @@ StdAggregatorState *StdAggregator::EnsureState(AggregatorState **state)
 
 void StdAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_StdAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetRowValue(m_StdAttr, row);
 
 	StdAggregatorState *pstate = EnsureState(state);
 
@@ -35,9 +35,7 @@ SumAggregatorState *SumAggregator::EnsureState(AggregatorState **state)
 
 void SumAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_SumAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetRowValue(m_SumAttr, row);
 
 	SumAggregatorState *pstate = EnsureState(state);
 
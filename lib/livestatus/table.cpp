@@ -113,6 +113,38 @@ Column Table::GetColumn(const String& name) const
 	return it->second;
 }
 
+/**
+ * Returns the value of a column for the specified row. The values of the
+ * most recently evaluated row are kept, so that the filters and aggregators
+ * of a query which refer to the same column only resolve it once per row.
+ */
+Value Table::GetRowValue(const String& name, const Value& row)
+{
+	if (!row.IsObject())
+		return GetColumn(name).ExtractValue(row);
+
+	Object::Ptr obj = row;
+
+	if (obj != m_CachedRow) {
+		m_CachedRow = obj;
+		m_CachedRowGeneration++;
+	}
+
+	auto it = m_ColumnValueCache.find(name);
+
+	if (it == m_ColumnValueCache.end())
+		it = m_ColumnValueCache.insert(std::make_pair(name, CachedColumnValue{ GetColumn(name), 0, Empty })).first;
+
+	CachedColumnValue& entry = it->second;
+
+	if (entry.Generation != m_CachedRowGeneration) {
+		entry.CachedValue = entry.ResolvedColumn.ExtractValue(row);
+		entry.Generation = m_CachedRowGeneration;
+	}
+
+	return entry.CachedValue;
+}
+
 std::vector<String> Table::GetColumnNames() const
 {
 	std::vector<String> names;
@@ -124,20 +156,88 @@ std::vector<String> Table::GetColumnNames() const
 	return names;
 }
 
-std::vector<LivestatusRowValue> Table::FilterRows(const Filter::Ptr& filter, int limit)
+std::vector<LivestatusRowValue> Table::FilterRows(const Filter::Ptr& filter, int limit, size_t *rowsScanned)
 {
 	std::vector<LivestatusRowValue> rs;
+	size_t scanned = 0;
+
+	AddRowFunction addRowFn = std::bind(&Table::FilteredAddRow, this, std::ref(rs), std::ref(scanned), filter, limit, _1, _2, _3);
+
+	bool indexed = false;
+
+	if (filter) {
+		std::vector<LivestatusIndexPredicate> predicates;
+		filter->GetIndexPredicates(predicates);
+
+		/* the filter is still applied to each row, the index only narrows down the candidates */
+		for (const LivestatusIndexPredicate& predicate : predicates) {
+			if (FetchIndexedRows(predicate, addRowFn)) {
+				indexed = true;
+				break;
+			}
+		}
+	}
+
+	if (!indexed)
+		FetchRows(addRowFn);
 
-	FetchRows(std::bind(&Table::FilteredAddRow, this, std::ref(rs), filter, limit, _1, _2, _3));
+	if (rowsScanned)
+		*rowsScanned = scanned;
 
 	return rs;
 }
 
-bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
+/**
+ * Fetches only the rows which can satisfy the specified predicate by looking
+ * them up directly instead of visiting all objects.
+ *
+ * @returns true if the table has an index for the predicate's column, false otherwise.
+ */
+bool Table::FetchIndexedRows(const LivestatusIndexPredicate&, const AddRowFunction&)
+{
+	return false;
+}
+
+/**
+ * Adds the rows which can match a filter predicate on the config objects
+ * of a type. The objects are looked up through the same indexes which are
+ * used for filters in API queries.
+ *
+ * @returns false if the predicate can't be looked up.
+ */
+bool Table::FetchPredicateRows(const String& type, const FilterPredicate& predicate, const AddRowFunction& addRowFn)
+{
+	Type::Ptr ptype = Type::GetByName(type);
+
+	if (!ptype)
+		return false;
+
+	std::set<ConfigObject::Ptr> objects;
+
+	if (!FilterUtility::GetPredicateTargets(ptype, type.ToLower(), predicate, objects))
+		return false;
+
+	std::vector<ConfigObject::Ptr> rows(objects.begin(), objects.end());
+
+	std::sort(rows.begin(), rows.end(), [](const ConfigObject::Ptr& a, const ConfigObject::Ptr& b) {
+		return a->GetName() < b->GetName();
+	});
+
+	for (const ConfigObject::Ptr& row : rows) {
+		if (!addRowFn(row, LivestatusGroupByNone, Empty))
+			break;
+	}
+
+	return true;
+}
+
+bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, size_t& rowsScanned, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	if (limit != -1 && static_cast<int>(rs.size()) == limit)
 		return false;
 
+	rowsScanned++;
+
 	if (!filter || filter->Apply(this, row)) {
 		LivestatusRowValue rval;
 		rval.Row = row;
@@ -21,6 +21,7 @@
 #define TABLE_H
 
 #include "livestatus/column.hpp"
+#include "remote/filterutility.hpp"
 #include "base/object.hpp"
 #include "base/dictionary.hpp"
 #include "base/array.hpp"
@@ -37,6 +38,17 @@ struct LivestatusRowValue {
 
 typedef std::function<bool (const Value&, LivestatusGroupByType, const Object::Ptr&)> AddRowFunction;
 
+/**
+ * A column predicate which every row matching a filter must satisfy.
+ *
+ * @ingroup livestatus
+ */
+struct LivestatusIndexPredicate {
+	String Column;
+	String Operator;
+	String Operand;
+};
+
 class Filter;
 
 /**
@@ -52,10 +64,11 @@ public:
 	virtual String GetName() const = 0;
 	virtual String GetPrefix() const = 0;
 
-	std::vector<LivestatusRowValue> FilterRows(const intrusive_ptr<Filter>& filter, int limit = -1);
+	std::vector<LivestatusRowValue> FilterRows(const intrusive_ptr<Filter>& filter, int limit = -1, size_t *rowsScanned = nullptr);
 
 	void AddColumn(const String& name, const Column& column);
 	Column GetColumn(const String& name) const;
+	Value GetRowValue(const String& name, const Value& row);
 	std::vector<String> GetColumnNames() const;
 
 	LivestatusGroupByType GetGroupByType() const;
@@ -64,6 +77,8 @@ protected:
 	Table(LivestatusGroupByType type = LivestatusGroupByNone);
 
 	virtual void FetchRows(const AddRowFunction& addRowFn) = 0;
+	virtual bool FetchIndexedRows(const LivestatusIndexPredicate& predicate, const AddRowFunction& addRowFn);
+	static bool FetchPredicateRows(const String& type, const FilterPredicate& predicate, const AddRowFunction& addRowFn);
 
 	static Value ZeroAccessor(const Value&);
 	static Value OneAccessor(const Value&);
@@ -75,9 +90,19 @@ protected:
 	Value m_GroupByObject;
 
 private:
+	struct CachedColumnValue {
+		Column ResolvedColumn;
+		size_t Generation;
+		Value CachedValue;
+	};
+
 	std::map<String, Column> m_Columns;
 
-	bool FilteredAddRow(std::vector<LivestatusRowValue>& rs, const intrusive_ptr<Filter>& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
+	Object::Ptr m_CachedRow;
+	size_t m_CachedRowGeneration{0};
+	std::map<String, CachedColumnValue> m_ColumnValueCache;
+
+	bool FilteredAddRow(std::vector<LivestatusRowValue>& rs, size_t& rowsScanned, const intrusive_ptr<Filter>& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
 };
 
 }
@@ -100,6 +100,9 @@ void ClusterZoneCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const Che
 	double messagesReceivedPerSecond = 0;
 	double bytesSentPerSecond = 0;
 	double bytesReceivedPerSecond = 0;
+	double flushesPerSecond = 0;
+	double sendQueueBytes = 0;
+	double sendQueueMessages = 0;
 
 	for (const Endpoint::Ptr& endpoint : zone->GetEndpoints()) {
 		if (endpoint->GetConnected())
@@ -120,6 +123,9 @@ void ClusterZoneCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const Che
 		messagesReceivedPerSecond += endpoint->GetMessagesReceivedPerSecond();
 		bytesSentPerSecond += endpoint->GetBytesSentPerSecond();
 		bytesReceivedPerSecond += endpoint->GetBytesReceivedPerSecond();
+		flushesPerSecond += endpoint->GetFlushesPerSecond();
+		sendQueueBytes += endpoint->GetSendQueueBytes();
+		sendQueueMessages += endpoint->GetSendQueueMessages();
 	}
 
 	if (connected) {
@@ -148,7 +154,10 @@ void ClusterZoneCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const Che
 		new PerfdataValue("sum_messages_sent_per_second", messagesSentPerSecond),
 		new PerfdataValue("sum_messages_received_per_second", messagesReceivedPerSecond),
 		new PerfdataValue("sum_bytes_sent_per_second", bytesSentPerSecond),
-		new PerfdataValue("sum_bytes_received_per_second", bytesReceivedPerSecond)
+		new PerfdataValue("sum_bytes_received_per_second", bytesReceivedPerSecond),
+		new PerfdataValue("sum_flushes_per_second", flushesPerSecond),
+		new PerfdataValue("sum_send_queue_bytes", sendQueueBytes),
+		new PerfdataValue("sum_send_queue_messages", sendQueueMessages)
 	}));
 
 	checkable->ProcessCheckResult(cr);
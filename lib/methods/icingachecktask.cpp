@@ -25,12 +25,15 @@
 #include "icinga/icingaapplication.hpp"
 #include "icinga/clusterevents.hpp"
 #include "icinga/checkable.hpp"
+#include "icinga/concurrencycontroller.hpp"
 #include "base/application.hpp"
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
+#include "base/timer.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/function.hpp"
 #include "base/configtype.hpp"
+#include "base/convert.hpp"
 
 using namespace icinga;
 
@@ -92,16 +95,34 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	perfdata->Add(new PerfdataValue("passive_service_checks_15min", CIB::GetPassiveServiceChecksStatistics(60 * 15)));
 
 	perfdata->Add(new PerfdataValue("current_concurrent_checks", Checkable::GetPendingChecks()));
+	perfdata->Add(new PerfdataValue("max_concurrent_checks", ConcurrencyController::GetLimit()));
+	perfdata->Add(new PerfdataValue("max_concurrent_checks_change_reason", static_cast<int>(ConcurrencyController::GetLastChangeReason())));
 	perfdata->Add(new PerfdataValue("remote_check_queue", ClusterEvents::GetCheckRequestQueueSize()));
 
+	const Histogram& eventLoopLag = Timer::GetEventLoopLag();
+
+	perfdata->Add(new PerfdataValue("avg_event_loop_lag", eventLoopLag.GetAverage()));
+	perfdata->Add(new PerfdataValue("p95_event_loop_lag", eventLoopLag.GetPercentile(95)));
+	perfdata->Add(new PerfdataValue("max_event_loop_lag", eventLoopLag.GetMax()));
+
 	CheckableCheckStatistics scs = CIB::CalculateServiceCheckStats();
 
 	perfdata->Add(new PerfdataValue("min_latency", scs.min_latency));
 	perfdata->Add(new PerfdataValue("max_latency", scs.max_latency));
 	perfdata->Add(new PerfdataValue("avg_latency", scs.avg_latency));
+	perfdata->Add(new PerfdataValue("p50_latency", scs.p50_latency));
+	perfdata->Add(new PerfdataValue("p95_latency", scs.p95_latency));
+	perfdata->Add(new PerfdataValue("p99_latency", scs.p99_latency));
 	perfdata->Add(new PerfdataValue("min_execution_time", scs.min_execution_time));
 	perfdata->Add(new PerfdataValue("max_execution_time", scs.max_execution_time));
 	perfdata->Add(new PerfdataValue("avg_execution_time", scs.avg_execution_time));
+	perfdata->Add(new PerfdataValue("p50_execution_time", scs.p50_execution_time));
+	perfdata->Add(new PerfdataValue("p95_execution_time", scs.p95_execution_time));
+	perfdata->Add(new PerfdataValue("p99_execution_time", scs.p99_execution_time));
+	perfdata->Add(new PerfdataValue("avg_processing_time", scs.avg_processing_time));
+	perfdata->Add(new PerfdataValue("p50_processing_time", scs.p50_processing_time));
+	perfdata->Add(new PerfdataValue("p95_processing_time", scs.p95_processing_time));
+	perfdata->Add(new PerfdataValue("p99_processing_time", scs.p99_processing_time));
 
 	ServiceStatistics ss = CIB::CalculateServiceStats();
 
@@ -166,6 +187,11 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	String output = "Icinga 2 has been running for " + Utility::FormatDuration(uptime) +
 		". Version: " + appVersion;
 
+	if (ConcurrencyController::IsAdaptive()) {
+		output += "; Concurrent checks limit: " + Convert::ToString(ConcurrencyController::GetLimit()) +
+			" (last change: " + ConcurrencyController::GetLastChangeReasonText() + ")";
+	}
+
 	/* Indicate a warning if the last reload failed. */
 	double lastReloadFailed = Application::GetLastReloadFailed();
 
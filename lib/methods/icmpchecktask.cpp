@@ -0,0 +1,514 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "methods/icmpchecktask.hpp"
+#include "icinga/pluginutility.hpp"
+#include "icinga/checkcommand.hpp"
+#include "icinga/macroprocessor.hpp"
+#include "icinga/icingaapplication.hpp"
+#include "base/socketevents.hpp"
+#include "base/timer.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "base/function.hpp"
+#include "base/logger.hpp"
+#include <boost/thread/mutex.hpp>
+#include <iomanip>
+#include <memory>
+#include <set>
+
+#ifndef _WIN32
+#	include <netdb.h>
+#	include <netinet/in.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+REGISTER_SCRIPTFUNCTION_NS(Internal, IcmpCheck, &IcmpCheckTask::ScriptFunc, "checkable:cr:resolvedMacros:useResolvedMacros");
+
+#ifndef _WIN32
+
+#define ICMP_TIMER_INTERVAL 0.1
+#define ICMP_PACKET_INTERVAL 0.2
+#define ICMP_PAYLOAD_SIZE 56
+
+/**
+ * The state of one ICMP check, i.e. a series of echo requests to one address.
+ */
+struct IcmpCheck
+{
+	Checkable::Ptr Object;
+	CheckResult::Ptr Result;
+
+	sockaddr_storage Address;
+	socklen_t AddressLength;
+
+	int Packets;
+	int Sent{0};
+	int Received{0};
+	double RoundTripSum{0};
+	std::vector<uint16_t> Sequences;
+
+	double WarningRta;
+	double CriticalRta;
+	int WarningLoss;
+	int CriticalLoss;
+
+	double NextSend;
+	double Deadline;
+};
+
+struct IcmpEchoHeader
+{
+	uint8_t Type;
+	uint8_t Code;
+	uint16_t Checksum;
+	uint16_t Identifier;
+	uint16_t Sequence;
+};
+
+/**
+ * An ICMP socket which multiplexes the echo requests of all ICMP checks for
+ * one address family. Replies are matched to their requests by the sequence
+ * number.
+ */
+class IcmpSocket final : public Object, private SocketEvents
+{
+public:
+	DECLARE_PTR_TYPEDEFS(IcmpSocket);
+
+	IcmpSocket(const Socket::Ptr& socket, int family, bool raw);
+
+	static IcmpSocket::Ptr GetSocket(int family, String& error);
+
+	void AddCheck(const std::shared_ptr<IcmpCheck>& check);
+
+private:
+	struct EchoRequest
+	{
+		std::shared_ptr<IcmpCheck> Check;
+		double SendTime;
+	};
+
+	Socket::Ptr m_Socket;
+	int m_Family;
+	bool m_Raw;
+	uint16_t m_Identifier;
+
+	boost::mutex m_Mutex;
+	std::set<std::shared_ptr<IcmpCheck> > m_Checks;
+	std::map<uint16_t, EchoRequest> m_Requests;
+	uint16_t m_NextSequence{0};
+
+	Timer::Ptr m_Timer;
+
+	void OnEvent(int revents) override;
+	void TimerHandler();
+
+	void SendEchoRequest(const std::shared_ptr<IcmpCheck>& check, double now);
+	std::shared_ptr<IcmpCheck> HandleEchoReply(const char *buffer, size_t length, const sockaddr_storage& from, double now);
+	void RemoveCheck(const std::shared_ptr<IcmpCheck>& check);
+
+	static void FinishCheck(const std::shared_ptr<IcmpCheck>& check);
+};
+
+static boost::mutex l_IcmpSocketsMutex;
+static IcmpSocket::Ptr l_IcmpSocket4;
+static IcmpSocket::Ptr l_IcmpSocket6;
+
+static uint16_t IcmpChecksum(const char *data, size_t length)
+{
+	uint32_t sum = 0;
+
+	for (size_t i = 0; i + 1 < length; i += 2) {
+		uint16_t word;
+		memcpy(&word, data + i, sizeof(word));
+		sum += word;
+	}
+
+	if (length % 2 != 0)
+		sum += static_cast<uint8_t>(data[length - 1]);
+
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum;
+}
+
+static bool IsSameAddress(const sockaddr_storage& a, const sockaddr_storage& b)
+{
+	if (a.ss_family != b.ss_family)
+		return false;
+
+	if (a.ss_family == AF_INET)
+		return reinterpret_cast<const sockaddr_in&>(a).sin_addr.s_addr == reinterpret_cast<const sockaddr_in&>(b).sin_addr.s_addr;
+
+	return memcmp(&reinterpret_cast<const sockaddr_in6&>(a).sin6_addr, &reinterpret_cast<const sockaddr_in6&>(b).sin6_addr, sizeof(in6_addr)) == 0;
+}
+
+IcmpSocket::IcmpSocket(const Socket::Ptr& socket, int family, bool raw)
+	: SocketEvents(socket, this), m_Socket(socket), m_Family(family), m_Raw(raw)
+{
+	/* Ping sockets (SOCK_DGRAM) get their identifier from the kernel and only
+	 * receive the replies for that identifier. */
+	m_Identifier = getpid() & 0xffff;
+
+	m_Timer = new Timer("IcmpCheckTask");
+	m_Timer->SetInterval(ICMP_TIMER_INTERVAL);
+	m_Timer->OnTimerExpired.connect(std::bind(&IcmpSocket::TimerHandler, this));
+	m_Timer->Start();
+
+	ChangeEvents(POLLIN);
+}
+
+/**
+ * Returns the shared ICMP socket for the address family, creating it if
+ * necessary. Unprivileged ping sockets are preferred over raw sockets.
+ */
+IcmpSocket::Ptr IcmpSocket::GetSocket(int family, String& error)
+{
+	boost::mutex::scoped_lock lock(l_IcmpSocketsMutex);
+
+	IcmpSocket::Ptr& icmpSocket = (family == AF_INET) ? l_IcmpSocket4 : l_IcmpSocket6;
+
+	if (icmpSocket)
+		return icmpSocket;
+
+	int protocol = IPPROTO_ICMP;
+
+	if (family == AF_INET6)
+		protocol = IPPROTO_ICMPV6;
+
+	bool raw = false;
+
+	SOCKET fd = socket(family, SOCK_DGRAM, protocol);
+
+	if (fd == INVALID_SOCKET) {
+		fd = socket(family, SOCK_RAW, protocol);
+		raw = true;
+	}
+
+	if (fd == INVALID_SOCKET) {
+		error = "Cannot create ICMP socket: " + Utility::FormatErrorNumber(errno)
+			+ ". Either allow ping sockets ('net.ipv4.ping_group_range') or grant the CAP_NET_RAW capability.";
+		return nullptr;
+	}
+
+	Utility::SetNonBlockingSocket(fd);
+	Utility::SetCloExec(fd);
+
+	icmpSocket = new IcmpSocket(new Socket(fd), family, raw);
+
+	return icmpSocket;
+}
+
+void IcmpSocket::AddCheck(const std::shared_ptr<IcmpCheck>& check)
+{
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_Checks.insert(check);
+	SendEchoRequest(check, now);
+}
+
+void IcmpSocket::SendEchoRequest(const std::shared_ptr<IcmpCheck>& check, double now)
+{
+	uint16_t sequence = m_NextSequence++;
+
+	while (m_Requests.find(sequence) != m_Requests.end())
+		sequence = m_NextSequence++;
+
+	char packet[sizeof(IcmpEchoHeader) + ICMP_PAYLOAD_SIZE] = {};
+
+	IcmpEchoHeader header = {};
+	header.Type = (m_Family == AF_INET) ? 8 : 128;
+	header.Identifier = htons(m_Identifier);
+	header.Sequence = htons(sequence);
+	memcpy(packet, &header, sizeof(header));
+
+	/* The kernel calculates the checksum for ICMPv6. */
+	if (m_Family == AF_INET) {
+		header.Checksum = IcmpChecksum(packet, sizeof(packet));
+		memcpy(packet, &header, sizeof(header));
+	}
+
+	if (sendto(m_Socket->GetFD(), packet, sizeof(packet), 0, reinterpret_cast<sockaddr *>(&check->Address), check->AddressLength) < 0) {
+		Log(LogDebug, "IcmpCheckTask")
+			<< "sendto() failed for '" << check->Object->GetName() << "': " << Utility::FormatErrorNumber(errno);
+	}
+
+	m_Requests[sequence] = { check, now };
+	check->Sequences.push_back(sequence);
+	check->Sent++;
+	check->NextSend = now + ICMP_PACKET_INTERVAL;
+
+	/* Replies which take longer than the critical RTA (but at least a second)
+	 * after the last request are counted as lost. */
+	if (check->Sent == check->Packets)
+		check->Deadline = std::min(check->Deadline, now + std::max(check->CriticalRta / 1000, 1.0));
+}
+
+void IcmpSocket::OnEvent(int revents)
+{
+	if (!(revents & POLLIN))
+		return;
+
+	for (;;) {
+		char buffer[1500];
+		sockaddr_storage from;
+		socklen_t fromLength = sizeof(from);
+
+		ssize_t rc = recvfrom(m_Socket->GetFD(), buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&from), &fromLength);
+
+		if (rc < 0)
+			break;
+
+		std::shared_ptr<IcmpCheck> check = HandleEchoReply(buffer, rc, from, Utility::GetTime());
+
+		if (check)
+			FinishCheck(check);
+	}
+}
+
+/**
+ * Accounts for an echo reply.
+ *
+ * @returns The check if this was its last outstanding reply, nullptr otherwise.
+ */
+std::shared_ptr<IcmpCheck> IcmpSocket::HandleEchoReply(const char *buffer, size_t length, const sockaddr_storage& from, double now)
+{
+	size_t offset = 0;
+
+	/* Raw IPv4 sockets include the IP header. */
+	if (m_Family == AF_INET && m_Raw && length > 0)
+		offset = (buffer[0] & 0x0f) * 4;
+
+	if (length < offset + sizeof(IcmpEchoHeader))
+		return nullptr;
+
+	IcmpEchoHeader header;
+	memcpy(&header, buffer + offset, sizeof(header));
+
+	if (header.Type != ((m_Family == AF_INET) ? 0 : 129))
+		return nullptr;
+
+	if (m_Raw && ntohs(header.Identifier) != m_Identifier)
+		return nullptr;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	auto it = m_Requests.find(ntohs(header.Sequence));
+
+	if (it == m_Requests.end() || !IsSameAddress(it->second.Check->Address, from))
+		return nullptr;
+
+	std::shared_ptr<IcmpCheck> check = it->second.Check;
+
+	check->Received++;
+	check->RoundTripSum += now - it->second.SendTime;
+
+	m_Requests.erase(it);
+
+	if (check->Received < check->Packets)
+		return nullptr;
+
+	RemoveCheck(check);
+
+	return check;
+}
+
+void IcmpSocket::RemoveCheck(const std::shared_ptr<IcmpCheck>& check)
+{
+	for (uint16_t sequence : check->Sequences) {
+		auto it = m_Requests.find(sequence);
+
+		if (it != m_Requests.end() && it->second.Check == check)
+			m_Requests.erase(it);
+	}
+
+	m_Checks.erase(check);
+}
+
+void IcmpSocket::TimerHandler()
+{
+	double now = Utility::GetTime();
+	std::vector<std::shared_ptr<IcmpCheck> > finished;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		for (const std::shared_ptr<IcmpCheck>& check : m_Checks) {
+			if (check->Sent < check->Packets && check->NextSend <= now)
+				SendEchoRequest(check, now);
+
+			if (check->Deadline <= now)
+				finished.push_back(check);
+		}
+
+		for (const std::shared_ptr<IcmpCheck>& check : finished)
+			RemoveCheck(check);
+	}
+
+	for (const std::shared_ptr<IcmpCheck>& check : finished)
+		FinishCheck(check);
+}
+
+static void ProcessIcmpCheckResult(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+{
+	Checkable::DecreasePendingChecks();
+
+	checkable->ProcessCheckResult(cr);
+}
+
+/**
+ * Calculates the check result in the same format as the check_ping plugin.
+ */
+void IcmpSocket::FinishCheck(const std::shared_ptr<IcmpCheck>& check)
+{
+	int loss = (check->Packets - check->Received) * 100 / check->Packets;
+	double rta = (check->Received > 0) ? check->RoundTripSum / check->Received * 1000 : check->CriticalRta;
+
+	int exitStatus = 0;
+
+	if (check->Received == 0 || loss >= check->CriticalLoss || rta >= check->CriticalRta)
+		exitStatus = 2;
+	else if (loss >= check->WarningLoss || rta >= check->WarningRta)
+		exitStatus = 1;
+
+	static const char * const stateTexts[] = { "OK", "WARNING", "CRITICAL" };
+
+	std::ostringstream msgbuf;
+	msgbuf << "PING " << stateTexts[exitStatus] << " - Packet loss = " << loss << "%";
+
+	if (check->Received > 0)
+		msgbuf << ", RTA = " << std::fixed << std::setprecision(2) << rta << " ms";
+
+	std::ostringstream perfbuf;
+	perfbuf << std::fixed << std::setprecision(6)
+		<< "rta=" << rta << "ms;" << check->WarningRta << ";" << check->CriticalRta << ";" << 0.0
+		<< " pl=" << loss << "%;" << check->WarningLoss << ";" << check->CriticalLoss << ";0";
+
+	CheckResult::Ptr cr = check->Result;
+	cr->SetOutput(msgbuf.str());
+	cr->SetPerformanceData(PluginUtility::SplitPerfdata(perfbuf.str()));
+	cr->SetState(PluginUtility::ExitStatusToState(exitStatus));
+	cr->SetExitStatus(exitStatus);
+	cr->SetExecutionEnd(Utility::GetTime());
+
+	Utility::QueueAsyncCallback(std::bind(&ProcessIcmpCheckResult, check->Object, cr));
+}
+
+#endif /* _WIN32 */
+
+void IcmpCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
+	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros)
+{
+	REQUIRE_NOT_NULL(checkable);
+	REQUIRE_NOT_NULL(cr);
+
+	CheckCommand::Ptr commandObj = checkable->GetCheckCommand();
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	MacroProcessor::ResolverList resolvers;
+	if (service)
+		resolvers.emplace_back("service", service);
+	resolvers.emplace_back("host", host);
+	resolvers.emplace_back("command", commandObj);
+	resolvers.emplace_back("icinga", IcingaApplication::GetInstance());
+
+	String missingMacro;
+
+	String address = MacroProcessor::ResolveMacros("$ping_address$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value wrta = MacroProcessor::ResolveMacros("$ping_wrta$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value wpl = MacroProcessor::ResolveMacros("$ping_wpl$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value crta = MacroProcessor::ResolveMacros("$ping_crta$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value cpl = MacroProcessor::ResolveMacros("$ping_cpl$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value packets = MacroProcessor::ResolveMacros("$ping_packets$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value timeout = MacroProcessor::ResolveMacros("$ping_timeout$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+
+	if (resolvedMacros && !useResolvedMacros)
+		return;
+
+	double now = Utility::GetTime();
+
+	cr->SetExecutionStart(now);
+	cr->SetExecutionEnd(now);
+
+#ifndef _WIN32
+	String error;
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	addrinfo *result;
+	int rc;
+
+	if (address.IsEmpty())
+		error = "No address specified.";
+	else if ((rc = getaddrinfo(address.CStr(), nullptr, &hints, &result)) != 0)
+		error = "Cannot resolve address '" + address + "': " + gai_strerror(rc);
+	else {
+		auto check = std::make_shared<IcmpCheck>();
+		check->Object = checkable;
+		check->Result = cr;
+
+		memcpy(&check->Address, result->ai_addr, result->ai_addrlen);
+		check->AddressLength = result->ai_addrlen;
+
+		freeaddrinfo(result);
+
+		check->Packets = (packets.IsEmpty() || packets <= 0) ? 5 : static_cast<int>(packets);
+		check->WarningRta = wrta.IsEmpty() ? 100 : static_cast<double>(wrta);
+		check->WarningLoss = wpl.IsEmpty() ? 5 : static_cast<int>(wpl);
+		check->CriticalRta = crta.IsEmpty() ? 200 : static_cast<double>(crta);
+		check->CriticalLoss = cpl.IsEmpty() ? 15 : static_cast<int>(cpl);
+		check->NextSend = now;
+		check->Deadline = now + ((timeout.IsEmpty() || timeout <= 0) ? 10 : static_cast<double>(timeout));
+
+		IcmpSocket::Ptr icmpSocket = IcmpSocket::GetSocket(check->Address.ss_family, error);
+
+		if (icmpSocket) {
+			Checkable::IncreasePendingChecks();
+			icmpSocket->AddCheck(check);
+			return;
+		}
+	}
+#else /* _WIN32 */
+	String error = "Not supported on this platform.";
+#endif /* _WIN32 */
+
+	cr->SetOutput("PING UNKNOWN - " + error);
+	cr->SetState(ServiceUnknown);
+	cr->SetExitStatus(3);
+
+	checkable->ProcessCheckResult(cr);
+}
@@ -76,7 +76,7 @@ void PluginCheckTask::ProcessFinishedHandler(const Checkable::Ptr& checkable, co
 
 	std::pair<String, String> co = PluginUtility::ParseCheckOutput(output);
 	cr->SetCommand(commandLine);
-	cr->SetOutput(co.first);
+	cr->SetOutput(std::move(co.first));
 	cr->SetPerformanceData(PluginUtility::SplitPerfdata(co.second));
 	cr->SetState(PluginUtility::ExitStatusToState(pr.ExitStatus));
 	cr->SetExitStatus(pr.ExitStatus);
@@ -0,0 +1,412 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "methods/tcpchecktask.hpp"
+#include "icinga/pluginutility.hpp"
+#include "icinga/checkcommand.hpp"
+#include "icinga/macroprocessor.hpp"
+#include "icinga/icingaapplication.hpp"
+#include "base/socketevents.hpp"
+#include "base/tlsutility.hpp"
+#include "base/timer.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "base/function.hpp"
+#include "base/logger.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+#include <iomanip>
+#include <set>
+
+#ifndef _WIN32
+#	include <netdb.h>
+#	include <arpa/inet.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+REGISTER_SCRIPTFUNCTION_NS(Internal, TcpCheck, &TcpCheckTask::ScriptFunc, "checkable:cr:resolvedMacros:useResolvedMacros");
+
+#ifndef _WIN32
+
+#define TCP_TIMER_INTERVAL 0.1
+
+/**
+ * A non-blocking TCP connection for one TCP check.
+ */
+class TcpCheckConnection final : public Object, private SocketEvents
+{
+public:
+	DECLARE_PTR_TYPEDEFS(TcpCheckConnection);
+
+	TcpCheckConnection(const Socket::Ptr& socket, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+
+	String Address;
+	String Port;
+	String ServerName;
+	bool UseTls{false};
+
+	double WarningTime{-1};
+	double CriticalTime{-1};
+	double Timeout{10};
+
+	void Start();
+
+	static void TimerHandler();
+
+private:
+	Socket::Ptr m_Socket;
+	Checkable::Ptr m_Checkable;
+	CheckResult::Ptr m_Result;
+
+	boost::mutex m_Mutex;
+	bool m_Connected{false};
+	bool m_Finished{false};
+	double m_Deadline{0};
+	std::unique_ptr<SSL, decltype(&SSL_free)> m_SSL{nullptr, SSL_free};
+
+	void OnEvent(int revents) override;
+	void ContinueHandshake();
+
+	void SetResult(int exitStatus, const String& output, bool perfdata);
+	void Finish();
+};
+
+static boost::mutex l_TcpConnectionsMutex;
+static std::set<TcpCheckConnection::Ptr> l_TcpConnections;
+static Timer::Ptr l_TcpTimer;
+static std::shared_ptr<SSL_CTX> l_TcpSSLContext;
+static boost::once_flag l_TcpOnceFlag = BOOST_ONCE_INIT;
+
+static void InitializeTcpCheck()
+{
+	l_TcpSSLContext = MakeSSLContext();
+
+	l_TcpTimer = new Timer("TcpCheckTask");
+	l_TcpTimer->SetInterval(TCP_TIMER_INTERVAL);
+	l_TcpTimer->OnTimerExpired.connect(std::bind(&TcpCheckConnection::TimerHandler));
+	l_TcpTimer->Start();
+}
+
+TcpCheckConnection::TcpCheckConnection(const Socket::Ptr& socket, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+	: SocketEvents(socket, this), m_Socket(socket), m_Checkable(checkable), m_Result(cr)
+{ }
+
+void TcpCheckConnection::Start()
+{
+	boost::call_once(l_TcpOnceFlag, &InitializeTcpCheck);
+
+	m_Deadline = m_Result->GetExecutionStart() + Timeout;
+
+	{
+		boost::mutex::scoped_lock lock(l_TcpConnectionsMutex);
+		l_TcpConnections.insert(this);
+	}
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	ChangeEvents(POLLOUT);
+}
+
+void TcpCheckConnection::TimerHandler()
+{
+	double now = Utility::GetTime();
+	std::vector<TcpCheckConnection::Ptr> expired;
+
+	{
+		boost::mutex::scoped_lock lock(l_TcpConnectionsMutex);
+
+		for (const TcpCheckConnection::Ptr& connection : l_TcpConnections) {
+			if (connection->m_Deadline <= now)
+				expired.push_back(connection);
+		}
+	}
+
+	for (const TcpCheckConnection::Ptr& connection : expired) {
+		{
+			boost::mutex::scoped_lock lock(connection->m_Mutex);
+
+			if (connection->m_Finished)
+				continue;
+
+			connection->SetResult(2, "CRITICAL - Socket timeout after " + Convert::ToString(connection->Timeout) + " seconds", false);
+		}
+
+		connection->Finish();
+	}
+}
+
+void TcpCheckConnection::OnEvent(int revents)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Finished)
+			return;
+
+		if (!m_Connected) {
+			int error;
+			socklen_t length = sizeof(error);
+
+			if (getsockopt(m_Socket->GetFD(), SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &length) < 0)
+				error = errno;
+
+			if (error == 0 && !(revents & POLLOUT))
+				return;
+
+			if (error != 0)
+				SetResult(2, "connect to address " + Address + " and port " + Port + ": " + Utility::FormatErrorNumber(error), false);
+			else {
+				m_Connected = true;
+
+				if (UseTls) {
+					m_SSL.reset(SSL_new(l_TcpSSLContext.get()));
+					SSL_set_fd(m_SSL.get(), m_Socket->GetFD());
+					SSL_set_connect_state(m_SSL.get());
+
+					if (!ServerName.IsEmpty())
+						SSL_set_tlsext_host_name(m_SSL.get(), ServerName.CStr());
+				}
+			}
+		}
+
+		if (m_Connected && !m_Finished) {
+			if (UseTls)
+				ContinueHandshake();
+			else
+				SetResult(0, String(), true);
+		}
+
+		if (!m_Finished)
+			return;
+	}
+
+	Finish();
+}
+
+void TcpCheckConnection::ContinueHandshake()
+{
+	int rc = SSL_do_handshake(m_SSL.get());
+
+	if (rc == 1) {
+		SetResult(0, String(), true);
+		return;
+	}
+
+	switch (SSL_get_error(m_SSL.get(), rc)) {
+		case SSL_ERROR_WANT_READ:
+			ChangeEvents(POLLIN);
+			break;
+		case SSL_ERROR_WANT_WRITE:
+			ChangeEvents(POLLOUT);
+			break;
+		default:
+			SetResult(2, "CRITICAL - Cannot make SSL connection.", false);
+	}
+}
+
+/**
+ * Sets the check result in the same format as the check_tcp plugin. Must be
+ * called with the connection mutex held.
+ */
+void TcpCheckConnection::SetResult(int exitStatus, const String& output, bool perfdata)
+{
+	m_Finished = true;
+
+	double now = Utility::GetTime();
+	double elapsed = now - m_Result->GetExecutionStart();
+
+	std::ostringstream msgbuf;
+
+	if (perfdata) {
+		if (CriticalTime >= 0 && elapsed > CriticalTime)
+			exitStatus = 2;
+		else if (WarningTime >= 0 && elapsed > WarningTime)
+			exitStatus = 1;
+
+		static const char * const stateTexts[] = { "OK", "WARNING", "CRITICAL" };
+
+		msgbuf << "TCP " << stateTexts[exitStatus] << " - " << std::fixed << std::setprecision(3) << elapsed
+			<< " second response time on " << Address << " port " << Port;
+
+		std::ostringstream perfbuf;
+		perfbuf << std::fixed << std::setprecision(6) << "time=" << elapsed << "s;";
+
+		if (WarningTime >= 0)
+			perfbuf << WarningTime;
+
+		perfbuf << ";";
+
+		if (CriticalTime >= 0)
+			perfbuf << CriticalTime;
+
+		perfbuf << ";" << 0.0 << ";" << Timeout;
+
+		m_Result->SetPerformanceData(PluginUtility::SplitPerfdata(perfbuf.str()));
+	} else
+		msgbuf << output;
+
+	m_Result->SetOutput(msgbuf.str());
+	m_Result->SetState(PluginUtility::ExitStatusToState(exitStatus));
+	m_Result->SetExitStatus(exitStatus);
+	m_Result->SetExecutionEnd(now);
+}
+
+static void ProcessTcpCheckResult(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+{
+	Checkable::DecreasePendingChecks();
+
+	checkable->ProcessCheckResult(cr);
+}
+
+/**
+ * Releases the connection once its result has been set. Must be called
+ * without holding the connection mutex because unregistering waits for the
+ * socket IO thread.
+ */
+void TcpCheckConnection::Finish()
+{
+	SocketEvents::Unregister();
+	m_Socket->Close();
+
+	Utility::QueueAsyncCallback(std::bind(&ProcessTcpCheckResult, m_Checkable, m_Result));
+
+	boost::mutex::scoped_lock lock(l_TcpConnectionsMutex);
+	l_TcpConnections.erase(this);
+}
+
+#endif /* _WIN32 */
+
+void TcpCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
+	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros)
+{
+	REQUIRE_NOT_NULL(checkable);
+	REQUIRE_NOT_NULL(cr);
+
+	CheckCommand::Ptr commandObj = checkable->GetCheckCommand();
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	MacroProcessor::ResolverList resolvers;
+	if (service)
+		resolvers.emplace_back("service", service);
+	resolvers.emplace_back("host", host);
+	resolvers.emplace_back("command", commandObj);
+	resolvers.emplace_back("icinga", IcingaApplication::GetInstance());
+
+	String missingMacro;
+
+	String address = MacroProcessor::ResolveMacros("$tcp_address$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	String port = MacroProcessor::ResolveMacros("$tcp_port$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value wtime = MacroProcessor::ResolveMacros("$tcp_wtime$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value ctime = MacroProcessor::ResolveMacros("$tcp_ctime$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value timeout = MacroProcessor::ResolveMacros("$tcp_timeout$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+	Value ssl = MacroProcessor::ResolveMacros("$tcp_ssl$", resolvers, checkable->GetLastCheckResult(),
+		&missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros);
+
+	if (resolvedMacros && !useResolvedMacros)
+		return;
+
+	double now = Utility::GetTime();
+
+	cr->SetExecutionStart(now);
+	cr->SetExecutionEnd(now);
+
+#ifndef _WIN32
+	String error;
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo *result;
+	int rc;
+
+	if (address.IsEmpty() || port.IsEmpty())
+		error = "UNKNOWN - No address or port specified.";
+	else if ((rc = getaddrinfo(address.CStr(), port.CStr(), &hints, &result)) != 0)
+		error = "UNKNOWN - Cannot resolve address '" + address + "': " + gai_strerror(rc);
+	else {
+		SOCKET fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+
+		if (fd == INVALID_SOCKET) {
+			error = "UNKNOWN - Cannot create socket: " + Utility::FormatErrorNumber(errno);
+			freeaddrinfo(result);
+		} else {
+			Utility::SetNonBlockingSocket(fd);
+			Utility::SetCloExec(fd);
+
+			rc = connect(fd, result->ai_addr, result->ai_addrlen);
+			int connectError = errno;
+
+			freeaddrinfo(result);
+
+			Socket::Ptr socket = new Socket(fd);
+
+			if (rc < 0 && connectError != EINPROGRESS) {
+				cr->SetOutput("connect to address " + address + " and port " + port + ": " + Utility::FormatErrorNumber(connectError));
+				cr->SetState(ServiceCritical);
+				cr->SetExitStatus(2);
+
+				checkable->ProcessCheckResult(cr);
+				return;
+			}
+
+			TcpCheckConnection::Ptr connection = new TcpCheckConnection(socket, checkable, cr);
+			connection->Address = address;
+			connection->Port = port;
+			connection->UseTls = !ssl.IsEmpty() && ssl.ToBool();
+
+			/* Only host names are valid for SNI. */
+			in6_addr addr;
+			if (inet_pton(AF_INET, address.CStr(), &addr) != 1 && inet_pton(AF_INET6, address.CStr(), &addr) != 1)
+				connection->ServerName = address;
+
+			if (!wtime.IsEmpty())
+				connection->WarningTime = wtime;
+
+			if (!ctime.IsEmpty())
+				connection->CriticalTime = ctime;
+
+			if (!timeout.IsEmpty() && timeout > 0)
+				connection->Timeout = timeout;
+
+			Checkable::IncreasePendingChecks();
+			connection->Start();
+			return;
+		}
+	}
+#else /* _WIN32 */
+	String error = "UNKNOWN - Not supported on this platform.";
+#endif /* _WIN32 */
+
+	cr->SetOutput(error);
+	cr->SetState(ServiceUnknown);
+	cr->SetExitStatus(3);
+
+	checkable->ProcessCheckResult(cr);
+}
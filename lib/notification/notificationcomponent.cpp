@@ -27,6 +27,8 @@
 #include "base/utility.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/convert.hpp"
 
 using namespace icinga;
 
@@ -34,17 +36,43 @@ REGISTER_TYPE(NotificationComponent);
 
 REGISTER_STATSFUNCTION(NotificationComponent, &NotificationComponent::StatsFunc);
 
-void NotificationComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void NotificationComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const NotificationComponent::Ptr& notification_component : ConfigType::GetObjectsByType<NotificationComponent>()) {
 		nodes.emplace_back(notification_component->GetName(), 1); //add more stats
+
+		size_t idle, parked;
+
+		{
+			boost::mutex::scoped_lock lock(notification_component->m_Mutex);
+			idle = notification_component->m_IdleNotifications.size();
+			parked = notification_component->m_ParkedNotifications.size();
+		}
+
+		String perfdata_prefix = "notificationcomponent_" + notification_component->GetName() + "_";
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "idle", Convert::ToDouble(idle)));
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "parked", Convert::ToDouble(parked)));
 	}
 
 	status->Set("notificationcomponent", new Dictionary(std::move(nodes)));
 }
 
+void NotificationComponent::OnConfigLoaded()
+{
+	ConfigObject::OnActiveChanged.connect(std::bind(&NotificationComponent::ObjectHandler, this, _1));
+	ConfigObject::OnPausedChanged.connect(std::bind(&NotificationComponent::ObjectHandler, this, _1));
+
+	/* Notification::OnNextNotificationChanged is the cluster event, this one fires for every change. */
+	ObjectImpl<Notification>::OnNextNotificationChanged.connect(std::bind(&NotificationComponent::NextNotificationChangedHandler, this, _1));
+	Notification::OnIntervalChanged.connect(std::bind(&NotificationComponent::UnparkNotification, this, _1));
+	Notification::OnNoMoreNotificationsChanged.connect(std::bind(&NotificationComponent::UnparkNotification, this, _1));
+
+	Checkable::OnEnableNotificationsChanged.connect(std::bind(&NotificationComponent::CheckableNotificationsChangedHandler, this, _1));
+	IcingaApplication::OnEnableNotificationsChanged.connect(std::bind(&NotificationComponent::GlobalNotificationsChangedHandler, this));
+}
+
 /**
  * Starts the component.
  */
@@ -58,10 +86,11 @@ void NotificationComponent::Start(bool runtimeCreated)
 	Checkable::OnNotificationsRequested.connect(std::bind(&NotificationComponent::SendNotificationsHandler, this, _1,
 		_2, _3, _4, _5));
 
-	m_NotificationTimer = new Timer();
-	m_NotificationTimer->SetInterval(5);
-	m_NotificationTimer->OnTimerExpired.connect(std::bind(&NotificationComponent::NotificationTimerHandler, this));
-	m_NotificationTimer->Start();
+	/* Pick up the notifications which were activated before this component. */
+	for (const Notification::Ptr& notification : ConfigType::GetObjectsByType<Notification>())
+		ObjectHandler(notification);
+
+	m_Thread = std::thread(std::bind(&NotificationComponent::NotificationThreadProc, this));
 }
 
 void NotificationComponent::Stop(bool runtimeRemoved)
@@ -69,71 +98,214 @@ void NotificationComponent::Stop(bool runtimeRemoved)
 	Log(LogInformation, "NotificationComponent")
 		<< "'" << GetName() << "' stopped.";
 
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Stopped = true;
+		m_CV.notify_all();
+	}
+
+	if (m_Thread.joinable())
+		m_Thread.join();
+
 	ObjectImpl<NotificationComponent>::Stop(runtimeRemoved);
 }
 
 /**
- * Periodically sends notifications.
- *
- * @param - Event arguments for the timer.
+ * Waits for the notification which is due next and sends its reminder.
+ * Notifications are re-queued through NextNotificationChangedHandler()
+ * once their next notification time has been bumped.
  */
-void NotificationComponent::NotificationTimerHandler()
+void NotificationComponent::NotificationThreadProc()
 {
-	double now = Utility::GetTime();
+	Utility::SetThreadName("Notification Scheduler");
 
-	for (const Notification::Ptr& notification : ConfigType::GetObjectsByType<Notification>()) {
-		if (!notification->IsActive())
-			continue;
+	boost::mutex::scoped_lock lock(m_Mutex);
 
-		if (notification->IsPaused() && GetEnableHA())
-			continue;
+	for (;;) {
+		typedef boost::multi_index::nth_index<NotificationSet, 1>::type NotificationTimeView;
+		NotificationTimeView& idx = boost::get<1>(m_IdleNotifications);
 
-		Checkable::Ptr checkable = notification->GetCheckable();
+		while (idx.begin() == idx.end() && !m_Stopped)
+			m_CV.wait(lock);
 
-		if (!IcingaApplication::GetInstance()->GetEnableNotifications() || !checkable->GetEnableNotifications())
-			continue;
+		if (m_Stopped)
+			break;
 
-		if (notification->GetInterval() <= 0 && notification->GetNoMoreNotifications())
-			continue;
-
-		if (notification->GetNextNotification() > now)
-			continue;
+		auto it = idx.begin();
+		NotificationScheduleInfo nsi = *it;
 
-		bool reachable = checkable->IsReachable(DependencyNotification);
+		double wait = nsi.NextNotification - Utility::GetTime();
+	
+		if (wait > 0) {
+			/* Wait for the next notification. */
+			m_CV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
 
-		{
-			ObjectLock olock(notification);
-			notification->SetNextNotification(Utility::GetTime() + notification->GetInterval());
+			continue;
 		}
 
-		{
-			Host::Ptr host;
-			Service::Ptr service;
-			tie(host, service) = GetHostService(checkable);
-
-			ObjectLock olock(checkable);
-
-			if (checkable->GetStateType() == StateTypeSoft)
-				continue;
+		Notification::Ptr notification = nsi.Object;
 
-			if ((service && service->GetState() == ServiceOK) || (!service && host->GetState() == HostUp))
-				continue;
+		m_IdleNotifications.erase(notification);
 
-			if (!reachable || checkable->IsInDowntime() || checkable->IsAcknowledged() || checkable->IsFlapping())
-				continue;
+		/* These are checked while holding the lock so that a concurrent change
+		 * of the settings cannot miss a notification which is about to be parked. */
+		if (IsParkable(notification)) {
+			m_ParkedNotifications.insert(notification);
+			continue;
 		}
 
-		try {
-			Log(LogNotice, "NotificationComponent")
-				<< "Attempting to send reminder notification '" << notification->GetName() << "'";
+		lock.unlock();
 
-			notification->BeginExecuteNotification(NotificationProblem, checkable->GetLastCheckResult(), false, true);
+		try {
+			SendReminderNotification(notification);
 		} catch (const std::exception& ex) {
 			Log(LogWarning, "NotificationComponent")
 				<< "Exception occurred during notification for object '"
 				<< GetName() << "': " << DiagnosticInformation(ex);
 		}
+
+		lock.lock();
+
+		/* Notifications without an interval are due again right away; retry them
+		 * no more often than the former 5 second scan did. */
+		auto nit = m_IdleNotifications.find(notification);
+
+		if (nit != m_IdleNotifications.end() && nit->NextNotification <= Utility::GetTime()) {
+			nsi.NextNotification = Utility::GetTime() + 5;
+			m_IdleNotifications.erase(nit);
+			m_IdleNotifications.insert(nsi);
+		}
+	}
+}
+
+/**
+ * Sends a reminder notification if the notification's checkable is still
+ * in a problem state.
+ */
+void NotificationComponent::SendReminderNotification(const Notification::Ptr& notification)
+{
+	Checkable::Ptr checkable = notification->GetCheckable();
+
+	bool reachable = checkable->IsReachable(DependencyNotification);
+
+	{
+		ObjectLock olock(notification);
+		notification->SetNextNotification(Utility::GetTime() + notification->GetInterval());
+	}
+
+	{
+		Host::Ptr host;
+		Service::Ptr service;
+		tie(host, service) = GetHostService(checkable);
+
+		ObjectLock olock(checkable);
+
+		if (checkable->GetStateType() == StateTypeSoft)
+			return;
+
+		if ((service && service->GetState() == ServiceOK) || (!service && host->GetState() == HostUp))
+			return;
+
+		if (!reachable || checkable->IsInDowntime() || checkable->IsAcknowledged() || checkable->IsFlapping())
+			return;
 	}
+
+	Log(LogNotice, "NotificationComponent")
+		<< "Attempting to send reminder notification '" << notification->GetName() << "'";
+
+	notification->BeginExecuteNotification(NotificationProblem, checkable->GetLastCheckResult(), false, true);
+}
+
+bool NotificationComponent::IsSchedulable(const Notification::Ptr& notification) const
+{
+	return notification->IsActive() && !(notification->IsPaused() && GetEnableHA());
+}
+
+/**
+ * Returns whether a due notification can only become sendable through a
+ * change of its settings rather than the passing of time.
+ */
+bool NotificationComponent::IsParkable(const Notification::Ptr& notification)
+{
+	Checkable::Ptr checkable = notification->GetCheckable();
+
+	if (!IcingaApplication::GetInstance()->GetEnableNotifications() || !checkable->GetEnableNotifications())
+		return true;
+
+	return notification->GetInterval() <= 0 && notification->GetNoMoreNotifications();
+}
+
+/**
+ * Inserts the notification into the queue or updates its position.
+ *
+ * @threadsafety Caller must hold m_Mutex.
+ */
+void NotificationComponent::ScheduleNotification(const Notification::Ptr& notification)
+{
+	/* remove and re-insert the object from the set in order to force an index update */
+	m_IdleNotifications.erase(notification);
+
+	NotificationScheduleInfo nsi;
+	nsi.Object = notification;
+	nsi.NextNotification = notification->GetNextNotification();
+	m_IdleNotifications.insert(nsi);
+
+	m_CV.notify_all();
+}
+
+void NotificationComponent::UnparkNotification(const Notification::Ptr& notification)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (m_ParkedNotifications.erase(notification))
+		ScheduleNotification(notification);
+}
+
+void NotificationComponent::ObjectHandler(const ConfigObject::Ptr& object)
+{
+	Notification::Ptr notification = dynamic_pointer_cast<Notification>(object);
+
+	if (!notification)
+		return;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_ParkedNotifications.erase(notification);
+
+	if (IsSchedulable(notification))
+		ScheduleNotification(notification);
+	else
+		m_IdleNotifications.erase(notification);
+}
+
+void NotificationComponent::NextNotificationChangedHandler(const Notification::Ptr& notification)
+{
+	if (!IsSchedulable(notification))
+		return;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	/* Parked notifications are re-queued with their current time once they are unparked. */
+	if (m_ParkedNotifications.find(notification) != m_ParkedNotifications.end())
+		return;
+
+	ScheduleNotification(notification);
+}
+
+void NotificationComponent::CheckableNotificationsChangedHandler(const Checkable::Ptr& checkable)
+{
+	for (const Notification::Ptr& notification : checkable->GetNotifications())
+		UnparkNotification(notification);
+}
+
+void NotificationComponent::GlobalNotificationsChangedHandler()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	for (const Notification::Ptr& notification : m_ParkedNotifications)
+		ScheduleNotification(notification);
+
+	m_ParkedNotifications.clear();
 }
 
 /**
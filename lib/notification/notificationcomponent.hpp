@@ -23,11 +23,42 @@
 #include "notification/notificationcomponent-ti.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
-#include "base/timer.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/key_extractors.hpp>
+#include <set>
+#include <thread>
 
 namespace icinga
 {
 
+/**
+ * @ingroup notification
+ */
+struct NotificationScheduleInfo
+{
+	Notification::Ptr Object;
+	double NextNotification;
+};
+
+/**
+ * @ingroup notification
+ */
+struct NotificationNextNotificationExtractor
+{
+	typedef double result_type;
+
+	/**
+	 * @threadsafety Always.
+	 */
+	double operator()(const NotificationScheduleInfo& nsi)
+	{
+		return nsi.NextNotification;
+	}
+};
+
 /**
  * @ingroup notification
  */
@@ -37,15 +68,47 @@ public:
 	DECLARE_OBJECT(NotificationComponent);
 	DECLARE_OBJECTNAME(NotificationComponent);
 
+	typedef boost::multi_index_container<
+		NotificationScheduleInfo,
+		boost::multi_index::indexed_by<
+			boost::multi_index::ordered_unique<boost::multi_index::member<NotificationScheduleInfo, Notification::Ptr, &NotificationScheduleInfo::Object> >,
+			boost::multi_index::ordered_non_unique<NotificationNextNotificationExtractor>
+		>
+	> NotificationSet;
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
 private:
-	Timer::Ptr m_NotificationTimer;
+	boost::mutex m_Mutex;
+	boost::condition_variable m_CV;
+	bool m_Stopped{false};
+	std::thread m_Thread;
+
+	/* Notifications waiting for their next reminder, ordered by due time. */
+	NotificationSet m_IdleNotifications;
+
+	/* Due notifications which cannot be sent until notifications are enabled
+	 * again or their interval changes. */
+	std::set<Notification::Ptr> m_ParkedNotifications;
+
+	void NotificationThreadProc();
+	void SendReminderNotification(const Notification::Ptr& notification);
+
+	bool IsSchedulable(const Notification::Ptr& notification) const;
+	static bool IsParkable(const Notification::Ptr& notification);
+
+	void ScheduleNotification(const Notification::Ptr& notification);
+	void UnparkNotification(const Notification::Ptr& notification);
+
+	void ObjectHandler(const ConfigObject::Ptr& object);
+	void NextNotificationChangedHandler(const Notification::Ptr& notification);
+	void CheckableNotificationsChangedHandler(const Checkable::Ptr& checkable);
+	void GlobalNotificationsChangedHandler();
 
-	void NotificationTimerHandler();
 	void SendNotificationsHandler(const Checkable::Ptr& checkable, NotificationType type,
 		const CheckResult::Ptr& cr, const String& author, const String& text);
 };
@@ -0,0 +1,613 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "perfdata/batchwriter.hpp"
+#include "perfdata/batchwriter-ti.cpp"
+#include "base/application.hpp"
+#include "base/configtype.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/utility.hpp"
+#include "icinga/cib.hpp"
+#include <algorithm>
+
+using namespace icinga;
+
+REGISTER_TYPE(BatchWriter);
+
+void BatchWriter::OnConfigLoaded()
+{
+	ObjectImpl<BatchWriter>::OnConfigLoaded();
+
+	m_WorkQueue.SetName(GetReflectionType()->GetName() + ", " + GetName());
+}
+
+void BatchWriter::Start(bool runtimeCreated)
+{
+	ObjectImpl<BatchWriter>::Start(runtimeCreated);
+
+	String typeName = GetReflectionType()->GetName();
+
+	m_FlushLimit = GetFlushThreshold();
+
+	/* Only used by writers which send their batches synchronously. */
+	m_FlushQueue.reset(new WorkQueue(GetFlushConcurrency(), GetFlushConcurrency()));
+	m_FlushQueue->SetName(typeName + ", " + GetName() + ", Flush");
+
+	m_WorkQueue.SetExceptionCallback(std::bind(&BatchWriter::ExceptionHandler, this, _1));
+	m_FlushQueue->SetExceptionCallback(std::bind(&BatchWriter::ExceptionHandler, this, _1));
+
+	if (GetSpoolMaxSize() > 0) {
+		m_Spool.reset(new PerfdataSpool(Application::GetLocalStateDir() + "/spool/icinga2/" + typeName.ToLower() + "-" + GetName(), GetSpoolMaxSize()));
+
+		/* Replay batches which could not be sent while the backend was unavailable. */
+		m_SpoolTimer = new Timer("BatchWriter spool");
+		m_SpoolTimer->SetInterval(1);
+		m_SpoolTimer->OnTimerExpired.connect(std::bind(&BatchWriter::SpoolTimerHandler, this));
+		m_SpoolTimer->Start();
+	}
+
+	/* Setup timer for periodically flushing m_DataBuffer */
+	m_FlushTimer = new Timer("BatchWriter flush");
+	m_FlushTimer->SetInterval(GetFlushInterval());
+	m_FlushTimer->OnTimerExpired.connect(std::bind(&BatchWriter::FlushTimeout, this));
+	m_FlushTimer->Start();
+}
+
+void BatchWriter::Stop(bool runtimeRemoved)
+{
+	m_FlushTimer->Stop();
+
+	if (m_SpoolTimer)
+		m_SpoolTimer->Stop();
+
+	/* Send the remaining records. */
+	m_WorkQueue.Enqueue(std::bind(&BatchWriter::FlushTimeoutWQ, this), PriorityHigh);
+	m_WorkQueue.Join();
+	m_FlushQueue->Join();
+	WaitForPendingBatches(0);
+
+	ObjectImpl<BatchWriter>::Stop(runtimeRemoved);
+}
+
+void BatchWriter::AssertOnWorkQueue()
+{
+	ASSERT(m_WorkQueue.IsWorkerThread());
+}
+
+void BatchWriter::ExceptionHandler(boost::exception_ptr exp)
+{
+	Log(LogCritical, GetReflectionType()->GetName())
+		<< "Exception during " << GetReflectionType()->GetName() << " operation: Verify that your backend is operational!";
+
+	Log(LogDebug, GetReflectionType()->GetName())
+		<< "Exception during " << GetReflectionType()->GetName() << " operation: " << DiagnosticInformation(std::move(exp));
+}
+
+/**
+ * Buffers a record. The buffer is flushed once it holds flush_threshold
+ * records or flush_threshold_bytes bytes. Writers with a target send
+ * latency flush smaller batches while the backend is slow.
+ *
+ * @param record The formatted record.
+ */
+void BatchWriter::AddRecord(String record)
+{
+	AssertOnWorkQueue();
+
+	m_DataBufferBytes += record.GetLength();
+	m_DataBuffer.push_back(std::move(record));
+
+	/* Flush if we've buffered too much to prevent excessive memory use. */
+	if (static_cast<int>(m_DataBuffer.size()) >= m_FlushLimit
+		|| (GetFlushThresholdBytes() > 0 && m_DataBufferBytes >= static_cast<size_t>(GetFlushThresholdBytes()))) {
+		Log(LogDebug, GetReflectionType()->GetName())
+			<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
+
+		Flush();
+	}
+}
+
+void BatchWriter::FlushTimeout()
+{
+	m_WorkQueue.Enqueue(std::bind(&BatchWriter::FlushTimeoutWQ, this), PriorityHigh);
+}
+
+void BatchWriter::FlushTimeoutWQ()
+{
+	AssertOnWorkQueue();
+
+	PrunePerfdataSeries();
+
+	if (m_DataBuffer.empty())
+		return;
+
+	Log(LogDebug, GetReflectionType()->GetName())
+		<< "Timer expired writing " << m_DataBuffer.size() << " data points";
+
+	Flush();
+}
+
+/**
+ * Returns whether a perfdata value should be formatted and sent. Values
+ * are skipped if they were sent less than perfdata_min_interval seconds
+ * ago, or if perfdata_changes_only is set and neither the value nor its
+ * thresholds changed within the last perfdata_max_silence seconds.
+ *
+ * @param checkable The checkable.
+ * @param pdv The perfdata value.
+ * @param ts The check result's timestamp.
+ * @returns true if the value should be sent.
+ */
+bool BatchWriter::ShouldSendPerfdataValue(const Checkable::Ptr& checkable, const PerfdataValue::Ptr& pdv, double ts)
+{
+	AssertOnWorkQueue();
+
+	bool changesOnly = GetPerfdataChangesOnly();
+	int minInterval = GetPerfdataMinInterval();
+
+	if (!changesOnly && minInterval <= 0)
+		return true;
+
+	const Value values[] = { pdv->GetValue(), pdv->GetWarn(), pdv->GetCrit(), pdv->GetMin(), pdv->GetMax() };
+
+	String key = checkable->GetName() + "\n" + pdv->GetLabel();
+	auto it = m_PerfdataSeries.find(key);
+
+	if (it != m_PerfdataSeries.end()) {
+		PerfdataSeries& series = it->second;
+		series.LastSeen = ts;
+
+		double silence = ts - series.LastSent;
+
+		if (minInterval > 0 && silence < minInterval) {
+			m_PerfdataValuesSkipped++;
+			return false;
+		}
+
+		if (changesOnly && (GetPerfdataMaxSilence() <= 0 || silence < GetPerfdataMaxSilence())
+			&& std::equal(std::begin(values), std::end(values), series.Values)) {
+			m_PerfdataValuesSkipped++;
+			return false;
+		}
+	} else
+		it = m_PerfdataSeries.emplace(key, PerfdataSeries()).first;
+
+	PerfdataSeries& series = it->second;
+	std::copy(std::begin(values), std::end(values), series.Values);
+	series.LastSent = ts;
+	series.LastSeen = ts;
+
+	return true;
+}
+
+/**
+ * Forgets perfdata labels which were not seen for a day, e.g. because
+ * their checkable was deleted.
+ */
+void BatchWriter::PrunePerfdataSeries()
+{
+	double now = Utility::GetTime();
+
+	if (now - m_LastSeriesPrune < 3600)
+		return;
+
+	m_LastSeriesPrune = now;
+
+	for (auto it = m_PerfdataSeries.begin(); it != m_PerfdataSeries.end();) {
+		if (now - it->second.LastSeen > 86400)
+			it = m_PerfdataSeries.erase(it);
+		else
+			it++;
+	}
+}
+
+/**
+ * Hands the buffered records to the flush threads.
+ */
+void BatchWriter::Flush()
+{
+	AssertOnWorkQueue();
+
+	std::vector<String> records;
+	records.swap(m_DataBuffer);
+	m_DataBufferBytes = 0;
+
+	if (records.empty())
+		return;
+
+	String batch = FormatBatch(records);
+
+	m_BatchSize.Record(batch.GetLength());
+
+	if (m_Spool && ShouldSpool()) {
+		m_Spool->Append(batch);
+		return;
+	}
+
+	/* Without a spool further flushes wait while all batches are in flight. */
+	if (!m_Spool)
+		WaitForPendingBatches(GetFlushConcurrency() - 1);
+
+	SendOrSpool(batch);
+}
+
+/**
+ * Hands a batch which the backend could not accept yet back to the
+ * pipeline. The batch is spooled and replayed once the flush threads
+ * are idle.
+ *
+ * @param batch The batch.
+ */
+void BatchWriter::RequeueBatch(const String& batch)
+{
+	m_BatchesRequeued++;
+
+	if (m_Spool) {
+		m_Spool->Append(batch);
+		return;
+	}
+
+	Log(LogWarning, GetReflectionType()->GetName())
+		<< "Dropping " << batch.GetLength() << " bytes of data which the backend could not accept: The spool is disabled.";
+}
+
+/**
+ * Returns the send latency in seconds which the batch size is adjusted to,
+ * or 0 if the batch size only depends on the flush thresholds.
+ */
+double BatchWriter::GetTargetSendLatency() const
+{
+	return 0;
+}
+
+/**
+ * Joins records into a batch. Batches must remain valid when they are
+ * concatenated because spooled batches are replayed together.
+ *
+ * @param records The records.
+ * @returns The batch.
+ */
+String BatchWriter::FormatBatch(const std::vector<String>& records)
+{
+	size_t length = 0;
+
+	for (const String& record : records)
+		length += record.GetLength();
+
+	std::string batch;
+	batch.reserve(length);
+
+	for (const String& record : records)
+		batch += record.GetData();
+
+	return batch;
+}
+
+/**
+ * Sends a batch from one of the flush threads.
+ *
+ * @param batch The batch.
+ * @returns false if the backend was unavailable and the batch should be sent again later.
+ */
+bool BatchWriter::SendBatch(const String& /* batch */)
+{
+	BOOST_THROW_EXCEPTION(std::runtime_error(GetReflectionType()->GetName() + " does not implement SendBatch()."));
+}
+
+/**
+ * Sends a batch without blocking the calling thread. By default the batch
+ * is sent with SendBatch() from one of the flush threads.
+ *
+ * @param batch The batch.
+ * @param callback Called with the result of SendBatch() once the batch was sent.
+ */
+void BatchWriter::SendBatchAsync(const String& batch, const SendCallback& callback)
+{
+	m_FlushQueue->Enqueue([this, batch, callback]() {
+		bool sent = false;
+
+		try {
+			sent = SendBatch(batch);
+		} catch (const std::exception&) {
+			ExceptionHandler(boost::current_exception());
+		}
+
+		callback(sent);
+	});
+}
+
+/**
+ * Returns whether a new batch should go to the spool right away, either
+ * because the backend failed recently or because flush_concurrency batches
+ * are still waiting for the backend.
+ */
+bool BatchWriter::ShouldSpool()
+{
+	if (GetPendingBatches() >= static_cast<size_t>(GetFlushConcurrency()))
+		return true;
+
+	boost::mutex::scoped_lock lock(m_BackoffMutex);
+	return !m_BackendAvailable && Utility::GetTime() < m_NextRetry;
+}
+
+size_t BatchWriter::GetPendingBatches() const
+{
+	boost::mutex::scoped_lock lock(m_PendingBatchesMutex);
+	return m_PendingBatches;
+}
+
+/**
+ * Waits until no more than the specified number of batches are in flight.
+ */
+void BatchWriter::WaitForPendingBatches(size_t limit)
+{
+	boost::mutex::scoped_lock lock(m_PendingBatchesMutex);
+
+	while (m_PendingBatches > limit)
+		m_PendingBatchesCV.wait(lock);
+}
+
+void BatchWriter::SendOrSpool(const String& batch)
+{
+	SendAndRecord(batch, true, [this, batch](bool sent) {
+		if (!sent && m_Spool)
+			m_Spool->Append(batch);
+	});
+}
+
+/**
+ * Sends a batch and updates the statistics and the backoff once the
+ * backend answered.
+ *
+ * @param batch The batch.
+ * @param adjustFlushLimit Whether the send latency should change the batch size.
+ * @param callback Called with the result.
+ */
+void BatchWriter::SendAndRecord(const String& batch, bool adjustFlushLimit, const SendCallback& callback)
+{
+	{
+		boost::mutex::scoped_lock lock(m_PendingBatchesMutex);
+		m_PendingBatches++;
+	}
+
+	double start = Utility::GetTime();
+
+	SendBatchAsync(batch, [this, start, adjustFlushLimit, callback](bool sent) {
+		double now = Utility::GetTime();
+
+		m_SendLatency.Record(now - start);
+
+		if (sent && adjustFlushLimit)
+			AdjustFlushLimit(now - start);
+
+		{
+			boost::mutex::scoped_lock lock(m_BackoffMutex);
+
+			if (sent) {
+				m_BatchesSent++;
+
+				m_BackendAvailable = true;
+				m_RetryBackoff = 0;
+			} else {
+				m_BatchesFailed++;
+
+				/* Double the time until the next attempt, up to one minute. */
+				m_BackendAvailable = false;
+				m_RetryBackoff = std::min(60.0, std::max(1.0, m_RetryBackoff * 2));
+				m_NextRetry = now + m_RetryBackoff;
+			}
+		}
+
+		callback(sent);
+
+		boost::mutex::scoped_lock lock(m_PendingBatchesMutex);
+		m_PendingBatches--;
+		m_PendingBatchesCV.notify_all();
+	});
+}
+
+/**
+ * Halves the number of records per batch when a batch took longer than
+ * the target latency and grows it again up to flush_threshold while
+ * batches are fast.
+ *
+ * @param latency The time it took to send the last batch.
+ */
+void BatchWriter::AdjustFlushLimit(double latency)
+{
+	double target = GetTargetSendLatency();
+
+	if (target <= 0)
+		return;
+
+	int threshold = GetFlushThreshold();
+	int limit = m_FlushLimit;
+	int newLimit = limit;
+
+	if (latency > target)
+		newLimit = std::max(limit / 2, std::max(threshold / 64, 1));
+	else if (latency < target / 2)
+		newLimit = std::min(limit + limit / 4 + 1, threshold);
+
+	if (newLimit == limit)
+		return;
+
+	m_FlushLimit = newLimit;
+
+	Log(LogDebug, GetReflectionType()->GetName())
+		<< "Sending batches of up to " << newLimit << " records, last batch took " << latency << " seconds.";
+}
+
+void BatchWriter::SpoolTimerHandler()
+{
+	if (m_Spool->IsEmpty() || GetPendingBatches() > 0)
+		return;
+
+	{
+		boost::mutex::scoped_lock lock(m_BackoffMutex);
+
+		if (!m_BackendAvailable && Utility::GetTime() < m_NextRetry)
+			return;
+	}
+
+	if (m_ReplayingSpool.exchange(true))
+		return;
+
+	ReplaySpool(GetSpoolReplayRate());
+}
+
+/**
+ * Sends the oldest spooled batches one after another.
+ *
+ * @param remaining The number of batches which may still be sent.
+ */
+void BatchWriter::ReplaySpool(int remaining)
+{
+	unsigned long id;
+	String data;
+
+	if (remaining <= 0 || !m_Spool->ReadOldest(&id, &data)) {
+		m_ReplayingSpool = false;
+		return;
+	}
+
+	Log(LogNotice, GetReflectionType()->GetName())
+		<< "Replaying " << data.GetLength() << " bytes of spooled data.";
+
+	SendAndRecord(data, false, [this, id, remaining](bool sent) {
+		if (!sent) {
+			m_ReplayingSpool = false;
+			return;
+		}
+
+		m_Spool->Remove(id);
+		ReplaySpool(remaining - 1);
+	});
+}
+
+/**
+ * Returns the status of the pipeline and adds its performance data.
+ *
+ * @param perfdataPrefix The prefix for the performance data labels.
+ * @param perfdata Returns the performance data.
+ * @returns The status.
+ */
+Dictionary::Ptr BatchWriter::GetPipelineStats(const String& perfdataPrefix, const Array::Ptr& perfdata) const
+{
+	size_t workQueueItems = m_WorkQueue.GetLength();
+	double workQueueItemRate = const_cast<WorkQueue&>(m_WorkQueue).GetTaskCount(60) / 60.0;
+	size_t dataBufferItems = m_DataBuffer.size();
+	size_t flushQueueItems = GetPendingBatches();
+	uint_fast64_t batchesSent = m_BatchesSent;
+	uint_fast64_t batchesFailed = m_BatchesFailed;
+	uint_fast64_t batchesRequeued = m_BatchesRequeued;
+	int flushLimit = m_FlushLimit;
+	uint_fast64_t perfdataValuesSkipped = m_PerfdataValuesSkipped;
+
+	size_t spoolSegments = 0;
+	size_t spoolBytes = 0;
+	double spoolAge = 0;
+
+	if (m_Spool) {
+		spoolSegments = m_Spool->GetSegmentCount();
+		spoolBytes = m_Spool->GetSize();
+		spoolAge = m_Spool->GetAge();
+	}
+
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_work_queue_items", workQueueItems));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_work_queue_item_rate", workQueueItemRate));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_data_queue_items", dataBufferItems));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_flush_queue_items", flushQueueItems));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_batches_sent", batchesSent, false, "c"));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_batches_failed", batchesFailed, false, "c"));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_batches_requeued", batchesRequeued, false, "c"));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_flush_limit", flushLimit));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_perfdata_values_skipped", perfdataValuesSkipped, false, "c"));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_send_latency", m_SendLatency.GetPercentile(95), false, "s"));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_spool_segments", spoolSegments));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_spool_bytes", spoolBytes, false, "B"));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_spool_age", spoolAge, false, "s"));
+
+	return new Dictionary({
+		{ "work_queue_items", workQueueItems },
+		{ "work_queue_item_rate", workQueueItemRate },
+		{ "data_buffer_items", dataBufferItems },
+		{ "flush_queue_items", flushQueueItems },
+		{ "batches_sent", batchesSent },
+		{ "batches_failed", batchesFailed },
+		{ "batches_requeued", batchesRequeued },
+		{ "flush_limit", flushLimit },
+		{ "perfdata_values_skipped", perfdataValuesSkipped },
+		{ "batch_size", CIB::GetHistogramStats(m_BatchSize) },
+		{ "send_latency", CIB::GetHistogramStats(m_SendLatency) },
+		{ "spool_segments", spoolSegments },
+		{ "spool_bytes", spoolBytes },
+		{ "spool_age", spoolAge }
+	});
+}
+
+void BatchWriter::ValidateFlushInterval(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<BatchWriter>::ValidateFlushInterval(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "flush_interval" }, "Value must be greater than 0."));
+}
+
+void BatchWriter::ValidateFlushConcurrency(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<BatchWriter>::ValidateFlushConcurrency(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "flush_concurrency" }, "Value must be greater than 0."));
+}
+
+void BatchWriter::ValidateSpoolMaxSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<BatchWriter>::ValidateSpoolMaxSize(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "spool_max_size" }, "Value must not be negative."));
+}
+
+void BatchWriter::ValidateSpoolReplayRate(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<BatchWriter>::ValidateSpoolReplayRate(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "spool_replay_rate" }, "Value must be greater than 0."));
+}
+
+void BatchWriter::ValidatePerfdataMaxSilence(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<BatchWriter>::ValidatePerfdataMaxSilence(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "perfdata_max_silence" }, "Value must not be negative."));
+}
+
+void BatchWriter::ValidatePerfdataMinInterval(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<BatchWriter>::ValidatePerfdataMinInterval(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "perfdata_min_interval" }, "Value must not be negative."));
+}
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef BATCHWRITER_H
+#define BATCHWRITER_H
+
+#include "perfdata/batchwriter-ti.hpp"
+#include "perfdata/perfdataspool.hpp"
+#include "icinga/checkable.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/histogram.hpp"
+#include "base/timer.hpp"
+#include "base/workqueue.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <atomic>
+#include <map>
+
+namespace icinga
+{
+
+/**
+ * The common pipeline of the perfdata writers. Records are buffered on the
+ * work queue and sent in batches, up to flush_concurrency at a time.
+ * Batches which cannot be sent are spooled to disk and replayed once the
+ * backend is available again.
+ *
+ * Derived classes format the records and either implement SendBatch(),
+ * which is called from a pool of flush threads, or send the batches
+ * asynchronously in SendBatchAsync().
+ *
+ * @ingroup perfdata
+ */
+class BatchWriter : public ObjectImpl<BatchWriter>
+{
+public:
+	DECLARE_OBJECT(BatchWriter);
+
+	void ValidateFlushInterval(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateFlushConcurrency(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateSpoolMaxSize(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateSpoolReplayRate(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidatePerfdataMaxSilence(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidatePerfdataMinInterval(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
+protected:
+	WorkQueue m_WorkQueue{10000000, 1};
+
+	void OnConfigLoaded() override;
+	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+
+	void AddRecord(String record);
+	void Flush();
+	void AssertOnWorkQueue();
+
+	bool ShouldSendPerfdataValue(const Checkable::Ptr& checkable, const PerfdataValue::Ptr& pdv, double ts);
+
+	Dictionary::Ptr GetPipelineStats(const String& perfdataPrefix, const Array::Ptr& perfdata) const;
+
+	void RequeueBatch(const String& batch);
+
+	typedef std::function<void (bool)> SendCallback;
+
+	virtual String FormatBatch(const std::vector<String>& records);
+	virtual bool SendBatch(const String& batch);
+	virtual void SendBatchAsync(const String& batch, const SendCallback& callback);
+	virtual double GetTargetSendLatency() const;
+	virtual void ExceptionHandler(boost::exception_ptr exp);
+
+private:
+	/**
+	 * The last value of a perfdata label which was sent to the backend.
+	 */
+	struct PerfdataSeries
+	{
+		Value Values[5];
+		double LastSent;
+		double LastSeen;
+	};
+
+	std::unique_ptr<WorkQueue> m_FlushQueue;
+	Timer::Ptr m_FlushTimer;
+	std::vector<String> m_DataBuffer;
+	size_t m_DataBufferBytes{0};
+	std::atomic<int> m_FlushLimit{0};
+
+	std::unique_ptr<PerfdataSpool> m_Spool;
+	Timer::Ptr m_SpoolTimer;
+	std::atomic<bool> m_ReplayingSpool{false};
+
+	mutable boost::mutex m_PendingBatchesMutex;
+	boost::condition_variable m_PendingBatchesCV;
+	size_t m_PendingBatches{0};
+
+	boost::mutex m_BackoffMutex;
+	bool m_BackendAvailable{true};
+	double m_RetryBackoff{0};
+	double m_NextRetry{0};
+
+	std::map<String, PerfdataSeries> m_PerfdataSeries;
+	double m_LastSeriesPrune{0};
+	std::atomic<uint_fast64_t> m_PerfdataValuesSkipped{0};
+
+	std::atomic<uint_fast64_t> m_BatchesSent{0};
+	std::atomic<uint_fast64_t> m_BatchesFailed{0};
+	std::atomic<uint_fast64_t> m_BatchesRequeued{0};
+	Histogram m_SendLatency;
+	Histogram m_BatchSize;
+
+	void FlushTimeout();
+	void FlushTimeoutWQ();
+	void PrunePerfdataSeries();
+	void SendOrSpool(const String& batch);
+	void SendAndRecord(const String& batch, bool adjustFlushLimit, const SendCallback& callback);
+	void AdjustFlushLimit(double latency);
+	bool ShouldSpool();
+	size_t GetPendingBatches() const;
+	void WaitForPendingBatches(size_t limit);
+	void SpoolTimerHandler();
+	void ReplaySpool(int remaining);
+};
+
+}
+
+#endif /* BATCHWRITER_H */
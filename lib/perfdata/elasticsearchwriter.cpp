@@ -22,6 +22,7 @@
 #include "remote/url.hpp"
 #include "remote/httprequest.hpp"
 #include "remote/httpresponse.hpp"
+#include "remote/httputility.hpp"
 #include "icinga/compatutility.hpp"
 #include "icinga/service.hpp"
 #include "icinga/checkcommand.hpp"
@@ -29,6 +30,7 @@
 #include "base/stream.hpp"
 #include "base/base64.hpp"
 #include "base/json.hpp"
+#include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/networkstream.hpp"
 #include "base/perfdatavalue.hpp"
@@ -36,6 +38,7 @@
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/scoped_array.hpp>
+#include <algorithm>
 #include <utility>
 
 using namespace icinga;
@@ -44,28 +47,24 @@ REGISTER_TYPE(ElasticsearchWriter);
 
 REGISTER_STATSFUNCTION(ElasticsearchWriter, &ElasticsearchWriter::StatsFunc);
 
-void ElasticsearchWriter::OnConfigLoaded()
-{
-	ObjectImpl<ElasticsearchWriter>::OnConfigLoaded();
-
-	m_WorkQueue.SetName("ElasticsearchWriter, " + GetName());
-}
-
 void ElasticsearchWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const ElasticsearchWriter::Ptr& elasticsearchwriter : ConfigType::GetObjectsByType<ElasticsearchWriter>()) {
-		size_t workQueueItems = elasticsearchwriter->m_WorkQueue.GetLength();
-		double workQueueItemRate = elasticsearchwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		String prefix = "elasticsearchwriter_" + elasticsearchwriter->GetName();
+		Dictionary::Ptr stats = elasticsearchwriter->GetPipelineStats(prefix, perfdata);
 
-		nodes.emplace_back(elasticsearchwriter->GetName(), new Dictionary({
-			{ "work_queue_items", workQueueItems },
-			{ "work_queue_item_rate", workQueueItemRate }
-		}));
+		uint_fast64_t itemsRetried = elasticsearchwriter->m_ItemsRetried;
+		uint_fast64_t itemsRejected = elasticsearchwriter->m_ItemsRejected;
 
-		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_work_queue_items", workQueueItems));
-		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		stats->Set("bulk_items_retried", itemsRetried);
+		stats->Set("bulk_items_rejected", itemsRejected);
+
+		perfdata->Add(new PerfdataValue(prefix + "_bulk_items_retried", itemsRetried, false, "c"));
+		perfdata->Add(new PerfdataValue(prefix + "_bulk_items_rejected", itemsRejected, false, "c"));
+
+		nodes.emplace_back(elasticsearchwriter->GetName(), stats);
 	}
 
 	status->Set("elasticsearchwriter", new Dictionary(std::move(nodes)));
@@ -80,18 +79,24 @@ void ElasticsearchWriter::Start(bool runtimeCreated)
 	Log(LogInformation, "ElasticsearchWriter")
 		<< "'" << GetName() << "' started.";
 
-	m_WorkQueue.SetExceptionCallback(std::bind(&ElasticsearchWriter::ExceptionHandler, this, _1));
+	/* Writers which send to the same server share their connections. */
+	String key = (GetEnableTls() ? "https://" : "http://") + GetHost() + ":" + GetPort()
+		+ (GetEnableTls() ? "\n" + GetCertPath() + "\n" + GetKeyPath() + "\n" + GetCaPath() : "");
+
+	m_Connections = HttpConnectionPool::GetShared(key, std::bind(&ElasticsearchWriter::Connect, GetHost(), GetPort(),
+		GetEnableTls(), GetCertPath(), GetKeyPath(), GetCaPath()), GetFlushConcurrency());
+
+	m_BulkRetries = new DeadlineQueue(std::bind(&ElasticsearchWriter::BulkRetryHandler, this, _1), 1);
+	m_BulkRetries->Start();
 
-	/* Setup timer for periodically flushing m_DataBuffer */
-	m_FlushTimer = new Timer();
-	m_FlushTimer->SetInterval(GetFlushInterval());
-	m_FlushTimer->OnTimerExpired.connect(std::bind(&ElasticsearchWriter::FlushTimeout, this));
-	m_FlushTimer->Start();
-	m_FlushTimer->Reschedule(0);
+	if (GetEnableCompression() && !HttpUtility::IsCompressionSupported()) {
+		Log(LogWarning, "ElasticsearchWriter")
+			<< "Compression is not supported by this build. Sending uncompressed data to Elasticsearch.";
+	}
 
 	/* Register for new metrics. */
-	Checkable::OnNewCheckResult.connect(std::bind(&ElasticsearchWriter::CheckResultHandler, this, _1, _2));
-	Checkable::OnStateChange.connect(std::bind(&ElasticsearchWriter::StateChangeHandler, this, _1, _2, _3));
+	CheckResultBatcher::OnNewCheckResults.connect(std::bind(&ElasticsearchWriter::CheckResultHandler, this, _1), "ElasticsearchWriter::CheckResultHandler");
+	Checkable::OnStateChange.connect(std::bind(&ElasticsearchWriter::StateChangeHandler, this, _1, _2, _3), "ElasticsearchWriter::StateChangeHandler");
 	Checkable::OnNotificationSentToAllUsers.connect(std::bind(&ElasticsearchWriter::NotificationSentToAllUsersHandler, this, _1, _2, _3, _4, _5, _6, _7));
 }
 
@@ -100,12 +105,13 @@ void ElasticsearchWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "ElasticsearchWriter")
 		<< "'" << GetName() << "' stopped.";
 
-	m_WorkQueue.Join();
-
 	ObjectImpl<ElasticsearchWriter>::Stop(runtimeRemoved);
+
+	m_BulkRetries->Stop();
+	m_Connections.reset();
 }
 
-void ElasticsearchWriter::AddCheckResult(const Dictionary::Ptr& fields, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void ElasticsearchWriter::AddCheckResult(const Dictionary::Ptr& fields, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, bool filterPerfdata)
 {
 	String prefix = "check_result.";
 
@@ -129,26 +135,24 @@ void ElasticsearchWriter::AddCheckResult(const Dictionary::Ptr& fields, const Ch
 	if (!GetEnableSendPerfdata())
 		return;
 
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	Array::Ptr perfdata = cr->GetParsedPerformanceData();
 
 	if (perfdata) {
 		ObjectLock olock(perfdata);
 		for (const Value& val : perfdata) {
-			PerfdataValue::Ptr pdv;
-
-			if (val.IsObjectType<PerfdataValue>())
-				pdv = val;
-			else {
-				try {
-					pdv = PerfdataValue::Parse(val);
-				} catch (const std::exception&) {
-					Log(LogWarning, "ElasticsearchWriter")
-						<< "Ignoring invalid perfdata value: '" << val << "' for object '"
-						<< checkable->GetName() << "'.";
-					continue;
-				}
+			if (!val.IsObjectType<PerfdataValue>()) {
+				Log(LogWarning, "ElasticsearchWriter")
+					<< "Ignoring invalid perfdata value: '" << val << "' for object '"
+					<< checkable->GetName() << "'.";
+				continue;
 			}
 
+			PerfdataValue::Ptr pdv = val;
+
+			/* Only the check result events are filtered, state changes and notifications keep all values. */
+			if (filterPerfdata && !ShouldSendPerfdataValue(checkable, pdv, cr->GetExecutionEnd()))
+				continue;
+
 			String escapedKey = pdv->GetLabel();
 			boost::replace_all(escapedKey, " ", "_");
 			boost::replace_all(escapedKey, ".", "_");
@@ -174,9 +178,10 @@ void ElasticsearchWriter::AddCheckResult(const Dictionary::Ptr& fields, const Ch
 	}
 }
 
-void ElasticsearchWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void ElasticsearchWriter::CheckResultHandler(const CheckResultBatch& batch)
 {
-	m_WorkQueue.Enqueue(std::bind(&ElasticsearchWriter::InternalCheckResultHandler, this, checkable, cr));
+	CheckResultBatcher::Handler handler = std::bind(&ElasticsearchWriter::InternalCheckResultHandler, this, _1, _2);
+	m_WorkQueue.Enqueue(std::bind(&CheckResultBatcher::ForEach, batch, handler));
 }
 
 void ElasticsearchWriter::InternalCheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -221,7 +226,7 @@ void ElasticsearchWriter::InternalCheckResultHandler(const Checkable::Ptr& check
 	double ts = Utility::GetTime();
 
 	if (cr) {
-		AddCheckResult(fields, checkable, cr);
+		AddCheckResult(fields, checkable, cr, true);
 		ts = cr->GetExecutionEnd();
 	}
 
@@ -268,7 +273,7 @@ void ElasticsearchWriter::StateChangeHandlerInternal(const Checkable::Ptr& check
 	double ts = Utility::GetTime();
 
 	if (cr) {
-		AddCheckResult(fields, checkable, cr);
+		AddCheckResult(fields, checkable, cr, false);
 		ts = cr->GetExecutionEnd();
 	}
 
@@ -334,7 +339,7 @@ void ElasticsearchWriter::NotificationSentToAllUsersHandlerInternal(const Notifi
 	double ts = Utility::GetTime();
 
 	if (cr) {
-		AddCheckResult(fields, checkable, cr);
+		AddCheckResult(fields, checkable, cr, false);
 		ts = cr->GetExecutionEnd();
 	}
 
@@ -343,9 +348,6 @@ void ElasticsearchWriter::NotificationSentToAllUsersHandlerInternal(const Notifi
 
 void ElasticsearchWriter::Enqueue(const String& type, const Dictionary::Ptr& fields, double ts)
 {
-	/* Atomically buffer the data point. */
-	boost::mutex::scoped_lock lock(m_DataBufferMutex);
-
 	/* Format the timestamps to dynamically select the date datatype inside the index. */
 	fields->Set("@timestamp", FormatTimestamp(ts));
 	fields->Set("timestamp", FormatTimestamp(ts));
@@ -362,48 +364,26 @@ void ElasticsearchWriter::Enqueue(const String& type, const Dictionary::Ptr& fie
 	Log(LogDebug, "ElasticsearchWriter")
 		<< "Add to fields to message list: '" << fieldsBody << "'.";
 
-	m_DataBuffer.emplace_back(indexBody + fieldsBody);
-
-	/* Flush if we've buffered too much to prevent excessive memory use. */
-	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
-		Log(LogDebug, "ElasticsearchWriter")
-			<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
-		Flush();
-	}
-}
-
-void ElasticsearchWriter::FlushTimeout()
-{
-	/* Prevent new data points from being added to the array, there is a
-	 * race condition where they could disappear.
-	 */
-	boost::mutex::scoped_lock lock(m_DataBufferMutex);
-
-	/* Flush if there are any data available. */
-	if (m_DataBuffer.size() > 0) {
-		Log(LogDebug, "ElasticsearchWriter")
-			<< "Timer expired writing " << m_DataBuffer.size() << " data points";
-		Flush();
-	}
-}
-
-void ElasticsearchWriter::Flush()
-{
-	/* Ensure you hold a lock against m_DataBuffer so that things
-	 * don't go missing after creating the body and clearing the buffer.
-	 */
-	String body = boost::algorithm::join(m_DataBuffer, "\n");
-	m_DataBuffer.clear();
-
-	/* Elasticsearch 6.x requires a new line. This is compatible to 5.x.
-	 * Tested with 6.0.0 and 5.6.4.
+	/* Elasticsearch 6.x requires a new line after each document. This is
+	 * compatible to 5.x. Tested with 6.0.0 and 5.6.4.
 	 */
-	body += "\n";
-
-	SendRequest(body);
+	AddRecord(indexBody + fieldsBody + "\n");
 }
 
-void ElasticsearchWriter::SendRequest(const String& body)
+/**
+ * Sends a batch of documents to Elasticsearch.
+ *
+ * @param body The bulk request body.
+ * @returns false if Elasticsearch was unavailable and the body should be sent again later.
+ */
+/**
+ * Sends a bulk request.
+ *
+ * @param body The bulk request body.
+ * @param callback Called with the HTTP status code, or 0 if the request could
+ * not be sent, and the response body of successful requests.
+ */
+void ElasticsearchWriter::SendBulkRequest(const String& body, const BulkResponseCallback& callback)
 {
 	Url::Ptr url = new Url();
 
@@ -428,74 +408,227 @@ void ElasticsearchWriter::SendRequest(const String& body)
 
 	url->SetPath(path);
 
-	Stream::Ptr stream;
-
-	try {
-		stream = Connect();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Flush failed, cannot connect to Elasticsearch.";
-		return;
-	}
-
-	if (!stream)
-		return;
-
-	HttpRequest req(stream);
-
-	/* Specify required headers by Elasticsearch. */
-	req.AddHeader("Accept", "application/json");
-	req.AddHeader("Content-Type", "application/json");
-
 	/* Send authentication if configured. */
 	String username = GetUsername();
 	String password = GetPassword();
 
-	if (!username.IsEmpty() && !password.IsEmpty())
-		req.AddHeader("Authorization", "Basic " + Base64::Encode(username + ":" + password));
-
-	req.RequestMethod = "POST";
-	req.RequestUrl = url;
+	bool compress = GetEnableCompression() && HttpUtility::IsCompressionSupported();
+	String data = compress ? HttpUtility::GzipCompress(body) : body;
 
 	/* Don't log the request body to debug log, this is already done above. */
 	Log(LogDebug, "ElasticsearchWriter")
-		<< "Sending " << req.RequestMethod << " request" << ((!username.IsEmpty() && !password.IsEmpty()) ? " with basic auth" : "" )
+		<< "Sending POST request" << ((!username.IsEmpty() && !password.IsEmpty()) ? " with basic auth" : "" )
 		<< " to '" << url->Format() << "'.";
 
+	auto result = std::make_shared<std::pair<int, String> >(0, String());
+	ElasticsearchWriter::Ptr self = this;
+
+	m_Connections->SubmitRequest([url, data, username, password, compress](HttpRequest& req) {
+		/* Specify required headers by Elasticsearch. */
+		req.AddHeader("Accept", "application/json");
+		req.AddHeader("Content-Type", "application/json");
+
+		if (compress)
+			req.AddHeader("Content-Encoding", "gzip");
+
+		if (!username.IsEmpty() && !password.IsEmpty())
+			req.AddHeader("Authorization", "Basic " + Base64::Encode(username + ":" + password));
+
+		req.RequestMethod = "POST";
+		req.RequestUrl = url;
+
+		req.WriteBody(data.CStr(), data.GetLength());
+	}, [self, result](HttpResponse& resp) {
+		result->first = resp.StatusCode;
+
+		if (resp.StatusCode <= 299) {
+			size_t responseSize = resp.GetBodySize();
+			boost::scoped_array<char> buffer(new char[responseSize]);
+			resp.ReadBody(buffer.get(), responseSize);
+			result->second = String(buffer.get(), buffer.get() + responseSize);
+		} else if (resp.StatusCode != 429)
+			self->ProcessResponse(resp);
+	}, [self, result, callback](boost::exception_ptr exp) {
+		if (exp) {
+			Log(LogWarning, "ElasticsearchWriter")
+				<< "Flush failed, cannot send data to Elasticsearch on host '" << self->GetHost() << "' port '" << self->GetPort() << "': " << DiagnosticInformation(exp, false);
+		}
+
+		callback(result->first, result->second);
+	});
+}
+
+void ElasticsearchWriter::SendBatchAsync(const String& body, const SendCallback& callback)
+{
+	SendBulk(body, 0, callback);
+}
+
+/**
+ * Sends a batch. Documents which Elasticsearch rejects because its queues
+ * are full (429 Too Many Requests) are sent again after a short delay.
+ * The batch is still in flight meanwhile, so new batches are held back.
+ * Documents which are still rejected after bulk_max_retries attempts are
+ * spooled.
+ *
+ * @param batch The batch.
+ * @param attempt The number of times the batch was sent before.
+ * @param callback Called with whether the batch was sent.
+ */
+void ElasticsearchWriter::SendBulk(const String& batch, int attempt, const SendCallback& callback)
+{
+	ElasticsearchWriter::Ptr self = this;
+
+	SendBulkRequest(batch, [self, batch, attempt, callback](int statusCode, const String& response) {
+		if (statusCode == 0) {
+			callback(false);
+			return;
+		}
+
+		String throttled;
+
+		/* Server errors are temporary, other errors would happen again. */
+		if (statusCode == 429)
+			throttled = batch;
+		else if (statusCode > 299) {
+			callback(statusCode < 500);
+			return;
+		} else
+			throttled = self->GetThrottledItems(batch, response);
+
+		if (throttled.IsEmpty()) {
+			callback(true);
+			return;
+		}
+
+		if (attempt >= self->GetBulkMaxRetries() || !self->IsActive()) {
+			/* Spool the whole batch and back off if nothing was accepted. */
+			if (statusCode == 429) {
+				callback(false);
+				return;
+			}
+
+			self->RequeueBatch(throttled);
+			callback(true);
+			return;
+		}
+
+		double delay = std::min(0.5 * (1 << attempt), 10.0);
+
+		Log(LogNotice, "ElasticsearchWriter")
+			<< "Elasticsearch is overloaded, sending " << throttled.GetLength() << " bytes again in " << delay << " seconds.";
+
+		BulkRetry::Ptr retry = new BulkRetry();
+		retry->Batch = throttled;
+		retry->Attempt = attempt + 1;
+		retry->Callback = callback;
+
+		self->m_BulkRetries->Set(retry, Utility::GetTime() + delay);
+	});
+}
+
+void ElasticsearchWriter::BulkRetryHandler(const Object::Ptr& object)
+{
+	BulkRetry::Ptr retry = static_pointer_cast<BulkRetry>(object);
+
+	SendBulk(retry->Batch, retry->Attempt, retry->Callback);
+}
+
+/**
+ * Checks the per-item results of a bulk request.
+ *
+ * @param body The bulk request body.
+ * @param response The response body.
+ * @returns The actions and documents which were rejected with status 429.
+ */
+String ElasticsearchWriter::GetThrottledItems(const String& body, const String& response)
+{
+	Dictionary::Ptr result;
+
 	try {
-		req.WriteBody(body.CStr(), body.GetLength());
-		req.Finish();
-	} catch (const std::exception& ex) {
+		result = JsonDecode(response);
+	} catch (...) {
 		Log(LogWarning, "ElasticsearchWriter")
-			<< "Cannot write to HTTP API on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw ex;
+			<< "Unable to parse JSON response:\n" << response;
+		return String();
 	}
 
-	HttpResponse resp(stream, req);
-	StreamReadContext context;
+	if (!result || !result->Get("errors").ToBool())
+		return String();
 
-	try {
-		resp.Parse(context, true);
-		while (resp.Parse(context, true) && !resp.Complete)
-			; /* Do nothing */
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex, false);
-		throw ex;
+	Array::Ptr items = result->Get("items");
+
+	if (!items)
+		return String();
+
+	std::string throttled;
+	size_t rejected = 0;
+	String reason;
+	size_t pos = 0;
+
+	ObjectLock olock(items);
+	for (const Dictionary::Ptr& item : items) {
+		/* Each item belongs to one action line and one document line. */
+		size_t actionEnd = body.Find("\n", pos);
+
+		if (actionEnd == String::NPos)
+			break;
+
+		size_t documentEnd = body.Find("\n", actionEnd + 1);
+
+		if (documentEnd == String::NPos)
+			break;
+
+		Dictionary::Ptr action;
+
+		if (item)
+			action = item->Get("index");
+
+		int status = action ? static_cast<int>(action->Get("status")) : 0;
+
+		if (status == 429)
+			throttled += body.SubStr(pos, documentEnd + 1 - pos).GetData();
+		else if (status > 299) {
+			rejected++;
+
+			if (reason.IsEmpty()) {
+				Value error = action->Get("error");
+
+				if (error.IsObjectType<Dictionary>())
+					reason = static_cast<Dictionary::Ptr>(error)->Get("reason");
+				else
+					reason = error;
+			}
+		}
+
+		pos = documentEnd + 1;
 	}
 
-	if (!resp.Complete) {
+	if (rejected > 0) {
+		m_ItemsRejected += rejected;
+
 		Log(LogWarning, "ElasticsearchWriter")
-			<< "Failed to read a complete HTTP response from the Elasticsearch server.";
-		return;
+			<< "Elasticsearch rejected " << rejected << " documents: " << reason;
 	}
 
+	if (!throttled.empty())
+		m_ItemsRetried += std::count(throttled.begin(), throttled.end(), '\n') / 2;
+
+	return throttled;
+}
+
+double ElasticsearchWriter::GetTargetSendLatency() const
+{
+	return GetBulkTargetLatency();
+}
+
+void ElasticsearchWriter::ProcessResponse(HttpResponse& resp)
+{
 	if (resp.StatusCode > 299) {
 		if (resp.StatusCode == 401) {
 			/* More verbose error logging with Elasticsearch is hidden behind a proxy. */
-			if (!username.IsEmpty() && !password.IsEmpty()) {
+			if (!GetUsername().IsEmpty() && !GetPassword().IsEmpty()) {
 				Log(LogCritical, "ElasticsearchWriter")
-					<< "401 Unauthorized. Please ensure that the user '" << username
+					<< "401 Unauthorized. Please ensure that the user '" << GetUsername()
 					<< "' is able to authenticate against the HTTP API/Proxy.";
 			} else {
 				Log(LogCritical, "ElasticsearchWriter")
@@ -539,39 +672,40 @@ void ElasticsearchWriter::SendRequest(const String& body)
 	}
 }
 
-Stream::Ptr ElasticsearchWriter::Connect()
+Stream::Ptr ElasticsearchWriter::Connect(const String& host, const String& port, bool tls,
+	const String& certPath, const String& keyPath, const String& caPath)
 {
 	TcpSocket::Ptr socket = new TcpSocket();
 
 	Log(LogNotice, "ElasticsearchWriter")
-		<< "Connecting to Elasticsearch on host '" << GetHost() << "' port '" << GetPort() << "'.";
+		<< "Connecting to Elasticsearch on host '" << host << "' port '" << port << "'.";
 
 	try {
-		socket->Connect(GetHost(), GetPort());
+		socket->Connect(host, port);
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "ElasticsearchWriter")
-			<< "Can't connect to Elasticsearch on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			<< "Can't connect to Elasticsearch on host '" << host << "' port '" << port << "'.";
 		throw ex;
 	}
 
-	if (GetEnableTls()) {
+	if (tls) {
 		std::shared_ptr<SSL_CTX> sslContext;
 
 		try {
-			sslContext = MakeSSLContext(GetCertPath(), GetKeyPath(), GetCaPath());
+			sslContext = MakeSSLContext(certPath, keyPath, caPath);
 		} catch (const std::exception& ex) {
 			Log(LogWarning, "ElasticsearchWriter")
 				<< "Unable to create SSL context.";
 			throw ex;
 		}
 
-		TlsStream::Ptr tlsStream = new TlsStream(socket, GetHost(), RoleClient, sslContext);
+		TlsStream::Ptr tlsStream = new TlsStream(socket, host, RoleClient, sslContext);
 
 		try {
 			tlsStream->Handshake();
 		} catch (const std::exception& ex) {
 			Log(LogWarning, "ElasticsearchWriter")
-				<< "TLS handshake with host '" << GetHost() << "' on port " << GetPort() << " failed.";
+				<< "TLS handshake with host '" << host << "' on port " << port << " failed.";
 			throw ex;
 		}
 
@@ -581,19 +715,6 @@ Stream::Ptr ElasticsearchWriter::Connect()
 	}
 }
 
-void ElasticsearchWriter::AssertOnWorkQueue()
-{
-	ASSERT(m_WorkQueue.IsWorkerThread());
-}
-
-void ElasticsearchWriter::ExceptionHandler(boost::exception_ptr exp)
-{
-	Log(LogCritical, "ElasticsearchWriter", "Exception during Elastic operation: Verify that your backend is operational!");
-
-	Log(LogDebug, "ElasticsearchWriter")
-		<< "Exception during Elasticsearch operation: " << DiagnosticInformation(std::move(exp));
-}
-
 String ElasticsearchWriter::FormatTimestamp(double ts)
 {
 	/* The date format must match the default dynamic date detection
@@ -611,3 +732,19 @@ String ElasticsearchWriter::FormatTimestamp(double ts)
 
 	return Utility::FormatDateTime("%Y-%m-%dT%H:%M:%S", ts) + "." + Convert::ToString(milliSeconds) + Utility::FormatDateTime("%z", ts);
 }
+
+void ElasticsearchWriter::ValidateBulkTargetLatency(const Lazy<double>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ElasticsearchWriter>::ValidateBulkTargetLatency(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "bulk_target_latency" }, "Value must not be negative."));
+}
+
+void ElasticsearchWriter::ValidateBulkMaxRetries(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ElasticsearchWriter>::ValidateBulkMaxRetries(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "bulk_max_retries" }, "Value must not be negative."));
+}
@@ -22,9 +22,10 @@
 
 #include "perfdata/elasticsearchwriter-ti.hpp"
 #include "icinga/service.hpp"
-#include "base/configobject.hpp"
-#include "base/workqueue.hpp"
-#include "base/timer.hpp"
+#include "icinga/checkresultbatcher.hpp"
+#include "remote/httpconnectionpool.hpp"
+#include "base/deadlinequeue.hpp"
+#include <atomic>
 
 namespace icinga
 {
@@ -39,23 +40,43 @@ public:
 
 	static String FormatTimestamp(double ts);
 
+	void ValidateBulkTargetLatency(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
+	void ValidateBulkMaxRetries(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 protected:
-	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
+	void SendBatchAsync(const String& body, const SendCallback& callback) override;
+	double GetTargetSendLatency() const override;
+
 private:
+	/**
+	 * Documents which are sent again after Elasticsearch was overloaded.
+	 */
+	class BulkRetry final : public Object
+	{
+	public:
+		DECLARE_PTR_TYPEDEFS(BulkRetry);
+
+		String Batch;
+		int Attempt;
+		SendCallback Callback;
+	};
+
+	typedef std::function<void (int, const String&)> BulkResponseCallback;
+
 	String m_EventPrefix;
-	WorkQueue m_WorkQueue{10000000, 1};
-	Timer::Ptr m_FlushTimer;
-	std::vector<String> m_DataBuffer;
-	boost::mutex m_DataBufferMutex;
+	std::shared_ptr<HttpConnectionPool> m_Connections;
+	DeadlineQueue::Ptr m_BulkRetries;
+	std::atomic<uint_fast64_t> m_ItemsRetried{0};
+	std::atomic<uint_fast64_t> m_ItemsRejected{0};
 
-	void AddCheckResult(const Dictionary::Ptr& fields, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void AddCheckResult(const Dictionary::Ptr& fields, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, bool filterPerfdata);
 
 	void StateChangeHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, StateType type);
 	void StateChangeHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, StateType type);
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void CheckResultHandler(const CheckResultBatch& batch);
 	void InternalCheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	void NotificationSentToAllUsersHandler(const Notification::Ptr& notification,
 		const Checkable::Ptr& checkable, const std::set<User::Ptr>& users, NotificationType type,
@@ -66,12 +87,13 @@ private:
 
 	void Enqueue(const String& type, const Dictionary::Ptr& fields, double ts);
 
-	Stream::Ptr Connect();
-	void AssertOnWorkQueue();
-	void ExceptionHandler(boost::exception_ptr exp);
-	void FlushTimeout();
-	void Flush();
-	void SendRequest(const String& body);
+	static Stream::Ptr Connect(const String& host, const String& port, bool tls,
+		const String& certPath, const String& keyPath, const String& caPath);
+	void SendBulk(const String& batch, int attempt, const SendCallback& callback);
+	void SendBulkRequest(const String& body, const BulkResponseCallback& callback);
+	void BulkRetryHandler(const Object::Ptr& object);
+	String GetThrottledItems(const String& body, const String& response);
+	void ProcessResponse(HttpResponse& resp);
 };
 
 }
@@ -46,30 +46,16 @@ REGISTER_TYPE(GelfWriter);
 
 REGISTER_STATSFUNCTION(GelfWriter, &GelfWriter::StatsFunc);
 
-void GelfWriter::OnConfigLoaded()
-{
-	ObjectImpl<GelfWriter>::OnConfigLoaded();
-
-	m_WorkQueue.SetName("GelfWriter, " + GetName());
-}
-
 void GelfWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const GelfWriter::Ptr& gelfwriter : ConfigType::GetObjectsByType<GelfWriter>()) {
-		size_t workQueueItems = gelfwriter->m_WorkQueue.GetLength();
-		double workQueueItemRate = gelfwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
-
-		nodes.emplace_back(gelfwriter->GetName(), new Dictionary({
-			{ "work_queue_items", workQueueItems },
-			{ "work_queue_item_rate", workQueueItemRate },
-			{ "connected", gelfwriter->GetConnected() },
-			{ "source", gelfwriter->GetSource() }
-		}));
-
-		perfdata->Add(new PerfdataValue("gelfwriter_" + gelfwriter->GetName() + "_work_queue_items", workQueueItems));
-		perfdata->Add(new PerfdataValue("gelfwriter_" + gelfwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		Dictionary::Ptr stats = gelfwriter->GetPipelineStats("gelfwriter_" + gelfwriter->GetName(), perfdata);
+		stats->Set("connected", gelfwriter->GetConnected());
+		stats->Set("source", gelfwriter->GetSource());
+
+		nodes.emplace_back(gelfwriter->GetName(), stats);
 	}
 
 	status->Set("gelfwriter", new Dictionary(std::move(nodes)));
@@ -82,20 +68,17 @@ void GelfWriter::Start(bool runtimeCreated)
 	Log(LogInformation, "GelfWriter")
 		<< "'" << GetName() << "' started.";
 
-	/* Register exception handler for WQ tasks. */
-	m_WorkQueue.SetExceptionCallback(std::bind(&GelfWriter::ExceptionHandler, this, _1));
-
 	/* Timer for reconnecting */
-	m_ReconnectTimer = new Timer();
+	m_ReconnectTimer = new Timer("GelfWriter reconnect");
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&GelfWriter::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
 	/* Register event handlers. */
-	Checkable::OnNewCheckResult.connect(std::bind(&GelfWriter::CheckResultHandler, this, _1, _2));
+	CheckResultBatcher::OnNewCheckResults.connect(std::bind(&GelfWriter::CheckResultHandler, this, _1), "GelfWriter::CheckResultHandler");
 	Checkable::OnNotificationSentToUser.connect(std::bind(&GelfWriter::NotificationToUserHandler, this, _1, _2, _3, _4, _5, _6, _7, _8));
-	Checkable::OnStateChange.connect(std::bind(&GelfWriter::StateChangeHandler, this, _1, _2, _3));
+	Checkable::OnStateChange.connect(std::bind(&GelfWriter::StateChangeHandler, this, _1, _2, _3), "GelfWriter::StateChangeHandler");
 }
 
 void GelfWriter::Stop(bool runtimeRemoved)
@@ -103,16 +86,11 @@ void GelfWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "GelfWriter")
 		<< "'" << GetName() << "' stopped.";
 
-	m_WorkQueue.Join();
+	m_ReconnectTimer->Stop();
 
 	ObjectImpl<GelfWriter>::Stop(runtimeRemoved);
 }
 
-void GelfWriter::AssertOnWorkQueue()
-{
-	ASSERT(m_WorkQueue.IsWorkerThread());
-}
-
 void GelfWriter::ExceptionHandler(boost::exception_ptr exp)
 {
 	Log(LogCritical, "GelfWriter", "Exception during Graylog Gelf operation: Verify that your backend is operational!");
@@ -120,6 +98,8 @@ void GelfWriter::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "GelfWriter")
 		<< "Exception during Graylog Gelf operation: " << DiagnosticInformation(std::move(exp));
 
+	ObjectLock olock(this);
+
 	if (GetConnected()) {
 		m_Stream->Close();
 
@@ -153,9 +133,13 @@ void GelfWriter::Reconnect()
 		throw ex;
 	}
 
-	m_Stream = new NetworkStream(socket);
+	{
+		ObjectLock olock(this);
 
-	SetConnected(true);
+		m_Stream = new NetworkStream(socket);
+
+		SetConnected(true);
+	}
 
 	Log(LogInformation, "GelfWriter")
 		<< "Finished reconnecting to Graylog Gelf in " << std::setw(2) << Utility::GetTime() - startTime << " second(s).";
@@ -170,6 +154,8 @@ void GelfWriter::Disconnect()
 {
 	AssertOnWorkQueue();
 
+	ObjectLock olock(this);
+
 	if (!GetConnected())
 		return;
 
@@ -178,9 +164,10 @@ void GelfWriter::Disconnect()
 	SetConnected(false);
 }
 
-void GelfWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void GelfWriter::CheckResultHandler(const CheckResultBatch& batch)
 {
-	m_WorkQueue.Enqueue(std::bind(&GelfWriter::CheckResultHandlerInternal, this, checkable, cr));
+	CheckResultBatcher::Handler handler = std::bind(&GelfWriter::CheckResultHandlerInternal, this, _1, _2);
+	m_WorkQueue.Enqueue(std::bind(&CheckResultBatcher::ForEach, batch, handler));
 }
 
 void GelfWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -234,26 +221,23 @@ void GelfWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, con
 	}
 
 	if (cr && GetEnableSendPerfdata()) {
-		Array::Ptr perfdata = cr->GetPerformanceData();
+		Array::Ptr perfdata = cr->GetParsedPerformanceData();
 
 		if (perfdata) {
 			ObjectLock olock(perfdata);
 			for (const Value& val : perfdata) {
-				PerfdataValue::Ptr pdv;
-
-				if (val.IsObjectType<PerfdataValue>())
-					pdv = val;
-				else {
-					try {
-						pdv = PerfdataValue::Parse(val);
-					} catch (const std::exception&) {
-						Log(LogWarning, "GelfWriter")
-							<< "Ignoring invalid perfdata value: '" << val << "' for object '"
-							<< checkable->GetName() << "'.";
-						continue;
-					}
+				if (!val.IsObjectType<PerfdataValue>()) {
+					Log(LogWarning, "GelfWriter")
+						<< "Ignoring invalid perfdata value: '" << val << "' for object '"
+						<< checkable->GetName() << "'.";
+					continue;
 				}
 
+				PerfdataValue::Ptr pdv = val;
+
+				if (!ShouldSendPerfdataValue(checkable, pdv, ts))
+					continue;
+
 				String escaped_key = pdv->GetLabel();
 				boost::replace_all(escaped_key, " ", "_");
 				boost::replace_all(escaped_key, ".", "_");
@@ -410,26 +394,38 @@ String GelfWriter::ComposeGelfMessage(const Dictionary::Ptr& fields, const Strin
 
 void GelfWriter::SendLogMessage(const String& gelfMessage)
 {
-	std::ostringstream msgbuf;
-	msgbuf << gelfMessage;
-	msgbuf << '\0';
+	Log(LogDebug, "GelfWriter")
+		<< "Add to message list: '" << gelfMessage << "'.";
 
-	String log = msgbuf.str();
+	/* Messages are delimited by a null byte. */
+	AddRecord(gelfMessage + String(1, '\0'));
+}
 
+/**
+ * Sends a batch of messages with a single write.
+ *
+ * @param data The null-delimited messages.
+ * @returns false if Graylog is not connected.
+ */
+bool GelfWriter::SendBatch(const String& data)
+{
 	ObjectLock olock(this);
 
 	if (!GetConnected())
-		return;
+		return false;
 
 	try {
-		Log(LogDebug, "GelfWriter")
-			<< "Sending '" << log << "'.";
-
-		m_Stream->Write(log.CStr(), log.GetLength());
+		m_Stream->Write(data.CStr(), data.GetLength());
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "GelfWriter")
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex, false);
 
-		throw ex;
+		m_Stream->Close();
+
+		SetConnected(false);
+
+		return false;
 	}
+
+	return true;
 }
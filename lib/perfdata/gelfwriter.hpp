@@ -22,10 +22,9 @@
 
 #include "perfdata/gelfwriter-ti.hpp"
 #include "icinga/service.hpp"
-#include "base/configobject.hpp"
+#include "icinga/checkresultbatcher.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
-#include "base/workqueue.hpp"
 #include <fstream>
 
 namespace icinga
@@ -45,17 +44,18 @@ public:
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
 protected:
-	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
+	bool SendBatch(const String& data) override;
+	void ExceptionHandler(boost::exception_ptr exp) override;
+
 private:
 	Stream::Ptr m_Stream;
-	WorkQueue m_WorkQueue{10000000, 1};
 
 	Timer::Ptr m_ReconnectTimer;
 
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void CheckResultHandler(const CheckResultBatch& batch);
 	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	void NotificationToUserHandler(const Notification::Ptr& notification, const Checkable::Ptr& checkable,
 		const User::Ptr& user, NotificationType notificationType, const CheckResult::Ptr& cr,
@@ -73,10 +73,6 @@ private:
 
 	void Disconnect();
 	void Reconnect();
-
-	void AssertOnWorkQueue();
-
-	void ExceptionHandler(boost::exception_ptr exp);
 };
 
 }
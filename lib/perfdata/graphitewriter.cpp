@@ -36,6 +36,7 @@
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <cstring>
 #include <utility>
 
 using namespace icinga;
@@ -44,29 +45,15 @@ REGISTER_TYPE(GraphiteWriter);
 
 REGISTER_STATSFUNCTION(GraphiteWriter, &GraphiteWriter::StatsFunc);
 
-void GraphiteWriter::OnConfigLoaded()
-{
-	ObjectImpl<GraphiteWriter>::OnConfigLoaded();
-
-	m_WorkQueue.SetName("GraphiteWriter, " + GetName());
-}
-
 void GraphiteWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const GraphiteWriter::Ptr& graphitewriter : ConfigType::GetObjectsByType<GraphiteWriter>()) {
-		size_t workQueueItems = graphitewriter->m_WorkQueue.GetLength();
-		double workQueueItemRate = graphitewriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		Dictionary::Ptr stats = graphitewriter->GetPipelineStats("graphitewriter_" + graphitewriter->GetName(), perfdata);
+		stats->Set("connected", graphitewriter->GetConnected());
 
-		nodes.emplace_back(graphitewriter->GetName(), new Dictionary({
-			{ "work_queue_items", workQueueItems },
-			{ "work_queue_item_rate", workQueueItemRate },
-			{ "connected", graphitewriter->GetConnected() }
-		}));
-
-		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_work_queue_items", workQueueItems));
-		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		nodes.emplace_back(graphitewriter->GetName(), stats);
 	}
 
 	status->Set("graphitewriter", new Dictionary(std::move(nodes)));
@@ -79,18 +66,15 @@ void GraphiteWriter::Start(bool runtimeCreated)
 	Log(LogInformation, "GraphiteWriter")
 		<< "'" << GetName() << "' started.";
 
-	/* Register exception handler for WQ tasks. */
-	m_WorkQueue.SetExceptionCallback(std::bind(&GraphiteWriter::ExceptionHandler, this, _1));
-
 	/* Timer for reconnecting */
-	m_ReconnectTimer = new Timer();
+	m_ReconnectTimer = new Timer("GraphiteWriter reconnect");
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&GraphiteWriter::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
 	/* Register event handlers. */
-	Checkable::OnNewCheckResult.connect(std::bind(&GraphiteWriter::CheckResultHandler, this, _1, _2));
+	CheckResultBatcher::OnNewCheckResults.connect(std::bind(&GraphiteWriter::CheckResultHandler, this, _1), "GraphiteWriter::CheckResultHandler");
 }
 
 void GraphiteWriter::Stop(bool runtimeRemoved)
@@ -98,16 +82,11 @@ void GraphiteWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "GraphiteWriter")
 		<< "'" << GetName() << "' stopped.";
 
-	m_WorkQueue.Join();
+	m_ReconnectTimer->Stop();
 
 	ObjectImpl<GraphiteWriter>::Stop(runtimeRemoved);
 }
 
-void GraphiteWriter::AssertOnWorkQueue()
-{
-	ASSERT(m_WorkQueue.IsWorkerThread());
-}
-
 void GraphiteWriter::ExceptionHandler(boost::exception_ptr exp)
 {
 	Log(LogCritical, "GraphiteWriter", "Exception during Graphite operation: Verify that your backend is operational!");
@@ -115,6 +94,8 @@ void GraphiteWriter::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "GraphiteWriter")
 		<< "Exception during Graphite operation: " << DiagnosticInformation(std::move(exp));
 
+	ObjectLock olock(this);
+
 	if (GetConnected()) {
 		m_Stream->Close();
 
@@ -148,9 +129,13 @@ void GraphiteWriter::Reconnect()
 		throw ex;
 	}
 
-	m_Stream = new NetworkStream(socket);
+	{
+		ObjectLock olock(this);
+
+		m_Stream = new NetworkStream(socket);
 
-	SetConnected(true);
+		SetConnected(true);
+	}
 
 	Log(LogInformation, "GraphiteWriter")
 		<< "Finished reconnecting to Graphite in " << std::setw(2) << Utility::GetTime() - startTime << " second(s).";
@@ -165,6 +150,8 @@ void GraphiteWriter::Disconnect()
 {
 	AssertOnWorkQueue();
 
+	ObjectLock olock(this);
+
 	if (!GetConnected())
 		return;
 
@@ -173,9 +160,10 @@ void GraphiteWriter::Disconnect()
 	SetConnected(false);
 }
 
-void GraphiteWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void GraphiteWriter::CheckResultHandler(const CheckResultBatch& batch)
 {
-	m_WorkQueue.Enqueue(std::bind(&GraphiteWriter::CheckResultHandlerInternal, this, checkable, cr));
+	CheckResultBatcher::Handler handler = std::bind(&GraphiteWriter::CheckResultHandlerInternal, this, _1, _2);
+	m_WorkQueue.Enqueue(std::bind(&CheckResultBatcher::ForEach, batch, handler));
 }
 
 void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -227,32 +215,29 @@ void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable,
 		SendMetric(prefixMetadata, "execution_time", cr->CalculateExecutionTime(), ts);
 	}
 
-	SendPerfdata(prefixPerfdata, cr, ts);
+	SendPerfdata(checkable, prefixPerfdata, cr, ts);
 }
 
-void GraphiteWriter::SendPerfdata(const String& prefix, const CheckResult::Ptr& cr, double ts)
+void GraphiteWriter::SendPerfdata(const Checkable::Ptr& checkable, const String& prefix, const CheckResult::Ptr& cr, double ts)
 {
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	Array::Ptr perfdata = cr->GetParsedPerformanceData();
 
 	if (!perfdata)
 		return;
 
 	ObjectLock olock(perfdata);
 	for (const Value& val : perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "GraphiteWriter")
-					<< "Ignoring invalid perfdata value: " << val;
-				continue;
-			}
+		if (!val.IsObjectType<PerfdataValue>()) {
+			Log(LogWarning, "GraphiteWriter")
+				<< "Ignoring invalid perfdata value: " << val;
+			continue;
 		}
 
+		PerfdataValue::Ptr pdv = val;
+
+		if (!ShouldSendPerfdataValue(checkable, pdv, ts))
+			continue;
+
 		String escapedKey = EscapeMetricLabel(pdv->GetLabel());
 
 		SendMetric(prefix, escapedKey + ".value", pdv->GetValue(), ts);
@@ -272,29 +257,121 @@ void GraphiteWriter::SendPerfdata(const String& prefix, const CheckResult::Ptr&
 
 void GraphiteWriter::SendMetric(const String& prefix, const String& name, double value, double ts)
 {
-	std::ostringstream msgbuf;
-	msgbuf << prefix << "." << name << " " << Convert::ToString(value) << " " << static_cast<long>(ts);
+	String path = prefix + "." + name;
+	long timestamp = static_cast<long>(ts);
 
 	Log(LogDebug, "GraphiteWriter")
-		<< "Add to metric list:'" << msgbuf.str() << "'.";
+		<< "Add to metric list:'" << path << " " << Convert::ToString(value) << " " << timestamp << "'.";
 
-	// do not send \n to debug log
-	msgbuf << "\n";
-	String metric = msgbuf.str();
+	if (GetEnablePickle())
+		AddRecord(FormatPickleMetric(path, value, timestamp));
+	else
+		AddRecord(path + " " + Convert::ToString(value) + " " + Convert::ToString(timestamp) + "\n");
+}
+
+/**
+ * Wraps pickled metrics into messages for Graphite's pickle protocol.
+ * Plaintext metrics are sent as they are.
+ */
+String GraphiteWriter::FormatBatch(const std::vector<String>& records)
+{
+	if (!GetEnablePickle())
+		return BatchWriter::FormatBatch(records);
+
+	/* Carbon rejects pickle messages larger than 1 MiB. */
+	const size_t chunkSize = 500;
+
+	String data;
+
+	for (size_t begin = 0; begin < records.size(); begin += chunkSize) {
+		std::vector<String> chunk(records.begin() + begin, records.begin() + std::min(begin + chunkSize, records.size()));
+		data += FormatPickle(BatchWriter::FormatBatch(chunk));
+	}
+
+	return data;
+}
 
+/**
+ * Sends a batch of metrics with a single write.
+ *
+ * @param data The formatted metrics.
+ * @returns false if Graphite is not connected.
+ */
+bool GraphiteWriter::SendBatch(const String& data)
+{
 	ObjectLock olock(this);
 
 	if (!GetConnected())
-		return;
+		return false;
 
 	try {
-		m_Stream->Write(metric.CStr(), metric.GetLength());
+		m_Stream->Write(data.CStr(), data.GetLength());
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "GraphiteWriter")
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex, false);
 
-		throw ex;
+		m_Stream->Close();
+
+		SetConnected(false);
+
+		return false;
 	}
+
+	return true;
+}
+
+static void AppendPickleInt(std::string& buffer, uint32_t value)
+{
+	/* little-endian */
+	for (int i = 0; i < 4; i++)
+		buffer += static_cast<char>((value >> (i * 8)) & 0xff);
+}
+
+/**
+ * Pickles a single (path, (timestamp, value)) tuple. The tuples are
+ * combined into messages by FormatPickle().
+ */
+String GraphiteWriter::FormatPickleMetric(const String& path, double value, long timestamp)
+{
+	std::string payload;
+
+	payload += 'X'; /* BINUNICODE */
+	AppendPickleInt(payload, path.GetLength());
+	payload += path.GetData();
+
+	payload += 'J'; /* BININT */
+	AppendPickleInt(payload, static_cast<uint32_t>(timestamp));
+
+	payload += 'G'; /* BINFLOAT, big-endian */
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	for (int k = 7; k >= 0; k--)
+		payload += static_cast<char>((bits >> (k * 8)) & 0xff);
+
+	payload += "\x86\x86"; /* TUPLE2, TUPLE2 */
+
+	return payload;
+}
+
+/**
+ * Formats pickled metrics as one message for Graphite's pickle protocol:
+ * A 4 byte big-endian length followed by a pickled (protocol 2) list of
+ * (path, (timestamp, value)) tuples.
+ */
+String GraphiteWriter::FormatPickle(const String& metrics)
+{
+	std::string payload = "\x80\x02" /* PROTO 2 */ "]" /* EMPTY_LIST */ "(" /* MARK */;
+	payload += metrics.GetData();
+	payload += "e."; /* APPENDS, STOP */
+
+	std::string message;
+	uint32_t length = payload.size();
+
+	for (int i = 3; i >= 0; i--)
+		message += static_cast<char>((length >> (i * 8)) & 0xff);
+
+	return message + payload;
 }
 
 String GraphiteWriter::EscapeMetric(const String& str)
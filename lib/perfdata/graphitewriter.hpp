@@ -22,10 +22,9 @@
 
 #include "perfdata/graphitewriter-ti.hpp"
 #include "icinga/service.hpp"
-#include "base/configobject.hpp"
+#include "icinga/checkresultbatcher.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
-#include "base/workqueue.hpp"
 #include <fstream>
 
 namespace icinga
@@ -48,20 +47,24 @@ public:
 	void ValidateServiceNameTemplate(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
 
 protected:
-	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
+	String FormatBatch(const std::vector<String>& records) override;
+	bool SendBatch(const String& data) override;
+	void ExceptionHandler(boost::exception_ptr exp) override;
+
 private:
 	Stream::Ptr m_Stream;
-	WorkQueue m_WorkQueue{10000000, 1};
 
 	Timer::Ptr m_ReconnectTimer;
 
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void CheckResultHandler(const CheckResultBatch& batch);
 	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	void SendMetric(const String& prefix, const String& name, double value, double ts);
-	void SendPerfdata(const String& prefix, const CheckResult::Ptr& cr, double ts);
+	void SendPerfdata(const Checkable::Ptr& checkable, const String& prefix, const CheckResult::Ptr& cr, double ts);
+	static String FormatPickleMetric(const String& path, double value, long timestamp);
+	static String FormatPickle(const String& metrics);
 	static String EscapeMetric(const String& str);
 	static String EscapeMetricLabel(const String& str);
 	static Value EscapeMacroMetric(const Value& value);
@@ -70,10 +73,6 @@ private:
 
 	void Disconnect();
 	void Reconnect();
-
-	void AssertOnWorkQueue();
-
-	void ExceptionHandler(boost::exception_ptr exp);
 };
 
 }
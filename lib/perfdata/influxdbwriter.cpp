@@ -22,6 +22,7 @@
 #include "remote/url.hpp"
 #include "remote/httprequest.hpp"
 #include "remote/httpresponse.hpp"
+#include "remote/httputility.hpp"
 #include "icinga/service.hpp"
 #include "icinga/macroprocessor.hpp"
 #include "icinga/icingaapplication.hpp"
@@ -40,61 +41,26 @@
 #include "base/statsfunction.hpp"
 #include "base/tlsutility.hpp"
 #include <boost/algorithm/string.hpp>
-#include <boost/algorithm/string/replace.hpp>
 #include <boost/math/special_functions/fpclassify.hpp>
 #include <boost/regex.hpp>
 #include <boost/scoped_array.hpp>
+#include <cmath>
+#include <cstdio>
 #include <utility>
 
 using namespace icinga;
 
-class InfluxdbInteger final : public Object
-{
-public:
-	DECLARE_PTR_TYPEDEFS(InfluxdbInteger);
-
-	InfluxdbInteger(int value)
-		: m_Value(value)
-	{ }
-
-	int GetValue() const
-	{
-		return m_Value;
-	}
-
-private:
-	int m_Value;
-};
-
 REGISTER_TYPE(InfluxdbWriter);
 
 REGISTER_STATSFUNCTION(InfluxdbWriter, &InfluxdbWriter::StatsFunc);
 
-void InfluxdbWriter::OnConfigLoaded()
-{
-	ObjectImpl<InfluxdbWriter>::OnConfigLoaded();
-
-	m_WorkQueue.SetName("InfluxdbWriter, " + GetName());
-}
-
 void InfluxdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const InfluxdbWriter::Ptr& influxdbwriter : ConfigType::GetObjectsByType<InfluxdbWriter>()) {
-		size_t workQueueItems = influxdbwriter->m_WorkQueue.GetLength();
-		double workQueueItemRate = influxdbwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
-		size_t dataBufferItems = influxdbwriter->m_DataBuffer.size();
-
-		nodes.emplace_back(influxdbwriter->GetName(), new Dictionary({
-			{ "work_queue_items", workQueueItems },
-			{ "work_queue_item_rate", workQueueItemRate },
-			{ "data_buffer_items", dataBufferItems }
-		}));
-
-		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_work_queue_items", workQueueItems));
-		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
-		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_data_queue_items", dataBufferItems));
+		nodes.emplace_back(influxdbwriter->GetName(),
+			influxdbwriter->GetPipelineStats("influxdbwriter_" + influxdbwriter->GetName(), perfdata));
 	}
 
 	status->Set("influxdbwriter", new Dictionary(std::move(nodes)));
@@ -107,18 +73,20 @@ void InfluxdbWriter::Start(bool runtimeCreated)
 	Log(LogInformation, "InfluxdbWriter")
 		<< "'" << GetName() << "' started.";
 
-	/* Register exception handler for WQ tasks. */
-	m_WorkQueue.SetExceptionCallback(std::bind(&InfluxdbWriter::ExceptionHandler, this, _1));
+	/* Writers which send to the same server share their connections. */
+	String key = (GetSslEnable() ? "https://" : "http://") + GetHost() + ":" + GetPort()
+		+ (GetSslEnable() ? "\n" + GetSslCert() + "\n" + GetSslKey() + "\n" + GetSslCaCert() : "");
 
-	/* Setup timer for periodically flushing m_DataBuffer */
-	m_FlushTimer = new Timer();
-	m_FlushTimer->SetInterval(GetFlushInterval());
-	m_FlushTimer->OnTimerExpired.connect(std::bind(&InfluxdbWriter::FlushTimeout, this));
-	m_FlushTimer->Start();
-	m_FlushTimer->Reschedule(0);
+	m_Connections = HttpConnectionPool::GetShared(key, std::bind(&InfluxdbWriter::Connect, GetHost(), GetPort(),
+		GetSslEnable(), GetSslCert(), GetSslKey(), GetSslCaCert()), GetFlushConcurrency());
+
+	if (GetEnableCompression() && !HttpUtility::IsCompressionSupported()) {
+		Log(LogWarning, "InfluxdbWriter")
+			<< "Compression is not supported by this build. Sending uncompressed data to InfluxDB.";
+	}
 
 	/* Register for new metrics. */
-	Checkable::OnNewCheckResult.connect(std::bind(&InfluxdbWriter::CheckResultHandler, this, _1, _2));
+	CheckResultBatcher::OnNewCheckResults.connect(std::bind(&InfluxdbWriter::CheckResultHandler, this, _1), "InfluxdbWriter::CheckResultHandler");
 }
 
 void InfluxdbWriter::Stop(bool runtimeRemoved)
@@ -126,57 +94,43 @@ void InfluxdbWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "InfluxdbWriter")
 		<< "'" << GetName() << "' stopped.";
 
-	m_WorkQueue.Join();
-
 	ObjectImpl<InfluxdbWriter>::Stop(runtimeRemoved);
-}
-
-void InfluxdbWriter::AssertOnWorkQueue()
-{
-	ASSERT(m_WorkQueue.IsWorkerThread());
-}
 
-void InfluxdbWriter::ExceptionHandler(boost::exception_ptr exp)
-{
-	Log(LogCritical, "InfluxdbWriter", "Exception during InfluxDB operation: Verify that your backend is operational!");
-
-	Log(LogDebug, "InfluxdbWriter")
-		<< "Exception during InfluxDB operation: " << DiagnosticInformation(std::move(exp));
-
-	//TODO: Close the connection, if we keep it open.
+	m_Connections.reset();
 }
 
-Stream::Ptr InfluxdbWriter::Connect()
+Stream::Ptr InfluxdbWriter::Connect(const String& host, const String& port, bool tls,
+	const String& certPath, const String& keyPath, const String& caPath)
 {
 	TcpSocket::Ptr socket = new TcpSocket();
 
 	Log(LogNotice, "InfluxdbWriter")
-		<< "Reconnecting to InfluxDB on host '" << GetHost() << "' port '" << GetPort() << "'.";
+		<< "Reconnecting to InfluxDB on host '" << host << "' port '" << port << "'.";
 
 	try {
-		socket->Connect(GetHost(), GetPort());
+		socket->Connect(host, port);
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "InfluxdbWriter")
-			<< "Can't connect to InfluxDB on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			<< "Can't connect to InfluxDB on host '" << host << "' port '" << port << "'.";
 		throw ex;
 	}
 
-	if (GetSslEnable()) {
+	if (tls) {
 		std::shared_ptr<SSL_CTX> sslContext;
 		try {
-			sslContext = MakeSSLContext(GetSslCert(), GetSslKey(), GetSslCaCert());
+			sslContext = MakeSSLContext(certPath, keyPath, caPath);
 		} catch (const std::exception& ex) {
 			Log(LogWarning, "InfluxdbWriter")
 				<< "Unable to create SSL context.";
 			throw ex;
 		}
 
-		TlsStream::Ptr tlsStream = new TlsStream(socket, GetHost(), RoleClient, sslContext);
+		TlsStream::Ptr tlsStream = new TlsStream(socket, host, RoleClient, sslContext);
 		try {
 			tlsStream->Handshake();
 		} catch (const std::exception& ex) {
 			Log(LogWarning, "InfluxdbWriter")
-				<< "TLS handshake with host '" << GetHost() << "' failed.";
+				<< "TLS handshake with host '" << host << "' failed.";
 			throw ex;
 		}
 
@@ -186,9 +140,10 @@ Stream::Ptr InfluxdbWriter::Connect()
 	}
 }
 
-void InfluxdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void InfluxdbWriter::CheckResultHandler(const CheckResultBatch& batch)
 {
-	m_WorkQueue.Enqueue(std::bind(&InfluxdbWriter::CheckResultHandlerWQ, this, checkable, cr), PriorityLow);
+	CheckResultBatcher::Handler handler = std::bind(&InfluxdbWriter::CheckResultHandlerWQ, this, _1, _2);
+	m_WorkQueue.Enqueue(std::bind(&CheckResultBatcher::ForEach, batch, handler), PriorityLow);
 }
 
 void InfluxdbWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -210,228 +165,302 @@ void InfluxdbWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable, const
 	resolvers.emplace_back("host", host);
 	resolvers.emplace_back("icinga", IcingaApplication::GetInstance());
 
-	String prefix;
-
 	double ts = cr->GetExecutionEnd();
 
-	// Clone the template and perform an in-place macro expansion of measurement and tag values
-	Dictionary::Ptr tmpl_clean = service ? GetServiceTemplate() : GetHostTemplate();
-	Dictionary::Ptr tmpl = static_pointer_cast<Dictionary>(tmpl_clean->Clone());
-	tmpl->Set("measurement", MacroProcessor::ResolveMacros(tmpl->Get("measurement"), resolvers, cr));
-
-	Dictionary::Ptr tags = tmpl->Get("tags");
-	if (tags) {
-		ObjectLock olock(tags);
-		for (const Dictionary::Pair& pair : tags) {
-			String missing_macro;
-			Value value = MacroProcessor::ResolveMacros(pair.second, resolvers, cr, &missing_macro);
-
-			if (!missing_macro.IsEmpty())
-				continue;
+	const std::string& prefix = GetTagSet(checkable, service ? GetServiceTemplate() : GetHostTemplate(), resolvers, cr, ts);
 
-			tags->Set(pair.first, value);
-		}
-	}
-
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	Array::Ptr perfdata = cr->GetParsedPerformanceData();
 	if (perfdata) {
 		ObjectLock olock(perfdata);
 		for (const Value& val : perfdata) {
-			PerfdataValue::Ptr pdv;
-
-			if (val.IsObjectType<PerfdataValue>())
-				pdv = val;
-			else {
-				try {
-					pdv = PerfdataValue::Parse(val);
-				} catch (const std::exception&) {
-					Log(LogWarning, "InfluxdbWriter")
-						<< "Ignoring invalid perfdata value: " << val;
-					continue;
-				}
+			if (!val.IsObjectType<PerfdataValue>()) {
+				Log(LogWarning, "InfluxdbWriter")
+					<< "Ignoring invalid perfdata value: " << val;
+				continue;
 			}
 
-			Dictionary::Ptr fields = new Dictionary();
-			fields->Set("value", pdv->GetValue());
+			PerfdataValue::Ptr pdv = val;
+
+			if (!ShouldSendPerfdataValue(checkable, pdv, ts))
+				continue;
+
+			/* Fields are written in alphabetical order, like they used to be sorted in a Dictionary. */
+			m_Line.clear();
 
 			if (GetEnableSendThresholds()) {
 				if (pdv->GetCrit())
-					fields->Set("crit", pdv->GetCrit());
-				if (pdv->GetWarn())
-					fields->Set("warn", pdv->GetWarn());
-				if (pdv->GetMin())
-					fields->Set("min", pdv->GetMin());
+					AppendField(m_Line, "crit", pdv->GetCrit());
 				if (pdv->GetMax())
-					fields->Set("max", pdv->GetMax());
-			}
-			if (!pdv->GetUnit().IsEmpty()) {
-				fields->Set("unit", pdv->GetUnit());
+					AppendField(m_Line, "max", pdv->GetMax());
+				if (pdv->GetMin())
+					AppendField(m_Line, "min", pdv->GetMin());
 			}
 
-			SendMetric(tmpl, pdv->GetLabel(), fields, ts);
+			if (!pdv->GetUnit().IsEmpty())
+				AppendField(m_Line, "unit", pdv->GetUnit());
+
+			AppendField(m_Line, "value", pdv->GetValue());
+
+			if (GetEnableSendThresholds() && pdv->GetWarn())
+				AppendField(m_Line, "warn", pdv->GetWarn());
+
+			SendMetric(prefix, pdv->GetLabel(), ts);
 		}
 	}
 
 	if (GetEnableSendMetadata()) {
-		Host::Ptr host;
-		Service::Ptr service;
-		tie(host, service) = GetHostService(checkable);
-
-		Dictionary::Ptr fields = new Dictionary();
-
-		if (service)
-			fields->Set("state", new InfluxdbInteger(service->GetState()));
-		else
-			fields->Set("state", new InfluxdbInteger(host->GetState()));
-
-		fields->Set("current_attempt", new InfluxdbInteger(checkable->GetCheckAttempt()));
-		fields->Set("max_check_attempts", new InfluxdbInteger(checkable->GetMaxCheckAttempts()));
-		fields->Set("state_type", new InfluxdbInteger(checkable->GetStateType()));
-		fields->Set("reachable", checkable->IsReachable());
-		fields->Set("downtime_depth", new InfluxdbInteger(checkable->GetDowntimeDepth()));
-		fields->Set("acknowledgement", new InfluxdbInteger(checkable->GetAcknowledgement()));
-		fields->Set("latency", cr->CalculateLatency());
-		fields->Set("execution_time", cr->CalculateExecutionTime());
-
-		SendMetric(tmpl, Empty, fields, ts);
+		m_Line.clear();
+
+		AppendIntegerField(m_Line, "acknowledgement", checkable->GetAcknowledgement());
+		AppendIntegerField(m_Line, "current_attempt", checkable->GetCheckAttempt());
+		AppendIntegerField(m_Line, "downtime_depth", checkable->GetDowntimeDepth());
+		AppendField(m_Line, "execution_time", cr->CalculateExecutionTime());
+		AppendField(m_Line, "latency", cr->CalculateLatency());
+		AppendIntegerField(m_Line, "max_check_attempts", checkable->GetMaxCheckAttempts());
+		AppendField(m_Line, "reachable", checkable->IsReachable());
+		AppendIntegerField(m_Line, "state", service ? static_cast<int>(service->GetState()) : static_cast<int>(host->GetState()));
+		AppendIntegerField(m_Line, "state_type", checkable->GetStateType());
+
+		SendMetric(prefix, Empty, ts);
 	}
 }
 
-String InfluxdbWriter::EscapeKeyOrTagValue(const String& str)
+/**
+ * Returns the escaped measurement and tags for a checkable's data points.
+ * The macros are resolved for every check result, the escaped line prefix
+ * is only built again when the template or one of the values changed.
+ *
+ * @param checkable The checkable.
+ * @param tmpl The host or service template.
+ * @param resolvers The macro resolvers.
+ * @param cr The check result.
+ * @param ts The check result's timestamp.
+ * @returns The line prefix.
+ */
+const std::string& InfluxdbWriter::GetTagSet(const Checkable::Ptr& checkable, const Dictionary::Ptr& tmpl,
+	const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr, double ts)
 {
-	// Iterate over the key name and escape commas and spaces with a backslash
-	String result = str;
-	boost::algorithm::replace_all(result, "\"", "\\\"");
-	boost::algorithm::replace_all(result, "=", "\\=");
-	boost::algorithm::replace_all(result, ",", "\\,");
-	boost::algorithm::replace_all(result, " ", "\\ ");
+	PruneTagSets(ts);
 
-	// InfluxDB 'feature': although backslashes are allowed in keys they also act
-	// as escape sequences when followed by ',' or ' '.  When your tag is like
-	// 'metric=C:\' bad things happen.  Backslashes themselves cannot be escaped
-	// and through experimentation they also escape '='.  To be safe we replace
-	// trailing backslashes with and underscore.
-	// See https://github.com/influxdata/influxdb/issues/8587 for more info
-	size_t length = result.GetLength();
-	if (result[length - 1] == '\\')
-		result[length - 1] = '_';
+	std::vector<Value> values;
+	values.emplace_back(MacroProcessor::ResolveMacros(tmpl->Get("measurement"), resolvers, cr));
 
-	return result;
-}
+	Dictionary::Ptr tags = tmpl->Get("tags");
+	if (tags) {
+		ObjectLock olock(tags);
+		values.reserve(tags->GetLength() + 1);
 
-String InfluxdbWriter::EscapeValue(const Value& value)
-{
-	if (value.IsObjectType<InfluxdbInteger>()) {
-		std::ostringstream os;
-		os << static_cast<InfluxdbInteger::Ptr>(value)->GetValue() << "i";
-		return os.str();
+		for (const Dictionary::Pair& pair : tags) {
+			String missing_macro;
+			Value value = MacroProcessor::ResolveMacros(pair.second, resolvers, cr, &missing_macro);
+
+			/* Keep the unresolved value if a macro is missing. */
+			values.emplace_back(missing_macro.IsEmpty() ? value : pair.second);
+		}
 	}
 
-	if (value.IsBoolean())
-		return value ? "true" : "false";
+	TagSet& tagSet = m_TagSets[checkable->GetName()];
+	tagSet.LastUsed = ts;
 
-	if (value.IsString())
-		return "\"" + EscapeKeyOrTagValue(value) + "\"";
+	if (tagSet.Template == tmpl && tagSet.Values == values)
+		return tagSet.Prefix;
 
-	return value;
-}
+	tagSet.Template = tmpl;
+	tagSet.Values = std::move(values);
+	tagSet.Prefix.clear();
 
-void InfluxdbWriter::SendMetric(const Dictionary::Ptr& tmpl, const String& label, const Dictionary::Ptr& fields, double ts)
-{
-	std::ostringstream msgbuf;
-	msgbuf << EscapeKeyOrTagValue(tmpl->Get("measurement"));
+	AppendEscaped(tagSet.Prefix, tagSet.Values[0]);
 
-	Dictionary::Ptr tags = tmpl->Get("tags");
 	if (tags) {
 		ObjectLock olock(tags);
+		size_t index = 1;
+
 		for (const Dictionary::Pair& pair : tags) {
+			const Value& value = tagSet.Values[index++];
+
 			// Empty macro expansion, no tag
-			if (!pair.second.IsEmpty()) {
-				msgbuf << "," << EscapeKeyOrTagValue(pair.first) << "=" << EscapeKeyOrTagValue(pair.second);
+			if (!value.IsEmpty()) {
+				tagSet.Prefix += ',';
+				AppendEscaped(tagSet.Prefix, pair.first);
+				tagSet.Prefix += '=';
+				AppendEscaped(tagSet.Prefix, value);
 			}
 		}
 	}
 
-	// Label may be empty in the case of metadata
-	if (!label.IsEmpty())
-		msgbuf << ",metric=" << EscapeKeyOrTagValue(label);
+	return tagSet.Prefix;
+}
 
-	msgbuf << " ";
+/**
+ * Forgets the tag sets of checkables without check results for a day,
+ * e.g. because they were deleted.
+ */
+void InfluxdbWriter::PruneTagSets(double now)
+{
+	if (now - m_LastTagSetPrune < 3600)
+		return;
 
-	{
-		bool first = true;
+	m_LastTagSetPrune = now;
 
-		ObjectLock fieldLock(fields);
-		for (const Dictionary::Pair& pair : fields) {
-			if (first)
-				first = false;
-			else
-				msgbuf << ",";
+	for (auto it = m_TagSets.begin(); it != m_TagSets.end();) {
+		if (now - it->second.LastUsed > 86400)
+			it = m_TagSets.erase(it);
+		else
+			it++;
+	}
+}
 
-			msgbuf << EscapeKeyOrTagValue(pair.first) << "=" << EscapeValue(pair.second);
+/**
+ * Escapes commas, spaces, equal signs and quotes with a backslash and
+ * appends the result to a line.
+ */
+void InfluxdbWriter::AppendEscaped(std::string& buf, const String& str)
+{
+	size_t start = buf.size();
+
+	for (char ch : str) {
+		switch (ch) {
+			case '"':
+			case '=':
+			case ',':
+			case ' ':
+				buf += '\\';
+				break;
+			default:
+				break;
 		}
+
+		buf += ch;
 	}
 
-	msgbuf << " " <<  static_cast<unsigned long>(ts);
+	// InfluxDB 'feature': although backslashes are allowed in keys they also act
+	// as escape sequences when followed by ',' or ' '.  When your tag is like
+	// 'metric=C:\' bad things happen.  Backslashes themselves cannot be escaped
+	// and through experimentation they also escape '='.  To be safe we replace
+	// trailing backslashes with and underscore.
+	// See https://github.com/influxdata/influxdb/issues/8587 for more info
+	if (buf.size() > start && buf.back() == '\\')
+		buf.back() = '_';
+}
 
-#ifdef I2_DEBUG
-	Log(LogDebug, "InfluxdbWriter")
-		<< "Add to metric list: '" << msgbuf.str() << "'.";
-#endif /* I2_DEBUG */
+void InfluxdbWriter::AppendInteger(std::string& buf, long long value)
+{
+	char digits[24];
+	char *end = digits + sizeof(digits);
+	char *pos = end;
 
-	// Buffer the data point
-	m_DataBuffer.emplace_back(msgbuf.str());
+	unsigned long long uvalue = value < 0 ? 0ULL - static_cast<unsigned long long>(value) : value;
 
-	// Flush if we've buffered too much to prevent excessive memory use
-	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
-		Log(LogDebug, "InfluxdbWriter")
-			<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
+	do {
+		*--pos = '0' + uvalue % 10;
+		uvalue /= 10;
+	} while (uvalue > 0);
 
-		try {
-			Flush();
-		} catch (...) {
-			/* Do nothing. */
-		}
+	if (value < 0)
+		*--pos = '-';
+
+	buf.append(pos, end);
+}
+
+/**
+ * Appends a number the same way Convert::ToString() formats it, without
+ * going through a stream.
+ */
+void InfluxdbWriter::AppendNumber(std::string& buf, double value)
+{
+	double integral;
+
+	if (std::isfinite(value) && std::modf(value, &integral) == 0) {
+		AppendInteger(buf, static_cast<long long>(value));
+		return;
 	}
+
+	char number[512];
+	int length = snprintf(number, sizeof(number), "%f", value);
+
+	if (length > 0)
+		buf.append(number, std::min(static_cast<size_t>(length), sizeof(number) - 1));
 }
 
-void InfluxdbWriter::FlushTimeout()
+void InfluxdbWriter::AppendValue(std::string& buf, const Value& value)
 {
-	m_WorkQueue.Enqueue(boost::bind(&InfluxdbWriter::FlushTimeoutWQ, this), PriorityHigh);
+	if (value.IsNumber())
+		AppendNumber(buf, value.Get<double>());
+	else if (value.IsBoolean())
+		buf += value.Get<bool>() ? "true" : "false";
+	else if (value.IsString()) {
+		buf += '"';
+		AppendEscaped(buf, value.Get<String>());
+		buf += '"';
+	} else
+		buf += static_cast<String>(value).GetData();
 }
 
-void InfluxdbWriter::FlushTimeoutWQ()
+void InfluxdbWriter::AppendField(std::string& buf, const char *key, const Value& value)
 {
-	AssertOnWorkQueue();
+	if (!buf.empty())
+		buf += ',';
 
-	// Flush if there are any data available
-	if (m_DataBuffer.empty())
-		return;
+	buf += key;
+	buf += '=';
+	AppendValue(buf, value);
+}
 
-	Log(LogDebug, "InfluxdbWriter")
-		<< "Timer expired writing " << m_DataBuffer.size() << " data points";
+void InfluxdbWriter::AppendIntegerField(std::string& buf, const char *key, long long value)
+{
+	if (!buf.empty())
+		buf += ',';
 
-	Flush();
+	buf += key;
+	buf += '=';
+	AppendInteger(buf, value);
+	buf += 'i';
 }
 
-void InfluxdbWriter::Flush()
+/**
+ * Buffers a data point. The fields have already been written to m_Line.
+ *
+ * @param prefix The escaped measurement and tags.
+ * @param label The perfdata label, empty for metadata.
+ * @param ts The timestamp.
+ */
+void InfluxdbWriter::SendMetric(const std::string& prefix, const String& label, double ts)
 {
-	String body = boost::algorithm::join(m_DataBuffer, "\n");
-	m_DataBuffer.clear();
+	std::string line;
+	line.reserve(prefix.size() + label.GetLength() + m_Line.size() + 32);
 
-	Stream::Ptr stream;
+	line += prefix;
 
-	try {
-		stream = Connect();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "InfluxDbWriter")
-			<< "Flush failed, cannot connect to InfluxDB.";
-		return;
+	// Label may be empty in the case of metadata
+	if (!label.IsEmpty()) {
+		line += ",metric=";
+		AppendEscaped(line, label);
 	}
 
-	if (!stream)
-		return;
+	line += ' ';
+	line += m_Line;
+	line += ' ';
+	AppendInteger(line, static_cast<unsigned long>(ts));
+
+#ifdef I2_DEBUG
+	Log(LogDebug, "InfluxdbWriter")
+		<< "Add to metric list: '" << line << "'.";
+#endif /* I2_DEBUG */
 
+	line += '\n';
+
+	// Buffer the data point
+	AddRecord(std::move(line));
+}
+
+/**
+ * Sends a batch of data points to InfluxDB.
+ *
+ * @param body The data points.
+ * @param callback Called with false if InfluxDB was unavailable and the body should be sent again later.
+ */
+void InfluxdbWriter::SendBatchAsync(const String& body, const SendCallback& callback)
+{
 	Url::Ptr url = new Url();
 	url->SetScheme(GetSslEnable() ? "https" : "http");
 	url->SetHost(GetHost());
@@ -448,37 +477,36 @@ void InfluxdbWriter::Flush()
 	if (!GetPassword().IsEmpty())
 		url->AddQueryElement("p", GetPassword());
 
-	HttpRequest req(stream);
-	req.RequestMethod = "POST";
-	req.RequestUrl = url;
+	bool compress = GetEnableCompression() && HttpUtility::IsCompressionSupported();
+	String data = compress ? HttpUtility::GzipCompress(body) : body;
 
-	try {
-		req.WriteBody(body.CStr(), body.GetLength());
-		req.Finish();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "InfluxdbWriter")
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw ex;
-	}
+	auto statusCode = std::make_shared<int>(0);
+	InfluxdbWriter::Ptr self = this;
 
-	HttpResponse resp(stream, req);
-	StreamReadContext context;
+	m_Connections->SubmitRequest([url, data, compress](HttpRequest& req) {
+		req.RequestMethod = "POST";
+		req.RequestUrl = url;
 
-	try {
-		while (resp.Parse(context, true) && !resp.Complete)
-			; /* Do nothing */
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "InfluxdbWriter")
-			<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex);
-		throw ex;
-	}
+		if (compress)
+			req.AddHeader("Content-Encoding", "gzip");
 
-	if (!resp.Complete) {
-		Log(LogWarning, "InfluxdbWriter")
-			<< "Failed to read a complete HTTP response from the InfluxDB server.";
-		return;
-	}
+		req.WriteBody(data.CStr(), data.GetLength());
+	}, [self, statusCode](HttpResponse& resp) {
+		*statusCode = resp.StatusCode;
+		self->ProcessResponse(resp);
+	}, [self, statusCode, callback](boost::exception_ptr exp) {
+		if (exp) {
+			Log(LogWarning, "InfluxdbWriter")
+				<< "Flush failed, cannot send data to InfluxDB on host '" << self->GetHost() << "' port '" << self->GetPort() << "': " << DiagnosticInformation(exp, false);
+		}
+
+		/* Server errors are temporary, other errors would happen again. */
+		callback(*statusCode != 0 && *statusCode < 500);
+	});
+}
 
+void InfluxdbWriter::ProcessResponse(HttpResponse& resp)
+{
 	if (resp.StatusCode != 204) {
 		Log(LogWarning, "InfluxdbWriter")
 			<< "Unexpected response code: " << resp.StatusCode;
@@ -508,8 +536,6 @@ void InfluxdbWriter::Flush()
 
 		Log(LogCritical, "InfluxdbWriter")
 			<< "InfluxDB error message:\n" << error;
-
-		return;
 	}
 }
 
@@ -548,4 +574,3 @@ void InfluxdbWriter::ValidateServiceTemplate(const Lazy<Dictionary::Ptr>& lvalue
 		}
 	}
 }
-
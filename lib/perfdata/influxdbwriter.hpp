@@ -22,11 +22,12 @@
 
 #include "perfdata/influxdbwriter-ti.hpp"
 #include "icinga/service.hpp"
-#include "base/configobject.hpp"
+#include "icinga/checkresultbatcher.hpp"
+#include "icinga/macroprocessor.hpp"
+#include "remote/httpconnectionpool.hpp"
 #include "base/tcpsocket.hpp"
-#include "base/timer.hpp"
-#include "base/workqueue.hpp"
 #include <fstream>
+#include <map>
 
 namespace icinga
 {
@@ -48,30 +49,45 @@ public:
 	void ValidateServiceTemplate(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
 
 protected:
-	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
-private:
-	WorkQueue m_WorkQueue{10000000, 1};
-	Timer::Ptr m_FlushTimer;
-	std::vector<String> m_DataBuffer;
+	void SendBatchAsync(const String& body, const SendCallback& callback) override;
 
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void SendMetric(const Dictionary::Ptr& tmpl, const String& label, const Dictionary::Ptr& fields, double ts);
-	void FlushTimeout();
-	void FlushTimeoutWQ();
-	void Flush();
+private:
+	/**
+	 * The escaped measurement and tags of a checkable's data points.
+	 */
+	struct TagSet
+	{
+		Dictionary::Ptr Template;
+		std::vector<Value> Values;
+		std::string Prefix;
+		double LastUsed;
+	};
 
-	static String EscapeKeyOrTagValue(const String& str);
-	static String EscapeValue(const Value& value);
+	std::shared_ptr<HttpConnectionPool> m_Connections;
+	std::map<String, TagSet> m_TagSets;
+	double m_LastTagSetPrune{0};
+	std::string m_Line;
 
-	Stream::Ptr Connect();
+	void CheckResultHandler(const CheckResultBatch& batch);
+	void CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	const std::string& GetTagSet(const Checkable::Ptr& checkable, const Dictionary::Ptr& tmpl,
+		const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr, double ts);
+	void PruneTagSets(double now);
+	void SendMetric(const std::string& prefix, const String& label, double ts);
+	void ProcessResponse(HttpResponse& resp);
 
-	void AssertOnWorkQueue();
+	static void AppendEscaped(std::string& buf, const String& str);
+	static void AppendInteger(std::string& buf, long long value);
+	static void AppendNumber(std::string& buf, double value);
+	static void AppendValue(std::string& buf, const Value& value);
+	static void AppendField(std::string& buf, const char *key, const Value& value);
+	static void AppendIntegerField(std::string& buf, const char *key, long long value);
 
-	void ExceptionHandler(boost::exception_ptr exp);
+	static Stream::Ptr Connect(const String& host, const String& port, bool tls,
+		const String& certPath, const String& keyPath, const String& caPath);
 };
 
 }
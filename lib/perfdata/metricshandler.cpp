@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "perfdata/metricshandler.hpp"
+#include "perfdata/openmetricsexporter.hpp"
+#include "remote/httputility.hpp"
+#include "remote/filterutility.hpp"
+#include "base/configtype.hpp"
+
+using namespace icinga;
+
+REGISTER_URLHANDLER("/v1/metrics", MetricsHandler);
+
+bool MetricsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
+{
+	if (request.RequestUrl->GetPath().size() != 2)
+		return false;
+
+	if (request.RequestMethod != "GET")
+		return false;
+
+	FilterUtility::CheckPermission(user, "metrics");
+
+	for (const OpenMetricsExporter::Ptr& exporter : ConfigType::GetObjectsByType<OpenMetricsExporter>()) {
+		if (!exporter->IsActive())
+			continue;
+
+		exporter->WriteMetrics(response);
+		return true;
+	}
+
+	HttpUtility::SendJsonError(response, params, 404, "The openmetrics feature is not enabled.");
+	return true;
+}
@@ -0,0 +1,301 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "perfdata/openmetricsexporter.hpp"
+#include "perfdata/openmetricsexporter-ti.cpp"
+#include "icinga/service.hpp"
+#include "icinga/icingaapplication.hpp"
+#include "base/configtype.hpp"
+#include "base/objectlock.hpp"
+#include "base/logger.hpp"
+#include "base/convert.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/exception.hpp"
+#include "base/statsfunction.hpp"
+#include <boost/regex.hpp>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace icinga;
+
+#define OPENMETRICS_CHUNK_SIZE (64 * 1024)
+#define OPENMETRICS_SEND_QUEUE_SIZE (4 * 1024 * 1024)
+
+REGISTER_TYPE(OpenMetricsExporter);
+
+REGISTER_STATSFUNCTION(OpenMetricsExporter, &OpenMetricsExporter::StatsFunc);
+
+void OpenMetricsExporter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	DictionaryData nodes;
+
+	for (const OpenMetricsExporter::Ptr& exporter : ConfigType::GetObjectsByType<OpenMetricsExporter>()) {
+		size_t seriesCount = exporter->GetSeriesCount();
+
+		nodes.emplace_back(exporter->GetName(), new Dictionary({
+			{ "series", seriesCount }
+		}));
+
+		perfdata->Add(new PerfdataValue("openmetricsexporter_" + exporter->GetName() + "_series", seriesCount));
+	}
+
+	status->Set("openmetricsexporter", new Dictionary(std::move(nodes)));
+}
+
+void OpenMetricsExporter::Start(bool runtimeCreated)
+{
+	ObjectImpl<OpenMetricsExporter>::Start(runtimeCreated);
+
+	Log(LogInformation, "OpenMetricsExporter")
+		<< "'" << GetName() << "' started.";
+
+	Checkable::OnNewCheckResult.connect(std::bind(&OpenMetricsExporter::CheckResultHandler, this, _1, _2), "OpenMetricsExporter::CheckResultHandler");
+}
+
+void OpenMetricsExporter::Stop(bool runtimeRemoved)
+{
+	Log(LogInformation, "OpenMetricsExporter")
+		<< "'" << GetName() << "' stopped.";
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Metrics.clear();
+		m_SeriesCount = 0;
+	}
+
+	ObjectImpl<OpenMetricsExporter>::Stop(runtimeRemoved);
+}
+
+/**
+ * Renders the samples of a check result. Scrapes only concatenate the
+ * rendered samples, so their cost does not depend on the check rate.
+ */
+void OpenMetricsExporter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+{
+	if (!IsActive())
+		return;
+
+	if (!IcingaApplication::GetInstance()->GetEnablePerfdata() || !checkable->GetEnablePerfdata()) {
+		RemoveEntry(checkable.get());
+		return;
+	}
+
+	Array::Ptr perfdata = cr->GetParsedPerformanceData();
+
+	if (!perfdata || perfdata->GetLength() == 0) {
+		RemoveEntry(checkable.get());
+		return;
+	}
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	String labels = "host=\"" + EscapeLabelValue(host->GetName()) + "\"";
+
+	if (service)
+		labels += ",service=\"" + EscapeLabelValue(service->GetShortName()) + "\"";
+
+	std::ostringstream tsbuf;
+	tsbuf << std::fixed << std::setprecision(3) << cr->GetExecutionEnd();
+	String timestamp = tsbuf.str();
+
+	String names[MetricFamilyCount];
+
+	for (int family = 0; family < MetricFamilyCount; family++)
+		names[family] = GetMetricFamilyName(family);
+
+	std::ostringstream samples[MetricFamilyCount];
+	auto entry = std::make_shared<MetricsEntry>();
+	entry->Object = checkable;
+
+	bool sendThresholds = GetEnableSendThresholds();
+
+	ObjectLock olock(perfdata);
+
+	for (const Value& val : perfdata) {
+		if (!val.IsObjectType<PerfdataValue>())
+			continue;
+
+		PerfdataValue::Ptr pdv = val;
+
+		String sampleLabels = labels + ",label=\"" + EscapeLabelValue(pdv->GetLabel()) + "\"";
+
+		if (!pdv->GetUnit().IsEmpty())
+			sampleLabels += ",unit=\"" + EscapeLabelValue(pdv->GetUnit()) + "\"";
+
+		sampleLabels += "} ";
+
+		samples[MetricValue] << names[MetricValue] << "{" << sampleLabels << FormatValue(pdv->GetValue()) << " " << timestamp << "\n";
+		entry->SeriesCount++;
+
+		if (!sendThresholds)
+			continue;
+
+		const Value thresholds[] = { pdv->GetWarn(), pdv->GetCrit(), pdv->GetMin(), pdv->GetMax() };
+
+		for (int family = MetricWarn; family < MetricFamilyCount; family++) {
+			const Value& threshold = thresholds[family - MetricWarn];
+
+			if (threshold.IsEmpty())
+				continue;
+
+			samples[family] << names[family] << "{" << sampleLabels << FormatValue(threshold) << " " << timestamp << "\n";
+			entry->SeriesCount++;
+		}
+	}
+
+	for (int family = 0; family < MetricFamilyCount; family++)
+		entry->Samples[family] = samples[family].str();
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	std::shared_ptr<const MetricsEntry>& current = m_Metrics[checkable.get()];
+
+	if (current)
+		m_SeriesCount -= current->SeriesCount;
+
+	m_SeriesCount += entry->SeriesCount;
+	current = std::move(entry);
+}
+
+void OpenMetricsExporter::RemoveEntry(Checkable *checkable)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	auto it = m_Metrics.find(checkable);
+
+	if (it == m_Metrics.end())
+		return;
+
+	m_SeriesCount -= it->second->SeriesCount;
+	m_Metrics.erase(it);
+}
+
+size_t OpenMetricsExporter::GetSeriesCount() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	return m_SeriesCount;
+}
+
+/**
+ * Writes all metric families to an HTTP response.
+ *
+ * @param response The response. Its status and headers must not be sent yet.
+ */
+void OpenMetricsExporter::WriteMetrics(HttpResponse& response)
+{
+	std::vector<std::shared_ptr<const MetricsEntry> > entries;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		entries.reserve(m_Metrics.size());
+
+		for (auto it = m_Metrics.begin(); it != m_Metrics.end();) {
+			/* Drop checkables which were deleted since their last check result. */
+			if (!it->second->Object->IsActive()) {
+				m_SeriesCount -= it->second->SeriesCount;
+				it = m_Metrics.erase(it);
+				continue;
+			}
+
+			entries.push_back(it->second);
+			it++;
+		}
+	}
+
+	response.SetStatus(200, "OK");
+	response.AddHeader("Content-Type", "application/openmetrics-text; version=1.0.0; charset=utf-8");
+
+	String buffer;
+
+	for (int family = 0; family < MetricFamilyCount; family++) {
+		if (family != MetricValue && !GetEnableSendThresholds())
+			break;
+
+		buffer += "# TYPE " + GetMetricFamilyName(family) + " gauge\n";
+
+		for (const std::shared_ptr<const MetricsEntry>& entry : entries) {
+			buffer += entry->Samples[family];
+
+			if (buffer.GetLength() >= OPENMETRICS_CHUNK_SIZE) {
+				response.WriteBody(buffer.CStr(), buffer.GetLength());
+				buffer.Clear();
+
+				response.WaitForSendQueue(OPENMETRICS_SEND_QUEUE_SIZE);
+
+				if (!response.IsPeerConnected())
+					return;
+			}
+		}
+	}
+
+	buffer += "# EOF\n";
+
+	response.WriteBody(buffer.CStr(), buffer.GetLength());
+}
+
+String OpenMetricsExporter::GetMetricFamilyName(int family) const
+{
+	static const char * const suffixes[] = { "", "_warn", "_crit", "_min", "_max" };
+
+	return GetMetricPrefix() + "_perfdata" + suffixes[family];
+}
+
+String OpenMetricsExporter::EscapeLabelValue(const String& str)
+{
+	String result;
+
+	for (char ch : str) {
+		if (ch == '\\')
+			result += "\\\\";
+		else if (ch == '"')
+			result += "\\\"";
+		else if (ch == '\n')
+			result += "\\n";
+		else
+			result += ch;
+	}
+
+	return result;
+}
+
+String OpenMetricsExporter::FormatValue(double value)
+{
+	if (std::isnan(value))
+		return "NaN";
+
+	if (std::isinf(value))
+		return value > 0 ? "+Inf" : "-Inf";
+
+	return Convert::ToString(value);
+}
+
+void OpenMetricsExporter::ValidateMetricPrefix(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<OpenMetricsExporter>::ValidateMetricPrefix(lvalue, utils);
+
+	boost::regex expr("^[a-zA-Z_:][a-zA-Z0-9_:]*$");
+
+	if (!boost::regex_match(lvalue().GetData(), expr))
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "metric_prefix" }, "Metric prefix '" + lvalue() + "' is not a valid metric name."));
+}
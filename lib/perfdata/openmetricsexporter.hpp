@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef OPENMETRICSEXPORTER_H
+#define OPENMETRICSEXPORTER_H
+
+#include "perfdata/openmetricsexporter-ti.hpp"
+#include "icinga/checkable.hpp"
+#include "remote/httpresponse.hpp"
+#include <boost/thread/mutex.hpp>
+#include <memory>
+#include <unordered_map>
+
+namespace icinga
+{
+
+/**
+ * Keeps the latest performance data values of all checkables and renders
+ * them in the OpenMetrics text format for scrapers.
+ *
+ * @ingroup perfdata
+ */
+class OpenMetricsExporter final : public ObjectImpl<OpenMetricsExporter>
+{
+public:
+	DECLARE_OBJECT(OpenMetricsExporter);
+	DECLARE_OBJECTNAME(OpenMetricsExporter);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+	void WriteMetrics(HttpResponse& response);
+	size_t GetSeriesCount() const;
+
+	void ValidateMetricPrefix(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+
+protected:
+	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+
+private:
+	enum MetricFamily
+	{
+		MetricValue,
+		MetricWarn,
+		MetricCrit,
+		MetricMin,
+		MetricMax,
+		MetricFamilyCount
+	};
+
+	/**
+	 * The rendered samples of one checkable, one fragment per metric family.
+	 */
+	struct MetricsEntry
+	{
+		Checkable::Ptr Object;
+		String Samples[MetricFamilyCount];
+		size_t SeriesCount{0};
+	};
+
+	mutable boost::mutex m_Mutex;
+	std::unordered_map<Checkable *, std::shared_ptr<const MetricsEntry> > m_Metrics;
+	size_t m_SeriesCount{0};
+
+	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void RemoveEntry(Checkable *checkable);
+	String GetMetricFamilyName(int family) const;
+
+	static String EscapeLabelValue(const String& str);
+	static String FormatValue(double value);
+};
+
+}
+
+#endif /* OPENMETRICSEXPORTER_H */
@@ -44,12 +44,13 @@ REGISTER_TYPE(OpenTsdbWriter);
 
 REGISTER_STATSFUNCTION(OpenTsdbWriter, &OpenTsdbWriter::StatsFunc);
 
-void OpenTsdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void OpenTsdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const OpenTsdbWriter::Ptr& opentsdbwriter : ConfigType::GetObjectsByType<OpenTsdbWriter>()) {
-		nodes.emplace_back(opentsdbwriter->GetName(), 1); //add more stats
+		nodes.emplace_back(opentsdbwriter->GetName(),
+			opentsdbwriter->GetPipelineStats("opentsdbwriter_" + opentsdbwriter->GetName(), perfdata));
 	}
 
 	status->Set("opentsdbwriter", new Dictionary(std::move(nodes)));
@@ -62,13 +63,13 @@ void OpenTsdbWriter::Start(bool runtimeCreated)
 	Log(LogInformation, "OpentsdbWriter")
 		<< "'" << GetName() << "' started.";
 
-	m_ReconnectTimer = new Timer();
+	m_ReconnectTimer = new Timer("OpenTsdbWriter reconnect");
 	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&OpenTsdbWriter::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
-	Service::OnNewCheckResult.connect(std::bind(&OpenTsdbWriter::CheckResultHandler, this, _1, _2));
+	Service::OnNewCheckResult.connect(std::bind(&OpenTsdbWriter::CheckResultHandler, this, _1, _2), "OpenTsdbWriter::CheckResultHandler");
 }
 
 void OpenTsdbWriter::Stop(bool runtimeRemoved)
@@ -76,13 +77,19 @@ void OpenTsdbWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "OpentsdbWriter")
 		<< "'" << GetName() << "' stopped.";
 
+	m_ReconnectTimer->Stop();
+
 	ObjectImpl<OpenTsdbWriter>::Stop(runtimeRemoved);
 }
 
 void OpenTsdbWriter::ReconnectTimerHandler()
 {
-	if (m_Stream)
-		return;
+	{
+		ObjectLock olock(this);
+
+		if (m_Stream)
+			return;
+	}
 
 	TcpSocket::Ptr socket = new TcpSocket();
 
@@ -97,11 +104,20 @@ void OpenTsdbWriter::ReconnectTimerHandler()
 		return;
 	}
 
+	ObjectLock olock(this);
+
 	m_Stream = new NetworkStream(socket);
 }
 
 void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
 {
+	m_WorkQueue.Enqueue(std::bind(&OpenTsdbWriter::CheckResultHandlerInternal, this, checkable, cr));
+}
+
+void OpenTsdbWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+{
+	AssertOnWorkQueue();
+
 	CONTEXT("Processing check result for '" + checkable->GetName() + "'");
 
 	if (!IcingaApplication::GetInstance()->GetEnablePerfdata() || !checkable->GetEnablePerfdata())
@@ -139,7 +155,7 @@ void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 	SendMetric(metric + ".downtime_depth", tags, checkable->GetDowntimeDepth(), ts);
 	SendMetric(metric + ".acknowledgement", tags, checkable->GetAcknowledgement(), ts);
 
-	SendPerfdata(metric, tags, cr, ts);
+	SendPerfdata(checkable, metric, tags, cr, ts);
 
 	metric = "icinga.check";
 
@@ -158,29 +174,26 @@ void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 	SendMetric(metric + ".execution_time", tags, cr->CalculateExecutionTime(), ts);
 }
 
-void OpenTsdbWriter::SendPerfdata(const String& metric, const std::map<String, String>& tags, const CheckResult::Ptr& cr, double ts)
+void OpenTsdbWriter::SendPerfdata(const Checkable::Ptr& checkable, const String& metric, const std::map<String, String>& tags, const CheckResult::Ptr& cr, double ts)
 {
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	Array::Ptr perfdata = cr->GetParsedPerformanceData();
 
 	if (!perfdata)
 		return;
 
 	ObjectLock olock(perfdata);
 	for (const Value& val : perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "OpenTsdbWriter")
-					<< "Ignoring invalid perfdata value: " << val;
-				continue;
-			}
+		if (!val.IsObjectType<PerfdataValue>()) {
+			Log(LogWarning, "OpenTsdbWriter")
+				<< "Ignoring invalid perfdata value: " << val;
+			continue;
 		}
 
+		PerfdataValue::Ptr pdv = val;
+
+		if (!ShouldSendPerfdataValue(checkable, pdv, ts))
+			continue;
+
 		String escaped_key = EscapeMetric(pdv->GetLabel());
 		boost::algorithm::replace_all(escaped_key, "::", ".");
 
@@ -217,21 +230,35 @@ void OpenTsdbWriter::SendMetric(const String& metric, const std::map<String, Str
 
 	/* do not send \n to debug log */
 	msgbuf << "\n";
-	String put = msgbuf.str();
 
+	AddRecord(msgbuf.str());
+}
+
+/**
+ * Sends a batch of metrics with a single write.
+ *
+ * @param data The put commands.
+ * @returns false if OpenTSDB is not connected.
+ */
+bool OpenTsdbWriter::SendBatch(const String& data)
+{
 	ObjectLock olock(this);
 
 	if (!m_Stream)
-		return;
+		return false;
 
 	try {
-		m_Stream->Write(put.CStr(), put.GetLength());
+		m_Stream->Write(data.CStr(), data.GetLength());
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "OpenTsdbWriter")
 			<< "Cannot write to OpenTSDB TSD on host '" << GetHost() << "' port '" << GetPort() + "'.";
 
 		m_Stream.reset();
+
+		return false;
 	}
+
+	return true;
 }
 
 /* for metric and tag name rules, see
@@ -22,7 +22,6 @@
 
 #include "perfdata/opentsdbwriter-ti.hpp"
 #include "icinga/service.hpp"
-#include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
 #include <fstream>
@@ -47,14 +46,17 @@ protected:
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
+	bool SendBatch(const String& data) override;
+
 private:
 	Stream::Ptr m_Stream;
 
 	Timer::Ptr m_ReconnectTimer;
 
 	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	void SendMetric(const String& metric, const std::map<String, String>& tags, double value, double ts);
-	void SendPerfdata(const String& metric, const std::map<String, String>& tags, const CheckResult::Ptr& cr, double ts);
+	void SendPerfdata(const Checkable::Ptr& checkable, const String& metric, const std::map<String, String>& tags, const CheckResult::Ptr& cr, double ts);
 	static String EscapeTag(const String& str);
 	static String EscapeMetric(const String& str);
 
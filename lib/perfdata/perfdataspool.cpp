@@ -0,0 +1,245 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "perfdata/perfdataspool.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace icinga;
+
+/**
+ * Opens the spool in the specified directory and picks up the segments
+ * left over from a previous run.
+ *
+ * @param path The spool directory. It is created if necessary.
+ * @param maxSize The maximum number of bytes kept on disk.
+ * @param segmentSize The size after which a new segment is started.
+ */
+PerfdataSpool::PerfdataSpool(const String& path, size_t maxSize, size_t segmentSize)
+	: m_Path(path), m_MaxSize(maxSize), m_SegmentSize(segmentSize)
+{
+	Utility::MkDirP(m_Path, 0750);
+
+	Utility::Glob(m_Path + "/*.spool", [this](const String& file) {
+		/* Segments are named <id>-<timestamp>.spool */
+		String name = Utility::BaseName(file);
+		std::vector<String> tokens = name.SubStr(0, name.GetLength() - 6).Split("-");
+
+		if (tokens.size() != 2)
+			return;
+
+		Segment segment;
+
+		try {
+			segment.Id = Convert::ToLong(tokens[0]);
+			segment.Timestamp = Convert::ToDouble(tokens[1]);
+		} catch (const std::exception&) {
+			return;
+		}
+
+		std::ifstream fp(file.CStr(), std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+
+		if (!fp)
+			return;
+
+		segment.Size = fp.tellg();
+
+		m_Segments.push_back(segment);
+		m_Size += segment.Size;
+	}, GlobFile);
+
+	std::sort(m_Segments.begin(), m_Segments.end(), [](const Segment& a, const Segment& b) {
+		return a.Id < b.Id;
+	});
+
+	if (!m_Segments.empty()) {
+		m_NextId = m_Segments.back().Id + 1;
+
+		Log(LogInformation, "PerfdataSpool")
+			<< "Found " << m_Segments.size() << " spooled segments (" << m_Size << " bytes) in '" << m_Path << "'.";
+	}
+
+	while (m_Size > m_MaxSize && !m_Segments.empty())
+		DropOldest();
+}
+
+/**
+ * Appends data to the newest segment. Old segments are dropped to keep
+ * the spool below its maximum size.
+ *
+ * @param data The data.
+ */
+void PerfdataSpool::Append(const String& data)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (data.GetLength() > m_MaxSize) {
+		Log(LogWarning, "PerfdataSpool")
+			<< "Dropping " << data.GetLength() << " bytes which exceed the spool size limit of '" << m_Path << "'.";
+		return;
+	}
+
+	while (m_Size + data.GetLength() > m_MaxSize && !m_Segments.empty())
+		DropOldest();
+
+	if (!m_LastSegmentOpen || m_Segments.back().Size >= m_SegmentSize) {
+		Segment segment;
+		segment.Id = m_NextId++;
+		segment.Timestamp = static_cast<long>(Utility::GetTime());
+		segment.Size = 0;
+
+		m_Segments.push_back(segment);
+		m_LastSegmentOpen = true;
+	}
+
+	Segment& segment = m_Segments.back();
+
+	std::ofstream fp(GetSegmentPath(segment).CStr(), std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+	fp.write(data.CStr(), data.GetLength());
+	fp.close();
+
+	if (!fp) {
+		Log(LogWarning, "PerfdataSpool")
+			<< "Could not write " << data.GetLength() << " bytes to '" << GetSegmentPath(segment) << "'.";
+		return;
+	}
+
+	segment.Size += data.GetLength();
+	m_Size += data.GetLength();
+}
+
+/**
+ * Reads the oldest segment. New data is appended to a new segment
+ * afterwards, so the segment can be removed once it has been replayed.
+ *
+ * @param id Returns the segment ID.
+ * @param data Returns the segment's content.
+ * @returns false if the spool is empty.
+ */
+bool PerfdataSpool::ReadOldest(unsigned long *id, String *data)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	while (!m_Segments.empty()) {
+		const Segment& segment = m_Segments.front();
+
+		if (m_Segments.size() == 1)
+			m_LastSegmentOpen = false;
+
+		std::ifstream fp(GetSegmentPath(segment).CStr(), std::ifstream::in | std::ifstream::binary);
+
+		if (fp) {
+			std::ostringstream msgbuf;
+			msgbuf << fp.rdbuf();
+
+			*id = segment.Id;
+			*data = msgbuf.str();
+			return true;
+		}
+
+		Log(LogWarning, "PerfdataSpool")
+			<< "Could not read spooled segment '" << GetSegmentPath(segment) << "'.";
+
+		m_Size -= segment.Size;
+		m_Segments.pop_front();
+	}
+
+	return false;
+}
+
+/**
+ * Removes a segment which has been replayed.
+ *
+ * @param id The segment ID.
+ */
+void PerfdataSpool::Remove(unsigned long id)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	for (auto it = m_Segments.begin(); it != m_Segments.end(); it++) {
+		if (it->Id != id)
+			continue;
+
+		if (std::next(it) == m_Segments.end())
+			m_LastSegmentOpen = false;
+
+		(void) unlink(GetSegmentPath(*it).CStr());
+
+		m_Size -= it->Size;
+		m_Segments.erase(it);
+		return;
+	}
+}
+
+bool PerfdataSpool::IsEmpty() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_Segments.empty();
+}
+
+size_t PerfdataSpool::GetSegmentCount() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_Segments.size();
+}
+
+size_t PerfdataSpool::GetSize() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_Size;
+}
+
+/**
+ * Returns the number of seconds since the oldest spooled segment was started.
+ */
+double PerfdataSpool::GetAge() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (m_Segments.empty())
+		return 0;
+
+	return std::max(0.0, Utility::GetTime() - m_Segments.front().Timestamp);
+}
+
+String PerfdataSpool::GetSegmentPath(const Segment& segment) const
+{
+	return m_Path + "/" + Convert::ToString(segment.Id) + "-" + Convert::ToString(static_cast<long>(segment.Timestamp)) + ".spool";
+}
+
+void PerfdataSpool::DropOldest()
+{
+	const Segment& segment = m_Segments.front();
+
+	Log(LogWarning, "PerfdataSpool")
+		<< "Spool '" << m_Path << "' is full. Dropping " << segment.Size << " bytes of spooled data.";
+
+	(void) unlink(GetSegmentPath(segment).CStr());
+
+	m_Size -= segment.Size;
+	m_Segments.pop_front();
+
+	if (m_Segments.empty())
+		m_LastSegmentOpen = false;
+}
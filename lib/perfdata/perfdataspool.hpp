@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef PERFDATASPOOL_H
+#define PERFDATASPOOL_H
+
+#include "base/string.hpp"
+#include <boost/thread/mutex.hpp>
+#include <deque>
+
+namespace icinga
+{
+
+/**
+ * A bounded on-disk queue for request bodies which could not be sent to
+ * a backend. Bodies are appended to segment files which are replayed and
+ * removed oldest first. The oldest segments are dropped when the spool
+ * exceeds its maximum size.
+ *
+ * @ingroup perfdata
+ */
+class PerfdataSpool
+{
+public:
+	PerfdataSpool(const String& path, size_t maxSize, size_t segmentSize = 1024 * 1024);
+
+	void Append(const String& data);
+
+	bool ReadOldest(unsigned long *id, String *data);
+	void Remove(unsigned long id);
+
+	bool IsEmpty() const;
+	size_t GetSegmentCount() const;
+	size_t GetSize() const;
+	double GetAge() const;
+
+private:
+	struct Segment
+	{
+		unsigned long Id;
+		double Timestamp;
+		size_t Size;
+	};
+
+	String m_Path;
+	size_t m_MaxSize;
+	size_t m_SegmentSize;
+
+	mutable boost::mutex m_Mutex;
+	std::deque<Segment> m_Segments;
+	bool m_LastSegmentOpen{false};
+	size_t m_Size{0};
+	unsigned long m_NextId{0};
+
+	String GetSegmentPath(const Segment& segment) const;
+	void DropOldest();
+};
+
+}
+
+#endif /* PERFDATASPOOL_H */
@@ -30,7 +30,13 @@
 #include "base/context.hpp"
 #include "base/exception.hpp"
 #include "base/application.hpp"
+#include "base/perfdatavalue.hpp"
 #include "base/statsfunction.hpp"
+#ifdef _WIN32
+#	include <io.h>
+#else /* _WIN32 */
+#	include <unistd.h>
+#endif /* _WIN32 */
 
 using namespace icinga;
 
@@ -38,12 +44,43 @@ REGISTER_TYPE(PerfdataWriter);
 
 REGISTER_STATSFUNCTION(PerfdataWriter, &PerfdataWriter::StatsFunc);
 
-void PerfdataWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+/* Producers trigger a flush once this many bytes are buffered. */
+#define PERFDATA_FLUSH_THRESHOLD (4 * 1024 * 1024)
+
+/* Buffer size of the output files. */
+#define PERFDATA_FILE_BUFFER_SIZE (1024 * 1024)
+
+static void SyncFile(FILE *output)
+{
+#ifdef _WIN32
+	_commit(_fileno(output));
+#elif defined(__APPLE__)
+	fsync(fileno(output));
+#else /* __APPLE__ */
+	fdatasync(fileno(output));
+#endif /* _WIN32 */
+}
+
+void PerfdataWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const PerfdataWriter::Ptr& perfdatawriter : ConfigType::GetObjectsByType<PerfdataWriter>()) {
-		nodes.emplace_back(perfdatawriter->GetName(), 1); //add more stats
+		size_t workQueueItems = perfdatawriter->m_WorkQueue.GetLength();
+		size_t dataBufferBytes;
+
+		{
+			boost::mutex::scoped_lock lock(perfdatawriter->m_BufferMutex);
+			dataBufferBytes = perfdatawriter->m_ServiceBuffer.size() + perfdatawriter->m_HostBuffer.size();
+		}
+
+		nodes.emplace_back(perfdatawriter->GetName(), new Dictionary({
+			{ "work_queue_items", workQueueItems },
+			{ "data_buffer_bytes", dataBufferBytes }
+		}));
+
+		perfdata->Add(new PerfdataValue("perfdatawriter_" + perfdatawriter->GetName() + "_work_queue_items", workQueueItems));
+		perfdata->Add(new PerfdataValue("perfdatawriter_" + perfdatawriter->GetName() + "_data_buffer_bytes", dataBufferBytes, false, "B"));
 	}
 
 	status->Set("perfdatawriter", new Dictionary(std::move(nodes)));
@@ -56,15 +93,23 @@ void PerfdataWriter::Start(bool runtimeCreated)
 	Log(LogInformation, "PerfdataWriter")
 		<< "'" << GetName() << "' started.";
 
-	Checkable::OnNewCheckResult.connect(std::bind(&PerfdataWriter::CheckResultHandler, this, _1, _2));
+	m_WorkQueue.SetName("PerfdataWriter, " + GetName());
+	m_WorkQueue.SetExceptionCallback(std::bind(&PerfdataWriter::ExceptionHandler, this, _1));
 
-	m_RotationTimer = new Timer();
+	/* Open the files before the first check result is written. */
+	m_WorkQueue.Enqueue(std::bind(&PerfdataWriter::RotateFiles, this));
+
+	Checkable::OnNewCheckResult.connect(std::bind(&PerfdataWriter::CheckResultHandler, this, _1, _2), "PerfdataWriter::CheckResultHandler");
+
+	m_FlushTimer = new Timer("PerfdataWriter flush");
+	m_FlushTimer->OnTimerExpired.connect(std::bind(&PerfdataWriter::FlushTimerHandler, this));
+	m_FlushTimer->SetInterval(GetFlushInterval());
+	m_FlushTimer->Start();
+
+	m_RotationTimer = new Timer("PerfdataWriter rotation");
 	m_RotationTimer->OnTimerExpired.connect(std::bind(&PerfdataWriter::RotationTimerHandler, this));
 	m_RotationTimer->SetInterval(GetRotationInterval());
 	m_RotationTimer->Start();
-
-	RotateFile(m_ServiceOutputFile, GetServiceTempPath(), GetServicePerfdataPath());
-	RotateFile(m_HostOutputFile, GetHostTempPath(), GetHostPerfdataPath());
 }
 
 void PerfdataWriter::Stop(bool runtimeRemoved)
@@ -72,9 +117,33 @@ void PerfdataWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "PerfdataWriter")
 		<< "'" << GetName() << "' stopped.";
 
+	m_FlushTimer->Stop();
+	m_RotationTimer->Stop();
+
+	/* Write the remaining lines. */
+	m_WorkQueue.Enqueue(std::bind(&PerfdataWriter::Flush, this));
+	m_WorkQueue.Join();
+
+	CloseFile(m_ServiceOutputFile);
+	CloseFile(m_HostOutputFile);
+
 	ObjectImpl<PerfdataWriter>::Stop(runtimeRemoved);
 }
 
+void PerfdataWriter::AssertOnWorkQueue()
+{
+	ASSERT(m_WorkQueue.IsWorkerThread());
+}
+
+void PerfdataWriter::ExceptionHandler(boost::exception_ptr exp)
+{
+	Log(LogCritical, "PerfdataWriter")
+		<< "Exception while writing performance data files: " << DiagnosticInformation(std::move(exp), false);
+
+	Log(LogDebug, "PerfdataWriter")
+		<< "Exception while writing performance data files: " << DiagnosticInformation(std::move(exp));
+}
+
 Value PerfdataWriter::EscapeMacroMetric(const Value& value)
 {
 	if (value.IsObjectType<Array>())
@@ -83,6 +152,10 @@ Value PerfdataWriter::EscapeMacroMetric(const Value& value)
 		return value;
 }
 
+/**
+ * Formats the perfdata line for a check result. The line is only added to
+ * a buffer, the files are written by the work queue.
+ */
 void PerfdataWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
 {
 	CONTEXT("Writing performance data for object '" + checkable->GetName() + "'");
@@ -104,35 +177,95 @@ void PerfdataWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 	resolvers.emplace_back("host", host);
 	resolvers.emplace_back("icinga", IcingaApplication::GetInstance());
 
-	if (service) {
-		String line = MacroProcessor::ResolveMacros(GetServiceFormatTemplate(), resolvers, cr, nullptr, &PerfdataWriter::EscapeMacroMetric);
+	String line = MacroProcessor::ResolveMacros(service ? GetServiceFormatTemplate() : GetHostFormatTemplate(),
+		resolvers, cr, nullptr, &PerfdataWriter::EscapeMacroMetric);
 
-		{
-			ObjectLock olock(this);
-			if (!m_ServiceOutputFile.good())
-				return;
+	size_t bufferSize;
 
-			m_ServiceOutputFile << line << "\n";
-		}
-	} else {
-		String line = MacroProcessor::ResolveMacros(GetHostFormatTemplate(), resolvers, cr, nullptr, &PerfdataWriter::EscapeMacroMetric);
+	{
+		boost::mutex::scoped_lock lock(m_BufferMutex);
 
-		{
-			ObjectLock olock(this);
-			if (!m_HostOutputFile.good())
-				return;
+		std::string& buffer = service ? m_ServiceBuffer : m_HostBuffer;
+		buffer += line.GetData();
+		buffer += '\n';
 
-			m_HostOutputFile << line << "\n";
-		}
+		bufferSize = buffer.size();
 	}
+
+	if (bufferSize >= PERFDATA_FLUSH_THRESHOLD)
+		EnqueueFlush();
+}
+
+void PerfdataWriter::FlushTimerHandler()
+{
+	EnqueueFlush();
+}
+
+void PerfdataWriter::EnqueueFlush()
+{
+	/* One pending flush writes everything which is buffered until it runs. */
+	if (m_FlushPending.exchange(true))
+		return;
+
+	m_WorkQueue.Enqueue(std::bind(&PerfdataWriter::Flush, this), PriorityHigh);
 }
 
-void PerfdataWriter::RotateFile(std::ofstream& output, const String& temp_path, const String& perfdata_path)
+/**
+ * Writes the buffered lines to the temporary files.
+ */
+void PerfdataWriter::Flush()
 {
-	ObjectLock olock(this);
+	AssertOnWorkQueue();
+
+	m_FlushPending = false;
 
-	if (output.good()) {
-		output.close();
+	std::string serviceData, hostData;
+
+	{
+		boost::mutex::scoped_lock lock(m_BufferMutex);
+		serviceData.swap(m_ServiceBuffer);
+		hostData.swap(m_HostBuffer);
+	}
+
+	WriteFile(m_ServiceOutputFile, serviceData, GetServiceTempPath());
+	WriteFile(m_HostOutputFile, hostData, GetHostTempPath());
+}
+
+void PerfdataWriter::WriteFile(FILE *output, const std::string& data, const String& path)
+{
+	if (data.empty() || !output)
+		return;
+
+	if (fwrite(data.c_str(), 1, data.size(), output) != data.size() || fflush(output) != 0) {
+		Log(LogWarning, "PerfdataWriter")
+			<< "Could not write to perfdata file '" << path << "': " << Utility::FormatErrorNumber(errno);
+		return;
+	}
+
+	if (GetSyncPolicy() == "flush")
+		SyncFile(output);
+}
+
+void PerfdataWriter::CloseFile(FILE *& output)
+{
+	if (!output)
+		return;
+
+	fflush(output);
+
+	if (GetSyncPolicy() != "none")
+		SyncFile(output);
+
+	fclose(output);
+	output = nullptr;
+}
+
+void PerfdataWriter::RotateFile(FILE *& output, const String& temp_path, const String& perfdata_path)
+{
+	AssertOnWorkQueue();
+
+	if (output) {
+		CloseFile(output);
 
 		if (Utility::PathExists(temp_path)) {
 			String finalFile = perfdata_path + "." + Convert::ToString((long)Utility::GetTime());
@@ -145,15 +278,33 @@ void PerfdataWriter::RotateFile(std::ofstream& output, const String& temp_path,
 		}
 	}
 
-	output.open(temp_path.CStr());
+	output = fopen(temp_path.CStr(), "w");
 
-	if (!output.good())
+	if (!output) {
 		Log(LogWarning, "PerfdataWriter")
 			<< "Could not open perfdata file '" << temp_path << "' for writing. Perfdata will be lost.";
+		return;
+	}
+
+	setvbuf(output, nullptr, _IOFBF, PERFDATA_FILE_BUFFER_SIZE);
 }
 
 void PerfdataWriter::RotationTimerHandler()
 {
+	m_WorkQueue.Enqueue(std::bind(&PerfdataWriter::RotateFiles, this), PriorityHigh);
+}
+
+/**
+ * Moves the temporary files to the perfdata paths. This runs on the work
+ * queue, so check results are buffered meanwhile.
+ */
+void PerfdataWriter::RotateFiles()
+{
+	AssertOnWorkQueue();
+
+	/* The lines buffered so far belong into the current files. */
+	Flush();
+
 	RotateFile(m_ServiceOutputFile, GetServiceTempPath(), GetServicePerfdataPath());
 	RotateFile(m_HostOutputFile, GetHostTempPath(), GetHostPerfdataPath());
 }
@@ -173,3 +324,19 @@ void PerfdataWriter::ValidateServiceFormatTemplate(const Lazy<String>& lvalue, c
 	if (!MacroProcessor::ValidateMacroString(lvalue()))
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "service_format_template" }, "Closing $ not found in macro format string '" + lvalue() + "'."));
 }
+
+void PerfdataWriter::ValidateFlushInterval(const Lazy<double>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<PerfdataWriter>::ValidateFlushInterval(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "flush_interval" }, "Value must be greater than 0."));
+}
+
+void PerfdataWriter::ValidateSyncPolicy(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<PerfdataWriter>::ValidateSyncPolicy(lvalue, utils);
+
+	if (lvalue() != "none" && lvalue() != "rotation" && lvalue() != "flush")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "sync_policy" }, "Value must be one of 'none', 'rotation' or 'flush'."));
+}
@@ -24,7 +24,9 @@
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
-#include <fstream>
+#include "base/workqueue.hpp"
+#include <atomic>
+#include <cstdio>
 
 namespace icinga
 {
@@ -44,21 +46,41 @@ public:
 
 	void ValidateHostFormatTemplate(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
 	void ValidateServiceFormatTemplate(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateFlushInterval(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
+	void ValidateSyncPolicy(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
 
 protected:
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
 private:
+	WorkQueue m_WorkQueue{10000000, 1};
+
+	boost::mutex m_BufferMutex;
+	std::string m_ServiceBuffer;
+	std::string m_HostBuffer;
+	std::atomic<bool> m_FlushPending{false};
+
 	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	static Value EscapeMacroMetric(const Value& value);
 
+	Timer::Ptr m_FlushTimer;
+	void FlushTimerHandler();
+	void EnqueueFlush();
+	void Flush();
+
 	Timer::Ptr m_RotationTimer;
 	void RotationTimerHandler();
+	void RotateFiles();
+
+	FILE *m_ServiceOutputFile{nullptr};
+	FILE *m_HostOutputFile{nullptr};
+	void WriteFile(FILE *output, const std::string& data, const String& path);
+	void RotateFile(FILE *& output, const String& temp_path, const String& perfdata_path);
+	void CloseFile(FILE *& output);
 
-	std::ofstream m_ServiceOutputFile;
-	std::ofstream m_HostOutputFile;
-	void RotateFile(std::ofstream& output, const String& temp_path, const String& perfdata_path);
+	void AssertOnWorkQueue();
+	void ExceptionHandler(boost::exception_ptr exp);
 };
 
 }
@@ -117,6 +117,26 @@ struct PgsqlInterfaceImpl final : public PgsqlInterface
 	{
 		return PQstatus(conn);
 	}
+
+	int sendQuery(PGconn *conn, const char *query) const override
+	{
+		return PQsendQuery(conn, query);
+	}
+
+	PGresult *getResult(PGconn *conn) const override
+	{
+		return PQgetResult(conn);
+	}
+
+	int putCopyData(PGconn *conn, const char *buffer, int nbytes) const override
+	{
+		return PQputCopyData(conn, buffer, nbytes);
+	}
+
+	int putCopyEnd(PGconn *conn, const char *errormsg) const override
+	{
+		return PQputCopyEnd(conn, errormsg);
+	}
 };
 
 PgsqlInterface *create_pgsql_shim()
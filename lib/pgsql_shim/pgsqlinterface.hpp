@@ -52,6 +52,10 @@ struct PgsqlInterface
 	virtual PGconn *setdbLogin(const char *pghost, const char *pgport, const char *pgoptions, const char *pgtty, const char *dbName, const char *login, const char *pwd) const = 0;
 	virtual PGconn *connectdb(const char *conninfo) const = 0;
 	virtual ConnStatusType status(const PGconn *conn) const = 0;
+	virtual int sendQuery(PGconn *conn, const char *query) const = 0;
+	virtual PGresult *getResult(PGconn *conn) const = 0;
+	virtual int putCopyData(PGconn *conn, const char *buffer, int nbytes) const = 0;
+	virtual int putCopyEnd(PGconn *conn, const char *errormsg) const = 0;
 
 protected:
 	PgsqlInterface() = default;
@@ -23,12 +23,107 @@
 #include "remote/apiaction.hpp"
 #include "base/exception.hpp"
 #include "base/logger.hpp"
+#include "base/objectlock.hpp"
 #include <set>
 
 using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/actions", ActionsHandler);
 
+static Dictionary::Ptr CreateBatchResult(int code, const String& status)
+{
+	return new Dictionary({
+		{ "code", code },
+		{ "status", status }
+	});
+}
+
+Dictionary::Ptr ActionsHandler::InvokeAction(const ApiAction::Ptr& action, const ConfigObject::Ptr& target,
+	const Dictionary::Ptr& params, bool verbose)
+{
+	try {
+		return action->Invoke(target, params);
+	} catch (const std::exception& ex) {
+		Dictionary::Ptr fail = new Dictionary({
+			{ "code", 500 },
+			{ "status", "Action execution failed: '" + DiagnosticInformation(ex, false) + "'." }
+		});
+
+		/* Exception for actions. Normally we would handle this inside SendJsonError(). */
+		if (verbose)
+			fail->Set("diagnostic_information", DiagnosticInformation(ex));
+
+		return fail;
+	}
+}
+
+/**
+ * Runs an action for each item of a batch. Every item holds the parameters
+ * for one invocation and names its target object like a single request
+ * would (e.g. `service`). The permission filters are compiled once for the
+ * whole batch and the targets are looked up by name instead of evaluating
+ * a filter for each item.
+ */
+ArrayData ActionsHandler::InvokeBatch(const ApiUser::Ptr& user, const String& actionName,
+	const ApiAction::Ptr& action, const Array::Ptr& batch, bool verbose)
+{
+	Expression *filter;
+	FilterUtility::CheckPermission(user, "actions/" + actionName, &filter);
+	std::unique_ptr<Expression> permissionFilter(filter);
+
+	ConfigObjectTargetProvider::Ptr provider = new ConfigObjectTargetProvider();
+	ScriptFrame permissionFrame(true);
+
+	std::vector<std::pair<String, String> > typeAttrs;
+
+	for (const String& type : action->GetTypes())
+		typeAttrs.emplace_back(type, type.ToLower());
+
+	ArrayData results;
+
+	ObjectLock olock(batch);
+	for (const Value& vitem : batch) {
+		if (!vitem.IsObjectType<Dictionary>()) {
+			results.emplace_back(CreateBatchResult(400, "Batch items must be dictionaries."));
+			continue;
+		}
+
+		Dictionary::Ptr item = vitem;
+		String type, name;
+
+		for (const auto& typeAttr : typeAttrs) {
+			if (item->Contains(typeAttr.second)) {
+				type = typeAttr.first;
+				name = item->Get(typeAttr.second);
+				break;
+			}
+		}
+
+		if (type.IsEmpty()) {
+			results.emplace_back(CreateBatchResult(400, "Batch item doesn't specify a target object."));
+			continue;
+		}
+
+		ConfigObject::Ptr target;
+
+		try {
+			target = provider->GetTargetByName(type, name);
+		} catch (const std::exception&) {
+			results.emplace_back(CreateBatchResult(404, "Object '" + name + "' of type '" + type + "' does not exist."));
+			continue;
+		}
+
+		if (!FilterUtility::EvaluateFilter(permissionFrame, permissionFilter.get(), target)) {
+			results.emplace_back(CreateBatchResult(403, "Access denied to object '" + name + "' of type '" + type + "'."));
+			continue;
+		}
+
+		results.emplace_back(InvokeAction(action, target, item, verbose));
+	}
+
+	return results;
+}
+
 bool ActionsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
 {
 	if (request.RequestUrl->GetPath().size() != 3)
@@ -46,19 +141,26 @@ bool ActionsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& reques
 		return true;
 	}
 
-	QueryDescription qd;
+	bool verbose = false;
+
+	if (params)
+		verbose = HttpUtility::GetLastParameter(params, "verbose");
 
-	const std::vector<String>& types = action->GetTypes();
-	std::vector<Value> objs;
+	ArrayData results;
 
-	String permission = "actions/" + actionName;
+	if (params && params->Contains("batch")) {
+		Value batch = params->Get("batch");
 
-	if (!types.empty()) {
-		qd.Types = std::set<String>(types.begin(), types.end());
-		qd.Permission = permission;
+		if (action->GetTypes().empty() || !batch.IsObjectType<Array>()) {
+			HttpUtility::SendJsonError(response, params, 400, "Invalid value for 'batch' specified.");
+			return true;
+		}
+
+		Log(LogNotice, "ApiActionHandler")
+			<< "Running action " << actionName << " for a batch of " << static_cast<Array::Ptr>(batch)->GetLength() << " items";
 
 		try {
-			objs = FilterUtility::GetFilterTargets(qd, params, user);
+			results = InvokeBatch(user, actionName, action, batch, verbose);
 		} catch (const std::exception& ex) {
 			HttpUtility::SendJsonError(response, params, 404,
 				"No objects found.",
@@ -66,35 +168,35 @@ bool ActionsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& reques
 			return true;
 		}
 	} else {
-		FilterUtility::CheckPermission(user, permission);
-		objs.emplace_back(nullptr);
-	}
-
-	ArrayData results;
-
-	Log(LogNotice, "ApiActionHandler")
-		<< "Running action " << actionName;
-
-	bool verbose = false;
-
-	if (params)
-		verbose = HttpUtility::GetLastParameter(params, "verbose");
-
-	for (const ConfigObject::Ptr& obj : objs) {
-		try {
-			results.emplace_back(action->Invoke(obj, params));
-		} catch (const std::exception& ex) {
-			Dictionary::Ptr fail = new Dictionary({
-				{ "code", 500 },
-				{ "status", "Action execution failed: '" + DiagnosticInformation(ex, false) + "'." }
-			});
+		QueryDescription qd;
+
+		const std::vector<String>& types = action->GetTypes();
+		std::vector<Value> objs;
+
+		String permission = "actions/" + actionName;
+
+		if (!types.empty()) {
+			qd.Types = std::set<String>(types.begin(), types.end());
+			qd.Permission = permission;
+
+			try {
+				objs = FilterUtility::GetFilterTargets(qd, params, user);
+			} catch (const std::exception& ex) {
+				HttpUtility::SendJsonError(response, params, 404,
+					"No objects found.",
+					DiagnosticInformation(ex));
+				return true;
+			}
+		} else {
+			FilterUtility::CheckPermission(user, permission);
+			objs.emplace_back(nullptr);
+		}
 
-			/* Exception for actions. Normally we would handle this inside SendJsonError(). */
-			if (verbose)
-				fail->Set("diagnostic_information", DiagnosticInformation(ex));
+		Log(LogNotice, "ApiActionHandler")
+			<< "Running action " << actionName;
 
-			results.emplace_back(std::move(fail));
-		}
+		for (const ConfigObject::Ptr& obj : objs)
+			results.emplace_back(InvokeAction(action, obj, params, verbose));
 	}
 
 	int statusCode = 500;
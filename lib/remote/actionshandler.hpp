@@ -21,6 +21,7 @@
 #define ACTIONSHANDLER_H
 
 #include "remote/httphandler.hpp"
+#include "remote/apiaction.hpp"
 
 namespace icinga
 {
@@ -32,6 +33,12 @@ public:
 
 	bool HandleRequest(const ApiUser::Ptr& user, HttpRequest& request,
 		HttpResponse& response, const Dictionary::Ptr& params) override;
+
+private:
+	static Dictionary::Ptr InvokeAction(const ApiAction::Ptr& action, const ConfigObject::Ptr& target,
+		const Dictionary::Ptr& params, bool verbose);
+	static ArrayData InvokeBatch(const ApiUser::Ptr& user, const String& actionName,
+		const ApiAction::Ptr& action, const Array::Ptr& batch, bool verbose);
 };
 
 }
@@ -179,3 +179,55 @@ void ApiClient::AutocompleteScriptHttpCompletionCallback(HttpRequest& request,
 		callback(boost::current_exception(), nullptr);
 	}
 }
+
+void ApiClient::GetStatus(const String& name, const GetStatusCompletionCallback& callback) const
+{
+	Url::Ptr url = new Url();
+	url->SetScheme("https");
+	url->SetHost(m_Connection->GetHost());
+	url->SetPort(m_Connection->GetPort());
+	url->SetPath({ "v1", "status", name });
+
+	try {
+		std::shared_ptr<HttpRequest> req = m_Connection->NewRequest();
+		req->RequestMethod = "GET";
+		req->RequestUrl = url;
+		req->AddHeader("Authorization", "Basic " + Base64::Encode(m_User + ":" + m_Password));
+		req->AddHeader("Accept", "application/json");
+		m_Connection->SubmitRequest(req, std::bind(GetStatusHttpCompletionCallback, _1, _2, callback));
+	} catch (const std::exception&) {
+		callback(boost::current_exception(), nullptr);
+	}
+}
+
+void ApiClient::GetStatusHttpCompletionCallback(HttpRequest& request,
+	HttpResponse& response, const GetStatusCompletionCallback& callback)
+{
+	String body;
+	char buffer[1024];
+	size_t count;
+
+	while ((count = response.ReadBody(buffer, sizeof(buffer))) > 0)
+		body += String(buffer, buffer + count);
+
+	try {
+		if (response.StatusCode < 200 || response.StatusCode > 299) {
+			std::string message = "HTTP request failed; Code: " + Convert::ToString(response.StatusCode) + "; Body: " + body;
+
+			BOOST_THROW_EXCEPTION(ScriptError(message));
+		}
+
+		Dictionary::Ptr result = JsonDecode(body);
+
+		Array::Ptr results = result->Get("results");
+
+		if (!results || results->GetLength() == 0)
+			BOOST_THROW_EXCEPTION(ScriptError("Unexpected result from API."));
+
+		Dictionary::Ptr resultInfo = results->Get(0);
+
+		callback(boost::exception_ptr(), resultInfo->Get("status"));
+	} catch (const std::exception&) {
+		callback(boost::current_exception(), nullptr);
+	}
+}
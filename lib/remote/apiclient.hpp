@@ -44,6 +44,9 @@ public:
 	void AutocompleteScript(const String& session, const String& command, bool sandboxed,
 		const AutocompleteScriptCompletionCallback& callback) const;
 
+	typedef std::function<void(boost::exception_ptr, const Dictionary::Ptr&)> GetStatusCompletionCallback;
+	void GetStatus(const String& name, const GetStatusCompletionCallback& callback) const;
+
 private:
 	HttpClientConnection::Ptr m_Connection;
 	String m_User;
@@ -53,6 +56,8 @@ private:
 		HttpResponse& response, const ExecuteScriptCompletionCallback& callback);
 	static void AutocompleteScriptHttpCompletionCallback(HttpRequest& request,
 		HttpResponse& response, const AutocompleteScriptCompletionCallback& callback);
+	static void GetStatusHttpCompletionCallback(HttpRequest& request,
+		HttpResponse& response, const GetStatusCompletionCallback& callback);
 };
 
 }
@@ -19,6 +19,7 @@
 
 #include "remote/apifunction.hpp"
 #include "base/singleton.hpp"
+#include "base/utility.hpp"
 
 using namespace icinga;
 
@@ -28,7 +29,35 @@ ApiFunction::ApiFunction(Callback function)
 
 Value ApiFunction::Invoke(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& arguments)
 {
-	return m_Callback(origin, arguments);
+	double start = Utility::GetTime();
+	Value result;
+
+	try {
+		result = m_Callback(origin, arguments);
+	} catch (...) {
+		m_Durations.Record(Utility::GetTime() - start);
+		throw;
+	}
+
+	m_Durations.Record(Utility::GetTime() - start);
+
+	return result;
+}
+
+/**
+ * Returns how long calls to this function took recently.
+ */
+Dictionary::Ptr ApiFunction::GetStats() const
+{
+	return new Dictionary({
+		{ "count", m_Durations.GetCount() },
+		{ "min", m_Durations.GetMin() },
+		{ "max", m_Durations.GetMax() },
+		{ "avg", m_Durations.GetAverage() },
+		{ "p50", m_Durations.GetPercentile(50) },
+		{ "p95", m_Durations.GetPercentile(95) },
+		{ "p99", m_Durations.GetPercentile(99) }
+	});
 }
 
 ApiFunction::Ptr ApiFunction::GetByName(const String& name)
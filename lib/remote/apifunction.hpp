@@ -25,6 +25,7 @@
 #include "base/registry.hpp"
 #include "base/value.hpp"
 #include "base/dictionary.hpp"
+#include "base/histogram.hpp"
 #include <vector>
 
 namespace icinga
@@ -46,12 +47,15 @@ public:
 
 	Value Invoke(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& arguments);
 
+	Dictionary::Ptr GetStats() const;
+
 	static ApiFunction::Ptr GetByName(const String& name);
 	static void Register(const String& name, const ApiFunction::Ptr& function);
 	static void Unregister(const String& name);
 
 private:
 	Callback m_Callback;
+	Histogram m_Durations;
 };
 
 /**
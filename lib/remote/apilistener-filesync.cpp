@@ -24,12 +24,64 @@
 #include "base/logger.hpp"
 #include "base/convert.hpp"
 #include "base/exception.hpp"
+#include "base/tlsutility.hpp"
+#include <cctype>
 #include <fstream>
 #include <iomanip>
+#include <set>
 
 using namespace icinga;
 
 REGISTER_APIFUNCTION(Update, config, &ApiListener::ConfigUpdateHandler);
+REGISTER_APIFUNCTION(Manifest, config, &ApiListener::ConfigManifestHandler);
+REGISTER_APIFUNCTION(RequestFiles, config, &ApiListener::ConfigRequestFilesHandler);
+REGISTER_APIFUNCTION(FileChunk, config, &ApiListener::ConfigFileChunkHandler);
+
+/* Config files are sent in chunks of this size. */
+#define CONFIG_SYNC_CHUNK_SIZE (256 * 1024)
+
+/* The number of bytes which are sent for one config::RequestFiles message in a resumable transfer. */
+#define CONFIG_SYNC_WINDOW_SIZE (4 * CONFIG_SYNC_CHUNK_SIZE)
+
+/**
+ * Returns the directory in which the files of a resumable transfer are
+ * stored until the transfer is complete. The files are named after their
+ * checksum.
+ */
+static String GetConfigStageDir(const String& zoneName)
+{
+	return Application::GetLocalStateDir() + "/lib/icinga2/api/zones-stage/" + zoneName;
+}
+
+static bool IsValidChecksum(const String& checksum)
+{
+	if (checksum.GetLength() != 64)
+		return false;
+
+	for (char ch : checksum) {
+		if (!isxdigit(static_cast<unsigned char>(ch)))
+			return false;
+	}
+
+	return true;
+}
+
+static size_t GetStagedFileSize(const String& path)
+{
+	std::ifstream fp(path.CStr(), std::ifstream::binary | std::ifstream::ate);
+
+	if (!fp)
+		return 0;
+
+	return fp.tellg();
+}
+
+static String ReadStagedFile(const String& path)
+{
+	std::ifstream fp(path.CStr(), std::ifstream::binary);
+
+	return String((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+}
 
 void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file)
 {
@@ -54,6 +106,24 @@ void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String&
 	update->Set(file.SubStr(path.GetLength()), content);
 }
 
+/**
+ * Calculates the checksums for a zone's config files.
+ *
+ * @param config The file contents, as returned by MergeConfigUpdate().
+ * @returns A dictionary which maps the file names to their SHA256 checksums.
+ */
+Dictionary::Ptr ApiListener::GetConfigChecksums(const Dictionary::Ptr& config)
+{
+	DictionaryData checksums;
+
+	ObjectLock olock(config);
+	for (const Dictionary::Pair& kv : config) {
+		checksums.emplace_back(kv.first, SHA256(kv.second));
+	}
+
+	return new Dictionary(std::move(checksums));
+}
+
 Dictionary::Ptr ApiListener::MergeConfigUpdate(const ConfigDirInformation& config)
 {
 	Dictionary::Ptr result = new Dictionary();
@@ -225,6 +295,43 @@ void ApiListener::SyncZoneDirs() const
 	}
 }
 
+/**
+ * Loads the config files of the zones which are synced to the endpoints of a zone.
+ *
+ * @param azone The endpoints' zone.
+ * @returns The config files by zone name.
+ */
+std::map<String, ConfigDirInformation> ApiListener::GetSyncedZoneConfigs(const Zone::Ptr& azone)
+{
+	std::map<String, ConfigDirInformation> configs;
+
+	String zonesDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones";
+
+	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
+		String zoneDir = zonesDir + "/" + zone->GetName();
+
+		if (!zone->IsChildOf(azone) && !zone->IsGlobal())
+			continue;
+
+		if (!Utility::PathExists(zoneDir))
+			continue;
+
+		configs[zone->GetName()] = LoadConfigDir(zoneDir);
+	}
+
+	return configs;
+}
+
+/**
+ * Sends the config files for the endpoint's zones. Endpoints which support
+ * checksums receive a config::Manifest message and then request the files
+ * they're missing with config::RequestFiles. All other endpoints receive
+ * the full content in a config::Update message.
+ *
+ * The manifest announces resumable transfers: receivers which support them
+ * request the files together with the offset at which to continue and
+ * receive at most CONFIG_SYNC_WINDOW_SIZE bytes per request.
+ */
 void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
 {
 	Endpoint::Ptr endpoint = aclient->GetEndpoint();
@@ -237,85 +344,703 @@ void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
 	if (!azone->IsChildOf(lzone))
 		return;
 
+	std::map<String, ConfigDirInformation> configs = GetSyncedZoneConfigs(azone);
+
+	for (const auto& kv : configs) {
+		Zone::Ptr zone = Zone::GetByName(kv.first);
+
+		Log(LogInformation, "ApiListener")
+			<< "Syncing configuration files for " << (zone->IsGlobal() ? "global " : "")
+			<< "zone '" << zone->GetName() << "' to endpoint '" << endpoint->GetName() << "'.";
+	}
+
+	Array::Ptr configSync;
+
+	if (!configs.empty()) {
+		/* The peer's hello tells us whether it supports checksums. Older versions don't answer our hello. */
+		Dictionary::Ptr hello = aclient->WaitForHello(5);
+
+		if (hello)
+			configSync = hello->Get("config_sync");
+	}
+
+	if (configSync && configSync->Contains("checksums")) {
+		Dictionary::Ptr checksums = new Dictionary();
+
+		for (const auto& kv : configs)
+			checksums->Set(kv.first, GetConfigChecksums(MergeConfigUpdate(kv.second)));
+
+		Dictionary::Ptr message = new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "config::Manifest" },
+			{ "params", new Dictionary({
+				{ "checksums", checksums },
+				{ "resumable", true }
+			}) }
+		});
+
+		aclient->SendMessage(message);
+
+		return;
+	}
+
 	Dictionary::Ptr configUpdateV1 = new Dictionary();
 	Dictionary::Ptr configUpdateV2 = new Dictionary();
 
-	String zonesDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones";
+	for (const auto& kv : configs) {
+		configUpdateV1->Set(kv.first, kv.second.UpdateV1);
+		configUpdateV2->Set(kv.first, kv.second.UpdateV2);
+	}
 
-	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
-		String zoneDir = zonesDir + "/" + zone->GetName();
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "config::Update" },
+		{ "params", new Dictionary({
+			{ "update", configUpdateV1 },
+			{ "update_v2", configUpdateV2 }
+		}) }
+	});
+
+	aclient->SendMessage(message);
+}
+
+/**
+ * Sends the requested config files in chunks, followed by a config::Update
+ * message with the checksums of all files.
+ *
+ * In a resumable transfer the files are requested along with the offsets at
+ * which to continue. Only the next CONFIG_SYNC_WINDOW_SIZE bytes are sent and
+ * the last chunk is flagged with "window_end", which tells the receiver to
+ * request the next window. No config::Update message is sent in this case,
+ * the receiver already knows the checksums from the manifest.
+ */
+Value ApiListener::ConfigRequestFilesHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Endpoint::Ptr endpoint = origin->FromClient->GetEndpoint();
+
+	if (!endpoint)
+		return Empty;
+
+	Zone::Ptr azone = endpoint->GetZone();
+
+	/* don't send config updates to our master */
+	if (!azone->IsChildOf(Zone::GetLocalZone()))
+		return Empty;
+
+	Dictionary::Ptr files = params->Get("files");
+
+	if (!files)
+		return Empty;
+
+	Dictionary::Ptr checksums = new Dictionary();
+	size_t numBytes = 0;
+
+	bool resumable = false;
+	size_t budget = CONFIG_SYNC_WINDOW_SIZE;
+	Dictionary::Ptr pendingChunk;
+
+	/* The last chunk of a window is only sent once we know that it is the last one. */
+	auto sendChunk = [&origin, &pendingChunk](const Dictionary::Ptr& params) {
+		if (pendingChunk) {
+			origin->FromClient->SendMessage(new Dictionary({
+				{ "jsonrpc", "2.0" },
+				{ "method", "config::FileChunk" },
+				{ "params", pendingChunk }
+			}));
+		}
+
+		pendingChunk = params;
+	};
+
+	for (const auto& kv : GetSyncedZoneConfigs(azone)) {
+		Dictionary::Ptr config = MergeConfigUpdate(kv.second);
+		checksums->Set(kv.first, GetConfigChecksums(config));
+
+		Value vfiles = files->Get(kv.first);
+
+		if (vfiles.IsObjectType<Dictionary>()) {
+			resumable = true;
+
+			Dictionary::Ptr offsets = vfiles;
+
+			ObjectLock olock(offsets);
+			for (const Dictionary::Pair& file : offsets) {
+				if (budget == 0)
+					break;
+
+				size_t offset = Convert::ToLong(file.second);
+
+				/* Files are only sent from the zone's own config directory. */
+				if (!config->Contains(file.first) || offset > String(config->Get(file.first)).GetLength()) {
+					sendChunk(new Dictionary({
+						{ "zone", kv.first },
+						{ "path", file.first },
+						{ "missing", true }
+					}));
+
+					continue;
+				}
+
+				String content = config->Get(file.first);
+
+				do {
+					size_t count = std::min(std::min<size_t>(CONFIG_SYNC_CHUNK_SIZE, budget), content.GetLength() - offset);
+
+					sendChunk(new Dictionary({
+						{ "zone", kv.first },
+						{ "path", file.first },
+						{ "offset", offset },
+						{ "size", content.GetLength() },
+						{ "data", content.SubStr(offset, count) }
+					}));
+
+					offset += count;
+					budget -= count;
+					numBytes += count;
+				} while (offset < content.GetLength() && budget > 0);
+			}
 
-		if (!zone->IsChildOf(azone) && !zone->IsGlobal())
 			continue;
+		}
 
-		if (!Utility::PathExists(zoneDir))
+		Array::Ptr paths = vfiles;
+
+		if (!paths)
 			continue;
 
-		Log(LogInformation, "ApiListener")
-			<< "Syncing configuration files for " << (zone->IsGlobal() ? "global " : "")
-			<< "zone '" << zone->GetName() << "' to endpoint '" << endpoint->GetName() << "'.";
+		ObjectLock olock(paths);
+		for (const Value& vpath : paths) {
+			String path = vpath;
 
-		ConfigDirInformation config = LoadConfigDir(zonesDir + "/" + zone->GetName());
-		configUpdateV1->Set(zone->GetName(), config.UpdateV1);
-		configUpdateV2->Set(zone->GetName(), config.UpdateV2);
+			/* Files are only sent from the zone's own config directory. */
+			if (!config->Contains(path))
+				continue;
+
+			String content = config->Get(path);
+			size_t offset = 0;
+
+			do {
+				Dictionary::Ptr message = new Dictionary({
+					{ "jsonrpc", "2.0" },
+					{ "method", "config::FileChunk" },
+					{ "params", new Dictionary({
+						{ "zone", kv.first },
+						{ "path", path },
+						{ "data", content.SubStr(offset, CONFIG_SYNC_CHUNK_SIZE) }
+					}) }
+				});
+
+				origin->FromClient->SendMessage(message);
+
+				offset += CONFIG_SYNC_CHUNK_SIZE;
+			} while (offset < content.GetLength());
+
+			numBytes += content.GetLength();
+		}
+	}
+
+	if (resumable) {
+		if (pendingChunk) {
+			pendingChunk->Set("window_end", true);
+			sendChunk(nullptr);
+		}
+
+		Log(LogNotice, "ApiListener")
+			<< "Sending " << numBytes << " bytes of changed configuration files to endpoint '" << endpoint->GetName() << "'.";
+
+		return Empty;
 	}
 
+	Log(LogInformation, "ApiListener")
+		<< "Sending " << numBytes << " bytes of changed configuration files to endpoint '" << endpoint->GetName() << "'.";
+
 	Dictionary::Ptr message = new Dictionary({
 		{ "jsonrpc", "2.0" },
 		{ "method", "config::Update" },
 		{ "params", new Dictionary({
-			{ "update", configUpdateV1 },
-			{ "update_v2", configUpdateV2 }
+			{ "checksums", checksums }
 		}) }
 	});
 
-	aclient->SendMessage(message);
+	origin->FromClient->SendMessage(message);
+
+	return Empty;
 }
 
-Value ApiListener::ConfigUpdateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+/**
+ * Checks whether config updates from the origin are accepted.
+ */
+static bool IsConfigUpdateAllowed(const MessageOrigin::Ptr& origin)
 {
 	if (!origin->FromClient->GetEndpoint() || (origin->FromZone && !Zone::GetLocalZone()->IsChildOf(origin->FromZone)))
-		return Empty;
+		return false;
 
 	ApiListener::Ptr listener = ApiListener::GetInstance();
 
 	if (!listener) {
 		Log(LogCritical, "ApiListener", "No instance available.");
-		return Empty;
+		return false;
 	}
 
 	if (!listener->GetAcceptConfig()) {
 		Log(LogWarning, "ApiListener")
 			<< "Ignoring config update. '" << listener->GetName() << "' does not accept config.";
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Checks whether config updates for a zone are accepted.
+ */
+static bool IsZoneConfigUpdateAllowed(const String& zoneName)
+{
+	Zone::Ptr zone = Zone::GetByName(zoneName);
+
+	if (!zone) {
+		Log(LogWarning, "ApiListener")
+			<< "Ignoring config update for unknown zone '" << zoneName << "'.";
+		return false;
+	}
+
+	if (ConfigCompiler::HasZoneConfigAuthority(zoneName)) {
+		Log(LogWarning, "ApiListener")
+			<< "Ignoring config update for zone '" << zoneName << "' because we have an authoritative version of the zone's config.";
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Sets up the state of a resumable transfer for a zone. Files which were
+ * partially received before are continued where the transfer stopped.
+ */
+static void PrepareConfigTransfer(const String& zoneName, const Dictionary::Ptr& checksums, const ArrayData& paths,
+	const Dictionary::Ptr& transferChecksums, const Dictionary::Ptr& transferFiles)
+{
+	String stageDir = GetConfigStageDir(zoneName);
+	Dictionary::Ptr zoneFiles = new Dictionary();
+	std::set<String> stagedChecksums;
+
+	transferChecksums->Set(zoneName, checksums);
+
+	for (const String& path : paths) {
+		String checksum = checksums->Get(path);
+
+		if (!IsValidChecksum(checksum)) {
+			Log(LogWarning, "ApiListener")
+				<< "Ignoring invalid checksum for file '" << path << "' in zone '" << zoneName << "'.";
+			continue;
+		}
+
+		size_t offset = GetStagedFileSize(stageDir + "/" + checksum);
+
+		if (offset > 0) {
+			Log(LogNotice, "ApiListener")
+				<< "Resuming transfer of file '" << path << "' in zone '" << zoneName << "' at offset " << offset << ".";
+		}
+
+		zoneFiles->Set(path, new Dictionary({
+			{ "checksum", checksum },
+			{ "offset", offset },
+			{ "done", false }
+		}));
+
+		stagedChecksums.insert(checksum);
+	}
+
+	if (Utility::PathExists(stageDir)) {
+		/* Remove the staged files which aren't part of this transfer. */
+		Utility::Glob(stageDir + "/*", [&stagedChecksums](const String& file) {
+			if (stagedChecksums.find(Utility::BaseName(file)) == stagedChecksums.end())
+				(void) unlink(file.CStr());
+		}, GlobFile);
+	}
+
+	if (zoneFiles->GetLength() > 0) {
+		Utility::MkDirP(stageDir, 0700);
+		transferFiles->Set(zoneName, zoneFiles);
+	}
+}
+
+/**
+ * Appends a chunk of a resumable transfer to the staged file.
+ */
+static void ReceiveConfigFileChunk(const JsonRpcConnection::Ptr& client, const String& zoneName, const String& path, const Dictionary::Ptr& params)
+{
+	Dictionary::Ptr transferFiles = client->GetConfigSyncTransfer()->Get("files");
+
+	if (!transferFiles)
+		return;
+
+	Dictionary::Ptr zoneFiles = transferFiles->Get(zoneName);
+
+	if (!zoneFiles)
+		return;
+
+	Dictionary::Ptr state = zoneFiles->Get(path);
+
+	if (!state || state->Get("done"))
+		return;
+
+	String stagePath = GetConfigStageDir(zoneName) + "/" + state->Get("checksum");
+
+	if (params->Get("missing")) {
+		Log(LogWarning, "ApiListener")
+			<< "Endpoint '" << client->GetEndpoint()->GetName() << "' could not send file '" << path << "' in zone '" << zoneName << "'.";
+
+		(void) unlink(stagePath.CStr());
+		state->Set("done", true);
+		return;
+	}
+
+	size_t offset = Convert::ToLong(params->Get("offset"));
+
+	/* Chunks which don't continue the file are ignored, the next request asks for the right offset. */
+	if (offset != static_cast<size_t>(Convert::ToLong(state->Get("offset"))))
+		return;
+
+	String data = params->Get("data");
+
+	std::ofstream fp(stagePath.CStr(), std::ofstream::binary | (offset == 0 ? std::ofstream::trunc : std::ofstream::app));
+	fp.write(data.CStr(), data.GetLength());
+	fp.close();
+
+	if (fp.fail()) {
+		Log(LogWarning, "ApiListener")
+			<< "Could not write staged config file '" << stagePath << "'.";
+
+		state->Set("done", true);
+		return;
+	}
+
+	offset += data.GetLength();
+	state->Set("offset", offset);
+
+	if (offset >= static_cast<size_t>(Convert::ToLong(params->Get("size"))))
+		state->Set("done", true);
+}
+
+/**
+ * Compares the parent's checksums with our config files and requests the
+ * files which are missing or differ.
+ */
+Value ApiListener::ConfigManifestHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	if (!IsConfigUpdateAllowed(origin))
+		return Empty;
+
+	Dictionary::Ptr checksums = params->Get("checksums");
+
+	if (!checksums)
 		return Empty;
+
+	/* Drop the leftovers of an incomplete transfer. */
+	origin->FromClient->GetConfigSyncFiles()->Clear();
+	origin->FromClient->GetConfigSyncTransfer()->Clear();
+
+	bool resumable = params->Get("resumable");
+
+	Dictionary::Ptr files = new Dictionary();
+	size_t numFiles = 0;
+
+	/* For resumable transfers: the checksums of the zones we accept and the
+	 * state of each file we need, i.e. its checksum, the number of bytes
+	 * we have and whether it's complete. */
+	Dictionary::Ptr transferChecksums = new Dictionary();
+	Dictionary::Ptr transferFiles = new Dictionary();
+
+	{
+		ObjectLock olock(checksums);
+		for (const Dictionary::Pair& kv : checksums) {
+			if (!IsZoneConfigUpdateAllowed(kv.first))
+				continue;
+
+			String oldDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones/" + kv.first;
+			Dictionary::Ptr oldChecksums = GetConfigChecksums(MergeConfigUpdate(LoadConfigDir(oldDir)));
+			Dictionary::Ptr newChecksums = kv.second;
+
+			ArrayData paths;
+
+			ObjectLock xlock(newChecksums);
+			for (const Dictionary::Pair& file : newChecksums) {
+				if (oldChecksums->Get(file.first) != file.second)
+					paths.emplace_back(file.first);
+			}
+
+			if (resumable)
+				PrepareConfigTransfer(kv.first, newChecksums, paths, transferChecksums, transferFiles);
+
+			if (!paths.empty()) {
+				numFiles += paths.size();
+				files->Set(kv.first, new Array(std::move(paths)));
+			}
+		}
+	}
+
+	/* Files are only deleted along with a new timestamp file, so there's nothing to do. */
+	if (numFiles == 0) {
+		Log(LogInformation, "ApiListener")
+			<< "Configuration files from endpoint '" << origin->FromClient->GetEndpoint()->GetName() << "' are up to date.";
+		return Empty;
+	}
+
+	Log(LogInformation, "ApiListener")
+		<< "Requesting " << numFiles << " changed configuration files from endpoint '"
+		<< origin->FromClient->GetEndpoint()->GetName() << "'.";
+
+	if (resumable) {
+		Dictionary::Ptr transfer = origin->FromClient->GetConfigSyncTransfer();
+		transfer->Set("checksums", transferChecksums);
+		transfer->Set("files", transferFiles);
+
+		RequestConfigFiles(origin->FromClient);
+
+		return Empty;
+	}
+
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "config::RequestFiles" },
+		{ "params", new Dictionary({
+			{ "files", files }
+		}) }
+	});
+
+	origin->FromClient->SendMessage(message);
+
+	return Empty;
+}
+
+Value ApiListener::ConfigFileChunkHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	if (!IsConfigUpdateAllowed(origin))
+		return Empty;
+
+	String zoneName = params->Get("zone");
+	String path = params->Get("path");
+
+	if (params->Contains("offset") || params->Contains("missing")) {
+		ReceiveConfigFileChunk(origin->FromClient, zoneName, path, params);
+
+		if (params->Get("window_end"))
+			RequestConfigFiles(origin->FromClient);
+
+		return Empty;
+	}
+
+	Dictionary::Ptr files = origin->FromClient->GetConfigSyncFiles();
+	Dictionary::Ptr zoneFiles = files->Get(zoneName);
+
+	if (!zoneFiles) {
+		zoneFiles = new Dictionary();
+		files->Set(zoneName, zoneFiles);
+	}
+
+	Array::Ptr chunks = zoneFiles->Get(path);
+
+	if (!chunks) {
+		chunks = new Array();
+		zoneFiles->Set(path, chunks);
+	}
+
+	chunks->Add(params->Get("data"));
+
+	return Empty;
+}
+
+/**
+ * Updates a zone's config directory so that it matches the parent's
+ * checksums. Files which were received in chunks are taken from the
+ * connection, all other files must already exist with the right content.
+ *
+ * @returns Whether the config was changed.
+ */
+bool ApiListener::ApplyConfigManifest(const JsonRpcConnection::Ptr& client, const String& zoneName, const Dictionary::Ptr& checksums)
+{
+	String oldDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones/" + zoneName;
+
+	Utility::MkDirP(oldDir, 0700);
+
+	ConfigDirInformation oldConfigInfo = LoadConfigDir(oldDir);
+	Dictionary::Ptr oldConfig = MergeConfigUpdate(oldConfigInfo);
+
+	Dictionary::Ptr receivedFiles = client->GetConfigSyncFiles()->Get(zoneName);
+
+	ConfigDirInformation newConfigInfo;
+	newConfigInfo.UpdateV1 = new Dictionary();
+
+	ObjectLock olock(checksums);
+	for (const Dictionary::Pair& kv : checksums) {
+		Array::Ptr chunks;
+
+		if (receivedFiles)
+			chunks = receivedFiles->Get(kv.first);
+
+		String content;
+
+		if (chunks) {
+			ObjectLock xlock(chunks);
+			for (const Value& chunk : chunks) {
+				content += chunk;
+			}
+		} else {
+			if (oldConfig->Contains(kv.first))
+				content = oldConfig->Get(kv.first);
+
+			/* Files from a resumable transfer are staged on disk. */
+			String checksum = kv.second;
+			String stagePath = GetConfigStageDir(zoneName) + "/" + checksum;
+
+			if (SHA256(content) != checksum && IsValidChecksum(checksum) && Utility::PathExists(stagePath))
+				content = ReadStagedFile(stagePath);
+		}
+
+		if (SHA256(content) != kv.second) {
+			Log(LogWarning, "ApiListener")
+				<< "Ignoring config update for zone '" << zoneName << "': Content of file '" << kv.first << "' doesn't match its checksum.";
+			return false;
+		}
+
+		newConfigInfo.UpdateV1->Set(kv.first, content);
 	}
 
+	return UpdateConfigDir(oldConfigInfo, newConfigInfo, oldDir, false);
+}
+
+/**
+ * Requests the next window of a resumable transfer, or applies the
+ * transfer once all files are complete.
+ */
+void ApiListener::RequestConfigFiles(const JsonRpcConnection::Ptr& client)
+{
+	Dictionary::Ptr transferFiles = client->GetConfigSyncTransfer()->Get("files");
+
+	if (!transferFiles)
+		return;
+
+	Dictionary::Ptr files = new Dictionary();
+
+	{
+		ObjectLock olock(transferFiles);
+		for (const Dictionary::Pair& kv : transferFiles) {
+			Dictionary::Ptr zoneFiles = kv.second;
+			Dictionary::Ptr offsets = new Dictionary();
+
+			ObjectLock xlock(zoneFiles);
+			for (const Dictionary::Pair& file : zoneFiles) {
+				Dictionary::Ptr state = file.second;
+
+				if (!state->Get("done"))
+					offsets->Set(file.first, state->Get("offset"));
+			}
+
+			if (offsets->GetLength() > 0)
+				files->Set(kv.first, offsets);
+		}
+	}
+
+	if (files->GetLength() == 0) {
+		FinishConfigTransfer(client);
+		return;
+	}
+
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "config::RequestFiles" },
+		{ "params", new Dictionary({
+			{ "files", files }
+		}) }
+	});
+
+	client->SendMessage(message);
+}
+
+/**
+ * Applies the config of a completed resumable transfer and removes the
+ * staged files.
+ */
+void ApiListener::FinishConfigTransfer(const JsonRpcConnection::Ptr& client)
+{
+	Dictionary::Ptr transfer = client->GetConfigSyncTransfer();
+	Dictionary::Ptr checksums = transfer->Get("checksums");
+
+	transfer->Clear();
+
+	if (!checksums)
+		return;
+
+	Log(LogInformation, "ApiListener")
+		<< "Applying config update from endpoint '" << client->GetEndpoint()->GetName() << "'.";
+
+	bool configChange = false;
+
+	{
+		ObjectLock olock(checksums);
+		for (const Dictionary::Pair& kv : checksums) {
+			if (!IsZoneConfigUpdateAllowed(kv.first))
+				continue;
+
+			if (ApplyConfigManifest(client, kv.first, kv.second))
+				configChange = true;
+
+			/* Staged files which didn't match their checksum are requested from the start next time. */
+			String stageDir = GetConfigStageDir(kv.first);
+
+			if (Utility::PathExists(stageDir))
+				Utility::RemoveDirRecursive(stageDir);
+		}
+	}
+
+	if (configChange) {
+		Log(LogInformation, "ApiListener", "Restarting after configuration change.");
+		Application::RequestRestart();
+	}
+}
+
+Value ApiListener::ConfigUpdateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	if (!IsConfigUpdateAllowed(origin))
+		return Empty;
+
 	Log(LogInformation, "ApiListener")
 		<< "Applying config update from endpoint '" << origin->FromClient->GetEndpoint()->GetName()
 		<< "' of zone '" << GetFromZoneName(origin->FromZone) << "'.";
 
+	bool configChange = false;
+
+	/* The answer to config::RequestFiles, the changed files were sent in chunks. */
+	Dictionary::Ptr checksums = params->Get("checksums");
+
+	if (checksums) {
+		{
+			ObjectLock olock(checksums);
+			for (const Dictionary::Pair& kv : checksums) {
+				if (!IsZoneConfigUpdateAllowed(kv.first))
+					continue;
+
+				if (ApplyConfigManifest(origin->FromClient, kv.first, kv.second))
+					configChange = true;
+			}
+		}
+
+		origin->FromClient->GetConfigSyncFiles()->Clear();
+	}
+
 	Dictionary::Ptr updateV1 = params->Get("update");
 	Dictionary::Ptr updateV2 = params->Get("update_v2");
 
-	bool configChange = false;
+	if (!updateV1)
+		updateV1 = new Dictionary();
 
 	ObjectLock olock(updateV1);
 	for (const Dictionary::Pair& kv : updateV1) {
-		Zone::Ptr zone = Zone::GetByName(kv.first);
-
-		if (!zone) {
-			Log(LogWarning, "ApiListener")
-				<< "Ignoring config update for unknown zone '" << kv.first << "'.";
+		if (!IsZoneConfigUpdateAllowed(kv.first))
 			continue;
-		}
-
-		if (ConfigCompiler::HasZoneConfigAuthority(kv.first)) {
-			Log(LogWarning, "ApiListener")
-				<< "Ignoring config update for zone '" << kv.first << "' because we have an authoritative version of the zone's config.";
-			continue;
-		}
 
-		String oldDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones/" + zone->GetName();
+		String oldDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones/" + kv.first;
 
 		Utility::MkDirP(oldDir, 0700);
 
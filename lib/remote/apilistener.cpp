@@ -23,9 +23,13 @@
 #include "remote/endpoint.hpp"
 #include "remote/jsonrpc.hpp"
 #include "remote/apifunction.hpp"
+#include "remote/messagecompressor.hpp"
+#include "remote/eventqueue.hpp"
+#include "remote/httphandler.hpp"
 #include "base/convert.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
+#include "base/statefile.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
 #include "base/objectlock.hpp"
@@ -35,10 +39,15 @@
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
 #include "base/exception.hpp"
+#include "base/tracing.hpp"
+#include <cmath>
 #include <fstream>
 
 using namespace icinga;
 
+/* The number of replay log entries between two index entries. */
+#define LOG_INDEX_INTERVAL 1000
+
 REGISTER_TYPE(ApiListener);
 
 boost::signals2::signal<void(bool)> ApiListener::OnMasterChanged;
@@ -89,6 +98,11 @@ String ApiListener::GetDefaultCaPath()
 	return GetCertsDir() + "/ca.crt";
 }
 
+String ApiListener::GetTicketKeyPath()
+{
+	return GetCertsDir() + "/ticket.key";
+}
+
 void ApiListener::CopyCertificateFile(const String& oldCertPath, const String& newCertPath)
 {
 	struct stat st1, st2;
@@ -185,8 +199,22 @@ void ApiListener::UpdateSSLContext()
 		}
 	}
 
+	try {
+		SetTicketKeysToSSLContext(context, GetTicketKeyPath());
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ApiListener")
+			<< "Cannot persist TLS session ticket keys in '" << GetTicketKeyPath()
+			<< "', sessions cannot be resumed after a restart: " << DiagnosticInformation(ex, false);
+	}
+
 	m_SSLContext = context;
 
+	/* Sessions of the old context carry the old certificate. */
+	{
+		boost::mutex::scoped_lock lock(m_TlsSessionsLock);
+		m_TlsSessions.clear();
+	}
+
 	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
 		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
 			client->Disconnect();
@@ -219,9 +247,13 @@ void ApiListener::Start(bool runtimeCreated)
 	ObjectImpl<ApiListener>::Start(runtimeCreated);
 
 	{
-		boost::mutex::scoped_lock lock(m_LogLock);
-		RotateLogFile();
-		OpenLogFile();
+		ProfiledMutex::scoped_lock lock(m_LogLock);
+		m_ReplayLogShardsClosed = false;
+
+		/* Older versions wrote a single replay log for all zones. */
+		auto legacy = std::make_shared<ReplayLogShard>();
+		legacy->Path = GetApiDir() + "log/";
+		RotateLogFile(legacy);
 	}
 
 	/* create the primary JSON-RPC listener */
@@ -231,24 +263,24 @@ void ApiListener::Start(bool runtimeCreated)
 		Application::Exit(EXIT_FAILURE);
 	}
 
-	m_Timer = new Timer();
-	m_Timer->OnTimerExpired.connect(std::bind(&ApiListener::ApiTimerHandler, this));
-	m_Timer->SetInterval(5);
-	m_Timer->Start();
-	m_Timer->Reschedule(0);
+	m_LogCleanupTimer = new Timer("ApiListener replay log cleanup");
+	m_LogCleanupTimer->OnTimerExpired.connect(std::bind(&ApiListener::LogCleanupTimerHandler, this));
+	m_LogCleanupTimer->SetInterval(300);
+	m_LogCleanupTimer->Start();
+	m_LogCleanupTimer->Reschedule(0);
 
-	m_ReconnectTimer = new Timer();
+	m_ReconnectTimer = new Timer("ApiListener reconnect");
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&ApiListener::ApiReconnectTimerHandler, this));
-	m_ReconnectTimer->SetInterval(60);
+	m_ReconnectTimer->SetInterval(10);
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
-	m_AuthorityTimer = new Timer();
-	m_AuthorityTimer->OnTimerExpired.connect(std::bind(&ApiListener::UpdateObjectAuthority));
+	m_AuthorityTimer = new Timer("ApiListener authority");
+	m_AuthorityTimer->OnTimerExpired.connect(std::bind(&ApiListener::AuthorityTimerHandler));
 	m_AuthorityTimer->SetInterval(30);
 	m_AuthorityTimer->Start();
 
-	m_CleanupCertificateRequestsTimer = new Timer();
+	m_CleanupCertificateRequestsTimer = new Timer("ApiListener certificate requests cleanup");
 	m_CleanupCertificateRequestsTimer->OnTimerExpired.connect(std::bind(&ApiListener::CleanupCertificateRequestsTimerHandler, this));
 	m_CleanupCertificateRequestsTimer->SetInterval(3600);
 	m_CleanupCertificateRequestsTimer->Start();
@@ -264,8 +296,15 @@ void ApiListener::Stop(bool runtimeDeleted)
 	Log(LogInformation, "ApiListener")
 		<< "'" << GetName() << "' stopped.";
 
-	boost::mutex::scoped_lock lock(m_LogLock);
-	CloseLogFile();
+	ProfiledMutex::scoped_lock lock(m_LogLock);
+	m_ReplayLogShardsClosed = true;
+
+	for (auto& kv : m_ReplayLogShards) {
+		boost::mutex::scoped_lock shardLock(kv.second->Lock);
+		CloseLogFile(kv.second);
+	}
+
+	m_ReplayLogShards.clear();
 }
 
 ApiListener::Ptr ApiListener::GetInstance()
@@ -345,7 +384,33 @@ void ApiListener::ListenerThreadProc(const Socket::Ptr& server)
 
 	server->Listen();
 
+	/* Limits how many TLS handshakes we start per second, e.g. when all
+	 * agents reconnect after a restart. The others wait in the backlog. */
+	double acceptRate = 100;
+	Value acceptRateValue = ScriptGlobal::Get("ApiAcceptRate", &Empty);
+
+	if (!acceptRateValue.IsEmpty())
+		acceptRate = acceptRateValue;
+
+	double burst = std::max(acceptRate, 1.0);
+	double tokens = burst;
+	double lastRefill = Utility::GetTime();
+
 	for (;;) {
+		if (acceptRate > 0) {
+			double now = Utility::GetTime();
+			tokens = std::min(burst, tokens + (now - lastRefill) * acceptRate);
+			lastRefill = now;
+
+			if (tokens < 1) {
+				m_ThrottledAccepts++;
+				Utility::Sleep((1 - tokens) / acceptRate);
+				continue;
+			}
+
+			tokens--;
+		}
+
 		try {
 			Socket::Ptr client = server->Accept();
 			std::thread thread(std::bind(&ApiListener::NewClientHandler, this, client, String(), RoleServer));
@@ -390,10 +455,13 @@ void ApiListener::AddConnection(const Endpoint::Ptr& endpoint)
 
 	try {
 		endpoint->SetConnecting(true);
+		m_ReconnectAttempts++;
 		client->Connect(host, port);
 		NewClientHandler(client, serverName, RoleClient);
+		UpdateReconnectState(endpoint, endpoint->GetConnected());
 		endpoint->SetConnecting(false);
 	} catch (const std::exception& ex) {
+		UpdateReconnectState(endpoint, false);
 		endpoint->SetConnecting(false);
 		client->Close();
 
@@ -408,6 +476,35 @@ void ApiListener::AddConnection(const Endpoint::Ptr& endpoint)
 		<< "Finished reconnecting to endpoint '" << endpoint->GetName() << "' via host '" << host << "' and port '" << port << "'";
 }
 
+std::shared_ptr<SSL_SESSION> ApiListener::GetTlsSession(const String& hostname)
+{
+	boost::mutex::scoped_lock lock(m_TlsSessionsLock);
+
+	auto it = m_TlsSessions.find(hostname);
+
+	if (it == m_TlsSessions.end())
+		return nullptr;
+
+	return it->second;
+}
+
+/**
+ * Remembers the most recent resumable session for an endpoint we're
+ * connecting to, so that reconnects can skip the full TLS handshake.
+ *
+ * @param hostname The endpoint's server name.
+ * @param session The session, or nullptr to forget it.
+ */
+void ApiListener::SetTlsSession(const String& hostname, const std::shared_ptr<SSL_SESSION>& session)
+{
+	boost::mutex::scoped_lock lock(m_TlsSessionsLock);
+
+	if (session)
+		m_TlsSessions[hostname] = session;
+	else
+		m_TlsSessions.erase(hostname);
+}
+
 void ApiListener::NewClientHandler(const Socket::Ptr& client, const String& hostname, ConnectionRole role)
 {
 	try {
@@ -452,15 +549,53 @@ void ApiListener::NewClientHandlerInternal(const Socket::Ptr& client, const Stri
 		}
 	}
 
+	if (role == RoleClient && !hostname.IsEmpty()) {
+		std::shared_ptr<SSL_SESSION> session = GetTlsSession(hostname);
+
+		if (session)
+			tlsStream->SetSession(session);
+
+		tlsStream->SetSessionCallback(std::bind(&ApiListener::SetTlsSession, this, hostname, _1));
+	}
+
 	try {
 		tlsStream->Handshake();
 	} catch (const std::exception&) {
 		Log(LogCritical, "ApiListener")
 			<< "Client TLS handshake failed (" << conninfo << ")";
 		tlsStream->Close();
+
+		/* Don't offer a session which might have caused this again. */
+		if (role == RoleClient && !hostname.IsEmpty())
+			SetTlsSession(hostname, nullptr);
+
 		return;
 	}
 
+	m_TlsHandshakes++;
+
+	if (tlsStream->IsSessionReused()) {
+		m_TlsResumedHandshakes++;
+
+		Log(LogNotice, "ApiListener")
+			<< "Resumed TLS session (" << conninfo << ")";
+	}
+
+	bool kernelSend = tlsStream->IsKernelSendOffloaded();
+	bool kernelReceive = tlsStream->IsKernelReceiveOffloaded();
+
+	if (kernelSend)
+		m_TlsKernelSendOffloads++;
+
+	if (kernelReceive)
+		m_TlsKernelReceiveOffloads++;
+
+	if (kernelSend || kernelReceive) {
+		Log(LogNotice, "ApiListener")
+			<< "Kernel TLS offload active for " << (kernelSend && kernelReceive ? "sending and receiving" : kernelSend ? "sending" : "receiving")
+			<< " (" << conninfo << ")";
+	}
+
 	std::shared_ptr<X509> cert = tlsStream->GetPeerCertificate();
 	String identity;
 	Endpoint::Ptr endpoint;
@@ -512,13 +647,7 @@ void ApiListener::NewClientHandlerInternal(const Socket::Ptr& client, const Stri
 	ClientType ctype;
 
 	if (role == RoleClient) {
-		Dictionary::Ptr message = new Dictionary({
-			{ "jsonrpc", "2.0" },
-			{ "method", "icinga::Hello" },
-			{ "params", new Dictionary() }
-		});
-
-		JsonRpc::SendMessage(tlsStream, message);
+		JsonRpc::SendMessage(tlsStream, MakeHelloMessage());
 		ctype = ClientJsonRpc;
 	} else {
 		tlsStream->WaitForData(10);
@@ -647,78 +776,105 @@ void ApiListener::SyncClient(const JsonRpcConnection::Ptr& aclient, const Endpoi
 		<< "Finished syncing endpoint '" << endpoint->GetName() << "' in zone '" << eZone->GetName() << "'.";
 }
 
-void ApiListener::ApiTimerHandler()
+/**
+ * Removes the replay log files which none of the endpoints need anymore.
+ * This runs every few minutes to expire files according to the endpoints'
+ * log_duration and shortly after an endpoint has confirmed a new log position.
+ */
+void ApiListener::LogCleanupTimerHandler()
 {
-	double now = Utility::GetTime();
+	std::set<Endpoint::Ptr> endpoints;
 
-	std::vector<int> files;
-	Utility::Glob(GetApiDir() + "log/*", std::bind(&ApiListener::LogGlobHandler, std::ref(files), _1), GlobFile);
-	std::sort(files.begin(), files.end());
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+		if (endpoint != GetLocalEndpoint())
+			endpoints.insert(endpoint);
+	}
 
-	for (int ts : files) {
-		bool need = false;
+	/* Older versions wrote a single replay log for all zones. */
+	RemoveOldLogFiles(GetApiDir() + "log/", endpoints);
 
-		for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
-			if (endpoint == GetLocalEndpoint())
-				continue;
+	std::vector<String> shards;
+	Utility::Glob(GetApiDir() + "log/*", [&shards](const String& path) { shards.push_back(path); }, GlobDirectory);
 
-			if (endpoint->GetLogDuration() >= 0 && ts < now - endpoint->GetLogDuration())
-				continue;
+	for (const String& path : shards) {
+		Zone::Ptr zone = Zone::GetByName(Utility::BaseName(path));
+		std::set<Endpoint::Ptr> zoneEndpoints;
 
-			if (ts > endpoint->GetLocalLogPosition()) {
-				need = true;
-				break;
+		if (zone) {
+			for (const Endpoint::Ptr& endpoint : zone->GetEndpoints()) {
+				if (endpoint != GetLocalEndpoint())
+					zoneEndpoints.insert(endpoint);
 			}
 		}
 
-		if (!need) {
-			String path = GetApiDir() + "log/" + Convert::ToString(ts);
-			Log(LogNotice, "ApiListener")
-				<< "Removing old log file: " << path;
-			(void)unlink(path.CStr());
-		}
+		RemoveOldLogFiles(path + "/", zoneEndpoints);
 	}
+}
 
-	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
-		if (!endpoint->GetConnected())
-			continue;
+/**
+ * Runs the replay log cleanup in a few seconds unless it is already due.
+ */
+void ApiListener::ScheduleLogCleanup()
+{
+	double next = Utility::GetTime() + 5;
 
-		double ts = endpoint->GetRemoteLogPosition();
+	if (m_LogCleanupTimer && m_LogCleanupTimer->GetNext() > next)
+		m_LogCleanupTimer->Reschedule(next);
+}
 
-		if (ts == 0)
-			continue;
+/**
+ * Returns how long to wait before the next connection attempt to an
+ * endpoint: 60 seconds doubled for each failed attempt, capped at
+ * ApiReconnectBackoffMax, randomized between half and the full delay.
+ * For zero failures this returns the delay after a lost connection.
+ *
+ * @param failures The number of failed attempts in a row.
+ */
+double ApiListener::GetReconnectDelay(int failures)
+{
+	double maxDelay = 600;
+	Value maxDelayValue = ScriptGlobal::Get("ApiReconnectBackoffMax", &Empty);
 
-		Dictionary::Ptr lmessage = new Dictionary({
-			{ "jsonrpc", "2.0" },
-			{ "method", "log::SetLogPosition" },
-			{ "params", new Dictionary({
-				{ "log_position", ts }
-			}) }
-		});
+	if (!maxDelayValue.IsEmpty())
+		maxDelay = maxDelayValue;
 
-		double maxTs = 0;
+	double random = static_cast<double>(Utility::Random()) / RAND_MAX;
 
-		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
-			if (client->GetTimestamp() > maxTs)
-				maxTs = client->GetTimestamp();
-		}
+	if (failures == 0)
+		return random * std::min(30.0, maxDelay);
 
-		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
-			if (client->GetTimestamp() != maxTs)
-				client->Disconnect();
-			else
-				client->SendMessage(lmessage);
-		}
+	double delay = std::min(maxDelay, 60 * std::pow(2, std::min(failures - 1, 16)));
 
-		Log(LogNotice, "ApiListener")
-			<< "Setting log position for identity '" << endpoint->GetName() << "': "
-			<< Utility::FormatDateTime("%Y/%m/%d %H:%M:%S", ts);
+	return delay / 2 + random * delay / 2;
+}
+
+void ApiListener::UpdateReconnectState(const Endpoint::Ptr& endpoint, bool connected)
+{
+	boost::mutex::scoped_lock lock(m_ReconnectLock);
+	ReconnectState& state = m_ReconnectStates[endpoint->GetName()];
+
+	if (connected) {
+		state.Failures = 0;
+		state.NextAttempt = 0;
+		state.WasConnected = true;
+		return;
 	}
+
+	state.Failures++;
+
+	double delay = GetReconnectDelay(state.Failures);
+	state.NextAttempt = Utility::GetTime() + delay;
+
+	Log(LogInformation, "ApiListener")
+		<< "Next connection attempt to endpoint '" << endpoint->GetName() << "' in "
+		<< Utility::FormatDuration(delay) << " (" << state.Failures << " failed attempts).";
 }
 
 void ApiListener::ApiReconnectTimerHandler()
 {
 	Zone::Ptr my_zone = Zone::GetLocalZone();
+	double now = Utility::GetTime();
+	std::vector<std::pair<double, Endpoint::Ptr> > candidates;
 
 	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
 		/* don't connect to global zones */
@@ -759,17 +915,65 @@ void ApiListener::ApiReconnectTimerHandler()
 
 			/* don't try to connect if we're already connected */
 			if (endpoint->GetConnected()) {
+				UpdateReconnectState(endpoint, true);
+
 				Log(LogDebug, "ApiListener")
 					<< "Not connecting to Endpoint '" << endpoint->GetName()
 					<< "' because we're already connected to it.";
 				continue;
 			}
 
-			std::thread thread(std::bind(&ApiListener::AddConnection, this, endpoint));
-			thread.detach();
+			double nextAttempt;
+
+			{
+				boost::mutex::scoped_lock lock(m_ReconnectLock);
+				ReconnectState& state = m_ReconnectStates[endpoint->GetName()];
+
+				/* All peers notice a lost connection at the same time, spread their first attempts. */
+				if (state.WasConnected) {
+					state.WasConnected = false;
+					state.NextAttempt = now + GetReconnectDelay(0);
+				}
+
+				nextAttempt = state.NextAttempt;
+			}
+
+			/* don't try to connect before the backoff delay has passed */
+			if (nextAttempt > now) {
+				Log(LogDebug, "ApiListener")
+					<< "Not connecting to Endpoint '" << endpoint->GetName()
+					<< "' for another " << Utility::FormatDuration(nextAttempt - now) << ".";
+				continue;
+			}
+
+			candidates.emplace_back(nextAttempt, endpoint);
 		}
 	}
 
+	/* Try the endpoints which have been waiting longest first, the others wait for the next run. */
+	std::sort(candidates.begin(), candidates.end(), [](const std::pair<double, Endpoint::Ptr>& a, const std::pair<double, Endpoint::Ptr>& b) {
+		return a.first < b.first;
+	});
+
+	int budget = 32;
+	Value budgetValue = ScriptGlobal::Get("ApiReconnectBudget", &Empty);
+
+	if (!budgetValue.IsEmpty())
+		budget = budgetValue;
+
+	if (budget > 0 && candidates.size() > static_cast<size_t>(budget)) {
+		Log(LogNotice, "ApiListener")
+			<< "Deferring " << candidates.size() - budget << " connection attempts to the next run.";
+
+		m_DeferredReconnects += candidates.size() - budget;
+		candidates.resize(budget);
+	}
+
+	for (const auto& candidate : candidates) {
+		std::thread thread(std::bind(&ApiListener::AddConnection, this, candidate.second));
+		thread.detach();
+	}
+
 	Endpoint::Ptr master = GetMaster();
 
 	if (master)
@@ -821,45 +1025,93 @@ void ApiListener::RelayMessage(const MessageOrigin::Ptr& origin,
 	m_RelayQueue.Enqueue(std::bind(&ApiListener::SyncRelayMessage, this, origin, secobj, message, log), PriorityNormal, true);
 }
 
-void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj)
+/**
+ * Appends a message to the replay logs of the zones which couldn't be reached.
+ *
+ * Each zone has its own replay log, so reconnecting endpoints only read the
+ * messages which were meant for them and relaying messages to different zones
+ * doesn't serialize on a single log file.
+ *
+ * Each entry consists of two netstrings: A small MessagePack header with the
+ * message timestamp and the zone of the message's security object, followed
+ * by the JSON-encoded message itself. This way ReplayLog() can filter entries without
+ * decoding the messages. Every LOG_INDEX_INTERVAL entries the offset of the
+ * next entry is written to the log's index file, which lets ReplayLog()
+ * skip the entries an endpoint has already seen.
+ */
+void ApiListener::PersistMessage(const EncodedMessage::Ptr& message, const ConfigObject::Ptr& secobj, const std::set<Zone::Ptr>& logZones)
 {
-	double ts = message->Get("ts");
+	double ts = message->GetMessage()->Get("ts");
 
 	ASSERT(ts != 0);
 
-	Dictionary::Ptr pmessage = new Dictionary();
-	pmessage->Set("timestamp", ts);
-
-	pmessage->Set("message", JsonEncode(message));
+	Dictionary::Ptr pheader = new Dictionary();
+	pheader->Set("timestamp", ts);
 
 	if (secobj) {
-		Dictionary::Ptr secname = new Dictionary();
-		secname->Set("type", secobj->GetReflectionType()->GetName());
-		secname->Set("name", secobj->GetName());
-		pmessage->Set("secobj", secname);
-	}
-
-	boost::mutex::scoped_lock lock(m_LogLock);
-	if (m_LogFile) {
-		NetString::WriteStringToStream(m_LogFile, JsonEncode(pmessage));
-		m_LogMessageCount++;
-		SetLogMessageTimestamp(ts);
-
-		if (m_LogMessageCount > 50000) {
-			CloseLogFile();
-			RotateLogFile();
-			OpenLogFile();
+		/* Same rules as Zone::CanAccessObject(). */
+		Zone::Ptr zone;
+
+		if (secobj->GetReflectionType() == Zone::TypeInstance)
+			zone = static_pointer_cast<Zone>(secobj);
+		else
+			zone = static_pointer_cast<Zone>(secobj->GetZone());
+
+		if (!zone)
+			zone = Zone::GetLocalZone();
+
+		if (zone)
+			pheader->Set("zone", zone->GetName());
+	}
+
+	String header = StateFile::EncodeRecord(pheader);
+	/* The same bytes which were sent to JSON connections, if there were any. */
+	String pmessage = message->GetEncoded(JsonRpcEncodingJson);
+
+	for (const Zone::Ptr& zone : logZones) {
+		ReplayLogShard::Ptr shard = GetReplayLogShard(zone);
+
+		if (!shard)
+			continue;
+
+		boost::mutex::scoped_lock lock(shard->Lock);
+
+		if (!shard->File)
+			continue;
+
+		if (shard->IndexFile && shard->MessageCount % LOG_INDEX_INTERVAL == 0) {
+			String line = Convert::ToString(shard->MaxTimestamp) + " " + Convert::ToString(shard->FileOffset) + "\n";
+			shard->IndexFile->Write(line.CStr(), line.GetLength());
+		}
+
+		shard->FileOffset += NetString::WriteStringToStream(shard->File, header);
+		shard->FileOffset += NetString::WriteStringToStream(shard->File, pmessage);
+		shard->MessageCount++;
+		shard->MessageTimestamp = ts;
+
+		if (ts > shard->MaxTimestamp)
+			shard->MaxTimestamp = ts;
+
+		if (shard->MessageCount > 50000) {
+			CloseLogFile(shard);
+			RotateLogFile(shard);
+			OpenLogFile(shard);
 		}
 	}
 }
 
 void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	SyncSendMessage(endpoint, new EncodedMessage(message));
+}
+
+void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const EncodedMessage::Ptr& message)
 {
 	ObjectLock olock(endpoint);
 
-	if (!endpoint->GetSyncing()) {
+	if (!endpoint->GetSyncing() && !endpoint->GetSendQueueSpilled()) {
 		Log(LogNotice, "ApiListener")
-			<< "Sending message '" << message->Get("method") << "' to '" << endpoint->GetName() << "'";
+			<< "Sending message '" << message->GetMessage()->Get("method") << "' to '" << endpoint->GetName() << "'";
 
 		double maxTs = 0;
 
@@ -877,7 +1129,14 @@ void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionar
 	}
 }
 
-bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentMaster)
+/**
+ * Relays a message to the endpoints of a zone.
+ *
+ * @param logZones Receives the zones whose replay logs need the message.
+ * @returns Whether the message reached the zone.
+ */
+bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, const EncodedMessage::Ptr& message,
+	const Endpoint::Ptr& currentMaster, std::set<Zone::Ptr>& logZones)
 {
 	ASSERT(targetZone);
 
@@ -898,6 +1157,7 @@ bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrig
 	bool relayed = false, log_needed = false, log_done = false;
 
 	std::set<Endpoint::Ptr> targetEndpoints;
+	std::set<Zone::Ptr> disconnectedZones;
 
 	if (targetZone->GetGlobal()) {
 		targetEndpoints = myZone->GetEndpoints();
@@ -920,11 +1180,13 @@ bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrig
 
 		log_needed = true;
 
-		/* don't relay messages to disconnected endpoints */
-		if (!endpoint->GetConnected()) {
+		/* don't relay messages to disconnected endpoints, and log them for endpoints which can't keep up */
+		if (!endpoint->GetConnected() || endpoint->GetSendQueueSpilled()) {
 			if (targetZone == myZone)
 				log_done = false;
 
+			disconnectedZones.insert(endpoint->GetZone());
+
 			continue;
 		}
 
@@ -960,18 +1222,32 @@ bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrig
 	}
 
 	if (!skippedEndpoints.empty()) {
-		double ts = message->Get("ts");
+		double ts = message->GetMessage()->Get("ts");
 
 		for (const Endpoint::Ptr& endpoint : skippedEndpoints)
 			endpoint->SetLocalLogPosition(ts);
 	}
 
-	return !log_needed || log_done;
+	if (!log_needed || log_done)
+		return true;
+
+	/* Global messages are logged for each zone with disconnected endpoints. */
+	if (targetZone->GetGlobal())
+		logZones.insert(disconnectedZones.begin(), disconnectedZones.end());
+	else
+		logZones.insert(targetZone);
+
+	return false;
 }
 
 void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
 	const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log)
 {
+	TraceSpan span("cluster.relay");
+
+	if (span.IsSampled())
+		span.SetDetail(message->Get("method"));
+
 	double ts = Utility::GetTime();
 	message->Set("ts", ts);
 
@@ -995,58 +1271,116 @@ void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
 
 	Endpoint::Ptr master = GetMaster();
 
-	bool need_log = !RelayMessageOne(target_zone, origin, message, master);
+	/* Encode the message only once for all endpoints and the replay log. */
+	EncodedMessage::Ptr encodedMessage = new EncodedMessage(message);
+
+	std::set<Zone::Ptr> logZones;
+
+	RelayMessageOne(target_zone, origin, encodedMessage, master, logZones);
+
+	for (const Zone::Ptr& zone : target_zone->GetAllParents())
+		RelayMessageOne(zone, origin, encodedMessage, master, logZones);
+
+	if (log && !logZones.empty())
+		PersistMessage(encodedMessage, secobj, logZones);
+}
+
+/**
+ * Returns the replay log for a zone. The log is opened when it's used for
+ * the first time.
+ *
+ * @param zone The zone.
+ * @returns The replay log, or an empty pointer if the listener was stopped.
+ */
+ReplayLogShard::Ptr ApiListener::GetReplayLogShard(const Zone::Ptr& zone)
+{
+	ProfiledMutex::scoped_lock lock(m_LogLock);
+
+	if (m_ReplayLogShardsClosed)
+		return ReplayLogShard::Ptr();
+
+	ReplayLogShard::Ptr& shard = m_ReplayLogShards[zone->GetName()];
+
+	if (!shard) {
+		shard = std::make_shared<ReplayLogShard>();
+		shard->Path = GetApiDir() + "log/" + zone->GetName() + "/";
+
+		boost::mutex::scoped_lock shardLock(shard->Lock);
 
-	for (const Zone::Ptr& zone : target_zone->GetAllParents()) {
-		if (!RelayMessageOne(zone, origin, message, master))
-			need_log = true;
+		/* The current file might be left over from before the last restart. */
+		RotateLogFile(shard);
+		OpenLogFile(shard);
 	}
 
-	if (log && need_log)
-		PersistMessage(message, secobj);
+	return shard;
 }
 
-/* must hold m_LogLock */
-void ApiListener::OpenLogFile()
+/* must hold shard->Lock */
+void ApiListener::OpenLogFile(const ReplayLogShard::Ptr& shard)
 {
-	String path = GetApiDir() + "log/current";
+	String path = shard->Path + "current";
 
-	Utility::MkDirP(Utility::DirName(path), 0750);
+	Utility::MkDirP(shard->Path, 0750);
 
 	auto *fp = new std::fstream(path.CStr(), std::fstream::out | std::ofstream::app);
 
 	if (!fp->good()) {
 		Log(LogWarning, "ApiListener")
 			<< "Could not open spool file: " << path;
+		delete fp;
 		return;
 	}
 
-	m_LogFile = new StdioStream(fp, true);
-	m_LogMessageCount = 0;
-	SetLogMessageTimestamp(Utility::GetTime());
+	shard->File = new StdioStream(fp, true);
+	shard->MessageCount = 0;
+	fp->seekp(0, std::ios_base::end);
+	shard->FileOffset = fp->tellp();
+	shard->MaxTimestamp = 0;
+	shard->MessageTimestamp = Utility::GetTime();
+
+	/* Entries which were written before we opened the file aren't covered by an index. */
+	shard->IndexFile.reset();
+
+	if (shard->FileOffset != 0)
+		return;
+
+	auto *ifp = new std::fstream((path + ".idx").CStr(), std::fstream::out | std::fstream::trunc);
+
+	if (!ifp->good()) {
+		delete ifp;
+		return;
+	}
+
+	shard->IndexFile = new StdioStream(ifp, true);
 }
 
-/* must hold m_LogLock */
-void ApiListener::CloseLogFile()
+/* must hold shard->Lock */
+void ApiListener::CloseLogFile(const ReplayLogShard::Ptr& shard)
 {
-	if (!m_LogFile)
+	if (!shard->File)
 		return;
 
-	m_LogFile->Close();
-	m_LogFile.reset();
+	shard->File->Close();
+	shard->File.reset();
+
+	if (shard->IndexFile) {
+		shard->IndexFile->Close();
+		shard->IndexFile.reset();
+	}
 }
 
-/* must hold m_LogLock */
-void ApiListener::RotateLogFile()
+/* must hold shard->Lock */
+void ApiListener::RotateLogFile(const ReplayLogShard::Ptr& shard)
 {
-	double ts = GetLogMessageTimestamp();
+	double ts = shard->MessageTimestamp;
 
 	if (ts == 0)
 		ts = Utility::GetTime();
 
-	String oldpath = GetApiDir() + "log/current";
-	String newpath = GetApiDir() + "log/" + Convert::ToString(static_cast<int>(ts)+1);
+	String oldpath = shard->Path + "current";
+	String newpath = shard->Path + Convert::ToString(static_cast<int>(ts)+1);
 	(void) rename(oldpath.CStr(), newpath.CStr());
+	(void) rename((oldpath + ".idx").CStr(), (newpath + ".idx").CStr());
 }
 
 void ApiListener::LogGlobHandler(std::vector<int>& files, const String& file)
@@ -1067,138 +1401,270 @@ void ApiListener::LogGlobHandler(std::vector<int>& files, const String& file)
 	files.push_back(ts);
 }
 
-void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
+/**
+ * Removes the files of a replay log which none of the specified endpoints need anymore.
+ *
+ * @param path The replay log's directory.
+ * @param endpoints The endpoints which read the replay log.
+ */
+void ApiListener::RemoveOldLogFiles(const String& path, const std::set<Endpoint::Ptr>& endpoints)
 {
-	Endpoint::Ptr endpoint = client->GetEndpoint();
-
-	if (endpoint->GetLogDuration() == 0) {
-		ObjectLock olock2(endpoint);
-		endpoint->SetSyncing(false);
-		return;
-	}
+	double now = Utility::GetTime();
 
-	CONTEXT("Replaying log for Endpoint '" + endpoint->GetName() + "'");
+	std::vector<int> files;
+	Utility::Glob(path + "*", std::bind(&ApiListener::LogGlobHandler, std::ref(files), _1), GlobFile);
+	std::sort(files.begin(), files.end());
 
-	int count = -1;
-	double peer_ts = endpoint->GetLocalLogPosition();
-	double logpos_ts = peer_ts;
-	bool last_sync = false;
+	for (int ts : files) {
+		bool need = false;
 
-	Endpoint::Ptr target_endpoint = client->GetEndpoint();
-	ASSERT(target_endpoint);
+		for (const Endpoint::Ptr& endpoint : endpoints) {
+			if (endpoint->GetLogDuration() >= 0 && ts < now - endpoint->GetLogDuration())
+				continue;
 
-	Zone::Ptr target_zone = target_endpoint->GetZone();
+			if (ts > endpoint->GetLocalLogPosition()) {
+				need = true;
+				break;
+			}
+		}
 
-	if (!target_zone) {
-		ObjectLock olock2(endpoint);
-		endpoint->SetSyncing(false);
-		return;
+		if (!need) {
+			String file = path + Convert::ToString(ts);
+			Log(LogNotice, "ApiListener")
+				<< "Removing old log file: " << file;
+			(void)unlink(file.CStr());
+			(void)unlink((file + ".idx").CStr());
+		}
 	}
+}
 
-	for (;;) {
-		boost::mutex::scoped_lock lock(m_LogLock);
+/**
+ * Uses a log file's index to find the offset from which on the log
+ * contains messages which are newer than the specified timestamp.
+ *
+ * @param path The path of the log file.
+ * @param peer_ts The timestamp of the newest message the peer has seen.
+ * @returns The offset at which replaying should start.
+ */
+std::streamoff ApiListener::GetLogReplayOffset(const String& path, double peer_ts)
+{
+	std::ifstream fp((path + ".idx").CStr());
 
-		CloseLogFile();
-		RotateLogFile();
+	std::streamoff offset = 0;
+	double maxTs;
+	std::streamoff entryOffset;
 
-		if (count == -1 || count > 50000) {
-			OpenLogFile();
-			lock.unlock();
-		} else {
-			last_sync = true;
-		}
+	/* Each line holds the newest timestamp of all the entries before the offset. */
+	while (fp >> maxTs >> entryOffset) {
+		if (maxTs > peer_ts)
+			break;
 
-		count = 0;
+		offset = entryOffset;
+	}
 
-		std::vector<int> files;
-		Utility::Glob(GetApiDir() + "log/*", std::bind(&ApiListener::LogGlobHandler, std::ref(files), _1), GlobFile);
-		std::sort(files.begin(), files.end());
+	return offset;
+}
 
-		for (int ts : files) {
-			String path = GetApiDir() + "log/" + Convert::ToString(ts);
+/**
+ * Sends the messages from a replay log's files which the client hasn't seen yet.
+ *
+ * @param client The client.
+ * @param path The replay log's directory.
+ * @param peer_ts The timestamp of the newest message the client has seen.
+ * @param logpos_ts The log position which was last sent to the client.
+ * @returns The number of messages which were sent.
+ */
+int ApiListener::ReplayLogFiles(const JsonRpcConnection::Ptr& client, const String& path, double& peer_ts, double& logpos_ts)
+{
+	Endpoint::Ptr endpoint = client->GetEndpoint();
+	Zone::Ptr target_zone = endpoint->GetZone();
 
-			if (ts < peer_ts)
-				continue;
+	int count = 0;
 
-			Log(LogNotice, "ApiListener")
-				<< "Replaying log: " << path;
+	/* Whether the target zone may access objects in a zone. */
+	std::map<String, bool> zoneAccess;
 
-			auto *fp = new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary);
-			StdioStream::Ptr logStream = new StdioStream(fp, true);
+	std::vector<int> files;
+	Utility::Glob(path + "*", std::bind(&ApiListener::LogGlobHandler, std::ref(files), _1), GlobFile);
+	std::sort(files.begin(), files.end());
 
-			String message;
-			StreamReadContext src;
-			while (true) {
-				Dictionary::Ptr pmessage;
+	for (int ts : files) {
+		String file = path + Convert::ToString(ts);
 
-				try {
-					StreamReadStatus srs = NetString::ReadStringFromStream(logStream, &message, src);
+		if (ts < peer_ts)
+			continue;
 
-					if (srs == StatusEof)
-						break;
+		std::streamoff offset = GetLogReplayOffset(file, peer_ts);
 
-					if (srs != StatusNewItem)
-						continue;
+		Log(LogNotice, "ApiListener")
+			<< "Replaying log: " << file << " (starting at offset " << offset << ")";
+
+		auto *fp = new std::fstream(file.CStr(), std::fstream::in | std::fstream::binary);
+		fp->seekg(offset);
+		StdioStream::Ptr logStream = new StdioStream(fp, true);
+
+		String message;
+		StreamReadContext src;
+		while (true) {
+			Dictionary::Ptr pmessage;
 
-					pmessage = JsonDecode(message);
-				} catch (const std::exception&) {
-					Log(LogWarning, "ApiListener")
-						<< "Unexpected end-of-file for cluster log: " << path;
+			try {
+				StreamReadStatus srs = NetString::ReadStringFromStream(logStream, &message, src);
 
-					/* Log files may be incomplete or corrupted. This is perfectly OK. */
+				if (srs == StatusEof)
 					break;
-				}
 
-				if (pmessage->Get("timestamp") <= peer_ts)
+				if (srs != StatusNewItem)
 					continue;
 
-				Dictionary::Ptr secname = pmessage->Get("secobj");
+				pmessage = StateFile::DecodeRecord(message);
 
-				if (secname) {
-					ConfigObject::Ptr secobj = ConfigObject::GetObject(secname->Get("type"), secname->Get("name"));
+				/* Log files written by older versions embed the message in the header. */
+				if (!pmessage->Contains("message")) {
+					do {
+						srs = NetString::ReadStringFromStream(logStream, &message, src);
+					} while (srs == StatusNeedData);
 
-					if (!secobj)
-						continue;
+					if (srs != StatusNewItem)
+						BOOST_THROW_EXCEPTION(std::invalid_argument("Missing message for log entry."));
 
-					if (!target_zone->CanAccessObject(secobj))
-						continue;
+					pmessage->Set("message", message);
 				}
+			} catch (const std::exception&) {
+				Log(LogWarning, "ApiListener")
+					<< "Unexpected end-of-file for cluster log: " << file;
 
-				try  {
-					size_t bytesSent = NetString::WriteStringToStream(client->GetStream(), pmessage->Get("message"));
-					endpoint->AddMessageSent(bytesSent);
-					count++;
-				} catch (const std::exception& ex) {
-					Log(LogWarning, "ApiListener")
-						<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex, false);
+				/* Log files may be incomplete or corrupted. This is perfectly OK. */
+				break;
+			}
+
+			if (pmessage->Get("timestamp") <= peer_ts)
+				continue;
 
-					Log(LogDebug, "ApiListener")
-						<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex);
+			String zoneName = pmessage->Get("zone");
 
-					break;
+			if (!zoneName.IsEmpty()) {
+				auto it = zoneAccess.find(zoneName);
+
+				if (it == zoneAccess.end()) {
+					Zone::Ptr zone = Zone::GetByName(zoneName);
+					bool access = zone && (zone->GetGlobal() || zone->IsChildOf(target_zone));
+					it = zoneAccess.insert(std::make_pair(zoneName, access)).first;
 				}
 
-				peer_ts = pmessage->Get("timestamp");
+				if (!it->second)
+					continue;
+			}
 
-				if (ts > logpos_ts + 10) {
-					logpos_ts = ts;
+			Dictionary::Ptr secname = pmessage->Get("secobj");
 
-					Dictionary::Ptr lmessage = new Dictionary({
-						{ "jsonrpc", "2.0" },
-						{ "method", "log::SetLogPosition" },
-						{ "params", new Dictionary({
-							{ "log_position", logpos_ts }
-						}) }
-					});
+			if (secname) {
+				ConfigObject::Ptr secobj = ConfigObject::GetObject(secname->Get("type"), secname->Get("name"));
 
-					size_t bytesSent = JsonRpc::SendMessage(client->GetStream(), lmessage);
-					endpoint->AddMessageSent(bytesSent);
-				}
+				if (!secobj)
+					continue;
+
+				if (!target_zone->CanAccessObject(secobj))
+					continue;
+			}
+
+			try  {
+				client->WaitForSendQueue();
+
+				/* The connection was closed, give up and wait for a reconnect. */
+				if (client->GetStream()->IsEof())
+					break;
+
+				client->SendRawMessage(pmessage->Get("message"));
+				count++;
+			} catch (const std::exception& ex) {
+				Log(LogWarning, "ApiListener")
+					<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex, false);
+
+				Log(LogDebug, "ApiListener")
+					<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex);
+
+				break;
 			}
 
-			logStream->Close();
+			peer_ts = pmessage->Get("timestamp");
+
+			if (ts > logpos_ts + 10) {
+				logpos_ts = ts;
+
+				Dictionary::Ptr lmessage = new Dictionary({
+					{ "jsonrpc", "2.0" },
+					{ "method", "log::SetLogPosition" },
+					{ "params", new Dictionary({
+						{ "log_position", logpos_ts }
+					}) }
+				});
+
+				client->SendMessage(lmessage);
+			}
 		}
 
+		logStream->Close();
+	}
+
+	return count;
+}
+
+void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
+{
+	Endpoint::Ptr endpoint = client->GetEndpoint();
+
+	if (endpoint->GetLogDuration() == 0) {
+		ObjectLock olock2(endpoint);
+		endpoint->SetSyncing(false);
+		client->ResumeSendQueue();
+		return;
+	}
+
+	CONTEXT("Replaying log for Endpoint '" + endpoint->GetName() + "'");
+
+	int count = -1;
+	double peer_ts = endpoint->GetLocalLogPosition();
+	double logpos_ts = peer_ts;
+	bool last_sync = false;
+
+	Zone::Ptr target_zone = endpoint->GetZone();
+
+	ReplayLogShard::Ptr shard;
+
+	if (target_zone)
+		shard = GetReplayLogShard(target_zone);
+
+	if (!shard) {
+		ObjectLock olock2(endpoint);
+		endpoint->SetSyncing(false);
+		client->ResumeSendQueue();
+		return;
+	}
+
+	/* Older versions wrote a single replay log for all zones. Nobody writes to it anymore. */
+	int legacyCount = ReplayLogFiles(client, GetApiDir() + "log/", peer_ts, logpos_ts);
+
+	if (legacyCount > 0) {
+		Log(LogInformation, "ApiListener")
+			<< "Replayed " << legacyCount << " messages from the legacy replay log.";
+	}
+
+	for (;;) {
+		boost::mutex::scoped_lock lock(shard->Lock);
+
+		CloseLogFile(shard);
+		RotateLogFile(shard);
+
+		if (count == -1 || count > 50000) {
+			OpenLogFile(shard);
+			lock.unlock();
+		} else {
+			last_sync = true;
+		}
+
+		count = ReplayLogFiles(client, shard->Path, peer_ts, logpos_ts);
+
 		if (count > 0) {
 			Log(LogInformation, "ApiListener")
 				<< "Replayed " << count << " messages.";
@@ -1211,15 +1677,38 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 			{
 				ObjectLock olock2(endpoint);
 				endpoint->SetSyncing(false);
+
+				/* The shard is still locked, nothing can be logged for the endpoint in between. */
+				client->ResumeSendQueue();
 			}
 
-			OpenLogFile();
+			OpenLogFile(shard);
 
 			break;
 		}
 	}
 }
 
+/**
+ * Replays the messages which were logged while the client's send queue
+ * exceeded the high watermark.
+ *
+ * @param client The client.
+ */
+void ApiListener::ResumeSpilledClient(const JsonRpcConnection::Ptr& client)
+{
+	m_SyncQueue.Enqueue([this, client]() {
+		Endpoint::Ptr endpoint = client->GetEndpoint();
+
+		{
+			ObjectLock olock(endpoint);
+			endpoint->SetSyncing(true);
+		}
+
+		ReplayLog(client);
+	});
+}
+
 void ApiListener::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	std::pair<Dictionary::Ptr, Dictionary::Ptr> stats;
@@ -1307,6 +1796,39 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 		connectedZones->Set(zone->GetName(), zoneStats);
 	}
 
+	/* compression stats */
+	Dictionary::Ptr compressionStats = new Dictionary();
+
+	for (Endpoint *endpoint : ConfigType::GetObjectRange<Endpoint>()) {
+		if (endpoint->GetName() == GetIdentity())
+			continue;
+
+		Dictionary::Ptr stats = endpoint->GetCompressionStats();
+
+		if (stats->Get("bytes_sent_compressed") > 0 || stats->Get("bytes_received_compressed") > 0)
+			compressionStats->Set(endpoint->GetName(), stats);
+	}
+
+	/* per-endpoint telemetry */
+	Dictionary::Ptr telemetryStats = new Dictionary();
+
+	for (Endpoint *endpoint : ConfigType::GetObjectRange<Endpoint>()) {
+		if (endpoint->GetName() == GetIdentity())
+			continue;
+
+		telemetryStats->Set(endpoint->GetName(), endpoint->GetTelemetry());
+	}
+
+	/* API function stats */
+	Dictionary::Ptr functionStats = new Dictionary();
+
+	for (const auto& kv : ApiFunctionRegistry::GetInstance()->GetItems()) {
+		Dictionary::Ptr stats = kv.second->GetStats();
+
+		if (stats->Get("count") > 0)
+			functionStats->Set(kv.first, stats);
+	}
+
 	/* connection stats */
 	size_t jsonRpcClients = GetAnonymousClients().size();
 	size_t httpClients = GetHttpClients().size();
@@ -1318,6 +1840,27 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 	double syncQueueItemRate = m_SyncQueue.GetTaskCount(60) / 60.0;
 	double relayQueueItemRate = m_RelayQueue.GetTaskCount(60) / 60.0;
 
+	/* HTTP request stats */
+	Dictionary::Ptr httpStats = HttpHandler::GetStats();
+	Dictionary::Ptr httpConnectionStats = HttpServerConnection::GetStats();
+
+	/* TLS stats */
+	unsigned long tlsHandshakes = m_TlsHandshakes;
+	unsigned long tlsResumedHandshakes = m_TlsResumedHandshakes;
+	double tlsResumptionRate = tlsHandshakes > 0 ? static_cast<double>(tlsResumedHandshakes) / tlsHandshakes : 0;
+
+	/* reconnect stats */
+	size_t backoffEndpoints = 0;
+
+	{
+		boost::mutex::scoped_lock lock(m_ReconnectLock);
+
+		for (const auto& kv : m_ReconnectStates) {
+			if (kv.second.Failures > 0)
+				backoffEndpoints++;
+		}
+	}
+
 	Dictionary::Ptr status = new Dictionary({
 		{ "identity", GetIdentity() },
 		{ "num_endpoints", allEndpoints },
@@ -1340,8 +1883,30 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 		}) },
 
 		{ "http", new Dictionary({
-			{ "clients", httpClients }
-		}) }
+			{ "clients", httpClients },
+			{ "connections", httpConnectionStats },
+			{ "requests", httpStats }
+		}) },
+
+		{ "tls", new Dictionary({
+			{ "handshakes", tlsHandshakes },
+			{ "resumed_handshakes", tlsResumedHandshakes },
+			{ "resumption_rate", tlsResumptionRate },
+			{ "kernel_send_offloads", m_TlsKernelSendOffloads.load() },
+			{ "kernel_receive_offloads", m_TlsKernelReceiveOffloads.load() }
+		}) },
+
+		{ "reconnect", new Dictionary({
+			{ "attempts", m_ReconnectAttempts.load() },
+			{ "deferred", m_DeferredReconnects.load() },
+			{ "backoff_endpoints", backoffEndpoints },
+			{ "throttled_accepts", m_ThrottledAccepts.load() }
+		}) },
+
+		{ "compression", compressionStats },
+		{ "telemetry", telemetryStats },
+		{ "functions", functionStats },
+		{ "event_queues", EventQueue::GetStatusForAllQueues() }
 	});
 
 	/* performance data */
@@ -1351,6 +1916,13 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 
 	perfdata->Set("num_json_rpc_clients", jsonRpcClients);
 	perfdata->Set("num_http_clients", httpClients);
+	perfdata->Set("num_http_active_requests", httpStats->Get("active_requests"));
+	perfdata->Set("num_http_queued_requests", httpStats->Get("queued_requests"));
+	perfdata->Set("num_http_keepalive_requests", httpConnectionStats->Get("keepalive_requests"));
+	perfdata->Set("num_http_pipelined_requests", httpConnectionStats->Get("pipelined_requests"));
+	perfdata->Set("num_tls_handshakes", tlsHandshakes);
+	perfdata->Set("num_tls_resumed_handshakes", tlsResumedHandshakes);
+	perfdata->Set("num_reconnect_backoff_endpoints", backoffEndpoints);
 	perfdata->Set("num_json_rpc_work_queue_items", workQueueItems);
 	perfdata->Set("num_json_rpc_work_queue_count", workQueueCount);
 	perfdata->Set("num_json_rpc_sync_queue_items", syncQueueItems);
@@ -1414,8 +1986,79 @@ std::set<HttpServerConnection::Ptr> ApiListener::GetHttpClients() const
 	return m_HttpClients;
 }
 
+/**
+ * Builds the icinga::Hello message which is sent by the connecting side.
+ * It announces the message encodings and compression methods which this
+ * instance can decode, the config sync methods it supports and the
+ * messages it accepts in batches.
+ */
+Dictionary::Ptr ApiListener::MakeHelloMessage()
+{
+	return new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "icinga::Hello" },
+		{ "params", new Dictionary({
+			{ "encodings", new Array({ "msgpack" }) },
+			{ "compression", MessageCompressor::IsSupported() ? new Array({ "deflate" }) : new Array() },
+			{ "config_sync", new Array({ "checksums" }) },
+			{ "batching", new Array({ "event::ExecuteCommand", "event::CheckResult" }) }
+		}) }
+	});
+}
+
 Value ApiListener::HelloAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
 {
+	JsonRpcConnection::Ptr client = origin->FromClient;
+
+	if (!client)
+		return Empty;
+
+	/* Older versions don't send any encodings and keep talking uncompressed JSON. */
+	Array::Ptr encodings = params->Get("encodings");
+	Array::Ptr compression = params->Get("compression");
+	Array::Ptr configSync = params->Get("config_sync");
+	Array::Ptr batching = params->Get("batching");
+
+	bool msgpack = encodings && encodings->Contains("msgpack");
+	bool deflate = compression && compression->Contains("deflate") && MessageCompressor::IsSupported();
+	bool checksums = configSync && configSync->Contains("checksums");
+	bool batch = batching && batching->Contains("event::ExecuteCommand") && batching->Contains("event::CheckResult");
+
+	if (!msgpack && !deflate && !checksums && !batch) {
+		client->SetHello(params);
+		return Empty;
+	}
+
+	/* Answer the connecting side's hello so that it learns about our capabilities, too. */
+	if (client->GetRole() == RoleServer)
+		client->SendMessage(MakeHelloMessage());
+
+	if (msgpack) {
+		Log(LogNotice, "ApiListener")
+			<< "Using MessagePack encoding for messages to '" << client->GetIdentity() << "'.";
+
+		client->SetEncoding(JsonRpcEncodingMsgPack);
+	}
+
+	Endpoint::Ptr endpoint = client->GetEndpoint();
+
+	if (deflate && endpoint && endpoint->GetCompression()) {
+		Log(LogInformation, "ApiListener")
+			<< "Compressing messages to endpoint '" << endpoint->GetName() << "'.";
+
+		client->EnableCompression();
+	}
+
+	if (batch) {
+		Log(LogNotice, "ApiListener")
+			<< "Sending command executions and check results to '" << client->GetIdentity() << "' in batches.";
+
+		client->EnableBatching();
+	}
+
+	/* Only now the reply is queued, so SendConfigUpdate() can't overtake it. */
+	client->SetHello(params);
+
 	return Empty;
 }
 
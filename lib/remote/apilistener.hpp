@@ -30,6 +30,7 @@
 #include "base/workqueue.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/tlsstream.hpp"
+#include "base/profiledmutex.hpp"
 #include <set>
 
 namespace icinga
@@ -46,6 +47,25 @@ struct ConfigDirInformation
 	Dictionary::Ptr UpdateV2;
 };
 
+/**
+ * The replay log for the endpoints of one zone.
+ *
+ * @ingroup remote
+ */
+struct ReplayLogShard
+{
+	typedef std::shared_ptr<ReplayLogShard> Ptr;
+
+	boost::mutex Lock;
+	String Path;
+	Stream::Ptr File;
+	Stream::Ptr IndexFile;
+	size_t MessageCount{0};
+	size_t FileOffset{0};
+	double MaxTimestamp{0};
+	double MessageTimestamp{0};
+};
+
 /**
 * @ingroup remote
 */
@@ -74,8 +94,13 @@ public:
 	Endpoint::Ptr GetLocalEndpoint() const;
 
 	void SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message);
+	void SyncSendMessage(const Endpoint::Ptr& endpoint, const EncodedMessage::Ptr& message);
+
+	void ResumeSpilledClient(const JsonRpcConnection::Ptr& client);
 	void RelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
 
+	void ScheduleLogCleanup();
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 	std::pair<Dictionary::Ptr, Dictionary::Ptr> GetStatus();
 
@@ -91,6 +116,9 @@ public:
 
 	/* filesync */
 	static Value ConfigUpdateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ConfigManifestHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ConfigRequestFilesHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ConfigFileChunkHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
 	/* configsync */
 	static void ConfigUpdateObjectHandler(const ConfigObject::Ptr& object, const Value& cookie);
@@ -100,6 +128,7 @@ public:
 	static Value HelloAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
 	static void UpdateObjectAuthority();
+	static void RegisterLoadFunction(const std::function<double ()>& function);
 
 	static bool IsHACluster();
 	static String GetFromZoneName(const Zone::Ptr& fromZone);
@@ -107,6 +136,7 @@ public:
 	static String GetDefaultCertPath();
 	static String GetDefaultKeyPath();
 	static String GetDefaultCaPath();
+	static String GetTicketKeyPath();
 
 protected:
 	void OnConfigLoaded() override;
@@ -120,12 +150,32 @@ private:
 	std::shared_ptr<SSL_CTX> m_SSLContext;
 	std::set<TcpSocket::Ptr> m_Servers;
 
+	boost::mutex m_TlsSessionsLock;
+	std::map<String, std::shared_ptr<SSL_SESSION> > m_TlsSessions;
+	std::atomic<unsigned long> m_TlsHandshakes{0};
+	std::atomic<unsigned long> m_TlsResumedHandshakes{0};
+	std::atomic<unsigned long> m_TlsKernelSendOffloads{0};
+	std::atomic<unsigned long> m_TlsKernelReceiveOffloads{0};
+
+	struct ReconnectState
+	{
+		int Failures{0};
+		double NextAttempt{0};
+		bool WasConnected{false};
+	};
+
+	boost::mutex m_ReconnectLock;
+	std::map<String, ReconnectState> m_ReconnectStates;
+	std::atomic<unsigned long> m_ReconnectAttempts{0};
+	std::atomic<unsigned long> m_DeferredReconnects{0};
+	std::atomic<unsigned long> m_ThrottledAccepts{0};
+
 	mutable boost::mutex m_AnonymousClientsLock;
 	mutable boost::mutex m_HttpClientsLock;
 	std::set<JsonRpcConnection::Ptr> m_AnonymousClients;
 	std::set<HttpServerConnection::Ptr> m_HttpClients;
 
-	Timer::Ptr m_Timer;
+	Timer::Ptr m_LogCleanupTimer;
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_AuthorityTimer;
 	Timer::Ptr m_CleanupCertificateRequestsTimer;
@@ -133,33 +183,47 @@ private:
 
 	static ApiListener::Ptr m_Instance;
 
-	void ApiTimerHandler();
+	void LogCleanupTimerHandler();
 	void ApiReconnectTimerHandler();
+	static void AuthorityTimerHandler();
+	static void UpdateLoadBalancing();
 	void CleanupCertificateRequestsTimerHandler();
 
 	bool AddListener(const String& node, const String& service);
 	void AddConnection(const Endpoint::Ptr& endpoint);
+	void UpdateReconnectState(const Endpoint::Ptr& endpoint, bool connected);
+	static double GetReconnectDelay(int failures);
 
 	void NewClientHandler(const Socket::Ptr& client, const String& hostname, ConnectionRole role);
 	void NewClientHandlerInternal(const Socket::Ptr& client, const String& hostname, ConnectionRole role);
 	void ListenerThreadProc(const Socket::Ptr& server);
 
+	std::shared_ptr<SSL_SESSION> GetTlsSession(const String& hostname);
+	void SetTlsSession(const String& hostname, const std::shared_ptr<SSL_SESSION>& session);
+
+	static Dictionary::Ptr MakeHelloMessage();
+
 	WorkQueue m_RelayQueue;
 	WorkQueue m_SyncQueue{0, 4};
 
-	boost::mutex m_LogLock;
-	Stream::Ptr m_LogFile;
-	size_t m_LogMessageCount{0};
+	ProfiledMutex m_LogLock{"ApiListener log"};
+	std::map<String, ReplayLogShard::Ptr> m_ReplayLogShards;
+	bool m_ReplayLogShardsClosed{false};
 
-	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentMaster);
+	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, const EncodedMessage::Ptr& message,
+		const Endpoint::Ptr& currentMaster, std::set<Zone::Ptr>& logZones);
 	void SyncRelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
-	void PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj);
+	void PersistMessage(const EncodedMessage::Ptr& message, const ConfigObject::Ptr& secobj, const std::set<Zone::Ptr>& logZones);
 
-	void OpenLogFile();
-	void RotateLogFile();
-	void CloseLogFile();
+	ReplayLogShard::Ptr GetReplayLogShard(const Zone::Ptr& zone);
+	static void OpenLogFile(const ReplayLogShard::Ptr& shard);
+	static void RotateLogFile(const ReplayLogShard::Ptr& shard);
+	static void CloseLogFile(const ReplayLogShard::Ptr& shard);
 	static void LogGlobHandler(std::vector<int>& files, const String& file);
+	static void RemoveOldLogFiles(const String& path, const std::set<Endpoint::Ptr>& endpoints);
+	static std::streamoff GetLogReplayOffset(const String& path, double peer_ts);
 	void ReplayLog(const JsonRpcConnection::Ptr& client);
+	static int ReplayLogFiles(const JsonRpcConnection::Ptr& client, const String& path, double& peer_ts, double& logpos_ts);
 
 	static void CopyCertificateFile(const String& oldCertPath, const String& newCertPath);
 
@@ -172,7 +236,12 @@ private:
 	void SyncZoneDir(const Zone::Ptr& zone) const;
 
 	static void ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file);
+	static Dictionary::Ptr GetConfigChecksums(const Dictionary::Ptr& config);
+	static std::map<String, ConfigDirInformation> GetSyncedZoneConfigs(const Zone::Ptr& azone);
 	void SendConfigUpdate(const JsonRpcConnection::Ptr& aclient);
+	static bool ApplyConfigManifest(const JsonRpcConnection::Ptr& client, const String& zoneName, const Dictionary::Ptr& checksums);
+	static void RequestConfigFiles(const JsonRpcConnection::Ptr& client);
+	static void FinishConfigTransfer(const JsonRpcConnection::Ptr& client);
 
 	/* configsync */
 	void UpdateConfigObject(const ConfigObject::Ptr& object, const MessageOrigin::Ptr& origin,
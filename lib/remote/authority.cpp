@@ -21,9 +21,137 @@
 #include "remote/apilistener.hpp"
 #include "base/configtype.hpp"
 #include "base/utility.hpp"
+#include "base/rendezvoushash.hpp"
+#include "base/logger.hpp"
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#ifndef _WIN32
+#	include <sys/resource.h>
+#endif /* _WIN32 */
 
 using namespace icinga;
 
+static boost::mutex l_LoadFunctionsMutex;
+static std::vector<std::function<double ()> > l_LoadFunctions;
+
+/**
+ * Registers a function which reports how busy this instance is, e.g.
+ * the share of check slots which are in use. 0 means idle, 1 means
+ * fully loaded; the load of the instance is the highest reported value.
+ *
+ * @param function The function.
+ */
+void ApiListener::RegisterLoadFunction(const std::function<double ()>& function)
+{
+	boost::mutex::scoped_lock lock(l_LoadFunctionsMutex);
+	l_LoadFunctions.push_back(function);
+}
+
+/* The share of the machine's CPU time the process used since the last call. */
+static double GetCpuLoad()
+{
+#ifndef _WIN32
+	static double lastWallTime = 0, lastCpuTime = 0;
+
+	rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0;
+
+	double cpuTime = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+		+ usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+	double wallTime = Utility::GetTime();
+
+	double load = 0;
+
+	if (lastWallTime > 0 && wallTime > lastWallTime) {
+		unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+		load = (cpuTime - lastCpuTime) / (wallTime - lastWallTime) / cpus;
+	}
+
+	lastWallTime = wallTime;
+	lastCpuTime = cpuTime;
+
+	return load;
+#else /* _WIN32 */
+	return 0;
+#endif /* _WIN32 */
+}
+
+/**
+ * Measures the local load and, if load balancing is enabled, adjusts the
+ * local endpoint's authority factor: An endpoint whose load is clearly
+ * above the zone's average gives up some objects, one which is clearly
+ * below takes over some. Each step changes the factor by 0.1, so only a
+ * small share of the objects moves per authority update.
+ */
+void ApiListener::UpdateLoadBalancing()
+{
+	double load = GetCpuLoad();
+
+	{
+		boost::mutex::scoped_lock lock(l_LoadFunctionsMutex);
+
+		for (const std::function<double ()>& function : l_LoadFunctions)
+			load = std::max(load, function());
+	}
+
+	Endpoint::Ptr my_endpoint = Endpoint::GetLocalEndpoint();
+
+	if (!my_endpoint)
+		return;
+
+	my_endpoint->SetLoad(load);
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+	Zone::Ptr my_zone = Zone::GetLocalZone();
+
+	if (!listener || !listener->GetLoadBalancing() || !my_zone) {
+		my_endpoint->SetAuthorityFactor(1);
+		return;
+	}
+
+	double total = 0;
+	int count = 0;
+
+	for (const Endpoint::Ptr& endpoint : my_zone->GetEndpoints()) {
+		if (endpoint != my_endpoint && !endpoint->GetConnected())
+			continue;
+
+		total += endpoint->GetLoad();
+		count++;
+	}
+
+	if (count < 2)
+		return;
+
+	double average = total / count;
+	double factor = my_endpoint->GetAuthorityFactor();
+	double newFactor = factor;
+
+	/* Hysteresis: differences of less than 20% (or 0.1) are ignored. */
+	if (load > average * 1.2 && load - average > 0.1)
+		newFactor = std::max(0.3, std::round(factor * 10 - 1) / 10);
+	else if (load < average * 0.8 && average - load > 0.1)
+		newFactor = std::min(2.0, std::round(factor * 10 + 1) / 10);
+
+	if (newFactor != factor) {
+		Log(LogInformation, "ApiListener")
+			<< "Changing the authority factor of endpoint '" << my_endpoint->GetName() << "' from "
+			<< factor << " to " << newFactor << " (load " << load << ", zone average " << average << ").";
+
+		my_endpoint->SetAuthorityFactor(newFactor);
+	}
+}
+
+void ApiListener::AuthorityTimerHandler()
+{
+	UpdateLoadBalancing();
+	UpdateObjectAuthority();
+}
+
 void ApiListener::UpdateObjectAuthority()
 {
 	Zone::Ptr my_zone = Zone::GetLocalZone();
@@ -57,6 +185,13 @@ void ApiListener::UpdateObjectAuthority()
 		);
 	}
 
+	/* Rendezvous hashing: When an endpoint connects or disconnects only the
+	 * objects it gains or loses change their authority. */
+	RendezvousHash hash;
+
+	for (const Endpoint::Ptr& endpoint : endpoints)
+		hash.AddNode(endpoint->GetName(), endpoint->GetAuthorityWeight() * endpoint->GetAuthorityFactor());
+
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
 
@@ -72,7 +207,7 @@ void ApiListener::UpdateObjectAuthority()
 			if (!my_zone)
 				authority = true;
 			else
-				authority = endpoints[Utility::SDBM(object->GetName()) % endpoints.size()] == my_endpoint;
+				authority = !endpoints.empty() && endpoints[hash.GetNode(object->GetName())] == my_endpoint;
 
 			object->SetAuthority(authority);
 		}
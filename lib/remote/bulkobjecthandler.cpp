@@ -0,0 +1,267 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/bulkobjecthandler.hpp"
+#include "remote/configobjectutility.hpp"
+#include "remote/httputility.hpp"
+#include "remote/filterutility.hpp"
+#include "remote/zone.hpp"
+#include "base/configtype.hpp"
+#include "base/objectlock.hpp"
+#include <boost/algorithm/string/case_conv.hpp>
+
+using namespace icinga;
+
+REGISTER_URLHANDLER("/v1/objects/bulk", BulkObjectHandler);
+
+static ConfigObject::Ptr GetBulkTarget(const ApiUser::Ptr& user, const Type::Ptr& type, const String& name, const String& permission)
+{
+	QueryDescription qd;
+	qd.Types.insert(type->GetName());
+	qd.Permission = permission + "/" + type->GetName();
+
+	String attr = type->GetName();
+	boost::algorithm::to_lower(attr);
+
+	Dictionary::Ptr query = new Dictionary({
+		{ "type", type->GetName() },
+		{ attr, name }
+	});
+
+	std::vector<Value> objs = FilterUtility::GetFilterTargets(qd, query, user);
+
+	return objs.at(0);
+}
+
+/**
+ * Creates, modifies and deletes several objects with one request. All
+ * deletions are processed first, then all new objects are committed and
+ * activated together and finally the modifications are applied.
+ */
+bool BulkObjectHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
+{
+	if (request.RequestUrl->GetPath().size() != 3)
+		return false;
+
+	if (request.RequestMethod != "POST")
+		return false;
+
+	Value objectsVal = params->Get("objects");
+
+	if (objectsVal.GetReflectionType() != Array::TypeInstance) {
+		HttpUtility::SendJsonError(response, params, 400,
+			"Invalid type for 'objects' attribute specified. Array type is required.");
+		return true;
+	}
+
+	Array::Ptr objects = objectsVal;
+
+	bool verbose = HttpUtility::GetLastParameter(params, "verbose");
+
+	Zone::Ptr localZone = Zone::GetLocalZone();
+
+	std::vector<Dictionary::Ptr> results;
+	std::vector<Dictionary::Ptr> deletions, modifications;
+	std::vector<ConfigObjectCreation> creations;
+	std::vector<Dictionary::Ptr> creationResults;
+
+	{
+		ObjectLock olock(objects);
+
+		for (const Value& objectVal : objects) {
+			Dictionary::Ptr result = new Dictionary();
+			results.push_back(result);
+
+			if (!objectVal.IsObjectType<Dictionary>()) {
+				result->Set("code", 400);
+				result->Set("status", "Invalid object specification. Dictionary type is required.");
+				continue;
+			}
+
+			Dictionary::Ptr object = objectVal;
+
+			String action = object->Get("action");
+			String typeName = object->Get("type");
+			String name = object->Get("name");
+
+			result->Set("action", action);
+			result->Set("type", typeName);
+			result->Set("name", name);
+
+			Type::Ptr type = FilterUtility::TypeFromPluralName(typeName);
+
+			if (!type)
+				type = Type::GetByName(typeName);
+
+			if (!type || !dynamic_cast<ConfigType *>(type.get()) || name.IsEmpty()) {
+				result->Set("code", 400);
+				result->Set("status", "Invalid type or name specified.");
+				continue;
+			}
+
+			result->Set("type", type->GetName());
+			object->Set("type", type->GetName());
+
+			if (action == "delete")
+				deletions.push_back(object);
+			else if (action == "modify")
+				modifications.push_back(object);
+			else if (action == "create") {
+				try {
+					FilterUtility::CheckPermission(user, "objects/create/" + type->GetName());
+
+					Dictionary::Ptr attrs = object->Get("attrs");
+
+					if (!attrs)
+						attrs = new Dictionary();
+
+					/* Put created objects into the local zone if not explicitly defined,
+					 * just like CreateObjectHandler does. */
+					if (localZone && !attrs->Contains("zone"))
+						attrs->Set("zone", localZone->GetName());
+
+					if (attrs->Contains("groups")) {
+						Array::Ptr groups = attrs->Get("groups");
+
+						if (groups)
+							attrs->Set("groups", groups->Unique());
+					}
+
+					ConfigObjectCreation creation;
+					creation.ObjectType = type;
+					creation.Name = name;
+					creation.Config = ConfigObjectUtility::CreateObjectConfig(type, name,
+						object->Get("ignore_on_error"), object->Get("templates"), attrs);
+
+					creations.emplace_back(std::move(creation));
+					creationResults.push_back(result);
+				} catch (const std::exception& ex) {
+					result->Set("code", 500);
+					result->Set("status", "Object could not be created.");
+					result->Set("errors", new Array({ DiagnosticInformation(ex, false) }));
+
+					if (verbose)
+						result->Set("diagnostic_information", new Array({ DiagnosticInformation(ex) }));
+				}
+			} else {
+				result->Set("code", 400);
+				result->Set("status", "Invalid action specified. Must be one of 'create', 'modify' or 'delete'.");
+			}
+
+			object->Set("result", result);
+		}
+	}
+
+	for (const Dictionary::Ptr& object : deletions) {
+		Dictionary::Ptr result = object->Get("result");
+		Array::Ptr errors = new Array();
+		Array::Ptr diagnosticInformation = new Array();
+
+		try {
+			ConfigObject::Ptr obj = GetBulkTarget(user, Type::GetByName(object->Get("type")), object->Get("name"), "objects/delete");
+
+			if (ConfigObjectUtility::DeleteObject(obj, object->Get("cascade"), errors, diagnosticInformation)) {
+				result->Set("code", 200);
+				result->Set("status", "Object was deleted.");
+				continue;
+			}
+		} catch (const std::exception& ex) {
+			errors->Add(DiagnosticInformation(ex, false));
+			diagnosticInformation->Add(DiagnosticInformation(ex));
+		}
+
+		result->Set("code", 500);
+		result->Set("status", "Object could not be deleted.");
+		result->Set("errors", errors);
+
+		if (verbose)
+			result->Set("diagnostic_information", diagnosticInformation);
+	}
+
+	ConfigObjectUtility::CreateObjects(creations);
+
+	for (std::vector<ConfigObjectCreation>::size_type i = 0; i < creations.size(); i++) {
+		const ConfigObjectCreation& creation = creations[i];
+		const Dictionary::Ptr& result = creationResults[i];
+
+		if (creation.Created) {
+			result->Set("code", 200);
+			result->Set("status", "Object was created.");
+		} else {
+			result->Set("code", 500);
+			result->Set("status", "Object could not be created.");
+			result->Set("errors", creation.Errors);
+
+			if (verbose)
+				result->Set("diagnostic_information", creation.DiagnosticInformation);
+		}
+	}
+
+	for (const Dictionary::Ptr& object : modifications) {
+		Dictionary::Ptr result = object->Get("result");
+		String key;
+
+		try {
+			ConfigObject::Ptr obj = GetBulkTarget(user, Type::GetByName(object->Get("type")), object->Get("name"), "objects/modify");
+
+			Dictionary::Ptr attrs = object->Get("attrs");
+
+			if (attrs) {
+				ObjectLock olock(attrs);
+				for (const Dictionary::Pair& kv : attrs) {
+					key = kv.first;
+					obj->ModifyAttribute(kv.first, kv.second);
+				}
+			}
+
+			result->Set("code", 200);
+			result->Set("status", "Attributes updated.");
+		} catch (const std::exception& ex) {
+			result->Set("code", 500);
+			result->Set("status", key.IsEmpty() ? "Object could not be modified: " + DiagnosticInformation(ex, false)
+				: "Attribute '" + key + "' could not be set: " + DiagnosticInformation(ex, false));
+
+			if (verbose)
+				result->Set("diagnostic_information", DiagnosticInformation(ex));
+		}
+	}
+
+	bool success = true;
+	ArrayData resultsData;
+
+	for (const Dictionary::Ptr& result : results) {
+		if (result->Get("code") != 200)
+			success = false;
+
+		resultsData.push_back(result);
+	}
+
+	Dictionary::Ptr result = new Dictionary({
+		{ "results", new Array(std::move(resultsData)) }
+	});
+
+	if (!success)
+		response.SetStatus(500, "One or more objects could not be processed");
+	else
+		response.SetStatus(200, "OK");
+
+	HttpUtility::SendJsonBody(response, params, result);
+
+	return true;
+}
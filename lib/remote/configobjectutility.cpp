@@ -27,6 +27,8 @@
 #include "base/dependencygraph.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
 #include <fstream>
+#include <map>
+#include <set>
 
 using namespace icinga;
 
@@ -97,18 +99,31 @@ String ConfigObjectUtility::CreateObjectConfig(const Type::Ptr& type, const Stri
 	return config.str();
 }
 
-bool ConfigObjectUtility::CreateObject(const Type::Ptr& type, const String& fullName,
-	const String& config, const Array::Ptr& errors, const Array::Ptr& diagnosticInformation)
+void ConfigObjectUtility::EnsurePackage()
 {
-	{
-		boost::mutex::scoped_lock lock(ConfigPackageUtility::GetStaticMutex());
-		if (!ConfigPackageUtility::PackageExists("_api")) {
-			ConfigPackageUtility::CreatePackage("_api");
+	boost::mutex::scoped_lock lock(ConfigPackageUtility::GetStaticMutex());
+	if (!ConfigPackageUtility::PackageExists("_api")) {
+		ConfigPackageUtility::CreatePackage("_api");
 
-			String stage = ConfigPackageUtility::CreateStage("_api");
-			ConfigPackageUtility::ActivateStage("_api", stage);
-		}
+		String stage = ConfigPackageUtility::CreateStage("_api");
+		ConfigPackageUtility::ActivateStage("_api", stage);
 	}
+}
+
+void ConfigObjectUtility::RemoveObjectConfig(const String& path)
+{
+	if (unlink(path.CStr()) < 0 && errno != ENOENT) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("unlink")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(path));
+	}
+}
+
+bool ConfigObjectUtility::CreateObject(const Type::Ptr& type, const String& fullName,
+	const String& config, const Array::Ptr& errors, const Array::Ptr& diagnosticInformation)
+{
+	EnsurePackage();
 
 	ConfigItem::Ptr item = ConfigItem::GetByTypeAndName(type, fullName);
 
@@ -184,6 +199,157 @@ bool ConfigObjectUtility::CreateObject(const Type::Ptr& type, const String& full
 	return true;
 }
 
+/**
+ * Returns the config file of the object which caused an error while
+ * committing objects.
+ */
+static String GetErrorPath(const boost::exception_ptr& eptr)
+{
+	try {
+		boost::rethrow_exception(eptr);
+	} catch (const ValidationError& ex) {
+		ConfigObject::Ptr object = ex.GetObject();
+
+		if (object)
+			return object->GetDebugInfo().Path;
+	} catch (const ScriptError& ex) {
+		return ex.GetDebugInfo().Path;
+	} catch (...) {
+	}
+
+	return String();
+}
+
+/**
+ * Creates several objects with a single commit and activation pass, i.e.
+ * apply rules and dependencies are only evaluated once for all of them.
+ * Each object is still written into its own config file so that it can be
+ * modified and deleted on its own.
+ *
+ * Objects which fail validation are reported in their Errors and the
+ * others are committed again without them. If an error can't be attributed
+ * to one of the objects (e.g. one which is raised by an apply rule), none
+ * of the remaining objects are created.
+ */
+void ConfigObjectUtility::CreateObjects(std::vector<ConfigObjectCreation>& objects)
+{
+	EnsurePackage();
+
+	std::map<String, ConfigObjectCreation *> paths;
+	std::vector<ConfigObjectCreation *> pending;
+
+	for (ConfigObjectCreation& object : objects) {
+		if (ConfigItem::GetByTypeAndName(object.ObjectType, object.Name)) {
+			object.Errors->Add("Object '" + object.Name + "' already exists.");
+			continue;
+		}
+
+		String path = GetObjectConfigPath(object.ObjectType, object.Name);
+
+		if (paths.find(path) != paths.end()) {
+			object.Errors->Add("Object '" + object.Name + "' is specified more than once.");
+			continue;
+		}
+
+		Utility::MkDirP(Utility::DirName(path), 0700);
+
+		if (Utility::PathExists(path)) {
+			object.Errors->Add("Cannot create object '" + object.Name + "'. Configuration file '" + path + "' already exists.");
+			continue;
+		}
+
+		std::ofstream fp(path.CStr(), std::ofstream::out | std::ostream::trunc);
+		fp << object.Config;
+		fp.close();
+
+		paths[path] = &object;
+		pending.push_back(&object);
+	}
+
+	while (!pending.empty()) {
+		ActivationScope ascope;
+		std::vector<ConfigObjectCreation *> evaluated;
+
+		for (ConfigObjectCreation *object : pending) {
+			String path = GetObjectConfigPath(object->ObjectType, object->Name);
+
+			try {
+				std::unique_ptr<Expression> expr = ConfigCompiler::CompileFile(path, String(), "_api");
+
+				ScriptFrame frame(true);
+				expr->Evaluate(frame);
+
+				evaluated.push_back(object);
+			} catch (const std::exception& ex) {
+				RemoveObjectConfig(path);
+
+				object->Errors->Add(DiagnosticInformation(ex, false));
+				object->DiagnosticInformation->Add(DiagnosticInformation(ex));
+			}
+		}
+
+		pending.clear();
+
+		WorkQueue upq;
+		upq.SetName("ConfigObjectUtility::CreateObjects");
+
+		std::vector<ConfigItem::Ptr> newItems;
+
+		bool committed = ConfigItem::CommitItems(ascope.GetContext(), upq, newItems);
+
+		if (committed && ConfigItem::ActivateItems(upq, newItems, true)) {
+			for (ConfigObjectCreation *object : evaluated)
+				object->Created = true;
+
+			if (!evaluated.empty())
+				ApiListener::UpdateObjectAuthority();
+
+			break;
+		}
+
+		std::set<ConfigObjectCreation *> failed;
+		std::vector<boost::exception_ptr> unattributed;
+
+		for (const boost::exception_ptr& ex : upq.GetExceptions()) {
+			auto it = paths.find(GetErrorPath(ex));
+
+			if (it == paths.end()) {
+				unattributed.push_back(ex);
+				continue;
+			}
+
+			it->second->Errors->Add(DiagnosticInformation(ex, false));
+			it->second->DiagnosticInformation->Add(DiagnosticInformation(ex));
+			failed.insert(it->second);
+		}
+
+		/* Failed commits are rolled back, so the other objects can be committed again. */
+		bool retry = !committed && !failed.empty() && unattributed.empty();
+
+		for (ConfigObjectCreation *object : evaluated) {
+			bool objectFailed = failed.find(object) != failed.end();
+
+			if (retry && !objectFailed) {
+				pending.push_back(object);
+				continue;
+			}
+
+			RemoveObjectConfig(GetObjectConfigPath(object->ObjectType, object->Name));
+
+			if (objectFailed)
+				continue;
+
+			if (unattributed.empty())
+				object->Errors->Add("Object '" + object->Name + "' could not be created because other objects failed.");
+
+			for (const boost::exception_ptr& ex : unattributed) {
+				object->Errors->Add(DiagnosticInformation(ex, false));
+				object->DiagnosticInformation->Add(DiagnosticInformation(ex));
+			}
+		}
+	}
+}
+
 bool ConfigObjectUtility::DeleteObjectHelper(const ConfigObject::Ptr& object, bool cascade,
 	const Array::Ptr& errors, const Array::Ptr& diagnosticInformation)
 {
@@ -25,10 +25,26 @@
 #include "base/configobject.hpp"
 #include "base/dictionary.hpp"
 #include "base/type.hpp"
+#include <vector>
 
 namespace icinga
 {
 
+/**
+ * An object which is created by ConfigObjectUtility::CreateObjects().
+ *
+ * @ingroup remote
+ */
+struct ConfigObjectCreation
+{
+	Type::Ptr ObjectType;
+	String Name;
+	String Config;
+	Array::Ptr Errors{new Array()};
+	Array::Ptr DiagnosticInformation{new Array()};
+	bool Created{false};
+};
+
 /**
  * Helper functions.
  *
@@ -47,11 +63,15 @@ public:
 	static bool CreateObject(const Type::Ptr& type, const String& fullName,
 		const String& config, const Array::Ptr& errors, const Array::Ptr& diagnosticInformation);
 
+	static void CreateObjects(std::vector<ConfigObjectCreation>& objects);
+
 	static bool DeleteObject(const ConfigObject::Ptr& object, bool cascade, const Array::Ptr& errors,
 		const Array::Ptr& diagnosticInformation);
 
 private:
 	static String EscapeName(const String& name);
+	static void EnsurePackage();
+	static void RemoveObjectConfig(const String& path);
 	static bool DeleteObjectHelper(const ConfigObject::Ptr& object, bool cascade, const Array::Ptr& errors,
 		const Array::Ptr& diagnosticInformation);
 };
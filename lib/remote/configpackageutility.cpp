@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "remote/configpackageutility.hpp"
+#include "config/configcompiler.hpp"
 #include "base/application.hpp"
 #include "base/exception.hpp"
 #include "base/utility.hpp"
@@ -25,6 +26,7 @@
 #include <boost/regex.hpp>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
 
 using namespace icinga;
 
@@ -210,10 +212,60 @@ void ConfigPackageUtility::TryActivateStageCallback(const ProcessResult& pr, con
 	}
 }
 
-void ConfigPackageUtility::AsyncTryActivateStage(const String& packageName, const String& stageName, bool reload)
+/**
+ * Parses all configuration files of a stage in-process. This doesn't evaluate
+ * anything, i.e. there are no side effects on the running objects, but it
+ * catches syntax errors without spawning a validation process which has to
+ * load the complete configuration.
+ *
+ * @param packageName The package name.
+ * @param stageName The stage name.
+ * @param output Receives the error messages.
+ * @returns true if all files could be parsed, false otherwise.
+ */
+bool ConfigPackageUtility::ValidateStageSyntax(const String& packageName, const String& stageName, String& output)
+{
+	std::ostringstream msgbuf;
+	int errors = 0;
+
+	for (const std::pair<String, bool>& kv : GetFiles(packageName, stageName)) {
+		if (kv.second || !Utility::Match("*.conf", kv.first))
+			continue;
+
+		try {
+			std::unique_ptr<Expression> expression = ConfigCompiler::CompileFile(kv.first, String(), packageName);
+		} catch (const std::exception& ex) {
+			msgbuf << "critical/config: " << DiagnosticInformation(ex, false) << "\n";
+			errors++;
+		}
+	}
+
+	if (errors > 0)
+		msgbuf << "critical/config: " << errors << (errors > 1 ? " errors" : " error") << "\n";
+
+	output = msgbuf.str();
+
+	return errors == 0;
+}
+
+void ConfigPackageUtility::TryActivateStage(const String& packageName, const String& stageName, bool reload)
 {
 	VERIFY(Application::GetArgC() >= 1);
 
+	/* Don't spawn a full validation for stages which can't even be parsed. */
+	String output;
+
+	if (!ValidateStageSyntax(packageName, stageName, output)) {
+		ProcessResult pr;
+		pr.PID = -1;
+		pr.ExecutionStart = pr.ExecutionEnd = Utility::GetTime();
+		pr.ExitStatus = 1;
+		pr.Output = output;
+
+		TryActivateStageCallback(pr, packageName, stageName, reload);
+		return;
+	}
+
 	// prepare arguments
 	Array::Ptr args = new Array({
 		Application::GetExePath(Application::GetArgV()[0]),
@@ -228,6 +280,11 @@ void ConfigPackageUtility::AsyncTryActivateStage(const String& packageName, cons
 	process->Run(std::bind(&TryActivateStageCallback, _1, packageName, stageName, reload));
 }
 
+void ConfigPackageUtility::AsyncTryActivateStage(const String& packageName, const String& stageName, bool reload)
+{
+	Utility::QueueAsyncCallback(std::bind(&ConfigPackageUtility::TryActivateStage, packageName, stageName, reload));
+}
+
 void ConfigPackageUtility::DeleteStage(const String& packageName, const String& stageName)
 {
 	String path = GetPackageDir() + "/" + packageName + "/" + stageName;
@@ -52,6 +52,7 @@ public:
 	static String GetActiveStage(const String& packageName);
 	static void ActivateStage(const String& packageName, const String& stageName);
 	static void AsyncTryActivateStage(const String& packageName, const String& stageName, bool reload);
+	static bool ValidateStageSyntax(const String& packageName, const String& stageName, String& output);
 
 	static std::vector<std::pair<String, bool> > GetFiles(const String& packageName, const String& stageName);
 
@@ -67,6 +68,7 @@ private:
 	static void WritePackageConfig(const String& packageName);
 	static void WriteStageConfig(const String& packageName, const String& stageName);
 
+	static void TryActivateStage(const String& packageName, const String& stageName, bool reload);
 	static void TryActivateStageCallback(const ProcessResult& pr, const String& packageName, const String& stageName, bool reload);
 };
 
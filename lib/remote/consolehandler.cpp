@@ -62,7 +62,7 @@ static void EnsureFrameCleanupTimer()
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, []() {
-		l_FrameCleanupTimer = new Timer();
+		l_FrameCleanupTimer = new Timer("ConsoleHandler frame cleanup");
 		l_FrameCleanupTimer->OnTimerExpired.connect(std::bind(ScriptFrameCleanupHandler));
 		l_FrameCleanupTimer->SetInterval(30);
 		l_FrameCleanupTimer->Start();
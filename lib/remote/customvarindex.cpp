@@ -0,0 +1,223 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/customvarindex.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/objectlock.hpp"
+#include "base/array.hpp"
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <map>
+
+using namespace icinga;
+
+struct CustomVarPathIndex
+{
+	/* Objects by the value of the variable... */
+	std::map<String, std::set<ConfigObject::Ptr> > Values;
+	/* ...and by the items of the variable if it is an array. */
+	std::map<String, std::set<ConfigObject::Ptr> > Items;
+};
+
+struct CustomVarIndexKey
+{
+	size_t Path;
+	bool Item;
+	String Value;
+};
+
+static boost::mutex l_CustomVarIndexMutex;
+static bool l_CustomVarIndexLoaded = false;
+static std::vector<std::vector<String> > l_CustomVarIndexPaths;
+static std::vector<CustomVarPathIndex> l_CustomVarIndexes;
+static std::map<ConfigObject::Ptr, std::vector<CustomVarIndexKey> > l_CustomVarIndexKeys;
+
+/* Must be called with l_CustomVarIndexMutex held. */
+static void LoadCustomVarIndexPaths()
+{
+	if (l_CustomVarIndexLoaded)
+		return;
+
+	l_CustomVarIndexLoaded = true;
+
+	Value paths = ScriptGlobal::Get("CustomVarIndexes", &Empty);
+
+	if (!paths.IsObjectType<Array>())
+		return;
+
+	Array::Ptr arr = paths;
+
+	ObjectLock olock(arr);
+	for (const Value& path : arr) {
+		if (!path.IsString() || static_cast<String>(path).IsEmpty())
+			continue;
+
+		l_CustomVarIndexPaths.emplace_back(static_cast<String>(path).Split("."));
+	}
+
+	l_CustomVarIndexes.resize(l_CustomVarIndexPaths.size());
+}
+
+static bool GetCustomVar(const Dictionary::Ptr& vars, const std::vector<String>& path, Value *value)
+{
+	Dictionary::Ptr dict = vars;
+
+	for (std::vector<String>::size_type i = 0; i < path.size(); i++) {
+		if (!dict)
+			return false;
+
+		Value current;
+
+		if (!dict->Get(path[i], &current))
+			return false;
+
+		if (i == path.size() - 1) {
+			*value = current;
+			return true;
+		}
+
+		if (!current.IsObjectType<Dictionary>())
+			return false;
+
+		dict = current;
+	}
+
+	return false;
+}
+
+static void RemoveCustomVarIndexKeys(const ConfigObject::Ptr& object)
+{
+	auto it = l_CustomVarIndexKeys.find(object);
+
+	if (it == l_CustomVarIndexKeys.end())
+		return;
+
+	for (const CustomVarIndexKey& key : it->second) {
+		auto& values = key.Item ? l_CustomVarIndexes[key.Path].Items : l_CustomVarIndexes[key.Path].Values;
+		auto vit = values.find(key.Value);
+
+		if (vit == values.end())
+			continue;
+
+		vit->second.erase(object);
+
+		if (vit->second.empty())
+			values.erase(vit);
+	}
+
+	l_CustomVarIndexKeys.erase(it);
+}
+
+/**
+ * Updates the index entries for an object after its custom variables
+ * have changed.
+ *
+ * @param object The object.
+ * @param vars The object's custom variables.
+ */
+void CustomVarIndex::UpdateObject(const ConfigObject::Ptr& object, const Dictionary::Ptr& vars)
+{
+	boost::mutex::scoped_lock lock(l_CustomVarIndexMutex);
+
+	LoadCustomVarIndexPaths();
+
+	if (l_CustomVarIndexPaths.empty())
+		return;
+
+	RemoveCustomVarIndexKeys(object);
+
+	if (!vars)
+		return;
+
+	std::vector<CustomVarIndexKey> keys;
+
+	for (std::vector<std::vector<String> >::size_type i = 0; i < l_CustomVarIndexPaths.size(); i++) {
+		Value value;
+
+		if (!GetCustomVar(vars, l_CustomVarIndexPaths[i], &value))
+			continue;
+
+		/* Filters only compare strings with strings, see GetFilterPredicates(). */
+		if (value.IsString())
+			keys.push_back({ i, false, static_cast<String>(value) });
+		else if (value.IsObjectType<Array>()) {
+			Array::Ptr arr = value;
+
+			ObjectLock olock(arr);
+			for (const Value& item : arr) {
+				if (item.IsString())
+					keys.push_back({ i, true, static_cast<String>(item) });
+			}
+		}
+	}
+
+	for (const CustomVarIndexKey& key : keys) {
+		if (key.Item)
+			l_CustomVarIndexes[key.Path].Items[key.Value].insert(object);
+		else
+			l_CustomVarIndexes[key.Path].Values[key.Value].insert(object);
+	}
+
+	if (!keys.empty())
+		l_CustomVarIndexKeys[object] = std::move(keys);
+}
+
+void CustomVarIndex::RemoveObject(const ConfigObject::Ptr& object)
+{
+	boost::mutex::scoped_lock lock(l_CustomVarIndexMutex);
+
+	RemoveCustomVarIndexKeys(object);
+}
+
+/**
+ * Finds the active objects of a type whose custom variable at the specified
+ * path is one of the values or, if membership is set, an array which
+ * contains one of the values.
+ *
+ * @returns false if there is no index for the path.
+ */
+bool CustomVarIndex::GetObjects(const Type::Ptr& type, const std::vector<String>& path, bool membership,
+	const std::set<String>& values, std::set<ConfigObject::Ptr>& result)
+{
+	boost::mutex::scoped_lock lock(l_CustomVarIndexMutex);
+
+	LoadCustomVarIndexPaths();
+
+	auto it = std::find(l_CustomVarIndexPaths.begin(), l_CustomVarIndexPaths.end(), path);
+
+	if (it == l_CustomVarIndexPaths.end())
+		return false;
+
+	const CustomVarPathIndex& index = l_CustomVarIndexes[it - l_CustomVarIndexPaths.begin()];
+	const auto& objects = membership ? index.Items : index.Values;
+
+	for (const String& value : values) {
+		auto vit = objects.find(value);
+
+		if (vit == objects.end())
+			continue;
+
+		for (const ConfigObject::Ptr& object : vit->second) {
+			if (type->IsAssignableFrom(object->GetReflectionType()))
+				result.insert(object);
+		}
+	}
+
+	return true;
+}
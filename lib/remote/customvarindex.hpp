@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CUSTOMVARINDEX_H
+#define CUSTOMVARINDEX_H
+
+#include "remote/i2-remote.hpp"
+#include "base/configobject.hpp"
+#include "base/dictionary.hpp"
+#include <set>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Inverted indexes for the custom variables which are listed in the
+ * CustomVarIndexes constant, mapping their values to the active objects
+ * which have them.
+ *
+ * @ingroup remote
+ */
+class CustomVarIndex
+{
+public:
+	static void UpdateObject(const ConfigObject::Ptr& object, const Dictionary::Ptr& vars);
+	static void RemoveObject(const ConfigObject::Ptr& object);
+
+	static bool GetObjects(const Type::Ptr& type, const std::vector<String>& path, bool membership,
+		const std::set<String>& values, std::set<ConfigObject::Ptr>& result);
+
+private:
+	CustomVarIndex();
+};
+
+}
+
+#endif /* CUSTOMVARINDEX_H */
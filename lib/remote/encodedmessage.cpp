@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+#include "remote/encodedmessage.hpp"
+
+using namespace icinga;
+
+EncodedMessage::EncodedMessage(Dictionary::Ptr message)
+	: m_Message(std::move(message))
+{ }
+
+Dictionary::Ptr EncodedMessage::GetMessage() const
+{
+	return m_Message;
+}
+
+/**
+ * Returns the encoded message. It's encoded when it's needed for the first time.
+ *
+ * @param encoding The encoding.
+ * @returns The encoded message without the netstring framing. It remains
+ *          valid as long as the EncodedMessage exists.
+ */
+const String& EncodedMessage::GetEncoded(JsonRpcEncoding encoding)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	String& encoded = (encoding == JsonRpcEncodingMsgPack) ? m_MsgPack : m_Json;
+
+	/* Encoded messages are never empty. */
+	if (encoded.IsEmpty())
+		encoded = JsonRpc::EncodeMessage(m_Message, encoding);
+
+	return encoded;
+}
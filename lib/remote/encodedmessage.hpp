@@ -0,0 +1,58 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+#ifndef ENCODEDMESSAGE_H
+#define ENCODEDMESSAGE_H
+
+#include "remote/i2-remote.hpp"
+#include "remote/jsonrpc.hpp"
+#include "base/dictionary.hpp"
+#include <boost/thread/mutex.hpp>
+
+namespace icinga
+{
+
+/**
+ * A message which is sent to several connections, e.g. a JSON-RPC message
+ * or an API event. The message is encoded only once for each encoding, no
+ * matter how many connections it is sent to. The message must not be
+ * modified once it was wrapped.
+ *
+ * @ingroup remote
+ */
+class EncodedMessage final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(EncodedMessage);
+
+	EncodedMessage(Dictionary::Ptr message);
+
+	Dictionary::Ptr GetMessage() const;
+	const String& GetEncoded(JsonRpcEncoding encoding);
+
+private:
+	Dictionary::Ptr m_Message;
+
+	boost::mutex m_Mutex;
+	String m_Json;
+	String m_MsgPack;
+};
+
+}
+
+#endif /* ENCODEDMESSAGE_H */
@@ -120,36 +120,248 @@ Endpoint::Ptr Endpoint::GetLocalEndpoint()
 
 void Endpoint::AddMessageSent(int bytes)
 {
-	double time = Utility::GetTime();
+	double time = Utility::GetCoarseTime();
 	m_MessagesSent.InsertValue(time, 1);
 	m_BytesSent.InsertValue(time, bytes);
+	m_MessagesSentTotal++;
+	m_BytesSentTotal += bytes;
 	SetLastMessageSent(time);
 }
 
 void Endpoint::AddMessageReceived(int bytes)
 {
-	double time = Utility::GetTime();
+	double time = Utility::GetCoarseTime();
 	m_MessagesReceived.InsertValue(time, 1);
 	m_BytesReceived.InsertValue(time, bytes);
+	m_MessagesReceivedTotal++;
+	m_BytesReceivedTotal += bytes;
 	SetLastMessageReceived(time);
 }
 
+/**
+ * Records that the buffered messages for one of the endpoint's
+ * connections were written to the stream.
+ *
+ * @param bytes The number of bytes which were written. The TLS stream
+ *              splits them into records of up to 16 KB.
+ * @param queueWait How long the oldest message was buffered.
+ */
+void Endpoint::AddFlush(size_t bytes, double queueWait)
+{
+	m_Flushes.InsertValue(Utility::GetCoarseTime(), 1);
+
+	/* The histogram has a resolution of one microsecond: sizes are recorded in megabytes so that it is one byte. */
+	m_WriteSize.Record(bytes / 1000000.0);
+	m_SendQueueWait.Record(queueWait);
+}
+
+/**
+ * Records the time between sending a heartbeat to the endpoint and receiving its answer.
+ */
+void Endpoint::AddRoundTripTime(double rtt)
+{
+	m_RoundTripTime.Record(rtt);
+}
+
+/**
+ * Records how long it took to process a message from the endpoint.
+ */
+void Endpoint::AddMessageProcessed(const String& method, double duration)
+{
+	m_ProcessingTime.Record(duration);
+
+	boost::mutex::scoped_lock lock(m_MethodStatsMutex);
+
+	std::unique_ptr<Histogram>& histogram = m_MethodProcessingTime[method];
+
+	if (!histogram)
+		histogram.reset(new Histogram());
+
+	histogram->Record(duration);
+}
+
+void Endpoint::AddCompressedMessage(size_t inputBytes, size_t outputBytes, double duration)
+{
+	boost::mutex::scoped_lock lock(m_CompressionStatsMutex);
+	m_CompressionInput += inputBytes;
+	m_CompressionOutput += outputBytes;
+	m_CompressionTime += duration;
+}
+
+void Endpoint::AddDecompressedMessage(size_t inputBytes, size_t outputBytes, double duration)
+{
+	boost::mutex::scoped_lock lock(m_CompressionStatsMutex);
+	m_DecompressionInput += inputBytes;
+	m_DecompressionOutput += outputBytes;
+	m_DecompressionTime += duration;
+}
+
+/**
+ * Returns the amount of data which was compressed and decompressed for this
+ * endpoint's connections since the application was started, the resulting
+ * compression ratios and the time spent.
+ */
+Dictionary::Ptr Endpoint::GetCompressionStats() const
+{
+	boost::mutex::scoped_lock lock(m_CompressionStatsMutex);
+
+	return new Dictionary({
+		{ "bytes_sent_uncompressed", m_CompressionInput },
+		{ "bytes_sent_compressed", m_CompressionOutput },
+		{ "compression_ratio", m_CompressionOutput > 0 ? m_CompressionInput / m_CompressionOutput : 0 },
+		{ "compression_time", m_CompressionTime },
+		{ "bytes_received_compressed", m_DecompressionInput },
+		{ "bytes_received_uncompressed", m_DecompressionOutput },
+		{ "decompression_ratio", m_DecompressionInput > 0 ? m_DecompressionOutput / m_DecompressionInput : 0 },
+		{ "decompression_time", m_DecompressionTime }
+	});
+}
+
+static Dictionary::Ptr GetHistogramStats(const Histogram& histogram, double scale = 1)
+{
+	return new Dictionary({
+		{ "count", histogram.GetCount() },
+		{ "min", histogram.GetMin() * scale },
+		{ "max", histogram.GetMax() * scale },
+		{ "avg", histogram.GetAverage() * scale },
+		{ "p50", histogram.GetPercentile(50) * scale },
+		{ "p95", histogram.GetPercentile(95) * scale },
+		{ "p99", histogram.GetPercentile(99) * scale }
+	});
+}
+
+/**
+ * Returns the totals of the messages and bytes which were exchanged with the
+ * endpoint and histograms for the heartbeat round-trip time, the message
+ * processing time (in total and per method), the time messages spent in
+ * the send buffer and the size of the writes to the TLS stream.
+ */
+Dictionary::Ptr Endpoint::GetTelemetry() const
+{
+	Dictionary::Ptr methods = new Dictionary();
+
+	{
+		boost::mutex::scoped_lock lock(m_MethodStatsMutex);
+
+		for (const auto& kv : m_MethodProcessingTime)
+			methods->Set(kv.first, GetHistogramStats(*kv.second));
+	}
+
+	ArrayData tlsOffload;
+
+	for (const JsonRpcConnection::Ptr& client : GetClients()) {
+		TlsStream::Ptr stream = client->GetStream();
+
+		tlsOffload.emplace_back(new Dictionary({
+			{ "kernel_send", stream->IsKernelSendOffloaded() },
+			{ "kernel_receive", stream->IsKernelReceiveOffloaded() }
+		}));
+	}
+
+	return new Dictionary({
+		{ "messages_sent", m_MessagesSentTotal.load() },
+		{ "messages_received", m_MessagesReceivedTotal.load() },
+		{ "bytes_sent", m_BytesSentTotal.load() },
+		{ "bytes_received", m_BytesReceivedTotal.load() },
+		{ "round_trip_time", GetHistogramStats(m_RoundTripTime) },
+		{ "processing_time", GetHistogramStats(m_ProcessingTime) },
+		{ "method_processing_time", methods },
+		{ "send_queue_wait", GetHistogramStats(m_SendQueueWait) },
+		{ "write_size", GetHistogramStats(m_WriteSize, 1000000) },
+		{ "tls_offload", new Array(std::move(tlsOffload)) }
+	});
+}
+
 double Endpoint::GetMessagesSentPerSecond() const
 {
-	return m_MessagesSent.CalculateRate(Utility::GetTime(), 60);
+	return m_MessagesSent.CalculateRate(Utility::GetCoarseTime(), 60);
 }
 
 double Endpoint::GetMessagesReceivedPerSecond() const
 {
-	return m_MessagesReceived.CalculateRate(Utility::GetTime(), 60);
+	return m_MessagesReceived.CalculateRate(Utility::GetCoarseTime(), 60);
 }
 
 double Endpoint::GetBytesSentPerSecond() const
 {
-	return m_BytesSent.CalculateRate(Utility::GetTime(), 60);
+	return m_BytesSent.CalculateRate(Utility::GetCoarseTime(), 60);
 }
 
 double Endpoint::GetBytesReceivedPerSecond() const
 {
-	return m_BytesReceived.CalculateRate(Utility::GetTime(), 60);
+	return m_BytesReceived.CalculateRate(Utility::GetCoarseTime(), 60);
+}
+
+double Endpoint::GetFlushesPerSecond() const
+{
+	return m_Flushes.CalculateRate(Utility::GetCoarseTime(), 60);
+}
+
+double Endpoint::GetMessagesPerFlush() const
+{
+	double flushes = GetFlushesPerSecond();
+
+	if (flushes == 0)
+		return 0;
+
+	return GetMessagesSentPerSecond() / flushes;
+}
+
+double Endpoint::GetBytesPerFlush() const
+{
+	double flushes = GetFlushesPerSecond();
+
+	if (flushes == 0)
+		return 0;
+
+	return GetBytesSentPerSecond() / flushes;
+}
+
+double Endpoint::GetSendQueueBytes() const
+{
+	boost::mutex::scoped_lock lock(m_ClientsLock);
+
+	double bytes = 0;
+
+	for (const JsonRpcConnection::Ptr& client : m_Clients)
+		bytes += client->GetSendQueueBytes();
+
+	return bytes;
+}
+
+double Endpoint::GetSendQueueMessages() const
+{
+	boost::mutex::scoped_lock lock(m_ClientsLock);
+
+	double messages = 0;
+
+	for (const JsonRpcConnection::Ptr& client : m_Clients)
+		messages += client->GetSendQueueMessages();
+
+	return messages;
+}
+
+/**
+ * Checks whether one of the endpoint's connections exceeded the send queue
+ * limit. Messages for the endpoint are written to the replay log instead
+ * until the queue has drained.
+ */
+bool Endpoint::GetSendQueueSpilled() const
+{
+	boost::mutex::scoped_lock lock(m_ClientsLock);
+
+	for (const JsonRpcConnection::Ptr& client : m_Clients) {
+		if (client->IsSendQueueSpilled())
+			return true;
+	}
+
+	return false;
+}
+
+void Endpoint::ValidateAuthorityWeight(const Lazy<double>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<Endpoint>::ValidateAuthorityWeight(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "authority_weight" }, "Value must be greater than 0."));
 }
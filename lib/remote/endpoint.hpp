@@ -23,6 +23,11 @@
 #include "remote/i2-remote.hpp"
 #include "remote/endpoint-ti.hpp"
 #include "base/ringbuffer.hpp"
+#include "base/histogram.hpp"
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <set>
 
 namespace icinga
@@ -59,6 +64,11 @@ public:
 
 	void AddMessageSent(int bytes);
 	void AddMessageReceived(int bytes);
+	void AddFlush(size_t bytes, double queueWait);
+	void AddRoundTripTime(double rtt);
+	void AddMessageProcessed(const String& method, double duration);
+	void AddCompressedMessage(size_t inputBytes, size_t outputBytes, double duration);
+	void AddDecompressedMessage(size_t inputBytes, size_t outputBytes, double duration);
 
 	double GetMessagesSentPerSecond() const override;
 	double GetMessagesReceivedPerSecond() const override;
@@ -66,6 +76,19 @@ public:
 	double GetBytesSentPerSecond() const override;
 	double GetBytesReceivedPerSecond() const override;
 
+	double GetFlushesPerSecond() const override;
+	double GetMessagesPerFlush() const override;
+	double GetBytesPerFlush() const override;
+
+	double GetSendQueueBytes() const override;
+	double GetSendQueueMessages() const override;
+	bool GetSendQueueSpilled() const override;
+
+	Dictionary::Ptr GetCompressionStats() const;
+	Dictionary::Ptr GetTelemetry() const override;
+
+	void ValidateAuthorityWeight(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void OnAllConfigLoaded() override;
 
@@ -78,6 +101,28 @@ private:
 	mutable RingBuffer m_MessagesReceived{60};
 	mutable RingBuffer m_BytesSent{60};
 	mutable RingBuffer m_BytesReceived{60};
+	mutable RingBuffer m_Flushes{60};
+
+	std::atomic<uint_fast64_t> m_MessagesSentTotal{0};
+	std::atomic<uint_fast64_t> m_MessagesReceivedTotal{0};
+	std::atomic<uint_fast64_t> m_BytesSentTotal{0};
+	std::atomic<uint_fast64_t> m_BytesReceivedTotal{0};
+
+	Histogram m_RoundTripTime;
+	Histogram m_ProcessingTime;
+	Histogram m_SendQueueWait;
+	Histogram m_WriteSize;
+
+	mutable boost::mutex m_MethodStatsMutex;
+	std::map<String, std::unique_ptr<Histogram> > m_MethodProcessingTime;
+
+	mutable boost::mutex m_CompressionStatsMutex;
+	double m_CompressionInput{0};
+	double m_CompressionOutput{0};
+	double m_CompressionTime{0};
+	double m_DecompressionInput{0};
+	double m_DecompressionOutput{0};
+	double m_DecompressionTime{0};
 };
 
 }
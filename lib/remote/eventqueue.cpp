@@ -21,11 +21,33 @@
 #include "remote/filterutility.hpp"
 #include "base/singleton.hpp"
 #include "base/logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+/* Maximum number of events which are buffered for slow clients unless configured otherwise. */
+#define EVENTQUEUE_DEFAULT_BUFFER_SIZE 10000
 
 using namespace icinga;
 
+namespace
+{
+
+/* The registered queues which might accept events of a type, split up by their host condition. */
+struct EventQueueTypeIndex
+{
+	std::vector<EventQueue::Ptr> AnyHost;
+	std::map<String, std::vector<EventQueue::Ptr> > ByHost;
+};
+
+}
+
+static boost::mutex l_IndexMutex;
+static std::map<String, EventQueueTypeIndex> l_Index;
+static std::atomic<bool> l_IndexDirty(true);
+
 EventQueue::EventQueue(String name)
-	: m_Name(std::move(name))
+	: m_Name(std::move(name)), m_BufferSize(EVENTQUEUE_DEFAULT_BUFFER_SIZE)
 { }
 
 bool EventQueue::CanProcessEvent(const String& type) const
@@ -35,13 +57,27 @@ bool EventQueue::CanProcessEvent(const String& type) const
 	return m_Types.find(type) != m_Types.end();
 }
 
-void EventQueue::ProcessEvent(const Dictionary::Ptr& event)
+/**
+ * Adds an event to the queue unless it's rejected by the queue's filter.
+ * The event is shared with all other queues and should be encoded by the
+ * clients through the EncodedMessage, so that it's encoded only once.
+ *
+ * @param event The event.
+ */
+void EventQueue::ProcessEvent(const EncodedMessage::Ptr& event)
 {
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Clients.empty() || !MatchPredicates(event->GetMessage()))
+			return;
+	}
+
 	ScriptFrame frame(true);
 	frame.Sandboxed = true;
 
 	try {
-		if (!FilterUtility::EvaluateFilter(frame, m_Filter.get(), event, "event"))
+		if (!FilterUtility::EvaluateFilter(frame, m_Filter.get(), event->GetMessage(), "event"))
 			return;
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "EventQueue")
@@ -51,19 +87,55 @@ void EventQueue::ProcessEvent(const Dictionary::Ptr& event)
 
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	typedef std::pair<void *const, std::deque<Dictionary::Ptr> > kv_pair;
-	for (kv_pair& kv : m_Events) {
-		kv.second.push_back(event);
-	}
+	if (m_Clients.empty())
+		return;
+
+	m_Events.push_back(event);
+
+	TrimEvents();
 
 	m_CV.notify_all();
 }
 
-void EventQueue::AddClient(void *client)
+/**
+ * Checks the event against the conditions which were extracted from the
+ * queue's filter. Events of which the attributes aren't strings are left
+ * to the filter.
+ *
+ * The caller must hold m_Mutex.
+ */
+bool EventQueue::MatchPredicates(const Dictionary::Ptr& event) const
+{
+	for (const auto& kv : m_Predicates) {
+		Value value = event->Get(kv.first);
+
+		if ((value.IsEmpty() || value.IsString()) && kv.second.find(static_cast<String>(value)) == kv.second.end())
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Checks whether the queue's filter allows the specified value for an attribute.
+ *
+ * The caller must hold m_Mutex.
+ */
+bool EventQueue::MatchPredicate(const String& attr, const String& value) const
+{
+	auto it = m_Predicates.find(attr);
+
+	return it == m_Predicates.end() || it->second.find(value) != it->second.end();
+}
+
+void EventQueue::AddClient(void *client, const String& name)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	auto result = m_Events.insert(std::make_pair(client, std::deque<Dictionary::Ptr>()));
+	/* New clients only receive events which are added after they've subscribed. */
+	EventQueueClient eqclient{name, m_FirstEvent + m_Events.size(), 0};
+
+	auto result = m_Clients.insert(std::make_pair(client, eqclient));
 	ASSERT(result.second);
 }
 
@@ -71,40 +143,130 @@ void EventQueue::RemoveClient(void *client)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	m_Events.erase(client);
+	m_Clients.erase(client);
+
+	TrimEvents();
+}
+
+/**
+ * Removes the events which were read by all clients as well as the
+ * oldest events once the buffer size is exceeded.
+ *
+ * The caller must hold m_Mutex.
+ */
+void EventQueue::TrimEvents()
+{
+	uint_fast64_t minCursor = m_FirstEvent + m_Events.size();
+
+	for (const auto& kv : m_Clients) {
+		if (kv.second.Cursor < minCursor)
+			minCursor = kv.second.Cursor;
+	}
+
+	while (!m_Events.empty() && (m_FirstEvent < minCursor || m_Events.size() > m_BufferSize)) {
+		m_Events.pop_front();
+		m_FirstEvent++;
+	}
 }
 
 void EventQueue::UnregisterIfUnused(const String& name, const EventQueue::Ptr& queue)
 {
 	boost::mutex::scoped_lock lock(queue->m_Mutex);
 
-	if (queue->m_Events.empty())
+	if (queue->m_Clients.empty())
 		Unregister(name);
 }
 
 void EventQueue::SetTypes(const std::set<String>& types)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
-	m_Types = types;
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Types = types;
+	}
+
+	l_IndexDirty = true;
 }
 
 void EventQueue::SetFilter(std::unique_ptr<Expression> filter)
+{
+	std::map<String, std::set<String> > predicates;
+
+	for (const FilterPredicate& predicate : FilterUtility::GetFilterPredicates(filter.get())) {
+		if ((predicate.Variable != "event" && predicate.Variable != "obj") || predicate.Path.size() != 1 || predicate.Membership)
+			continue;
+
+		const String& attr = predicate.Path[0];
+
+		if (attr != "host" && attr != "service" && attr != "type")
+			continue;
+
+		auto it = predicates.find(attr);
+
+		if (it == predicates.end()) {
+			predicates[attr] = predicate.Values;
+			continue;
+		}
+
+		std::set<String> values;
+		std::set_intersection(it->second.begin(), it->second.end(), predicate.Values.begin(), predicate.Values.end(),
+			std::inserter(values, values.begin()));
+		it->second.swap(values);
+	}
+
+	if (filter)
+		filter.reset(new BytecodeExpression(std::move(filter)));
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Filter.swap(filter);
+		m_Predicates.swap(predicates);
+	}
+
+	l_IndexDirty = true;
+}
+
+/**
+ * Sets the maximum number of events which are kept for clients that
+ * haven't read them yet.
+ *
+ * @param size The number of events.
+ */
+void EventQueue::SetBufferSize(size_t size)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
-	m_Filter.swap(filter);
+
+	m_BufferSize = size;
+
+	TrimEvents();
 }
 
-Dictionary::Ptr EventQueue::WaitForEvent(void *client, double timeout)
+EncodedMessage::Ptr EventQueue::WaitForEvent(void *client, double timeout)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
 	for (;;) {
-		auto it = m_Events.find(client);
-		ASSERT(it != m_Events.end());
+		auto it = m_Clients.find(client);
+		ASSERT(it != m_Clients.end());
+
+		EventQueueClient& eqclient = it->second;
+
+		if (eqclient.Cursor < m_FirstEvent) {
+			uint_fast64_t dropped = m_FirstEvent - eqclient.Cursor;
+
+			Log(LogWarning, "EventQueue")
+				<< "Client '" << eqclient.Name << "' of event queue '" << m_Name << "' is too slow, dropped "
+				<< dropped << " events.";
+
+			eqclient.Dropped += dropped;
+			eqclient.Cursor = m_FirstEvent;
+		}
+
+		if (eqclient.Cursor < m_FirstEvent + m_Events.size()) {
+			EncodedMessage::Ptr result = m_Events[eqclient.Cursor - m_FirstEvent];
+			eqclient.Cursor++;
+
+			TrimEvents();
 
-		if (!it->second.empty()) {
-			Dictionary::Ptr result = *it->second.begin();
-			it->second.pop_front();
 			return result;
 		}
 
@@ -113,19 +275,133 @@ Dictionary::Ptr EventQueue::WaitForEvent(void *client, double timeout)
 	}
 }
 
+/**
+ * Returns the number of buffered events and, for each client, the number
+ * of events it hasn't read yet (its lag) and the number of events it missed.
+ */
+Dictionary::Ptr EventQueue::GetStatus() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	ArrayData clients;
+	uint_fast64_t lastEvent = m_FirstEvent + m_Events.size();
+
+	for (const auto& kv : m_Clients) {
+		uint_fast64_t cursor = std::max(kv.second.Cursor, m_FirstEvent);
+
+		clients.emplace_back(new Dictionary({
+			{ "name", kv.second.Name },
+			{ "lag", lastEvent - cursor },
+			{ "dropped", kv.second.Dropped + (cursor - kv.second.Cursor) }
+		}));
+	}
+
+	return new Dictionary({
+		{ "buffered_events", m_Events.size() },
+		{ "buffer_size", m_BufferSize },
+		{ "clients", new Array(std::move(clients)) }
+	});
+}
+
+Dictionary::Ptr EventQueue::GetStatusForAllQueues()
+{
+	DictionaryData result;
+
+	for (const auto& kv : EventQueueRegistry::GetInstance()->GetItems())
+		result.emplace_back(kv.first, kv.second->GetStatus());
+
+	return new Dictionary(std::move(result));
+}
+
+/**
+ * Rebuilds the dispatch index from the registered queues if any of them
+ * has changed.
+ *
+ * The caller must hold l_IndexMutex.
+ */
+void EventQueue::UpdateIndex()
+{
+	if (!l_IndexDirty.exchange(false))
+		return;
+
+	l_Index.clear();
+
+	for (const auto& kv : EventQueueRegistry::GetInstance()->GetItems()) {
+		const EventQueue::Ptr& queue = kv.second;
+
+		boost::mutex::scoped_lock lock(queue->m_Mutex);
+
+		auto hosts = queue->m_Predicates.find("host");
+
+		for (const String& type : queue->m_Types) {
+			if (!queue->MatchPredicate("type", type))
+				continue;
+
+			EventQueueTypeIndex& index = l_Index[type];
+
+			if (hosts == queue->m_Predicates.end())
+				index.AnyHost.push_back(queue);
+			else {
+				for (const String& host : hosts->second)
+					index.ByHost[host].push_back(queue);
+			}
+		}
+	}
+}
+
 std::vector<EventQueue::Ptr> EventQueue::GetQueuesForType(const String& type)
 {
-	EventQueueRegistry::ItemMap queues = EventQueueRegistry::GetInstance()->GetItems();
+	boost::mutex::scoped_lock lock(l_IndexMutex);
+
+	UpdateIndex();
+
+	auto it = l_Index.find(type);
+
+	if (it == l_Index.end())
+		return std::vector<EventQueue::Ptr>();
 
-	std::vector<EventQueue::Ptr> availQueues;
+	std::set<EventQueue::Ptr> queues(it->second.AnyHost.begin(), it->second.AnyHost.end());
+
+	for (const auto& kv : it->second.ByHost)
+		queues.insert(kv.second.begin(), kv.second.end());
+
+	return std::vector<EventQueue::Ptr>(queues.begin(), queues.end());
+}
 
-	typedef std::pair<String, EventQueue::Ptr> kv_pair;
-	for (const kv_pair& kv : queues) {
-		if (kv.second->CanProcessEvent(type))
-			availQueues.push_back(kv.second);
+/**
+ * Adds an event to all registered queues which accept its type and host.
+ *
+ * @param event The event.
+ */
+void EventQueue::DispatchEvent(const EncodedMessage::Ptr& event)
+{
+	Dictionary::Ptr message = event->GetMessage();
+	Value host = message->Get("host");
+
+	std::vector<EventQueue::Ptr> queues;
+
+	{
+		boost::mutex::scoped_lock lock(l_IndexMutex);
+
+		UpdateIndex();
+
+		auto it = l_Index.find(static_cast<String>(message->Get("type")));
+
+		if (it == l_Index.end())
+			return;
+
+		queues = it->second.AnyHost;
+
+		if (host.IsEmpty() || host.IsString()) {
+			auto hit = it->second.ByHost.find(static_cast<String>(host));
+
+			if (hit != it->second.ByHost.end())
+				queues.insert(queues.end(), hit->second.begin(), hit->second.end());
+		}
 	}
 
-	return availQueues;
+	for (const EventQueue::Ptr& queue : queues)
+		queue->ProcessEvent(event);
 }
 
 EventQueue::Ptr EventQueue::GetByName(const String& name)
@@ -136,11 +412,15 @@ EventQueue::Ptr EventQueue::GetByName(const String& name)
 void EventQueue::Register(const String& name, const EventQueue::Ptr& function)
 {
 	EventQueueRegistry::GetInstance()->Register(name, function);
+
+	l_IndexDirty = true;
 }
 
 void EventQueue::Unregister(const String& name)
 {
 	EventQueueRegistry::GetInstance()->Unregister(name);
+
+	l_IndexDirty = true;
 }
 
 EventQueueRegistry *EventQueueRegistry::GetInstance()
@@ -21,6 +21,7 @@
 #define EVENTQUEUE_H
 
 #include "remote/httphandler.hpp"
+#include "remote/encodedmessage.hpp"
 #include "base/object.hpp"
 #include "config/expression.hpp"
 #include <boost/thread/mutex.hpp>
@@ -32,6 +33,25 @@
 namespace icinga
 {
 
+struct EventQueueClient
+{
+	String Name;
+	uint_fast64_t Cursor;
+	uint_fast64_t Dropped;
+};
+
+/**
+ * An API event queue. Events are stored once in a ring buffer which is
+ * shared by all of the queue's clients, each of which has its own read
+ * cursor. Clients which fall behind by more than the buffer size miss
+ * the oldest events.
+ *
+ * Simple conditions on the event's host, service and type are extracted
+ * from the queue's filter, so that most events can be dispatched to the
+ * matching queues without running the filter.
+ *
+ * @ingroup remote
+ */
 class EventQueue final : public Object
 {
 public:
@@ -40,16 +60,21 @@ public:
 	EventQueue(String name);
 
 	bool CanProcessEvent(const String& type) const;
-	void ProcessEvent(const Dictionary::Ptr& event);
-	void AddClient(void *client);
+	void ProcessEvent(const EncodedMessage::Ptr& event);
+	void AddClient(void *client, const String& name = String());
 	void RemoveClient(void *client);
 
 	void SetTypes(const std::set<String>& types);
 	void SetFilter(std::unique_ptr<Expression> filter);
+	void SetBufferSize(size_t size);
+
+	EncodedMessage::Ptr WaitForEvent(void *client, double timeout = 5);
 
-	Dictionary::Ptr WaitForEvent(void *client, double timeout = 5);
+	Dictionary::Ptr GetStatus() const;
 
+	static Dictionary::Ptr GetStatusForAllQueues();
 	static std::vector<EventQueue::Ptr> GetQueuesForType(const String& type);
+	static void DispatchEvent(const EncodedMessage::Ptr& event);
 	static void UnregisterIfUnused(const String& name, const EventQueue::Ptr& queue);
 
 	static EventQueue::Ptr GetByName(const String& name);
@@ -64,8 +89,18 @@ private:
 
 	std::set<String> m_Types;
 	std::unique_ptr<Expression> m_Filter;
+	std::map<String, std::set<String> > m_Predicates;
+
+	std::deque<EncodedMessage::Ptr> m_Events;
+	uint_fast64_t m_FirstEvent{0};
+	size_t m_BufferSize;
+	std::map<void *, EventQueueClient> m_Clients;
+
+	void TrimEvents();
+	bool MatchPredicates(const Dictionary::Ptr& event) const;
+	bool MatchPredicate(const String& attr, const String& value) const;
 
-	std::map<void *, std::deque<Dictionary::Ptr> > m_Events;
+	static void UpdateIndex();
 };
 
 /**
@@ -20,16 +20,23 @@
 #include "remote/eventshandler.hpp"
 #include "remote/httputility.hpp"
 #include "remote/filterutility.hpp"
+#include "remote/apilistener.hpp"
 #include "config/configcompiler.hpp"
 #include "config/expression.hpp"
 #include "base/objectlock.hpp"
-#include "base/json.hpp"
-#include <boost/algorithm/string/replace.hpp>
+
+/* Maximum number of bytes which are queued for a client before the next event is sent. */
+#define EVENTS_SEND_QUEUE_SIZE (1024 * 1024)
 
 using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/events", EventsHandler);
 
+bool EventsHandler::IsStreaming() const
+{
+	return true;
+}
+
 bool EventsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
 {
 	if (request.RequestUrl->GetPath().size() != 2)
@@ -82,13 +89,21 @@ bool EventsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request
 	queue->SetTypes(types->ToSet<String>());
 	queue->SetFilter(std::move(ufilter));
 
-	queue->AddClient(&request);
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (listener)
+		queue->SetBufferSize(listener->GetEventQueueSize());
+
+	queue->AddClient(&request, user->GetName());
 
 	response.SetStatus(200, "OK");
 	response.AddHeader("Content-Type", "application/json");
 
 	for (;;) {
-		Dictionary::Ptr result = queue->WaitForEvent(&request);
+		/* Events for slow clients are kept in the queue's buffer rather than the stream. */
+		response.WaitForSendQueue(EVENTS_SEND_QUEUE_SIZE);
+
+		EncodedMessage::Ptr result = queue->WaitForEvent(&request);
 
 		if (!response.IsPeerConnected()) {
 			queue->RemoveClient(&request);
@@ -99,9 +114,8 @@ bool EventsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request
 		if (!result)
 			continue;
 
-		String body = JsonEncode(result);
-
-		boost::algorithm::replace_all(body, "\n", "");
+		/* The compact JSON encoding doesn't contain any newlines. */
+		const String& body = result->GetEncoded(JsonRpcEncodingJson);
 
 		try {
 			response.WriteBody(body.CStr(), body.GetLength());
@@ -33,6 +33,7 @@ public:
 
 	bool HandleRequest(const ApiUser::Ptr& user, HttpRequest& request,
 		HttpResponse& response, const Dictionary::Ptr& params) override;
+	bool IsStreaming() const override;
 };
 
 }
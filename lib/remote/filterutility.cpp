@@ -18,13 +18,17 @@
  ******************************************************************************/
 
 #include "remote/filterutility.hpp"
+#include "remote/customvarindex.hpp"
 #include "remote/httputility.hpp"
 #include "config/configcompiler.hpp"
 #include "config/expression.hpp"
 #include "base/json.hpp"
 #include "base/configtype.hpp"
+#include "base/dependencygraph.hpp"
 #include "base/logger.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <algorithm>
+#include <iterator>
 
 using namespace icinga;
 
@@ -123,6 +127,181 @@ bool FilterUtility::EvaluateFilter(ScriptFrame& frame, Expression *filter,
 	return Convert::ToBool(filter->Evaluate(frame));
 }
 
+static bool GetFilterAttributePath(const Expression *expr, String *variable, std::vector<String> *path)
+{
+	auto *iexpr = dynamic_cast<const IndexerExpression *>(expr);
+
+	if (!iexpr)
+		return false;
+
+	auto *lexpr = dynamic_cast<const LiteralExpression *>(iexpr->GetOperand2().get());
+
+	if (!lexpr || !lexpr->GetValue().IsString())
+		return false;
+
+	auto *vexpr = dynamic_cast<const VariableExpression *>(iexpr->GetOperand1().get());
+
+	if (vexpr) {
+		*variable = vexpr->GetVariable();
+		path->clear();
+	} else if (!GetFilterAttributePath(iexpr->GetOperand1().get(), variable, path))
+		return false;
+
+	path->push_back(lexpr->GetValue());
+	return true;
+}
+
+static bool GetFilterConstant(const Expression *expr, const Dictionary::Ptr& vars, Value *value)
+{
+	auto *lexpr = dynamic_cast<const LiteralExpression *>(expr);
+
+	if (lexpr) {
+		*value = lexpr->GetValue();
+		return true;
+	}
+
+	auto *vexpr = dynamic_cast<const VariableExpression *>(expr);
+
+	return vexpr && vars && vars->Get(vexpr->GetVariable(), value);
+}
+
+static bool GetFilterStringConstant(const Expression *expr, const Dictionary::Ptr& vars, String *value)
+{
+	Value constant;
+
+	if (!GetFilterConstant(expr, vars, &constant) || !constant.IsString())
+		return false;
+
+	*value = constant;
+	return true;
+}
+
+static bool GetFilterStringConstants(const Expression *expr, const Dictionary::Ptr& vars, std::set<String> *values)
+{
+	auto *aexpr = dynamic_cast<const ArrayExpression *>(expr);
+
+	if (aexpr) {
+		for (const auto& item : aexpr->GetExpressions()) {
+			String value;
+
+			if (!GetFilterStringConstant(item.get(), vars, &value))
+				return false;
+
+			values->insert(value);
+		}
+
+		return true;
+	}
+
+	Value constant;
+
+	if (!GetFilterConstant(expr, vars, &constant) || !constant.IsObjectType<Array>())
+		return false;
+
+	Array::Ptr arr = constant;
+
+	ObjectLock olock(arr);
+	for (const Value& item : arr) {
+		if (!item.IsString())
+			return false;
+
+		values->insert(item);
+	}
+
+	return true;
+}
+
+static bool GetFilterPredicate(const Expression *expr, const Dictionary::Ptr& vars, FilterPredicate *predicate)
+{
+	auto *bexpr = dynamic_cast<const BinaryExpression *>(expr);
+
+	if (!bexpr)
+		return false;
+
+	const Expression *op1 = bexpr->GetOperand1().get();
+	const Expression *op2 = bexpr->GetOperand2().get();
+	String value;
+
+	predicate->Membership = false;
+	predicate->Values.clear();
+
+	if (dynamic_cast<const EqualExpression *>(expr)) {
+		if ((GetFilterAttributePath(op1, &predicate->Variable, &predicate->Path) && GetFilterStringConstant(op2, vars, &value))
+			|| (GetFilterAttributePath(op2, &predicate->Variable, &predicate->Path) && GetFilterStringConstant(op1, vars, &value))) {
+			predicate->Values.insert(value);
+			return true;
+		}
+	} else if (dynamic_cast<const InExpression *>(expr)) {
+		if (GetFilterAttributePath(op1, &predicate->Variable, &predicate->Path))
+			return GetFilterStringConstants(op2, vars, &predicate->Values);
+
+		if (GetFilterAttributePath(op2, &predicate->Variable, &predicate->Path) && GetFilterStringConstant(op1, vars, &value)) {
+			predicate->Membership = true;
+			predicate->Values.insert(value);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void GetFilterConjuncts(const Expression *expr, std::vector<const Expression *>& conjuncts)
+{
+	auto *aexpr = dynamic_cast<const LogicalAndExpression *>(expr);
+
+	if (aexpr) {
+		GetFilterConjuncts(aexpr->GetOperand1().get(), conjuncts);
+		GetFilterConjuncts(aexpr->GetOperand2().get(), conjuncts);
+	} else
+		conjuncts.push_back(expr);
+}
+
+/**
+ * Finds simple conditions in a filter which can be checked without running
+ * the filter, i.e. equality and membership tests between attributes and
+ * string literals or variables which are and-ed with the rest of the filter. Only the
+ * conditions which are evaluated before anything else are used, so that
+ * they can't be affected by side effects of the filter.
+ *
+ * Objects which don't match one of the returned predicates never match the
+ * filter. Matching all predicates doesn't imply that the filter matches.
+ *
+ * @param filter The filter.
+ * @param vars Variables which have the same value for all objects, e.g. the
+ *             query's filter_vars.
+ * @returns The predicates.
+ */
+std::vector<FilterPredicate> FilterUtility::GetFilterPredicates(const Expression *filter, const Dictionary::Ptr& vars)
+{
+	std::vector<FilterPredicate> predicates;
+
+	for (;;) {
+		auto *dexpr = dynamic_cast<const DictExpression *>(filter);
+
+		if (!dexpr || !dexpr->IsInline() || dexpr->GetExpressions().size() != 1)
+			break;
+
+		filter = dexpr->GetExpressions()[0].get();
+	}
+
+	if (!filter)
+		return predicates;
+
+	std::vector<const Expression *> conjuncts;
+	GetFilterConjuncts(filter, conjuncts);
+
+	for (const Expression *conjunct : conjuncts) {
+		FilterPredicate predicate;
+
+		if (!GetFilterPredicate(conjunct, vars, &predicate))
+			break;
+
+		predicates.emplace_back(std::move(predicate));
+	}
+
+	return predicates;
+}
+
 static void FilteredAddTarget(ScriptFrame& permissionFrame, Expression *permissionFilter,
 	ScriptFrame& frame, Expression *ufilter, std::vector<Value>& result, const String& variableName, const Object::Ptr& target)
 {
@@ -130,6 +309,191 @@ static void FilteredAddTarget(ScriptFrame& permissionFrame, Expression *permissi
 		result.emplace_back(target);
 }
 
+static void GetReferencingObjects(const Type::Ptr& type, const ConfigObject::Ptr& object, std::set<ConfigObject::Ptr>& result)
+{
+	for (const Object::Ptr& parent : DependencyGraph::GetParents(object)) {
+		ConfigObject::Ptr pobj = dynamic_pointer_cast<ConfigObject>(parent);
+
+		if (pobj && type->IsAssignableFrom(pobj->GetReflectionType()))
+			result.insert(pobj);
+	}
+}
+
+/**
+ * Finds the objects of a type which can match an attribute predicate on the
+ * object itself, using the type's name index for names, the dependency
+ * graph for attributes which refer to other objects (e.g. host_name, groups
+ * or zone) and the CustomVarIndex for custom variables.
+ *
+ * @returns false if the predicate can't be looked up.
+ */
+static bool GetPredicateObjects(const Type::Ptr& type, const std::vector<String>& path, const FilterPredicate& predicate, std::set<ConfigObject::Ptr>& result)
+{
+	/* Empty strings also match custom variables which don't exist. */
+	if (path.size() > 1 && path[0] == "vars" && type->GetFieldId("vars") >= 0 && predicate.Values.find("") == predicate.Values.end())
+		return CustomVarIndex::GetObjects(type, std::vector<String>(path.begin() + 1, path.end()), predicate.Membership, predicate.Values, result);
+
+	if (path.size() != 1)
+		return false;
+
+	const String& attr = path[0];
+
+	if (attr == "name") {
+		if (predicate.Membership)
+			return false;
+
+		for (const String& name : predicate.Values) {
+			ConfigObject::Ptr object = ConfigObject::GetObject(type->GetName(), name);
+
+			if (object)
+				result.insert(object);
+		}
+
+		return true;
+	}
+
+	int fid = type->GetFieldId(attr);
+
+	if (fid < 0)
+		return false;
+
+	Field field = type->GetFieldInfo(fid);
+
+	/* Objects with an empty reference don't depend on anything. */
+	if (!field.RefTypeName || predicate.Membership != (field.ArrayRank > 0) || predicate.Values.find("") != predicate.Values.end())
+		return false;
+
+	for (const String& name : predicate.Values) {
+		ConfigObject::Ptr ref = ConfigObject::GetObject(field.RefTypeName, name);
+
+		if (ref)
+			GetReferencingObjects(type, ref, result);
+	}
+
+	return true;
+}
+
+/**
+ * Finds the objects of a type which can match a filter predicate. Predicates
+ * on joined objects (e.g. host.name for services) are supported for joins
+ * which are backed by a reference attribute of the type. Besides the API
+ * query planner the livestatus tables use this for their equality filters.
+ *
+ * @param type The object type.
+ * @param varName The name of the variable which refers to the object itself.
+ * @param predicate The predicate.
+ * @param result The objects which can match the predicate.
+ * @returns false if the predicate can't be looked up.
+ */
+bool FilterUtility::GetPredicateTargets(const Type::Ptr& type, const String& varName, const FilterPredicate& predicate, std::set<ConfigObject::Ptr>& result)
+{
+	if (predicate.Path.empty())
+		return false;
+
+	if (predicate.Variable == varName || predicate.Variable == "obj")
+		return GetPredicateObjects(type, predicate.Path, predicate, result);
+
+	for (int fid = 0; fid < type->GetFieldCount(); fid++) {
+		Field field = type->GetFieldInfo(fid);
+
+		if ((field.Attributes & FANavigation) == 0 || predicate.Variable != (field.NavigationName ? field.NavigationName : field.Name))
+			continue;
+
+		Type::Ptr joinedType = Type::GetByName(field.TypeName);
+
+		if (!joinedType || !dynamic_cast<ConfigType *>(joinedType.get()))
+			return false;
+
+		bool backed = false;
+
+		for (int rid = 0; rid < type->GetFieldCount(); rid++) {
+			Field rfield = type->GetFieldInfo(rid);
+
+			if (rfield.RefTypeName && rfield.ArrayRank == 0 && joinedType->GetName() == rfield.RefTypeName) {
+				backed = true;
+				break;
+			}
+		}
+
+		std::set<ConfigObject::Ptr> joinedObjects;
+
+		if (!backed || !GetPredicateObjects(joinedType, predicate.Path, predicate, joinedObjects))
+			return false;
+
+		for (const ConfigObject::Ptr& joinedObject : joinedObjects)
+			GetReferencingObjects(type, joinedObject, result);
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Uses the filter's predicates to find a set of config objects which contains
+ * all objects that can match the filter, so that it doesn't have to be
+ * evaluated for every object of the type. Lookups through the dependency
+ * graph only see activated objects.
+ *
+ * @returns false if none of the predicates can be looked up.
+ */
+static bool GetPlannedTargets(const String& type, const Expression *filter, const Dictionary::Ptr& vars,
+	const String& variableName, std::vector<ConfigObject::Ptr>& targets)
+{
+	Type::Ptr ptype = Type::GetByName(type);
+
+	if (!ptype || !dynamic_cast<ConfigType *>(ptype.get()))
+		return false;
+
+	String varName = variableName;
+
+	if (varName.IsEmpty())
+		varName = ptype->GetName().ToLower();
+
+	/* The object and its joins replace filter variables of the same name. */
+	Dictionary::Ptr constants = vars->ShallowClone();
+	constants->Remove("obj");
+	constants->Remove(varName);
+
+	for (int fid = 0; fid < ptype->GetFieldCount(); fid++) {
+		Field field = ptype->GetFieldInfo(fid);
+
+		if (field.Attributes & FANavigation)
+			constants->Remove(field.NavigationName ? field.NavigationName : field.Name);
+	}
+
+	std::set<ConfigObject::Ptr> candidates;
+	bool planned = false;
+
+	for (const FilterPredicate& predicate : FilterUtility::GetFilterPredicates(filter, constants)) {
+		std::set<ConfigObject::Ptr> objects;
+
+		if (!FilterUtility::GetPredicateTargets(ptype, varName, predicate, objects))
+			continue;
+
+		if (planned) {
+			std::set<ConfigObject::Ptr> intersection;
+			std::set_intersection(candidates.begin(), candidates.end(), objects.begin(), objects.end(),
+				std::inserter(intersection, intersection.begin()));
+			candidates.swap(intersection);
+		} else {
+			candidates.swap(objects);
+			planned = true;
+		}
+	}
+
+	if (!planned)
+		return false;
+
+	targets.assign(candidates.begin(), candidates.end());
+
+	std::sort(targets.begin(), targets.end(), [](const ConfigObject::Ptr& a, const ConfigObject::Ptr& b) {
+		return a->GetName() < b->GetName();
+	});
+
+	return true;
+}
+
 void FilterUtility::CheckPermission(const ApiUser::Ptr& user, const String& permission, Expression **permissionFilter)
 {
 	if (permissionFilter)
@@ -251,11 +615,13 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 		frame.Sandboxed = true;
 		Dictionary::Ptr uvars = new Dictionary();
 
-		std::unique_ptr<Expression> ufilter;
+		std::shared_ptr<Expression> ufilter;
+		std::unique_ptr<Expression> cfilter;
 
 		if (query->Contains("filter")) {
 			String filter = HttpUtility::GetLastParameter(query, "filter");
 			ufilter = ConfigCompiler::CompileText("<API query>", filter);
+			cfilter.reset(new BytecodeExpression(ufilter));
 		}
 
 		Dictionary::Ptr filter_vars = query->Get("filter_vars");
@@ -268,9 +634,16 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 
 		frame.Self = uvars;
 
-		provider->FindTargets(type, std::bind(&FilteredAddTarget,
-			std::ref(permissionFrame), permissionFilter,
-			std::ref(frame), &*ufilter, std::ref(result), variableName, _1));
+		std::vector<ConfigObject::Ptr> targets;
+
+		if (ufilter && dynamic_pointer_cast<ConfigObjectTargetProvider>(provider) && GetPlannedTargets(type, ufilter.get(), uvars, variableName, targets)) {
+			for (const ConfigObject::Ptr& target : targets)
+				FilteredAddTarget(permissionFrame, permissionFilter, frame, cfilter.get(), result, variableName, target);
+		} else {
+			provider->FindTargets(type, std::bind(&FilteredAddTarget,
+				std::ref(permissionFrame), permissionFilter,
+				std::ref(frame), cfilter.get(), std::ref(result), variableName, _1));
+		}
 	}
 
 	return result;
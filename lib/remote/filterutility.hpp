@@ -59,6 +59,19 @@ struct QueryDescription
 	String Permission;
 };
 
+/**
+ * A condition which must hold for an object to match a filter: the
+ * attribute at Path below Variable is one of Values or, if Membership
+ * is set, an array which contains one of Values.
+ */
+struct FilterPredicate
+{
+	String Variable;
+	std::vector<String> Path;
+	bool Membership;
+	std::set<String> Values;
+};
+
 /**
  * Filter utilities.
  *
@@ -73,6 +86,9 @@ public:
 		const ApiUser::Ptr& user, const String& variableName = String());
 	static bool EvaluateFilter(ScriptFrame& frame, Expression *filter,
 		const Object::Ptr& target, const String& variableName = String());
+	static std::vector<FilterPredicate> GetFilterPredicates(const Expression *filter, const Dictionary::Ptr& vars = nullptr);
+	static bool GetPredicateTargets(const Type::Ptr& type, const String& varName,
+		const FilterPredicate& predicate, std::set<ConfigObject::Ptr>& result);
 };
 
 }
@@ -0,0 +1,471 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/httpconnectionpool.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <algorithm>
+
+using namespace icinga;
+
+static boost::mutex l_SharedPoolsMutex;
+static std::map<String, std::weak_ptr<HttpConnectionPool> > l_SharedPools;
+
+HttpConnectionPool::HttpConnectionPool(const ConnectFunction& connect, size_t maxConnections, size_t pipelineDepth)
+	: m_Connect(connect), m_MaxConnections(std::max<size_t>(maxConnections, 1)),
+	m_PipelineDepth(std::max<size_t>(pipelineDepth, 1)), m_SendQueue(0, static_cast<int>(m_MaxConnections))
+{
+	m_SendQueue.SetName("HttpConnectionPool");
+}
+
+HttpConnectionPool::~HttpConnectionPool()
+{
+	if (m_TimeoutTimer)
+		m_TimeoutTimer->Stop(true);
+
+	m_SendQueue.Join();
+
+	Clear();
+}
+
+/**
+ * Returns the pool for a server which is shared by all callers that use
+ * the same key. The key must identify the host, port and TLS settings.
+ * The pool is created with the connect function and limits of the first
+ * caller, and with the timeout and retries which are set in the
+ * HttpClientTimeout, HttpClientRetries and HttpClientPipelineDepth
+ * constants.
+ *
+ * @param key The key.
+ * @param connect Opens a new connection to the server.
+ * @param maxConnections The maximum number of concurrent connections.
+ * @returns The pool.
+ */
+std::shared_ptr<HttpConnectionPool> HttpConnectionPool::GetShared(const String& key, const ConnectFunction& connect, size_t maxConnections)
+{
+	boost::mutex::scoped_lock lock(l_SharedPoolsMutex);
+
+	std::shared_ptr<HttpConnectionPool> pool = l_SharedPools[key].lock();
+
+	if (pool)
+		return pool;
+
+	for (auto it = l_SharedPools.begin(); it != l_SharedPools.end();) {
+		if (it->second.expired())
+			it = l_SharedPools.erase(it);
+		else
+			it++;
+	}
+
+	Value pipelineDepth = ScriptGlobal::Get("HttpClientPipelineDepth", &Empty);
+	pool = std::make_shared<HttpConnectionPool>(connect, maxConnections, pipelineDepth.IsEmpty() ? 4 : static_cast<int>(pipelineDepth));
+
+	Value timeout = ScriptGlobal::Get("HttpClientTimeout", &Empty);
+	pool->SetTimeout(timeout.IsEmpty() ? 60 : static_cast<double>(timeout));
+
+	Value retries = ScriptGlobal::Get("HttpClientRetries", &Empty);
+	pool->SetMaxRetries(retries.IsEmpty() ? 2 : static_cast<int>(retries));
+
+	l_SharedPools[key] = pool;
+
+	return pool;
+}
+
+/**
+ * Sets the number of seconds the pool waits for each response before it
+ * aborts the connection. 0 disables the timeout.
+ */
+void HttpConnectionPool::SetTimeout(double timeout)
+{
+	m_Timeout = timeout;
+
+	if (timeout <= 0 || m_TimeoutTimer)
+		return;
+
+	m_TimeoutTimer = new Timer("HttpConnectionPool timeout");
+	m_TimeoutTimer->SetInterval(std::min(std::max(timeout / 4, 0.5), 5.0));
+	m_TimeoutTimer->OnTimerExpired.connect(std::bind(&HttpConnectionPool::TimeoutTimerHandler, this));
+	m_TimeoutTimer->Start();
+}
+
+/**
+ * Sets how often a request is sent again after its connection could not
+ * be established, failed or timed out.
+ */
+void HttpConnectionPool::SetMaxRetries(int retries)
+{
+	m_MaxRetries = retries;
+}
+
+/**
+ * Queues a request and returns immediately. The request is sent by one
+ * of the pool's threads.
+ *
+ * @param prepareRequest Sets the URL, headers and body of the request.
+ * @param processResponse Handles the complete response.
+ * @param completion Called after the response was processed or once the
+ * request has failed for good, with the exception in that case.
+ */
+void HttpConnectionPool::SubmitRequest(const PrepareRequestFunction& prepareRequest, const ProcessResponseFunction& processResponse,
+	const CompletionFunction& completion)
+{
+	bool startSender = false;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		m_Requests.push_back({ prepareRequest, processResponse, completion, 0 });
+
+		if (m_Senders < m_MaxConnections) {
+			m_Senders++;
+			startSender = true;
+		}
+	}
+
+	if (startSender)
+		m_SendQueue.Enqueue(std::bind(&HttpConnectionPool::SenderProc, this));
+}
+
+/**
+ * Sends a request and waits until the response was processed. Must not
+ * be called from a completion callback.
+ *
+ * @param prepareRequest Sets the URL, headers and body of the request.
+ * @param processResponse Handles the complete response.
+ */
+void HttpConnectionPool::SendRequest(const PrepareRequestFunction& prepareRequest, const ProcessResponseFunction& processResponse)
+{
+	boost::mutex mutex;
+	boost::condition_variable cv;
+	bool done = false;
+	boost::exception_ptr error;
+
+	SubmitRequest(prepareRequest, processResponse, [&mutex, &cv, &done, &error](boost::exception_ptr exp) {
+		boost::mutex::scoped_lock lock(mutex);
+		error = exp;
+		done = true;
+		cv.notify_all();
+	});
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	while (!done)
+		cv.wait(lock);
+
+	if (error)
+		boost::rethrow_exception(error);
+}
+
+/**
+ * Closes all idle connections.
+ */
+void HttpConnectionPool::Clear()
+{
+	std::vector<Stream::Ptr> connections;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		connections.swap(m_IdleConnections);
+	}
+
+	for (const Stream::Ptr& stream : connections)
+		stream->Close();
+}
+
+size_t HttpConnectionPool::GetIdleConnections() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_IdleConnections.size();
+}
+
+/**
+ * Returns the number of requests which wait for a connection.
+ */
+size_t HttpConnectionPool::GetPendingRequests() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_Requests.size();
+}
+
+void HttpConnectionPool::SenderProc()
+{
+	for (;;) {
+		std::vector<PendingRequest> requests;
+		bool startSender = false;
+
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
+
+			if (m_Requests.empty()) {
+				m_Senders--;
+				return;
+			}
+
+			/* Leave enough requests for the other connections before pipelining. */
+			size_t spareSenders = m_MaxConnections - m_Senders;
+			size_t count = std::min(m_PipelineDepth, (m_Requests.size() + spareSenders) / (spareSenders + 1));
+
+			for (size_t i = 0; i < std::max<size_t>(count, 1); i++) {
+				requests.push_back(std::move(m_Requests.front()));
+				m_Requests.pop_front();
+			}
+
+			if (!m_Requests.empty() && m_Senders < m_MaxConnections) {
+				m_Senders++;
+				startSender = true;
+			}
+		}
+
+		if (startSender)
+			m_SendQueue.Enqueue(std::bind(&HttpConnectionPool::SenderProc, this));
+
+		SendRequests(requests);
+	}
+}
+
+/**
+ * Writes the requests to one connection and reads their responses in order.
+ * Requests which the server didn't answer before the connection failed or
+ * was closed are queued again. The completion callbacks are invoked after
+ * the connection was handed back to the pool.
+ *
+ * @param requests The requests.
+ */
+void HttpConnectionPool::SendRequests(std::vector<PendingRequest>& requests)
+{
+	std::vector<std::pair<CompletionFunction, boost::exception_ptr> > completions;
+
+	bool reused;
+	Stream::Ptr stream;
+
+	try {
+		stream = Acquire(&reused);
+	} catch (const std::exception&) {
+		std::vector<PendingRequest> retries;
+
+		for (PendingRequest& pending : requests) {
+			if (++pending.Attempts <= m_MaxRetries)
+				retries.push_back(std::move(pending));
+			else
+				completions.emplace_back(pending.Completion, boost::current_exception());
+		}
+
+		RequeueRequests(retries, 0);
+
+		for (auto& completion : completions) {
+			if (completion.first)
+				completion.first(completion.second);
+		}
+
+		return;
+	}
+
+	std::vector<std::unique_ptr<HttpRequest> > httpRequests;
+	std::unique_ptr<HttpResponse> response;
+	size_t completed = 0;
+	bool keepAlive = true;
+	boost::exception_ptr error;
+
+	SetDeadline(stream);
+
+	try {
+		for (PendingRequest& pending : requests) {
+			httpRequests.emplace_back(new HttpRequest(stream));
+			pending.Prepare(*httpRequests.back());
+			httpRequests.back()->Finish();
+		}
+
+		StreamReadContext context;
+
+		for (; completed < requests.size(); completed++) {
+			response.reset(new HttpResponse(stream, *httpRequests[completed]));
+
+			while (response->Parse(context, true) && !response->Complete)
+				; /* Do nothing */
+
+			if (!response->Complete)
+				BOOST_THROW_EXCEPTION(std::runtime_error("Failed to read a complete HTTP response."));
+
+			PendingRequest& pending = requests[completed];
+			boost::exception_ptr processError;
+
+			try {
+				pending.Process(*response);
+			} catch (const std::exception&) {
+				processError = boost::current_exception();
+			}
+
+			completions.emplace_back(pending.Completion, processError);
+
+			SetDeadline(stream);
+
+			if (response->ProtocolVersion != HttpVersion11 || response->Headers->Get("connection") == "close") {
+				keepAlive = false;
+				completed++;
+				break;
+			}
+		}
+	} catch (const std::exception&) {
+		error = boost::current_exception();
+	}
+
+	bool timedOut = ClearDeadline(stream);
+
+	if (error || !keepAlive)
+		stream->Close();
+	else
+		Release(stream);
+
+	if (error) {
+		PendingRequest& failed = requests[completed];
+		bool answered = response && response->Headers;
+		bool retry;
+
+		if (timedOut) {
+			error = boost::copy_exception(std::runtime_error("Timed out after " + Convert::ToString(m_Timeout) + " seconds waiting for an HTTP response."));
+			retry = ++failed.Attempts <= m_MaxRetries;
+		} else if (answered)
+			retry = false;
+		else if (!reused && completed == 0)
+			retry = ++failed.Attempts <= m_MaxRetries;
+		else
+			retry = true; /* The server closed an idle or pipelined connection. */
+
+		if (!retry) {
+			completions.emplace_back(failed.Completion, error);
+			completed++;
+		}
+	}
+
+	RequeueRequests(requests, completed);
+
+	for (auto& completion : completions) {
+		if (completion.first)
+			completion.first(completion.second);
+	}
+}
+
+void HttpConnectionPool::RequeueRequests(std::vector<PendingRequest>& requests, size_t offset)
+{
+	if (offset >= requests.size())
+		return;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	for (size_t i = requests.size(); i > offset; i--)
+		m_Requests.push_front(std::move(requests[i - 1]));
+}
+
+void HttpConnectionPool::SetDeadline(const Stream::Ptr& stream)
+{
+	if (m_Timeout <= 0)
+		return;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_ActiveConnections[stream] = { Utility::GetTime() + m_Timeout, false };
+}
+
+/**
+ * Stops watching a connection.
+ *
+ * @returns Whether the connection was aborted because it timed out.
+ */
+bool HttpConnectionPool::ClearDeadline(const Stream::Ptr& stream)
+{
+	if (m_Timeout <= 0)
+		return false;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	auto it = m_ActiveConnections.find(stream);
+
+	if (it == m_ActiveConnections.end())
+		return false;
+
+	bool timedOut = it->second.TimedOut;
+	m_ActiveConnections.erase(it);
+
+	return timedOut;
+}
+
+void HttpConnectionPool::TimeoutTimerHandler()
+{
+	std::vector<Stream::Ptr> expired;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		double now = Utility::GetTime();
+
+		for (auto& kv : m_ActiveConnections) {
+			if (!kv.second.TimedOut && kv.second.Deadline < now) {
+				kv.second.TimedOut = true;
+				expired.push_back(kv.first);
+			}
+		}
+	}
+
+	/* Wake up the thread which waits for the response. Closing wakes up
+	 * threads which wait for TLS streams, blocking sockets have to be shut down. */
+	for (const Stream::Ptr& stream : expired) {
+		try {
+			if (stream->SupportsWaiting())
+				stream->Close();
+			else
+				stream->Shutdown();
+		} catch (const std::exception&) {
+			/* Nothing to do, the request fails once the stream is closed. */
+		}
+	}
+}
+
+Stream::Ptr HttpConnectionPool::Acquire(bool *reused)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (!m_IdleConnections.empty()) {
+			Stream::Ptr stream = m_IdleConnections.back();
+			m_IdleConnections.pop_back();
+
+			*reused = true;
+			return stream;
+		}
+	}
+
+	*reused = false;
+	return m_Connect();
+}
+
+void HttpConnectionPool::Release(const Stream::Ptr& stream)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_IdleConnections.size() < m_MaxConnections) {
+			m_IdleConnections.push_back(stream);
+			return;
+		}
+	}
+
+	stream->Close();
+}
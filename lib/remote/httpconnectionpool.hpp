@@ -0,0 +1,125 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef HTTPCONNECTIONPOOL_H
+#define HTTPCONNECTIONPOOL_H
+
+#include "remote/i2-remote.hpp"
+#include "remote/httprequest.hpp"
+#include "remote/httpresponse.hpp"
+#include "base/stream.hpp"
+#include "base/timer.hpp"
+#include "base/workqueue.hpp"
+#include <boost/thread/mutex.hpp>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * An asynchronous HTTP client which sends requests over persistent
+ * keep-alive connections. Requests are queued and sent by the pool's own
+ * threads, one per connection, so callers never block on the network.
+ * Several requests may be pipelined on a connection before their
+ * responses are read.
+ *
+ * Requests whose connection failed before the server answered them are
+ * sent again on a new connection. Responses which take longer than the
+ * timeout abort their connection.
+ *
+ * @ingroup remote
+ */
+class HttpConnectionPool
+{
+public:
+	typedef std::function<Stream::Ptr ()> ConnectFunction;
+	typedef std::function<void (HttpRequest&)> PrepareRequestFunction;
+	typedef std::function<void (HttpResponse&)> ProcessResponseFunction;
+	typedef std::function<void (boost::exception_ptr)> CompletionFunction;
+
+	HttpConnectionPool(const ConnectFunction& connect, size_t maxConnections, size_t pipelineDepth = 1);
+	~HttpConnectionPool();
+
+	static std::shared_ptr<HttpConnectionPool> GetShared(const String& key, const ConnectFunction& connect, size_t maxConnections);
+
+	void SetTimeout(double timeout);
+	void SetMaxRetries(int retries);
+
+	void SubmitRequest(const PrepareRequestFunction& prepareRequest, const ProcessResponseFunction& processResponse,
+		const CompletionFunction& completion);
+	void SendRequest(const PrepareRequestFunction& prepareRequest, const ProcessResponseFunction& processResponse);
+
+	void Clear();
+
+	size_t GetIdleConnections() const;
+	size_t GetPendingRequests() const;
+
+private:
+	/**
+	 * A request which was submitted but not answered yet.
+	 */
+	struct PendingRequest
+	{
+		PrepareRequestFunction Prepare;
+		ProcessResponseFunction Process;
+		CompletionFunction Completion;
+		int Attempts;
+	};
+
+	/**
+	 * A connection on which requests are in flight.
+	 */
+	struct ActiveConnection
+	{
+		double Deadline;
+		bool TimedOut;
+	};
+
+	ConnectFunction m_Connect;
+	size_t m_MaxConnections;
+	size_t m_PipelineDepth;
+	double m_Timeout{0};
+	int m_MaxRetries{0};
+
+	mutable boost::mutex m_Mutex;
+	std::vector<Stream::Ptr> m_IdleConnections;
+	std::map<Stream::Ptr, ActiveConnection> m_ActiveConnections;
+	std::deque<PendingRequest> m_Requests;
+	size_t m_Senders{0};
+
+	Timer::Ptr m_TimeoutTimer;
+	WorkQueue m_SendQueue;
+
+	void SenderProc();
+	void SendRequests(std::vector<PendingRequest>& requests);
+	void RequeueRequests(std::vector<PendingRequest>& requests, size_t offset);
+	void SetDeadline(const Stream::Ptr& stream);
+	bool ClearDeadline(const Stream::Ptr& stream);
+	void TimeoutTimerHandler();
+
+	Stream::Ptr Acquire(bool *reused);
+	void Release(const Stream::Ptr& stream);
+};
+
+}
+
+#endif /* HTTPCONNECTIONPOOL_H */
@@ -19,14 +19,107 @@
 
 #include "remote/httphandler.hpp"
 #include "remote/httputility.hpp"
+#include "remote/apilistener.hpp"
 #include "base/singleton.hpp"
 #include "base/exception.hpp"
+#include "base/utility.hpp"
 #include <boost/algorithm/string/join.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 using namespace icinga;
 
 Dictionary::Ptr HttpHandler::m_UrlTree;
 
+namespace
+{
+
+struct HttpHandlerStats
+{
+	uint_fast64_t Requests;
+	double QueueTime;
+	double ExecutionTime;
+	double MaxExecutionTime;
+};
+
+}
+
+static boost::mutex l_WorkersMutex;
+static boost::condition_variable l_WorkersCV;
+static int l_ActiveRequests = 0;
+static int l_QueuedRequests = 0;
+static std::map<String, int> l_UserRequests;
+static std::map<String, HttpHandlerStats> l_HandlerStats;
+
+/**
+ * Waits until the request may be handled, i.e. until fewer than the ApiListener's
+ * max_concurrent_requests are being handled. Streaming requests don't count
+ * against that limit, but like all other requests against the user's
+ * max_concurrent_requests.
+ *
+ * @returns 0 if the request may be handled, otherwise the HTTP status code with
+ *          which it must be rejected.
+ */
+static int AcquireWorker(const ApiUser::Ptr& user, bool streaming)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+	int maxRequests = (listener && !streaming) ? listener->GetMaxConcurrentRequests() : 0;
+	int maxQueued = listener ? listener->GetMaxQueuedRequests() : 0;
+	int maxUserRequests = user ? user->GetMaxConcurrentRequests() : 0;
+	String userName = user ? user->GetName() : String();
+
+	boost::mutex::scoped_lock lock(l_WorkersMutex);
+
+	if (maxUserRequests > 0 && l_UserRequests[userName] >= maxUserRequests)
+		return 429;
+
+	if (maxRequests > 0 && l_ActiveRequests >= maxRequests) {
+		if (l_QueuedRequests >= maxQueued)
+			return 503;
+
+		l_QueuedRequests++;
+
+		while (l_ActiveRequests >= maxRequests)
+			l_WorkersCV.wait(lock);
+
+		l_QueuedRequests--;
+	}
+
+	if (!streaming)
+		l_ActiveRequests++;
+
+	l_UserRequests[userName]++;
+
+	return 0;
+}
+
+static void ReleaseWorker(const ApiUser::Ptr& user, bool streaming)
+{
+	String userName = user ? user->GetName() : String();
+
+	boost::mutex::scoped_lock lock(l_WorkersMutex);
+
+	if (!streaming) {
+		l_ActiveRequests--;
+		l_WorkersCV.notify_one();
+	}
+
+	auto it = l_UserRequests.find(userName);
+
+	if (--it->second == 0)
+		l_UserRequests.erase(it);
+}
+
+/**
+ * Whether requests for the handler keep running for a long time without
+ * using much CPU time (e.g. event streams). Such requests aren't limited
+ * by the worker pool and the request budgets.
+ */
+bool HttpHandler::IsStreaming() const
+{
+	return false;
+}
+
 void HttpHandler::Register(const Url::Ptr& url, const HttpHandler::Ptr& handler)
 {
 	if (!m_UrlTree)
@@ -58,10 +151,17 @@ void HttpHandler::Register(const Url::Ptr& url, const HttpHandler::Ptr& handler)
 		node->Set("handlers", handlers);
 	}
 
+	handler->m_Url = url->Format();
+
 	handlers->Add(handler);
 }
 
-void HttpHandler::ProcessRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response)
+/**
+ * Handles a request using the most specific handler which accepts it.
+ *
+ * @param queued The time at which the request was received.
+ */
+void HttpHandler::ProcessRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, double queued)
 {
 	Dictionary::Ptr node = m_UrlTree;
 	std::vector<HttpHandler::Ptr> handlers;
@@ -104,19 +204,90 @@ void HttpHandler::ProcessRequest(const ApiUser::Ptr& user, HttpRequest& request,
 		return;
 	}
 
-	bool processed = false;
-	for (const HttpHandler::Ptr& handler : handlers) {
-		if (handler->HandleRequest(user, request, response, params)) {
-			processed = true;
-			break;
+	bool streaming = !handlers.empty() && handlers[0]->IsStreaming();
+	int rejectStatus = AcquireWorker(user, streaming);
+
+	if (rejectStatus == 429) {
+		HttpUtility::SendJsonError(response, params, 429, "Too many concurrent requests for this API user.");
+		return;
+	} else if (rejectStatus != 0) {
+		HttpUtility::SendJsonError(response, params, 503, "Too many requests are waiting to be processed.");
+		return;
+	}
+
+	double started = Utility::GetTime();
+
+	if (queued == 0)
+		queued = started;
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (listener && !streaming) {
+		double maxTime = listener->GetMaxRequestTime();
+		int maxSize = listener->GetMaxResponseSize();
+
+		response.SetBudget(maxTime > 0 ? started + maxTime : 0, maxSize > 0 ? maxSize : 0);
+	}
+
+	HttpHandler::Ptr processedBy;
+
+	try {
+		for (const HttpHandler::Ptr& handler : handlers) {
+			if (handler->HandleRequest(user, request, response, params)) {
+				processedBy = handler;
+				break;
+			}
 		}
+	} catch (...) {
+		ReleaseWorker(user, streaming);
+		throw;
 	}
 
-	if (!processed) {
+	ReleaseWorker(user, streaming);
+
+	if (!processedBy) {
 		String path = boost::algorithm::join(request.RequestUrl->GetPath(), "/");
 		HttpUtility::SendJsonError(response, params, 404, "The requested path '" + path +
 				"' could not be found or the request method is not valid for this path.");
 		return;
 	}
+
+	double executionTime = Utility::GetTime() - started;
+
+	boost::mutex::scoped_lock lock(l_WorkersMutex);
+
+	HttpHandlerStats& stats = l_HandlerStats[processedBy->m_Url];
+	stats.Requests++;
+	stats.QueueTime += started - queued;
+	stats.ExecutionTime += executionTime;
+	stats.MaxExecutionTime = std::max(stats.MaxExecutionTime, executionTime);
 }
 
+/**
+ * Returns the number of requests which are being handled or are waiting for
+ * a worker and, for each URL handler, its number of requests as well as
+ * their average time spent waiting and being handled.
+ */
+Dictionary::Ptr HttpHandler::GetStats()
+{
+	boost::mutex::scoped_lock lock(l_WorkersMutex);
+
+	DictionaryData handlers;
+
+	for (const auto& kv : l_HandlerStats) {
+		const HttpHandlerStats& stats = kv.second;
+
+		handlers.emplace_back(kv.first, new Dictionary({
+			{ "requests", stats.Requests },
+			{ "avg_queue_time", stats.QueueTime / stats.Requests },
+			{ "avg_execution_time", stats.ExecutionTime / stats.Requests },
+			{ "max_execution_time", stats.MaxExecutionTime }
+		}));
+	}
+
+	return new Dictionary({
+		{ "active_requests", l_ActiveRequests },
+		{ "queued_requests", l_QueuedRequests },
+		{ "handlers", new Dictionary(std::move(handlers)) }
+	});
+}
@@ -40,12 +40,17 @@ public:
 	DECLARE_PTR_TYPEDEFS(HttpHandler);
 
 	virtual bool HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params) = 0;
+	virtual bool IsStreaming() const;
 
 	static void Register(const Url::Ptr& url, const HttpHandler::Ptr& handler);
-	static void ProcessRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response);
+	static void ProcessRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, double queued = 0);
+
+	static Dictionary::Ptr GetStats();
 
 private:
 	static Dictionary::Ptr m_UrlTree;
+
+	String m_Url;
 };
 
 /**
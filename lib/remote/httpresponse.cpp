@@ -22,6 +22,8 @@
 #include "base/logger.hpp"
 #include "base/application.hpp"
 #include "base/convert.hpp"
+#include "base/tlsstream.hpp"
+#include "base/utility.hpp"
 
 using namespace icinga;
 
@@ -46,6 +48,8 @@ void HttpResponse::SetStatus(int code, const String& message)
 	else
 		status += "1.1";
 
+	StatusCode = code;
+
 	status += " " + Convert::ToString(code) + " " + message + "\r\n";
 
 	m_Stream->Write(status.CStr(), status.GetLength());
@@ -61,7 +65,8 @@ void HttpResponse::AddHeader(const String& key, const String& value)
 void HttpResponse::FinishHeaders()
 {
 	if (m_State == HttpResponseHeaders) {
-		if (m_Request->ProtocolVersion == HttpVersion11)
+		/* Responses with status 304 don't have a body. */
+		if (m_Request->ProtocolVersion == HttpVersion11 && StatusCode != 304)
 			AddHeader("Transfer-Encoding", "chunked");
 
 		AddHeader("Server", "Icinga/" + Application::GetAppVersion());
@@ -78,6 +83,8 @@ void HttpResponse::WriteBody(const char *data, size_t count)
 {
 	ASSERT(m_State == HttpResponseHeaders || m_State == HttpResponseBody);
 
+	m_BodyBytes += count;
+
 	if (m_Request->ProtocolVersion == HttpVersion10) {
 		if (!m_Body)
 			m_Body = new FIFO();
@@ -105,6 +112,8 @@ void HttpResponse::Finish()
 			size_t rc = m_Body->Read(buffer, sizeof(buffer), true);
 			m_Stream->Write(buffer, rc);
 		}
+	} else if (StatusCode == 304) {
+		FinishHeaders();
 	} else {
 		WriteBody(nullptr, 0);
 		m_Stream->Write("\r\n", 2);
@@ -264,7 +273,64 @@ bool HttpResponse::IsPeerConnected() const
 	return !m_Stream->IsEof();
 }
 
+/**
+ * Blocks until the peer has received enough of the body for the stream's
+ * send queue to shrink to the specified size. Handlers which stream large
+ * bodies use this to avoid queueing the whole body in memory.
+ *
+ * @param maxBytes The maximum number of queued bytes.
+ */
+void HttpResponse::WaitForSendQueue(size_t maxBytes)
+{
+	TlsStream::Ptr tlsStream = dynamic_pointer_cast<TlsStream>(m_Stream);
+
+	if (!tlsStream)
+		return;
+
+	while (!tlsStream->IsEof() && tlsStream->GetSendQueueSize() > maxBytes)
+		Utility::Sleep(0.1);
+}
+
+/**
+ * Limits the time and the response size which a handler may use. Handlers
+ * which produce large responses should check IsBudgetExceeded() regularly
+ * and abort the request.
+ *
+ * @param deadline The time until which the request has to be handled, or 0.
+ * @param maxBodySize The maximum size of the response body in bytes, or 0.
+ */
+void HttpResponse::SetBudget(double deadline, size_t maxBodySize)
+{
+	m_Deadline = deadline;
+	m_MaxBodySize = maxBodySize;
+}
+
+/**
+ * Checks whether the request's time or response size budget is used up.
+ *
+ * @param pendingBytes The number of bytes the handler is about to write.
+ */
+bool HttpResponse::IsBudgetExceeded(size_t pendingBytes) const
+{
+	if (m_MaxBodySize > 0 && m_BodyBytes + pendingBytes > m_MaxBodySize)
+		return true;
+
+	return m_Deadline > 0 && Utility::GetTime() > m_Deadline;
+}
+
 void HttpResponse::RebindRequest(const HttpRequest& request)
 {
 	m_Request = &request;
 }
+
+/**
+ * Makes the response write to another stream, e.g. a buffer for responses
+ * which must not be sent before the responses of pipelined requests
+ * which were received earlier.
+ */
+void HttpResponse::RebindStream(const Stream::Ptr& stream)
+{
+	ASSERT(m_State == HttpResponseStart);
+
+	m_Stream = stream;
+}
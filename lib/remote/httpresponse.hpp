@@ -64,8 +64,13 @@ public:
 	void Finish();
 
 	bool IsPeerConnected() const;
+	void WaitForSendQueue(size_t maxBytes);
+
+	void SetBudget(double deadline, size_t maxBodySize);
+	bool IsBudgetExceeded(size_t pendingBytes = 0) const;
 
 	void RebindRequest(const HttpRequest& request);
+	void RebindStream(const Stream::Ptr& stream);
 
 private:
 	HttpResponseState m_State;
@@ -74,6 +79,9 @@ private:
 	Stream::Ptr m_Stream;
 	FIFO::Ptr m_Body;
 	std::vector<String> m_Headers;
+	size_t m_BodyBytes{0};
+	double m_Deadline{0};
+	size_t m_MaxBodySize{0};
 
 	void FinishHeaders();
 };
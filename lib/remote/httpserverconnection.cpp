@@ -23,6 +23,7 @@
 #include "remote/apilistener.hpp"
 #include "remote/apifunction.hpp"
 #include "remote/jsonrpc.hpp"
+#include "base/application.hpp"
 #include "base/base64.hpp"
 #include "base/convert.hpp"
 #include "base/configtype.hpp"
@@ -36,13 +37,21 @@
 using namespace icinga;
 
 static boost::once_flag l_HttpServerConnectionOnceFlag = BOOST_ONCE_INIT;
-static Timer::Ptr l_HttpServerConnectionTimeoutTimer;
+static WorkQueue *l_PipelineQueue;
+
+static std::atomic<unsigned long> l_HttpConnections(0);
+static std::atomic<unsigned long> l_HttpRequests(0);
+static std::atomic<unsigned long> l_HttpKeepAliveRequests(0);
+static std::atomic<unsigned long> l_HttpPipelinedRequests(0);
 
 HttpServerConnection::HttpServerConnection(const String& identity, bool authenticated, const TlsStream::Ptr& stream)
-	: m_Stream(stream), m_Seen(Utility::GetTime()), m_CurrentRequest(stream), m_PendingRequests(0)
+	: m_Stream(stream), m_Seen(Utility::GetTime()), m_CurrentRequest(stream), m_PendingRequests(0),
+	m_PendingUpdates(0), m_RequestCount(0)
 {
 	boost::call_once(l_HttpServerConnectionOnceFlag, &HttpServerConnection::StaticInitialize);
 
+	l_HttpConnections++;
+
 	m_RequestQueue.SetName("HttpServerConnection");
 
 	if (authenticated)
@@ -51,14 +60,18 @@ HttpServerConnection::HttpServerConnection(const String& identity, bool authenti
 
 void HttpServerConnection::StaticInitialize()
 {
-	l_HttpServerConnectionTimeoutTimer = new Timer();
-	l_HttpServerConnectionTimeoutTimer->OnTimerExpired.connect(std::bind(&HttpServerConnection::TimeoutTimerHandler));
-	l_HttpServerConnectionTimeoutTimer->SetInterval(5);
-	l_HttpServerConnectionTimeoutTimer->Start();
+	l_PipelineQueue = new WorkQueue(0, Application::GetConcurrency());
+	l_PipelineQueue->SetName("HttpServerConnection, pipeline");
 }
 
 void HttpServerConnection::Start()
 {
+	/* The timer holds an owning reference to this object until Disconnect() is called. */
+	m_LivenessTimer = new Timer("HttpServerConnection liveness");
+	m_LivenessTimer->OnTimerExpired.connect(std::bind(&HttpServerConnection::CheckLiveness, HttpServerConnection::Ptr(this)));
+	m_LivenessTimer->Start();
+	m_LivenessTimer->Reschedule(Utility::GetTime() + 10);
+
 	/* the stream holds an owning reference to this object through the callback we're registering here */
 	m_Stream->RegisterDataHandler(std::bind(&HttpServerConnection::DataAvailableHandler, HttpServerConnection::Ptr(this)));
 	if (m_Stream->IsDataAvailable())
@@ -92,6 +105,11 @@ void HttpServerConnection::Disconnect()
 	new (&m_CurrentRequest) HttpRequest(nullptr);
 
 	m_Stream->Close();
+
+	if (m_LivenessTimer) {
+		m_LivenessTimer->Stop();
+		m_LivenessTimer->OnTimerExpired.disconnect_all_slots();
+	}
 }
 
 bool HttpServerConnection::ProcessMessage()
@@ -173,16 +191,46 @@ bool HttpServerConnection::ProcessMessage()
 		return res;
 	}
 
-	m_RequestQueue.Enqueue(std::bind(&HttpServerConnection::ProcessMessageAsync,
-		HttpServerConnection::Ptr(this), m_CurrentRequest, response, m_AuthenticatedUser));
+	l_HttpRequests++;
+
+	if (m_RequestCount > 0)
+		l_HttpKeepAliveRequests++;
+
+	m_RequestCount++;
+
+	/* GET requests which arrive while earlier requests are still pending are processed
+	 * concurrently. Their responses are buffered and sent in order by the connection's
+	 * request queue. Any other request waits until the earlier requests are done, so
+	 * GET requests always see the effects of updates which were sent before them. */
+	if (m_PendingRequests > 0 && m_PendingUpdates == 0 && m_CurrentRequest.RequestMethod == "GET"
+		&& m_CurrentRequest.ProtocolVersion == HttpVersion11 && m_CurrentRequest.Headers->Get("connection") != "close") {
+		auto pipelined = std::make_shared<PipelinedResponse>();
+
+		response.RebindStream(pipelined->Buffer);
+
+		l_PipelineQueue->Enqueue(std::bind(&HttpServerConnection::ProcessPipelinedMessage,
+			m_CurrentRequest, response, m_AuthenticatedUser, Utility::GetTime(), pipelined));
+
+		m_RequestQueue.Enqueue(std::bind(&HttpServerConnection::SendPipelinedResponse,
+			HttpServerConnection::Ptr(this), pipelined));
+
+		l_HttpPipelinedRequests++;
+	} else {
+		if (m_CurrentRequest.RequestMethod != "GET")
+			m_PendingUpdates++;
+
+		m_RequestQueue.Enqueue(std::bind(&HttpServerConnection::ProcessMessageAsync,
+			HttpServerConnection::Ptr(this), m_CurrentRequest, response, m_AuthenticatedUser, Utility::GetTime()));
+	}
 
-	m_Seen = Utility::GetTime();
+	m_Seen = Utility::GetCoarseTime();
 	m_PendingRequests++;
 
 	m_CurrentRequest.~HttpRequest();
 	new (&m_CurrentRequest) HttpRequest(m_Stream);
 
-	return false;
+	/* Parse the next request if the client has already sent it. */
+	return true;
 }
 
 bool HttpServerConnection::ManageHeaders(HttpResponse& response)
@@ -320,12 +368,34 @@ bool HttpServerConnection::ManageHeaders(HttpResponse& response)
 	return true;
 }
 
-void HttpServerConnection::ProcessMessageAsync(HttpRequest& request, HttpResponse& response, const ApiUser::Ptr& user)
+void HttpServerConnection::ProcessMessageAsync(HttpRequest& request, HttpResponse& response, const ApiUser::Ptr& user, double queued)
+{
+	response.RebindRequest(request);
+
+	try {
+		HttpHandler::ProcessRequest(user, request, response, queued);
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "HttpServerConnection")
+			<< "Unhandled exception while processing Http request: " << DiagnosticInformation(ex);
+		HttpUtility::SendJsonError(response, nullptr, 503, "Unhandled exception" , DiagnosticInformation(ex));
+	}
+
+	response.Finish();
+
+	if (request.RequestMethod != "GET")
+		m_PendingUpdates--;
+
+	m_PendingRequests--;
+	m_Stream->SetCorked(false);
+}
+
+void HttpServerConnection::ProcessPipelinedMessage(HttpRequest& request, HttpResponse& response,
+	const ApiUser::Ptr& user, double queued, const std::shared_ptr<PipelinedResponse>& pipelined)
 {
 	response.RebindRequest(request);
 
 	try {
-		HttpHandler::ProcessRequest(user, request, response);
+		HttpHandler::ProcessRequest(user, request, response, queued);
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "HttpServerConnection")
 			<< "Unhandled exception while processing Http request: " << DiagnosticInformation(ex);
@@ -333,10 +403,48 @@ void HttpServerConnection::ProcessMessageAsync(HttpRequest& request, HttpRespons
 	}
 
 	response.Finish();
+
+	boost::mutex::scoped_lock lock(pipelined->Mutex);
+	pipelined->Done = true;
+	pipelined->CV.notify_all();
+}
+
+void HttpServerConnection::SendPipelinedResponse(const std::shared_ptr<PipelinedResponse>& pipelined)
+{
+	{
+		boost::mutex::scoped_lock lock(pipelined->Mutex);
+
+		while (!pipelined->Done)
+			pipelined->CV.wait(lock);
+	}
+
+	const FIFO::Ptr& buffer = pipelined->Buffer;
+
+	while (buffer->IsDataAvailable()) {
+		char data[16 * 1024];
+		size_t count = buffer->Read(data, sizeof(data), true);
+		m_Stream->Write(data, count);
+	}
+
 	m_PendingRequests--;
 	m_Stream->SetCorked(false);
 }
 
+Dictionary::Ptr HttpServerConnection::GetStats()
+{
+	unsigned long connections = l_HttpConnections;
+	unsigned long requests = l_HttpRequests;
+	unsigned long keepAliveRequests = l_HttpKeepAliveRequests;
+
+	return new Dictionary({
+		{ "connections", connections },
+		{ "requests", requests },
+		{ "keepalive_requests", keepAliveRequests },
+		{ "pipelined_requests", static_cast<unsigned long>(l_HttpPipelinedRequests) },
+		{ "requests_per_connection", connections > 0 ? static_cast<double>(requests) / connections : 0 }
+	});
+}
+
 void HttpServerConnection::DataAvailableHandler()
 {
 	bool close = false;
@@ -364,21 +472,23 @@ void HttpServerConnection::DataAvailableHandler()
 		Disconnect();
 }
 
+/**
+ * Disconnects the client if it hasn't sent a request for 10 seconds and
+ * there are no pending requests. The timer is only rescheduled when it
+ * expires, i.e. new requests just update m_Seen.
+ */
 void HttpServerConnection::CheckLiveness()
 {
-	if (m_Seen < Utility::GetTime() - 10 && m_PendingRequests == 0) {
+	double now = Utility::GetTime();
+
+	if (m_Seen < now - 10 && m_PendingRequests == 0) {
 		Log(LogInformation, "HttpServerConnection")
 			<<  "No messages for Http connection have been received in the last 10 seconds.";
+
+		/* This stops the timer unless the I/O thread is busy, in which case we try again. */
 		Disconnect();
 	}
-}
-
-void HttpServerConnection::TimeoutTimerHandler()
-{
-	ApiListener::Ptr listener = ApiListener::GetInstance();
 
-	for (const HttpServerConnection::Ptr& client : listener->GetHttpClients()) {
-		client->CheckLiveness();
-	}
+	m_LivenessTimer->Reschedule(std::max(m_Seen + 10, now + 5));
 }
 
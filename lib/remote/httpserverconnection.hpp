@@ -24,12 +24,30 @@
 #include "remote/httpresponse.hpp"
 #include "remote/apiuser.hpp"
 #include "base/tlsstream.hpp"
+#include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include "base/fifo.hpp"
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <atomic>
 
 namespace icinga
 {
 
+/**
+ * The buffered response for a request which is processed while earlier
+ * requests on the same connection are still pending.
+ *
+ * @ingroup remote
+ */
+struct PipelinedResponse
+{
+	boost::mutex Mutex;
+	boost::condition_variable CV;
+	bool Done{false};
+	FIFO::Ptr Buffer{new FIFO()};
+};
+
 /**
  * An API client connection.
  *
@@ -50,6 +68,8 @@ public:
 
 	void Disconnect();
 
+	static Dictionary::Ptr GetStats();
+
 private:
 	ApiUser::Ptr m_ApiUser;
 	ApiUser::Ptr m_AuthenticatedUser;
@@ -58,7 +78,10 @@ private:
 	HttpRequest m_CurrentRequest;
 	boost::recursive_mutex m_DataHandlerMutex;
 	WorkQueue m_RequestQueue;
-	int m_PendingRequests;
+	std::atomic<int> m_PendingRequests;
+	std::atomic<int> m_PendingUpdates;
+	unsigned long m_RequestCount;
+	Timer::Ptr m_LivenessTimer;
 
 	StreamReadContext m_Context;
 
@@ -66,12 +89,14 @@ private:
 	void DataAvailableHandler();
 
 	static void StaticInitialize();
-	static void TimeoutTimerHandler();
 	void CheckLiveness();
 
 	bool ManageHeaders(HttpResponse& response);
 
-	void ProcessMessageAsync(HttpRequest& request, HttpResponse& response, const ApiUser::Ptr&);
+	void ProcessMessageAsync(HttpRequest& request, HttpResponse& response, const ApiUser::Ptr&, double queued);
+	static void ProcessPipelinedMessage(HttpRequest& request, HttpResponse& response, const ApiUser::Ptr& user,
+		double queued, const std::shared_ptr<PipelinedResponse>& pipelined);
+	void SendPipelinedResponse(const std::shared_ptr<PipelinedResponse>& pipelined);
 };
 
 }
@@ -20,6 +20,11 @@
 #include "remote/httputility.hpp"
 #include "base/json.hpp"
 #include "base/logger.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#ifdef HAVE_ZLIB
+#	include <zlib.h>
+#endif /* HAVE_ZLIB */
 
 using namespace icinga;
 
@@ -62,9 +67,9 @@ void HttpUtility::SendJsonBody(HttpResponse& response, const Dictionary::Ptr& pa
 	if (params)
 		prettyPrint = GetLastParameter(params, "pretty");
 
-	String body = JsonEncode(val, prettyPrint);
-
-	response.WriteBody(body.CStr(), body.GetLength());
+	JsonEncode(val, [&response](const char *data, size_t count) {
+		response.WriteBody(data, count);
+	}, prettyPrint);
 }
 
 Value HttpUtility::GetLastParameter(const Dictionary::Ptr& params, const String& key)
@@ -133,3 +138,49 @@ String HttpUtility::GetErrorNameByCode(const int code)
 	}
 }
 
+
+bool HttpUtility::IsCompressionSupported()
+{
+#ifdef HAVE_ZLIB
+	return true;
+#else /* HAVE_ZLIB */
+	return false;
+#endif /* HAVE_ZLIB */
+}
+
+/**
+ * Compresses a message body which is sent with "Content-Encoding: gzip".
+ *
+ * @param data The body.
+ * @returns The compressed body.
+ */
+String HttpUtility::GzipCompress(const String& data)
+{
+#ifdef HAVE_ZLIB
+	z_stream stream = {};
+
+	/* Adding 16 to the window bits selects the gzip format. */
+	int rc = deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+
+	if (rc != Z_OK)
+		BOOST_THROW_EXCEPTION(std::runtime_error("deflateInit2() failed with error code " + Convert::ToString(rc)));
+
+	std::string result(deflateBound(&stream, data.GetLength()), '\0');
+
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.CStr()));
+	stream.avail_in = data.GetLength();
+	stream.next_out = reinterpret_cast<Bytef *>(&result[0]);
+	stream.avail_out = result.size();
+
+	rc = deflate(&stream, Z_FINISH);
+	result.resize(stream.total_out);
+	deflateEnd(&stream);
+
+	if (rc != Z_STREAM_END)
+		BOOST_THROW_EXCEPTION(std::runtime_error("deflate() failed with error code " + Convert::ToString(rc)));
+
+	return result;
+#else /* HAVE_ZLIB */
+	BOOST_THROW_EXCEPTION(std::runtime_error("Icinga 2 was built without zlib support."));
+#endif /* HAVE_ZLIB */
+}
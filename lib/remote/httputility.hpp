@@ -42,6 +42,9 @@ public:
 	static void SendJsonError(HttpResponse& response, const Dictionary::Ptr& params, const int code,
 		const String& verbose = String(), const String& diagnosticInformation = String());
 
+	static bool IsCompressionSupported();
+	static String GzipCompress(const String& data);
+
 private:
 	static String GetErrorNameByCode(int code);
 
@@ -20,6 +20,7 @@
 #include "remote/jsonrpc.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
+#include "base/msgpack.hpp"
 #include "base/console.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/convert.hpp"
@@ -57,19 +58,39 @@ static bool GetDebugJsonRpcCached()
  * Sends a message to the connected peer and returns the bytes sent.
  *
  * @param message The message.
+ * @param encoding The encoding, MessagePack may only be used once the peer announced support for it.
  *
  * @return The amount of bytes sent.
  */
-size_t JsonRpc::SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message)
+size_t JsonRpc::SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message, JsonRpcEncoding encoding)
 {
-	String json = JsonEncode(message);
+	return NetString::WriteStringToStream(stream, EncodeMessage(message, encoding));
+}
+
+/**
+ * Encodes a message without the netstring framing.
+ *
+ * @param message The message.
+ * @param encoding The encoding.
+ *
+ * @return The encoded message.
+ */
+String JsonRpc::EncodeMessage(const Dictionary::Ptr& message, JsonRpcEncoding encoding)
+{
+	String data;
+
+	if (encoding == JsonRpcEncodingMsgPack)
+		data = MsgPackEncode(message);
+	else
+		data = JsonEncode(message);
 
 #ifdef I2_DEBUG
 	if (GetDebugJsonRpcCached())
-		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << ">> " << json << ConsoleColorTag(Console_Normal) << "\n";
+		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << ">> " << (encoding == JsonRpcEncodingMsgPack ? "(msgpack) " + JsonEncode(message) : data)
+			<< ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
-	return NetString::WriteStringToStream(stream, json);
+	return data;
 }
 
 StreamReadStatus JsonRpc::ReadMessage(const Stream::Ptr& stream, String *message, StreamReadContext& src, bool may_wait, ssize_t maxMessageLength)
@@ -84,15 +105,36 @@ StreamReadStatus JsonRpc::ReadMessage(const Stream::Ptr& stream, String *message
 
 #ifdef I2_DEBUG
 	if (GetDebugJsonRpcCached())
-		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << jsonString << ConsoleColorTag(Console_Normal) << "\n";
+		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << (IsMsgPackMessage(jsonString) ? "(msgpack)" : jsonString)
+			<< ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
 	return StatusNewItem;
 }
 
+/**
+ * Checks whether a message was MessagePack-encoded. Messages are always
+ * dictionaries: JSON messages start with '{' whereas MessagePack maps
+ * start with a map header.
+ */
+bool JsonRpc::IsMsgPackMessage(const String& message)
+{
+	if (message.IsEmpty())
+		return false;
+
+	auto type = static_cast<unsigned char>(message[0]);
+
+	return (type & 0xf0) == 0x80 || type == 0xde || type == 0xdf;
+}
+
 Dictionary::Ptr JsonRpc::DecodeMessage(const String& message)
 {
-	Value value = JsonDecode(message);
+	Value value;
+
+	if (IsMsgPackMessage(message))
+		value = MsgPackDecode(message);
+	else
+		value = JsonDecode(message);
 
 	if (!value.IsObjectType<Dictionary>()) {
 		BOOST_THROW_EXCEPTION(std::invalid_argument("JSON-RPC"
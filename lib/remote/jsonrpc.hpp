@@ -27,6 +27,17 @@
 namespace icinga
 {
 
+/**
+ * The encoding which is used for JSON-RPC messages.
+ *
+ * @ingroup remote
+ */
+enum JsonRpcEncoding
+{
+	JsonRpcEncodingJson,
+	JsonRpcEncodingMsgPack
+};
+
 /**
  * A JSON-RPC connection.
  *
@@ -35,10 +46,13 @@ namespace icinga
 class JsonRpc
 {
 public:
-	static size_t SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message);
+	static size_t SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message, JsonRpcEncoding encoding = JsonRpcEncodingJson);
+	static String EncodeMessage(const Dictionary::Ptr& message, JsonRpcEncoding encoding = JsonRpcEncodingJson);
 	static StreamReadStatus ReadMessage(const Stream::Ptr& stream, String *message, StreamReadContext& src, bool may_wait = false, ssize_t maxMessageLength = -1);
 	static Dictionary::Ptr DecodeMessage(const String& message);
 
+	static bool IsMsgPackMessage(const String& message);
+
 private:
 	JsonRpc();
 };
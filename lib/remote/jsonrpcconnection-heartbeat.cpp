@@ -20,6 +20,8 @@
 #include "remote/jsonrpcconnection.hpp"
 #include "remote/messageorigin.hpp"
 #include "remote/apifunction.hpp"
+#include "remote/apilistener.hpp"
+#include "remote/zone.hpp"
 #include "base/initialize.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
@@ -42,12 +44,23 @@ void JsonRpcConnection::HeartbeatTimerHandler()
 				continue;
 			}
 
+			Dictionary::Ptr params = new Dictionary({
+				{ "timeout", 120 },
+				{ "ts", Utility::GetTime() }
+			});
+
+			/* Used for the load-based distribution of the object authority. */
+			Endpoint::Ptr localEndpoint = Endpoint::GetLocalEndpoint();
+
+			if (localEndpoint) {
+				params->Set("load", localEndpoint->GetLoad());
+				params->Set("authority_factor", localEndpoint->GetAuthorityFactor());
+			}
+
 			Dictionary::Ptr request = new Dictionary({
 				{ "jsonrpc", "2.0" },
 				{ "method", "event::Heartbeat" },
-				{ "params", new Dictionary({
-					{ "timeout", 120 }
-				}) }
+				{ "params", params }
 			});
 
 			client->SendMessage(request);
@@ -64,6 +77,43 @@ Value JsonRpcConnection::HeartbeatAPIHandler(const MessageOrigin::Ptr& origin, c
 		origin->FromClient->m_HeartbeatTimeout = vtimeout;
 	}
 
+	Endpoint::Ptr endpoint = origin->FromClient->GetEndpoint();
+
+	/* Send the timestamp back so that the peer can measure the round-trip time.
+	 * Older versions don't send a timestamp. */
+	Value ts = params->Get("ts");
+
+	if (!ts.IsEmpty()) {
+		origin->FromClient->SendMessage(new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "event::Heartbeat" },
+			{ "params", new Dictionary({
+				{ "echo", ts }
+			}) }
+		}));
+	}
+
+	Value echo = params->Get("echo");
+
+	if (!echo.IsEmpty() && endpoint)
+		endpoint->AddRoundTripTime(Utility::GetTime() - static_cast<double>(echo));
+
+	if (endpoint) {
+		Value load = params->Get("load");
+
+		if (!load.IsEmpty())
+			endpoint->SetLoad(load);
+
+		Value factor = params->Get("authority_factor");
+
+		if (!factor.IsEmpty() && static_cast<double>(factor) > 0 && static_cast<double>(factor) != endpoint->GetAuthorityFactor()) {
+			endpoint->SetAuthorityFactor(factor);
+
+			if (endpoint->GetZone() == Zone::GetLocalZone())
+				ApiListener::UpdateObjectAuthority();
+		}
+	}
+
 	return Empty;
 }
 
@@ -35,12 +35,14 @@ static Value SetLogPositionHandler(const MessageOrigin::Ptr& origin, const Dicti
 REGISTER_APIFUNCTION(SetLogPosition, log, &SetLogPositionHandler);
 
 static boost::once_flag l_JsonRpcConnectionOnceFlag = BOOST_ONCE_INIT;
-static Timer::Ptr l_JsonRpcConnectionTimeoutTimer;
 static WorkQueue *l_JsonRpcConnectionWorkQueues;
 static size_t l_JsonRpcConnectionWorkQueueCount;
 static int l_JsonRpcConnectionNextID;
 static Timer::Ptr l_HeartbeatTimer;
 
+/* Buffered messages are written once they exceed this size. */
+#define JSONRPC_SEND_BUFFER_SIZE (64 * 1024)
+
 JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 	TlsStream::Ptr stream, ConnectionRole role)
 	: m_ID(l_JsonRpcConnectionNextID++), m_Identity(identity), m_Authenticated(authenticated), m_Stream(std::move(stream)),
@@ -54,11 +56,6 @@ JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 
 void JsonRpcConnection::StaticInitialize()
 {
-	l_JsonRpcConnectionTimeoutTimer = new Timer();
-	l_JsonRpcConnectionTimeoutTimer->OnTimerExpired.connect(std::bind(&JsonRpcConnection::TimeoutTimerHandler));
-	l_JsonRpcConnectionTimeoutTimer->SetInterval(15);
-	l_JsonRpcConnectionTimeoutTimer->Start();
-
 	l_JsonRpcConnectionWorkQueueCount = Application::GetConcurrency();
 	l_JsonRpcConnectionWorkQueues = new WorkQueue[l_JsonRpcConnectionWorkQueueCount];
 
@@ -66,7 +63,7 @@ void JsonRpcConnection::StaticInitialize()
 		l_JsonRpcConnectionWorkQueues[i].SetName("JsonRpcConnection, #" + Convert::ToString(i));
 	}
 
-	l_HeartbeatTimer = new Timer();
+	l_HeartbeatTimer = new Timer("JsonRpcConnection heartbeat");
 	l_HeartbeatTimer->OnTimerExpired.connect(std::bind(&JsonRpcConnection::HeartbeatTimerHandler));
 	l_HeartbeatTimer->SetInterval(10);
 	l_HeartbeatTimer->Start();
@@ -74,6 +71,21 @@ void JsonRpcConnection::StaticInitialize()
 
 void JsonRpcConnection::Start()
 {
+	/* The timers hold owning references to this object until Disconnect() is called. */
+	m_LivenessTimer = new Timer("JsonRpcConnection liveness");
+	m_LivenessTimer->OnTimerExpired.connect(std::bind(&JsonRpcConnection::CheckLiveness, JsonRpcConnection::Ptr(this)));
+	m_LivenessTimer->Start();
+	m_LivenessTimer->Reschedule(Utility::GetTime() + 60);
+
+	if (m_Endpoint) {
+		m_LogPositionTimer = new Timer("JsonRpcConnection log position");
+		m_LogPositionTimer->OnTimerExpired.connect(std::bind(&JsonRpcConnection::SendLogPosition, JsonRpcConnection::Ptr(this)));
+		m_LogPositionTimer->Start();
+
+		/* This also replaces older connections to the same endpoint. */
+		ScheduleLogPosition();
+	}
+
 	/* the stream holds an owning reference to this object through the callback we're registering here */
 	m_Stream->RegisterDataHandler(std::bind(&JsonRpcConnection::DataAvailableHandler, JsonRpcConnection::Ptr(this)));
 	if (m_Stream->IsDataAvailable())
@@ -110,19 +122,118 @@ ConnectionRole JsonRpcConnection::GetRole() const
 	return m_Role;
 }
 
+JsonRpcEncoding JsonRpcConnection::GetEncoding() const
+{
+	ObjectLock olock(m_Stream);
+	return m_Encoding;
+}
+
+/**
+ * Changes the encoding for messages sent to the peer. Received messages
+ * are decoded according to their own format.
+ */
+void JsonRpcConnection::SetEncoding(JsonRpcEncoding encoding)
+{
+	ObjectLock olock(m_Stream);
+	m_Encoding = encoding;
+}
+
+/**
+ * Compresses all messages which are sent after this call. The peer
+ * must have announced that it is able to decompress them.
+ */
+void JsonRpcConnection::EnableCompression()
+{
+	boost::mutex::scoped_lock lock(m_SendBufferMutex);
+
+	if (!m_Compressor)
+		m_Compressor.reset(new MessageCompressor());
+}
+
+/**
+ * Marks the connection's peer as able to process the batched variants of
+ * event::ExecuteCommand and event::CheckResult.
+ */
+void JsonRpcConnection::EnableBatching()
+{
+	m_Batching.store(true);
+}
+
+bool JsonRpcConnection::IsBatchingEnabled() const
+{
+	return m_Batching.load();
+}
+
+/**
+ * Remembers the parameters of the peer's icinga::Hello message.
+ */
+void JsonRpcConnection::SetHello(const Dictionary::Ptr& params)
+{
+	boost::mutex::scoped_lock lock(m_HelloMutex);
+	m_Hello = params;
+	m_HelloCV.notify_all();
+}
+
+/**
+ * Waits until the peer's icinga::Hello message was processed. Older
+ * versions don't answer our own hello, so callers should only rely on
+ * the result when the peer was the connecting side.
+ *
+ * @param timeout How long to wait, in seconds.
+ * @returns The hello message's parameters, or an empty pointer on timeout.
+ */
+Dictionary::Ptr JsonRpcConnection::WaitForHello(double timeout)
+{
+	boost::mutex::scoped_lock lock(m_HelloMutex);
+
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(static_cast<long>(timeout * 1000));
+
+	while (!m_Hello && !m_Stream->IsEof()) {
+		if (!m_HelloCV.timed_wait(lock, deadline))
+			break;
+	}
+
+	return m_Hello;
+}
+
+Dictionary::Ptr JsonRpcConnection::GetConfigSyncFiles() const
+{
+	return m_ConfigSyncFiles;
+}
+
+Dictionary::Ptr JsonRpcConnection::GetConfigSyncTransfer() const
+{
+	return m_ConfigSyncTransfer;
+}
+
 void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
 {
 	try {
-		ObjectLock olock(m_Stream);
-
 		if (m_Stream->IsEof())
 			return;
 
-		size_t bytesSent = JsonRpc::SendMessage(m_Stream, message);
+		SendRawMessage(JsonRpc::EncodeMessage(message, GetEncoding()));
+	} catch (const std::exception& ex) {
+		std::ostringstream info;
+		info << "Error while sending JSON-RPC message for identity '" << m_Identity << "'";
+		Log(LogWarning, "JsonRpcConnection")
+			<< info.str() << "\n" << DiagnosticInformation(ex);
 
-		if (m_Endpoint)
-			m_Endpoint->AddMessageSent(bytesSent);
+		Disconnect();
+	}
+}
+
+/**
+ * Sends a message which is shared with other connections. It's only
+ * encoded if no other connection with the same encoding did so before.
+ */
+void JsonRpcConnection::SendMessage(const EncodedMessage::Ptr& message)
+{
+	try {
+		if (m_Stream->IsEof())
+			return;
 
+		SendRawMessage(message->GetEncoded(GetEncoding()));
 	} catch (const std::exception& ex) {
 		std::ostringstream info;
 		info << "Error while sending JSON-RPC message for identity '" << m_Identity << "'";
@@ -133,6 +244,214 @@ void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
 	}
 }
 
+/**
+ * Queues an already encoded message for sending. Messages are collected
+ * in a per-connection buffer which is written to the stream in one go
+ * once it exceeds the size threshold or when the flush callback which
+ * is queued for the first buffered message runs, whichever comes first.
+ *
+ * @param data The encoded message without the netstring framing.
+ */
+void JsonRpcConnection::SendRawMessage(const String& data)
+{
+	if (m_Stream->IsEof())
+		return;
+
+	size_t bytes;
+
+	{
+		boost::mutex::scoped_lock lock(m_SendBufferMutex);
+
+		/* Messages must be compressed in the order in which they're written. */
+		String compressed;
+
+		if (m_Compressor) {
+			double start = Utility::GetTime();
+			compressed = m_Compressor->Compress(data);
+
+			if (m_Endpoint)
+				m_Endpoint->AddCompressedMessage(data.GetLength(), compressed.GetLength(), Utility::GetTime() - start);
+		}
+
+		const String& payload = m_Compressor ? compressed : data;
+
+		String header = Convert::ToString(payload.GetLength()) + ":";
+		bytes = header.GetLength() + payload.GetLength() + 1;
+
+		if (payload.GetLength() >= JSONRPC_SEND_BUFFER_SIZE) {
+			/* Don't copy large messages (e.g. config updates) into the buffer. */
+			FlushSendBufferInternal(lock);
+
+			m_Stream->Write(header.CStr(), header.GetLength());
+			m_Stream->Write(payload.CStr(), payload.GetLength());
+			m_Stream->Write(",", 1);
+
+			if (m_Endpoint)
+				m_Endpoint->AddFlush(bytes, 0);
+		} else {
+			if (m_SendBuffer.IsEmpty())
+				m_SendBufferSince = Utility::GetTime();
+
+			m_SendBuffer += header;
+			m_SendBuffer += payload;
+			m_SendBuffer += ',';
+
+			if (m_SendBuffer.GetLength() >= JSONRPC_SEND_BUFFER_SIZE)
+				FlushSendBufferInternal(lock);
+			else if (!m_FlushPending) {
+				m_FlushPending = true;
+				Utility::QueueAsyncCallback(std::bind(&JsonRpcConnection::FlushSendBuffer, JsonRpcConnection::Ptr(this)));
+			}
+		}
+
+		m_BytesQueued += bytes;
+		m_QueuedMessageEnds.push_back(m_BytesQueued);
+
+		size_t queued = UpdateSendQueue(lock);
+
+		ApiListener::Ptr listener = ApiListener::GetInstance();
+
+		if (listener && m_Endpoint) {
+			int highWatermark = listener->GetSendQueueHighWatermark();
+			int lowWatermark = listener->GetSendQueueLowWatermark();
+
+			if (!m_SendQueueSpilled && highWatermark > 0 && queued > static_cast<size_t>(highWatermark)) {
+				Log(LogWarning, "JsonRpcConnection")
+					<< "Send queue for endpoint '" << m_Endpoint->GetName() << "' exceeds " << highWatermark
+					<< " bytes. Writing messages to the replay log until it has drained.";
+
+				m_SendQueueSpilled = true;
+			} else if (m_SendQueueSpilled && !m_SendQueueResumePending && queued <= static_cast<size_t>(std::max(lowWatermark, 0))) {
+				Log(LogInformation, "JsonRpcConnection")
+					<< "Send queue for endpoint '" << m_Endpoint->GetName() << "' has drained. Replaying the messages which were logged in the meantime.";
+
+				m_SendQueueResumePending = true;
+				listener->ResumeSpilledClient(this);
+			}
+		}
+	}
+
+	if (m_Endpoint)
+		m_Endpoint->AddMessageSent(bytes);
+}
+
+void JsonRpcConnection::FlushSendBuffer()
+{
+	try {
+		boost::mutex::scoped_lock lock(m_SendBufferMutex);
+
+		m_FlushPending = false;
+
+		FlushSendBufferInternal(lock);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "JsonRpcConnection")
+			<< "Error while sending JSON-RPC messages for identity '" << m_Identity << "'\n" << DiagnosticInformation(ex);
+
+		Disconnect();
+	}
+}
+
+/**
+ * Writes the buffered messages to the stream.
+ *
+ * @param lock The lock for m_SendBufferMutex, which must be held by the caller.
+ */
+void JsonRpcConnection::FlushSendBufferInternal(boost::mutex::scoped_lock& lock)
+{
+	ASSERT(lock.owns_lock());
+
+	if (m_SendBuffer.IsEmpty())
+		return;
+
+	size_t bytes = m_SendBuffer.GetLength();
+
+	if (!m_Stream->IsEof())
+		m_Stream->Write(m_SendBuffer.CStr(), bytes);
+
+	m_SendBuffer.Clear();
+
+	if (m_Endpoint)
+		m_Endpoint->AddFlush(bytes, Utility::GetTime() - m_SendBufferSince);
+}
+
+/**
+ * Drops the messages which left the stream's send queue from the
+ * accounting and returns the number of bytes which are still queued.
+ *
+ * @param lock The lock for m_SendBufferMutex, which must be held by the caller.
+ */
+size_t JsonRpcConnection::UpdateSendQueue(boost::mutex::scoped_lock& lock)
+{
+	ASSERT(lock.owns_lock());
+
+	size_t queued = m_SendBuffer.GetLength() + m_Stream->GetSendQueueSize();
+	uint_fast64_t sent = m_BytesQueued - queued;
+
+	while (!m_QueuedMessageEnds.empty() && m_QueuedMessageEnds.front() <= sent)
+		m_QueuedMessageEnds.pop_front();
+
+	return queued;
+}
+
+/**
+ * Returns the number of bytes which were queued for this connection but
+ * haven't been sent yet.
+ */
+size_t JsonRpcConnection::GetSendQueueBytes()
+{
+	boost::mutex::scoped_lock lock(m_SendBufferMutex);
+	return UpdateSendQueue(lock);
+}
+
+/**
+ * Returns the number of messages which were at least partially queued for
+ * this connection but haven't been sent completely yet.
+ */
+size_t JsonRpcConnection::GetSendQueueMessages()
+{
+	boost::mutex::scoped_lock lock(m_SendBufferMutex);
+	UpdateSendQueue(lock);
+	return m_QueuedMessageEnds.size();
+}
+
+bool JsonRpcConnection::IsSendQueueSpilled() const
+{
+	return m_SendQueueSpilled;
+}
+
+/**
+ * Sends messages to this connection directly again. Called by the
+ * ApiListener once the messages which were logged while the send
+ * queue was spilled have been replayed.
+ */
+void JsonRpcConnection::ResumeSendQueue()
+{
+	boost::mutex::scoped_lock lock(m_SendBufferMutex);
+
+	m_SendQueueSpilled = false;
+	m_SendQueueResumePending = false;
+}
+
+/**
+ * Blocks while the send queue exceeds the high watermark, e.g. to keep the
+ * replay log from queueing the whole log in memory.
+ */
+void JsonRpcConnection::WaitForSendQueue()
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return;
+
+	int highWatermark = listener->GetSendQueueHighWatermark();
+
+	if (highWatermark <= 0)
+		return;
+
+	while (!m_Stream->IsEof() && GetSendQueueBytes() > static_cast<size_t>(highWatermark))
+		Utility::Sleep(0.1);
+}
+
 void JsonRpcConnection::Disconnect()
 {
 	Log(LogWarning, "JsonRpcConnection")
@@ -140,6 +459,16 @@ void JsonRpcConnection::Disconnect()
 
 	m_Stream->Close();
 
+	if (m_LivenessTimer) {
+		m_LivenessTimer->Stop();
+		m_LivenessTimer->OnTimerExpired.disconnect_all_slots();
+	}
+
+	if (m_LogPositionTimer) {
+		m_LogPositionTimer->Stop();
+		m_LogPositionTimer->OnTimerExpired.disconnect_all_slots();
+	}
+
 	if (m_Endpoint)
 		m_Endpoint->RemoveClient(this);
 	else {
@@ -148,42 +477,65 @@ void JsonRpcConnection::Disconnect()
 	}
 }
 
-void JsonRpcConnection::MessageHandlerWrapper(const String& jsonString)
+void JsonRpcConnection::MessageHandlerWrapper(const Dictionary::Ptr& message)
 {
-	if (m_Stream->IsEof())
-		return;
-
-	try {
-		MessageHandler(jsonString);
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "JsonRpcConnection")
-			<< "Error while reading JSON-RPC message for identity '" << m_Identity
-			<< "': " << DiagnosticInformation(ex);
-
-		Disconnect();
+	if (!m_Stream->IsEof()) {
+		try {
+			MessageHandler(message);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "JsonRpcConnection")
+				<< "Error while reading JSON-RPC message for identity '" << m_Identity
+				<< "': " << DiagnosticInformation(ex);
 
-		return;
+			Disconnect();
+		}
 	}
+
+	/* Read more messages once all messages from the last batch were processed. */
+	if (--m_PendingMessages == 0)
+		m_Stream->SetCorked(false);
 }
 
-void JsonRpcConnection::MessageHandler(const String& jsonString)
+/**
+ * Returns the work queue for a message. Messages which refer to the same
+ * host (or one of its services) always use the same queue, which keeps them
+ * in order while messages for other hosts are processed in parallel. All
+ * other messages use the connection's queue.
+ *
+ * @param message The message.
+ * @returns The work queue.
+ */
+WorkQueue& JsonRpcConnection::GetWorkQueue(const Dictionary::Ptr& message) const
 {
-	Dictionary::Ptr message = JsonRpc::DecodeMessage(jsonString);
+	Dictionary::Ptr params = message->Get("params");
+	String key;
 
-	m_Seen = Utility::GetTime();
+	if (params) {
+		key = params->Get("host");
 
-	if (m_HeartbeatTimeout != 0)
-		m_NextHeartbeat = Utility::GetTime() + m_HeartbeatTimeout;
+		/* config::UpdateObject and friends: Service, Comment and Downtime names start with the host name. */
+		if (key.IsEmpty()) {
+			String name = params->Get("name");
+			key = name.SubStr(0, name.FindFirstOf("!"));
+		}
+	}
 
-	if (m_Endpoint && message->Contains("ts")) {
-		double ts = message->Get("ts");
+	size_t index;
 
-		/* ignore old messages */
-		if (ts < m_Endpoint->GetRemoteLogPosition())
-			return;
+	if (key.IsEmpty())
+		index = m_ID % l_JsonRpcConnectionWorkQueueCount;
+	else
+		index = std::hash<std::string>()(key.GetData()) % l_JsonRpcConnectionWorkQueueCount;
 
-		m_Endpoint->SetRemoteLogPosition(ts);
-	}
+	return l_JsonRpcConnectionWorkQueues[index];
+}
+
+void JsonRpcConnection::MessageHandler(const Dictionary::Ptr& message)
+{
+	m_Seen = Utility::GetCoarseTime();
+
+	if (m_HeartbeatTimeout != 0)
+		m_NextHeartbeat = Utility::GetTime() + m_HeartbeatTimeout;
 
 	MessageOrigin::Ptr origin = new MessageOrigin();
 	origin->FromClient = this;
@@ -193,8 +545,6 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 			origin->FromZone = m_Endpoint->GetZone();
 		else
 			origin->FromZone = Zone::GetByName(message->Get("originZone"));
-
-		m_Endpoint->AddMessageReceived(jsonString.GetLength());
 	}
 
 	Value vmethod;
@@ -226,9 +576,14 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 				<< "Call to non-existent function '" << method << "' from endpoint '" << m_Identity << "'.";
 		} else {
 			Dictionary::Ptr params = message->Get("params");
-			if (params)
+			if (params) {
+				double start = Utility::GetTime();
+
 				resultMessage->Set("result", afunc->Invoke(origin, params));
-			else
+
+				if (m_Endpoint)
+					m_Endpoint->AddMessageProcessed(method, Utility::GetTime() - start);
+			} else
 				resultMessage->Set("result", Empty);
 		}
 	} catch (const std::exception& ex) {
@@ -260,7 +615,43 @@ bool JsonRpcConnection::ProcessMessage()
 	if (srs != StatusNewItem)
 		return false;
 
-	l_JsonRpcConnectionWorkQueues[m_ID % l_JsonRpcConnectionWorkQueueCount].Enqueue(std::bind(&JsonRpcConnection::MessageHandlerWrapper, JsonRpcConnection::Ptr(this), message));
+	/* Compressed messages have to be decompressed in the order in which they were received. */
+	if (MessageDecompressor::IsCompressedMessage(message)) {
+		if (!m_Endpoint)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Compressed messages are only accepted from endpoints."));
+
+		if (!m_Decompressor)
+			m_Decompressor.reset(new MessageDecompressor());
+
+		double start = Utility::GetTime();
+		size_t compressedLength = message.GetLength();
+
+		message = m_Decompressor->Decompress(message);
+
+		m_Endpoint->AddDecompressedMessage(compressedLength, message.GetLength(), Utility::GetTime() - start);
+	}
+
+	Dictionary::Ptr decodedMessage = JsonRpc::DecodeMessage(message);
+
+	if (m_Endpoint) {
+		/* This has to happen in the order in which messages were received, not when they're processed. */
+		if (decodedMessage->Contains("ts")) {
+			double ts = decodedMessage->Get("ts");
+
+			/* ignore old messages */
+			if (ts < m_Endpoint->GetRemoteLogPosition())
+				return true;
+
+			m_Endpoint->SetRemoteLogPosition(ts);
+
+			ScheduleLogPosition();
+		}
+
+		m_Endpoint->AddMessageReceived(message.GetLength());
+	}
+
+	m_PendingMessages++;
+	GetWorkQueue(decodedMessage).Enqueue(std::bind(&JsonRpcConnection::MessageHandlerWrapper, JsonRpcConnection::Ptr(this), decodedMessage));
 
 	return true;
 }
@@ -290,7 +681,9 @@ void JsonRpcConnection::DataAvailableHandler()
 			return;
 		}
 
-		l_JsonRpcConnectionWorkQueues[m_ID % l_JsonRpcConnectionWorkQueueCount].Enqueue(std::bind(&Stream::SetCorked, m_Stream, false));
+		/* The last message handler uncorks the stream. */
+		if (m_PendingMessages == 0)
+			m_Stream->SetCorked(false);
 	} else
 		close = true;
 
@@ -306,34 +699,87 @@ Value SetLogPositionHandler(const MessageOrigin::Ptr& origin, const Dictionary::
 	if (!endpoint)
 		return Empty;
 
-	if (log_position > endpoint->GetLocalLogPosition())
+	if (log_position > endpoint->GetLocalLogPosition()) {
 		endpoint->SetLocalLogPosition(log_position);
 
+		/* The endpoint might not need some of the replay log files anymore. */
+		ApiListener::Ptr listener = ApiListener::GetInstance();
+
+		if (listener)
+			listener->ScheduleLogCleanup();
+	}
+
 	return Empty;
 }
 
+/**
+ * Disconnects the client if it hasn't sent anything for 60 seconds. The
+ * timer is only rescheduled when it expires, i.e. received messages just
+ * update m_Seen.
+ */
 void JsonRpcConnection::CheckLiveness()
 {
-	if (m_Seen < Utility::GetTime() - 60 && (!m_Endpoint || !m_Endpoint->GetSyncing())) {
-		Log(LogInformation, "JsonRpcConnection")
-			<<  "No messages for identity '" << m_Identity << "' have been received in the last 60 seconds.";
-		Disconnect();
+	double now = Utility::GetTime();
+
+	if (m_Seen < now - 60) {
+		if (!m_Endpoint || !m_Endpoint->GetSyncing()) {
+			Log(LogInformation, "JsonRpcConnection")
+				<<  "No messages for identity '" << m_Identity << "' have been received in the last 60 seconds.";
+			Disconnect();
+			return;
+		}
+
+		/* Check again after the replay log was sent. */
+		m_LivenessTimer->Reschedule(now + 15);
+		return;
 	}
+
+	m_LivenessTimer->Reschedule(m_Seen + 60);
 }
 
-void JsonRpcConnection::TimeoutTimerHandler()
+/**
+ * Tells the endpoint which of its messages we've received in a few seconds.
+ * Further messages which arrive in the meantime don't reschedule the timer.
+ */
+void JsonRpcConnection::ScheduleLogPosition()
 {
-	ApiListener::Ptr listener = ApiListener::GetInstance();
+	if (!m_LogPositionPending.exchange(true))
+		m_LogPositionTimer->Reschedule(Utility::GetTime() + 5);
+}
 
-	for (const JsonRpcConnection::Ptr& client : listener->GetAnonymousClients()) {
-		client->CheckLiveness();
-	}
+void JsonRpcConnection::SendLogPosition()
+{
+	m_LogPositionPending = false;
 
-	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
-		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
-			client->CheckLiveness();
+	/* Only the newest connection to an endpoint is used. */
+	for (const JsonRpcConnection::Ptr& client : m_Endpoint->GetClients()) {
+		if (client->GetTimestamp() > m_Timestamp) {
+			Disconnect();
+			return;
 		}
 	}
+
+	for (const JsonRpcConnection::Ptr& client : m_Endpoint->GetClients()) {
+		if (client->GetTimestamp() < m_Timestamp)
+			client->Disconnect();
+	}
+
+	double ts = m_Endpoint->GetRemoteLogPosition();
+
+	if (ts == 0)
+		return;
+
+	SendMessage(new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "log::SetLogPosition" },
+		{ "params", new Dictionary({
+			{ "log_position", ts }
+		}) }
+	}));
+
+	Log(LogNotice, "JsonRpcConnection")
+		<< "Setting log position for identity '" << m_Identity << "': "
+		<< Utility::FormatDateTime("%Y/%m/%d %H:%M:%S", ts);
 }
 
 size_t JsonRpcConnection::GetWorkQueueCount()
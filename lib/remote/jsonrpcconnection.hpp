@@ -22,9 +22,15 @@
 
 #include "remote/i2-remote.hpp"
 #include "remote/endpoint.hpp"
+#include "remote/jsonrpc.hpp"
+#include "remote/encodedmessage.hpp"
+#include "remote/messagecompressor.hpp"
 #include "base/tlsstream.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <atomic>
+#include <deque>
 
 namespace icinga
 {
@@ -64,9 +70,31 @@ public:
 	TlsStream::Ptr GetStream() const;
 	ConnectionRole GetRole() const;
 
+	JsonRpcEncoding GetEncoding() const;
+	void SetEncoding(JsonRpcEncoding encoding);
+
+	void EnableCompression();
+
+	void EnableBatching();
+	bool IsBatchingEnabled() const;
+
+	void SetHello(const Dictionary::Ptr& params);
+	Dictionary::Ptr WaitForHello(double timeout);
+
+	Dictionary::Ptr GetConfigSyncFiles() const;
+	Dictionary::Ptr GetConfigSyncTransfer() const;
+
 	void Disconnect();
 
 	void SendMessage(const Dictionary::Ptr& request);
+	void SendMessage(const EncodedMessage::Ptr& message);
+	void SendRawMessage(const String& data);
+
+	size_t GetSendQueueBytes();
+	size_t GetSendQueueMessages();
+	bool IsSendQueueSpilled() const;
+	void ResumeSendQueue();
+	void WaitForSendQueue();
 
 	static void HeartbeatTimerHandler();
 	static Value HeartbeatAPIHandler(const intrusive_ptr<MessageOrigin>& origin, const Dictionary::Ptr& params);
@@ -84,22 +112,60 @@ private:
 	Endpoint::Ptr m_Endpoint;
 	TlsStream::Ptr m_Stream;
 	ConnectionRole m_Role;
+	JsonRpcEncoding m_Encoding{JsonRpcEncodingJson};
 	double m_Timestamp;
 	double m_Seen;
 	double m_NextHeartbeat;
 	double m_HeartbeatTimeout;
 	boost::mutex m_DataHandlerMutex;
 
+	/* One-shot timers which are only rescheduled when there is something to do. */
+	Timer::Ptr m_LivenessTimer;
+	Timer::Ptr m_LogPositionTimer;
+	std::atomic<bool> m_LogPositionPending{false};
+
+	boost::mutex m_SendBufferMutex;
+	String m_SendBuffer;
+	double m_SendBufferSince{0};
+	bool m_FlushPending{false};
+
+	/* Total number of bytes queued so far and the offsets at which the
+	 * messages which haven't been sent yet end. */
+	uint_fast64_t m_BytesQueued{0};
+	std::deque<uint_fast64_t> m_QueuedMessageEnds;
+	std::atomic<bool> m_SendQueueSpilled{false};
+	bool m_SendQueueResumePending{false};
+	std::unique_ptr<MessageCompressor> m_Compressor;
+	std::unique_ptr<MessageDecompressor> m_Decompressor;
+	std::atomic<bool> m_Batching{false};
+
+	boost::mutex m_HelloMutex;
+	boost::condition_variable m_HelloCV;
+	Dictionary::Ptr m_Hello;
+
+	/* Config files which were received in chunks, see ApiListener::ConfigFileChunkHandler(). */
+	Dictionary::Ptr m_ConfigSyncFiles{new Dictionary()};
+
+	/* The state of a resumable config file transfer, see ApiListener::ConfigManifestHandler(). */
+	Dictionary::Ptr m_ConfigSyncTransfer{new Dictionary()};
+
 	StreamReadContext m_Context;
+	std::atomic<int> m_PendingMessages{0};
 
 	bool ProcessMessage();
-	void MessageHandlerWrapper(const String& jsonString);
-	void MessageHandler(const String& jsonString);
+	void MessageHandlerWrapper(const Dictionary::Ptr& message);
+	void MessageHandler(const Dictionary::Ptr& message);
+	WorkQueue& GetWorkQueue(const Dictionary::Ptr& message) const;
 	void DataAvailableHandler();
 
+	void FlushSendBuffer();
+	void FlushSendBufferInternal(boost::mutex::scoped_lock& lock);
+	size_t UpdateSendQueue(boost::mutex::scoped_lock& lock);
+
 	static void StaticInitialize();
-	static void TimeoutTimerHandler();
 	void CheckLiveness();
+	void ScheduleLogPosition();
+	void SendLogPosition();
 
 	void CertificateRequestResponseHandler(const Dictionary::Ptr& message);
 };
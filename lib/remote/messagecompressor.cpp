@@ -0,0 +1,241 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/messagecompressor.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#ifdef HAVE_ZLIB
+#	include <zlib.h>
+#endif /* HAVE_ZLIB */
+
+using namespace icinga;
+
+/* Compressed messages start with this byte, JSON and MessagePack messages never do. */
+#define COMPRESSED_MESSAGE_MARKER '\x01'
+
+#ifdef HAVE_ZLIB
+/* Content which is common to most cluster messages. Both peers must use the
+ * same dictionary. The most frequent strings are at the end because deflate
+ * encodes shorter distances more efficiently.
+ */
+static const char l_MessageDictionary[] =
+	"\"type\":\"Downtime\"\"type\":\"Comment\"config::UpdateObjectconfig::DeleteObject"
+	"event::SetAcknowledgementevent::ClearAcknowledgementevent::SendNotifications"
+	"event::NotificationSentUserevent::NotificationSentToAllUsersevent::SetForceNextCheck"
+	"event::SetForceNextNotificationevent::SetNextNotificationevent::ExecuteCommand"
+	"\"notification\":\"users\":\"notification_type\":\"author\":\"text\":\"expiry\":"
+	"log::SetLogPosition\"log_position\":event::Heartbeat\"timeout\":"
+	"\"vars_after\":{\"attempt\":1.0,\"reachable\":true,\"state\":0.0,\"state_type\":1.0}"
+	"\"vars_before\":{\"attempt\":1.0,\"reachable\":true,\"state\":0.0,\"state_type\":1.0}"
+	"\"performance_data\":[\"ttl\":0.0,\"type\":\"CheckResult\"},"
+	"\"schedule_end\":\"schedule_start\":\"state\":0.0,\"active\":true,\"check_source\":"
+	"\"command\":[\"/usr/lib/nagios/plugins/check_\"execution_end\":\"execution_start\":"
+	"\"exit_status\":0.0,\"output\":\"OK - \"next_check\":event::SetNextCheck"
+	"{\"jsonrpc\":\"2.0\",\"method\":\"event::CheckResult\",\"params\":{\"cr\":{"
+	"\"host\":\"service\":\"originZone\":\"secobj\":{\"name\":\"type\":\"Service\"},\"ts\":";
+
+struct icinga::MessageCompressorState
+{
+	z_stream Stream;
+};
+
+/* The trailer of an empty stored block, which is produced by each sync flush. */
+static const unsigned char l_SyncTrailer[] = { 0x00, 0x00, 0xff, 0xff };
+
+static void ThrowZlibError(const char *function, int rc)
+{
+	BOOST_THROW_EXCEPTION(std::runtime_error(String(function) + "() failed with error code " + Convert::ToString(rc)));
+}
+#endif /* HAVE_ZLIB */
+
+MessageCompressor::MessageCompressor()
+{
+#ifdef HAVE_ZLIB
+	m_State.reset(new MessageCompressorState());
+
+	int rc = deflateInit2(&m_State->Stream, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+	if (rc != Z_OK)
+		ThrowZlibError("deflateInit2", rc);
+
+	rc = deflateSetDictionary(&m_State->Stream, reinterpret_cast<const Bytef *>(l_MessageDictionary), sizeof(l_MessageDictionary) - 1);
+
+	if (rc != Z_OK) {
+		deflateEnd(&m_State->Stream);
+		ThrowZlibError("deflateSetDictionary", rc);
+	}
+#else /* HAVE_ZLIB */
+	BOOST_THROW_EXCEPTION(std::runtime_error("Message compression is not supported by this build."));
+#endif /* HAVE_ZLIB */
+}
+
+MessageCompressor::~MessageCompressor()
+{
+#ifdef HAVE_ZLIB
+	if (m_State)
+		deflateEnd(&m_State->Stream);
+#endif /* HAVE_ZLIB */
+}
+
+/**
+ * Checks whether this build can compress and decompress messages.
+ */
+bool MessageCompressor::IsSupported()
+{
+#ifdef HAVE_ZLIB
+	return true;
+#else /* HAVE_ZLIB */
+	return false;
+#endif /* HAVE_ZLIB */
+}
+
+/**
+ * Compresses a message. The result can only be decompressed when all
+ * previously compressed messages have been decompressed as well.
+ *
+ * @param message The encoded message.
+ * @returns The compressed message.
+ */
+String MessageCompressor::Compress(const String& message)
+{
+#ifdef HAVE_ZLIB
+	z_stream& stream = m_State->Stream;
+
+	std::string result;
+	result.resize(1 + deflateBound(&stream, message.GetLength()) + 16);
+	result[0] = COMPRESSED_MESSAGE_MARKER;
+
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(message.CStr()));
+	stream.avail_in = message.GetLength();
+
+	size_t length = 1;
+
+	do {
+		if (length == result.size())
+			result.resize(result.size() * 2);
+
+		stream.next_out = reinterpret_cast<Bytef *>(&result[length]);
+		stream.avail_out = result.size() - length;
+
+		int rc = deflate(&stream, Z_SYNC_FLUSH);
+
+		if (rc != Z_OK && rc != Z_BUF_ERROR)
+			ThrowZlibError("deflate", rc);
+
+		length = result.size() - stream.avail_out;
+	} while (stream.avail_out == 0);
+
+	/* Every message ends with the same sync flush trailer, the peer adds it again. */
+	if (length >= 1 + sizeof(l_SyncTrailer) && memcmp(&result[length - sizeof(l_SyncTrailer)], l_SyncTrailer, sizeof(l_SyncTrailer)) == 0)
+		length -= sizeof(l_SyncTrailer);
+
+	result.resize(length);
+
+	return result;
+#else /* HAVE_ZLIB */
+	(void)message;
+	BOOST_THROW_EXCEPTION(std::runtime_error("Message compression is not supported by this build."));
+#endif /* HAVE_ZLIB */
+}
+
+MessageDecompressor::MessageDecompressor()
+{
+#ifdef HAVE_ZLIB
+	m_State.reset(new MessageCompressorState());
+
+	int rc = inflateInit2(&m_State->Stream, -MAX_WBITS);
+
+	if (rc != Z_OK)
+		ThrowZlibError("inflateInit2", rc);
+
+	rc = inflateSetDictionary(&m_State->Stream, reinterpret_cast<const Bytef *>(l_MessageDictionary), sizeof(l_MessageDictionary) - 1);
+
+	if (rc != Z_OK) {
+		inflateEnd(&m_State->Stream);
+		ThrowZlibError("inflateSetDictionary", rc);
+	}
+#else /* HAVE_ZLIB */
+	BOOST_THROW_EXCEPTION(std::runtime_error("Message compression is not supported by this build."));
+#endif /* HAVE_ZLIB */
+}
+
+MessageDecompressor::~MessageDecompressor()
+{
+#ifdef HAVE_ZLIB
+	if (m_State)
+		inflateEnd(&m_State->Stream);
+#endif /* HAVE_ZLIB */
+}
+
+bool MessageDecompressor::IsCompressedMessage(const String& message)
+{
+	return !message.IsEmpty() && message[0] == COMPRESSED_MESSAGE_MARKER;
+}
+
+/**
+ * Decompresses a message which was compressed by MessageCompressor::Compress().
+ *
+ * @param message The compressed message.
+ * @returns The encoded message.
+ */
+String MessageDecompressor::Decompress(const String& message)
+{
+#ifdef HAVE_ZLIB
+	ASSERT(IsCompressedMessage(message));
+
+	z_stream& stream = m_State->Stream;
+
+	std::string input = message.GetData().substr(1);
+	input.append(reinterpret_cast<const char *>(l_SyncTrailer), sizeof(l_SyncTrailer));
+
+	std::string result;
+	result.resize(input.size() * 4 + 256);
+
+	stream.next_in = reinterpret_cast<Bytef *>(&input[0]);
+	stream.avail_in = input.size();
+
+	size_t length = 0;
+
+	do {
+		if (length == result.size())
+			result.resize(result.size() * 2);
+
+		stream.next_out = reinterpret_cast<Bytef *>(&result[length]);
+		stream.avail_out = result.size() - length;
+
+		int rc = inflate(&stream, Z_SYNC_FLUSH);
+
+		if (rc != Z_OK && rc != Z_BUF_ERROR)
+			ThrowZlibError("inflate", rc);
+
+		length = result.size() - stream.avail_out;
+	} while (stream.avail_out == 0);
+
+	/* Inflate stops early only when the peer finished the deflate stream. */
+	if (stream.avail_in > 0)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Compressed message contains trailing data."));
+
+	result.resize(length);
+
+	return result;
+#else /* HAVE_ZLIB */
+	(void)message;
+	BOOST_THROW_EXCEPTION(std::runtime_error("Message compression is not supported by this build."));
+#endif /* HAVE_ZLIB */
+}
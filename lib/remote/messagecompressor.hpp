@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef MESSAGECOMPRESSOR_H
+#define MESSAGECOMPRESSOR_H
+
+#include "remote/i2-remote.hpp"
+#include "base/string.hpp"
+#include <memory>
+
+namespace icinga
+{
+
+struct MessageCompressorState;
+
+/**
+ * Compresses the messages which are sent over a JSON-RPC connection. All
+ * messages share one deflate stream (primed with a dictionary of common
+ * message contents), so repeated keys and values are only a few bits each.
+ * Messages must be compressed in the order in which they are sent.
+ *
+ * @ingroup remote
+ */
+class MessageCompressor
+{
+public:
+	MessageCompressor();
+	~MessageCompressor();
+
+	static bool IsSupported();
+
+	String Compress(const String& message);
+
+private:
+	std::unique_ptr<MessageCompressorState> m_State;
+};
+
+/**
+ * Decompresses the messages which were compressed by the peer's
+ * MessageCompressor. Messages must be decompressed in the order in
+ * which they were received.
+ *
+ * @ingroup remote
+ */
+class MessageDecompressor
+{
+public:
+	MessageDecompressor();
+	~MessageDecompressor();
+
+	static bool IsCompressedMessage(const String& message);
+
+	String Decompress(const String& message);
+
+private:
+	std::unique_ptr<MessageCompressorState> m_State;
+};
+
+}
+
+#endif /* MESSAGECOMPRESSOR_H */
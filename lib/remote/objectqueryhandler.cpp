@@ -21,20 +21,114 @@
 #include "remote/httputility.hpp"
 #include "remote/filterutility.hpp"
 #include "base/serializer.hpp"
+#include "base/json.hpp"
 #include "base/dependencygraph.hpp"
 #include "base/configtype.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "base/application.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <iomanip>
 #include <set>
 
+/* Serialized results are sent in chunks of at least this size. */
+#define OBJECT_QUERY_CHUNK_SIZE (64 * 1024)
+
+/* Maximum number of bytes which are queued for a client before more results are serialized. */
+#define OBJECT_QUERY_SEND_QUEUE_SIZE (4 * 1024 * 1024)
+
+/* Snapshots for paginated queries expire when no page was requested for this many seconds. */
+#define OBJECT_QUERY_SNAPSHOT_TIMEOUT 300
+
+/* Maximum number of snapshots which are kept at the same time. */
+#define OBJECT_QUERY_MAX_SNAPSHOTS 100
+
 using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/objects", ObjectQueryHandler);
 
-Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& object,
-	const String& attrPrefix, const Array::Ptr& attrs, bool isJoin, bool allAttrs)
+namespace
 {
-	Type::Ptr type = object->GetReflectionType();
 
+/* The result set of a paginated query, sorted by name. */
+struct ObjectQuerySnapshot
+{
+	String User;
+	String Type;
+	std::shared_ptr<std::vector<Value> > Objects;
+	double LastAccess;
+};
+
+}
+
+static boost::mutex l_SnapshotsMutex;
+static std::map<String, ObjectQuerySnapshot> l_Snapshots;
+
+/**
+ * Removes expired snapshots and, if there are still too many, the ones
+ * which were used least recently.
+ *
+ * The caller must hold l_SnapshotsMutex.
+ */
+static void ExpireSnapshots()
+{
+	double now = Utility::GetTime();
+
+	for (auto it = l_Snapshots.begin(); it != l_Snapshots.end();) {
+		if (it->second.LastAccess < now - OBJECT_QUERY_SNAPSHOT_TIMEOUT)
+			it = l_Snapshots.erase(it);
+		else
+			++it;
+	}
+
+	while (l_Snapshots.size() >= OBJECT_QUERY_MAX_SNAPSHOTS) {
+		auto oldest = std::min_element(l_Snapshots.begin(), l_Snapshots.end(),
+			[](const std::pair<const String, ObjectQuerySnapshot>& a, const std::pair<const String, ObjectQuerySnapshot>& b) {
+				return a.second.LastAccess < b.second.LastAccess;
+			});
+
+		l_Snapshots.erase(oldest);
+	}
+}
+
+static String AddSnapshot(const ApiUser::Ptr& user, const Type::Ptr& type, const std::shared_ptr<std::vector<Value> >& objects)
+{
+	boost::mutex::scoped_lock lock(l_SnapshotsMutex);
+
+	ExpireSnapshots();
+
+	String token = Utility::NewUniqueID();
+	l_Snapshots[token] = ObjectQuerySnapshot{ user->GetName(), type->GetName(), objects, Utility::GetTime() };
+
+	return token;
+}
+
+static std::shared_ptr<std::vector<Value> > GetSnapshot(const String& token, const ApiUser::Ptr& user, const Type::Ptr& type)
+{
+	boost::mutex::scoped_lock lock(l_SnapshotsMutex);
+
+	auto it = l_Snapshots.find(token);
+
+	if (it == l_Snapshots.end() || it->second.User != user->GetName() || it->second.Type != type->GetName())
+		return nullptr;
+
+	it->second.LastAccess = Utility::GetTime();
+
+	return it->second.Objects;
+}
+
+/**
+ * Determines the fields which are serialized for objects of a type, i.e.
+ * the requested attributes without the ones which aren't user-visible.
+ *
+ * @throws ScriptError if one of the attributes doesn't exist.
+ */
+ObjectQueryHandler::FieldList ObjectQueryHandler::GetProjection(const Type::Ptr& type, const String& attrPrefix,
+	const Array::Ptr& attrs, bool isJoin, bool allAttrs)
+{
 	std::vector<int> fids;
 
 	if (isJoin && attrs) {
@@ -81,14 +175,12 @@ Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& obje
 		}
 	}
 
-	DictionaryData resultAttrs;
-	resultAttrs.reserve(fids.size());
+	FieldList fields;
+	fields.reserve(fids.size());
 
 	for (int fid : fids) {
 		Field field = type->GetFieldInfo(fid);
 
-		Value val = object->GetField(fid);
-
 		/* hide attributes which shouldn't be user-visible */
 		if (field.Attributes & FANoUserView)
 			continue;
@@ -97,13 +189,129 @@ Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& obje
 		if (field.Attributes & FANavigation && !(field.Attributes & (FAConfig | FAState)))
 			continue;
 
-		Value sval = Serialize(val, FAConfig | FAState);
-		resultAttrs.emplace_back(field.Name, sval);
+		fields.emplace_back(fid, field.Name);
+	}
+
+	return fields;
+}
+
+/**
+ * Serializes the requested attributes of an object. The fields are only
+ * determined once per request for each type and join.
+ */
+Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& object, const String& attrPrefix,
+	const Array::Ptr& attrs, bool isJoin, bool allAttrs, ProjectionCache& projections)
+{
+	Type::Ptr type = object->GetReflectionType();
+
+	auto key = std::make_pair(attrPrefix, type);
+	auto it = projections.find(key);
+
+	if (it == projections.end())
+		it = projections.insert(std::make_pair(key, GetProjection(type, attrPrefix, attrs, isJoin, allAttrs))).first;
+
+	DictionaryData resultAttrs;
+	resultAttrs.reserve(it->second.size());
+
+	for (const auto& field : it->second) {
+		resultAttrs.emplace_back(field.second, Serialize(object->GetField(field.first), FAConfig | FAState));
 	}
 
 	return new Dictionary(std::move(resultAttrs));
 }
 
+/**
+ * Serializes one result for an object query.
+ *
+ * @throws ScriptError if the requested attributes or joins are invalid.
+ */
+Dictionary::Ptr ObjectQueryHandler::SerializeQueryResult(const ConfigObject::Ptr& obj, const Array::Ptr& uattrs,
+	const Array::Ptr& ujoins, const Array::Ptr& umetas, const FieldList& joinFields, bool allJoins,
+	ProjectionCache& projections)
+{
+	DictionaryData result1{
+		{ "name", obj->GetName() },
+		{ "type", obj->GetReflectionType()->GetName() }
+	};
+
+	DictionaryData metaAttrs;
+
+	if (umetas) {
+		ObjectLock olock(umetas);
+		for (const String& meta : umetas) {
+			if (meta == "used_by") {
+				Array::Ptr used_by = new Array();
+				metaAttrs.emplace_back("used_by", used_by);
+
+				for (const Object::Ptr& pobj : DependencyGraph::GetParents((obj)))
+				{
+					ConfigObject::Ptr configObj = dynamic_pointer_cast<ConfigObject>(pobj);
+
+					if (!configObj)
+						continue;
+
+					used_by->Add(new Dictionary({
+						{ "type", configObj->GetReflectionType()->GetName() },
+						{ "name", configObj->GetName() }
+					}));
+				}
+			} else if (meta == "location") {
+				metaAttrs.emplace_back("location", obj->GetSourceLocation());
+			}
+		}
+	}
+
+	result1.emplace_back("meta", new Dictionary(std::move(metaAttrs)));
+
+	result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false, projections));
+
+	DictionaryData joins;
+
+	for (const auto& joinField : joinFields) {
+		Object::Ptr joinedObj = obj->NavigateField(joinField.first);
+
+		if (!joinedObj)
+			continue;
+
+		joins.emplace_back(joinField.second, SerializeObjectAttrs(joinedObj, joinField.second, ujoins, true, allJoins, projections));
+	}
+
+	result1.emplace_back("joins", new Dictionary(std::move(joins)));
+
+	return new Dictionary(std::move(result1));
+}
+
+/**
+ * Computes an entity tag for a page of query results from the query's
+ * parameters and the change sequences of the objects and their joins.
+ */
+String ObjectQueryHandler::GetETag(const Dictionary::Ptr& params, const std::vector<Value>& objs,
+	size_t begin, size_t end, const FieldList& joinFields)
+{
+	size_t seed = 0;
+
+	/* Change sequences start over when Icinga is restarted. */
+	boost::hash_combine(seed, Application::GetStartTime());
+	boost::hash_combine(seed, JsonEncode(params).GetData());
+
+	for (size_t i = begin; i < end; i++) {
+		ConfigObject::Ptr obj = objs[i];
+
+		boost::hash_combine(seed, obj->GetName().GetData());
+		boost::hash_combine(seed, obj->GetChangeSequence());
+
+		for (const auto& joinField : joinFields) {
+			ConfigObject::Ptr joinedObj = dynamic_pointer_cast<ConfigObject>(obj->NavigateField(joinField.first));
+
+			boost::hash_combine(seed, joinedObj ? joinedObj->GetChangeSequence() : 0);
+		}
+	}
+
+	std::ostringstream msgbuf;
+	msgbuf << "\"" << std::hex << std::setw(16) << std::setfill('0') << seed << "\"";
+	return msgbuf.str();
+}
+
 bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
 {
 	if (request.RequestUrl->GetPath().size() < 3 || request.RequestUrl->GetPath().size() > 4)
@@ -159,21 +367,99 @@ bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& re
 		params->Set(attr, request.RequestUrl->GetPath()[3]);
 	}
 
-	std::vector<Value> objs;
+	long limit = 0;
 
-	try {
-		objs = FilterUtility::GetFilterTargets(qd, params, user);
-	} catch (const std::exception& ex) {
-		HttpUtility::SendJsonError(response, params, 404,
-			"No objects found.",
-			DiagnosticInformation(ex));
-		return true;
+	if (params->Contains("limit")) {
+		try {
+			limit = Convert::ToLong(HttpUtility::GetLastParameter(params, "limit"));
+		} catch (const std::exception&) {
+			limit = 0;
+		}
+
+		if (limit <= 0) {
+			HttpUtility::SendJsonError(response, params, 400, "Invalid value for 'limit' specified.");
+			return true;
+		}
 	}
 
-	ArrayData results;
-	results.reserve(objs.size());
+	String cursor = HttpUtility::GetLastParameter(params, "cursor");
+	std::shared_ptr<std::vector<Value> > objs;
+	String snapshot;
+	size_t offset = 0;
+
+	if (!cursor.IsEmpty()) {
+		/* Cursors consist of the snapshot's token and the offset of the page's first object. */
+		String::SizeType pos = cursor.FindLastOf(":");
+
+		if (pos != String::NPos) {
+			snapshot = cursor.SubStr(0, pos);
+			objs = GetSnapshot(snapshot, user, type);
+		}
+
+		try {
+			if (objs)
+				offset = std::min(static_cast<size_t>(Convert::ToLong(cursor.SubStr(pos + 1))), objs->size());
+		} catch (const std::exception&) {
+			objs = nullptr;
+		}
+
+		if (!objs || limit == 0) {
+			HttpUtility::SendJsonError(response, params, 400, "Invalid or expired cursor, or no limit specified.");
+			return true;
+		}
+	} else {
+		objs = std::make_shared<std::vector<Value> >();
+
+		try {
+			*objs = FilterUtility::GetFilterTargets(qd, params, user);
+		} catch (const std::exception& ex) {
+			HttpUtility::SendJsonError(response, params, 404,
+				"No objects found.",
+				DiagnosticInformation(ex));
+			return true;
+		}
+
+		if (params->Contains("changed_since")) {
+			double changedSince;
+
+			try {
+				changedSince = Convert::ToDouble(HttpUtility::GetLastParameter(params, "changed_since"));
+			} catch (const std::exception&) {
+				HttpUtility::SendJsonError(response, params, 400, "Invalid value for 'changed_since' specified.");
+				return true;
+			}
+
+			objs->erase(std::remove_if(objs->begin(), objs->end(), [changedSince](const ConfigObject::Ptr& obj) {
+				return obj->GetLastChange() <= changedSince;
+			}), objs->end());
+		}
+
+		/* Paginated results are sorted by name, so that pages don't depend on the order of the objects. */
+		if (limit > 0) {
+			std::vector<std::pair<String, Value> > sorted;
+			sorted.reserve(objs->size());
+
+			for (const ConfigObject::Ptr& obj : *objs)
+				sorted.emplace_back(obj->GetName(), obj);
 
-	std::set<String> joinAttrs;
+			std::sort(sorted.begin(), sorted.end(), [](const std::pair<String, Value>& a, const std::pair<String, Value>& b) {
+				return a.first < b.first;
+			});
+
+			for (size_t i = 0; i < sorted.size(); i++)
+				(*objs)[i] = std::move(sorted[i].second);
+
+			if (objs->size() > static_cast<size_t>(limit))
+				snapshot = AddSnapshot(user, type, objs);
+		}
+	}
+
+	size_t end = objs->size();
+
+	if (limit > 0)
+		end = std::min(end, offset + limit);
+
+	FieldList joinFields;
 	std::set<String> userJoinAttrs;
 
 	if (ujoins) {
@@ -192,98 +478,112 @@ bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& re
 		if (!allJoins && userJoinAttrs.find(field.NavigationName) == userJoinAttrs.end())
 			continue;
 
-		joinAttrs.insert(field.Name);
+		joinFields.emplace_back(fid, field.NavigationName);
 	}
 
-	for (const ConfigObject::Ptr& obj : objs) {
-		DictionaryData result1{
-			{ "name", obj->GetName() },
-			{ "type", obj->GetReflectionType()->GetName() }
-		};
-
-		DictionaryData metaAttrs;
-
-		if (umetas) {
-			ObjectLock olock(umetas);
-			for (const String& meta : umetas) {
-				if (meta == "used_by") {
-					Array::Ptr used_by = new Array();
-					metaAttrs.emplace_back("used_by", used_by);
-
-					for (const Object::Ptr& pobj : DependencyGraph::GetParents((obj)))
-					{
-						ConfigObject::Ptr configObj = dynamic_pointer_cast<ConfigObject>(pobj);
-
-						if (!configObj)
-							continue;
-
-						used_by->Add(new Dictionary({
-							{ "type", configObj->GetReflectionType()->GetName() },
-							{ "name", configObj->GetName() }
-						}));
-					}
-				} else if (meta == "location") {
-					metaAttrs.emplace_back("location", obj->GetSourceLocation());
-				} else {
-					HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
-					return true;
-				}
+	if (umetas) {
+		ObjectLock olock(umetas);
+		for (const String& meta : umetas) {
+			if (meta != "used_by" && meta != "location") {
+				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
+				return true;
 			}
 		}
+	}
 
-		result1.emplace_back("meta", new Dictionary(std::move(metaAttrs)));
+	/* The ETag changes whenever one of the results or their joined objects changes. New
+	 * snapshots for paginated queries can't be reused, so their first pages don't get one. */
+	String etag;
 
-		try {
-			result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false));
-		} catch (const ScriptError& ex) {
-			HttpUtility::SendJsonError(response, params, 400, ex.what());
+	if (snapshot.IsEmpty() || !cursor.IsEmpty()) {
+		etag = GetETag(params, *objs, offset, end, joinFields);
+
+		if (request.Headers->Get("if-none-match") == etag) {
+			response.SetStatus(304, "Not Modified");
+			response.AddHeader("ETag", etag);
 			return true;
 		}
+	}
 
-		DictionaryData joins;
+	/* Results are serialized one at a time and sent in chunks instead of building the whole
+	 * response in memory. The status is sent along with the first chunk, so that errors for
+	 * the requested attributes can still be reported with a proper status code. */
+	bool prettyPrint = HttpUtility::GetLastParameter(params, "pretty");
+	bool started = false;
+	ProjectionCache projections;
+	String buffer = "{\"results\":[";
 
-		for (const String& joinAttr : joinAttrs) {
-			Object::Ptr joinedObj;
-			int fid = type->GetFieldId(joinAttr);
+	for (size_t i = offset; i < end; i++) {
+		if (response.IsBudgetExceeded(buffer.GetLength())) {
+			String error = "Request exceeded the time or response size limits.";
 
-			if (fid < 0) {
-				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for join: " + joinAttr);
+			if (!started) {
+				HttpUtility::SendJsonError(response, params, 503, error);
 				return true;
 			}
 
-			Field field = type->GetFieldInfo(fid);
+			buffer += "],\"error\":503,\"status\":" + JsonEncode(error) + "}";
+			response.WriteBody(buffer.CStr(), buffer.GetLength());
+			return true;
+		}
+
+		Dictionary::Ptr result;
 
-			if (!(field.Attributes & FANavigation)) {
-				HttpUtility::SendJsonError(response, params, 400, "Not a joinable field: " + joinAttr);
+		try {
+			result = SerializeQueryResult((*objs)[i], uattrs, ujoins, umetas, joinFields, allJoins, projections);
+		} catch (const ScriptError& ex) {
+			if (!started) {
+				HttpUtility::SendJsonError(response, params, 400, ex.what());
 				return true;
 			}
 
-			joinedObj = obj->NavigateField(fid);
+			/* It's too late to change the status, report the error after the results instead. */
+			buffer += "],\"error\":400,\"status\":" + JsonEncode(ex.what()) + "}";
+			response.WriteBody(buffer.CStr(), buffer.GetLength());
+			return true;
+		}
 
-			if (!joinedObj)
-				continue;
+		if (i > offset)
+			buffer += ",";
 
-			String prefix = field.NavigationName;
+		buffer += JsonEncode(result, prettyPrint);
 
-			try {
-				joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, prefix, ujoins, true, allJoins));
-			} catch (const ScriptError& ex) {
-				HttpUtility::SendJsonError(response, params, 400, ex.what());
-				return true;
+		if (buffer.GetLength() >= OBJECT_QUERY_CHUNK_SIZE) {
+			if (!started) {
+				response.SetStatus(200, "OK");
+				response.AddHeader("Content-Type", "application/json");
+
+				if (!etag.IsEmpty())
+					response.AddHeader("ETag", etag);
+
+				started = true;
 			}
+
+			response.WriteBody(buffer.CStr(), buffer.GetLength());
+			buffer.Clear();
+
+			response.WaitForSendQueue(OBJECT_QUERY_SEND_QUEUE_SIZE);
+
+			if (!response.IsPeerConnected())
+				return true;
 		}
+	}
 
-		result1.emplace_back("joins", new Dictionary(std::move(joins)));
+	if (!started) {
+		response.SetStatus(200, "OK");
+		response.AddHeader("Content-Type", "application/json");
 
-		results.push_back(new Dictionary(std::move(result1)));
+		if (!etag.IsEmpty())
+			response.AddHeader("ETag", etag);
 	}
 
-	Dictionary::Ptr result = new Dictionary({
-		{ "results", new Array(std::move(results)) }
-	});
+	buffer += "]";
+
+	if (end < objs->size())
+		buffer += ",\"next_cursor\":" + JsonEncode(snapshot + ":" + Convert::ToString(end));
 
-	response.SetStatus(200, "OK");
-	HttpUtility::SendJsonBody(response, params, result);
+	buffer += "}";
+	response.WriteBody(buffer.CStr(), buffer.GetLength());
 
 	return true;
 }
@@ -21,6 +21,9 @@
 #define OBJECTQUERYHANDLER_H
 
 #include "remote/httphandler.hpp"
+#include "base/configobject.hpp"
+#include <map>
+#include <set>
 
 namespace icinga
 {
@@ -34,8 +37,18 @@ public:
 		HttpResponse& response, const Dictionary::Ptr& params) override;
 
 private:
-	static Dictionary::Ptr SerializeObjectAttrs(const Object::Ptr& object, const String& attrPrefix,
+	typedef std::vector<std::pair<int, String> > FieldList;
+	typedef std::map<std::pair<String, Type::Ptr>, FieldList> ProjectionCache;
+
+	static String GetETag(const Dictionary::Ptr& params, const std::vector<Value>& objs,
+		size_t begin, size_t end, const FieldList& joinFields);
+	static FieldList GetProjection(const Type::Ptr& type, const String& attrPrefix,
 		const Array::Ptr& attrs, bool isJoin, bool allAttrs);
+	static Dictionary::Ptr SerializeObjectAttrs(const Object::Ptr& object, const String& attrPrefix,
+		const Array::Ptr& attrs, bool isJoin, bool allAttrs, ProjectionCache& projections);
+	static Dictionary::Ptr SerializeQueryResult(const ConfigObject::Ptr& obj, const Array::Ptr& uattrs,
+		const Array::Ptr& ujoins, const Array::Ptr& umetas, const FieldList& joinFields, bool allJoins,
+		ProjectionCache& projections);
 };
 
 }
@@ -0,0 +1,94 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/tracehandler.hpp"
+#include "remote/httputility.hpp"
+#include "remote/filterutility.hpp"
+#include "base/tracing.hpp"
+#include "base/convert.hpp"
+
+using namespace icinga;
+
+REGISTER_URLHANDLER("/v1/trace", TraceHandler);
+
+bool TraceHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
+{
+	if (request.RequestUrl->GetPath().size() != 2)
+		return false;
+
+	if (request.RequestMethod == "GET") {
+		FilterUtility::CheckPermission(user, "trace/query");
+
+		String format = HttpUtility::GetLastParameter(params, "format");
+
+		if (format.IsEmpty() || format == "chrome") {
+			response.SetStatus(200, "OK");
+			HttpUtility::SendJsonBody(response, params, Tracing::ExportChromeTrace());
+		} else if (format == "otlp") {
+			response.SetStatus(200, "OK");
+			HttpUtility::SendJsonBody(response, params, Tracing::ExportOpenTelemetry());
+		} else
+			HttpUtility::SendJsonError(response, params, 400, "Invalid format '" + format + "' specified.");
+
+		return true;
+	}
+
+	if (request.RequestMethod != "POST")
+		return false;
+
+	FilterUtility::CheckPermission(user, "trace/modify");
+
+	Value sampleRate = HttpUtility::GetLastParameter(params, "sample_rate");
+
+	if (!sampleRate.IsEmpty()) {
+		double rate;
+
+		try {
+			rate = Convert::ToDouble(sampleRate);
+		} catch (const std::exception&) {
+			HttpUtility::SendJsonError(response, params, 400, "Invalid value for 'sample_rate' specified.");
+			return true;
+		}
+
+		if (rate < 0 || rate > 1) {
+			HttpUtility::SendJsonError(response, params, 400, "The 'sample_rate' must be between 0 and 1.");
+			return true;
+		}
+
+		Tracing::SetSampleRate(rate);
+	}
+
+	if (HttpUtility::GetLastParameter(params, "clear").ToBool())
+		Tracing::Clear();
+
+	Dictionary::Ptr result = new Dictionary({
+		{ "results", new Array({
+			new Dictionary({
+				{ "code", 200 },
+				{ "status", "Updated the trace settings." },
+				{ "sample_rate", Tracing::GetSampleRate() }
+			})
+		}) }
+	});
+
+	response.SetStatus(200, "OK");
+	HttpUtility::SendJsonBody(response, params, result);
+
+	return true;
+}
@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef ICINGA2_RESULTRING_H
+#define ICINGA2_RESULTRING_H
+
+/*
+ * Client library for the ResultRingListener feature.
+ *
+ * Local producers of passive check results connect to the listener's socket
+ * and receive a shared memory ring buffer and an eventfd. Results are written
+ * into the ring as binary records; the eventfd is only signalled when the
+ * listener is waiting for new records. Any number of processes and threads
+ * may submit results to the same ring concurrently.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define ICINGA2_RESULTRING_MAGIC 0x52433249u /* "I2CR" */
+#define ICINGA2_RESULTRING_VERSION 1
+
+/* The data area starts at this offset of the shared memory. */
+#define ICINGA2_RESULTRING_DATA_OFFSET 4096
+
+#define ICINGA2_RESULTRING_RECORD_RESULT 1
+#define ICINGA2_RESULTRING_RECORD_PADDING 2
+
+/*
+ * The header at the start of the shared memory. The counters are offsets
+ * into an infinite stream; their position in the data area is the counter
+ * modulo the size. Each of them lives in its own cache line.
+ */
+struct icinga2_resultring_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size; /* The size of the data area, a power of two. */
+	uint8_t reserved0[48];
+
+	uint64_t head; /* Reserved by producers (compare-and-swap). */
+	uint8_t reserved1[56];
+
+	uint64_t tail; /* Consumed by the listener. */
+	uint8_t reserved2[56];
+
+	uint32_t waiting; /* Set while the listener waits for the eventfd. */
+	uint8_t reserved3[60];
+};
+
+/*
+ * A record in the data area. Records are aligned to 8 bytes and never wrap
+ * around the end of the data area; producers fill the rest of the data area
+ * with a padding record instead. A record is complete once its length is
+ * set, so the length must be written last.
+ *
+ * Result records are followed by the host name, the service name and the
+ * plugin output (including performance data after a '|'), without
+ * terminating NUL bytes. Host checks have an empty service name.
+ */
+struct icinga2_resultring_record
+{
+	uint32_t length; /* The record length in bytes including this header; 0 while being written. */
+	uint16_t type;
+	uint16_t host_length;
+	uint16_t service_length;
+	uint16_t reserved;
+	int32_t exit_status;
+	uint32_t output_length;
+	uint32_t reserved2;
+	double execution_start; /* UNIX timestamps; 0 means "now". */
+	double execution_end;
+};
+
+struct icinga2_resultring;
+
+/*
+ * Connects to the listener's socket and maps its ring buffer.
+ *
+ * Returns NULL and sets errno on failure.
+ */
+struct icinga2_resultring *icinga2_resultring_open(const char *socket_path);
+
+void icinga2_resultring_close(struct icinga2_resultring *ring);
+
+/*
+ * Submits a passive check result. `service` may be NULL or empty for host
+ * check results.
+ *
+ * Returns 0 on success. Otherwise -1 is returned and errno is set to
+ * EAGAIN if the ring is full, EMSGSIZE if the record doesn't fit into the
+ * ring or EINVAL if a name is too long.
+ */
+int icinga2_resultring_submit(struct icinga2_resultring *ring, const char *host, const char *service,
+	int exit_status, const char *output, double execution_start, double execution_end);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* ICINGA2_RESULTRING_H */
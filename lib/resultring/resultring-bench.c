@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+/*
+ * Measures how many check results per second a single producer can hand
+ * to a running ResultRingListener.
+ *
+ * Usage: icinga2-resultring-bench <socket path> <host> <service> [count]
+ */
+
+#include "icinga2-resultring.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	struct icinga2_resultring *ring;
+	unsigned long count = 1000000, i, retries = 0;
+	double start, duration;
+
+	if (argc < 4) {
+		fprintf(stderr, "Usage: %s <socket path> <host> <service> [count]\n", argv[0]);
+		return 1;
+	}
+
+	if (argc > 4)
+		count = strtoul(argv[4], NULL, 10);
+
+	ring = icinga2_resultring_open(argv[1]);
+
+	if (!ring) {
+		fprintf(stderr, "Could not connect to '%s': %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	start = now();
+
+	for (i = 0; i < count; i++) {
+		while (icinga2_resultring_submit(ring, argv[2], argv[3], 0, "OK - benchmark|value=1", 0, 0) < 0) {
+			if (errno != EAGAIN) {
+				fprintf(stderr, "Could not submit result: %s\n", strerror(errno));
+				icinga2_resultring_close(ring);
+				return 1;
+			}
+
+			retries++;
+			sched_yield();
+		}
+	}
+
+	duration = now() - start;
+
+	printf("%lu results in %.3f seconds (%.0f results/s, %lu retries because the ring was full)\n",
+		count, duration, count / duration, retries);
+
+	icinga2_resultring_close(ring);
+
+	return 0;
+}
@@ -0,0 +1,263 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga2-resultring.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+struct icinga2_resultring
+{
+	struct icinga2_resultring_header *header;
+	char *data;
+	size_t mapping_size;
+	int eventfd;
+};
+
+/*
+ * Receives the ring's memory file descriptor and the eventfd which the
+ * listener sends to each new connection.
+ */
+static int receive_fds(int sock, int *memfd, int *eventfd)
+{
+	char byte;
+	struct iovec iov;
+	struct msghdr msg;
+	union {
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(2 * sizeof(int))];
+	} control;
+	struct cmsghdr *cmsg;
+	int fds[2];
+
+	iov.iov_base = &byte;
+	iov.iov_len = sizeof(byte);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) <= 0)
+		return -1;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int))) {
+		errno = EPROTO;
+		return -1;
+	}
+
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+	*memfd = fds[0];
+	*eventfd = fds[1];
+
+	return 0;
+}
+
+struct icinga2_resultring *icinga2_resultring_open(const char *socket_path)
+{
+	struct sockaddr_un addr;
+	struct icinga2_resultring *ring;
+	struct icinga2_resultring_header *header;
+	int sock, memfd = -1, eventfd = -1, saved_errno;
+	size_t mapping_size;
+
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return NULL;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+
+	sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (sock < 0)
+		return NULL;
+
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || receive_fds(sock, &memfd, &eventfd) < 0) {
+		saved_errno = errno;
+		close(sock);
+		errno = saved_errno;
+		return NULL;
+	}
+
+	close(sock);
+
+	/* Map the header first to learn the size of the data area. */
+	header = mmap(NULL, ICINGA2_RESULTRING_DATA_OFFSET, PROT_READ, MAP_SHARED, memfd, 0);
+
+	if (header == MAP_FAILED)
+		goto fail;
+
+	if (header->magic != ICINGA2_RESULTRING_MAGIC || header->version != ICINGA2_RESULTRING_VERSION) {
+		munmap(header, ICINGA2_RESULTRING_DATA_OFFSET);
+		errno = EPROTO;
+		goto fail;
+	}
+
+	mapping_size = ICINGA2_RESULTRING_DATA_OFFSET + header->size;
+	munmap(header, ICINGA2_RESULTRING_DATA_OFFSET);
+
+	header = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+	if (header == MAP_FAILED)
+		goto fail;
+
+	close(memfd);
+
+	ring = malloc(sizeof(*ring));
+
+	if (!ring) {
+		munmap(header, mapping_size);
+		close(eventfd);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	ring->header = header;
+	ring->data = (char *)header + ICINGA2_RESULTRING_DATA_OFFSET;
+	ring->mapping_size = mapping_size;
+	ring->eventfd = eventfd;
+
+	return ring;
+
+fail:
+	saved_errno = errno;
+	close(memfd);
+	close(eventfd);
+	errno = saved_errno;
+	return NULL;
+}
+
+void icinga2_resultring_close(struct icinga2_resultring *ring)
+{
+	if (!ring)
+		return;
+
+	munmap(ring->header, ring->mapping_size);
+	close(ring->eventfd);
+	free(ring);
+}
+
+/*
+ * Marks a record as complete and rings the doorbell if the listener is
+ * waiting for new records.
+ */
+static void commit_record(struct icinga2_resultring *ring, struct icinga2_resultring_record *record, uint32_t length)
+{
+	uint64_t one = 1;
+	ssize_t rc;
+
+	/* Sequentially consistent so that it's ordered before the load of "waiting". */
+	__atomic_store_n(&record->length, length, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->header->waiting, __ATOMIC_SEQ_CST) &&
+	    __atomic_exchange_n(&ring->header->waiting, 0, __ATOMIC_SEQ_CST)) {
+		rc = write(ring->eventfd, &one, sizeof(one));
+		(void)rc;
+	}
+}
+
+int icinga2_resultring_submit(struct icinga2_resultring *ring, const char *host, const char *service,
+	int exit_status, const char *output, double execution_start, double execution_end)
+{
+	struct icinga2_resultring_header *header = ring->header;
+	struct icinga2_resultring_record *record, *padding;
+	size_t host_length, service_length, output_length, length, offset, pad;
+	uint64_t size = header->size, head, tail, needed;
+	char *payload;
+
+	if (!service)
+		service = "";
+
+	if (!output)
+		output = "";
+
+	host_length = strlen(host);
+	service_length = strlen(service);
+	output_length = strlen(output);
+
+	if (host_length == 0 || host_length > UINT16_MAX || service_length > UINT16_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	length = (sizeof(*record) + host_length + service_length + output_length + 7) & ~(size_t)7;
+
+	/* Larger records could leave too little room for everybody else. */
+	if (length > size / 4) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	head = __atomic_load_n(&header->head, __ATOMIC_RELAXED);
+
+	for (;;) {
+		offset = head & (size - 1);
+		pad = offset + length > size ? size - offset : 0;
+		needed = pad + length;
+
+		tail = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+
+		if (head + needed - tail > size) {
+			errno = EAGAIN;
+			return -1;
+		}
+
+		if (__atomic_compare_exchange_n(&header->head, &head, head + needed, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			break;
+	}
+
+	if (pad) {
+		padding = (struct icinga2_resultring_record *)(ring->data + offset);
+		padding->type = ICINGA2_RESULTRING_RECORD_PADDING;
+		commit_record(ring, padding, pad);
+		offset = 0;
+	}
+
+	record = (struct icinga2_resultring_record *)(ring->data + offset);
+	record->type = ICINGA2_RESULTRING_RECORD_RESULT;
+	record->host_length = host_length;
+	record->service_length = service_length;
+	record->reserved = 0;
+	record->exit_status = exit_status;
+	record->output_length = output_length;
+	record->reserved2 = 0;
+	record->execution_start = execution_start;
+	record->execution_end = execution_end;
+
+	payload = (char *)(record + 1);
+	memcpy(payload, host, host_length);
+	memcpy(payload + host_length, service, service_length);
+	memcpy(payload + host_length + service_length, output, output_length);
+
+	commit_record(ring, record, length);
+
+	return 0;
+}
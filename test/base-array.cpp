@@ -176,4 +176,30 @@ BOOST_AUTO_TEST_CASE(json)
 	BOOST_CHECK(deserialized->Get(2) == 5);
 }
 
+BOOST_AUTO_TEST_CASE(cow)
+{
+	Array::Ptr array = new Array({ 7, 2, 5 });
+
+	Array::Ptr clone = array->ShallowClone();
+
+	clone->Set(0, 3);
+	clone->Add(1);
+
+	BOOST_CHECK(array->GetLength() == 3);
+	BOOST_CHECK(array->Get(0) == 7);
+	BOOST_CHECK(clone->GetLength() == 4);
+	BOOST_CHECK(clone->Get(0) == 3);
+
+	array->Freeze();
+	BOOST_CHECK(array->IsFrozen());
+	BOOST_CHECK_THROW(array->Add(4), std::invalid_argument);
+
+	Array::Ptr clone2 = array->ShallowClone();
+	clone2->Sort();
+
+	BOOST_CHECK(clone2->Get(0) == 2);
+	BOOST_CHECK(array->Get(0) == 7);
+	BOOST_CHECK(array->Contains(5));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -59,4 +59,54 @@ BOOST_AUTO_TEST_CASE(base64)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(vectors)
+{
+	/* RFC 4648, section 10 */
+	BOOST_CHECK(Base64::Encode("") == "");
+	BOOST_CHECK(Base64::Encode("f") == "Zg==");
+	BOOST_CHECK(Base64::Encode("fo") == "Zm8=");
+	BOOST_CHECK(Base64::Encode("foo") == "Zm9v");
+	BOOST_CHECK(Base64::Encode("foob") == "Zm9vYg==");
+	BOOST_CHECK(Base64::Encode("fooba") == "Zm9vYmE=");
+	BOOST_CHECK(Base64::Encode("foobar") == "Zm9vYmFy");
+
+	BOOST_CHECK(Base64::Decode("Zm9vYmE=") == "fooba");
+	BOOST_CHECK(Base64::Decode("Zm9vYmE") == "fooba");
+	BOOST_CHECK(Base64::Decode("Zm9vYg") == "foob");
+
+	String data;
+
+	for (int i = 0; i < 256; i++)
+		data += String(1, static_cast<char>(i));
+
+	String encoded = Base64::Encode(data);
+	BOOST_CHECK(encoded.Find("+") != String::NPos);
+	BOOST_CHECK(encoded.Find("/") != String::NPos);
+
+	/* covers the block-wise code paths and all tail lengths */
+	for (size_t length = 0; length <= data.GetLength(); length++) {
+		String enc = Base64::Encode(data.CStr(), length);
+		BOOST_CHECK(enc.GetLength() == (length + 2) / 3 * 4);
+		BOOST_CHECK(Base64::Decode(enc) == data.SubStr(0, length));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(invalid)
+{
+	BOOST_CHECK_THROW(Base64::Decode("Z"), std::invalid_argument);
+	BOOST_CHECK_THROW(Base64::Decode("Zm9v!mFy"), std::invalid_argument);
+	BOOST_CHECK_THROW(Base64::Decode("Zm9v\nYmFy"), std::invalid_argument);
+	BOOST_CHECK_THROW(Base64::Decode("===="), std::invalid_argument);
+	BOOST_CHECK_THROW(Base64::Decode("Zg==Zg=="), std::invalid_argument);
+
+	/* an invalid character in an otherwise valid block of 16 characters */
+	String encoded = Base64::Encode("The quick brown fox jumps over the lazy dog");
+
+	for (size_t i = 0; i < encoded.GetLength() - 1; i++) {
+		String broken = encoded;
+		broken[i] = '*';
+		BOOST_CHECK_THROW(Base64::Decode(broken), std::invalid_argument);
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,96 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/binaryfilelogger.hpp"
+#include <BoostTestTargetConfig.h>
+#include <sstream>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_binaryfilelogger)
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	std::stringstream stream;
+	std::map<String, unsigned short> writeFacilities;
+
+	BinaryFileLogger::WriteHeader(stream, writeFacilities);
+
+	LogEntry entries[3];
+	entries[0] = { 1500000000.25, LogDebug, "ApiListener", "Received message" };
+	entries[1] = { 1500000001.5, LogCritical, "CheckerComponent", "Line 1\nContext:\n\t(0) Line 2" };
+	entries[2] = { 1500000002, LogInformation, "ApiListener", "" };
+
+	for (const LogEntry& entry : entries)
+		BinaryFileLogger::WriteLogEntry(stream, writeFacilities, entry);
+
+	BOOST_CHECK(writeFacilities.size() == 2);
+
+	/* a file which was reopened starts with a new facility table */
+	BinaryFileLogger::WriteHeader(stream, writeFacilities);
+	BinaryFileLogger::WriteLogEntry(stream, writeFacilities, entries[1]);
+
+	std::vector<String> readFacilities;
+	LogEntry entry;
+
+	for (const LogEntry& expected : entries) {
+		BOOST_REQUIRE(BinaryFileLogger::ReadLogEntry(stream, readFacilities, entry));
+		BOOST_CHECK(entry.Timestamp == expected.Timestamp);
+		BOOST_CHECK(entry.Severity == expected.Severity);
+		BOOST_CHECK(entry.Facility == expected.Facility);
+		BOOST_CHECK(entry.Message == expected.Message);
+	}
+
+	BOOST_REQUIRE(BinaryFileLogger::ReadLogEntry(stream, readFacilities, entry));
+	BOOST_CHECK(entry.Facility == "CheckerComponent");
+	BOOST_CHECK(readFacilities.size() == 1);
+
+	BOOST_CHECK(!BinaryFileLogger::ReadLogEntry(stream, readFacilities, entry));
+}
+
+BOOST_AUTO_TEST_CASE(truncated)
+{
+	std::stringstream stream;
+	std::map<String, unsigned short> facilities;
+
+	BinaryFileLogger::WriteHeader(stream, facilities);
+	BinaryFileLogger::WriteLogEntry(stream, facilities, { 1500000000, LogWarning, "Test", "Complete" });
+	BinaryFileLogger::WriteLogEntry(stream, facilities, { 1500000000, LogWarning, "Test", "Truncated" });
+
+	String data = stream.str();
+	std::stringstream truncated(data.SubStr(0, data.GetLength() - 3));
+
+	std::vector<String> readFacilities;
+	LogEntry entry;
+
+	BOOST_REQUIRE(BinaryFileLogger::ReadLogEntry(truncated, readFacilities, entry));
+	BOOST_CHECK(entry.Message == "Complete");
+	BOOST_CHECK(!BinaryFileLogger::ReadLogEntry(truncated, readFacilities, entry));
+}
+
+BOOST_AUTO_TEST_CASE(invalid)
+{
+	std::stringstream stream("\x07garbage");
+	std::vector<String> facilities;
+	LogEntry entry;
+
+	BOOST_CHECK_THROW(BinaryFileLogger::ReadLogEntry(stream, facilities, entry), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
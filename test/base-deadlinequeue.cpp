@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/deadlinequeue.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <boost/thread/mutex.hpp>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_deadlinequeue)
+
+static boost::mutex l_Mutex;
+static std::vector<Object::Ptr> l_Expired;
+
+static void Callback(const Object::Ptr& object)
+{
+	boost::mutex::scoped_lock lock(l_Mutex);
+	l_Expired.push_back(object);
+}
+
+static std::vector<Object::Ptr> GetExpired()
+{
+	boost::mutex::scoped_lock lock(l_Mutex);
+	return l_Expired;
+}
+
+BOOST_AUTO_TEST_CASE(order)
+{
+	l_Expired.clear();
+
+	DeadlineQueue::Ptr queue = new DeadlineQueue(&Callback);
+	queue->Start();
+
+	Object::Ptr first = new Object();
+	Object::Ptr second = new Object();
+
+	double now = Utility::GetTime();
+	queue->Set(second, now + 1.5);
+	queue->Set(first, now + 0.5);
+	BOOST_CHECK(queue->GetLength() == 2);
+
+	Utility::Sleep(1);
+	BOOST_CHECK(GetExpired() == std::vector<Object::Ptr>({ first }));
+
+	Utility::Sleep(1);
+	BOOST_CHECK(GetExpired() == std::vector<Object::Ptr>({ first, second }));
+	BOOST_CHECK(queue->GetLength() == 0);
+
+	queue->Stop();
+}
+
+BOOST_AUTO_TEST_CASE(update)
+{
+	l_Expired.clear();
+
+	DeadlineQueue::Ptr queue = new DeadlineQueue(&Callback);
+	queue->Start();
+
+	Object::Ptr postponed = new Object();
+	Object::Ptr removed = new Object();
+	Object::Ptr advanced = new Object();
+
+	double now = Utility::GetTime();
+	queue->Set(postponed, now + 0.5);
+	queue->Set(removed, now + 0.5);
+	queue->Set(advanced, now + 60);
+
+	queue->Set(postponed, now + 60);
+	queue->Remove(removed);
+	queue->Set(advanced, now + 0.5);
+	BOOST_CHECK(queue->GetLength() == 2);
+
+	Utility::Sleep(1.5);
+	BOOST_CHECK(GetExpired() == std::vector<Object::Ptr>({ advanced }));
+	BOOST_CHECK(queue->GetLength() == 1);
+
+	queue->Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
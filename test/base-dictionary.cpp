@@ -20,6 +20,7 @@
 #include "base/dictionary.hpp"
 #include "base/objectlock.hpp"
 #include "base/json.hpp"
+#include "base/convert.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -178,4 +179,84 @@ BOOST_AUTO_TEST_CASE(json)
 	BOOST_CHECK(deserialized->Get("test2") == "hello world");
 }
 
+BOOST_AUTO_TEST_CASE(large)
+{
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	/* Insert the keys in reverse order so that the dictionary has to sort them. */
+	for (int i = 99; i >= 0; i--)
+		dictionary->Set("key" + Convert::ToString(100 + i), i);
+
+	BOOST_CHECK(dictionary->GetLength() == 100);
+	BOOST_CHECK(dictionary->Get("key150") == 50);
+
+	dictionary->Set("key150", "hello world");
+	BOOST_CHECK(dictionary->Get("key150") == "hello world");
+	BOOST_CHECK(dictionary->GetLength() == 100);
+
+	dictionary->Remove("key150");
+	BOOST_CHECK(!dictionary->Contains("key150"));
+	BOOST_CHECK(dictionary->GetLength() == 99);
+
+	ObjectLock olock(dictionary);
+
+	String last;
+	int count = 0;
+
+	for (const Dictionary::Pair& kv : dictionary) {
+		BOOST_CHECK(last < kv.first);
+		last = kv.first;
+		count++;
+	}
+
+	BOOST_CHECK(count == 99);
+}
+
+BOOST_AUTO_TEST_CASE(duplicates)
+{
+	Dictionary::Ptr dictionary = new Dictionary({
+		{ "test2", 2 },
+		{ "test1", 1 },
+		{ "test2", 3 }
+	});
+
+	BOOST_CHECK(dictionary->GetLength() == 2);
+	BOOST_CHECK(dictionary->Get("test1") == 1);
+	BOOST_CHECK(dictionary->Get("test2") == 2);
+}
+
+BOOST_AUTO_TEST_CASE(cow)
+{
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	for (int i = 0; i < 50; i++)
+		dictionary->Set("key" + Convert::ToString(i), i);
+
+	Dictionary::Ptr clone1 = dictionary->ShallowClone();
+	Dictionary::Ptr clone2 = clone1->ShallowClone();
+
+	clone1->Set("key10", "hello world");
+	clone2->Remove("key20");
+
+	BOOST_CHECK(dictionary->Get("key10") == 10);
+	BOOST_CHECK(dictionary->Contains("key20"));
+	BOOST_CHECK(clone1->Get("key10") == "hello world");
+	BOOST_CHECK(clone1->Contains("key20"));
+	BOOST_CHECK(clone2->Get("key10") == 10);
+	BOOST_CHECK(!clone2->Contains("key20"));
+
+	dictionary->Clear();
+	BOOST_CHECK(dictionary->GetLength() == 0);
+	BOOST_CHECK(clone2->GetLength() == 49);
+
+	clone2->Freeze();
+	BOOST_CHECK_THROW(clone2->Set("key10", 5), std::invalid_argument);
+
+	Dictionary::Ptr clone3 = clone2->ShallowClone();
+	clone3->Set("key10", 5);
+	BOOST_CHECK(!clone3->IsFrozen());
+	BOOST_CHECK(clone3->Get("key10") == 5);
+	BOOST_CHECK(clone2->Get("key10") == 10);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
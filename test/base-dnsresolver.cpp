@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+#include "base/dnsresolver.hpp"
+#include <BoostTestTargetConfig.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_dnsresolver)
+
+BOOST_AUTO_TEST_CASE(numeric)
+{
+	std::vector<DnsAddress> addresses = DnsResolver::Resolve("127.0.0.1", "5665");
+
+	BOOST_REQUIRE(!addresses.empty());
+	BOOST_CHECK(addresses[0].Family == AF_INET);
+
+	auto *sin = reinterpret_cast<const sockaddr_in *>(&addresses[0].Address);
+	BOOST_CHECK(ntohs(sin->sin_port) == 5665);
+
+	int hits = DnsResolver::GetStats()->Get("hits");
+
+	addresses = DnsResolver::Resolve("127.0.0.1", "5665");
+	BOOST_CHECK(!addresses.empty());
+	BOOST_CHECK(static_cast<int>(DnsResolver::GetStats()->Get("hits")) == hits + 1);
+
+	DnsResolver::Invalidate("127.0.0.1", "5665");
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool done = false;
+	int error = -1;
+
+	DnsResolver::ResolveAsync("127.0.0.1", "5665", [&](const std::vector<DnsAddress>& result, int rc) {
+		std::unique_lock<std::mutex> lock(mtx);
+		error = rc;
+		done = true;
+		cv.notify_all();
+	});
+
+	std::unique_lock<std::mutex> lock(mtx);
+	BOOST_CHECK(cv.wait_for(lock, std::chrono::seconds(10), [&]() { return done; }));
+	BOOST_CHECK(error == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -57,4 +57,46 @@ BOOST_AUTO_TEST_CASE(io)
 	fifo->Close();
 }
 
+BOOST_AUTO_TEST_CASE(buffers)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	StreamBuffer buffers[] = { { "hello", 5 }, { " ", 1 }, { "world", 5 } };
+	fifo->WriteBuffers(buffers, 3);
+	BOOST_CHECK(fifo->GetAvailableBytes() == 11);
+
+	String seen;
+
+	BOOST_CHECK(fifo->ReadBuffered([&seen](const char *data, size_t size) -> size_t {
+		seen = String(data, data + size);
+		return 6;
+	}));
+
+	BOOST_CHECK(seen == "hello world");
+	BOOST_CHECK(fifo->GetAvailableBytes() == 5);
+
+	char *data = fifo->PrepareWrite(3);
+	memcpy(data, "!!!", 3);
+	fifo->CommitWrite(2);
+
+	char buffer[8];
+	size_t rc = fifo->Read(buffer, sizeof(buffer), true);
+	BOOST_CHECK(rc == 7);
+	BOOST_CHECK(memcmp(buffer, "world!!", 7) == 0);
+
+	/* data which is consumed in small steps is eventually moved to the front */
+	String large(64 * 1024, 'x');
+	fifo->Write(large.CStr(), large.GetLength());
+
+	for (size_t i = 0; i < large.GetLength(); i += 100) {
+		fifo->ReadBuffered([](const char *, size_t size) -> size_t {
+			return std::min<size_t>(size, 100);
+		});
+	}
+
+	BOOST_CHECK(fifo->GetAvailableBytes() == 0);
+
+	fifo->Close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/function.hpp"
+#include <BoostTestTargetConfig.h>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_function)
+
+static String FunctionConcat(const String& a, const String& b)
+{
+	return a + b;
+}
+
+BOOST_AUTO_TEST_CASE(span)
+{
+	Function::Ptr func = new Function("concat", FunctionConcat, { "a", "b" });
+
+	InlineArguments<2> arguments(2);
+	arguments[0] = "foo";
+	arguments[1] = "bar";
+
+	BOOST_CHECK(func->Invoke(arguments) == "foobar");
+	BOOST_CHECK(func->Invoke({ "a", "b" }) == "ab");
+
+	/* Calls which don't fit into the inline buffer still work. */
+	InlineArguments<1> overflow(2);
+	overflow[0] = "x";
+	overflow[1] = "y";
+
+	BOOST_CHECK(func->Invoke(overflow) == "xy");
+	BOOST_CHECK_THROW(func->Invoke(ArgumentSpan()), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(vector_adapter)
+{
+	const std::vector<Value> *seen = nullptr;
+
+	Function::Ptr func = new Function("count", [&seen](const std::vector<Value>& arguments) -> Value {
+		seen = &arguments;
+		return arguments.size();
+	});
+
+	std::vector<Value> arguments { 1, 2, 3 };
+
+	/* Vectors are passed through without being copied. */
+	BOOST_CHECK(func->Invoke(arguments) == 3);
+	BOOST_CHECK(seen == &arguments);
+
+	Value values[] = { 1, 2 };
+
+	BOOST_CHECK(func->Invoke(ArgumentSpan(values, 2)) == 2);
+	BOOST_CHECK(seen != &arguments);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/histogram.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_histogram)
+
+BOOST_AUTO_TEST_CASE(empty)
+{
+	Histogram histogram;
+
+	BOOST_CHECK(histogram.GetCount() == 0);
+	BOOST_CHECK(histogram.GetAverage() == 0);
+	BOOST_CHECK(histogram.GetPercentile(99) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(percentiles)
+{
+	Histogram histogram;
+
+	for (int i = 1; i <= 1000; i++)
+		histogram.Record(i / 1000.0);
+
+	BOOST_CHECK(histogram.GetCount() == 1000);
+	BOOST_CHECK_CLOSE(histogram.GetAverage(), 0.5005, 0.1);
+	BOOST_CHECK_CLOSE(histogram.GetPercentile(50), 0.5, 7);
+	BOOST_CHECK_CLOSE(histogram.GetPercentile(95), 0.95, 7);
+	BOOST_CHECK_CLOSE(histogram.GetPercentile(99), 0.99, 7);
+	BOOST_CHECK_CLOSE(histogram.GetMin(), 0.001, 7);
+	BOOST_CHECK_CLOSE(histogram.GetMax(), 1, 7);
+
+	histogram.Record(0);
+	BOOST_CHECK(histogram.GetMin() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(decay)
+{
+	Histogram histogram;
+
+	for (int i = 0; i < 100; i++)
+		histogram.Record(0.1);
+
+	histogram.Decay();
+	BOOST_CHECK(histogram.GetCount() == 50);
+	BOOST_CHECK_CLOSE(histogram.GetPercentile(50), 0.1, 7);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
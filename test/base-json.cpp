@@ -19,8 +19,14 @@
 
 #include "base/dictionary.hpp"
 #include "base/objectlock.hpp"
+#include "base/convert.hpp"
+#include "base/array.hpp"
 #include "base/json.hpp"
+#include "base/netstring.hpp"
+#include "base/stdiostream.hpp"
+#include "base/utility.hpp"
 #include <BoostTestTargetConfig.h>
+#include <fstream>
 
 using namespace icinga;
 
@@ -33,4 +39,168 @@ BOOST_AUTO_TEST_CASE(invalid1)
 	BOOST_CHECK_THROW(JsonDecode("{\"test\": \"test\""), std::exception);
 }
 
+BOOST_AUTO_TEST_CASE(encode_stream)
+{
+	Array::Ptr arr = new Array();
+
+	for (int i = 0; i < 10000; i++)
+		arr->Add(new Dictionary({ { "id", i }, { "name", "service" + Convert::ToString(i) } }));
+
+	String expected = JsonEncode(arr);
+	String result;
+	size_t chunks = 0;
+
+	JsonEncode(arr, [&result, &chunks](const char *data, size_t count) {
+		BOOST_CHECK(count > 0);
+		result += String(data, data + count);
+		chunks++;
+	});
+
+	BOOST_CHECK(result == expected);
+	BOOST_CHECK(chunks > 1);
+}
+
+#ifdef ICINGA2_WITH_SIMD_JSON
+static void CheckSimdDecode(const String& json)
+{
+	Value result;
+	BOOST_CHECK_MESSAGE(JsonDecodeSimd(json, &result), "SIMD decoder rejected: " + json);
+	BOOST_CHECK_MESSAGE(JsonEncode(result) == JsonEncode(JsonDecodeYajl(json)), "SIMD decoder mismatch: " + json);
+}
+#endif /* ICINGA2_WITH_SIMD_JSON */
+
+BOOST_AUTO_TEST_CASE(decode_simd)
+{
+#ifdef ICINGA2_WITH_SIMD_JSON
+	CheckSimdDecode("{\"a\":1,\"b\":[true,false,null],\"c\":\"x\\ny\\u00e4\\u20ac\\u0000z\",\"d\":-0.5e-3,\"e\":{},\"f\":[]}");
+	CheckSimdDecode(" { \"a\" : \"\\\"quoted\\\\\" , \"b\\\\\" : \"\\/\\b\\f\\r\\t\" } ");
+	CheckSimdDecode("{\"a\":1,\"a\":2}");
+	CheckSimdDecode("[12345678901234567890,1.7976931348623157e308,0,-0,3.14159,1E+2,1539784038.123456]");
+	CheckSimdDecode("\"top-level string\"");
+	CheckSimdDecode("42");
+	CheckSimdDecode("true");
+
+	String escapes = "\"";
+	for (int i = 0; i < 100; i++)
+		escapes += "\\\\\\\"" + String(i % 7, 'x');
+	escapes += "\"";
+	CheckSimdDecode(escapes);
+
+	String nested;
+	for (int i = 0; i < 100; i++)
+		nested += "{\"k\":[";
+	nested += "1";
+	for (int i = 0; i < 100; i++)
+		nested += "]}";
+	CheckSimdDecode(nested);
+
+	Value result;
+	BOOST_CHECK(!JsonDecodeSimd("", &result));
+	BOOST_CHECK(!JsonDecodeSimd("[1,]", &result));
+	BOOST_CHECK(!JsonDecodeSimd("{\"a\" 1}", &result));
+	BOOST_CHECK(!JsonDecodeSimd("{\"a\":1,}", &result));
+	BOOST_CHECK(!JsonDecodeSimd("\"abc", &result));
+	BOOST_CHECK(!JsonDecodeSimd("01", &result));
+	BOOST_CHECK(!JsonDecodeSimd("[1] x", &result));
+	BOOST_CHECK(!JsonDecodeSimd("/* comment */ 1", &result));
+	BOOST_CHECK(!JsonDecodeSimd("\"\\ud83d\\ude00\"", &result));
+	BOOST_CHECK(!JsonDecodeSimd("1e999", &result));
+	BOOST_CHECK(!JsonDecodeSimd("\"a\tb\"", &result));
+
+	/* These are handled by the yajl fallback. */
+	BOOST_CHECK(JsonDecode("/* comment */ 1") == 1);
+	BOOST_CHECK_THROW(JsonDecode("[1,]"), std::exception);
+#endif /* ICINGA2_WITH_SIMD_JSON */
+}
+
+/* Not part of the regular test run. Set ICINGA2_JSON_BENCHMARK_LOG to a
+ * replay log file (var/lib/icinga2/api/log/<timestamp>) to benchmark the
+ * decoders with recorded cluster messages:
+ *
+ * boosttest-test-base --run_test=base_json/decode_benchmark --log_level=message
+ */
+BOOST_AUTO_TEST_CASE(decode_benchmark)
+{
+#ifdef ICINGA2_WITH_SIMD_JSON
+	std::vector<String> messages;
+	const char *logPath = getenv("ICINGA2_JSON_BENCHMARK_LOG");
+
+	if (logPath) {
+		auto *fp = new std::fstream(logPath, std::fstream::in | std::fstream::binary);
+		StdioStream::Ptr logStream = new StdioStream(fp, true);
+
+		String message;
+		StreamReadContext src;
+
+		while (NetString::ReadStringFromStream(logStream, &message, src) == StatusNewItem) {
+			Dictionary::Ptr pmessage = JsonDecodeYajl(message);
+			messages.push_back(message);
+			messages.push_back(pmessage->Get("message"));
+		}
+	} else {
+		for (int i = 0; i < 1000; i++) {
+			Dictionary::Ptr cr = new Dictionary({
+				{ "type", "CheckResult" },
+				{ "state", i % 4 },
+				{ "output", "PING OK - Packet loss = 0%, RTA = 0." + Convert::ToString(i) + " ms" },
+				{ "performance_data", new Array({ "rta=0.0" + Convert::ToString(i) + "ms;100;200;0", "pl=0%;80;100;0" }) },
+				{ "execution_start", 1539784038.123456 + i },
+				{ "execution_end", 1539784038.223456 + i },
+				{ "command", new Array({ "/usr/lib/nagios/plugins/check_ping", "-H", "192.0.2." + Convert::ToString(i % 255) }) }
+			});
+
+			messages.push_back(JsonEncode(new Dictionary({
+				{ "jsonrpc", "2.0" },
+				{ "method", "event::CheckResult" },
+				{ "params", new Dictionary({
+					{ "host", "host" + Convert::ToString(i) },
+					{ "service", "ping4" },
+					{ "cr", cr }
+				}) },
+				{ "ts", 1539784038.5 + i }
+			})));
+		}
+	}
+
+	size_t bytes = 0;
+
+	for (const String& message : messages)
+		bytes += message.GetLength();
+
+	const int iterations = 20;
+
+	double start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		for (const String& message : messages)
+			JsonDecodeYajl(message);
+	}
+
+	double yajlTime = Utility::GetTime() - start;
+
+	start = Utility::GetTime();
+
+	for (int i = 0; i < iterations; i++) {
+		for (const String& message : messages)
+			JsonDecode(message);
+	}
+
+	double simdTime = Utility::GetTime() - start;
+
+	double megabytes = bytes * iterations / (1024.0 * 1024.0);
+
+	size_t fallbacks = 0;
+
+	for (const String& message : messages) {
+		Value result;
+
+		if (!JsonDecodeSimd(message, &result))
+			fallbacks++;
+	}
+
+	BOOST_TEST_MESSAGE(messages.size() << " messages (" << fallbacks << " decoded by yajl), " << bytes << " bytes: yajl "
+		<< megabytes / yajlTime << " MiB/s, simd " << megabytes / simdTime << " MiB/s");
+#endif /* ICINGA2_WITH_SIMD_JSON */
+}
+
 BOOST_AUTO_TEST_SUITE_END()
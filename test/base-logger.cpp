@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/logger.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_logger)
+
+BOOST_AUTO_TEST_CASE(message_template)
+{
+	BOOST_CHECK(Logger::GetMessageTemplate("Connection to endpoint 'master1' failed.") == "Connection to endpoint '?' failed.");
+	BOOST_CHECK(Logger::GetMessageTemplate("Connection to endpoint 'master2' failed.") == Logger::GetMessageTemplate("Connection to endpoint 'master1' failed."));
+	BOOST_CHECK(Logger::GetMessageTemplate("Query queue items: 12345, query rate: 1.5/s") == "Query queue items: #, query rate: #.#/s");
+	BOOST_CHECK(Logger::GetMessageTemplate("Unterminated 'quote") == "Unterminated '?'");
+	BOOST_CHECK(Logger::GetMessageTemplate(String(1000, 'x')).GetLength() == 256);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -18,7 +18,9 @@
  ******************************************************************************/
 
 #include "base/utility.hpp"
+#include "base/pattern.hpp"
 #include <BoostTestTargetConfig.h>
+#include <mmatch.h>
 
 using namespace icinga;
 
@@ -41,4 +43,60 @@ BOOST_AUTO_TEST_CASE(tolong)
 	BOOST_CHECK(Utility::Match("he**o", "hello"));
 }
 
+static std::vector<String> GetStrings(const String& alphabet, size_t maxLength)
+{
+	std::vector<String> strings { "" };
+
+	for (size_t i = 0; i < strings.size(); i++) {
+		if (strings[i].GetLength() == maxLength)
+			continue;
+
+		for (char ch : alphabet)
+			strings.push_back(strings[i] + String(1, ch));
+	}
+
+	return strings;
+}
+
+BOOST_AUTO_TEST_CASE(compiled)
+{
+	BOOST_CHECK(GlobPattern("*").GetKind() == GlobMatchAll);
+	BOOST_CHECK(GlobPattern("hello").GetKind() == GlobMatchExact);
+	BOOST_CHECK(GlobPattern("he**").GetKind() == GlobMatchPrefix);
+	BOOST_CHECK(GlobPattern("*lo").GetKind() == GlobMatchSuffix);
+	BOOST_CHECK(GlobPattern("*l\\*l*").GetKind() == GlobMatchInfix);
+	BOOST_CHECK(GlobPattern("h*o").GetKind() == GlobMatchGeneric);
+
+	std::vector<String> texts = GetStrings("aAb*?\\", 3);
+
+	for (const String& pattern : GetStrings("aB*?\\", 4)) {
+		GlobPattern glob(pattern);
+
+		for (const String& text : texts)
+			BOOST_CHECK_MESSAGE(glob.Match(text) == (match(pattern.CStr(), text.CStr()) == 0),
+				"pattern '" << pattern << "', text '" << text << "'");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(cache)
+{
+	uint64_t misses = PatternCache::GetMisses();
+
+	std::shared_ptr<const boost::regex> expr = PatternCache::GetRegex("^he.*o$");
+	BOOST_CHECK(PatternCache::GetMisses() == misses + 1);
+
+	uint64_t hits = PatternCache::GetHits();
+	BOOST_CHECK(PatternCache::GetRegex("^he.*o$") == expr);
+	BOOST_CHECK(PatternCache::GetHits() == hits + 1);
+
+	BOOST_CHECK(PatternCache::GetRegex("^he.*o$", boost::regex::icase) != expr);
+	BOOST_CHECK(boost::regex_search("HELLO", *PatternCache::GetRegex("^he.*o$", boost::regex::icase)));
+
+	BOOST_CHECK_THROW(PatternCache::GetRegex("("), boost::regex_error);
+
+	BOOST_CHECK(PatternCache::GetGlob("he*") == PatternCache::GetGlob("he*"));
+	BOOST_CHECK(PatternCache::MatchGlob("HELLO", "hello"));
+	BOOST_CHECK(!PatternCache::MatchGlob("hello", "hello!"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/memoryaccounting.hpp"
+#include <BoostTestTargetConfig.h>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_memoryaccounting)
+
+BOOST_AUTO_TEST_CASE(stats)
+{
+	Dictionary::Ptr status = new Dictionary();
+	MemoryAccounting::StatsFunc(status, new Array());
+
+	BOOST_CHECK(status->Get("accounting") == MemoryAccounting::IsEnabled());
+	BOOST_CHECK(status->Get("config_objects").IsObjectType<Dictionary>());
+
+	if (!MemoryAccounting::IsEnabled())
+		return;
+
+	Dictionary::Ptr types = status->Get("types");
+	Dictionary::Ptr before = types->Get("icinga::Array");
+	double liveBefore = before ? static_cast<double>(before->Get("live")) : 0;
+
+	std::vector<Array::Ptr> arrays;
+
+	for (int i = 0; i < 100; i++)
+		arrays.emplace_back(new Array());
+
+	status = new Dictionary();
+	MemoryAccounting::StatsFunc(status, new Array());
+
+	types = status->Get("types");
+	Dictionary::Ptr after = types->Get("icinga::Array");
+	BOOST_REQUIRE(after);
+	BOOST_CHECK(after->Get("live") >= liveBefore + 100);
+	BOOST_CHECK(after->Get("bytes") > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/msgpack.hpp"
+#include "base/json.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/convert.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_msgpack)
+
+static void CheckRoundTrip(const Value& value)
+{
+	Value result = MsgPackDecode(MsgPackEncode(value));
+	BOOST_CHECK_MESSAGE(JsonEncode(result) == JsonEncode(value), "MessagePack round trip mismatch: " + JsonEncode(value));
+}
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	CheckRoundTrip(Empty);
+	CheckRoundTrip(true);
+	CheckRoundTrip(false);
+	CheckRoundTrip("");
+	CheckRoundTrip(String(100, 'x'));
+	CheckRoundTrip(String(70000, 'y'));
+	CheckRoundTrip(String("a\0b", "a\0b" + 3));
+
+	for (double number : { 0.0, 1.0, 127.0, 128.0, 255.0, 256.0, 65535.0, 65536.0, 4294967295.0, 4294967296.0,
+		-1.0, -32.0, -33.0, -128.0, -129.0, -32768.0, -32769.0, -2147483648.0, -2147483649.0,
+		0.5, -0.25, 1539784038.123456, 1e300 }) {
+		CheckRoundTrip(number);
+	}
+
+	Array::Ptr arr = new Array();
+
+	for (int i = 0; i < 100; i++)
+		arr->Add(i * 1000);
+
+	CheckRoundTrip(arr);
+
+	Dictionary::Ptr dict = new Dictionary();
+
+	for (int i = 0; i < 20; i++)
+		dict->Set("key" + Convert::ToString(i), new Dictionary({ { "state", i % 4 }, { "output", "OK" } }));
+
+	CheckRoundTrip(new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::CheckResult" },
+		{ "params", new Dictionary({ { "cr", dict }, { "empty", new Array() }, { "nested", new Array({ arr, Empty }) } }) },
+		{ "ts", 1539784038.123456 }
+	}));
+}
+
+BOOST_AUTO_TEST_CASE(compact)
+{
+	BOOST_CHECK(MsgPackEncode(5).GetLength() == 1);
+	BOOST_CHECK(MsgPackEncode(-5).GetLength() == 1);
+	BOOST_CHECK(MsgPackEncode(1539784038).GetLength() == 5);
+	BOOST_CHECK(MsgPackEncode(1539784038.5).GetLength() == 9);
+
+	Dictionary::Ptr message = new Dictionary({ { "state", 0 }, { "output", "OK" }, { "execution_start", 1539784038.5 } });
+	BOOST_CHECK(MsgPackEncode(message).GetLength() < JsonEncode(message).GetLength());
+}
+
+BOOST_AUTO_TEST_CASE(invalid)
+{
+	BOOST_CHECK_THROW(MsgPackDecode(""), std::exception);
+	BOOST_CHECK_THROW(MsgPackDecode("\xa5" "abc"), std::exception);
+	BOOST_CHECK_THROW(MsgPackDecode("\x81\x01\x02"), std::exception);
+	BOOST_CHECK_THROW(MsgPackDecode("\xdd\xff\xff\xff\xff"), std::exception);
+	BOOST_CHECK_THROW(MsgPackDecode("\x01\x02"), std::exception);
+	BOOST_CHECK_THROW(MsgPackDecode("\xc1"), std::exception);
+	BOOST_CHECK_THROW(MsgPackDecode(String(1000, '\x91')), std::exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -19,6 +19,7 @@
 
 #include "base/netstring.hpp"
 #include "base/fifo.hpp"
+#include "base/convert.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -39,4 +40,81 @@ BOOST_AUTO_TEST_CASE(netstring)
 	fifo->Close();
 }
 
+BOOST_AUTO_TEST_CASE(parse)
+{
+	const char *data;
+	size_t length;
+
+	String buffer = "5:hello,3:foo,";
+	BOOST_CHECK(NetString::ParseString(buffer.CStr(), buffer.GetLength(), &data, &length) == 8);
+	BOOST_CHECK(String(data, data + length) == "hello");
+	BOOST_CHECK(NetString::ParseString(buffer.CStr() + 8, buffer.GetLength() - 8, &data, &length) == 6);
+	BOOST_CHECK(String(data, data + length) == "foo");
+
+	buffer = "0:,";
+	BOOST_CHECK(NetString::ParseString(buffer.CStr(), buffer.GetLength(), &data, &length) == 3);
+	BOOST_CHECK(length == 0);
+
+	/* incomplete netstrings */
+	for (String incomplete : { "", "5", "5:", "5:hel", "5:hello" })
+		BOOST_CHECK(NetString::ParseString(incomplete.CStr(), incomplete.GetLength(), &data, &length) == 0);
+
+	/* invalid netstrings */
+	for (String invalid : { ":hello,", "x:hello,", "5x:hello,", "05:hello,", "5:hello!", "1234567890:" }) {
+		BOOST_CHECK_THROW(NetString::ParseString(invalid.CStr(), invalid.GetLength(), &data, &length),
+			std::invalid_argument);
+	}
+
+	buffer = "5:hello,";
+	BOOST_CHECK_THROW(NetString::ParseString(buffer.CStr(), buffer.GetLength(), &data, &length, 4),
+		std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(stream)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	for (int i = 0; i < 1000; i++)
+		NetString::WriteStringToStream(fifo, "message " + Convert::ToString(i));
+
+	/* a large message which needs more than one read */
+	String large(200 * 1024, 'x');
+	NetString::WriteStringToStream(fifo, large);
+
+	fifo->Write("11:incomp", 9);
+
+	String s;
+	StreamReadContext src;
+
+	for (int i = 0; i < 1000; i++) {
+		StreamReadStatus srs;
+
+		while ((srs = NetString::ReadStringFromStream(fifo, &s, src)) == StatusNeedData)
+			;
+
+		BOOST_REQUIRE(srs == StatusNewItem);
+		BOOST_CHECK(s == "message " + Convert::ToString(i));
+	}
+
+	StreamReadStatus srs;
+
+	while ((srs = NetString::ReadStringFromStream(fifo, &s, src)) == StatusNeedData)
+		;
+
+	BOOST_REQUIRE(srs == StatusNewItem);
+	BOOST_CHECK(s == large);
+
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNeedData);
+
+	fifo->Write("lete,", 5);
+
+	while ((srs = NetString::ReadStringFromStream(fifo, &s, src)) == StatusNeedData)
+		;
+
+	BOOST_REQUIRE(srs == StatusNewItem);
+	BOOST_CHECK(s == "incomplete");
+
+	fifo->Close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
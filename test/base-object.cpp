@@ -18,8 +18,11 @@
  ******************************************************************************/
 
 #include "base/object.hpp"
+#include "base/objectlock.hpp"
 #include "base/value.hpp"
 #include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
 
 using namespace icinga;
 
@@ -53,4 +56,35 @@ BOOST_AUTO_TEST_CASE(getself)
 	BOOST_CHECK(vobject.IsObjectType<TestObject>());
 }
 
+BOOST_AUTO_TEST_CASE(lock)
+{
+	TestObject::Ptr tobject = new TestObject();
+	int counter = 0;
+
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([&tobject, &counter]() {
+			for (int k = 0; k < 10000; k++) {
+				ObjectLock olock(tobject);
+				ObjectLock olockRecursive(tobject);
+				counter++;
+			}
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	BOOST_CHECK(counter == 40000);
+
+	uint64_t acquisitions, contended;
+	double waitTime;
+	ObjectLock::GetContentionStats(tobject.get(), acquisitions, contended, waitTime);
+
+	BOOST_CHECK(acquisitions == 80000);
+	BOOST_CHECK(contended <= 40000);
+	BOOST_CHECK(waitTime >= 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
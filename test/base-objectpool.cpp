@@ -0,0 +1,67 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/objectpool.hpp"
+#include "base/dictionary.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_objectpool)
+
+BOOST_AUTO_TEST_CASE(reuse)
+{
+	void *first = ObjectPool::Allocate(100);
+	BOOST_CHECK(first);
+	ObjectPool::Free(first, 100);
+
+	void *second = ObjectPool::Allocate(100);
+	BOOST_CHECK(first == second);
+	ObjectPool::Free(second, 100);
+
+	void *large = ObjectPool::Allocate(ObjectPool::MaxSize + 1);
+	BOOST_CHECK(large);
+	ObjectPool::Free(large, ObjectPool::MaxSize + 1);
+}
+
+BOOST_AUTO_TEST_CASE(crossthread)
+{
+	std::vector<Dictionary::Ptr> dicts;
+
+	for (int i = 0; i < 1000; i++)
+		dicts.push_back(new Dictionary({ { "id", i } }));
+
+	std::thread worker([&dicts]() {
+		dicts.clear();
+	});
+
+	worker.join();
+
+	BOOST_CHECK(dicts.empty());
+
+	for (int i = 0; i < 1000; i++) {
+		Dictionary::Ptr dict = new Dictionary();
+		dict->Set("id", i);
+		BOOST_CHECK(dict->Get("id") == i);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/profiledmutex.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_profiledmutex)
+
+BOOST_AUTO_TEST_CASE(contention)
+{
+	ProfiledMutex mutex("Test contention");
+	int counter = 0;
+
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([&mutex, &counter]() {
+			for (int k = 0; k < 10000; k++) {
+				ProfiledMutex::scoped_lock lock(mutex);
+				counter++;
+			}
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	BOOST_CHECK(counter == 40000);
+
+	Dictionary::Ptr status = new Dictionary();
+	ProfiledMutex::StatsFunc(status, new Array());
+
+	Dictionary::Ptr stats = status->Get("Test contention");
+	BOOST_REQUIRE(stats);
+	BOOST_CHECK(stats->Get("instances") == 1);
+	BOOST_CHECK(stats->Get("acquisitions") == 40000);
+
+	Array::Ptr sites = stats->Get("sites");
+	BOOST_CHECK(sites->GetLength() <= 10);
+
+	if (static_cast<double>(stats->Get("contended")) > 0)
+		BOOST_CHECK(sites->GetLength() > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/rendezvoushash.hpp"
+#include "base/convert.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_rendezvoushash)
+
+BOOST_AUTO_TEST_CASE(distribution)
+{
+	RendezvousHash three, two;
+
+	three.AddNode("master1");
+	three.AddNode("master2");
+	three.AddNode("master3");
+
+	two.AddNode("master1");
+	two.AddNode("master2");
+
+	BOOST_CHECK(three.GetNodeCount() == 3);
+
+	int counts[3] = { 0, 0, 0 };
+
+	for (int i = 0; i < 3000; i++) {
+		String key = "host" + Convert::ToString(i) + "!disk";
+		size_t node = three.GetNode(key);
+
+		BOOST_REQUIRE(node < 3);
+		counts[node]++;
+
+		/* only the keys of the removed node move */
+		if (node != 2)
+			BOOST_CHECK(two.GetNode(key) == node);
+
+		BOOST_CHECK(three.GetNode(key) == node);
+	}
+
+	for (int count : counts) {
+		BOOST_CHECK(count > 800);
+		BOOST_CHECK(count < 1200);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(weights)
+{
+	RendezvousHash hash;
+
+	hash.AddNode("master1", 1);
+	hash.AddNode("master2", 3);
+
+	int counts[2] = { 0, 0 };
+
+	for (int i = 0; i < 4000; i++)
+		counts[hash.GetNode("host" + Convert::ToString(i))]++;
+
+	BOOST_CHECK(counts[0] > 800);
+	BOOST_CHECK(counts[0] < 1200);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
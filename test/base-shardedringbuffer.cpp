@@ -0,0 +1,70 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+#include "base/shardedringbuffer.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_shardedringbuffer)
+
+BOOST_AUTO_TEST_CASE(rate)
+{
+	ShardedRingBuffer rb(60, 4);
+
+	BOOST_CHECK(rb.GetLength() == 60);
+
+	rb.InsertValue(1000, 2);
+	rb.InsertValue(1000, 3);
+	rb.InsertValue(1001, 1);
+
+	BOOST_CHECK(rb.UpdateAndGetValues(1001, 1) == 1);
+	BOOST_CHECK(rb.UpdateAndGetValues(1001, 60) == 6);
+	BOOST_CHECK(rb.CalculateRate(1001, 60) == 3);
+
+	/* The values from 1000 and 1001 have been overwritten or left the window. */
+	rb.InsertValue(1060, 4);
+	BOOST_CHECK(rb.UpdateAndGetValues(1060, 60) == 5);
+	BOOST_CHECK(rb.UpdateAndGetValues(1200, 60) == 0);
+
+	/* Values older than the window are ignored. */
+	rb.InsertValue(1000, 10);
+	BOOST_CHECK(rb.UpdateAndGetValues(1060, 60) == 5);
+}
+
+BOOST_AUTO_TEST_CASE(threads)
+{
+	ShardedRingBuffer rb(60);
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 8; i++) {
+		threads.emplace_back([&rb]() {
+			for (int j = 0; j < 10000; j++)
+				rb.InsertValue(1000, 1);
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	BOOST_CHECK(rb.UpdateAndGetValues(1000, 60) == 80000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
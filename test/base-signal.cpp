@@ -0,0 +1,75 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/signal.hpp"
+#include "base/convert.hpp"
+#include <BoostTestTargetConfig.h>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_signal)
+
+BOOST_AUTO_TEST_CASE(emit)
+{
+	Signal<void (int, const String&)> signal("test");
+	BOOST_CHECK(signal.empty());
+
+	/* Emitting a signal without slots does nothing. */
+	signal(1, "one");
+
+	std::vector<String> calls;
+
+	signal.connect([&calls](int number, const String& name) {
+		calls.push_back("first:" + Convert::ToString(number) + ":" + name);
+	});
+	signal.connect([&calls](int number, const String& name) {
+		calls.push_back("second:" + Convert::ToString(number) + ":" + name);
+	}, "second");
+	BOOST_CHECK(!signal.empty());
+
+	signal(2, "two");
+
+	BOOST_REQUIRE(calls.size() == 2);
+	BOOST_CHECK(calls[0] == "first:2:two");
+	BOOST_CHECK(calls[1] == "second:2:two");
+}
+
+BOOST_AUTO_TEST_CASE(stats)
+{
+	Signal<void (int)> signal("base_signal_stats");
+
+	signal.connect([](int) { }, "noop");
+
+	for (int i = 0; i < 3; i++)
+		signal(i);
+
+	Dictionary::Ptr status = new Dictionary();
+	SignalBase::StatsFunc(status, new Array());
+
+	Dictionary::Ptr slots = status->Get("base_signal_stats");
+	BOOST_REQUIRE(slots);
+
+	Dictionary::Ptr noop = slots->Get("noop");
+	BOOST_REQUIRE(noop);
+	BOOST_CHECK(noop->Get("calls") == 3);
+	BOOST_CHECK(noop->Get("execution_time") >= 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/startuptimeline.hpp"
+#include "base/objectlock.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_startuptimeline)
+
+BOOST_AUTO_TEST_CASE(phases)
+{
+	double now = Utility::GetTime();
+
+	StartupTimeline::AddPhase("test phase", now, now + 1);
+	StartupTimeline::AddPhase("test phase", now + 2, now + 4);
+	StartupTimeline::AddConcurrentTime("test validation", 5);
+	StartupTimeline::AddMilestone("test milestone");
+
+	{
+		StartupPhase phase("test scope");
+	}
+
+	BOOST_CHECK(!StartupTimeline::IsFinished());
+	StartupTimeline::Finish();
+	BOOST_CHECK(StartupTimeline::IsFinished());
+
+	/* Phases are no longer recorded once the startup has finished. */
+	StartupTimeline::AddPhase("test late phase", now, now + 1);
+
+	Dictionary::Ptr timeline = StartupTimeline::ToDictionary();
+	BOOST_CHECK(timeline->Get("finished") == true);
+
+	Array::Ptr phases = timeline->Get("phases");
+	BOOST_REQUIRE(phases);
+
+	Dictionary::Ptr phase, validation, scope;
+
+	ObjectLock olock(phases);
+	for (const Dictionary::Ptr& entry : phases) {
+		BOOST_CHECK(entry->Get("name") != "test late phase");
+
+		if (entry->Get("name") == "test phase")
+			phase = entry;
+		else if (entry->Get("name") == "test validation")
+			validation = entry;
+		else if (entry->Get("name") == "test scope")
+			scope = entry;
+	}
+
+	BOOST_REQUIRE(phase);
+	BOOST_CHECK(phase->Get("count") == 2);
+	BOOST_CHECK(phase->Get("duration") == 3);
+	BOOST_CHECK(phase->Get("concurrent") == false);
+
+	BOOST_REQUIRE(validation);
+	BOOST_CHECK(validation->Get("duration") == 5);
+	BOOST_CHECK(validation->Get("concurrent") == true);
+
+	BOOST_CHECK(scope);
+
+	Dictionary::Ptr milestones = timeline->Get("milestones");
+	BOOST_CHECK(milestones->Contains("test milestone"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/statefile.hpp"
+#include "base/stdiostream.hpp"
+#include "base/netstring.hpp"
+#include "base/dictionary.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <fstream>
+#include <unistd.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_statefile)
+
+BOOST_AUTO_TEST_CASE(records)
+{
+	std::fstream fp;
+	String path = Utility::CreateTempFile("icinga2-statefile.XXXXXX", 0600, fp, true);
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+	StateFile::WriteHeader(sfp);
+
+	Dictionary::Ptr record = new Dictionary({
+		{ "type", "Host" },
+		{ "name", "test" },
+		{ "update", new Dictionary({ { "last_check", 1500000000.25 } }) }
+	});
+
+	StateFile::WriteRecord(sfp, record);
+
+	/* records which were appended by an older version */
+	NetString::WriteStringToStream(sfp, "{\"type\":\"Service\",\"name\":\"test!ping\"}");
+
+	/* an interrupted write */
+	sfp->Write("20:{", 4);
+
+	sfp->Close();
+	fp.close();
+
+	{
+		StateFileView view(path);
+		BOOST_CHECK(view.GetVersion() == StateFile::Version);
+
+		auto records = view.GetRecords();
+		BOOST_REQUIRE(records.size() == 2);
+
+		Dictionary::Ptr first = StateFile::DecodeRecord(String(records[0].first, records[0].first + records[0].second));
+		BOOST_CHECK(first->Get("name") == "test");
+		BOOST_CHECK(Dictionary::Ptr(first->Get("update"))->Get("last_check") == 1500000000.25);
+
+		Dictionary::Ptr second = StateFile::DecodeRecord(String(records[1].first, records[1].first + records[1].second));
+		BOOST_CHECK(second->Get("type") == "Service");
+	}
+
+	unlink(path.CStr());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "base/string.hpp"
+#include "base/utility.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -118,4 +119,40 @@ BOOST_AUTO_TEST_CASE(find)
 	BOOST_CHECK(s.FindFirstOf("xl") == 2);
 }
 
+BOOST_AUTO_TEST_CASE(intern)
+{
+	const String a = String::Intern("hello");
+	const String b = String::Intern(String("hel") + "lo");
+
+	BOOST_CHECK(a.IsInterned());
+	BOOST_CHECK(&a.GetData() == &b.GetData());
+	BOOST_CHECK(a == b);
+	BOOST_CHECK(a == "hello");
+	BOOST_CHECK(a != String::Intern("world"));
+	BOOST_CHECK(String::GetInternedCount() >= 2);
+
+	String c = a;
+	c += " world";
+	BOOST_CHECK(!c.IsInterned());
+	BOOST_CHECK(c == "hello world");
+	BOOST_CHECK(a == "hello");
+
+	String d = b;
+	d[0] = 'j';
+	BOOST_CHECK(d == "jello");
+	BOOST_CHECK(b == "hello");
+
+	BOOST_CHECK(!String::Intern(String(100, 'x')).IsInterned());
+}
+
+BOOST_AUTO_TEST_CASE(validate_utf8)
+{
+	BOOST_CHECK(Utility::ValidateUTF8("") == "");
+	BOOST_CHECK(Utility::ValidateUTF8("hello") == "hello");
+	BOOST_CHECK(Utility::ValidateUTF8("gr\xC3\xBC\xC3\x9F \xE2\x82\xAC") == "gr\xC3\xBC\xC3\x9F \xE2\x82\xAC");
+	BOOST_CHECK(Utility::ValidateUTF8("a\xFF" "b") == "a\xEF\xBF\xBD" "b");
+	BOOST_CHECK(Utility::ValidateUTF8("a\xC3") == "a\xEF\xBF\xBD");
+	BOOST_CHECK(Utility::ValidateUTF8("\xE2\x82x") == "\xEF\xBF\xBD\xEF\xBF\xBDx");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
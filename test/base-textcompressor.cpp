@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+#include "base/textcompressor.hpp"
+#include "base/convert.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_textcompressor)
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	if (!TextCompressor::IsSupported())
+		return;
+
+	String text;
+
+	for (int i = 0; i < 20; i++)
+		text += "Interface GigabitEthernet0/" + Convert::ToString(i) + " is up, ifInOctets=" + Convert::ToString(i * 1000) + "\n";
+
+	std::string compressed;
+	BOOST_CHECK(TextCompressor::Compress(text, compressed));
+	BOOST_CHECK(compressed.size() < text.GetLength());
+	BOOST_CHECK(TextCompressor::Decompress(compressed, text.GetLength()) == text);
+}
+
+BOOST_AUTO_TEST_CASE(incompressible)
+{
+	std::string compressed;
+	BOOST_CHECK(!TextCompressor::Compress("", compressed));
+	BOOST_CHECK(!TextCompressor::Compress("a", compressed));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,56 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/threadplacement.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_threadplacement)
+
+BOOST_AUTO_TEST_CASE(cpulist)
+{
+	std::vector<int> cpus = ThreadPlacement::ParseCPUList("0-3,8,10-11\n");
+	std::vector<int> expected{0, 1, 2, 3, 8, 10, 11};
+	BOOST_CHECK(cpus == expected);
+
+	cpus = ThreadPlacement::ParseCPUList("4,2-3,2");
+	expected = {2, 3, 4};
+	BOOST_CHECK(cpus == expected);
+
+	BOOST_CHECK(ThreadPlacement::ParseCPUList("").empty());
+
+	BOOST_CHECK_THROW(ThreadPlacement::ParseCPUList("3-1"), std::invalid_argument);
+	BOOST_CHECK_THROW(ThreadPlacement::ParseCPUList("a-b"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(policy)
+{
+	BOOST_CHECK(ThreadPlacement::IsValidPolicy("none"));
+	BOOST_CHECK(ThreadPlacement::IsValidPolicy("numa"));
+	BOOST_CHECK(!ThreadPlacement::IsValidPolicy("spread"));
+
+	BOOST_CHECK(ThreadPlacement::GetPolicy() == "none");
+	BOOST_CHECK(ThreadPlacement::GetNodeCount() == 0);
+	BOOST_CHECK(ThreadPlacement::PlaceThread(0) == -1);
+
+	BOOST_CHECK_THROW(ThreadPlacement::SetPolicy("spread"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -75,4 +75,85 @@ BOOST_AUTO_TEST_CASE(scope)
 	BOOST_CHECK(counter >= 4 && counter <= 6);
 }
 
+BOOST_AUTO_TEST_CASE(reschedule)
+{
+	int counter;
+	Timer::Ptr timer = new Timer();
+	timer->OnTimerExpired.connect(std::bind(&Callback, &counter));
+	timer->SetInterval(60);
+
+	counter = 0;
+	timer->Start();
+	timer->Reschedule(Utility::GetTime() + 0.5);
+	Utility::Sleep(1.5);
+
+	BOOST_CHECK(counter == 1);
+
+	timer->Reschedule(Utility::GetTime() + 3600);
+	Utility::Sleep(1);
+	timer->Stop();
+
+	BOOST_CHECK(counter == 1);
+}
+
+static void RearmCallback(int *counter, Timer *timer)
+{
+	(*counter)++;
+
+	if (*counter < 3)
+		timer->Reschedule(Utility::GetTime() + 0.2);
+}
+
+BOOST_AUTO_TEST_CASE(oneshot)
+{
+	int counter = 0;
+	Timer::Ptr timer = new Timer();
+	timer->OnTimerExpired.connect(std::bind(&RearmCallback, &counter, timer.get()));
+
+	timer->Start();
+	Utility::Sleep(1);
+
+	BOOST_CHECK(counter == 0);
+
+	timer->Reschedule(Utility::GetTime() + 0.2);
+	Utility::Sleep(2);
+	timer->Stop();
+
+	BOOST_CHECK(counter == 3);
+}
+
+BOOST_AUTO_TEST_CASE(statistics)
+{
+	int counter = 0;
+	Timer::Ptr timer = new Timer("Test statistics");
+	timer->OnTimerExpired.connect(std::bind(&Callback, &counter));
+	timer->SetInterval(60);
+
+	BOOST_CHECK(timer->GetName() == "Test statistics");
+
+	timer->Start();
+	timer->Reschedule(Utility::GetTime() + 0.5);
+	Utility::Sleep(1.5);
+	timer->Stop();
+
+	BOOST_CHECK(counter == 1);
+
+	Dictionary::Ptr status = new Dictionary();
+	Timer::StatsFunc(status, new Array());
+
+	Dictionary::Ptr stats = status->Get("timer");
+	BOOST_REQUIRE(stats);
+
+	Dictionary::Ptr owners = stats->Get("owners");
+	Dictionary::Ptr owner = owners->Get("Test statistics");
+	BOOST_REQUIRE(owner);
+	BOOST_CHECK(owner->Get("timers") == 1);
+	BOOST_CHECK(owner->Get("calls") == 1);
+	BOOST_CHECK(owner->Get("dispatch_lag").IsObjectType<Dictionary>());
+	BOOST_CHECK(owner->Get("queue_wait").IsObjectType<Dictionary>());
+	BOOST_CHECK(owner->Get("execution_time").IsObjectType<Dictionary>());
+
+	BOOST_CHECK(Timer::GetEventLoopLag().GetCount() > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
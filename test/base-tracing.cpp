@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/tracing.hpp"
+#include "base/array.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_tracing)
+
+BOOST_AUTO_TEST_CASE(disabled)
+{
+	Tracing::SetSampleRate(0);
+	Tracing::Clear();
+
+	{
+		TraceSpan span("test.disabled");
+		BOOST_CHECK(!span.IsSampled());
+	}
+
+	Tracing::RecordSpan("test.disabled", 0, 1);
+
+	BOOST_CHECK(Tracing::GetEvents().empty());
+}
+
+BOOST_AUTO_TEST_CASE(nested)
+{
+	Tracing::SetSampleRate(1);
+	Tracing::Clear();
+
+	{
+		TraceSpan outer("test.outer");
+		outer.SetDetail("detail");
+
+		TraceSpan inner("test.inner");
+		BOOST_CHECK(inner.IsSampled());
+	}
+
+	Tracing::SetSampleRate(0);
+
+	std::vector<TraceEvent> events = Tracing::GetEvents();
+	BOOST_REQUIRE(events.size() == 2);
+
+	const TraceEvent& outer = events[0];
+	const TraceEvent& inner = events[1];
+
+	BOOST_CHECK(String(outer.Name) == "test.outer");
+	BOOST_CHECK(outer.Detail == "detail");
+	BOOST_CHECK(outer.ParentSpanId == 0);
+	BOOST_CHECK(inner.ParentSpanId == outer.SpanId);
+	BOOST_CHECK(inner.TraceId == outer.TraceId);
+	BOOST_CHECK(inner.Start >= outer.Start && inner.End <= outer.End);
+}
+
+BOOST_AUTO_TEST_CASE(ring_buffer)
+{
+	Tracing::SetSampleRate(1);
+	Tracing::Clear();
+
+	for (int i = 0; i < 10000; i++)
+		Tracing::RecordSpan("test.span", i, i + 1);
+
+	Tracing::SetSampleRate(0);
+
+	std::vector<TraceEvent> events = Tracing::GetEvents();
+	BOOST_CHECK(events.size() < 10000);
+	BOOST_CHECK(events.back().Start == 9999);
+}
+
+BOOST_AUTO_TEST_CASE(exporters)
+{
+	Tracing::SetSampleRate(1);
+	Tracing::Clear();
+
+	Tracing::RecordSpan("test.span", 1, 2, "detail");
+
+	Tracing::SetSampleRate(0);
+
+	Array::Ptr traceEvents = Tracing::ExportChromeTrace()->Get("traceEvents");
+	BOOST_REQUIRE(traceEvents->GetLength() == 1);
+
+	Dictionary::Ptr traceEvent = traceEvents->Get(0);
+	BOOST_CHECK(traceEvent->Get("name") == "test.span");
+	BOOST_CHECK(traceEvent->Get("ts") == 1000000);
+	BOOST_CHECK(traceEvent->Get("dur") == 1000000);
+
+	Array::Ptr resourceSpans = Tracing::ExportOpenTelemetry()->Get("resourceSpans");
+	Array::Ptr scopeSpans = Dictionary::Ptr(resourceSpans->Get(0))->Get("scopeSpans");
+	Array::Ptr spans = Dictionary::Ptr(scopeSpans->Get(0))->Get("spans");
+	BOOST_REQUIRE(spans->GetLength() == 1);
+
+	Dictionary::Ptr span = spans->Get(0);
+	BOOST_CHECK(span->Get("startTimeUnixNano") == "1000000000");
+	BOOST_CHECK(String(span->Get("traceId")).GetLength() == 32);
+	BOOST_CHECK(String(span->Get("spanId")).GetLength() == 16);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -22,6 +22,10 @@
 #include "base/objectlock.hpp"
 #include "base/application.hpp"
 #include "base/type.hpp"
+#include "base/configtype.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include "icinga/host.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -61,4 +65,78 @@ BOOST_AUTO_TEST_CASE(instantiate)
 	BOOST_CHECK(p);
 }
 
+BOOST_AUTO_TEST_CASE(object_range)
+{
+	ConfigType *type = ConfigType::Get<Host>();
+
+	Host::Ptr h1 = new Host();
+	h1->SetName("object_range_1");
+	Host::Ptr h2 = new Host();
+	h2->SetName("object_range_2");
+
+	size_t count = type->GetObjectCount();
+
+	type->RegisterObject(h1);
+
+	ConfigObjectRange<Host> before = ConfigType::GetObjectRange<Host>();
+	BOOST_CHECK(before.size() == count + 1);
+
+	type->RegisterObject(h2);
+
+	ConfigObjectRange<Host> after = ConfigType::GetObjectRange<Host>();
+	BOOST_CHECK(after.size() == count + 2);
+	BOOST_CHECK(after.GetVersion() != before.GetVersion());
+
+	/* Views taken earlier are not affected by later changes. */
+	BOOST_CHECK(before.size() == count + 1);
+
+	bool found = false;
+
+	for (Host *host : after) {
+		if (host == h2.get())
+			found = true;
+	}
+
+	BOOST_CHECK(found);
+
+	/* Unchanged lists are shared between readers. */
+	BOOST_CHECK(ConfigType::GetObjectRange<Host>().GetVersion() == after.GetVersion());
+
+	type->UnregisterObject(h1);
+	type->UnregisterObject(h2);
+
+	BOOST_CHECK(ConfigType::GetObjectRange<Host>().size() == count);
+	BOOST_CHECK(after.size() == count + 2);
+}
+
+BOOST_AUTO_TEST_CASE(object_lookup)
+{
+	ConfigType *type = ConfigType::Get<Host>();
+
+	std::vector<Host::Ptr> hosts;
+
+	for (int i = 0; i < 100; i++) {
+		Host::Ptr host = new Host();
+		host->SetName("object_lookup_" + Convert::ToString(i));
+		type->RegisterObject(host);
+		hosts.push_back(host);
+	}
+
+	for (const Host::Ptr& host : hosts) {
+		BOOST_CHECK(Host::GetByName(host->GetName()) == host);
+		BOOST_CHECK(Host::GetByName(String::Intern(host->GetName())) == host);
+	}
+
+	BOOST_CHECK(!Host::GetByName("object_lookup_missing"));
+
+	Host::Ptr duplicate = new Host();
+	duplicate->SetName("object_lookup_0");
+	BOOST_CHECK_THROW(type->RegisterObject(duplicate), ScriptError);
+
+	for (const Host::Ptr& host : hosts)
+		type->UnregisterObject(host);
+
+	BOOST_CHECK(!Host::GetByName("object_lookup_0"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -66,4 +66,32 @@ BOOST_AUTO_TEST_CASE(format)
 	BOOST_CHECK(v != 3);
 }
 
+BOOST_AUTO_TEST_CASE(layout)
+{
+	BOOST_CHECK(sizeof(Value) <= 16);
+}
+
+BOOST_AUTO_TEST_CASE(copy_move)
+{
+	Value v = String(100, 'x');
+	Value copy = v;
+
+	BOOST_CHECK(copy.IsString());
+	BOOST_CHECK(&copy.Get<String>() == &v.Get<String>());
+
+	v = 3;
+	BOOST_CHECK(copy.Get<String>() == String(100, 'x'));
+
+	Value moved = std::move(copy);
+	BOOST_CHECK(moved.IsString());
+	BOOST_CHECK(copy.IsEmpty());
+
+	Value object = new Object();
+	moved.Swap(object);
+	BOOST_CHECK(moved.IsObject());
+	BOOST_CHECK(object.IsString());
+
+	BOOST_CHECK_THROW(object.Get<double>(), boost::bad_get);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/valueinternpool.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_valueinternpool)
+
+BOOST_AUTO_TEST_CASE(intern)
+{
+	ValueInternPool pool;
+
+	Dictionary::Ptr vars1 = new Dictionary({
+		{ "disk_wfree", "20%" },
+		{ "snmp", new Dictionary({ { "community", "public" }, { "version", 2 } }) }
+	});
+
+	Dictionary::Ptr vars2 = new Dictionary({
+		{ "snmp", new Dictionary({ { "version", 2 }, { "community", "public" } }) },
+		{ "disk_wfree", "20%" }
+	});
+
+	Dictionary::Ptr shared1 = pool.Intern(vars1);
+	Dictionary::Ptr shared2 = pool.Intern(vars2);
+
+	BOOST_CHECK(shared1 == shared2);
+	BOOST_CHECK(shared1 != vars1);
+	BOOST_CHECK(shared1->IsFrozen());
+	BOOST_CHECK(Dictionary::Ptr(shared1->Get("snmp"))->IsFrozen());
+	BOOST_CHECK(shared1->Get("disk_wfree") == "20%");
+
+	BOOST_CHECK(pool.GetUniqueCount() == 2);
+	BOOST_CHECK(pool.GetSharedCount() == 2);
+
+	Array::Ptr arr = new Array({ 1, 2 });
+	BOOST_CHECK(Array::Ptr(pool.Intern(arr)) != Array::Ptr(pool.Intern(new Array({ 2, 1 }))));
+	BOOST_CHECK(Array::Ptr(pool.Intern(arr)) == Array::Ptr(pool.Intern(new Array({ 1, 2 }))));
+
+	/* containers with other objects can't be compared */
+	Dictionary::Ptr withObject = new Dictionary({ { "object", new Object() } });
+	BOOST_CHECK(Dictionary::Ptr(pool.Intern(withObject)) == withObject);
+	BOOST_CHECK(!withObject->IsFrozen());
+
+	BOOST_CHECK(pool.Intern(5) == 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
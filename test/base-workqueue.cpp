@@ -0,0 +1,111 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/workqueue.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_workqueue)
+
+BOOST_AUTO_TEST_CASE(order)
+{
+	WorkQueue wq;
+	wq.SetName("Test");
+
+	std::vector<int> results;
+
+	for (int i = 0; i < 1000; i++)
+		wq.Enqueue([&results, i]() { results.push_back(i); });
+
+	wq.Join();
+
+	BOOST_CHECK(results.size() == 1000);
+
+	for (int i = 0; i < 1000; i++)
+		BOOST_CHECK(results[i] == i);
+
+	BOOST_CHECK(wq.GetLength() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(producers)
+{
+	WorkQueue wq(16);
+	wq.SetName("Test");
+
+	std::atomic<int> count(0);
+	std::vector<std::thread> producers;
+
+	for (int i = 0; i < 4; i++) {
+		producers.emplace_back([&wq, &count]() {
+			for (int k = 0; k < 2500; k++)
+				wq.Enqueue([&count]() { count++; }, k % 2 ? PriorityHigh : PriorityNormal);
+		});
+	}
+
+	for (std::thread& producer : producers)
+		producer.join();
+
+	wq.Join();
+
+	BOOST_CHECK(count == 10000);
+	BOOST_CHECK(wq.GetLength() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(multiple_threads)
+{
+	WorkQueue wq(0, 4);
+	wq.SetName("Test");
+
+	std::atomic<int> count(0);
+
+	for (int i = 0; i < 1000; i++)
+		wq.Enqueue([&count]() { count++; });
+
+	wq.Join();
+
+	BOOST_CHECK(count == 1000);
+}
+
+BOOST_AUTO_TEST_CASE(stats)
+{
+	WorkQueue wq;
+	wq.SetName("Test stats");
+
+	for (int i = 0; i < 100; i++)
+		wq.Enqueue([]() { });
+
+	wq.Join();
+
+	Dictionary::Ptr status = new Dictionary();
+	WorkQueue::StatsFunc(status, new Array());
+
+	Dictionary::Ptr stats = status->Get("Test stats");
+	BOOST_REQUIRE(stats);
+	BOOST_CHECK(stats->Get("items") == 0);
+	BOOST_CHECK(stats->Get("threads") == 1);
+
+	Dictionary::Ptr waitTime = stats->Get("wait_time");
+	BOOST_REQUIRE(waitTime);
+	BOOST_CHECK(waitTime->Contains("p99"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/applyrule.hpp"
+#include "config/ruleindex.hpp"
+#include "config/configcompiler.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static void AddTestRule(const String& type, const String& name, const String& filter, const Dictionary::Ptr& scope = nullptr)
+{
+	std::shared_ptr<Expression> expr = MakeBytecode(ConfigCompiler::CompileText("<test>", filter));
+	ApplyRule::AddRule(type, "Host", name, nullptr, expr, String(), String(), String(), nullptr, false, DebugInfo(), scope);
+}
+
+static std::vector<String> GetCandidateNames(const String& type, const Dictionary::Ptr& host)
+{
+	std::vector<String> names;
+	std::map<String, Value> variables { { "host", host } };
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules(type, variables))
+		names.push_back(rule->GetName());
+
+	return names;
+}
+
+static Dictionary::Ptr MakeHost(const String& os, const Array::Ptr& groups)
+{
+	return new Dictionary({
+		{ "name", "example" },
+		{ "groups", groups },
+		{ "vars", new Dictionary({ { "os", os } }) }
+	});
+}
+
+BOOST_AUTO_TEST_SUITE(config_applyrule)
+
+BOOST_AUTO_TEST_CASE(candidates)
+{
+	AddTestRule("ApplyRuleTestA", "os", "(host.vars.os == \"Linux\") && !(host.name == \"ignored\")");
+	AddTestRule("ApplyRuleTestA", "group", "\"web\" in host.groups || \"db\" in host.groups");
+	AddTestRule("ApplyRuleTestA", "pattern", "match(\"ex*\", host.name)");
+	AddTestRule("ApplyRuleTestA", "any", "true");
+	AddTestRule("ApplyRuleTestA", "shadowed", "host.vars.os == \"Windows\"", new Dictionary({ { "host", "x" } }));
+
+	std::vector<String> expected { "os", "group", "pattern", "any", "shadowed" };
+	BOOST_CHECK(GetCandidateNames("ApplyRuleTestA", MakeHost("Linux", new Array({ "web" }))) == expected);
+
+	expected = { "pattern", "any", "shadowed" };
+	BOOST_CHECK(GetCandidateNames("ApplyRuleTestA", MakeHost("BSD", new Array())) == expected);
+
+	/* Attributes with unexpected types can't be looked up and select all rules. */
+	expected = { "group", "pattern", "any", "shadowed" };
+	BOOST_CHECK(GetCandidateNames("ApplyRuleTestA", MakeHost("BSD", new Array({ 3 }))) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(rebuild)
+{
+	AddTestRule("ApplyRuleTestB", "linux", "host.vars.os == \"Linux\"");
+
+	std::vector<String> expected;
+	BOOST_CHECK(GetCandidateNames("ApplyRuleTestB", MakeHost("BSD", new Array())) == expected);
+
+	AddTestRule("ApplyRuleTestB", "bsd", "host.vars.os == \"BSD\"");
+
+	expected = { "bsd" };
+	BOOST_CHECK(GetCandidateNames("ApplyRuleTestB", MakeHost("BSD", new Array())) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(rule_index)
+{
+	std::vector<std::unique_ptr<Expression> > filters;
+	filters.emplace_back(ConfigCompiler::CompileText("<test>", "user.vars.role == \"admin\""));
+	filters.emplace_back(ConfigCompiler::CompileText("<test>", "\"ops\" in user.groups"));
+	filters.emplace_back(ConfigCompiler::CompileText("<test>", "host.vars.os == \"Linux\""));
+
+	RuleIndex index({ "user" });
+
+	for (const auto& filter : filters)
+		index.AddRule(filter.get(), nullptr);
+
+	BOOST_CHECK(index.GetRuleCount() == 3);
+
+	Dictionary::Ptr user = new Dictionary({
+		{ "groups", new Array({ "ops" }) },
+		{ "vars", new Dictionary({ { "role", "guest" } }) }
+	});
+
+	/* 'host' isn't indexed, so the third rule is always a candidate. */
+	std::vector<size_t> expected { 1, 2 };
+	BOOST_CHECK(index.GetCandidates({ { "user", user } }) == expected);
+
+	user->Set("vars", new Dictionary({ { "role", "admin" } }));
+	user->Set("groups", new Array());
+
+	expected = { 0, 2 };
+	BOOST_CHECK(index.GetCandidates({ { "user", user } }) == expected);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
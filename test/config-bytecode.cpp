@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/configcompiler.hpp"
+#include "base/exception.hpp"
+#include "base/json.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static Value EvaluateTree(const String& text)
+{
+	ScriptFrame frame(true);
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", text);
+	return expr->Evaluate(frame);
+}
+
+static Value EvaluateBytecode(const String& text)
+{
+	ScriptFrame frame(true);
+	BytecodeExpression expr(ConfigCompiler::CompileText("<test>", text));
+	return expr.Evaluate(frame);
+}
+
+BOOST_AUTO_TEST_SUITE(config_bytecode)
+
+BOOST_AUTO_TEST_CASE(equivalence)
+{
+	std::vector<String> scripts = {
+		"",
+		"3",
+		"1 + 3 * 2 - 4 / 2",
+		"7 % 3 ^ 1 | 8 & 12",
+		"1 << 3 >> 1",
+		"-3 + ~5",
+		"!true || !false",
+		"\"a\" + \"b\" == \"ab\"",
+		"1 < 2 && 2 <= 2 && 3 > 2 && 3 >= 4",
+		"0 && 1",
+		"\"\" || \"x\"",
+		"3 in [ 1, 2, 3 ]",
+		"3 !in [ 1, 2, 3 ]",
+		"3 in null",
+		"3 !in null",
+		"[ 1, [ 2, 3 ], \"x\" ]",
+		"{ a = 3 }.a",
+		"len([ 1, 2, 3 ])",
+		"\"hello\".len()",
+		"String(3) + \"x\"",
+		"var x = 5; x * 2",
+		"function(a, b) { return a + b }(3, 4)",
+		"(function() { if (true) { return 1 }; return 2 })()",
+		"globals.Math.min(3, 1)",
+		"match(\"ex*\", \"example\")",
+		"regex(\"^ex\", \"example\") && \"x\" in [ \"x\" ]",
+		"var s = \"b\"; [ s in [ \"a\", \"b\" ], s !in [ \"a\", \"b\" ], s in [ \"a\" + \"b\" ] ]",
+		"[ null in [ \"\" ], null in [ \"a\" ], 1 in [ \"1\" ], true in [ \"true\" ] ]",
+		"var x = 3; [ true && x, false && x, 0 || x, \"a\" || x ]",
+		"var x = 3; x * (2 + 4) - (10 / 4)"
+	};
+
+	for (const String& script : scripts) {
+		BOOST_TEST_MESSAGE("Script: " << script);
+		BOOST_CHECK_EQUAL(JsonEncode(EvaluateBytecode(script)), JsonEncode(EvaluateTree(script)));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+	BOOST_CHECK_THROW(EvaluateBytecode("3 in \"x\""), ScriptError);
+	BOOST_CHECK_THROW(EvaluateBytecode("3()"), ScriptError);
+	BOOST_CHECK_THROW(EvaluateBytecode("[ 1 ] - { }"), ScriptError);
+
+	/* Constant expressions which fail are not folded. */
+	BOOST_CHECK_THROW(EvaluateBytecode("true && 1 / 0"), ScriptError);
+
+	/* The left side of 'in' isn't evaluated if the right side is null. */
+	BOOST_CHECK(EvaluateBytecode("3() in null") == false);
+
+	/* Logical operators short-circuit. */
+	BOOST_CHECK(EvaluateBytecode("true || 3()") == true);
+	BOOST_CHECK(EvaluateBytecode("false && 3()") == false);
+
+	ScriptFrame frame(true);
+	frame.Sandboxed = true;
+	BytecodeExpression expr(ConfigCompiler::CompileText("<test>", "\n\nx = 3"));
+
+	try {
+		expr.Evaluate(frame);
+		BOOST_FAIL("Assignment must fail in sandbox mode.");
+	} catch (const ScriptError& ex) {
+		BOOST_CHECK_EQUAL(ex.GetDebugInfo().FirstLine, 3);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/configcache.hpp"
+#include "config/configcompiler.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <fstream>
+
+using namespace icinga;
+
+static void WriteConfig(const String& path, const String& text)
+{
+	std::ofstream fp(path.CStr(), std::ofstream::out | std::ofstream::trunc);
+	fp << text;
+}
+
+BOOST_AUTO_TEST_SUITE(config_cache)
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	String configPath = "icinga2-configcache-test-" + Convert::ToString(Utility::GetPid()) + ".conf";
+	String cachePath = configPath + ".cache";
+
+	WriteConfig(configPath,
+		"globals.CacheTestFunc = function(x) use(y = 3) { return x * y }\n"
+		"globals.CacheTestDict = { \"__function\" = 1, f = CacheTestFunc }\n");
+
+	ConfigCache::BeginRecording();
+
+	{
+		std::unique_ptr<Expression> expr = ConfigCompiler::CompileFile(configPath);
+		ScriptFrame frame(true);
+		expr->Evaluate(frame);
+	}
+
+	std::vector<ConfigItem::Ptr> newItems;
+	BOOST_CHECK(ConfigCache::Save(cachePath, newItems));
+	ConfigCache::EndRecording();
+
+	ScriptGlobal::Set("CacheTestFunc", new Dictionary());
+	ScriptGlobal::Set("CacheTestDict", new Dictionary());
+
+	{
+		ConfigCache cache;
+		BOOST_REQUIRE(cache.Load(cachePath));
+
+		ActivationScope ascope;
+		WorkQueue upq;
+		BOOST_CHECK(cache.Restore(ascope.GetContext(), upq, newItems));
+	}
+
+	Function::Ptr func = ScriptGlobal::Get("CacheTestFunc");
+	BOOST_REQUIRE(func);
+	BOOST_CHECK(func->Invoke({ 2 }) == 6);
+
+	Dictionary::Ptr dict = ScriptGlobal::Get("CacheTestDict");
+	BOOST_REQUIRE(dict);
+	BOOST_CHECK(dict->Get("__function") == 1);
+	BOOST_CHECK(dict->Get("f") == func);
+
+	WriteConfig(configPath, "globals.CacheTestFunc = 1\n");
+
+	{
+		ConfigCache cache;
+		BOOST_CHECK(!cache.Load(cachePath));
+	}
+
+	unlink(configPath.CStr());
+	unlink(cachePath.CStr());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
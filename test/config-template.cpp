@@ -0,0 +1,105 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include "config/activationcontext.hpp"
+#include "icinga/host.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static ConfigItem::Ptr CompileTemplates(const String& text, const String& name)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", text);
+
+	ActivationScope ascope;
+	ScriptFrame frame(true);
+	expr->Evaluate(frame);
+
+	return ConfigItem::GetByTypeAndName(Host::TypeInstance, name);
+}
+
+BOOST_AUTO_TEST_SUITE(config_template)
+
+BOOST_AUTO_TEST_CASE(constants)
+{
+	ConfigItem::Ptr item = CompileTemplates(
+		"template Host \"template-test-base\" { max_check_attempts = 5; vars.os = \"Linux\"; vars.dc = \"a\" }\n"
+		"template Host \"template-test\" { import \"template-test-base\"; vars.os = \"BSD\"; vars.disks[\"/\"] = 10; check_interval = 2m; vars.list = [ 1 ] }\n",
+		"template-test");
+	BOOST_REQUIRE(item);
+
+	Host::Ptr host = new Host();
+	DebugHint dhint;
+
+	{
+		ScriptFrame frame(true, host);
+		item->GetTemplateExpression()->Evaluate(frame, &dhint);
+	}
+
+	BOOST_CHECK(host->GetMaxCheckAttempts() == 5);
+	BOOST_CHECK(host->GetCheckInterval() == 120);
+
+	Dictionary::Ptr vars = host->GetVars();
+	BOOST_REQUIRE(vars);
+	BOOST_CHECK(vars->Get("os") == "BSD");
+	BOOST_CHECK(vars->Get("dc") == "a");
+	BOOST_CHECK(Dictionary::Ptr(vars->Get("disks"))->Get("/") == 10);
+
+	/* Literal arrays must not be shared between objects. */
+	Array::Ptr list = vars->Get("list");
+	list->Add(2);
+
+	Host::Ptr host2 = new Host();
+
+	{
+		ScriptFrame frame(true, host2);
+		item->GetTemplateExpression()->Evaluate(frame);
+	}
+
+	BOOST_CHECK(Array::Ptr(host2->GetVars()->Get("list"))->GetLength() == 1);
+
+	Dictionary::Ptr hints = dhint.ToDictionary();
+	BOOST_REQUIRE(hints);
+	Dictionary::Ptr children = hints->Get("properties");
+	BOOST_REQUIRE(children);
+	BOOST_CHECK(children->Contains("max_check_attempts"));
+	BOOST_CHECK(children->Contains("vars"));
+}
+
+BOOST_AUTO_TEST_CASE(locals)
+{
+	ConfigItem::Ptr item = CompileTemplates(
+		"template Host \"template-test-locals\" { max_check_attempts = 7 }\n",
+		"template-test-locals");
+	BOOST_REQUIRE(item);
+
+	Host::Ptr host = new Host();
+	host->SetMaxCheckAttempts(3);
+
+	ScriptFrame frame(true, host);
+	frame.Locals->Set("max_check_attempts", 1);
+	item->GetTemplateExpression()->Evaluate(frame);
+
+	BOOST_CHECK(host->GetMaxCheckAttempts() == 3);
+	BOOST_CHECK(frame.Locals->Get("max_check_attempts") == 7);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -19,6 +19,8 @@
 
 #include "icinga/host.hpp"
 #include <bitset>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <BoostTestTargetConfig.h>
 
@@ -262,4 +264,45 @@ BOOST_AUTO_TEST_CASE(host_flapping_docs_example)
 #endif
 }
 
+BOOST_AUTO_TEST_CASE(flapping_value)
+{
+	/* Compare against the straightforward weighted loop over the history. */
+	for (unsigned long stateChangeBuf = 0; stateChangeBuf < (1UL << 20); stateChangeBuf += 37) {
+		for (int oldestIndex = 0; oldestIndex < 20; oldestIndex++) {
+			double stateChanges = 0;
+
+			for (int i = 0; i < 20; i++) {
+				if (stateChangeBuf & (1UL << ((oldestIndex + i) % 20)))
+					stateChanges += 0.8 + (0.02 * i);
+			}
+
+			double expected = 100.0 * stateChanges / 20.0;
+			double actual = Checkable::CalculateFlappingValue(stateChangeBuf, oldestIndex);
+
+			if (std::fabs(expected - actual) > 1e-9)
+				BOOST_CHECK_CLOSE(expected, actual, 1e-9);
+		}
+	}
+
+	BOOST_CHECK_CLOSE(Checkable::CalculateFlappingValue(0xFFFFF, 7), 99.0, 1e-9);
+	BOOST_CHECK_EQUAL(Checkable::CalculateFlappingValue(0, 7), 0);
+}
+
+BOOST_AUTO_TEST_CASE(flapping_value_benchmark)
+{
+	const int iterations = 10000000;
+
+	/* Utility::GetTime() may be faked by the other test cases. */
+	auto begin = std::chrono::steady_clock::now();
+	double sum = 0;
+
+	for (int i = 0; i < iterations; i++)
+		sum += Checkable::CalculateFlappingValue(i * 2654435761UL, i % 20);
+
+	std::chrono::duration<double, std::nano> duration = std::chrono::steady_clock::now() - begin;
+
+	BOOST_TEST_MESSAGE("Flapping value: " << duration.count() / iterations << " ns per check result (checksum " << sum << ")");
+	BOOST_CHECK(sum >= 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
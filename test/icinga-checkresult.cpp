@@ -757,4 +757,73 @@ BOOST_AUTO_TEST_CASE(service_flapping_ok_over_bad_into_ok)
 
 #endif /* I2_DEBUG */
 }
+static void CountCheckResult(int *count)
+{
+	(*count)++;
+}
+
+BOOST_AUTO_TEST_CASE(passive_dedup)
+{
+	int count = 0;
+	boost::signals2::connection c = Checkable::OnNewCheckResult.connect(std::bind(&CountCheckResult, &count));
+
+	Host::Ptr host = new Host();
+	host->SetActive(true);
+	host->SetPassiveDedupWindow(60);
+	host->SetPassiveDedupLimit(2);
+	host->Activate();
+	host->SetAuthority(true);
+
+	std::vector<CheckResult::Ptr> results;
+
+	for (int i = 0; i < 6; i++) {
+		CheckResult::Ptr cr = MakeCheckResult(ServiceCritical);
+		cr->SetActive(false);
+		cr->SetOutput(i == 5 ? "changed" : "unchanged");
+		results.push_back(cr);
+	}
+
+	/* The first result is processed fully, the next two are duplicates. */
+	for (int i = 0; i < 3; i++)
+		host->ProcessCheckResult(results[i]);
+
+	BOOST_CHECK(count == 1);
+	BOOST_CHECK(host->GetLastCheckResult() == results[2]);
+
+	/* The limit forces a full result, then one more duplicate. */
+	host->ProcessCheckResult(results[3]);
+	host->ProcessCheckResult(results[4]);
+	BOOST_CHECK(count == 2);
+
+	/* A changed output is always processed. */
+	host->ProcessCheckResult(results[5]);
+	BOOST_CHECK(count == 3);
+	BOOST_CHECK(host->GetState() == HostDown);
+
+	c.disconnect();
+}
+
+BOOST_AUTO_TEST_CASE(snapshot)
+{
+	Host::Ptr host = new Host();
+	host->SetActive(true);
+	host->SetMaxCheckAttempts(3);
+	host->Activate();
+	host->SetAuthority(true);
+
+	CheckableSnapshot::Ptr before = host->GetSnapshot();
+
+	host->ProcessCheckResult(MakeCheckResult(ServiceCritical));
+
+	CheckableSnapshot::Ptr after = host->GetSnapshot();
+	BOOST_CHECK(after->Generation > before->Generation);
+	BOOST_CHECK(after->StateRaw == ServiceCritical);
+	BOOST_CHECK(after->Type == StateTypeSoft);
+	BOOST_CHECK(after->CheckAttempt == host->GetCheckAttempt());
+	BOOST_CHECK(after->LastCheckResult == host->GetLastCheckResult());
+
+	/* Snapshots which were handed out don't change. */
+	BOOST_CHECK(before->LastCheckResult != after->LastCheckResult);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.org/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/cib.hpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static void CreateCIBTestObjects()
+{
+	String config = R"CONFIG(
+object CheckCommand "cib-dummy" {
+  execute = function(checkable, cr, resolvedMacros, useResolvedMacros) { }
+}
+
+object Host "cib-host" {
+  check_command = "cib-dummy"
+  max_check_attempts = 1
+  enable_active_checks = false
+}
+
+object Service "disk" {
+  host_name = "cib-host"
+  check_command = "cib-dummy"
+  max_check_attempts = 1
+  enable_active_checks = false
+}
+
+object Service "load" {
+  host_name = "cib-host"
+  check_command = "cib-dummy"
+  max_check_attempts = 1
+  enable_active_checks = false
+}
+)CONFIG";
+
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<cib>", config);
+	expr->Evaluate(*ScriptFrame::GetCurrentFrame());
+}
+
+static void ProcessCheckResult(const Checkable::Ptr& checkable, ServiceState state)
+{
+	static double ts = Utility::GetTime();
+	ts += 1;
+
+	CheckResult::Ptr cr = new CheckResult();
+	cr->SetState(state);
+	cr->SetScheduleStart(ts);
+	cr->SetScheduleEnd(ts);
+	cr->SetExecutionStart(ts);
+	cr->SetExecutionEnd(ts);
+
+	checkable->ProcessCheckResult(cr);
+}
+
+BOOST_AUTO_TEST_SUITE(icinga_cib)
+
+BOOST_AUTO_TEST_CASE(state_counters)
+{
+	HostStatistics hs0 = CIB::CalculateHostStats();
+	ServiceStatistics ss0 = CIB::CalculateServiceStats();
+
+	BOOST_REQUIRE(ConfigItem::RunWithActivationContext(new Function("CreateCIBTestObjects", CreateCIBTestObjects)));
+
+	Host::Ptr host = Host::GetByName("cib-host");
+	BOOST_REQUIRE(host);
+
+	Service::Ptr disk = host->GetServiceByShortName("disk");
+	Service::Ptr load = host->GetServiceByShortName("load");
+	BOOST_REQUIRE(disk && load);
+
+	/* Freshly activated checkables are pending. */
+	HostStatistics hs = CIB::CalculateHostStats();
+	ServiceStatistics ss = CIB::CalculateServiceStats();
+	BOOST_CHECK_EQUAL(hs.hosts_pending - hs0.hosts_pending, 1);
+	BOOST_CHECK_EQUAL(ss.services_pending - ss0.services_pending, 2);
+
+	ProcessCheckResult(host, ServiceOK);
+	ProcessCheckResult(disk, ServiceOK);
+	ProcessCheckResult(load, ServiceCritical);
+
+	hs = CIB::CalculateHostStats();
+	ss = CIB::CalculateServiceStats();
+	BOOST_CHECK_EQUAL(hs.hosts_pending - hs0.hosts_pending, 0);
+	BOOST_CHECK_EQUAL(hs.hosts_up - hs0.hosts_up, 1);
+	BOOST_CHECK_EQUAL(ss.services_pending - ss0.services_pending, 0);
+	BOOST_CHECK_EQUAL(ss.services_ok - ss0.services_ok, 1);
+	BOOST_CHECK_EQUAL(ss.services_critical - ss0.services_critical, 1);
+	BOOST_CHECK_EQUAL(ss.services_unreachable - ss0.services_unreachable, 0);
+
+	/* Services become unreachable when their host goes down. */
+	ProcessCheckResult(host, ServiceCritical);
+
+	hs = CIB::CalculateHostStats();
+	ss = CIB::CalculateServiceStats();
+	BOOST_CHECK_EQUAL(hs.hosts_up - hs0.hosts_up, 0);
+	BOOST_CHECK_EQUAL(hs.hosts_down - hs0.hosts_down, 1);
+	BOOST_CHECK_EQUAL(ss.services_unreachable - ss0.services_unreachable, 2);
+
+	load->AcknowledgeProblem("icingaadmin", "", AcknowledgementNormal, false);
+	BOOST_CHECK_EQUAL(CIB::CalculateServiceStats().services_acknowledged - ss0.services_acknowledged, 1);
+
+	/* Recovering clears the acknowledgement. */
+	ProcessCheckResult(host, ServiceOK);
+	ProcessCheckResult(load, ServiceOK);
+
+	ss = CIB::CalculateServiceStats();
+	BOOST_CHECK_EQUAL(ss.services_unreachable - ss0.services_unreachable, 0);
+	BOOST_CHECK_EQUAL(ss.services_acknowledged - ss0.services_acknowledged, 0);
+	BOOST_CHECK_EQUAL(ss.services_critical - ss0.services_critical, 0);
+	BOOST_CHECK_EQUAL(ss.services_ok - ss0.services_ok, 2);
+
+	/* Deactivated checkables aren't counted anymore. */
+	disk->Deactivate();
+
+	ss = CIB::CalculateServiceStats();
+	BOOST_CHECK_EQUAL(ss.services_ok - ss0.services_ok, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.org/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/host.hpp"
+#include "icinga/dependency.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static void CreateDependencyTestObjects()
+{
+	String config = R"CONFIG(
+object CheckCommand "dependency-dummy" {
+  execute = function(checkable, cr, resolvedMacros, useResolvedMacros) { }
+}
+
+template Host "dependency-host" {
+  check_command = "dependency-dummy"
+  max_check_attempts = 1
+  enable_active_checks = false
+}
+
+object Host "dependency-uplink" {
+  import "dependency-host"
+}
+
+object Host "dependency-router" {
+  import "dependency-host"
+}
+
+object Host "dependency-switch" {
+  import "dependency-host"
+}
+
+object Service "port" {
+  host_name = "dependency-switch"
+  check_command = "dependency-dummy"
+  enable_active_checks = false
+}
+
+object Dependency "router-uplink" {
+  parent_host_name = "dependency-uplink"
+  child_host_name = "dependency-router"
+}
+
+object Dependency "switch-router" {
+  parent_host_name = "dependency-router"
+  child_host_name = "dependency-switch"
+}
+)CONFIG";
+
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<dependencies>", config);
+	expr->Evaluate(*ScriptFrame::GetCurrentFrame());
+}
+
+static void ProcessCheckResult(const Host::Ptr& host, ServiceState state)
+{
+	static double ts = Utility::GetTime();
+	ts += 1;
+
+	CheckResult::Ptr cr = new CheckResult();
+	cr->SetState(state);
+	cr->SetScheduleStart(ts);
+	cr->SetScheduleEnd(ts);
+	cr->SetExecutionStart(ts);
+	cr->SetExecutionEnd(ts);
+
+	host->ProcessCheckResult(cr);
+}
+
+BOOST_AUTO_TEST_SUITE(icinga_dependencies)
+
+BOOST_AUTO_TEST_CASE(reachability)
+{
+	BOOST_REQUIRE(ConfigItem::RunWithActivationContext(new Function("CreateDependencyTestObjects", CreateDependencyTestObjects)));
+
+	Host::Ptr uplink = Host::GetByName("dependency-uplink");
+	Host::Ptr router = Host::GetByName("dependency-router");
+	Host::Ptr sw = Host::GetByName("dependency-switch");
+	BOOST_REQUIRE(uplink && router && sw);
+
+	Service::Ptr port = sw->GetServiceByShortName("port");
+	BOOST_REQUIRE(port);
+
+	/* Parents which have not been checked yet don't fail dependencies. */
+	BOOST_CHECK(sw->IsReachable());
+	BOOST_CHECK(port->IsReachable());
+
+	ProcessCheckResult(uplink, ServiceOK);
+	ProcessCheckResult(router, ServiceOK);
+	ProcessCheckResult(sw, ServiceOK);
+
+	BOOST_CHECK(router->IsReachable());
+	BOOST_CHECK(sw->IsReachable());
+	BOOST_CHECK(port->IsReachable());
+
+	/* A failing uplink makes the whole chain unreachable. */
+	ProcessCheckResult(uplink, ServiceCritical);
+
+	Dependency::Ptr failedDependency;
+	BOOST_CHECK(!router->IsReachable(DependencyState, &failedDependency));
+	BOOST_CHECK(failedDependency && failedDependency->GetName() == "dependency-router!router-uplink");
+
+	BOOST_CHECK(!sw->IsReachable(DependencyState, &failedDependency));
+	BOOST_CHECK(failedDependency && failedDependency->GetName() == "dependency-router!router-uplink");
+
+	/* Host dependencies don't apply to services, only the host's own state does. */
+	BOOST_CHECK(port->IsReachable());
+	BOOST_CHECK(uplink->IsReachable());
+
+	/* Check results without a state change keep the cached result. */
+	ProcessCheckResult(uplink, ServiceCritical);
+	BOOST_CHECK(!sw->IsReachable());
+
+	ProcessCheckResult(uplink, ServiceOK);
+
+	BOOST_CHECK(router->IsReachable(DependencyState, &failedDependency));
+	BOOST_CHECK(!failedDependency);
+	BOOST_CHECK(sw->IsReachable());
+	BOOST_CHECK(port->IsReachable());
+
+	/* Services implicitly depend on their host. */
+	ProcessCheckResult(sw, ServiceCritical);
+
+	BOOST_CHECK(sw->IsReachable());
+	BOOST_CHECK(!port->IsReachable());
+	BOOST_CHECK(port->IsReachable(DependencyCheckExecution));
+
+	ProcessCheckResult(sw, ServiceOK);
+	BOOST_CHECK(port->IsReachable());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
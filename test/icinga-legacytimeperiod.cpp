@@ -103,4 +103,51 @@ BOOST_AUTO_TEST_CASE(simple)
 	BOOST_CHECK_EQUAL(mktime(&end), (time_t) 1456790400); // 2016-03-01
 }
 
+BOOST_AUTO_TEST_CASE(dayranges)
+{
+	tm beg = {}, end = {}, ref = {};
+	int stride;
+
+	ref.tm_year = 2016 - 1900;
+	ref.tm_mon = 0;
+	ref.tm_mday = 5;
+	LegacyTimePeriod::ParseTimeRange("day 1 - 15 / 2", &beg, &end, &stride, &ref);
+	BOOST_CHECK_EQUAL(mktime(&beg), (time_t) 1451606400); // 2016-01-01
+	BOOST_CHECK_EQUAL(mktime(&end), (time_t) 1452902400); // 2016-01-16
+	BOOST_CHECK_EQUAL(stride, 2);
+
+	BOOST_CHECK_THROW(LegacyTimePeriod::CompileDayDefinition("monday 0"),
+		std::invalid_argument);
+	BOOST_CHECK_THROW(LegacyTimePeriod::CompileTimeRange("17:00-09:00"),
+		std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(scriptfunc)
+{
+	TimePeriod::Ptr tp = new TimePeriod();
+	tp->SetRanges(new Dictionary({
+		{ "monday", "09:00-12:00,13:00-17:00" },
+		{ "2016-01-06", "10:00-11:00" }
+	}), true);
+
+	/* 2016-01-04 (monday) until 2016-01-11 (monday) */
+	for (int pass = 0; pass < 2; pass++) {
+		Array::Ptr segments = LegacyTimePeriod::ScriptFunc(tp, 1451865600, 1451865600 + 7 * 24 * 60 * 60);
+
+		BOOST_REQUIRE_EQUAL(segments->GetLength(), 5);
+
+		Dictionary::Ptr segment = segments->Get(0);
+		BOOST_CHECK_EQUAL(segment->Get("begin"), 1451898000); // 2016-01-04 09:00
+		BOOST_CHECK_EQUAL(segment->Get("end"), 1451908800); // 2016-01-04 12:00
+
+		segment = segments->Get(2);
+		BOOST_CHECK_EQUAL(segment->Get("begin"), 1452074400); // 2016-01-06 10:00
+		BOOST_CHECK_EQUAL(segment->Get("end"), 1452078000); // 2016-01-06 11:00
+
+		segment = segments->Get(4);
+		BOOST_CHECK_EQUAL(segment->Get("begin"), 1452517200); // 2016-01-11 13:00
+		BOOST_CHECK_EQUAL(segment->Get("end"), 1452531600); // 2016-01-11 17:00
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "icinga/macroprocessor.hpp"
+#include "base/utility.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -64,4 +65,45 @@ BOOST_AUTO_TEST_CASE(simple)
 
 }
 
+BOOST_AUTO_TEST_CASE(templates)
+{
+	Dictionary::Ptr macros = new Dictionary();
+	macros->Set("testA", 7);
+	macros->Set("testB", "hello");
+
+	MacroProcessor::ResolverList resolvers;
+	resolvers.emplace_back("macros", macros);
+
+	BOOST_CHECK(MacroProcessor::ResolveMacros("$$$testB$$$ $macros.testA$", resolvers) == "$hello$ 7");
+	BOOST_CHECK(MacroProcessor::ResolveMacros("$testA$", resolvers) == 7);
+	BOOST_CHECK_THROW(MacroProcessor::ResolveMacros("$testA$ $testB", resolvers), std::runtime_error);
+
+	Array::Ptr command = new Array({ "check_test" });
+
+	Dictionary::Ptr arguments = new Dictionary({
+		{ "-a", new Dictionary({ { "value", "$testA$" }, { "order", 2 } }) },
+		{ "-b", "$testB$" },
+		{ "-c", new Dictionary({ { "set_if", "$testC$" }, { "order", -1 } }) },
+		{ "-d", new Dictionary({ { "value", "$testD$" } }) }
+	});
+
+	CommandTemplate::Ptr commandTemplate = new CommandTemplate(command, arguments);
+	BOOST_CHECK(commandTemplate->IsCompiledFrom(command, arguments));
+	BOOST_CHECK(!commandTemplate->IsCompiledFrom(new Array({ "check_test" }), arguments));
+
+	Array::Ptr result = MacroProcessor::ResolveArguments(commandTemplate, resolvers, nullptr, nullptr, false);
+	BOOST_CHECK(Utility::Join(result, ' ') == "check_test -b hello -a 7");
+
+	/* the same template picks up changed values */
+	macros->Set("testB", "world");
+	macros->Set("testC", true);
+	macros->Set("testD", new Array({ 1, 2 }));
+
+	result = MacroProcessor::ResolveArguments(commandTemplate, resolvers, nullptr, nullptr, false);
+	BOOST_CHECK(Utility::Join(result, ' ') == "check_test -c -b world -d 1 -d 2 -a 7");
+
+	Array::Ptr uncompiled = MacroProcessor::ResolveArguments(command, arguments, resolvers, nullptr, nullptr, false);
+	BOOST_CHECK(Utility::Join(uncompiled, ' ') == Utility::Join(result, ' '));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -19,6 +19,8 @@
 
 #include "base/perfdatavalue.hpp"
 #include "icinga/pluginutility.hpp"
+#include "icinga/checkresult.hpp"
+#include "base/objectlock.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -140,4 +142,57 @@ BOOST_AUTO_TEST_CASE(multi)
 	BOOST_CHECK(pd->Get(1) == "test::b=4");
 }
 
+BOOST_AUTO_TEST_CASE(parse_output)
+{
+	std::pair<String, String> co = PluginUtility::ParseCheckOutput("");
+	BOOST_CHECK(co.first == "");
+	BOOST_CHECK(co.second == "");
+
+	co = PluginUtility::ParseCheckOutput("OK - all fine");
+	BOOST_CHECK(co.first == "OK - all fine");
+	BOOST_CHECK(co.second == "");
+
+	co = PluginUtility::ParseCheckOutput("OK - all fine | a=1 b=2");
+	BOOST_CHECK(co.first == "OK - all fine ");
+	BOOST_CHECK(co.second == "a=1 b=2");
+
+	co = PluginUtility::ParseCheckOutput("OK |a=1\nline 2\nline 3|b=2\nc=3");
+	BOOST_CHECK(co.first == "OK \nline 2\nline 3\nc=3");
+	BOOST_CHECK(co.second == "a=1 b=2");
+
+	co = PluginUtility::ParseCheckOutput("\nOK\r\n| a=1 |");
+	BOOST_CHECK(co.first == "OK\n\n");
+	BOOST_CHECK(co.second == "a=1 |");
+}
+
+BOOST_AUTO_TEST_CASE(checkresult_cache)
+{
+	CheckResult::Ptr cr = new CheckResult();
+	BOOST_CHECK(!cr->GetParsedPerformanceData());
+	BOOST_CHECK(cr->GetFormattedPerformanceData() == "");
+
+	cr->SetPerformanceData(new Array({ "a=1;2;3", "b" }));
+
+	Array::Ptr pd = cr->GetParsedPerformanceData();
+	BOOST_REQUIRE(pd->GetLength() == 2);
+
+	/* invalid values are kept as strings */
+	PerfdataValue::Ptr pdv = pd->Get(0);
+	BOOST_CHECK(pdv->GetLabel() == "a");
+	BOOST_CHECK(pdv->GetCrit() == 3);
+	BOOST_CHECK(pd->Get(1) == "b");
+
+	/* the parsed values are shared until the perfdata is replaced */
+	BOOST_CHECK(cr->GetParsedPerformanceData() == pd);
+	BOOST_CHECK_THROW(pd->Add("c=1"), std::invalid_argument);
+	BOOST_CHECK(cr->GetFormattedPerformanceData() == "a=1;2;3 b");
+
+	cr->SetPerformanceData(PluginUtility::SplitPerfdata("c=4"));
+
+	pd = cr->GetParsedPerformanceData();
+	BOOST_REQUIRE(pd->GetLength() == 1);
+	BOOST_CHECK(static_cast<PerfdataValue::Ptr>(pd->Get(0))->GetValue() == 4);
+	BOOST_CHECK(cr->GetFormattedPerformanceData() == "c=4");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
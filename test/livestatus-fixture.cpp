@@ -45,9 +45,13 @@ object CheckCommand "dummy" {
   command = "/bin/echo"
 }
 
+object HostGroup "test-hosts" {
+}
+
 object Host "test-01" {
   address = "127.0.0.1"
   check_command = "dummy"
+  groups = [ "test-hosts" ]
 }
 
 object Host "test-02" {
@@ -18,16 +18,26 @@
  ******************************************************************************/
 
 #include "livestatus/livestatusquery.hpp"
+#include "livestatus/checkablestatecache.hpp"
+#include "livestatus/livestatusquerycache.hpp"
+#include "livestatus/livestatushandler.hpp"
+#include "icinga/service.hpp"
+#include "remote/httpresponse.hpp"
+#include "base/exception.hpp"
 #include "base/application.hpp"
 #include "base/stdiostream.hpp"
 #include "base/json.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "base/scriptglobal.hpp"
+#include <fstream>
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
 
-String LivestatusQueryHelper(const std::vector<String>& lines)
+String LivestatusQueryHelper(const std::vector<String>& lines, const String& compatLogPath = "")
 {
-	LivestatusQuery::Ptr query = new LivestatusQuery(lines, "");
+	LivestatusQuery::Ptr query = new LivestatusQuery(lines, compatLogPath);
 
 	std::stringstream stream;
 	StdioStream::Ptr sstream = new StdioStream(&stream, false);
@@ -119,6 +129,403 @@ BOOST_AUTO_TEST_CASE(services)
 
 	BOOST_TEST_MESSAGE("Done with testing livestatus services...");
 }
+
+BOOST_AUTO_TEST_CASE(state_cache)
+{
+	CheckableStateCache::Start();
+
+	Service::Ptr service = Service::GetByNamePair("test-01", "livestatus");
+	BOOST_REQUIRE(service);
+
+	std::vector<String> lines;
+	lines.emplace_back("GET services");
+	lines.emplace_back("Columns: state plugin_output has_been_checked");
+	lines.emplace_back("Filter: host_name = test-01");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	/* the first query fills the cache */
+	Array::Ptr res = Array::Ptr(JsonDecode(LivestatusQueryHelper(lines)))->Get(0);
+	BOOST_CHECK(res->Get(0) == ServiceUnknown);
+	BOOST_CHECK(res->Get(1) == "");
+	BOOST_CHECK(res->Get(2) == 0);
+
+	CheckResult::Ptr cr = new CheckResult();
+	cr->SetOutput("disk full");
+	cr->SetState(ServiceCritical);
+
+	service->SetLastCheckResult(cr);
+	service->SetStateRaw(ServiceCritical);
+
+	/* the attribute change signals must have invalidated the cached row */
+	res = Array::Ptr(JsonDecode(LivestatusQueryHelper(lines)))->Get(0);
+	BOOST_CHECK(res->Get(0) == ServiceCritical);
+	BOOST_CHECK(res->Get(1) == "disk full");
+	BOOST_CHECK(res->Get(2) == 1);
+}
+BOOST_AUTO_TEST_CASE(stats)
+{
+	std::vector<String> lines;
+	lines.emplace_back("GET hosts");
+	lines.emplace_back("Stats: name = test-01");
+	lines.emplace_back("Stats: name = test-02");
+	lines.emplace_back("Stats: name ~ test");
+	lines.emplace_back("Stats: address = 127.0.0.1");
+	lines.emplace_back("Stats: name = test-01");
+	lines.emplace_back("Stats: address = 127.0.0.2");
+	lines.emplace_back("StatsAnd: 2");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	Array::Ptr res = Array::Ptr(JsonDecode(LivestatusQueryHelper(lines)))->Get(0);
+	BOOST_REQUIRE(res->GetLength() == 5);
+
+	/* aggregators which refer to the same columns share the resolved values of each row */
+	BOOST_CHECK(res->Get(0) == 1);
+	BOOST_CHECK(res->Get(1) == 1);
+	BOOST_CHECK(res->Get(2) == 2);
+	BOOST_CHECK(res->Get(3) == 1);
+	BOOST_CHECK(res->Get(4) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(output_formats)
+{
+	Service::Ptr service = Service::GetByNamePair("test-02", "livestatus");
+	BOOST_REQUIRE(service);
+
+	CheckResult::Ptr cr = new CheckResult();
+	cr->SetOutput("a\"b\\c\nd\te\x01");
+	cr->SetExecutionStart(1.25);
+	cr->SetExecutionEnd(3.5);
+	cr->SetPerformanceData(new Array({ "load=1.5", "x=1" }));
+	service->SetLastCheckResult(cr);
+
+	std::vector<String> lines;
+	lines.emplace_back("GET services");
+	lines.emplace_back("Columns: plugin_output long_plugin_output perf_data execution_time");
+	lines.emplace_back("Filter: host_name = test-02");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	LivestatusQuery::Ptr query = new LivestatusQuery(lines, "");
+	std::stringstream stream;
+	query->Execute(new StdioStream(&stream, false));
+
+	BOOST_CHECK(stream.str() == "[[\"a\\\"b\\\\c\",\"d\\te\\u0001\",\"load=1.5 x=1\",2.25]]");
+
+	lines[3] = "OutputFormat: csv";
+
+	query = new LivestatusQuery(lines, "");
+	stream.str("");
+	query->Execute(new StdioStream(&stream, false));
+
+	BOOST_CHECK(stream.str() == "a\"b\\c;d\te\x01;load=1.5 x=1;2.250000\n");
+
+	lines[3] = "OutputFormat: python";
+
+	query = new LivestatusQuery(lines, "");
+	stream.str("");
+	query->Execute(new StdioStream(&stream, false));
+
+	BOOST_CHECK(stream.str() == "[[ r\"a\\\"b\\c\", r\"d\te\x01\", r\"load=1.5 x=1\", 2.250000 ]]");
+}
+
+BOOST_AUTO_TEST_CASE(index_filter)
+{
+	std::vector<String> lines;
+	lines.emplace_back("GET services");
+	lines.emplace_back("Columns: host_name service_description");
+	lines.emplace_back("Filter: host_name = test-01");
+	lines.emplace_back("Filter: service_description = livestatus");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	LivestatusQuery::Ptr query = new LivestatusQuery(lines, "");
+
+	std::stringstream stream;
+	query->Execute(new StdioStream(&stream, false));
+
+	/* only the services of the matching host are visited */
+	BOOST_CHECK(query->GetRowsScanned() == 1);
+	BOOST_CHECK(query->GetRowsReturned() == 1);
+
+	/* negated predicates are not used for index lookups */
+	lines[2] = "Filter: host_name != test-01";
+
+	query = new LivestatusQuery(lines, "");
+	query->Execute(new StdioStream(&stream, false));
+
+	BOOST_CHECK(query->GetRowsScanned() == 2);
+	BOOST_CHECK(query->GetRowsReturned() == 1);
+
+	lines[0] = "GET hosts";
+	lines[1] = "Columns: name";
+	lines[2] = "Filter: name = test-02";
+	lines[3] = "Filter: name = test-01";
+
+	query = new LivestatusQuery(lines, "");
+	query->Execute(new StdioStream(&stream, false));
+
+	BOOST_CHECK(query->GetRowsScanned() == 1);
+	BOOST_CHECK(query->GetRowsReturned() == 0);
+
+	/* group memberships are looked up through the object references */
+	lines[0] = "GET services";
+	lines[1] = "Columns: host_name";
+	lines[2] = "Filter: host_groups >= test-hosts";
+	lines[3] = "Filter: service_description = livestatus";
+
+	query = new LivestatusQuery(lines, "");
+	query->Execute(new StdioStream(&stream, false));
+
+	BOOST_CHECK(query->GetRowsScanned() == 1);
+	BOOST_CHECK(query->GetRowsReturned() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(api_handler)
+{
+	ScriptGlobal::Set("LocalStateDir", ".");
+
+	ApiUser::Ptr user = new ApiUser();
+	user->SetPermissions(new Array({ "livestatus/query" }));
+
+	HttpRequest request(nullptr);
+	request.RequestMethod = "POST";
+	request.RequestUrl = new Url("/v1/livestatus");
+
+	Dictionary::Ptr params = new Dictionary({
+		{ "query", "GET hosts\nColumns: name\nFilter: name = test-01\nOutputFormat: json\nResponseHeader: fixed16\n" }
+	});
+
+	std::stringstream stream;
+	LivestatusHandler::Ptr handler = new LivestatusHandler();
+
+	{
+		HttpResponse response(new StdioStream(&stream, false), request);
+		BOOST_CHECK(handler->HandleRequest(user, request, response, params));
+		BOOST_CHECK(response.StatusCode == 200);
+		response.Finish();
+	}
+
+	/* the body only contains the result set */
+	String output = stream.str();
+	BOOST_CHECK(output.Find("\r\n[[\"test-01\"]]\r\n") != String::NPos);
+
+	params->Set("query", "GET nonexistent\n");
+
+	{
+		HttpResponse response(new StdioStream(&stream, false), request);
+		BOOST_CHECK(handler->HandleRequest(user, request, response, params));
+		BOOST_CHECK(response.StatusCode == 404);
+	}
+
+	/* commands require a separate permission */
+	params->Set("query", "COMMAND [1234] SCHEDULE_FORCED_HOST_CHECK;test-01;1234\n");
+
+	{
+		HttpResponse response(new StdioStream(&stream, false), request);
+		BOOST_CHECK_THROW(handler->HandleRequest(user, request, response, params), ScriptError);
+	}
+
+	ScriptGlobal::GetGlobals()->Remove("LocalStateDir");
+}
+
+BOOST_AUTO_TEST_CASE(chunked_output)
+{
+	std::vector<String> lines;
+	lines.emplace_back("GET hosts");
+	lines.emplace_back("Columns: name");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("ResponseHeader: chunked");
+	lines.emplace_back("\n");
+
+	LivestatusQuery::Ptr query = new LivestatusQuery(lines, "");
+
+	std::stringstream stream;
+	query->Execute(new StdioStream(&stream, false));
+
+	String output = stream.str();
+	BOOST_REQUIRE(output.GetLength() > 32);
+
+	String header = output.SubStr(0, 16);
+	BOOST_CHECK(header.SubStr(0, 4) == "200 ");
+
+	size_t length = Convert::ToLong(header.SubStr(4).Trim());
+	BOOST_REQUIRE(output.GetLength() == 16 + length + 16);
+
+	Array::Ptr result = JsonDecode(output.SubStr(16, length));
+	BOOST_CHECK(result->GetLength() == 2);
+
+	/* the response is terminated by an empty chunk */
+	BOOST_CHECK(output.SubStr(16 + length) == "200           0\n");
+}
+
+static void WriteLogLines(const String& path, int from, int until)
+{
+	std::ofstream fp(path.CStr(), std::ofstream::out | std::ofstream::app);
+
+	for (int ts = from; ts < until; ts++)
+		fp << "[" << ts << "] LOG VERSION: 2.0\n";
+}
+
+BOOST_AUTO_TEST_CASE(log_index)
+{
+	String path = "icinga2-livestatus-log-test-" + Convert::ToString(Utility::GetPid());
+	Utility::MkDirP(path + "/archives", 0750);
+
+	WriteLogLines(path + "/archives/icinga-1.log", 1000000000, 1000002000);
+	WriteLogLines(path + "/icinga.log", 1000002000, 1000005000);
+
+	std::vector<String> lines;
+	lines.emplace_back("GET log");
+	lines.emplace_back("Columns: time lineno");
+	lines.emplace_back("Filter: time >= 1000003500");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	Array::Ptr res = JsonDecode(LivestatusQueryHelper(lines, path));
+	BOOST_CHECK(res->GetLength() == 1500);
+	BOOST_CHECK(Array::Ptr(res->Get(0))->Get(1) == 1500);
+
+	/* lines appended to the current log file are picked up */
+	WriteLogLines(path + "/icinga.log", 1000005000, 1000005100);
+
+	res = JsonDecode(LivestatusQueryHelper(lines, path));
+	BOOST_CHECK(res->GetLength() == 1600);
+
+	/* archived log files which overlap the time window are not skipped */
+	lines[2] = "Filter: time >= 1000001900";
+
+	res = JsonDecode(LivestatusQueryHelper(lines, path));
+	BOOST_CHECK(res->GetLength() == 3200);
+
+	Utility::RemoveDirRecursive(path);
+}
+BOOST_AUTO_TEST_CASE(statehist_extract)
+{
+	String path = "icinga2-livestatus-statehist-test-" + Convert::ToString(Utility::GetPid());
+	Utility::MkDirP(path + "/archives", 0750);
+
+	{
+		std::ofstream fp((path + "/archives/icinga-1.log").CStr());
+
+		fp << "[1000000000] CURRENT HOST STATE: test-01;UP;HARD;1;ok\n";
+
+		for (int ts = 1000000001; ts < 1000003000; ts++) {
+			if (ts == 1000001500)
+				fp << "[" << ts << "] HOST ALERT: test-01;DOWN;HARD;1;down\n";
+			else
+				fp << "[" << ts << "] EXTERNAL COMMAND: PROCESS_HOST_CHECK_RESULT;test-02;0;ok\n";
+		}
+	}
+
+	{
+		std::ofstream fp((path + "/icinga.log").CStr());
+
+		fp << "[1000003000] EXTERNAL COMMAND: PROCESS_HOST_CHECK_RESULT;test-02;0;ok\n";
+		fp << "[1000003500] HOST ALERT: test-01;UP;HARD;1;ok\n";
+	}
+
+	ScriptGlobal::Set("LocalStateDir", path);
+
+	std::vector<String> lines;
+	lines.emplace_back("GET statehist");
+	lines.emplace_back("Columns: state from until");
+	lines.emplace_back("Filter: time >= 1000000000");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	for (int i = 0; i < 2; i++) {
+		Array::Ptr res = JsonDecode(LivestatusQueryHelper(lines, path));
+		BOOST_REQUIRE(res->GetLength() == 3);
+
+		Array::Ptr row = res->Get(0);
+		BOOST_CHECK(row->Get(0) == 0);
+		BOOST_CHECK(row->Get(1) == 1000000000);
+		BOOST_CHECK(row->Get(2) == 1000001500);
+
+		row = res->Get(1);
+		BOOST_CHECK(row->Get(0) == 1);
+		BOOST_CHECK(row->Get(2) == 1000003500);
+
+		row = res->Get(2);
+		BOOST_CHECK(row->Get(0) == 0);
+		BOOST_CHECK(row->Get(1) == 1000003500);
+	}
+
+	/* only the archived log file is extracted */
+	BOOST_CHECK(Utility::PathExists(path + "/cache/icinga2/livestatus-statehist/icinga-1.log.json"));
+	BOOST_CHECK(!Utility::PathExists(path + "/cache/icinga2/livestatus-statehist/icinga.log.json"));
+
+	ScriptGlobal::GetGlobals()->Remove("LocalStateDir");
+
+	Utility::RemoveDirRecursive(path);
+}
+
+BOOST_AUTO_TEST_CASE(query_cache)
+{
+	std::vector<String> lines;
+	lines.emplace_back("GET hosts");
+	lines.emplace_back("Columns:name");
+	lines.emplace_back("OutputFormat:  json");
+	lines.emplace_back("KeepAlive: on");
+
+	std::vector<String> other;
+	other.emplace_back("GET hosts");
+	other.emplace_back("Columns: name");
+	other.emplace_back("OutputFormat: json");
+
+	/* the key ignores formatting differences and the KeepAlive header */
+	String key = LivestatusQueryCache::GetQueryKey(lines);
+	BOOST_CHECK(key == LivestatusQueryCache::GetQueryKey(other));
+
+	other.emplace_back("AuthUser: admin");
+	BOOST_CHECK(key != LivestatusQueryCache::GetQueryKey(other));
+
+	std::vector<String> command;
+	command.emplace_back("COMMAND [1234] SCHEDULE_FORCED_HOST_CHECK;test-01;1234");
+	BOOST_CHECK(LivestatusQueryCache::GetQueryKey(command).IsEmpty());
+
+	LivestatusQueryCache cache;
+
+	uint_fast64_t generation = LivestatusQueryCache::GetGeneration();
+
+	std::stringstream stream;
+	LivestatusCaptureStream::Ptr capture = new LivestatusCaptureStream(new StdioStream(&stream, false),
+		LivestatusQueryCache::GetMaxResponseSize());
+
+	LivestatusQuery::Ptr query = new LivestatusQuery(lines, "");
+	BOOST_CHECK(query->Execute(capture));
+	BOOST_CHECK(query->GetResponseCode() == LivestatusErrorOK);
+	BOOST_REQUIRE(capture->IsComplete());
+	BOOST_CHECK(capture->GetData() == stream.str());
+
+	cache.AddResponse(key, generation, capture->GetData());
+
+	String response;
+	BOOST_CHECK(cache.GetResponse(key, 60, response));
+	BOOST_CHECK(response == stream.str());
+
+	/* entries expire after the maximum age */
+	BOOST_CHECK(!cache.GetResponse(key, -1, response));
+	BOOST_CHECK(!cache.GetResponse(key, 60, response));
+
+	/* and whenever a check result is processed */
+	cache.AddResponse(key, generation, capture->GetData());
+
+	Service::Ptr service = Service::GetByNamePair("test-01", "livestatus");
+	BOOST_REQUIRE(service);
+
+	CheckResult::Ptr cr = new CheckResult();
+	cr->SetState(ServiceOK);
+	service->ProcessCheckResult(cr);
+
+	BOOST_CHECK(LivestatusQueryCache::GetGeneration() != generation);
+	BOOST_CHECK(!cache.GetResponse(key, 60, response));
+
+	BOOST_CHECK(cache.GetHits() == 1);
+	BOOST_CHECK(cache.GetMisses() == 3);
+}
 //____________________________________________________________________________//
 
 BOOST_AUTO_TEST_SUITE_END()
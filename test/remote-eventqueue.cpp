@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/eventqueue.hpp"
+#include "config/configcompiler.hpp"
+#include "base/objectlock.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(remote_eventqueue)
+
+static EncodedMessage::Ptr MakeEvent(int id)
+{
+	return new EncodedMessage(new Dictionary({
+		{ "type", "CheckResult" },
+		{ "id", id }
+	}));
+}
+
+BOOST_AUTO_TEST_CASE(shared)
+{
+	EventQueue::Ptr queue = new EventQueue("test");
+
+	int client1, client2;
+	queue->AddClient(&client1);
+	queue->AddClient(&client2);
+
+	EncodedMessage::Ptr event = MakeEvent(1);
+	queue->ProcessEvent(event);
+
+	BOOST_CHECK(queue->WaitForEvent(&client1, 0) == event);
+	BOOST_CHECK(queue->WaitForEvent(&client2, 0) == event);
+	BOOST_CHECK(!queue->WaitForEvent(&client1, 0));
+
+	Dictionary::Ptr status = queue->GetStatus();
+	BOOST_CHECK(status->Get("buffered_events") == 0);
+
+	queue->RemoveClient(&client1);
+	queue->RemoveClient(&client2);
+}
+
+BOOST_AUTO_TEST_CASE(lag)
+{
+	EventQueue::Ptr queue = new EventQueue("test");
+	queue->SetBufferSize(2);
+
+	int fast, slow;
+	queue->AddClient(&fast, "fast");
+	queue->AddClient(&slow, "slow");
+
+	for (int i = 0; i < 5; i++) {
+		queue->ProcessEvent(MakeEvent(i));
+		BOOST_CHECK(queue->WaitForEvent(&fast, 0)->GetMessage()->Get("id") == i);
+	}
+
+	Dictionary::Ptr status = queue->GetStatus();
+	BOOST_CHECK(status->Get("buffered_events") == 2);
+
+	Array::Ptr clients = status->Get("clients");
+	BOOST_CHECK(clients->GetLength() == 2);
+
+	ObjectLock olock(clients);
+	for (const Dictionary::Ptr& client : clients) {
+		if (client->Get("name") == "slow") {
+			BOOST_CHECK(client->Get("lag") == 2);
+			BOOST_CHECK(client->Get("dropped") == 3);
+		} else {
+			BOOST_CHECK(client->Get("lag") == 0);
+			BOOST_CHECK(client->Get("dropped") == 0);
+		}
+	}
+
+	BOOST_CHECK(queue->WaitForEvent(&slow, 0)->GetMessage()->Get("id") == 3);
+	BOOST_CHECK(queue->WaitForEvent(&slow, 0)->GetMessage()->Get("id") == 4);
+	BOOST_CHECK(!queue->WaitForEvent(&slow, 0));
+
+	queue->RemoveClient(&fast);
+	queue->RemoveClient(&slow);
+}
+
+BOOST_AUTO_TEST_CASE(dispatch)
+{
+	EventQueue::Ptr queue1 = new EventQueue("test1");
+	EventQueue::Ptr queue2 = new EventQueue("test2");
+	EventQueue::Register("test1", queue1);
+	EventQueue::Register("test2", queue2);
+
+	queue1->SetTypes({ "CheckResult" });
+	queue1->SetFilter(ConfigCompiler::CompileText("<test>", "event.host == \"web01\" && event.id > 1"));
+	queue2->SetTypes({ "CheckResult" });
+	queue2->SetFilter(ConfigCompiler::CompileText("<test>", "event.service in [ \"ping4\" ]"));
+
+	int client1, client2;
+	queue1->AddClient(&client1);
+	queue2->AddClient(&client2);
+
+	BOOST_CHECK(EventQueue::GetQueuesForType("CheckResult").size() == 2);
+	BOOST_CHECK(EventQueue::GetQueuesForType("StateChange").empty());
+
+	EventQueue::DispatchEvent(new EncodedMessage(new Dictionary({
+		{ "type", "CheckResult" },
+		{ "host", "web01" },
+		{ "id", 1 }
+	})));
+
+	EventQueue::DispatchEvent(new EncodedMessage(new Dictionary({
+		{ "type", "CheckResult" },
+		{ "host", "web01" },
+		{ "service", "ping4" },
+		{ "id", 2 }
+	})));
+
+	EventQueue::DispatchEvent(new EncodedMessage(new Dictionary({
+		{ "type", "CheckResult" },
+		{ "host", "web02" },
+		{ "service", "ssh" },
+		{ "id", 3 }
+	})));
+
+	BOOST_CHECK(queue1->WaitForEvent(&client1, 0)->GetMessage()->Get("id") == 2);
+	BOOST_CHECK(!queue1->WaitForEvent(&client1, 0));
+	BOOST_CHECK(queue2->WaitForEvent(&client2, 0)->GetMessage()->Get("id") == 2);
+	BOOST_CHECK(!queue2->WaitForEvent(&client2, 0));
+
+	queue1->RemoveClient(&client1);
+	queue2->RemoveClient(&client2);
+
+	EventQueue::Unregister("test1");
+	EventQueue::Unregister("test2");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
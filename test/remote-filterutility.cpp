@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/filterutility.hpp"
+#include "remote/customvarindex.hpp"
+#include "remote/zone.hpp"
+#include "config/configcompiler.hpp"
+#include "base/scriptglobal.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(remote_filterutility)
+
+BOOST_AUTO_TEST_CASE(predicates)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>",
+		"event.host == \"web01\" && event.service in [ \"ping4\", \"ssh\" ] && event.check_result.state > 0 && event.type == \"x\"");
+	std::vector<FilterPredicate> predicates = FilterUtility::GetFilterPredicates(expr.get());
+
+	BOOST_CHECK(predicates.size() == 2);
+	BOOST_CHECK(predicates[0].Variable == "event");
+	BOOST_CHECK(predicates[0].Path == std::vector<String>{ "host" });
+	BOOST_CHECK(!predicates[0].Membership);
+	BOOST_CHECK(predicates[0].Values == std::set<String>{ "web01" });
+	BOOST_CHECK(predicates[1].Path == std::vector<String>{ "service" });
+	BOOST_CHECK((predicates[1].Values == std::set<String>{ "ping4", "ssh" }));
+
+	expr = ConfigCompiler::CompileText("<test>", "\"linux\" in host.vars.groups");
+	predicates = FilterUtility::GetFilterPredicates(expr.get());
+
+	BOOST_CHECK(predicates.size() == 1);
+	BOOST_CHECK(predicates[0].Variable == "host");
+	BOOST_CHECK((predicates[0].Path == std::vector<String>{ "vars", "groups" }));
+	BOOST_CHECK(predicates[0].Membership);
+
+	expr = ConfigCompiler::CompileText("<test>", "event.host == \"web01\" || event.host == \"web02\"");
+	BOOST_CHECK(FilterUtility::GetFilterPredicates(expr.get()).empty());
+
+	expr = ConfigCompiler::CompileText("<test>", "host.name == h && host.vars.os == os");
+	predicates = FilterUtility::GetFilterPredicates(expr.get(), new Dictionary({ { "h", "web01" } }));
+
+	BOOST_CHECK(predicates.size() == 1);
+	BOOST_CHECK(predicates[0].Values == std::set<String>{ "web01" });
+}
+
+BOOST_AUTO_TEST_CASE(custom_var_index)
+{
+	ScriptGlobal::Set("CustomVarIndexes", new Array({ "os", "location.city" }));
+
+	Zone::Ptr z1 = new Zone();
+	Zone::Ptr z2 = new Zone();
+
+	CustomVarIndex::UpdateObject(z1, new Dictionary({
+		{ "os", "Linux" },
+		{ "location", new Dictionary({ { "city", "Berlin" } }) }
+	}));
+	CustomVarIndex::UpdateObject(z2, new Dictionary({
+		{ "os", new Array({ "Linux", "Windows" }) }
+	}));
+
+	std::set<ConfigObject::Ptr> result;
+	BOOST_CHECK(CustomVarIndex::GetObjects(Zone::TypeInstance, { "os" }, false, { "Linux" }, result));
+	BOOST_CHECK(result == std::set<ConfigObject::Ptr>{ z1 });
+
+	result.clear();
+	BOOST_CHECK(CustomVarIndex::GetObjects(Zone::TypeInstance, { "os" }, true, { "Windows" }, result));
+	BOOST_CHECK(result == std::set<ConfigObject::Ptr>{ z2 });
+
+	result.clear();
+	BOOST_CHECK(CustomVarIndex::GetObjects(Zone::TypeInstance, { "location", "city" }, false, { "Berlin", "Paris" }, result));
+	BOOST_CHECK(result == std::set<ConfigObject::Ptr>{ z1 });
+
+	BOOST_CHECK(!CustomVarIndex::GetObjects(Zone::TypeInstance, { "location" }, false, { "Berlin" }, result));
+
+	CustomVarIndex::UpdateObject(z1, new Dictionary({ { "os", "Windows" } }));
+
+	result.clear();
+	BOOST_CHECK(CustomVarIndex::GetObjects(Zone::TypeInstance, { "os" }, false, { "Linux" }, result));
+	BOOST_CHECK(result.empty());
+
+	CustomVarIndex::RemoveObject(z2);
+
+	result.clear();
+	BOOST_CHECK(CustomVarIndex::GetObjects(Zone::TypeInstance, { "os" }, true, { "Linux", "Windows" }, result));
+	BOOST_CHECK(result.empty());
+
+	CustomVarIndex::RemoveObject(z1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,249 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+#include "remote/httpconnectionpool.hpp"
+#include "remote/httputility.hpp"
+#include "base/fifo.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+/**
+ * A connection which answers each request with the next canned response.
+ */
+class TestConnection final : public Stream
+{
+public:
+	DECLARE_PTR_TYPEDEFS(TestConnection);
+
+	TestConnection(const std::vector<String>& responses)
+		: m_Responses(responses), m_Input(new FIFO())
+	{ }
+
+	size_t Read(void *buffer, size_t count, bool allow_partial) override
+	{
+		/* Pipelined requests are answered one after another. */
+		if (m_Input->GetAvailableBytes() == 0 && m_Answered < CountRequests() && !m_Responses.empty()) {
+			m_Input->Write(m_Responses.front().CStr(), m_Responses.front().GetLength());
+			m_Responses.erase(m_Responses.begin());
+			m_Answered++;
+		}
+
+		return m_Input->Read(buffer, count, allow_partial);
+	}
+
+	void Write(const void *buffer, size_t count) override
+	{
+		Requests += String(static_cast<const char *>(buffer), static_cast<const char *>(buffer) + count);
+	}
+
+	void Close() override
+	{
+		Closed = true;
+	}
+
+	bool IsEof() const override
+	{
+		return m_Responses.empty() && m_Input->GetAvailableBytes() == 0;
+	}
+
+	String Requests;
+	bool Closed{false};
+
+private:
+	std::vector<String> m_Responses;
+	FIFO::Ptr m_Input;
+	size_t m_Answered{0};
+
+	size_t CountRequests() const
+	{
+		size_t count = 0;
+
+		for (size_t pos = Requests.Find("POST "); pos != String::NPos; pos = Requests.Find("POST ", pos + 1))
+			count++;
+
+		return count;
+	}
+};
+
+static const String l_NoContent = "HTTP/1.1 204 No Content\r\n\r\n";
+static const String l_NoContentClose = "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n";
+
+static void PrepareRequest(HttpRequest& request)
+{
+	Url::Ptr url = new Url("http://localhost/write");
+
+	request.RequestMethod = "POST";
+	request.RequestUrl = url;
+	request.WriteBody("data", 4);
+}
+
+static void SendRequests(HttpConnectionPool& pool, int count)
+{
+	for (int i = 0; i < count; i++) {
+		int statusCode = 0;
+
+		pool.SendRequest(&PrepareRequest, [&statusCode](HttpResponse& response) {
+			statusCode = response.StatusCode;
+		});
+
+		BOOST_CHECK(statusCode == 204);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(remote_httpconnectionpool)
+
+BOOST_AUTO_TEST_CASE(reuse)
+{
+	std::vector<TestConnection::Ptr> connections;
+
+	HttpConnectionPool pool([&connections]() {
+		TestConnection::Ptr connection = new TestConnection({ l_NoContent, l_NoContent, l_NoContent });
+		connections.push_back(connection);
+		return connection;
+	}, 1);
+
+	SendRequests(pool, 3);
+
+	BOOST_CHECK(connections.size() == 1);
+	BOOST_CHECK(pool.GetIdleConnections() == 1);
+	BOOST_CHECK(connections[0]->Requests.Find("POST /write HTTP/1.1") != String::NPos);
+
+	pool.Clear();
+
+	BOOST_CHECK(pool.GetIdleConnections() == 0);
+	BOOST_CHECK(connections[0]->Closed);
+}
+
+BOOST_AUTO_TEST_CASE(connection_close)
+{
+	std::vector<TestConnection::Ptr> connections;
+
+	HttpConnectionPool pool([&connections]() {
+		TestConnection::Ptr connection = new TestConnection({ l_NoContentClose });
+		connections.push_back(connection);
+		return connection;
+	}, 1);
+
+	SendRequests(pool, 2);
+
+	BOOST_CHECK(connections.size() == 2);
+	BOOST_CHECK(pool.GetIdleConnections() == 0);
+	BOOST_CHECK(connections[0]->Closed);
+	BOOST_CHECK(connections[1]->Closed);
+}
+
+BOOST_AUTO_TEST_CASE(reconnect)
+{
+	std::vector<TestConnection::Ptr> connections;
+
+	/* The server closes each connection after the first response without telling us. */
+	HttpConnectionPool pool([&connections]() {
+		TestConnection::Ptr connection = new TestConnection({ l_NoContent });
+		connections.push_back(connection);
+		return connection;
+	}, 1);
+
+	SendRequests(pool, 2);
+
+	BOOST_CHECK(connections.size() == 2);
+	BOOST_CHECK(connections[0]->Closed);
+	BOOST_CHECK(pool.GetIdleConnections() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(async)
+{
+	std::vector<TestConnection::Ptr> connections;
+
+	HttpConnectionPool pool([&connections]() {
+		TestConnection::Ptr connection = new TestConnection({ l_NoContent, l_NoContent, l_NoContent, l_NoContent });
+		connections.push_back(connection);
+		return connection;
+	}, 1, 4);
+
+	boost::mutex mutex;
+	boost::condition_variable cv;
+	int completed = 0;
+	int noContent = 0;
+
+	for (int i = 0; i < 4; i++) {
+		auto statusCode = std::make_shared<int>(0);
+
+		pool.SubmitRequest(&PrepareRequest, [statusCode](HttpResponse& response) {
+			*statusCode = response.StatusCode;
+		}, [&mutex, &cv, &completed, &noContent, statusCode](boost::exception_ptr exp) {
+			boost::mutex::scoped_lock lock(mutex);
+
+			if (!exp && *statusCode == 204)
+				noContent++;
+
+			completed++;
+			cv.notify_all();
+		});
+	}
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	while (completed < 4)
+		cv.wait(lock);
+
+	BOOST_CHECK(noContent == 4);
+	BOOST_CHECK(connections.size() == 1);
+	BOOST_CHECK(pool.GetPendingRequests() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(retries)
+{
+	int attempts = 0;
+
+	/* The first two connection attempts fail. */
+	HttpConnectionPool pool([&attempts]() -> Stream::Ptr {
+		if (++attempts <= 2)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Connection refused"));
+
+		return new TestConnection({ l_NoContent });
+	}, 1);
+
+	pool.SetMaxRetries(2);
+	SendRequests(pool, 1);
+
+	BOOST_CHECK(attempts == 3);
+
+	HttpConnectionPool failingPool([]() -> Stream::Ptr {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Connection refused"));
+	}, 1);
+
+	BOOST_CHECK_THROW(failingPool.SendRequest(&PrepareRequest, [](HttpResponse&) { }), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(gzip)
+{
+	if (!HttpUtility::IsCompressionSupported())
+		return;
+
+	String body = String(1000, 'x');
+	String compressed = HttpUtility::GzipCompress(body);
+
+	BOOST_CHECK(compressed.GetLength() < body.GetLength());
+	BOOST_CHECK(compressed.GetLength() > 2);
+	BOOST_CHECK(static_cast<unsigned char>(compressed[0]) == 0x1f);
+	BOOST_CHECK(static_cast<unsigned char>(compressed[1]) == 0x8b);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
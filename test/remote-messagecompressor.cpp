@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+#include "remote/messagecompressor.hpp"
+#include "base/convert.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(remote_messagecompressor)
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	if (!MessageCompressor::IsSupported())
+		return;
+
+	MessageCompressor compressor;
+	MessageDecompressor decompressor;
+
+	for (int i = 0; i < 100; i++) {
+		String message = "{\"jsonrpc\":\"2.0\",\"method\":\"event::CheckResult\",\"params\":{\"host\":\"host"
+			+ Convert::ToString(i) + "\",\"cr\":{\"output\":\"OK - " + String(i * 10, 'x') + "\"}}}";
+
+		String compressed = compressor.Compress(message);
+
+		BOOST_CHECK(MessageDecompressor::IsCompressedMessage(compressed));
+		BOOST_CHECK(compressed.GetLength() < message.GetLength());
+		BOOST_CHECK(decompressor.Decompress(compressed) == message);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(uncompressed)
+{
+	BOOST_CHECK(!MessageDecompressor::IsCompressedMessage(""));
+	BOOST_CHECK(!MessageDecompressor::IsCompressedMessage("{\"jsonrpc\":\"2.0\"}"));
+	BOOST_CHECK(!MessageDecompressor::IsCompressedMessage("\x81\xa7jsonrpc"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
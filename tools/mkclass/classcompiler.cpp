@@ -270,7 +270,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		m_Impl << "\t" << "int offset = ";
 
 		if (!klass.Parent.empty())
-			m_Impl << klass.Parent << "::TypeInstance->GetFieldCount()";
+			m_Impl << klass.Parent << "::FieldCount";
 		else
 			m_Impl << "0";
 
@@ -334,7 +334,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		<< "{" << std::endl;
 
 	if (!klass.Parent.empty())
-		m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount();" << std::endl
+		m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::FieldCount;" << std::endl
 			<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::TypeInstance->GetFieldInfo(id); }" << std::endl;
 
 	if (!klass.Fields.empty()) {
@@ -374,6 +374,32 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 
 	m_Impl << "}" << std::endl << std::endl;
 
+	/* GetFieldName */
+	m_Header << "\t" << "String GetFieldName(int id) const override;" << std::endl;
+
+	m_Impl << "String TypeImpl<" << klass.Name << ">::GetFieldName(int id) const" << std::endl
+		<< "{" << std::endl;
+
+	if (!klass.Parent.empty())
+		m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::FieldCount;" << std::endl
+			<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::TypeInstance->GetFieldName(id); }" << std::endl;
+	else
+		m_Impl << "\t" << "int real_id = id;" << std::endl;
+
+	if (!klass.Fields.empty()) {
+		m_Impl << "\t" << "static const String names[] = {" << std::endl;
+
+		for (const Field& field : klass.Fields)
+			m_Impl << "\t\t" << "String::Intern(\"" << field.Name << "\")," << std::endl;
+
+		m_Impl << "\t" << "};" << std::endl << std::endl
+			<< "\t" << "if (real_id >= 0 && real_id < " << klass.Fields.size() << ")" << std::endl
+			<< "\t\t" << "return names[real_id];" << std::endl << std::endl;
+	}
+
+	m_Impl << "\t" << "throw std::runtime_error(\"Invalid field ID.\");" << std::endl
+		<< "}" << std::endl << std::endl;
+
 	/* GetFieldCount */
 	m_Header << "\t" << "int GetFieldCount() const override;" << std::endl;
 
@@ -382,11 +408,19 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		<< "\t" << "return " << klass.Fields.size();
 
 	if (!klass.Parent.empty())
-		m_Impl << " + " << klass.Parent << "::TypeInstance->GetFieldCount()";
+		m_Impl << " + " << klass.Parent << "::FieldCount";
 
 	m_Impl << ";" << std::endl
 		<< "}" << std::endl << std::endl;
 
+	/* GetFieldAccessor */
+	m_Header << "\t" << "FieldAccessor GetFieldAccessor(int id) const override;" << std::endl;
+
+	m_Impl << "FieldAccessor TypeImpl<" << klass.Name << ">::GetFieldAccessor(int id) const" << std::endl
+		<< "{" << std::endl
+		<< "\t" << "return ObjectImpl<" << klass.Name << ">::GetFieldAccessor(id);" << std::endl
+		<< "}" << std::endl << std::endl;
+
 	/* GetFactory */
 	m_Header << "\t" << "ObjectFactory GetFactory() const override;" << std::endl;
 
@@ -424,7 +458,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		<< "{" << std::endl;
 
 	if (!klass.Parent.empty())
-		m_Impl << "\t" << "int real_id = fieldId - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+		m_Impl << "\t" << "int real_id = fieldId - " << klass.Parent << "::FieldCount; " << std::endl
 			<< "\t" << "if (real_id < 0) { " << klass.Parent << "::TypeInstance->RegisterAttributeHandler(fieldId, callback); return; }" << std::endl;
 
 	if (!klass.Fields.empty()) {
@@ -467,6 +501,46 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		<< "public:" << std::endl
 		<< "\t" << "DECLARE_PTR_TYPEDEFS(ObjectImpl<" << klass.Name << ">);" << std::endl << std::endl;
 
+	/* field IDs */
+	std::string fieldOffset = klass.Parent.empty() ? "0" : klass.Parent + "::FieldCount";
+
+	m_Header << "\t" << "enum {" << std::endl;
+
+	size_t fnum = 0;
+	for (const Field& field : klass.Fields) {
+		m_Header << "\t\t" << "FieldId" << field.GetFriendlyName() << " = " << fieldOffset << " + " << fnum << "," << std::endl;
+		fnum++;
+	}
+
+	m_Header << "\t\t" << "FieldCount = " << fieldOffset << " + " << klass.Fields.size() << std::endl
+		<< "\t" << "};" << std::endl << std::endl;
+
+	/* GetFieldAccessor */
+	m_Header << "\t" << "static FieldAccessor GetFieldAccessor(int id);" << std::endl << std::endl;
+
+	m_Impl << "FieldAccessor ObjectImpl<" << klass.Name << ">::GetFieldAccessor(int id)" << std::endl
+		<< "{" << std::endl;
+
+	if (!klass.Parent.empty())
+		m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::FieldCount;" << std::endl
+			<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::GetFieldAccessor(id); }" << std::endl;
+	else
+		m_Impl << "\t" << "int real_id = id;" << std::endl;
+
+	m_Impl << "\t" << "switch (real_id) {" << std::endl;
+
+	fnum = 0;
+	for (const Field& field : klass.Fields) {
+		m_Impl << "\t\t" << "case " << fnum << ":" << std::endl
+			<< "\t\t\t" << "return [](const Object *object) -> Value { return static_cast<const ObjectImpl<" << klass.Name << "> *>(object)->Get" << field.GetFriendlyName() << "(); };" << std::endl;
+		fnum++;
+	}
+
+	m_Impl << "\t\t" << "default:" << std::endl
+		<< "\t\t\t" << "return nullptr;" << std::endl
+		<< "\t" << "}" << std::endl
+		<< "}" << std::endl << std::endl;
+
 	/* Validate */
 	m_Header << "\t" << "void Validate(int types, const ValidationUtils& utils) override;" << std::endl;
 
@@ -580,6 +654,111 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 	m_Impl << "ObjectImpl<" << klass.Name << ">::~ObjectImpl()" << std::endl
 		<< "{ }" << std::endl << std::endl;
 
+	/* SerializeFields */
+	m_Header << "public:" << std::endl
+			<< "\t" << "void SerializeFields(DictionaryData& fields, int attributeTypes) const override;" << std::endl;
+
+	m_Impl << "void ObjectImpl<" << klass.Name << ">::SerializeFields(DictionaryData& fields, int attributeTypes) const" << std::endl
+		<< "{" << std::endl;
+
+	if (!klass.Parent.empty())
+		m_Impl << "\t" << klass.Parent << "::SerializeFields(fields, attributeTypes);" << std::endl << std::endl;
+
+	if (!klass.Fields.empty()) {
+		m_Impl << "\t" << "static const String names[] = {" << std::endl;
+
+		for (const Field& field : klass.Fields)
+			m_Impl << "\t\t" << "String::Intern(\"" << field.Name << "\")," << std::endl;
+
+		m_Impl << "\t" << "};" << std::endl;
+	}
+
+	size_t snum = 0;
+	for (const Field& field : klass.Fields) {
+		/* The serializer adds the type's name as the "type" attribute. */
+		if (field.Name == "type") {
+			snum++;
+			continue;
+		}
+
+		std::string realType = field.Type.GetRealType();
+		bool scalar = (field.Attributes & FAEnum) || realType == "String" || realType == "double" ||
+			realType == "int" || realType == "bool" || realType == "Timestamp";
+
+		m_Impl << std::endl
+			<< "\t" << "if (attributeTypes == 0 || (attributeTypes & " << field.Attributes << ") != 0)" << std::endl
+			<< "\t\t" << "fields.emplace_back(names[" << snum << "], ";
+
+		if (field.Attributes & FAEnum)
+			m_Impl << "static_cast<int>(Get" << field.GetFriendlyName() << "())";
+		else if (scalar)
+			m_Impl << "Get" << field.GetFriendlyName() << "()";
+		else
+			m_Impl << "Serialize(Get" << field.GetFriendlyName() << "(), attributeTypes)";
+
+		m_Impl << ");" << std::endl;
+		snum++;
+	}
+
+	m_Impl << "}" << std::endl << std::endl;
+
+	/* DeserializeField */
+	m_Header << "public:" << std::endl
+			<< "\t" << "bool DeserializeField(const String& name, const Value& value, bool safeMode, int attributeTypes) override;" << std::endl;
+
+	m_Impl << "bool ObjectImpl<" << klass.Name << ">::DeserializeField(const String& name, const Value& value, bool safeMode, int attributeTypes)" << std::endl
+		<< "{" << std::endl;
+
+	if (!klass.Fields.empty()) {
+		std::vector<const Field *> fieldsByNum;
+
+		for (const Field& field : klass.Fields)
+			fieldsByNum.push_back(&field);
+
+		m_Impl << "\tswitch (static_cast<int>(Utility::SDBM(name, " << hlen << "))) {" << std::endl;
+
+		for (const auto& itj : jumptable) {
+			m_Impl << "\t\tcase " << itj.first << ":" << std::endl;
+
+			for (const auto& itf : itj.second) {
+				const Field& field = *fieldsByNum[itf.first];
+				std::string setter = "Set" + field.GetFriendlyName() + "(";
+				std::string convBegin, convEnd;
+
+				if (field.Attributes & FAEnum) {
+					convBegin = "static_cast<" + field.Type.GetRealType() + ">(static_cast<int>(";
+					convEnd = "))";
+				}
+
+				m_Impl << "\t\t\t" << "if (name == \"" << itf.second << "\") {" << std::endl
+					<< "\t\t\t\t" << "if ((attributeTypes & " << field.Attributes << ") == 0)" << std::endl
+					<< "\t\t\t\t\t" << "return true;" << std::endl << std::endl
+					<< "\t\t\t\t" << "try {" << std::endl
+					<< "\t\t\t\t\t" << setter << convBegin << "Deserialize(value, safeMode, attributeTypes)" << convEnd << ", true);" << std::endl
+					<< "\t\t\t\t" << "} catch (const std::exception&) {" << std::endl
+					<< "\t\t\t\t\t" << setter << convBegin << "Empty" << convEnd << ");" << std::endl
+					<< "\t\t\t\t" << "}" << std::endl << std::endl
+					<< "\t\t\t\t" << "return true;" << std::endl
+					<< "\t\t\t" << "}" << std::endl;
+			}
+
+			m_Impl << std::endl
+					<< "\t\t\tbreak;" << std::endl;
+		}
+
+		m_Impl << "\t}" << std::endl << std::endl;
+	}
+
+	m_Impl << "\t" << "return ";
+
+	if (!klass.Parent.empty())
+		m_Impl << klass.Parent << "::DeserializeField(name, value, safeMode, attributeTypes)";
+	else
+		m_Impl << "false";
+
+	m_Impl << ";" << std::endl
+		<< "}" << std::endl << std::endl;
+
 	if (!klass.Fields.empty()) {
 		/* SetField */
 		m_Header << "public:" << std::endl
@@ -589,7 +768,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::FieldCount; " << std::endl
 				<< "\t" << "if (real_id < 0) { " << klass.Parent << "::SetField(id, value, suppress_events, cookie); return; }" << std::endl;
 
 		m_Impl << "\t" << "switch (";
@@ -633,7 +812,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::FieldCount; " << std::endl
 				<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::GetField(id); }" << std::endl;
 
 		m_Impl << "\t" << "switch (";
@@ -666,7 +845,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::FieldCount; " << std::endl
 				<< "\t" << "if (real_id < 0) { " << klass.Parent << "::ValidateField(id, lvalue, utils); return; }" << std::endl;
 
 		m_Impl << "\t" << "switch (";
@@ -710,7 +889,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::FieldCount; " << std::endl
 				<< "\t" << "if (real_id < 0) { " << klass.Parent << "::NotifyField(id, cookie); return; }" << std::endl;
 
 		m_Impl << "\t" << "switch (";
@@ -744,7 +923,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::FieldCount; " << std::endl
 				<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::NavigateField(id); }" << std::endl;
 
 		bool haveNavigationFields = false;
@@ -869,6 +1048,21 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 					<< "\t\t" << "Notify" << field.GetFriendlyName() << "(cookie);" << std::endl
 					<< "}" << std::endl << std::endl;
 			}
+
+			/* Plain setters get an overload which moves temporaries into the field.
+			 * Virtual setters don't because overrides would be bypassed. */
+			if (field.Type.GetArgumentType() == field.Type.GetRealType() || field.Attributes & (FASetVirtual | FANoStorage | FAEnum)
+				|| field.PureSetAccessor || !field.SetAccessor.empty() || field.Type.IsName || !field.TrackAccessor.empty())
+				continue;
+
+			m_Header << "\t" << "void Set" << field.GetFriendlyName() << "(" << field.Type.GetRealType() << "&& value, bool suppress_events = false, const Value& cookie = Empty);" << std::endl;
+
+			m_Impl << "void ObjectImpl<" << klass.Name << ">::Set" << field.GetFriendlyName() << "(" << field.Type.GetRealType() << "&& value, bool suppress_events, const Value& cookie)" << std::endl
+				<< "{" << std::endl
+				<< "\t" << "m_" << field.GetFriendlyName() << " = std::move(value);" << std::endl
+				<< "\t" << "if (!suppress_events)" << std::endl
+				<< "\t\t" << "Notify" << field.GetFriendlyName() << "(cookie);" << std::endl
+				<< "}" << std::endl << std::endl;
 		}
 
 		m_Header << "protected:" << std::endl;
@@ -1021,6 +1215,8 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 
 			if (field.Name != "active") {
 				m_Impl << "\t" << "auto *dobj = dynamic_cast<ConfigObject *>(this);" << std::endl
+					<< "\t" << "if (dobj)" << std::endl
+					<< "\t\t" << "dobj->MarkChanged();" << std::endl
 					<< "\t" << "if (!dobj || dobj->IsActive())" << std::endl
 					<< "\t";
 			}
@@ -1056,11 +1252,15 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		/* instance variables */
 		m_Header << "private:" << std::endl;
 
-		for (const Field& field : klass.Fields) {
-			if (field.Attributes & FANoStorage)
-				continue;
+		/* Hot fields come first so that they share as few cache lines as possible
+		 * instead of being spread between the rarely used config fields. */
+		for (bool hot : { true, false }) {
+			for (const Field& field : klass.Fields) {
+				if (field.Attributes & FANoStorage || static_cast<bool>(field.Attributes & FAHot) != hot)
+					continue;
 
-			m_Header << "\t" << field.Type.GetRealType() << " m_" << field.GetFriendlyName() << ";" << std::endl;
+				m_Header << "\t" << field.Type.GetRealType() << " m_" << field.GetFriendlyName() << ";" << std::endl;
+			}
 		}
 		
 		/* signal */
@@ -1458,6 +1658,7 @@ void ClassCompiler::CompileStream(const std::string& path, std::istream& input,
 		<< "#include \"base/logger.hpp\"" << std::endl
 		<< "#include \"base/function.hpp\"" << std::endl
 		<< "#include \"base/configtype.hpp\"" << std::endl
+		<< "#include \"base/serializer.hpp\"" << std::endl
 		<< "#ifdef _MSC_VER" << std::endl
 		<< "#pragma warning( push )" << std::endl
 		<< "#pragma warning( disable : 4244 )" << std::endl